@@ -88,6 +88,35 @@ struct nfit_map {
 	uint16_t reserved;           /* Reserved, must be zero */
 } __attribute__((packed));
 
+/**
+ * struct nfit_dcr - NVDIMM Control Region Structure
+ */
+struct nfit_dcr {
+	uint16_t type;
+	uint16_t length;
+	uint16_t region_index;
+	uint16_t vendor_id;
+	uint16_t device_id;
+	uint16_t revision_id;
+	uint16_t subsystem_vendor_id;
+	uint16_t subsystem_device_id;
+	uint16_t subsystem_revision_id;
+	uint8_t valid_fields;
+	uint8_t manufacturing_location;
+	uint16_t manufacturing_date;
+	uint8_t reserved[2];
+	uint32_t serial_number;
+	uint16_t code;
+	uint16_t windows;
+	uint64_t window_size;
+	uint64_t command_offset;
+	uint64_t command_size;
+	uint64_t status_offset;
+	uint64_t status_size;
+	uint16_t flags;
+	uint8_t reserved1[6];
+} __attribute__((packed));
+
 struct srat {
 	struct acpi_header h;
 	uint32_t revision;
@@ -138,6 +167,58 @@ struct srat_mem {
 	uint64_t reserved2;
 } __attribute__((packed));
 
+/**
+ * struct hmat - Heterogeneous Memory Attribute Table, revision 2
+ */
+struct hmat {
+	struct acpi_header h;
+	uint32_t reserved;
+} __attribute__((packed));
+
+enum acpi_hmat_type {
+	ACPI_HMAT_TYPE_PROXIMITY = 0,
+	ACPI_HMAT_TYPE_LOCALITY = 1,
+	ACPI_HMAT_TYPE_CACHE = 2,
+};
+
+enum {
+	ACPI_HMAT_INITIATOR_PD_VALID = (1<<0),
+	ACPI_HMAT_ACCESS_LATENCY = 0,
+	ACPI_HMAT_ACCESS_BANDWIDTH = 3,
+};
+
+struct hmat_proximity {
+	uint16_t type;
+	uint16_t reserved;
+	uint32_t length;
+	uint16_t flags;
+	uint16_t reserved1;
+	uint32_t processor_pd;
+	uint32_t memory_pd;
+	uint32_t reserved2;
+	uint64_t reserved3;
+	uint64_t reserved4;
+} __attribute__((packed));
+
+/*
+ * Followed by the initiator and target proximity domains, 32 bits
+ * each, then one 16 bit entry per initiator and target, in units of
+ * @entry_base_unit: picoseconds for latency, MB/s for bandwidth.
+ */
+struct hmat_locality {
+	uint16_t type;
+	uint16_t reserved;
+	uint32_t length;
+	uint8_t flags;
+	uint8_t data_type;
+	uint8_t min_transfer_size;
+	uint8_t reserved1;
+	uint32_t number_of_initiator_pds;
+	uint32_t number_of_target_pds;
+	uint32_t reserved2;
+	uint64_t entry_base_unit;
+} __attribute__((packed));
+
 struct acpi_subtable8 {
 	uint8_t type;
 	uint8_t length;
@@ -6,19 +6,35 @@ large portion of the necessary c code for implementation. Updated versions of
 the affected source files are created and placed into cxlcli-test/cxl/gen
 including libcxl.c, libcxl.h, libcxl.sym, builtin.h, cxl.c and memdev.c.
 
+For libcxl.c each opcode becomes a constant struct cxl_vendor_cmd descriptor
+(opcode, payload sizes, input and output field layout) and a thin
+cxl_memdev_<cmd>() wrapper that hands its arguments to the shared
+cxl_memdev_vendor_cmd() executor in cxl/lib/libcxl.c, rather than a full
+copy of the submit / status check / print boilerplate. Commands with an
+output payload also get a cxl_cmd_new_<cmd>() constructor and one
+cxl_cmd_<cmd>_get_<field>() accessor per field, which read straight from
+the mailbox output buffer instead of copying it out.
+
+Commands that read a device buffer or log, recognized by an output array
+paired with an end-of-buffer flag or an input index, also get a
+cxl_cmd_<cmd>_next() iterator that pages through it with one reused
+command, and a --stream CLI option writing every page to stdout, raw.
+
 It requires some marked up base versions of these files to read in as
 templates, which are all included in the tar.
 
 This is currently a first draft, so it has some limitations:
- - Variable-length input / output payloads are not yet implemented.
+ - Variable-length payloads are supported when the variable part is a
+   single trailing array; its element count comes from an earlier field
+   named in its length, or is whatever fits in the payload.
  - Names for variables & flags use mnemonics verbatim and are not truncated.
  - Code is inserted directly into the relevant files instead of creating
    vendor specific source files to import. These files are duplicated, not
    overwritten, so it's fine for now but not ideal.
  - The traversal for the pyyml output is a bit hacky, it'll need to be made
    more robust in order to be extended to YAMLs from different vendors.
- - Input parameters greater than 8 bytes of length need to be implemented
-   manually.
+ - Input parameters greater than 8 bytes are taken by the CLI as a file
+   of raw host-endian elements.
 
 Instructions for use:
  1. $ tar git clone git@github.com:elake/ndctl.git
@@ -63,18 +79,35 @@ class Payload():
             x = "o"
         self.fixed_size = True
         self.simple = True
-        self.var_opl = False
         self.payload = payload
         self.name = payload.get(f'{x}pl_name', "")
         self.mn = payload.get(f'{x}pl_mnemonic', "").lower()
         self.size = payload.get(f'{x}pl_size_bytes')
-        if isinstance(self.size, str):
-            self.fixed_size = False
-            return
+        self.variable = isinstance(self.size, str)
         self.params = []
+        self.stream = None
         self.build_params(payload, x)
+        if self.variable:
+            self.size_variable(input)
         self.is_simple()
 
+    def size_variable(self, input):
+        """
+        A variable-length payload is sized by its fixed part, everything
+        ahead of a single trailing array. Any other layout still has to
+        be written by hand.
+        """
+        var = [p for p in self.params if p.get("variable")]
+        last = max(self.params, key=lambda p: p.get("offset"), default=None)
+        if len(var) != 1 or var[0] is not last:
+            self.fixed_size = False
+            return
+        # an input array has to say how long it is, an output can fill
+        if input and not var[0].get("count_by"):
+            self.fixed_size = False
+            return
+        self.size = var[0].get("offset")
+
     def build_params(self, payload, x):
         used_mn = set()
         self.params_used = False
@@ -96,7 +129,11 @@ class Payload():
                 "format_specifier": "",
                 "unit_size": par.get(f"{x}pl_unit_size"),
                 "contiguous": par.get(f"{x}pl_contiguous", False),
+                "variable": isinstance(par.get(f"{x}pl_length"), str),
+                "count_by": None,
             }
+            if param["variable"]:
+                param["count_by"] = self.get_variable_length(param)
             param.update({
                 "type": self.types(param),
             })
@@ -121,8 +158,22 @@ class Payload():
             param["utype"] = re.sub("__le", "u", t)
             self.params.append(param)
 
-    def get_variable_length(self, mn):
-        keywords = ["num", "inst"]
+    def get_variable_length(self, param):
+        """
+        The earlier parameter holding the element count of a variable
+        length @param, found by name in its length, e.g. "num_entries * 4"
+        or "Number of Entries x 4". None means as many as fit.
+        """
+        length = param.get("size").lower()
+        for par in reversed(self.params):
+            if par.get("variable") or par.get("size") not in {1, 2, 4, 8}:
+                continue
+            mn = par.get("mn")
+            name = (par.get("name") or "").lower()
+            if re.search(rf"\b{re.escape(mn)}\b", length) or (
+                    name and name in length):
+                return par
+        return None
 
     def is_simple(self):
         for param in self.params:
@@ -156,6 +207,9 @@ class Payload():
             4: '__le32',
             8: '__le64',
             }
+        if param.get("variable"):
+            # no fixed count, the payload says how many
+            return (t.get(unit or 1), 0)
         if unit:
             return (t.get(unit), i // unit)
         if t.get(i): return t.get(i)
@@ -187,6 +241,14 @@ class Payload():
 def base(s):
     return os.path.join(OUTDIR, f"{BASE}.{s}")
 
+def is_array(param):
+    return not isinstance(param.get("type"), str)
+
+def is_rsvd(param):
+    return re.match(r"^rsvd\d*$", param.get("mn")) is not None
+
+WIDTHS = {'u8': 1, '__le16': 2, '__le32': 4, '__le64': 8}
+
 def to_cpu(t, mn):
     t = re.sub("_", "", t)
     if t == 'u8':
@@ -201,7 +263,56 @@ def cpu_to(t, mn):
     else:
         return f"cpu_to_{t}({mn})"
 
-def generate_ipl_struct(name, ipl):
+def detect_stream(ipl, opl):
+    """
+    Recognize a buffer or log read: an output array that is paged through
+    by rereading, either until an output flag marks the end of the device
+    buffer, or by advancing an input index until a page comes back shorter
+    than asked. Returns the field indexes for struct cxl_vendor_stream, or
+    None when nothing would tell the pages had run out.
+    """
+    ins = [p for p in ipl.params if not is_rsvd(p)]
+    outs = [p for p in opl.params if not is_rsvd(p)]
+    data = [i for i, p in enumerate(outs) if is_array(p)]
+    if not data:
+        return None
+
+    def find(params, pattern):
+        for i, p in enumerate(params):
+            if not is_array(p) and re.search(pattern, p.get("mn")):
+                return i
+        return -1
+
+    end = find(outs, r"(^|_)(end|done|last|eof)($|_)")
+    index = find(ins, r"(^|_)(idx|index|offset)($|_)")
+    # without an end flag only a variable page can come up short
+    count = -1
+    if index >= 0 and outs[data[-1]].get("variable"):
+        count = find(ins, r"(^|_)(cnt|count|num)($|_)")
+    if end < 0 and count < 0:
+        return None
+    return {"data": data[-1], "end": end, "index": index, "count": count}
+
+
+def generate_stream_cmd(name, opl):
+    # memdev.c --stream: every page, raw, to stdout
+    mn = stream_data(opl).get("mn")
+    t = re.sub('__le', 'u', stream_data(opl).get("type")[0])
+    return (
+        f"static int stream_cmd_{name}(struct cxl_cmd *cmd)\n{{\n"
+        + f"\tconst {t} *{mn};\n"
+        + f"\tint nr;\n\n"
+        + f"\tif (!cmd)\n\t\treturn -errno;\n"
+        + f"\twhile ((nr = cxl_cmd_{name}_next(cmd, &{mn})) > 0)\n"
+        + f"\t\tif (fwrite({mn}, sizeof(*{mn}), nr, stdout) != (size_t) nr) {{\n"
+        + f"\t\t\tnr = -errno;\n\t\t\tbreak;\n\t\t}}\n"
+        + f"\tcxl_cmd_unref(cmd);\n"
+        + f"\tif (fflush(stdout) != 0 && !nr)\n\t\tnr = -errno;\n"
+        + f"\treturn nr;\n}}\n\n"
+    )
+
+
+def generate_ipl_struct(name, ipl, opl):
     # struct memdev.c line 138-143
     pname = f"{name}_params"
     out = f"static struct _{pname} {{\n"
@@ -210,11 +321,15 @@ def generate_ipl_struct(name, ipl):
         l = param.get('size')
         if re.match(r"^rsvd\d*$", mn):
             continue
-        if l < 5:
+        if is_array(param):
+            out += f"\tconst char *{mn}_file;\n"
+        elif l < 5:
             out += f"\tu32 {mn};\n"
         else:
             out += f"\tu64 {mn};\n"
     out += f"\tbool verbose;\n"
+    if opl.stream:
+        out += f"\tbool stream;\n"
     out += f"}} {pname};\n\n"
     return out
 
@@ -228,9 +343,13 @@ def generate_option_struct(name, ipl):
     out += f"\tOPT_END(),\n}};\n\n"
     return out
 
-def generate_def_base_options(name):
+def generate_def_base_options(name, opl):
     # Line 145 memdev.c
-    return f'#define {name.upper()}_BASE_OPTIONS() \\\nOPT_BOOLEAN(\'v\',"verbose", &{name}_params.verbose, "turn on debug")\n\n'
+    out = f'#define {name.upper()}_BASE_OPTIONS() \\\nOPT_BOOLEAN(\'v\',"verbose", &{name}_params.verbose, "turn on debug")'
+    if opl.stream:
+        end = "the end" if opl.stream.get("end") >= 0 else "a short page"
+        out += f', \\\nOPT_BOOLEAN(0, "stream", &{name}_params.stream, "write every page to stdout, raw, until {end}")'
+    return f"{out}\n\n"
 
 def generate_def_options(name, ipl):
     if not ipl.params_used:
@@ -244,19 +363,23 @@ def generate_def_options(name, ipl):
         '__le64': 'OPT_U64',
         }
     out = f"#define {name.upper()}_OPTIONS()"
+    counts = [p.get("count_by") for p in ipl.params if p.get("count_by")]
     for param in ipl.params:
         mn = param.get('mn')
         if re.match(r"^rsvd\d*$", mn):
             continue
+        # set from the size of the file holding the array it counts
+        if any(param is c for c in counts):
+            continue
         pname = param.get('name')
         pt = param.get('type')
         if not isinstance(pt, str):
             pt = pt[0]
         # ctype = t.get(pt)
-        if int(param.get('size')) < 5:
-            ctype = 'OPT_UINTEGER'
-        else:
+        if is_array(param) or int(param.get('size')) >= 5:
             ctype = 'OPT_U64'
+        else:
+            ctype = 'OPT_UINTEGER'
         flag = mn[0]
         while flag in flags:
             i = ord(flag) + 1
@@ -264,36 +387,128 @@ def generate_def_options(name, ipl):
                 i = 65
             flag = chr(i)
         flags.add(flag)
+        if is_array(param):
+            out += (f" \\\nOPT_FILENAME(\'{flag}\', \"{mn}_file\", "
+                    + f"&{name}_params.{mn}_file, \"{mn}-file\", "
+                    + f"\"{pname}, as raw host-endian elements\"),")
+            continue
         out += f" \\\n{ctype}(\'{flag}\', \"{mn}\", &{name}_params.{mn}, \"{pname}\"),"
     out = f"{out.rstrip(',')}\n\n"
     return out
 
-def generate_action_cmd(name, ipl):
+def action_call(head, name, ipl, tail=");"):
+    # head(memdev, <each parameter>)tail, the arrays as loaded from file
+    rout = f"{head}(memdev"
+    out = ""
+    for param in ipl.params:
+        mn = param.get('mn')
+        if re.match(r"^rsvd\d*$", mn):
+            continue
+        arg = f"{name}_params.{mn}"
+        if is_array(param):
+            arg = mn
+        if len(rout) > 60:
+            out += f"{rout},\n\t\t"
+            rout = arg
+            continue
+        rout += f", {arg}"
+    return f"{out}{rout}{tail}\n"
+
+
+def generate_action_cmd(name, ipl, opl):
     # action_cmd memdev.c line 315-325
+    arrays = [p for p in ipl.params if is_array(p) and not is_rsvd(p)]
     out = f"static int action_cmd_{name}(struct cxl_memdev *memdev, struct action_context *actx)\n{{\n"
+    for param in arrays:
+        out += f"\tvoid *{param.get('mn')} = NULL;\n"
+        out += f"\tsize_t {param.get('mn')}_size;\n"
+    if arrays:
+        out += f"\tint rc;\n\n"
     out += f"\tif (cxl_memdev_is_active(memdev)) {{\n"
     out += f"\t\tfprintf(stderr, \"%s: memdev active, abort {name}\\n\",\n"
     out += f"\t\t\tcxl_memdev_get_devname(memdev));\n"
     out += f"\t\treturn -EBUSY;\n\t}}\n\n"
-    rout = f"\treturn cxl_memdev_{name}(memdev"
-    for param in ipl.params:
+    for param in arrays:
         mn = param.get('mn')
-        if re.match(r"^rsvd\d*$", mn):
-            continue
         t = param.get('type')
-        amp = "(void *) "
-        if isinstance(t, str):
-            # Prepend with & only if parameter is an array
-            amp = ""
-        if len(rout) > 60:
-            out += f"{rout},\n\t\t"
-            rout = f"{amp}{name}_params.{mn}"
+        out += f"\trc = vendor_load_file({name}_params.{mn}_file, &{mn}, &{mn}_size);\n"
+        out += f"\tif (rc)\n\t\tgoto out;\n"
+        if param.get("variable"):
+            count = param.get("count_by")
+            if count:
+                nr = f"{mn}_size"
+                if WIDTHS.get(t[0]) > 1:
+                    nr += f" / {WIDTHS.get(t[0])}"
+                out += f"\t{name}_params.{count.get('mn')} = {nr};\n"
             continue
-        rout += f", {amp}{name}_params.{mn}"
-    out += f"{rout});\n}}\n"
+        need = WIDTHS.get(t[0]) * t[1]
+        out += f"\tif ({mn}_size < {need}) {{\n"
+        out += f"\t\tfprintf(stderr, \"%s: expected {need} bytes\\n\",\n"
+        out += f"\t\t\t{name}_params.{mn}_file);\n"
+        out += f"\t\trc = -EINVAL;\n\t\tgoto out;\n\t}}\n"
+    if arrays:
+        out += "\n"
+    if opl.stream and arrays:
+        out += f"\tif ({name}_params.stream) {{\n"
+        out += action_call(f"\t\trc = stream_cmd_{name}(cxl_cmd_new_{name}", name, ipl, "));")
+        out += f"\t\tgoto out;\n\t}}\n\n"
+    elif opl.stream:
+        out += f"\tif ({name}_params.stream)\n"
+        out += action_call(f"\t\treturn stream_cmd_{name}(cxl_cmd_new_{name}", name, ipl, "));")
+        out += "\n"
+    if arrays:
+        out += action_call(f"\trc = cxl_memdev_{name}", name, ipl)
+    else:
+        out += action_call(f"\treturn cxl_memdev_{name}", name, ipl)
+    if arrays:
+        out += "out:\n"
+        for param in arrays:
+            out += f"\tfree({param.get('mn')});\n"
+        out += "\treturn rc;\n"
+    out += "}\n"
     return out
 
 
+def generate_load_file():
+    # shared by the action of every command with an array input
+    return r"""/* all of @path, for an array parameter, in a buffer to be freed */
+static int vendor_load_file(const char *path, void **buf, size_t *size)
+{
+	struct stat st;
+	FILE *f;
+	int rc = 0;
+
+	if (!path) {
+		fprintf(stderr, "an input file is required\n");
+		return -EINVAL;
+	}
+	f = fopen(path, "rb");
+	if (!f || fstat(fileno(f), &st) < 0) {
+		rc = -errno;
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		goto out;
+	}
+	*size = st.st_size;
+	*buf = malloc(*size ? *size : 1);
+	if (!*buf) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	if (fread(*buf, 1, *size, f) != *size) {
+		fprintf(stderr, "%s: short read\n", path);
+		free(*buf);
+		*buf = NULL;
+		rc = -EIO;
+	}
+out:
+	if (f)
+		fclose(f);
+	return rc;
+}
+
+"""
+
+
 def generate_cmd_def(name):
     # memdev.c line 715-721
     return (
@@ -316,21 +531,11 @@ def generate_mem_cmd_info(name, opcode, ipl, opl):
     return out
 
 
-def generate_mbox(name, payload, end="in"):
-    # struct cxl_mbox libcxl.c line 1537-1546 & 1460-1471
-    if not payload.params:
-        return ""
-    out = f"struct cxl_mbox_{name}_{end} {{\n"
-    for param in payload.params:
-        out += f"\t{payload.declaration(param)}"
-    out += f"}}  __attribute__((packed));\n"
-    return out
-
-
-def generate_cxl_export(name, ipl, opl, fullname):
-    # CXL_EXPORT libcxl.c line 1549-1619
+def generate_signature(prefix, name, ipl, ret="int ", fn=None):
+    # Shared by the libcxl.c definition and the libcxl.h prototype
     out = ""
-    nout = f"CXL_EXPORT int cxl_memdev_{name}(struct cxl_memdev *memdev"
+    fn = fn or f"cxl_memdev_{name}"
+    nout = f"{prefix}{ret}{fn}(struct cxl_memdev *memdev"
     for param in ipl.params:
         mn = param.get('mn')
         if re.match(r"^rsvd\d*$", mn):
@@ -348,134 +553,219 @@ def generate_cxl_export(name, ipl, opl, fullname):
             nout += f", {re.sub('__le', 'u', t)} {mn}"
         else:
             nout += f", {re.sub('__le', 'u', t[0])} *{mn}"
-    out += f"{nout})\n{{\n"
-    for param in opl.params:
-        enums = param.get("enums")
-        if enums:
-            mn = param.get("mn")
-            out += f"\tconst char *{mn}_descriptions[] = {{"
-            for en in enums:
-                out += f"\n\t\t\"{en.get('name')}\","
-            out = f"{out.rstrip(',')}\n\t}};\n\n"
-    out += f"\tstruct cxl_cmd *cmd;\n"
-    if ipl.params_used:
-        out += f"\tstruct cxl_mem_query_commands *query;\n"
-        out += f"\tstruct cxl_command_info *cinfo;\n"
-        out += f"\tstruct cxl_mbox_{name}_in *{name}_in;\n"
-    if opl.params:
-        out += f"\tstruct cxl_mbox_{name}_out *{name}_out;\n"
-    out += f"\tint rc = 0;\n\n"
-    out += f"\tcmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_{name.upper()}_OPCODE);\n"
-    out += f"\tif (!cmd) {{\n"
-    out += f"\t\tfprintf(stderr, \"%s: cxl_cmd_new_raw returned Null output\\n\",\n"
-    out += f"\t\t\t\tcxl_memdev_get_devname(memdev));\n"
-    out += f"\t\treturn -ENOMEM;\n\t}}\n\n"
-    if ipl.params_used:
-        out += f"\tquery = cmd->query_cmd;\n"
-        out += f"\tcinfo = &query->commands[cmd->query_idx];\n\n"
-        out += f"\t/* update payload size */\n"
-        out += f"\tcinfo->size_in = CXL_MEM_COMMAND_ID_{name.upper()}_PAYLOAD_IN_SIZE;\n"
-        out += f"\tif (cinfo->size_in > 0) {{\n"
-        out += f"\t\t cmd->input_payload = calloc(1, cinfo->size_in);\n"
-        out += f"\t\tif (!cmd->input_payload)\n"
-        out += f"\t\t\treturn -ENOMEM;\n"
-        out += f"\t\tcmd->send_cmd->in.payload = (u64)cmd->input_payload;\n"
-        out += f"\t\tcmd->send_cmd->in.size = cinfo->size_in;\n\t}}\n\n"
-        out += f"\t{name}_in = (void *) cmd->send_cmd->in.payload;\n\n"
-        for param in ipl.params:
-            mn = param.get('mn')
-            if re.match(r"^rsvd\d*$", mn):
-                continue
-            t = param.get('type')
-            if  isinstance(t, str):
-                t = re.sub("_", "", t)
-                if t == 'u8':
-                    out += f"\t{name}_in->{mn} = {mn};\n"
-                else:
-                    out += f"\t{name}_in->{mn} = cpu_to_{t}({mn});\n"
-            else:
-                tz = re.sub("_", "", t[0])
-                out += f"\tfor(int i = 0; i < {t[1]}; i++) {{\n"
-                if tz == 'u8':
-                    out += f"\t\t{name}_in->{mn}[i] = {mn}[i];\n\t}}\n\n"
-                else:
-                    out += f"\t\t{name}_in->{mn}[i] = cpu_to_{tz}({mn}[i]);\n\t}}\n\n"
-    out += f"\trc = cxl_cmd_submit(cmd);\n"
-    out += f"\tif (rc < 0) {{\n"
-    out += f"\t\tfprintf(stderr, \"%s: cmd submission failed: %d (%s)\\n\",\n"
-    out += f"\t\t\t\tcxl_memdev_get_devname(memdev), rc, strerror(-rc));\n"
-    out += f"\t\t goto out;\n\t}}\n\n"
-    out += f"\trc = cxl_cmd_get_mbox_status(cmd);\n"
-    out += f"\tif (rc != 0) {{\n"
-    out += f"\t\tfprintf(stderr, \"%s: firmware status: %d\\n\",\n"
-    out += f"\t\t\t\tcxl_memdev_get_devname(memdev), rc);\n"
-    out += f"\t\trc = -ENXIO;\n"
-    out += f"\t\tgoto out;\n\t}}\n\n"
-    out += f"\tif (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_{name.upper()}) {{\n"
-    out += f"\t\t fprintf(stderr, \"%s: invalid command id 0x%x (expecting 0x%x)\\n\",\n"
-    out += f"\t\t\t\tcxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_{name.upper()});\n"
-    out += f"\t\treturn -EINVAL;\n\t}}\n\n"
+    return f"{out}{nout})"
+
+
+def wrap(head, items, tail, indent="\t"):
+    # Join items after head, breaking lines before they pass 80 columns
+    out = ""
+    line = head
+    for i, item in enumerate(items):
+        sep = ", " if i < len(items) - 1 else tail
+        if len(line.expandtabs(8)) + len(item) + len(sep) > 80 and line.strip():
+            out += line.rstrip() + "\n"
+            line = indent
+        line += item + sep
+    return out + line + "\n"
+
+
+def generate_fields(name, payload, end="in"):
+    # struct cxl_vendor_field rows for one payload
+    widths = {'u8': 1, '__le16': 2, '__le32': 4, '__le64': 8}
+    enums = ""
+    rows = ""
+    for param in payload.params:
+        mn = param.get('mn')
+        if re.match(r"^rsvd\d*$", mn):
+            continue
+        t = param.get('type')
+        items = []
+        if end == "out":
+            items.append(f"\"{param.get('name')}\"")
+        if not isinstance(t, str):
+            if end == "out" and not param.get("contiguous"):
+                items.append(f".mn = \"{mn}\"")
+        items.append(f".offset = {param.get('offset'):#04x}")
+        if isinstance(t, str):
+            items.append(f".width = {widths.get(t)}")
+        elif param.get("variable"):
+            flags = ["CXL_VF_VARIABLE"]
+            if end == "out" and param.get("contiguous"):
+                flags.insert(0, "CXL_VF_CONTIGUOUS")
+            items.append(f".width = {widths.get(t[0])}")
+            count = param.get("count_by")
+            if count:
+                items.append(f".count_offset = {count.get('offset'):#04x}")
+                items.append(f".count_width = {count.get('size')}")
+            items.append(f".flags = {' | '.join(flags)}")
+        else:
+            items.append(f".width = {widths.get(t[0])}")
+            items.append(f".count = {t[1]}")
+            if end == "out" and param.get("contiguous"):
+                items.append(".flags = CXL_VF_CONTIGUOUS")
+        if end == "out" and param.get("enums") and isinstance(t, str):
+            dname = f"{name}_{mn}_descriptions"
+            enums += f"static const char * const {dname}[] = {{"
+            for en in param.get("enums"):
+                enums += f"\n\t\"{en.get('name')}\","
+            enums = f"{enums.rstrip(',')}\n}};\n\n"
+            items.append(f".enums = {dname}")
+            items.append(f".nr_enums = ARRAY_SIZE({dname})")
+        if end == "out":
+            # the label is positional, keep it next to the brace
+            items[0] = f"{{ .name = {items[0]}"
+            rows += wrap("\t", items, " },", indent="\t  ")
+        else:
+            rows += wrap("\t{ ", items, " },", indent="\t  ")
+    if not rows:
+        return ""
+    return (
+        enums
+        + f"static const struct cxl_vendor_field {name}_{end}_fields[] = {{\n"
+        + rows
+        + f"}};\n"
+    )
+
+
+def generate_vendor_cmd(name, ipl, opl, fullname):
+    # struct cxl_vendor_cmd descriptor consumed by cxl_memdev_vendor_cmd()
+    N = name.upper()
+    out = ""
+    fin = generate_fields(name, ipl, end="in")
+    fout = generate_fields(name, opl, end="out")
+    if fin:
+        out += f"{fin}\n"
+    if fout:
+        out += f"{fout}\n"
+    if opl.stream:
+        out += f"static const struct cxl_vendor_stream {name}_stream = {{\n"
+        for k in ("data", "end", "index", "count"):
+            out += f"\t.{k} = {opl.stream.get(k)},\n"
+        out += f"}};\n\n"
+    out += f"static const struct cxl_vendor_cmd {name}_cmd = {{\n"
     if opl.params:
-        out += f"\t{name}_out = (void *)cmd->send_cmd->out.payload;\n"
-        heading = ( (78 - len(fullname)) // 2 ) * '='
-        heading += f" {fullname} "
-        heading += ( 80 - len(heading) ) * '='
-        out += f"\tfprintf(stdout, \"{heading}\\n\");\n"
-        for param in opl.params:
-            fs = param.get('format_specifier')
-            mn = param.get('mn')
-            if re.match(r"^rsvd\d*$", mn):
-                continue
-            t = param.get('type')
-            if isinstance(t, str):
-                print_value = to_cpu(t, f'{name}_out->{mn}')
-                if not param.get("enums"):
-                    out += f"\tfprintf(stdout, \"{param.get('name')}: {fs}\\n\", {print_value});\n"
-                else:
-                    out += f"\tfprintf(stdout, \"{param.get('name')}: {fs}\\n\", {mn}_descriptions[{name}_out->{mn}]);\n"
-            else:
-                out += f"\tfprintf(stdout, \"{param.get('name')}: \");\n"
-                out += f"\t/* Procedurally generated print statement. To print this array contiguously,\n\t   add \"contiguous: True\" to the YAML param and rerun cligen.py */\n"
-                out += f"\tfor (int i = 0; i < {t[1]}; i++) {{\n"
-                if param.get("contiguous"):
-                    out += f"\t\tfprintf(stdout, \"{fs}\", {to_cpu(t[0], f'{name}_out->{mn}[i]')});\n\t}}\n"
-                else:
-                    out += f"\t\tfprintf(stdout, \"{mn}[%d]: {fs}\\n\", i, {to_cpu(t[0], f'{name}_out->{mn}[i]')});\n\t}}\n"
-                out += f"\tfprintf(stdout, \"\\n\");\n"
-    out += f"\nout:\n"
-    out += f"\tcxl_cmd_unref(cmd);\n"
-    out += f"\treturn rc;\n"
-    out += f"\treturn 0;\n}}\n\n"
+        out += f"\t.title = \"{fullname}\",\n"
+    out += f"\t.opcode = CXL_MEM_COMMAND_ID_{N}_OPCODE,\n"
+    if fin:
+        out += f"\t.size_in = CXL_MEM_COMMAND_ID_{N}_PAYLOAD_IN_SIZE,\n"
+        out += f"\t.in = {name}_in_fields,\n"
+        out += f"\t.nr_in = ARRAY_SIZE({name}_in_fields),\n"
+    if opl.params and opl.size:
+        out += f"\t.size_out = CXL_MEM_COMMAND_ID_{N}_PAYLOAD_OUT_SIZE,\n"
+    if fout:
+        out += f"\t.out = {name}_out_fields,\n"
+        out += f"\t.nr_out = ARRAY_SIZE({name}_out_fields),\n"
+    if opl.stream:
+        out += f"\t.stream = &{name}_stream,\n"
+    if ipl.variable:
+        out += f"\t.flags = CXL_VC_VAR_IN,\n"
+    out += f"}};\n"
     return out
 
 
-def generate_libcxl_h(name, ipl):
-    # cxl_memdev libcxl.h line 62-63
-    out = ""
-    nout = f"int cxl_memdev_{name}(struct cxl_memdev *memdev"
+def generate_cxl_export(name, ipl, opl, fullname):
+    # CXL_EXPORT thin wrapper around the vendor command descriptor
+    out = generate_vendor_cmd(name, ipl, opl, fullname)
+    out += f"\n{generate_signature('CXL_EXPORT ', name, ipl)}\n{{\n"
+    args = []
     for param in ipl.params:
         mn = param.get('mn')
         if re.match(r"^rsvd\d*$", mn):
             continue
-        t = param.get('type')
-        if len(nout) > 60:
-            out += f"{nout},\n\t"
-            nout = ""
-            if  isinstance(t, str):
-                nout += f"{re.sub('__le', 'u', t)} {mn}"
-            else:
-                nout += f"{re.sub('__le', 'u', t[0])} *{mn}"
+        if isinstance(param.get('type'), str):
+            args.append(mn)
+        else:
+            args.append(f"(uintptr_t) {mn}")
+    if args:
+        out += wrap("\tconst u64 args[] = { ", args, " };", indent="\t\t")
+        out += f"\n\treturn cxl_memdev_vendor_cmd(memdev, &{name}_cmd, args);\n"
+    else:
+        out += f"\treturn cxl_memdev_vendor_cmd(memdev, &{name}_cmd, NULL);\n"
+    out += f"}}\n"
+    if opl.params_used:
+        out += generate_views(name, ipl, opl)
+    if opl.stream:
+        out += f"\n{generate_next('CXL_EXPORT ', name, opl)}\n{{\n"
+        out += (f"\treturn cxl_vendor_cmd_next(cmd, &{name}_cmd,\n"
+                + f"\t\t\t(const void **) {stream_data(opl).get('mn')});\n}}\n")
+    return out
+
+
+def stream_data(opl):
+    return [p for p in opl.params if not is_rsvd(p)][opl.stream.get("data")]
+
+
+def generate_next(prefix, name, opl):
+    # the page iterator of a buffer or log read
+    data = stream_data(opl)
+    mn = data.get('mn')
+    return (f"{prefix}int cxl_cmd_{name}_next(struct cxl_cmd *cmd,\n"
+            + f"\t\tconst {re.sub('__le', 'u', data.get('type')[0])} **{mn})")
+
+
+def generate_views(name, ipl, opl):
+    # cxl_cmd_new_<cmd>() plus zero-copy accessors into the output payload
+    out = f"\n{generate_signature('CXL_EXPORT ', name, ipl, 'struct cxl_cmd *', f'cxl_cmd_new_{name}')}\n{{\n"
+    args = []
+    for param in ipl.params:
+        if is_rsvd(param):
             continue
-        if  isinstance(t, str):
-            nout += f", {re.sub('__le', 'u', t)} {mn}"
+        if is_array(param):
+            args.append(f"(uintptr_t) {param.get('mn')}")
         else:
-            nout += f", {re.sub('__le', 'u', t[0])} *{mn}"
-    out += f"{nout});\n"
+            args.append(param.get('mn'))
+    if args:
+        out += wrap("\tconst u64 args[] = { ", args, " };", indent="\t\t")
+        out += f"\n\treturn cxl_vendor_cmd_new(memdev, &{name}_cmd, args);\n}}\n"
+    else:
+        out += f"\treturn cxl_vendor_cmd_new(memdev, &{name}_cmd, NULL);\n}}\n"
+    for idx, param in enumerate(p for p in opl.params if not is_rsvd(p)):
+        out += f"\n{generate_getter('CXL_EXPORT ', name, param)}\n{{\n"
+        if is_array(param):
+            out += (f"\treturn cxl_vendor_cmd_view(cmd, &{name}_cmd, {idx},\n"
+                    + f"\t\t\t(const void **) {param.get('mn')});\n}}\n")
+        else:
+            out += f"\tcmd_vendor_get_field(cmd, &{name}_cmd, {idx});\n}}\n"
+    return out
+
+
+def generate_getter(prefix, name, param):
+    # scalars come back by value, arrays as a view of the output payload
+    mn = param.get('mn')
+    t = param.get('type')
+    fn = f"cxl_cmd_{name}_get_{mn}"
+    if is_array(param):
+        return (f"{prefix}int {fn}(struct cxl_cmd *cmd,\n"
+                + f"\t\tconst {re.sub('__le', 'u', t[0])} **{mn})")
+    ret = "unsigned long long" if t == "__le64" else "int"
+    return f"{prefix}{ret} {fn}(struct cxl_cmd *cmd)"
+
+
+def generate_libcxl_h(name, ipl, opl):
+    # cxl_memdev libcxl.h line 62-63
+    out = f"{generate_signature('', name, ipl)};\n"
+    if not opl.params_used:
+        return out
+    out += f"{generate_signature('', name, ipl, 'struct cxl_cmd *', f'cxl_cmd_new_{name}')};\n"
+    for param in opl.params:
+        if not is_rsvd(param):
+            out += f"{generate_getter('', name, param)};\n"
+    if opl.stream:
+        out += f"{generate_next('', name, opl)};\n"
     return out
 
-def generate_libcxl_sym(name):
+def generate_libcxl_sym(name, opl):
     # libcxl.sym line 75
-    return f"\tcxl_memdev_{name};\n"
+    out = f"\tcxl_memdev_{name};\n"
+    if not opl.params_used:
+        return out
+    out += f"\tcxl_cmd_new_{name};\n"
+    for param in opl.params:
+        if not is_rsvd(param):
+            out += f"\tcxl_cmd_{name}_get_{param.get('mn')};\n"
+    if opl.stream:
+        out += f"\tcxl_cmd_{name}_next;\n"
+    return out
 
 def build_results(results):
     bb = open(base(BUILTINH), 'r')
@@ -520,10 +810,6 @@ def build_results(results):
             for v in results.get("mem_cmd_info").keys():
                 lc.write(results.get("mem_cmd_info").get(v))
                 lc.write(f"\n")
-                lc.write(results.get("mbox_in").get(v))
-                lc.write(f"\n")
-                lc.write(results.get("mbox_out").get(v))
-                lc.write(f"\n")
                 lc.write(results.get("cxl_export").get(v))
                 lc.write(f"\n")
         else:
@@ -539,6 +825,7 @@ def build_results(results):
                 m.write(results.get("options_memdev_c").get(v))
                 m.write(results.get("option_structs_memdev_c").get(v))
         elif re.search(rea, line):
+            m.write(results.get("helpers_memdev_c"))
             for v in results.get("action_cmd_memdev_c").values():
                 m.write(v)
                 m.write(f"\n")
@@ -579,12 +866,11 @@ def run(opcodes):
     action_cmd_memdev_c = {}
     cmd_memdev_c = {}
     mem_cmd_info = {}
-    mbox_in = {}
-    mbox_out = {}
     cxl_export = {}
     libcxl_h = {}
     libcxl_sym = {}
     skipped = {}
+    helpers_memdev_c = ""
 
     for command in opcodes:
         name = command.get("opcode_name", "").lower()
@@ -598,21 +884,26 @@ def run(opcodes):
         if not (ipl.fixed_size and opl.fixed_size):
             skipped.update({name: { "ipl.size": ipl.size, "opl.size": opl.size}})
             continue
+        opl.stream = detect_stream(ipl, opl)
         cxl_c_cmd_struct = f'\t{{ "{re.sub("_", "-", mnemonic)}", .c_fn = cmd_{mnemonic} }},\n'
         cxl_c[name] = cxl_c_cmd_struct
         builtin_h_cmd = (
             f"int cmd_{mnemonic}(int argc, const char **argv, struct cxl_ctx *ctx);\n"
         )
         builtin_h[name] = builtin_h_cmd
-        param_struct = generate_ipl_struct(mnemonic, ipl)
+        param_struct = generate_ipl_struct(mnemonic, ipl, opl)
         param_structs_memdev_c[name] = param_struct
-        base_options_def = generate_def_base_options(mnemonic)
+        base_options_def = generate_def_base_options(mnemonic, opl)
         base_options_memdev_c[name] = base_options_def
         options_def = generate_def_options(mnemonic, ipl)
         options_memdev_c[name] = options_def
         option_struct = generate_option_struct(mnemonic, ipl)
         option_structs_memdev_c[name] = option_struct
-        action_cmd = generate_action_cmd(mnemonic, ipl)
+        if any(is_array(p) and not is_rsvd(p) for p in ipl.params):
+            helpers_memdev_c = generate_load_file()
+        action_cmd = generate_action_cmd(mnemonic, ipl, opl)
+        if opl.stream:
+            action_cmd = generate_stream_cmd(mnemonic, opl) + action_cmd
         action_cmd_memdev_c[name] = action_cmd
         cmd_def = generate_cmd_def(mnemonic)
         cmd_memdev_c[name] = cmd_def
@@ -620,15 +911,11 @@ def run(opcodes):
             mnemonic, opcode, ipl, opl
         )
         mem_cmd_info[name] = mem_command_info
-        cxl_mbox_in = generate_mbox(mnemonic, ipl, end='in')
-        mbox_in[name] = cxl_mbox_in
-        cxl_mbox_out = generate_mbox(mnemonic, opl, end='out')
-        mbox_out[name] = cxl_mbox_out
         libcxl_export = generate_cxl_export(mnemonic, ipl, opl, name)
         cxl_export[name] = libcxl_export
-        libh = generate_libcxl_h(mnemonic, ipl)
+        libh = generate_libcxl_h(mnemonic, ipl, opl)
         libcxl_h[name] = libh
-        libsym = generate_libcxl_sym(mnemonic)
+        libsym = generate_libcxl_sym(mnemonic, opl)
         libcxl_sym[name] = libsym
     results = {
         "cxl_c" : cxl_c,
@@ -638,10 +925,9 @@ def run(opcodes):
         "base_options_memdev_c" : base_options_memdev_c,
         "options_memdev_c" : options_memdev_c,
         "action_cmd_memdev_c" : action_cmd_memdev_c,
+        "helpers_memdev_c" : helpers_memdev_c,
         "cmd_memdev_c" : cmd_memdev_c,
         "mem_cmd_info" : mem_cmd_info,
-        "mbox_in" : mbox_in,
-        "mbox_out" : mbox_out,
         "cxl_export" : cxl_export,
         "libcxl_h" : libcxl_h,
         "libcxl_sym" : libcxl_sym,
@@ -0,0 +1,331 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <util/pool.h>
+#include <json-c/json.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+static struct {
+	unsigned int jobs;
+	bool dry_run;
+	bool verbose;
+} param = {
+	.jobs = 16,
+};
+
+static const struct alert_field {
+	const char *name;
+	unsigned int bit;
+	int min, max;
+} alert_fields[] = {
+	{ "life_used", CXL_ALERT_LIFE_USED, 0, 100 },
+	{ "over_temperature", CXL_ALERT_OVER_TEMP, -32768, 32767 },
+	{ "under_temperature", CXL_ALERT_UNDER_TEMP, -32768, 32767 },
+	{ "corrected_volatile_errors", CXL_ALERT_CORR_VOL_MEM_ERR, 0, 65535 },
+	{ "corrected_persistent_errors", CXL_ALERT_CORR_PERS_MEM_ERR, 0, 65535 },
+};
+
+/* warnings named in the policy, and which of those it wants enabled */
+static struct {
+	unsigned int mask;
+	struct cxl_alert_config cfg;
+} policy;
+
+struct alert_dev {
+	struct cxl_memdev *memdev;
+	struct cxl_alert_config cur;
+	unsigned int changed;
+	unsigned int locked;
+	int rc;
+};
+
+static int alert_get(const struct cxl_alert_config *cfg, unsigned int bit)
+{
+	switch (bit) {
+	case CXL_ALERT_LIFE_USED:
+		return cfg->life_used_warn;
+	case CXL_ALERT_OVER_TEMP:
+		return cfg->over_temp_warn;
+	case CXL_ALERT_UNDER_TEMP:
+		return cfg->under_temp_warn;
+	case CXL_ALERT_CORR_VOL_MEM_ERR:
+		return cfg->corr_vol_mem_err_warn;
+	default:
+		return cfg->corr_pers_mem_err_warn;
+	}
+}
+
+static void alert_set(struct cxl_alert_config *cfg, unsigned int bit, int val)
+{
+	switch (bit) {
+	case CXL_ALERT_LIFE_USED:
+		cfg->life_used_warn = val;
+		break;
+	case CXL_ALERT_OVER_TEMP:
+		cfg->over_temp_warn = val;
+		break;
+	case CXL_ALERT_UNDER_TEMP:
+		cfg->under_temp_warn = val;
+		break;
+	case CXL_ALERT_CORR_VOL_MEM_ERR:
+		cfg->corr_vol_mem_err_warn = val;
+		break;
+	default:
+		cfg->corr_pers_mem_err_warn = val;
+		break;
+	}
+}
+
+/*
+ * Each key names one programmable warning: a number enables it at that
+ * threshold, false disables it, and a missing key leaves it alone.
+ */
+static int parse_policy(const char *path)
+{
+	const struct alert_field *f;
+	struct json_object *jpolicy;
+	unsigned int i;
+	int64_t val;
+	int rc = 0;
+
+	jpolicy = json_object_from_file(path);
+	if (!jpolicy || !json_object_is_type(jpolicy, json_type_object)) {
+		fprintf(stderr, "%s: not a JSON object\n", path);
+		json_object_put(jpolicy);
+		return -EINVAL;
+	}
+
+	json_object_object_foreach(jpolicy, key, jval) {
+		for (i = 0; i < ARRAY_SIZE(alert_fields); i++)
+			if (strcmp(key, alert_fields[i].name) == 0)
+				break;
+		if (i == ARRAY_SIZE(alert_fields)) {
+			fprintf(stderr, "%s: unknown alert '%s'\n", path, key);
+			rc = -EINVAL;
+			continue;
+		}
+		f = &alert_fields[i];
+		if (json_object_is_type(jval, json_type_null))
+			continue;
+		policy.mask |= f->bit;
+		if (json_object_is_type(jval, json_type_boolean)
+				&& !json_object_get_boolean(jval))
+			continue;
+		val = json_object_get_int64(jval);
+		if (!json_object_is_type(jval, json_type_int)
+				|| val < f->min || val > f->max) {
+			fprintf(stderr, "%s: %s must be false or %d..%d\n",
+					path, key, f->min, f->max);
+			rc = -EINVAL;
+			continue;
+		}
+		policy.cfg.valid_alerts |= f->bit;
+		alert_set(&policy.cfg, f->bit, val);
+	}
+	json_object_put(jpolicy);
+	if (rc == 0 && !policy.mask) {
+		fprintf(stderr, "%s: no alerts to apply\n", path);
+		rc = -EINVAL;
+	}
+	return rc;
+}
+
+/* Read the current settings once and write back only what differs */
+static void alert_apply(struct alert_dev *a)
+{
+	struct cxl_alert_config cfg;
+	unsigned int i, bit;
+	bool want, have;
+
+	a->rc = cxl_memdev_read_alert_config(a->memdev, &a->cur);
+	if (a->rc)
+		return;
+
+	cfg = a->cur;
+	for (i = 0; i < ARRAY_SIZE(alert_fields); i++) {
+		bit = alert_fields[i].bit;
+		if (!(policy.mask & bit))
+			continue;
+		want = policy.cfg.valid_alerts & bit;
+		have = a->cur.valid_alerts & bit;
+		if (want == have && (!want || alert_get(&a->cur, bit)
+					== alert_get(&policy.cfg, bit)))
+			continue;
+		if (!(a->cur.programmable_alerts & bit)) {
+			a->locked |= bit;
+			continue;
+		}
+		a->changed |= bit;
+		cfg.valid_alerts = (cfg.valid_alerts & ~bit)
+			| (policy.cfg.valid_alerts & bit);
+		if (want)
+			alert_set(&cfg, bit, alert_get(&policy.cfg, bit));
+	}
+
+	if (a->locked)
+		a->rc = -EPERM;
+	else if (a->changed && !param.dry_run)
+		a->rc = cxl_memdev_write_alert_config(a->memdev, a->changed,
+				&cfg);
+}
+
+static void alert_worker(void *arg, int idx)
+{
+	struct alert_dev *devs = arg;
+
+	alert_apply(&devs[idx]);
+}
+
+/* Devices are independent, so the mailbox round trips run side by side */
+static void alert_apply_all(struct alert_dev *devs, int nr)
+{
+	struct util_pool pool = {
+		.arg = devs,
+		.nr = nr,
+		.jobs = max(param.jobs, 1U),
+		.run = alert_worker,
+	};
+
+	util_pool_run(&pool);
+}
+
+static struct json_object *alert_value_to_json(
+		const struct cxl_alert_config *cfg, unsigned int bit)
+{
+	if (!(cfg->valid_alerts & bit))
+		return json_object_new_boolean(false);
+	return json_object_new_int(alert_get(cfg, bit));
+}
+
+static struct json_object *alert_dev_to_json(struct alert_dev *a)
+{
+	struct json_object *jdev, *jchanges = NULL, *jchange;
+	const struct alert_field *f;
+	const char *status;
+	unsigned int i;
+
+	jdev = json_object_new_object();
+	if (!jdev)
+		return NULL;
+	json_object_object_add(jdev, "memdev",
+			json_object_new_string(cxl_memdev_get_devname(a->memdev)));
+
+	if (a->rc)
+		status = "failed";
+	else if (!a->changed)
+		status = "unchanged";
+	else
+		status = param.dry_run ? "pending" : "updated";
+	json_object_object_add(jdev, "status", json_object_new_string(status));
+	if (a->rc == -EPERM && a->locked)
+		json_object_object_add(jdev, "error",
+				json_object_new_string("alert not programmable"));
+	else if (a->rc)
+		json_object_object_add(jdev, "error",
+				json_object_new_string(strerror(-a->rc)));
+
+	for (i = 0; i < ARRAY_SIZE(alert_fields); i++) {
+		f = &alert_fields[i];
+		if (!((a->changed | a->locked) & f->bit))
+			continue;
+		if (!jchanges)
+			jchanges = json_object_new_array();
+		jchange = json_object_new_object();
+		if (!jchanges || !jchange) {
+			json_object_put(jchange);
+			break;
+		}
+		json_object_object_add(jchange, "alert",
+				json_object_new_string(f->name));
+		json_object_object_add(jchange, "from",
+				alert_value_to_json(&a->cur, f->bit));
+		json_object_object_add(jchange, "to",
+				alert_value_to_json(&policy.cfg, f->bit));
+		if (a->locked & f->bit)
+			json_object_object_add(jchange, "programmable",
+					json_object_new_boolean(false));
+		json_object_array_add(jchanges, jchange);
+	}
+	if (jchanges)
+		json_object_object_add(jdev, "changes", jchanges);
+	return jdev;
+}
+
+int cmd_apply_alert_policy(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_UINTEGER('j', "jobs", &param.jobs,
+				"update up to <n> memdevs at once (default 16)"),
+		OPT_BOOLEAN('n', "dry-run", &param.dry_run,
+				"report the changes without applying them"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl apply-alert-policy <policy.json> [<mem0>..<memN>] [<options>]",
+		NULL
+	};
+	struct alert_dev *devs = NULL, *a;
+	struct json_object *jlist, *jdev;
+	struct cxl_memdev *memdev;
+	const char *all[] = { "all" };
+	const char **filters;
+	int i, j, nr = 0, nr_filters, err = 0;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1)
+		usage_with_options(u, options);
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+	if (parse_policy(argv[0]))
+		return EXIT_FAILURE;
+
+	filters = argc > 1 ? &argv[1] : all;
+	nr_filters = argc > 1 ? argc - 1 : 1;
+	for (i = 0; i < nr_filters; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, filters[i]))
+				continue;
+			for (j = 0; j < nr; j++)
+				if (devs[j].memdev == memdev)
+					break;
+			if (j < nr)
+				continue;
+			a = realloc(devs, (nr + 1) * sizeof(*a));
+			if (!a) {
+				free(devs);
+				return EXIT_FAILURE;
+			}
+			devs = a;
+			a = &devs[nr++];
+			memset(a, 0, sizeof(*a));
+			a->memdev = memdev;
+		}
+	if (!nr) {
+		fprintf(stderr, "no memdevs matched\n");
+		return EXIT_FAILURE;
+	}
+
+	alert_apply_all(devs, nr);
+
+	jlist = json_object_new_array();
+	for (i = 0; i < nr; i++) {
+		err |= devs[i].rc;
+		jdev = alert_dev_to_json(&devs[i]);
+		if (jlist && jdev)
+			json_object_array_add(jlist, jdev);
+	}
+	if (jlist)
+		util_display_json_array(stdout, jlist, 0);
+	free(devs);
+	return err ? EXIT_FAILURE : 0;
+}
@@ -10,6 +10,26 @@ int cmd_transfer_fw(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_activate_fw(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_device_info_get(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_list(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_stats(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_monitor(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_daemon(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_hct_stream(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_hct_decode(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_capture_watch(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_perf(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_fbist_bench(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_eye_sweep(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_link_dbg_dump(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_sync_timestamp(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_mbox_trace(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_list_poison(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_scan_media(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_monitor_qos(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_ld_alloc(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_create_region(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_inject_campaign(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_apply_alert_policy(int argc, const char **argv, struct cxl_ctx *ctx);
+int cxl_run_builtin(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_write_labels(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_read_labels(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_zero_labels(int argc, const char **argv, struct cxl_ctx *ctx);
@@ -41,6 +61,7 @@ int cmd_ltmon_basic_cfg(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_ltmon_watch(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_ltmon_capture_stat(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_ltmon_capture_log_dmp(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_ltmon_record(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_ltmon_capture_trigger(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_ltmon_enable(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_osa_os_type_trig_cfg(int argc, const char **argv, struct cxl_ctx *ctx);
@@ -113,8 +134,10 @@ int cmd_hct_set_config(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_osa_os_patt_trig_cfg(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_osa_misc_trig_cfg(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_osa_data_read(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_osa_capture(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_dimm_spd_read(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_ddr_training_status(int argc, const char **argv, struct cxl_ctx *ctx);
+int cmd_ddr_summary(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_dimm_slot_info(int argc, const char **argv, struct cxl_ctx *ctx);
 int cmd_pmic_vtmon_info(int argc, const char **argv, struct cxl_ctx *ctx);
 #endif /* _CXL_BUILTIN_H_ */
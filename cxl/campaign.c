@@ -0,0 +1,623 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <json-c/json.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+/*
+ * 'cxl inject-campaign': run a schedule of error injection phases
+ * against one memdev. Each phase injects one error type at a fixed
+ * rate for a fixed time while the selected MTA/HIF counters and the
+ * event logs are sampled. A baseline phase without injection runs
+ * first, and the report gives each phase's counter rates relative to
+ * it alongside the number of injections and new event records.
+ */
+enum campaign_inj {
+	INJ_NONE,
+	INJ_DRS_POISON,
+	INJ_DRS_ECC,
+	INJ_RXFLIT_CRC,
+	INJ_TXFLIT_CRC,
+	INJ_HIF_POISON,
+	INJ_HIF_ECC,
+};
+
+static const char *campaign_inj_names[] = {
+	[INJ_NONE] = "none",
+	[INJ_DRS_POISON] = "drs-poison",
+	[INJ_DRS_ECC] = "drs-ecc",
+	[INJ_RXFLIT_CRC] = "rxflit-crc",
+	[INJ_TXFLIT_CRC] = "txflit-crc",
+	[INJ_HIF_POISON] = "hif-poison",
+	[INJ_HIF_ECC] = "hif-ecc",
+};
+
+/* informational, warning, failure and fatal */
+#define CAMPAIGN_NR_LOGS 4
+
+struct campaign_phase {
+	enum campaign_inj type;
+	double rate;
+	u64 duration_ns;
+	unsigned long injected;
+	unsigned long failed;
+	u64 elapsed_ns;
+	unsigned long long *deltas;
+	unsigned long events[CAMPAIGN_NR_LOGS];
+};
+
+struct campaign_counter {
+	char name[32];
+	bool hif;
+	u8 type;
+	u32 counter;
+	struct cxl_cmd *latch;
+	struct cxl_cmd *read;
+	unsigned long long last;
+};
+
+static struct {
+	const char *schedule;
+	const char *events;
+	const char *baseline;
+	const char *interval;
+	const char *output;
+	unsigned int ch_id;
+	unsigned int duration;
+	unsigned int inj_mode;
+	unsigned int tag;
+	unsigned int mem_id;
+	const char *address;
+	unsigned int bytes_per_count;
+	bool verbose;
+} param = {
+	.baseline = "10s",
+	.interval = "1s",
+};
+
+static struct campaign_phase *phases;
+static int nr_phases;
+static struct campaign_counter *counters;
+static int nr_counters;
+static u64 last_event_ts[CAMPAIGN_NR_LOGS];
+static unsigned long long address;
+static volatile sig_atomic_t campaign_stop;
+
+static void campaign_stop_handler(int sig)
+{
+	campaign_stop = 1;
+}
+
+static u64 campaign_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* "100ms", "30s", "2m", or a bare number of seconds */
+static int campaign_parse_time(const char *str, u64 *ns)
+{
+	unsigned long long val;
+	char *end;
+
+	errno = 0;
+	val = strtoull(str, &end, 0);
+	if (errno || end == str || !val)
+		return -EINVAL;
+
+	if (strcmp(end, "ms") == 0)
+		*ns = val * 1000000ULL;
+	else if (*end == '\0' || strcmp(end, "s") == 0)
+		*ns = val * 1000000000ULL;
+	else if (strcmp(end, "m") == 0)
+		*ns = val * 60000000000ULL;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+static struct campaign_phase *campaign_add_phase(void)
+{
+	struct campaign_phase *p;
+
+	p = realloc(phases, (nr_phases + 1) * sizeof(*p));
+	if (!p)
+		return NULL;
+	phases = p;
+	p = &phases[nr_phases++];
+	memset(p, 0, sizeof(*p));
+	return p;
+}
+
+/* <type>:<injections per second>:<duration>[,...] */
+static int campaign_parse_schedule(const char *list)
+{
+	char *dup, *tok, *save, *type, *rate, *duration, *end;
+	struct campaign_phase *p;
+	unsigned int i;
+	int rc = 0;
+
+	dup = strdup(list);
+	if (!dup)
+		return -ENOMEM;
+
+	for (tok = strtok_r(dup, ", ", &save); tok;
+			tok = strtok_r(NULL, ", ", &save)) {
+		type = tok;
+		rate = strchr(type, ':');
+		duration = rate ? strchr(rate + 1, ':') : NULL;
+		if (!duration) {
+			rc = -EINVAL;
+			break;
+		}
+		*rate++ = '\0';
+		*duration++ = '\0';
+
+		p = campaign_add_phase();
+		if (!p) {
+			rc = -ENOMEM;
+			break;
+		}
+		for (i = 1; i < ARRAY_SIZE(campaign_inj_names); i++)
+			if (strcmp(type, campaign_inj_names[i]) == 0)
+				p->type = i;
+		p->rate = strtod(rate, &end);
+		if (p->type == INJ_NONE || end == rate || *end || p->rate <= 0
+				|| campaign_parse_time(duration, &p->duration_ns)) {
+			fprintf(stderr, "invalid schedule entry '%s:%s:%s'\n",
+					type, rate, duration);
+			rc = -EINVAL;
+			break;
+		}
+	}
+	free(dup);
+	return rc;
+}
+
+/* mta:<type>:<counter> or hif:<counter>, as for 'cxl perf stat' */
+static int campaign_parse_events(const char *list)
+{
+	struct campaign_counter *c;
+	char *dup, *tok, *save;
+	unsigned int type, counter;
+	int n, rc = 0;
+
+	dup = strdup(list);
+	if (!dup)
+		return -ENOMEM;
+
+	for (tok = strtok_r(dup, ", ", &save); tok;
+			tok = strtok_r(NULL, ", ", &save)) {
+		c = realloc(counters, (nr_counters + 1) * sizeof(*c));
+		if (!c) {
+			rc = -ENOMEM;
+			break;
+		}
+		counters = c;
+		c = &counters[nr_counters];
+		memset(c, 0, sizeof(*c));
+		n = 0;
+		if (sscanf(tok, "mta:%u:%u%n", &type, &counter, &n) == 2
+				&& !tok[n]) {
+			c->type = type;
+		} else if (sscanf(tok, "hif:%u%n", &counter, &n) == 1
+				&& !tok[n]) {
+			c->hif = true;
+		} else {
+			fprintf(stderr, "invalid event '%s'\n", tok);
+			rc = -EINVAL;
+			break;
+		}
+		c->counter = counter;
+		snprintf(c->name, sizeof(c->name), "%s", tok);
+		nr_counters++;
+	}
+	free(dup);
+	return rc;
+}
+
+static int campaign_submit(struct cxl_cmd *cmd)
+{
+	int rc = cxl_cmd_submit(cmd);
+
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	return rc;
+}
+
+static int campaign_counters_init(struct cxl_memdev *memdev)
+{
+	struct campaign_counter *c;
+	int i;
+
+	for (i = 0; i < nr_counters; i++) {
+		c = &counters[i];
+		if (c->hif) {
+			c->latch = cxl_cmd_new_perfcnt_mta_hif_cnt_val_latch(
+					memdev, c->counter);
+			c->read = cxl_cmd_new_perfcnt_mta_hif_latch_val_get(
+					memdev, c->counter);
+		} else {
+			c->latch = cxl_cmd_new_perfcnt_mta_cnt_val_latch(memdev,
+					c->type, c->counter);
+			c->read = cxl_cmd_new_perfcnt_mta_latch_val_get(memdev,
+					c->type, c->counter);
+		}
+		if (!c->latch || !c->read)
+			return -ENOMEM;
+	}
+	return 0;
+}
+
+/* latch all counters back to back, then read them, into @phase */
+static int campaign_sample_counters(struct campaign_phase *phase)
+{
+	struct campaign_counter *c;
+	unsigned long long value;
+	int i, rc;
+
+	for (i = 0; i < nr_counters; i++) {
+		rc = campaign_submit(counters[i].latch);
+		if (rc)
+			return rc;
+	}
+	for (i = 0; i < nr_counters; i++) {
+		c = &counters[i];
+		rc = campaign_submit(c->read);
+		if (rc)
+			return rc;
+		rc = c->hif
+			? cxl_cmd_perfcnt_mta_hif_latch_val_get_get_latch_val(
+					c->read, &value)
+			: cxl_cmd_perfcnt_mta_latch_val_get_get_latch_val(
+					c->read, &value);
+		if (rc)
+			return rc;
+		if (phase)
+			phase->deltas[i] += value - c->last;
+		c->last = value;
+	}
+	return 0;
+}
+
+struct campaign_event_ctx {
+	struct campaign_phase *phase;
+	int log;
+	u64 newest;
+};
+
+/*
+ * Records are left in the logs for the RAS stack under test, so count
+ * only those newer than any seen at the previous sample.
+ */
+static int campaign_count_event(struct cxl_memdev *memdev,
+		const struct cxl_event_record_info *rec, void *priv)
+{
+	struct campaign_event_ctx *ec = priv;
+
+	if (rec->timestamp <= last_event_ts[ec->log])
+		return 0;
+	ec->newest = max(ec->newest, rec->timestamp);
+	if (ec->phase)
+		ec->phase->events[ec->log]++;
+	return 0;
+}
+
+static void campaign_sample_events(struct cxl_memdev *memdev,
+		struct campaign_phase *phase)
+{
+	struct campaign_event_ctx ec = { .phase = phase };
+
+	for (ec.log = 0; ec.log < CAMPAIGN_NR_LOGS; ec.log++) {
+		ec.newest = last_event_ts[ec.log];
+		if (cxl_memdev_drain_event_records(memdev, ec.log, 0,
+					campaign_count_event, &ec) == 0)
+			last_event_ts[ec.log] = ec.newest;
+	}
+}
+
+static int campaign_inject(struct cxl_memdev *memdev, enum campaign_inj type)
+{
+	switch (type) {
+	case INJ_DRS_POISON:
+		return cxl_memdev_err_inj_drs_poison(memdev, param.ch_id,
+				param.duration, param.inj_mode, param.tag);
+	case INJ_DRS_ECC:
+		return cxl_memdev_err_inj_drs_ecc(memdev, param.ch_id,
+				param.duration, param.inj_mode, param.tag);
+	case INJ_RXFLIT_CRC:
+		return cxl_memdev_err_inj_rxflit_crc(memdev, param.mem_id);
+	case INJ_TXFLIT_CRC:
+		return cxl_memdev_err_inj_txflit_crc(memdev, param.mem_id);
+	case INJ_HIF_POISON:
+		return cxl_memdev_err_inj_hif_poison(memdev, param.ch_id,
+				param.duration, param.inj_mode, address);
+	case INJ_HIF_ECC:
+		return cxl_memdev_err_inj_hif_ecc(memdev, param.ch_id,
+				param.duration, param.inj_mode, address);
+	default:
+		return 0;
+	}
+}
+
+static void campaign_sleep_until(u64 deadline)
+{
+	struct timespec ts = {
+		.tv_sec = deadline / 1000000000ULL,
+		.tv_nsec = deadline % 1000000000ULL,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+			== EINTR && !campaign_stop)
+		;
+}
+
+/*
+ * Injections and samples run off one absolute timeline, so a slow
+ * mailbox delays the next event rather than stretching the phase.
+ */
+static int campaign_run_phase(struct cxl_memdev *memdev,
+		struct campaign_phase *p, u64 sample_ns)
+{
+	u64 start = campaign_now_ns(), end = start + p->duration_ns;
+	u64 inj_ns = p->rate > 0 ? (u64) (1e9 / p->rate) : 0;
+	u64 next_inj = start, next_sample = start + sample_ns, now;
+	int rc;
+
+	while (!campaign_stop) {
+		now = campaign_now_ns();
+		if (now >= end)
+			break;
+		if (inj_ns && now >= next_inj) {
+			rc = campaign_inject(memdev, p->type);
+			if (rc)
+				p->failed++;
+			else
+				p->injected++;
+			next_inj += inj_ns;
+			continue;
+		}
+		if (now >= next_sample) {
+			rc = campaign_sample_counters(p);
+			if (rc)
+				return rc;
+			campaign_sample_events(memdev, p);
+			next_sample += sample_ns;
+			continue;
+		}
+		now = min(end, next_sample);
+		campaign_sleep_until(inj_ns ? min(now, next_inj) : now);
+	}
+
+	rc = campaign_sample_counters(p);
+	if (rc)
+		return rc;
+	campaign_sample_events(memdev, p);
+	p->elapsed_ns = campaign_now_ns() - start;
+	return 0;
+}
+
+static double phase_rate(struct campaign_phase *p, int i)
+{
+	return p->elapsed_ns ? p->deltas[i] * 1e9 / p->elapsed_ns : 0;
+}
+
+static struct json_object *campaign_phase_to_json(struct campaign_phase *p,
+		struct campaign_phase *base)
+{
+	struct json_object *jphase, *jcounters, *jcounter, *jevents;
+	static const char * const logs[] = { "info", "warning", "failure",
+		"fatal" };
+	double rate, base_rate;
+	int i;
+
+	jphase = json_object_new_object();
+	if (!jphase)
+		return NULL;
+	json_object_object_add(jphase, "type",
+			json_object_new_string(campaign_inj_names[p->type]));
+	json_object_object_add(jphase, "rate", json_object_new_double(p->rate));
+	json_object_object_add(jphase, "duration_ms",
+			json_object_new_int64(p->elapsed_ns / 1000000));
+	json_object_object_add(jphase, "injected",
+			json_object_new_int64(p->injected));
+	if (p->failed)
+		json_object_object_add(jphase, "failed",
+				json_object_new_int64(p->failed));
+
+	jcounters = json_object_new_array();
+	for (i = 0; jcounters && i < nr_counters; i++) {
+		jcounter = json_object_new_object();
+		if (!jcounter)
+			break;
+		rate = phase_rate(p, i);
+		json_object_object_add(jcounter, "event",
+				json_object_new_string(counters[i].name));
+		json_object_object_add(jcounter, "per_s",
+				json_object_new_int64(rate));
+		if (param.bytes_per_count)
+			json_object_object_add(jcounter, "bytes_per_s",
+				json_object_new_int64(rate * param.bytes_per_count));
+		base_rate = phase_rate(base, i);
+		if (p != base && base_rate > 0)
+			json_object_object_add(jcounter, "change_pct",
+				json_object_new_double((int) ((rate - base_rate)
+						* 10000 / base_rate) / 100.0));
+		json_object_array_add(jcounters, jcounter);
+	}
+	if (jcounters)
+		json_object_object_add(jphase, "counters", jcounters);
+
+	jevents = json_object_new_object();
+	for (i = 0; jevents && i < CAMPAIGN_NR_LOGS; i++)
+		json_object_object_add(jevents, logs[i],
+				json_object_new_int64(p->events[i]));
+	if (jevents)
+		json_object_object_add(jphase, "events", jevents);
+	return jphase;
+}
+
+int cmd_inject_campaign(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_STRING('s', "schedule", &param.schedule, "schedule",
+				"<type>:<per second>:<duration>[,...]"),
+		OPT_STRING('e', "events", &param.events, "event-list",
+				"counters to sample: mta:<type>:<counter>, hif:<counter>"),
+		OPT_STRING('B', "baseline", &param.baseline, "duration",
+				"length of the baseline phase (default 10s)"),
+		OPT_STRING('I', "interval", &param.interval, "interval",
+				"counter and event log sample period (default 1s)"),
+		OPT_UINTEGER('b', "bytes-per-count", &param.bytes_per_count,
+				"bytes moved per counted event, to report bandwidth"),
+		OPT_UINTEGER('c', "ch_id", &param.ch_id, "DRS or HIF channel"),
+		OPT_UINTEGER('d', "duration", &param.duration,
+				"injection duration field"),
+		OPT_UINTEGER('i', "inj_mode", &param.inj_mode, "injection mode"),
+		OPT_UINTEGER('t', "tag", &param.tag, "DRS tag"),
+		OPT_UINTEGER('m', "cxl_mem_id", &param.mem_id,
+				"CXL.mem instance for flit CRC injection"),
+		OPT_STRING('a', "address", &param.address, "address",
+				"HIF address to inject at"),
+		OPT_FILENAME('o', "output", &param.output, "output-file",
+				"write the report to this file instead of stdout"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl inject-campaign <mem0> -s <schedule> [<options>]",
+		NULL
+	};
+	struct sigaction sa = { .sa_handler = campaign_stop_handler };
+	struct cxl_memdev *memdev, *target = NULL;
+	struct json_object *jreport, *jphases;
+	struct campaign_phase *p;
+	u64 sample_ns, baseline_ns;
+	FILE *out = stdout;
+	int i, rc;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc != 1 || !param.schedule)
+		usage_with_options(u, options);
+	if (campaign_parse_time(param.interval, &sample_ns)
+			|| campaign_parse_time(param.baseline, &baseline_ns)) {
+		fprintf(stderr, "invalid --interval or --baseline\n");
+		return EXIT_FAILURE;
+	}
+	if (param.address) {
+		errno = 0;
+		address = strtoull(param.address, NULL, 0);
+		if (errno) {
+			fprintf(stderr, "invalid --address '%s'\n", param.address);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* phase 0 is the baseline, the schedule follows */
+	p = campaign_add_phase();
+	if (!p)
+		return EXIT_FAILURE;
+	p->duration_ns = baseline_ns;
+	rc = campaign_parse_schedule(param.schedule);
+	if (rc == 0 && param.events)
+		rc = campaign_parse_events(param.events);
+	if (rc)
+		goto out;
+	for (i = 0; i < nr_phases; i++) {
+		phases[i].deltas = calloc(max(nr_counters, 1),
+				sizeof(*phases[i].deltas));
+		if (!phases[i].deltas) {
+			rc = -ENOMEM;
+			goto out;
+		}
+	}
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	cxl_memdev_foreach(ctx, memdev)
+		if (util_cxl_memdev_filter(memdev, argv[0])) {
+			target = memdev;
+			break;
+		}
+	if (!target) {
+		fprintf(stderr, "%s: no such memdev\n", argv[0]);
+		rc = -ENODEV;
+		goto out;
+	}
+
+	rc = campaign_counters_init(target);
+	if (rc == 0)
+		rc = campaign_sample_counters(NULL);
+	if (rc) {
+		fprintf(stderr, "%s: failed to read counters: %s\n",
+				cxl_memdev_get_devname(target), strerror(-rc));
+		goto out;
+	}
+	campaign_sample_events(target, NULL);
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	for (i = 0; i < nr_phases && !campaign_stop; i++) {
+		if (param.verbose)
+			fprintf(stderr, "%s: phase %d: %s at %g/s\n",
+					cxl_memdev_get_devname(target), i,
+					campaign_inj_names[phases[i].type],
+					phases[i].rate);
+		rc = campaign_run_phase(target, &phases[i], sample_ns);
+		if (rc) {
+			fprintf(stderr, "%s: phase %d: sample failed: %s\n",
+					cxl_memdev_get_devname(target), i,
+					strerror(-rc));
+			break;
+		}
+	}
+
+	if (param.output) {
+		out = fopen(param.output, "w");
+		if (!out) {
+			fprintf(stderr, "failed to open %s: %s\n", param.output,
+					strerror(errno));
+			out = stdout;
+		}
+	}
+	jreport = json_object_new_object();
+	jphases = json_object_new_array();
+	if (jreport && jphases) {
+		json_object_object_add(jreport, "memdev", json_object_new_string(
+					cxl_memdev_get_devname(target)));
+		for (p = phases; p < phases + i; p++)
+			json_object_array_add(jphases,
+					campaign_phase_to_json(p, &phases[0]));
+		json_object_object_add(jreport, "phases", jphases);
+		fprintf(out, "%s\n", json_object_to_json_string_ext(jreport,
+					JSON_C_TO_STRING_PRETTY));
+	} else
+		json_object_put(jphases);
+	json_object_put(jreport);
+	if (out != stdout)
+		fclose(out);
+out:
+	for (i = 0; i < nr_counters; i++) {
+		cxl_cmd_unref(counters[i].latch);
+		cxl_cmd_unref(counters[i].read);
+	}
+	for (i = 0; i < nr_phases; i++)
+		free(phases[i].deltas);
+	free(counters);
+	free(phases);
+	return rc ? EXIT_FAILURE : 0;
+}
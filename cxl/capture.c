@@ -0,0 +1,492 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+#include <cxl/capture.h>
+
+/* reuse the core log helpers for the watcher's notifications */
+#ifndef ENABLE_LOGGING
+#define ENABLE_LOGGING
+#endif
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include <util/log.h>
+#include <util/monitor.h>
+
+/*
+ * 'cxl capture-watch': arm an HCT or OSA capture whose buffer and
+ * trigger conditions were set up beforehand (hct-set-config,
+ * osa-cap-ctrl, osa-*-trig-cfg), then sample one counter every
+ * --interval. When it crosses the threshold the capture is triggered,
+ * the stopped buffer is drained into a new file under --output, and
+ * the capture is armed again until --count captures have been taken.
+ */
+enum watch_source {
+	WATCH_MTA,
+	WATCH_HIF,
+	WATCH_TEMPERATURE,
+	WATCH_THROTTLED,
+};
+
+struct watch_sampler {
+	enum watch_source source;
+	unsigned int type, counter;
+	struct cxl_cmd *latch;
+	struct cxl_cmd *read;
+	unsigned long long last;
+	u64 last_ns;
+};
+
+static struct {
+	const char *capture;
+	const char *watch;
+	const char *above;
+	const char *below;
+	const char *output;
+	const char *log;
+	unsigned int interval;
+	unsigned int count;
+	unsigned int holdoff;
+	unsigned int post_trigger;
+	unsigned int hct_inst;
+	unsigned int arm_control;
+	unsigned int fire_control;
+	unsigned int cxl_mem_id;
+	unsigned int lane_mask;
+	unsigned int lane_dir_mask;
+	unsigned int arm_op;
+	unsigned int fire_op;
+	bool osa;
+	bool daemon;
+	bool verbose;
+	double threshold;
+	struct log_ctx ctx;
+} watch = {
+	.capture = "hct",
+	.output = ".",
+	.interval = 100,
+	.count = 1,
+	.holdoff = 10,
+	.post_trigger = 100,
+	.arm_control = 1,
+	.fire_control = 2,
+	.lane_mask = 0xffff,
+	.lane_dir_mask = 0x3,
+	.arm_op = 1,
+	.fire_op = 2,
+};
+
+static volatile sig_atomic_t watch_stop;
+
+static void watch_stop_handler(int sig)
+{
+	watch_stop = 1;
+}
+
+static u64 watch_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* sleep for @ms, cut short by a stop request */
+static void watch_sleep_ms(unsigned int ms)
+{
+	u64 deadline = watch_now_ns() + ms * 1000000ULL;
+	struct timespec next = {
+		.tv_sec = deadline / 1000000000ULL,
+		.tv_nsec = deadline % 1000000000ULL,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL)
+			== EINTR && !watch_stop)
+		;
+}
+
+/* same names as 'cxl perf stat' rows: mta:<type>:<n>, hif:<n>, ... */
+static int watch_parse_source(const char *str, struct watch_sampler *s)
+{
+	int n = 0;
+
+	memset(s, 0, sizeof(*s));
+	if (sscanf(str, "mta:%u:%u%n", &s->type, &s->counter, &n) == 2
+			&& !str[n])
+		s->source = WATCH_MTA;
+	else if (sscanf(str, "hif:%u%n", &s->counter, &n) == 1 && !str[n])
+		s->source = WATCH_HIF;
+	else if (strcmp(str, "temperature") == 0)
+		s->source = WATCH_TEMPERATURE;
+	else if (strcmp(str, "throttled") == 0)
+		s->source = WATCH_THROTTLED;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+static int watch_sampler_init(struct watch_sampler *s,
+		struct cxl_memdev *memdev)
+{
+	switch (s->source) {
+	case WATCH_MTA:
+		s->latch = cxl_cmd_new_perfcnt_mta_cnt_val_latch(memdev,
+				s->type, s->counter);
+		s->read = cxl_cmd_new_perfcnt_mta_latch_val_get(memdev,
+				s->type, s->counter);
+		break;
+	case WATCH_HIF:
+		s->latch = cxl_cmd_new_perfcnt_mta_hif_cnt_val_latch(memdev,
+				s->counter);
+		s->read = cxl_cmd_new_perfcnt_mta_hif_latch_val_get(memdev,
+				s->counter);
+		break;
+	case WATCH_TEMPERATURE:
+		s->read = cxl_cmd_new_get_health_info(memdev);
+		break;
+	case WATCH_THROTTLED:
+		s->read = cxl_cmd_new_health_counters_get(memdev);
+		break;
+	}
+	if (!s->read || ((s->source == WATCH_MTA || s->source == WATCH_HIF)
+				&& !s->latch))
+		return -ENOMEM;
+	return 0;
+}
+
+static void watch_sampler_free(struct watch_sampler *s)
+{
+	cxl_cmd_unref(s->latch);
+	cxl_cmd_unref(s->read);
+}
+
+static int watch_submit(struct cxl_cmd *cmd)
+{
+	int rc = cxl_cmd_submit(cmd);
+
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	return rc;
+}
+
+/*
+ * Counters are compared as their change per second, the temperature
+ * as read. Returns 1 with @val set, 0 for the sample that only primes
+ * a counter's baseline, or a negative error.
+ */
+static int watch_sample(struct watch_sampler *s, double *val)
+{
+	unsigned long long value;
+	long long throttled;
+	u64 now, last_ns;
+	int rc;
+
+	if (s->latch) {
+		rc = watch_submit(s->latch);
+		if (rc)
+			return rc;
+	}
+	rc = watch_submit(s->read);
+	if (rc)
+		return rc;
+	now = watch_now_ns();
+
+	switch (s->source) {
+	case WATCH_TEMPERATURE:
+		*val = cxl_cmd_get_health_info_get_temperature(s->read);
+		return 1;
+	case WATCH_MTA:
+		rc = cxl_cmd_perfcnt_mta_latch_val_get_get_latch_val(s->read,
+				&value);
+		break;
+	case WATCH_HIF:
+		rc = cxl_cmd_perfcnt_mta_hif_latch_val_get_get_latch_val(
+				s->read, &value);
+		break;
+	default:
+		throttled = cxl_cmd_health_counters_get_get_time_in_throttled(
+				s->read);
+		rc = throttled < 0 ? throttled : 0;
+		value = throttled;
+		break;
+	}
+	if (rc)
+		return rc;
+
+	last_ns = s->last_ns;
+	if (last_ns)
+		*val = (value - s->last) / ((now - last_ns) / 1e9);
+	s->last = value;
+	s->last_ns = now;
+	return last_ns ? 1 : 0;
+}
+
+static bool watch_crossed(double val)
+{
+	if (watch.above)
+		return val > watch.threshold;
+	return val < watch.threshold;
+}
+
+static int watch_arm(struct cxl_memdev *memdev)
+{
+	int rc;
+
+	if (watch.osa)
+		return cxl_memdev_osa_ana_op(memdev, watch.cxl_mem_id,
+				watch.arm_op);
+	rc = cxl_memdev_hct_enable(memdev, watch.hct_inst);
+	if (rc == 0)
+		rc = cxl_memdev_hct_start_stop_trigger(memdev, watch.hct_inst,
+				watch.arm_control);
+	return rc;
+}
+
+static int watch_fire(struct cxl_memdev *memdev)
+{
+	if (watch.osa)
+		return cxl_memdev_osa_ana_op(memdev, watch.cxl_mem_id,
+				watch.fire_op);
+	return cxl_memdev_hct_start_stop_trigger(memdev, watch.hct_inst,
+			watch.fire_control);
+}
+
+static int watch_drain(struct cxl_memdev *memdev, char *path, size_t len)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct timespec ts;
+	struct tm tm;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	gmtime_r(&ts.tv_sec, &tm);
+	snprintf(path, len, "%s/%s-%s-%04d%02d%02dT%02d%02d%02d.%03ldZ.bin",
+			watch.output, devname, watch.capture,
+			tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+			tm.tm_hour, tm.tm_min, tm.tm_sec,
+			ts.tv_nsec / 1000000);
+
+	if (watch.osa)
+		return osa_capture_drain(memdev, watch.cxl_mem_id,
+				watch.lane_mask, watch.lane_dir_mask, path);
+	return hct_capture_drain(memdev, watch.hct_inst, path);
+}
+
+static int watch_loop(struct cxl_memdev *memdev, struct watch_sampler *s)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	unsigned int taken = 0;
+	char path[PATH_MAX];
+	u64 deadline;
+	double val;
+	int rc;
+
+	rc = watch_arm(memdev);
+	if (rc) {
+		err(&watch, "%s: failed to arm the %s capture: %s\n", devname,
+				watch.capture, strerror(-rc));
+		return rc;
+	}
+	info(&watch, "%s: %s capture armed, watching %s\n", devname,
+			watch.capture, watch.watch);
+
+	deadline = watch_now_ns();
+	while (!watch_stop && (!watch.count || taken < watch.count)) {
+		struct timespec next;
+
+		deadline += watch.interval * 1000000ULL;
+		next.tv_sec = deadline / 1000000000ULL;
+		next.tv_nsec = deadline % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+					NULL) == EINTR && !watch_stop)
+			;
+		if (watch_stop)
+			break;
+
+		rc = watch_sample(s, &val);
+		if (rc < 0) {
+			err(&watch, "%s: %s sample failed: %s\n", devname,
+					watch.watch, strerror(-rc));
+			return rc;
+		}
+		if (rc == 0 || !watch_crossed(val))
+			continue;
+
+		notice(&watch, "%s: %s at %g crossed %s %g, triggering\n",
+				devname, watch.watch, val,
+				watch.above ? "above" : "below",
+				watch.threshold);
+		rc = watch_fire(memdev);
+		if (rc) {
+			err(&watch, "%s: trigger failed: %s\n", devname,
+					strerror(-rc));
+			return rc;
+		}
+		/* let the post-trigger part of the buffer fill */
+		watch_sleep_ms(watch.post_trigger);
+
+		rc = watch_drain(memdev, path, sizeof(path));
+		if (rc) {
+			err(&watch, "%s: drain to %s failed: %s\n", devname,
+					path, strerror(-rc));
+			return rc;
+		}
+		notice(&watch, "%s: captured to %s\n", devname, path);
+		if (watch.count && ++taken >= watch.count)
+			break;
+
+		/* a burst of crossings yields one capture, not dozens */
+		watch_sleep_ms(watch.holdoff * 1000);
+		if (watch_stop)
+			break;
+		rc = watch_arm(memdev);
+		if (rc) {
+			err(&watch, "%s: failed to re-arm: %s\n", devname,
+					strerror(-rc));
+			return rc;
+		}
+		s->last_ns = 0;
+		deadline = watch_now_ns();
+	}
+	return 0;
+}
+
+static int watch_parse_threshold(void)
+{
+	const char *str = watch.above ? watch.above : watch.below;
+	char *end;
+
+	if (!str || (watch.above && watch.below))
+		return -EINVAL;
+	errno = 0;
+	watch.threshold = strtod(str, &end);
+	if (errno || end == str || *end)
+		return -EINVAL;
+	return 0;
+}
+
+int cmd_capture_watch(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_STRING('C', "capture", &watch.capture, "hct|osa",
+				"capture to arm and trigger (default hct)"),
+		OPT_STRING('w', "watch", &watch.watch, "counter",
+				"mta:<type>:<n>, hif:<n>, temperature or throttled"),
+		OPT_STRING('a', "above", &watch.above, "value",
+				"trigger when the counter's rate goes above <value>"),
+		OPT_STRING('b', "below", &watch.below, "value",
+				"trigger when the counter's rate drops below <value>"),
+		OPT_FILENAME('o', "output", &watch.output, "dir",
+				"directory for the captures (default .)"),
+		OPT_UINTEGER('I', "interval", &watch.interval,
+				"milliseconds between samples (default 100)"),
+		OPT_UINTEGER('c', "count", &watch.count,
+				"captures to take before exiting, 0 for no limit (default 1)"),
+		OPT_UINTEGER('H', "holdoff", &watch.holdoff,
+				"seconds before re-arming after a capture (default 10)"),
+		OPT_UINTEGER('p', "post-trigger", &watch.post_trigger,
+				"milliseconds between trigger and drain (default 100)"),
+		OPT_UINTEGER('i', "hct_inst", &watch.hct_inst, "HCT Instance"),
+		OPT_UINTEGER('\0', "arm-control", &watch.arm_control,
+				"hct buffer control that arms the capture (default 1)"),
+		OPT_UINTEGER('\0', "fire-control", &watch.fire_control,
+				"hct buffer control that triggers it (default 2)"),
+		OPT_UINTEGER('\0', "cxl_mem_id", &watch.cxl_mem_id, "CXL.MEM ID"),
+		OPT_UINTEGER('l', "lane_mask", &watch.lane_mask,
+				"osa lanes to drain (default 0xffff)"),
+		OPT_UINTEGER('m', "lane_dir_mask", &watch.lane_dir_mask,
+				"osa lane directions to drain (default 0x3)"),
+		OPT_UINTEGER('\0', "arm-op", &watch.arm_op,
+				"osa analyzer op that arms the capture (default 1)"),
+		OPT_UINTEGER('\0', "fire-op", &watch.fire_op,
+				"osa analyzer op that triggers it (default 2)"),
+		OPT_FILENAME('L', "log", &watch.log,
+				"<file> | syslog | standard",
+				"where to log notifications (default standard)"),
+		OPT_BOOLEAN('\0', "daemon", &watch.daemon,
+				"run in the background"),
+		OPT_BOOLEAN('v', "verbose", &watch.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl capture-watch <mem0> -w <counter> {-a|-b} <value> [<options>]",
+		NULL
+	};
+	struct sigaction sa = { .sa_handler = watch_stop_handler };
+	struct cxl_memdev *memdev, *found = NULL;
+	struct watch_sampler s = { 0 };
+	const char *prefix = "./";
+	int rc;
+
+	argc = parse_options_prefix(argc, argv, prefix, options, u, 0);
+	if (argc != 1 || !watch.watch)
+		usage_with_options(u, options);
+	if (watch_parse_source(watch.watch, &s) < 0) {
+		fprintf(stderr, "unknown counter: %s\n", watch.watch);
+		return EXIT_FAILURE;
+	}
+	if (watch_parse_threshold() < 0) {
+		fprintf(stderr, "specify one of --above or --below with a number\n");
+		usage_with_options(u, options);
+	}
+	if (strcmp(watch.capture, "osa") == 0)
+		watch.osa = true;
+	else if (strcmp(watch.capture, "hct") != 0) {
+		fprintf(stderr, "unknown capture: %s\n", watch.capture);
+		return EXIT_FAILURE;
+	}
+	if (!watch.interval)
+		watch.interval = 100;
+
+	log_init(&watch.ctx, "cxl/capture-watch", "CXL_CAPTURE_WATCH_LOG");
+	watch.ctx.log_fn = util_monitor_log_standard;
+	watch.ctx.log_priority = watch.verbose ? LOG_DEBUG : LOG_INFO;
+	if (watch.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+	if (watch.log) {
+		rc = util_monitor_set_log(&watch.ctx, &watch.log, prefix);
+		if (rc)
+			return EXIT_FAILURE;
+	}
+
+	cxl_memdev_foreach(ctx, memdev)
+		if (util_cxl_memdev_filter(memdev, argv[0])) {
+			found = memdev;
+			break;
+		}
+	if (!found) {
+		fprintf(stderr, "%s: no such memdev\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rc = watch_sampler_init(&s, found);
+	if (rc)
+		goto out;
+
+	if (watch.daemon) {
+		if (!watch.log || strncmp(watch.log, "./", 2) == 0)
+			watch.ctx.log_fn = util_monitor_log_syslog;
+		if (daemon(1, 0) != 0) {
+			err(&watch, "daemon start failed\n");
+			rc = -errno;
+			goto out;
+		}
+	}
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	rc = watch_loop(found, &s);
+out:
+	watch_sampler_free(&s);
+	util_monitor_close_log();
+	return rc ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _CXL_CAPTURE_H_
+#define _CXL_CAPTURE_H_
+#include <ccan/short_types/short_types.h>
+
+struct cxl_memdev;
+
+/*
+ * Read out a trace or analyzer buffer that has already stopped, into
+ * a new file at @path in the format 'cxl hct-stream' and 'cxl
+ * osa-capture' write, so 'cxl hct-decode' and osa readers take either.
+ */
+int hct_capture_drain(struct cxl_memdev *memdev, u8 hct_inst,
+		const char *path);
+int osa_capture_drain(struct cxl_memdev *memdev, u8 cxl_mem_id, u16 lane_mask,
+		u8 lane_dir_mask, const char *path);
+#endif /* _CXL_CAPTURE_H_ */
@@ -21,9 +21,11 @@
 #include <util/strbuf.h>
 #include <util/util.h>
 #include <util/main.h>
+#include <util/daemon.h>
+#include <util/pool.h>
 #include <cxl/builtin.h>
 
-const char cxl_usage_string[] = "cxl [--version] [--help] COMMAND [ARGS]";
+const char cxl_usage_string[] = "cxl [--version] [--help] [-j <n>] COMMAND [ARGS]";
 const char cxl_more_info_string[] =
 	"See 'cxl help COMMAND' for more information on a specific command.\n"
 	" cxl --list-cmds to see all available commands";
@@ -67,6 +69,25 @@ static struct cmd_struct commands[] = {
 	{ "device-info-get", .c_fn = cmd_device_info_get },
 	{ "version", .c_fn = cmd_version },
 	{ "list", .c_fn = cmd_list },
+	{ "stats", .c_fn = cmd_stats },
+	{ "monitor", .c_fn = cmd_monitor },
+	{ "daemon", .c_fn = cmd_daemon },
+	{ "hct-stream", .c_fn = cmd_hct_stream },
+	{ "hct-decode", .c_fn = cmd_hct_decode },
+	{ "capture-watch", .c_fn = cmd_capture_watch },
+	{ "perf", .c_fn = cmd_perf },
+	{ "fbist-bench", .c_fn = cmd_fbist_bench },
+	{ "eye-sweep", .c_fn = cmd_eye_sweep },
+	{ "link-dbg-dump", .c_fn = cmd_link_dbg_dump },
+	{ "sync-timestamp", .c_fn = cmd_sync_timestamp },
+	{ "mbox-trace", .c_fn = cmd_mbox_trace },
+	{ "list-poison", .c_fn = cmd_list_poison },
+	{ "scan-media", .c_fn = cmd_scan_media },
+	{ "monitor-qos", .c_fn = cmd_monitor_qos },
+	{ "ld-alloc", .c_fn = cmd_ld_alloc },
+	{ "create-region", .c_fn = cmd_create_region },
+	{ "inject-campaign", .c_fn = cmd_inject_campaign },
+	{ "apply-alert-policy", .c_fn = cmd_apply_alert_policy },
 	{ "help", .c_fn = cmd_help },
 	{ "zero-labels", .c_fn = cmd_zero_labels },
 	{ "read-labels", .c_fn = cmd_read_labels },
@@ -97,6 +118,7 @@ static struct cmd_struct commands[] = {
 	{ "ltmon-watch", .c_fn = cmd_ltmon_watch },
 	{ "ltmon-capture-stat", .c_fn = cmd_ltmon_capture_stat },
 	{ "ltmon-capture-log-dmp", .c_fn = cmd_ltmon_capture_log_dmp },
+	{ "ltmon-record", .c_fn = cmd_ltmon_record },
 	{ "ltmon-capture-trigger", .c_fn = cmd_ltmon_capture_trigger },
 	{ "ltmon-enable", .c_fn = cmd_ltmon_enable },
 	{ "osa-os-type-trig-cfg", .c_fn = cmd_osa_os_type_trig_cfg },
@@ -169,12 +191,27 @@ static struct cmd_struct commands[] = {
 	{ "osa-os-patt-trig-cfg", .c_fn = cmd_osa_os_patt_trig_cfg },
 	{ "osa-misc-trig-cfg", .c_fn = cmd_osa_misc_trig_cfg },
 	{ "osa-data-read", .c_fn = cmd_osa_data_read },
+	{ "osa-capture", .c_fn = cmd_osa_capture },
 	{ "dimm-spd-read", .c_fn = cmd_dimm_spd_read },
 	{ "ddr-training-status", .c_fn = cmd_ddr_training_status },
+	{ "ddr-summary", .c_fn = cmd_ddr_summary },
 	{ "dimm-slot-info", .c_fn = cmd_dimm_slot_info },
 	{ "pmic-vtmon-info", .c_fn = cmd_pmic_vtmon_info },
 };
 
+/* run a builtin in-process, for wrappers like 'cxl stats' */
+int cxl_run_builtin(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(commands); i++)
+		if (!strcmp(commands[i].cmd, argv[0]))
+			return commands[i].c_fn(argc, argv, ctx);
+
+	fprintf(stderr, "Unknown command: '%s'\n", argv[0]);
+	return -EINVAL;
+}
+
 int main(int argc, const char **argv)
 {
 	struct cxl_ctx *ctx;
@@ -196,9 +233,14 @@ int main(int argc, const char **argv)
 		goto out;
 	}
 
+	/* a resident daemon answers this without enumerating */
+	main_handle_daemon_command(argc, argv, PROG_CXL);
+
 	rc = cxl_new(&ctx);
 	if (rc)
 		goto out;
+	/* the top level -j bounds the library's threads too */
+	cxl_set_max_threads(ctx, util_pool_max_jobs);
 	main_handle_internal_command(argc, argv, ctx, commands,
 			ARRAY_SIZE(commands), PROG_CXL);
 	cxl_unref(ctx);
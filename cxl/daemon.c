@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cxl/libcxl.h>
+#include <util/parse-options.h>
+#include <ccan/array_size/array_size.h>
+
+#include <util/daemon.h>
+#include "builtin.h"
+
+static const char * const subsystems[] = { "cxl", "dax", NULL };
+
+static struct cmd_struct served_cmds[] = {
+	{ "list", .c_fn = cmd_list },
+};
+
+static void *daemon_refresh(struct util_daemon *d)
+{
+	struct cxl_ctx *old = d->ctx, *ctx;
+
+	if (cxl_new(&ctx) != 0) {
+		log_err(&d->log, "failed to re-create the context\n");
+		return NULL;
+	}
+	cxl_set_log_priority(ctx, cxl_get_log_priority(old));
+	cxl_unref(old);
+	return ctx;
+}
+
+static void daemon_warm(struct util_daemon *d)
+{
+	struct cxl_memdev *memdev;
+	struct cxl_port *port;
+
+	cxl_memdev_foreach(d->ctx, memdev)
+		cxl_memdev_get_endpoint(memdev);
+	cxl_port_foreach(d->ctx, port)
+		cxl_decoder_get_first(port);
+}
+
+int cmd_daemon(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const char *log = NULL;
+	bool background = false, verbose = false;
+	struct util_daemon d = {
+		.prog = PROG_CXL,
+		.subsystems = subsystems,
+		.refresh = daemon_refresh,
+		.warm = daemon_warm,
+		.cmds = served_cmds,
+		.num_cmds = ARRAY_SIZE(served_cmds),
+	};
+	const struct option options[] = {
+		OPT_STRING('s', "socket", &d.socket, "path",
+			"listen on <path> (default " UTIL_DAEMON_DIR "/cxl.sock)"),
+		OPT_FILENAME('l', "log", &log,
+			"<file> | syslog | standard",
+			"where to log (default standard)"),
+		OPT_BOOLEAN('\0', "daemon", &background,
+			"run cxl daemon in the background"),
+		OPT_BOOLEAN('v', "verbose", &verbose, "log every query"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl daemon [<options>]",
+		NULL
+	};
+	const char *prefix = "./";
+	int i, rc;
+
+	argc = parse_options_prefix(argc, argv, prefix, options, u, 0);
+	for (i = 0; i < argc; i++)
+		error("unknown parameter \"%s\"\n", argv[i]);
+	if (argc)
+		usage_with_options(u, options);
+
+	rc = util_daemon_start(&d, "cxl/daemon", log, prefix, background,
+			verbose);
+	if (rc)
+		return rc;
+
+	/* main() keeps its reference, refreshes drop only ours */
+	d.ctx = cxl_ref(ctx);
+	rc = util_daemon_serve(&d);
+	cxl_unref(d.ctx);
+	return rc;
+}
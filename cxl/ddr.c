@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <json-c/json.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+/*
+ * 'cxl ddr-summary' builds one record per DDR channel from three
+ * commands that otherwise take a round trip each: DIMM slot info says
+ * which channels exist and what sits in them, DDR info reports each
+ * controller's MSTR register, and the training status log is carried
+ * along on request. All memdevs' slot info (and training logs) go out
+ * in one command batch, then all their channels' DDR info in a second,
+ * so the whole view costs two batches.
+ */
+static struct {
+	bool training;
+	bool verbose;
+} param;
+
+/* MSTR fields of the DesignWare controller behind DDR info */
+#define DDR_MSTR_BUS_WIDTH(m) (((m) >> 12) & 0x3)
+#define DDR_MSTR_ACTIVE_RANKS(m) (((m) >> 24) & 0xf)
+
+static const char * const ddr_bus_width_names[] = {
+	"full", "half", "quarter", "reserved",
+};
+
+static const char * const ddr_dram_width_names[] = {
+	"x4", "x8", "x16", "x32",
+};
+
+struct ddr_channel {
+	int id;
+	int cmd;
+};
+
+struct ddr_memdev {
+	struct cxl_memdev *memdev;
+	int slot_cmd;
+	int training_cmd;
+	struct ddr_channel channels[CXL_DIMM_SLOT_MAX];
+	int nr_channels;
+};
+
+static struct cxl_cmd *ddr_batch_cmd(struct cxl_cmd_batch *batch, int idx)
+{
+	struct cxl_cmd *cmd;
+
+	if (idx < 0 || cxl_cmd_batch_get_result(batch, idx) < 0)
+		return NULL;
+	cmd = cxl_cmd_batch_get_cmd(batch, idx);
+	if (cxl_cmd_get_mbox_status(cmd))
+		return NULL;
+	return cmd;
+}
+
+static int ddr_batch_add(struct cxl_cmd_batch *batch, struct cxl_cmd *cmd)
+{
+	int idx;
+
+	if (!cmd)
+		return -ENOMEM;
+	idx = cxl_cmd_batch_add(batch, cmd);
+	cxl_cmd_unref(cmd);
+	return idx;
+}
+
+static void ddr_add_channels(struct ddr_memdev *d, struct cxl_cmd *cmd)
+{
+	struct cxl_dimm_slot slot;
+	int i, j, nr;
+
+	nr = cxl_cmd_dimm_slot_info_get_nr_slots(cmd);
+	for (i = 0; i < nr; i++) {
+		if (cxl_cmd_dimm_slot_info_get_slot(cmd, i, &slot) < 0)
+			continue;
+		for (j = 0; j < d->nr_channels; j++)
+			if (d->channels[j].id == slot.channel)
+				break;
+		if (j < d->nr_channels)
+			continue;
+		d->channels[d->nr_channels].id = slot.channel;
+		d->channels[d->nr_channels].cmd = -1;
+		d->nr_channels++;
+	}
+}
+
+static struct json_object *ddr_training_to_json(struct cxl_cmd *cmd)
+{
+	struct json_object *jobj;
+	const u8 *data;
+	char *hex;
+	int i, len;
+
+	len = cxl_cmd_ddr_training_status_get_data(cmd, &data);
+	if (len < 0)
+		return NULL;
+	hex = malloc(len * 2 + 1);
+	if (!hex)
+		return NULL;
+	for (i = 0; i < len; i++)
+		sprintf(&hex[i * 2], "%02x", data[i]);
+	hex[len * 2] = '\0';
+	jobj = json_object_new_string(hex);
+	free(hex);
+	return jobj;
+}
+
+static struct json_object *ddr_channel_to_json(struct ddr_memdev *d,
+		struct ddr_channel *ch, struct cxl_cmd *slots,
+		struct cxl_cmd *info, struct json_object *jtraining)
+{
+	struct json_object *jobj, *jdimms, *jdimm;
+	struct cxl_dimm_slot slot;
+	unsigned int mstr;
+	int i, width, bus;
+	char silk[2];
+
+	jobj = json_object_new_object();
+	if (!jobj)
+		return NULL;
+	json_object_object_add(jobj, "memdev",
+		json_object_new_string(cxl_memdev_get_devname(d->memdev)));
+	json_object_object_add(jobj, "channel", json_object_new_int(ch->id));
+
+	jdimms = json_object_new_array();
+	if (jdimms) {
+		for (i = 0; i < cxl_cmd_dimm_slot_info_get_nr_slots(slots); i++) {
+			if (cxl_cmd_dimm_slot_info_get_slot(slots, i, &slot) < 0
+					|| slot.channel != ch->id)
+				continue;
+			jdimm = json_object_new_object();
+			if (!jdimm)
+				break;
+			silk[0] = slot.silk_screen;
+			silk[1] = '\0';
+			json_object_object_add(jdimm, "slot",
+					json_object_new_int(i));
+			json_object_object_add(jdimm, "silk_screen",
+					json_object_new_string(silk));
+			json_object_object_add(jdimm, "spd_addr",
+					util_json_object_hex(slot.spd_addr, 0));
+			json_object_object_add(jdimm, "present",
+					json_object_new_boolean(slot.present));
+			json_object_array_add(jdimms, jdimm);
+		}
+		json_object_object_add(jobj, "dimms", jdimms);
+	}
+
+	if (!info) {
+		json_object_object_add(jobj, "error",
+				json_object_new_string("ddr-info failed"));
+	} else {
+		mstr = cxl_cmd_ddr_info_get_mstr(info);
+		bus = DDR_MSTR_BUS_WIDTH(mstr);
+		width = cxl_cmd_ddr_info_get_dram_width(info);
+		json_object_object_add(jobj, "mstr",
+				util_json_object_hex(mstr, 0));
+		json_object_object_add(jobj, "bus_width",
+				json_object_new_string(ddr_bus_width_names[bus]));
+		json_object_object_add(jobj, "active_ranks",
+			json_object_new_int(__builtin_popcount(
+					DDR_MSTR_ACTIVE_RANKS(mstr))));
+		if (width >= 0 && width < 4)
+			json_object_object_add(jobj, "dram_width",
+				json_object_new_string(
+					ddr_dram_width_names[width]));
+		/* a narrowed bus gives up half the channel's bandwidth or more */
+		json_object_object_add(jobj, "degraded",
+				json_object_new_boolean(bus != 0));
+	}
+
+	if (jtraining)
+		json_object_object_add(jobj, "training_status",
+				json_object_get(jtraining));
+	return jobj;
+}
+
+int cmd_ddr_summary(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_BOOLEAN('t', "training", &param.training,
+				"include the raw DDR training status log"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl ddr-summary <mem0> [<mem1>..<memN>] [<options>]",
+		NULL
+	};
+	struct cxl_cmd_batch *batch = NULL, *info_batch = NULL;
+	struct json_object *jchannels = NULL, *jobj, *jtraining;
+	struct ddr_memdev *devs = NULL, *d;
+	struct cxl_cmd *slots, *cmd;
+	struct cxl_memdev *memdev;
+	int i, j, nr = 0, rc = EXIT_FAILURE;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1)
+		usage_with_options(u, options);
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	for (i = 0; i < argc; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, argv[i]))
+				continue;
+			for (j = 0; j < nr; j++)
+				if (devs[j].memdev == memdev)
+					break;
+			if (j < nr)
+				continue;
+			d = realloc(devs, (nr + 1) * sizeof(*d));
+			if (!d)
+				goto out;
+			devs = d;
+			d = &devs[nr++];
+			memset(d, 0, sizeof(*d));
+			d->memdev = memdev;
+		}
+	if (!nr) {
+		fprintf(stderr, "no memdevs matched\n");
+		goto out;
+	}
+
+	batch = cxl_cmd_batch_new(ctx);
+	info_batch = cxl_cmd_batch_new(ctx);
+	jchannels = json_object_new_array();
+	if (!batch || !info_batch || !jchannels)
+		goto out;
+
+	for (i = 0; i < nr; i++) {
+		d = &devs[i];
+		d->slot_cmd = ddr_batch_add(batch,
+				cxl_cmd_new_dimm_slot_info(d->memdev));
+		d->training_cmd = -1;
+		if (param.training)
+			d->training_cmd = ddr_batch_add(batch,
+				cxl_cmd_new_ddr_training_status(d->memdev));
+	}
+	cxl_cmd_batch_submit(batch);
+
+	for (i = 0; i < nr; i++) {
+		d = &devs[i];
+		slots = ddr_batch_cmd(batch, d->slot_cmd);
+		if (!slots) {
+			fprintf(stderr, "%s: dimm-slot-info failed\n",
+					cxl_memdev_get_devname(d->memdev));
+			continue;
+		}
+		ddr_add_channels(d, slots);
+		for (j = 0; j < d->nr_channels; j++)
+			d->channels[j].cmd = ddr_batch_add(info_batch,
+				cxl_cmd_new_ddr_info(d->memdev,
+					d->channels[j].id));
+	}
+	cxl_cmd_batch_submit(info_batch);
+
+	rc = 0;
+	for (i = 0; i < nr; i++) {
+		d = &devs[i];
+		slots = ddr_batch_cmd(batch, d->slot_cmd);
+		if (!slots) {
+			rc = EXIT_FAILURE;
+			continue;
+		}
+		jtraining = NULL;
+		cmd = ddr_batch_cmd(batch, d->training_cmd);
+		if (cmd)
+			jtraining = ddr_training_to_json(cmd);
+		for (j = 0; j < d->nr_channels; j++) {
+			cmd = ddr_batch_cmd(info_batch, d->channels[j].cmd);
+			if (!cmd)
+				rc = EXIT_FAILURE;
+			jobj = ddr_channel_to_json(d, &d->channels[j], slots,
+					cmd, jtraining);
+			if (jobj)
+				json_object_array_add(jchannels, jobj);
+		}
+		json_object_put(jtraining);
+	}
+	util_display_json_array(stdout, jchannels, 0);
+	jchannels = NULL;
+out:
+	json_object_put(jchannels);
+	cxl_cmd_batch_free(info_batch);
+	cxl_cmd_batch_free(batch);
+	free(devs);
+	return rc;
+}
@@ -0,0 +1,381 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/types.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <ccan/endian/endian.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+/*
+ * eye-sweep matrix file: a struct eye_file_header followed by
+ * @nr_records lanes, each a struct eye_lane_record and then a
+ * @nr_bins x @nr_phases row major matrix of little endian bit error
+ * counts exactly as the device returned them. Bins that report fewer
+ * phases than the widest bin of the lane are zero padded.
+ */
+#define EYE_FILE_MAGIC "CXLEYE\0\0"
+#define EYE_FILE_VERSION 1
+#define EYE_MAX_LANES 32
+#define EYE_MAX_PHASES 60
+
+struct eye_file_header {
+	char magic[8];
+	__le32 version;
+	__le32 nr_records;
+	u8 depth;
+	u8 rsvd[7];
+} __attribute__((packed));
+
+struct eye_lane_record {
+	char devname[16];
+	u8 lane;
+	u8 nr_bins;
+	u8 nr_phases;
+	u8 rsvd[5];
+} __attribute__((packed));
+
+static struct {
+	const char *outfile;
+	const char *csvfile;
+	unsigned int depth;
+	unsigned int lane_mask;
+	unsigned int bins;
+	unsigned int busy;
+	unsigned int interval;
+	unsigned int timeout;
+	bool verbose;
+} param = {
+	.lane_mask = 0xffff,
+	.bins = 1,
+	.busy = 1,
+	.interval = 100,
+	.timeout = 60,
+};
+
+enum eye_state {
+	EYE_RUNNING,
+	EYE_DONE,
+	EYE_FAILED,
+};
+
+struct eye_sweep {
+	struct cxl_memdev *memdev;
+	struct cxl_cmd *status;
+	enum eye_state state;
+	int rc;
+};
+
+struct eye_output {
+	FILE *f;
+	FILE *csv;
+	u32 nr_records;
+	/* [bin][phase] staging for one lane */
+	u32 *matrix;
+};
+
+static volatile sig_atomic_t eye_stop;
+
+static void eye_stop_handler(int sig)
+{
+	eye_stop = 1;
+}
+
+static u64 eye_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int eye_submit(struct cxl_cmd *cmd)
+{
+	int rc = cxl_cmd_submit(cmd);
+
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	return rc;
+}
+
+static int eye_write_header(struct eye_output *out)
+{
+	struct eye_file_header hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, EYE_FILE_MAGIC, sizeof(hdr.magic));
+	hdr.version = cpu_to_le32(EYE_FILE_VERSION);
+	hdr.nr_records = cpu_to_le32(out->nr_records);
+	hdr.depth = param.depth;
+	if (fseek(out->f, 0, SEEK_SET) < 0)
+		return -errno;
+	if (fwrite(&hdr, sizeof(hdr), 1, out->f) != 1)
+		return -EIO;
+	return 0;
+}
+
+/* read every bin of @lane, then append it to the matrix file and csv */
+static int eye_collect_lane(struct cxl_memdev *memdev, struct cxl_cmd *cmd,
+		unsigned int lane, struct eye_output *out)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	unsigned int bin, phase, nr_phases = 0;
+	struct eye_lane_record rec;
+	const u32 *ber;
+	int nr, rc;
+
+	memset(out->matrix, 0,
+			param.bins * EYE_MAX_PHASES * sizeof(*out->matrix));
+	for (bin = 0; bin < param.bins; bin++) {
+		cxl_cmd_eh_eye_cap_read_set_bin(cmd, lane, bin);
+		rc = eye_submit(cmd);
+		if (rc)
+			return rc;
+		nr = cxl_cmd_eh_eye_cap_read_get_ber_data(cmd, &ber);
+		if (nr < 0)
+			return nr;
+		memcpy(&out->matrix[bin * EYE_MAX_PHASES], ber,
+				nr * sizeof(*ber));
+		if ((unsigned int) nr > nr_phases)
+			nr_phases = nr;
+	}
+
+	memset(&rec, 0, sizeof(rec));
+	strncpy(rec.devname, devname, sizeof(rec.devname) - 1);
+	rec.lane = lane;
+	rec.nr_bins = param.bins;
+	rec.nr_phases = nr_phases;
+	if (fwrite(&rec, sizeof(rec), 1, out->f) != 1)
+		return -EIO;
+	for (bin = 0; bin < param.bins; bin++)
+		if (nr_phases && fwrite(&out->matrix[bin * EYE_MAX_PHASES],
+					sizeof(u32), nr_phases, out->f)
+				!= nr_phases)
+			return -EIO;
+	out->nr_records++;
+
+	if (!out->csv)
+		return 0;
+	for (bin = 0; bin < param.bins; bin++)
+		for (phase = 0; phase < nr_phases; phase++)
+			fprintf(out->csv, "%s,%u,%u,%u,%u\n", devname, lane,
+					bin, phase, le32_to_cpu(
+					out->matrix[bin * EYE_MAX_PHASES + phase]));
+	return 0;
+}
+
+static int eye_collect(struct eye_sweep *s, struct eye_output *out)
+{
+	struct cxl_cmd *cmd;
+	unsigned int lane;
+	int rc = 0;
+
+	cmd = cxl_cmd_new_eh_eye_cap_read(s->memdev, 0, 0);
+	if (!cmd)
+		return -ENOMEM;
+
+	for (lane = 0; lane < EYE_MAX_LANES; lane++) {
+		if (!(param.lane_mask & (1U << lane)))
+			continue;
+		rc = eye_collect_lane(s->memdev, cmd, lane, out);
+		if (rc)
+			break;
+	}
+
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+/*
+ * All captures were started up front; one pass polls the status of
+ * every device still running and drains each one as soon as it
+ * finishes, so slow devices never hold up the rest of the sweep.
+ */
+static int eye_poll(struct eye_sweep *sweeps, int nr, struct eye_output *out)
+{
+	struct timespec delay = {
+		.tv_sec = param.interval / 1000,
+		.tv_nsec = (param.interval % 1000) * 1000000L,
+	};
+	u64 deadline = eye_now_ns() + param.timeout * 1000000000ULL;
+	int i, running, stat;
+
+	do {
+		running = 0;
+		for (i = 0; i < nr; i++) {
+			struct eye_sweep *s = &sweeps[i];
+
+			if (s->state != EYE_RUNNING)
+				continue;
+			s->rc = eye_submit(s->status);
+			stat = s->rc ? s->rc
+				: cxl_cmd_eh_eye_cap_status_get_stat(s->status);
+			if (stat < 0) {
+				s->rc = stat;
+				s->state = EYE_FAILED;
+				continue;
+			}
+			if ((unsigned int) stat == param.busy) {
+				running++;
+				continue;
+			}
+
+			s->rc = eye_collect(s, out);
+			s->state = s->rc ? EYE_FAILED : EYE_DONE;
+			if (s->rc == -EIO)
+				return s->rc;
+		}
+		if (!running)
+			return 0;
+		nanosleep(&delay, NULL);
+	} while (!eye_stop && eye_now_ns() < deadline);
+
+	for (i = 0; i < nr; i++)
+		if (sweeps[i].state == EYE_RUNNING) {
+			sweeps[i].rc = eye_stop ? -EINTR : -ETIMEDOUT;
+			sweeps[i].state = EYE_FAILED;
+		}
+	return 0;
+}
+
+int cmd_eye_sweep(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_FILENAME('o', "output", &param.outfile, "output-file",
+				"write the per-lane eye matrices to this file"),
+		OPT_FILENAME('C', "csv", &param.csvfile, "csv-file",
+				"also write memdev,lane,bin,phase,ber rows"),
+		OPT_UINTEGER('d', "depth", &param.depth,
+				"capture depth (BT_DEPTH_MIN to BT_DEPTH_MAX)"),
+		OPT_UINTEGER('l', "lane_mask", &param.lane_mask,
+				"lanes to capture (default 0xffff)"),
+		OPT_UINTEGER('b', "bins", &param.bins,
+				"bins to read per lane, up to BT_BIN_TOT (default 1)"),
+		OPT_UINTEGER('B', "busy", &param.busy,
+				"status reported while a capture runs (default 1)"),
+		OPT_UINTEGER('p', "interval", &param.interval,
+				"milliseconds between status polls (default 100)"),
+		OPT_UINTEGER('t', "timeout", &param.timeout,
+				"seconds to wait for all captures (default 60)"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl eye-sweep <mem0> [<mem1>..<memN>] -o <file> [<options>]",
+		NULL
+	};
+	struct sigaction sa = { .sa_handler = eye_stop_handler };
+	struct eye_sweep *sweeps = NULL, *s;
+	struct eye_output out = { 0 };
+	struct cxl_memdev *memdev;
+	int i, j, nr = 0, swept = 0, failed = 0, rc = -ENOMEM;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1 || !param.outfile)
+		usage_with_options(u, options);
+	if (!param.lane_mask || !param.bins || param.bins > UINT8_MAX) {
+		fprintf(stderr, "--lane_mask must be non-zero and --bins 1-%d\n",
+				UINT8_MAX);
+		return EXIT_FAILURE;
+	}
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	for (i = 0; i < argc; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, argv[i]))
+				continue;
+			for (j = 0; j < nr; j++)
+				if (sweeps[j].memdev == memdev)
+					break;
+			if (j < nr)
+				continue;
+			if (cxl_memdev_is_active(memdev)) {
+				fprintf(stderr, "%s: memdev active, skipping\n",
+						cxl_memdev_get_devname(memdev));
+				failed++;
+				continue;
+			}
+			s = realloc(sweeps, (nr + 1) * sizeof(*s));
+			if (!s)
+				goto out;
+			sweeps = s;
+			s = &sweeps[nr++];
+			memset(s, 0, sizeof(*s));
+			s->memdev = memdev;
+			s->status = cxl_cmd_new_eh_eye_cap_status(memdev);
+			if (!s->status)
+				goto out;
+		}
+	if (!nr) {
+		fprintf(stderr, "no memdevs to sweep\n");
+		rc = -ENODEV;
+		goto out;
+	}
+
+	out.matrix = calloc(param.bins * EYE_MAX_PHASES, sizeof(u32));
+	if (!out.matrix)
+		goto out;
+	out.f = fopen(param.outfile, "wb");
+	if (!out.f) {
+		rc = -errno;
+		fprintf(stderr, "failed to open %s: %s\n", param.outfile,
+				strerror(errno));
+		goto out;
+	}
+	if (param.csvfile) {
+		out.csv = fopen(param.csvfile, "w");
+		if (!out.csv) {
+			rc = -errno;
+			fprintf(stderr, "failed to open %s: %s\n",
+					param.csvfile, strerror(errno));
+			goto out;
+		}
+		fprintf(out.csv, "memdev,lane,bin,phase,ber\n");
+	}
+	rc = eye_write_header(&out);
+	if (rc)
+		goto out;
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	for (i = 0; i < nr; i++) {
+		sweeps[i].rc = cxl_memdev_eh_eye_cap_run(sweeps[i].memdev,
+				param.depth, param.lane_mask);
+		if (sweeps[i].rc)
+			sweeps[i].state = EYE_FAILED;
+	}
+
+	rc = eye_poll(sweeps, nr, &out);
+	if (!rc)
+		rc = eye_write_header(&out);
+
+	for (i = 0; i < nr; i++)
+		if (sweeps[i].rc) {
+			fprintf(stderr, "%s: sweep failed: %s\n",
+					cxl_memdev_get_devname(sweeps[i].memdev),
+					strerror(-sweeps[i].rc));
+			failed++;
+		} else
+			swept++;
+	fprintf(stderr, "%d of %d memdevs swept, %u lanes written\n",
+			swept, nr, out.nr_records);
+out:
+	if (out.f && fclose(out.f) != 0 && !rc)
+		rc = -errno;
+	if (out.csv && fclose(out.csv) != 0 && !rc)
+		rc = -errno;
+	free(out.matrix);
+	for (i = 0; i < nr; i++)
+		cxl_cmd_unref(sweeps[i].status);
+	free(sweeps);
+	return rc || failed ? EXIT_FAILURE : 0;
+}
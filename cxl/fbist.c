@@ -0,0 +1,496 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <json-c/json.h>
+#include <json-c/json_util.h>
+#include <ccan/array_size/array_size.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+#define FBIST_NR_TXG 2
+
+enum fbist_profile {
+	FBIST_SIMPLEDATA,
+	FBIST_RANDOMSEQUENCE,
+};
+
+static const char * const fbist_profiles[] = {
+	[FBIST_SIMPLEDATA] = "simpledata",
+	[FBIST_RANDOMSEQUENCE] = "randomsequence",
+};
+
+static struct {
+	const char *profile;
+	const char *baseline;
+	unsigned int fbist_id;
+	unsigned int test_nr;
+	u64 start;
+	u64 size;
+	unsigned int ddrpage_size;
+	unsigned int seed_dr0;
+	unsigned int seed_dr1;
+	unsigned int threads;
+	unsigned int timeout;
+	unsigned int tolerance;
+	bool verbose;
+} param = {
+	.profile = "simpledata",
+	.threads = 4,
+	.timeout = 600,
+	.tolerance = 5,
+};
+
+enum fbist_metric {
+	FBIST_READ_BW,
+	FBIST_WRITE_BW,
+	FBIST_READ_LAT,
+	FBIST_WRITE_LAT,
+	FBIST_NR_METRICS,
+};
+
+static const char * const fbist_metrics[] = {
+	[FBIST_READ_BW] = "read_bw",
+	[FBIST_WRITE_BW] = "write_bw",
+	[FBIST_READ_LAT] = "read_latency",
+	[FBIST_WRITE_LAT] = "write_latency",
+};
+
+struct fbist_bench {
+	struct cxl_memdev *memdev;
+	pthread_t thread;
+	bool started;
+	enum fbist_profile profile;
+	int rc;
+	u64 elapsed_ns;
+	/* [txg][thread][metric] */
+	unsigned int *samples;
+};
+
+static unsigned int *fbist_sample(struct fbist_bench *b, int txg, int thread)
+{
+	return &b->samples[(txg * param.threads + thread) * FBIST_NR_METRICS];
+}
+
+static u64 fbist_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int fbist_submit(struct cxl_cmd *cmd)
+{
+	int rc = cxl_cmd_submit(cmd);
+
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	return rc;
+}
+
+static int fbist_start(struct fbist_bench *b)
+{
+	struct cxl_cmd *cmd;
+	int rc;
+
+	if (b->profile == FBIST_SIMPLEDATA)
+		cmd = cxl_cmd_new_fbist_test_simpledata(b->memdev,
+				param.fbist_id, param.test_nr, param.start,
+				param.size);
+	else
+		cmd = cxl_cmd_new_fbist_test_randomsequence(b->memdev,
+				param.fbist_id, param.test_nr, param.start,
+				param.size, param.ddrpage_size, param.seed_dr0,
+				param.seed_dr1);
+	if (!cmd)
+		return -ENOMEM;
+
+	rc = fbist_submit(cmd);
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+/* poll until both transaction generators have stopped */
+static int fbist_wait(struct fbist_bench *b)
+{
+	struct timespec delay = { .tv_nsec = 10 * 1000 * 1000 };
+	u64 deadline = fbist_now_ns() + param.timeout * 1000000000ULL;
+	struct cxl_cmd *cmd;
+	int rc, txg;
+
+	cmd = cxl_cmd_new_fbist_run_get(b->memdev, param.fbist_id);
+	if (!cmd)
+		return -ENOMEM;
+
+	for (;;) {
+		bool running = false;
+
+		rc = fbist_submit(cmd);
+		if (rc)
+			break;
+		for (txg = 0; txg < FBIST_NR_TXG; txg++)
+			if (cxl_cmd_fbist_run_get_get_txg_run(cmd, txg) > 0)
+				running = true;
+		if (!running)
+			break;
+		if (fbist_now_ns() >= deadline) {
+			rc = -ETIMEDOUT;
+			break;
+		}
+		nanosleep(&delay, NULL);
+	}
+
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+static int fbist_collect(struct fbist_bench *b)
+{
+	long long v[FBIST_NR_METRICS];
+	struct cxl_cmd *bw, *lat;
+	int txg, thread, m, rc = 0;
+	unsigned int *s;
+
+	for (txg = 0; txg < FBIST_NR_TXG && !rc; txg++)
+		for (thread = 0; thread < (int) param.threads && !rc; thread++) {
+			bw = cxl_cmd_new_fbist_thread_bandwidth_get(b->memdev,
+					param.fbist_id, txg, thread);
+			lat = cxl_cmd_new_fbist_thread_latency_get(b->memdev,
+					param.fbist_id, txg, thread);
+			if (!bw || !lat)
+				rc = -ENOMEM;
+			if (!rc)
+				rc = fbist_submit(bw);
+			if (!rc)
+				rc = fbist_submit(lat);
+			if (!rc) {
+				v[FBIST_READ_BW] = cxl_cmd_fbist_thread_bandwidth_get_get_read_bw_cnt(bw);
+				v[FBIST_WRITE_BW] = cxl_cmd_fbist_thread_bandwidth_get_get_write_bw_cnt(bw);
+				v[FBIST_READ_LAT] = cxl_cmd_fbist_thread_latency_get_get_read_latency_cnt(lat);
+				v[FBIST_WRITE_LAT] = cxl_cmd_fbist_thread_latency_get_get_write_latency_cnt(lat);
+				s = fbist_sample(b, txg, thread);
+				for (m = 0; m < FBIST_NR_METRICS && !rc; m++)
+					if (v[m] < 0)
+						rc = v[m];
+					else
+						s[m] = v[m];
+			}
+			cxl_cmd_unref(bw);
+			cxl_cmd_unref(lat);
+		}
+
+	return rc;
+}
+
+static void *fbist_bench_run(void *arg)
+{
+	struct fbist_bench *b = arg;
+	u64 start = fbist_now_ns();
+
+	b->rc = fbist_start(b);
+	if (!b->rc)
+		b->rc = fbist_wait(b);
+	b->elapsed_ns = fbist_now_ns() - start;
+	if (!b->rc)
+		b->rc = fbist_collect(b);
+
+	return NULL;
+}
+
+static struct json_object *fbist_summary_to_json(unsigned int *samples,
+		int nr)
+{
+	struct json_object *jsum, *jmetric;
+	int m, i;
+
+	jsum = json_object_new_object();
+	if (!jsum)
+		return NULL;
+
+	for (m = 0; m < FBIST_NR_METRICS; m++) {
+		unsigned long long total = 0;
+		unsigned int min = ~0U, max = 0, v;
+
+		for (i = 0; i < nr; i++) {
+			v = samples[i * FBIST_NR_METRICS + m];
+			total += v;
+			min = v < min ? v : min;
+			max = v > max ? v : max;
+		}
+
+		jmetric = json_object_new_object();
+		if (!jmetric)
+			continue;
+		json_object_object_add(jmetric, "min", json_object_new_int64(min));
+		json_object_object_add(jmetric, "avg",
+				json_object_new_int64(nr ? total / nr : 0));
+		json_object_object_add(jmetric, "max", json_object_new_int64(max));
+		json_object_object_add(jsum, fbist_metrics[m], jmetric);
+	}
+
+	return jsum;
+}
+
+static struct json_object *fbist_bench_to_json(struct fbist_bench *b)
+{
+	struct json_object *jbench, *jthreads, *jthread;
+	unsigned int *s;
+	int txg, thread, m;
+
+	jbench = json_object_new_object();
+	if (!jbench)
+		return NULL;
+
+	json_object_object_add(jbench, "memdev",
+			json_object_new_string(cxl_memdev_get_devname(b->memdev)));
+	if (b->rc) {
+		json_object_object_add(jbench, "error",
+				json_object_new_string(strerror(-b->rc)));
+		return jbench;
+	}
+	json_object_object_add(jbench, "elapsed_ms",
+			json_object_new_int64(b->elapsed_ns / 1000000));
+
+	jthreads = json_object_new_array();
+	for (txg = 0; jthreads && txg < FBIST_NR_TXG; txg++)
+		for (thread = 0; thread < (int) param.threads; thread++) {
+			jthread = json_object_new_object();
+			if (!jthread)
+				continue;
+			json_object_object_add(jthread, "txg",
+					json_object_new_int(txg));
+			json_object_object_add(jthread, "thread",
+					json_object_new_int(thread));
+			s = fbist_sample(b, txg, thread);
+			for (m = 0; m < FBIST_NR_METRICS; m++)
+				json_object_object_add(jthread, fbist_metrics[m],
+						json_object_new_int64(s[m]));
+			json_object_array_add(jthreads, jthread);
+		}
+	if (jthreads)
+		json_object_object_add(jbench, "threads", jthreads);
+
+	json_object_object_add(jbench, "summary",
+			fbist_summary_to_json(b->samples,
+				FBIST_NR_TXG * param.threads));
+	return jbench;
+}
+
+static struct json_object *fbist_baseline_find(struct json_object *jbase,
+		const char *devname)
+{
+	struct json_object *jmemdevs, *jbench, *jname;
+	int i;
+
+	if (!json_object_object_get_ex(jbase, "memdevs", &jmemdevs))
+		return NULL;
+
+	for (i = 0; i < json_object_array_length(jmemdevs); i++) {
+		jbench = json_object_array_get_idx(jmemdevs, i);
+		if (json_object_object_get_ex(jbench, "memdev", &jname)
+				&& strcmp(json_object_get_string(jname), devname) == 0)
+			return jbench;
+	}
+
+	return NULL;
+}
+
+static long long fbist_summary_avg(struct json_object *jbench, int m)
+{
+	struct json_object *jsum, *jmetric, *javg;
+
+	if (!json_object_object_get_ex(jbench, "summary", &jsum)
+			|| !json_object_object_get_ex(jsum, fbist_metrics[m], &jmetric)
+			|| !json_object_object_get_ex(jmetric, "avg", &javg))
+		return -1;
+	return json_object_get_int64(javg);
+}
+
+/*
+ * Annotate @jbench with the change of each average against the
+ * baseline run of the same memdev. A regression is a bandwidth drop or
+ * a latency rise of more than --tolerance percent.
+ */
+static int fbist_compare(struct json_object *jbench, struct json_object *jbase)
+{
+	const char *devname;
+	struct json_object *jname, *jold, *jcmp, *jmetric;
+	int m, regressions = 0;
+
+	if (!json_object_object_get_ex(jbench, "memdev", &jname))
+		return 0;
+	devname = json_object_get_string(jname);
+	jold = fbist_baseline_find(jbase, devname);
+	if (!jold)
+		return 0;
+
+	jcmp = json_object_new_object();
+	if (!jcmp)
+		return 0;
+
+	for (m = 0; m < FBIST_NR_METRICS; m++) {
+		long long new = fbist_summary_avg(jbench, m);
+		long long old = fbist_summary_avg(jold, m);
+		double pct;
+		bool worse;
+
+		if (new < 0 || old <= 0)
+			continue;
+		pct = 100.0 * (new - old) / old;
+		worse = (m == FBIST_READ_BW || m == FBIST_WRITE_BW) ?
+			pct < -(double) param.tolerance :
+			pct > (double) param.tolerance;
+		regressions += worse;
+
+		jmetric = json_object_new_object();
+		if (!jmetric)
+			continue;
+		json_object_object_add(jmetric, "baseline_avg",
+				json_object_new_int64(old));
+		json_object_object_add(jmetric, "change_pct",
+				json_object_new_double(pct));
+		json_object_object_add(jmetric, "regression",
+				json_object_new_boolean(worse));
+		json_object_object_add(jcmp, fbist_metrics[m], jmetric);
+	}
+	json_object_object_add(jbench, "baseline", jcmp);
+
+	return regressions;
+}
+
+int cmd_fbist_bench(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_STRING('p', "profile", &param.profile, "profile",
+				"simpledata (default) or randomsequence"),
+		OPT_UINTEGER('f', "fbist_id", &param.fbist_id, "Flex BIST Instance"),
+		OPT_UINTEGER('t', "test_nr", &param.test_nr,
+				"test number (simpledata) or phase number (randomsequence)"),
+		OPT_U64('s', "start_address", &param.start, "Start Address"),
+		OPT_U64('n', "num_bytes", &param.size, "Num Bytes"),
+		OPT_UINTEGER('d', "ddrpage_size", &param.ddrpage_size,
+				"DDR Page size (randomsequence)"),
+		OPT_UINTEGER('e', "seed_dr0", &param.seed_dr0, "Seed DR0 (randomsequence)"),
+		OPT_UINTEGER('g', "seed_dr1", &param.seed_dr1, "Seed DR1 (randomsequence)"),
+		OPT_UINTEGER('T', "threads", &param.threads,
+				"threads per transaction generator to report (default 4)"),
+		OPT_UINTEGER('w', "timeout", &param.timeout,
+				"seconds to wait for the run to finish (default 600)"),
+		OPT_FILENAME('b', "baseline", &param.baseline, "baseline-file",
+				"compare against a previously saved report"),
+		OPT_UINTEGER('r', "tolerance", &param.tolerance,
+				"percent change tolerated against the baseline (default 5)"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl fbist-bench <mem0> [<mem1>..<memN>] [<options>]",
+		NULL
+	};
+	struct json_object *jreport, *jmemdevs, *jbase = NULL, *jbench;
+	struct fbist_bench *benches = NULL, *b;
+	struct cxl_memdev *memdev;
+	int i, j, nr = 0, profile, regressions = 0, failed = 0;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1 || !param.threads)
+		usage_with_options(u, options);
+	for (profile = 0; profile < (int) ARRAY_SIZE(fbist_profiles); profile++)
+		if (strcmp(param.profile, fbist_profiles[profile]) == 0)
+			break;
+	if (profile == ARRAY_SIZE(fbist_profiles)) {
+		fprintf(stderr, "unknown profile: %s\n", param.profile);
+		return EXIT_FAILURE;
+	}
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	if (param.baseline) {
+		jbase = json_object_from_file(param.baseline);
+		if (!jbase) {
+			fprintf(stderr, "failed to read baseline %s\n",
+					param.baseline);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < argc; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, argv[i]))
+				continue;
+			for (j = 0; j < nr; j++)
+				if (benches[j].memdev == memdev)
+					break;
+			if (j < nr)
+				continue;
+			if (cxl_memdev_is_active(memdev)) {
+				fprintf(stderr, "%s: memdev active, skipping\n",
+						cxl_memdev_get_devname(memdev));
+				failed++;
+				continue;
+			}
+			b = realloc(benches, (nr + 1) * sizeof(*b));
+			if (!b)
+				goto out;
+			benches = b;
+			b = &benches[nr++];
+			memset(b, 0, sizeof(*b));
+			b->memdev = memdev;
+			b->profile = profile;
+			b->samples = calloc(FBIST_NR_TXG * param.threads
+					* FBIST_NR_METRICS, sizeof(unsigned int));
+			if (!b->samples)
+				goto out;
+		}
+
+	for (i = 0; i < nr; i++)
+		if (pthread_create(&benches[i].thread, NULL, fbist_bench_run,
+					&benches[i]) == 0)
+			benches[i].started = true;
+		else
+			benches[i].rc = -EAGAIN;
+	for (i = 0; i < nr; i++)
+		if (benches[i].started)
+			pthread_join(benches[i].thread, NULL);
+
+	jreport = json_object_new_object();
+	jmemdevs = json_object_new_array();
+	if (!jreport || !jmemdevs)
+		goto out;
+	json_object_object_add(jreport, "profile",
+			json_object_new_string(param.profile));
+	for (i = 0; i < nr; i++) {
+		failed += benches[i].rc != 0;
+		jbench = fbist_bench_to_json(&benches[i]);
+		if (!jbench)
+			continue;
+		if (jbase && !benches[i].rc)
+			regressions += fbist_compare(jbench, jbase);
+		json_object_array_add(jmemdevs, jbench);
+	}
+	json_object_object_add(jreport, "memdevs", jmemdevs);
+
+	printf("%s\n", json_object_to_json_string_ext(jreport,
+				JSON_C_TO_STRING_PRETTY));
+	json_object_put(jreport);
+
+	if (regressions)
+		fprintf(stderr, "%d metrics regressed beyond %u%%\n",
+				regressions, param.tolerance);
+out:
+	for (i = 0; i < nr; i++)
+		free(benches[i].samples);
+	free(benches);
+	if (jbase)
+		json_object_put(jbase);
+	return (failed || regressions || !nr) ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <ccan/endian/endian.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+#include <cxl/capture.h>
+
+/*
+ * hct-stream capture file: a struct hct_file_header followed by any
+ * number of records, each a struct hct_record and then nr_entries
+ * little endian trace buffer words exactly as the device returned them.
+ * Every field is little endian so captures can be decoded anywhere.
+ */
+#define HCT_FILE_MAGIC "CXLHCT\0\0"
+#define HCT_FILE_VERSION 1
+#define HCT_STREAM_BUF_SIZE (1 << 20)
+#define HCT_ENTRIES_MAX 255
+
+struct hct_file_header {
+	char magic[8];
+	__le32 version;
+	__le32 rsvd;
+} __attribute__((packed));
+
+struct hct_record {
+	__le64 timestamp_ns;
+	u8 hct_inst;
+	u8 buf_end;
+	__le16 nr_entries;
+	__le32 rsvd;
+} __attribute__((packed));
+
+static struct {
+	const char *outfile;
+	unsigned int hct_inst;
+	unsigned int num_entries;
+	unsigned int duration;
+	unsigned int count;
+	bool verbose;
+} param;
+
+static volatile sig_atomic_t hct_stop;
+
+static void hct_stop_handler(int sig)
+{
+	hct_stop = 1;
+}
+
+static int hct_file_check(const struct hct_file_header *hdr)
+{
+	if (memcmp(hdr->magic, HCT_FILE_MAGIC, sizeof(hdr->magic)) != 0)
+		return -EINVAL;
+	if (le32_to_cpu(hdr->version) != HCT_FILE_VERSION)
+		return -EOPNOTSUPP;
+	return 0;
+}
+
+/* open @path for appending, writing the file header if it is empty */
+static FILE *hct_file_open(const char *path)
+{
+	struct hct_file_header hdr;
+	struct stat st;
+	FILE *f;
+
+	f = fopen(path, "a+b");
+	if (!f)
+		return NULL;
+
+	if (fstat(fileno(f), &st) < 0)
+		goto err;
+
+	if (st.st_size == 0) {
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, HCT_FILE_MAGIC, sizeof(hdr.magic));
+		hdr.version = cpu_to_le32(HCT_FILE_VERSION);
+		if (fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+			goto err;
+	} else {
+		if (fread(&hdr, sizeof(hdr), 1, f) != 1
+				|| hct_file_check(&hdr) < 0) {
+			errno = EINVAL;
+			goto err;
+		}
+	}
+
+	return f;
+err:
+	fclose(f);
+	return NULL;
+}
+
+static u64 hct_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* one record per read, returns the number of entries or -errno */
+static int hct_record_one(struct cxl_cmd *cmd, u8 hct_inst, FILE *f)
+{
+	struct hct_record rec;
+	const u32 *buf;
+	int nr, rc;
+
+	rc = cxl_cmd_submit(cmd);
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	if (rc)
+		return rc;
+
+	nr = cxl_cmd_hct_read_buffer_get_entries(cmd, &buf);
+	if (nr < 0)
+		return nr;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.timestamp_ns = cpu_to_le64(hct_now_ns());
+	rec.hct_inst = hct_inst;
+	rec.buf_end = cxl_cmd_hct_read_buffer_get_buf_end(cmd);
+	rec.nr_entries = cpu_to_le16(nr);
+	if (fwrite(&rec, sizeof(rec), 1, f) != 1
+			|| (nr && fwrite(buf, sizeof(*buf), nr, f)
+				!= (size_t) nr))
+		return -errno;
+	return nr;
+}
+
+/*
+ * Nothing is formatted while capturing: each read is one fwrite of the
+ * record header and one of the raw entries into a large stdio buffer.
+ */
+static int hct_stream(struct cxl_memdev *memdev, FILE *f)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	unsigned long long reads = 0, entries = 0;
+	struct cxl_cmd *cmd;
+	u64 deadline = 0;
+	int nr, rc = 0;
+
+	cmd = cxl_cmd_new_hct_read_buffer(memdev, param.hct_inst,
+			param.num_entries);
+	if (!cmd)
+		return -ENOMEM;
+
+	if (param.duration)
+		deadline = hct_now_ns() + param.duration * 1000000000ULL;
+
+	while (!hct_stop) {
+		if (param.count && reads >= param.count)
+			break;
+		if (deadline && hct_now_ns() >= deadline)
+			break;
+
+		nr = hct_record_one(cmd, param.hct_inst, f);
+		if (nr < 0) {
+			rc = nr;
+			break;
+		}
+
+		reads++;
+		entries += nr;
+	}
+
+	cxl_cmd_unref(cmd);
+	if (fflush(f) != 0 && !rc)
+		rc = -errno;
+
+	fprintf(stderr, "%s: %llu reads, %llu trace entries captured\n",
+			devname, reads, entries);
+	if (rc)
+		fprintf(stderr, "%s: capture stopped: %s\n", devname,
+				strerror(-rc));
+	return rc;
+}
+
+/* a stopped buffer is read until the device reports its end */
+#define HCT_DRAIN_READS_MAX 65536
+
+int hct_capture_drain(struct cxl_memdev *memdev, u8 hct_inst,
+		const char *path)
+{
+	struct cxl_cmd *cmd;
+	int i, nr, rc = 0;
+	FILE *f;
+
+	f = hct_file_open(path);
+	if (!f)
+		return -errno;
+	cmd = cxl_cmd_new_hct_read_buffer(memdev, hct_inst, HCT_ENTRIES_MAX);
+	if (!cmd) {
+		fclose(f);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < HCT_DRAIN_READS_MAX; i++) {
+		nr = hct_record_one(cmd, hct_inst, f);
+		if (nr < 0) {
+			rc = nr;
+			break;
+		}
+		if (nr == 0 || cxl_cmd_hct_read_buffer_get_buf_end(cmd))
+			break;
+	}
+
+	cxl_cmd_unref(cmd);
+	if (fclose(f) != 0 && !rc)
+		rc = -errno;
+	return rc;
+}
+
+int cmd_hct_stream(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_FILENAME('o', "output", &param.outfile, "output-file",
+				"append captured trace records to this file"),
+		OPT_UINTEGER('i', "hct_inst", &param.hct_inst, "HCT Instance"),
+		OPT_UINTEGER('n', "num_entries_to_read", &param.num_entries,
+				"buffer entries to request per read (default 255)"),
+		OPT_UINTEGER('t', "duration", &param.duration,
+				"stop after <n> seconds (default: until interrupted)"),
+		OPT_UINTEGER('c', "count", &param.count,
+				"stop after <n> reads (default: until interrupted)"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl hct-stream <mem0> -o <file> [<options>]",
+		NULL
+	};
+	struct cxl_memdev *memdev, *found = NULL;
+	struct sigaction sa = { .sa_handler = hct_stop_handler };
+	char *iobuf;
+	FILE *f;
+	int rc;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc != 1 || !param.outfile)
+		usage_with_options(u, options);
+	if (!param.num_entries || param.num_entries > HCT_ENTRIES_MAX)
+		param.num_entries = HCT_ENTRIES_MAX;
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	cxl_memdev_foreach(ctx, memdev)
+		if (util_cxl_memdev_filter(memdev, argv[0])) {
+			found = memdev;
+			break;
+		}
+	if (!found) {
+		fprintf(stderr, "%s: no such memdev\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	f = hct_file_open(param.outfile);
+	if (!f) {
+		fprintf(stderr, "failed to open %s: %s\n", param.outfile,
+				strerror(errno));
+		return EXIT_FAILURE;
+	}
+	iobuf = malloc(HCT_STREAM_BUF_SIZE);
+	if (iobuf)
+		setvbuf(f, iobuf, _IOFBF, HCT_STREAM_BUF_SIZE);
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	rc = hct_stream(found, f);
+
+	fclose(f);
+	free(iobuf);
+	return rc ? EXIT_FAILURE : 0;
+}
+
+static int hct_decode(const u8 *map, size_t size)
+{
+	const struct hct_record *rec;
+	size_t pos = sizeof(struct hct_file_header);
+	unsigned long long nr_records = 0;
+	int nr, i;
+
+	if (size < pos || hct_file_check((const void *) map) < 0) {
+		fprintf(stderr, "not an hct-stream capture\n");
+		return -EINVAL;
+	}
+
+	while (pos + sizeof(*rec) <= size) {
+		const __le32 *entries;
+		u64 ts;
+
+		rec = (const void *) (map + pos);
+		nr = le16_to_cpu(rec->nr_entries);
+		pos += sizeof(*rec);
+		if (pos + nr * sizeof(*entries) > size) {
+			fprintf(stderr, "truncated record at offset %zu\n",
+					pos - sizeof(*rec));
+			return -EINVAL;
+		}
+		entries = (const void *) (map + pos);
+		pos += nr * sizeof(*entries);
+
+		if (param.hct_inst != UINT_MAX && rec->hct_inst != param.hct_inst)
+			continue;
+
+		ts = le64_to_cpu(rec->timestamp_ns);
+		printf("[%llu.%09llu] hct_inst: %u buf_end: %u entries: %d\n",
+				(unsigned long long) ts / 1000000000ULL,
+				(unsigned long long) ts % 1000000000ULL,
+				rec->hct_inst, rec->buf_end, nr);
+		for (i = 0; i < nr; i++)
+			printf("%08x%c", le32_to_cpu(entries[i]),
+					(i % 8 == 7 || i == nr - 1) ? '\n' : ' ');
+		nr_records++;
+	}
+
+	fprintf(stderr, "%llu records decoded\n", nr_records);
+	return 0;
+}
+
+int cmd_hct_decode(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_UINTEGER('i', "hct_inst", &param.hct_inst,
+				"only decode records for this HCT instance"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl hct-decode <file> [<options>]",
+		NULL
+	};
+	struct stat st;
+	void *map;
+	int fd, rc;
+
+	param.hct_inst = UINT_MAX;
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc != 1)
+		usage_with_options(u, options);
+
+	fd = open(argv[0], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "failed to open %s: %s\n", argv[0],
+				strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return EXIT_FAILURE;
+	}
+	if (st.st_size == 0) {
+		fprintf(stderr, "%s: empty capture\n", argv[0]);
+		close(fd);
+		return EXIT_FAILURE;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "failed to map %s: %s\n", argv[0],
+				strerror(errno));
+		return EXIT_FAILURE;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	rc = hct_decode(map, st.st_size);
+	munmap(map, st.st_size);
+	return rc ? EXIT_FAILURE : 0;
+}
@@ -12,8 +12,13 @@
 #include <libgen.h>
 #include <stdlib.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/sysmacros.h>
@@ -26,9 +31,11 @@
 
 #include <util/log.h>
 #include <util/sysfs.h>
+#include <util/usdt.h>
 #include <util/bitmap.h>
 #include <cxl/cxl_mem.h>
 #include <cxl/libcxl.h>
+#include <daxctl/libdaxctl.h>
 #include "private.h"
 
 const char *DEVICE_ERRORS[23] = {
@@ -326,19 +333,103 @@ struct cxl_ctx {
 	struct log_ctx ctx;
 	int refcount;
 	void *userdata;
+	pthread_mutex_t init_lock;
 	int memdevs_init;
 	struct list_head memdevs;
 	struct kmod_ctx *kmod_ctx;
 	void *private_data;
+	pthread_mutex_t pool_lock;
+	struct list_head cmd_pool;
+	int cmd_pool_len;
+	struct list_head payload_pool;
+	int payload_pool_len;
+	pthread_mutex_t async_lock;
+	struct list_head async_done;
+	int async_fd;
+	pthread_mutex_t stats_lock;
+	struct cxl_mbox_stats *mbox_stats;
+	int nr_mbox_stats;
+	int mbox_stats_alloc;
+	int enum_threads;
+	int max_threads;
+	char *spd_cache_dir;
+	char *inventory_cache_dir;
+	int opcode_check;
+	struct cxl_mbox_trace_entry *trace;
+	unsigned int trace_len;
+	unsigned long long trace_head;
+	char *trace_dump_path;
+	char *sysfs_root;
+	cxl_transport_fn transport;
+	void *transport_data;
+	cxl_vendor_output_fn vendor_output;
+	void *vendor_output_data;
+	int topology_init;
+	struct list_head ports;
+	struct list_head regions;
+	struct daxctl_ctx *daxctl_ctx;
 };
 
+#define CXL_ENUM_THREADS_MAX 64
+
+/*
+ * Idle commands and payload buffers are parked on per-context freelists
+ * so that steady-state polling does not hit the allocator. Bound the
+ * freelists so a burst of outstanding commands does not pin memory.
+ */
+#define CXL_CMD_POOL_MAX 16
+#define CXL_PAYLOAD_POOL_MAX 16
+
+struct cxl_payload {
+	struct list_node list;
+	size_t size;
+	unsigned char data[] __attribute__((aligned(16)));
+};
+
+static void cxl_memdev_worker_stop(struct cxl_memdev *memdev);
+static void cxl_memdev_inventory_flush(struct cxl_memdev *memdev,
+		bool remove_file);
+static int cxl_memdev_cel_check(struct cxl_memdev *memdev, int opcode);
+static void cxl_topology_free(struct cxl_ctx *ctx);
+
+/* DDR4 SPD EEPROM image, see cxl_memdev_get_spd() */
+#define CXL_SPD_SIZE 512
+
+struct cxl_spd {
+	struct list_node list;
+	struct cxl_memdev *memdev;
+	u32 spd_id;
+	char serial[9];
+	u8 data[CXL_SPD_SIZE];
+};
+
+static void cxl_memdev_spd_flush(struct cxl_memdev *memdev)
+{
+	struct cxl_spd *spd, *_s;
+
+	list_for_each_safe(&memdev->spd_cache, spd, _s, list) {
+		list_del_from(&memdev->spd_cache, &spd->list);
+		free(spd);
+	}
+}
+
 static void free_memdev(struct cxl_memdev *memdev, struct list_head *head)
 {
 	if (head)
 		list_del_from(head, &memdev->list);
+	cxl_memdev_worker_stop(memdev);
 	kmod_module_unref(memdev->module);
+	if (memdev->fd >= 0)
+		close(memdev->fd);
+	if (memdev->sysfs_fd >= 0)
+		close(memdev->sysfs_fd);
+	free(memdev->query_cmd);
 	free(memdev->firmware_version);
-	free(memdev->dev_buf);
+	cxl_memdev_spd_flush(memdev);
+	free(memdev->inventory);
+	free(memdev->cel);
+	free(memdev->conf_space);
+	free(memdev->host);
 	free(memdev->dev_path);
 	free(memdev);
 }
@@ -414,8 +505,10 @@ CXL_EXPORT void *cxl_get_private_data(struct cxl_ctx *ctx)
  */
 CXL_EXPORT int cxl_new(struct cxl_ctx **ctx)
 {
+	pthread_mutexattr_t attr;
 	struct kmod_ctx *kmod_ctx;
 	struct cxl_ctx *c;
+	const char *env;
 	int rc = 0;
 
 	c = calloc(1, sizeof(struct cxl_ctx));
@@ -434,6 +527,48 @@ CXL_EXPORT int cxl_new(struct cxl_ctx **ctx)
 	dbg(c, "log_priority=%d\n", c->ctx.log_priority);
 	*ctx = c;
 	list_head_init(&c->memdevs);
+	list_head_init(&c->ports);
+	list_head_init(&c->regions);
+	list_head_init(&c->cmd_pool);
+	list_head_init(&c->payload_pool);
+	pthread_mutex_init(&c->pool_lock, NULL);
+	list_head_init(&c->async_done);
+	pthread_mutex_init(&c->async_lock, NULL);
+	c->async_fd = -1;
+	pthread_mutex_init(&c->stats_lock, NULL);
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&c->init_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	env = secure_getenv("CXL_ENUM_THREADS");
+	if (env)
+		cxl_set_enum_threads(c, strtol(env, NULL, 0));
+	env = secure_getenv("CXL_SPD_CACHE_DIR");
+	if (env)
+		cxl_set_spd_cache_dir(c, env);
+	c->opcode_check = 1;
+	env = secure_getenv("CXL_OPCODE_CHECK");
+	if (env)
+		cxl_set_opcode_check(c, strtol(env, NULL, 0));
+	env = secure_getenv("CXL_MBOX_TRACE");
+	if (env)
+		cxl_set_mbox_trace(c, strtoul(env, NULL, 0));
+	env = secure_getenv("CXL_MBOX_TRACE_DUMP");
+	if (env)
+		cxl_set_mbox_trace_dump(c, env);
+	env = secure_getenv("CXL_INVENTORY_CACHE_DIR");
+	if (env)
+		cxl_set_inventory_cache_dir(c, env);
+	env = secure_getenv("CXL_SYSFS_ROOT");
+	if (env && *env) {
+		char *devices;
+
+		/* a root standing in for /sys, as NDCTL_SYSFS_ROOT */
+		if (asprintf(&devices, "%s/bus/cxl/devices", env) >= 0) {
+			cxl_set_sysfs_root(c, devices);
+			free(devices);
+		}
+	}
 	c->kmod_ctx = kmod_ctx;
 
 	return 0;
@@ -450,7 +585,7 @@ CXL_EXPORT struct cxl_ctx *cxl_ref(struct cxl_ctx *ctx)
 {
 	if (ctx == NULL)
 		return NULL;
-	ctx->refcount++;
+	__atomic_add_fetch(&ctx->refcount, 1, __ATOMIC_RELAXED);
 	return ctx;
 }
 
@@ -464,18 +599,53 @@ CXL_EXPORT struct cxl_ctx *cxl_ref(struct cxl_ctx *ctx)
 CXL_EXPORT void cxl_unref(struct cxl_ctx *ctx)
 {
 	struct cxl_memdev *memdev, *_d;
+	struct cxl_payload *payload, *_p;
+	struct cxl_cmd *cmd, *_c;
 
 	if (ctx == NULL)
 		return;
-	ctx->refcount--;
-	if (ctx->refcount > 0)
+	if (__atomic_sub_fetch(&ctx->refcount, 1, __ATOMIC_ACQ_REL) > 0)
 		return;
 
+	/* quiesce async workers, then drop undelivered completions */
+	cxl_memdev_foreach(ctx, memdev)
+		cxl_memdev_worker_stop(memdev);
+	while ((cmd = list_pop(&ctx->async_done, struct cxl_cmd, list)))
+		cxl_cmd_unref(cmd);
+
 	list_for_each_safe(&ctx->memdevs, memdev, _d, list)
 		free_memdev(memdev, &ctx->memdevs);
+	cxl_topology_free(ctx);
+	daxctl_unref(ctx->daxctl_ctx);
+
+	list_for_each_safe(&ctx->cmd_pool, cmd, _c, list) {
+		list_del_from(&ctx->cmd_pool, &cmd->list);
+		free(cmd->query_cmd);
+		free(cmd->send_cmd);
+		free(cmd);
+	}
+
+	list_for_each_safe(&ctx->payload_pool, payload, _p, list) {
+		list_del_from(&ctx->payload_pool, &payload->list);
+		free(payload);
+	}
 
+	free(ctx->spd_cache_dir);
+	free(ctx->inventory_cache_dir);
+	pthread_mutex_destroy(&ctx->pool_lock);
+
+	if (ctx->async_fd >= 0)
+		close(ctx->async_fd);
+	pthread_mutex_destroy(&ctx->async_lock);
+	free(ctx->mbox_stats);
+	free(ctx->trace);
+	free(ctx->trace_dump_path);
+	free(ctx->sysfs_root);
+	pthread_mutex_destroy(&ctx->stats_lock);
+	pthread_mutex_destroy(&ctx->init_lock);
 	kmod_unref(ctx->kmod_ctx);
 	info(ctx, "context %p released\n", ctx);
+	log_exit(&ctx->ctx);
 	free(ctx);
 }
 
@@ -515,1705 +685,4337 @@ CXL_EXPORT int cxl_get_log_priority(struct cxl_ctx *ctx)
 CXL_EXPORT void cxl_set_log_priority(struct cxl_ctx *ctx, int priority)
 {
 	ctx->ctx.log_priority = priority;
+	/* forward the debug level to our internal libdaxctl instance */
+	if (ctx->daxctl_ctx)
+		daxctl_set_log_priority(ctx->daxctl_ctx, priority);
 }
 
-static void *add_cxl_memdev(void *parent, int id, const char *cxlmem_base)
+/**
+ * cxl_set_log_ring - record messages, and format them only when dumped
+ * @ctx: cxl library context
+ * @size: bytes of ring, e.g. 1 << 20, 0 to format every message again
+ *
+ * Every message down to LOG_DEBUG is kept as its format pointer,
+ * arguments and a timestamp, the most recent ones that fit in @size.
+ * The priority in effect before still decides what is printed as it
+ * happens, and an error first dumps the recorded history, see
+ * cxl_log_dump(). The CXL_LOG_RING environment variable, e.g. "1M",
+ * provides the default. Debug messages need the library built with
+ * "configure --enable-debug".
+ */
+CXL_EXPORT int cxl_set_log_ring(struct cxl_ctx *ctx, unsigned long size)
 {
-	const char *devname = devpath_to_devname(cxlmem_base);
-	char *path = calloc(1, strlen(cxlmem_base) + 100);
-	struct cxl_ctx *ctx = parent;
-	struct cxl_memdev *memdev, *memdev_dup;
-	char buf[SYSFS_ATTR_SIZE];
+	return log_ring_enable(&ctx->ctx, size);
+}
+
+/**
+ * cxl_log_dump - format and emit the recorded messages, oldest first
+ * @ctx: cxl library context
+ *
+ * Messages go through the log function, the ring is left empty.
+ */
+CXL_EXPORT void cxl_log_dump(struct cxl_ctx *ctx)
+{
+	log_ring_dump(&ctx->ctx);
+}
+
+struct cxl_counters {
+	struct cxl_ctx *ctx;
+	struct cxl_counters_hdr *hdr;
+	size_t size;
+};
+
+/**
+ * cxl_counters_open - map a counter page for reading
+ * @ctx: cxl library context
+ * @path: page written by 'cxl perf stat --publish', NULL for
+ *	  CXL_COUNTERS_PATH
+ *
+ * Returns NULL with errno set when the page is missing, or was written
+ * with a layout this library does not know.
+ */
+CXL_EXPORT struct cxl_counters *cxl_counters_open(struct cxl_ctx *ctx,
+		const char *path)
+{
+	struct cxl_counters_hdr *hdr;
+	struct cxl_counters *c;
 	struct stat st;
+	int fd, rc;
 
 	if (!path)
-		return NULL;
-	dbg(ctx, "%s: base: \'%s\'\n", __func__, cxlmem_base);
+		path = CXL_COUNTERS_PATH;
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		rc = -errno;
+		dbg(ctx, "%s: %s\n", path, strerror(errno));
+		goto err;
+	}
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(*hdr)) {
+		rc = -ENXIO;
+		close(fd);
+		goto bad;
+	}
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED) {
+		rc = -errno;
+		goto bad;
+	}
+
+	rc = -EPROTO;
+	if (memcmp(hdr->magic, CXL_COUNTERS_MAGIC, sizeof(hdr->magic)) != 0
+			|| hdr->version != CXL_COUNTERS_VERSION
+			|| hdr->hdr_size < sizeof(*hdr)
+			|| hdr->slot_size < sizeof(struct cxl_counter)
+			|| hdr->hdr_size + (u64) hdr->nr_slots * hdr->slot_size
+				> (u64) st.st_size)
+		goto unmap;
+
+	c = calloc(1, sizeof(*c));
+	if (!c) {
+		rc = -ENOMEM;
+		goto unmap;
+	}
+	c->ctx = ctx;
+	c->hdr = hdr;
+	c->size = st.st_size;
+	return c;
+
+ unmap:
+	munmap(hdr, st.st_size);
+ bad:
+	err(ctx, "%s: not a counter page: %s\n", path, strerror(-rc));
+ err:
+	errno = -rc;
+	return NULL;
+}
 
-	memdev = calloc(1, sizeof(*memdev));
-	if (!memdev)
-		goto err_dev;
-	memdev->id = id;
-	memdev->ctx = ctx;
+CXL_EXPORT void cxl_counters_close(struct cxl_counters *c)
+{
+	if (!c)
+		return;
+	munmap(c->hdr, c->size);
+	free(c);
+}
 
-	sprintf(path, "/dev/cxl/%s", devname);
-	if (stat(path, &st) < 0)
-		goto err_read;
-	memdev->major = major(st.st_rdev);
-	memdev->minor = minor(st.st_rdev);
+/**
+ * cxl_counters_read - copy out the latest sample
+ * @c: page from cxl_counters_open()
+ * @buf: room for @nr readings
+ * @nr: size of @buf
+ * @time_ns: set to the sample's CLOCK_MONOTONIC time, may be NULL
+ *
+ * Copies up to @nr readings of one consistent sample without any system
+ * call. Returns how many readings the sample has, which may be more
+ * than @nr, -EAGAIN if the writer kept updating the page, or -ESTALE
+ * once the writer has exited, in which case the page should be opened
+ * again.
+ */
+CXL_EXPORT int cxl_counters_read(struct cxl_counters *c,
+		struct cxl_counter *buf, int nr, u64 *time_ns)
+{
+	struct cxl_counters_hdr *hdr = c->hdr;
+	const char *slots = (const char *) hdr + hdr->hdr_size;
+	u32 n, flags;
+	u64 seq, t;
+	int i, tries;
+
+	for (tries = 0; tries < 1000; tries++) {
+		seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		n = min(__atomic_load_n(&hdr->nr, __ATOMIC_RELAXED),
+				hdr->nr_slots);
+		flags = __atomic_load_n(&hdr->flags, __ATOMIC_RELAXED);
+		t = __atomic_load_n(&hdr->time_ns, __ATOMIC_RELAXED);
+		for (i = 0; i < (int) n && i < nr; i++)
+			memcpy(&buf[i], slots + (size_t) i * hdr->slot_size,
+					sizeof(*buf));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) != seq)
+			continue;
 
-	sprintf(path, "%s/pmem/size", cxlmem_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
-		goto err_read;
-	memdev->pmem_size = strtoull(buf, NULL, 0);
+		if (flags & CXL_COUNTERS_EXITED)
+			return -ESTALE;
+		if (time_ns)
+			*time_ns = t;
+		return n;
+	}
+	return -EAGAIN;
+}
 
-	sprintf(path, "%s/ram/size", cxlmem_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
-		goto err_read;
-	memdev->ram_size = strtoull(buf, NULL, 0);
+/**
+ * cxl_set_sysfs_root - enumerate memdevs from an alternate directory
+ * @ctx: cxl library context
+ * @path: directory holding memN device directories, NULL for the
+ *	 default of /sys/bus/cxl/devices
+ *
+ * Must be called before the first memdev lookup. Together with
+ * cxl_set_transport() this lets tests and benchmarks run against a
+ * simulated device tree. The CXL_SYSFS_ROOT environment variable names
+ * a directory standing in for /sys and provides the default of
+ * @path/bus/cxl/devices.
+ */
+CXL_EXPORT int cxl_set_sysfs_root(struct cxl_ctx *ctx, const char *path)
+{
+	char *p = NULL;
 
-	sprintf(path, "%s/payload_max", cxlmem_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
-		goto err_read;
-	memdev->payload_max = strtoull(buf, NULL, 0);
-	if (memdev->payload_max < 0)
-		goto err_read;
+	if (ctx->memdevs_init)
+		return -EBUSY;
+	if (path) {
+		p = strdup(path);
+		if (!p)
+			return -ENOMEM;
+	}
+	free(ctx->sysfs_root);
+	ctx->sysfs_root = p;
+	return 0;
+}
 
-	sprintf(path, "%s/label_storage_size", cxlmem_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
-		goto err_read;
-	memdev->lsa_size = strtoull(buf, NULL, 0);
-	if (memdev->lsa_size == ULLONG_MAX)
-		goto err_read;
+/**
+ * cxl_set_transport - route memdev ioctls to a caller supplied backend
+ * @ctx: cxl library context
+ * @fn: called with the memdev, the ioctl request and its argument in
+ *	place of ioctl() on /dev/cxl/<memdev>, NULL to restore the default
+ * @data: passed through to @fn
+ *
+ * @fn returns 0 or a negative errno, and fills in the query or send
+ * command exactly as the kernel would. No device node is opened while
+ * a transport is installed.
+ */
+CXL_EXPORT void cxl_set_transport(struct cxl_ctx *ctx, cxl_transport_fn fn,
+		void *data)
+{
+	ctx->transport = fn;
+	ctx->transport_data = data;
+}
 
-	memdev->dev_path = strdup(cxlmem_base);
-	if (!memdev->dev_path)
-		goto err_read;
+/**
+ * cxl_set_vendor_output - receive vendor command results as fields
+ * @ctx: cxl library context
+ * @fn: called once per decoded output field, or array element, in
+ *	place of the text the cxl_memdev_<cmd>() helpers print, NULL to
+ *	restore the text
+ * @data: passed through to @fn
+ *
+ * Covers the vendor commands with a known output layout. Helpers that
+ * decode their output by hand keep printing text.
+ */
+CXL_EXPORT void cxl_set_vendor_output(struct cxl_ctx *ctx,
+		cxl_vendor_output_fn fn, void *data)
+{
+	ctx->vendor_output = fn;
+	ctx->vendor_output_data = data;
+}
 
-	sprintf(path, "%s/firmware_version", cxlmem_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
-		goto err_read;
+/*
+ * Thread safety: once a list or a cached attribute has been built it is
+ * only read, so lookups from several threads need no locking. Building
+ * it is serialized as follows.
+ *
+ * Lists and loaded objects carry an init state. The thread that builds
+ * one holds ctx->init_lock, which is recursive so the builder can call
+ * back into lookups, and marks it done only when it is complete.
+ * Readers that find it done never take the lock.
+ *
+ * Single cached values are computed without a lock and published with
+ * a compare and swap. A thread that loses the race frees its own copy
+ * and uses the winner's.
+ *
+ * Invalidation, such as re-enumeration or firmware activation, is not
+ * covered. Callers must keep it away from concurrent readers.
+ */
+enum {
+	CXL_INIT_NONE,
+	CXL_INIT_BUSY,
+	CXL_INIT_DONE,
+};
 
-	memdev->firmware_version = strdup(buf);
-	if (!memdev->firmware_version)
-		goto err_read;
+/* true when the caller must build the state and then call cxl_init_end() */
+static bool cxl_init_begin(struct cxl_ctx *ctx, int *state)
+{
+	if (__atomic_load_n(state, __ATOMIC_ACQUIRE) == CXL_INIT_DONE)
+		return false;
+	pthread_mutex_lock(&ctx->init_lock);
+	if (*state != CXL_INIT_NONE) {
+		pthread_mutex_unlock(&ctx->init_lock);
+		return false;
+	}
+	*state = CXL_INIT_BUSY;
+	return true;
+}
+
+static void cxl_init_end(struct cxl_ctx *ctx, int *state)
+{
+	__atomic_store_n(state, CXL_INIT_DONE, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ctx->init_lock);
+}
+
+/* publish @val in @slot unless another thread got there first */
+#define cxl_publish(slot, val, release) \
+({ \
+	typeof(*(slot)) __old = NULL; \
+	if (!__atomic_compare_exchange_n((slot), &__old, (val), false, \
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) { \
+		release(val); \
+		(val) = __old; \
+	} \
+	(val); \
+})
+
+static bool memdev_has_attr(struct cxl_memdev *memdev, unsigned int attr)
+{
+	return __atomic_load_n(&memdev->attrs, __ATOMIC_ACQUIRE) & attr;
+}
+
+static void memdev_set_attr(struct cxl_memdev *memdev, unsigned int attr)
+{
+	__atomic_fetch_or(&memdev->attrs, attr, __ATOMIC_RELEASE);
+}
+
+static void memdev_clear_attr(struct cxl_memdev *memdev, unsigned int attr)
+{
+	__atomic_fetch_and(&memdev->attrs, ~attr, __ATOMIC_RELEASE);
+}
+
+static void *add_cxl_memdev(void *parent, int id, const char *cxlmem_base)
+{
+	struct cxl_ctx *ctx = parent;
+	struct cxl_memdev *memdev, *memdev_dup;
+	int fd;
+
+	dbg(ctx, "%s: base: \'%s\'\n", __func__, cxlmem_base);
+
+	memdev = calloc(1, sizeof(*memdev));
+	if (!memdev)
+		return NULL;
+	memdev->id = id;
+	memdev->ctx = ctx;
+	memdev->fd = -1;
+	memdev->sysfs_fd = -1;
+	list_head_init(&memdev->spd_cache);
 
-	memdev->dev_buf = calloc(1, strlen(cxlmem_base) + 50);
-	if (!memdev->dev_buf)
+	memdev->dev_path = strdup(cxlmem_base);
+	if (!memdev->dev_path)
 		goto err_read;
-	memdev->buf_len = strlen(cxlmem_base) + 50;
 
 	cxl_memdev_foreach(ctx, memdev_dup)
 		if (memdev_dup->id == memdev->id) {
+			/*
+			 * The device may have been re-probed since the
+			 * command table and attributes were cached, re-read
+			 * them on next use.
+			 */
+			free(memdev_dup->query_cmd);
+			memdev_dup->query_cmd = NULL;
+			free(memdev_dup->firmware_version);
+			memdev_dup->firmware_version = NULL;
+			cxl_memdev_spd_flush(memdev_dup);
+			cxl_memdev_inventory_flush(memdev_dup, false);
+			free(memdev_dup->cel);
+			memdev_dup->cel = NULL;
+			fd = __atomic_exchange_n(&memdev_dup->sysfs_fd, -1,
+					__ATOMIC_ACQ_REL);
+			if (fd >= 0)
+				close(fd);
+			__atomic_store_n(&memdev_dup->attrs, 0, __ATOMIC_RELEASE);
 			free_memdev(memdev, NULL);
-			free(path);
 			return memdev_dup;
 		}
 
 	list_add(&ctx->memdevs, &memdev->list);
-	free(path);
 	return memdev;
 
  err_read:
-	free(memdev->firmware_version);
-	free(memdev->dev_buf);
 	free(memdev->dev_path);
 	free(memdev);
- err_dev:
-	free(path);
 	return NULL;
 }
 
-static void cxl_memdevs_init(struct cxl_ctx *ctx)
+/*
+ * Only the device name is resolved at enumeration time. Everything else
+ * is read from sysfs, or stat()ed from /dev/cxl, on first use and cached,
+ * so that targeting one memdev does not pay for every memdev's attributes.
+ * Failed reads are not cached and are retried by the next caller.
+ */
+/*
+ * The device directory is opened once and every attribute is read
+ * relative to it, so repeat reads skip the path walk through sysfs.
+ */
+static int memdev_sysfs_fd(struct cxl_memdev *memdev)
 {
-	if (ctx->memdevs_init)
-		return;
-
-	ctx->memdevs_init = 1;
+	int fd = __atomic_load_n(&memdev->sysfs_fd, __ATOMIC_ACQUIRE);
+	int old = -1;
 
-	sysfs_device_parse(ctx, "/sys/bus/cxl/devices", "mem", ctx,
-			   add_cxl_memdev);
+	if (fd >= 0)
+		return fd;
+	fd = sysfs_open_dev(memdev->ctx, memdev->dev_path);
+	if (fd < 0)
+		return fd;
+	if (!__atomic_compare_exchange_n(&memdev->sysfs_fd, &old, fd, false,
+				__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		close(fd);
+		fd = old;
+	}
+	return fd;
 }
 
-CXL_EXPORT struct cxl_ctx *cxl_memdev_get_ctx(struct cxl_memdev *memdev)
+static int memdev_read_attr(struct cxl_memdev *memdev, const char *attr,
+		char *buf)
 {
-	return memdev->ctx;
+	int fd = memdev_sysfs_fd(memdev);
+
+	if (fd < 0)
+		return fd;
+	return sysfs_read_attr_at(memdev->ctx, fd, attr, buf);
 }
 
-CXL_EXPORT struct cxl_memdev *cxl_memdev_get_first(struct cxl_ctx *ctx)
+static int memdev_read_ull(struct cxl_memdev *memdev, const char *name,
+		unsigned long long *val)
 {
-	cxl_memdevs_init(ctx);
-
-	return list_top(&ctx->memdevs, struct cxl_memdev, list);
+	char buf[SYSFS_ATTR_SIZE];
+	unsigned long long v;
+
+	if (memdev_read_attr(memdev, name, buf) < 0)
+		return -ENXIO;
+	v = strtoull(buf, NULL, 0);
+	if (v == ULLONG_MAX)
+		return -ENXIO;
+	*val = v;
+	return 0;
 }
 
-CXL_EXPORT struct cxl_memdev *cxl_memdev_get_next(struct cxl_memdev *memdev)
+/* the value is stored before @attr is set, so readers never see it torn */
+static int memdev_load_ull(struct cxl_memdev *memdev, unsigned int attr,
+		const char *name, unsigned long long *val)
 {
-	struct cxl_ctx *ctx = memdev->ctx;
+	unsigned long long v;
 
-	return list_next(&ctx->memdevs, memdev, list);
+	if (memdev_has_attr(memdev, attr))
+		return 0;
+	if (memdev_read_ull(memdev, name, &v) < 0)
+		return -ENXIO;
+	*val = v;
+	memdev_set_attr(memdev, attr);
+	return 0;
 }
 
-CXL_EXPORT int cxl_memdev_get_id(struct cxl_memdev *memdev)
+static int memdev_load_devt(struct cxl_memdev *memdev)
 {
-	return memdev->id;
-}
+	char path[PATH_MAX];
+	struct stat st;
 
-CXL_EXPORT const char *cxl_memdev_get_devname(struct cxl_memdev *memdev)
-{
-	return devpath_to_devname(memdev->dev_path);
-}
+	if (memdev_has_attr(memdev, CXL_MEMDEV_ATTR_DEVT))
+		return 0;
 
-CXL_EXPORT int cxl_memdev_get_major(struct cxl_memdev *memdev)
-{
-	return memdev->major;
+	snprintf(path, sizeof(path), "/dev/cxl/%s",
+			cxl_memdev_get_devname(memdev));
+	if (stat(path, &st) < 0)
+		return -errno;
+	memdev->major = major(st.st_rdev);
+	memdev->minor = minor(st.st_rdev);
+	memdev_set_attr(memdev, CXL_MEMDEV_ATTR_DEVT);
+	return 0;
 }
 
-CXL_EXPORT int cxl_memdev_get_minor(struct cxl_memdev *memdev)
+static int memdev_payload_max(struct cxl_memdev *memdev)
 {
-	return memdev->minor;
-}
+	unsigned long long v;
 
-CXL_EXPORT unsigned long long cxl_memdev_get_pmem_size(struct cxl_memdev *memdev)
-{
-	return memdev->pmem_size;
+	if (memdev_has_attr(memdev, CXL_MEMDEV_ATTR_PAYLOAD_MAX))
+		return memdev->payload_max;
+	if (memdev_read_ull(memdev, "payload_max", &v) < 0 || v > INT_MAX)
+		return 0;
+	memdev->payload_max = v;
+	memdev_set_attr(memdev, CXL_MEMDEV_ATTR_PAYLOAD_MAX);
+	return memdev->payload_max;
 }
 
-CXL_EXPORT unsigned long long cxl_memdev_get_ram_size(struct cxl_memdev *memdev)
+static void memdev_load_attrs(struct cxl_memdev *memdev)
 {
-	return memdev->ram_size;
+	memdev_load_devt(memdev);
+	memdev_payload_max(memdev);
+	cxl_memdev_get_pmem_size(memdev);
+	cxl_memdev_get_ram_size(memdev);
+	cxl_memdev_get_lsa_size(memdev);
+	cxl_memdev_get_firmware_verison(memdev);
 }
 
-CXL_EXPORT const char *cxl_memdev_get_firmware_verison(struct cxl_memdev *memdev)
+struct cxl_memdev_prefetch {
+	pthread_mutex_t lock;
+	struct cxl_memdev **memdevs;
+	int nr, next;
+};
+
+static void *cxl_memdev_prefetch_run(void *arg)
 {
-	return memdev->firmware_version;
+	struct cxl_memdev_prefetch *pf = arg;
+	int i;
+
+	for (;;) {
+		pthread_mutex_lock(&pf->lock);
+		i = pf->next++;
+		pthread_mutex_unlock(&pf->lock);
+		if (i >= pf->nr)
+			break;
+		memdev_load_attrs(pf->memdevs[i]);
+	}
+
+	return NULL;
 }
 
-CXL_EXPORT size_t cxl_memdev_get_lsa_size(struct cxl_memdev *memdev)
+/* clamp a thread count to the cxl_set_max_threads() ceiling */
+static int cxl_threads(struct cxl_ctx *ctx, int nr)
 {
-	return memdev->lsa_size;
+	if (ctx->max_threads && nr > ctx->max_threads)
+		return ctx->max_threads;
+	return nr;
 }
 
-CXL_EXPORT int cxl_memdev_is_active(struct cxl_memdev *memdev)
+/*
+ * Read the attributes of @nr memdevs from up to ctx->enum_threads
+ * threads, within the cxl_set_max_threads() bound. The calling thread
+ * takes part, so failing to start a thread only costs parallelism.
+ */
+static void cxl_memdevs_prefetch(struct cxl_ctx *ctx,
+		struct cxl_memdev **memdevs, int nr)
 {
-	/*
-	 * TODO: Currently memdevs are always considered inactive. Once we have
-	 * cxl_bus drivers that are bound/unbound to memdevs, we'd use that to
-	 * determine the active/inactive state.
-	 */
-	return 0;
+	struct cxl_memdev_prefetch pf = {
+		.memdevs = memdevs,
+		.nr = nr,
+	};
+	int i, nr_threads = cxl_threads(ctx, min(ctx->enum_threads, nr)) - 1;
+	pthread_t *threads;
+
+	threads = calloc(max(nr_threads, 1), sizeof(*threads));
+	if (!threads)
+		nr_threads = 0;
+
+	pthread_mutex_init(&pf.lock, NULL);
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, cxl_memdev_prefetch_run,
+					&pf))
+			break;
+	nr_threads = i;
+
+	cxl_memdev_prefetch_run(&pf);
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&pf.lock);
+	free(threads);
 }
 
-CXL_EXPORT void cxl_cmd_unref(struct cxl_cmd *cmd)
+static const char *cxl_devices_path(struct cxl_ctx *ctx)
 {
-	if (!cmd)
-		return;
-	if (--cmd->refcount == 0) {
-		free(cmd->query_cmd);
-		free(cmd->send_cmd);
-		free(cmd->input_payload);
-		free(cmd->output_payload);
-		free(cmd);
-	}
+	return ctx->sysfs_root ?: "/sys/bus/cxl/devices";
 }
 
-CXL_EXPORT void cxl_cmd_ref(struct cxl_cmd *cmd)
+static int memdev_cmp(const void *a, const void *b)
 {
-	cmd->refcount++;
+	const struct cxl_memdev *x = *(struct cxl_memdev * const *)a;
+	const struct cxl_memdev *y = *(struct cxl_memdev * const *)b;
+
+	return x->id - y->id;
 }
 
-static int cxl_cmd_alloc_query(struct cxl_cmd *cmd, int num_cmds)
+static void __cxl_memdevs_init(struct cxl_ctx *ctx)
 {
-	size_t size;
+	struct cxl_memdev *memdev, **memdevs;
+	int i, nr = 0;
 
-	if (!cmd)
-		return -EINVAL;
+	sysfs_device_parse(ctx, cxl_devices_path(ctx), "mem", ctx,
+			   add_cxl_memdev);
 
-	if (cmd->query_cmd != NULL)
-		free(cmd->query_cmd);
+	/* keep iteration order independent of readdir() order */
+	cxl_memdev_foreach(ctx, memdev)
+		nr++;
+	if (nr < 2)
+		return;
 
-	size = sizeof(struct cxl_mem_query_commands) +
-			(num_cmds * sizeof(struct cxl_command_info));
-	cmd->query_cmd = calloc(1, size);
-	if (!cmd->query_cmd)
-		return -ENOMEM;
+	memdevs = calloc(nr, sizeof(*memdevs));
+	if (!memdevs)
+		return;
 
-	cmd->query_cmd->n_commands = num_cmds;
+	i = 0;
+	while ((memdev = list_pop(&ctx->memdevs, struct cxl_memdev, list)))
+		memdevs[i++] = memdev;
+	qsort(memdevs, nr, sizeof(*memdevs), memdev_cmp);
+	for (i = 0; i < nr; i++)
+		list_add_tail(&ctx->memdevs, &memdevs[i]->list);
 
-	return 0;
+	if (ctx->enum_threads > 1)
+		cxl_memdevs_prefetch(ctx, memdevs, nr);
+	free(memdevs);
 }
 
-static struct cxl_cmd *cxl_cmd_new(struct cxl_memdev *memdev)
+static void cxl_memdevs_init(struct cxl_ctx *ctx)
 {
-	struct cxl_cmd *cmd;
-	size_t size;
+	if (cxl_init_begin(ctx, &ctx->memdevs_init)) {
+		usdt(libcxl, enumerate_start, ctx);
+		__cxl_memdevs_init(ctx);
+		usdt(libcxl, enumerate_done, ctx);
+		cxl_init_end(ctx, &ctx->memdevs_init);
+	}
+}
 
-	size = sizeof(*cmd);
-	cmd = calloc(1, size);
-	if (!cmd)
-		return NULL;
+/**
+ * cxl_set_enum_threads - read memdev attributes in parallel
+ * @ctx: cxl library context
+ * @nr_threads: number of threads, 0 or 1 for serial enumeration
+ *
+ * Memdev attributes are normally read from sysfs on first use. With
+ * @nr_threads > 1 the first walk of the memdev list instead prefetches
+ * every memdev's attributes from a bounded pool of threads, which
+ * speeds up listing hosts with many memdevs. Must be set before the
+ * first cxl_memdev_get_first(). The CXL_ENUM_THREADS environment
+ * variable provides the default.
+ */
+CXL_EXPORT void cxl_set_enum_threads(struct cxl_ctx *ctx, int nr_threads)
+{
+	ctx->enum_threads = min(max(nr_threads, 0), CXL_ENUM_THREADS_MAX);
+}
 
-	cxl_cmd_ref(cmd);
-	cmd->memdev = memdev;
+/**
+ * cxl_set_max_threads - bound the threads the library starts
+ * @ctx: cxl library context
+ * @nr_threads: most threads any one call runs at once, the calling one
+ *	included, 0 for no bound
+ *
+ * Applies on top of cxl_set_enum_threads(). The cxl tool sets it from
+ * its top level '-j' option.
+ */
+CXL_EXPORT void cxl_set_max_threads(struct cxl_ctx *ctx, int nr_threads)
+{
+	ctx->max_threads = max(nr_threads, 0);
+}
 
-	return cmd;
+/**
+ * cxl_set_spd_cache_dir - persist DIMM SPD contents across processes
+ * @ctx: cxl library context
+ * @dir: directory to keep SPD images in, e.g. /run/cxl/spd, or NULL
+ *
+ * SPD contents read by cxl_memdev_get_spd() are always cached on the
+ * memdev for the life of @ctx. With a cache directory they are also
+ * saved there, keyed by memdev serial number, and later contexts load
+ * them from there instead of the mailbox. Use a tmpfs such as /run so
+ * the cache does not outlive a reboot, which is when DIMMs can change.
+ * The CXL_SPD_CACHE_DIR environment variable provides the default.
+ */
+CXL_EXPORT int cxl_set_spd_cache_dir(struct cxl_ctx *ctx, const char *dir)
+{
+	char *d = NULL;
+
+	if (dir) {
+		d = strdup(dir);
+		if (!d)
+			return -ENOMEM;
+	}
+	free(ctx->spd_cache_dir);
+	ctx->spd_cache_dir = d;
+	return 0;
 }
 
-static int __do_cmd(struct cxl_cmd *cmd, int ioctl_cmd, int fd)
+/**
+ * cxl_set_inventory_cache_dir - persist memdev inventory across processes
+ * @ctx: cxl library context
+ * @dir: directory to keep inventory files in, e.g. /run/cxl, or NULL
+ *
+ * Like cxl_set_spd_cache_dir(), but for the identify, device info,
+ * firmware info and DIMM slot info responses behind
+ * cxl_memdev_get_inventory(). Each file records the sysfs
+ * firmware_version it was read under and is discarded once that
+ * changes or a firmware activation is issued through this library.
+ * The CXL_INVENTORY_CACHE_DIR environment variable provides the default.
+ */
+CXL_EXPORT int cxl_set_inventory_cache_dir(struct cxl_ctx *ctx,
+		const char *dir)
 {
-	void *cmd_buf;
-	int rc;
+	char *d = NULL;
 
-	switch (ioctl_cmd) {
-	case CXL_MEM_QUERY_COMMANDS:
-		cmd_buf = cmd->query_cmd;
-		break;
-	case CXL_MEM_SEND_COMMAND:
-		cmd_buf = cmd->send_cmd;
-		if (cxl_get_log_priority(cmd->memdev->ctx) == LOG_DEBUG)
-		{
-			hexdump_mbox(cmd, cmd->memdev->ctx);
-		}
-		break;
-	default:
-		return -EINVAL;
+	if (dir) {
+		d = strdup(dir);
+		if (!d)
+			return -ENOMEM;
 	}
-	rc = ioctl(fd, ioctl_cmd, cmd_buf);
-	if (rc < 0)
-		rc = -errno;
+	free(ctx->inventory_cache_dir);
+	ctx->inventory_cache_dir = d;
+	return 0;
+}
 
-	return rc;
+/**
+ * cxl_set_opcode_check - fail raw commands the device does not list
+ * @ctx: cxl library context
+ * @enable: non-zero to consult the Command Effects Log, 0 to skip it
+ *
+ * By default cxl_cmd_new_raw() reads each memdev's Command Effects Log
+ * once and fails with EOPNOTSUPP, without a mailbox round trip, for
+ * opcodes it does not list. Disable this for firmware whose CEL is
+ * known to be incomplete. The CXL_OPCODE_CHECK environment variable
+ * provides the default.
+ */
+CXL_EXPORT void cxl_set_opcode_check(struct cxl_ctx *ctx, int enable)
+{
+	ctx->opcode_check = !!enable;
 }
 
-static int do_cmd(struct cxl_cmd *cmd, int ioctl_cmd)
+CXL_EXPORT struct cxl_ctx *cxl_memdev_get_ctx(struct cxl_memdev *memdev)
 {
-	char *path;
-	struct stat st;
-	unsigned int major, minor;
-	int rc = 0, fd;
-	struct cxl_memdev *memdev = cmd->memdev;
-	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
-	const char *devname = cxl_memdev_get_devname(memdev);
+	return memdev->ctx;
+}
 
-	major = cxl_memdev_get_major(memdev);
-	minor = cxl_memdev_get_minor(memdev);
+CXL_EXPORT struct cxl_memdev *cxl_memdev_get_first(struct cxl_ctx *ctx)
+{
+	cxl_memdevs_init(ctx);
 
-	if (asprintf(&path, "/dev/cxl/%s", devname) < 0)
-		return -ENOMEM;
+	return list_top(&ctx->memdevs, struct cxl_memdev, list);
+}
 
-	fd = open(path, O_RDWR);
-	if (fd < 0) {
-		err(ctx, "failed to open %s: %s\n", path, strerror(errno));
-		rc = -errno;
-		goto out;
-	}
+CXL_EXPORT struct cxl_memdev *cxl_memdev_get_next(struct cxl_memdev *memdev)
+{
+	struct cxl_ctx *ctx = memdev->ctx;
 
-	if (fstat(fd, &st) >= 0 && S_ISCHR(st.st_mode)
-			&& major(st.st_rdev) == major
-			&& minor(st.st_rdev) == minor) {
-		rc = __do_cmd(cmd, ioctl_cmd, fd);
-	} else {
-		err(ctx, "failed to validate %s as a CXL memdev node\n", path);
-		rc = -ENXIO;
-	}
-	close(fd);
-out:
-	free(path);
-	return rc;
+	return list_next(&ctx->memdevs, memdev, list);
 }
 
-static int alloc_do_query(struct cxl_cmd *cmd, int num_cmds)
+/*
+ * CXL topology: ports, their decoders, and regions. One pass over the
+ * bus directory lists every object by name; attributes are read per
+ * object the first time any of its getters is called.
+ */
+static int cxl_topo_read_attr(struct cxl_ctx *ctx, const char *dev_path,
+		const char *attr, char *buf)
 {
-	struct cxl_ctx *ctx = cxl_memdev_get_ctx(cmd->memdev);
-	int rc;
-
-	rc = cxl_cmd_alloc_query(cmd, num_cmds);
-	if (rc)
-		return rc;
+	char path[PATH_MAX];
 
-	rc = do_cmd(cmd, CXL_MEM_QUERY_COMMANDS);
-	if (rc < 0)
-		err(ctx, "%s: query commands failed: %s\n",
-			cxl_memdev_get_devname(cmd->memdev),
-			strerror(-rc));
-	return rc;
+	if (snprintf(path, sizeof(path), "%s/%s", dev_path, attr)
+			>= (int) sizeof(path))
+		return -ENOMEM;
+	return sysfs_read_attr(ctx, path, buf);
 }
 
-static int cxl_cmd_do_query(struct cxl_cmd *cmd)
+/* loaders read many attributes at once, relative to a handle on the device */
+static unsigned long long cxl_topo_read_ull(struct cxl_ctx *ctx, int dirfd,
+		const char *attr)
 {
-	struct cxl_memdev *memdev = cmd->memdev;
-	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
-	const char *devname = cxl_memdev_get_devname(memdev);
-	int rc, n_commands;
+	char buf[SYSFS_ATTR_SIZE];
 
-	switch (cmd->query_status) {
-	case CXL_CMD_QUERY_OK:
-		return 0;
-	case CXL_CMD_QUERY_UNSUPPORTED:
-		return -EOPNOTSUPP;
-	case CXL_CMD_QUERY_NOT_RUN:
-		break;
-	default:
-		err(ctx, "%s: Unknown query_status %d\n",
-			devname, cmd->query_status);
-		return -EINVAL;
-	}
+	if (sysfs_read_attr_at(ctx, dirfd, attr, buf) < 0)
+		return ULLONG_MAX;
+	return strtoull(buf, NULL, 0);
+}
 
-	rc = alloc_do_query(cmd, 0);
-	if (rc)
-		return rc;
+static char *cxl_topo_read_str(struct cxl_ctx *ctx, int dirfd,
+		const char *attr)
+{
+	char buf[SYSFS_ATTR_SIZE];
 
-	n_commands = cmd->query_cmd->n_commands;
-	dbg(ctx, "%s: supports %d commands\n", devname, n_commands);
+	if (sysfs_read_attr_at(ctx, dirfd, attr, buf) < 0)
+		return NULL;
+	return strdup(buf);
+}
 
-	return alloc_do_query(cmd, n_commands);
+static void free_decoder(struct cxl_decoder *decoder)
+{
+	free(decoder->target_list);
+	free(decoder->mode);
+	free(decoder->dev_path);
+	free(decoder);
 }
 
-static int cxl_cmd_validate(struct cxl_cmd *cmd, u32 cmd_id)
+static void free_port(struct cxl_port *port)
 {
-	struct cxl_memdev *memdev = cmd->memdev;
-	struct cxl_mem_query_commands *query = cmd->query_cmd;
-	const char *devname = cxl_memdev_get_devname(memdev);
-	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
-	u32 i;
+	struct cxl_decoder *decoder;
 
-	for (i = 0; i < query->n_commands; i++) {
-		struct cxl_command_info *cinfo = &query->commands[i];
-		const char *cmd_name = cxl_command_names[cinfo->id].name;
+	while ((decoder = list_pop(&port->decoders, struct cxl_decoder, list)))
+		free_decoder(decoder);
+	free(port->host);
+	free(port->dev_path);
+	free(port);
+}
 
-		if (cinfo->id != cmd_id)
-			continue;
+static void free_region(struct cxl_region *region)
+{
+	int i;
 
-		dbg(ctx, "%s: %s: in: %d, out %d, flags: %#08x\n",
-			devname, cmd_name, cinfo->size_in,
-			cinfo->size_out, cinfo->flags);
+	if (region->targets)
+		for (i = 0; i < region->interleave_ways; i++)
+			free(region->targets[i]);
+	free(region->targets);
+	free(region->uuid);
+	free(region->mode);
+	free(region->dev_path);
+	free(region);
+}
 
-		cmd->query_idx = i;
-		cmd->query_status = CXL_CMD_QUERY_OK;
-		return 0;
-	}
-	cmd->query_status = CXL_CMD_QUERY_UNSUPPORTED;
-	return -EOPNOTSUPP;
+static void cxl_topology_free(struct cxl_ctx *ctx)
+{
+	struct cxl_region *region;
+	struct cxl_port *port;
+
+	while ((port = list_pop(&ctx->ports, struct cxl_port, list)))
+		free_port(port);
+	while ((region = list_pop(&ctx->regions, struct cxl_region, list)))
+		free_region(region);
 }
 
-CXL_EXPORT int cxl_cmd_set_input_payload(struct cxl_cmd *cmd, void *buf,
-		int size)
+static char *cxl_topo_path(struct cxl_ctx *ctx, const char *name)
 {
-	struct cxl_memdev *memdev = cmd->memdev;
+	char *path;
 
-	if (size > memdev->payload_max || size < 0)
-		return -EINVAL;
+	if (asprintf(&path, "%s/%s", cxl_devices_path(ctx), name) < 0)
+		return NULL;
+	return path;
+}
 
-	if (!buf) {
+static void add_cxl_port(struct cxl_ctx *ctx, const char *name, int id,
+		enum cxl_port_type type)
+{
+	struct cxl_port *port = calloc(1, sizeof(*port));
 
-		/* If the user didn't supply a buffer, allocate it */
-		cmd->input_payload = calloc(1, size);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-	} else {
-		/*
-		 * Use user-buffer as is. If an automatic allocation was
-		 * previously made (based on a fixed size from query),
-		 * it will get freed during unref.
-		 */
-		cmd->send_cmd->in.payload = (u64)buf;
+	if (!port)
+		return;
+	port->dev_path = cxl_topo_path(ctx, name);
+	if (!port->dev_path) {
+		free(port);
+		return;
 	}
-	cmd->send_cmd->in.size = size;
-
-	return 0;
+	port->id = id;
+	port->type = type;
+	port->ctx = ctx;
+	list_head_init(&port->decoders);
+	list_add_tail(&ctx->ports, &port->list);
 }
 
-CXL_EXPORT int cxl_cmd_set_output_payload(struct cxl_cmd *cmd, void *buf,
-		int size)
+static struct cxl_region *add_cxl_region(struct cxl_ctx *ctx,
+		const char *name, int id)
 {
-	struct cxl_memdev *memdev = cmd->memdev;
+	struct cxl_region *region = calloc(1, sizeof(*region));
 
-	if (size > memdev->payload_max || size < 0)
-		return -EINVAL;
+	if (!region)
+		return NULL;
+	region->dev_path = cxl_topo_path(ctx, name);
+	if (!region->dev_path) {
+		free(region);
+		return NULL;
+	}
+	region->id = id;
+	region->ctx = ctx;
+	list_add_tail(&ctx->regions, &region->list);
+	return region;
+}
 
-	if (!buf) {
+#define cxl_topo_sort(head, type, cmp) \
+do { \
+	type *_obj, **_objs; \
+	int _i = 0, _nr = 0; \
+	list_for_each(head, _obj, list) \
+		_nr++; \
+	_objs = _nr > 1 ? calloc(_nr, sizeof(*_objs)) : NULL; \
+	if (!_objs) \
+		break; \
+	while ((_obj = list_pop(head, type, list))) \
+		_objs[_i++] = _obj; \
+	qsort(_objs, _nr, sizeof(*_objs), cmp); \
+	for (_i = 0; _i < _nr; _i++) \
+		list_add_tail(head, &_objs[_i]->list); \
+	free(_objs); \
+} while (0)
 
-		/* If the user didn't supply a buffer, allocate it */
-		cmd->output_payload = calloc(1, size);
-		if (!cmd->output_payload)
-			return -ENOMEM;
-		cmd->send_cmd->out.payload = (u64)cmd->output_payload;
-	} else {
-		/*
-		 * Use user-buffer as is. If an automatic allocation was
-		 * previously made (based on a fixed size from query),
-		 * it will get freed during unref.
-		 */
-		cmd->send_cmd->out.payload = (u64)buf;
-	}
-	cmd->send_cmd->out.size = size;
+static int port_cmp(const void *a, const void *b)
+{
+	const struct cxl_port *x = *(struct cxl_port * const *)a;
+	const struct cxl_port *y = *(struct cxl_port * const *)b;
 
-	return 0;
+	return x->id - y->id;
 }
 
-static int cxl_cmd_alloc_send(struct cxl_cmd *cmd, u32 cmd_id)
+static int decoder_cmp(const void *a, const void *b)
 {
-	struct cxl_mem_query_commands *query = cmd->query_cmd;
-	struct cxl_command_info *cinfo = &query->commands[cmd->query_idx];
-	size_t size;
+	const struct cxl_decoder *x = *(struct cxl_decoder * const *)a;
+	const struct cxl_decoder *y = *(struct cxl_decoder * const *)b;
 
-	if (!query)
-		return -EINVAL;
+	return x->id - y->id;
+}
 
-	size = sizeof(struct cxl_send_command);
-	cmd->send_cmd = calloc(1, size);
-	if (!cmd->send_cmd)
-		return -ENOMEM;
+static int region_cmp(const void *a, const void *b)
+{
+	const struct cxl_region *x = *(struct cxl_region * const *)a;
+	const struct cxl_region *y = *(struct cxl_region * const *)b;
 
-	if (cinfo->id != cmd_id)
-		return -EINVAL;
+	return x->id - y->id;
+}
 
-	cmd->send_cmd->id = cmd_id;
+static void __cxl_topology_init(struct cxl_ctx *ctx)
+{
+	struct dirent *de;
+	DIR *dir;
+	int id;
 
-	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
+	dir = opendir(cxl_devices_path(ctx));
+	if (!dir) {
+		dbg(ctx, "no cxl topology found\n");
+		return;
+	}
+	while ((de = readdir(dir)) != NULL) {
+		if (sscanf(de->d_name, "root%d", &id) == 1)
+			add_cxl_port(ctx, de->d_name, id, CXL_PORT_ROOT);
+		else if (sscanf(de->d_name, "port%d", &id) == 1)
+			add_cxl_port(ctx, de->d_name, id, CXL_PORT_SWITCH);
+		else if (sscanf(de->d_name, "endpoint%d", &id) == 1)
+			add_cxl_port(ctx, de->d_name, id, CXL_PORT_ENDPOINT);
+		else if (sscanf(de->d_name, "region%d", &id) == 1)
+			add_cxl_region(ctx, de->d_name, id);
 	}
+	closedir(dir);
 
-	if (cinfo->size_out < 0)
-		cinfo->size_out = cmd->memdev->payload_max; // -1 will require update
+	cxl_topo_sort(&ctx->ports, struct cxl_port, port_cmp);
+	cxl_topo_sort(&ctx->regions, struct cxl_region, region_cmp);
+}
 
-	if (cinfo->size_out > 0) {
-		cmd->output_payload = calloc(1, cinfo->size_out);
-		if (!cmd->output_payload)
-			return -ENOMEM;
-		cmd->send_cmd->out.payload = (u64)cmd->output_payload;
-		cmd->send_cmd->out.size = cinfo->size_out;
+static void cxl_topology_init(struct cxl_ctx *ctx)
+{
+	if (cxl_init_begin(ctx, &ctx->topology_init)) {
+		__cxl_topology_init(ctx);
+		cxl_init_end(ctx, &ctx->topology_init);
 	}
+}
 
-	return 0;
+CXL_EXPORT struct cxl_port *cxl_port_get_first(struct cxl_ctx *ctx)
+{
+	cxl_topology_init(ctx);
+
+	return list_top(&ctx->ports, struct cxl_port, list);
 }
 
-static struct cxl_cmd *cxl_cmd_new_generic(struct cxl_memdev *memdev,
-		u32 cmd_id)
+CXL_EXPORT struct cxl_port *cxl_port_get_next(struct cxl_port *port)
 {
-	const char *devname = cxl_memdev_get_devname(memdev);
-	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
-	struct cxl_cmd *cmd;
-	int rc;
+	return list_next(&port->ctx->ports, port, list);
+}
 
-	cmd = cxl_cmd_new(memdev);
-	if (!cmd)
-		return NULL;
+CXL_EXPORT struct cxl_ctx *cxl_port_get_ctx(struct cxl_port *port)
+{
+	return port->ctx;
+}
 
-	rc = cxl_cmd_do_query(cmd);
-	if (rc) {
-		err(ctx, "%s: query returned: %s\n", devname, strerror(-rc));
-		goto fail;
-	}
+CXL_EXPORT int cxl_port_get_id(struct cxl_port *port)
+{
+	return port->id;
+}
 
-	rc = cxl_cmd_validate(cmd, cmd_id);
-	if (rc) {
-		errno = -rc;
-		goto fail;
-	}
+CXL_EXPORT const char *cxl_port_get_devname(struct cxl_port *port)
+{
+	return devpath_to_devname(port->dev_path);
+}
 
-	rc = cxl_cmd_alloc_send(cmd, cmd_id);
-	if (rc) {
-		errno = -rc;
-		goto fail;
-	}
+CXL_EXPORT int cxl_port_is_root(struct cxl_port *port)
+{
+	return port->type == CXL_PORT_ROOT;
+}
 
-	return cmd;
+CXL_EXPORT int cxl_port_is_switch(struct cxl_port *port)
+{
+	return port->type == CXL_PORT_SWITCH;
+}
 
-fail:
-	cxl_cmd_unref(cmd);
+CXL_EXPORT int cxl_port_is_endpoint(struct cxl_port *port)
+{
+	return port->type == CXL_PORT_ENDPOINT;
+}
+
+static struct cxl_port *cxl_port_find(struct cxl_ctx *ctx, const char *name)
+{
+	struct cxl_port *port;
+
+	cxl_port_foreach(ctx, port)
+		if (strcmp(cxl_port_get_devname(port), name) == 0)
+			return port;
 	return NULL;
 }
 
-CXL_EXPORT const char *cxl_cmd_get_devname(struct cxl_cmd *cmd)
+static struct cxl_port *cxl_port_find_id(struct cxl_ctx *ctx, int id)
 {
-	return cxl_memdev_get_devname(cmd->memdev);
+	struct cxl_port *port;
+
+	cxl_port_foreach(ctx, port)
+		if (port->id == id)
+			return port;
+	return NULL;
 }
 
-#define cmd_get_int(cmd, n, N, field) \
-do { \
-	struct cxl_cmd_##n *c = (void *)cmd->send_cmd->out.payload; \
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_##N) \
-		return EINVAL; \
-	if (cmd->status < 0) \
-		return cmd->status; \
-	return le32_to_cpu(c->field); \
-} while(0);
+/*
+ * The bus directory only holds links. The parent port is the directory
+ * the real device lives in, and the host is whatever 'uport' points to:
+ * the ACPI0017 device, a host bridge, a switch upstream port or a
+ * memdev.
+ */
+static void __cxl_port_load(struct cxl_port *port)
+{
+	char *real, *parent, link[PATH_MAX], path[PATH_MAX];
+	struct dirent *de;
+	ssize_t len;
+	DIR *dir;
+	int id;
 
-CXL_EXPORT struct cxl_cmd *cxl_cmd_new_get_health_info(
-		struct cxl_memdev *memdev)
+	real = realpath(port->dev_path, NULL);
+	if (real) {
+		parent = dirname(real);
+		if (port->type != CXL_PORT_ROOT)
+			port->parent = cxl_port_find(port->ctx,
+					devpath_to_devname(parent));
+		free(real);
+	}
+
+	snprintf(path, sizeof(path), "%s/uport", port->dev_path);
+	len = readlink(path, link, sizeof(link) - 1);
+	if (len > 0) {
+		link[len] = '\0';
+		port->host = strdup(devpath_to_devname(link));
+	}
+
+	dir = opendir(port->dev_path);
+	if (!dir)
+		return;
+	while ((de = readdir(dir)) != NULL)
+		if (sscanf(de->d_name, "dport%d", &id) == 1)
+			port->nr_dports++;
+	closedir(dir);
+}
+
+static void cxl_port_load(struct cxl_port *port)
 {
-	return cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_HEALTH_INFO);
+	if (cxl_init_begin(port->ctx, &port->loaded)) {
+		__cxl_port_load(port);
+		cxl_init_end(port->ctx, &port->loaded);
+	}
 }
 
-#define cmd_health_get_int(c, f) \
-do { \
-	cmd_get_int(c, get_health_info, GET_HEALTH_INFO, f); \
-} while (0);
+CXL_EXPORT struct cxl_port *cxl_port_get_parent(struct cxl_port *port)
+{
+	cxl_port_load(port);
+	return port->parent;
+}
 
-CXL_EXPORT int cxl_cmd_get_health_info_get_health_status(struct cxl_cmd *cmd)
+CXL_EXPORT const char *cxl_port_get_host(struct cxl_port *port)
 {
-	cmd_health_get_int(cmd, health_status);
+	cxl_port_load(port);
+	return port->host;
 }
 
-CXL_EXPORT int cxl_cmd_get_health_info_get_media_status(struct cxl_cmd *cmd)
+CXL_EXPORT int cxl_port_get_nr_dports(struct cxl_port *port)
 {
-	cmd_health_get_int(cmd, media_status);
+	cxl_port_load(port);
+	return port->nr_dports;
 }
 
-CXL_EXPORT int cxl_cmd_get_health_info_get_ext_status(struct cxl_cmd *cmd)
+/**
+ * cxl_memdev_get_endpoint - the endpoint port a memdev decodes through
+ * @memdev: memory device
+ *
+ * Returns NULL while the memdev is not attached to a CXL port topology.
+ */
+CXL_EXPORT struct cxl_port *cxl_memdev_get_endpoint(struct cxl_memdev *memdev)
 {
-	cmd_health_get_int(cmd, ext_status);
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct cxl_port *port;
+	const char *host;
+
+	cxl_port_foreach(memdev->ctx, port) {
+		if (!cxl_port_is_endpoint(port))
+			continue;
+		host = cxl_port_get_host(port);
+		if (host && strcmp(host, devname) == 0)
+			return port;
+	}
+	return NULL;
 }
 
-CXL_EXPORT int cxl_cmd_get_health_info_get_life_used(struct cxl_cmd *cmd)
+static void __cxl_decoders_init(struct cxl_port *port)
 {
-	cmd_health_get_int(cmd, life_used);
+	struct cxl_ctx *ctx = port->ctx;
+	struct cxl_decoder *decoder;
+	struct dirent *de;
+	int port_id, id;
+	DIR *dir;
+
+	dir = opendir(cxl_devices_path(ctx));
+	if (!dir)
+		return;
+	while ((de = readdir(dir)) != NULL) {
+		if (sscanf(de->d_name, "decoder%d.%d", &port_id, &id) != 2
+				|| port_id != port->id)
+			continue;
+		decoder = calloc(1, sizeof(*decoder));
+		if (!decoder)
+			break;
+		decoder->dev_path = cxl_topo_path(ctx, de->d_name);
+		if (!decoder->dev_path) {
+			free(decoder);
+			break;
+		}
+		decoder->id = id;
+		decoder->port = port;
+		list_add_tail(&port->decoders, &decoder->list);
+	}
+	closedir(dir);
+
+	cxl_topo_sort(&port->decoders, struct cxl_decoder, decoder_cmp);
 }
 
-CXL_EXPORT int cxl_cmd_get_health_info_get_temperature(struct cxl_cmd *cmd)
+static void cxl_decoders_init(struct cxl_port *port)
 {
-	cmd_health_get_int(cmd, temperature);
+	if (cxl_init_begin(port->ctx, &port->decoders_init)) {
+		__cxl_decoders_init(port);
+		cxl_init_end(port->ctx, &port->decoders_init);
+	}
 }
 
-CXL_EXPORT int cxl_cmd_get_health_info_get_dirty_shutdowns(struct cxl_cmd *cmd)
+CXL_EXPORT struct cxl_decoder *cxl_decoder_get_first(struct cxl_port *port)
 {
-	cmd_health_get_int(cmd, dirty_shutdowns);
+	cxl_decoders_init(port);
+
+	return list_top(&port->decoders, struct cxl_decoder, list);
 }
 
-CXL_EXPORT int cxl_cmd_get_health_info_get_volatile_errors(struct cxl_cmd *cmd)
+CXL_EXPORT struct cxl_decoder *cxl_decoder_get_next(
+		struct cxl_decoder *decoder)
 {
-	cmd_health_get_int(cmd, volatile_errors);
+	return list_next(&decoder->port->decoders, decoder, list);
 }
 
-CXL_EXPORT int cxl_cmd_get_health_info_get_pmem_errors(struct cxl_cmd *cmd)
+CXL_EXPORT struct cxl_port *cxl_decoder_get_port(struct cxl_decoder *decoder)
 {
-	cmd_health_get_int(cmd, pmem_errors);
+	return decoder->port;
 }
 
-CXL_EXPORT struct cxl_cmd *cxl_cmd_new_identify(struct cxl_memdev *memdev)
+CXL_EXPORT int cxl_decoder_get_id(struct cxl_decoder *decoder)
 {
-	return cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_IDENTIFY);
+	return decoder->id;
 }
 
-CXL_EXPORT int cxl_cmd_identify_get_fw_rev(struct cxl_cmd *cmd, char *fw_rev,
-		int fw_len)
+CXL_EXPORT const char *cxl_decoder_get_devname(struct cxl_decoder *decoder)
 {
-	struct cxl_cmd_identify *id = (void *)cmd->send_cmd->out.payload;
+	return devpath_to_devname(decoder->dev_path);
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_IDENTIFY)
-		return -EINVAL;
-	if (cmd->status < 0)
-		return cmd->status;
+static void __cxl_decoder_load(struct cxl_decoder *decoder)
+{
+	struct cxl_ctx *ctx = decoder->port->ctx;
+	int path = sysfs_open_dev(ctx, decoder->dev_path);
+	unsigned long long v;
 
-	if (fw_len > 0)
-		memcpy(fw_rev, id->fw_revision,
-			min(fw_len, CXL_CMD_IDENTIFY_FW_REV_LENGTH));
-	return 0;
+	decoder->resource = cxl_topo_read_ull(ctx, path, "start");
+	decoder->size = cxl_topo_read_ull(ctx, path, "size");
+	v = cxl_topo_read_ull(ctx, path, "interleave_ways");
+	decoder->interleave_ways = v == ULLONG_MAX ? -1 : (int) v;
+	v = cxl_topo_read_ull(ctx, path, "interleave_granularity");
+	decoder->interleave_granularity = v == ULLONG_MAX ? 0 : v;
+	decoder->target_list = cxl_topo_read_str(ctx, path, "target_list");
+	if (decoder->port->type == CXL_PORT_ROOT) {
+		decoder->cap_pmem = cxl_topo_read_ull(ctx, path, "cap_pmem") == 1;
+		decoder->cap_ram = cxl_topo_read_ull(ctx, path, "cap_ram") == 1;
+	}
+	if (decoder->port->type != CXL_PORT_ENDPOINT) {
+		decoder->dpa_resource = ULLONG_MAX;
+		decoder->dpa_size = ULLONG_MAX;
+	} else {
+		decoder->mode = cxl_topo_read_str(ctx, path, "mode");
+		decoder->dpa_resource = cxl_topo_read_ull(ctx, path,
+				"dpa_resource");
+		decoder->dpa_size = cxl_topo_read_ull(ctx, path, "dpa_size");
+	}
+	if (path >= 0)
+		close(path);
 }
 
-CXL_EXPORT unsigned long long cxl_cmd_identify_get_partition_align(
-		struct cxl_cmd *cmd)
+static void cxl_decoder_load(struct cxl_decoder *decoder)
 {
-	struct cxl_cmd_identify *id = (void *)cmd->send_cmd->out.payload;
+	if (cxl_init_begin(decoder->port->ctx, &decoder->loaded)) {
+		__cxl_decoder_load(decoder);
+		cxl_init_end(decoder->port->ctx, &decoder->loaded);
+	}
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_IDENTIFY)
-		return -EINVAL;
-	if (cmd->status < 0)
-		return cmd->status;
+#define cxl_decoder_get_field(decoder, field) \
+do { \
+	cxl_decoder_load(decoder); \
+	return (decoder)->field; \
+} while (0)
 
-	return le64_to_cpu(id->partition_align);
+CXL_EXPORT unsigned long long cxl_decoder_get_resource(
+		struct cxl_decoder *decoder)
+{
+	cxl_decoder_get_field(decoder, resource);
 }
 
-CXL_EXPORT unsigned int cxl_cmd_identify_get_lsa_size(struct cxl_cmd *cmd)
+CXL_EXPORT unsigned long long cxl_decoder_get_size(struct cxl_decoder *decoder)
 {
-	struct cxl_cmd_identify *id = (void *)cmd->send_cmd->out.payload;
+	cxl_decoder_get_field(decoder, size);
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_IDENTIFY)
-		return -EINVAL;
-	if (cmd->status < 0)
-		return cmd->status;
+CXL_EXPORT unsigned long long cxl_decoder_get_dpa_resource(
+		struct cxl_decoder *decoder)
+{
+	cxl_decoder_get_field(decoder, dpa_resource);
+}
 
-	return le32_to_cpu(id->lsa_size);
+CXL_EXPORT unsigned long long cxl_decoder_get_dpa_size(
+		struct cxl_decoder *decoder)
+{
+	cxl_decoder_get_field(decoder, dpa_size);
 }
 
-CXL_EXPORT struct cxl_cmd *cxl_cmd_new_raw(struct cxl_memdev *memdev,
-		int opcode)
+CXL_EXPORT int cxl_decoder_get_interleave_ways(struct cxl_decoder *decoder)
 {
-	struct cxl_cmd *cmd;
+	cxl_decoder_get_field(decoder, interleave_ways);
+}
 
-	/* opcode '0' is reserved */
-	if (opcode <= 0) {
-		errno = EINVAL;
-		return NULL;
-	}
+CXL_EXPORT unsigned int cxl_decoder_get_interleave_granularity(
+		struct cxl_decoder *decoder)
+{
+	cxl_decoder_get_field(decoder, interleave_granularity);
+}
 
-	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_RAW);
-	if (!cmd)
-		return NULL;
+CXL_EXPORT const char *cxl_decoder_get_target_list(
+		struct cxl_decoder *decoder)
+{
+	cxl_decoder_get_field(decoder, target_list);
+}
 
-	cmd->send_cmd->raw.opcode = opcode;
-	return cmd;
+CXL_EXPORT const char *cxl_decoder_get_mode(struct cxl_decoder *decoder)
+{
+	cxl_decoder_get_field(decoder, mode);
 }
 
-CXL_EXPORT struct cxl_cmd *cxl_cmd_new_get_lsa(struct cxl_memdev *memdev,
-		unsigned int offset, unsigned int length)
+/* CXL 2.0 8.2.5.12.7: at most 16 way interleave */
+#define CXL_REGION_MAX_WAYS 16
+
+/* resolve a "decoderX.Y" name as found in region target attributes */
+static struct cxl_decoder *cxl_decoder_find(struct cxl_ctx *ctx,
+		const char *name)
 {
-	struct cxl_cmd_get_lsa_in *get_lsa;
-	struct cxl_cmd *cmd;
+	struct cxl_decoder *decoder;
+	struct cxl_port *port;
+	int port_id, id;
 
-	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_LSA);
-	if (!cmd)
+	if (sscanf(name, "decoder%d.%d", &port_id, &id) != 2)
+		return NULL;
+	port = cxl_port_find_id(ctx, port_id);
+	if (!port)
 		return NULL;
+	cxl_decoder_foreach(port, decoder)
+		if (decoder->id == id)
+			return decoder;
+	return NULL;
+}
 
-	get_lsa = (void *)cmd->send_cmd->in.payload;
-	get_lsa->offset = cpu_to_le32(offset);
-	get_lsa->length = cpu_to_le32(length);
-	return cmd;
+CXL_EXPORT struct cxl_region *cxl_region_get_first(struct cxl_ctx *ctx)
+{
+	cxl_topology_init(ctx);
+
+	return list_top(&ctx->regions, struct cxl_region, list);
 }
 
-#define cmd_get_void(cmd, N) \
-do { \
-	void *p = (void *)cmd->send_cmd->out.payload; \
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_##N) \
-		return NULL; \
-	if (cmd->status < 0) \
-		return NULL; \
-	return p; \
-} while(0);
+CXL_EXPORT struct cxl_region *cxl_region_get_next(struct cxl_region *region)
+{
+	return list_next(&region->ctx->regions, region, list);
+}
 
-CXL_EXPORT void *cxl_cmd_get_lsa_get_payload(struct cxl_cmd *cmd)
+CXL_EXPORT struct cxl_ctx *cxl_region_get_ctx(struct cxl_region *region)
 {
-	cmd_get_void(cmd, GET_LSA);
+	return region->ctx;
 }
 
-CXL_EXPORT int cxl_cmd_submit(struct cxl_cmd *cmd)
+CXL_EXPORT int cxl_region_get_id(struct cxl_region *region)
 {
-	struct cxl_memdev *memdev = cmd->memdev;
-	const char *devname = cxl_memdev_get_devname(memdev);
-	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
-	int rc;
+	return region->id;
+}
 
-	switch (cmd->query_status) {
-	case CXL_CMD_QUERY_OK:
-		break;
-	case CXL_CMD_QUERY_UNSUPPORTED:
-		return -EOPNOTSUPP;
-	case CXL_CMD_QUERY_NOT_RUN:
-		return -EINVAL;
-	default:
-		err(ctx, "%s: Unknown query_status %d\n",
-			devname, cmd->query_status);
-		return -EINVAL;
-	}
+CXL_EXPORT const char *cxl_region_get_devname(struct cxl_region *region)
+{
+	return devpath_to_devname(region->dev_path);
+}
 
-	dbg(ctx, "%s: submitting SEND cmd: in: %d, out: %d\n", devname,
-		cmd->send_cmd->in.size, cmd->send_cmd->out.size);
-	rc = do_cmd(cmd, CXL_MEM_SEND_COMMAND);
-	if (rc < 0)
-		err(ctx, "%s: send command failed: %s\n",
-			devname, strerror(-rc));
-	cmd->status = cmd->send_cmd->retval;
-	dbg(ctx, "%s: got SEND cmd: in: %d, out: %d, retval: %d\n", devname,
-		cmd->send_cmd->in.size, cmd->send_cmd->out.size, cmd->status);
+static void __cxl_region_load(struct cxl_region *region)
+{
+	struct cxl_ctx *ctx = region->ctx;
+	int path = sysfs_open_dev(ctx, region->dev_path);
+	unsigned long long v;
+	char attr[32];
+	int i;
 
-	return rc;
+	region->resource = cxl_topo_read_ull(ctx, path, "resource");
+	region->size = cxl_topo_read_ull(ctx, path, "size");
+	v = cxl_topo_read_ull(ctx, path, "interleave_granularity");
+	region->interleave_granularity = v == ULLONG_MAX ? 0 : v;
+	region->uuid = cxl_topo_read_str(ctx, path, "uuid");
+	region->mode = cxl_topo_read_str(ctx, path, "mode");
+
+	v = cxl_topo_read_ull(ctx, path, "interleave_ways");
+	if (v == ULLONG_MAX || v > CXL_REGION_MAX_WAYS)
+		goto out;
+	region->targets = calloc(v, sizeof(*region->targets));
+	if (!region->targets)
+		goto out;
+	region->interleave_ways = v;
+	for (i = 0; i < region->interleave_ways; i++) {
+		snprintf(attr, sizeof(attr), "target%d", i);
+		region->targets[i] = cxl_topo_read_str(ctx, path, attr);
+	}
+out:
+	if (path >= 0)
+		close(path);
 }
 
-CXL_EXPORT int cxl_cmd_get_mbox_status(struct cxl_cmd *cmd)
+static void cxl_region_load(struct cxl_region *region)
 {
-	return cmd->status;
+	if (cxl_init_begin(region->ctx, &region->loaded)) {
+		__cxl_region_load(region);
+		cxl_init_end(region->ctx, &region->loaded);
+	}
 }
 
-CXL_EXPORT int cxl_cmd_get_out_size(struct cxl_cmd *cmd)
+CXL_EXPORT unsigned long long cxl_region_get_resource(
+		struct cxl_region *region)
 {
-	return cmd->send_cmd->out.size;
+	cxl_region_load(region);
+	return region->resource;
 }
 
-CXL_EXPORT struct cxl_cmd *cxl_cmd_new_set_lsa(struct cxl_memdev *memdev,
-		void *lsa_buf, unsigned int offset, unsigned int length)
+CXL_EXPORT unsigned long long cxl_region_get_size(struct cxl_region *region)
 {
-	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
-	struct cxl_cmd_set_lsa *set_lsa;
-	struct cxl_cmd *cmd;
-	int rc;
-
-	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_SET_LSA);
-	if (!cmd)
-		return NULL;
+	cxl_region_load(region);
+	return region->size;
+}
 
-	/* this will allocate 'in.payload' */
-	rc = cxl_cmd_set_input_payload(cmd, NULL, sizeof(*set_lsa) + length);
-	if (rc) {
-		err(ctx, "%s: cmd setup failed: %s\n",
-			cxl_memdev_get_devname(memdev), strerror(-rc));
-		goto out_fail;
-	}
-	set_lsa = (void *)cmd->send_cmd->in.payload;
-	set_lsa->offset = cpu_to_le32(offset);
-	memcpy(set_lsa->lsa_data, lsa_buf, length);
+CXL_EXPORT int cxl_region_get_interleave_ways(struct cxl_region *region)
+{
+	cxl_region_load(region);
+	return region->interleave_ways;
+}
 
-	return cmd;
+CXL_EXPORT unsigned int cxl_region_get_interleave_granularity(
+		struct cxl_region *region)
+{
+	cxl_region_load(region);
+	return region->interleave_granularity;
+}
 
-out_fail:
-	cxl_cmd_unref(cmd);
-	return NULL;
+CXL_EXPORT const char *cxl_region_get_uuid(struct cxl_region *region)
+{
+	cxl_region_load(region);
+	return region->uuid;
 }
 
-enum lsa_op {
-	LSA_OP_GET,
-	LSA_OP_SET,
-	LSA_OP_ZERO,
-};
-
-static int lsa_op(struct cxl_memdev *memdev, int op, void **buf,
-		size_t length, size_t offset)
+CXL_EXPORT const char *cxl_region_get_mode(struct cxl_region *region)
 {
-	const char *devname = cxl_memdev_get_devname(memdev);
-	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
-	struct cxl_cmd *cmd;
-	void *zero_buf = NULL;
-	int rc = 0;
+	cxl_region_load(region);
+	return region->mode;
+}
 
-	if (op != LSA_OP_ZERO && (buf == NULL || *buf == NULL)) {
-		err(ctx, "%s: LSA buffer cannot be NULL\n", devname);
-		return -EINVAL;
-	}
+/**
+ * cxl_region_get_target - endpoint decoder at an interleave position
+ * @region: region
+ * @position: 0 to cxl_region_get_interleave_ways() - 1
+ *
+ * Returns NULL for positions that have not been assigned yet.
+ */
+CXL_EXPORT struct cxl_decoder *cxl_region_get_target(
+		struct cxl_region *region, int position)
+{
+	cxl_region_load(region);
+	if (position < 0 || position >= region->interleave_ways
+			|| !region->targets[position]
+			|| !region->targets[position][0])
+		return NULL;
+	return cxl_decoder_find(region->ctx, region->targets[position]);
+}
 
-	/* TODO: handle the case for offset + len > mailbox payload size */
-	switch (op) {
-	case LSA_OP_GET:
-		if (length == 0)
-			length = memdev->lsa_size;
-		cmd = cxl_cmd_new_get_lsa(memdev, offset, length);
-		if (!cmd)
-			return -ENOMEM;
-		rc = cxl_cmd_set_output_payload(cmd, *buf, length);
-		if (rc) {
-			err(ctx, "%s: cmd setup failed: %s\n",
-			    cxl_memdev_get_devname(memdev), strerror(-rc));
-			goto out;
-		}
-		break;
-	case LSA_OP_ZERO:
-		if (length == 0)
-			length = memdev->lsa_size;
-		zero_buf = calloc(1, length);
-		if (!zero_buf)
-			return -ENOMEM;
-		buf = &zero_buf;
-		/* fall through */
-	case LSA_OP_SET:
-		cmd = cxl_cmd_new_set_lsa(memdev, *buf, offset, length);
-		if (!cmd) {
-			rc = -ENOMEM;
-			goto out_free;
-		}
-		break;
-	default:
-		return -EOPNOTSUPP;
-	}
+/*
+ * Region assembly. The kernel builds a region in steps: name it on the
+ * root decoder, set its geometry, size each endpoint decoder's DPA
+ * allocation, attach the endpoint decoders by position and commit.
+ * Each setter drops the cached attributes so later getters see what
+ * the kernel accepted.
+ */
+static int cxl_topo_write_attr(struct cxl_ctx *ctx, const char *dev_path,
+		const char *attr, const char *val)
+{
+	char path[PATH_MAX];
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		err(ctx, "%s: cmd submission failed: %s\n",
-			devname, strerror(-rc));
-		goto out;
-	}
+	if (snprintf(path, sizeof(path), "%s/%s", dev_path, attr)
+			>= (int) sizeof(path))
+		return -ENOMEM;
+	return sysfs_write_attr(ctx, path, val);
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		err(ctx, "%s: firmware status: %d:\n%s\n",
-			devname, rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+static int cxl_topo_write_ull(struct cxl_ctx *ctx, const char *dev_path,
+		const char *attr, unsigned long long val)
+{
+	char buf[SYSFS_ATTR_SIZE];
 
-	if (op == LSA_OP_GET)
-		memcpy(*buf, cxl_cmd_get_lsa_get_payload(cmd), length);
-	/*
-	 * TODO: If writing, the memdev may need to be disabled/re-enabled to
-	 * refresh any cached LSA data in the kernel.
-	 */
+	snprintf(buf, sizeof(buf), "%#llx", val);
+	return cxl_topo_write_attr(ctx, dev_path, attr, buf);
+}
 
-out:
-	cxl_cmd_unref(cmd);
-out_free:
-	free(zero_buf);
-	return rc;
+static void cxl_decoder_unload(struct cxl_decoder *decoder)
+{
+	free(decoder->target_list);
+	free(decoder->mode);
+	decoder->target_list = NULL;
+	decoder->mode = NULL;
+	__atomic_store_n(&decoder->loaded, CXL_INIT_NONE, __ATOMIC_RELEASE);
 }
 
-CXL_EXPORT int cxl_memdev_zero_lsa(struct cxl_memdev *memdev)
+static void cxl_region_unload(struct cxl_region *region)
 {
-	return lsa_op(memdev, LSA_OP_ZERO, NULL, 0, 0);
+	int i;
+
+	if (region->targets)
+		for (i = 0; i < region->interleave_ways; i++)
+			free(region->targets[i]);
+	free(region->targets);
+	free(region->uuid);
+	free(region->mode);
+	region->targets = NULL;
+	region->uuid = NULL;
+	region->mode = NULL;
+	region->interleave_ways = 0;
+	__atomic_store_n(&region->loaded, CXL_INIT_NONE, __ATOMIC_RELEASE);
 }
 
-CXL_EXPORT int cxl_memdev_set_lsa(struct cxl_memdev *memdev, void *buf,
-		size_t length, size_t offset)
+CXL_EXPORT int cxl_decoder_is_pmem_capable(struct cxl_decoder *decoder)
 {
-	return lsa_op(memdev, LSA_OP_SET, &buf, length, offset);
+	cxl_decoder_load(decoder);
+	return decoder->cap_pmem;
 }
 
-CXL_EXPORT int cxl_memdev_get_lsa(struct cxl_memdev *memdev, void *buf,
-		size_t length, size_t offset)
+CXL_EXPORT int cxl_decoder_is_volatile_capable(struct cxl_decoder *decoder)
 {
-	return lsa_op(memdev, LSA_OP_GET, &buf, length, offset);
+	cxl_decoder_load(decoder);
+	return decoder->cap_ram;
 }
 
-CXL_EXPORT int cxl_memdev_cmd_identify(struct cxl_memdev *memdev)
+CXL_EXPORT int cxl_decoder_get_nr_targets(struct cxl_decoder *decoder)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_cmd_identify *id;
-	int rc = 0;
+	const char *list = cxl_decoder_get_target_list(decoder);
+	int nr = 0;
 
-	printf("id: 0x%x\n", CXL_MEM_COMMAND_ID_IDENTIFY);
-	cmd = cxl_cmd_new_identify(memdev);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_identify returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	if (!list || !list[0])
+		return 0;
+	for (nr = 1; *list; list++)
+		nr += *list == ',';
+	return nr;
+}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
-	}
+/**
+ * cxl_decoder_get_target - port below a downstream target of a decoder
+ * @decoder: root or switch decoder
+ * @position: index into the decoder's target list
+ *
+ * The target list names downstream ports of @decoder's port by id. For
+ * a root decoder this resolves to the host bridge port, for a switch
+ * decoder to the next level switch or endpoint port.
+ */
+CXL_EXPORT struct cxl_port *cxl_decoder_get_target(struct cxl_decoder *decoder,
+		int position)
+{
+	const char *list = cxl_decoder_get_target_list(decoder);
+	struct cxl_port *parent = decoder->port, *port;
+	char path[PATH_MAX], link[PATH_MAX];
+	const char *host;
+	int i, dport;
+	ssize_t len;
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
+	if (!list || position < 0)
+		return NULL;
+	for (i = 0; i < position && list; i++) {
+		list = strchr(list, ',');
+		if (list)
+			list++;
 	}
+	if (!list || sscanf(list, "%d", &dport) != 1)
+		return NULL;
 
-	id = (void *)cmd->send_cmd->out.payload;
-	fprintf(stderr, "size of payload: %ld\n", sizeof(*id));
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_IDENTIFY) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_IDENTIFY);
-		return -EINVAL;
+	snprintf(path, sizeof(path), "%s/dport%d", parent->dev_path, dport);
+	len = readlink(path, link, sizeof(link) - 1);
+	if (len <= 0)
+		return NULL;
+	link[len] = '\0';
+
+	cxl_port_foreach(parent->ctx, port) {
+		if (cxl_port_get_parent(port) != parent)
+			continue;
+		host = cxl_port_get_host(port);
+		if (host && strcmp(host, devpath_to_devname(link)) == 0)
+			return port;
 	}
+	return NULL;
+}
 
-	fprintf(stdout, "%s info\n", cxl_memdev_get_devname(memdev));
-	fprintf(stdout, "    fw revision: ");
-	for (int i=0; i < CXL_CMD_IDENTIFY_FW_REV_LENGTH; ++i)
-		fprintf(stdout, "%02x ", id->fw_revision[i]);
-	fprintf(stdout, "\n");
-	fprintf(stdout, "    total_capacity: %lu MB (%lu GB)\n",
-	le64_to_cpu(id->total_capacity), (le64_to_cpu(id->total_capacity))/4);
-	fprintf(stdout, "    volatile_capacity: %lu MB (%lu GB)\n",
-	le64_to_cpu(id->volatile_capacity), (le64_to_cpu(id->volatile_capacity))/4);
-	fprintf(stdout, "    persistent_capacity: %lu MB (%lu GB)\n",
-	le64_to_cpu(id->persistent_capacity), (le64_to_cpu(id->persistent_capacity))/4);
-	fprintf(stdout, "    partition_align: %lu MB (%lu GB)\n",
-	le64_to_cpu(id->partition_align), (le64_to_cpu(id->partition_align))/4);
-	fprintf(stdout, "    info_event_log_size: %d\n", le16_to_cpu(id->info_event_log_size));
-	fprintf(stdout, "    warning_event_log_size: %d\n", le16_to_cpu(id->warning_event_log_size));
-	fprintf(stdout, "    failure_event_log_size: %d\n", le16_to_cpu(id->failure_event_log_size));
-	fprintf(stdout, "    fatal_event_log_size: %d\n", le16_to_cpu(id->fatal_event_log_size));
-	fprintf(stdout, "    lsa_size: %d\n", le32_to_cpu(id->lsa_size));
-	for (int i=0; i < 3; ++i)
-	fprintf(stdout, "    poison_list_max_mer[%d]: %d\n", i, id->poison_list_max_mer[i]);
-	fprintf(stdout, "    inject_poison_limit: %d\n", le16_to_cpu(id->inject_poison_limit));
-	fprintf(stdout, "    poison_caps: %d\n", id->poison_caps);
-	fprintf(stdout, "    qos_telemetry_caps: %d\n", id->qos_telemetry_caps);
+CXL_EXPORT int cxl_decoder_set_mode(struct cxl_decoder *decoder,
+		const char *mode)
+{
+	int rc = cxl_topo_write_attr(decoder->port->ctx, decoder->dev_path,
+			"mode", mode);
 
-out:
-	cxl_cmd_unref(cmd);
+	cxl_decoder_unload(decoder);
 	return rc;
 }
 
-struct cxl_mbox_get_supported_logs {
-	__le16 entries;
-	u8 rsvd[6];
-	struct gsl_entry {
-		uuid_t uuid;
-		__le32 size;
-	} __attribute__((packed)) entry[];
-} __attribute__((packed));
-
-CXL_EXPORT int cxl_memdev_get_supported_logs(struct cxl_memdev *memdev)
+CXL_EXPORT int cxl_decoder_set_dpa_size(struct cxl_decoder *decoder,
+		unsigned long long size)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mbox_get_supported_logs *gsl;
-	int rc = 0;
+	int rc = cxl_topo_write_ull(decoder->port->ctx, decoder->dev_path,
+			"dpa_size", size);
 
-	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_identify returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	cxl_decoder_unload(decoder);
+	return rc;
+}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
+static struct cxl_region *cxl_decoder_create_region(
+		struct cxl_decoder *decoder, const char *attr)
+{
+	struct cxl_ctx *ctx = decoder->port->ctx;
+	struct cxl_region *region;
+	char buf[SYSFS_ATTR_SIZE];
+	int id, rc;
+
+	cxl_topology_init(ctx);
+	rc = cxl_topo_read_attr(ctx, decoder->dev_path, attr, buf);
+	if (rc < 0 || sscanf(buf, "region%d", &id) != 1) {
+		err(ctx, "%s: no region available\n",
+				cxl_decoder_get_devname(decoder));
+		errno = rc < 0 ? -rc : EINVAL;
+		return NULL;
 	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
+	rc = cxl_topo_write_attr(ctx, decoder->dev_path, attr, buf);
+	if (rc < 0) {
+		errno = -rc;
+		return NULL;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev),
-				cmd->send_cmd->id,
-				CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS);
-		return -EINVAL;
+	region = add_cxl_region(ctx, buf, id);
+	if (!region) {
+		errno = ENOMEM;
+		return NULL;
 	}
+	cxl_topo_sort(&ctx->regions, struct cxl_region, region_cmp);
+	return region;
+}
 
-	gsl = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "payload info\n");
-	fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
-	fprintf(stdout, "    entries: %d\n", gsl->entries);
-	for (int e=0; e < gsl->entries; ++e) {
-		char uuid[40];
-		uuid_unparse(gsl->entry[e].uuid, uuid);
-		fprintf(stdout, "        entries[%d] uuid: %s, size: %d\n", e, uuid, gsl->entry[e].size);
-	}
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
+CXL_EXPORT struct cxl_region *cxl_decoder_create_pmem_region(
+		struct cxl_decoder *decoder)
+{
+	return cxl_decoder_create_region(decoder, "create_pmem_region");
 }
 
-#define CEL_UUID "0da9c0b5-bf41-4b78-8f79-96b1623b3f17"
+CXL_EXPORT struct cxl_region *cxl_decoder_create_ram_region(
+		struct cxl_decoder *decoder)
+{
+	return cxl_decoder_create_region(decoder, "create_ram_region");
+}
 
-struct cxl_mbox_get_log {
-	uuid_t uuid;
-	__le32 offset;
-	__le32 length;
-}  __attribute__((packed));
+/**
+ * cxl_decoder_delete_region - tear down a region created on @decoder
+ * @decoder: root decoder the region was created on
+ * @region: region, freed on success
+ */
+CXL_EXPORT int cxl_decoder_delete_region(struct cxl_decoder *decoder,
+		struct cxl_region *region)
+{
+	int rc = cxl_topo_write_attr(decoder->port->ctx, decoder->dev_path,
+			"delete_region", cxl_region_get_devname(region));
 
-struct cel_entry {
-	__le16 opcode;
-	__le16 effect;
-} __attribute__((packed));
+	if (rc < 0)
+		return rc;
+	list_del_from(&region->ctx->regions, &region->list);
+	free_region(region);
+	return 0;
+}
 
-CXL_EXPORT int cxl_memdev_get_cel_log(struct cxl_memdev *memdev, const char* uuid)
+CXL_EXPORT int cxl_region_set_uuid(struct cxl_region *region, uuid_t uu)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mbox_get_log *get_log_input;
-	struct cel_entry *cel_entries;
-	int no_cel_entries;
-	int rc = 0;
+	char uuid[40];
+	int rc;
 
-	if (!uuid) {
-		fprintf(stderr, "%s: Please specify log uuid argument\n",
-				cxl_memdev_get_devname(memdev));
-		return -EINVAL;
-	}
+	uuid_unparse(uu, uuid);
+	rc = cxl_topo_write_attr(region->ctx, region->dev_path, "uuid", uuid);
+	cxl_region_unload(region);
+	return rc;
+}
 
-	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_LOG);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_memdev_get_cel_log returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+CXL_EXPORT int cxl_region_set_size(struct cxl_region *region,
+		unsigned long long size)
+{
+	int rc = cxl_topo_write_ull(region->ctx, region->dev_path, "size", size);
 
-	get_log_input = (void *) cmd->send_cmd->in.payload;
-	uuid_parse(uuid, get_log_input->uuid);
-	get_log_input->offset = 0;
-	get_log_input->length = cmd->memdev->payload_max;
+	cxl_region_unload(region);
+	return rc;
+}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
-	}
+CXL_EXPORT int cxl_region_set_interleave_ways(struct cxl_region *region,
+		unsigned int ways)
+{
+	int rc = cxl_topo_write_ull(region->ctx, region->dev_path,
+			"interleave_ways", ways);
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_LOG) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_LOG);
-		return -EINVAL;
-	}
-
-	fprintf(stdout, "payload info\n");
-	fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
-	cel_entries = (void *)cmd->send_cmd->out.payload;
-	no_cel_entries = (cmd->send_cmd->out.size)/sizeof(struct cel_entry);
-	fprintf(stdout, "    no_cel_entries size: %d\n", no_cel_entries);
-	for (int e = 0; e < no_cel_entries; ++e) {
-		fprintf(stdout, "    cel_entry[%d] opcode: 0x%x, effect: 0x%x\n", e,
-				le16_to_cpu(cel_entries[e].opcode),
-				le16_to_cpu(cel_entries[e].effect));
-	}
-out:
-	cxl_cmd_unref(cmd);
+	cxl_region_unload(region);
 	return rc;
 }
 
-#define CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY_OPCODE 0x102
-
-struct cxl_mbox_get_event_interrupt_policy {
-	u8 info_event_log_int_settings;
-	u8 warning_event_log_int_settings;
-	u8 failure_event_log_int_settings;
-	u8 fatal_event_log_int_settings;
-}  __attribute__((packed));
-
-CXL_EXPORT int cxl_memdev_get_event_interrupt_policy(struct cxl_memdev *memdev)
+CXL_EXPORT int cxl_region_set_interleave_granularity(
+		struct cxl_region *region, unsigned int granularity)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mbox_get_event_interrupt_policy *event_interrupt_policy_out;
-	int rc = 0;
+	int rc = cxl_topo_write_ull(region->ctx, region->dev_path,
+			"interleave_granularity", granularity);
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	cxl_region_unload(region);
+	return rc;
+}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
-	}
+CXL_EXPORT int cxl_region_set_target(struct cxl_region *region, int position,
+		struct cxl_decoder *decoder)
+{
+	char attr[32];
+	int rc;
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+	snprintf(attr, sizeof(attr), "target%d", position);
+	rc = cxl_topo_write_attr(region->ctx, region->dev_path, attr,
+			decoder ? cxl_decoder_get_devname(decoder) : "\n");
+	cxl_region_unload(region);
+	return rc;
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY);
-		return -EINVAL;
-	}
+CXL_EXPORT int cxl_region_commit(struct cxl_region *region)
+{
+	int rc = cxl_topo_write_attr(region->ctx, region->dev_path, "commit",
+			"1");
 
-	fprintf(stdout, "payload info\n");
-	fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
-	event_interrupt_policy_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "    info_event_log_int_settings: 0x%x\n", event_interrupt_policy_out->info_event_log_int_settings);
-	fprintf(stdout, "    warning_event_log_int_settings: 0x%x\n", event_interrupt_policy_out->warning_event_log_int_settings);
-	fprintf(stdout, "    failure_event_log_int_settings: 0x%x\n", event_interrupt_policy_out->failure_event_log_int_settings);
-	fprintf(stdout, "    fatal_event_log_int_settings: 0x%x\n", event_interrupt_policy_out->fatal_event_log_int_settings);
-out:
-	cxl_cmd_unref(cmd);
+	cxl_region_unload(region);
 	return rc;
 }
 
-#define CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY_OPCODE 0x103
-#define CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY_PAYLOAD_IN_SIZE 0x4
-
-CXL_EXPORT int cxl_memdev_set_event_interrupt_policy(struct cxl_memdev *memdev, u32 int_policy)
+/*
+ * A ram region hands its capacity to the dax bus through a dax_regionN
+ * child, which libdaxctl enumerates like any other dax region. The
+ * lookups below keep a private daxctl context so callers can walk from
+ * a memdev to the dax devices, and so the NUMA nodes, backed by it.
+ */
+CXL_EXPORT struct daxctl_ctx *cxl_get_daxctl_ctx(struct cxl_ctx *ctx)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-    struct cxl_command_info *cinfo;
-	struct cxl_mbox_get_event_interrupt_policy *interrupt_policy_in;
-	int rc = 0;
+	struct daxctl_ctx *dctx;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	pthread_mutex_lock(&ctx->init_lock);
+	if (!ctx->daxctl_ctx && daxctl_new(&ctx->daxctl_ctx) == 0)
+		daxctl_set_log_priority(ctx->daxctl_ctx,
+				ctx->ctx.log_priority);
+	dctx = ctx->daxctl_ctx;
+	pthread_mutex_unlock(&ctx->init_lock);
+	return dctx;
+}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+static char *cxl_region_dax_path(struct cxl_region *region)
+{
+	char *real, *path;
 
-	/* this is hack to create right payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-        cmd->input_payload = calloc(1, cinfo->size_in);
-        if (!cmd->input_payload)
-            return -ENOMEM;
-        cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-        cmd->send_cmd->in.size = cinfo->size_in;
-    }
+	real = realpath(region->dev_path, NULL);
+	if (!real)
+		return NULL;
+	if (asprintf(&path, "%s/dax_region%d", real, region->id) < 0)
+		path = NULL;
+	free(real);
+	return path;
+}
 
-	interrupt_policy_in = (void *) cmd->send_cmd->in.payload;
+/**
+ * cxl_region_get_daxctl_region - dax region exporting @region's capacity
+ * @region: CXL region
+ *
+ * Returns NULL for regions that are not committed, are pmem, or whose
+ * dax_region driver has not bound.
+ */
+CXL_EXPORT struct daxctl_region *cxl_region_get_daxctl_region(
+		struct cxl_region *region)
+{
+	struct daxctl_ctx *dctx = cxl_get_daxctl_ctx(region->ctx);
+	uuid_t uuid;
+	char *path, *attrs;
+	struct stat st;
 
-	/* below is meant for readability, you don't really need this */
-	int_policy = cpu_to_be32(int_policy);
-	interrupt_policy_in->info_event_log_int_settings = (int_policy & 0xff);
-	interrupt_policy_in->warning_event_log_int_settings = ((int_policy >> 8) & 0xff);
-	interrupt_policy_in->failure_event_log_int_settings = ((int_policy >> 16) & 0xff);
-	interrupt_policy_in->fatal_event_log_int_settings = ((int_policy >> 24) & 0xff);
+	if (region->dax_region || !dctx)
+		return region->dax_region;
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
+	path = cxl_region_dax_path(region);
+	if (!path)
+		return NULL;
+	if (asprintf(&attrs, "%s/dax_region", path) >= 0) {
+		if (stat(attrs, &st) == 0) {
+			uuid_clear(uuid);
+			region->dax_region = daxctl_new_region(dctx,
+					region->id, uuid, path);
+		}
+		free(attrs);
 	}
+	free(path);
+	return region->dax_region;
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+/**
+ * cxl_region_get_by_daxctl_region - CXL region behind a dax region
+ * @ctx: context to search
+ * @dax_region: dax region from any daxctl context
+ */
+CXL_EXPORT struct cxl_region *cxl_region_get_by_daxctl_region(
+		struct cxl_ctx *ctx, struct daxctl_region *dax_region)
+{
+	const char *dax_path = daxctl_region_get_path(dax_region);
+	struct cxl_region *region;
+	char *path;
+	int match;
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY);
-		return -EINVAL;
+	if (!dax_path || daxctl_region_get_id(dax_region) < 0)
+		return NULL;
+	cxl_region_foreach(ctx, region) {
+		if (region->id != daxctl_region_get_id(dax_region))
+			continue;
+		path = cxl_region_dax_path(region);
+		match = path && strcmp(path, dax_path) == 0;
+		free(path);
+		if (match)
+			return region;
 	}
-
-	fprintf(stdout, "command completed successfully\n");
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	return NULL;
 }
 
-#define CXL_MEM_COMMAND_ID_GET_TIMESTAMP CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_GET_TIMESTAMP_OPCODE 0x0300
+/* the memdev an endpoint decoder allocates capacity from */
+CXL_EXPORT struct cxl_memdev *cxl_decoder_get_memdev(
+		struct cxl_decoder *decoder)
+{
+	struct cxl_memdev *memdev;
 
-CXL_EXPORT int cxl_memdev_get_timestamp(struct cxl_memdev *memdev)
+	if (!cxl_port_is_endpoint(decoder->port))
+		return NULL;
+	cxl_memdev_foreach(decoder->port->ctx, memdev)
+		if (cxl_memdev_get_endpoint(memdev) == decoder->port)
+			return memdev;
+	return NULL;
+}
+
+/**
+ * cxl_region_get_memdev_position - where @memdev sits in @region
+ * @region: CXL region
+ * @memdev: memory device
+ *
+ * Returns the interleave position, or -ENXIO if @memdev does not
+ * contribute capacity to @region.
+ */
+CXL_EXPORT int cxl_region_get_memdev_position(struct cxl_region *region,
+		struct cxl_memdev *memdev)
 {
-	struct cxl_cmd *cmd;
-	__le64 *timestamp_out;
-	int rc = 0;
+	struct cxl_port *endpoint = cxl_memdev_get_endpoint(memdev);
+	struct cxl_decoder *decoder;
+	int i;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_TIMESTAMP_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
+	if (!endpoint)
+		return -ENXIO;
+	for (i = 0; i < cxl_region_get_interleave_ways(region); i++) {
+		decoder = cxl_region_get_target(region, i);
+		if (decoder && decoder->port == endpoint)
+			return i;
 	}
+	return -ENXIO;
+}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
-	}
+/* where the region's HPA range maps @hpa, if a dax device covers it */
+static void cxl_hpa_to_dax(struct cxl_region *region, unsigned long long hpa,
+		struct cxl_hpa_info *info)
+{
+	struct daxctl_region *dax_region;
+	struct daxctl_mapping *mapping;
+	unsigned long long start;
+	struct daxctl_dev *dev;
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+	dax_region = cxl_region_get_daxctl_region(region);
+	if (!dax_region)
+		return;
+	daxctl_dev_foreach(dax_region, dev)
+		daxctl_mapping_foreach(dev, mapping) {
+			start = daxctl_mapping_get_start(mapping);
+			if (hpa < start || hpa >= start
+					+ daxctl_mapping_get_size(mapping))
+				continue;
+			info->dax = dev;
+			info->dax_offset = daxctl_mapping_get_offset(mapping)
+				* sysconf(_SC_PAGESIZE) + hpa - start;
+			info->numa_node = daxctl_dev_get_target_node(dev);
+			return;
+		}
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_TIMESTAMP) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_TIMESTAMP);
-		return -EINVAL;
+/**
+ * cxl_memdev_dpa_to_hpa - resolve a device physical address
+ * @memdev: memory device
+ * @dpa: device physical address, e.g. from an event or poison record
+ * @info: filled in on success
+ *
+ * Finds the endpoint decoder whose DPA allocation holds @dpa and the
+ * region it is a target of, and interleaves the decoder's offset back
+ * into the region's HPA range at the memdev's position. When a dax
+ * device of the region covers the address, its offset into that
+ * device and its target node are filled in too. Only topology already
+ * read from sysfs is consulted, so a lookup costs no mailbox commands
+ * and no device or region enumeration after the first.
+ *
+ * Assumes modulo interleave arithmetic, host bridge XOR interleave
+ * is not undone. Returns -ENXIO when no committed region maps @dpa.
+ */
+CXL_EXPORT int cxl_memdev_dpa_to_hpa(struct cxl_memdev *memdev,
+		unsigned long long dpa, struct cxl_hpa_info *info)
+{
+	struct cxl_port *endpoint = cxl_memdev_get_endpoint(memdev);
+	unsigned long long base, offset, chunk, gran;
+	struct cxl_decoder *decoder;
+	struct cxl_region *region;
+	int ways, pos;
+
+	memset(info, 0, sizeof(*info));
+	info->numa_node = -1;
+	if (!endpoint)
+		return -ENXIO;
+
+	cxl_decoder_foreach(endpoint, decoder) {
+		base = cxl_decoder_get_dpa_resource(decoder);
+		if (base == ULLONG_MAX || dpa < base
+				|| dpa - base >= cxl_decoder_get_dpa_size(decoder))
+			continue;
+		cxl_region_foreach(memdev->ctx, region) {
+			ways = cxl_region_get_interleave_ways(region);
+			for (pos = 0; pos < ways; pos++)
+				if (cxl_region_get_target(region, pos) == decoder)
+					break;
+			if (pos >= ways)
+				continue;
+
+			gran = cxl_region_get_interleave_granularity(region);
+			if (!gran)
+				return -ENXIO;
+			offset = dpa - base;
+			chunk = offset / gran;
+			offset = (chunk * ways + pos) * gran + offset % gran;
+			if (offset >= cxl_region_get_size(region))
+				return -ENXIO;
+
+			info->region = region;
+			info->position = pos;
+			info->hpa = cxl_region_get_resource(region) + offset;
+			cxl_hpa_to_dax(region, info->hpa, info);
+			return 0;
+		}
 	}
+	return -ENXIO;
+}
 
-	timestamp_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "timestamp: 0x%lx\n", le64_to_cpu(*timestamp_out));
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
+CXL_EXPORT int cxl_memdev_get_id(struct cxl_memdev *memdev)
+{
+	return memdev->id;
 }
 
-#define CXL_MEM_COMMAND_ID_SET_TIMESTAMP CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_SET_TIMESTAMP_OPCODE 0x0301
-#define CXL_MEM_COMMAND_ID_SET_TIMESTAMP_PAYLOAD_IN_SIZE 8
+CXL_EXPORT const char *cxl_memdev_get_devname(struct cxl_memdev *memdev)
+{
+	return devpath_to_devname(memdev->dev_path);
+}
 
-CXL_EXPORT int cxl_memdev_set_timestamp(struct cxl_memdev *memdev, u64 timestamp)
+/* the device the memdev is registered on, the PCI BDF for a cxl_pci device */
+CXL_EXPORT const char *cxl_memdev_get_host(struct cxl_memdev *memdev)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-    struct cxl_command_info *cinfo;
-	__le64 *timestamp_in;
-	int rc = 0;
+	char *real, *host;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_SET_TIMESTAMP_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+	host = __atomic_load_n(&memdev->host, __ATOMIC_ACQUIRE);
+	if (host)
+		return host;
+	real = realpath(memdev->dev_path, NULL);
+	if (!real)
+		return NULL;
+	host = strdup(devpath_to_devname(dirname(real)));
+	free(real);
+	if (!host)
+		return NULL;
+	return cxl_publish(&memdev->host, host, free);
+}
 
-	/* this is hack to create right payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_SET_TIMESTAMP_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-        cmd->input_payload = calloc(1, cinfo->size_in);
-        if (!cmd->input_payload)
-            return -ENOMEM;
-        cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-        cmd->send_cmd->in.size = cinfo->size_in;
-    }
+CXL_EXPORT int cxl_memdev_get_major(struct cxl_memdev *memdev)
+{
+	int rc = memdev_load_devt(memdev);
 
-	timestamp_in = (void *) cmd->send_cmd->in.payload;
-	*timestamp_in = cpu_to_le64(timestamp);
-	fprintf(stdout, "setting timestamp to: 0x%lx\n", le64_to_cpu(*timestamp_in));
+	return rc < 0 ? rc : memdev->major;
+}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
-	}
+CXL_EXPORT int cxl_memdev_get_minor(struct cxl_memdev *memdev)
+{
+	int rc = memdev_load_devt(memdev);
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+	return rc < 0 ? rc : memdev->minor;
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_SET_TIMESTAMP) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_SET_TIMESTAMP);
-		return -EINVAL;
-	}
+CXL_EXPORT unsigned long long cxl_memdev_get_pmem_size(struct cxl_memdev *memdev)
+{
+	if (memdev_load_ull(memdev, CXL_MEMDEV_ATTR_PMEM_SIZE, "pmem/size",
+				&memdev->pmem_size) < 0)
+		return 0;
+	return memdev->pmem_size;
+}
 
-	fprintf(stdout, "command completed successfully\n");
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
+CXL_EXPORT unsigned long long cxl_memdev_get_ram_size(struct cxl_memdev *memdev)
+{
+	if (memdev_load_ull(memdev, CXL_MEMDEV_ATTR_RAM_SIZE, "ram/size",
+				&memdev->ram_size) < 0)
+		return 0;
+	return memdev->ram_size;
 }
 
-struct cxl_mbox_get_alert_config_out {
-	u8 valid_alerts;
-	u8 programmable_alerts;
-	u8 life_used_critical_alert_threshold;
-	u8 life_used_prog_warn_threshold;
-	__le16 dev_over_temp_crit_alert_threshold;
-	__le16 dev_under_temp_crit_alert_threshold;
-	__le16 dev_over_temp_prog_warn_threshold;
-	__le16 dev_under_temp_prog_warn_threshold;
-	__le16 corr_vol_mem_err_prog_warn_thresold;
-	__le16 corr_pers_mem_err_prog_warn_threshold;
-}  __attribute__((packed));
+CXL_EXPORT const char *cxl_memdev_get_firmware_verison(struct cxl_memdev *memdev)
+{
+	char buf[SYSFS_ATTR_SIZE];
+	char *fw;
 
-CXL_EXPORT int cxl_memdev_get_alert_config(struct cxl_memdev *memdev)
+	if (memdev_has_attr(memdev, CXL_MEMDEV_ATTR_FW_VERSION))
+		return memdev->firmware_version;
+	if (memdev_read_attr(memdev, "firmware_version", buf) < 0)
+		return NULL;
+	fw = strdup(buf);
+	if (!fw)
+		return NULL;
+	cxl_publish(&memdev->firmware_version, fw, free);
+	memdev_set_attr(memdev, CXL_MEMDEV_ATTR_FW_VERSION);
+	return fw;
+}
+
+CXL_EXPORT unsigned long long cxl_memdev_get_serial(struct cxl_memdev *memdev)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mbox_get_alert_config_out *alert_config_out;
-	int rc = 0;
+	if (memdev_load_ull(memdev, CXL_MEMDEV_ATTR_SERIAL, "serial",
+				&memdev->serial) < 0)
+		return ULLONG_MAX;
+	return memdev->serial;
+}
 
-	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+CXL_EXPORT size_t cxl_memdev_get_lsa_size(struct cxl_memdev *memdev)
+{
+	unsigned long long v;
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
-	}
+	if (memdev_has_attr(memdev, CXL_MEMDEV_ATTR_LSA_SIZE))
+		return memdev->lsa_size;
+	if (memdev_read_ull(memdev, "label_storage_size", &v) < 0)
+		return 0;
+	memdev->lsa_size = v;
+	memdev_set_attr(memdev, CXL_MEMDEV_ATTR_LSA_SIZE);
+	return memdev->lsa_size;
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+CXL_EXPORT int cxl_memdev_is_active(struct cxl_memdev *memdev)
+{
+	/*
+	 * TODO: Currently memdevs are always considered inactive. Once we have
+	 * cxl_bus drivers that are bound/unbound to memdevs, we'd use that to
+	 * determine the active/inactive state.
+	 */
+	return 0;
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG);
-		return -EINVAL;
+/*
+ * Payload buffers are sized to at least the memdev's payload_max so
+ * that any buffer in the pool can back any command to any memdev with
+ * the same mailbox size. Only the requested @size is cleared. The pools
+ * are shared by every memdev in the context, so callers driving
+ * different memdevs from different threads go through @pool_lock.
+ */
+static void *cxl_payload_get(struct cxl_memdev *memdev, size_t size)
+{
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	struct cxl_payload *payload;
+
+	pthread_mutex_lock(&ctx->pool_lock);
+	list_for_each(&ctx->payload_pool, payload, list)
+		if (payload->size >= size) {
+			list_del_from(&ctx->payload_pool, &payload->list);
+			ctx->payload_pool_len--;
+			pthread_mutex_unlock(&ctx->pool_lock);
+			memset(payload->data, 0, size);
+			return payload->data;
+		}
+	pthread_mutex_unlock(&ctx->pool_lock);
+
+	size = max_t(size_t, size, memdev_payload_max(memdev));
+	payload = calloc(1, sizeof(*payload) + size);
+	if (!payload)
+		return NULL;
+	payload->size = size;
+	return payload->data;
+}
+
+static void cxl_payload_put(struct cxl_ctx *ctx, void *buf)
+{
+	struct cxl_payload *payload;
+
+	if (!buf)
+		return;
+
+	payload = container_of(buf, struct cxl_payload, data);
+	pthread_mutex_lock(&ctx->pool_lock);
+	if (ctx->payload_pool_len >= CXL_PAYLOAD_POOL_MAX) {
+		pthread_mutex_unlock(&ctx->pool_lock);
+		free(payload);
+		return;
 	}
+	list_add(&ctx->payload_pool, &payload->list);
+	ctx->payload_pool_len++;
+	pthread_mutex_unlock(&ctx->pool_lock);
+}
 
-	fprintf(stdout, "alert_config summary\n");
-	//fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
+/* replace any automatic input allocation with a fresh @size buffer */
+static void *cxl_cmd_alloc_input(struct cxl_cmd *cmd, size_t size)
+{
+	cxl_payload_put(cxl_memdev_get_ctx(cmd->memdev), cmd->input_payload);
+	cmd->input_payload = NULL;
+	return cxl_payload_get(cmd->memdev, size);
+}
 
-	alert_config_out = (void *)cmd->send_cmd->out.payload;
+static void *cxl_cmd_alloc_output(struct cxl_cmd *cmd, size_t size)
+{
+	cxl_payload_put(cxl_memdev_get_ctx(cmd->memdev), cmd->output_payload);
+	cmd->output_payload = NULL;
+	return cxl_payload_get(cmd->memdev, size);
+}
 
-	fprintf(stdout, "    valid_alerts: 0x%x\n", alert_config_out->valid_alerts);
-	fprintf(stdout, "    programmable_alerts: 0x%x\n", alert_config_out->programmable_alerts);
-	fprintf(stdout, "    life_used_critical_alert_threshold: 0x%x\n",
-		alert_config_out->life_used_critical_alert_threshold);
-	fprintf(stdout, "    life_used_prog_warn_threshold: 0x%x\n",
-		alert_config_out->life_used_prog_warn_threshold);
+CXL_EXPORT void cxl_cmd_unref(struct cxl_cmd *cmd)
+{
+	struct cxl_ctx *ctx;
 
-	fprintf(stdout, "    dev_over_temp_crit_alert_threshold: 0x%x\n",
-		le16_to_cpu(alert_config_out->dev_over_temp_crit_alert_threshold));
-	fprintf(stdout, "    dev_under_temp_crit_alert_threshold: 0x%x\n",
-		le16_to_cpu(alert_config_out->dev_under_temp_crit_alert_threshold));
-	fprintf(stdout, "    dev_over_temp_prog_warn_threshold: 0x%x\n",
-		le16_to_cpu(alert_config_out->dev_over_temp_prog_warn_threshold));
-	fprintf(stdout, "    dev_under_temp_prog_warn_threshold: 0x%x\n",
-		le16_to_cpu(alert_config_out->dev_under_temp_prog_warn_threshold));
-	fprintf(stdout, "    corr_vol_mem_err_prog_warn_thresold: 0x%x\n",
-		le16_to_cpu(alert_config_out->corr_vol_mem_err_prog_warn_thresold));
-	fprintf(stdout, "    corr_pers_mem_err_prog_warn_threshold: 0x%x\n",
-		le16_to_cpu(alert_config_out->corr_pers_mem_err_prog_warn_threshold));
+	if (!cmd)
+		return;
+	if (__atomic_sub_fetch(&cmd->refcount, 1, __ATOMIC_ACQ_REL) > 0)
+		return;
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
+	ctx = cxl_memdev_get_ctx(cmd->memdev);
+	cxl_payload_put(ctx, cmd->input_payload);
+	cxl_payload_put(ctx, cmd->output_payload);
+	cmd->input_payload = NULL;
+	cmd->output_payload = NULL;
+
+	pthread_mutex_lock(&ctx->pool_lock);
+	if (ctx->cmd_pool_len >= CXL_CMD_POOL_MAX) {
+		pthread_mutex_unlock(&ctx->pool_lock);
+		free(cmd->query_cmd);
+		free(cmd->send_cmd);
+		free(cmd);
+		return;
+	}
+
+	/* keep the query and send buffers for the next cxl_cmd_new() */
+	list_add(&ctx->cmd_pool, &cmd->list);
+	ctx->cmd_pool_len++;
+	pthread_mutex_unlock(&ctx->pool_lock);
 }
 
-struct cxl_mbox_set_alert_config_in {
-    u8 valid_alert_actions;
-    u8 enable_alert_actions;
-    u8 life_used_prog_warn_threshold;
-    u8 reserved;
-    __le16 dev_over_temp_prog_warn_threshold;
-    __le16 dev_under_temp_prog_warn_threshold;
-    __le16 corr_vol_mem_err_prog_warn_thresold;
-    __le16 corr_pers_mem_err_prog_warn_threshold;
-}  __attribute__((packed));
+CXL_EXPORT void cxl_cmd_ref(struct cxl_cmd *cmd)
+{
+	__atomic_add_fetch(&cmd->refcount, 1, __ATOMIC_RELAXED);
+}
+
+static int cxl_cmd_alloc_query(struct cxl_cmd *cmd, int num_cmds)
+{
+	size_t size;
 
+	if (!cmd)
+		return -EINVAL;
 
-CXL_EXPORT int cxl_memdev_set_alert_config(struct cxl_memdev *memdev, u32 alert_prog_threshold,
-	u32 device_temp_threshold, u32 mem_error_threshold)
+	if (cmd->query_cmd != NULL)
+		free(cmd->query_cmd);
+
+	size = sizeof(struct cxl_mem_query_commands) +
+			(num_cmds * sizeof(struct cxl_command_info));
+	cmd->query_cmd = calloc(1, size);
+	if (!cmd->query_cmd)
+		return -ENOMEM;
+
+	cmd->query_cmd->n_commands = num_cmds;
+
+	return 0;
+}
+
+static struct cxl_cmd *cxl_cmd_new(struct cxl_memdev *memdev)
 {
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	struct cxl_mem_query_commands *query_cmd;
+	struct cxl_send_command *send_cmd;
 	struct cxl_cmd *cmd;
-	struct cxl_mbox_set_alert_config_in *alert_config_in;
-	int rc = 0;
+	size_t size;
 
-	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_SET_ALERT_CONFIG);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
+	pthread_mutex_lock(&ctx->pool_lock);
+	cmd = list_pop(&ctx->cmd_pool, struct cxl_cmd, list);
+	if (cmd)
+		ctx->cmd_pool_len--;
+	pthread_mutex_unlock(&ctx->pool_lock);
+	if (cmd) {
+		query_cmd = cmd->query_cmd;
+		send_cmd = cmd->send_cmd;
+		memset(cmd, 0, sizeof(*cmd));
+		cmd->query_cmd = query_cmd;
+		cmd->send_cmd = send_cmd;
+	} else {
+		size = sizeof(*cmd);
+		cmd = calloc(1, size);
+		if (!cmd)
+			return NULL;
 	}
 
-	alert_config_in = (void *) cmd->send_cmd->in.payload;
+	cxl_cmd_ref(cmd);
+	cmd->memdev = memdev;
 
-	alert_prog_threshold = cpu_to_be32(alert_prog_threshold);
-	device_temp_threshold = cpu_to_be32(device_temp_threshold);
-	mem_error_threshold = cpu_to_be32(mem_error_threshold);
+	return cmd;
+}
 
-	alert_config_in->valid_alert_actions = ((alert_prog_threshold >> 8) & 0xff);
-	alert_config_in->enable_alert_actions = ((alert_prog_threshold >> 16) & 0xff);
-	alert_config_in->life_used_prog_warn_threshold = ((alert_prog_threshold >> 24) & 0xff);
-	alert_config_in->reserved = 0;
+/* mailbox opcodes behind the kernel's well-known command ids */
+static const u16 cxl_mem_command_opcodes[CXL_MEM_COMMAND_ID_MAX] = {
+	[CXL_MEM_COMMAND_ID_IDENTIFY] = 0x4000,
+	[CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS] = 0x0400,
+	[CXL_MEM_COMMAND_ID_GET_FW_INFO] = 0x0200,
+	[CXL_MEM_COMMAND_ID_GET_PARTITION_INFO] = 0x4100,
+	[CXL_MEM_COMMAND_ID_GET_LSA] = 0x4102,
+	[CXL_MEM_COMMAND_ID_GET_HEALTH_INFO] = 0x4200,
+	[CXL_MEM_COMMAND_ID_GET_LOG] = 0x0401,
+	[CXL_MEM_COMMAND_ID_SET_PARTITION_INFO] = 0x4101,
+	[CXL_MEM_COMMAND_ID_SET_LSA] = 0x4103,
+	[CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG] = 0x4201,
+	[CXL_MEM_COMMAND_ID_SET_ALERT_CONFIG] = 0x4202,
+	[CXL_MEM_COMMAND_ID_GET_SHUTDOWN_STATE] = 0x4203,
+	[CXL_MEM_COMMAND_ID_SET_SHUTDOWN_STATE] = 0x4204,
+	[CXL_MEM_COMMAND_ID_GET_POISON] = 0x4300,
+	[CXL_MEM_COMMAND_ID_INJECT_POISON] = 0x4301,
+	[CXL_MEM_COMMAND_ID_CLEAR_POISON] = 0x4302,
+	[CXL_MEM_COMMAND_ID_GET_SCAN_MEDIA_CAPS] = 0x4303,
+	[CXL_MEM_COMMAND_ID_SCAN_MEDIA] = 0x4304,
+	[CXL_MEM_COMMAND_ID_GET_SCAN_MEDIA] = 0x4305,
+};
 
-	alert_config_in->dev_over_temp_prog_warn_threshold = cpu_to_le16(be16_to_cpu(((device_temp_threshold) & 0xffff)));
-	alert_config_in->dev_under_temp_prog_warn_threshold = cpu_to_le16(be16_to_cpu((((device_temp_threshold) >> 16) & 0xffff)));
+static unsigned int cxl_cmd_get_opcode(struct cxl_cmd *cmd)
+{
+	u32 id = cmd->send_cmd->id;
 
-	alert_config_in->corr_vol_mem_err_prog_warn_thresold = cpu_to_le16(be16_to_cpu((mem_error_threshold & 0xffff)));
-	alert_config_in->corr_pers_mem_err_prog_warn_threshold = cpu_to_le16(be16_to_cpu(((mem_error_threshold >> 16) & 0xffff)));
+	if (id == CXL_MEM_COMMAND_ID_RAW)
+		return cmd->send_cmd->raw.opcode;
+	if (id < ARRAY_SIZE(cxl_mem_command_opcodes))
+		return cxl_mem_command_opcodes[id];
+	return 0;
+}
 
-	fprintf(stdout, "alert_config settings\n");
-	fprintf(stdout, "    valid_alert_actions: 0x%x\n", alert_config_in->valid_alert_actions);
-	fprintf(stdout, "    enable_alert_actions: 0x%x\n", alert_config_in->enable_alert_actions);
-	fprintf(stdout, "    life_used_prog_warn_threshold: 0x%x\n", alert_config_in->life_used_prog_warn_threshold);
-	fprintf(stdout, "    dev_over_temp_prog_warn_threshold: 0x%x\n",
-		le16_to_cpu(alert_config_in->dev_over_temp_prog_warn_threshold));
-	fprintf(stdout, "    dev_under_temp_prog_warn_threshold: 0x%x\n",
-		le16_to_cpu(alert_config_in->dev_under_temp_prog_warn_threshold));
-	fprintf(stdout, "    corr_vol_mem_err_prog_warn_thresold: 0x%x\n",
-		le16_to_cpu(alert_config_in->corr_vol_mem_err_prog_warn_thresold));
-	fprintf(stdout, "    corr_pers_mem_err_prog_warn_threshold: 0x%x\n",
-		le16_to_cpu(alert_config_in->corr_pers_mem_err_prog_warn_threshold));
+static u64 cxl_elapsed_ns(const struct timespec *start)
+{
+	struct timespec now;
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
-	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000000ULL
+		+ now.tv_nsec - start->tv_nsec;
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+static void cxl_mbox_stats_record(struct cxl_ctx *ctx, unsigned int opcode,
+		int error, u64 ns)
+{
+	struct cxl_mbox_stats *stats = NULL;
+	u64 us = ns / 1000;
+	int i, bucket = 0;
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_SET_ALERT_CONFIG) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_SET_ALERT_CONFIG);
-		return -EINVAL;
+	while (us && bucket < CXL_MBOX_STATS_NR_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
 	}
 
-	fprintf(stdout, "command completed successfully\n");
+	pthread_mutex_lock(&ctx->stats_lock);
+	for (i = 0; i < ctx->nr_mbox_stats; i++)
+		if (ctx->mbox_stats[i].opcode == opcode) {
+			stats = &ctx->mbox_stats[i];
+			break;
+		}
+
+	if (!stats) {
+		if (ctx->nr_mbox_stats == ctx->mbox_stats_alloc) {
+			int alloc = max(16, ctx->mbox_stats_alloc * 2);
+			struct cxl_mbox_stats *s;
 
+			s = realloc(ctx->mbox_stats, alloc * sizeof(*s));
+			if (!s)
+				goto out;
+			ctx->mbox_stats = s;
+			ctx->mbox_stats_alloc = alloc;
+		}
+		stats = &ctx->mbox_stats[ctx->nr_mbox_stats++];
+		memset(stats, 0, sizeof(*stats));
+		stats->opcode = opcode;
+	}
+
+	stats->count++;
+	if (error)
+		stats->errors++;
+	stats->total_ns += ns;
+	stats->max_ns = max_t(u64, stats->max_ns, ns);
+	stats->hist[bucket]++;
 out:
-	cxl_cmd_unref(cmd);
-	return rc;
+	pthread_mutex_unlock(&ctx->stats_lock);
 }
 
-struct cxl_health_info {
-    u8 health_state;
-    u8 media_status;
-    u8 additional_status;
-    u8 life_used;
-    __le16 device_temp;
-    __le32 dirty_shutdown_count;
-    __le32 corr_vol_mem_err_count;
-    __le32 corr_pers_mem_err_count;
-}  __attribute__((packed));
+/**
+ * cxl_ctx_get_mbox_stats - snapshot per-opcode mailbox accounting
+ * @ctx: cxl library context
+ * @stats: array to fill, may be NULL to size the snapshot
+ * @nr: number of entries available in @stats
+ *
+ * Every CXL_MEM_SEND_COMMAND ioctl issued through @ctx is accounted
+ * against its mailbox opcode. Returns the number of opcodes seen so
+ * far, which may be larger than @nr.
+ */
+CXL_EXPORT int cxl_ctx_get_mbox_stats(struct cxl_ctx *ctx,
+		struct cxl_mbox_stats *stats, int nr)
+{
+	int n;
+
+	pthread_mutex_lock(&ctx->stats_lock);
+	n = ctx->nr_mbox_stats;
+	if (stats && nr > 0)
+		memcpy(stats, ctx->mbox_stats,
+				min(n, nr) * sizeof(*stats));
+	pthread_mutex_unlock(&ctx->stats_lock);
+
+	return n;
+}
+
+CXL_EXPORT void cxl_ctx_reset_mbox_stats(struct cxl_ctx *ctx)
+{
+	pthread_mutex_lock(&ctx->stats_lock);
+	ctx->nr_mbox_stats = 0;
+	pthread_mutex_unlock(&ctx->stats_lock);
+}
+
+/*
+ * Mailbox flight recorder: a fixed ring of the most recent commands,
+ * cheap enough to leave enabled, for pulling out after a failure.
+ * @trace_head counts every command recorded, the ring holds the last
+ * @trace_len of them.
+ */
+#define CXL_MBOX_TRACE_MAX 65536
+
+/**
+ * cxl_set_mbox_trace - record recent mailbox commands in a ring
+ * @ctx: cxl library context
+ * @nr_entries: ring size, 0 to stop recording and drop the ring
+ *
+ * While the ring is enabled, the verbose payload hexdump that LOG_DEBUG
+ * otherwise prints for each command is skipped, since the ring already
+ * keeps the payloads. The CXL_MBOX_TRACE environment variable provides
+ * the default.
+ */
+CXL_EXPORT int cxl_set_mbox_trace(struct cxl_ctx *ctx, unsigned int nr_entries)
+{
+	struct cxl_mbox_trace_entry *trace = NULL;
+
+	nr_entries = min(nr_entries, CXL_MBOX_TRACE_MAX);
+	if (nr_entries) {
+		trace = calloc(nr_entries, sizeof(*trace));
+		if (!trace)
+			return -ENOMEM;
+	}
+
+	pthread_mutex_lock(&ctx->stats_lock);
+	free(ctx->trace);
+	ctx->trace = trace;
+	ctx->trace_len = nr_entries;
+	ctx->trace_head = 0;
+	pthread_mutex_unlock(&ctx->stats_lock);
+	return 0;
+}
+
+/**
+ * cxl_set_mbox_trace_dump - save the trace ring when a command fails
+ * @ctx: cxl library context
+ * @path: file to write with cxl_ctx_dump_mbox_trace(), or NULL
+ *
+ * The file is replaced every time an ioctl fails or the device returns
+ * a non-zero mailbox status. The CXL_MBOX_TRACE_DUMP environment
+ * variable provides the default.
+ */
+CXL_EXPORT int cxl_set_mbox_trace_dump(struct cxl_ctx *ctx, const char *path)
+{
+	char *p = NULL;
+
+	if (path) {
+		p = strdup(path);
+		if (!p)
+			return -ENOMEM;
+	}
+	free(ctx->trace_dump_path);
+	ctx->trace_dump_path = p;
+	return 0;
+}
+
+static int cxl_mbox_trace_copy(struct cxl_ctx *ctx,
+		struct cxl_mbox_trace_entry *entries, int nr)
+{
+	unsigned long long first;
+	int n, i;
+
+	n = min_t(unsigned long long, ctx->trace_head, ctx->trace_len);
+	if (!entries || nr <= 0)
+		return n;
+	first = ctx->trace_head - n;
+	for (i = 0; i < n && i < nr; i++)
+		entries[i] = ctx->trace[(first + i) % ctx->trace_len];
+	return n;
+}
+
+/**
+ * cxl_ctx_get_mbox_trace - snapshot the trace ring
+ * @ctx: cxl library context
+ * @entries: array to fill oldest first, may be NULL to size the snapshot
+ * @nr: number of entries available in @entries
+ *
+ * Returns the number of entries in the ring, which may be larger
+ * than @nr.
+ */
+CXL_EXPORT int cxl_ctx_get_mbox_trace(struct cxl_ctx *ctx,
+		struct cxl_mbox_trace_entry *entries, int nr)
+{
+	int n;
+
+	pthread_mutex_lock(&ctx->stats_lock);
+	n = cxl_mbox_trace_copy(ctx, entries, nr);
+	pthread_mutex_unlock(&ctx->stats_lock);
+	return n;
+}
+
+static int cxl_mbox_trace_write(int fd, const void *buf, size_t len)
+{
+	ssize_t rc;
+
+	while (len) {
+		rc = write(fd, buf, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf = (const char *) buf + rc;
+		len -= rc;
+	}
+	return 0;
+}
+
+/**
+ * cxl_ctx_dump_mbox_trace - write the trace ring to a file descriptor
+ * @ctx: cxl library context
+ * @fd: destination
+ *
+ * Writes a struct cxl_mbox_trace_header followed by the entries oldest
+ * first, as decoded by 'cxl mbox-trace'.
+ */
+CXL_EXPORT int cxl_ctx_dump_mbox_trace(struct cxl_ctx *ctx, int fd)
+{
+	struct cxl_mbox_trace_header hdr = {
+		.magic = CXL_MBOX_TRACE_MAGIC,
+		.version = CXL_MBOX_TRACE_VERSION,
+		.entry_size = sizeof(struct cxl_mbox_trace_entry),
+	};
+	struct cxl_mbox_trace_entry *entries = NULL;
+	int n, rc;
+
+	pthread_mutex_lock(&ctx->stats_lock);
+	n = cxl_mbox_trace_copy(ctx, NULL, 0);
+	if (n) {
+		entries = malloc(n * sizeof(*entries));
+		if (entries)
+			cxl_mbox_trace_copy(ctx, entries, n);
+	}
+	hdr.nr_recorded = ctx->trace_head;
+	pthread_mutex_unlock(&ctx->stats_lock);
+	if (n && !entries)
+		return -ENOMEM;
+
+	hdr.nr_entries = n;
+	rc = cxl_mbox_trace_write(fd, &hdr, sizeof(hdr));
+	if (rc == 0 && n)
+		rc = cxl_mbox_trace_write(fd, entries, n * sizeof(*entries));
+	free(entries);
+	return rc;
+}
+
+static void cxl_mbox_trace_save(struct cxl_ctx *ctx)
+{
+	const char *path = ctx->trace_dump_path;
+	char tmp[PATH_MAX];
+	int fd, rc;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid())
+			>= (int) sizeof(tmp))
+		return;
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return;
+	rc = cxl_ctx_dump_mbox_trace(ctx, fd);
+	close(fd);
+	if (rc || rename(tmp, path) < 0)
+		unlink(tmp);
+}
+
+static void cxl_mbox_trace_record(struct cxl_cmd *cmd, u64 timestamp_ns,
+		u64 latency_ns, int rc)
+{
+	struct cxl_ctx *ctx = cmd->memdev->ctx;
+	struct cxl_send_command *send_cmd = cmd->send_cmd;
+	struct cxl_mbox_trace_entry *e;
+	bool failed = rc < 0 || send_cmd->retval;
+
+	pthread_mutex_lock(&ctx->stats_lock);
+	if (!ctx->trace) {
+		pthread_mutex_unlock(&ctx->stats_lock);
+		return;
+	}
+	e = &ctx->trace[ctx->trace_head++ % ctx->trace_len];
+	e->timestamp_ns = timestamp_ns;
+	e->latency_ns = min_t(u64, latency_ns, UINT_MAX);
+	e->opcode = cxl_cmd_get_opcode(cmd);
+	e->memdev_id = cmd->memdev->id;
+	e->rc = rc;
+	e->mbox_status = send_cmd->retval;
+	e->in_size = send_cmd->in.size;
+	e->out_size = send_cmd->out.size;
+	memset(e->in, 0, sizeof(e->in));
+	memset(e->out, 0, sizeof(e->out));
+	if (send_cmd->in.payload && send_cmd->in.size > 0)
+		memcpy(e->in, (void *) send_cmd->in.payload,
+				min_t(int, send_cmd->in.size, sizeof(e->in)));
+	if (rc == 0 && send_cmd->out.payload && send_cmd->out.size > 0)
+		memcpy(e->out, (void *) send_cmd->out.payload,
+				min_t(int, send_cmd->out.size, sizeof(e->out)));
+	pthread_mutex_unlock(&ctx->stats_lock);
+
+	if (failed && ctx->trace_dump_path)
+		cxl_mbox_trace_save(ctx);
+}
+
+static int __do_cmd(struct cxl_cmd *cmd, int ioctl_cmd, int fd)
+{
+	struct cxl_ctx *ctx = cmd->memdev->ctx;
+	struct timespec start, now = { 0 };
+	void *cmd_buf;
+	u64 ns;
+	int rc;
+
+	switch (ioctl_cmd) {
+	case CXL_MEM_QUERY_COMMANDS:
+		cmd_buf = cmd->query_cmd;
+		break;
+	case CXL_MEM_SEND_COMMAND:
+		cmd_buf = cmd->send_cmd;
+		if (ctx->trace)
+			clock_gettime(CLOCK_REALTIME, &now);
+		else if (cxl_get_log_priority(ctx) == LOG_DEBUG)
+		{
+			hexdump_mbox(cmd, ctx);
+		}
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (ioctl_cmd == CXL_MEM_SEND_COMMAND)
+		usdt(libcxl, mbox_start, cxl_cmd_get_opcode(cmd),
+				cmd->send_cmd->in.size);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (ctx->transport) {
+		rc = ctx->transport(cmd->memdev, ioctl_cmd, cmd_buf,
+				ctx->transport_data);
+	} else {
+		rc = ioctl(fd, ioctl_cmd, cmd_buf);
+		if (rc < 0)
+			rc = -errno;
+	}
+
+	if (ioctl_cmd == CXL_MEM_SEND_COMMAND) {
+		ns = cxl_elapsed_ns(&start);
+		usdt(libcxl, mbox_done, cxl_cmd_get_opcode(cmd),
+				cmd->send_cmd->in.size, cmd->send_cmd->out.size,
+				rc, cmd->send_cmd->retval, ns);
+		cxl_mbox_stats_record(ctx, cxl_cmd_get_opcode(cmd),
+				rc < 0 || cmd->send_cmd->retval, ns);
+		if (ctx->trace)
+			cxl_mbox_trace_record(cmd, (u64) now.tv_sec * 1000000000ULL
+					+ now.tv_nsec, ns, rc);
+	}
+
+	return rc;
+}
+
+static int cxl_memdev_open(struct cxl_memdev *memdev)
+{
+	char *path;
+	struct stat st;
+	unsigned int major, minor;
+	int fd;
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	const char *devname = cxl_memdev_get_devname(memdev);
+
+	major = cxl_memdev_get_major(memdev);
+	minor = cxl_memdev_get_minor(memdev);
+
+	if (asprintf(&path, "/dev/cxl/%s", devname) < 0)
+		return -ENOMEM;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		err(ctx, "failed to open %s: %s\n", path, strerror(errno));
+		fd = -errno;
+		goto out;
+	}
+
+	if (fstat(fd, &st) < 0 || !S_ISCHR(st.st_mode)
+			|| major(st.st_rdev) != major
+			|| minor(st.st_rdev) != minor) {
+		err(ctx, "failed to validate %s as a CXL memdev node\n", path);
+		close(fd);
+		fd = -ENXIO;
+	}
+out:
+	free(path);
+	return fd;
+}
+
+static void cxl_memdev_close(struct cxl_memdev *memdev)
+{
+	int fd = __atomic_exchange_n(&memdev->fd, -1, __ATOMIC_ACQ_REL);
+
+	if (fd >= 0)
+		close(fd);
+}
+
+/*
+ * Commands that only read state, safe to issue a second time. Raw
+ * commands, vendor ones included, and the list reads that resume from
+ * where the previous call stopped are not.
+ */
+static bool cxl_cmd_is_query(struct cxl_cmd *cmd)
+{
+	switch (cmd->send_cmd->id) {
+	case CXL_MEM_COMMAND_ID_IDENTIFY:
+	case CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS:
+	case CXL_MEM_COMMAND_ID_GET_FW_INFO:
+	case CXL_MEM_COMMAND_ID_GET_PARTITION_INFO:
+	case CXL_MEM_COMMAND_ID_GET_LSA:
+	case CXL_MEM_COMMAND_ID_GET_HEALTH_INFO:
+	case CXL_MEM_COMMAND_ID_GET_LOG:
+	case CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG:
+	case CXL_MEM_COMMAND_ID_GET_SHUTDOWN_STATE:
+	case CXL_MEM_COMMAND_ID_GET_SCAN_MEDIA_CAPS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int do_cmd(struct cxl_cmd *cmd, int ioctl_cmd)
+{
+	struct cxl_memdev *memdev = cmd->memdev;
+	int rc, fd, retry = cxl_cmd_is_query(cmd);
+
+	if (memdev->ctx->transport)
+		return __do_cmd(cmd, ioctl_cmd, -1);
+
+	if (!memdev->persistent_fd) {
+		fd = cxl_memdev_open(memdev);
+		if (fd < 0)
+			return fd;
+		rc = __do_cmd(cmd, ioctl_cmd, fd);
+		close(fd);
+		return rc;
+	}
+
+	do {
+		fd = __atomic_load_n(&memdev->fd, __ATOMIC_ACQUIRE);
+		if (fd < 0) {
+			int old = -1;
+
+			fd = cxl_memdev_open(memdev);
+			if (fd < 0)
+				return fd;
+			if (!__atomic_compare_exchange_n(&memdev->fd, &old, fd,
+						false, __ATOMIC_ACQ_REL,
+						__ATOMIC_ACQUIRE)) {
+				close(fd);
+				fd = old;
+			}
+		}
+
+		rc = __do_cmd(cmd, ioctl_cmd, fd);
+
+		/*
+		 * The cached node may have been removed and re-created
+		 * underneath us, revalidate it, and retry once if the
+		 * command only reads. A failed command may still have
+		 * reached the device, so one that changes state is not
+		 * issued twice.
+		 */
+		if (rc != -ENODEV && rc != -ENXIO)
+			break;
+		cxl_memdev_close(memdev);
+	} while (retry--);
+
+	return rc;
+}
+
+/**
+ * cxl_memdev_set_persistent_fd - keep the memdev node open across commands
+ * @memdev: memory device to operate on
+ * @enable: non-zero to cache the file descriptor, zero to release it
+ *
+ * By default every command opens and validates /dev/cxl/<memdev>.
+ * High-rate pollers can opt in to keeping a validated descriptor open
+ * for the lifetime of the memdev. The descriptor is revalidated if a
+ * command fails with -ENODEV or -ENXIO, and the command is retried on
+ * the new one only if it is a read-only query of a standard command.
+ */
+CXL_EXPORT void cxl_memdev_set_persistent_fd(struct cxl_memdev *memdev,
+		int enable)
+{
+	memdev->persistent_fd = !!enable;
+	if (!enable)
+		cxl_memdev_close(memdev);
+}
+
+static int alloc_do_query(struct cxl_cmd *cmd, int num_cmds)
+{
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(cmd->memdev);
+	int rc;
+
+	rc = cxl_cmd_alloc_query(cmd, num_cmds);
+	if (rc)
+		return rc;
+
+	rc = do_cmd(cmd, CXL_MEM_QUERY_COMMANDS);
+	if (rc < 0)
+		err(ctx, "%s: query commands failed: %s\n",
+			cxl_memdev_get_devname(cmd->memdev),
+			strerror(-rc));
+	return rc;
+}
+
+/*
+ * The set of commands supported by a memdev does not change while the
+ * driver is bound, so run the two-step QUERY_COMMANDS sequence once and
+ * cache the result on the memdev for all subsequent commands.
+ */
+static int cxl_memdev_do_query(struct cxl_memdev *memdev)
+{
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct cxl_cmd query = {
+		.memdev = memdev,
+	};
+	int rc, n_commands;
+
+	if (__atomic_load_n(&memdev->query_cmd, __ATOMIC_ACQUIRE))
+		return 0;
+
+	rc = alloc_do_query(&query, 0);
+	if (rc)
+		goto out;
+
+	n_commands = query.query_cmd->n_commands;
+	dbg(ctx, "%s: supports %d commands\n", devname, n_commands);
+
+	rc = alloc_do_query(&query, n_commands);
+	if (rc)
+		goto out;
+
+	cxl_publish(&memdev->query_cmd, query.query_cmd, free);
+	return 0;
+out:
+	free(query.query_cmd);
+	return rc;
+}
+
+static int cxl_cmd_do_query(struct cxl_cmd *cmd)
+{
+	struct cxl_memdev *memdev = cmd->memdev;
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	const char *devname = cxl_memdev_get_devname(memdev);
+
+	switch (cmd->query_status) {
+	case CXL_CMD_QUERY_OK:
+		return 0;
+	case CXL_CMD_QUERY_UNSUPPORTED:
+		return -EOPNOTSUPP;
+	case CXL_CMD_QUERY_NOT_RUN:
+		break;
+	default:
+		err(ctx, "%s: Unknown query_status %d\n",
+			devname, cmd->query_status);
+		return -EINVAL;
+	}
+
+	return cxl_memdev_do_query(memdev);
+}
+
+static int cxl_cmd_validate(struct cxl_cmd *cmd, u32 cmd_id)
+{
+	struct cxl_memdev *memdev = cmd->memdev;
+	struct cxl_mem_query_commands *query = memdev->query_cmd;
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	u32 i;
+	int rc;
+
+	for (i = 0; i < query->n_commands; i++) {
+		struct cxl_command_info *cinfo = &query->commands[i];
+		const char *cmd_name = cxl_command_names[cinfo->id].name;
+
+		if (cinfo->id != cmd_id)
+			continue;
+
+		dbg(ctx, "%s: %s: in: %d, out %d, flags: %#08x\n",
+			devname, cmd_name, cinfo->size_in,
+			cinfo->size_out, cinfo->flags);
+
+		/*
+		 * Callers are allowed to adjust the payload sizes in
+		 * their command info, so hand out a private copy rather
+		 * than a pointer into the shared memdev table.
+		 */
+		if (!cmd->query_cmd) {
+			rc = cxl_cmd_alloc_query(cmd, 1);
+			if (rc)
+				return rc;
+		}
+		cmd->query_cmd->commands[0] = *cinfo;
+		cmd->query_idx = 0;
+		cmd->query_status = CXL_CMD_QUERY_OK;
+		return 0;
+	}
+	cmd->query_status = CXL_CMD_QUERY_UNSUPPORTED;
+	return -EOPNOTSUPP;
+}
+
+CXL_EXPORT int cxl_cmd_set_input_payload(struct cxl_cmd *cmd, void *buf,
+		int size)
+{
+	struct cxl_memdev *memdev = cmd->memdev;
+
+	if (size > memdev_payload_max(memdev) || size < 0)
+		return -EINVAL;
+
+	if (!buf) {
+
+		/* If the user didn't supply a buffer, allocate it */
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, size);
+		if (!cmd->input_payload)
+			return -ENOMEM;
+		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
+	} else {
+		/*
+		 * Use user-buffer as is. If an automatic allocation was
+		 * previously made (based on a fixed size from query),
+		 * it will get freed during unref.
+		 */
+		cmd->send_cmd->in.payload = (u64)buf;
+	}
+	cmd->send_cmd->in.size = size;
+
+	return 0;
+}
+
+CXL_EXPORT int cxl_cmd_set_output_payload(struct cxl_cmd *cmd, void *buf,
+		int size)
+{
+	struct cxl_memdev *memdev = cmd->memdev;
+
+	if (size > memdev_payload_max(memdev) || size < 0)
+		return -EINVAL;
+
+	if (!buf) {
+
+		/* If the user didn't supply a buffer, allocate it */
+		cmd->output_payload = cxl_cmd_alloc_output(cmd, size);
+		if (!cmd->output_payload)
+			return -ENOMEM;
+		cmd->send_cmd->out.payload = (u64)cmd->output_payload;
+	} else {
+		/*
+		 * Use user-buffer as is, and return any automatic
+		 * allocation to the pool now, so that a caller reusing
+		 * one buffer across commands does not hold a payload_max
+		 * buffer per command as well.
+		 */
+		cxl_payload_put(cxl_memdev_get_ctx(memdev),
+				cmd->output_payload);
+		cmd->output_payload = NULL;
+		cmd->send_cmd->out.payload = (u64)buf;
+	}
+	cmd->send_cmd->out.size = size;
+	cmd->out_size = size;
+
+	return 0;
+}
+
+static int cxl_cmd_alloc_send(struct cxl_cmd *cmd, u32 cmd_id)
+{
+	struct cxl_mem_query_commands *query = cmd->query_cmd;
+	struct cxl_command_info *cinfo = &query->commands[cmd->query_idx];
+	size_t size;
+
+	if (!query)
+		return -EINVAL;
+
+	size = sizeof(struct cxl_send_command);
+	if (cmd->send_cmd)
+		memset(cmd->send_cmd, 0, size);
+	else
+		cmd->send_cmd = calloc(1, size);
+	if (!cmd->send_cmd)
+		return -ENOMEM;
+
+	if (cinfo->id != cmd_id)
+		return -EINVAL;
+
+	cmd->send_cmd->id = cmd_id;
+
+	if (cinfo->size_in > 0) {
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
+		if (!cmd->input_payload)
+			return -ENOMEM;
+		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
+		cmd->send_cmd->in.size = cinfo->size_in;
+	}
+
+	if (cinfo->size_out < 0)
+		cinfo->size_out = memdev_payload_max(cmd->memdev); // -1 will require update
+
+	if (cinfo->size_out > 0) {
+		cmd->output_payload = cxl_cmd_alloc_output(cmd, cinfo->size_out);
+		if (!cmd->output_payload)
+			return -ENOMEM;
+		cmd->send_cmd->out.payload = (u64)cmd->output_payload;
+		cmd->send_cmd->out.size = cinfo->size_out;
+		cmd->out_size = cinfo->size_out;
+	}
+
+	return 0;
+}
+
+static struct cxl_cmd *cxl_cmd_new_generic(struct cxl_memdev *memdev,
+		u32 cmd_id)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	struct cxl_cmd *cmd;
+	int rc;
+
+	cmd = cxl_cmd_new(memdev);
+	if (!cmd)
+		return NULL;
+
+	rc = cxl_cmd_do_query(cmd);
+	if (rc) {
+		err(ctx, "%s: query returned: %s\n", devname, strerror(-rc));
+		errno = -rc;
+		goto fail;
+	}
+
+	rc = cxl_cmd_validate(cmd, cmd_id);
+	if (rc) {
+		errno = -rc;
+		goto fail;
+	}
+
+	rc = cxl_cmd_alloc_send(cmd, cmd_id);
+	if (rc) {
+		errno = -rc;
+		goto fail;
+	}
+
+	return cmd;
+
+fail:
+	cxl_cmd_unref(cmd);
+	return NULL;
+}
+
+CXL_EXPORT const char *cxl_cmd_get_devname(struct cxl_cmd *cmd)
+{
+	return cxl_memdev_get_devname(cmd->memdev);
+}
+
+#define cmd_get_int(cmd, n, N, field) \
+do { \
+	struct cxl_cmd_##n *c = (void *)cmd->send_cmd->out.payload; \
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_##N) \
+		return EINVAL; \
+	if (cmd->status < 0) \
+		return cmd->status; \
+	return le32_to_cpu(c->field); \
+} while(0);
+
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_get_health_info(
+		struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_HEALTH_INFO);
+}
+
+#define cmd_health_get_int(c, f) \
+do { \
+	cmd_get_int(c, get_health_info, GET_HEALTH_INFO, f); \
+} while (0);
+
+CXL_EXPORT int cxl_cmd_get_health_info_get_health_status(struct cxl_cmd *cmd)
+{
+	cmd_health_get_int(cmd, health_status);
+}
+
+CXL_EXPORT int cxl_cmd_get_health_info_get_media_status(struct cxl_cmd *cmd)
+{
+	cmd_health_get_int(cmd, media_status);
+}
+
+CXL_EXPORT int cxl_cmd_get_health_info_get_ext_status(struct cxl_cmd *cmd)
+{
+	cmd_health_get_int(cmd, ext_status);
+}
+
+CXL_EXPORT int cxl_cmd_get_health_info_get_life_used(struct cxl_cmd *cmd)
+{
+	cmd_health_get_int(cmd, life_used);
+}
+
+CXL_EXPORT int cxl_cmd_get_health_info_get_temperature(struct cxl_cmd *cmd)
+{
+	cmd_health_get_int(cmd, temperature);
+}
+
+CXL_EXPORT int cxl_cmd_get_health_info_get_dirty_shutdowns(struct cxl_cmd *cmd)
+{
+	cmd_health_get_int(cmd, dirty_shutdowns);
+}
+
+CXL_EXPORT int cxl_cmd_get_health_info_get_volatile_errors(struct cxl_cmd *cmd)
+{
+	cmd_health_get_int(cmd, volatile_errors);
+}
+
+CXL_EXPORT int cxl_cmd_get_health_info_get_pmem_errors(struct cxl_cmd *cmd)
+{
+	cmd_health_get_int(cmd, pmem_errors);
+}
+
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_identify(struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_IDENTIFY);
+}
+
+CXL_EXPORT int cxl_cmd_identify_get_fw_rev(struct cxl_cmd *cmd, char *fw_rev,
+		int fw_len)
+{
+	struct cxl_cmd_identify *id = (void *)cmd->send_cmd->out.payload;
+
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_IDENTIFY)
+		return -EINVAL;
+	if (cmd->status < 0)
+		return cmd->status;
+
+	if (fw_len > 0)
+		memcpy(fw_rev, id->fw_revision,
+			min(fw_len, CXL_CMD_IDENTIFY_FW_REV_LENGTH));
+	return 0;
+}
+
+CXL_EXPORT unsigned long long cxl_cmd_identify_get_partition_align(
+		struct cxl_cmd *cmd)
+{
+	struct cxl_cmd_identify *id = (void *)cmd->send_cmd->out.payload;
+
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_IDENTIFY)
+		return -EINVAL;
+	if (cmd->status < 0)
+		return cmd->status;
+
+	return le64_to_cpu(id->partition_align);
+}
+
+CXL_EXPORT unsigned int cxl_cmd_identify_get_lsa_size(struct cxl_cmd *cmd)
+{
+	struct cxl_cmd_identify *id = (void *)cmd->send_cmd->out.payload;
+
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_IDENTIFY)
+		return -EINVAL;
+	if (cmd->status < 0)
+		return cmd->status;
+
+	return le32_to_cpu(id->lsa_size);
+}
+
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_raw(struct cxl_memdev *memdev,
+		int opcode)
+{
+	struct cxl_cmd *cmd;
+
+	/* opcode '0' is reserved */
+	if (opcode <= 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (cxl_memdev_cel_check(memdev, opcode) == 0) {
+		dbg(memdev->ctx, "%s: opcode %#x not in the command effects log\n",
+				cxl_memdev_get_devname(memdev), opcode);
+		errno = EOPNOTSUPP;
+		return NULL;
+	}
+
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_RAW);
+	if (!cmd)
+		return NULL;
+
+	cmd->send_cmd->raw.opcode = opcode;
+	return cmd;
+}
+
+/*
+ * Vendor commands are raw commands whose input payload size is fixed
+ * by the opcode rather than reported by the kernel.
+ */
+static struct cxl_cmd *cxl_cmd_new_vendor(struct cxl_memdev *memdev,
+		int opcode, int size_in)
+{
+	struct cxl_command_info *cinfo;
+	struct cxl_cmd *cmd;
+	int rc;
+
+	cmd = cxl_cmd_new_raw(memdev, opcode);
+	if (!cmd)
+		return NULL;
+	if (size_in <= 0)
+		return cmd;
+
+	cinfo = &cmd->query_cmd->commands[cmd->query_idx];
+	cinfo->size_in = size_in;
+	rc = cxl_cmd_set_input_payload(cmd, NULL, size_in);
+	if (rc) {
+		cxl_cmd_unref(cmd);
+		errno = -rc;
+		return NULL;
+	}
+
+	return cmd;
+}
+
+/*
+ * Raw commands are set up to return up to payload_max, and the kernel
+ * allocates and clears that much on every submission. Commands that
+ * know how much they can return trim the transfer, the pooled buffer
+ * behind it is left as is so it can go back to the pool at any size.
+ */
+static void cxl_cmd_vendor_limit_out(struct cxl_cmd *cmd, int size)
+{
+	if (size < 0 || size >= cmd->out_size)
+		return;
+	cmd->send_cmd->out.size = size;
+	cmd->out_size = size;
+}
+
+static int cxl_cmd_vendor_submit(struct cxl_cmd *cmd)
+{
+	const char *devname = cxl_cmd_get_devname(cmd);
+	int rc;
+
+	rc = cxl_cmd_submit(cmd);
+	if (rc < 0) {
+		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
+				devname, rc, strerror(-rc));
+		return rc;
+	}
+
+	rc = cxl_cmd_get_mbox_status(cmd);
+	if (rc != 0) {
+		fprintf(stderr, "%s: firmware status: %d:\n%s\n", devname, rc,
+				rc < (int) ARRAY_SIZE(DEVICE_ERRORS) ?
+				DEVICE_ERRORS[rc] : "Unknown error");
+		return -ENXIO;
+	}
+
+	return 0;
+}
+
+/* output payload of a completed vendor command, or NULL on mismatch */
+static void *cxl_cmd_vendor_get_payload(struct cxl_cmd *cmd, int opcode,
+		int size)
+{
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_RAW
+			|| cmd->send_cmd->raw.opcode != opcode)
+		return NULL;
+	if (cmd->status != 0)
+		return NULL;
+	if (cmd->send_cmd->out.size < size)
+		return NULL;
+	return (void *)cmd->send_cmd->out.payload;
+}
+
+#define cmd_vendor_get_int(cmd, n, N, bits, field) \
+do { \
+	struct cxl_mbox_##n##_out *o = cxl_cmd_vendor_get_payload(cmd, \
+		CXL_MEM_COMMAND_ID_##N##_OPCODE, sizeof(*o)); \
+	if (!o) \
+		return -EINVAL; \
+	return le##bits##_to_cpu(o->field); \
+} while (0)
+
+/* for 64-bit fields, whose full range an int return can not carry */
+#define cmd_vendor_get_u64(cmd, n, N, field, val) \
+do { \
+	struct cxl_mbox_##n##_out *o = cxl_cmd_vendor_get_payload(cmd, \
+		CXL_MEM_COMMAND_ID_##N##_OPCODE, sizeof(*o)); \
+	if (!o) \
+		return -EINVAL; \
+	*(val) = le64_to_cpu(o->field); \
+	return 0; \
+} while (0)
+
+/*
+ * Table-driven vendor commands. cligen emits one struct cxl_vendor_cmd
+ * per opcode describing where each argument lands in the input payload
+ * and how to print the output payload, and the exported
+ * cxl_memdev_<cmd>() entry point is a thin wrapper around
+ * cxl_memdev_vendor_cmd(). Scalar arguments are passed by value, array
+ * arguments as a pointer to host-endian elements.
+ *
+ * A CXL_VF_VARIABLE field is a trailing array whose element count is
+ * another field of the same payload, at @count_offset, or with no
+ * @count_width whatever fits in the payload. @size_in and @size_out are
+ * then only the fixed part, and the payload grows to hold the array, up
+ * to payload_max.
+ */
+#define CXL_VF_CONTIGUOUS (1 << 0)
+#define CXL_VF_VARIABLE (1 << 1)
+
+struct cxl_vendor_field {
+	const char *name;
+	const char *mn;
+	const char * const *enums;
+	u16 offset;
+	u16 count_offset;
+	u8 width;
+	u8 count;
+	u8 count_width;
+	u8 flags;
+	u8 nr_enums;
+};
+
+#define CXL_VC_VAR_IN (1 << 0)
+
+/*
+ * How a buffer or log command pages: each read returns the next
+ * elements of out field @data, until out field @end is set, an empty
+ * page, or with an @index, a page shorter than the @count asked for.
+ * @index is the input field advanced past each page. -1 when absent.
+ */
+struct cxl_vendor_stream {
+	u8 data;
+	s8 end;
+	s8 index;
+	s8 count;
+};
+
+struct cxl_vendor_cmd {
+	const char *title;
+	const struct cxl_vendor_field *in;
+	const struct cxl_vendor_field *out;
+	const struct cxl_vendor_stream *stream;
+	u16 opcode;
+	u16 size_in;
+	u16 size_out;
+	u8 nr_in;
+	u8 nr_out;
+	u8 flags;
+};
+
+static u64 cxl_vendor_get(const void *p, int width)
+{
+	__le16 v16;
+	__le32 v32;
+	__le64 v64;
+
+	switch (width) {
+	case 2:
+		memcpy(&v16, p, sizeof(v16));
+		return le16_to_cpu(v16);
+	case 4:
+		memcpy(&v32, p, sizeof(v32));
+		return le32_to_cpu(v32);
+	case 8:
+		memcpy(&v64, p, sizeof(v64));
+		return le64_to_cpu(v64);
+	default:
+		return *(const u8 *)p;
+	}
+}
+
+static void cxl_vendor_put(void *p, int width, u64 v)
+{
+	__le16 v16;
+	__le32 v32;
+	__le64 v64;
+
+	switch (width) {
+	case 2:
+		v16 = cpu_to_le16(v);
+		memcpy(p, &v16, sizeof(v16));
+		break;
+	case 4:
+		v32 = cpu_to_le32(v);
+		memcpy(p, &v32, sizeof(v32));
+		break;
+	case 8:
+		v64 = cpu_to_le64(v);
+		memcpy(p, &v64, sizeof(v64));
+		break;
+	default:
+		*(u8 *)p = v;
+		break;
+	}
+}
+
+/* element @i of a caller supplied host-endian array */
+static u64 cxl_vendor_elem(const void *a, int width, int i)
+{
+	switch (width) {
+	case 2:
+		return ((const u16 *)a)[i];
+	case 4:
+		return ((const u32 *)a)[i];
+	case 8:
+		return ((const u64 *)a)[i];
+	default:
+		return ((const u8 *)a)[i];
+	}
+}
+
+static bool cxl_vendor_is_array(const struct cxl_vendor_field *f)
+{
+	return f->count || (f->flags & CXL_VF_VARIABLE);
+}
+
+/* elements of @f in a @size byte payload, never more than it holds */
+static int cxl_vendor_count(const struct cxl_vendor_field *f,
+		const void *payload, int size)
+{
+	int nr, fit;
+
+	if (!(f->flags & CXL_VF_VARIABLE))
+		return f->count;
+
+	fit = size > f->offset ? (size - f->offset) / f->width : 0;
+	if (!f->count_width)
+		return fit;
+	nr = cxl_vendor_get((const unsigned char *)payload + f->count_offset,
+			f->count_width);
+	return min(nr, fit);
+}
+
+static void cxl_vendor_encode(void *in, const struct cxl_vendor_field *f,
+		u64 arg, int nr)
+{
+	unsigned char *p = (unsigned char *)in + f->offset;
+	const void *a = (const void *)(uintptr_t)arg;
+	int i;
+
+	if (!cxl_vendor_is_array(f)) {
+		cxl_vendor_put(p, f->width, arg);
+		return;
+	}
+
+	for (i = 0; i < nr; i++)
+		cxl_vendor_put(p + i * f->width, f->width,
+				cxl_vendor_elem(a, f->width, i));
+}
+
+/* hand a decoded field to the context's vendor output, if one is set */
+static bool cxl_vendor_emit(struct cxl_memdev *memdev, const char *title,
+		const char *field, const char *label, u64 value, int index)
+{
+	struct cxl_ctx *ctx = memdev->ctx;
+	struct cxl_vendor_value v = {
+		.cmd = title,
+		.field = field,
+		.label = label,
+		.value = value,
+		.index = index,
+	};
+
+	if (!ctx->vendor_output)
+		return false;
+	ctx->vendor_output(memdev, &v, ctx->vendor_output_data);
+	return true;
+}
+
+static void cxl_vendor_output(struct cxl_memdev *memdev,
+		const struct cxl_vendor_cmd *vc, const void *out, int size)
+{
+	int i, j;
+
+	for (i = 0; i < vc->nr_out; i++) {
+		const struct cxl_vendor_field *f = &vc->out[i];
+		const unsigned char *p = (const unsigned char *)out + f->offset;
+		int nr = cxl_vendor_count(f, out, size);
+		u64 v;
+
+		if (!cxl_vendor_is_array(f)) {
+			v = cxl_vendor_get(p, f->width);
+			cxl_vendor_emit(memdev, vc->title, f->name,
+					f->enums && v < f->nr_enums ?
+					f->enums[v] : NULL, v, -1);
+			continue;
+		}
+		for (j = 0; j < nr; j++)
+			cxl_vendor_emit(memdev, vc->title, f->name, NULL,
+					cxl_vendor_get(p + j * f->width,
+						f->width), j);
+	}
+}
+
+static void cxl_vendor_print(const struct cxl_vendor_cmd *vc, const void *out,
+		int size)
+{
+	static const char rule[] = "========================================"
+		"========================================";
+	int len = strlen(vc->title);
+	int left = len < 78 ? (78 - len) / 2 : 0;
+	int right = max_t(int, 80 - left - len - 2, 0);
+	int i, j;
+
+	fprintf(stdout, "%.*s %s %.*s\n", left, rule, vc->title, right, rule);
+	for (i = 0; i < vc->nr_out; i++) {
+		const struct cxl_vendor_field *f = &vc->out[i];
+		const unsigned char *p = (const unsigned char *)out + f->offset;
+		int nr = cxl_vendor_count(f, out, size);
+		u64 v;
+
+		if (!cxl_vendor_is_array(f)) {
+			v = cxl_vendor_get(p, f->width);
+			if (f->enums && v < f->nr_enums)
+				fprintf(stdout, "%s: %s\n", f->name, f->enums[v]);
+			else
+				fprintf(stdout, "%s: %llx\n", f->name,
+						(unsigned long long)v);
+			continue;
+		}
+
+		fprintf(stdout, "%s: ", f->name);
+		for (j = 0; j < nr; j++) {
+			v = cxl_vendor_get(p + j * f->width, f->width);
+			if (f->flags & CXL_VF_CONTIGUOUS)
+				fprintf(stdout, "%llx", (unsigned long long)v);
+			else
+				fprintf(stdout, "%s[%d]: %llx\n", f->mn, j,
+						(unsigned long long)v);
+		}
+		fprintf(stdout, "\n");
+	}
+}
+
+/*
+ * Most a @vc command with input payload @in can return: its fixed
+ * fields, and for a trailing array, as many elements as the stream asks
+ * for or its count field can express. Without a count field only the
+ * device knows, so the whole of payload_max.
+ */
+static int cxl_vendor_size_out(struct cxl_memdev *memdev,
+		const struct cxl_vendor_cmd *vc, const void *in)
+{
+	const struct cxl_vendor_stream *stream = vc->stream;
+	int i, nr, end, size = vc->size_out;
+	int limit = memdev_payload_max(memdev);
+
+	for (i = 0; i < vc->nr_out; i++) {
+		const struct cxl_vendor_field *f = &vc->out[i];
+
+		if (!(f->flags & CXL_VF_VARIABLE)) {
+			end = f->offset + f->width * max_t(int, f->count, 1);
+		} else {
+			if (!f->count_width || f->count_width > 2)
+				return limit;
+			nr = (1 << (8 * f->count_width)) - 1;
+			if (stream && stream->data == i && stream->count >= 0)
+				nr = min_t(u64, nr, cxl_vendor_get(
+					(const unsigned char *)in
+					+ vc->in[stream->count].offset,
+					vc->in[stream->count].width));
+			end = f->offset + nr * f->width;
+		}
+		size = max(size, end);
+	}
+	return min(size, limit);
+}
+
+/*
+ * Build, but do not submit, a @vc command with @args encoded. Variable
+ * length arrays are encoded after everything else, once the fields
+ * that count them are in place, and size the input payload.
+ */
+static struct cxl_cmd *cxl_vendor_cmd_new(struct cxl_memdev *memdev,
+		const struct cxl_vendor_cmd *vc, const u64 *args)
+{
+	int i, nr, end, limit = vc->size_in, size_in = vc->size_in;
+	struct cxl_cmd *cmd;
+
+	if (vc->flags & CXL_VC_VAR_IN) {
+		limit = memdev_payload_max(memdev);
+		if (limit < size_in) {
+			errno = EINVAL;
+			return NULL;
+		}
+	}
+
+	cmd = cxl_cmd_new_vendor(memdev, vc->opcode, limit);
+	if (!cmd)
+		return NULL;
+
+	for (i = 0; i < vc->nr_in; i++)
+		if (!(vc->in[i].flags & CXL_VF_VARIABLE))
+			cxl_vendor_encode(cmd->input_payload, &vc->in[i],
+					args[i], vc->in[i].count);
+
+	for (i = 0; i < vc->nr_in; i++) {
+		const struct cxl_vendor_field *f = &vc->in[i];
+
+		if (!(f->flags & CXL_VF_VARIABLE))
+			continue;
+		/* only the device knows what fills an output payload */
+		if (!f->count_width) {
+			cxl_cmd_unref(cmd);
+			errno = EINVAL;
+			return NULL;
+		}
+		nr = cxl_vendor_get((unsigned char *)cmd->input_payload
+				+ f->count_offset, f->count_width);
+		end = f->offset + nr * f->width;
+		if (end > limit) {
+			cxl_cmd_unref(cmd);
+			errno = EINVAL;
+			return NULL;
+		}
+		cxl_vendor_encode(cmd->input_payload, f, args[i], nr);
+		size_in = max(size_in, end);
+	}
+	if (vc->flags & CXL_VC_VAR_IN)
+		cmd->send_cmd->in.size = size_in;
+	cxl_cmd_vendor_limit_out(cmd,
+			cxl_vendor_size_out(memdev, vc, cmd->input_payload));
+
+	return cmd;
+}
+
+/*
+ * Zero-copy view of output field @idx of a completed @vc command:
+ * *@view points at the field in the mailbox output buffer, in device
+ * (little endian) order, and the return is its number of elements. It
+ * stays valid until the command is resubmitted or freed.
+ */
+static int cxl_vendor_cmd_view(struct cxl_cmd *cmd,
+		const struct cxl_vendor_cmd *vc, int idx, const void **view)
+{
+	const struct cxl_vendor_field *f = &vc->out[idx];
+	unsigned char *out;
+
+	out = cxl_cmd_vendor_get_payload(cmd, vc->opcode, vc->size_out);
+	if (!out)
+		return -EINVAL;
+	*view = out + f->offset;
+	if (!cxl_vendor_is_array(f))
+		return 1;
+	return cxl_vendor_count(f, out, cmd->send_cmd->out.size);
+}
+
+/*
+ * Read the next page of a buffer or log with one reused command: the
+ * return is the number of elements *@view points at, as for
+ * cxl_vendor_cmd_view(), 0 once the device has no more.
+ */
+static int cxl_vendor_cmd_next(struct cxl_cmd *cmd,
+		const struct cxl_vendor_cmd *vc, const void **view)
+{
+	const struct cxl_vendor_stream *s = vc->stream;
+	unsigned char *in = cmd->input_payload;
+	const struct cxl_vendor_field *f;
+	const void *end;
+	int nr, rc;
+
+	if (!s)
+		return -EINVAL;
+	if (cmd->stream_done)
+		return 0;
+
+	rc = cxl_cmd_submit(cmd);
+	if (rc < 0)
+		return rc;
+	if (cxl_cmd_get_mbox_status(cmd))
+		return -ENXIO;
+
+	nr = cxl_vendor_cmd_view(cmd, vc, s->data, view);
+	if (nr <= 0) {
+		cmd->stream_done = true;
+		return nr;
+	}
+
+	if (s->end >= 0) {
+		rc = cxl_vendor_cmd_view(cmd, vc, s->end, &end);
+		if (rc < 0)
+			return rc;
+		if (cxl_vendor_get(end, vc->out[s->end].width))
+			cmd->stream_done = true;
+	}
+
+	if (s->index >= 0) {
+		f = &vc->in[s->index];
+		cxl_vendor_put(in + f->offset, f->width,
+				cxl_vendor_get(in + f->offset, f->width) + nr);
+	}
+	if (s->count >= 0) {
+		f = &vc->in[s->count];
+		if ((u64) nr < cxl_vendor_get(in + f->offset, f->width))
+			cmd->stream_done = true;
+	}
+
+	return nr;
+}
+
+/* scalar output field @idx of a completed @vc command, host endian */
+#define cmd_vendor_get_field(cmd, vc, idx) \
+do { \
+	const void *p; \
+	int rc = cxl_vendor_cmd_view(cmd, vc, idx, &p); \
+	if (rc < 0) \
+		return rc; \
+	return cxl_vendor_get(p, (vc)->out[idx].width); \
+} while (0)
+
+static int cxl_memdev_vendor_cmd(struct cxl_memdev *memdev,
+		const struct cxl_vendor_cmd *vc, const u64 *args)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct cxl_cmd *cmd;
+	void *out;
+	int rc;
+
+	cmd = cxl_vendor_cmd_new(memdev, vc, args);
+	if (!cmd) {
+		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
+				devname);
+		return errno ? -errno : -ENOMEM;
+	}
+
+	rc = cxl_cmd_vendor_submit(cmd);
+	if (rc)
+		goto out;
+
+	out = cxl_cmd_vendor_get_payload(cmd, vc->opcode, vc->size_out);
+	if (!out) {
+		fprintf(stderr, "%s: invalid response to opcode 0x%x\n",
+				devname, vc->opcode);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	if (vc->title && memdev->ctx->vendor_output)
+		cxl_vendor_output(memdev, vc, out, cmd->send_cmd->out.size);
+	else if (vc->title)
+		cxl_vendor_print(vc, out, cmd->send_cmd->out.size);
+
+out:
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_get_lsa(struct cxl_memdev *memdev,
+		unsigned int offset, unsigned int length)
+{
+	struct cxl_cmd_get_lsa_in *get_lsa;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_LSA);
+	if (!cmd)
+		return NULL;
+
+	get_lsa = (void *)cmd->send_cmd->in.payload;
+	get_lsa->offset = cpu_to_le32(offset);
+	get_lsa->length = cpu_to_le32(length);
+	return cmd;
+}
+
+#define cmd_get_void(cmd, N) \
+do { \
+	void *p = (void *)cmd->send_cmd->out.payload; \
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_##N) \
+		return NULL; \
+	if (cmd->status < 0) \
+		return NULL; \
+	return p; \
+} while(0);
+
+CXL_EXPORT void *cxl_cmd_get_lsa_get_payload(struct cxl_cmd *cmd)
+{
+	cmd_get_void(cmd, GET_LSA);
+}
+
+CXL_EXPORT int cxl_cmd_submit(struct cxl_cmd *cmd)
+{
+	struct cxl_memdev *memdev = cmd->memdev;
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	int rc;
+
+	switch (cmd->query_status) {
+	case CXL_CMD_QUERY_OK:
+		break;
+	case CXL_CMD_QUERY_UNSUPPORTED:
+		return -EOPNOTSUPP;
+	case CXL_CMD_QUERY_NOT_RUN:
+		return -EINVAL;
+	default:
+		err(ctx, "%s: Unknown query_status %d\n",
+			devname, cmd->query_status);
+		return -EINVAL;
+	}
+
+	/*
+	 * The kernel trims out.size to the returned length, restore the
+	 * buffer capacity so a command can be modified and resubmitted.
+	 */
+	cmd->send_cmd->out.size = cmd->out_size;
+	cmd->send_cmd->retval = 0;
+	cmd->status = 0;
+
+	dbg(ctx, "%s: submitting SEND cmd: in: %d, out: %d\n", devname,
+		cmd->send_cmd->in.size, cmd->send_cmd->out.size);
+	rc = do_cmd(cmd, CXL_MEM_SEND_COMMAND);
+	if (rc < 0)
+		err(ctx, "%s: send command failed: %s\n",
+			devname, strerror(-rc));
+	cmd->status = cmd->send_cmd->retval;
+	dbg(ctx, "%s: got SEND cmd: in: %d, out: %d, retval: %d\n", devname,
+		cmd->send_cmd->in.size, cmd->send_cmd->out.size, cmd->status);
+
+	return rc;
+}
+
+CXL_EXPORT int cxl_cmd_get_mbox_status(struct cxl_cmd *cmd)
+{
+	return cmd->status;
+}
+
+CXL_EXPORT int cxl_cmd_get_out_size(struct cxl_cmd *cmd)
+{
+	return cmd->send_cmd->out.size;
+}
+
+CXL_EXPORT void *cxl_cmd_get_input_payload(struct cxl_cmd *cmd)
+{
+	return (void *)cmd->send_cmd->in.payload;
+}
+
+CXL_EXPORT void *cxl_cmd_get_output_payload(struct cxl_cmd *cmd)
+{
+	return (void *)cmd->send_cmd->out.payload;
+}
+
+struct cxl_cmd_batch_entry {
+	struct cxl_cmd *cmd;
+	int rc;
+};
+
+/**
+ * struct cxl_cmd_batch - set of prepared commands submitted together
+ * @ctx: library context the commands belong to
+ * @entries: commands in submission order with their submit result
+ * @nr: number of queued commands
+ * @alloc: allocated size of @entries
+ * @stop_on_error: once a command fails, by submission or mailbox
+ *	status, cancel the ones queued after it for the same memdev
+ */
+struct cxl_cmd_batch {
+	struct cxl_ctx *ctx;
+	struct cxl_cmd_batch_entry *entries;
+	int nr, alloc;
+	bool stop_on_error;
+};
+
+struct cxl_cmd_batch_worker {
+	struct cxl_cmd_batch *batch;
+	struct cxl_memdev *memdev;
+	pthread_t thread;
+	int started;
+};
+
+CXL_EXPORT struct cxl_cmd_batch *cxl_cmd_batch_new(struct cxl_ctx *ctx)
+{
+	struct cxl_cmd_batch *batch;
+
+	batch = calloc(1, sizeof(*batch));
+	if (!batch)
+		return NULL;
+	batch->ctx = ctx;
+	return batch;
+}
+
+CXL_EXPORT void cxl_cmd_batch_free(struct cxl_cmd_batch *batch)
+{
+	int i;
+
+	if (!batch)
+		return;
+	for (i = 0; i < batch->nr; i++)
+		cxl_cmd_unref(batch->entries[i].cmd);
+	free(batch->entries);
+	free(batch);
+}
+
+/**
+ * cxl_cmd_batch_add - queue a prepared command
+ * @batch: batch established by cxl_cmd_batch_new()
+ * @cmd: fully prepared command, the batch takes its own reference
+ *
+ * Returns the index of @cmd in the batch, or a negative error code.
+ */
+CXL_EXPORT int cxl_cmd_batch_add(struct cxl_cmd_batch *batch,
+		struct cxl_cmd *cmd)
+{
+	struct cxl_cmd_batch_entry *entries;
+
+	if (!cmd || cxl_memdev_get_ctx(cmd->memdev) != batch->ctx)
+		return -EINVAL;
+
+	if (batch->nr == batch->alloc) {
+		int alloc = batch->alloc ? batch->alloc * 2 : 16;
+
+		entries = realloc(batch->entries, alloc * sizeof(*entries));
+		if (!entries)
+			return -ENOMEM;
+		batch->entries = entries;
+		batch->alloc = alloc;
+	}
+
+	cxl_cmd_ref(cmd);
+	batch->entries[batch->nr].cmd = cmd;
+	batch->entries[batch->nr].rc = -EINPROGRESS;
+	return batch->nr++;
+}
+
+CXL_EXPORT int cxl_cmd_batch_get_count(struct cxl_cmd_batch *batch)
+{
+	return batch->nr;
+}
+
+CXL_EXPORT struct cxl_cmd *cxl_cmd_batch_get_cmd(struct cxl_cmd_batch *batch,
+		int idx)
+{
+	if (idx < 0 || idx >= batch->nr)
+		return NULL;
+	return batch->entries[idx].cmd;
+}
+
+/**
+ * cxl_cmd_batch_get_result - retrieve the submission result of one command
+ * @batch: submitted batch
+ * @idx: index returned by cxl_cmd_batch_add()
+ *
+ * Returns the cxl_cmd_submit() result for the command. The mailbox
+ * status is available from cxl_cmd_get_mbox_status().
+ */
+CXL_EXPORT int cxl_cmd_batch_get_result(struct cxl_cmd_batch *batch, int idx)
+{
+	if (idx < 0 || idx >= batch->nr)
+		return -EINVAL;
+	return batch->entries[idx].rc;
+}
+
+static void *cxl_cmd_batch_run(void *arg)
+{
+	struct cxl_cmd_batch_worker *worker = arg;
+	struct cxl_cmd_batch *batch = worker->batch;
+	bool failed = false;
+	int i;
 
-CXL_EXPORT int cxl_memdev_get_health_info(struct cxl_memdev *memdev)
+	for (i = 0; i < batch->nr; i++) {
+		struct cxl_cmd_batch_entry *entry = &batch->entries[i];
+
+		if (entry->cmd->memdev != worker->memdev)
+			continue;
+		if (failed) {
+			entry->rc = -ECANCELED;
+			continue;
+		}
+		entry->rc = cxl_cmd_submit(entry->cmd);
+		if (batch->stop_on_error && (entry->rc < 0
+					|| cxl_cmd_get_mbox_status(entry->cmd)))
+			failed = true;
+	}
+
+	return NULL;
+}
+
+/**
+ * cxl_cmd_batch_submit - submit all queued commands
+ * @batch: batch established by cxl_cmd_batch_new()
+ *
+ * Commands targeting the same memdev are issued in the order they were
+ * added. Commands for different memdevs are issued concurrently, one
+ * thread per memdev, so the batch completes in roughly the time of the
+ * slowest device rather than the sum of all of them.
+ *
+ * Returns 0 if every command was submitted, otherwise the first
+ * failure in queue order. Per-command results are available from
+ * cxl_cmd_batch_get_result().
+ */
+CXL_EXPORT int cxl_cmd_batch_submit(struct cxl_cmd_batch *batch)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_health_info *health_info;
-	int rc = 0;
+	struct cxl_cmd_batch_worker *workers;
+	struct cxl_ctx *ctx = batch->ctx;
+	int i, j, nr_workers = 0, rc = 0;
 
-	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_HEALTH_INFO);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_memdev_get_health_info returned Null output\n",
-				cxl_memdev_get_devname(memdev));
+	if (!batch->nr)
+		return 0;
+
+	workers = calloc(batch->nr, sizeof(*workers));
+	if (!workers)
 		return -ENOMEM;
+
+	for (i = 0; i < batch->nr; i++) {
+		struct cxl_memdev *memdev = batch->entries[i].cmd->memdev;
+
+		for (j = 0; j < nr_workers; j++)
+			if (workers[j].memdev == memdev)
+				break;
+		if (j < nr_workers)
+			continue;
+		workers[nr_workers].batch = batch;
+		workers[nr_workers].memdev = memdev;
+		nr_workers++;
 	}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
+	/* the calling thread services the first memdev itself */
+	for (i = 1; i < nr_workers; i++) {
+		rc = pthread_create(&workers[i].thread, NULL,
+				cxl_cmd_batch_run, &workers[i]);
+		if (rc) {
+			dbg(ctx, "worker for %s failed to start: %s\n",
+				cxl_memdev_get_devname(workers[i].memdev),
+				strerror(rc));
+			continue;
+		}
+		workers[i].started = 1;
 	}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
+	cxl_cmd_batch_run(&workers[0]);
+
+	for (i = 1; i < nr_workers; i++) {
+		if (workers[i].started)
+			pthread_join(workers[i].thread, NULL);
+		else
+			cxl_cmd_batch_run(&workers[i]);
 	}
+	free(workers);
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_HEALTH_INFO) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_HEALTH_INFO);
-		return -EINVAL;
+	rc = 0;
+	for (i = 0; i < batch->nr; i++)
+		if (batch->entries[i].rc < 0) {
+			rc = batch->entries[i].rc;
+			break;
+		}
+
+	return rc;
+}
+
+/**
+ * struct cxl_memdev_worker - per-memdev thread for asynchronous commands
+ * @thread: worker thread, started on the first cxl_cmd_submit_async()
+ * @lock: protects @queue and @stop
+ * @cond: signalled when work is queued or the worker is stopped
+ * @queue: commands waiting to be submitted, in submission order
+ * @stop: drain @queue and exit
+ */
+struct cxl_memdev_worker {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct list_head queue;
+	int stop;
+};
+
+static void *cxl_memdev_worker_run(void *arg)
+{
+	struct cxl_memdev *memdev = arg;
+	struct cxl_memdev_worker *worker = memdev->worker;
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	struct cxl_cmd *cmd;
+
+	for (;;) {
+		pthread_mutex_lock(&worker->lock);
+		while (!worker->stop && list_empty(&worker->queue))
+			pthread_cond_wait(&worker->cond, &worker->lock);
+		cmd = list_pop(&worker->queue, struct cxl_cmd, list);
+		pthread_mutex_unlock(&worker->lock);
+		if (!cmd)
+			break;
+
+		if (cmd->bg_timeout_ms >= 0)
+			cmd->async_rc = cxl_cmd_submit_bg(cmd, cmd->bg_timeout_ms,
+					NULL, NULL);
+		else
+			cmd->async_rc = cxl_cmd_submit(cmd);
+
+		pthread_mutex_lock(&ctx->async_lock);
+		list_add_tail(&ctx->async_done, &cmd->list);
+		pthread_mutex_unlock(&ctx->async_lock);
+		eventfd_write(ctx->async_fd, 1);
 	}
 
-	if (cmd->send_cmd->out.size != sizeof(*health_info)) {
-		fprintf(stderr, "%s: invalid payload output size (got: %d, required: %ld)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->out.size, sizeof(*health_info));
-		return -EINVAL;
+	return NULL;
+}
+
+static int cxl_memdev_worker_start(struct cxl_memdev *memdev)
+{
+	struct cxl_memdev_worker *worker;
+	int rc;
+
+	worker = calloc(1, sizeof(*worker));
+	if (!worker)
+		return -ENOMEM;
+	list_head_init(&worker->queue);
+	pthread_mutex_init(&worker->lock, NULL);
+	pthread_cond_init(&worker->cond, NULL);
+	memdev->worker = worker;
+
+	rc = pthread_create(&worker->thread, NULL, cxl_memdev_worker_run,
+			memdev);
+	if (rc) {
+		pthread_cond_destroy(&worker->cond);
+		pthread_mutex_destroy(&worker->lock);
+		free(worker);
+		memdev->worker = NULL;
+		return -rc;
 	}
 
-	health_info = (void *)cmd->send_cmd->out.payload;
+	return 0;
+}
 
-	fprintf(stdout, "Device Health Info\n");
-	fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
-	fprintf(stdout, "    health_state: 0x%x\n", health_info->health_state);
-	fprintf(stdout, "    media_status: 0x%x\n", health_info->media_status);
-	fprintf(stdout, "    additional_status: 0x%x\n", health_info->additional_status);
-	fprintf(stdout, "    life_used: 0x%x\n", health_info->life_used);
-	fprintf(stdout, "    device_temp: 0x%x\n", le16_to_cpu(health_info->device_temp));
-	fprintf(stdout, "    dirty_shutdown_count: 0x%x\n", le32_to_cpu(health_info->dirty_shutdown_count));
-	fprintf(stdout, "    corr_vol_mem_err_count: 0x%x\n", le32_to_cpu(health_info->corr_vol_mem_err_count));
-	fprintf(stdout, "    corr_pers_mem_err_count: 0x%x\n", le32_to_cpu(health_info->corr_pers_mem_err_count));
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
+/* flush queued commands and join the worker, completions stay queued */
+static void cxl_memdev_worker_stop(struct cxl_memdev *memdev)
+{
+	struct cxl_memdev_worker *worker = memdev->worker;
+
+	if (!worker)
+		return;
+
+	pthread_mutex_lock(&worker->lock);
+	worker->stop = 1;
+	pthread_cond_signal(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+	pthread_join(worker->thread, NULL);
+
+	pthread_cond_destroy(&worker->cond);
+	pthread_mutex_destroy(&worker->lock);
+	free(worker);
+	memdev->worker = NULL;
 }
 
-#define CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_OPCODE 0x100
-#define CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_PAYLOAD_IN_SIZE 0x1
-#define CXL_MAX_RECORDS_TO_DUMP 20
+/**
+ * cxl_get_async_fd - retrieve the completion descriptor for async commands
+ * @ctx: cxl library context
+ *
+ * Returns an eventfd that becomes readable whenever a command queued by
+ * cxl_cmd_submit_async() completes, suitable for poll() or epoll. Call
+ * cxl_async_complete() when it is readable. The descriptor is owned by
+ * the library and closed by the final cxl_unref().
+ */
+CXL_EXPORT int cxl_get_async_fd(struct cxl_ctx *ctx)
+{
+	int fd;
 
-#define CXL_DRAM_EVENT_GUID "601dcbb3-9c06-4eab-b8af-4e9bfb5c9624"
-#define CXL_MEM_MODULE_EVENT_GUID "fe927475-dd59-4339-a586-79bab113b774"
+	if (ctx->async_fd >= 0)
+		return ctx->async_fd;
 
-struct cxl_dram_event_record {
-	__le64 physical_addr;
-	u8 memory_event_descriptor;
-	u8 memory_event_type;
-	u8 transaction_type;
-	__le16 validity_flags;
-	u8 channel;
-	u8 rank;
-	u8 nibble_mask[3];
-	u8 bank_group;
-	u8 bank;
-	u8 row[3];
-	__le16 column;
-	u8 correction_mask[0x20];
-        u8 component_identifier[0x10];
-        u8 sub_channel;
-	u8 reserved[0x6];
-} __attribute__((packed));
+	fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (fd < 0)
+		return -errno;
+	ctx->async_fd = fd;
+	return fd;
+}
 
-struct cxl_memory_module_record {
-	u8 dev_event_type;
-	u8 dev_health_info[0x12];
-	u8 reserved[0x3d];
-}__attribute__((packed));
+/**
+ * cxl_cmd_submit_async - queue a command without waiting for completion
+ * @cmd: fully prepared command
+ * @done: completion callback, may be NULL
+ * @data: opaque pointer passed to @done
+ *
+ * The command is handed to a worker thread owned by its memdev, so
+ * commands to one memdev execute in submission order while the caller
+ * continues. Callbacks are never run from the worker; they run from
+ * cxl_async_complete() in the caller's thread. The library holds a
+ * reference on @cmd until its callback has returned.
+ */
+static int cxl_cmd_queue_async(struct cxl_cmd *cmd, cxl_cmd_done_fn done,
+		void *data, int bg_timeout_ms)
+{
+	struct cxl_memdev *memdev = cmd->memdev;
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	struct cxl_memdev_worker *worker;
+	int rc;
 
-struct cxl_event_record {
-	uuid_t uuid;
-	u8 event_record_length;
-	u8 event_record_flags[3];
-	__le16 event_record_handle;
-	__le16 related_event_record_handle;
-	__le64 event_record_ts;
-	u8 reserved[0x10];
-	union {
-		struct cxl_dram_event_record dram_event_record;
-		struct cxl_memory_module_record memory_module_record;
-	} event_record;
-} __attribute__((packed));
+	rc = cxl_get_async_fd(ctx);
+	if (rc < 0)
+		return rc;
 
-struct cxl_get_event_record_info {
-    u8 flags;
-    u8 reserved1;
-    __le16 overflow_err_cnt;
-    __le64 first_overflow_evt_ts;
-    __le64 last_overflow_evt_ts;
-    __le16 event_record_count;
-	u8 reserved2[0xa];
-	struct cxl_event_record event_records[];
-}  __attribute__((packed));
+	if (!memdev->worker) {
+		rc = cxl_memdev_worker_start(memdev);
+		if (rc) {
+			err(ctx, "%s: failed to start worker: %s\n",
+				cxl_memdev_get_devname(memdev), strerror(-rc));
+			return rc;
+		}
+	}
+	worker = memdev->worker;
 
-CXL_EXPORT int cxl_memdev_get_event_records(struct cxl_memdev *memdev, u8 event_log_type)
+	cxl_cmd_ref(cmd);
+	cmd->async_done = done;
+	cmd->async_data = data;
+	cmd->async_rc = -EINPROGRESS;
+	cmd->bg_timeout_ms = bg_timeout_ms;
+
+	pthread_mutex_lock(&worker->lock);
+	list_add_tail(&worker->queue, &cmd->list);
+	pthread_cond_signal(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+
+	return 0;
+}
+
+CXL_EXPORT int cxl_cmd_submit_async(struct cxl_cmd *cmd,
+		cxl_cmd_done_fn done, void *data)
+{
+	return cxl_cmd_queue_async(cmd, done, data, -1);
+}
+
+/**
+ * cxl_cmd_submit_bg_async - queue a background command and its wait
+ * @cmd: fully prepared command
+ * @timeout_ms: as for cxl_cmd_submit_bg()
+ * @done: completion callback, may be NULL
+ * @data: opaque pointer passed to @done
+ *
+ * Like cxl_cmd_submit_async(), but the memdev's worker also waits for
+ * the background operation @cmd starts, and @done receives the result
+ * of cxl_cmd_submit_bg(). Background operations on different memdevs
+ * proceed in parallel; later commands to the same memdev queue behind.
+ */
+CXL_EXPORT int cxl_cmd_submit_bg_async(struct cxl_cmd *cmd,
+		unsigned int timeout_ms, cxl_cmd_done_fn done, void *data)
+{
+	return cxl_cmd_queue_async(cmd, done, data, min_t(unsigned int,
+				timeout_ms, INT_MAX));
+}
+
+/**
+ * cxl_async_complete - run callbacks for finished asynchronous commands
+ * @ctx: cxl library context
+ *
+ * Returns the number of commands completed.
+ */
+CXL_EXPORT int cxl_async_complete(struct cxl_ctx *ctx)
 {
+	eventfd_t count;
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-    struct cxl_command_info *cinfo;
-	struct cxl_get_event_record_info *event_info;
-	int rc = 0;
-	int rec;
-	int indent = 2;
+	int completed = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
+	if (ctx->async_fd < 0)
+		return 0;
+
+	eventfd_read(ctx->async_fd, &count);
+
+	for (;;) {
+		pthread_mutex_lock(&ctx->async_lock);
+		cmd = list_pop(&ctx->async_done, struct cxl_cmd, list);
+		pthread_mutex_unlock(&ctx->async_lock);
+		if (!cmd)
+			break;
+
+		if (cmd->async_done)
+			cmd->async_done(cmd, cmd->async_rc, cmd->async_data);
+		cxl_cmd_unref(cmd);
+		completed++;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+	return completed;
+}
 
-	/* this is hack to create right payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-        cmd->input_payload = calloc(1, cinfo->size_in);
-        if (!cmd->input_payload)
-            return -ENOMEM;
-        cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-        cmd->send_cmd->in.size = cinfo->size_in;
-    }
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_set_lsa(struct cxl_memdev *memdev,
+		void *lsa_buf, unsigned int offset, unsigned int length)
+{
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	struct cxl_cmd_set_lsa *set_lsa;
+	struct cxl_cmd *cmd;
+	int rc;
 
-	* ((u8 *) cmd->send_cmd->in.payload) = event_log_type;
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_SET_LSA);
+	if (!cmd)
+		return NULL;
+
+	/* this will allocate 'in.payload' */
+	rc = cxl_cmd_set_input_payload(cmd, NULL, sizeof(*set_lsa) + length);
+	if (rc) {
+		err(ctx, "%s: cmd setup failed: %s\n",
+			cxl_memdev_get_devname(memdev), strerror(-rc));
+		goto out_fail;
+	}
+	set_lsa = (void *)cmd->send_cmd->in.payload;
+	set_lsa->offset = cpu_to_le32(offset);
+	memcpy(set_lsa->lsa_data, lsa_buf, length);
+
+	return cmd;
+
+out_fail:
+	cxl_cmd_unref(cmd);
+	return NULL;
+}
+
+enum lsa_op {
+	LSA_OP_GET,
+	LSA_OP_SET,
+	LSA_OP_ZERO,
+};
+
+/* LSA chunks prepared and submitted per batch */
+#define CXL_LSA_CHUNKS_IN_FLIGHT 8
+
+static struct cxl_cmd *lsa_chunk_cmd(struct cxl_memdev *memdev, int op,
+		void *buf, size_t offset, size_t length)
+{
+	struct cxl_cmd *cmd;
+
+	if (op != LSA_OP_GET)
+		return cxl_cmd_new_set_lsa(memdev, buf, offset, length);
+
+	cmd = cxl_cmd_new_get_lsa(memdev, offset, length);
+	if (!cmd)
+		return NULL;
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		goto out;
+	/* land the data straight in the caller's buffer */
+	if (cxl_cmd_set_output_payload(cmd, buf, length)) {
+		cxl_cmd_unref(cmd);
+		return NULL;
 	}
+	return cmd;
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+/*
+ * Transfers are split into chunks that fit the mailbox payload. Up to
+ * CXL_LSA_CHUNKS_IN_FLIGHT chunk commands are prepared and handed to the
+ * batch path at a time, and the first failing chunk ends the transfer.
+ */
+static int lsa_op(struct cxl_memdev *memdev, int op, void **buf,
+		size_t length, size_t offset)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+	struct cxl_cmd_batch *batch = NULL;
+	size_t chunk, lsa_size, done = 0;
+	void *zero_buf = NULL;
+	struct cxl_cmd *cmd;
+	int i, rc = 0;
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS) {
-		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS);
+	if (op != LSA_OP_ZERO && (buf == NULL || *buf == NULL)) {
+		err(ctx, "%s: LSA buffer cannot be NULL\n", devname);
 		return -EINVAL;
 	}
 
-	event_info = (void *)cmd->send_cmd->out.payload;
+	if (op != LSA_OP_GET && op != LSA_OP_SET && op != LSA_OP_ZERO)
+		return -EOPNOTSUPP;
 
-	fprintf(stdout, "cxl_dram_event_record size: 0x%lx\n", sizeof(struct cxl_dram_event_record));
-	fprintf(stdout, "cxl_memory_module_record size: 0x%lx\n", sizeof(struct cxl_memory_module_record));
-	fprintf(stdout, "cxl_event_record size: 0x%lx\n", sizeof(struct cxl_event_record));
-	fprintf(stdout, "cxl_get_event_record_info size: 0x%lx\n", sizeof(struct cxl_get_event_record_info));
-	fprintf(stdout, "========= Get Event Records Info =========\n");
-	fprintf(stdout, "%*sout size: 0x%x\n", indent, "", cmd->send_cmd->out.size);
-	fprintf(stdout, "%*sflags: 0x%x\n", indent, "", event_info->flags);
-	fprintf(stdout, "%*soverflow_err_cnt: 0x%x\n", indent, "", le16_to_cpu(event_info->overflow_err_cnt));
-	fprintf(stdout, "%*sfirst_overflow_evt_ts: 0x%lx\n", indent, "", le64_to_cpu(event_info->first_overflow_evt_ts));
-	fprintf(stdout, "%*slast_overflow_evt_ts: 0x%lx\n", indent, "", le64_to_cpu(event_info->last_overflow_evt_ts));
-	fprintf(stdout, "%*sevent_record_count: 0x%x\n", indent, "", le16_to_cpu(event_info->event_record_count));
+	lsa_size = cxl_memdev_get_lsa_size(memdev);
+	if (length == 0 && op != LSA_OP_SET)
+		length = lsa_size;
+	if (offset > lsa_size || length > lsa_size - offset) {
+		err(ctx, "%s: LSA access %#zx@%#zx exceeds LSA size %#zx\n",
+			devname, length, offset, lsa_size);
+		return -EINVAL;
+	}
 
-	for (rec = 0; rec < min(CXL_MAX_RECORDS_TO_DUMP, le16_to_cpu(event_info->event_record_count)); ++rec) {
-		char uuid[40];
-		struct cxl_event_record *event_record = &event_info->event_records[rec];
+	chunk = memdev_payload_max(memdev);
+	if (op != LSA_OP_GET)
+		chunk -= min(chunk, sizeof(struct cxl_cmd_set_lsa));
+	if (!chunk) {
+		err(ctx, "%s: mailbox payload too small for LSA access\n",
+			devname);
+		return -ENXIO;
+	}
 
-		uuid_unparse(event_info->event_records[rec].uuid, uuid);
+	if (op == LSA_OP_ZERO) {
+		zero_buf = calloc(1, min(chunk, length));
+		if (!zero_buf)
+			return -ENOMEM;
+	}
 
-		if (strcmp(uuid, CXL_DRAM_EVENT_GUID) == 0)
-			fprintf(stdout, "%*sEvent Record: %d (DRAM guid: %s)\n", indent, "", rec, uuid);
-		else if (strcmp(uuid, CXL_MEM_MODULE_EVENT_GUID) == 0)
-			fprintf(stdout, "%*sEvent Record: %d (Memory Module Event guid: %s)\n", indent, "", rec, uuid);
-		else
-			fprintf(stdout, "%*sEvent Record: %d (uuid: %s)\n", indent, "", rec, uuid);
+	while (done < length) {
+		batch = cxl_cmd_batch_new(ctx);
+		if (!batch) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		/* nothing past a failed chunk may reach the label area */
+		batch->stop_on_error = true;
+
+		for (i = 0; i < CXL_LSA_CHUNKS_IN_FLIGHT && done < length; i++) {
+			size_t n = min(chunk, length - done);
+			void *data = zero_buf ? zero_buf : (char *)*buf + done;
+
+			cmd = lsa_chunk_cmd(memdev, op, data, offset + done, n);
+			if (!cmd) {
+				err(ctx, "%s: cmd setup failed\n", devname);
+				rc = -ENOMEM;
+				goto out;
+			}
+			rc = cxl_cmd_batch_add(batch, cmd);
+			cxl_cmd_unref(cmd);
+			if (rc < 0)
+				goto out;
+			done += n;
+		}
 
-		fprintf(stdout, "%*sevent_record_length: 0x%x\n", indent+2, "", event_record->event_record_length);
-		fprintf(stdout, "%*sevent_record_flags: 0x%02x%02x%02x\n", indent+2, "", event_record->event_record_flags[0],
-			event_record->event_record_flags[1], event_record->event_record_flags[2]);
-		fprintf(stdout, "%*sevent_record_handle: 0x%x\n", indent+2, "", le16_to_cpu(event_record->event_record_handle));
-		fprintf(stdout, "%*srelated_event_record_handle: 0x%x\n", indent+2, "",
-			le16_to_cpu(event_record->related_event_record_handle));
-		fprintf(stdout, "%*sevent_record_ts: 0x%lx\n", indent+2, "", le64_to_cpu(event_record->event_record_ts));
+		cxl_cmd_batch_submit(batch);
+		for (i = 0; i < cxl_cmd_batch_get_count(batch); i++) {
+			cmd = cxl_cmd_batch_get_cmd(batch, i);
+			rc = cxl_cmd_batch_get_result(batch, i);
+			if (rc < 0) {
+				err(ctx, "%s: cmd submission failed: %s\n",
+					devname, strerror(-rc));
+				goto out;
+			}
 
-		if (strcmp(uuid, CXL_DRAM_EVENT_GUID) == 0){
-			struct cxl_dram_event_record *dram_event = &event_record->event_record.dram_event_record;
-			fprintf(stdout, "%*sphysical_addr: 0x%lx\n", indent+2, "", le64_to_cpu(dram_event->physical_addr));
-			fprintf(stdout, "%*smemory_event_descriptor: 0x%x\n", indent+2, "", dram_event->memory_event_descriptor);
-			fprintf(stdout, "%*smemory_event_type: 0x%x\n", indent+2, "", dram_event->memory_event_type);
-			fprintf(stdout, "%*stransaction_type: 0x%x\n", indent+2, "", dram_event->transaction_type);
-			fprintf(stdout, "%*svalidity_flags: 0x%x\n", indent+2, "", le16_to_cpu(dram_event->validity_flags));
-			fprintf(stdout, "%*schannel: 0x%x\n", indent+2, "", dram_event->channel);
-			fprintf(stdout, "%*srank: 0x%x\n", indent+2, "", dram_event->rank);
-			fprintf(stdout, "%*snibble_mask: 0x%02x%02x%02x\n", indent+2, "",
-				dram_event->nibble_mask[0], dram_event->nibble_mask[1],
-				dram_event->nibble_mask[2]);
-			fprintf(stdout, "%*sbank_group: 0x%x\n", indent+2, "", dram_event->bank_group);
-			fprintf(stdout, "%*sbank: 0x%x\n", indent+2, "", dram_event->bank);
-			fprintf(stdout, "%*srow: 0x%02x%02x%02x\n", indent+2, "", dram_event->row[0],
-				dram_event->row[1], dram_event->row[2]);
-			fprintf(stdout, "%*scolumn: 0x%x\n", indent+2, "", le16_to_cpu(dram_event->column));
-			for (int i=0; i < 4; i++) {
-				fprintf(stdout, "%*scorrection mask[%d]: 0x", indent+2, "", i);
-				for (int j=0; j < 8; j++) {
-					fprintf(stdout, "%02x", dram_event->correction_mask[i*j+j]);
-				}
-				fprintf(stdout, "\n");
+			rc = cxl_cmd_get_mbox_status(cmd);
+			if (rc != 0) {
+				err(ctx, "%s: firmware status: %d:\n%s\n",
+					devname, rc,
+					rc < (int) ARRAY_SIZE(DEVICE_ERRORS) ?
+					DEVICE_ERRORS[rc] : "Unknown error");
+				rc = -ENXIO;
+				goto out;
 			}
-			fprintf(stdout, "%*scomponent identifier: 0x%02x%02x%02x\n", indent+2, "",
-				dram_event->component_identifier[0], dram_event->component_identifier[1],
-				dram_event->component_identifier[2]);
 		}
+		cxl_cmd_batch_free(batch);
+		batch = NULL;
 	}
 
+	/*
+	 * TODO: If writing, the memdev may need to be disabled/re-enabled to
+	 * refresh any cached LSA data in the kernel.
+	 */
+
 out:
-	cxl_cmd_unref(cmd);
+	cxl_cmd_batch_free(batch);
+	free(zero_buf);
 	return rc;
-	return 0;
 }
 
-// GET_LD_INFO START
-#define CXL_MEM_COMMAND_ID_GET_LD_INFO CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_GET_LD_INFO_OPCODE 0x5400
-#define CXL_MEM_COMMAND_ID_GET_LD_INFO_PAYLOAD_OUT_SIZE 0xb
+CXL_EXPORT int cxl_memdev_zero_lsa(struct cxl_memdev *memdev)
+{
+	return lsa_op(memdev, LSA_OP_ZERO, NULL, 0, 0);
+}
 
-struct cxl_get_ld_info {
-	__le64 mem_size;
-	__le16 ld_cnt;
-	u8 qos_telemetry_capa;
-}  __attribute__((packed));
+CXL_EXPORT int cxl_memdev_set_lsa(struct cxl_memdev *memdev, void *buf,
+		size_t length, size_t offset)
+{
+	return lsa_op(memdev, LSA_OP_SET, &buf, length, offset);
+}
 
-CXL_EXPORT int cxl_memdev_get_ld_info(struct cxl_memdev *memdev)
+CXL_EXPORT int cxl_memdev_get_lsa(struct cxl_memdev *memdev, void *buf,
+		size_t length, size_t offset)
+{
+	return lsa_op(memdev, LSA_OP_GET, &buf, length, offset);
+}
+
+/* granularity at which cxl_memdev_update_lsa() looks for changes */
+#define CXL_LSA_UPDATE_BLOCK 256
+
+/**
+ * cxl_memdev_update_lsa - write only the parts of a label range that changed
+ * @memdev: memory device to operate on
+ * @buf: new contents of the range
+ * @length: size of the range
+ * @offset: start of the range in the label storage area
+ *
+ * Reads back the current contents of the range and issues SET_LSA only
+ * for runs of CXL_LSA_UPDATE_BLOCK sized blocks that differ from @buf.
+ * Returns the number of bytes written, or a negative error code.
+ */
+CXL_EXPORT int cxl_memdev_update_lsa(struct cxl_memdev *memdev, void *buf,
+		size_t length, size_t offset)
+{
+	unsigned char *new = buf, *cur;
+	size_t start, end, n;
+	int rc, written = 0;
+
+	if (!buf)
+		return -EINVAL;
+	if (!length)
+		return 0;
+
+	cur = malloc(length);
+	if (!cur)
+		return -ENOMEM;
+
+	rc = cxl_memdev_get_lsa(memdev, cur, length, offset);
+	if (rc < 0)
+		goto out;
+
+	for (start = 0; start < length; start = end) {
+		n = min_t(size_t, CXL_LSA_UPDATE_BLOCK, length - start);
+		end = start + n;
+		if (memcmp(cur + start, new + start, n) == 0)
+			continue;
+
+		/* coalesce adjacent dirty blocks into one write */
+		while (end < length) {
+			n = min_t(size_t, CXL_LSA_UPDATE_BLOCK, length - end);
+			if (memcmp(cur + end, new + end, n) == 0)
+				break;
+			end += n;
+		}
+
+		rc = cxl_memdev_set_lsa(memdev, new + start, end - start,
+				offset + start);
+		if (rc < 0)
+			goto out;
+		written += end - start;
+	}
+	rc = written;
+out:
+	free(cur);
+	return rc;
+}
+
+CXL_EXPORT int cxl_memdev_cmd_identify(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_get_ld_info *ld_info;
+	struct cxl_cmd_identify *id;
 	int rc = 0;
-	int indent = 2;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_LD_INFO_OPCODE);
+	printf("id: 0x%x\n", CXL_MEM_COMMAND_ID_IDENTIFY);
+	cmd = cxl_cmd_new_identify(memdev);
 	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
+		fprintf(stderr, "%s: cxl_cmd_new_identify returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
-	cmd->send_cmd->in.size = 0;
-
-	fprintf(stdout, "Getting LD info for memdev %s\n", cxl_memdev_get_devname(memdev));
 
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
@@ -2230,377 +5032,456 @@ CXL_EXPORT int cxl_memdev_get_ld_info(struct cxl_memdev *memdev)
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_LD_INFO) {
+	id = (void *)cmd->send_cmd->out.payload;
+	fprintf(stderr, "size of payload: %ld\n", sizeof(*id));
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_IDENTIFY) {
 		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_LD_INFO);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_IDENTIFY);
 		return -EINVAL;
 	}
 
-	ld_info = (void *)cmd->send_cmd->out.payload;
-
-	fprintf(stdout, "========= Get LD Info =========\n");
-	fprintf(stdout, "%*sout size: 0x%x\n", indent, "", cmd->send_cmd->out.size);
-	fprintf(stdout, "%*smemory size: 0x%lx\n", indent, "", le64_to_cpu(ld_info->mem_size));
-	fprintf(stdout, "%*sld count: 0x%x\n", indent, "", le16_to_cpu(ld_info->ld_cnt));
-	fprintf(stdout, "%*sqos telemetry capability: 0x%x\n", indent, "", ld_info->qos_telemetry_capa);
+	fprintf(stdout, "%s info\n", cxl_memdev_get_devname(memdev));
+	fprintf(stdout, "    fw revision: ");
+	for (int i=0; i < CXL_CMD_IDENTIFY_FW_REV_LENGTH; ++i)
+		fprintf(stdout, "%02x ", id->fw_revision[i]);
+	fprintf(stdout, "\n");
+	fprintf(stdout, "    total_capacity: %lu MB (%lu GB)\n",
+	le64_to_cpu(id->total_capacity), (le64_to_cpu(id->total_capacity))/4);
+	fprintf(stdout, "    volatile_capacity: %lu MB (%lu GB)\n",
+	le64_to_cpu(id->volatile_capacity), (le64_to_cpu(id->volatile_capacity))/4);
+	fprintf(stdout, "    persistent_capacity: %lu MB (%lu GB)\n",
+	le64_to_cpu(id->persistent_capacity), (le64_to_cpu(id->persistent_capacity))/4);
+	fprintf(stdout, "    partition_align: %lu MB (%lu GB)\n",
+	le64_to_cpu(id->partition_align), (le64_to_cpu(id->partition_align))/4);
+	fprintf(stdout, "    info_event_log_size: %d\n", le16_to_cpu(id->info_event_log_size));
+	fprintf(stdout, "    warning_event_log_size: %d\n", le16_to_cpu(id->warning_event_log_size));
+	fprintf(stdout, "    failure_event_log_size: %d\n", le16_to_cpu(id->failure_event_log_size));
+	fprintf(stdout, "    fatal_event_log_size: %d\n", le16_to_cpu(id->fatal_event_log_size));
+	fprintf(stdout, "    lsa_size: %d\n", le32_to_cpu(id->lsa_size));
+	for (int i=0; i < 3; ++i)
+	fprintf(stdout, "    poison_list_max_mer[%d]: %d\n", i, id->poison_list_max_mer[i]);
+	fprintf(stdout, "    inject_poison_limit: %d\n", le16_to_cpu(id->inject_poison_limit));
+	fprintf(stdout, "    poison_caps: %d\n", id->poison_caps);
+	fprintf(stdout, "    qos_telemetry_caps: %d\n", id->qos_telemetry_caps);
 
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
-// GET_LD_INFO END
-
-#define CXL_MEM_COMMAND_ID_DEVICE_INFO_GET CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_OPCODE 49152
-#define CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_PAYLOAD_OUT_SIZE 8
-#define CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_PAYLOAD_IN_SIZE 0
-
-
-struct cxl_mbox_device_info_get_out {
-	__le16 device_id;
-	u8 chipinfo_rel_major;
-	u8 chipinfo_rel_minor;
-	u8 device_rev;
-	u8 configfile_ver_major;
-	__le16 configfile_ver_minor;
-}  __attribute__((packed));
+struct cxl_mbox_get_supported_logs {
+	__le16 entries;
+	u8 rsvd[6];
+	struct gsl_entry {
+		uuid_t uuid;
+		__le32 size;
+	} __attribute__((packed)) entry[];
+} __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_device_info_get(struct cxl_memdev *memdev)
+CXL_EXPORT int cxl_memdev_get_supported_logs(struct cxl_memdev *memdev)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_device_info_get_out *device_info_get_out;
-	int rc = 0;
-	char release_major;
-	release_major = 'A';
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* this is hack to create right payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
+	struct cxl_cmd *cmd;
+	struct cxl_mbox_get_supported_logs *gsl;
+	int rc = 0;
+
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS);
+	if (!cmd) {
+		fprintf(stderr, "%s: cxl_cmd_new_identify returned Null output\n",
+				cxl_memdev_get_devname(memdev));
+		return -ENOMEM;
 	}
 
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
+		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
+				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
 		rc = -ENXIO;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_DEVICE_INFO_GET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_DEVICE_INFO_GET);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev),
+				cmd->send_cmd->id,
+				CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS);
 		return -EINVAL;
 	}
 
-	device_info_get_out = (void *)cmd->send_cmd->out.payload;
-	release_major = release_major + device_info_get_out->chipinfo_rel_major;
-	fprintf(stdout, "=========================== read device information ============================\n");
-
-	fprintf(stdout, "Release & Revision for Device ID %x: %c.%x Rev %x\n",
-				device_info_get_out->device_id,
-				release_major,
-				device_info_get_out->chipinfo_rel_minor,
-				device_info_get_out->device_rev);
-	fprintf(stdout, "Device ID: %x\n", device_info_get_out->device_id);
-	fprintf(stdout, "Chip Info Release Major: %x\n", device_info_get_out->chipinfo_rel_major);
-	fprintf(stdout, "Chip Info Release Minor: %x\n", device_info_get_out->chipinfo_rel_minor);
-	fprintf(stdout, "Device Revision: %x\n", device_info_get_out->device_rev);
-	fprintf(stdout, "ConfigFile version Major: %x\n", device_info_get_out->configfile_ver_major);
-	fprintf(stdout, "ConfigFile version Minor: %x\n", device_info_get_out->configfile_ver_minor);
-
+	gsl = (void *)cmd->send_cmd->out.payload;
+	fprintf(stdout, "payload info\n");
+	fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
+	fprintf(stdout, "    entries: %d\n", gsl->entries);
+	for (int e=0; e < gsl->entries; ++e) {
+		char uuid[40];
+		uuid_unparse(gsl->entry[e].uuid, uuid);
+		fprintf(stdout, "        entries[%d] uuid: %s, size: %d\n", e, uuid, gsl->entry[e].size);
+	}
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
-#define CXL_MEM_COMMAND_ID_GET_FW_INFO CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_GET_FW_INFO_OPCODE 512
-#define CXL_MEM_COMMAND_ID_GET_FW_INFO_PAYLOAD_OUT_SIZE 80
-
+#define CEL_UUID "0da9c0b5-bf41-4b78-8f79-96b1623b3f17"
 
-struct cxl_mbox_get_fw_info_out {
-	u8 fw_slots_supp;
-	u8 fw_slot_info;
-	u8 fw_activation_capas;
-	u8 rsvd[13];
-	char slot_1_fw_rev[16];
-	char slot_2_fw_rev[16];
-	char slot_3_fw_rev[16];
-	char slot_4_fw_rev[16];
+struct cxl_mbox_get_log {
+	uuid_t uuid;
+	__le32 offset;
+	__le32 length;
 }  __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_get_fw_info(struct cxl_memdev *memdev)
+struct cel_entry {
+	__le16 opcode;
+	__le16 effect;
+} __attribute__((packed));
+
+CXL_EXPORT int cxl_memdev_get_cel_log(struct cxl_memdev *memdev, const char* uuid)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mbox_get_fw_info_out *get_fw_info_out;
+	struct cxl_mbox_get_log *get_log_input;
+	struct cel_entry *cel_entries;
+	int no_cel_entries;
 	int rc = 0;
-	u8 active_slot_mask;
-	u8 active_slot;
-	u8 staged_slot_mask;
-	u8 staged_slot;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_FW_INFO_OPCODE);
+	if (!uuid) {
+		fprintf(stderr, "%s: Please specify log uuid argument\n",
+				cxl_memdev_get_devname(memdev));
+		return -EINVAL;
+	}
+
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_LOG);
 	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
+		fprintf(stderr, "%s: cxl_memdev_get_cel_log returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
+	get_log_input = (void *) cmd->send_cmd->in.payload;
+	uuid_parse(uuid, get_log_input->uuid);
+	get_log_input->offset = 0;
+	get_log_input->length = memdev_payload_max(cmd->memdev);
+
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
+		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
+				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
 		rc = -ENXIO;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_FW_INFO) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_FW_INFO);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_LOG) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_LOG);
 		return -EINVAL;
 	}
 
-	get_fw_info_out = (void *)cmd->send_cmd->out.payload;
-	active_slot_mask = 0b00000111;
-	active_slot = get_fw_info_out->fw_slot_info & active_slot_mask;
-	staged_slot_mask = 0b00111000;
-	staged_slot = get_fw_info_out->fw_slot_info & staged_slot_mask;
-	staged_slot = staged_slot>>3;
-	fprintf(stdout, "================================= get fw info ==================================\n");
-	fprintf(stdout, "FW Slots Supported: %x\n", get_fw_info_out->fw_slots_supp);
-	fprintf(stdout, "Active FW Slot: %x\n", active_slot);
-	if (staged_slot)
-	{
-		fprintf(stdout, "Staged FW Slot: %x\n", staged_slot);
+	fprintf(stdout, "payload info\n");
+	fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
+	cel_entries = (void *)cmd->send_cmd->out.payload;
+	no_cel_entries = (cmd->send_cmd->out.size)/sizeof(struct cel_entry);
+	fprintf(stdout, "    no_cel_entries size: %d\n", no_cel_entries);
+	for (int e = 0; e < no_cel_entries; ++e) {
+		fprintf(stdout, "    cel_entry[%d] opcode: 0x%x, effect: 0x%x\n", e,
+				le16_to_cpu(cel_entries[e].opcode),
+				le16_to_cpu(cel_entries[e].effect));
 	}
-	fprintf(stdout, "FW Activation Capabilities: %x\n", get_fw_info_out->fw_activation_capas);
-	fprintf(stdout, "Slot 1 FW Revision: %s\n", get_fw_info_out->slot_1_fw_rev);
-	fprintf(stdout, "Slot 2 FW Revision: %s\n", get_fw_info_out->slot_2_fw_rev);
-	fprintf(stdout, "Slot 3 FW Revision: %s\n", get_fw_info_out->slot_3_fw_rev);
-	fprintf(stdout, "Slot 4 FW Revision: %s\n", get_fw_info_out->slot_4_fw_rev);
-
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
+/*
+ * The Command Effects Log of a memdev, read once by
+ * cxl_memdev_get_cel(): @supported has a bit per opcode for the raw
+ * command fast path, @entries is sorted by opcode for the effect
+ * lookups and listings.
+ */
+#define CXL_NR_OPCODES 0x10000
 
-#define CXL_MEM_COMMAND_ID_TRANSFER_FW CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_TRANSFER_FW_PAYLOAD_IN_SIZE 128 + FW_BLOCK_SIZE
+struct cxl_cel_entry {
+	u16 opcode;
+	u16 effect;
+};
 
-struct cxl_mbox_transfer_fw_in {
-	u8 action;
-	u8 slot;
-	__le16 rsvd;
-	__le32 offset;
-	__le64 rsvd8[15];
-	fwblock data;
-}  __attribute__((packed));
+struct cxl_cel {
+	unsigned long supported[BITS_TO_LONGS(CXL_NR_OPCODES)];
+	int nr;
+	struct cxl_cel_entry entries[];
+};
 
+static int cxl_cel_entry_cmp(const void *a, const void *b)
+{
+	const struct cxl_cel_entry *x = a, *y = b;
 
-CXL_EXPORT int cxl_memdev_transfer_fw(struct cxl_memdev *memdev,
-	u8 action, u8 slot, u32 offset, int size,
-    unsigned char *data, u32 transfer_fw_opcode)
+	return (int) x->opcode - (int) y->opcode;
+}
+
+/* size of the log @uuid from Get Supported Logs, or a negative error */
+static long cxl_log_size(struct cxl_memdev *memdev, const char *uuid)
 {
+	struct cxl_mbox_get_supported_logs *gsl;
+	unsigned int i, nr;
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_transfer_fw_in *transfer_fw_in;
-	int rc = 0;
+	long size = -ENOENT;
+	uuid_t want;
 
-	cmd = cxl_cmd_new_raw(memdev, transfer_fw_opcode);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
+	if (uuid_parse(uuid, want))
+		return -EINVAL;
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS);
+	if (!cmd)
 		return -ENOMEM;
+	if (cxl_cmd_submit(cmd) < 0 || cxl_cmd_get_mbox_status(cmd)
+			|| cmd->send_cmd->out.size < (int) sizeof(*gsl)) {
+		size = -ENXIO;
+		goto out;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* used to force correct payload size */
-	cinfo->size_in = 128 + size;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	gsl = (void *) cmd->send_cmd->out.payload;
+	nr = min_t(unsigned int, le16_to_cpu(gsl->entries),
+			(cmd->send_cmd->out.size - sizeof(*gsl))
+			/ sizeof(gsl->entry[0]));
+	for (i = 0; i < nr; i++)
+		if (uuid_compare(gsl->entry[i].uuid, want) == 0) {
+			size = le32_to_cpu(gsl->entry[i].size);
+			break;
+		}
+out:
+	cxl_cmd_unref(cmd);
+	return size;
+}
 
-	transfer_fw_in = (struct cxl_mbox_transfer_fw_in *) cmd->send_cmd->in.payload;
-	transfer_fw_in->action = action;
-	transfer_fw_in->slot = slot;
-	transfer_fw_in->offset = cpu_to_le32(offset);
-	memcpy(transfer_fw_in->data, data, size);
+static struct cxl_cel *cxl_cel_read(struct cxl_memdev *memdev)
+{
+	int max = memdev_payload_max(memdev), nr = 0, got, i;
+	struct cxl_mbox_get_log *get_log_input;
+	struct cxl_cel *cel = NULL, *c;
+	struct cel_entry *raw;
+	struct cxl_cmd *cmd;
+	u32 offset = 0, len;
+	long size;
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+	if (max < (int) sizeof(*raw))
+		return NULL;
+	/*
+	 * The log size bounds the reads, without it they go on until a
+	 * short one, which costs an extra empty Get Log whenever the log
+	 * is a multiple of the payload size
+	 */
+	size = cxl_log_size(memdev, CEL_UUID);
+	if (size == 0)
+		return calloc(1, sizeof(*cel));
+	if (size > (long) (CXL_NR_OPCODES * sizeof(*raw)))
+		size = CXL_NR_OPCODES * sizeof(*raw);
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_LOG);
+	if (!cmd)
+		return NULL;
+	max = min(max, (int) cmd->out_size);
+
+	do {
+		len = max;
+		if (size > 0)
+			len = min_t(long, len, size - offset);
+		get_log_input = (void *) cmd->send_cmd->in.payload;
+		uuid_parse(CEL_UUID, get_log_input->uuid);
+		get_log_input->offset = cpu_to_le32(offset);
+		get_log_input->length = cpu_to_le32(len);
+		if (cxl_cmd_submit(cmd) < 0 || cxl_cmd_get_mbox_status(cmd)) {
+			free(cel);
+			cel = NULL;
+			break;
+		}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
-		goto out;
-	}
+		got = cmd->send_cmd->out.size / sizeof(*raw);
+		c = realloc(cel, sizeof(*cel) + (nr + got) * sizeof(cel->entries[0]));
+		if (!c) {
+			free(cel);
+			cel = NULL;
+			break;
+		}
+		if (!cel)
+			memset(c, 0, sizeof(*c));
+		cel = c;
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_TRANSFER_FW) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_TRANSFER_FW);
-		rc = -EINVAL;
-		goto out;
-	}
+		raw = (void *) cmd->send_cmd->out.payload;
+		for (i = 0; i < got; i++) {
+			u16 opcode = le16_to_cpu(raw[i].opcode);
 
+			cel->entries[nr + i].opcode = opcode;
+			cel->entries[nr + i].effect = le16_to_cpu(raw[i].effect);
+			cel->supported[BIT_WORD(opcode)] |= BIT_MASK(opcode);
+		}
+		nr += got;
+		cel->nr = nr;
+		offset += cmd->send_cmd->out.size;
+	} while (cmd->send_cmd->out.size == (int) len && nr < CXL_NR_OPCODES
+			&& (size < 0 || offset < size));
 
-out:
 	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	if (cel)
+		qsort(cel->entries, cel->nr, sizeof(cel->entries[0]),
+				cxl_cel_entry_cmp);
+	else
+		dbg(memdev->ctx, "%s: command effects log unavailable\n",
+				cxl_memdev_get_devname(memdev));
+	return cel;
 }
 
+/* NULL when the device could not report its CEL */
+static struct cxl_cel *cxl_memdev_get_cel(struct cxl_memdev *memdev)
+{
+	struct cxl_cel *cel;
 
-#define CXL_MEM_COMMAND_ID_ACTIVATE_FW CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_ACTIVATE_FW_OPCODE 52482
-#define CXL_MEM_COMMAND_ID_ACTIVATE_FW_PAYLOAD_IN_SIZE 2
+	if (memdev_has_attr(memdev, CXL_MEMDEV_ATTR_CEL))
+		return memdev->cel;
+	cel = cxl_cel_read(memdev);
+	if (cel)
+		cxl_publish(&memdev->cel, cel, free);
+	memdev_set_attr(memdev, CXL_MEMDEV_ATTR_CEL);
+	return cel;
+}
 
-struct cxl_mbox_activate_fw_in {
-	u8 action;
-	u8 slot;
+/**
+ * cxl_memdev_cel_opcode_supported - is @opcode in the Command Effects Log
+ * @memdev: memory device
+ * @opcode: mailbox opcode
+ *
+ * Returns 1 when listed, 0 when not, and a negative error code when the
+ * log could not be read and support is unknown.
+ */
+CXL_EXPORT int cxl_memdev_cel_opcode_supported(struct cxl_memdev *memdev,
+		int opcode)
+{
+	struct cxl_cel *cel = cxl_memdev_get_cel(memdev);
+
+	if (!cel)
+		return -ENXIO;
+	if (opcode < 0 || opcode >= CXL_NR_OPCODES)
+		return 0;
+	return !!(cel->supported[BIT_WORD(opcode)] & BIT_MASK(opcode));
+}
+
+/* 0 for opcodes the CEL rules out, otherwise let the device decide */
+static int cxl_memdev_cel_check(struct cxl_memdev *memdev, int opcode)
+{
+	if (!memdev->ctx->opcode_check)
+		return 1;
+	return cxl_memdev_cel_opcode_supported(memdev, opcode);
+}
+
+CXL_EXPORT int cxl_memdev_cel_get_effect(struct cxl_memdev *memdev,
+		int opcode)
+{
+	struct cxl_cel *cel = cxl_memdev_get_cel(memdev);
+	struct cxl_cel_entry key = { .opcode = opcode }, *e;
+
+	if (!cel)
+		return -ENXIO;
+	e = bsearch(&key, cel->entries, cel->nr, sizeof(key),
+			cxl_cel_entry_cmp);
+	return e ? e->effect : -ENOENT;
+}
+
+CXL_EXPORT int cxl_memdev_cel_get_nr_entries(struct cxl_memdev *memdev)
+{
+	struct cxl_cel *cel = cxl_memdev_get_cel(memdev);
+
+	return cel ? cel->nr : -ENXIO;
+}
+
+/* entries are in ascending opcode order */
+CXL_EXPORT int cxl_memdev_cel_get_opcode(struct cxl_memdev *memdev, int idx)
+{
+	struct cxl_cel *cel = cxl_memdev_get_cel(memdev);
+
+	if (!cel)
+		return -ENXIO;
+	if (idx < 0 || idx >= cel->nr)
+		return -EINVAL;
+	return cel->entries[idx].opcode;
+}
+
+#define CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY_OPCODE 0x102
+
+struct cxl_mbox_get_event_interrupt_policy {
+	u8 info_event_log_int_settings;
+	u8 warning_event_log_int_settings;
+	u8 failure_event_log_int_settings;
+	u8 fatal_event_log_int_settings;
 }  __attribute__((packed));
 
-
-CXL_EXPORT int cxl_memdev_activate_fw(struct cxl_memdev *memdev,
-	u8 action, u8 slot)
+CXL_EXPORT int cxl_memdev_get_event_interrupt_policy(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_activate_fw_in *activate_fw_in;
+	struct cxl_mbox_get_event_interrupt_policy *event_interrupt_policy_out;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_ACTIVATE_FW_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* this is hack to create right payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_ACTIVATE_FW_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	activate_fw_in = (void *) cmd->send_cmd->in.payload;
-
-	activate_fw_in->action = action;
-	activate_fw_in->slot = slot;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
+		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
+				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
 		rc = -ENXIO;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_ACTIVATE_FW) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_ACTIVATE_FW);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_EVENT_INTERRUPT_POLICY);
 		return -EINVAL;
 	}
 
-
+	fprintf(stdout, "payload info\n");
+	fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
+	event_interrupt_policy_out = (void *)cmd->send_cmd->out.payload;
+	fprintf(stdout, "    info_event_log_int_settings: 0x%x\n", event_interrupt_policy_out->info_event_log_int_settings);
+	fprintf(stdout, "    warning_event_log_int_settings: 0x%x\n", event_interrupt_policy_out->warning_event_log_int_settings);
+	fprintf(stdout, "    failure_event_log_int_settings: 0x%x\n", event_interrupt_policy_out->failure_event_log_int_settings);
+	fprintf(stdout, "    fatal_event_log_int_settings: 0x%x\n", event_interrupt_policy_out->fatal_event_log_int_settings);
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
+#define CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY_OPCODE 0x103
+#define CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY_PAYLOAD_IN_SIZE 0x4
 
-#define CXL_MEM_COMMAND_ID_DDR_INFO CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_DDR_INFO_OPCODE 50432
-#define CXL_MEM_COMMAND_ID_DDR_INFO_PAYLOAD_IN_SIZE 1
-#define CXL_MEM_COMMAND_ID_DDR_INFO_PAYLOAD_OUT_SIZE 8
-
-struct cxl_mbox_ddr_info_in {
-	u8 ddr_id;
-}  __attribute__((packed));
-
-struct cxl_mbox_ddr_info_out {
-	__le32 mstr_reg;
-	__le32 dram_width;
-}  __attribute__((packed));
-
-CXL_EXPORT int cxl_memdev_ddr_info(struct cxl_memdev *memdev, u8 ddr_id)
+CXL_EXPORT int cxl_memdev_set_event_interrupt_policy(struct cxl_memdev *memdev, u32 int_policy)
 {
-	/*const char *dram_width_descriptions[4] = {
-		"DRAM Width x4 device",
-		"DRAM Width x8 device",
-		"DRAM Width x16 device",
-		"DRAM Width x32 device"
-	};*/
-
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ddr_info_in *ddr_info_in;
-	struct cxl_mbox_ddr_info_out *ddr_info_out;
+    struct cxl_command_info *cinfo;
+	struct cxl_mbox_get_event_interrupt_policy *interrupt_policy_in;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_DDR_INFO_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
@@ -2610,106 +5491,69 @@ CXL_EXPORT int cxl_memdev_ddr_info(struct cxl_memdev *memdev, u8 ddr_id)
 	query = cmd->query_cmd;
 	cinfo = &query->commands[cmd->query_idx];
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_DDR_INFO_PAYLOAD_IN_SIZE;
+	/* this is hack to create right payload size */
+	cinfo->size_in = CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+        cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
+        if (!cmd->input_payload)
+            return -ENOMEM;
+        cmd->send_cmd->in.payload = (u64)cmd->input_payload;
+        cmd->send_cmd->in.size = cinfo->size_in;
+    }
 
-	ddr_info_in = (void *) cmd->send_cmd->in.payload;
+	interrupt_policy_in = (void *) cmd->send_cmd->in.payload;
+
+	/* below is meant for readability, you don't really need this */
+	int_policy = cpu_to_be32(int_policy);
+	interrupt_policy_in->info_event_log_int_settings = (int_policy & 0xff);
+	interrupt_policy_in->warning_event_log_int_settings = ((int_policy >> 8) & 0xff);
+	interrupt_policy_in->failure_event_log_int_settings = ((int_policy >> 16) & 0xff);
+	interrupt_policy_in->fatal_event_log_int_settings = ((int_policy >> 24) & 0xff);
 
-	ddr_info_in->ddr_id = ddr_id;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
+		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
+				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
 		rc = -ENXIO;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_DDR_INFO) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_DDR_INFO);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_SET_EVENT_INTERRUPT_POLICY);
 		return -EINVAL;
 	}
 
-	ddr_info_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "=================================== ddr info ===================================\n");
-	fprintf(stdout, "DDR controller MSTR register: %x\n", le32_to_cpu(ddr_info_out->mstr_reg));
-	fprintf(stdout, "DRAM width derived from DEVICE_CONFIG: %d\n", le32_to_cpu(ddr_info_out->dram_width));
-
+	fprintf(stdout, "command completed successfully\n");
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
 	return 0;
 }
 
+#define CXL_MEM_COMMAND_ID_GET_TIMESTAMP CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_GET_TIMESTAMP_OPCODE 0x0300
 
-#define CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS_OPCODE 0x101
-
-struct cxl_clear_event_record_info {
-    u8 event_log_type;
-    u8 clear_event_flags;
-    u8 no_event_record_handles;
-	u8 reserved[3];
-	__le16 event_record_handles[];
-}  __attribute__((packed));
-
-CXL_EXPORT int cxl_memdev_clear_event_records(struct cxl_memdev *memdev, u8 event_log_type,
-	u8 clear_event_flags, u8 no_event_record_handles, u16 *event_record_handles)
+CXL_EXPORT int cxl_memdev_get_timestamp(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-    struct cxl_command_info *cinfo;
-	struct cxl_clear_event_record_info *event_info;
+	__le64 *timestamp_out;
 	int rc = 0;
-	int rec;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_TIMESTAMP_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* this is hack to create right payload size */
-	cinfo->size_in = sizeof(*event_info) + (no_event_record_handles * sizeof(__le16));
-	if (cinfo->size_in > 0) {
-        cmd->input_payload = calloc(1, cinfo->size_in);
-        if (!cmd->input_payload)
-            return -ENOMEM;
-        cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-        cmd->send_cmd->in.size = cinfo->size_in;
-    }
-
-	if (clear_event_flags) {
-		dbg(memdev->ctx, "Clearing 'All Event' Records for type %d\n", event_log_type);
-	}
-
-	event_info = (struct cxl_clear_event_record_info *) cmd->send_cmd->in.payload;
-	event_info->event_log_type = event_log_type;
-	event_info->clear_event_flags = clear_event_flags;
-	event_info->no_event_record_handles = no_event_record_handles;
-	for (rec = 0; rec < event_info->no_event_record_handles; ++rec) {
-		dbg(memdev->ctx, "Clearing Event Record 0x%x for %d type\n", event_record_handles[rec], event_log_type);
-		event_info->event_record_handles[rec] = cpu_to_le16(event_record_handles[rec]);
-	}
-
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -2725,68 +5569,59 @@ CXL_EXPORT int cxl_memdev_clear_event_records(struct cxl_memdev *memdev, u8 even
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_TIMESTAMP) {
 		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_TIMESTAMP);
 		return -EINVAL;
 	}
 
-	fprintf(stdout, "Clear Event Records command completed successfully\n");
-
+	timestamp_out = (void *)cmd->send_cmd->out.payload;
+	fprintf(stdout, "timestamp: 0x%lx\n", le64_to_cpu(*timestamp_out));
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
-#define CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER_OPCODE 50691
-#define CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER_PAYLOAD_IN_SIZE 2
-
-struct cxl_mbox_hct_start_stop_trigger_in {
-	u8 hct_inst;
-	u8 buf_control;
-}  __attribute__((packed));
-
+#define CXL_MEM_COMMAND_ID_SET_TIMESTAMP CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_SET_TIMESTAMP_OPCODE 0x0301
+#define CXL_MEM_COMMAND_ID_SET_TIMESTAMP_PAYLOAD_IN_SIZE 8
 
-CXL_EXPORT int cxl_memdev_hct_start_stop_trigger(struct cxl_memdev *memdev,
-	u8 hct_inst, u8 buf_control)
+CXL_EXPORT int cxl_memdev_set_timestamp(struct cxl_memdev *memdev, u64 timestamp)
 {
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_hct_start_stop_trigger_in *hct_start_stop_trigger_in;
+    struct cxl_command_info *cinfo;
+	__le64 *timestamp_in;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_SET_TIMESTAMP_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
-
 	query = cmd->query_cmd;
 	cinfo = &query->commands[cmd->query_idx];
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER_PAYLOAD_IN_SIZE;
+	/* this is hack to create right payload size */
+	cinfo->size_in = CXL_MEM_COMMAND_ID_SET_TIMESTAMP_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+        cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
+        if (!cmd->input_payload)
+            return -ENOMEM;
+        cmd->send_cmd->in.payload = (u64)cmd->input_payload;
+        cmd->send_cmd->in.size = cinfo->size_in;
+    }
 
-	hct_start_stop_trigger_in = (void *) cmd->send_cmd->in.payload;
+	timestamp_in = (void *) cmd->send_cmd->in.payload;
+	*timestamp_in = cpu_to_le64(timestamp);
+	fprintf(stdout, "setting timestamp to: 0x%lx\n", le64_to_cpu(*timestamp_in));
 
-	hct_start_stop_trigger_in->hct_inst = hct_inst;
-	hct_start_stop_trigger_in->buf_control = buf_control;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
@@ -2797,78 +5632,90 @@ CXL_EXPORT int cxl_memdev_hct_start_stop_trigger(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_SET_TIMESTAMP) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_SET_TIMESTAMP);
 		return -EINVAL;
 	}
 
-
+	fprintf(stdout, "command completed successfully\n");
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
+/*
+ * Reusable get / set timestamp commands for callers that need to pick
+ * the timestamp immediately before submission, e.g. to align the time
+ * base of several memdevs.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_get_timestamp(struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_GET_TIMESTAMP_OPCODE,
+			0);
+}
+
+CXL_EXPORT unsigned long long cxl_cmd_get_timestamp_get_timestamp(
+		struct cxl_cmd *cmd)
+{
+	__le64 *timestamp_out = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_GET_TIMESTAMP_OPCODE,
+			sizeof(*timestamp_out));
 
-#define CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_OPCODE 50692
-#define CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_PAYLOAD_IN_SIZE 1
-#define CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_PAYLOAD_OUT_SIZE 2
+	if (!timestamp_out)
+		return -EINVAL;
+	return le64_to_cpu(*timestamp_out);
+}
 
-struct cxl_mbox_hct_get_buffer_status_in {
-	u8 hct_inst;
-}  __attribute__((packed));
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_set_timestamp(struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_SET_TIMESTAMP_OPCODE,
+			CXL_MEM_COMMAND_ID_SET_TIMESTAMP_PAYLOAD_IN_SIZE);
+}
 
-struct cxl_mbox_hct_get_buffer_status_out {
-	u8 buf_status;
-	u8 fill_level;
+CXL_EXPORT int cxl_cmd_set_timestamp_set_timestamp(struct cxl_cmd *cmd,
+		u64 timestamp)
+{
+	__le64 *timestamp_in = cmd->input_payload;
+
+	if (cxl_cmd_get_opcode(cmd) != CXL_MEM_COMMAND_ID_SET_TIMESTAMP_OPCODE
+			|| !timestamp_in)
+		return -EINVAL;
+	*timestamp_in = cpu_to_le64(timestamp);
+	return 0;
+}
+
+struct cxl_mbox_get_alert_config_out {
+	u8 valid_alerts;
+	u8 programmable_alerts;
+	u8 life_used_critical_alert_threshold;
+	u8 life_used_prog_warn_threshold;
+	__le16 dev_over_temp_crit_alert_threshold;
+	__le16 dev_under_temp_crit_alert_threshold;
+	__le16 dev_over_temp_prog_warn_threshold;
+	__le16 dev_under_temp_prog_warn_threshold;
+	__le16 corr_vol_mem_err_prog_warn_thresold;
+	__le16 corr_pers_mem_err_prog_warn_threshold;
 }  __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_hct_get_buffer_status(struct cxl_memdev *memdev,
-	u8 hct_inst)
+CXL_EXPORT int cxl_memdev_get_alert_config(struct cxl_memdev *memdev)
 {
-	const char *buf_status_descriptions[] = {
-		"Stop",
-		"Pre-Trigger",
-		"Post-Trigger"
-	};
-
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_hct_get_buffer_status_in *hct_get_buffer_status_in;
-	struct cxl_mbox_hct_get_buffer_status_out *hct_get_buffer_status_out;
+	struct cxl_mbox_get_alert_config_out *alert_config_out;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_OPCODE);
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	hct_get_buffer_status_in = (void *) cmd->send_cmd->in.payload;
-
-	hct_get_buffer_status_in->hct_inst = hct_inst;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
@@ -2879,70 +5726,103 @@ CXL_EXPORT int cxl_memdev_hct_get_buffer_status(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG);
 		return -EINVAL;
 	}
 
-	hct_get_buffer_status_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "======================= get hif/cxl trace buffer status ========================\n");
-	fprintf(stdout, "Buffer Status: %s\n", buf_status_descriptions[hct_get_buffer_status_out->buf_status]);
-	fprintf(stdout, "Fill Level: %x\n", hct_get_buffer_status_out->fill_level);
+	fprintf(stdout, "alert_config summary\n");
+	//fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
+
+	alert_config_out = (void *)cmd->send_cmd->out.payload;
+
+	fprintf(stdout, "    valid_alerts: 0x%x\n", alert_config_out->valid_alerts);
+	fprintf(stdout, "    programmable_alerts: 0x%x\n", alert_config_out->programmable_alerts);
+	fprintf(stdout, "    life_used_critical_alert_threshold: 0x%x\n",
+		alert_config_out->life_used_critical_alert_threshold);
+	fprintf(stdout, "    life_used_prog_warn_threshold: 0x%x\n",
+		alert_config_out->life_used_prog_warn_threshold);
+
+	fprintf(stdout, "    dev_over_temp_crit_alert_threshold: 0x%x\n",
+		le16_to_cpu(alert_config_out->dev_over_temp_crit_alert_threshold));
+	fprintf(stdout, "    dev_under_temp_crit_alert_threshold: 0x%x\n",
+		le16_to_cpu(alert_config_out->dev_under_temp_crit_alert_threshold));
+	fprintf(stdout, "    dev_over_temp_prog_warn_threshold: 0x%x\n",
+		le16_to_cpu(alert_config_out->dev_over_temp_prog_warn_threshold));
+	fprintf(stdout, "    dev_under_temp_prog_warn_threshold: 0x%x\n",
+		le16_to_cpu(alert_config_out->dev_under_temp_prog_warn_threshold));
+	fprintf(stdout, "    corr_vol_mem_err_prog_warn_thresold: 0x%x\n",
+		le16_to_cpu(alert_config_out->corr_vol_mem_err_prog_warn_thresold));
+	fprintf(stdout, "    corr_pers_mem_err_prog_warn_threshold: 0x%x\n",
+		le16_to_cpu(alert_config_out->corr_pers_mem_err_prog_warn_threshold));
 
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
-
-#define CXL_MEM_COMMAND_ID_HCT_ENABLE CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_HCT_ENABLE_OPCODE 50694
-#define CXL_MEM_COMMAND_ID_HCT_ENABLE_PAYLOAD_IN_SIZE 1
-
-struct cxl_mbox_hct_enable_in {
-	u8 hct_inst;
+struct cxl_mbox_set_alert_config_in {
+    u8 valid_alert_actions;
+    u8 enable_alert_actions;
+    u8 life_used_prog_warn_threshold;
+    u8 reserved;
+    __le16 dev_over_temp_prog_warn_threshold;
+    __le16 dev_under_temp_prog_warn_threshold;
+    __le16 corr_vol_mem_err_prog_warn_thresold;
+    __le16 corr_pers_mem_err_prog_warn_threshold;
 }  __attribute__((packed));
 
 
-CXL_EXPORT int cxl_memdev_hct_enable(struct cxl_memdev *memdev,
-	u8 hct_inst)
+CXL_EXPORT int cxl_memdev_set_alert_config(struct cxl_memdev *memdev, u32 alert_prog_threshold,
+	u32 device_temp_threshold, u32 mem_error_threshold)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_hct_enable_in *hct_enable_in;
+	struct cxl_mbox_set_alert_config_in *alert_config_in;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HCT_ENABLE_OPCODE);
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_SET_ALERT_CONFIG);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+	alert_config_in = (void *) cmd->send_cmd->in.payload;
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_HCT_ENABLE_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	alert_prog_threshold = cpu_to_be32(alert_prog_threshold);
+	device_temp_threshold = cpu_to_be32(device_temp_threshold);
+	mem_error_threshold = cpu_to_be32(mem_error_threshold);
+
+	alert_config_in->valid_alert_actions = ((alert_prog_threshold >> 8) & 0xff);
+	alert_config_in->enable_alert_actions = ((alert_prog_threshold >> 16) & 0xff);
+	alert_config_in->life_used_prog_warn_threshold = ((alert_prog_threshold >> 24) & 0xff);
+	alert_config_in->reserved = 0;
+
+	alert_config_in->dev_over_temp_prog_warn_threshold = cpu_to_le16(be16_to_cpu(((device_temp_threshold) & 0xffff)));
+	alert_config_in->dev_under_temp_prog_warn_threshold = cpu_to_le16(be16_to_cpu((((device_temp_threshold) >> 16) & 0xffff)));
+
+	alert_config_in->corr_vol_mem_err_prog_warn_thresold = cpu_to_le16(be16_to_cpu((mem_error_threshold & 0xffff)));
+	alert_config_in->corr_pers_mem_err_prog_warn_threshold = cpu_to_le16(be16_to_cpu(((mem_error_threshold >> 16) & 0xffff)));
 
-	hct_enable_in = (void *) cmd->send_cmd->in.payload;
+	fprintf(stdout, "alert_config settings\n");
+	fprintf(stdout, "    valid_alert_actions: 0x%x\n", alert_config_in->valid_alert_actions);
+	fprintf(stdout, "    enable_alert_actions: 0x%x\n", alert_config_in->enable_alert_actions);
+	fprintf(stdout, "    life_used_prog_warn_threshold: 0x%x\n", alert_config_in->life_used_prog_warn_threshold);
+	fprintf(stdout, "    dev_over_temp_prog_warn_threshold: 0x%x\n",
+		le16_to_cpu(alert_config_in->dev_over_temp_prog_warn_threshold));
+	fprintf(stdout, "    dev_under_temp_prog_warn_threshold: 0x%x\n",
+		le16_to_cpu(alert_config_in->dev_under_temp_prog_warn_threshold));
+	fprintf(stdout, "    corr_vol_mem_err_prog_warn_thresold: 0x%x\n",
+		le16_to_cpu(alert_config_in->corr_vol_mem_err_prog_warn_thresold));
+	fprintf(stdout, "    corr_pers_mem_err_prog_warn_threshold: 0x%x\n",
+		le16_to_cpu(alert_config_in->corr_pers_mem_err_prog_warn_threshold));
 
-	hct_enable_in->hct_inst = hct_inst;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
@@ -2953,67 +5833,136 @@ CXL_EXPORT int cxl_memdev_hct_enable(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HCT_ENABLE) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HCT_ENABLE);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_SET_ALERT_CONFIG) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_SET_ALERT_CONFIG);
 		return -EINVAL;
 	}
 
+	fprintf(stdout, "command completed successfully\n");
 
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
+/**
+ * cxl_memdev_read_alert_config - read the alert configuration of a memdev
+ * @memdev: memory device
+ * @cfg: filled in on success
+ *
+ * Quiet counterpart of cxl_memdev_get_alert_config() for callers that
+ * want the decoded thresholds rather than a printed summary.
+ */
+CXL_EXPORT int cxl_memdev_read_alert_config(struct cxl_memdev *memdev,
+		struct cxl_alert_config *cfg)
+{
+	struct cxl_mbox_get_alert_config_out *out;
+	struct cxl_cmd *cmd;
+	int rc;
 
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR_OPCODE 50954
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR_PAYLOAD_IN_SIZE 2
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_ALERT_CONFIG);
+	if (!cmd)
+		return -ENOMEM;
+	rc = cxl_cmd_submit(cmd);
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	if (rc == 0 && cmd->send_cmd->out.size < (int) sizeof(*out))
+		rc = -EIO;
+	if (rc == 0) {
+		out = (void *) cmd->send_cmd->out.payload;
+		cfg->valid_alerts = out->valid_alerts;
+		cfg->programmable_alerts = out->programmable_alerts;
+		cfg->life_used_crit = out->life_used_critical_alert_threshold;
+		cfg->life_used_warn = out->life_used_prog_warn_threshold;
+		cfg->over_temp_crit =
+			le16_to_cpu(out->dev_over_temp_crit_alert_threshold);
+		cfg->under_temp_crit =
+			le16_to_cpu(out->dev_under_temp_crit_alert_threshold);
+		cfg->over_temp_warn =
+			le16_to_cpu(out->dev_over_temp_prog_warn_threshold);
+		cfg->under_temp_warn =
+			le16_to_cpu(out->dev_under_temp_prog_warn_threshold);
+		cfg->corr_vol_mem_err_warn =
+			le16_to_cpu(out->corr_vol_mem_err_prog_warn_thresold);
+		cfg->corr_pers_mem_err_warn =
+			le16_to_cpu(out->corr_pers_mem_err_prog_warn_threshold);
+	}
+	cxl_cmd_unref(cmd);
+	return rc;
+}
 
-struct cxl_mbox_ltmon_capture_clear_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-}  __attribute__((packed));
+/**
+ * cxl_memdev_write_alert_config - update selected programmable warnings
+ * @memdev: memory device
+ * @mask: CXL_ALERT_* warnings to act on, all others are left untouched
+ * @cfg: thresholds, and in @cfg->valid_alerts whether each warning in
+ *	 @mask is enabled or disabled
+ *
+ * Fills in Set Alert Configuration directly from @cfg, so only the
+ * warnings in @mask are rewritten on the device.
+ */
+CXL_EXPORT int cxl_memdev_write_alert_config(struct cxl_memdev *memdev,
+		unsigned int mask, const struct cxl_alert_config *cfg)
+{
+	struct cxl_mbox_set_alert_config_in *in;
+	struct cxl_cmd *cmd;
+	int rc;
+
+	if (!mask || mask & ~CXL_ALERT_ALL)
+		return -EINVAL;
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_SET_ALERT_CONFIG);
+	if (!cmd)
+		return -ENOMEM;
+	in = (void *) cmd->send_cmd->in.payload;
+	memset(in, 0, sizeof(*in));
+	in->valid_alert_actions = mask;
+	in->enable_alert_actions = mask & cfg->valid_alerts;
+	in->life_used_prog_warn_threshold = cfg->life_used_warn;
+	in->dev_over_temp_prog_warn_threshold = cpu_to_le16(cfg->over_temp_warn);
+	in->dev_under_temp_prog_warn_threshold =
+		cpu_to_le16(cfg->under_temp_warn);
+	in->corr_vol_mem_err_prog_warn_thresold =
+		cpu_to_le16(cfg->corr_vol_mem_err_warn);
+	in->corr_pers_mem_err_prog_warn_threshold =
+		cpu_to_le16(cfg->corr_pers_mem_err_warn);
 
+	rc = cxl_cmd_submit(cmd);
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	cxl_cmd_unref(cmd);
+	return rc;
+}
 
-CXL_EXPORT int cxl_memdev_ltmon_capture_clear(struct cxl_memdev *memdev,
-	u8 cxl_mem_id)
+struct cxl_health_info {
+    u8 health_state;
+    u8 media_status;
+    u8 additional_status;
+    u8 life_used;
+    __le16 device_temp;
+    __le32 dirty_shutdown_count;
+    __le32 corr_vol_mem_err_count;
+    __le32 corr_pers_mem_err_count;
+}  __attribute__((packed));
+
+CXL_EXPORT int cxl_memdev_get_health_info(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_capture_clear_in *ltmon_capture_clear_in;
+	struct cxl_health_info *health_info;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR_OPCODE);
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_HEALTH_INFO);
 	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
+		fprintf(stderr, "%s: cxl_memdev_get_health_info returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	ltmon_capture_clear_in = (void *) cmd->send_cmd->in.payload;
-
-	ltmon_capture_clear_in->cxl_mem_id = cxl_mem_id;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
@@ -3024,46 +5973,104 @@ CXL_EXPORT int cxl_memdev_ltmon_capture_clear(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_HEALTH_INFO) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_HEALTH_INFO);
+		return -EINVAL;
+	}
+
+	if (cmd->send_cmd->out.size != sizeof(*health_info)) {
+		fprintf(stderr, "%s: invalid payload output size (got: %d, required: %ld)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->out.size, sizeof(*health_info));
 		return -EINVAL;
 	}
 
+	health_info = (void *)cmd->send_cmd->out.payload;
 
+	fprintf(stdout, "Device Health Info\n");
+	fprintf(stdout, "    out size: 0x%x\n", cmd->send_cmd->out.size);
+	fprintf(stdout, "    health_state: 0x%x\n", health_info->health_state);
+	fprintf(stdout, "    media_status: 0x%x\n", health_info->media_status);
+	fprintf(stdout, "    additional_status: 0x%x\n", health_info->additional_status);
+	fprintf(stdout, "    life_used: 0x%x\n", health_info->life_used);
+	fprintf(stdout, "    device_temp: 0x%x\n", le16_to_cpu(health_info->device_temp));
+	fprintf(stdout, "    dirty_shutdown_count: 0x%x\n", le32_to_cpu(health_info->dirty_shutdown_count));
+	fprintf(stdout, "    corr_vol_mem_err_count: 0x%x\n", le32_to_cpu(health_info->corr_vol_mem_err_count));
+	fprintf(stdout, "    corr_pers_mem_err_count: 0x%x\n", le32_to_cpu(health_info->corr_pers_mem_err_count));
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
+#define CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_OPCODE 0x100
+#define CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_PAYLOAD_IN_SIZE 0x1
+#define CXL_MAX_RECORDS_TO_DUMP 20
+
+#define CXL_DRAM_EVENT_GUID "601dcbb3-9c06-4eab-b8af-4e9bfb5c9624"
+#define CXL_MEM_MODULE_EVENT_GUID "fe927475-dd59-4339-a586-79bab113b774"
 
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_OPCODE 50956
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_PAYLOAD_IN_SIZE 8
+struct cxl_dram_event_record {
+	__le64 physical_addr;
+	u8 memory_event_descriptor;
+	u8 memory_event_type;
+	u8 transaction_type;
+	__le16 validity_flags;
+	u8 channel;
+	u8 rank;
+	u8 nibble_mask[3];
+	u8 bank_group;
+	u8 bank;
+	u8 row[3];
+	__le16 column;
+	u8 correction_mask[0x20];
+        u8 component_identifier[0x10];
+        u8 sub_channel;
+	u8 reserved[0x6];
+} __attribute__((packed));
+
+struct cxl_memory_module_record {
+	u8 dev_event_type;
+	u8 dev_health_info[0x12];
+	u8 reserved[0x3d];
+}__attribute__((packed));
+
+struct cxl_event_record {
+	uuid_t uuid;
+	u8 event_record_length;
+	u8 event_record_flags[3];
+	__le16 event_record_handle;
+	__le16 related_event_record_handle;
+	__le64 event_record_ts;
+	u8 reserved[0x10];
+	union {
+		struct cxl_dram_event_record dram_event_record;
+		struct cxl_memory_module_record memory_module_record;
+	} event_record;
+} __attribute__((packed));
 
-struct cxl_mbox_ltmon_capture_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	u8 capt_mode;
-	__le16 ignore_sub_chg;
-	u8 ignore_rxl0_chg;
-	u8 trig_src_sel;
-	u8 rsvd7;
+struct cxl_get_event_record_info {
+    u8 flags;
+    u8 reserved1;
+    __le16 overflow_err_cnt;
+    __le64 first_overflow_evt_ts;
+    __le64 last_overflow_evt_ts;
+    __le16 event_record_count;
+	u8 reserved2[0xa];
+	struct cxl_event_record event_records[];
 }  __attribute__((packed));
 
-
-CXL_EXPORT int cxl_memdev_ltmon_capture(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u8 capt_mode, u16 ignore_sub_chg, u8 ignore_rxl0_chg,
-	u8 trig_src_sel)
+CXL_EXPORT int cxl_memdev_get_event_records(struct cxl_memdev *memdev, u8 event_log_type)
 {
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_capture_in *ltmon_capture_in;
+    struct cxl_command_info *cinfo;
+	struct cxl_get_event_record_info *event_info;
 	int rc = 0;
+	int rec;
+	int indent = 2;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
@@ -3073,28 +6080,23 @@ CXL_EXPORT int cxl_memdev_ltmon_capture(struct cxl_memdev *memdev,
 	query = cmd->query_cmd;
 	cinfo = &query->commands[cmd->query_idx];
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_PAYLOAD_IN_SIZE;
+	/* this is hack to create right payload size */
+	cinfo->size_in = CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+        cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
+        if (!cmd->input_payload)
+            return -ENOMEM;
+        cmd->send_cmd->in.payload = (u64)cmd->input_payload;
+        cmd->send_cmd->in.size = cinfo->size_in;
+    }
 
-	ltmon_capture_in = (void *) cmd->send_cmd->in.payload;
+	* ((u8 *) cmd->send_cmd->in.payload) = event_log_type;
 
-	ltmon_capture_in->cxl_mem_id = cxl_mem_id;
-	ltmon_capture_in->capt_mode = capt_mode;
-	ltmon_capture_in->ignore_sub_chg = cpu_to_le16(ignore_sub_chg);
-	ltmon_capture_in->ignore_rxl0_chg = ignore_rxl0_chg;
-	ltmon_capture_in->trig_src_sel = trig_src_sel;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
@@ -3105,146 +6107,116 @@ CXL_EXPORT int cxl_memdev_ltmon_capture(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_CAPTURE) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_CAPTURE);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS);
 		return -EINVAL;
 	}
 
+	event_info = (void *)cmd->send_cmd->out.payload;
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
-}
-
-
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE_OPCODE 50958
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE_PAYLOAD_IN_SIZE 4
-
-struct cxl_mbox_ltmon_capture_freeze_and_restore_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	u8 freeze_restore;
-	u8 rsvd3;
-}  __attribute__((packed));
-
-
-CXL_EXPORT int cxl_memdev_ltmon_capture_freeze_and_restore(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u8 freeze_restore)
-{
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_capture_freeze_and_restore_in *ltmon_capture_freeze_and_restore_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+	fprintf(stdout, "cxl_dram_event_record size: 0x%lx\n", sizeof(struct cxl_dram_event_record));
+	fprintf(stdout, "cxl_memory_module_record size: 0x%lx\n", sizeof(struct cxl_memory_module_record));
+	fprintf(stdout, "cxl_event_record size: 0x%lx\n", sizeof(struct cxl_event_record));
+	fprintf(stdout, "cxl_get_event_record_info size: 0x%lx\n", sizeof(struct cxl_get_event_record_info));
+	fprintf(stdout, "========= Get Event Records Info =========\n");
+	fprintf(stdout, "%*sout size: 0x%x\n", indent, "", cmd->send_cmd->out.size);
+	fprintf(stdout, "%*sflags: 0x%x\n", indent, "", event_info->flags);
+	fprintf(stdout, "%*soverflow_err_cnt: 0x%x\n", indent, "", le16_to_cpu(event_info->overflow_err_cnt));
+	fprintf(stdout, "%*sfirst_overflow_evt_ts: 0x%lx\n", indent, "", le64_to_cpu(event_info->first_overflow_evt_ts));
+	fprintf(stdout, "%*slast_overflow_evt_ts: 0x%lx\n", indent, "", le64_to_cpu(event_info->last_overflow_evt_ts));
+	fprintf(stdout, "%*sevent_record_count: 0x%x\n", indent, "", le16_to_cpu(event_info->event_record_count));
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	for (rec = 0; rec < min(CXL_MAX_RECORDS_TO_DUMP, le16_to_cpu(event_info->event_record_count)); ++rec) {
+		char uuid[40];
+		struct cxl_event_record *event_record = &event_info->event_records[rec];
 
-	ltmon_capture_freeze_and_restore_in = (void *) cmd->send_cmd->in.payload;
+		uuid_unparse(event_info->event_records[rec].uuid, uuid);
 
-	ltmon_capture_freeze_and_restore_in->cxl_mem_id = cxl_mem_id;
-	ltmon_capture_freeze_and_restore_in->freeze_restore = freeze_restore;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+		if (strcmp(uuid, CXL_DRAM_EVENT_GUID) == 0)
+			fprintf(stdout, "%*sEvent Record: %d (DRAM guid: %s)\n", indent, "", rec, uuid);
+		else if (strcmp(uuid, CXL_MEM_MODULE_EVENT_GUID) == 0)
+			fprintf(stdout, "%*sEvent Record: %d (Memory Module Event guid: %s)\n", indent, "", rec, uuid);
+		else
+			fprintf(stdout, "%*sEvent Record: %d (uuid: %s)\n", indent, "", rec, uuid);
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+		fprintf(stdout, "%*sevent_record_length: 0x%x\n", indent+2, "", event_record->event_record_length);
+		fprintf(stdout, "%*sevent_record_flags: 0x%02x%02x%02x\n", indent+2, "", event_record->event_record_flags[0],
+			event_record->event_record_flags[1], event_record->event_record_flags[2]);
+		fprintf(stdout, "%*sevent_record_handle: 0x%x\n", indent+2, "", le16_to_cpu(event_record->event_record_handle));
+		fprintf(stdout, "%*srelated_event_record_handle: 0x%x\n", indent+2, "",
+			le16_to_cpu(event_record->related_event_record_handle));
+		fprintf(stdout, "%*sevent_record_ts: 0x%lx\n", indent+2, "", le64_to_cpu(event_record->event_record_ts));
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE);
-		return -EINVAL;
+		if (strcmp(uuid, CXL_DRAM_EVENT_GUID) == 0){
+			struct cxl_dram_event_record *dram_event = &event_record->event_record.dram_event_record;
+			fprintf(stdout, "%*sphysical_addr: 0x%lx\n", indent+2, "", le64_to_cpu(dram_event->physical_addr));
+			fprintf(stdout, "%*smemory_event_descriptor: 0x%x\n", indent+2, "", dram_event->memory_event_descriptor);
+			fprintf(stdout, "%*smemory_event_type: 0x%x\n", indent+2, "", dram_event->memory_event_type);
+			fprintf(stdout, "%*stransaction_type: 0x%x\n", indent+2, "", dram_event->transaction_type);
+			fprintf(stdout, "%*svalidity_flags: 0x%x\n", indent+2, "", le16_to_cpu(dram_event->validity_flags));
+			fprintf(stdout, "%*schannel: 0x%x\n", indent+2, "", dram_event->channel);
+			fprintf(stdout, "%*srank: 0x%x\n", indent+2, "", dram_event->rank);
+			fprintf(stdout, "%*snibble_mask: 0x%02x%02x%02x\n", indent+2, "",
+				dram_event->nibble_mask[0], dram_event->nibble_mask[1],
+				dram_event->nibble_mask[2]);
+			fprintf(stdout, "%*sbank_group: 0x%x\n", indent+2, "", dram_event->bank_group);
+			fprintf(stdout, "%*sbank: 0x%x\n", indent+2, "", dram_event->bank);
+			fprintf(stdout, "%*srow: 0x%02x%02x%02x\n", indent+2, "", dram_event->row[0],
+				dram_event->row[1], dram_event->row[2]);
+			fprintf(stdout, "%*scolumn: 0x%x\n", indent+2, "", le16_to_cpu(dram_event->column));
+			for (int i=0; i < 4; i++) {
+				fprintf(stdout, "%*scorrection mask[%d]: 0x", indent+2, "", i);
+				for (int j=0; j < 8; j++) {
+					fprintf(stdout, "%02x", dram_event->correction_mask[i*j+j]);
+				}
+				fprintf(stdout, "\n");
+			}
+			fprintf(stdout, "%*scomponent identifier: 0x%02x%02x%02x\n", indent+2, "",
+				dram_event->component_identifier[0], dram_event->component_identifier[1],
+				dram_event->component_identifier[2]);
+		}
 	}
 
-
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
 	return 0;
 }
 
+// GET_LD_INFO START
+#define CXL_MEM_COMMAND_ID_GET_LD_INFO CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_GET_LD_INFO_OPCODE 0x5400
+#define CXL_MEM_COMMAND_ID_GET_LD_INFO_PAYLOAD_OUT_SIZE 0xb
 
-#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_OPCODE 50960
-#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_PAYLOAD_IN_SIZE 2
-#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_PAYLOAD_OUT_SIZE 4
-
-struct cxl_mbox_ltmon_l2r_count_dump_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-}  __attribute__((packed));
-
-struct cxl_mbox_ltmon_l2r_count_dump_out {
-	__le32 dump_cnt;
+struct cxl_get_ld_info {
+	__le64 mem_size;
+	__le16 ld_cnt;
+	u8 qos_telemetry_capa;
 }  __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_ltmon_l2r_count_dump(struct cxl_memdev *memdev,
-	u8 cxl_mem_id)
+CXL_EXPORT int cxl_memdev_get_ld_info(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_l2r_count_dump_in *ltmon_l2r_count_dump_in;
-	struct cxl_mbox_ltmon_l2r_count_dump_out *ltmon_l2r_count_dump_out;
+	struct cxl_get_ld_info *ld_info;
 	int rc = 0;
+	int indent = 2;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_LD_INFO_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
+	cmd->send_cmd->in.size = 0;
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	ltmon_l2r_count_dump_in = (void *) cmd->send_cmd->in.payload;
+	fprintf(stdout, "Getting LD info for memdev %s\n", cxl_memdev_get_devname(memdev));
 
-	ltmon_l2r_count_dump_in->cxl_mem_id = cxl_mem_id;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
@@ -3255,15 +6227,19 @@ CXL_EXPORT int cxl_memdev_ltmon_l2r_count_dump(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_LD_INFO) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_LD_INFO);
 		return -EINVAL;
 	}
 
-	ltmon_l2r_count_dump_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "============================= ltmon l2r count dump =============================\n");
-	fprintf(stdout, "Dump Count: %x\n", le32_to_cpu(ltmon_l2r_count_dump_out->dump_cnt));
+	ld_info = (void *)cmd->send_cmd->out.payload;
+
+	fprintf(stdout, "========= Get LD Info =========\n");
+	fprintf(stdout, "%*sout size: 0x%x\n", indent, "", cmd->send_cmd->out.size);
+	fprintf(stdout, "%*smemory size: 0x%lx\n", indent, "", le64_to_cpu(ld_info->mem_size));
+	fprintf(stdout, "%*sld count: 0x%x\n", indent, "", le16_to_cpu(ld_info->ld_cnt));
+	fprintf(stdout, "%*sqos telemetry capability: 0x%x\n", indent, "", ld_info->qos_telemetry_capa);
 
 out:
 	cxl_cmd_unref(cmd);
@@ -3271,27 +6247,34 @@ out:
 	return 0;
 }
 
+// GET_LD_INFO END
 
-#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR_OPCODE 50961
-#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR_PAYLOAD_IN_SIZE 2
+#define CXL_MEM_COMMAND_ID_DEVICE_INFO_GET CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_OPCODE 49152
+#define CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_PAYLOAD_OUT_SIZE 8
+#define CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_PAYLOAD_IN_SIZE 0
 
-struct cxl_mbox_ltmon_l2r_count_clear_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-}  __attribute__((packed));
 
+struct cxl_mbox_device_info_get_out {
+	__le16 device_id;
+	u8 chipinfo_rel_major;
+	u8 chipinfo_rel_minor;
+	u8 device_rev;
+	u8 configfile_ver_major;
+	__le16 configfile_ver_minor;
+}  __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_ltmon_l2r_count_clear(struct cxl_memdev *memdev,
-	u8 cxl_mem_id)
+CXL_EXPORT int cxl_memdev_device_info_get(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
 	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_l2r_count_clear_in *ltmon_l2r_count_clear_in;
+	struct cxl_mbox_device_info_get_out *device_info_get_out;
 	int rc = 0;
+	char release_major;
+	release_major = 'A';
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
@@ -3301,19 +6284,16 @@ CXL_EXPORT int cxl_memdev_ltmon_l2r_count_clear(struct cxl_memdev *memdev,
 	query = cmd->query_cmd;
 	cinfo = &query->commands[cmd->query_idx];
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR_PAYLOAD_IN_SIZE;
+	/* this is hack to create right payload size */
+	cinfo->size_in = CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
 		cmd->send_cmd->in.size = cinfo->size_in;
 	}
 
-	ltmon_l2r_count_clear_in = (void *) cmd->send_cmd->in.payload;
-
-	ltmon_l2r_count_clear_in->cxl_mem_id = cxl_mem_id;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -3323,18 +6303,33 @@ CXL_EXPORT int cxl_memdev_ltmon_l2r_count_clear(struct cxl_memdev *memdev,
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
+		fprintf(stderr, "%s: firmware status: %d\n",
+				cxl_memdev_get_devname(memdev), rc);
 		rc = -ENXIO;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_DEVICE_INFO_GET) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_DEVICE_INFO_GET);
 		return -EINVAL;
 	}
 
+	device_info_get_out = (void *)cmd->send_cmd->out.payload;
+	release_major = release_major + device_info_get_out->chipinfo_rel_major;
+	fprintf(stdout, "=========================== read device information ============================\n");
+
+	fprintf(stdout, "Release & Revision for Device ID %x: %c.%x Rev %x\n",
+				device_info_get_out->device_id,
+				release_major,
+				device_info_get_out->chipinfo_rel_minor,
+				device_info_get_out->device_rev);
+	fprintf(stdout, "Device ID: %x\n", device_info_get_out->device_id);
+	fprintf(stdout, "Chip Info Release Major: %x\n", device_info_get_out->chipinfo_rel_major);
+	fprintf(stdout, "Chip Info Release Minor: %x\n", device_info_get_out->chipinfo_rel_minor);
+	fprintf(stdout, "Device Revision: %x\n", device_info_get_out->device_rev);
+	fprintf(stdout, "ConfigFile version Major: %x\n", device_info_get_out->configfile_ver_major);
+	fprintf(stdout, "ConfigFile version Minor: %x\n", device_info_get_out->configfile_ver_minor);
 
 out:
 	cxl_cmd_unref(cmd);
@@ -3342,53 +6337,39 @@ out:
 	return 0;
 }
 
+#define CXL_MEM_COMMAND_ID_GET_FW_INFO CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_GET_FW_INFO_OPCODE 512
+#define CXL_MEM_COMMAND_ID_GET_FW_INFO_PAYLOAD_OUT_SIZE 80
 
-#define CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG_OPCODE 50962
-#define CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG_PAYLOAD_IN_SIZE 4
 
-struct cxl_mbox_ltmon_basic_cfg_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	u8 tick_cnt;
-	u8 global_ts;
+struct cxl_mbox_get_fw_info_out {
+	u8 fw_slots_supp;
+	u8 fw_slot_info;
+	u8 fw_activation_capas;
+	u8 rsvd[13];
+	char slot_1_fw_rev[16];
+	char slot_2_fw_rev[16];
+	char slot_3_fw_rev[16];
+	char slot_4_fw_rev[16];
 }  __attribute__((packed));
 
-
-CXL_EXPORT int cxl_memdev_ltmon_basic_cfg(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u8 tick_cnt, u8 global_ts)
+CXL_EXPORT int cxl_memdev_get_fw_info(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_basic_cfg_in *ltmon_basic_cfg_in;
+	struct cxl_mbox_get_fw_info_out *get_fw_info_out;
 	int rc = 0;
+	u8 active_slot_mask;
+	u8 active_slot;
+	u8 staged_slot_mask;
+	u8 staged_slot;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_GET_FW_INFO_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	ltmon_basic_cfg_in = (void *) cmd->send_cmd->in.payload;
-
-	ltmon_basic_cfg_in->cxl_mem_id = cxl_mem_id;
-	ltmon_basic_cfg_in->tick_cnt = tick_cnt;
-	ltmon_basic_cfg_in->global_ts = global_ts;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -3398,18 +6379,36 @@ CXL_EXPORT int cxl_memdev_ltmon_basic_cfg(struct cxl_memdev *memdev,
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
+		fprintf(stderr, "%s: firmware status: %d\n",
+				cxl_memdev_get_devname(memdev), rc);
 		rc = -ENXIO;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_GET_FW_INFO) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_GET_FW_INFO);
 		return -EINVAL;
 	}
 
+	get_fw_info_out = (void *)cmd->send_cmd->out.payload;
+	active_slot_mask = 0b00000111;
+	active_slot = get_fw_info_out->fw_slot_info & active_slot_mask;
+	staged_slot_mask = 0b00111000;
+	staged_slot = get_fw_info_out->fw_slot_info & staged_slot_mask;
+	staged_slot = staged_slot>>3;
+	fprintf(stdout, "================================= get fw info ==================================\n");
+	fprintf(stdout, "FW Slots Supported: %x\n", get_fw_info_out->fw_slots_supp);
+	fprintf(stdout, "Active FW Slot: %x\n", active_slot);
+	if (staged_slot)
+	{
+		fprintf(stdout, "Staged FW Slot: %x\n", staged_slot);
+	}
+	fprintf(stdout, "FW Activation Capabilities: %x\n", get_fw_info_out->fw_activation_capas);
+	fprintf(stdout, "Slot 1 FW Revision: %s\n", get_fw_info_out->slot_1_fw_rev);
+	fprintf(stdout, "Slot 2 FW Revision: %s\n", get_fw_info_out->slot_2_fw_rev);
+	fprintf(stdout, "Slot 3 FW Revision: %s\n", get_fw_info_out->slot_3_fw_rev);
+	fprintf(stdout, "Slot 4 FW Revision: %s\n", get_fw_info_out->slot_4_fw_rev);
 
 out:
 	cxl_cmd_unref(cmd);
@@ -3418,66 +6417,89 @@ out:
 }
 
 
-#define CXL_MEM_COMMAND_ID_LTMON_WATCH CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_WATCH_OPCODE 50963
-#define CXL_MEM_COMMAND_ID_LTMON_WATCH_PAYLOAD_IN_SIZE 12
+#define CXL_MEM_COMMAND_ID_TRANSFER_FW CXL_MEM_COMMAND_ID_RAW
 
-struct cxl_mbox_ltmon_watch_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	u8 watch_id;
-	u8 watch_mode;
-	u8 src_maj_st;
-	u8 src_min_st;
-	u8 src_l0_st;
-	u8 dst_maj_st;
-	u8 dst_min_st;
-	u8 dst_l0_st;
-	__le16 rsvd10;
+struct cxl_mbox_transfer_fw_in {
+	u8 action;
+	u8 slot;
+	__le16 rsvd;
+	__le32 offset;
+	__le64 rsvd8[15];
+	unsigned char data[];
 }  __attribute__((packed));
 
+/*
+ * Largest firmware block that fits in one transfer-fw payload after the
+ * 128 byte header. Offsets are expressed in FW_BYTE_ALIGN units so the
+ * block size is rounded down to that alignment.
+ */
+CXL_EXPORT int cxl_memdev_get_fw_transfer_size(struct cxl_memdev *memdev)
+{
+	int size = memdev_payload_max(memdev);
+
+	if (size < 0)
+		return size;
+	size -= sizeof(struct cxl_mbox_transfer_fw_in);
+	size -= size % FW_BYTE_ALIGN;
+	if (size <= 0)
+		return -EINVAL;
+	return size;
+}
 
-CXL_EXPORT int cxl_memdev_ltmon_watch(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u8 watch_id, u8 watch_mode, u8 src_maj_st, u8 src_min_st,
-	u8 src_l0_st, u8 dst_maj_st, u8 dst_min_st, u8 dst_l0_st)
+/*
+ * A transfer-fw command with a payload_max sized input buffer. Callers
+ * stream a whole image through one command by rewriting the block with
+ * cxl_cmd_transfer_fw_set_block() and resubmitting it.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_transfer_fw(struct cxl_memdev *memdev,
+		u32 transfer_fw_opcode)
+{
+	return cxl_cmd_new_vendor(memdev, transfer_fw_opcode,
+			memdev_payload_max(memdev));
+}
+
+CXL_EXPORT int cxl_cmd_transfer_fw_set_block(struct cxl_cmd *cmd, u8 action,
+		u8 slot, u32 offset, const void *data, int size)
+{
+	struct cxl_mbox_transfer_fw_in *transfer_fw_in;
+	int size_in = sizeof(*transfer_fw_in) + size;
+
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_TRANSFER_FW
+			|| !cmd->input_payload)
+		return -EINVAL;
+	if (size < 0 || size_in > memdev_payload_max(cmd->memdev))
+		return -EINVAL;
+
+	transfer_fw_in = cmd->input_payload;
+	memset(transfer_fw_in, 0, sizeof(*transfer_fw_in));
+	transfer_fw_in->action = action;
+	transfer_fw_in->slot = slot;
+	transfer_fw_in->offset = cpu_to_le32(offset);
+	if (size)
+		memcpy(transfer_fw_in->data, data, size);
+	cmd->send_cmd->in.size = size_in;
+
+	return 0;
+}
+
+CXL_EXPORT int cxl_memdev_transfer_fw(struct cxl_memdev *memdev,
+	u8 action, u8 slot, u32 offset, int size,
+    unsigned char *data, u32 transfer_fw_opcode)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_watch_in *ltmon_watch_in;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_WATCH_OPCODE);
+	cmd = cxl_cmd_new_transfer_fw(memdev, transfer_fw_opcode);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_WATCH_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	ltmon_watch_in = (void *) cmd->send_cmd->in.payload;
+	rc = cxl_cmd_transfer_fw_set_block(cmd, action, slot, offset, data, size);
+	if (rc)
+		goto out;
 
-	ltmon_watch_in->cxl_mem_id = cxl_mem_id;
-	ltmon_watch_in->watch_id = watch_id;
-	ltmon_watch_in->watch_mode = watch_mode;
-	ltmon_watch_in->src_maj_st = src_maj_st;
-	ltmon_watch_in->src_min_st = src_min_st;
-	ltmon_watch_in->src_l0_st = src_l0_st;
-	ltmon_watch_in->dst_maj_st = dst_maj_st;
-	ltmon_watch_in->dst_min_st = dst_min_st;
-	ltmon_watch_in->dst_l0_st = dst_l0_st;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -3487,56 +6509,37 @@ CXL_EXPORT int cxl_memdev_ltmon_watch(struct cxl_memdev *memdev,
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
+		fprintf(stderr, "%s: firmware status: %d\n",
+				cxl_memdev_get_devname(memdev), rc);
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_WATCH) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_WATCH);
-		return -EINVAL;
-	}
-
-
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
 
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_OPCODE 50964
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_PAYLOAD_IN_SIZE 2
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_PAYLOAD_OUT_SIZE 12
+#define CXL_MEM_COMMAND_ID_ACTIVATE_FW CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_ACTIVATE_FW_OPCODE 52482
+#define CXL_MEM_COMMAND_ID_ACTIVATE_FW_PAYLOAD_IN_SIZE 2
 
-struct cxl_mbox_ltmon_capture_stat_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
+struct cxl_mbox_activate_fw_in {
+	u8 action;
+	u8 slot;
 }  __attribute__((packed));
 
-struct cxl_mbox_ltmon_capture_stat_out {
-	__le16 trig_cnt;
-	__le16 watch0_trig_cnt;
-	__le16 watch1_trig_cnt;
-	__le16 time_stamp;
-	u8 trig_src_stat;
-	u8 rsvd[3];
-}  __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_ltmon_capture_stat(struct cxl_memdev *memdev,
-	u8 cxl_mem_id)
+CXL_EXPORT int cxl_memdev_activate_fw(struct cxl_memdev *memdev,
+	u8 action, u8 slot)
 {
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
 	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_capture_stat_in *ltmon_capture_stat_in;
-	struct cxl_mbox_ltmon_capture_stat_out *ltmon_capture_stat_out;
+	struct cxl_mbox_activate_fw_in *activate_fw_in;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_ACTIVATE_FW_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
@@ -3546,19 +6549,20 @@ CXL_EXPORT int cxl_memdev_ltmon_capture_stat(struct cxl_memdev *memdev,
 	query = cmd->query_cmd;
 	cinfo = &query->commands[cmd->query_idx];
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_PAYLOAD_IN_SIZE;
+	/* this is hack to create right payload size */
+	cinfo->size_in = CXL_MEM_COMMAND_ID_ACTIVATE_FW_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
 		cmd->send_cmd->in.size = cinfo->size_in;
 	}
 
-	ltmon_capture_stat_in = (void *) cmd->send_cmd->in.payload;
+	activate_fw_in = (void *) cmd->send_cmd->in.payload;
 
-	ltmon_capture_stat_in->cxl_mem_id = cxl_mem_id;
+	activate_fw_in->action = action;
+	activate_fw_in->slot = slot;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -3568,25 +6572,19 @@ CXL_EXPORT int cxl_memdev_ltmon_capture_stat(struct cxl_memdev *memdev,
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
+		fprintf(stderr, "%s: firmware status: %d\n",
+				cxl_memdev_get_devname(memdev), rc);
 		rc = -ENXIO;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_ACTIVATE_FW) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_ACTIVATE_FW);
 		return -EINVAL;
 	}
+	cxl_memdev_inventory_flush(memdev, true);
 
-	ltmon_capture_stat_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "============================= ltmon capture status =============================\n");
-	fprintf(stdout, "Trigger Count: %x\n", le16_to_cpu(ltmon_capture_stat_out->trig_cnt));
-	fprintf(stdout, "Watch 0 Trigger Count: %x\n", le16_to_cpu(ltmon_capture_stat_out->watch0_trig_cnt));
-	fprintf(stdout, "Watch 1 Trigger Count: %x\n", le16_to_cpu(ltmon_capture_stat_out->watch1_trig_cnt));
-	fprintf(stdout, "Time Stamp: %x\n", le16_to_cpu(ltmon_capture_stat_out->time_stamp));
-	fprintf(stdout, "Trigger Source Status: %x\n", ltmon_capture_stat_out->trig_src_stat);
 
 out:
 	cxl_cmd_unref(cmd);
@@ -3595,34 +6593,37 @@ out:
 }
 
 
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_OPCODE 50965
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_PAYLOAD_IN_SIZE 8
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_PAYLOAD_OUT_SIZE 16
+#define CXL_MEM_COMMAND_ID_DDR_INFO CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_DDR_INFO_OPCODE 50432
+#define CXL_MEM_COMMAND_ID_DDR_INFO_PAYLOAD_IN_SIZE 1
+#define CXL_MEM_COMMAND_ID_DDR_INFO_PAYLOAD_OUT_SIZE 8
 
-struct cxl_mbox_ltmon_capture_log_dmp_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	__le16 dump_idx;
-	__le16 dump_cnt;
-	__le16 rsvd6;
+struct cxl_mbox_ddr_info_in {
+	u8 ddr_id;
 }  __attribute__((packed));
 
-struct cxl_mbox_ltmon_capture_log_dmp_out {
-	__le64 data[2];
+struct cxl_mbox_ddr_info_out {
+	__le32 mstr_reg;
+	__le32 dram_width;
 }  __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_ltmon_capture_log_dmp(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u16 dump_idx, u16 dump_cnt)
+CXL_EXPORT int cxl_memdev_ddr_info(struct cxl_memdev *memdev, u8 ddr_id)
 {
+	/*const char *dram_width_descriptions[4] = {
+		"DRAM Width x4 device",
+		"DRAM Width x8 device",
+		"DRAM Width x16 device",
+		"DRAM Width x32 device"
+	};*/
+
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
 	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_capture_log_dmp_in *ltmon_capture_log_dmp_in;
-	struct cxl_mbox_ltmon_capture_log_dmp_out *ltmon_capture_log_dmp_out;
+	struct cxl_mbox_ddr_info_in *ddr_info_in;
+	struct cxl_mbox_ddr_info_out *ddr_info_out;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_DDR_INFO_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
@@ -3633,20 +6634,18 @@ CXL_EXPORT int cxl_memdev_ltmon_capture_log_dmp(struct cxl_memdev *memdev,
 	cinfo = &query->commands[cmd->query_idx];
 
 	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_PAYLOAD_IN_SIZE;
+	cinfo->size_in = CXL_MEM_COMMAND_ID_DDR_INFO_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
 		cmd->send_cmd->in.size = cinfo->size_in;
 	}
 
-	ltmon_capture_log_dmp_in = (void *) cmd->send_cmd->in.payload;
+	ddr_info_in = (void *) cmd->send_cmd->in.payload;
 
-	ltmon_capture_log_dmp_in->cxl_mem_id = cxl_mem_id;
-	ltmon_capture_log_dmp_in->dump_idx = cpu_to_le16(dump_idx);
-	ltmon_capture_log_dmp_in->dump_cnt = cpu_to_le16(dump_cnt);
+	ddr_info_in->ddr_id = ddr_id;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -3656,27 +6655,22 @@ CXL_EXPORT int cxl_memdev_ltmon_capture_log_dmp(struct cxl_memdev *memdev,
 
 	rc = cxl_cmd_get_mbox_status(cmd);
 	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
+		fprintf(stderr, "%s: firmware status: %d\n",
+				cxl_memdev_get_devname(memdev), rc);
 		rc = -ENXIO;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_DDR_INFO) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_DDR_INFO);
 		return -EINVAL;
 	}
 
-	ltmon_capture_log_dmp_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "============================ ltmon capture log dump ============================\n");
-	fprintf(stdout, "LTMON Data: ");
-	/* Procedurally generated print statement. To print this array contiguously,
-	   add "contiguous: True" to the YAML param and rerun cligen.py */
-	for (int i = 0; i < 2; i++) {
-		fprintf(stdout, "data[%d]: %lx\n", i, le64_to_cpu(ltmon_capture_log_dmp_out->data[i]));
-	}
-	fprintf(stdout, "\n");
+	ddr_info_out = (void *)cmd->send_cmd->out.payload;
+	fprintf(stdout, "=================================== ddr info ===================================\n");
+	fprintf(stdout, "DDR controller MSTR register: %x\n", le32_to_cpu(ddr_info_out->mstr_reg));
+	fprintf(stdout, "DRAM width derived from DEVICE_CONFIG: %d\n", le32_to_cpu(ddr_info_out->dram_width));
 
 out:
 	cxl_cmd_unref(cmd);
@@ -3684,29 +6678,57 @@ out:
 	return 0;
 }
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_ddr_info(struct cxl_memdev *memdev,
+		u8 ddr_id)
+{
+	struct cxl_mbox_ddr_info_in *in;
+	struct cxl_cmd *cmd;
 
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER_OPCODE 50966
-#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER_PAYLOAD_IN_SIZE 4
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_DDR_INFO_OPCODE,
+			sizeof(*in));
+	if (!cmd)
+		return NULL;
+	in = (void *) cmd->send_cmd->in.payload;
+	in->ddr_id = ddr_id;
+	return cmd;
+}
 
-struct cxl_mbox_ltmon_capture_trigger_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	u8 trig_src;
-	u8 rsvd3;
+CXL_EXPORT unsigned int cxl_cmd_ddr_info_get_mstr(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_ddr_info_out *o = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_DDR_INFO_OPCODE, sizeof(*o));
+
+	return o ? le32_to_cpu(o->mstr_reg) : 0;
+}
+
+CXL_EXPORT int cxl_cmd_ddr_info_get_dram_width(struct cxl_cmd *cmd)
+{
+	cmd_vendor_get_int(cmd, ddr_info, DDR_INFO, 32, dram_width);
+}
+
+
+#define CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS_OPCODE 0x101
+
+struct cxl_clear_event_record_info {
+    u8 event_log_type;
+    u8 clear_event_flags;
+    u8 no_event_record_handles;
+	u8 reserved[3];
+	__le16 event_record_handles[];
 }  __attribute__((packed));
 
-
-CXL_EXPORT int cxl_memdev_ltmon_capture_trigger(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u8 trig_src)
+CXL_EXPORT int cxl_memdev_clear_event_records(struct cxl_memdev *memdev, u8 event_log_type,
+	u8 clear_event_flags, u8 no_event_record_handles, u16 *event_record_handles)
 {
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_capture_trigger_in *ltmon_capture_trigger_in;
+    struct cxl_command_info *cinfo;
+	struct cxl_clear_event_record_info *event_info;
 	int rc = 0;
+	int rec;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
@@ -3716,25 +6738,34 @@ CXL_EXPORT int cxl_memdev_ltmon_capture_trigger(struct cxl_memdev *memdev,
 	query = cmd->query_cmd;
 	cinfo = &query->commands[cmd->query_idx];
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER_PAYLOAD_IN_SIZE;
+	/* this is hack to create right payload size */
+	cinfo->size_in = sizeof(*event_info) + (no_event_record_handles * sizeof(__le16));
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
+        cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
+        if (!cmd->input_payload)
+            return -ENOMEM;
+        cmd->send_cmd->in.payload = (u64)cmd->input_payload;
+        cmd->send_cmd->in.size = cinfo->size_in;
+    }
+
+	if (clear_event_flags) {
+		dbg(memdev->ctx, "Clearing 'All Event' Records for type %d\n", event_log_type);
 	}
 
-	ltmon_capture_trigger_in = (void *) cmd->send_cmd->in.payload;
+	event_info = (struct cxl_clear_event_record_info *) cmd->send_cmd->in.payload;
+	event_info->event_log_type = event_log_type;
+	event_info->clear_event_flags = clear_event_flags;
+	event_info->no_event_record_handles = no_event_record_handles;
+	for (rec = 0; rec < event_info->no_event_record_handles; ++rec) {
+		dbg(memdev->ctx, "Clearing Event Record 0x%x for %d type\n", event_record_handles[rec], event_log_type);
+		event_info->event_record_handles[rec] = cpu_to_le16(event_record_handles[rec]);
+	}
 
-	ltmon_capture_trigger_in->cxl_mem_id = cxl_mem_id;
-	ltmon_capture_trigger_in->trig_src = trig_src;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
 				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		goto out;
 	}
 
 	rc = cxl_cmd_get_mbox_status(cmd);
@@ -3745,12 +6776,13 @@ CXL_EXPORT int cxl_memdev_ltmon_capture_trigger(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER);
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS) {
+		fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS);
 		return -EINVAL;
 	}
 
+	fprintf(stdout, "Clear Event Records command completed successfully\n");
 
 out:
 	cxl_cmd_unref(cmd);
@@ -3758,399 +6790,735 @@ out:
 	return 0;
 }
 
+#define CXL_EVENT_RECORDS_MORE (1 << 1)
+#define CXL_CLEAR_EVENT_HANDLES_MAX 255
+
+static void cxl_event_record_decode(const struct cxl_event_record *raw,
+		u8 event_log_type, struct cxl_event_record_info *rec)
+{
+	const struct cxl_dram_event_record *dram =
+		&raw->event_record.dram_event_record;
+	const struct cxl_memory_module_record *mm =
+		&raw->event_record.memory_module_record;
+	char uuid[40];
+
+	memset(rec, 0, sizeof(*rec));
+	memcpy(rec->uuid, raw->uuid, sizeof(rec->uuid));
+	rec->log_type = event_log_type;
+	rec->length = raw->event_record_length;
+	rec->flags = raw->event_record_flags[0]
+		| raw->event_record_flags[1] << 8
+		| raw->event_record_flags[2] << 16;
+	rec->handle = le16_to_cpu(raw->event_record_handle);
+	rec->related_handle = le16_to_cpu(raw->related_event_record_handle);
+	rec->timestamp = le64_to_cpu(raw->event_record_ts);
+	memcpy(rec->data, &raw->event_record, sizeof(rec->data));
+
+	uuid_unparse(raw->uuid, uuid);
+	if (strcmp(uuid, CXL_DRAM_EVENT_GUID) == 0) {
+		rec->type = CXL_EVENT_RECORD_DRAM;
+		rec->dram.physical_addr = le64_to_cpu(dram->physical_addr);
+		rec->dram.memory_event_descriptor = dram->memory_event_descriptor;
+		rec->dram.memory_event_type = dram->memory_event_type;
+		rec->dram.transaction_type = dram->transaction_type;
+		rec->dram.validity_flags = le16_to_cpu(dram->validity_flags);
+		rec->dram.channel = dram->channel;
+		rec->dram.rank = dram->rank;
+		rec->dram.nibble_mask = dram->nibble_mask[0]
+			| dram->nibble_mask[1] << 8 | dram->nibble_mask[2] << 16;
+		rec->dram.bank_group = dram->bank_group;
+		rec->dram.bank = dram->bank;
+		rec->dram.row = dram->row[0] | dram->row[1] << 8
+			| dram->row[2] << 16;
+		rec->dram.column = le16_to_cpu(dram->column);
+		memcpy(rec->dram.correction_mask, dram->correction_mask,
+				sizeof(rec->dram.correction_mask));
+		memcpy(rec->dram.component_identifier,
+				dram->component_identifier,
+				sizeof(rec->dram.component_identifier));
+		rec->dram.sub_channel = dram->sub_channel;
+	} else if (strcmp(uuid, CXL_MEM_MODULE_EVENT_GUID) == 0) {
+		rec->type = CXL_EVENT_RECORD_MEMORY_MODULE;
+		rec->memory_module.dev_event_type = mm->dev_event_type;
+		memcpy(rec->memory_module.dev_health_info, mm->dev_health_info,
+				sizeof(rec->memory_module.dev_health_info));
+	} else {
+		rec->type = CXL_EVENT_RECORD_GENERIC;
+	}
+}
 
-#define CXL_MEM_COMMAND_ID_LTMON_ENABLE CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_LTMON_ENABLE_OPCODE 51072
-#define CXL_MEM_COMMAND_ID_LTMON_ENABLE_PAYLOAD_IN_SIZE 4
+static int cxl_memdev_clear_event_handles(struct cxl_memdev *memdev,
+		u8 event_log_type, const u16 *handles, int nr)
+{
+	struct cxl_clear_event_record_info *clear;
+	struct cxl_cmd *cmd;
+	int i, rc;
 
-struct cxl_mbox_ltmon_enable_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	u8 enable;
-	u8 rsvd3;
-}  __attribute__((packed));
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_CLEAR_EVENT_RECORDS_OPCODE,
+			sizeof(*clear) + nr * sizeof(__le16));
+	if (!cmd)
+		return -ENOMEM;
 
+	clear = cmd->input_payload;
+	clear->event_log_type = event_log_type;
+	clear->no_event_record_handles = nr;
+	for (i = 0; i < nr; i++)
+		clear->event_record_handles[i] = cpu_to_le16(handles[i]);
 
-CXL_EXPORT int cxl_memdev_ltmon_enable(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u8 enable)
+	rc = cxl_cmd_vendor_submit(cmd);
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+/*
+ * Read every record in one event log, handing each to @fn as it is
+ * decoded. The device only returns newer records once the ones it
+ * already returned have been cleared, so a complete drain needs
+ * CXL_EVENT_DRAIN_CLEAR; without it a single GET_EVENT_RECORDS worth of
+ * records is reported. A negative return from @fn stops the drain
+ * before the current batch is cleared. Returns the number of records
+ * reported, or a negative error code.
+ */
+CXL_EXPORT int cxl_memdev_drain_event_records(struct cxl_memdev *memdev,
+		u8 event_log_type, unsigned int flags, cxl_event_record_fn fn,
+		void *priv)
 {
+	struct cxl_event_record_info rec;
+	struct cxl_get_event_record_info *get;
+	u16 handles[CXL_CLEAR_EVENT_HANDLES_MAX];
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_ltmon_enable_in *ltmon_enable_in;
-	int rc = 0;
+	int i, nr, total = 0, rc;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_LTMON_ENABLE_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_OPCODE,
+			CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_PAYLOAD_IN_SIZE);
+	if (!cmd)
 		return -ENOMEM;
-	}
+	*(u8 *) cmd->input_payload = event_log_type;
+
+	for (;;) {
+		rc = cxl_cmd_vendor_submit(cmd);
+		if (rc)
+			break;
+		get = cxl_cmd_vendor_get_payload(cmd,
+				CXL_MEM_COMMAND_ID_GET_EVENT_RECORDS_OPCODE,
+				sizeof(*get));
+		if (!get) {
+			rc = -EINVAL;
+			break;
+		}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+		if (le16_to_cpu(get->overflow_err_cnt))
+			info(memdev->ctx, "%s: event log %d overflowed, %d records lost\n",
+					cxl_memdev_get_devname(memdev),
+					event_log_type,
+					le16_to_cpu(get->overflow_err_cnt));
+
+		/* trust the record count only as far as the payload goes */
+		nr = le16_to_cpu(get->event_record_count);
+		nr = min_t(int, nr, (cmd->send_cmd->out.size - sizeof(*get))
+				/ sizeof(struct cxl_event_record));
+		nr = min(nr, CXL_CLEAR_EVENT_HANDLES_MAX);
+		if (nr == 0)
+			break;
+
+		for (i = 0; i < nr; i++) {
+			cxl_event_record_decode(&get->event_records[i],
+					event_log_type, &rec);
+			handles[i] = rec.handle;
+			rc = fn ? fn(memdev, &rec, priv) : 0;
+			if (rc < 0)
+				goto out;
+		}
+		total += nr;
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_LTMON_ENABLE_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
+		if (!(flags & CXL_EVENT_DRAIN_CLEAR))
+			break;
+		rc = cxl_memdev_clear_event_handles(memdev, event_log_type,
+				handles, nr);
+		if (rc)
+			break;
+		if (!(get->flags & CXL_EVENT_RECORDS_MORE))
+			break;
 	}
 
-	ltmon_enable_in = (void *) cmd->send_cmd->in.payload;
+out:
+	cxl_cmd_unref(cmd);
+	return rc < 0 ? rc : total;
+}
 
-	ltmon_enable_in->cxl_mem_id = cxl_mem_id;
-	ltmon_enable_in->enable = enable;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+#define CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER_OPCODE 50691
+#define CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER_PAYLOAD_IN_SIZE 2
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+static const struct cxl_vendor_field hct_start_stop_trigger_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+	{ .offset = 0x01, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd hct_start_stop_trigger_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_HCT_START_STOP_TRIGGER_PAYLOAD_IN_SIZE,
+	.in = hct_start_stop_trigger_in_fields,
+	.nr_in = ARRAY_SIZE(hct_start_stop_trigger_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_hct_start_stop_trigger(struct cxl_memdev *memdev,
+	u8 hct_inst, u8 buf_control)
+{
+	const u64 args[] = { hct_inst, buf_control };
+
+	return cxl_memdev_vendor_cmd(memdev, &hct_start_stop_trigger_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_OPCODE 50692
+#define CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_PAYLOAD_IN_SIZE 1
+#define CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_PAYLOAD_OUT_SIZE 2
+
+static const struct cxl_vendor_field hct_get_buffer_status_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+};
+
+static const char * const hct_get_buffer_status_buf_status_descriptions[] = {
+	"Stop",
+	"Pre-Trigger",
+	"Post-Trigger"
+};
+
+static const struct cxl_vendor_field hct_get_buffer_status_out_fields[] = {
+	{ .name = "Buffer Status", .offset = 0x00, .width = 1,
+	  .enums = hct_get_buffer_status_buf_status_descriptions,
+	  .nr_enums = ARRAY_SIZE(hct_get_buffer_status_buf_status_descriptions) },
+	{ .name = "Fill Level", .offset = 0x01, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd hct_get_buffer_status_cmd = {
+	.title = "get hif/cxl trace buffer status",
+	.opcode = CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_PAYLOAD_IN_SIZE,
+	.in = hct_get_buffer_status_in_fields,
+	.nr_in = ARRAY_SIZE(hct_get_buffer_status_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_HCT_GET_BUFFER_STATUS_PAYLOAD_OUT_SIZE,
+	.out = hct_get_buffer_status_out_fields,
+	.nr_out = ARRAY_SIZE(hct_get_buffer_status_out_fields),
+};
+
+CXL_EXPORT int cxl_memdev_hct_get_buffer_status(struct cxl_memdev *memdev,
+	u8 hct_inst)
+{
+	const u64 args[] = { hct_inst };
+
+	return cxl_memdev_vendor_cmd(memdev, &hct_get_buffer_status_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_HCT_ENABLE CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_HCT_ENABLE_OPCODE 50694
+#define CXL_MEM_COMMAND_ID_HCT_ENABLE_PAYLOAD_IN_SIZE 1
+
+static const struct cxl_vendor_field hct_enable_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd hct_enable_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_HCT_ENABLE_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_HCT_ENABLE_PAYLOAD_IN_SIZE,
+	.in = hct_enable_in_fields,
+	.nr_in = ARRAY_SIZE(hct_enable_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_hct_enable(struct cxl_memdev *memdev,
+	u8 hct_inst)
+{
+	const u64 args[] = { hct_inst };
+
+	return cxl_memdev_vendor_cmd(memdev, &hct_enable_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR_OPCODE 50954
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR_PAYLOAD_IN_SIZE 2
+
+static const struct cxl_vendor_field ltmon_capture_clear_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd ltmon_capture_clear_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_CLEAR_PAYLOAD_IN_SIZE,
+	.in = ltmon_capture_clear_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_capture_clear_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_ltmon_capture_clear(struct cxl_memdev *memdev,
+	u8 cxl_mem_id)
+{
+	const u64 args[] = { cxl_mem_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_capture_clear_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_OPCODE 50956
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_PAYLOAD_IN_SIZE 8
+
+static const struct cxl_vendor_field ltmon_capture_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+	{ .offset = 0x03, .width = 2 },
+	{ .offset = 0x05, .width = 1 },
+	{ .offset = 0x06, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd ltmon_capture_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_PAYLOAD_IN_SIZE,
+	.in = ltmon_capture_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_capture_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_ltmon_capture(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u8 capt_mode, u16 ignore_sub_chg, u8 ignore_rxl0_chg,
+	u8 trig_src_sel)
+{
+	const u64 args[] = { cxl_mem_id, capt_mode, ignore_sub_chg,
+		ignore_rxl0_chg, trig_src_sel };
+
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_capture_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE_OPCODE 50958
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE_PAYLOAD_IN_SIZE 4
+
+static const struct cxl_vendor_field ltmon_capture_freeze_and_restore_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd ltmon_capture_freeze_and_restore_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_FREEZE_AND_RESTORE_PAYLOAD_IN_SIZE,
+	.in = ltmon_capture_freeze_and_restore_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_capture_freeze_and_restore_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_ltmon_capture_freeze_and_restore(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u8 freeze_restore)
+{
+	const u64 args[] = { cxl_mem_id, freeze_restore };
+
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_capture_freeze_and_restore_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_OPCODE 50960
+#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_PAYLOAD_IN_SIZE 2
+#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_PAYLOAD_OUT_SIZE 4
+
+static const struct cxl_vendor_field ltmon_l2r_count_dump_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+};
+
+static const struct cxl_vendor_field ltmon_l2r_count_dump_out_fields[] = {
+	{ .name = "Dump Count", .offset = 0x00, .width = 4 },
+};
+
+static const struct cxl_vendor_cmd ltmon_l2r_count_dump_cmd = {
+	.title = "ltmon l2r count dump",
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_PAYLOAD_IN_SIZE,
+	.in = ltmon_l2r_count_dump_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_l2r_count_dump_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_DUMP_PAYLOAD_OUT_SIZE,
+	.out = ltmon_l2r_count_dump_out_fields,
+	.nr_out = ARRAY_SIZE(ltmon_l2r_count_dump_out_fields),
+};
+
+CXL_EXPORT int cxl_memdev_ltmon_l2r_count_dump(struct cxl_memdev *memdev,
+	u8 cxl_mem_id)
+{
+	const u64 args[] = { cxl_mem_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_l2r_count_dump_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR_OPCODE 50961
+#define CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR_PAYLOAD_IN_SIZE 2
+
+static const struct cxl_vendor_field ltmon_l2r_count_clear_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd ltmon_l2r_count_clear_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_L2R_COUNT_CLEAR_PAYLOAD_IN_SIZE,
+	.in = ltmon_l2r_count_clear_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_l2r_count_clear_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_ltmon_l2r_count_clear(struct cxl_memdev *memdev,
+	u8 cxl_mem_id)
+{
+	const u64 args[] = { cxl_mem_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_l2r_count_clear_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG_OPCODE 50962
+#define CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG_PAYLOAD_IN_SIZE 4
+
+static const struct cxl_vendor_field ltmon_basic_cfg_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+	{ .offset = 0x03, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd ltmon_basic_cfg_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_BASIC_CFG_PAYLOAD_IN_SIZE,
+	.in = ltmon_basic_cfg_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_basic_cfg_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_ltmon_basic_cfg(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u8 tick_cnt, u8 global_ts)
+{
+	const u64 args[] = { cxl_mem_id, tick_cnt, global_ts };
+
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_basic_cfg_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_LTMON_WATCH CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_WATCH_OPCODE 50963
+#define CXL_MEM_COMMAND_ID_LTMON_WATCH_PAYLOAD_IN_SIZE 12
+
+static const struct cxl_vendor_field ltmon_watch_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+	{ .offset = 0x03, .width = 1 },
+	{ .offset = 0x04, .width = 1 },
+	{ .offset = 0x05, .width = 1 },
+	{ .offset = 0x06, .width = 1 },
+	{ .offset = 0x07, .width = 1 },
+	{ .offset = 0x08, .width = 1 },
+	{ .offset = 0x09, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd ltmon_watch_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_WATCH_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_WATCH_PAYLOAD_IN_SIZE,
+	.in = ltmon_watch_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_watch_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_ltmon_watch(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u8 watch_id, u8 watch_mode, u8 src_maj_st, u8 src_min_st,
+	u8 src_l0_st, u8 dst_maj_st, u8 dst_min_st, u8 dst_l0_st)
+{
+	const u64 args[] = { cxl_mem_id, watch_id, watch_mode, src_maj_st,
+		src_min_st, src_l0_st, dst_maj_st, dst_min_st, dst_l0_st };
+
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_watch_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_OPCODE 50964
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_PAYLOAD_IN_SIZE 2
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_PAYLOAD_OUT_SIZE 12
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_LTMON_ENABLE) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_LTMON_ENABLE);
-		return -EINVAL;
-	}
+static const struct cxl_vendor_field ltmon_capture_stat_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+};
 
+static const struct cxl_vendor_field ltmon_capture_stat_out_fields[] = {
+	{ .name = "Trigger Count", .offset = 0x00, .width = 2 },
+	{ .name = "Watch 0 Trigger Count", .offset = 0x02, .width = 2 },
+	{ .name = "Watch 1 Trigger Count", .offset = 0x04, .width = 2 },
+	{ .name = "Time Stamp", .offset = 0x06, .width = 2 },
+	{ .name = "Trigger Source Status", .offset = 0x08, .width = 1 },
+};
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
-}
+static const struct cxl_vendor_cmd ltmon_capture_stat_cmd = {
+	.title = "ltmon capture status",
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_PAYLOAD_IN_SIZE,
+	.in = ltmon_capture_stat_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_capture_stat_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_PAYLOAD_OUT_SIZE,
+	.out = ltmon_capture_stat_out_fields,
+	.nr_out = ARRAY_SIZE(ltmon_capture_stat_out_fields),
+};
 
+CXL_EXPORT int cxl_memdev_ltmon_capture_stat(struct cxl_memdev *memdev,
+	u8 cxl_mem_id)
+{
+	const u64 args[] = { cxl_mem_id };
 
-#define CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG_OPCODE 51200
-#define CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG_PAYLOAD_IN_SIZE 12
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_capture_stat_cmd, args);
+}
 
-struct cxl_mbox_osa_os_type_trig_cfg_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	__le16 rsvd2;
-	__le16 lane_mask;
-	u8 lane_dir_mask;
-	u8 rate_mask;
-	__le16 os_type_mask;
-	__le16 rsvd10;
+struct cxl_mbox_ltmon_capture_stat_out {
+	__le16 trig_cnt;
+	__le16 watch0_trig_cnt;
+	__le16 watch1_trig_cnt;
+	__le16 time_stamp;
+	u8 trig_src_stat;
+	u8 rsvd[3];
 }  __attribute__((packed));
 
-
-CXL_EXPORT int cxl_memdev_osa_os_type_trig_cfg(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u16 lane_mask, u8 lane_dir_mask, u8 rate_mask, u16 os_type_mask)
+/* capture status whose results are read back via the getters below */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_ltmon_capture_stat(struct cxl_memdev *memdev,
+		u8 cxl_mem_id)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_osa_os_type_trig_cfg_in *osa_os_type_trig_cfg_in;
-	int rc = 0;
+	u8 *in;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_OPCODE,
+			CXL_MEM_COMMAND_ID_LTMON_CAPTURE_STAT_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+	in = cmd->input_payload;
+	in[1] = cxl_mem_id;
+	return cmd;
+}
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+CXL_EXPORT int cxl_cmd_ltmon_capture_stat_get_trig_cnt(struct cxl_cmd *cmd)
+{
+	cmd_vendor_get_int(cmd, ltmon_capture_stat, LTMON_CAPTURE_STAT, 16,
+			trig_cnt);
+}
 
-	osa_os_type_trig_cfg_in = (void *) cmd->send_cmd->in.payload;
+CXL_EXPORT int cxl_cmd_ltmon_capture_stat_get_time_stamp(struct cxl_cmd *cmd)
+{
+	cmd_vendor_get_int(cmd, ltmon_capture_stat, LTMON_CAPTURE_STAT, 16,
+			time_stamp);
+}
 
-	osa_os_type_trig_cfg_in->cxl_mem_id = cxl_mem_id;
-	osa_os_type_trig_cfg_in->lane_mask = cpu_to_le16(lane_mask);
-	osa_os_type_trig_cfg_in->lane_dir_mask = lane_dir_mask;
-	osa_os_type_trig_cfg_in->rate_mask = rate_mask;
-	osa_os_type_trig_cfg_in->os_type_mask = cpu_to_le16(os_type_mask);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_OPCODE 50965
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_PAYLOAD_IN_SIZE 8
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_PAYLOAD_OUT_SIZE 16
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG);
-		return -EINVAL;
-	}
+static const struct cxl_vendor_field ltmon_capture_log_dmp_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 2 },
+	{ .offset = 0x04, .width = 2 },
+};
 
+static const struct cxl_vendor_field ltmon_capture_log_dmp_out_fields[] = {
+	{ .name = "LTMON Data", .mn = "data", .offset = 0x00, .width = 8,
+	  .count = 2 },
+};
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
-}
+static const struct cxl_vendor_cmd ltmon_capture_log_dmp_cmd = {
+	.title = "ltmon capture log dump",
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_PAYLOAD_IN_SIZE,
+	.in = ltmon_capture_log_dmp_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_capture_log_dmp_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_PAYLOAD_OUT_SIZE,
+	.out = ltmon_capture_log_dmp_out_fields,
+	.nr_out = ARRAY_SIZE(ltmon_capture_log_dmp_out_fields),
+};
 
+CXL_EXPORT int cxl_memdev_ltmon_capture_log_dmp(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u16 dump_idx, u16 dump_cnt)
+{
+	const u64 args[] = { cxl_mem_id, dump_idx, dump_cnt };
 
-#define CXL_MEM_COMMAND_ID_OSA_CAP_CTRL CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_OSA_CAP_CTRL_OPCODE 51203
-#define CXL_MEM_COMMAND_ID_OSA_CAP_CTRL_PAYLOAD_IN_SIZE 16
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_capture_log_dmp_cmd, args);
+}
 
-struct cxl_mbox_osa_cap_ctrl_in {
+struct cxl_mbox_ltmon_capture_log_dmp_in {
 	u8 rsvd;
 	u8 cxl_mem_id;
+	__le16 dump_idx;
+	__le16 dump_cnt;
 	__le16 rsvd2;
-	__le16 lane_mask;
-	u8 lane_dir_mask;
-	u8 drop_single_os;
-	u8 stop_mode;
-	u8 snapshot_mode;
-	__le16 post_trig_num;
-	__le16 os_type_mask;
-	__le16 rsvd14;
 }  __attribute__((packed));
 
-
-CXL_EXPORT int cxl_memdev_osa_cap_ctrl(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u16 lane_mask, u8 lane_dir_mask, u8 drop_single_os,
-	u8 stop_mode, u8 snapshot_mode, u16 post_trig_num, u16 os_type_mask)
+/*
+ * Reusable log dump for callers that walk the whole capture log: pick
+ * the next window with cxl_cmd_ltmon_capture_log_dmp_set_range() and
+ * resubmit.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_ltmon_capture_log_dmp(struct cxl_memdev *memdev,
+		u8 cxl_mem_id)
 {
+	struct cxl_mbox_ltmon_capture_log_dmp_in *in;
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_osa_cap_ctrl_in *osa_cap_ctrl_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_OSA_CAP_CTRL_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_OPCODE,
+			CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_CAP_CTRL_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	in = cmd->input_payload;
+	in->cxl_mem_id = cxl_mem_id;
+	return cmd;
+}
 
-	osa_cap_ctrl_in = (void *) cmd->send_cmd->in.payload;
+CXL_EXPORT int cxl_cmd_ltmon_capture_log_dmp_set_range(struct cxl_cmd *cmd,
+		u16 dump_idx, u16 dump_cnt)
+{
+	struct cxl_mbox_ltmon_capture_log_dmp_in *in = cmd->input_payload;
 
-	osa_cap_ctrl_in->cxl_mem_id = cxl_mem_id;
-	osa_cap_ctrl_in->lane_mask = cpu_to_le16(lane_mask);
-	osa_cap_ctrl_in->lane_dir_mask = lane_dir_mask;
-	osa_cap_ctrl_in->drop_single_os = drop_single_os;
-	osa_cap_ctrl_in->stop_mode = stop_mode;
-	osa_cap_ctrl_in->snapshot_mode = snapshot_mode;
-	osa_cap_ctrl_in->post_trig_num = cpu_to_le16(post_trig_num);
-	osa_cap_ctrl_in->os_type_mask = cpu_to_le16(os_type_mask);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+	if (cxl_cmd_get_opcode(cmd) != CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_OPCODE)
+		return -EINVAL;
+	in->dump_idx = cpu_to_le16(dump_idx);
+	in->dump_cnt = cpu_to_le16(dump_cnt);
+	return 0;
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+/*
+ * Number of 64-bit log entries returned: the requested count, clamped
+ * to what the output payload holds. *@entries points at them in device
+ * (little endian) order and stays valid until the command is
+ * resubmitted or freed.
+ */
+CXL_EXPORT int cxl_cmd_ltmon_capture_log_dmp_get_entries(struct cxl_cmd *cmd,
+		const u64 **entries)
+{
+	struct cxl_mbox_ltmon_capture_log_dmp_in *in = cmd->input_payload;
+	void *out;
+	int max;
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_OSA_CAP_CTRL) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_OSA_CAP_CTRL);
+	out = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_LTMON_CAPTURE_LOG_DMP_OPCODE, 0);
+	if (!out)
 		return -EINVAL;
-	}
-
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	max = cmd->send_cmd->out.size / sizeof(u64);
+	*entries = out;
+	return min(le16_to_cpu(in->dump_cnt), max);
 }
 
 
-#define CXL_MEM_COMMAND_ID_OSA_CFG_DUMP CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_OPCODE 51204
-#define CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_PAYLOAD_IN_SIZE 4
-#define CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_PAYLOAD_OUT_SIZE 60
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER_OPCODE 50966
+#define CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER_PAYLOAD_IN_SIZE 4
 
-struct cxl_mbox_osa_cfg_dump_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	__le16 rsvd2;
-}  __attribute__((packed));
+static const struct cxl_vendor_field ltmon_capture_trigger_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+};
 
-struct cxl_mbox_osa_cfg_dump_out {
-	__le16 os_type_trig_cfg_lane_mask;
-	u8 os_type_trig_cfg_lane_dir_mask;
-	u8 os_type_trig_cfg_rate_mask;
-	__le16 os_type_trig_cfg_os_type_mask;
-	__le16 rsvd;
-	__le16 os_patt_trig_cfg_lane_mask;
-	u8 os_patt_trig_cfg_lane_dir_mask;
-	u8 os_patt_trig_cfg_rate_mask;
-	__le32 os_patt_trig_cfg_val[4];
-	__le32 os_patt_trig_cfg_mask[4];
-	u8 misc_trig_cfg_trig_en_mask;
-	u8 rsvd45[3];
-	__le16 cap_ctrl_lane_mask;
-	u8 cap_ctrl_lane_dir_mask;
-	u8 cap_ctrl_drop_single_os;
-	u8 cap_ctrl_stop_mode;
-	u8 cap_ctrl_snapshot_mode;
-	__le16 cap_ctrl_post_trig_num;
-	__le16 cap_ctrl_os_type_mask;
-	__le16 rsvd58;
-}  __attribute__((packed));
+static const struct cxl_vendor_cmd ltmon_capture_trigger_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_CAPTURE_TRIGGER_PAYLOAD_IN_SIZE,
+	.in = ltmon_capture_trigger_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_capture_trigger_in_fields),
+};
 
-CXL_EXPORT int cxl_memdev_osa_cfg_dump(struct cxl_memdev *memdev,
-	u8 cxl_mem_id)
+CXL_EXPORT int cxl_memdev_ltmon_capture_trigger(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u8 trig_src)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_osa_cfg_dump_in *osa_cfg_dump_in;
-	struct cxl_mbox_osa_cfg_dump_out *osa_cfg_dump_out;
-	int rc = 0;
+	const u64 args[] = { cxl_mem_id, trig_src };
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_capture_trigger_cmd, args);
+}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+#define CXL_MEM_COMMAND_ID_LTMON_ENABLE CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_LTMON_ENABLE_OPCODE 51072
+#define CXL_MEM_COMMAND_ID_LTMON_ENABLE_PAYLOAD_IN_SIZE 4
 
-	osa_cfg_dump_in = (void *) cmd->send_cmd->in.payload;
+static const struct cxl_vendor_field ltmon_enable_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+};
 
-	osa_cfg_dump_in->cxl_mem_id = cxl_mem_id;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+static const struct cxl_vendor_cmd ltmon_enable_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_LTMON_ENABLE_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_LTMON_ENABLE_PAYLOAD_IN_SIZE,
+	.in = ltmon_enable_in_fields,
+	.nr_in = ARRAY_SIZE(ltmon_enable_in_fields),
+};
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+CXL_EXPORT int cxl_memdev_ltmon_enable(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u8 enable)
+{
+	const u64 args[] = { cxl_mem_id, enable };
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_OSA_CFG_DUMP) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_OSA_CFG_DUMP);
-		return -EINVAL;
-	}
+	return cxl_memdev_vendor_cmd(memdev, &ltmon_enable_cmd, args);
+}
 
-	osa_cfg_dump_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "============================ osa configuration dump ============================\n");
-	fprintf(stdout, "OS type triggering - lane mask: %x\n", le16_to_cpu(osa_cfg_dump_out->os_type_trig_cfg_lane_mask));
-	fprintf(stdout, "OS type triggering - lane direction mask (see OSA_LANE_DIR_BITMSK_*): %x\n", osa_cfg_dump_out->os_type_trig_cfg_lane_dir_mask);
-	fprintf(stdout, "OS type triggering - link rate mask (see OSA_LINK_RATE_BITMSK_*): %x\n", osa_cfg_dump_out->os_type_trig_cfg_rate_mask);
-	fprintf(stdout, "OS type triggering - OS type mask (see OSA_OS_TYPE_TRIG_BITMSK_*): %x\n", le16_to_cpu(osa_cfg_dump_out->os_type_trig_cfg_os_type_mask));
-	fprintf(stdout, "OS pattern triggering - lane mask: %x\n", le16_to_cpu(osa_cfg_dump_out->os_patt_trig_cfg_lane_mask));
-	fprintf(stdout, "OS pattern triggering - lane direction mask (see OSA_LANE_DIR_BITMSK_*): %x\n", osa_cfg_dump_out->os_patt_trig_cfg_lane_dir_mask);
-	fprintf(stdout, "OS pattern triggering - link rate mask (see OSA_LINK_RATE_BITMSK_*): %x\n", osa_cfg_dump_out->os_patt_trig_cfg_rate_mask);
-	fprintf(stdout, "OS pattern triggering - pattern match value: ");
-	/* Procedurally generated print statement. To print this array contiguously,
-	   add "contiguous: True" to the YAML param and rerun cligen.py */
-	for (int i = 0; i < 4; i++) {
-		fprintf(stdout, "os_patt_trig_cfg_val[%d]: %x\n", i, le32_to_cpu(osa_cfg_dump_out->os_patt_trig_cfg_val[i]));
-	}
-	fprintf(stdout, "\n");
-	fprintf(stdout, "OS pattern triggering - pattern match mask: ");
-	/* Procedurally generated print statement. To print this array contiguously,
-	   add "contiguous: True" to the YAML param and rerun cligen.py */
-	for (int i = 0; i < 4; i++) {
-		fprintf(stdout, "os_patt_trig_cfg_mask[%d]: %x\n", i, le32_to_cpu(osa_cfg_dump_out->os_patt_trig_cfg_mask[i]));
-	}
-	fprintf(stdout, "\n");
-	fprintf(stdout, "miscellaneous triggering: %x\n", osa_cfg_dump_out->misc_trig_cfg_trig_en_mask);
-	fprintf(stdout, "capture control - lane mask: %x\n", le16_to_cpu(osa_cfg_dump_out->cap_ctrl_lane_mask));
-	fprintf(stdout, "capture control - lane direction mask (see OSA_LANE_DIR_BITMSK_*): %x\n", osa_cfg_dump_out->cap_ctrl_lane_dir_mask);
-	fprintf(stdout, "capture control - drop single OS's (TS1/TS2/FTS/CTL_SKP): %x\n", osa_cfg_dump_out->cap_ctrl_drop_single_os);
-	fprintf(stdout, "capture control - capture stop mode: %x\n", osa_cfg_dump_out->cap_ctrl_stop_mode);
-	fprintf(stdout, "capture control - snapshot mode enable: %x\n", osa_cfg_dump_out->cap_ctrl_snapshot_mode);
-	fprintf(stdout, "capture control: %x\n", le16_to_cpu(osa_cfg_dump_out->cap_ctrl_post_trig_num));
-	fprintf(stdout, "capture control - OS type mask (see OSA_OS_TYPE_CAP_BITMSK_*): %x\n", le16_to_cpu(osa_cfg_dump_out->cap_ctrl_os_type_mask));
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+#define CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG_OPCODE 51200
+#define CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG_PAYLOAD_IN_SIZE 12
+
+static const struct cxl_vendor_field osa_os_type_trig_cfg_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x04, .width = 2 },
+	{ .offset = 0x06, .width = 1 },
+	{ .offset = 0x07, .width = 1 },
+	{ .offset = 0x08, .width = 2 },
+};
+
+static const struct cxl_vendor_cmd osa_os_type_trig_cfg_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_OSA_OS_TYPE_TRIG_CFG_PAYLOAD_IN_SIZE,
+	.in = osa_os_type_trig_cfg_in_fields,
+	.nr_in = ARRAY_SIZE(osa_os_type_trig_cfg_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_osa_os_type_trig_cfg(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u16 lane_mask, u8 lane_dir_mask, u8 rate_mask, u16 os_type_mask)
+{
+	const u64 args[] = { cxl_mem_id, lane_mask, lane_dir_mask, rate_mask,
+		os_type_mask };
+
+	return cxl_memdev_vendor_cmd(memdev, &osa_os_type_trig_cfg_cmd, args);
 }
 
 
-#define CXL_MEM_COMMAND_ID_OSA_ANA_OP CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_OSA_ANA_OP_OPCODE 51205
-#define CXL_MEM_COMMAND_ID_OSA_ANA_OP_PAYLOAD_IN_SIZE 4
+#define CXL_MEM_COMMAND_ID_OSA_CAP_CTRL CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_OSA_CAP_CTRL_OPCODE 51203
+#define CXL_MEM_COMMAND_ID_OSA_CAP_CTRL_PAYLOAD_IN_SIZE 16
 
-struct cxl_mbox_osa_ana_op_in {
+struct cxl_mbox_osa_cap_ctrl_in {
 	u8 rsvd;
 	u8 cxl_mem_id;
-	u8 op;
-	u8 rsvd3;
+	__le16 rsvd2;
+	__le16 lane_mask;
+	u8 lane_dir_mask;
+	u8 drop_single_os;
+	u8 stop_mode;
+	u8 snapshot_mode;
+	__le16 post_trig_num;
+	__le16 os_type_mask;
+	__le16 rsvd14;
 }  __attribute__((packed));
 
 
-CXL_EXPORT int cxl_memdev_osa_ana_op(struct cxl_memdev *memdev,
-	u8 cxl_mem_id, u8 op)
+CXL_EXPORT int cxl_memdev_osa_cap_ctrl(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u16 lane_mask, u8 lane_dir_mask, u8 drop_single_os,
+	u8 stop_mode, u8 snapshot_mode, u16 post_trig_num, u16 os_type_mask)
 {
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
 	struct cxl_command_info *cinfo;
-	struct cxl_mbox_osa_ana_op_in *osa_ana_op_in;
+	struct cxl_mbox_osa_cap_ctrl_in *osa_cap_ctrl_in;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_OSA_ANA_OP_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_OSA_CAP_CTRL_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
@@ -4161,19 +7529,25 @@ CXL_EXPORT int cxl_memdev_osa_ana_op(struct cxl_memdev *memdev,
 	cinfo = &query->commands[cmd->query_idx];
 
 	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_ANA_OP_PAYLOAD_IN_SIZE;
+	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_CAP_CTRL_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
 		cmd->send_cmd->in.size = cinfo->size_in;
 	}
 
-	osa_ana_op_in = (void *) cmd->send_cmd->in.payload;
+	osa_cap_ctrl_in = (void *) cmd->send_cmd->in.payload;
 
-	osa_ana_op_in->cxl_mem_id = cxl_mem_id;
-	osa_ana_op_in->op = op;
+	osa_cap_ctrl_in->cxl_mem_id = cxl_mem_id;
+	osa_cap_ctrl_in->lane_mask = cpu_to_le16(lane_mask);
+	osa_cap_ctrl_in->lane_dir_mask = lane_dir_mask;
+	osa_cap_ctrl_in->drop_single_os = drop_single_os;
+	osa_cap_ctrl_in->stop_mode = stop_mode;
+	osa_cap_ctrl_in->snapshot_mode = snapshot_mode;
+	osa_cap_ctrl_in->post_trig_num = cpu_to_le16(post_trig_num);
+	osa_cap_ctrl_in->os_type_mask = cpu_to_le16(os_type_mask);
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -4189,9 +7563,9 @@ CXL_EXPORT int cxl_memdev_osa_ana_op(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_OSA_ANA_OP) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_OSA_CAP_CTRL) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_OSA_ANA_OP);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_OSA_CAP_CTRL);
 		return -EINVAL;
 	}
 
@@ -4203,91 +7577,202 @@ out:
 }
 
 
+#define CXL_MEM_COMMAND_ID_OSA_CFG_DUMP CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_OPCODE 51204
+#define CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_PAYLOAD_IN_SIZE 4
+#define CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_PAYLOAD_OUT_SIZE 60
+
+static const struct cxl_vendor_field osa_cfg_dump_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+};
+
+static const struct cxl_vendor_field osa_cfg_dump_out_fields[] = {
+	{ .name = "OS type triggering - lane mask", .offset = 0x00,
+	  .width = 2 },
+	{ .name = "OS type triggering - lane direction mask (see OSA_LANE_DIR_BITMSK_*)",
+	  .offset = 0x02, .width = 1 },
+	{ .name = "OS type triggering - link rate mask (see OSA_LINK_RATE_BITMSK_*)",
+	  .offset = 0x03, .width = 1 },
+	{ .name = "OS type triggering - OS type mask (see OSA_OS_TYPE_TRIG_BITMSK_*)",
+	  .offset = 0x04, .width = 2 },
+	{ .name = "OS pattern triggering - lane mask", .offset = 0x08,
+	  .width = 2 },
+	{ .name = "OS pattern triggering - lane direction mask (see OSA_LANE_DIR_BITMSK_*)",
+	  .offset = 0x0a, .width = 1 },
+	{ .name = "OS pattern triggering - link rate mask (see OSA_LINK_RATE_BITMSK_*)",
+	  .offset = 0x0b, .width = 1 },
+	{ .name = "OS pattern triggering - pattern match value",
+	  .mn = "os_patt_trig_cfg_val", .offset = 0x0c, .width = 4,
+	  .count = 4 },
+	{ .name = "OS pattern triggering - pattern match mask",
+	  .mn = "os_patt_trig_cfg_mask", .offset = 0x1c, .width = 4,
+	  .count = 4 },
+	{ .name = "miscellaneous triggering", .offset = 0x2c, .width = 1 },
+	{ .name = "capture control - lane mask", .offset = 0x30, .width = 2 },
+	{ .name = "capture control - lane direction mask (see OSA_LANE_DIR_BITMSK_*)",
+	  .offset = 0x32, .width = 1 },
+	{ .name = "capture control - drop single OS's (TS1/TS2/FTS/CTL_SKP)",
+	  .offset = 0x33, .width = 1 },
+	{ .name = "capture control - capture stop mode", .offset = 0x34,
+	  .width = 1 },
+	{ .name = "capture control - snapshot mode enable", .offset = 0x35,
+	  .width = 1 },
+	{ .name = "capture control", .offset = 0x36, .width = 2 },
+	{ .name = "capture control - OS type mask (see OSA_OS_TYPE_CAP_BITMSK_*)",
+	  .offset = 0x38, .width = 2 },
+};
+
+static const struct cxl_vendor_cmd osa_cfg_dump_cmd = {
+	.title = "osa configuration dump",
+	.opcode = CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_PAYLOAD_IN_SIZE,
+	.in = osa_cfg_dump_in_fields,
+	.nr_in = ARRAY_SIZE(osa_cfg_dump_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_OSA_CFG_DUMP_PAYLOAD_OUT_SIZE,
+	.out = osa_cfg_dump_out_fields,
+	.nr_out = ARRAY_SIZE(osa_cfg_dump_out_fields),
+};
+
+CXL_EXPORT int cxl_memdev_osa_cfg_dump(struct cxl_memdev *memdev,
+	u8 cxl_mem_id)
+{
+	const u64 args[] = { cxl_mem_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &osa_cfg_dump_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_OSA_ANA_OP CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_OSA_ANA_OP_OPCODE 51205
+#define CXL_MEM_COMMAND_ID_OSA_ANA_OP_PAYLOAD_IN_SIZE 4
+
+static const struct cxl_vendor_field osa_ana_op_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd osa_ana_op_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_OSA_ANA_OP_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_OSA_ANA_OP_PAYLOAD_IN_SIZE,
+	.in = osa_ana_op_in_fields,
+	.nr_in = ARRAY_SIZE(osa_ana_op_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_osa_ana_op(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u8 op)
+{
+	const u64 args[] = { cxl_mem_id, op };
+
+	return cxl_memdev_vendor_cmd(memdev, &osa_ana_op_cmd, args);
+}
+
+
 #define CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_OPCODE 51206
 #define CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_PAYLOAD_IN_SIZE 4
 #define CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_PAYLOAD_OUT_SIZE 8
 
-struct cxl_mbox_osa_status_query_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	__le16 rsvd2;
-}  __attribute__((packed));
+static const struct cxl_vendor_field osa_status_query_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+};
+
+static const struct cxl_vendor_field osa_status_query_out_fields[] = {
+	{ .name = "OSA state (see osa_state_enum)", .offset = 0x00,
+	  .width = 1 },
+	{ .name = "lane that caused the trigger", .offset = 0x01, .width = 1 },
+	{ .name = "direction of lane that caused the trigger (see osa_lane_dir_enum)",
+	  .offset = 0x02, .width = 1 },
+	{ .name = "trigger reason mask (see OSA_TRIG_REASON_BITMSK_*)",
+	  .offset = 0x04, .width = 2 },
+};
+
+static const struct cxl_vendor_cmd osa_status_query_cmd = {
+	.title = "osa status query",
+	.opcode = CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_PAYLOAD_IN_SIZE,
+	.in = osa_status_query_in_fields,
+	.nr_in = ARRAY_SIZE(osa_status_query_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_PAYLOAD_OUT_SIZE,
+	.out = osa_status_query_out_fields,
+	.nr_out = ARRAY_SIZE(osa_status_query_out_fields),
+};
+
+CXL_EXPORT int cxl_memdev_osa_status_query(struct cxl_memdev *memdev,
+	u8 cxl_mem_id)
+{
+	const u64 args[] = { cxl_mem_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &osa_status_query_cmd, args);
+}
 
 struct cxl_mbox_osa_status_query_out {
 	u8 state;
-	u8 lane_id;
-	u8 lane_dir;
+	u8 trig_lane;
+	u8 trig_lane_dir;
 	u8 rsvd;
 	__le16 trig_reason_mask;
-	__le16 rsvd6;
+	__le16 rsvd2;
 }  __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_osa_status_query(struct cxl_memdev *memdev,
-	u8 cxl_mem_id)
+/* status query whose results are read back via the getters below */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_osa_status_query(struct cxl_memdev *memdev,
+		u8 cxl_mem_id)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_osa_status_query_in *osa_status_query_in;
-	struct cxl_mbox_osa_status_query_out *osa_status_query_out;
-	int rc = 0;
+	u8 *in;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_OPCODE,
+			CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+	in = cmd->input_payload;
+	in[1] = cxl_mem_id;
+	return cmd;
+}
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+static struct cxl_mbox_osa_status_query_out *
+cxl_cmd_osa_status_query_out(struct cxl_cmd *cmd)
+{
+	return cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY_OPCODE,
+			sizeof(struct cxl_mbox_osa_status_query_out));
+}
 
-	osa_status_query_in = (void *) cmd->send_cmd->in.payload;
+CXL_EXPORT int cxl_cmd_osa_status_query_get_state(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_osa_status_query_out *out = cxl_cmd_osa_status_query_out(cmd);
 
-	osa_status_query_in->cxl_mem_id = cxl_mem_id;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+	if (!out)
+		return -EINVAL;
+	return out->state;
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+CXL_EXPORT int cxl_cmd_osa_status_query_get_trig_lane(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_osa_status_query_out *out = cxl_cmd_osa_status_query_out(cmd);
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_OSA_STATUS_QUERY);
+	if (!out)
 		return -EINVAL;
-	}
+	return out->trig_lane;
+}
+
+CXL_EXPORT int cxl_cmd_osa_status_query_get_trig_lane_dir(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_osa_status_query_out *out = cxl_cmd_osa_status_query_out(cmd);
 
-	osa_status_query_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "=============================== osa status query ===============================\n");
-	fprintf(stdout, "OSA state (see osa_state_enum): %x\n", osa_status_query_out->state);
-	fprintf(stdout, "lane that caused the trigger: %x\n", osa_status_query_out->lane_id);
-	fprintf(stdout, "direction of lane that caused the trigger (see osa_lane_dir_enum): %x\n", osa_status_query_out->lane_dir);
-	fprintf(stdout, "trigger reason mask (see OSA_TRIG_REASON_BITMSK_*): %x\n", le16_to_cpu(osa_status_query_out->trig_reason_mask));
+	if (!out)
+		return -EINVAL;
+	return out->trig_lane_dir;
+}
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+CXL_EXPORT int cxl_cmd_osa_status_query_get_trig_reason(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_osa_status_query_out *out = cxl_cmd_osa_status_query_out(cmd);
+
+	if (!out)
+		return -EINVAL;
+	return le16_to_cpu(out->trig_reason_mask);
 }
 
 
@@ -4295,71 +7780,23 @@ out:
 #define CXL_MEM_COMMAND_ID_OSA_ACCESS_REL_OPCODE 51208
 #define CXL_MEM_COMMAND_ID_OSA_ACCESS_REL_PAYLOAD_IN_SIZE 4
 
-struct cxl_mbox_osa_access_rel_in {
-	u8 rsvd;
-	u8 cxl_mem_id;
-	__le16 rsvd2;
-}  __attribute__((packed));
+static const struct cxl_vendor_field osa_access_rel_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+};
 
+static const struct cxl_vendor_cmd osa_access_rel_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_OSA_ACCESS_REL_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_OSA_ACCESS_REL_PAYLOAD_IN_SIZE,
+	.in = osa_access_rel_in_fields,
+	.nr_in = ARRAY_SIZE(osa_access_rel_in_fields),
+};
 
 CXL_EXPORT int cxl_memdev_osa_access_rel(struct cxl_memdev *memdev,
 	u8 cxl_mem_id)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_osa_access_rel_in *osa_access_rel_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_OSA_ACCESS_REL_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_ACCESS_REL_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	osa_access_rel_in = (void *) cmd->send_cmd->in.payload;
-
-	osa_access_rel_in->cxl_mem_id = cxl_mem_id;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_OSA_ACCESS_REL) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_OSA_ACCESS_REL);
-		return -EINVAL;
-	}
-
+	const u64 args[] = { cxl_mem_id };
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	return cxl_memdev_vendor_cmd(memdev, &osa_access_rel_cmd, args);
 }
 
 
@@ -4367,77 +7804,28 @@ out:
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_LTIF_SET_OPCODE 51712
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_LTIF_SET_PAYLOAD_IN_SIZE 20
 
-struct cxl_mbox_perfcnt_mta_ltif_set_in {
-	__le32 counter;
-	__le32 match_value;
-	__le32 opcode;
-	__le32 meta_field;
-	__le32 meta_value;
-}  __attribute__((packed));
+static const struct cxl_vendor_field perfcnt_mta_ltif_set_in_fields[] = {
+	{ .offset = 0x00, .width = 4 },
+	{ .offset = 0x04, .width = 4 },
+	{ .offset = 0x08, .width = 4 },
+	{ .offset = 0x0c, .width = 4 },
+	{ .offset = 0x10, .width = 4 },
+};
 
+static const struct cxl_vendor_cmd perfcnt_mta_ltif_set_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_PERFCNT_MTA_LTIF_SET_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_LTIF_SET_PAYLOAD_IN_SIZE,
+	.in = perfcnt_mta_ltif_set_in_fields,
+	.nr_in = ARRAY_SIZE(perfcnt_mta_ltif_set_in_fields),
+};
 
 CXL_EXPORT int cxl_memdev_perfcnt_mta_ltif_set(struct cxl_memdev *memdev,
 	u32 counter, u32 match_value, u32 opcode, u32 meta_field, u32 meta_value)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_perfcnt_mta_ltif_set_in *perfcnt_mta_ltif_set_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_PERFCNT_MTA_LTIF_SET_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_LTIF_SET_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	perfcnt_mta_ltif_set_in = (void *) cmd->send_cmd->in.payload;
-
-	perfcnt_mta_ltif_set_in->counter = cpu_to_le32(counter);
-	perfcnt_mta_ltif_set_in->match_value = cpu_to_le32(match_value);
-	perfcnt_mta_ltif_set_in->opcode = cpu_to_le32(opcode);
-	perfcnt_mta_ltif_set_in->meta_field = cpu_to_le32(meta_field);
-	perfcnt_mta_ltif_set_in->meta_value = cpu_to_le32(meta_value);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_PERFCNT_MTA_LTIF_SET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_PERFCNT_MTA_LTIF_SET);
-		return -EINVAL;
-	}
-
+	const u64 args[] = { counter, match_value, opcode, meta_field,
+		meta_value };
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	return cxl_memdev_vendor_cmd(memdev, &perfcnt_mta_ltif_set_cmd, args);
 }
 
 
@@ -4455,69 +7843,60 @@ struct cxl_mbox_perfcnt_mta_get_out {
 	__le64 counter;
 }  __attribute__((packed));
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_perfcnt_mta_get(
+		struct cxl_memdev *memdev, u8 type, u32 counter)
+{
+	struct cxl_mbox_perfcnt_mta_get_in *perfcnt_mta_get_in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_PERFCNT_MTA_GET_OPCODE,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_GET_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	perfcnt_mta_get_in = (void *) cmd->send_cmd->in.payload;
+	perfcnt_mta_get_in->type = type;
+	perfcnt_mta_get_in->counter = cpu_to_le32(counter);
+	return cmd;
+}
+
+CXL_EXPORT int cxl_cmd_perfcnt_mta_get_get_counter(struct cxl_cmd *cmd,
+		unsigned long long *counter)
+{
+	cmd_vendor_get_u64(cmd, perfcnt_mta_get, PERFCNT_MTA_GET, counter,
+			counter);
+}
+
 CXL_EXPORT int cxl_memdev_perfcnt_mta_get(struct cxl_memdev *memdev,
 	u8 type, u32 counter)
 {
+	unsigned long long value;
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_perfcnt_mta_get_in *perfcnt_mta_get_in;
-	struct cxl_mbox_perfcnt_mta_get_out *perfcnt_mta_get_out;
-	int rc = 0;
+	int rc;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_PERFCNT_MTA_GET_OPCODE);
+	cmd = cxl_cmd_new_perfcnt_mta_get(memdev, type, counter);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_GET_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	perfcnt_mta_get_in = (void *) cmd->send_cmd->in.payload;
-
-	perfcnt_mta_get_in->type = type;
-	perfcnt_mta_get_in->counter = cpu_to_le32(counter);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
+	rc = cxl_cmd_vendor_submit(cmd);
+	if (rc)
 		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_PERFCNT_MTA_GET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_PERFCNT_MTA_GET);
-		return -EINVAL;
-	}
 
-	perfcnt_mta_get_out = (void *)cmd->send_cmd->out.payload;
+	rc = cxl_cmd_perfcnt_mta_get_get_counter(cmd, &value);
+	if (rc)
+		goto out;
+	if (cxl_vendor_emit(memdev, "mta get performance counter", "Counter",
+				NULL, value, -1))
+		goto out;
 	fprintf(stdout, "========================= mta get performance counter ==========================\n");
-	fprintf(stdout, "Counter: %lx\n", le64_to_cpu(perfcnt_mta_get_out->counter));
+	fprintf(stdout, "Counter: %llx\n", value);
 
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
 
@@ -4526,78 +7905,65 @@ out:
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_PAYLOAD_IN_SIZE 5
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_PAYLOAD_OUT_SIZE 8
 
-struct cxl_mbox_perfcnt_mta_latch_val_get_in {
-	u8 type;
-	__le32 counter;
-}  __attribute__((packed));
+static const struct cxl_vendor_field perfcnt_mta_latch_val_get_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+	{ .offset = 0x01, .width = 4 },
+};
 
-struct cxl_mbox_perfcnt_mta_latch_val_get_out {
-	__le64 latch_val;
-}  __attribute__((packed));
+static const struct cxl_vendor_field perfcnt_mta_latch_val_get_out_fields[] = {
+	{ .name = "Latch value", .offset = 0x00, .width = 8 },
+};
+
+static const struct cxl_vendor_cmd perfcnt_mta_latch_val_get_cmd = {
+	.title = "mta get latch value",
+	.opcode = CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_PAYLOAD_IN_SIZE,
+	.in = perfcnt_mta_latch_val_get_in_fields,
+	.nr_in = ARRAY_SIZE(perfcnt_mta_latch_val_get_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_PAYLOAD_OUT_SIZE,
+	.out = perfcnt_mta_latch_val_get_out_fields,
+	.nr_out = ARRAY_SIZE(perfcnt_mta_latch_val_get_out_fields),
+};
 
 CXL_EXPORT int cxl_memdev_perfcnt_mta_latch_val_get(struct cxl_memdev *memdev,
 	u8 type, u32 counter)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_perfcnt_mta_latch_val_get_in *perfcnt_mta_latch_val_get_in;
-	struct cxl_mbox_perfcnt_mta_latch_val_get_out *perfcnt_mta_latch_val_get_out;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	const u64 args[] = { type, counter };
 
-	perfcnt_mta_latch_val_get_in = (void *) cmd->send_cmd->in.payload;
+	return cxl_memdev_vendor_cmd(memdev, &perfcnt_mta_latch_val_get_cmd, args);
+}
 
-	perfcnt_mta_latch_val_get_in->type = type;
-	perfcnt_mta_latch_val_get_in->counter = cpu_to_le32(counter);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+struct cxl_mbox_perfcnt_mta_latch_val_get_out {
+	__le64 latch_val;
+}  __attribute__((packed));
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+/*
+ * Silent counterpart of cxl_memdev_perfcnt_mta_latch_val_get() for
+ * samplers that read the same counter repeatedly.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_perfcnt_mta_latch_val_get(
+		struct cxl_memdev *memdev, u8 type, u32 counter)
+{
+	struct cxl_mbox_perfcnt_mta_get_in *in;
+	struct cxl_cmd *cmd;
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET);
-		return -EINVAL;
-	}
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_OPCODE,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_LATCH_VAL_GET_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
 
-	perfcnt_mta_latch_val_get_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "============================= mta get latch value ==============================\n");
-	fprintf(stdout, "Latch value: %lx\n", le64_to_cpu(perfcnt_mta_latch_val_get_out->latch_val));
+	in = cmd->input_payload;
+	in->type = type;
+	in->counter = cpu_to_le32(counter);
+	return cmd;
+}
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+CXL_EXPORT int cxl_cmd_perfcnt_mta_latch_val_get_get_latch_val(
+		struct cxl_cmd *cmd, unsigned long long *latch_val)
+{
+	cmd_vendor_get_u64(cmd, perfcnt_mta_latch_val_get,
+			PERFCNT_MTA_LATCH_VAL_GET, latch_val, latch_val);
 }
 
 
@@ -4605,71 +7971,24 @@ out:
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_COUNTER_CLEAR_OPCODE 51715
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_COUNTER_CLEAR_PAYLOAD_IN_SIZE 5
 
-struct cxl_mbox_perfcnt_mta_counter_clear_in {
-	u8 type;
-	__le32 counter;
-}  __attribute__((packed));
+static const struct cxl_vendor_field perfcnt_mta_counter_clear_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+	{ .offset = 0x01, .width = 4 },
+};
 
+static const struct cxl_vendor_cmd perfcnt_mta_counter_clear_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_PERFCNT_MTA_COUNTER_CLEAR_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_COUNTER_CLEAR_PAYLOAD_IN_SIZE,
+	.in = perfcnt_mta_counter_clear_in_fields,
+	.nr_in = ARRAY_SIZE(perfcnt_mta_counter_clear_in_fields),
+};
 
 CXL_EXPORT int cxl_memdev_perfcnt_mta_counter_clear(struct cxl_memdev *memdev,
 	u8 type, u32 counter)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_perfcnt_mta_counter_clear_in *perfcnt_mta_counter_clear_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_PERFCNT_MTA_COUNTER_CLEAR_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_COUNTER_CLEAR_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	perfcnt_mta_counter_clear_in = (void *) cmd->send_cmd->in.payload;
-
-	perfcnt_mta_counter_clear_in->type = type;
-	perfcnt_mta_counter_clear_in->counter = cpu_to_le32(counter);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_PERFCNT_MTA_COUNTER_CLEAR) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_PERFCNT_MTA_COUNTER_CLEAR);
-		return -EINVAL;
-	}
+	const u64 args[] = { type, counter };
 
-
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	return cxl_memdev_vendor_cmd(memdev, &perfcnt_mta_counter_clear_cmd, args);
 }
 
 
@@ -4677,149 +7996,70 @@ out:
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH_OPCODE 51716
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH_PAYLOAD_IN_SIZE 5
 
-struct cxl_mbox_perfcnt_mta_cnt_val_latch_in {
-	u8 type;
-	__le32 counter;
-}  __attribute__((packed));
+static const struct cxl_vendor_field perfcnt_mta_cnt_val_latch_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+	{ .offset = 0x01, .width = 4 },
+};
 
+static const struct cxl_vendor_cmd perfcnt_mta_cnt_val_latch_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH_PAYLOAD_IN_SIZE,
+	.in = perfcnt_mta_cnt_val_latch_in_fields,
+	.nr_in = ARRAY_SIZE(perfcnt_mta_cnt_val_latch_in_fields),
+};
 
 CXL_EXPORT int cxl_memdev_perfcnt_mta_cnt_val_latch(struct cxl_memdev *memdev,
 	u8 type, u32 counter)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_perfcnt_mta_cnt_val_latch_in *perfcnt_mta_cnt_val_latch_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	perfcnt_mta_cnt_val_latch_in = (void *) cmd->send_cmd->in.payload;
-
-	perfcnt_mta_cnt_val_latch_in->type = type;
-	perfcnt_mta_cnt_val_latch_in->counter = cpu_to_le32(counter);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH);
-		return -EINVAL;
-	}
-
+	const u64 args[] = { type, counter };
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	return cxl_memdev_vendor_cmd(memdev, &perfcnt_mta_cnt_val_latch_cmd, args);
 }
 
-
-#define CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET_OPCODE 51717
-#define CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET_PAYLOAD_IN_SIZE 20
-
-struct cxl_mbox_perfcnt_mta_hif_set_in {
-	__le32 counter;
-	__le32 match_value;
-	__le32 addr;
-	__le32 req_ty;
-	__le32 sc_ty;
-}  __attribute__((packed));
-
-
-CXL_EXPORT int cxl_memdev_perfcnt_mta_hif_set(struct cxl_memdev *memdev,
-	u32 counter, u32 match_value, u32 addr, u32 req_ty, u32 sc_ty)
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_perfcnt_mta_cnt_val_latch(
+		struct cxl_memdev *memdev, u8 type, u32 counter)
 {
+	struct cxl_mbox_perfcnt_mta_get_in *in;
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_perfcnt_mta_hif_set_in *perfcnt_mta_hif_set_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH_OPCODE,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_CNT_VAL_LATCH_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
 
-	perfcnt_mta_hif_set_in = (void *) cmd->send_cmd->in.payload;
+	in = cmd->input_payload;
+	in->type = type;
+	in->counter = cpu_to_le32(counter);
+	return cmd;
+}
 
-	perfcnt_mta_hif_set_in->counter = cpu_to_le32(counter);
-	perfcnt_mta_hif_set_in->match_value = cpu_to_le32(match_value);
-	perfcnt_mta_hif_set_in->addr = cpu_to_le32(addr);
-	perfcnt_mta_hif_set_in->req_ty = cpu_to_le32(req_ty);
-	perfcnt_mta_hif_set_in->sc_ty = cpu_to_le32(sc_ty);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+#define CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET_OPCODE 51717
+#define CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET_PAYLOAD_IN_SIZE 20
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET);
-		return -EINVAL;
-	}
+static const struct cxl_vendor_field perfcnt_mta_hif_set_in_fields[] = {
+	{ .offset = 0x00, .width = 4 },
+	{ .offset = 0x04, .width = 4 },
+	{ .offset = 0x08, .width = 4 },
+	{ .offset = 0x0c, .width = 4 },
+	{ .offset = 0x10, .width = 4 },
+};
 
+static const struct cxl_vendor_cmd perfcnt_mta_hif_set_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_SET_PAYLOAD_IN_SIZE,
+	.in = perfcnt_mta_hif_set_in_fields,
+	.nr_in = ARRAY_SIZE(perfcnt_mta_hif_set_in_fields),
+};
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+CXL_EXPORT int cxl_memdev_perfcnt_mta_hif_set(struct cxl_memdev *memdev,
+	u32 counter, u32 match_value, u32 addr, u32 req_ty, u32 sc_ty)
+{
+	const u64 args[] = { counter, match_value, addr, req_ty, sc_ty };
+
+	return cxl_memdev_vendor_cmd(memdev, &perfcnt_mta_hif_set_cmd, args);
 }
 
 
@@ -4859,7 +8099,7 @@ CXL_EXPORT int cxl_memdev_perfcnt_mta_hif_cfg_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_CFG_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -4937,7 +8177,7 @@ CXL_EXPORT int cxl_memdev_perfcnt_mta_hif_latch_val_get(struct cxl_memdev *memde
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_LATCH_VAL_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -4978,6 +8218,34 @@ out:
 	return 0;
 }
 
+/*
+ * Silent counterpart of cxl_memdev_perfcnt_mta_hif_latch_val_get() for
+ * samplers that read the same counter repeatedly.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_perfcnt_mta_hif_latch_val_get(
+		struct cxl_memdev *memdev, u32 counter)
+{
+	struct cxl_mbox_perfcnt_mta_hif_latch_val_get_in *in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_LATCH_VAL_GET_OPCODE,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_LATCH_VAL_GET_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	in = cmd->input_payload;
+	in->counter = cpu_to_le32(counter);
+	return cmd;
+}
+
+CXL_EXPORT int cxl_cmd_perfcnt_mta_hif_latch_val_get_get_latch_val(
+		struct cxl_cmd *cmd, unsigned long long *latch_val)
+{
+	cmd_vendor_get_u64(cmd, perfcnt_mta_hif_latch_val_get,
+			PERFCNT_MTA_HIF_LATCH_VAL_GET, latch_val, latch_val);
+}
+
 
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_COUNTER_CLEAR CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_COUNTER_CLEAR_OPCODE 51720
@@ -5010,7 +8278,7 @@ CXL_EXPORT int cxl_memdev_perfcnt_mta_hif_counter_clear(struct cxl_memdev *memde
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_COUNTER_CLEAR_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -5080,7 +8348,7 @@ CXL_EXPORT int cxl_memdev_perfcnt_mta_hif_cnt_val_latch(struct cxl_memdev *memde
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_CNT_VAL_LATCH_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -5118,6 +8386,23 @@ out:
 	return 0;
 }
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_perfcnt_mta_hif_cnt_val_latch(
+		struct cxl_memdev *memdev, u32 counter)
+{
+	struct cxl_mbox_perfcnt_mta_hif_cnt_val_latch_in *in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_CNT_VAL_LATCH_OPCODE,
+			CXL_MEM_COMMAND_ID_PERFCNT_MTA_HIF_CNT_VAL_LATCH_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	in = cmd->input_payload;
+	in->counter = cpu_to_le32(counter);
+	return cmd;
+}
+
 
 #define CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT_OPCODE 51728
@@ -5133,246 +8418,16 @@ struct cxl_mbox_perfcnt_ddr_generic_select_in {
 }  __attribute__((packed));
 
 
-CXL_EXPORT int cxl_memdev_perfcnt_ddr_generic_select(struct cxl_memdev *memdev,
-	u8 ddr_id, u8 cid, u8 rank, u8 bank, u8 bankgroup, u64 event)
-{
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_perfcnt_ddr_generic_select_in *perfcnt_ddr_generic_select_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	perfcnt_ddr_generic_select_in = (void *) cmd->send_cmd->in.payload;
-
-	perfcnt_ddr_generic_select_in->ddr_id = ddr_id;
-	perfcnt_ddr_generic_select_in->cid = cid;
-	perfcnt_ddr_generic_select_in->rank = rank;
-	perfcnt_ddr_generic_select_in->bank = bank;
-	perfcnt_ddr_generic_select_in->bankgroup = bankgroup;
-	perfcnt_ddr_generic_select_in->event = cpu_to_le64(event);
-
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT);
-		return -EINVAL;
-	}
-
-
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
-}
-
-
-#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON_OPCODE 51970
-#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON_PAYLOAD_IN_SIZE 6
-
-struct cxl_mbox_err_inj_drs_poison_in {
-	u8 ch_id;
-	u8 duration;
-	u8 inj_mode;
-	u8 rsvd;
-	__le16 tag;
-}  __attribute__((packed));
-
-
-CXL_EXPORT int cxl_memdev_err_inj_drs_poison(struct cxl_memdev *memdev,
-	u8 ch_id, u8 duration, u8 inj_mode, u16 tag)
-{
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_err_inj_drs_poison_in *err_inj_drs_poison_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	err_inj_drs_poison_in = (void *) cmd->send_cmd->in.payload;
-
-	err_inj_drs_poison_in->ch_id = ch_id;
-	err_inj_drs_poison_in->duration = duration;
-	err_inj_drs_poison_in->inj_mode = inj_mode;
-	err_inj_drs_poison_in->tag = cpu_to_le16(tag);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON);
-		return -EINVAL;
-	}
-
-
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
-}
-
-
-#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC_OPCODE 51971
-#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC_PAYLOAD_IN_SIZE 6
-
-struct cxl_mbox_err_inj_drs_ecc_in {
-	u8 ch_id;
-	u8 duration;
-	u8 inj_mode;
-	u8 rsvd;
-	__le16 tag;
-}  __attribute__((packed));
-
-
-CXL_EXPORT int cxl_memdev_err_inj_drs_ecc(struct cxl_memdev *memdev,
-	u8 ch_id, u8 duration, u8 inj_mode, u16 tag)
-{
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_err_inj_drs_ecc_in *err_inj_drs_ecc_in;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	err_inj_drs_ecc_in = (void *) cmd->send_cmd->in.payload;
-
-	err_inj_drs_ecc_in->ch_id = ch_id;
-	err_inj_drs_ecc_in->duration = duration;
-	err_inj_drs_ecc_in->inj_mode = inj_mode;
-	err_inj_drs_ecc_in->tag = cpu_to_le16(tag);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
-
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC);
-		return -EINVAL;
-	}
-
-
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
-}
-
-
-#define CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC_OPCODE 51972
-#define CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC_PAYLOAD_IN_SIZE 1
-
-struct cxl_mbox_err_inj_rxflit_crc_in {
-	u8 cxl_mem_id;
-}  __attribute__((packed));
-
-
-CXL_EXPORT int cxl_memdev_err_inj_rxflit_crc(struct cxl_memdev *memdev,
-	u8 cxl_mem_id)
+CXL_EXPORT int cxl_memdev_perfcnt_ddr_generic_select(struct cxl_memdev *memdev,
+	u8 ddr_id, u8 cid, u8 rank, u8 bank, u8 bankgroup, u64 event)
 {
 	struct cxl_cmd *cmd;
 	struct cxl_mem_query_commands *query;
 	struct cxl_command_info *cinfo;
-	struct cxl_mbox_err_inj_rxflit_crc_in *err_inj_rxflit_crc_in;
+	struct cxl_mbox_perfcnt_ddr_generic_select_in *perfcnt_ddr_generic_select_in;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
@@ -5383,18 +8438,24 @@ CXL_EXPORT int cxl_memdev_err_inj_rxflit_crc(struct cxl_memdev *memdev,
 	cinfo = &query->commands[cmd->query_idx];
 
 	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC_PAYLOAD_IN_SIZE;
+	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
 		cmd->send_cmd->in.size = cinfo->size_in;
 	}
 
-	err_inj_rxflit_crc_in = (void *) cmd->send_cmd->in.payload;
+	perfcnt_ddr_generic_select_in = (void *) cmd->send_cmd->in.payload;
+
+	perfcnt_ddr_generic_select_in->ddr_id = ddr_id;
+	perfcnt_ddr_generic_select_in->cid = cid;
+	perfcnt_ddr_generic_select_in->rank = rank;
+	perfcnt_ddr_generic_select_in->bank = bank;
+	perfcnt_ddr_generic_select_in->bankgroup = bankgroup;
+	perfcnt_ddr_generic_select_in->event = cpu_to_le64(event);
 
-	err_inj_rxflit_crc_in->cxl_mem_id = cxl_mem_id;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -5410,9 +8471,9 @@ CXL_EXPORT int cxl_memdev_err_inj_rxflit_crc(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_SELECT);
 		return -EINVAL;
 	}
 
@@ -5424,47 +8485,196 @@ out:
 }
 
 
+#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON_OPCODE 51970
+#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON_PAYLOAD_IN_SIZE 6
+
+static const struct cxl_vendor_field err_inj_drs_poison_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+	{ .offset = 0x04, .width = 2 },
+};
+
+static const struct cxl_vendor_cmd err_inj_drs_poison_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_ERR_INJ_DRS_POISON_PAYLOAD_IN_SIZE,
+	.in = err_inj_drs_poison_in_fields,
+	.nr_in = ARRAY_SIZE(err_inj_drs_poison_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_err_inj_drs_poison(struct cxl_memdev *memdev,
+	u8 ch_id, u8 duration, u8 inj_mode, u16 tag)
+{
+	const u64 args[] = { ch_id, duration, inj_mode, tag };
+
+	return cxl_memdev_vendor_cmd(memdev, &err_inj_drs_poison_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC_OPCODE 51971
+#define CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC_PAYLOAD_IN_SIZE 6
+
+static const struct cxl_vendor_field err_inj_drs_ecc_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x02, .width = 1 },
+	{ .offset = 0x04, .width = 2 },
+};
+
+static const struct cxl_vendor_cmd err_inj_drs_ecc_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_ERR_INJ_DRS_ECC_PAYLOAD_IN_SIZE,
+	.in = err_inj_drs_ecc_in_fields,
+	.nr_in = ARRAY_SIZE(err_inj_drs_ecc_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_err_inj_drs_ecc(struct cxl_memdev *memdev,
+	u8 ch_id, u8 duration, u8 inj_mode, u16 tag)
+{
+	const u64 args[] = { ch_id, duration, inj_mode, tag };
+
+	return cxl_memdev_vendor_cmd(memdev, &err_inj_drs_ecc_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC_OPCODE 51972
+#define CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC_PAYLOAD_IN_SIZE 1
+
+static const struct cxl_vendor_field err_inj_rxflit_crc_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd err_inj_rxflit_crc_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_ERR_INJ_RXFLIT_CRC_PAYLOAD_IN_SIZE,
+	.in = err_inj_rxflit_crc_in_fields,
+	.nr_in = ARRAY_SIZE(err_inj_rxflit_crc_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_err_inj_rxflit_crc(struct cxl_memdev *memdev,
+	u8 cxl_mem_id)
+{
+	const u64 args[] = { cxl_mem_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &err_inj_rxflit_crc_cmd, args);
+}
+
+
 #define CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC_OPCODE 51973
 #define CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC_PAYLOAD_IN_SIZE 1
 
-struct cxl_mbox_err_inj_txflit_crc_in {
-	u8 cxl_mem_id;
-}  __attribute__((packed));
+static const struct cxl_vendor_field err_inj_txflit_crc_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+};
 
+static const struct cxl_vendor_cmd err_inj_txflit_crc_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC_PAYLOAD_IN_SIZE,
+	.in = err_inj_txflit_crc_in_fields,
+	.nr_in = ARRAY_SIZE(err_inj_txflit_crc_in_fields),
+};
 
 CXL_EXPORT int cxl_memdev_err_inj_txflit_crc(struct cxl_memdev *memdev,
 	u8 cxl_mem_id)
+{
+	const u64 args[] = { cxl_mem_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &err_inj_txflit_crc_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL_OPCODE 51974
+#define CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL_PAYLOAD_IN_SIZE 1
+
+static const struct cxl_vendor_field err_inj_viral_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd err_inj_viral_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL_PAYLOAD_IN_SIZE,
+	.in = err_inj_viral_in_fields,
+	.nr_in = ARRAY_SIZE(err_inj_viral_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_err_inj_viral(struct cxl_memdev *memdev,
+	u8 ld_id)
+{
+	const u64 args[] = { ld_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &err_inj_viral_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN_OPCODE 52224
+#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN_PAYLOAD_IN_SIZE 8
+
+static const struct cxl_vendor_field eh_eye_cap_run_in_fields[] = {
+	{ .offset = 0x01, .width = 1 },
+	{ .offset = 0x04, .width = 4 },
+};
+
+static const struct cxl_vendor_cmd eh_eye_cap_run_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN_PAYLOAD_IN_SIZE,
+	.in = eh_eye_cap_run_in_fields,
+	.nr_in = ARRAY_SIZE(eh_eye_cap_run_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_eh_eye_cap_run(struct cxl_memdev *memdev,
+	u8 depth, u32 lane_mask)
+{
+	const u64 args[] = { depth, lane_mask };
+
+	return cxl_memdev_vendor_cmd(memdev, &eh_eye_cap_run_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_OPCODE 52226
+#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_IN_SIZE 4
+#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_OUT_SIZE 248
+
+struct cxl_mbox_eh_eye_cap_read_in {
+	u8 rsvd;
+	u8 lane_id;
+	u8 bin_num;
+	u8 rsvd3;
+}  __attribute__((packed));
+
+struct cxl_mbox_eh_eye_cap_read_out {
+	u8 num_phase;
+	u8 rsvd[7];
+	__le32 ber_data[60];
+}  __attribute__((packed));
+
+CXL_EXPORT int cxl_memdev_eh_eye_cap_read(struct cxl_memdev *memdev,
+	u8 lane_id, u8 bin_num)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_err_inj_txflit_crc_in *err_inj_txflit_crc_in;
+	struct cxl_mbox_eh_eye_cap_read_in *eh_eye_cap_read_in;
+	struct cxl_mbox_eh_eye_cap_read_out *eh_eye_cap_read_out;
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC_OPCODE);
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_OPCODE,
+			CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_IN_SIZE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
+	cxl_cmd_vendor_limit_out(cmd, CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_OUT_SIZE);
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	err_inj_txflit_crc_in = (void *) cmd->send_cmd->in.payload;
+	eh_eye_cap_read_in = (void *) cmd->send_cmd->in.payload;
 
-	err_inj_txflit_crc_in->cxl_mem_id = cxl_mem_id;
+	eh_eye_cap_read_in->lane_id = lane_id;
+	eh_eye_cap_read_in->bin_num = bin_num;
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -5480,12 +8690,23 @@ CXL_EXPORT int cxl_memdev_err_inj_txflit_crc(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_ERR_INJ_TXFLIT_CRC);
-		return -EINVAL;
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ);
+		rc = -EINVAL;
+		goto out;
 	}
 
+	eh_eye_cap_read_out = (void *)cmd->send_cmd->out.payload;
+	fprintf(stdout, "============================= eh eye capture read ==============================\n");
+	fprintf(stdout, "Total number of phases in ber_data: %x\n", eh_eye_cap_read_out->num_phase);
+	fprintf(stdout, "Per-phase bit error rates (multiplied by EYE_CAP_ERROR_CNT_MULT): ");
+	/* Procedurally generated print statement. To print this array contiguously,
+	   add "contiguous: True" to the YAML param and rerun cligen.py */
+	for (int i = 0; i < 60; i++) {
+		fprintf(stdout, "ber_data[%d]: %x\n", i, le32_to_cpu(eh_eye_cap_read_out->ber_data[i]));
+	}
+	fprintf(stdout, "\n");
 
 out:
 	cxl_cmd_unref(cmd);
@@ -5493,122 +8714,238 @@ out:
 	return 0;
 }
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_eh_eye_cap_read(
+		struct cxl_memdev *memdev, u8 lane_id, u8 bin_num)
+{
+	struct cxl_mbox_eh_eye_cap_read_in *eh_eye_cap_read_in;
+	struct cxl_cmd *cmd;
 
-#define CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL_OPCODE 51974
-#define CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL_PAYLOAD_IN_SIZE 1
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_OPCODE,
+			CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
 
-struct cxl_mbox_err_inj_viral_in {
-	u8 ld_id;
-}  __attribute__((packed));
+	cxl_cmd_vendor_limit_out(cmd,
+			CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_OUT_SIZE);
 
+	eh_eye_cap_read_in = cmd->input_payload;
+	eh_eye_cap_read_in->lane_id = lane_id;
+	eh_eye_cap_read_in->bin_num = bin_num;
+	return cmd;
+}
 
-CXL_EXPORT int cxl_memdev_err_inj_viral(struct cxl_memdev *memdev,
-	u8 ld_id)
+CXL_EXPORT int cxl_cmd_eh_eye_cap_read_set_bin(struct cxl_cmd *cmd,
+		u8 lane_id, u8 bin_num)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_err_inj_viral_in *err_inj_viral_in;
-	int rc = 0;
+	struct cxl_mbox_eh_eye_cap_read_in *eh_eye_cap_read_in = cmd->input_payload;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	if (cxl_cmd_get_opcode(cmd) != CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_OPCODE)
+		return -EINVAL;
+	eh_eye_cap_read_in->lane_id = lane_id;
+	eh_eye_cap_read_in->bin_num = bin_num;
+	return 0;
+}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+/*
+ * Number of valid phases, clamped to the size of ber_data[]. *@ber_data
+ * points at the little endian per-phase error counts and stays valid
+ * until the command is resubmitted or freed.
+ */
+CXL_EXPORT int cxl_cmd_eh_eye_cap_read_get_ber_data(struct cxl_cmd *cmd,
+		const u32 **ber_data)
+{
+	struct cxl_mbox_eh_eye_cap_read_out *out;
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	out = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_OPCODE, sizeof(*out));
+	if (!out)
+		return -EINVAL;
+	*ber_data = (const u32 *) out->ber_data;
+	return min_t(int, out->num_phase, ARRAY_SIZE(out->ber_data));
+}
 
-	err_inj_viral_in = (void *) cmd->send_cmd->in.payload;
 
-	err_inj_viral_in->ld_id = ld_id;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_GET CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_GET_OPCODE 52227
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_GET_PAYLOAD_IN_SIZE 4
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_GET_PAYLOAD_OUT_SIZE 28
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+static const struct cxl_vendor_field eh_adapt_get_in_fields[] = {
+	{ .offset = 0x00, .width = 4 },
+};
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_ERR_INJ_VIRAL);
-		return -EINVAL;
-	}
+static const struct cxl_vendor_field eh_adapt_get_out_fields[] = {
+	{ .name = "contain the current value of the object PGA_GAIN as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ",
+	  .offset = 0x00, .width = 1 },
+	{ .name = "PGA Stage2 DC offset correction", .offset = 0x01,
+	  .width = 1 },
+	{ .name = "PGA Stage1 DC offset correction", .offset = 0x02,
+	  .width = 1 },
+	{ .name = "I_TAP2<7:0> 2's compliment", .offset = 0x03, .width = 1 },
+	{ .name = "I_TAP3<6:0> 2's compliment", .offset = 0x04, .width = 1 },
+	{ .name = "I_TAP4<6:0> 2's compliment", .offset = 0x05, .width = 1 },
+	{ .name = "I_TAP5<6:0> 2's compliment", .offset = 0x06, .width = 1 },
+	{ .name = "I_TAP6<6:0> 2's compliment", .offset = 0x07, .width = 1 },
+	{ .name = "I_TAP7<6:0> 2's compliment", .offset = 0x08, .width = 1 },
+	{ .name = "I_TAP8<6:0> 2's compliment", .offset = 0x09, .width = 1 },
+	{ .name = "I_TAP9<5:0> 2's compliment", .offset = 0x0a, .width = 1 },
+	{ .name = "I_TAP10<5:0> 2's compliment", .offset = 0x0b, .width = 1 },
+	{ .name = "Zobel a_gain", .offset = 0x0c, .width = 1 },
+	{ .name = "zobel_b_gain", .offset = 0x0d, .width = 1 },
+	{ .name = "Zobel DC offset correction", .offset = 0x0e, .width = 2 },
+	{ .name = "contain the current value of the object UDFE_THR_0 as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ.",
+	  .offset = 0x10, .width = 2 },
+	{ .name = "contain the current value of the object UDFE_THR_1 as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ",
+	  .offset = 0x12, .width = 2 },
+	{ .name = "contain the current value of the object DC_OFFSET as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ",
+	  .offset = 0x14, .width = 2 },
+	{ .name = "contain the current value of the object PGA_GAIN as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ",
+	  .offset = 0x16, .width = 2 },
+	{ .name = "contain the current value of the object PH_OFS_T as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ",
+	  .offset = 0x18, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd eh_adapt_get_cmd = {
+	.title = "eh get adaptation data",
+	.opcode = CXL_MEM_COMMAND_ID_EH_ADAPT_GET_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_EH_ADAPT_GET_PAYLOAD_IN_SIZE,
+	.in = eh_adapt_get_in_fields,
+	.nr_in = ARRAY_SIZE(eh_adapt_get_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_EH_ADAPT_GET_PAYLOAD_OUT_SIZE,
+	.out = eh_adapt_get_out_fields,
+	.nr_out = ARRAY_SIZE(eh_adapt_get_out_fields),
+};
+
+CXL_EXPORT int cxl_memdev_eh_adapt_get(struct cxl_memdev *memdev,
+	u32 lane_id)
+{
+	const u64 args[] = { lane_id };
+
+	return cxl_memdev_vendor_cmd(memdev, &eh_adapt_get_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF_OPCODE 52228
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF_PAYLOAD_IN_SIZE 16
+
+static const struct cxl_vendor_field eh_adapt_oneoff_in_fields[] = {
+	{ .offset = 0x00, .width = 4 },
+	{ .offset = 0x04, .width = 4 },
+	{ .offset = 0x08, .width = 4 },
+	{ .offset = 0x0c, .width = 4 },
+};
+
+static const struct cxl_vendor_cmd eh_adapt_oneoff_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF_PAYLOAD_IN_SIZE,
+	.in = eh_adapt_oneoff_in_fields,
+	.nr_in = ARRAY_SIZE(eh_adapt_oneoff_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_eh_adapt_oneoff(struct cxl_memdev *memdev,
+	u32 lane_id, u32 preload, u32 loops, u32 objects)
+{
+	const u64 args[] = { lane_id, preload, loops, objects };
 
+	return cxl_memdev_vendor_cmd(memdev, &eh_adapt_oneoff_cmd, args);
+}
+
+
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE_OPCODE 52229
+#define CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE_PAYLOAD_IN_SIZE 40
+
+static const struct cxl_vendor_field eh_adapt_force_in_fields[] = {
+	{ .offset = 0x00, .width = 4 },
+	{ .offset = 0x04, .width = 4 },
+	{ .offset = 0x08, .width = 4 },
+	{ .offset = 0x0c, .width = 4 },
+	{ .offset = 0x10, .width = 1 },
+	{ .offset = 0x11, .width = 1 },
+	{ .offset = 0x12, .width = 1 },
+	{ .offset = 0x13, .width = 1 },
+	{ .offset = 0x14, .width = 1 },
+	{ .offset = 0x15, .width = 1 },
+	{ .offset = 0x16, .width = 1 },
+	{ .offset = 0x17, .width = 1 },
+	{ .offset = 0x18, .width = 1 },
+	{ .offset = 0x19, .width = 1 },
+	{ .offset = 0x1a, .width = 1 },
+	{ .offset = 0x1b, .width = 1 },
+	{ .offset = 0x1c, .width = 2 },
+	{ .offset = 0x1e, .width = 2 },
+	{ .offset = 0x20, .width = 2 },
+	{ .offset = 0x22, .width = 2 },
+	{ .offset = 0x24, .width = 2 },
+	{ .offset = 0x26, .width = 1 },
+	{ .offset = 0x27, .width = 1 },
+};
+
+static const struct cxl_vendor_cmd eh_adapt_force_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE_PAYLOAD_IN_SIZE,
+	.in = eh_adapt_force_in_fields,
+	.nr_in = ARRAY_SIZE(eh_adapt_force_in_fields),
+};
+
+CXL_EXPORT int cxl_memdev_eh_adapt_force(struct cxl_memdev *memdev,
+	u32 lane_id, u32 rate, u32 vdd_bias, u32 ssc, u8 pga_gain, u8 pga_a0,
+	u8 pga_off, u8 cdfe_a2, u8 cdfe_a3, u8 cdfe_a4, u8 cdfe_a5, u8 cdfe_a6,
+	u8 cdfe_a7, u8 cdfe_a8, u8 cdfe_a9, u8 cdfe_a10, u16 dc_offset,
+	u16 zobel_dc_offset, u16 udfe_thr_0, u16 udfe_thr_1, u16 median_amp,
+	u8 zobel_a_gain, u8 ph_ofs_t)
+{
+	const u64 args[] = { lane_id, rate, vdd_bias, ssc, pga_gain, pga_a0,
+		pga_off, cdfe_a2, cdfe_a3, cdfe_a4, cdfe_a5, cdfe_a6, cdfe_a7,
+		cdfe_a8, cdfe_a9, cdfe_a10, dc_offset, zobel_dc_offset,
+		udfe_thr_0, udfe_thr_1, median_amp, zobel_a_gain, ph_ofs_t };
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	return cxl_memdev_vendor_cmd(memdev, &eh_adapt_force_cmd, args);
 }
 
 
-#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN_OPCODE 52224
-#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN_PAYLOAD_IN_SIZE 8
+#define CXL_MEM_COMMAND_ID_HBO_STATUS CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_HBO_STATUS_OPCODE 52480
+#define CXL_MEM_COMMAND_ID_HBO_STATUS_PAYLOAD_OUT_SIZE 8
 
-struct cxl_mbox_eh_eye_cap_run_in {
-	u8 rsvd;
-	u8 depth;
-	__le16 rsvd2;
-	__le32 lane_mask;
+
+struct cxl_mbox_hbo_status_out {
+	__le64 bo_status;
 }  __attribute__((packed));
 
+struct hbo_status_fields {
+	u16 opcode;
+	u8 percent_complete;
+	u8 is_running;
+	u16 return_code;
+	u16 extended_status;
+};
 
-CXL_EXPORT int cxl_memdev_eh_eye_cap_run(struct cxl_memdev *memdev,
-	u8 depth, u32 lane_mask)
+CXL_EXPORT int cxl_memdev_hbo_status(struct cxl_memdev *memdev, u8 print_output)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_eh_eye_cap_run_in *eh_eye_cap_run_in;
+	struct cxl_mbox_hbo_status_out *hbo_status_out;
+	struct hbo_status_fields status_fields;
+	u8 opcode_shift = 0;
+	u8 percent_shift = 16;
+	u8 running_shift = 23;
+	u8 retcode_shift = 32;
+	u8 extended_shift = 48;
+	u64 opcode_mask = (1 << percent_shift) - (1 << opcode_shift); // 0-15
+	u64 percent_mask = (1 << running_shift) - (1 << percent_shift); // 16-22
+	u64 running_mask = (1 << running_shift); // 23
+	u64 retcode_mask = (1 << extended_shift) - (1 << retcode_shift); // 32-47
+	u64 extended_mask = 0xffffffffffffffff - (1 << extended_shift) + 1; // 48-63
 	int rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN_OPCODE);
+	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HBO_STATUS_OPCODE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	eh_eye_cap_run_in = (void *) cmd->send_cmd->in.payload;
-
-	eh_eye_cap_run_in->depth = depth;
-	eh_eye_cap_run_in->lane_mask = cpu_to_le32(lane_mask);
 	rc = cxl_cmd_submit(cmd);
 	if (rc < 0) {
 		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
@@ -5624,13 +8961,32 @@ CXL_EXPORT int cxl_memdev_eh_eye_cap_run(struct cxl_memdev *memdev,
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN) {
+	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HBO_STATUS) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_EH_EYE_CAP_RUN);
+				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HBO_STATUS);
 		return -EINVAL;
 	}
 
+	hbo_status_out = (void *)cmd->send_cmd->out.payload;
+	status_fields.opcode = (hbo_status_out->bo_status & opcode_mask) >> opcode_shift;
+	status_fields.percent_complete = (hbo_status_out->bo_status & percent_mask) >> percent_shift;
+	status_fields.is_running = (hbo_status_out->bo_status & running_mask) >> running_shift;
+	status_fields.return_code = (hbo_status_out->bo_status & retcode_mask) >> retcode_shift;
+	status_fields.extended_status = (hbo_status_out->bo_status & extended_mask) >> extended_shift;
+	if (print_output)
+	{
+		fprintf(stdout, "=============================== hidden bo status ===============================\n");
+		fprintf(stdout, "BO status: %08lx\n", le64_to_cpu(hbo_status_out->bo_status));
+		fprintf(stdout, " - Opcode: %x\n", status_fields.opcode);
+		fprintf(stdout, " - Percent complete: %d\n", status_fields.percent_complete);
+		fprintf(stdout, " - Is running: %d\n", status_fields.is_running);
+		fprintf(stdout, " - Return code: %d\n", status_fields.return_code);
+		fprintf(stdout, " - Extended status: %x\n", status_fields.extended_status);
+	}
 
+    if (status_fields.is_running) {
+        rc = 1;
+    }
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
@@ -5638,493 +8994,1010 @@ out:
 }
 
 
-#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_OPCODE 52226
-#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_IN_SIZE 4
-#define CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_OUT_SIZE 248
+/*
+ * Background operations: commands that complete on the mailbox before
+ * the work is done, which is then tracked through HBO status.
+ */
+#define CXL_MBOX_BG_STARTED 1
+#define CXL_BG_POLL_MIN_MS 2
+#define CXL_BG_POLL_MAX_MS 1000
 
-struct cxl_mbox_eh_eye_cap_read_in {
-	u8 rsvd;
-	u8 lane_id;
-	u8 bin_num;
-	u8 rsvd3;
-}  __attribute__((packed));
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_hbo_status(struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_HBO_STATUS_OPCODE,
+			0);
+}
 
-struct cxl_mbox_eh_eye_cap_read_out {
-	u8 num_phase;
-	u8 rsvd[7];
-	__le32 ber_data[60];
-}  __attribute__((packed));
+#define cmd_hbo_status_get_field(cmd, shift, width) \
+do { \
+	struct cxl_mbox_hbo_status_out *o = cxl_cmd_vendor_get_payload(cmd, \
+		CXL_MEM_COMMAND_ID_HBO_STATUS_OPCODE, sizeof(*o)); \
+	if (!o) \
+		return -EINVAL; \
+	return (le64_to_cpu(o->bo_status) >> (shift)) & ((1ULL << (width)) - 1); \
+} while (0)
 
-CXL_EXPORT int cxl_memdev_eh_eye_cap_read(struct cxl_memdev *memdev,
-	u8 lane_id, u8 bin_num)
+CXL_EXPORT int cxl_cmd_hbo_status_get_opcode(struct cxl_cmd *cmd)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_eh_eye_cap_read_in *eh_eye_cap_read_in;
-	struct cxl_mbox_eh_eye_cap_read_out *eh_eye_cap_read_out;
-	int rc = 0;
+	cmd_hbo_status_get_field(cmd, 0, 16);
+}
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+CXL_EXPORT int cxl_cmd_hbo_status_get_percent_complete(struct cxl_cmd *cmd)
+{
+	cmd_hbo_status_get_field(cmd, 16, 7);
+}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+CXL_EXPORT int cxl_cmd_hbo_status_get_running(struct cxl_cmd *cmd)
+{
+	cmd_hbo_status_get_field(cmd, 23, 1);
+}
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+CXL_EXPORT int cxl_cmd_hbo_status_get_return_code(struct cxl_cmd *cmd)
+{
+	cmd_hbo_status_get_field(cmd, 32, 16);
+}
 
-	eh_eye_cap_read_in = (void *) cmd->send_cmd->in.payload;
+CXL_EXPORT int cxl_cmd_hbo_status_get_extended_status(struct cxl_cmd *cmd)
+{
+	cmd_hbo_status_get_field(cmd, 48, 16);
+}
 
-	eh_eye_cap_read_in->lane_id = lane_id;
-	eh_eye_cap_read_in->bin_num = bin_num;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+static u64 cxl_bg_now_ms(void)
+{
+	struct timespec ts;
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_EH_EYE_CAP_READ);
-		return -EINVAL;
-	}
+/*
+ * Until the device reports progress back off exponentially, then aim
+ * for a few polls over the remaining time projected from the rate so
+ * far, so short operations are noticed quickly and long ones are not
+ * polled needlessly.
+ */
+static unsigned int cxl_bg_next_poll(unsigned int interval, u64 elapsed_ms,
+		int percent)
+{
+	u64 remaining;
 
-	eh_eye_cap_read_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "============================= eh eye capture read ==============================\n");
-	fprintf(stdout, "Total number of phases in ber_data: %x\n", eh_eye_cap_read_out->num_phase);
-	fprintf(stdout, "Per-phase bit error rates (multiplied by EYE_CAP_ERROR_CNT_MULT): ");
-	/* Procedurally generated print statement. To print this array contiguously,
-	   add "contiguous: True" to the YAML param and rerun cligen.py */
-	for (int i = 0; i < 60; i++) {
-		fprintf(stdout, "ber_data[%d]: %x\n", i, le32_to_cpu(eh_eye_cap_read_out->ber_data[i]));
+	if (percent <= 0 || percent >= 100)
+		return min_t(unsigned int, interval * 2, CXL_BG_POLL_MAX_MS);
+	remaining = elapsed_ms * (100 - percent) / percent;
+	return clamp_t(u64, remaining / 4, CXL_BG_POLL_MIN_MS,
+			CXL_BG_POLL_MAX_MS);
+}
+
+/**
+ * cxl_memdev_bg_wait - wait for a memdev's background operation to finish
+ * @memdev: memory device
+ * @timeout_ms: give up after this long, 0 to wait indefinitely
+ * @progress: called whenever the reported percentage changes, may be NULL
+ * @data: opaque pointer passed to @progress
+ *
+ * Polls HBO status at adaptive intervals until the operation is no
+ * longer running. A non-zero return from @progress stops the wait with
+ * -ECANCELED; the operation itself keeps running. Returns 0 when the
+ * operation completed successfully, -EIO when it reported a failure
+ * and -ETIMEDOUT when @timeout_ms expired first.
+ */
+CXL_EXPORT int cxl_memdev_bg_wait(struct cxl_memdev *memdev,
+		unsigned int timeout_ms, cxl_bg_progress_fn progress, void *data)
+{
+	unsigned int interval = CXL_BG_POLL_MIN_MS;
+	u64 start = cxl_bg_now_ms(), elapsed;
+	int rc, percent, last = -1;
+	struct cxl_cmd *status;
+	struct timespec ts;
+
+	status = cxl_cmd_new_hbo_status(memdev);
+	if (!status)
+		return -ENOMEM;
+
+	for (;;) {
+		rc = cxl_cmd_submit(status);
+		if (rc == 0 && cxl_cmd_get_mbox_status(status))
+			rc = -ENXIO;
+		if (rc)
+			break;
+
+		percent = cxl_cmd_hbo_status_get_percent_complete(status);
+		if (!cxl_cmd_hbo_status_get_running(status)) {
+			rc = cxl_cmd_hbo_status_get_return_code(status);
+			if (rc)
+				dbg(memdev->ctx, "%s: background opcode %#x failed: %d\n",
+					cxl_memdev_get_devname(memdev),
+					cxl_cmd_hbo_status_get_opcode(status), rc);
+			else if (progress && last != 100)
+				progress(memdev,
+					cxl_cmd_hbo_status_get_opcode(status),
+					100, data);
+			rc = rc ? -EIO : 0;
+			break;
+		}
+		if (progress && percent != last && progress(memdev,
+					cxl_cmd_hbo_status_get_opcode(status),
+					percent, data)) {
+			rc = -ECANCELED;
+			break;
+		}
+		last = percent;
+
+		elapsed = cxl_bg_now_ms() - start;
+		if (timeout_ms && elapsed >= timeout_ms) {
+			rc = -ETIMEDOUT;
+			break;
+		}
+		interval = cxl_bg_next_poll(interval, elapsed, percent);
+		if (timeout_ms)
+			interval = min_t(u64, interval, timeout_ms - elapsed);
+		ts.tv_sec = interval / 1000;
+		ts.tv_nsec = (interval % 1000) * 1000000L;
+		nanosleep(&ts, NULL);
 	}
-	fprintf(stdout, "\n");
 
-out:
-	cxl_cmd_unref(cmd);
+	cxl_cmd_unref(status);
 	return rc;
-	return 0;
 }
 
+/**
+ * cxl_cmd_submit_bg - submit a command that may run in the background
+ * @cmd: fully prepared command
+ * @timeout_ms: see cxl_memdev_bg_wait()
+ * @progress: see cxl_memdev_bg_wait()
+ * @data: opaque pointer passed to @progress
+ *
+ * Submits @cmd and, when the device accepted it, waits for the
+ * background operation it started with cxl_memdev_bg_wait(). Commands
+ * that finish in the foreground make the wait return immediately.
+ */
+CXL_EXPORT int cxl_cmd_submit_bg(struct cxl_cmd *cmd, unsigned int timeout_ms,
+		cxl_bg_progress_fn progress, void *data)
+{
+	int rc, status;
 
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_GET CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_GET_OPCODE 52227
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_GET_PAYLOAD_IN_SIZE 4
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_GET_PAYLOAD_OUT_SIZE 28
+	rc = cxl_cmd_submit(cmd);
+	if (rc < 0)
+		return rc;
+	status = cxl_cmd_get_mbox_status(cmd);
+	if (status != 0 && status != CXL_MBOX_BG_STARTED)
+		return -ENXIO;
+	return cxl_memdev_bg_wait(cmd->memdev, timeout_ms, progress, data);
+}
 
-struct cxl_mbox_eh_adapt_get_in {
-	__le32 lane_id;
-}  __attribute__((packed));
+/*
+ * Poison list and media scan. Both return media error records in
+ * pages; the device keeps its position and hands out the next page on
+ * the following call for as long as it sets the "more records" flag.
+ * The kernel refuses the scan commands as RAW, so they go through its
+ * named command ids.
+ */
+#define CXL_MEM_COMMAND_ID_GET_POISON_OPCODE 0x4300
+
+/* Get Poison List flags */
+#define CXL_MEDIA_ERR_MORE_RECORDS BIT(0)
+#define CXL_MEDIA_ERR_OVERFLOW BIT(1)
+#define CXL_MEDIA_ERR_SCAN_IN_PROGRESS BIT(2)
+/* Get Scan Media Results flags, "more records" is bit 0 there too */
+#define CXL_SCAN_MEDIA_STOPPED BIT(1)
+#define CXL_MEDIA_ERR_SOURCE_MASK 0x7ULL
+#define CXL_MEDIA_ERR_ADDR_MASK (~0x3fULL)
+#define CXL_MEDIA_ERR_UNIT 64
+
+struct cxl_mbox_media_range {
+	le64 dpa;
+	le64 length;
+} __attribute__((packed));
 
-struct cxl_mbox_eh_adapt_get_out {
-	u8 pga_gain;
-	u8 pga_off2;
-	u8 pga_off1;
-	u8 cdfe_a2;
-	u8 cdfe_a3;
-	u8 cdfe_a4;
-	u8 cdfe_a5;
-	u8 cdfe_a6;
-	u8 cdfe_a7;
-	u8 cdfe_a8;
-	u8 cdfe_a9;
-	u8 cdfe_a10;
-	u8 zobel_a_gain;
-	u8 zobel_b_gain;
-	__le16 zobel_dc_offset;
-	__le16 udfe_thr_0;
-	__le16 udfe_thr_1;
-	__le16 dc_offset;
-	__le16 median_amp;
-	u8 ph_ofs_t;
-	u8 rsvd[3];
-}  __attribute__((packed));
+struct cxl_mbox_media_err_record {
+	le64 address;
+	le32 length;
+	u8 rsvd[4];
+} __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_eh_adapt_get(struct cxl_memdev *memdev,
-	u32 lane_id)
-{
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_eh_adapt_get_in *eh_adapt_get_in;
-	struct cxl_mbox_eh_adapt_get_out *eh_adapt_get_out;
-	int rc = 0;
+struct cxl_mbox_get_poison_out {
+	u8 flags;
+	u8 rsvd1;
+	le64 overflow_timestamp;
+	le16 count;
+	u8 rsvd2[20];
+	struct cxl_mbox_media_err_record records[];
+} __attribute__((packed));
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_EH_ADAPT_GET_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+struct cxl_mbox_scan_media_in {
+	le64 dpa;
+	le64 length;
+	u8 flags;
+} __attribute__((packed));
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+struct cxl_mbox_get_scan_media_out {
+	le64 restart_dpa;
+	le64 restart_length;
+	u8 flags;
+	u8 rsvd1;
+	le16 count;
+	u8 rsvd2[12];
+	struct cxl_mbox_media_err_record records[];
+} __attribute__((packed));
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_ADAPT_GET_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
+struct cxl_poison_list {
+	int nr;
+	int alloc;
+	int overflow;
+	struct cxl_poison_record *records;
+};
+
+static void cxl_media_err_decode(struct cxl_mbox_media_err_record *raw,
+		struct cxl_poison_record *rec)
+{
+	u64 addr = le64_to_cpu(raw->address);
+
+	rec->dpa = addr & CXL_MEDIA_ERR_ADDR_MASK;
+	rec->length = (u64) le32_to_cpu(raw->length) * CXL_MEDIA_ERR_UNIT;
+	rec->source = addr & CXL_MEDIA_ERR_SOURCE_MASK;
+}
+
+/*
+ * Walk the media error records of a Get Poison List or Get Scan Media
+ * Results response, @hdr_size bytes in, handing each one to @fn.
+ */
+static int cxl_media_err_page(struct cxl_cmd *cmd, size_t hdr_size,
+		int count, cxl_poison_fn fn, void *data)
+{
+	struct cxl_mbox_media_err_record *raw;
+	struct cxl_poison_record rec;
+	int i, max, rc;
+
+	raw = (void *) ((u8 *) cmd->send_cmd->out.payload + hdr_size);
+	max = (cmd->send_cmd->out.size - (int) hdr_size) / (int) sizeof(*raw);
+	if (count > max) {
+		dbg(cmd->memdev->ctx, "%s: %d media error records, room for %d\n",
+				cxl_memdev_get_devname(cmd->memdev), count, max);
+		count = max;
+	}
+	for (i = 0; i < count; i++) {
+		cxl_media_err_decode(&raw[i], &rec);
+		rc = fn(cmd->memdev, &rec, data);
+		if (rc)
+			return rc;
 	}
+	return 0;
+}
 
-	eh_adapt_get_in = (void *) cmd->send_cmd->in.payload;
+/* output payload of a completed scan command, or NULL on mismatch */
+static void *cxl_cmd_scan_get_payload(struct cxl_cmd *cmd, u32 id, int size)
+{
+	if (cmd->send_cmd->id != id || cmd->status != 0)
+		return NULL;
+	if (cmd->send_cmd->out.size < size)
+		return NULL;
+	return (void *)cmd->send_cmd->out.payload;
+}
 
-	eh_adapt_get_in->lane_id = cpu_to_le32(lane_id);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+static int cxl_media_submit(struct cxl_cmd *cmd)
+{
+	int rc = cxl_cmd_submit(cmd);
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
 		rc = -ENXIO;
-		goto out;
-	}
+	return rc;
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_EH_ADAPT_GET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_EH_ADAPT_GET);
+/**
+ * cxl_memdev_poison_foreach - stream the poison list of a memdev
+ * @memdev: memory device
+ * @dpa: start of the device physical address range, 64 byte aligned
+ * @length: size of the range in bytes, 0 for the whole device
+ * @fn: called for every record as each page arrives
+ * @data: opaque pointer passed to @fn
+ *
+ * Issues Get Poison List until the device clears "more records", so
+ * only one page is held at a time. A non-zero return from @fn stops
+ * the walk and is returned. Returns 1 when the device reported that
+ * its poison list overflowed and is therefore incomplete.
+ */
+CXL_EXPORT int cxl_memdev_poison_foreach(struct cxl_memdev *memdev,
+		unsigned long long dpa, unsigned long long length,
+		cxl_poison_fn fn, void *data)
+{
+	struct cxl_mbox_media_range *in;
+	struct cxl_mbox_get_poison_out *out;
+	struct cxl_cmd *cmd;
+	int rc, overflow = 0;
+	u8 flags;
+
+	if (dpa % CXL_MEDIA_ERR_UNIT || length % CXL_MEDIA_ERR_UNIT)
+		return -EINVAL;
+	if (!length)
+		length = cxl_memdev_get_pmem_size(memdev)
+			+ cxl_memdev_get_ram_size(memdev) - dpa;
+	if ((long long) length <= 0)
 		return -EINVAL;
-	}
 
-	eh_adapt_get_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "============================ eh get adaptation data ============================\n");
-	fprintf(stdout, "contain the current value of the object PGA_GAIN as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ: %x\n", eh_adapt_get_out->pga_gain);
-	fprintf(stdout, "PGA Stage2 DC offset correction: %x\n", eh_adapt_get_out->pga_off2);
-	fprintf(stdout, "PGA Stage1 DC offset correction: %x\n", eh_adapt_get_out->pga_off1);
-	fprintf(stdout, "I_TAP2<7:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a2);
-	fprintf(stdout, "I_TAP3<6:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a3);
-	fprintf(stdout, "I_TAP4<6:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a4);
-	fprintf(stdout, "I_TAP5<6:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a5);
-	fprintf(stdout, "I_TAP6<6:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a6);
-	fprintf(stdout, "I_TAP7<6:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a7);
-	fprintf(stdout, "I_TAP8<6:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a8);
-	fprintf(stdout, "I_TAP9<5:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a9);
-	fprintf(stdout, "I_TAP10<5:0> 2's compliment: %x\n", eh_adapt_get_out->cdfe_a10);
-	fprintf(stdout, "Zobel a_gain: %x\n", eh_adapt_get_out->zobel_a_gain);
-	fprintf(stdout, "zobel_b_gain: %x\n", eh_adapt_get_out->zobel_b_gain);
-	fprintf(stdout, "Zobel DC offset correction: %x\n", le16_to_cpu(eh_adapt_get_out->zobel_dc_offset));
-	fprintf(stdout, "contain the current value of the object UDFE_THR_0 as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ.: %x\n", le16_to_cpu(eh_adapt_get_out->udfe_thr_0));
-	fprintf(stdout, "contain the current value of the object UDFE_THR_1 as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ: %x\n", le16_to_cpu(eh_adapt_get_out->udfe_thr_1));
-	fprintf(stdout, "contain the current value of the object DC_OFFSET as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ: %x\n", le16_to_cpu(eh_adapt_get_out->dc_offset));
-	fprintf(stdout, "contain the current value of the object PGA_GAIN as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ: %x\n", le16_to_cpu(eh_adapt_get_out->median_amp));
-	fprintf(stdout, "contain the current value of the object PH_OFS_T as captured through a write to register bit ADAPT_DSP_RESULTS_CAPTURE_REQ: %x\n", eh_adapt_get_out->ph_ofs_t);
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_GET_POISON_OPCODE,
+			sizeof(*in));
+	if (!cmd)
+		return -errno;
+	in = (void *) cmd->send_cmd->in.payload;
+	in->dpa = cpu_to_le64(dpa);
+	in->length = cpu_to_le64(length / CXL_MEDIA_ERR_UNIT);
+
+	do {
+		rc = cxl_media_submit(cmd);
+		if (rc)
+			break;
+		out = cxl_cmd_vendor_get_payload(cmd,
+				CXL_MEM_COMMAND_ID_GET_POISON_OPCODE,
+				sizeof(*out));
+		if (!out) {
+			rc = -ENXIO;
+			break;
+		}
+		flags = out->flags;
+		overflow |= !!(flags & CXL_MEDIA_ERR_OVERFLOW);
+		rc = cxl_media_err_page(cmd, sizeof(*out),
+				le16_to_cpu(out->count), fn, data);
+	} while (rc == 0 && (flags & CXL_MEDIA_ERR_MORE_RECORDS));
 
-out:
 	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	return rc ? rc : overflow;
 }
 
+static int cxl_poison_record_cmp(const void *a, const void *b)
+{
+	const struct cxl_poison_record *x = a, *y = b;
 
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF_OPCODE 52228
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF_PAYLOAD_IN_SIZE 16
-
-struct cxl_mbox_eh_adapt_oneoff_in {
-	__le32 lane_id;
-	__le32 preload;
-	__le32 loops;
-	__le32 objects;
-}  __attribute__((packed));
-
+	if (x->dpa != y->dpa)
+		return x->dpa < y->dpa ? -1 : 1;
+	return x->source - y->source;
+}
 
-CXL_EXPORT int cxl_memdev_eh_adapt_oneoff(struct cxl_memdev *memdev,
-	u32 lane_id, u32 preload, u32 loops, u32 objects)
+static int cxl_poison_list_add(struct cxl_memdev *memdev,
+		const struct cxl_poison_record *rec, void *data)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_eh_adapt_oneoff_in *eh_adapt_oneoff_in;
-	int rc = 0;
+	struct cxl_poison_list *list = data;
+	struct cxl_poison_record *r;
+	int alloc;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
+	if (list->nr == list->alloc) {
+		alloc = list->alloc ? list->alloc * 2 : 64;
+		r = realloc(list->records, alloc * sizeof(*r));
+		if (!r)
+			return -ENOMEM;
+		list->records = r;
+		list->alloc = alloc;
 	}
+	list->records[list->nr++] = *rec;
+	return 0;
+}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+/* sort by address, then fold overlapping or adjacent same-source ranges */
+static void cxl_poison_list_merge(struct cxl_poison_list *list)
+{
+	struct cxl_poison_record *r = list->records, *prev;
+	int i, nr = 0;
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
+	if (!list->nr)
+		return;
+	qsort(r, list->nr, sizeof(*r), cxl_poison_record_cmp);
+	for (i = 1; i < list->nr; i++) {
+		prev = &r[nr];
+		if (r[i].source == prev->source
+				&& r[i].dpa <= prev->dpa + prev->length) {
+			prev->length = max(prev->length,
+					r[i].dpa + r[i].length - prev->dpa);
+			continue;
+		}
+		r[++nr] = r[i];
 	}
+	list->nr = nr + 1;
+}
 
-	eh_adapt_oneoff_in = (void *) cmd->send_cmd->in.payload;
+/**
+ * cxl_memdev_get_poison_list - read a memdev's poison list
+ * @memdev: memory device
+ * @dpa: see cxl_memdev_poison_foreach()
+ * @length: see cxl_memdev_poison_foreach()
+ *
+ * Collects every page into a list sorted by address, with overlapping
+ * and adjacent records of the same source merged. Release it with
+ * cxl_poison_list_free(). Returns NULL with errno set on failure.
+ */
+CXL_EXPORT struct cxl_poison_list *cxl_memdev_get_poison_list(
+		struct cxl_memdev *memdev, unsigned long long dpa,
+		unsigned long long length)
+{
+	struct cxl_poison_list *list = calloc(1, sizeof(*list));
+	int rc;
 
-	eh_adapt_oneoff_in->lane_id = cpu_to_le32(lane_id);
-	eh_adapt_oneoff_in->preload = cpu_to_le32(preload);
-	eh_adapt_oneoff_in->loops = cpu_to_le32(loops);
-	eh_adapt_oneoff_in->objects = cpu_to_le32(objects);
-	rc = cxl_cmd_submit(cmd);
+	if (!list) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	rc = cxl_memdev_poison_foreach(memdev, dpa, length,
+			cxl_poison_list_add, list);
 	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
+		cxl_poison_list_free(list);
+		errno = -rc;
+		return NULL;
 	}
+	list->overflow = rc;
+	cxl_poison_list_merge(list);
+	return list;
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+CXL_EXPORT void cxl_poison_list_free(struct cxl_poison_list *list)
+{
+	if (!list)
+		return;
+	free(list->records);
+	free(list);
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_EH_ADAPT_ONEOFF);
+CXL_EXPORT int cxl_poison_list_get_count(struct cxl_poison_list *list)
+{
+	return list->nr;
+}
+
+CXL_EXPORT const struct cxl_poison_record *cxl_poison_list_get_record(
+		struct cxl_poison_list *list, int idx)
+{
+	if (idx < 0 || idx >= list->nr)
+		return NULL;
+	return &list->records[idx];
+}
+
+CXL_EXPORT int cxl_poison_list_get_overflow(struct cxl_poison_list *list)
+{
+	return list->overflow;
+}
+
+/**
+ * cxl_memdev_get_scan_media_time - estimate how long a media scan takes
+ * @memdev: memory device
+ * @dpa: start of the range, 64 byte aligned
+ * @length: size of the range in bytes, a multiple of 64
+ *
+ * Returns the device's estimate in milliseconds, or a negative errno.
+ */
+CXL_EXPORT int cxl_memdev_get_scan_media_time(struct cxl_memdev *memdev,
+		unsigned long long dpa, unsigned long long length)
+{
+	struct cxl_mbox_media_range *in;
+	struct cxl_cmd *cmd;
+	le32 *out;
+	int rc;
+
+	if (dpa % CXL_MEDIA_ERR_UNIT || length % CXL_MEDIA_ERR_UNIT || !length)
 		return -EINVAL;
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_SCAN_MEDIA_CAPS);
+	if (!cmd)
+		return -errno;
+	if (cmd->send_cmd->in.size < (int) sizeof(*in)) {
+		cxl_cmd_unref(cmd);
+		return -ENXIO;
+	}
+	in = (void *) cmd->send_cmd->in.payload;
+	in->dpa = cpu_to_le64(dpa);
+	in->length = cpu_to_le64(length / CXL_MEDIA_ERR_UNIT);
+
+	rc = cxl_media_submit(cmd);
+	if (rc == 0) {
+		out = cxl_cmd_scan_get_payload(cmd,
+				CXL_MEM_COMMAND_ID_GET_SCAN_MEDIA_CAPS,
+				sizeof(*out));
+		rc = out ? (int) min_t(u32, le32_to_cpu(*out), INT_MAX)
+			: -ENXIO;
 	}
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+/**
+ * cxl_memdev_scan_media - scan a range of media for errors
+ * @memdev: memory device
+ * @dpa: start of the range, 64 byte aligned
+ * @length: size of the range in bytes, a multiple of 64
+ * @flags: CXL_SCAN_MEDIA_NO_EVENT_LOG to not log events for new errors
+ * @timeout_ms: see cxl_memdev_bg_wait()
+ * @progress: see cxl_memdev_bg_wait()
+ * @data: opaque pointer passed to @progress
+ *
+ * Starts Scan Media as a background operation and waits for it with
+ * cxl_memdev_bg_wait(). Retrieve what it found with
+ * cxl_memdev_scan_media_foreach(). Scanning a large device in several
+ * smaller ranges keeps each result set small.
+ */
+CXL_EXPORT int cxl_memdev_scan_media(struct cxl_memdev *memdev,
+		unsigned long long dpa, unsigned long long length,
+		unsigned int flags, unsigned int timeout_ms,
+		cxl_bg_progress_fn progress, void *data)
+{
+	struct cxl_mbox_scan_media_in *in;
+	struct cxl_cmd *cmd;
+	int rc;
 
+	if (dpa % CXL_MEDIA_ERR_UNIT || length % CXL_MEDIA_ERR_UNIT || !length)
+		return -EINVAL;
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_SCAN_MEDIA);
+	if (!cmd)
+		return -errno;
+	if (cmd->send_cmd->in.size < (int) sizeof(*in)) {
+		cxl_cmd_unref(cmd);
+		return -ENXIO;
+	}
+	in = (void *) cmd->send_cmd->in.payload;
+	in->dpa = cpu_to_le64(dpa);
+	in->length = cpu_to_le64(length / CXL_MEDIA_ERR_UNIT);
+	in->flags = flags & CXL_SCAN_MEDIA_NO_EVENT_LOG;
 
-out:
+	rc = cxl_cmd_submit_bg(cmd, timeout_ms, progress, data);
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
+/**
+ * cxl_memdev_scan_media_foreach - stream the results of the last scan
+ * @memdev: memory device
+ * @fn: called for every record as each page arrives
+ * @data: opaque pointer passed to @fn
+ * @restart_dpa: set to where the scan stopped when it ended early
+ * @restart_length: set to the length left to scan, 0 when it completed
+ *
+ * Issues Get Scan Media Results until the device clears "more records".
+ * Returns 1 when the device stopped the scan before the end of the
+ * range, call cxl_memdev_scan_media() again from @restart_dpa for
+ * @restart_length bytes to cover the rest.
+ */
+CXL_EXPORT int cxl_memdev_scan_media_foreach(struct cxl_memdev *memdev,
+		cxl_poison_fn fn, void *data, unsigned long long *restart_dpa,
+		unsigned long long *restart_length)
+{
+	struct cxl_mbox_get_scan_media_out *out;
+	struct cxl_cmd *cmd;
+	int rc, stopped = 0;
+	u8 flags;
 
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE_OPCODE 52229
-#define CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE_PAYLOAD_IN_SIZE 40
+	if (restart_length)
+		*restart_length = 0;
+	cmd = cxl_cmd_new_generic(memdev, CXL_MEM_COMMAND_ID_GET_SCAN_MEDIA);
+	if (!cmd)
+		return -errno;
+
+	do {
+		rc = cxl_media_submit(cmd);
+		if (rc)
+			break;
+		out = cxl_cmd_scan_get_payload(cmd,
+				CXL_MEM_COMMAND_ID_GET_SCAN_MEDIA, sizeof(*out));
+		if (!out) {
+			rc = -ENXIO;
+			break;
+		}
+		flags = out->flags;
+		if (flags & CXL_SCAN_MEDIA_STOPPED) {
+			stopped = 1;
+			if (restart_dpa)
+				*restart_dpa = le64_to_cpu(out->restart_dpa);
+			if (restart_length)
+				*restart_length = le64_to_cpu(out->restart_length)
+					* CXL_MEDIA_ERR_UNIT;
+		}
+		rc = cxl_media_err_page(cmd, sizeof(*out),
+				le16_to_cpu(out->count), fn, data);
+	} while (rc == 0 && (flags & CXL_MEDIA_ERR_MORE_RECORDS));
 
-struct cxl_mbox_eh_adapt_force_in {
-	__le32 lane_id;
-	__le32 rate;
-	__le32 vdd_bias;
-	__le32 ssc;
-	u8 pga_gain;
-	u8 pga_a0;
-	u8 pga_off;
-	u8 cdfe_a2;
-	u8 cdfe_a3;
-	u8 cdfe_a4;
-	u8 cdfe_a5;
-	u8 cdfe_a6;
-	u8 cdfe_a7;
-	u8 cdfe_a8;
-	u8 cdfe_a9;
-	u8 cdfe_a10;
-	__le16 dc_offset;
-	__le16 zobel_dc_offset;
-	__le16 udfe_thr_0;
-	__le16 udfe_thr_1;
-	__le16 median_amp;
-	u8 zobel_a_gain;
-	u8 ph_ofs_t;
-}  __attribute__((packed));
+	cxl_cmd_unref(cmd);
+	return rc ? rc : stopped;
+}
 
+/*
+ * QoS telemetry of multi-logical devices: what Get LD Info says the
+ * device can report, the thresholds it was configured with, and the
+ * egress port backpressure it currently sees.
+ */
+#define CXL_MEM_COMMAND_ID_GET_QOS_CONTROL_OPCODE 0x5403
+#define CXL_MEM_COMMAND_ID_GET_QOS_STATUS_OPCODE 0x5405
+
+struct cxl_mbox_get_qos_control_out {
+	u8 control;
+	u8 egress_moderate_pct;
+	u8 egress_severe_pct;
+	u8 backpressure_sample_interval;
+	le16 reqcmp_basis;
+	u8 completion_collection_interval;
+} __attribute__((packed));
 
-CXL_EXPORT int cxl_memdev_eh_adapt_force(struct cxl_memdev *memdev,
-	u32 lane_id, u32 rate, u32 vdd_bias, u32 ssc, u8 pga_gain, u8 pga_a0,
-	u8 pga_off, u8 cdfe_a2, u8 cdfe_a3, u8 cdfe_a4, u8 cdfe_a5, u8 cdfe_a6,
-	u8 cdfe_a7, u8 cdfe_a8, u8 cdfe_a9, u8 cdfe_a10, u16 dc_offset,
-	u16 zobel_dc_offset, u16 udfe_thr_0, u16 udfe_thr_1, u16 median_amp,
-	u8 zobel_a_gain, u8 ph_ofs_t)
+struct cxl_mbox_get_qos_status_out {
+	u8 backpressure_avg_pct;
+} __attribute__((packed));
+
+static int cxl_qos_load(const struct cxl_qos_telemetry *t)
+{
+	if (t->severe_pct && t->backpressure_pct >= t->severe_pct)
+		return CXL_QOS_LOAD_SEVERE;
+	if (t->moderate_pct && t->backpressure_pct >= t->moderate_pct)
+		return CXL_QOS_LOAD_MODERATE;
+	return CXL_QOS_LOAD_NORMAL;
+}
+
+/**
+ * cxl_memdev_update_qos_status - refresh the backpressure of a sample
+ * @memdev: memory device
+ * @t: sample filled in by cxl_memdev_get_qos_telemetry()
+ *
+ * Issues only Get QoS Status and reclassifies @t->load against the
+ * thresholds already in @t, which keeps periodic sampling to one
+ * mailbox command per interval.
+ */
+CXL_EXPORT int cxl_memdev_update_qos_status(struct cxl_memdev *memdev,
+		struct cxl_qos_telemetry *t)
 {
+	struct cxl_mbox_get_qos_status_out *out;
+	struct timespec ts;
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_eh_adapt_force_in *eh_adapt_force_in;
-	int rc = 0;
+	int rc;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_GET_QOS_STATUS_OPCODE, 0);
+	if (!cmd)
+		return -errno;
+	rc = cxl_media_submit(cmd);
+	if (rc == 0) {
+		out = cxl_cmd_vendor_get_payload(cmd,
+				CXL_MEM_COMMAND_ID_GET_QOS_STATUS_OPCODE,
+				sizeof(*out));
+		if (out) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			t->timestamp_ns = (u64) ts.tv_sec * 1000000000ULL
+				+ ts.tv_nsec;
+			t->backpressure_pct = min_t(int,
+					out->backpressure_avg_pct, 100);
+			t->load = cxl_qos_load(t);
+		} else
+			rc = -ENXIO;
 	}
+	cxl_cmd_unref(cmd);
+	return rc;
+}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+/**
+ * cxl_memdev_get_qos_telemetry - take a full QoS telemetry sample
+ * @memdev: memory device
+ * @t: filled in on success
+ *
+ * Reads the telemetry capabilities from Get LD Info, the enabled
+ * telemetry and load thresholds from Get QoS Control, and the current
+ * backpressure from Get QoS Status. Returns -EOPNOTSUPP when the
+ * device reports no QoS telemetry capability.
+ */
+static int cxl_ld_info(struct cxl_memdev *memdev, int *ld_count,
+		unsigned int *caps)
+{
+	struct cxl_get_ld_info *ld_info;
+	struct cxl_cmd *cmd;
+	int rc;
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_GET_LD_INFO_OPCODE,
+			0);
+	if (!cmd)
+		return -errno;
+	rc = cxl_media_submit(cmd);
+	if (rc == 0) {
+		ld_info = cxl_cmd_vendor_get_payload(cmd,
+				CXL_MEM_COMMAND_ID_GET_LD_INFO_OPCODE,
+				sizeof(*ld_info));
+		if (ld_info) {
+			*ld_count = le16_to_cpu(ld_info->ld_cnt);
+			*caps = ld_info->qos_telemetry_capa
+				& CXL_QOS_TELEMETRY_MASK;
+		} else
+			rc = -ENXIO;
 	}
+	cxl_cmd_unref(cmd);
+	return rc;
+}
 
-	eh_adapt_force_in = (void *) cmd->send_cmd->in.payload;
-
-	eh_adapt_force_in->lane_id = cpu_to_le32(lane_id);
-	eh_adapt_force_in->rate = cpu_to_le32(rate);
-	eh_adapt_force_in->vdd_bias = cpu_to_le32(vdd_bias);
-	eh_adapt_force_in->ssc = cpu_to_le32(ssc);
-	eh_adapt_force_in->pga_gain = pga_gain;
-	eh_adapt_force_in->pga_a0 = pga_a0;
-	eh_adapt_force_in->pga_off = pga_off;
-	eh_adapt_force_in->cdfe_a2 = cdfe_a2;
-	eh_adapt_force_in->cdfe_a3 = cdfe_a3;
-	eh_adapt_force_in->cdfe_a4 = cdfe_a4;
-	eh_adapt_force_in->cdfe_a5 = cdfe_a5;
-	eh_adapt_force_in->cdfe_a6 = cdfe_a6;
-	eh_adapt_force_in->cdfe_a7 = cdfe_a7;
-	eh_adapt_force_in->cdfe_a8 = cdfe_a8;
-	eh_adapt_force_in->cdfe_a9 = cdfe_a9;
-	eh_adapt_force_in->cdfe_a10 = cdfe_a10;
-	eh_adapt_force_in->dc_offset = cpu_to_le16(dc_offset);
-	eh_adapt_force_in->zobel_dc_offset = cpu_to_le16(zobel_dc_offset);
-	eh_adapt_force_in->udfe_thr_0 = cpu_to_le16(udfe_thr_0);
-	eh_adapt_force_in->udfe_thr_1 = cpu_to_le16(udfe_thr_1);
-	eh_adapt_force_in->median_amp = cpu_to_le16(median_amp);
-	eh_adapt_force_in->zobel_a_gain = zobel_a_gain;
-	eh_adapt_force_in->ph_ofs_t = ph_ofs_t;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+CXL_EXPORT int cxl_memdev_get_qos_telemetry(struct cxl_memdev *memdev,
+		struct cxl_qos_telemetry *t)
+{
+	struct cxl_mbox_get_qos_control_out *ctl;
+	struct cxl_cmd *cmd;
+	int rc;
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+	memset(t, 0, sizeof(*t));
+	rc = cxl_ld_info(memdev, &t->ld_count, &t->caps);
+	if (rc)
+		return rc;
+	if (!t->caps)
+		return -EOPNOTSUPP;
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_EH_ADAPT_FORCE);
-		return -EINVAL;
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_GET_QOS_CONTROL_OPCODE, 0);
+	if (!cmd)
+		return -errno;
+	rc = cxl_media_submit(cmd);
+	if (rc == 0) {
+		ctl = cxl_cmd_vendor_get_payload(cmd,
+				CXL_MEM_COMMAND_ID_GET_QOS_CONTROL_OPCODE,
+				sizeof(*ctl));
+		if (ctl) {
+			t->enabled = ctl->control & CXL_QOS_TELEMETRY_MASK;
+			t->moderate_pct = ctl->egress_moderate_pct;
+			t->severe_pct = ctl->egress_severe_pct;
+			t->sample_interval = ctl->backpressure_sample_interval;
+		} else
+			rc = -ENXIO;
 	}
-
-
-out:
 	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+	if (rc)
+		return rc;
+
+	return cxl_memdev_update_qos_status(memdev, t);
 }
 
+/*
+ * Capacity and bandwidth allocation of the logical devices of a
+ * multi-logical device. Capacity is handed out per LD in two ranges,
+ * each a multiple of the device's memory granularity; bandwidth shares
+ * and limits are fractions of 256 of the device's egress bandwidth and
+ * are part of its QoS telemetry.
+ */
+#define CXL_MEM_COMMAND_ID_GET_LD_ALLOC_OPCODE 0x5401
+#define CXL_MEM_COMMAND_ID_SET_LD_ALLOC_OPCODE 0x5402
+#define CXL_MEM_COMMAND_ID_GET_QOS_BW_OPCODE 0x5406
+#define CXL_MEM_COMMAND_ID_SET_QOS_BW_OPCODE 0x5407
+#define CXL_MEM_COMMAND_ID_GET_QOS_BW_LIMIT_OPCODE 0x5408
+#define CXL_MEM_COMMAND_ID_SET_QOS_BW_LIMIT_OPCODE 0x5409
+#define CXL_LD_ALLOC_GRANULARITY_MIN (256ULL << 20)
+
+struct cxl_mbox_ld_alloc {
+	le64 range1;
+	le64 range2;
+} __attribute__((packed));
 
-#define CXL_MEM_COMMAND_ID_HBO_STATUS CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_HBO_STATUS_OPCODE 52480
-#define CXL_MEM_COMMAND_ID_HBO_STATUS_PAYLOAD_OUT_SIZE 8
+struct cxl_mbox_get_ld_alloc_in {
+	u8 start_ld;
+	u8 limit;
+} __attribute__((packed));
 
+struct cxl_mbox_get_ld_alloc_out {
+	u8 nr_lds;
+	u8 granularity;
+	u8 start_ld;
+	u8 nr_entries;
+	struct cxl_mbox_ld_alloc ld[];
+} __attribute__((packed));
 
-struct cxl_mbox_hbo_status_out {
-	__le64 bo_status;
-}  __attribute__((packed));
+struct cxl_mbox_set_ld_alloc {
+	u8 nr_lds;
+	u8 start_ld;
+	u8 rsvd[2];
+	struct cxl_mbox_ld_alloc ld[];
+} __attribute__((packed));
 
-struct hbo_status_fields {
-	u16 opcode;
-	u8 percent_complete;
-	u8 is_running;
-	u16 return_code;
-	u16 extended_status;
-};
+/* request of the Get commands, and everything of the others */
+struct cxl_mbox_qos_bw {
+	u8 nr_lds;
+	u8 start_ld;
+	u8 fraction[];
+} __attribute__((packed));
+
+static int cxl_ld_alloc_submit(struct cxl_cmd *cmd, int opcode, int size,
+		void **out)
+{
+	int rc = cxl_media_submit(cmd);
+
+	if (rc)
+		return rc;
+	*out = cxl_cmd_vendor_get_payload(cmd, opcode, size);
+	return *out ? 0 : -ENXIO;
+}
 
-CXL_EXPORT int cxl_memdev_hbo_status(struct cxl_memdev *memdev, u8 print_output)
+static int cxl_ld_get_capacity(struct cxl_memdev *memdev,
+		struct cxl_ld_allocs *a)
 {
+	int opcode = CXL_MEM_COMMAND_ID_GET_LD_ALLOC_OPCODE;
+	struct cxl_mbox_get_ld_alloc_out *out;
+	struct cxl_mbox_get_ld_alloc_in *in;
 	struct cxl_cmd *cmd;
-	struct cxl_mbox_hbo_status_out *hbo_status_out;
-	struct hbo_status_fields status_fields;
-	u8 opcode_shift = 0;
-	u8 percent_shift = 16;
-	u8 running_shift = 23;
-	u8 retcode_shift = 32;
-	u8 extended_shift = 48;
-	u64 opcode_mask = (1 << percent_shift) - (1 << opcode_shift); // 0-15
-	u64 percent_mask = (1 << running_shift) - (1 << percent_shift); // 16-22
-	u64 running_mask = (1 << running_shift); // 23
-	u64 retcode_mask = (1 << extended_shift) - (1 << retcode_shift); // 32-47
-	u64 extended_mask = 0xffffffffffffffff - (1 << extended_shift) + 1; // 48-63
-	int rc = 0;
+	int i, n = 0, rc;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HBO_STATUS_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	cmd = cxl_cmd_new_vendor(memdev, opcode, sizeof(*in));
+	if (!cmd)
+		return -errno;
+	in = (void *) cmd->send_cmd->in.payload;
+
+	/* the device may return the list in several pieces */
+	do {
+		in->start_ld = n;
+		in->limit = a->ld_count - n;
+		rc = cxl_ld_alloc_submit(cmd, opcode, sizeof(*out),
+				(void **) &out);
+		if (rc)
+			break;
+		if (out->granularity > 2 || out->start_ld != n
+				|| !out->nr_entries
+				|| out->nr_entries > a->ld_count - n
+				|| cmd->send_cmd->out.size < (int) (sizeof(*out)
+					+ out->nr_entries * sizeof(out->ld[0]))) {
+			rc = -ENXIO;
+			break;
+		}
+		a->granularity = CXL_LD_ALLOC_GRANULARITY_MIN
+			<< out->granularity;
+		for (i = 0; i < out->nr_entries; i++, n++) {
+			a->ld[n].range1 = le64_to_cpu(out->ld[i].range1)
+				* a->granularity;
+			a->ld[n].range2 = le64_to_cpu(out->ld[i].range2)
+				* a->granularity;
+		}
+	} while (n < a->ld_count);
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+	cxl_cmd_unref(cmd);
+	return rc;
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
+static int cxl_ld_set_capacity(struct cxl_memdev *memdev,
+		struct cxl_ld_allocs *a, int first, int nr)
+{
+	int opcode = CXL_MEM_COMMAND_ID_SET_LD_ALLOC_OPCODE;
+	int size = sizeof(struct cxl_mbox_set_ld_alloc)
+		+ nr * sizeof(struct cxl_mbox_ld_alloc);
+	struct cxl_mbox_set_ld_alloc *in, *out;
+	struct cxl_cmd *cmd;
+	int i, rc;
+
+	for (i = first; i < first + nr; i++)
+		if (!a->granularity || a->ld[i].range1 % a->granularity
+				|| a->ld[i].range2 % a->granularity)
+			return -EINVAL;
+
+	cmd = cxl_cmd_new_vendor(memdev, opcode, size);
+	if (!cmd)
+		return -errno;
+	in = (void *) cmd->send_cmd->in.payload;
+	in->nr_lds = nr;
+	in->start_ld = first;
+	for (i = 0; i < nr; i++) {
+		in->ld[i].range1 = cpu_to_le64(a->ld[first + i].range1
+				/ a->granularity);
+		in->ld[i].range2 = cpu_to_le64(a->ld[first + i].range2
+				/ a->granularity);
+	}
+
+	/* the response carries what the device actually granted */
+	rc = cxl_ld_alloc_submit(cmd, opcode, sizeof(*out), (void **) &out);
+	if (rc == 0 && (out->start_ld != first || out->nr_lds > nr
+				|| cmd->send_cmd->out.size < (int) (sizeof(*out)
+					+ out->nr_lds * sizeof(out->ld[0]))))
 		rc = -ENXIO;
-		goto out;
+	for (i = 0; rc == 0 && i < out->nr_lds; i++) {
+		a->ld[first + i].range1 = le64_to_cpu(out->ld[i].range1)
+			* a->granularity;
+		a->ld[first + i].range2 = le64_to_cpu(out->ld[i].range2)
+			* a->granularity;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HBO_STATUS) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HBO_STATUS);
-		return -EINVAL;
-	}
+	cxl_cmd_unref(cmd);
+	return rc;
+}
 
-	hbo_status_out = (void *)cmd->send_cmd->out.payload;
-	status_fields.opcode = (hbo_status_out->bo_status & opcode_mask) >> opcode_shift;
-	status_fields.percent_complete = (hbo_status_out->bo_status & percent_mask) >> percent_shift;
-	status_fields.is_running = (hbo_status_out->bo_status & running_mask) >> running_shift;
-	status_fields.return_code = (hbo_status_out->bo_status & retcode_mask) >> retcode_shift;
-	status_fields.extended_status = (hbo_status_out->bo_status & extended_mask) >> extended_shift;
-	if (print_output)
-	{
-		fprintf(stdout, "=============================== hidden bo status ===============================\n");
-		fprintf(stdout, "BO status: %08lx\n", le64_to_cpu(hbo_status_out->bo_status));
-		fprintf(stdout, " - Opcode: %x\n", status_fields.opcode);
-		fprintf(stdout, " - Percent complete: %d\n", status_fields.percent_complete);
-		fprintf(stdout, " - Is running: %d\n", status_fields.is_running);
-		fprintf(stdout, " - Return code: %d\n", status_fields.return_code);
-		fprintf(stdout, " - Extended status: %x\n", status_fields.extended_status);
+/* Get or Set QoS Allocated BW or BW Limit for LDs @first..@first + @nr */
+static int cxl_ld_bw(struct cxl_memdev *memdev, struct cxl_ld_allocs *a,
+		int opcode, bool set, int first, int nr)
+{
+	bool limit = opcode == CXL_MEM_COMMAND_ID_GET_QOS_BW_LIMIT_OPCODE
+		|| opcode == CXL_MEM_COMMAND_ID_SET_QOS_BW_LIMIT_OPCODE;
+	struct cxl_mbox_qos_bw *in, *out;
+	struct cxl_cmd *cmd;
+	int i, rc;
+
+	cmd = cxl_cmd_new_vendor(memdev, opcode,
+			sizeof(*in) + (set ? nr : 0));
+	if (!cmd)
+		return -errno;
+	in = (void *) cmd->send_cmd->in.payload;
+	in->nr_lds = nr;
+	in->start_ld = first;
+	for (i = 0; set && i < nr; i++)
+		in->fraction[i] = limit ? a->ld[first + i].bw_limit
+			: a->ld[first + i].bw;
+
+	rc = cxl_ld_alloc_submit(cmd, opcode, sizeof(*out), (void **) &out);
+	if (rc == 0 && (out->start_ld != first || out->nr_lds > nr
+				|| cmd->send_cmd->out.size
+					< (int) sizeof(*out) + out->nr_lds))
+		rc = -ENXIO;
+	for (i = 0; rc == 0 && i < out->nr_lds; i++) {
+		if (limit)
+			a->ld[first + i].bw_limit = out->fraction[i];
+		else
+			a->ld[first + i].bw = out->fraction[i];
 	}
 
-    if (status_fields.is_running) {
-        rc = 1;
-    }
-out:
 	cxl_cmd_unref(cmd);
 	return rc;
+}
+
+/**
+ * cxl_memdev_get_ld_alloc - read how a multi-logical device is split
+ * @memdev: memory device
+ * @a: filled in on success
+ *
+ * Reads the LD count and QoS telemetry capabilities from Get LD Info,
+ * then the capacity of every LD from Get LD Allocations and, when the
+ * device has QoS telemetry, the bandwidth shares and limits. Returns
+ * -EOPNOTSUPP when @memdev is not a multi-logical device.
+ */
+CXL_EXPORT int cxl_memdev_get_ld_alloc(struct cxl_memdev *memdev,
+		struct cxl_ld_allocs *a)
+{
+	int rc;
+
+	memset(a, 0, sizeof(*a));
+	rc = cxl_ld_info(memdev, &a->ld_count, &a->qos_caps);
+	if (rc)
+		return rc;
+	if (a->ld_count <= 0)
+		return -EOPNOTSUPP;
+	if (a->ld_count > CXL_LD_MAX)
+		a->ld_count = CXL_LD_MAX;
+
+	rc = cxl_ld_get_capacity(memdev, a);
+	if (rc || !a->qos_caps)
+		return rc;
+	rc = cxl_ld_bw(memdev, a, CXL_MEM_COMMAND_ID_GET_QOS_BW_OPCODE, false,
+			0, a->ld_count);
+	if (rc)
+		return rc;
+	return cxl_ld_bw(memdev, a, CXL_MEM_COMMAND_ID_GET_QOS_BW_LIMIT_OPCODE,
+			false, 0, a->ld_count);
+}
+
+/**
+ * cxl_memdev_set_ld_alloc - change how a multi-logical device is split
+ * @memdev: memory device
+ * @a: allocation from cxl_memdev_get_ld_alloc(), with the new values
+ * @first: first LD to change
+ * @nr: number of LDs to change
+ * @what: CXL_LD_ALLOC_* fields of @a to apply
+ *
+ * Each field is applied to all @nr LDs in one command, so bandwidth
+ * can be moved between LDs without the total ever exceeding the
+ * device. On success the changed entries of @a are updated to what
+ * the device granted, which may be less than asked for.
+ */
+CXL_EXPORT int cxl_memdev_set_ld_alloc(struct cxl_memdev *memdev,
+		struct cxl_ld_allocs *a, int first, int nr, unsigned int what)
+{
+	int i, rc;
+
+	if (first < 0 || nr <= 0 || first + nr > a->ld_count
+			|| first + nr > CXL_LD_MAX)
+		return -EINVAL;
+	if ((what & (CXL_LD_ALLOC_BANDWIDTH | CXL_LD_ALLOC_BANDWIDTH_LIMIT))
+			&& !a->qos_caps)
+		return -EOPNOTSUPP;
+	for (i = first; i < first + nr; i++)
+		if (a->ld[i].bw > 255 || a->ld[i].bw_limit > 255)
+			return -EINVAL;
+
+	if (what & CXL_LD_ALLOC_CAPACITY) {
+		rc = cxl_ld_set_capacity(memdev, a, first, nr);
+		if (rc)
+			return rc;
+	}
+	if (what & CXL_LD_ALLOC_BANDWIDTH) {
+		rc = cxl_ld_bw(memdev, a, CXL_MEM_COMMAND_ID_SET_QOS_BW_OPCODE,
+				true, first, nr);
+		if (rc)
+			return rc;
+	}
+	if (what & CXL_LD_ALLOC_BANDWIDTH_LIMIT)
+		return cxl_ld_bw(memdev, a,
+				CXL_MEM_COMMAND_ID_SET_QOS_BW_LIMIT_OPCODE,
+				true, first, nr);
 	return 0;
 }
 
@@ -6132,244 +10005,247 @@ out:
 #define CXL_MEM_COMMAND_ID_HBO_TRANSFER_FW CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_HBO_TRANSFER_FW_OPCODE 52481
 
-
+static const struct cxl_vendor_cmd hbo_transfer_fw_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_HBO_TRANSFER_FW_OPCODE,
+};
 
 CXL_EXPORT int cxl_memdev_hbo_transfer_fw(struct cxl_memdev *memdev)
 {
-	struct cxl_cmd *cmd;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HBO_TRANSFER_FW_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	return cxl_memdev_vendor_cmd(memdev, &hbo_transfer_fw_cmd, NULL);
+}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+#define CXL_MEM_COMMAND_ID_HBO_ACTIVATE_FW CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_HBO_ACTIVATE_FW_OPCODE 52482
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HBO_TRANSFER_FW) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HBO_TRANSFER_FW);
-		return -EINVAL;
-	}
+static const struct cxl_vendor_cmd hbo_activate_fw_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_HBO_ACTIVATE_FW_OPCODE,
+};
 
+CXL_EXPORT int cxl_memdev_hbo_activate_fw(struct cxl_memdev *memdev)
+{
+	int rc = cxl_memdev_vendor_cmd(memdev, &hbo_activate_fw_cmd, NULL);
 
-out:
-	cxl_cmd_unref(cmd);
+	if (rc == 0)
+		cxl_memdev_inventory_flush(memdev, true);
 	return rc;
-	return 0;
 }
 
 
-#define CXL_MEM_COMMAND_ID_HBO_ACTIVATE_FW CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_HBO_ACTIVATE_FW_OPCODE 52482
+#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR_OPCODE 52736
+#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR_PAYLOAD_IN_SIZE 4
 
+static const struct cxl_vendor_field health_counters_clear_in_fields[] = {
+	{ .offset = 0x00, .width = 4 },
+};
 
+static const struct cxl_vendor_cmd health_counters_clear_cmd = {
+	.opcode = CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR_PAYLOAD_IN_SIZE,
+	.in = health_counters_clear_in_fields,
+	.nr_in = ARRAY_SIZE(health_counters_clear_in_fields),
+};
 
-CXL_EXPORT int cxl_memdev_hbo_activate_fw(struct cxl_memdev *memdev)
+CXL_EXPORT int cxl_memdev_health_counters_clear(struct cxl_memdev *memdev,
+	u32 bitmask)
 {
-	struct cxl_cmd *cmd;
-	int rc = 0;
+	const u64 args[] = { bitmask };
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HBO_ACTIVATE_FW_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+	return cxl_memdev_vendor_cmd(memdev, &health_counters_clear_cmd, args);
+}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET CXL_MEM_COMMAND_ID_RAW
+#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET_OPCODE 52737
+#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET_PAYLOAD_OUT_SIZE 40
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+struct cxl_mbox_health_counters_get_out {
+	__le32 critical_over_temperature_exceeded;
+	__le32 power_on_events;
+	__le32 power_on_hours;
+	__le32 cxl_mem_link_crc_errors;
+	__le32 cxl_io_link_lcrc_errors;
+	__le32 cxl_io_link_ecrc_errors;
+	__le32 num_ddr_single_ecc_errors;
+	__le32 num_ddr_double_ecc_errors;
+	__le32 link_recovery_events;
+	__le32 time_in_throttled;
+	__le32 over_temperature_warning_level_exceeded;
+	__le32 critical_under_temperature_exceeded;
+	__le32 under_temperature_warning_level_exceeded;
+	__le32 rx_retry_request;
+	__le32 rcmd_qs0_hi_threshold_detect;
+	__le32 rcmd_qs1_hi_threshold_detect;
+}  __attribute__((packed));
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HBO_ACTIVATE_FW) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HBO_ACTIVATE_FW);
-		return -EINVAL;
-	}
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_health_counters_get(
+		struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET_OPCODE, 0);
+}
 
+#define cmd_health_counters_get_int(c, f) \
+do { \
+	cmd_vendor_get_int(c, health_counters_get, HEALTH_COUNTERS_GET, 32, f); \
+} while (0)
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_critical_over_temperature_exceeded(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, critical_over_temperature_exceeded);
 }
 
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_over_temperature_warning_level_exceeded(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, over_temperature_warning_level_exceeded);
+}
 
-#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR_OPCODE 52736
-#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR_PAYLOAD_IN_SIZE 4
-
-struct cxl_mbox_health_counters_clear_in {
-	__le32 bitmask;
-}  __attribute__((packed));
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_critical_under_temperature_exceeded(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, critical_under_temperature_exceeded);
+}
 
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_under_temperature_warning_level_exceeded(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, under_temperature_warning_level_exceeded);
+}
 
-CXL_EXPORT int cxl_memdev_health_counters_clear(struct cxl_memdev *memdev,
-	u32 bitmask)
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_power_on_events(
+		struct cxl_cmd *cmd)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_health_counters_clear_in *health_counters_clear_in;
-	int rc = 0;
+	cmd_health_counters_get_int(cmd, power_on_events);
+}
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_power_on_hours(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, power_on_hours);
+}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_cxl_mem_link_crc_errors(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, cxl_mem_link_crc_errors);
+}
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_cxl_io_link_lcrc_errors(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, cxl_io_link_lcrc_errors);
+}
 
-	health_counters_clear_in = (void *) cmd->send_cmd->in.payload;
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_cxl_io_link_ecrc_errors(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, cxl_io_link_ecrc_errors);
+}
 
-	health_counters_clear_in->bitmask = cpu_to_le32(bitmask);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_num_ddr_single_ecc_errors(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, num_ddr_single_ecc_errors);
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
-		goto out;
-	}
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_num_ddr_double_ecc_errors(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, num_ddr_double_ecc_errors);
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_CLEAR);
-		return -EINVAL;
-	}
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_link_recovery_events(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, link_recovery_events);
+}
 
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_time_in_throttled(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, time_in_throttled);
+}
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_rx_retry_request(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, rx_retry_request);
 }
 
-#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET CXL_MEM_COMMAND_ID_RAW
-#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET_OPCODE 52737
-#define CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET_PAYLOAD_OUT_SIZE 40
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_rcmd_qs0_hi_threshold_detect(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, rcmd_qs0_hi_threshold_detect);
+}
 
-struct cxl_mbox_health_counters_get_out {
-	__le32 critical_over_temperature_exceeded;
-	__le32 power_on_events;
-	__le32 power_on_hours;
-	__le32 cxl_mem_link_crc_errors;
-	__le32 cxl_io_link_lcrc_errors;
-	__le32 cxl_io_link_ecrc_errors;
-	__le32 num_ddr_single_ecc_errors;
-	__le32 num_ddr_double_ecc_errors;
-	__le32 link_recovery_events;
-	__le32 time_in_throttled;
-	__le32 over_temperature_warning_level_exceeded;
-	__le32 critical_under_temperature_exceeded;
-	__le32 under_temperature_warning_level_exceeded;
-	__le32 rx_retry_request;
-	__le32 rcmd_qs0_hi_threshold_detect;
-	__le32 rcmd_qs1_hi_threshold_detect;
-}  __attribute__((packed));
+CXL_EXPORT long long cxl_cmd_health_counters_get_get_rcmd_qs1_hi_threshold_detect(
+		struct cxl_cmd *cmd)
+{
+	cmd_health_counters_get_int(cmd, rcmd_qs1_hi_threshold_detect);
+}
+
+static const struct {
+	const char *name;
+	long long (*get)(struct cxl_cmd *cmd);
+} health_counters[] = {
+	{ "CRITICAL_OVER_TEMPERATURE_EXCEEDED", cxl_cmd_health_counters_get_get_critical_over_temperature_exceeded },
+	{ "OVER_TEMPERATURE_WARNING_LEVEL_EXCEEDED", cxl_cmd_health_counters_get_get_over_temperature_warning_level_exceeded },
+	{ "CRITICAL_UNDER_TEMPERATURE_EXCEEDED", cxl_cmd_health_counters_get_get_critical_under_temperature_exceeded },
+	{ "UNDER_TEMPERATURE_WARNING_LEVEL_EXCEEDED", cxl_cmd_health_counters_get_get_under_temperature_warning_level_exceeded },
+	{ "POWER_ON_EVENTS", cxl_cmd_health_counters_get_get_power_on_events },
+	{ "POWER_ON_HOURS", cxl_cmd_health_counters_get_get_power_on_hours },
+	{ "CXL_MEM_LINK_CRC_ERRORS", cxl_cmd_health_counters_get_get_cxl_mem_link_crc_errors },
+	{ "CXL_IO_LINK_LCRC_ERRORS", cxl_cmd_health_counters_get_get_cxl_io_link_lcrc_errors },
+	{ "CXL_IO_LINK_ECRC_ERRORS", cxl_cmd_health_counters_get_get_cxl_io_link_ecrc_errors },
+	{ "NUM_DDR_SINGLE_ECC_ERRORS", cxl_cmd_health_counters_get_get_num_ddr_single_ecc_errors },
+	{ "NUM_DDR_DOUBLE_ECC_ERRORS", cxl_cmd_health_counters_get_get_num_ddr_double_ecc_errors },
+	{ "LINK_RECOVERY_EVENTS", cxl_cmd_health_counters_get_get_link_recovery_events },
+	{ "TIME_IN_THROTTLED", cxl_cmd_health_counters_get_get_time_in_throttled },
+	{ "RX_RETRY_REQUEST", cxl_cmd_health_counters_get_get_rx_retry_request },
+	{ "RCMD_QS0_HI_THRESHOLD_DETECT", cxl_cmd_health_counters_get_get_rcmd_qs0_hi_threshold_detect },
+	{ "RCMD_QS1_HI_THRESHOLD_DETECT", cxl_cmd_health_counters_get_get_rcmd_qs1_hi_threshold_detect },
+};
 
 CXL_EXPORT int cxl_memdev_health_counters_get(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mbox_health_counters_get_out *health_counters_get_out;
-	int rc = 0;
+	unsigned int i;
+	int rc;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET_OPCODE);
+	cmd = cxl_cmd_new_health_counters_get(memdev);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d:\n%s\n",
-				cxl_memdev_get_devname(memdev), rc, DEVICE_ERRORS[rc]);
-		rc = -ENXIO;
+	rc = cxl_cmd_vendor_submit(cmd);
+	if (rc)
+		goto out;
+	/* the counters share one payload, one short read fails them all */
+	if (health_counters[0].get(cmd) < 0) {
+		rc = -EINVAL;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HEALTH_COUNTERS_GET);
-		return -EINVAL;
+	if (memdev->ctx->vendor_output) {
+		for (i = 0; i < ARRAY_SIZE(health_counters); i++)
+			cxl_vendor_emit(memdev, "get health counters",
+					health_counters[i].name, NULL,
+					health_counters[i].get(cmd), -1);
+		goto out;
 	}
 
-	health_counters_get_out = (void *)cmd->send_cmd->out.payload;
 	fprintf(stdout, "============================= get health counters ==============================\n");
-	fprintf(stdout, "0: CRITICAL_OVER_TEMPERATURE_EXCEEDED = %d\n", le32_to_cpu(health_counters_get_out->critical_over_temperature_exceeded));
-	fprintf(stdout, "1: OVER_TEMPERATURE_WARNING_LEVEL_EXCEEDED = %d\n", le32_to_cpu(health_counters_get_out->over_temperature_warning_level_exceeded));
-	fprintf(stdout, "2: CRITICAL_UNDER_TEMPERATURE_EXCEEDED = %d\n", le32_to_cpu(health_counters_get_out->critical_under_temperature_exceeded));
-	fprintf(stdout, "3: UNDER_TEMPERATURE_WARNING_LEVEL_EXCEEDED = %d\n", le32_to_cpu(health_counters_get_out->under_temperature_warning_level_exceeded));
-	fprintf(stdout, "4: POWER_ON_EVENTS = %d\n", le32_to_cpu(health_counters_get_out->power_on_events));
-	fprintf(stdout, "5: POWER_ON_HOURS = %d\n", le32_to_cpu(health_counters_get_out->power_on_hours));
-	fprintf(stdout, "6: CXL_MEM_LINK_CRC_ERRORS = %d\n", le32_to_cpu(health_counters_get_out->cxl_mem_link_crc_errors));
-	fprintf(stdout, "7: CXL_IO_LINK_LCRC_ERRORS = %d\n", le32_to_cpu(health_counters_get_out->cxl_io_link_lcrc_errors));
-	fprintf(stdout, "8: CXL_IO_LINK_ECRC_ERRORS = %d\n", le32_to_cpu(health_counters_get_out->cxl_io_link_ecrc_errors));
-	fprintf(stdout, "9: NUM_DDR_SINGLE_ECC_ERRORS = %d\n", le32_to_cpu(health_counters_get_out->num_ddr_single_ecc_errors));
-	fprintf(stdout, "10: NUM_DDR_DOUBLE_ECC_ERRORS = %d\n", le32_to_cpu(health_counters_get_out->num_ddr_double_ecc_errors));
-	fprintf(stdout, "11: LINK_RECOVERY_EVENTS = %d\n", le32_to_cpu(health_counters_get_out->link_recovery_events));
-	fprintf(stdout, "12: TIME_IN_THROTTLED = %d\n", le32_to_cpu(health_counters_get_out->time_in_throttled));
-	fprintf(stdout, "13: RX_RETRY_REQUEST = %d\n", le32_to_cpu(health_counters_get_out->rx_retry_request));
-	fprintf(stdout, "14: RCMD_QS0_HI_THRESHOLD_DETECT = %d\n", le32_to_cpu(health_counters_get_out->rcmd_qs0_hi_threshold_detect));
-	fprintf(stdout, "15: RCMD_QS1_HI_THRESHOLD_DETECT = %d\n", le32_to_cpu(health_counters_get_out->rcmd_qs1_hi_threshold_detect));
+	for (i = 0; i < ARRAY_SIZE(health_counters); i++)
+		fprintf(stdout, "%d: %s = %lld\n", i, health_counters[i].name,
+				health_counters[i].get(cmd));
 
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
 #define CXL_MEM_COMMAND_ID_HCT_GET_PLAT_PARAMS CXL_MEM_COMMAND_ID_RAW
@@ -6474,7 +10350,7 @@ CXL_EXPORT int cxl_memdev_err_inj_hif_poison(struct cxl_memdev *memdev,
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_ERR_INJ_HIF_POISON_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -6551,7 +10427,7 @@ CXL_EXPORT int cxl_memdev_err_inj_hif_ecc(struct cxl_memdev *memdev,
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_ERR_INJ_HIF_ECC_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -6626,7 +10502,7 @@ CXL_EXPORT int cxl_memdev_perfcnt_ddr_generic_capture(struct cxl_memdev *memdev,
 	cinfo = &query->commands[cmd->query_idx];
 	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_DDR_GENERIC_CAPTURE_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -6712,7 +10588,7 @@ CXL_EXPORT int cxl_memdev_perfcnt_ddr_dfi_capture(struct cxl_memdev *memdev,
 	cinfo = &query->commands[cmd->query_idx];
 	cinfo->size_in = CXL_MEM_COMMAND_ID_PERFCNT_DDR_DFI_CAPTURE_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -6788,7 +10664,7 @@ CXL_EXPORT int cxl_memdev_eh_eye_cap_timeout_enable(struct cxl_memdev *memdev, u
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_EYE_CAP_TIMEOUT_ENABLE_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -6860,7 +10736,7 @@ CXL_EXPORT int cxl_memdev_eh_eye_cap_status(struct cxl_memdev *memdev)
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_EYE_CAP_STATUS_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -6896,6 +10772,25 @@ out:
 	return 0;
 }
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_eh_eye_cap_status(
+		struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_EH_EYE_CAP_STATUS_OPCODE,
+			CXL_MEM_COMMAND_ID_EH_EYE_CAP_STATUS_PAYLOAD_IN_SIZE);
+}
+
+CXL_EXPORT int cxl_cmd_eh_eye_cap_status_get_stat(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_eh_eye_cap_status_out *out;
+
+	out = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_EH_EYE_CAP_STATUS_OPCODE, sizeof(*out));
+	if (!out)
+		return -EINVAL;
+	return out->stat;
+}
+
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_CFG CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_CFG_OPCODE 0XCC06
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_CFG_PAYLOAD_IN_SIZE 13
@@ -6933,7 +10828,7 @@ CXL_EXPORT int cxl_memdev_eh_link_dbg_cfg(struct cxl_memdev *memdev, u8 port_id,
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_LINK_DBG_CFG_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7028,7 +10923,7 @@ CXL_EXPORT int cxl_memdev_eh_link_dbg_entry_dump(struct cxl_memdev *memdev, u8 e
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_LINK_DBG_ENTRY_DUMP_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7082,6 +10977,46 @@ out:
 	return 0;
 }
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_eh_link_dbg_entry_dump(
+		struct cxl_memdev *memdev, u8 entry_idx)
+{
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_EH_LINK_DBG_ENTRY_DUMP_OPCODE,
+			CXL_MEM_COMMAND_ID_EH_LINK_DBG_ENTRY_DUMP_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	cxl_cmd_eh_link_dbg_entry_dump_set_entry(cmd, entry_idx);
+	return cmd;
+}
+
+CXL_EXPORT int cxl_cmd_eh_link_dbg_entry_dump_set_entry(struct cxl_cmd *cmd,
+		u8 entry_idx)
+{
+	struct cxl_mbox_eh_link_dbg_entry_dump_in *eh_link_dbg_entry_dump_in =
+		cmd->input_payload;
+
+	if (cxl_cmd_get_opcode(cmd) != CXL_MEM_COMMAND_ID_EH_LINK_DBG_ENTRY_DUMP_OPCODE)
+		return -EINVAL;
+	eh_link_dbg_entry_dump_in->entry_idx = entry_idx;
+	return 0;
+}
+
+/* number of captured entries, from the upper nibble of cap_info */
+CXL_EXPORT int cxl_cmd_eh_link_dbg_entry_dump_get_entry_num(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_eh_link_dbg_entry_dump_out *out;
+
+	out = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_EH_LINK_DBG_ENTRY_DUMP_OPCODE,
+			sizeof(*out));
+	if (!out)
+		return -EINVAL;
+	return out->cap_info >> 4;
+}
+
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_LANE_DUMP CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_LANE_DUMP_OPCODE 0XCC08
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_LANE_DUMP_PAYLOAD_IN_SIZE 2
@@ -7262,7 +11197,7 @@ CXL_EXPORT int cxl_memdev_eh_link_dbg_lane_dump(struct cxl_memdev *memdev, u8 en
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_LINK_DBG_LANE_DUMP_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7384,6 +11319,34 @@ out:
 	return 0;
 }
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_eh_link_dbg_lane_dump(
+		struct cxl_memdev *memdev, u8 entry_idx, u8 lane_idx)
+{
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_EH_LINK_DBG_LANE_DUMP_OPCODE,
+			CXL_MEM_COMMAND_ID_EH_LINK_DBG_LANE_DUMP_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	cxl_cmd_eh_link_dbg_lane_dump_set_lane(cmd, entry_idx, lane_idx);
+	return cmd;
+}
+
+CXL_EXPORT int cxl_cmd_eh_link_dbg_lane_dump_set_lane(struct cxl_cmd *cmd,
+		u8 entry_idx, u8 lane_idx)
+{
+	struct cxl_mbox_eh_link_dbg_lane_dump_in *eh_link_dbg_lane_dump_in =
+		cmd->input_payload;
+
+	if (cxl_cmd_get_opcode(cmd) != CXL_MEM_COMMAND_ID_EH_LINK_DBG_LANE_DUMP_OPCODE)
+		return -EINVAL;
+	eh_link_dbg_lane_dump_in->entry_idx = entry_idx;
+	eh_link_dbg_lane_dump_in->lane_idx = lane_idx;
+	return 0;
+}
+
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_RESET CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_RESET_OPCODE 0XCC09
 #define CXL_MEM_COMMAND_ID_EH_LINK_DBG_RESET_PAYLOAD_IN_SIZE 0
@@ -7407,7 +11370,7 @@ CXL_EXPORT int cxl_memdev_eh_link_dbg_reset(struct cxl_memdev *memdev)
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_EH_LINK_DBG_RESET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7476,7 +11439,7 @@ CXL_EXPORT int cxl_memdev_fbist_stopconfig_set(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_STOPCONFIG_SET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7552,7 +11515,7 @@ CXL_EXPORT int cxl_memdev_fbist_cyclecount_set(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_CYCLECOUNT_SET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7626,7 +11589,7 @@ CXL_EXPORT int cxl_memdev_fbist_reset_set(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_RESET_SET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7700,7 +11663,7 @@ CXL_EXPORT int cxl_memdev_fbist_run_set(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_RUN_SET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7755,6 +11718,35 @@ struct cxl_mbox_fbist_run_get_out {
 	u8 txg1_run;
 }  __attribute__((packed));
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_fbist_run_get(struct cxl_memdev *memdev,
+		u32 fbist_id)
+{
+	struct cxl_mbox_fbist_run_get_in *fbist_run_get_in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_FBIST_RUN_GET_OPCODE,
+			CXL_MEM_COMMAND_ID_FBIST_RUN_GET_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	fbist_run_get_in = cmd->input_payload;
+	fbist_run_get_in->fbist_id = cpu_to_le32(fbist_id);
+	return cmd;
+}
+
+/* run state of transaction generator @txg_nr (0 or 1) */
+CXL_EXPORT int cxl_cmd_fbist_run_get_get_txg_run(struct cxl_cmd *cmd,
+		u8 txg_nr)
+{
+	struct cxl_mbox_fbist_run_get_out *out;
+
+	out = cxl_cmd_vendor_get_payload(cmd, CXL_MEM_COMMAND_ID_FBIST_RUN_GET_OPCODE,
+			sizeof(*out));
+	if (!out || txg_nr > 1)
+		return -EINVAL;
+	return txg_nr ? out->txg1_run : out->txg0_run;
+}
+
 CXL_EXPORT int cxl_memdev_fbist_run_get(struct cxl_memdev *memdev,
 	u32 fbist_id)
 {
@@ -7778,7 +11770,7 @@ CXL_EXPORT int cxl_memdev_fbist_run_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_RUN_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7858,7 +11850,7 @@ CXL_EXPORT int cxl_memdev_fbist_xfer_rem_cnt_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_XFER_REM_CNT_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -7938,7 +11930,7 @@ CXL_EXPORT int cxl_memdev_fbist_last_exp_read_data_get(struct cxl_memdev *memdev
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_LAST_EXP_READ_DATA_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8025,7 +12017,7 @@ CXL_EXPORT int cxl_memdev_fbist_curr_cycle_cnt_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_CURR_CYCLE_CNT_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8108,7 +12100,7 @@ CXL_EXPORT int cxl_memdev_fbist_thread_status_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_THREAD_STATUS_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8191,7 +12183,7 @@ CXL_EXPORT int cxl_memdev_fbist_thread_trans_cnt_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_THREAD_TRANS_CNT_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8251,71 +12243,68 @@ struct cxl_mbox_fbist_thread_bandwidth_get_out {
 	__le32 write_bw_cnt;
 }  __attribute__((packed));
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_fbist_thread_bandwidth_get(
+		struct cxl_memdev *memdev, u32 fbist_id, u8 txg_nr, u8 thread_nr)
+{
+	struct cxl_mbox_fbist_thread_bandwidth_get_in *fbist_thread_bandwidth_get_in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_FBIST_THREAD_BANDWIDTH_GET_OPCODE,
+			CXL_MEM_COMMAND_ID_FBIST_THREAD_BANDWIDTH_GET_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	fbist_thread_bandwidth_get_in = (void *) cmd->send_cmd->in.payload;
+	fbist_thread_bandwidth_get_in->fbist_id = cpu_to_le32(fbist_id);
+	fbist_thread_bandwidth_get_in->txg_nr = txg_nr;
+	fbist_thread_bandwidth_get_in->thread_nr = thread_nr;
+	return cmd;
+}
+
+CXL_EXPORT long long cxl_cmd_fbist_thread_bandwidth_get_get_read_bw_cnt(
+		struct cxl_cmd *cmd)
+{
+	cmd_vendor_get_int(cmd, fbist_thread_bandwidth_get,
+			FBIST_THREAD_BANDWIDTH_GET, 32, read_bw_cnt);
+}
+
+CXL_EXPORT long long cxl_cmd_fbist_thread_bandwidth_get_get_write_bw_cnt(
+		struct cxl_cmd *cmd)
+{
+	cmd_vendor_get_int(cmd, fbist_thread_bandwidth_get,
+			FBIST_THREAD_BANDWIDTH_GET, 32, write_bw_cnt);
+}
+
 CXL_EXPORT int cxl_memdev_fbist_thread_bandwidth_get(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 txg_nr, u8 thread_nr)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_fbist_thread_bandwidth_get_in *fbist_thread_bandwidth_get_in;
-	struct cxl_mbox_fbist_thread_bandwidth_get_out *fbist_thread_bandwidth_get_out;
-	int rc = 0;
+	int rc;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_FBIST_THREAD_BANDWIDTH_GET_OPCODE);
+	cmd = cxl_cmd_new_fbist_thread_bandwidth_get(memdev, fbist_id, txg_nr,
+			thread_nr);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_THREAD_BANDWIDTH_GET_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	fbist_thread_bandwidth_get_in = (void *) cmd->send_cmd->in.payload;
-
-	fbist_thread_bandwidth_get_in->fbist_id = cpu_to_le32(fbist_id);
-	fbist_thread_bandwidth_get_in->txg_nr = txg_nr;
-	fbist_thread_bandwidth_get_in->thread_nr = thread_nr;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
-		rc = -ENXIO;
+	rc = cxl_cmd_vendor_submit(cmd);
+	if (rc)
+		goto out;
+	if (cxl_cmd_fbist_thread_bandwidth_get_get_read_bw_cnt(cmd) < 0) {
+		rc = -EINVAL;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_FBIST_THREAD_BANDWIDTH_GET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_FBIST_THREAD_BANDWIDTH_GET);
-		return -EINVAL;
-	}
-
-	fbist_thread_bandwidth_get_out = (void *)cmd->send_cmd->out.payload;
 	fprintf(stdout, "================= read a txg's thread rd/wr bandwidth counters =================\n");
-	fprintf(stdout, "Read BW Count: %x\n", le32_to_cpu(fbist_thread_bandwidth_get_out->read_bw_cnt));
-	fprintf(stdout, "Write BW Count: %x\n", le32_to_cpu(fbist_thread_bandwidth_get_out->write_bw_cnt));
+	fprintf(stdout, "Read BW Count: %llx\n", cxl_cmd_fbist_thread_bandwidth_get_get_read_bw_cnt(cmd));
+	fprintf(stdout, "Write BW Count: %llx\n", cxl_cmd_fbist_thread_bandwidth_get_get_write_bw_cnt(cmd));
 
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
 
@@ -8335,71 +12324,68 @@ struct cxl_mbox_fbist_thread_latency_get_out {
 	__le32 write_latency_cnt;
 }  __attribute__((packed));
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_fbist_thread_latency_get(
+		struct cxl_memdev *memdev, u32 fbist_id, u8 txg_nr, u8 thread_nr)
+{
+	struct cxl_mbox_fbist_thread_latency_get_in *fbist_thread_latency_get_in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_FBIST_THREAD_LATENCY_GET_OPCODE,
+			CXL_MEM_COMMAND_ID_FBIST_THREAD_LATENCY_GET_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	fbist_thread_latency_get_in = (void *) cmd->send_cmd->in.payload;
+	fbist_thread_latency_get_in->fbist_id = cpu_to_le32(fbist_id);
+	fbist_thread_latency_get_in->txg_nr = txg_nr;
+	fbist_thread_latency_get_in->thread_nr = thread_nr;
+	return cmd;
+}
+
+CXL_EXPORT long long cxl_cmd_fbist_thread_latency_get_get_read_latency_cnt(
+		struct cxl_cmd *cmd)
+{
+	cmd_vendor_get_int(cmd, fbist_thread_latency_get,
+			FBIST_THREAD_LATENCY_GET, 32, read_latency_cnt);
+}
+
+CXL_EXPORT long long cxl_cmd_fbist_thread_latency_get_get_write_latency_cnt(
+		struct cxl_cmd *cmd)
+{
+	cmd_vendor_get_int(cmd, fbist_thread_latency_get,
+			FBIST_THREAD_LATENCY_GET, 32, write_latency_cnt);
+}
+
 CXL_EXPORT int cxl_memdev_fbist_thread_latency_get(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 txg_nr, u8 thread_nr)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_fbist_thread_latency_get_in *fbist_thread_latency_get_in;
-	struct cxl_mbox_fbist_thread_latency_get_out *fbist_thread_latency_get_out;
-	int rc = 0;
+	int rc;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_FBIST_THREAD_LATENCY_GET_OPCODE);
+	cmd = cxl_cmd_new_fbist_thread_latency_get(memdev, fbist_id, txg_nr,
+			thread_nr);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_THREAD_LATENCY_GET_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
-
-	fbist_thread_latency_get_in = (void *) cmd->send_cmd->in.payload;
-
-	fbist_thread_latency_get_in->fbist_id = cpu_to_le32(fbist_id);
-	fbist_thread_latency_get_in->txg_nr = txg_nr;
-	fbist_thread_latency_get_in->thread_nr = thread_nr;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
-
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
-		rc = -ENXIO;
+	rc = cxl_cmd_vendor_submit(cmd);
+	if (rc)
+		goto out;
+	if (cxl_cmd_fbist_thread_latency_get_get_read_latency_cnt(cmd) < 0) {
+		rc = -EINVAL;
 		goto out;
 	}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_FBIST_THREAD_LATENCY_GET) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_FBIST_THREAD_LATENCY_GET);
-		return -EINVAL;
-	}
-
-	fbist_thread_latency_get_out = (void *)cmd->send_cmd->out.payload;
 	fprintf(stdout, "================== read a txg's thread rd/wr latency counters ==================\n");
-	fprintf(stdout, "Read Latency Count: %x\n", le32_to_cpu(fbist_thread_latency_get_out->read_latency_cnt));
-	fprintf(stdout, "Write Latency Count: %x\n", le32_to_cpu(fbist_thread_latency_get_out->write_latency_cnt));
+	fprintf(stdout, "Read Latency Count: %llx\n", cxl_cmd_fbist_thread_latency_get_get_read_latency_cnt(cmd));
+	fprintf(stdout, "Write Latency Count: %llx\n", cxl_cmd_fbist_thread_latency_get_get_write_latency_cnt(cmd));
 
 out:
 	cxl_cmd_unref(cmd);
 	return rc;
-	return 0;
 }
 
 
@@ -8441,7 +12427,7 @@ CXL_EXPORT int cxl_memdev_fbist_thread_perf_mon_set(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_THREAD_PERF_MON_SET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8523,7 +12509,7 @@ CXL_EXPORT int cxl_memdev_fbist_top_read_status0_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_TOP_READ_STATUS0_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8604,7 +12590,7 @@ CXL_EXPORT int cxl_memdev_fbist_top_err_cnt_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_TOP_ERR_CNT_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8684,7 +12670,7 @@ CXL_EXPORT int cxl_memdev_fbist_last_read_addr_get(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_LAST_READ_ADDR_GET_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8738,6 +12724,31 @@ struct cxl_mbox_fbist_test_simpledata_in {
 }  __attribute__((packed));
 
 
+/*
+ * Silent counterpart of cxl_memdev_fbist_test_simpledata() for callers
+ * that report results themselves.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_fbist_test_simpledata(
+		struct cxl_memdev *memdev, u32 fbist_id, u8 test_nr,
+		u64 start_address, u64 num_bytes)
+{
+	struct cxl_mbox_fbist_test_simpledata_in *in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_FBIST_TEST_SIMPLEDATA_OPCODE,
+			CXL_MEM_COMMAND_ID_FBIST_TEST_SIMPLEDATA_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	in = cmd->input_payload;
+	in->fbist_id = cpu_to_le32(fbist_id);
+	in->test_nr = test_nr;
+	in->start_address = cpu_to_le64(start_address);
+	in->num_bytes = cpu_to_le64(num_bytes);
+	return cmd;
+}
+
 CXL_EXPORT int cxl_memdev_fbist_test_simpledata(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 test_nr, u64 start_address, u64 num_bytes)
 {
@@ -8760,7 +12771,7 @@ CXL_EXPORT int cxl_memdev_fbist_test_simpledata(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_TEST_SIMPLEDATA_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8838,7 +12849,7 @@ CXL_EXPORT int cxl_memdev_fbist_test_addresstest(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_TEST_ADDRESSTEST_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8919,7 +12930,7 @@ CXL_EXPORT int cxl_memdev_fbist_test_movinginversion(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_TEST_MOVINGINVERSION_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -8979,6 +12990,35 @@ struct cxl_mbox_fbist_test_randomsequence_in {
 }  __attribute__((packed));
 
 
+/*
+ * Silent counterpart of cxl_memdev_fbist_test_randomsequence() for
+ * callers that report results themselves.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_fbist_test_randomsequence(
+		struct cxl_memdev *memdev, u32 fbist_id, u8 phase_nr,
+		u64 start_address, u64 num_bytes, u32 ddrpage_size,
+		u32 seed_dr0, u32 seed_dr1)
+{
+	struct cxl_mbox_fbist_test_randomsequence_in *in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_FBIST_TEST_RANDOMSEQUENCE_OPCODE,
+			CXL_MEM_COMMAND_ID_FBIST_TEST_RANDOMSEQUENCE_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	in = cmd->input_payload;
+	in->fbist_id = cpu_to_le32(fbist_id);
+	in->phase_nr = phase_nr;
+	in->start_address = cpu_to_le64(start_address);
+	in->num_bytes = cpu_to_le64(num_bytes);
+	in->ddrpage_size = cpu_to_le32(ddrpage_size);
+	in->seed_dr0 = cpu_to_le32(seed_dr0);
+	in->seed_dr1 = cpu_to_le32(seed_dr1);
+	return cmd;
+}
+
 CXL_EXPORT int cxl_memdev_fbist_test_randomsequence(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 phase_nr, u64 start_address, u64 num_bytes, u32 ddrpage_size,
 	u32 seed_dr0, u32 seed_dr1)
@@ -9002,7 +13042,7 @@ CXL_EXPORT int cxl_memdev_fbist_test_randomsequence(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_FBIST_TEST_RANDOMSEQUENCE_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -9080,7 +13120,7 @@ CXL_EXPORT int cxl_memdev_conf_read(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_CONF_READ_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -9134,6 +13174,82 @@ out:
 	return 0;
 }
 
+
+/**
+ * cxl_memdev_conf_read_range - read a span of config space into @buf
+ * @memdev: memory device
+ * @offset: dword aligned start offset
+ * @length: number of bytes, a multiple of 4
+ * @buf: destination, at least @length bytes
+ *
+ * One command is built and resubmitted for each payload sized chunk,
+ * with the device writing straight into @buf.
+ */
+CXL_EXPORT int cxl_memdev_conf_read_range(struct cxl_memdev *memdev,
+	u32 offset, u32 length, void *buf)
+{
+	struct cxl_mbox_conf_read_in *in;
+	u32 chunk, done;
+	struct cxl_cmd *cmd;
+	int rc = 0;
+
+	if ((offset | length) & 3 || offset + length > CXL_CONF_SPACE_SIZE
+			|| offset + length < offset)
+		return -EINVAL;
+
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_CONF_READ_OPCODE,
+			CXL_MEM_COMMAND_ID_CONF_READ_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return -errno;
+	in = (void *) cmd->send_cmd->in.payload;
+	chunk = memdev_payload_max(memdev) & ~3;
+
+	for (done = 0; done < length && rc == 0; done += chunk) {
+		chunk = min_t(u32, chunk, length - done);
+		in->offset = cpu_to_le32(offset + done);
+		in->length = cpu_to_le32(chunk);
+		rc = cxl_cmd_set_output_payload(cmd, (u8 *) buf + done, chunk);
+		if (rc == 0)
+			rc = cxl_media_submit(cmd);
+		if (rc == 0 && (u32) cmd->send_cmd->out.size != chunk)
+			rc = -EIO;
+	}
+
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+/**
+ * cxl_memdev_get_conf_space - whole extended config space image
+ * @memdev: memory device
+ *
+ * Read once per context and kept, so repeated dumps of a device within
+ * a run cost no further mailbox traffic. The image is
+ * CXL_CONF_SPACE_SIZE bytes.
+ */
+CXL_EXPORT const void *cxl_memdev_get_conf_space(struct cxl_memdev *memdev)
+{
+	void *image;
+	int rc;
+
+	image = __atomic_load_n(&memdev->conf_space, __ATOMIC_ACQUIRE);
+	if (image)
+		return image;
+
+	image = malloc(CXL_CONF_SPACE_SIZE);
+	if (!image) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	rc = cxl_memdev_conf_read_range(memdev, 0, CXL_CONF_SPACE_SIZE, image);
+	if (rc) {
+		free(image);
+		errno = -rc;
+		return NULL;
+	}
+	return cxl_publish(&memdev->conf_space, image, free);
+}
+
 #define CXL_MEM_COMMAND_ID_HCT_GET_CONFIG CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_HCT_GET_CONFIG_OPCODE 50689
 #define CXL_MEM_COMMAND_ID_HCT_GET_CONFIG_PAYLOAD_IN_SIZE 1
@@ -9177,7 +13293,7 @@ CXL_EXPORT int cxl_memdev_hct_get_config(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_HCT_GET_CONFIG_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -9228,92 +13344,88 @@ out:
 #define CXL_MEM_COMMAND_ID_HCT_READ_BUFFER CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_OPCODE 50693
 #define CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_PAYLOAD_IN_SIZE 2
-#define CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_PAYLOAD_OUT_SIZE 1024
+#define CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_PAYLOAD_OUT_SIZE 4
 
-struct cxl_mbox_hct_read_buffer_in {
-	u8 hct_inst;
-	u8 num_entries_to_read;
-}  __attribute__((packed));
+static const struct cxl_vendor_field hct_read_buffer_in_fields[] = {
+	{ .offset = 0x00, .width = 1 },
+	{ .offset = 0x01, .width = 1 },
+};
 
-struct cxl_mbox_hct_read_buffer_out {
-	u8 buf_end;
-	u8 num_buf_entries;
-	__le16 rsvd;
-	__le32 buf_entry[1024];
-}  __attribute__((packed));
+/* as many entries as the device says it returned, not a fixed 1024 */
+static const struct cxl_vendor_field hct_read_buffer_out_fields[] = {
+	{ .name = "Buffer End Reached", .offset = 0x00, .width = 1 },
+	{ .name = "Number of buffer entries", .offset = 0x01, .width = 1 },
+	{ .name = "Buffer Entries", .mn = "buf_entry", .offset = 0x04,
+	  .width = 4, .count_offset = 0x01, .count_width = 1,
+	  .flags = CXL_VF_VARIABLE },
+};
+
+static const struct cxl_vendor_stream hct_read_buffer_stream = {
+	.data = 2,
+	.end = 0,
+	.index = -1,
+	.count = -1,
+};
+
+static const struct cxl_vendor_cmd hct_read_buffer_cmd = {
+	.title = "read hif/cxl trace buffer",
+	.opcode = CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_OPCODE,
+	.size_in = CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_PAYLOAD_IN_SIZE,
+	.in = hct_read_buffer_in_fields,
+	.nr_in = ARRAY_SIZE(hct_read_buffer_in_fields),
+	.size_out = CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_PAYLOAD_OUT_SIZE,
+	.out = hct_read_buffer_out_fields,
+	.nr_out = ARRAY_SIZE(hct_read_buffer_out_fields),
+	.stream = &hct_read_buffer_stream,
+};
 
 CXL_EXPORT int cxl_memdev_hct_read_buffer(struct cxl_memdev *memdev,
 	u8 hct_inst, u8 num_entries_to_read)
 {
-	u8 *buf_out;
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_hct_read_buffer_in *hct_read_buffer_in;
-	struct cxl_mbox_hct_read_buffer_out *hct_read_buffer_out;
-	int rc = 0;
-
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_HCT_READ_BUFFER_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	const u64 args[] = { hct_inst, num_entries_to_read };
 
-	hct_read_buffer_in = (void *) cmd->send_cmd->in.payload;
-
-	hct_read_buffer_in->hct_inst = hct_inst;
-	hct_read_buffer_in->num_entries_to_read = num_entries_to_read;
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+	return cxl_memdev_vendor_cmd(memdev, &hct_read_buffer_cmd, args);
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
-		rc = -ENXIO;
-		goto out;
-	}
+/*
+ * Reusable HCT read-buffer command for callers that poll the trace
+ * buffer in a loop and want the raw entries rather than a hex dump.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_hct_read_buffer(struct cxl_memdev *memdev,
+		u8 hct_inst, u8 num_entries_to_read)
+{
+	const u64 args[] = { hct_inst, num_entries_to_read };
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_HCT_READ_BUFFER) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_HCT_READ_BUFFER);
-		return -EINVAL;
-	}
+	return cxl_vendor_cmd_new(memdev, &hct_read_buffer_cmd, args);
+}
 
-	hct_read_buffer_out = (void *)cmd->send_cmd->out.payload;
-	fprintf(stdout, "========================== read hif/cxl trace buffer ===========================\n");
-	fprintf(stdout, "Buffer End Reached: %x\n", hct_read_buffer_out->buf_end);
-	fprintf(stdout, "Number of buffer entries: %x\n", hct_read_buffer_out->num_buf_entries);
+CXL_EXPORT int cxl_cmd_hct_read_buffer_get_buf_end(struct cxl_cmd *cmd)
+{
+	cmd_vendor_get_field(cmd, &hct_read_buffer_cmd, 0);
+}
 
-	buf_out = (u8*) cmd->send_cmd->out.payload;
-	fprintf(stdout, "Buffer Entries:\n");
-	for(int i=4; i<cmd->send_cmd->out.size; i++){
-		fprintf(stdout, "%02x ", buf_out[i]);
-	}
-	fprintf(stdout, "\n");
+/*
+ * Number of entries returned, clamped to what the output payload
+ * actually holds. *@entries points at them in device (little endian)
+ * order and stays valid until the command is resubmitted or freed.
+ */
+CXL_EXPORT int cxl_cmd_hct_read_buffer_get_entries(struct cxl_cmd *cmd,
+		const u32 **entries)
+{
+	return cxl_vendor_cmd_view(cmd, &hct_read_buffer_cmd, 2,
+			(const void **) entries);
+}
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
-	return 0;
+/*
+ * Drain the trace buffer: submit @cmd again and view the entries it
+ * returned, as cxl_cmd_hct_read_buffer_get_entries() does. 0 once the
+ * device reports the end of the buffer.
+ */
+CXL_EXPORT int cxl_cmd_hct_read_buffer_next(struct cxl_cmd *cmd,
+		const u32 **entries)
+{
+	return cxl_vendor_cmd_next(cmd, &hct_read_buffer_cmd,
+			(const void **) entries);
 }
 
 #define CXL_MEM_COMMAND_ID_HCT_SET_CONFIG CXL_MEM_COMMAND_ID_RAW
@@ -9355,7 +13467,7 @@ CXL_EXPORT int cxl_memdev_hct_set_config(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = HCT_SET_CONFIG_FIXED_PAYLOAD_IN_SIZE + size;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -9436,7 +13548,7 @@ CXL_EXPORT int cxl_memdev_osa_os_patt_trig_cfg(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_OS_PATT_TRIG_CFG_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -9520,7 +13632,7 @@ CXL_EXPORT int cxl_memdev_osa_misc_trig_cfg(struct cxl_memdev *memdev,
 	/* update payload size */
 	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_MISC_TRIG_CFG_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
+		 cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -9590,31 +13702,22 @@ CXL_EXPORT int cxl_memdev_osa_data_read(struct cxl_memdev *memdev,
 	u8 cxl_mem_id, u8 lane_id, u8 lane_dir, u16 start_entry, u8 num_entries)
 {
 	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
 	struct cxl_mbox_osa_data_read_in *osa_data_read_in;
 	struct cxl_mbox_osa_data_read_out *osa_data_read_out;
-	int rc = 0;
+	const u32 *data;
+	int nr, rc = 0;
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_OSA_DATA_READ_OPCODE);
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_OSA_DATA_READ_OPCODE,
+			CXL_MEM_COMMAND_ID_OSA_DATA_READ_PAYLOAD_IN_SIZE);
 	if (!cmd) {
 		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
 				cxl_memdev_get_devname(memdev));
 		return -ENOMEM;
 	}
-
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
-
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_OSA_DATA_READ_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+	cxl_cmd_vendor_limit_out(cmd, min_t(int,
+			offsetof(struct cxl_mbox_osa_data_read_out, data)
+			+ num_entries * sizeof(u32),
+			CXL_MEM_COMMAND_ID_OSA_DATA_READ_PAYLOAD_OUT_SIZE));
 
 	osa_data_read_in = (void *) cmd->send_cmd->in.payload;
 
@@ -9641,7 +13744,8 @@ CXL_EXPORT int cxl_memdev_osa_data_read(struct cxl_memdev *memdev,
 	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_OSA_DATA_READ) {
 		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
 				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_OSA_DATA_READ);
-		return -EINVAL;
+		rc = -EINVAL;
+		goto out;
 	}
 
 	osa_data_read_out = (void *)cmd->send_cmd->out.payload;
@@ -9654,9 +13758,9 @@ CXL_EXPORT int cxl_memdev_osa_data_read(struct cxl_memdev *memdev,
 	fprintf(stdout, "number of entries remaining: %x\n", le16_to_cpu(osa_data_read_out->entries_rem));
 	fprintf(stdout, "wrap indicator: %x\n", osa_data_read_out->wrap);
 	fprintf(stdout, "Data: \n");
-	for(int i=0; i<osa_data_read_out->entries_read;i++){
-		fprintf(stdout,"Entry %d: %x\n", i, le32_to_cpu(osa_data_read_out->data[i]));
-	}
+	nr = cxl_cmd_osa_data_read_get_entries(cmd, &data);
+	for (int i = 0; i < nr; i++)
+		fprintf(stdout, "Entry %d: %x\n", i, le32_to_cpu(data[i]));
 
 out:
 	cxl_cmd_unref(cmd);
@@ -9664,6 +13768,103 @@ out:
 	return 0;
 }
 
+/*
+ * Reusable OSA data read for callers that walk the analyzer buffer:
+ * point it at the next chunk with cxl_cmd_osa_data_read_set_start()
+ * and resubmit.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_osa_data_read(struct cxl_memdev *memdev,
+		u8 cxl_mem_id, u8 lane_id, u8 lane_dir, u8 num_entries)
+{
+	struct cxl_mbox_osa_data_read_in *osa_data_read_in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_OSA_DATA_READ_OPCODE,
+			CXL_MEM_COMMAND_ID_OSA_DATA_READ_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return NULL;
+
+	cxl_cmd_vendor_limit_out(cmd, min_t(int,
+			offsetof(struct cxl_mbox_osa_data_read_out, data)
+			+ num_entries * sizeof(u32),
+			CXL_MEM_COMMAND_ID_OSA_DATA_READ_PAYLOAD_OUT_SIZE));
+
+	osa_data_read_in = cmd->input_payload;
+	osa_data_read_in->cxl_mem_id = cxl_mem_id;
+	osa_data_read_in->lane_id = lane_id;
+	osa_data_read_in->lane_dir = lane_dir;
+	osa_data_read_in->num_entries = num_entries;
+	return cmd;
+}
+
+CXL_EXPORT int cxl_cmd_osa_data_read_set_start(struct cxl_cmd *cmd,
+		u16 start_entry)
+{
+	struct cxl_mbox_osa_data_read_in *osa_data_read_in = cmd->input_payload;
+
+	if (cxl_cmd_get_opcode(cmd) != CXL_MEM_COMMAND_ID_OSA_DATA_READ_OPCODE)
+		return -EINVAL;
+	osa_data_read_in->start_entry = cpu_to_le16(start_entry);
+	return 0;
+}
+
+static struct cxl_mbox_osa_data_read_out *
+cxl_cmd_osa_data_read_out(struct cxl_cmd *cmd)
+{
+	return cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_OSA_DATA_READ_OPCODE,
+			offsetof(struct cxl_mbox_osa_data_read_out, data));
+}
+
+CXL_EXPORT int cxl_cmd_osa_data_read_get_next_entry(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_osa_data_read_out *out = cxl_cmd_osa_data_read_out(cmd);
+
+	if (!out)
+		return -EINVAL;
+	return le16_to_cpu(out->next_entry);
+}
+
+CXL_EXPORT int cxl_cmd_osa_data_read_get_entries_rem(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_osa_data_read_out *out = cxl_cmd_osa_data_read_out(cmd);
+
+	if (!out)
+		return -EINVAL;
+	return le16_to_cpu(out->entries_rem);
+}
+
+CXL_EXPORT int cxl_cmd_osa_data_read_get_wrap(struct cxl_cmd *cmd)
+{
+	struct cxl_mbox_osa_data_read_out *out = cxl_cmd_osa_data_read_out(cmd);
+
+	if (!out)
+		return -EINVAL;
+	return out->wrap;
+}
+
+/*
+ * Number of entries read, clamped to what the output payload holds.
+ * *@entries points at them in device (little endian) order and stays
+ * valid until the command is resubmitted or freed.
+ */
+CXL_EXPORT int cxl_cmd_osa_data_read_get_entries(struct cxl_cmd *cmd,
+		const u32 **entries)
+{
+	struct cxl_mbox_osa_data_read_out *out = cxl_cmd_osa_data_read_out(cmd);
+	int nr, max;
+
+	if (!out)
+		return -EINVAL;
+
+	max = (cmd->send_cmd->out.size
+			- offsetof(struct cxl_mbox_osa_data_read_out, data))
+			/ sizeof(out->data[0]);
+	nr = min(out->entries_read, max);
+	*entries = (const u32 *) out->data;
+	return nr;
+}
+
 #define CXL_MEM_COMMAND_ID_DIMM_SPD_READ CXL_MEM_COMMAND_ID_RAW
 #define CXL_MEM_COMMAND_ID_DIMM_SPD_READ_OPCODE 50448
 #define CXL_MEM_COMMAND_ID_DIMM_SPD_READ_PAYLOAD_IN_SIZE 12
@@ -9801,113 +14002,264 @@ static int decode_ram_type(u8 *bytes) {
         }
     }
 
-    return UNKNOWN;
+    return UNKNOWN;
+}
+
+static const char *ram_types[] = {"Unknown",   "Direct Rambus",    "Rambus",     "FPM DRAM",
+                                  "EDO",       "Pipelined Nibble", "SDR SDRAM",  "Multiplexed ROM",
+                                  "DDR SGRAM", "DDR SDRAM",        "DDR2", "DDR3",
+                                  "DDR4"};
+
+static int cxl_spd_cache_path(struct cxl_memdev *memdev, u32 spd_id,
+		char *path, size_t len)
+{
+	const char *dir = memdev->ctx->spd_cache_dir;
+	unsigned long long serial;
+
+	if (!dir)
+		return -ENOENT;
+	/* without a serial number there is nothing stable to key on */
+	serial = cxl_memdev_get_serial(memdev);
+	if (serial == ULLONG_MAX || serial == 0)
+		return -ENOENT;
+	if (snprintf(path, len, "%s/%llx-%u.spd", dir, serial, spd_id)
+			>= (int) len)
+		return -ENAMETOOLONG;
+	return 0;
+}
+
+static int cxl_spd_load(struct cxl_spd *spd)
+{
+	char path[PATH_MAX];
+	ssize_t rc;
+	int fd;
+
+	if (cxl_spd_cache_path(spd->memdev, spd->spd_id, path, sizeof(path)))
+		return -ENOENT;
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	rc = read(fd, spd->data, sizeof(spd->data));
+	close(fd);
+	if (rc != sizeof(spd->data))
+		return -EINVAL;
+	return 0;
+}
+
+/* write via a temporary file so concurrent readers never see a partial image */
+static void cxl_spd_save(struct cxl_spd *spd)
+{
+	struct cxl_ctx *ctx = spd->memdev->ctx;
+	char path[PATH_MAX], tmp[PATH_MAX + 8];
+	ssize_t rc;
+	int fd;
+
+	if (cxl_spd_cache_path(spd->memdev, spd->spd_id, path, sizeof(path)))
+		return;
+	if (mkdir(ctx->spd_cache_dir, 0755) < 0 && errno != EEXIST)
+		return;
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return;
+	rc = write(fd, spd->data, sizeof(spd->data));
+	close(fd);
+	if (rc != sizeof(spd->data) || rename(tmp, path) < 0) {
+		dbg(ctx, "%s: failed to save SPD to %s\n",
+				cxl_memdev_get_devname(spd->memdev), path);
+		unlink(tmp);
+	}
+}
+
+static int cxl_spd_read(struct cxl_spd *spd)
+{
+	struct cxl_mbox_dimm_spd_read_in *dimm_spd_read_in;
+	struct cxl_cmd *cmd;
+	u32 offset, len;
+	int rc = 0;
+
+	cmd = cxl_cmd_new_vendor(spd->memdev,
+			CXL_MEM_COMMAND_ID_DIMM_SPD_READ_OPCODE,
+			CXL_MEM_COMMAND_ID_DIMM_SPD_READ_PAYLOAD_IN_SIZE);
+	if (!cmd)
+		return -ENOMEM;
+
+	dimm_spd_read_in = cmd->input_payload;
+	dimm_spd_read_in->spd_id = cpu_to_le32(spd->spd_id);
+	for (offset = 0; offset < CXL_SPD_SIZE; offset += len) {
+		len = min_t(u32, CXL_SPD_SIZE - offset, cmd->out_size);
+		dimm_spd_read_in->offset = cpu_to_le32(offset);
+		dimm_spd_read_in->num_bytes = cpu_to_le32(len);
+		rc = cxl_cmd_vendor_submit(cmd);
+		if (rc)
+			break;
+		if (cmd->send_cmd->out.size < (int) len) {
+			rc = -EIO;
+			break;
+		}
+		memcpy(&spd->data[offset], (void *) cmd->send_cmd->out.payload,
+				len);
+	}
+
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+static struct cxl_spd *cxl_spd_cache_find(struct cxl_memdev *memdev,
+		u32 spd_id)
+{
+	struct cxl_spd *spd, *found = NULL;
+
+	pthread_mutex_lock(&memdev->ctx->init_lock);
+	list_for_each(&memdev->spd_cache, spd, list)
+		if (spd->spd_id == spd_id) {
+			found = spd;
+			break;
+		}
+	pthread_mutex_unlock(&memdev->ctx->init_lock);
+	return found;
+}
+
+/**
+ * cxl_memdev_get_spd - SPD contents of one DIMM behind a memdev
+ * @memdev: memory device
+ * @spd_id: DIMM index
+ *
+ * The first call per DIMM reads the whole SPD over the mailbox, or from
+ * the cxl_set_spd_cache_dir() cache when present; later calls return the
+ * same object until the memdev is re-enumerated. Returns NULL with errno
+ * set on failure.
+ */
+CXL_EXPORT struct cxl_spd *cxl_memdev_get_spd(struct cxl_memdev *memdev,
+		u32 spd_id)
+{
+	struct cxl_spd *spd, *dup;
+	int rc;
+
+	spd = cxl_spd_cache_find(memdev, spd_id);
+	if (spd)
+		return spd;
+
+	spd = calloc(1, sizeof(*spd));
+	if (!spd) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	spd->memdev = memdev;
+	spd->spd_id = spd_id;
+
+	if (cxl_spd_load(spd) < 0) {
+		rc = cxl_spd_read(spd);
+		if (rc) {
+			free(spd);
+			errno = -rc;
+			return NULL;
+		}
+		cxl_spd_save(spd);
+	}
+	IntToString((u8 *) spd->serial, &spd->data[325],
+			SPD_MODULE_SERIAL_NUMBER_LEN);
+
+	/* the mailbox read runs unlocked, another thread may have won */
+	pthread_mutex_lock(&memdev->ctx->init_lock);
+	dup = cxl_spd_cache_find(memdev, spd_id);
+	if (dup) {
+		free(spd);
+		spd = dup;
+	} else
+		list_add_tail(&memdev->spd_cache, &spd->list);
+	pthread_mutex_unlock(&memdev->ctx->init_lock);
+	return spd;
 }
 
-static const char *ram_types[] = {"Unknown",   "Direct Rambus",    "Rambus",     "FPM DRAM",
-                                  "EDO",       "Pipelined Nibble", "SDR SDRAM",  "Multiplexed ROM",
-                                  "DDR SGRAM", "DDR SDRAM",        "DDR2", "DDR3",
-                                  "DDR4"};
+CXL_EXPORT const void *cxl_spd_get_data(struct cxl_spd *spd, size_t *len)
+{
+	*len = sizeof(spd->data);
+	return spd->data;
+}
 
-CXL_EXPORT int cxl_memdev_dimm_spd_read(struct cxl_memdev *memdev,
-	u32 spd_id, u32 offset, u32 num_bytes)
+CXL_EXPORT const char *cxl_spd_get_ram_type(struct cxl_spd *spd)
 {
-	struct cxl_cmd *cmd;
-	struct cxl_mem_query_commands *query;
-	struct cxl_command_info *cinfo;
-	struct cxl_mbox_dimm_spd_read_in *dimm_spd_read_in;
-	u8 *dimm_spd_read_out;
-	u8 serial[9];
-	int rc = 0;
-	int buswidth;
-	RamType ram_type;
+	return ram_types[decode_ram_type(spd->data)];
+}
 
-	cmd = cxl_cmd_new_raw(memdev, CXL_MEM_COMMAND_ID_DIMM_SPD_READ_OPCODE);
-	if (!cmd) {
-		fprintf(stderr, "%s: cxl_cmd_new_raw returned Null output\n",
-				cxl_memdev_get_devname(memdev));
-		return -ENOMEM;
-	}
+CXL_EXPORT const char *cxl_spd_get_module_type(struct cxl_spd *spd)
+{
+	return decode_ddr4_module_type(spd->data);
+}
 
-	query = cmd->query_cmd;
-	cinfo = &query->commands[cmd->query_idx];
+CXL_EXPORT int cxl_spd_get_data_width(struct cxl_spd *spd)
+{
+	return 8 << (spd->data[13] & 7);
+}
 
-	/* update payload size */
-	cinfo->size_in = CXL_MEM_COMMAND_ID_DIMM_SPD_READ_PAYLOAD_IN_SIZE;
-	if (cinfo->size_in > 0) {
-		 cmd->input_payload = calloc(1, cinfo->size_in);
-		if (!cmd->input_payload)
-			return -ENOMEM;
-		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
-		cmd->send_cmd->in.size = cinfo->size_in;
-	}
+CXL_EXPORT int cxl_spd_get_size_gb(struct cxl_spd *spd)
+{
+	return decode_ddr4_module_size(spd->data);
+}
 
-	dimm_spd_read_in = (void *) cmd->send_cmd->in.payload;
+CXL_EXPORT int cxl_spd_get_speed(struct cxl_spd *spd)
+{
+	return decode_ddr4_module_speed(spd->data);
+}
 
-	dimm_spd_read_in->spd_id = cpu_to_le32(spd_id);
-	dimm_spd_read_in->offset = cpu_to_le32(offset);
-	dimm_spd_read_in->num_bytes = cpu_to_le32(num_bytes);
-	rc = cxl_cmd_submit(cmd);
-	if (rc < 0) {
-		fprintf(stderr, "%s: cmd submission failed: %d (%s)\n",
-				cxl_memdev_get_devname(memdev), rc, strerror(-rc));
-		 goto out;
-	}
+CXL_EXPORT const char *cxl_spd_get_manufacturer(struct cxl_spd *spd)
+{
+	return decode_ddr4_manufacturer(spd->data);
+}
 
-	rc = cxl_cmd_get_mbox_status(cmd);
-	if (rc != 0) {
-		fprintf(stderr, "%s: firmware status: %d\n",
-				cxl_memdev_get_devname(memdev), rc);
-		rc = -ENXIO;
-		goto out;
-	}
+CXL_EXPORT const char *cxl_spd_get_serial(struct cxl_spd *spd)
+{
+	return spd->serial;
+}
 
-	if (cmd->send_cmd->id != CXL_MEM_COMMAND_ID_DIMM_SPD_READ) {
-		 fprintf(stderr, "%s: invalid command id 0x%x (expecting 0x%x)\n",
-				cxl_memdev_get_devname(memdev), cmd->send_cmd->id, CXL_MEM_COMMAND_ID_DIMM_SPD_READ);
+CXL_EXPORT int cxl_memdev_dimm_spd_read(struct cxl_memdev *memdev,
+	u32 spd_id, u32 offset, u32 num_bytes)
+{
+	struct cxl_spd *spd;
+	const u8 *data;
+
+	if (offset >= CXL_SPD_SIZE || num_bytes > CXL_SPD_SIZE - offset) {
+		fprintf(stderr, "%s: SPD range must be within %d bytes\n",
+				cxl_memdev_get_devname(memdev), CXL_SPD_SIZE);
 		return -EINVAL;
 	}
 
-	dimm_spd_read_out = (u8*)cmd->send_cmd->out.payload;
-	ram_type = decode_ram_type(dimm_spd_read_out);
+	spd = cxl_memdev_get_spd(memdev, spd_id);
+	if (!spd) {
+		fprintf(stderr, "%s: SPD read failed: %s\n",
+				cxl_memdev_get_devname(memdev), strerror(errno));
+		return -errno;
+	}
+	data = spd->data + offset;
 
 	fprintf(stdout, "=========================== DIMM SPD READ Data ============================\n");
 	fprintf(stdout, "Output Payload:");
-	for(int i=0; i<cmd->send_cmd->out.size; i++){
+	for (u32 i = 0; i < num_bytes; i++) {
 		if (i % 16 == 0)
-		{
-			fprintf(stdout, "\n%04x  %02x ", i+offset, dimm_spd_read_out[i]);
-		}
+			fprintf(stdout, "\n%04x  %02x ", i + offset, data[i]);
 		else
-		{
-			fprintf(stdout, "%02x ", dimm_spd_read_out[i]);
-		}
+			fprintf(stdout, "%02x ", data[i]);
 	}
 	fprintf(stdout, "\n\n");
 
 	// Decoding SPD data for only DDR4 SDRAM.
 
-	buswidth = 8 << (dimm_spd_read_out[13] & 7);
-
 	fprintf(stdout, "\n\n====== DIMM SPD DECODE ============\n");
 	fprintf(stdout, "Total Width: %s\n", "TBD");
-	fprintf(stdout, "Data Width: %d bits\n", buswidth);
-	fprintf(stdout, "Size: %d GB\n", decode_ddr4_module_size(dimm_spd_read_out));
+	fprintf(stdout, "Data Width: %d bits\n", cxl_spd_get_data_width(spd));
+	fprintf(stdout, "Size: %d GB\n", cxl_spd_get_size_gb(spd));
 	fprintf(stdout, "Form Factor: %s\n", "TBD");
 	fprintf(stdout, "Set: %s\n", "TBD");
 	fprintf(stdout, "Locator: %s\n", "DIMM_X");
 	fprintf(stdout, "Bank Locator: %s\n", "_Node1_ChannelX_DimmX");
-	fprintf(stdout, "Type: %s\n", ram_types[ram_type]);
-	fprintf(stdout, "Type Detail: %s\n", decode_ddr4_module_type(dimm_spd_read_out));
-	fprintf(stdout, "Speed: %d MT/s\n", decode_ddr4_module_speed(dimm_spd_read_out));
-	fprintf(stdout, "Manufacturer: %s\n", decode_ddr4_manufacturer(dimm_spd_read_out));
-	IntToString(serial, &dimm_spd_read_out[325], SPD_MODULE_SERIAL_NUMBER_LEN);
-	fprintf(stdout, "Serial Number: %s\n", serial);
+	fprintf(stdout, "Type: %s\n", cxl_spd_get_ram_type(spd));
+	fprintf(stdout, "Type Detail: %s\n", cxl_spd_get_module_type(spd));
+	fprintf(stdout, "Speed: %d MT/s\n", cxl_spd_get_speed(spd));
+	fprintf(stdout, "Manufacturer: %s\n", cxl_spd_get_manufacturer(spd));
+	fprintf(stdout, "Serial Number: %s\n", cxl_spd_get_serial(spd));
 	fprintf(stdout, "Asset Tag: %s\n", "TBD");
 
-out:
-	cxl_cmd_unref(cmd);
-	return rc;
 	return 0;
 }
 
@@ -9939,7 +14291,7 @@ CXL_EXPORT int cxl_memdev_ddr_training_status(struct cxl_memdev *memdev)
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_LOG_INFO_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -9949,7 +14301,7 @@ CXL_EXPORT int cxl_memdev_ddr_training_status(struct cxl_memdev *memdev)
 	get_log_input = (void *) cmd->send_cmd->in.payload;
 	uuid_parse(DDR_TRAINING_STATUS_UUID, get_log_input->uuid);
 	get_log_input->offset = 0;
-	get_log_input->length = cmd->memdev->payload_max;
+	get_log_input->length = memdev_payload_max(cmd->memdev);
 
 
 	rc = cxl_cmd_submit(cmd);
@@ -9992,6 +14344,34 @@ out:
 	return rc;
 }
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_ddr_training_status(
+		struct cxl_memdev *memdev)
+{
+	struct cxl_mbox_get_log *in;
+	struct cxl_cmd *cmd;
+
+	cmd = cxl_cmd_new_vendor(memdev, CXL_MEM_COMMAND_ID_LOG_INFO_OPCODE,
+			sizeof(*in));
+	if (!cmd)
+		return NULL;
+	in = (void *) cmd->send_cmd->in.payload;
+	uuid_parse(DDR_TRAINING_STATUS_UUID, in->uuid);
+	in->offset = 0;
+	in->length = cpu_to_le32(memdev_payload_max(memdev));
+	return cmd;
+}
+
+/* the training status log as returned, its layout is firmware specific */
+CXL_EXPORT int cxl_cmd_ddr_training_status_get_data(struct cxl_cmd *cmd,
+		const u8 **data)
+{
+	*data = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_LOG_INFO_OPCODE, 0);
+	if (!*data)
+		return -EINVAL;
+	return cmd->send_cmd->out.size;
+}
+
 struct cxl_dimm_slot_info_out {
 	u8 num_dimm_slots;
 	u8 rsvd[3];
@@ -10045,7 +14425,7 @@ CXL_EXPORT int cxl_memdev_dimm_slot_info(struct cxl_memdev *memdev)
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_LOG_INFO_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -10124,6 +14504,374 @@ out:
 	return rc;
 }
 
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_dimm_slot_info(
+		struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_DIMM_SLOT_INFO_OPCODE, 0);
+}
+
+CXL_EXPORT int cxl_cmd_dimm_slot_info_get_nr_slots(struct cxl_cmd *cmd)
+{
+	struct cxl_dimm_slot_info_out *o = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_DIMM_SLOT_INFO_OPCODE, sizeof(*o));
+
+	if (!o)
+		return -EINVAL;
+	return min_t(int, o->num_dimm_slots, CXL_DIMM_SLOT_MAX);
+}
+
+CXL_EXPORT int cxl_cmd_dimm_slot_info_get_slot(struct cxl_cmd *cmd, int slot,
+		struct cxl_dimm_slot *d)
+{
+	struct cxl_dimm_slot_info_out *o = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_DIMM_SLOT_INFO_OPCODE, sizeof(*o));
+	/* the four slot descriptors are 16 bytes apart */
+	const u8 *desc;
+
+	if (!o || slot < 0 || slot >= CXL_DIMM_SLOT_MAX)
+		return -EINVAL;
+	desc = &o->slot0_spd_i2c_addr + slot * 16;
+	d->spd_addr = desc[0];
+	d->channel = desc[1];
+	d->silk_screen = desc[2];
+	d->present = desc[3];
+	return 0;
+}
+
+/*
+ * Static identity of a memdev, see cxl_memdev_get_inventory(). The
+ * cache file is this structure verbatim; @fw_version is the sysfs
+ * firmware_version the responses were read under.
+ */
+#define CXL_INVENTORY_MAGIC "CXLINV\0\0"
+#define CXL_INVENTORY_VERSION 1
+#define CXL_CAPACITY_MULTIPLIER (256ULL * 1024 * 1024)
+#define CXL_INVENTORY_NR_DIMM_SLOTS 4
+
+struct cxl_inventory {
+	char magic[8];
+	__le32 version;
+	__le32 rsvd;
+	char fw_version[32];
+	struct cxl_cmd_identify identify;
+	struct cxl_mbox_device_info_get_out device_info;
+	struct cxl_mbox_get_fw_info_out fw_info;
+	struct cxl_dimm_slot_info_out dimm_slot_info;
+} __attribute__((packed));
+
+static int cxl_inventory_cache_path(struct cxl_memdev *memdev, char *path,
+		size_t len)
+{
+	const char *dir = memdev->ctx->inventory_cache_dir;
+	unsigned long long serial;
+
+	if (!dir)
+		return -ENOENT;
+	serial = cxl_memdev_get_serial(memdev);
+	if (serial == ULLONG_MAX || serial == 0)
+		return -ENOENT;
+	if (snprintf(path, len, "%s/%llx.bin", dir, serial) >= (int) len)
+		return -ENAMETOOLONG;
+	return 0;
+}
+
+static void cxl_memdev_inventory_flush(struct cxl_memdev *memdev,
+		bool remove_file)
+{
+	char path[PATH_MAX];
+
+	free(memdev->inventory);
+	memdev->inventory = NULL;
+	if (!remove_file)
+		return;
+
+	/* activation may change what sysfs reports once the driver re-reads it */
+	free(memdev->firmware_version);
+	memdev->firmware_version = NULL;
+	memdev_clear_attr(memdev, CXL_MEMDEV_ATTR_FW_VERSION);
+	if (cxl_inventory_cache_path(memdev, path, sizeof(path)) == 0)
+		unlink(path);
+}
+
+static int cxl_inventory_load(struct cxl_memdev *memdev,
+		struct cxl_inventory *inv, const char *fw_version)
+{
+	char path[PATH_MAX];
+	ssize_t rc;
+	int fd;
+
+	if (cxl_inventory_cache_path(memdev, path, sizeof(path)))
+		return -ENOENT;
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	rc = read(fd, inv, sizeof(*inv));
+	close(fd);
+	if (rc != sizeof(*inv)
+			|| memcmp(inv->magic, CXL_INVENTORY_MAGIC,
+				sizeof(inv->magic)) != 0
+			|| le32_to_cpu(inv->version) != CXL_INVENTORY_VERSION)
+		return -EINVAL;
+	if (strncmp(inv->fw_version, fw_version, sizeof(inv->fw_version)))
+		return -ESTALE;
+	return 0;
+}
+
+/* write via a temporary file so concurrent readers never see a partial file */
+static void cxl_inventory_save(struct cxl_memdev *memdev,
+		struct cxl_inventory *inv)
+{
+	struct cxl_ctx *ctx = memdev->ctx;
+	char path[PATH_MAX], tmp[PATH_MAX + 8];
+	ssize_t rc;
+	int fd;
+
+	if (cxl_inventory_cache_path(memdev, path, sizeof(path)))
+		return;
+	if (mkdir(ctx->inventory_cache_dir, 0755) < 0 && errno != EEXIST)
+		return;
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return;
+	rc = write(fd, inv, sizeof(*inv));
+	close(fd);
+	if (rc != sizeof(*inv) || rename(tmp, path) < 0) {
+		dbg(ctx, "%s: failed to save inventory to %s\n",
+				cxl_memdev_get_devname(memdev), path);
+		unlink(tmp);
+	}
+}
+
+/* submit @cmd and copy out as much of the response as @buf holds */
+static int cxl_inventory_fetch(struct cxl_cmd *cmd, void *buf, size_t size)
+{
+	int rc;
+
+	if (!cmd)
+		return -ENOMEM;
+	rc = cxl_cmd_vendor_submit(cmd);
+	if (rc == 0)
+		memcpy(buf, (void *) cmd->send_cmd->out.payload,
+				min_t(size_t, size, cmd->send_cmd->out.size));
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+static int cxl_inventory_read(struct cxl_memdev *memdev,
+		struct cxl_inventory *inv)
+{
+	int rc;
+
+	rc = cxl_inventory_fetch(cxl_cmd_new_identify(memdev),
+			&inv->identify, sizeof(inv->identify));
+	if (rc)
+		return rc;
+	rc = cxl_inventory_fetch(cxl_cmd_new_vendor(memdev,
+				CXL_MEM_COMMAND_ID_DEVICE_INFO_GET_OPCODE, 0),
+			&inv->device_info, sizeof(inv->device_info));
+	if (rc)
+		return rc;
+	rc = cxl_inventory_fetch(cxl_cmd_new_vendor(memdev,
+				CXL_MEM_COMMAND_ID_GET_FW_INFO_OPCODE, 0),
+			&inv->fw_info, sizeof(inv->fw_info));
+	if (rc)
+		return rc;
+	return cxl_inventory_fetch(cxl_cmd_new_vendor(memdev,
+				CXL_MEM_COMMAND_ID_DIMM_SLOT_INFO_OPCODE, 0),
+			&inv->dimm_slot_info, sizeof(inv->dimm_slot_info));
+}
+
+/**
+ * cxl_memdev_get_inventory - identify, device, firmware and DIMM slot info
+ * @memdev: memory device
+ *
+ * The first call issues the four mailbox commands, or loads their
+ * responses from the cxl_set_inventory_cache_dir() cache when it was
+ * written under the current sysfs firmware_version; later calls return
+ * the same object until the memdev is re-enumerated or firmware is
+ * activated. Returns NULL with errno set on failure.
+ */
+CXL_EXPORT struct cxl_inventory *cxl_memdev_get_inventory(
+		struct cxl_memdev *memdev)
+{
+	const char *fw_version;
+	struct cxl_inventory *inv;
+	int rc;
+
+	inv = __atomic_load_n(&memdev->inventory, __ATOMIC_ACQUIRE);
+	if (inv)
+		return inv;
+
+	fw_version = cxl_memdev_get_firmware_verison(memdev);
+	if (!fw_version)
+		fw_version = "";
+	inv = calloc(1, sizeof(*inv));
+	if (!inv) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if (cxl_inventory_load(memdev, inv, fw_version) < 0) {
+		memset(inv, 0, sizeof(*inv));
+		rc = cxl_inventory_read(memdev, inv);
+		if (rc) {
+			free(inv);
+			errno = -rc;
+			return NULL;
+		}
+		memcpy(inv->magic, CXL_INVENTORY_MAGIC, sizeof(inv->magic));
+		inv->version = cpu_to_le32(CXL_INVENTORY_VERSION);
+		strncpy(inv->fw_version, fw_version, sizeof(inv->fw_version));
+		cxl_inventory_save(memdev, inv);
+	}
+
+	return cxl_publish(&memdev->inventory, inv, free);
+}
+
+CXL_EXPORT int cxl_inventory_get_fw_rev(struct cxl_inventory *inv,
+		char *fw_rev, int fw_len)
+{
+	if (fw_len <= 0)
+		return -EINVAL;
+	memset(fw_rev, 0, fw_len);
+	memcpy(fw_rev, inv->identify.fw_revision,
+		min(fw_len - 1, CXL_CMD_IDENTIFY_FW_REV_LENGTH));
+	return 0;
+}
+
+CXL_EXPORT unsigned long long cxl_inventory_get_total_capacity(
+		struct cxl_inventory *inv)
+{
+	return le64_to_cpu(inv->identify.total_capacity)
+		* CXL_CAPACITY_MULTIPLIER;
+}
+
+CXL_EXPORT unsigned long long cxl_inventory_get_volatile_capacity(
+		struct cxl_inventory *inv)
+{
+	return le64_to_cpu(inv->identify.volatile_capacity)
+		* CXL_CAPACITY_MULTIPLIER;
+}
+
+CXL_EXPORT unsigned long long cxl_inventory_get_persistent_capacity(
+		struct cxl_inventory *inv)
+{
+	return le64_to_cpu(inv->identify.persistent_capacity)
+		* CXL_CAPACITY_MULTIPLIER;
+}
+
+CXL_EXPORT int cxl_inventory_get_device_id(struct cxl_inventory *inv)
+{
+	return le16_to_cpu(inv->device_info.device_id);
+}
+
+CXL_EXPORT int cxl_inventory_get_device_rev(struct cxl_inventory *inv)
+{
+	return inv->device_info.device_rev;
+}
+
+CXL_EXPORT int cxl_inventory_get_chipinfo_rel_major(struct cxl_inventory *inv)
+{
+	return inv->device_info.chipinfo_rel_major;
+}
+
+CXL_EXPORT int cxl_inventory_get_chipinfo_rel_minor(struct cxl_inventory *inv)
+{
+	return inv->device_info.chipinfo_rel_minor;
+}
+
+CXL_EXPORT int cxl_inventory_get_configfile_ver_major(
+		struct cxl_inventory *inv)
+{
+	return inv->device_info.configfile_ver_major;
+}
+
+CXL_EXPORT int cxl_inventory_get_configfile_ver_minor(
+		struct cxl_inventory *inv)
+{
+	return le16_to_cpu(inv->device_info.configfile_ver_minor);
+}
+
+CXL_EXPORT int cxl_inventory_get_fw_slots_supported(struct cxl_inventory *inv)
+{
+	return inv->fw_info.fw_slots_supp;
+}
+
+CXL_EXPORT int cxl_inventory_get_active_fw_slot(struct cxl_inventory *inv)
+{
+	return inv->fw_info.fw_slot_info & 0x7;
+}
+
+CXL_EXPORT int cxl_inventory_get_staged_fw_slot(struct cxl_inventory *inv)
+{
+	return (inv->fw_info.fw_slot_info >> 3) & 0x7;
+}
+
+/* @slot is 1-based, as in the Get FW Info slot fields */
+CXL_EXPORT int cxl_inventory_get_slot_fw_rev(struct cxl_inventory *inv,
+		int slot, char *fw_rev, int fw_len)
+{
+	const char *revs = inv->fw_info.slot_1_fw_rev;
+	const int rev_len = sizeof(inv->fw_info.slot_1_fw_rev);
+
+	if (slot < 1 || slot > 4 || fw_len <= 0)
+		return -EINVAL;
+	memset(fw_rev, 0, fw_len);
+	memcpy(fw_rev, revs + (slot - 1) * rev_len, min(fw_len - 1, rev_len));
+	return 0;
+}
+
+CXL_EXPORT int cxl_inventory_get_nr_dimm_slots(struct cxl_inventory *inv)
+{
+	return min_t(int, inv->dimm_slot_info.num_dimm_slots,
+			CXL_INVENTORY_NR_DIMM_SLOTS);
+}
+
+/*
+ * Each DIMM slot is a 16 byte record of SPD I2C address, channel,
+ * silk screen and presence, starting at slot 0's address byte.
+ */
+static const u8 *cxl_inventory_dimm_slot(struct cxl_inventory *inv, int slot)
+{
+	if (slot < 0 || slot >= cxl_inventory_get_nr_dimm_slots(inv))
+		return NULL;
+	return &inv->dimm_slot_info.slot0_spd_i2c_addr + slot * 16;
+}
+
+CXL_EXPORT int cxl_inventory_get_dimm_spd_addr(struct cxl_inventory *inv,
+		int slot)
+{
+	const u8 *s = cxl_inventory_dimm_slot(inv, slot);
+
+	return s ? s[0] : -EINVAL;
+}
+
+CXL_EXPORT int cxl_inventory_get_dimm_channel(struct cxl_inventory *inv,
+		int slot)
+{
+	const u8 *s = cxl_inventory_dimm_slot(inv, slot);
+
+	return s ? s[1] : -EINVAL;
+}
+
+CXL_EXPORT int cxl_inventory_get_dimm_silk_screen(struct cxl_inventory *inv,
+		int slot)
+{
+	const u8 *s = cxl_inventory_dimm_slot(inv, slot);
+
+	return s ? s[2] : -EINVAL;
+}
+
+CXL_EXPORT int cxl_inventory_get_dimm_present(struct cxl_inventory *inv,
+		int slot)
+{
+	const u8 *s = cxl_inventory_dimm_slot(inv, slot);
+
+	return s ? s[3] : -EINVAL;
+}
+
 #define MAX_PMIC 8
 #define PMIC_NAME_MAX_SIZE 20
 
@@ -10143,6 +14891,41 @@ struct cxl_pmic_vtmon_info_out {
 #define CXL_MEM_COMMAND_ID_PMIC_VTMON_INFO_OPCODE 0xFB00
 #define CXL_MEM_COMMAND_ID_PMIC_VTMON_INFO_PAYLOAD_IN_SIZE 0
 
+/*
+ * Command form of pmic-vtmon-info, for samplers that resubmit one
+ * command each interval and read the rails back without printing.
+ */
+CXL_EXPORT struct cxl_cmd *cxl_cmd_new_pmic_vtmon_info(
+		struct cxl_memdev *memdev)
+{
+	return cxl_cmd_new_vendor(memdev,
+			CXL_MEM_COMMAND_ID_PMIC_VTMON_INFO_OPCODE, 0);
+}
+
+CXL_EXPORT int cxl_cmd_pmic_vtmon_info_get_pmic(struct cxl_cmd *cmd, int pmic,
+		struct cxl_pmic_reading *r)
+{
+	struct cxl_pmic_vtmon_info_out *o;
+	const struct pmic_data *d;
+
+	if (pmic < 0 || pmic >= MAX_PMIC)
+		return -EINVAL;
+	o = cxl_cmd_vendor_get_payload(cmd,
+			CXL_MEM_COMMAND_ID_PMIC_VTMON_INFO_OPCODE, sizeof(*o));
+	if (!o)
+		return -EINVAL;
+
+	d = &o->pmic_data[pmic];
+	memcpy(r->name, d->pmic_name, PMIC_NAME_MAX_SIZE);
+	r->name[PMIC_NAME_MAX_SIZE] = '\0';
+	r->vin = d->vin;
+	r->vout = d->vout;
+	r->iout = d->iout;
+	r->power = d->powr;
+	r->temp = d->temp;
+	return 0;
+}
+
 CXL_EXPORT int cxl_memdev_pmic_vtmon_info(struct cxl_memdev *memdev)
 {
 	struct cxl_cmd *cmd;
@@ -10163,7 +14946,7 @@ CXL_EXPORT int cxl_memdev_pmic_vtmon_info(struct cxl_memdev *memdev)
 
 	cinfo->size_in = CXL_MEM_COMMAND_ID_PMIC_VTMON_INFO_PAYLOAD_IN_SIZE;
 	if (cinfo->size_in > 0) {
-		cmd->input_payload = calloc(1, cinfo->size_in);
+		cmd->input_payload = cxl_cmd_alloc_input(cmd, cinfo->size_in);
 		if (!cmd->input_payload)
 			return -ENOMEM;
 		cmd->send_cmd->in.payload = (u64)cmd->input_payload;
@@ -4,16 +4,29 @@
 #define _LIBCXL_PRIVATE_H_
 
 #include <libkmod.h>
+#include <ccan/list/list.h>
 #include <cxl/cxl_mem.h>
+#include <cxl/libcxl.h>
 #include <ccan/endian/endian.h>
 #include <ccan/short_types/short_types.h>
 
 #define CXL_EXPORT __attribute__ ((visibility("default")))
 
+/* attributes of struct cxl_memdev that have been loaded on demand */
+enum cxl_memdev_attr {
+	CXL_MEMDEV_ATTR_DEVT = 1 << 0,
+	CXL_MEMDEV_ATTR_PMEM_SIZE = 1 << 1,
+	CXL_MEMDEV_ATTR_RAM_SIZE = 1 << 2,
+	CXL_MEMDEV_ATTR_PAYLOAD_MAX = 1 << 3,
+	CXL_MEMDEV_ATTR_LSA_SIZE = 1 << 4,
+	CXL_MEMDEV_ATTR_FW_VERSION = 1 << 5,
+	CXL_MEMDEV_ATTR_SERIAL = 1 << 6,
+	CXL_MEMDEV_ATTR_CEL = 1 << 7,
+};
+
 struct cxl_memdev {
 	int id, major, minor;
-	void *dev_buf;
-	size_t buf_len;
+	unsigned int attrs;
 	char *dev_path;
 	char *firmware_version;
 	struct cxl_ctx *ctx;
@@ -22,7 +35,77 @@ struct cxl_memdev {
 	unsigned long long ram_size;
 	int payload_max;
 	size_t lsa_size;
+	unsigned long long serial;
+	struct list_head spd_cache;
+	struct cxl_inventory *inventory;
+	struct cxl_cel *cel;
+	void *conf_space;
+	char *host;
 	struct kmod_module *module;
+	struct cxl_mem_query_commands *query_cmd;
+	int persistent_fd;
+	int fd;
+	int sysfs_fd;
+	struct cxl_memdev_worker *worker;
+};
+
+enum cxl_port_type {
+	CXL_PORT_ROOT,
+	CXL_PORT_SWITCH,
+	CXL_PORT_ENDPOINT,
+};
+
+/*
+ * Ports, decoders and regions are listed at enumeration time by name
+ * only; each object reads all of its sysfs attributes on first access
+ * and sets @loaded.
+ */
+struct cxl_port {
+	int id;
+	enum cxl_port_type type;
+	char *dev_path;
+	struct cxl_ctx *ctx;
+	struct list_node list;
+	int loaded;
+	int decoders_init;
+	struct cxl_port *parent;
+	char *host;
+	int nr_dports;
+	struct list_head decoders;
+};
+
+struct cxl_decoder {
+	int id;
+	char *dev_path;
+	struct cxl_port *port;
+	struct list_node list;
+	int loaded;
+	unsigned long long resource;
+	unsigned long long size;
+	unsigned long long dpa_resource;
+	unsigned long long dpa_size;
+	int interleave_ways;
+	unsigned int interleave_granularity;
+	char *target_list;
+	char *mode;
+	int cap_pmem;
+	int cap_ram;
+};
+
+struct cxl_region {
+	int id;
+	char *dev_path;
+	struct cxl_ctx *ctx;
+	struct list_node list;
+	int loaded;
+	unsigned long long resource;
+	unsigned long long size;
+	int interleave_ways;
+	unsigned int interleave_granularity;
+	char *uuid;
+	char *mode;
+	char **targets;
+	struct daxctl_region *dax_region;
 };
 
 enum cxl_cmd_query_status {
@@ -34,14 +117,21 @@ enum cxl_cmd_query_status {
 /**
  * struct cxl_cmd - CXL memdev command
  * @memdev: the memory device to which the command is being sent
- * @query_cmd: structure for the Linux 'Query commands' ioctl
+ * @query_cmd: private copy of this command's entry from the memdev's
+ *	     cached 'Query commands' table
  * @send_cmd: structure for the Linux 'Send command' ioctl
  * @input_payload: buffer for input payload managed by libcxl
  * @output_payload: buffer for output payload managed by libcxl
  * @refcount: reference for passing command buffer around
  * @query_status: status from query_commands
- * @query_idx: index of 'this' command in the query_commands array
+ * @query_idx: index of 'this' command in @query_cmd
  * @status: command return status from the device
+ * @out_size: capacity of the output payload, restored before each submit
+ * @list: entry in the context's command pool while the command is idle,
+ *	  or in an async submission or completion queue while in flight
+ * @async_done: completion callback for cxl_cmd_submit_async()
+ * @async_data: opaque argument for @async_done
+ * @async_rc: cxl_cmd_submit() result of an asynchronous submission
  */
 struct cxl_cmd {
 	struct cxl_memdev *memdev;
@@ -53,6 +143,13 @@ struct cxl_cmd {
 	int query_status;
 	int query_idx;
 	int status;
+	int out_size;
+	struct list_node list;
+	cxl_cmd_done_fn async_done;
+	void *async_data;
+	int async_rc;
+	int bg_timeout_ms;
+	bool stream_done;
 };
 
 #define CXL_CMD_IDENTIFY_FW_REV_LENGTH 0x10
@@ -32,12 +32,104 @@ void cxl_set_log_fn(struct cxl_ctx *ctx,
 			const char *format, va_list args));
 int cxl_get_log_priority(struct cxl_ctx *ctx);
 void cxl_set_log_priority(struct cxl_ctx *ctx, int priority);
+int cxl_set_log_ring(struct cxl_ctx *ctx, unsigned long size);
+void cxl_log_dump(struct cxl_ctx *ctx);
 void cxl_set_userdata(struct cxl_ctx *ctx, void *userdata);
 void *cxl_get_userdata(struct cxl_ctx *ctx);
 void cxl_set_private_data(struct cxl_ctx *ctx, void *data);
 void *cxl_get_private_data(struct cxl_ctx *ctx);
+void cxl_set_enum_threads(struct cxl_ctx *ctx, int nr_threads);
+void cxl_set_max_threads(struct cxl_ctx *ctx, int nr_threads);
+int cxl_set_spd_cache_dir(struct cxl_ctx *ctx, const char *dir);
+int cxl_set_inventory_cache_dir(struct cxl_ctx *ctx, const char *dir);
+void cxl_set_opcode_check(struct cxl_ctx *ctx, int enable);
+
+#define CXL_MBOX_STATS_NR_BUCKETS 32
+
+/*
+ * Per-opcode mailbox accounting. hist[i] counts commands whose ioctl
+ * latency in microseconds fell in [2^(i-1), 2^i), hist[0] those under
+ * 1us; the last bucket also absorbs anything slower.
+ */
+struct cxl_mbox_stats {
+	unsigned int opcode;
+	unsigned long long count;
+	unsigned long long errors;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+	unsigned long long hist[CXL_MBOX_STATS_NR_BUCKETS];
+};
+
+int cxl_ctx_get_mbox_stats(struct cxl_ctx *ctx,
+		struct cxl_mbox_stats *stats, int nr);
+void cxl_ctx_reset_mbox_stats(struct cxl_ctx *ctx);
+
+#define CXL_MBOX_TRACE_PAYLOAD 32
+
+/*
+ * One mailbox command in the trace ring: when it was sent, how long the
+ * ioctl took, its result and the first CXL_MBOX_TRACE_PAYLOAD bytes of
+ * each payload. @in_size and @out_size are the full payload sizes.
+ */
+struct cxl_mbox_trace_entry {
+	unsigned long long timestamp_ns;
+	unsigned int latency_ns;
+	unsigned short opcode;
+	unsigned short memdev_id;
+	int rc;
+	unsigned int mbox_status;
+	int in_size;
+	int out_size;
+	unsigned char in[CXL_MBOX_TRACE_PAYLOAD];
+	unsigned char out[CXL_MBOX_TRACE_PAYLOAD];
+};
+
+#define CXL_MBOX_TRACE_MAGIC "CXLMBTR"
+#define CXL_MBOX_TRACE_VERSION 1
+
+/*
+ * Header of a cxl_ctx_dump_mbox_trace() file, followed by @nr_entries
+ * entries oldest first, in host byte order. @nr_recorded counts every
+ * command seen since the ring was enabled.
+ */
+struct cxl_mbox_trace_header {
+	char magic[8];
+	unsigned int version;
+	unsigned int entry_size;
+	unsigned long long nr_entries;
+	unsigned long long nr_recorded;
+};
+
+int cxl_set_mbox_trace(struct cxl_ctx *ctx, unsigned int nr_entries);
+int cxl_set_mbox_trace_dump(struct cxl_ctx *ctx, const char *path);
+int cxl_ctx_get_mbox_trace(struct cxl_ctx *ctx,
+		struct cxl_mbox_trace_entry *entries, int nr);
+int cxl_ctx_dump_mbox_trace(struct cxl_ctx *ctx, int fd);
 
 struct cxl_memdev;
+typedef int (*cxl_transport_fn)(struct cxl_memdev *memdev,
+		unsigned long request, void *arg, void *data);
+int cxl_set_sysfs_root(struct cxl_ctx *ctx, const char *path);
+void cxl_set_transport(struct cxl_ctx *ctx, cxl_transport_fn fn, void *data);
+
+/*
+ * One decoded output field of a vendor command. @label is the enum
+ * name for @value when the field has one, @index is the element of an
+ * array field or -1 for a scalar.
+ */
+struct cxl_vendor_value {
+	const char *cmd;
+	const char *field;
+	const char *label;
+	unsigned long long value;
+	int index;
+};
+
+typedef void (*cxl_vendor_output_fn)(struct cxl_memdev *memdev,
+		const struct cxl_vendor_value *v, void *data);
+void cxl_set_vendor_output(struct cxl_ctx *ctx, cxl_vendor_output_fn fn,
+		void *data);
+
 struct cxl_memdev *cxl_memdev_get_first(struct cxl_ctx *ctx);
 struct cxl_memdev *cxl_memdev_get_next(struct cxl_memdev *memdev);
 int cxl_memdev_get_id(struct cxl_memdev *memdev);
@@ -49,34 +141,155 @@ unsigned long long cxl_memdev_get_pmem_size(struct cxl_memdev *memdev);
 unsigned long long cxl_memdev_get_ram_size(struct cxl_memdev *memdev);
 const char *cxl_memdev_get_firmware_verison(struct cxl_memdev *memdev);
 size_t cxl_memdev_get_lsa_size(struct cxl_memdev *memdev);
+unsigned long long cxl_memdev_get_serial(struct cxl_memdev *memdev);
 int cxl_memdev_is_active(struct cxl_memdev *memdev);
+void cxl_memdev_set_persistent_fd(struct cxl_memdev *memdev, int enable);
 int cxl_memdev_zero_lsa(struct cxl_memdev *memdev);
 int cxl_memdev_get_lsa(struct cxl_memdev *memdev, void *buf, size_t length,
 		size_t offset);
 int cxl_memdev_set_lsa(struct cxl_memdev *memdev, void *buf, size_t length,
 		size_t offset);
+int cxl_memdev_update_lsa(struct cxl_memdev *memdev, void *buf,
+		size_t length, size_t offset);
 int cxl_memdev_cmd_identify(struct cxl_memdev *memdev);
 int cxl_memdev_device_info_get(struct cxl_memdev *memdev);
 int cxl_memdev_get_fw_info(struct cxl_memdev *memdev);
 int cxl_memdev_transfer_fw(struct cxl_memdev *memdev, u8 action,
 	u8 slot, u32 offset, int size, unsigned char *data, u32 transfer_fw_opcode);
+int cxl_memdev_get_fw_transfer_size(struct cxl_memdev *memdev);
+struct cxl_cmd *cxl_cmd_new_transfer_fw(struct cxl_memdev *memdev,
+	u32 transfer_fw_opcode);
+int cxl_cmd_transfer_fw_set_block(struct cxl_cmd *cmd, u8 action,
+	u8 slot, u32 offset, const void *data, int size);
 int cxl_memdev_activate_fw(struct cxl_memdev *memdev, u8 action,
 	u8 slot);
 int cxl_memdev_get_supported_logs(struct cxl_memdev *memdev);
 int cxl_memdev_get_cel_log(struct cxl_memdev *memdev, const char *uuid);
+
+/* Command Effects Log effect flags */
+enum cxl_cel_effect {
+	CXL_CEL_EFFECT_COLD_RESET_CONFIG = 1 << 0,
+	CXL_CEL_EFFECT_IMMEDIATE_CONFIG = 1 << 1,
+	CXL_CEL_EFFECT_IMMEDIATE_DATA = 1 << 2,
+	CXL_CEL_EFFECT_IMMEDIATE_POLICY = 1 << 3,
+	CXL_CEL_EFFECT_IMMEDIATE_LOG = 1 << 4,
+	CXL_CEL_EFFECT_SECURITY = 1 << 5,
+	CXL_CEL_EFFECT_BACKGROUND = 1 << 6,
+};
+
+int cxl_memdev_cel_opcode_supported(struct cxl_memdev *memdev, int opcode);
+int cxl_memdev_cel_get_effect(struct cxl_memdev *memdev, int opcode);
+int cxl_memdev_cel_get_nr_entries(struct cxl_memdev *memdev);
+int cxl_memdev_cel_get_opcode(struct cxl_memdev *memdev, int idx);
 int cxl_memdev_get_event_interrupt_policy(struct cxl_memdev *memdev);
 int cxl_memdev_set_event_interrupt_policy(struct cxl_memdev *memdev, u32 int_policy);
 int cxl_memdev_get_timestamp(struct cxl_memdev *memdev);
 int cxl_memdev_set_timestamp(struct cxl_memdev *memdev, u64 timestamp);
+struct cxl_cmd *cxl_cmd_new_get_timestamp(struct cxl_memdev *memdev);
+unsigned long long cxl_cmd_get_timestamp_get_timestamp(struct cxl_cmd *cmd);
+struct cxl_cmd *cxl_cmd_new_set_timestamp(struct cxl_memdev *memdev);
+int cxl_cmd_set_timestamp_set_timestamp(struct cxl_cmd *cmd, u64 timestamp);
 int cxl_memdev_get_alert_config(struct cxl_memdev *memdev);
 int cxl_memdev_set_alert_config(struct cxl_memdev *memdev, u32 alert_prog_threshold,
     u32 device_temp_threshold, u32 mem_error_threshold);
+
+/*
+ * Programmable warning thresholds from Get Alert Configuration. The
+ * CXL_ALERT_* bits index @valid_alerts (warning enabled) and
+ * @programmable_alerts (warning may be changed with Set Alert
+ * Configuration). Temperatures are two's complement degrees Celsius.
+ */
+#define CXL_ALERT_LIFE_USED (1 << 0)
+#define CXL_ALERT_OVER_TEMP (1 << 1)
+#define CXL_ALERT_UNDER_TEMP (1 << 2)
+#define CXL_ALERT_CORR_VOL_MEM_ERR (1 << 3)
+#define CXL_ALERT_CORR_PERS_MEM_ERR (1 << 4)
+#define CXL_ALERT_ALL 0x1f
+
+struct cxl_alert_config {
+	unsigned int valid_alerts;
+	unsigned int programmable_alerts;
+	unsigned int life_used_crit;
+	unsigned int life_used_warn;
+	short over_temp_crit;
+	short under_temp_crit;
+	short over_temp_warn;
+	short under_temp_warn;
+	unsigned int corr_vol_mem_err_warn;
+	unsigned int corr_pers_mem_err_warn;
+};
+
+int cxl_memdev_read_alert_config(struct cxl_memdev *memdev,
+		struct cxl_alert_config *cfg);
+int cxl_memdev_write_alert_config(struct cxl_memdev *memdev,
+		unsigned int mask, const struct cxl_alert_config *cfg);
 int cxl_memdev_get_health_info(struct cxl_memdev *memdev);
 int cxl_memdev_get_event_records(struct cxl_memdev *memdev, u8 event_log_type);
 int cxl_memdev_get_ld_info(struct cxl_memdev *memdev);
 int cxl_memdev_ddr_info(struct cxl_memdev *memdev, u8 ddr_id);
 int cxl_memdev_clear_event_records(struct cxl_memdev *memdev, u8 event_log_type,
     u8 clear_event_flags, u8 no_event_record_handles, u16 *event_record_handles);
+
+/*
+ * Decoded event record as handed to a cxl_memdev_drain_event_records()
+ * callback. Multi-byte fields are host endian, @data holds the raw
+ * type specific payload for records libcxl does not decode.
+ */
+enum cxl_event_record_type {
+	CXL_EVENT_RECORD_GENERIC,
+	CXL_EVENT_RECORD_DRAM,
+	CXL_EVENT_RECORD_MEMORY_MODULE,
+};
+
+#define CXL_EVENT_RECORD_DATA_SIZE 0x50
+
+/* the low bits of a DRAM or media record's physical_addr are flags */
+#define CXL_EVENT_DPA_MASK (~0x3fULL)
+#define CXL_EVENT_DESC_UNCORRECTABLE 0x1
+#define CXL_EVENT_DESC_THRESHOLD 0x2
+
+struct cxl_event_record_info {
+	enum cxl_event_record_type type;
+	uuid_t uuid;
+	u8 log_type;
+	u8 length;
+	u32 flags;
+	u16 handle;
+	u16 related_handle;
+	u64 timestamp;
+	union {
+		struct {
+			u64 physical_addr;
+			u8 memory_event_descriptor;
+			u8 memory_event_type;
+			u8 transaction_type;
+			u16 validity_flags;
+			u8 channel;
+			u8 rank;
+			u32 nibble_mask;
+			u8 bank_group;
+			u8 bank;
+			u32 row;
+			u16 column;
+			u8 correction_mask[0x20];
+			u8 component_identifier[0x10];
+			u8 sub_channel;
+		} dram;
+		struct {
+			u8 dev_event_type;
+			u8 dev_health_info[0x12];
+		} memory_module;
+		u8 data[CXL_EVENT_RECORD_DATA_SIZE];
+	};
+};
+
+/* clear each batch of records once it has been handed to the callback */
+#define CXL_EVENT_DRAIN_CLEAR (1 << 0)
+
+typedef int (*cxl_event_record_fn)(struct cxl_memdev *memdev,
+		const struct cxl_event_record_info *rec, void *priv);
+int cxl_memdev_drain_event_records(struct cxl_memdev *memdev, u8 event_log_type,
+		unsigned int flags, cxl_event_record_fn fn, void *priv);
 int cxl_memdev_hct_start_stop_trigger(struct cxl_memdev *memdev,
 	u8 hct_inst, u8 buf_control);
 int cxl_memdev_hct_get_buffer_status(struct cxl_memdev *memdev,
@@ -97,8 +310,18 @@ int cxl_memdev_ltmon_watch(struct cxl_memdev *memdev, u8 cxl_mem_id,
 	u8 watch_id, u8 watch_mode, u8 src_maj_st, u8 src_min_st, u8 src_l0_st,
 	u8 dst_maj_st, u8 dst_min_st, u8 dst_l0_st);
 int cxl_memdev_ltmon_capture_stat(struct cxl_memdev *memdev, u8 cxl_mem_id);
+struct cxl_cmd *cxl_cmd_new_ltmon_capture_stat(struct cxl_memdev *memdev,
+	u8 cxl_mem_id);
+int cxl_cmd_ltmon_capture_stat_get_trig_cnt(struct cxl_cmd *cmd);
+int cxl_cmd_ltmon_capture_stat_get_time_stamp(struct cxl_cmd *cmd);
 int cxl_memdev_ltmon_capture_log_dmp(struct cxl_memdev *memdev,
 	u8 cxl_mem_id, u16 dump_idx, u16 dump_cnt);
+struct cxl_cmd *cxl_cmd_new_ltmon_capture_log_dmp(struct cxl_memdev *memdev,
+	u8 cxl_mem_id);
+int cxl_cmd_ltmon_capture_log_dmp_set_range(struct cxl_cmd *cmd,
+	u16 dump_idx, u16 dump_cnt);
+int cxl_cmd_ltmon_capture_log_dmp_get_entries(struct cxl_cmd *cmd,
+	const u64 **entries);
 int cxl_memdev_ltmon_capture_trigger(struct cxl_memdev *memdev,
 	u8 cxl_mem_id, u8 trig_src);
 int cxl_memdev_ltmon_enable(struct cxl_memdev *memdev, u8 cxl_mem_id,
@@ -112,6 +335,12 @@ int cxl_memdev_osa_cfg_dump(struct cxl_memdev *memdev, u8 cxl_mem_id);
 int cxl_memdev_osa_ana_op(struct cxl_memdev *memdev, u8 cxl_mem_id,
 	u8 op);
 int cxl_memdev_osa_status_query(struct cxl_memdev *memdev, u8 cxl_mem_id);
+struct cxl_cmd *cxl_cmd_new_osa_status_query(struct cxl_memdev *memdev,
+	u8 cxl_mem_id);
+int cxl_cmd_osa_status_query_get_state(struct cxl_cmd *cmd);
+int cxl_cmd_osa_status_query_get_trig_lane(struct cxl_cmd *cmd);
+int cxl_cmd_osa_status_query_get_trig_lane_dir(struct cxl_cmd *cmd);
+int cxl_cmd_osa_status_query_get_trig_reason(struct cxl_cmd *cmd);
 int cxl_memdev_osa_access_rel(struct cxl_memdev *memdev, u8 cxl_mem_id);
 int cxl_memdev_perfcnt_mta_ltif_set(struct cxl_memdev *memdev,
 	u32 counter, u32 match_value, u32 opcode, u32 meta_field, u32 meta_value);
@@ -152,6 +381,14 @@ int cxl_memdev_eh_eye_cap_read(struct cxl_memdev *memdev, u8 lane_id,
 	u8 bin_num);
 int cxl_memdev_eh_eye_cap_timeout_enable(struct cxl_memdev *memdev, u8 enable);
 int cxl_memdev_eh_eye_cap_status(struct cxl_memdev *memdev);
+struct cxl_cmd *cxl_cmd_new_eh_eye_cap_status(struct cxl_memdev *memdev);
+int cxl_cmd_eh_eye_cap_status_get_stat(struct cxl_cmd *cmd);
+struct cxl_cmd *cxl_cmd_new_eh_eye_cap_read(struct cxl_memdev *memdev,
+	u8 lane_id, u8 bin_num);
+int cxl_cmd_eh_eye_cap_read_set_bin(struct cxl_cmd *cmd, u8 lane_id,
+	u8 bin_num);
+int cxl_cmd_eh_eye_cap_read_get_ber_data(struct cxl_cmd *cmd,
+	const u32 **ber_data);
 int cxl_memdev_eh_adapt_get(struct cxl_memdev *memdev, u32 lane_id);
 int cxl_memdev_eh_adapt_oneoff(struct cxl_memdev *memdev, u32 lane_id,
 	u32 preload, u32 loops, u32 objects);
@@ -176,6 +413,14 @@ int cxl_memdev_eh_link_dbg_cfg(struct cxl_memdev *memdev, u8 port_id, u8 op_mode
 	u8 cap_type, u16 lane_mask, u8 rate_mask, u32 timer_us, u32 cap_delay_us, u8 max_cap);
 int cxl_memdev_eh_link_dbg_entry_dump(struct cxl_memdev *memdev, u8 entry_idx);
 int cxl_memdev_eh_link_dbg_lane_dump(struct cxl_memdev *memdev, u8 entry_idx, u8 lane_idx);
+struct cxl_cmd *cxl_cmd_new_eh_link_dbg_entry_dump(struct cxl_memdev *memdev,
+	u8 entry_idx);
+int cxl_cmd_eh_link_dbg_entry_dump_set_entry(struct cxl_cmd *cmd, u8 entry_idx);
+int cxl_cmd_eh_link_dbg_entry_dump_get_entry_num(struct cxl_cmd *cmd);
+struct cxl_cmd *cxl_cmd_new_eh_link_dbg_lane_dump(struct cxl_memdev *memdev,
+	u8 entry_idx, u8 lane_idx);
+int cxl_cmd_eh_link_dbg_lane_dump_set_lane(struct cxl_cmd *cmd, u8 entry_idx,
+	u8 lane_idx);
 int cxl_memdev_eh_link_dbg_reset(struct cxl_memdev *memdev);
 int cxl_memdev_fbist_stopconfig_set(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 stop_on_wresp, u8 stop_on_rresp, u8 stop_on_rdataerr);
@@ -186,6 +431,9 @@ int cxl_memdev_fbist_reset_set(struct cxl_memdev *memdev, u32 fbist_id,
 int cxl_memdev_fbist_run_set(struct cxl_memdev *memdev, u32 fbist_id,
 	u8 txg0_run, u8 txg1_run);
 int cxl_memdev_fbist_run_get(struct cxl_memdev *memdev, u32 fbist_id);
+struct cxl_cmd *cxl_cmd_new_fbist_run_get(struct cxl_memdev *memdev,
+	u32 fbist_id);
+int cxl_cmd_fbist_run_get_get_txg_run(struct cxl_cmd *cmd, u8 txg_nr);
 int cxl_memdev_fbist_xfer_rem_cnt_get(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 thread_nr);
 int cxl_memdev_fbist_last_exp_read_data_get(struct cxl_memdev *memdev,
@@ -211,6 +459,9 @@ int cxl_memdev_fbist_last_read_addr_get(struct cxl_memdev *memdev,
 	u32 fbist_id);
 int cxl_memdev_fbist_test_simpledata(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 test_nr, u64 start_address, u64 num_bytes);
+struct cxl_cmd *cxl_cmd_new_fbist_test_simpledata(
+	struct cxl_memdev *memdev, u32 fbist_id, u8 test_nr,
+	u64 start_address, u64 num_bytes);
 int cxl_memdev_fbist_test_addresstest(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 test_nr, u64 start_address, u64 num_bytes, u32 seed);
 int cxl_memdev_fbist_test_movinginversion(struct cxl_memdev *memdev,
@@ -219,10 +470,25 @@ int cxl_memdev_fbist_test_movinginversion(struct cxl_memdev *memdev,
 int cxl_memdev_fbist_test_randomsequence(struct cxl_memdev *memdev,
 	u32 fbist_id, u8 phase_nr, u64 start_address, u64 num_bytes, u32 ddrpage_size,
 	u32 seed_dr0, u32 seed_dr1);
+struct cxl_cmd *cxl_cmd_new_fbist_test_randomsequence(
+	struct cxl_memdev *memdev, u32 fbist_id, u8 phase_nr,
+	u64 start_address, u64 num_bytes, u32 ddrpage_size,
+	u32 seed_dr0, u32 seed_dr1);
+#define CXL_CONF_SPACE_SIZE 4096
+int cxl_memdev_conf_read_range(struct cxl_memdev *memdev, u32 offset,
+	u32 length, void *buf);
+const void *cxl_memdev_get_conf_space(struct cxl_memdev *memdev);
+const char *cxl_memdev_get_host(struct cxl_memdev *memdev);
 int cxl_memdev_conf_read(struct cxl_memdev *memdev, u32 offset,
 	u32 length);
 int cxl_memdev_hct_get_config(struct cxl_memdev *memdev, u8 hct_inst);
 int cxl_memdev_hct_read_buffer(struct cxl_memdev *memdev, u8 hct_inst, u8 num_entries_to_read);
+struct cxl_cmd *cxl_cmd_new_hct_read_buffer(struct cxl_memdev *memdev,
+	u8 hct_inst, u8 num_entries_to_read);
+int cxl_cmd_hct_read_buffer_get_buf_end(struct cxl_cmd *cmd);
+int cxl_cmd_hct_read_buffer_get_entries(struct cxl_cmd *cmd,
+	const u32 **entries);
+int cxl_cmd_hct_read_buffer_next(struct cxl_cmd *cmd, const u32 **entries);
 int cxl_memdev_hct_set_config(struct cxl_memdev *memdev, u8 hct_inst, u8 config_flags,
 	u8 port_trig_depth, u8 ignore_invalid, int filesize, u8 *trig_config_buffer);
 int cxl_memdev_osa_os_patt_trig_cfg(struct cxl_memdev *memdev,
@@ -232,17 +498,198 @@ int cxl_memdev_osa_misc_trig_cfg(struct cxl_memdev *memdev, u8 cxl_mem_id,
 	u8 trig_en_mask);
 int cxl_memdev_osa_data_read(struct cxl_memdev *memdev, u8 cxl_mem_id,
 	u8 lane_id, u8 lane_dir, u16 start_entry, u8 num_entries);
+struct cxl_cmd *cxl_cmd_new_osa_data_read(struct cxl_memdev *memdev,
+	u8 cxl_mem_id, u8 lane_id, u8 lane_dir, u8 num_entries);
+int cxl_cmd_osa_data_read_set_start(struct cxl_cmd *cmd, u16 start_entry);
+int cxl_cmd_osa_data_read_get_next_entry(struct cxl_cmd *cmd);
+int cxl_cmd_osa_data_read_get_entries_rem(struct cxl_cmd *cmd);
+int cxl_cmd_osa_data_read_get_wrap(struct cxl_cmd *cmd);
+int cxl_cmd_osa_data_read_get_entries(struct cxl_cmd *cmd,
+	const u32 **entries);
 int cxl_memdev_dimm_spd_read(struct cxl_memdev *memdev, u32 spd_id,
 	u32 offset, u32 num_bytes);
+struct cxl_spd;
+struct cxl_spd *cxl_memdev_get_spd(struct cxl_memdev *memdev, u32 spd_id);
+const void *cxl_spd_get_data(struct cxl_spd *spd, size_t *len);
+const char *cxl_spd_get_ram_type(struct cxl_spd *spd);
+const char *cxl_spd_get_module_type(struct cxl_spd *spd);
+int cxl_spd_get_data_width(struct cxl_spd *spd);
+int cxl_spd_get_size_gb(struct cxl_spd *spd);
+int cxl_spd_get_speed(struct cxl_spd *spd);
+const char *cxl_spd_get_manufacturer(struct cxl_spd *spd);
+const char *cxl_spd_get_serial(struct cxl_spd *spd);
 int cxl_memdev_ddr_training_status(struct cxl_memdev *memdev);
 int cxl_memdev_dimm_slot_info(struct cxl_memdev *memdev);
+struct cxl_cmd *cxl_cmd_new_ddr_info(struct cxl_memdev *memdev, u8 ddr_id);
+unsigned int cxl_cmd_ddr_info_get_mstr(struct cxl_cmd *cmd);
+int cxl_cmd_ddr_info_get_dram_width(struct cxl_cmd *cmd);
+struct cxl_cmd *cxl_cmd_new_ddr_training_status(struct cxl_memdev *memdev);
+int cxl_cmd_ddr_training_status_get_data(struct cxl_cmd *cmd,
+	const u8 **data);
+#define CXL_DIMM_SLOT_MAX 4
+struct cxl_dimm_slot {
+	int spd_addr;
+	int channel;
+	char silk_screen;
+	int present;
+};
+struct cxl_cmd *cxl_cmd_new_dimm_slot_info(struct cxl_memdev *memdev);
+int cxl_cmd_dimm_slot_info_get_nr_slots(struct cxl_cmd *cmd);
+int cxl_cmd_dimm_slot_info_get_slot(struct cxl_cmd *cmd, int slot,
+	struct cxl_dimm_slot *d);
+struct cxl_inventory;
+struct cxl_inventory *cxl_memdev_get_inventory(struct cxl_memdev *memdev);
+int cxl_inventory_get_fw_rev(struct cxl_inventory *inv, char *fw_rev,
+	int fw_len);
+unsigned long long cxl_inventory_get_total_capacity(struct cxl_inventory *inv);
+unsigned long long cxl_inventory_get_volatile_capacity(
+	struct cxl_inventory *inv);
+unsigned long long cxl_inventory_get_persistent_capacity(
+	struct cxl_inventory *inv);
+int cxl_inventory_get_device_id(struct cxl_inventory *inv);
+int cxl_inventory_get_device_rev(struct cxl_inventory *inv);
+int cxl_inventory_get_chipinfo_rel_major(struct cxl_inventory *inv);
+int cxl_inventory_get_chipinfo_rel_minor(struct cxl_inventory *inv);
+int cxl_inventory_get_configfile_ver_major(struct cxl_inventory *inv);
+int cxl_inventory_get_configfile_ver_minor(struct cxl_inventory *inv);
+int cxl_inventory_get_fw_slots_supported(struct cxl_inventory *inv);
+int cxl_inventory_get_active_fw_slot(struct cxl_inventory *inv);
+int cxl_inventory_get_staged_fw_slot(struct cxl_inventory *inv);
+int cxl_inventory_get_slot_fw_rev(struct cxl_inventory *inv, int slot,
+	char *fw_rev, int fw_len);
+int cxl_inventory_get_nr_dimm_slots(struct cxl_inventory *inv);
+int cxl_inventory_get_dimm_spd_addr(struct cxl_inventory *inv, int slot);
+int cxl_inventory_get_dimm_channel(struct cxl_inventory *inv, int slot);
+int cxl_inventory_get_dimm_silk_screen(struct cxl_inventory *inv, int slot);
+int cxl_inventory_get_dimm_present(struct cxl_inventory *inv, int slot);
 int cxl_memdev_pmic_vtmon_info(struct cxl_memdev *memdev);
+#define CXL_PMIC_MAX 8
+struct cxl_pmic_reading {
+	char name[21];
+	float vin;
+	float vout;
+	float iout;
+	float power;
+	float temp;
+};
+struct cxl_cmd *cxl_cmd_new_pmic_vtmon_info(struct cxl_memdev *memdev);
+int cxl_cmd_pmic_vtmon_info_get_pmic(struct cxl_cmd *cmd, int pmic,
+		struct cxl_pmic_reading *r);
 
 #define cxl_memdev_foreach(ctx, memdev) \
         for (memdev = cxl_memdev_get_first(ctx); \
              memdev != NULL; \
              memdev = cxl_memdev_get_next(memdev))
 
+struct cxl_port;
+struct cxl_port *cxl_port_get_first(struct cxl_ctx *ctx);
+struct cxl_port *cxl_port_get_next(struct cxl_port *port);
+struct cxl_ctx *cxl_port_get_ctx(struct cxl_port *port);
+int cxl_port_get_id(struct cxl_port *port);
+const char *cxl_port_get_devname(struct cxl_port *port);
+int cxl_port_is_root(struct cxl_port *port);
+int cxl_port_is_switch(struct cxl_port *port);
+int cxl_port_is_endpoint(struct cxl_port *port);
+struct cxl_port *cxl_port_get_parent(struct cxl_port *port);
+const char *cxl_port_get_host(struct cxl_port *port);
+int cxl_port_get_nr_dports(struct cxl_port *port);
+struct cxl_port *cxl_memdev_get_endpoint(struct cxl_memdev *memdev);
+
+#define cxl_port_foreach(ctx, port) \
+        for (port = cxl_port_get_first(ctx); \
+             port != NULL; \
+             port = cxl_port_get_next(port))
+
+struct cxl_decoder;
+struct cxl_decoder *cxl_decoder_get_first(struct cxl_port *port);
+struct cxl_decoder *cxl_decoder_get_next(struct cxl_decoder *decoder);
+struct cxl_port *cxl_decoder_get_port(struct cxl_decoder *decoder);
+int cxl_decoder_get_id(struct cxl_decoder *decoder);
+const char *cxl_decoder_get_devname(struct cxl_decoder *decoder);
+unsigned long long cxl_decoder_get_resource(struct cxl_decoder *decoder);
+unsigned long long cxl_decoder_get_size(struct cxl_decoder *decoder);
+unsigned long long cxl_decoder_get_dpa_resource(struct cxl_decoder *decoder);
+unsigned long long cxl_decoder_get_dpa_size(struct cxl_decoder *decoder);
+int cxl_decoder_get_interleave_ways(struct cxl_decoder *decoder);
+unsigned int cxl_decoder_get_interleave_granularity(
+		struct cxl_decoder *decoder);
+const char *cxl_decoder_get_target_list(struct cxl_decoder *decoder);
+const char *cxl_decoder_get_mode(struct cxl_decoder *decoder);
+int cxl_decoder_is_pmem_capable(struct cxl_decoder *decoder);
+int cxl_decoder_is_volatile_capable(struct cxl_decoder *decoder);
+int cxl_decoder_get_nr_targets(struct cxl_decoder *decoder);
+struct cxl_port *cxl_decoder_get_target(struct cxl_decoder *decoder,
+		int position);
+int cxl_decoder_set_mode(struct cxl_decoder *decoder, const char *mode);
+int cxl_decoder_set_dpa_size(struct cxl_decoder *decoder,
+		unsigned long long size);
+
+#define cxl_decoder_foreach(port, decoder) \
+        for (decoder = cxl_decoder_get_first(port); \
+             decoder != NULL; \
+             decoder = cxl_decoder_get_next(decoder))
+
+struct cxl_region;
+struct cxl_region *cxl_region_get_first(struct cxl_ctx *ctx);
+struct cxl_region *cxl_region_get_next(struct cxl_region *region);
+struct cxl_ctx *cxl_region_get_ctx(struct cxl_region *region);
+int cxl_region_get_id(struct cxl_region *region);
+const char *cxl_region_get_devname(struct cxl_region *region);
+unsigned long long cxl_region_get_resource(struct cxl_region *region);
+unsigned long long cxl_region_get_size(struct cxl_region *region);
+int cxl_region_get_interleave_ways(struct cxl_region *region);
+unsigned int cxl_region_get_interleave_granularity(struct cxl_region *region);
+const char *cxl_region_get_uuid(struct cxl_region *region);
+const char *cxl_region_get_mode(struct cxl_region *region);
+struct cxl_decoder *cxl_region_get_target(struct cxl_region *region,
+		int position);
+struct cxl_region *cxl_decoder_create_pmem_region(struct cxl_decoder *decoder);
+struct cxl_region *cxl_decoder_create_ram_region(struct cxl_decoder *decoder);
+int cxl_decoder_delete_region(struct cxl_decoder *decoder,
+		struct cxl_region *region);
+int cxl_region_set_uuid(struct cxl_region *region, uuid_t uu);
+int cxl_region_set_size(struct cxl_region *region, unsigned long long size);
+int cxl_region_set_interleave_ways(struct cxl_region *region,
+		unsigned int ways);
+int cxl_region_set_interleave_granularity(struct cxl_region *region,
+		unsigned int granularity);
+int cxl_region_set_target(struct cxl_region *region, int position,
+		struct cxl_decoder *decoder);
+int cxl_region_commit(struct cxl_region *region);
+struct cxl_memdev *cxl_decoder_get_memdev(struct cxl_decoder *decoder);
+int cxl_region_get_memdev_position(struct cxl_region *region,
+		struct cxl_memdev *memdev);
+
+/*
+ * Host side view of a device physical address: @hpa within @region,
+ * and, when a dax device of the region covers it, @dax_offset into
+ * @dax and that device's @numa_node, -1 otherwise.
+ */
+struct daxctl_dev;
+struct cxl_hpa_info {
+	unsigned long long hpa;
+	struct cxl_region *region;
+	int position;
+	struct daxctl_dev *dax;
+	unsigned long long dax_offset;
+	int numa_node;
+};
+
+int cxl_memdev_dpa_to_hpa(struct cxl_memdev *memdev,
+		unsigned long long dpa, struct cxl_hpa_info *info);
+
+struct daxctl_ctx;
+struct daxctl_region;
+struct daxctl_ctx *cxl_get_daxctl_ctx(struct cxl_ctx *ctx);
+struct daxctl_region *cxl_region_get_daxctl_region(struct cxl_region *region);
+struct cxl_region *cxl_region_get_by_daxctl_region(struct cxl_ctx *ctx,
+		struct daxctl_region *dax_region);
+
+#define cxl_region_foreach(ctx, region) \
+        for (region = cxl_region_get_first(ctx); \
+             region != NULL; \
+             region = cxl_region_get_next(region))
+
 struct cxl_cmd;
 const char *cxl_cmd_get_devname(struct cxl_cmd *cmd);
 struct cxl_cmd *cxl_cmd_new_raw(struct cxl_memdev *memdev, int opcode);
@@ -253,6 +700,142 @@ void cxl_cmd_unref(struct cxl_cmd *cmd);
 int cxl_cmd_submit(struct cxl_cmd *cmd);
 int cxl_cmd_get_mbox_status(struct cxl_cmd *cmd);
 int cxl_cmd_get_out_size(struct cxl_cmd *cmd);
+void *cxl_cmd_get_input_payload(struct cxl_cmd *cmd);
+void *cxl_cmd_get_output_payload(struct cxl_cmd *cmd);
+
+struct cxl_cmd_batch;
+struct cxl_cmd_batch *cxl_cmd_batch_new(struct cxl_ctx *ctx);
+void cxl_cmd_batch_free(struct cxl_cmd_batch *batch);
+int cxl_cmd_batch_add(struct cxl_cmd_batch *batch, struct cxl_cmd *cmd);
+int cxl_cmd_batch_get_count(struct cxl_cmd_batch *batch);
+struct cxl_cmd *cxl_cmd_batch_get_cmd(struct cxl_cmd_batch *batch, int idx);
+int cxl_cmd_batch_get_result(struct cxl_cmd_batch *batch, int idx);
+int cxl_cmd_batch_submit(struct cxl_cmd_batch *batch);
+
+typedef void (*cxl_cmd_done_fn)(struct cxl_cmd *cmd, int rc, void *data);
+int cxl_get_async_fd(struct cxl_ctx *ctx);
+int cxl_cmd_submit_async(struct cxl_cmd *cmd, cxl_cmd_done_fn done,
+		void *data);
+int cxl_async_complete(struct cxl_ctx *ctx);
+
+typedef int (*cxl_bg_progress_fn)(struct cxl_memdev *memdev, int opcode,
+		int percent, void *data);
+int cxl_memdev_bg_wait(struct cxl_memdev *memdev, unsigned int timeout_ms,
+		cxl_bg_progress_fn progress, void *data);
+int cxl_cmd_submit_bg(struct cxl_cmd *cmd, unsigned int timeout_ms,
+		cxl_bg_progress_fn progress, void *data);
+int cxl_cmd_submit_bg_async(struct cxl_cmd *cmd, unsigned int timeout_ms,
+		cxl_cmd_done_fn done, void *data);
+struct cxl_cmd *cxl_cmd_new_hbo_status(struct cxl_memdev *memdev);
+int cxl_cmd_hbo_status_get_opcode(struct cxl_cmd *cmd);
+int cxl_cmd_hbo_status_get_percent_complete(struct cxl_cmd *cmd);
+int cxl_cmd_hbo_status_get_running(struct cxl_cmd *cmd);
+int cxl_cmd_hbo_status_get_return_code(struct cxl_cmd *cmd);
+int cxl_cmd_hbo_status_get_extended_status(struct cxl_cmd *cmd);
+
+enum cxl_poison_source {
+	CXL_POISON_SOURCE_UNKNOWN = 0,
+	CXL_POISON_SOURCE_EXTERNAL = 1,
+	CXL_POISON_SOURCE_INTERNAL = 2,
+	CXL_POISON_SOURCE_INJECTED = 3,
+	CXL_POISON_SOURCE_VENDOR = 7,
+};
+
+/* a poisoned device physical address range, @length in bytes */
+struct cxl_poison_record {
+	unsigned long long dpa;
+	unsigned long long length;
+	int source;
+};
+
+#define CXL_SCAN_MEDIA_NO_EVENT_LOG 1
+
+typedef int (*cxl_poison_fn)(struct cxl_memdev *memdev,
+		const struct cxl_poison_record *rec, void *data);
+int cxl_memdev_poison_foreach(struct cxl_memdev *memdev,
+		unsigned long long dpa, unsigned long long length,
+		cxl_poison_fn fn, void *data);
+struct cxl_poison_list;
+struct cxl_poison_list *cxl_memdev_get_poison_list(struct cxl_memdev *memdev,
+		unsigned long long dpa, unsigned long long length);
+void cxl_poison_list_free(struct cxl_poison_list *list);
+int cxl_poison_list_get_count(struct cxl_poison_list *list);
+const struct cxl_poison_record *cxl_poison_list_get_record(
+		struct cxl_poison_list *list, int idx);
+int cxl_poison_list_get_overflow(struct cxl_poison_list *list);
+int cxl_memdev_get_scan_media_time(struct cxl_memdev *memdev,
+		unsigned long long dpa, unsigned long long length);
+int cxl_memdev_scan_media(struct cxl_memdev *memdev, unsigned long long dpa,
+		unsigned long long length, unsigned int flags,
+		unsigned int timeout_ms, cxl_bg_progress_fn progress, void *data);
+int cxl_memdev_scan_media_foreach(struct cxl_memdev *memdev,
+		cxl_poison_fn fn, void *data, unsigned long long *restart_dpa,
+		unsigned long long *restart_length);
+
+/* QoS telemetry capability and control bits */
+#define CXL_QOS_TELEMETRY_EGRESS_CONGESTION 0x1
+#define CXL_QOS_TELEMETRY_THROUGHPUT_REDUCTION 0x2
+#define CXL_QOS_TELEMETRY_MASK 0x3
+
+enum cxl_qos_load {
+	CXL_QOS_LOAD_NORMAL,
+	CXL_QOS_LOAD_MODERATE,
+	CXL_QOS_LOAD_SEVERE,
+};
+
+/*
+ * One QoS telemetry sample. @load classifies @backpressure_pct against
+ * the device's egress moderate and severe thresholds; anything but
+ * CXL_QOS_LOAD_NORMAL means the device is throttling its hosts.
+ * @timestamp_ns is CLOCK_MONOTONIC when the status was read.
+ */
+struct cxl_qos_telemetry {
+	unsigned int caps;
+	unsigned int enabled;
+	int ld_count;
+	int moderate_pct;
+	int severe_pct;
+	int sample_interval;
+	int backpressure_pct;
+	int load;
+	unsigned long long timestamp_ns;
+};
+
+int cxl_memdev_get_qos_telemetry(struct cxl_memdev *memdev,
+		struct cxl_qos_telemetry *t);
+int cxl_memdev_update_qos_status(struct cxl_memdev *memdev,
+		struct cxl_qos_telemetry *t);
+
+#define CXL_LD_MAX 16
+#define CXL_LD_ALLOC_CAPACITY 0x1
+#define CXL_LD_ALLOC_BANDWIDTH 0x2
+#define CXL_LD_ALLOC_BANDWIDTH_LIMIT 0x4
+
+/*
+ * Share of a multi-logical device given to one LD. @range1 and @range2
+ * are bytes, multiples of struct cxl_ld_allocs @granularity. @bw is the
+ * LD's share of the egress bandwidth under load and @bw_limit the most
+ * it may use, both in 256ths; they are only valid when @qos_caps is
+ * non-zero.
+ */
+struct cxl_ld_alloc {
+	unsigned long long range1;
+	unsigned long long range2;
+	unsigned int bw;
+	unsigned int bw_limit;
+};
+
+struct cxl_ld_allocs {
+	int ld_count;
+	unsigned int qos_caps;
+	unsigned long long granularity;
+	struct cxl_ld_alloc ld[CXL_LD_MAX];
+};
+
+int cxl_memdev_get_ld_alloc(struct cxl_memdev *memdev,
+		struct cxl_ld_allocs *a);
+int cxl_memdev_set_ld_alloc(struct cxl_memdev *memdev,
+		struct cxl_ld_allocs *a, int first, int nr, unsigned int what);
 struct cxl_cmd *cxl_cmd_new_identify(struct cxl_memdev *memdev);
 int cxl_cmd_identify_get_fw_rev(struct cxl_cmd *cmd, char *fw_rev, int fw_len);
 unsigned long long cxl_cmd_identify_get_partition_align(struct cxl_cmd *cmd);
@@ -271,6 +854,124 @@ struct cxl_cmd *cxl_cmd_new_get_lsa(struct cxl_memdev *memdev,
 void *cxl_cmd_get_lsa_get_payload(struct cxl_cmd *cmd);
 struct cxl_cmd *cxl_cmd_new_set_lsa(struct cxl_memdev *memdev,
 		void *buf, unsigned int offset, unsigned int length);
+struct cxl_cmd *cxl_cmd_new_perfcnt_mta_get(
+		struct cxl_memdev *memdev, u8 type, u32 counter);
+int cxl_cmd_perfcnt_mta_get_get_counter(struct cxl_cmd *cmd,
+		unsigned long long *counter);
+struct cxl_cmd *cxl_cmd_new_perfcnt_mta_cnt_val_latch(
+		struct cxl_memdev *memdev, u8 type, u32 counter);
+struct cxl_cmd *cxl_cmd_new_perfcnt_mta_latch_val_get(
+		struct cxl_memdev *memdev, u8 type, u32 counter);
+int cxl_cmd_perfcnt_mta_latch_val_get_get_latch_val(struct cxl_cmd *cmd,
+		unsigned long long *latch_val);
+struct cxl_cmd *cxl_cmd_new_perfcnt_mta_hif_cnt_val_latch(
+		struct cxl_memdev *memdev, u32 counter);
+struct cxl_cmd *cxl_cmd_new_perfcnt_mta_hif_latch_val_get(
+		struct cxl_memdev *memdev, u32 counter);
+int cxl_cmd_perfcnt_mta_hif_latch_val_get_get_latch_val(struct cxl_cmd *cmd,
+		unsigned long long *latch_val);
+struct cxl_cmd *cxl_cmd_new_health_counters_get(struct cxl_memdev *memdev);
+long long cxl_cmd_health_counters_get_get_critical_over_temperature_exceeded(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_over_temperature_warning_level_exceeded(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_critical_under_temperature_exceeded(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_under_temperature_warning_level_exceeded(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_power_on_events(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_power_on_hours(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_cxl_mem_link_crc_errors(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_cxl_io_link_lcrc_errors(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_cxl_io_link_ecrc_errors(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_num_ddr_single_ecc_errors(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_num_ddr_double_ecc_errors(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_link_recovery_events(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_time_in_throttled(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_rx_retry_request(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_rcmd_qs0_hi_threshold_detect(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_health_counters_get_get_rcmd_qs1_hi_threshold_detect(
+		struct cxl_cmd *cmd);
+struct cxl_cmd *cxl_cmd_new_fbist_thread_bandwidth_get(
+		struct cxl_memdev *memdev, u32 fbist_id, u8 txg_nr, u8 thread_nr);
+long long cxl_cmd_fbist_thread_bandwidth_get_get_read_bw_cnt(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_fbist_thread_bandwidth_get_get_write_bw_cnt(
+		struct cxl_cmd *cmd);
+struct cxl_cmd *cxl_cmd_new_fbist_thread_latency_get(
+		struct cxl_memdev *memdev, u32 fbist_id, u8 txg_nr, u8 thread_nr);
+long long cxl_cmd_fbist_thread_latency_get_get_read_latency_cnt(
+		struct cxl_cmd *cmd);
+long long cxl_cmd_fbist_thread_latency_get_get_write_latency_cnt(
+		struct cxl_cmd *cmd);
+
+/*
+ * Counter page published by 'cxl perf stat --publish', so any number of
+ * readers get the latest sample without mailbox traffic of their own.
+ * The file starts with struct cxl_counters_hdr, followed by @nr_slots
+ * slots of @slot_size bytes at @hdr_size, each starting with a
+ * struct cxl_counter. Values are in host byte order.
+ *
+ * @seq is a sequence lock: it is odd while the writer updates the page,
+ * and a copy taken between two equal, even reads of it is consistent.
+ * A restarted writer replaces the file rather than rewriting it, and
+ * sets CXL_COUNTERS_EXITED in the old one on the way out.
+ */
+#define CXL_COUNTERS_PATH "/dev/shm/cxl-counters"
+#define CXL_COUNTERS_MAGIC "CXLCNTRS"
+#define CXL_COUNTERS_VERSION 1
+#define CXL_COUNTERS_EXITED (1U << 0)
+
+struct cxl_counters_hdr {
+	char magic[8];
+	u32 version;
+	u32 hdr_size;
+	u32 slot_size;
+	u32 nr_slots;
+	u32 nr;
+	u32 flags;
+	u64 seq;
+	/* CLOCK_MONOTONIC time of the latest sample, and the period */
+	u64 time_ns;
+	u64 interval_ns;
+	s32 pid;
+	u32 reserved;
+};
+
+#define CXL_COUNTER_GAUGE (1U << 0)
+
+/*
+ * One reading: a counter has its raw @value, its change since the
+ * previous sample in @delta and that change per second in @rate. A
+ * CXL_COUNTER_GAUGE reading, like a temperature, has only @rate.
+ */
+struct cxl_counter {
+	char memdev[16];
+	char event[40];
+	u64 time_ns;
+	u64 value;
+	u64 delta;
+	double rate;
+	u32 flags;
+	u32 reserved;
+};
+
+struct cxl_counters;
+struct cxl_counters *cxl_counters_open(struct cxl_ctx *ctx, const char *path);
+void cxl_counters_close(struct cxl_counters *counters);
+int cxl_counters_read(struct cxl_counters *counters, struct cxl_counter *buf,
+		int nr, u64 *time_ns);
 
 #ifdef __cplusplus
 } /* extern "C" */
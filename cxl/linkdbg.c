@@ -0,0 +1,399 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <linux/types.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <json-c/json.h>
+#include <ccan/array_size/array_size.h>
+#include <ccan/endian/endian.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+/*
+ * link-dbg-dump binary file: a struct link_dbg_file_header followed by
+ * one struct link_dbg_record per entry or lane dump, each trailed by
+ * @size bytes of output payload exactly as the device returned it. Lane
+ * records follow the entry record they belong to.
+ */
+#define LINK_DBG_FILE_MAGIC "CXLLDBG\0"
+#define LINK_DBG_FILE_VERSION 1
+#define LINK_DBG_MAX_ENTRIES 16
+#define LINK_DBG_MAX_LANES 16
+#define LINK_DBG_ENTRY_SIZE 34
+#define LINK_DBG_LANE_SIZE 59
+
+enum link_dbg_kind {
+	LINK_DBG_ENTRY,
+	LINK_DBG_LANE,
+};
+
+struct link_dbg_file_header {
+	char magic[8];
+	__le32 version;
+	__le32 rsvd;
+} __attribute__((packed));
+
+struct link_dbg_record {
+	char devname[16];
+	u8 kind;
+	u8 entry_idx;
+	u8 lane_idx;
+	u8 size;
+	__le32 rsvd;
+} __attribute__((packed));
+
+/* output payload layouts of eh_link_dbg_entry_dump and _lane_dump */
+struct link_dbg_field {
+	const char *name;
+	u8 offset;
+	u8 width;
+};
+
+static const struct link_dbg_field link_dbg_entry_fields[] = {
+	{ "cap_reason", 1, 1 },
+	{ "l2r_reason", 2, 4 },
+	{ "start_time", 6, 8 },
+	{ "end_time", 14, 8 },
+	{ "start_rate", 22, 1 },
+	{ "end_rate", 23, 1 },
+	{ "start_state", 24, 1 },
+	{ "end_state", 25, 1 },
+	{ "start_status", 26, 4 },
+	{ "end_status", 30, 4 },
+};
+
+static const struct link_dbg_field link_dbg_lane_fields[] = {
+	{ "pga_gain", 1, 1 },
+	{ "pga_off2", 2, 1 },
+	{ "pga_off1", 3, 1 },
+	{ "cdfe_a2", 4, 1 },
+	{ "cdfe_a3", 5, 1 },
+	{ "cdfe_a4", 6, 1 },
+	{ "cdfe_a5", 7, 1 },
+	{ "cdfe_a6", 8, 1 },
+	{ "cdfe_a7", 9, 1 },
+	{ "cdfe_a8", 10, 1 },
+	{ "cdfe_a9", 11, 1 },
+	{ "cdfe_a10", 12, 1 },
+	{ "zobel_a_gain", 13, 1 },
+	{ "zobel_b_gain", 14, 1 },
+	{ "zobel_dc_offset", 15, 2 },
+	{ "udfe_thr_0", 17, 2 },
+	{ "udfe_thr_1", 19, 2 },
+	{ "dc_offset", 21, 2 },
+	{ "median_amp", 23, 2 },
+	{ "ph_ofs_t", 25, 1 },
+	{ "cdru_lock_time", 26, 2 },
+	{ "eh_workaround_stat", 28, 2 },
+	{ "los_toggle_cnt", 30, 2 },
+	{ "adapt_time", 32, 2 },
+	{ "cdr_lock_toggle_cnt_0", 34, 2 },
+	{ "jat_stat_0", 36, 2 },
+	{ "db_err", 38, 4 },
+	{ "reg_val0", 42, 4 },
+	{ "reg_val1", 46, 1 },
+	{ "reg_val2", 47, 4 },
+	{ "reg_val3", 51, 4 },
+	{ "reg_val4", 55, 4 },
+};
+
+static struct {
+	const char *outfile;
+	const char *format;
+	unsigned int entry_idx;
+	unsigned int lane_mask;
+	bool all;
+	bool verbose;
+} param = {
+	.format = "json",
+	.lane_mask = 0xffff,
+};
+
+struct link_dbg_dump {
+	FILE *f;
+	bool binary;
+	struct json_object *jdevs;
+};
+
+static u64 link_dbg_get(const u8 *p, int width)
+{
+	__le16 v16;
+	__le32 v32;
+	__le64 v64;
+
+	switch (width) {
+	case 2:
+		memcpy(&v16, p, sizeof(v16));
+		return le16_to_cpu(v16);
+	case 4:
+		memcpy(&v32, p, sizeof(v32));
+		return le32_to_cpu(v32);
+	case 8:
+		memcpy(&v64, p, sizeof(v64));
+		return le64_to_cpu(v64);
+	default:
+		return *p;
+	}
+}
+
+static struct json_object *link_dbg_to_json(const u8 *payload,
+		const struct link_dbg_field *fields, int nr)
+{
+	struct json_object *jobj = json_object_new_object();
+	int i;
+
+	if (!jobj)
+		return NULL;
+	for (i = 0; i < nr; i++)
+		json_object_object_add(jobj, fields[i].name,
+				util_json_object_hex(link_dbg_get(
+					payload + fields[i].offset,
+					fields[i].width), 0));
+	return jobj;
+}
+
+static int link_dbg_submit(struct cxl_cmd *cmd, int size)
+{
+	int rc = cxl_cmd_submit(cmd);
+
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	if (rc == 0 && cxl_cmd_get_out_size(cmd) < size)
+		rc = -EINVAL;
+	return rc;
+}
+
+static int link_dbg_write(struct link_dbg_dump *d, const char *devname,
+		enum link_dbg_kind kind, int entry, int lane, struct cxl_cmd *cmd,
+		int size)
+{
+	struct link_dbg_record rec;
+
+	memset(&rec, 0, sizeof(rec));
+	strncpy(rec.devname, devname, sizeof(rec.devname) - 1);
+	rec.kind = kind;
+	rec.entry_idx = entry;
+	rec.lane_idx = lane;
+	rec.size = size;
+	if (fwrite(&rec, sizeof(rec), 1, d->f) != 1
+			|| fwrite(cxl_cmd_get_output_payload(cmd), size, 1,
+				d->f) != 1)
+		return -EIO;
+	return 0;
+}
+
+/*
+ * Dump one entry and each of its lanes in @param.lane_mask, reusing the
+ * two commands for every read.
+ */
+static int link_dbg_dump_entry(struct link_dbg_dump *d,
+		struct cxl_memdev *memdev, struct cxl_cmd *entry,
+		struct cxl_cmd *lane, int entry_idx, struct json_object *jentries)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct json_object *jentry = NULL, *jlanes = NULL, *jlane;
+	int i, rc;
+
+	cxl_cmd_eh_link_dbg_entry_dump_set_entry(entry, entry_idx);
+	rc = link_dbg_submit(entry, LINK_DBG_ENTRY_SIZE);
+	if (rc)
+		return rc;
+
+	if (d->binary) {
+		rc = link_dbg_write(d, devname, LINK_DBG_ENTRY, entry_idx, 0,
+				entry, LINK_DBG_ENTRY_SIZE);
+		if (rc)
+			return rc;
+	} else {
+		jentry = link_dbg_to_json(cxl_cmd_get_output_payload(entry),
+				link_dbg_entry_fields,
+				ARRAY_SIZE(link_dbg_entry_fields));
+		jlanes = json_object_new_array();
+		if (!jentry || !jlanes) {
+			json_object_put(jentry);
+			json_object_put(jlanes);
+			return -ENOMEM;
+		}
+		json_object_object_add(jentry, "entry_idx",
+				json_object_new_int(entry_idx));
+		json_object_object_add(jentry, "entry_num", json_object_new_int(
+				cxl_cmd_eh_link_dbg_entry_dump_get_entry_num(entry)));
+		json_object_object_add(jentry, "lanes", jlanes);
+		json_object_array_add(jentries, jentry);
+	}
+
+	for (i = 0; i < LINK_DBG_MAX_LANES; i++) {
+		if (!(param.lane_mask & (1U << i)))
+			continue;
+		cxl_cmd_eh_link_dbg_lane_dump_set_lane(lane, entry_idx, i);
+		rc = link_dbg_submit(lane, LINK_DBG_LANE_SIZE);
+		if (rc)
+			return rc;
+
+		if (d->binary) {
+			rc = link_dbg_write(d, devname, LINK_DBG_LANE,
+					entry_idx, i, lane, LINK_DBG_LANE_SIZE);
+			if (rc)
+				return rc;
+			continue;
+		}
+		jlane = link_dbg_to_json(cxl_cmd_get_output_payload(lane),
+				link_dbg_lane_fields,
+				ARRAY_SIZE(link_dbg_lane_fields));
+		if (!jlane)
+			return -ENOMEM;
+		json_object_object_add(jlane, "lane_idx", json_object_new_int(i));
+		json_object_array_add(jlanes, jlane);
+	}
+
+	return 0;
+}
+
+static int link_dbg_dump_memdev(struct link_dbg_dump *d,
+		struct cxl_memdev *memdev)
+{
+	struct json_object *jdev = NULL, *jentries = NULL;
+	struct cxl_cmd *entry, *lane = NULL;
+	int i, first, last, rc = -ENOMEM;
+
+	entry = cxl_cmd_new_eh_link_dbg_entry_dump(memdev, param.entry_idx);
+	if (entry)
+		lane = cxl_cmd_new_eh_link_dbg_lane_dump(memdev,
+				param.entry_idx, 0);
+	if (!lane)
+		goto out;
+
+	if (!d->binary) {
+		jdev = json_object_new_object();
+		jentries = json_object_new_array();
+		if (!jdev || !jentries) {
+			json_object_put(jentries);
+			goto out;
+		}
+		json_object_object_add(jdev, "memdev", json_object_new_string(
+					cxl_memdev_get_devname(memdev)));
+		json_object_object_add(jdev, "entries", jentries);
+	}
+
+	first = last = param.entry_idx;
+	if (param.all) {
+		/* entry 0 reports how many entries were captured */
+		cxl_cmd_eh_link_dbg_entry_dump_set_entry(entry, 0);
+		rc = link_dbg_submit(entry, LINK_DBG_ENTRY_SIZE);
+		if (rc)
+			goto out;
+		first = 0;
+		last = cxl_cmd_eh_link_dbg_entry_dump_get_entry_num(entry) - 1;
+		if (last >= LINK_DBG_MAX_ENTRIES)
+			last = LINK_DBG_MAX_ENTRIES - 1;
+	}
+
+	rc = 0;
+	for (i = first; i <= last && !rc; i++)
+		rc = link_dbg_dump_entry(d, memdev, entry, lane, i, jentries);
+
+out:
+	if (jdev) {
+		if (!rc)
+			json_object_array_add(d->jdevs, jdev);
+		else
+			json_object_put(jdev);
+	}
+	cxl_cmd_unref(lane);
+	cxl_cmd_unref(entry);
+	return rc;
+}
+
+int cmd_link_dbg_dump(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_BOOLEAN('a', "all", &param.all,
+				"dump every captured entry"),
+		OPT_UINTEGER('e', "entry_idx", &param.entry_idx,
+				"entry to dump when not using --all"),
+		OPT_UINTEGER('l', "lane_mask", &param.lane_mask,
+				"lanes to dump per entry (default 0xffff)"),
+		OPT_STRING('f', "format", &param.format, "format",
+				"'json' (default) or 'binary'"),
+		OPT_FILENAME('o', "output", &param.outfile, "output-file",
+				"write the dump to this file instead of stdout"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl link-dbg-dump <mem0> [<mem1>..<memN>] [<options>]",
+		NULL
+	};
+	struct link_dbg_dump d = { 0 };
+	struct link_dbg_file_header hdr;
+	struct cxl_memdev *memdev;
+	int i, rc, failed = 0;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1)
+		usage_with_options(u, options);
+	if (strcmp(param.format, "binary") == 0)
+		d.binary = true;
+	else if (strcmp(param.format, "json") != 0) {
+		fprintf(stderr, "unknown format: %s\n", param.format);
+		return EXIT_FAILURE;
+	}
+	if (!param.all && param.entry_idx >= LINK_DBG_MAX_ENTRIES) {
+		fprintf(stderr, "--entry_idx must be below %d\n",
+				LINK_DBG_MAX_ENTRIES);
+		return EXIT_FAILURE;
+	}
+	if (d.binary && !param.outfile) {
+		fprintf(stderr, "--format=binary needs --output\n");
+		return EXIT_FAILURE;
+	}
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	d.f = param.outfile ? fopen(param.outfile, d.binary ? "wb" : "w")
+		: stdout;
+	if (!d.f) {
+		fprintf(stderr, "failed to open %s: %s\n", param.outfile,
+				strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if (d.binary) {
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, LINK_DBG_FILE_MAGIC, sizeof(hdr.magic));
+		hdr.version = cpu_to_le32(LINK_DBG_FILE_VERSION);
+		if (fwrite(&hdr, sizeof(hdr), 1, d.f) != 1)
+			failed++;
+	} else {
+		d.jdevs = json_object_new_array();
+		if (!d.jdevs)
+			failed++;
+	}
+
+	for (i = 0; i < argc && !failed; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, argv[i]))
+				continue;
+			rc = link_dbg_dump_memdev(&d, memdev);
+			if (rc) {
+				fprintf(stderr, "%s: dump failed: %s\n",
+						cxl_memdev_get_devname(memdev),
+						strerror(-rc));
+				failed++;
+			}
+		}
+
+	if (d.jdevs) {
+		fprintf(d.f, "%s\n", json_object_to_json_string_ext(d.jdevs,
+					JSON_C_TO_STRING_PRETTY));
+		json_object_put(d.jdevs);
+	}
+	if (d.f != stdout && fclose(d.f) != 0)
+		failed++;
+	return failed ? EXIT_FAILURE : 0;
+}
@@ -3,9 +3,13 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <limits.h>
+#include <poll.h>
+#include <time.h>
 #include <util/json.h>
+#include <util/monitor.h>
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <cxl/libcxl.h>
@@ -14,8 +18,16 @@
 
 static struct {
 	bool memdevs;
+	bool ports;
+	bool decoders;
+	bool regions;
 	bool idle;
 	bool human;
+	bool inventory;
+	bool commands;
+	bool dax;
+	bool watch;
+	const char *fields;
 } list;
 
 static unsigned long listopts_to_flags(void)
@@ -26,12 +38,24 @@ static unsigned long listopts_to_flags(void)
 		flags |= UTIL_JSON_IDLE;
 	if (list.human)
 		flags |= UTIL_JSON_HUMAN;
+	if (list.inventory)
+		flags |= UTIL_JSON_INVENTORY;
+	if (list.commands)
+		flags |= UTIL_JSON_COMMANDS;
+	if (list.dax)
+		flags |= UTIL_JSON_DAX;
+	if (list.fields)
+		flags |= UTIL_JSON_FIELDS;
 	return flags;
 }
 
 static struct {
 	const char *memdev;
-} param;
+	const char *format;
+	unsigned int interval;
+} param = {
+	.interval = 10,
+};
 
 static int did_fail;
 
@@ -42,9 +66,398 @@ do { \
 			VERSION, __func__, __LINE__, ##__VA_ARGS__); \
 } while (0)
 
+/*
+ * newline delimited json: one compact object per line, written and
+ * released as soon as it is built so consumers see devices as they
+ * are enumerated
+ */
+static void display_ndjson(FILE *f_out, struct json_object *jobj)
+{
+	fprintf(f_out, "%s\n", json_object_to_json_string_ext(jobj,
+				JSON_C_TO_STRING_PLAIN));
+	fflush(f_out);
+	json_object_put(jobj);
+}
+
 static int num_list_flags(void)
 {
-	return list.memdevs;
+	return list.memdevs + list.ports + list.decoders + list.regions;
+}
+
+/*
+ * With a single object type selected the listing is a bare array as
+ * before, with several each type gets its own array in a top-level
+ * object. ndjson output is one object per line either way.
+ */
+struct list_ctx {
+	struct json_object *jtop;
+	struct util_json_stream *stream;
+	bool ndjson;
+	unsigned long flags;
+};
+
+static void list_append(struct list_ctx *lctx, const char *key,
+		struct json_object **jarray, struct json_object *jobj)
+{
+	if (!jobj) {
+		fail("\n");
+		return;
+	}
+	util_json_fields_prune(jobj, lctx->flags);
+	if (lctx->ndjson) {
+		display_ndjson(stdout, jobj);
+		return;
+	}
+	if (lctx->stream) {
+		util_json_stream_add(lctx->stream, jobj);
+		return;
+	}
+	if (!*jarray) {
+		*jarray = json_object_new_array();
+		if (!*jarray) {
+			fail("\n");
+			json_object_put(jobj);
+			return;
+		}
+		if (lctx->jtop)
+			json_object_object_add(lctx->jtop, key, *jarray);
+	}
+	json_object_array_add(*jarray, jobj);
+}
+
+static void list_topology(struct cxl_ctx *ctx, struct list_ctx *lctx,
+		struct json_object **jports, struct json_object **jdecoders,
+		struct json_object **jregions)
+{
+	struct cxl_decoder *decoder;
+	struct cxl_region *region;
+	struct cxl_port *port;
+
+	cxl_port_foreach(ctx, port) {
+		if (list.ports)
+			list_append(lctx, "ports", jports,
+				 util_cxl_port_to_json(port, lctx->flags));
+		if (!list.decoders)
+			continue;
+		cxl_decoder_foreach(port, decoder) {
+			if (!list.idle && !cxl_decoder_get_size(decoder))
+				continue;
+			list_append(lctx, "decoders", jdecoders,
+				 util_cxl_decoder_to_json(decoder, lctx->flags));
+		}
+	}
+
+	if (!list.regions)
+		return;
+	cxl_region_foreach(ctx, region) {
+		if (!list.idle && !cxl_region_get_size(region))
+			continue;
+		list_append(lctx, "regions", jregions,
+			 util_cxl_region_to_json(region, lctx->flags));
+	}
+}
+
+static const char * const list_keys[] = {
+	"memdev", "port", "decoder", "region", NULL
+};
+static const char * const list_subsystems[] = { "cxl", "dax", NULL };
+
+/* debounce, region assembly is a burst of uevents */
+#define LIST_WATCH_SETTLE_MS 100
+
+struct list_arrays {
+	struct json_object *jdevs;
+	struct json_object *jports;
+	struct json_object *jdecoders;
+	struct json_object *jregions;
+};
+
+static void list_walk(struct cxl_ctx *ctx, struct list_ctx *lctx,
+		struct list_arrays *arr)
+{
+	struct cxl_memdev *memdev;
+
+	cxl_memdev_foreach(ctx, memdev) {
+		if (!util_cxl_memdev_filter(memdev, param.memdev))
+			continue;
+
+		if (list.memdevs)
+			list_append(lctx, "memdevs", &arr->jdevs,
+				 util_cxl_memdev_to_json(memdev, lctx->flags));
+	}
+
+	list_topology(ctx, lctx, &arr->jports, &arr->jdecoders,
+			&arr->jregions);
+}
+
+static void list_arrays_put(struct list_arrays *arr)
+{
+	json_object_put(arr->jdevs);
+	json_object_put(arr->jports);
+	json_object_put(arr->jdecoders);
+	json_object_put(arr->jregions);
+	memset(arr, 0, sizeof(*arr));
+}
+
+static struct json_object *health_to_json(struct cxl_cmd *cmd)
+{
+	static const struct {
+		const char *name;
+		int (*get)(struct cxl_cmd *cmd);
+	} fields[] = {
+		{ "health_status", cxl_cmd_get_health_info_get_health_status },
+		{ "media_status", cxl_cmd_get_health_info_get_media_status },
+		{ "ext_status", cxl_cmd_get_health_info_get_ext_status },
+		{ "life_used", cxl_cmd_get_health_info_get_life_used },
+		{ "temperature", cxl_cmd_get_health_info_get_temperature },
+		{ "dirty_shutdowns",
+			cxl_cmd_get_health_info_get_dirty_shutdowns },
+		{ "volatile_errors",
+			cxl_cmd_get_health_info_get_volatile_errors },
+		{ "pmem_errors", cxl_cmd_get_health_info_get_pmem_errors },
+	};
+	struct json_object *jhealth, *jobj;
+	unsigned int i;
+
+	jhealth = json_object_new_object();
+	if (!jhealth)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(fields); i++) {
+		jobj = json_object_new_int(fields[i].get(cmd));
+		if (jobj)
+			json_object_object_add(jhealth, fields[i].name, jobj);
+	}
+	return jhealth;
+}
+
+static struct cxl_memdev *find_memdev(struct cxl_ctx *ctx, const char *name)
+{
+	struct cxl_memdev *memdev;
+
+	cxl_memdev_foreach(ctx, memdev)
+		if (strcmp(cxl_memdev_get_devname(memdev), name) == 0)
+			return memdev;
+	return NULL;
+}
+
+/*
+ * One get-health-info per listed memdev, all issued together through
+ * a command batch, and stored as each memdev's "health" attribute,
+ * replacing what the previous round put there.
+ */
+static void list_health(struct cxl_ctx *ctx, struct json_object *jdevs)
+{
+	int i, idx, nr = jdevs ? json_object_array_length(jdevs) : 0;
+	struct json_object *jdev, *jobj, *jhealth;
+	struct cxl_cmd_batch *batch;
+	struct cxl_memdev *memdev;
+	struct cxl_cmd *cmd;
+	int *slot;
+
+	if (!nr)
+		return;
+	batch = cxl_cmd_batch_new(ctx);
+	slot = calloc(nr, sizeof(*slot));
+	if (!batch || !slot)
+		goto out;
+
+	for (i = 0; i < nr; i++) {
+		slot[i] = -1;
+		jdev = json_object_array_get_idx(jdevs, i);
+		if (!json_object_object_get_ex(jdev, "memdev", &jobj))
+			continue;
+		memdev = find_memdev(ctx, json_object_get_string(jobj));
+		if (!memdev)
+			continue;
+		cmd = cxl_cmd_new_get_health_info(memdev);
+		if (!cmd)
+			continue;
+		slot[i] = cxl_cmd_batch_add(batch, cmd);
+		cxl_cmd_unref(cmd);
+	}
+	cxl_cmd_batch_submit(batch);
+
+	for (i = 0; i < nr; i++) {
+		idx = slot[i];
+		if (idx < 0)
+			continue;
+		cmd = cxl_cmd_batch_get_cmd(batch, idx);
+		if (cxl_cmd_batch_get_result(batch, idx) < 0
+				|| cxl_cmd_get_mbox_status(cmd))
+			continue;
+		jhealth = health_to_json(cmd);
+		if (jhealth)
+			json_object_object_add(json_object_array_get_idx(jdevs,
+						i), "health", jhealth);
+	}
+out:
+	free(slot);
+	cxl_cmd_batch_free(batch);
+}
+
+static int list_snap(struct list_arrays *arr, struct util_json_snap *snap)
+{
+	struct json_object *jarrays[] = {
+		arr->jdevs, arr->jports, arr->jdecoders, arr->jregions,
+	};
+	unsigned int i;
+	int rc;
+
+	for (i = 0; i < ARRAY_SIZE(jarrays); i++) {
+		rc = util_json_snap_add_flat(snap, jarrays[i], list_keys);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+/* what 'cxl list' would have printed, the arrays stay with the caller */
+static void list_watch_display(struct list_arrays *arr, unsigned long flags)
+{
+	struct json_object *jtop, *jarray = NULL;
+
+	if (num_list_flags() == 1) {
+		if (list.memdevs)
+			jarray = arr->jdevs;
+		else if (list.ports)
+			jarray = arr->jports;
+		else if (list.decoders)
+			jarray = arr->jdecoders;
+		else
+			jarray = arr->jregions;
+		if (jarray)
+			util_display_json_array(stdout,
+					json_object_get(jarray), flags);
+		return;
+	}
+
+	jtop = json_object_new_object();
+	if (!jtop) {
+		fail("\n");
+		return;
+	}
+	if (arr->jdevs)
+		json_object_object_add(jtop, "memdevs",
+				json_object_get(arr->jdevs));
+	if (arr->jports)
+		json_object_object_add(jtop, "ports",
+				json_object_get(arr->jports));
+	if (arr->jdecoders)
+		json_object_object_add(jtop, "decoders",
+				json_object_get(arr->jdecoders));
+	if (arr->jregions)
+		json_object_object_add(jtop, "regions",
+				json_object_get(arr->jregions));
+	printf("%s\n", json_object_to_json_string_ext(jtop,
+				JSON_C_TO_STRING_PRETTY));
+	json_object_put(jtop);
+}
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+/*
+ * Print the listing once, then one JSON object per line for each
+ * object added, removed, or changed, see util_json_snap_diff(). A
+ * uevent re-walks the topology against a fresh context, the health
+ * of listed memdevs is re-read every @interval seconds, and an
+ * unchanged device produces no output either way.
+ */
+static int list_watch(struct cxl_ctx *ctx, struct list_ctx *lctx,
+		unsigned int interval)
+{
+	unsigned long long deadline = 0, now;
+	struct util_json_snap prev = { 0 }, cur = { 0 };
+	struct cxl_ctx *wctx = cxl_ref(ctx);
+	struct list_arrays arr = { 0 };
+	struct pollfd pfd;
+	int ufd, timeout, rc;
+	bool changed;
+
+	ufd = util_uevent_open();
+	if (ufd < 0) {
+		error("failed to listen for uevents: %s\n", strerror(-ufd));
+		cxl_unref(wctx);
+		return ufd;
+	}
+	pfd.fd = ufd;
+	pfd.events = POLLIN;
+
+	list_walk(wctx, lctx, &arr);
+	if (interval && list.memdevs) {
+		list_health(wctx, arr.jdevs);
+		deadline = now_ms() + interval * 1000ULL;
+	}
+	rc = list_snap(&arr, &prev);
+	if (rc)
+		goto out;
+	list_watch_display(&arr, lctx->flags);
+	fflush(stdout);
+
+	for (;;) {
+		struct cxl_ctx *next;
+
+		timeout = -1;
+		if (deadline) {
+			now = now_ms();
+			timeout = deadline > now ? deadline - now : 0;
+		}
+		rc = poll(&pfd, 1, timeout);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = -errno;
+			break;
+		}
+
+		changed = false;
+		if (rc) {
+			changed = util_uevent_match(ufd, list_subsystems);
+			while (poll(&pfd, 1, LIST_WATCH_SETTLE_MS) > 0)
+				changed |= util_uevent_match(ufd,
+						list_subsystems);
+		}
+
+		if (changed) {
+			rc = cxl_new(&next);
+			if (rc)
+				break;
+			cxl_set_log_priority(next, cxl_get_log_priority(wctx));
+			list_arrays_put(&arr);
+			cxl_unref(wctx);
+			wctx = next;
+			did_fail = 0;
+			list_walk(wctx, lctx, &arr);
+		} else if (!deadline || now_ms() < deadline)
+			continue;
+
+		if (deadline) {
+			list_health(wctx, arr.jdevs);
+			deadline = now_ms() + interval * 1000ULL;
+		}
+
+		rc = list_snap(&arr, &cur);
+		if (rc || did_fail) {
+			util_json_snap_free(&cur);
+			error("failed to re-list, keeping the previous state\n");
+			continue;
+		}
+		util_json_snap_diff(stdout, &prev, &cur);
+		util_json_snap_free(&prev);
+		prev = cur;
+		memset(&cur, 0, sizeof(cur));
+	}
+out:
+	list_arrays_put(&arr);
+	util_json_snap_free(&prev);
+	close(ufd);
+	cxl_unref(wctx);
+	return rc;
 }
 
 int cmd_list(int argc, const char **argv, struct cxl_ctx *ctx)
@@ -54,18 +467,38 @@ int cmd_list(int argc, const char **argv, struct cxl_ctx *ctx)
 			   "filter by CXL memory device name"),
 		OPT_BOOLEAN('D', "memdevs", &list.memdevs,
 			    "include CXL memory device info"),
+		OPT_BOOLEAN('P', "ports", &list.ports,
+			    "include CXL port info"),
+		OPT_BOOLEAN('X', "decoders", &list.decoders,
+			    "include CXL decoder info"),
+		OPT_BOOLEAN('R', "regions", &list.regions,
+			    "include CXL region info"),
 		OPT_BOOLEAN('i', "idle", &list.idle, "include idle devices"),
 		OPT_BOOLEAN('u', "human", &list.human,
 				"use human friendly number formats "),
+		OPT_BOOLEAN('I', "inventory", &list.inventory,
+				"include identify, firmware and DIMM slot info"),
+		OPT_BOOLEAN('C', "commands", &list.commands,
+				"include supported command sets from the CEL"),
+		OPT_BOOLEAN('x', "dax", &list.dax,
+				"include the dax devices and NUMA nodes of regions"),
+		OPT_STRING('f', "format", &param.format, "format",
+				"output format: json (default) or ndjson"),
+		OPT_STRING('\0', "fields", &list.fields, "field[,field...]",
+				"only collect and print these attributes"),
+		OPT_BOOLEAN('\0', "watch", &list.watch,
+				"keep running and print changes as they happen"),
+		OPT_UINTEGER('\0', "interval", &param.interval,
+				"seconds between health reads with --watch (default 10, 0: never)"),
 		OPT_END(),
 	};
 	const char * const u[] = {
 		"cxl list [<options>]",
 		NULL
 	};
-	struct json_object *jdevs = NULL;
-	unsigned long list_flags;
-	struct cxl_memdev *memdev;
+	struct list_arrays arr = { 0 };
+	struct list_ctx lctx = { 0 };
+	struct util_json_stream out;
 	int i;
 
 	argc = parse_options(argc, argv, options, u, 0);
@@ -75,37 +508,53 @@ int cmd_list(int argc, const char **argv, struct cxl_ctx *ctx)
 	if (argc)
 		usage_with_options(u, options);
 
+	if (param.format && strcmp(param.format, "ndjson") == 0)
+		lctx.ndjson = true;
+	else if (param.format && strcmp(param.format, "json") != 0) {
+		error("unknown format \"%s\"\n", param.format);
+		usage_with_options(u, options);
+	}
+
 	if (num_list_flags() == 0)
 		list.memdevs = true;
 
-	list_flags = listopts_to_flags();
-
-	cxl_memdev_foreach(ctx, memdev) {
-		struct json_object *jdev = NULL;
-
-		if (!util_cxl_memdev_filter(memdev, param.memdev))
-			continue;
+	if (list.fields) {
+		if (util_json_fields_parse(list.fields)) {
+			error("invalid --fields \"%s\"\n", list.fields);
+			usage_with_options(u, options);
+		}
+		/* no Get Health Info for health nobody asked for */
+		if (!util_json_want(UTIL_JSON_FIELDS, "health"))
+			param.interval = 0;
+	}
 
-		if (list.memdevs) {
-			if (!jdevs) {
-				jdevs = json_object_new_array();
-				if (!jdevs) {
-					fail("\n");
-					continue;
-				}
-			}
-
-			jdev = util_cxl_memdev_to_json(memdev, list_flags);
-			if (!jdev) {
-				fail("\n");
-				continue;
-			}
-			json_object_array_add(jdevs, jdev);
+	lctx.flags = listopts_to_flags();
+	if (list.watch) {
+		if (lctx.ndjson) {
+			error("--watch output is always json\n");
+			usage_with_options(u, options);
 		}
+		return list_watch(ctx, &lctx, param.interval);
 	}
 
-	if (jdevs)
-		util_display_json_array(stdout, jdevs, list_flags);
+	if (num_list_flags() > 1 && !lctx.ndjson) {
+		lctx.jtop = json_object_new_object();
+		if (!lctx.jtop)
+			return -ENOMEM;
+	} else if (!lctx.ndjson) {
+		/* a single bare array can be written as it is built */
+		util_json_stream_init(&out, stdout, lctx.flags);
+		lctx.stream = &out;
+	}
+
+	list_walk(ctx, &lctx, &arr);
+
+	if (lctx.jtop) {
+		printf("%s\n", json_object_to_json_string_ext(lctx.jtop,
+					JSON_C_TO_STRING_PRETTY));
+		json_object_put(lctx.jtop);
+	} else if (lctx.stream)
+		util_json_stream_end(lctx.stream);
 
 	if (did_fail)
 		return -ENOMEM;
@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <ccan/endian/endian.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+/*
+ * ltmon-record ring file: a struct ltmon_ring_header followed by
+ * @nr_slots fixed size slots, each a struct ltmon_record and room for
+ * @slot_entries little endian 64-bit log entries. @head is the slot
+ * written next; once @nr_records exceeds @nr_slots the oldest record
+ * sits at @head. The header is rewritten after every record so a
+ * reader always sees a consistent ring.
+ */
+#define LTMON_RING_MAGIC "CXLLTMON"
+#define LTMON_RING_VERSION 1
+#define LTMON_FREEZE 1
+#define LTMON_RESTORE 0
+
+struct ltmon_ring_header {
+	char magic[8];
+	__le32 version;
+	__le32 slot_entries;
+	__le64 nr_slots;
+	__le64 head;
+	__le64 nr_records;
+	u8 cxl_mem_id;
+	u8 rsvd[7];
+} __attribute__((packed));
+
+struct ltmon_record {
+	__le64 timestamp_ns;
+	__le16 trig_cnt;
+	__le16 time_stamp;
+	__le16 nr_entries;
+	__le16 rsvd;
+} __attribute__((packed));
+
+static struct {
+	const char *outfile;
+	unsigned int cxl_mem_id;
+	unsigned int capt_mode;
+	unsigned int ignore_sub_chg;
+	unsigned int ignore_rxl0_chg;
+	unsigned int trig_src_sel;
+	unsigned int interval;
+	unsigned int entries;
+	unsigned int slots;
+	unsigned int count;
+	bool verbose;
+} param = {
+	.interval = 1000,
+	.entries = 64,
+	.slots = 4096,
+};
+
+struct ltmon_ring {
+	int fd;
+	struct ltmon_ring_header hdr;
+	size_t slot_size;
+	void *slot;
+};
+
+static volatile sig_atomic_t ltmon_stop;
+
+static void ltmon_stop_handler(int sig)
+{
+	ltmon_stop = 1;
+}
+
+static u64 ltmon_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int ltmon_pwrite(int fd, const void *buf, size_t len, off_t off)
+{
+	ssize_t rc;
+
+	while (len) {
+		rc = pwrite(fd, buf, len, off);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf = (const char *) buf + rc;
+		len -= rc;
+		off += rc;
+	}
+
+	return 0;
+}
+
+/* reopen an existing ring of the same geometry, or start a new one */
+static int ltmon_ring_open(struct ltmon_ring *ring, const char *path)
+{
+	struct ltmon_ring_header *hdr = &ring->hdr;
+	ssize_t rc;
+
+	ring->slot_size = sizeof(struct ltmon_record)
+		+ param.entries * sizeof(u64);
+	ring->slot = calloc(1, ring->slot_size);
+	if (!ring->slot)
+		return -ENOMEM;
+
+	ring->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (ring->fd < 0)
+		return -errno;
+
+	rc = pread(ring->fd, hdr, sizeof(*hdr), 0);
+	if (rc == sizeof(*hdr)
+			&& memcmp(hdr->magic, LTMON_RING_MAGIC, sizeof(hdr->magic)) == 0
+			&& le32_to_cpu(hdr->version) == LTMON_RING_VERSION
+			&& le32_to_cpu(hdr->slot_entries) == param.entries
+			&& le64_to_cpu(hdr->nr_slots) == param.slots
+			&& le64_to_cpu(hdr->head) < param.slots)
+		return 0;
+	if (rc > 0) {
+		fprintf(stderr, "%s: not an ltmon-record ring of this geometry\n",
+				path);
+		return -EINVAL;
+	}
+
+	memset(hdr, 0, sizeof(*hdr));
+	memcpy(hdr->magic, LTMON_RING_MAGIC, sizeof(hdr->magic));
+	hdr->version = cpu_to_le32(LTMON_RING_VERSION);
+	hdr->slot_entries = cpu_to_le32(param.entries);
+	hdr->nr_slots = cpu_to_le64(param.slots);
+	hdr->cxl_mem_id = param.cxl_mem_id;
+	if (ftruncate(ring->fd, sizeof(*hdr)
+				+ (off_t) param.slots * ring->slot_size) < 0)
+		return -errno;
+	return ltmon_pwrite(ring->fd, hdr, sizeof(*hdr), 0);
+}
+
+static int ltmon_ring_commit(struct ltmon_ring *ring)
+{
+	struct ltmon_ring_header *hdr = &ring->hdr;
+	u64 head = le64_to_cpu(hdr->head);
+	off_t off = sizeof(*hdr) + (off_t) head * ring->slot_size;
+	int rc;
+
+	rc = ltmon_pwrite(ring->fd, ring->slot, ring->slot_size, off);
+	if (rc)
+		return rc;
+
+	hdr->head = cpu_to_le64((head + 1) % param.slots);
+	hdr->nr_records = cpu_to_le64(le64_to_cpu(hdr->nr_records) + 1);
+	return ltmon_pwrite(ring->fd, hdr, sizeof(*hdr), 0);
+}
+
+static int ltmon_submit(struct cxl_cmd *cmd)
+{
+	int rc = cxl_cmd_submit(cmd);
+
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	return rc;
+}
+
+/*
+ * One freeze / status / dump / restore cycle into the ring's staging
+ * slot. The capture is restored even when the dump fails.
+ */
+static int ltmon_record_one(struct cxl_memdev *memdev, struct ltmon_ring *ring,
+		struct cxl_cmd *stat, struct cxl_cmd *dmp)
+{
+	struct ltmon_record *rec = ring->slot;
+	u64 *entries = (void *) (rec + 1);
+	unsigned int nr_entries = 0;
+	const u64 *data;
+	int nr, rc;
+
+	rc = cxl_memdev_ltmon_capture_freeze_and_restore(memdev,
+			param.cxl_mem_id, LTMON_FREEZE);
+	if (rc)
+		return rc;
+
+	memset(ring->slot, 0, ring->slot_size);
+	rec->timestamp_ns = cpu_to_le64(ltmon_now_ns());
+
+	rc = ltmon_submit(stat);
+	if (rc)
+		goto restore;
+	rec->trig_cnt = cpu_to_le16(cxl_cmd_ltmon_capture_stat_get_trig_cnt(stat));
+	rec->time_stamp = cpu_to_le16(cxl_cmd_ltmon_capture_stat_get_time_stamp(stat));
+
+	while (nr_entries < param.entries) {
+		cxl_cmd_ltmon_capture_log_dmp_set_range(dmp, nr_entries,
+				param.entries - nr_entries);
+		rc = ltmon_submit(dmp);
+		if (rc)
+			goto restore;
+		nr = cxl_cmd_ltmon_capture_log_dmp_get_entries(dmp, &data);
+		if (nr <= 0) {
+			rc = nr;
+			break;
+		}
+		memcpy(&entries[nr_entries], data, nr * sizeof(*data));
+		nr_entries += nr;
+	}
+	rec->nr_entries = cpu_to_le16(nr_entries);
+
+restore:
+	if (cxl_memdev_ltmon_capture_freeze_and_restore(memdev,
+				param.cxl_mem_id, LTMON_RESTORE) && !rc)
+		rc = -ENXIO;
+	return rc;
+}
+
+static int ltmon_record(struct cxl_memdev *memdev, struct ltmon_ring *ring)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct timespec delay = {
+		.tv_sec = param.interval / 1000,
+		.tv_nsec = (param.interval % 1000) * 1000000L,
+	};
+	struct cxl_cmd *stat, *dmp = NULL;
+	unsigned long long records = 0;
+	int rc = -ENOMEM;
+
+	stat = cxl_cmd_new_ltmon_capture_stat(memdev, param.cxl_mem_id);
+	if (stat)
+		dmp = cxl_cmd_new_ltmon_capture_log_dmp(memdev, param.cxl_mem_id);
+	if (!dmp)
+		goto out;
+
+	rc = cxl_memdev_ltmon_capture(memdev, param.cxl_mem_id,
+			param.capt_mode, param.ignore_sub_chg,
+			param.ignore_rxl0_chg, param.trig_src_sel);
+	if (rc)
+		goto out;
+
+	while (!ltmon_stop) {
+		rc = ltmon_record_one(memdev, ring, stat, dmp);
+		if (rc)
+			break;
+		rc = ltmon_ring_commit(ring);
+		if (rc)
+			break;
+		if (param.count && ++records >= param.count)
+			break;
+		nanosleep(&delay, NULL);
+	}
+
+	fprintf(stderr, "%s: %llu records written, %llu in ring\n", devname,
+			records, (unsigned long long)
+			le64_to_cpu(ring->hdr.nr_records));
+out:
+	cxl_cmd_unref(dmp);
+	cxl_cmd_unref(stat);
+	if (rc)
+		fprintf(stderr, "%s: recording stopped: %s\n", devname,
+				strerror(-rc));
+	return rc;
+}
+
+int cmd_ltmon_record(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_FILENAME('o', "output", &param.outfile, "output-file",
+				"ring file to record into"),
+		OPT_UINTEGER('c', "cxl_mem_id", &param.cxl_mem_id, "CXL.MEM ID"),
+		OPT_UINTEGER('d', "capt_mode", &param.capt_mode, "Capture Mode"),
+		OPT_UINTEGER('i', "ignore_sub_chg", &param.ignore_sub_chg,
+				"Ignore Sub Change"),
+		OPT_UINTEGER('j', "ignore_rxl0_chg", &param.ignore_rxl0_chg,
+				"Ignore Receiver L0 Change"),
+		OPT_UINTEGER('t', "trig_src_sel", &param.trig_src_sel,
+				"Trigger Source Selection"),
+		OPT_UINTEGER('p', "interval", &param.interval,
+				"milliseconds between dumps (default 1000)"),
+		OPT_UINTEGER('e', "entries", &param.entries,
+				"log entries to dump per record (default 64)"),
+		OPT_UINTEGER('s', "slots", &param.slots,
+				"records the ring holds (default 4096)"),
+		OPT_UINTEGER('n', "count", &param.count,
+				"stop after <n> records (default: until interrupted)"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl ltmon-record <mem0> -o <file> [<options>]",
+		NULL
+	};
+	struct sigaction sa = { .sa_handler = ltmon_stop_handler };
+	struct cxl_memdev *memdev, *found = NULL;
+	struct ltmon_ring ring = { .fd = -1 };
+	int rc;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc != 1 || !param.outfile)
+		usage_with_options(u, options);
+	if (!param.entries || param.entries > UINT16_MAX || !param.slots) {
+		fprintf(stderr, "--entries must be 1-%d and --slots non-zero\n",
+				UINT16_MAX);
+		return EXIT_FAILURE;
+	}
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	cxl_memdev_foreach(ctx, memdev)
+		if (util_cxl_memdev_filter(memdev, argv[0])) {
+			found = memdev;
+			break;
+		}
+	if (!found) {
+		fprintf(stderr, "%s: no such memdev\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rc = ltmon_ring_open(&ring, param.outfile);
+	if (rc) {
+		fprintf(stderr, "failed to open %s: %s\n", param.outfile,
+				strerror(-rc));
+		goto out;
+	}
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	rc = ltmon_record(found, &ring);
+out:
+	if (ring.fd >= 0)
+		close(ring.fd);
+	free(ring.slot);
+	return rc ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <util/json.h>
+#include <json-c/json.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+#include <util/parse-options.h>
+
+static struct {
+	const char *input;
+	const char *output;
+	unsigned int entries;
+	bool errors;
+	bool human;
+} param = {
+	.entries = 256,
+};
+
+static struct json_object *payload_to_json(const unsigned char *buf,
+		int size)
+{
+	char hex[CXL_MBOX_TRACE_PAYLOAD * 2 + 1];
+	int i, len = size < CXL_MBOX_TRACE_PAYLOAD ? size
+		: CXL_MBOX_TRACE_PAYLOAD;
+
+	if (len <= 0)
+		return NULL;
+	for (i = 0; i < len; i++)
+		sprintf(&hex[i * 2], "%02x", buf[i]);
+	return json_object_new_string(hex);
+}
+
+static struct json_object *trace_entry_to_json(
+		struct cxl_mbox_trace_entry *e, unsigned long flags)
+{
+	struct json_object *jentry, *jobj;
+	char devname[16];
+
+	jentry = json_object_new_object();
+	if (!jentry)
+		return NULL;
+
+	jobj = json_object_new_int64(e->timestamp_ns);
+	if (jobj)
+		json_object_object_add(jentry, "timestamp", jobj);
+
+	snprintf(devname, sizeof(devname), "mem%d", e->memdev_id);
+	jobj = json_object_new_string(devname);
+	if (jobj)
+		json_object_object_add(jentry, "memdev", jobj);
+
+	jobj = util_json_object_hex(e->opcode, flags);
+	if (jobj)
+		json_object_object_add(jentry, "opcode", jobj);
+
+	jobj = json_object_new_int64(e->latency_ns);
+	if (jobj)
+		json_object_object_add(jentry, "latency_ns", jobj);
+
+	if (e->rc) {
+		jobj = json_object_new_string(strerror(-e->rc));
+		if (jobj)
+			json_object_object_add(jentry, "error", jobj);
+	} else {
+		jobj = json_object_new_int(e->mbox_status);
+		if (jobj)
+			json_object_object_add(jentry, "mbox_status", jobj);
+	}
+
+	jobj = json_object_new_int(e->in_size);
+	if (jobj)
+		json_object_object_add(jentry, "in_size", jobj);
+	jobj = payload_to_json(e->in, e->in_size);
+	if (jobj)
+		json_object_object_add(jentry, "in", jobj);
+
+	jobj = json_object_new_int(e->out_size);
+	if (jobj)
+		json_object_object_add(jentry, "out_size", jobj);
+	if (!e->rc) {
+		jobj = payload_to_json(e->out, e->out_size);
+		if (jobj)
+			json_object_object_add(jentry, "out", jobj);
+	}
+
+	return jentry;
+}
+
+static int trace_display(struct cxl_mbox_trace_entry *entries, int n,
+		unsigned long flags)
+{
+	struct json_object *jtrace = json_object_new_array();
+	int i;
+
+	if (!jtrace)
+		return -ENOMEM;
+	for (i = 0; i < n; i++) {
+		struct json_object *jobj;
+
+		if (param.errors && !entries[i].rc && !entries[i].mbox_status)
+			continue;
+		jobj = trace_entry_to_json(&entries[i], flags);
+		if (jobj)
+			json_object_array_add(jtrace, jobj);
+	}
+	util_display_json_array(stdout, jtrace, flags);
+	return 0;
+}
+
+static int trace_read_file(const char *path,
+		struct cxl_mbox_trace_entry **entries)
+{
+	struct cxl_mbox_trace_header hdr;
+	FILE *f = fopen(path, "r");
+	int rc = -EINVAL;
+
+	*entries = NULL;
+	if (!f) {
+		rc = -errno;
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return rc;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1
+			|| memcmp(hdr.magic, CXL_MBOX_TRACE_MAGIC,
+				sizeof(CXL_MBOX_TRACE_MAGIC))
+			|| hdr.version != CXL_MBOX_TRACE_VERSION
+			|| hdr.entry_size != sizeof(**entries)
+			|| hdr.nr_entries > 65536) {
+		fprintf(stderr, "%s: not a mailbox trace\n", path);
+		goto out;
+	}
+	if (hdr.nr_entries) {
+		*entries = calloc(hdr.nr_entries, sizeof(**entries));
+		if (!*entries) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		if (fread(*entries, sizeof(**entries), hdr.nr_entries, f)
+				!= hdr.nr_entries) {
+			fprintf(stderr, "%s: truncated trace\n", path);
+			free(*entries);
+			*entries = NULL;
+			goto out;
+		}
+	}
+	rc = hdr.nr_entries;
+	if (hdr.nr_recorded > hdr.nr_entries)
+		fprintf(stderr, "%s: last %llu of %llu commands\n", path,
+				hdr.nr_entries, hdr.nr_recorded);
+out:
+	fclose(f);
+	return rc;
+}
+
+int cmd_mbox_trace(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_STRING('i', "input", &param.input, "file",
+				"decode a saved trace instead of running a command"),
+		OPT_STRING('o', "output", &param.output, "file",
+				"save the raw trace after running the command"),
+		OPT_UINTEGER('n', "entries", &param.entries,
+				"commands to keep in the trace (default 256)"),
+		OPT_BOOLEAN('e', "errors", &param.errors,
+				"only show failed commands"),
+		OPT_BOOLEAN('u', "human", &param.human,
+				"use human friendly number formats "),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl mbox-trace [<options>] <command> [<args>]",
+		"cxl mbox-trace [<options>] -i <file>",
+		NULL
+	};
+	struct cxl_mbox_trace_entry *entries = NULL;
+	unsigned long flags = 0;
+	int n, fd, rc = 0;
+
+	argc = parse_options(argc, argv, options, u,
+			PARSE_OPT_STOP_AT_NON_OPTION);
+	if (!!param.input == !!argc || (argc && !param.entries))
+		usage_with_options(u, options);
+
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+
+	if (param.input) {
+		n = trace_read_file(param.input, &entries);
+		if (n < 0)
+			return n;
+		rc = trace_display(entries, n, flags);
+		free(entries);
+		return rc;
+	}
+
+	rc = cxl_set_mbox_trace(ctx, param.entries);
+	if (rc)
+		return rc;
+	rc = cxl_run_builtin(argc, argv, ctx);
+
+	if (param.output) {
+		fd = open(param.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0 || cxl_ctx_dump_mbox_trace(ctx, fd))
+			fprintf(stderr, "failed to write %s\n", param.output);
+		if (fd >= 0)
+			close(fd);
+	}
+
+	n = cxl_ctx_get_mbox_trace(ctx, NULL, 0);
+	entries = calloc(n ? n : 1, sizeof(*entries));
+	if (!entries)
+		return -ENOMEM;
+	n = cxl_ctx_get_mbox_trace(ctx, entries, n);
+	trace_display(entries, n, flags);
+	free(entries);
+
+	return rc;
+}
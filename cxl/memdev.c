@@ -3,11 +3,17 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <uuid/uuid.h>
 #include <util/log.h>
+#include <util/json.h>
 #include <util/filter.h>
 #include <util/parse-options.h>
 #include <ccan/list/list.h>
@@ -15,6 +21,9 @@
 #include <ccan/array_size/array_size.h>
 #include <ccan/endian/endian.h>
 #include <ccan/short_types/short_types.h>
+#include <util/fwimage.h>
+#include <util/pool.h>
+#include <json-c/json.h>
 #include <cxl/libcxl.h>
 
 
@@ -22,6 +31,8 @@
 struct action_context {
   FILE *f_out;
   FILE *f_in;
+  /* the action wrapped by action_json() */
+  int (*json_action)(struct cxl_memdev *memdev, struct action_context *actx);
 };
 
 static struct parameters {
@@ -30,6 +41,10 @@ static struct parameters {
   unsigned len;
   unsigned offset;
   bool verbose;
+  bool incremental;
+  unsigned jobs;
+  bool json;
+  bool pretty;
 } param;
 
 #define fail(fmt, ...) \
@@ -38,8 +53,26 @@ do { \
       VERSION, __func__, __LINE__, ##__VA_ARGS__); \
 } while (0)
 
+#define JOBS_OPTION(s) \
+OPT_UINTEGER(s, "jobs", &param.jobs, \
+  "number of memdevs to operate on concurrently (default 1)")
+
+#define JSON_OPTIONS() \
+OPT_BOOLEAN(0, "json", &param.json, \
+  "print decoded results as one JSON object per memdev"), \
+OPT_BOOLEAN(0, "pretty", &param.pretty, \
+  "with --json, indent the output instead of one line per memdev")
+
 #define BASE_OPTIONS() \
-OPT_BOOLEAN('v',"verbose", &param.verbose, "turn on debug")
+OPT_BOOLEAN('v',"verbose", &param.verbose, "turn on debug"), \
+JOBS_OPTION('j'), \
+JSON_OPTIONS()
+
+/* for commands that already use -j for something else */
+#define BASE_OPTIONS_NO_J() \
+OPT_BOOLEAN('v',"verbose", &param.verbose, "turn on debug"), \
+JOBS_OPTION(0), \
+JSON_OPTIONS()
 
 #define READ_OPTIONS() \
 OPT_STRING('o', "output", &param.outfile, "output-file", \
@@ -47,7 +80,9 @@ OPT_STRING('o', "output", &param.outfile, "output-file", \
 
 #define WRITE_OPTIONS() \
 OPT_STRING('i', "input", &param.infile, "input-file", \
-  "filename to read label area data")
+  "filename to read label area data"), \
+OPT_BOOLEAN('I', "incremental", &param.incremental, \
+  "only write label area blocks that differ from the input")
 
 #define LABEL_OPTIONS() \
 OPT_UINTEGER('s', "size", &param.len, "number of label bytes to operate"), \
@@ -144,6 +179,9 @@ static struct _update_fw_params {
   bool hbo;
   bool mock;
   bool verbose;
+  u32 retry_delay_ms;
+  u32 retry_max_ms;
+  u32 retry_timeout;
 } update_fw_params;
 
 #define UPDATE_FW_OPTIONS() \
@@ -151,7 +189,13 @@ OPT_FILENAME('f', "file", &update_fw_params.filepath, "rom-file", \
   "filepath to read ROM for firmware update"), \
 OPT_UINTEGER('s', "slot", &update_fw_params.slot, "slot to use for firmware loading"), \
 OPT_BOOLEAN('b', "background", &update_fw_params.hbo, "runs as hidden background option"), \
-OPT_BOOLEAN('m', "mock", &update_fw_params.mock, "For testing purposes. Mock transfer with only 1 continue then abort")
+OPT_BOOLEAN('m', "mock", &update_fw_params.mock, "For testing purposes. Mock transfer with only 1 continue then abort"), \
+OPT_UINTEGER(0, "retry-delay", &update_fw_params.retry_delay_ms, \
+  "initial delay in ms before retrying a busy device (default 2)"), \
+OPT_UINTEGER(0, "retry-max-delay", &update_fw_params.retry_max_ms, \
+  "cap in ms on the exponential retry delay (default 1000)"), \
+OPT_UINTEGER(0, "retry-timeout", &update_fw_params.retry_timeout, \
+  "seconds to keep retrying a single block before aborting (default 120)")
 
 static const struct option cmd_update_fw_options[] = {
   BASE_OPTIONS(),
@@ -247,11 +291,15 @@ static const struct option cmd_ddr_info_options[] = {
 static struct _get_event_records_params {
   int event_log_type; /* 00 - information, 01 - warning, 02 - failure, 03 - fatal */
   bool verbose;
+  bool drain;
+  bool clear;
 } get_event_records_params;
 
 
 #define GET_EVENT_RECORDS_OPTIONS() \
-OPT_INTEGER('t', "log_type", &get_event_records_params.event_log_type, "Event log type (00 - information (default), 01 - warning, 02 - failure, 03 - fatal)")
+OPT_INTEGER('t', "log_type", &get_event_records_params.event_log_type, "Event log type (00 - information (default), 01 - warning, 02 - failure, 03 - fatal)"), \
+OPT_BOOLEAN('d', "drain", &get_event_records_params.drain, "decode every record in the log rather than the first batch"), \
+OPT_BOOLEAN('c', "clear", &get_event_records_params.clear, "with --drain, clear records as they are read so the whole log is emptied")
 
 static const struct option cmd_get_event_records_options[] = {
   BASE_OPTIONS(),
@@ -358,7 +406,7 @@ OPT_UINTEGER('j', "ignore_rxl0_chg", &ltmon_capture_params.ignore_rxl0_chg, "Ign
 OPT_UINTEGER('t', "trig_src_sel", &ltmon_capture_params.trig_src_sel, "Trigger Source Selection")
 
 static const struct option cmd_ltmon_capture_options[] = {
-  BASE_OPTIONS(),
+  BASE_OPTIONS_NO_J(),
   LTMON_CAPTURE_OPTIONS(),
   OPT_END(),
 };
@@ -1546,7 +1594,7 @@ OPT_UINTEGER('A', "zobel_a_gain", &eh_adapt_force_params.zobel_a_gain, "Zobel a_
 OPT_UINTEGER('x', "ph_ofs_t", &eh_adapt_force_params.ph_ofs_t, "Timing phase offset preload")
 
 static const struct option cmd_eh_adapt_force_options[] = {
-  BASE_OPTIONS(),
+  BASE_OPTIONS_NO_J(),
   EH_ADAPT_FORCE_OPTIONS(),
   OPT_END(),
 };
@@ -1729,15 +1777,26 @@ static const struct option cmd_eh_link_dbg_reset_options[] = {
 static struct _conf_read_params {
 	u32 offset;
 	u32 length;
+	bool all;
+	const char *outfile;
+	bool lspci;
 	bool verbose;
 } conf_read_params;
 
+/* shared by every memdev of the run so that their dumps concatenate */
+static FILE *conf_read_out;
+
 #define CONF_READ_BASE_OPTIONS() \
 OPT_BOOLEAN('v',"verbose", &conf_read_params.verbose, "turn on debug")
 
 #define CONF_READ_OPTIONS() \
 OPT_UINTEGER('o', "offset", &conf_read_params.offset, "Starting Offset"), \
-OPT_UINTEGER('l', "length", &conf_read_params.length, "Requested Length")
+OPT_UINTEGER('l', "length", &conf_read_params.length, "Requested Length"), \
+OPT_BOOLEAN('a', "all", &conf_read_params.all, "read the whole 4K config space"), \
+OPT_STRING('O', "output", &conf_read_params.outfile, "output-file", \
+	"write a binary config space image to <file> ('-' for stdout)"), \
+OPT_BOOLEAN('F', "lspci", &conf_read_params.lspci, \
+	"write the image as 'lspci -xxxx' text, readable with 'lspci -F'")
 
 static const struct option cmd_conf_read_options[] = {
 	CONF_READ_BASE_OPTIONS(),
@@ -1766,10 +1825,12 @@ static struct _hct_read_buffer_params {
 	u32 hct_inst;
 	u32 num_entries_to_read;
 	bool verbose;
+	bool stream;
 } hct_read_buffer_params;
 
 #define HCT_READ_BUFFER_BASE_OPTIONS() \
-OPT_BOOLEAN('v',"verbose", &hct_read_buffer_params.verbose, "turn on debug")
+OPT_BOOLEAN('v',"verbose", &hct_read_buffer_params.verbose, "turn on debug"), \
+OPT_BOOLEAN(0, "stream", &hct_read_buffer_params.stream, "write every page to stdout, raw, until the buffer end")
 
 #define HCT_READ_BUFFER_OPTIONS() \
 OPT_UINTEGER('i', "hct_inst", &hct_read_buffer_params.hct_inst, "HCT Instance"), \
@@ -1934,6 +1995,84 @@ static int action_cmd_clear_event_records(struct cxl_memdev *memdev, struct acti
   }
 }
 
+static int event_record_print(struct cxl_memdev *memdev,
+    const struct cxl_event_record_info *rec, void *priv)
+{
+  int *count = priv;
+  int indent = 2;
+  char uuid[40];
+
+  uuid_unparse(rec->uuid, uuid);
+  switch (rec->type) {
+  case CXL_EVENT_RECORD_DRAM:
+    printf("%*sEvent Record: %d (DRAM guid: %s)\n", indent, "", *count, uuid);
+    break;
+  case CXL_EVENT_RECORD_MEMORY_MODULE:
+    printf("%*sEvent Record: %d (Memory Module Event guid: %s)\n", indent, "", *count, uuid);
+    break;
+  default:
+    printf("%*sEvent Record: %d (uuid: %s)\n", indent, "", *count, uuid);
+    break;
+  }
+  (*count)++;
+
+  indent += 2;
+  printf("%*sevent_record_length: 0x%x\n", indent, "", rec->length);
+  printf("%*sevent_record_flags: 0x%06x\n", indent, "", rec->flags);
+  printf("%*sevent_record_handle: 0x%x\n", indent, "", rec->handle);
+  printf("%*srelated_event_record_handle: 0x%x\n", indent, "", rec->related_handle);
+  printf("%*sevent_record_ts: 0x%llx\n", indent, "", (unsigned long long) rec->timestamp);
+
+  if (rec->type == CXL_EVENT_RECORD_DRAM) {
+    printf("%*sphysical_addr: 0x%llx\n", indent, "", (unsigned long long) rec->dram.physical_addr);
+    printf("%*smemory_event_descriptor: 0x%x\n", indent, "", rec->dram.memory_event_descriptor);
+    printf("%*smemory_event_type: 0x%x\n", indent, "", rec->dram.memory_event_type);
+    printf("%*stransaction_type: 0x%x\n", indent, "", rec->dram.transaction_type);
+    printf("%*svalidity_flags: 0x%x\n", indent, "", rec->dram.validity_flags);
+    printf("%*schannel: 0x%x\n", indent, "", rec->dram.channel);
+    printf("%*srank: 0x%x\n", indent, "", rec->dram.rank);
+    printf("%*snibble_mask: 0x%06x\n", indent, "", rec->dram.nibble_mask);
+    printf("%*sbank_group: 0x%x\n", indent, "", rec->dram.bank_group);
+    printf("%*sbank: 0x%x\n", indent, "", rec->dram.bank);
+    printf("%*srow: 0x%06x\n", indent, "", rec->dram.row);
+    printf("%*scolumn: 0x%x\n", indent, "", rec->dram.column);
+    for (int i = 0; i < 4; i++) {
+      printf("%*scorrection mask[%d]: 0x", indent, "", i);
+      for (int j = 0; j < 8; j++)
+        printf("%02x", rec->dram.correction_mask[i * 8 + j]);
+      printf("\n");
+    }
+  } else if (rec->type == CXL_EVENT_RECORD_MEMORY_MODULE) {
+    printf("%*sdev_event_type: 0x%x\n", indent, "", rec->memory_module.dev_event_type);
+    printf("%*sdev_health_info: 0x", indent, "");
+    for (int i = 0; i < (int) sizeof(rec->memory_module.dev_health_info); i++)
+      printf("%02x", rec->memory_module.dev_health_info[i]);
+    printf("\n");
+  }
+
+  return 0;
+}
+
+static int event_records_drain(struct cxl_memdev *memdev)
+{
+  unsigned int flags = 0;
+  int count = 0;
+  int rc;
+
+  if (get_event_records_params.clear)
+    flags |= CXL_EVENT_DRAIN_CLEAR;
+
+  printf("========= Event Log %d =========\n", get_event_records_params.event_log_type);
+  rc = cxl_memdev_drain_event_records(memdev, get_event_records_params.event_log_type,
+      flags, event_record_print, &count);
+  if (rc < 0)
+    return rc;
+
+  printf("%s: %d event records %s\n", cxl_memdev_get_devname(memdev), rc,
+      get_event_records_params.clear ? "read and cleared" : "read");
+  return 0;
+}
+
 static int action_cmd_get_event_records(struct cxl_memdev *memdev, struct action_context *actx)
 {
   if (cxl_memdev_is_active(memdev)) {
@@ -1950,6 +2089,9 @@ static int action_cmd_get_event_records(struct cxl_memdev *memdev, struct action
   }
 #endif
 
+  if (get_event_records_params.drain)
+    return event_records_drain(memdev);
+
   return cxl_memdev_get_event_records(memdev, get_event_records_params.event_log_type);
 }
 
@@ -2054,9 +2196,54 @@ const char *TRANSFER_FW_ERRORS[15] = {
   "Invalid Payload Length"
 };
 
+/*
+ * Retry pacing for transfer-fw and hbo-status. The delay starts at
+ * --retry-delay, doubles on every retry up to --retry-max-delay, and a
+ * block is given up on once --retry-timeout worth of waiting is spent on
+ * it. Total time spent waiting is kept for the progress output.
+ */
+#define FW_RETRY_DELAY_MS 2
+#define FW_RETRY_MAX_MS 1000
+#define FW_RETRY_TIMEOUT 120
+
+struct fw_backoff {
+  unsigned int delay_ms;
+  unsigned long long block_ms;
+  unsigned long long total_ms;
+};
+
+static void fw_backoff_reset(struct fw_backoff *b)
+{
+  b->delay_ms = update_fw_params.retry_delay_ms ?: FW_RETRY_DELAY_MS;
+  b->block_ms = 0;
+}
+
+/* sleep for the next backoff interval, or -ETIMEDOUT if the budget is spent */
+static int fw_backoff_wait(struct fw_backoff *b)
+{
+  unsigned int max_ms = update_fw_params.retry_max_ms ?: FW_RETRY_MAX_MS;
+  unsigned long long timeout_ms =
+    (update_fw_params.retry_timeout ?: FW_RETRY_TIMEOUT) * 1000ULL;
+  struct timespec ts;
+
+  if (b->block_ms >= timeout_ms)
+    return -ETIMEDOUT;
+
+  ts.tv_sec = b->delay_ms / 1000;
+  ts.tv_nsec = (b->delay_ms % 1000) * 1000000L;
+  while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+    ;
+
+  b->block_ms += b->delay_ms;
+  b->total_ms += b->delay_ms;
+  b->delay_ms = min(b->delay_ms * 2, max(max_ms, b->delay_ms));
+  return 0;
+}
+
 /*
  * Performs inband FW update through a series of successive calls to transfer-fw. The rom
- * is loaded into memory and transfered in 128*n byte chunks. transfer-fw supports several
+ * is loaded into memory and transfered in the largest 128*n byte chunks that fit in the
+ * mailbox payload, reusing a single command for every chunk. transfer-fw supports several
  * actions that are specified as part of the input payload. The first call sets the action
  * to initiate_transfer and includes the first chunk. The remaining chunks are then sent
  * with the continue_transfer action. Finally, the end_transfer action will cause the
@@ -2078,21 +2265,21 @@ struct cxl_ctx {
 };
 static int action_cmd_update_fw(struct cxl_memdev *memdev, struct action_context *actx)
 {
-  struct stat fileStat;
-  int filesize;
+  ssize_t filesize;
   FILE *rom;
   int rc;
-  int fd;
   int num_blocks;
-  int num_read;
-  int size;
-  const int max_retries = 10;
-  int retry_count;
+  ssize_t size;
+  int block_size;
+  struct fw_backoff backoff = { 0 };
+  const char *devname = cxl_memdev_get_devname(memdev);
+  int ret = 0;
   u32 offset;
-  fwblock *rom_buffer;
+  struct fw_image *img;
+  const void *data;
+  struct cxl_cmd *cmd;
   u32 opcode;
   u8 action;
-  int sleep_time = 1;
   int percent_to_print = 0;
   struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
 
@@ -2106,35 +2293,38 @@ static int action_cmd_update_fw(struct cxl_memdev *memdev, struct action_context
   if (cxl_memdev_is_active(memdev)) {
     fprintf(stderr, "%s: memdev active, set_timestamp\n",
       cxl_memdev_get_devname(memdev));
+    fclose(rom);
     return -EBUSY;
   }
 
   dbg(ctx, "Rom filepath: %s\n", update_fw_params.filepath);
-  fd = fileno(rom);
-  rc = fstat(fd, &fileStat);
-  if (rc != 0) {
-    dbg(ctx, "Could not read filesize");
+
+  /* send as much of the image per mailbox command as the device allows */
+  block_size = cxl_memdev_get_fw_transfer_size(memdev);
+  if (block_size < 0) {
+    fprintf(stderr, "%s: could not determine transfer size: %s\n",
+      cxl_memdev_get_devname(memdev), strerror(-block_size));
     fclose(rom);
-    return 1;
+    return block_size;
   }
-
-  filesize = fileStat.st_size;
-  dbg(ctx, "ROM size: %d bytes\n", filesize);
-
-  num_blocks = filesize / FW_BLOCK_SIZE;
-  if (filesize % FW_BLOCK_SIZE != 0)
-  {
-    num_blocks++;
+  dbg(ctx, "Transfer block size: %d bytes\n", block_size);
+
+  /* the image is mapped, or read ahead one block at a time for pipes */
+  img = fw_image_open(fileno(rom), block_size);
+  if (!img) {
+    rc = -errno;
+    fprintf(stderr, "%s: could not read %s: %s\n", devname,
+      update_fw_params.filepath, strerror(errno));
+    fclose(rom);
+    return rc;
   }
 
-  rom_buffer = (fwblock*) malloc(filesize);
-  num_read = fread(rom_buffer, 1, filesize, rom);
-  if (filesize != num_read)
-  {
-    fprintf(stderr, "Number of bytes read: %d\nNumber of bytes expected: %d\n", num_read, num_blocks);
-    free(rom_buffer);
-    fclose(rom);
-    return -ENOENT;
+  /* progress is only reported as a percentage when the size is known */
+  filesize = fw_image_size(img);
+  num_blocks = 0;
+  if (filesize > 0) {
+    dbg(ctx, "ROM size: %zd bytes\n", filesize);
+    num_blocks = (filesize + block_size - 1) / block_size;
   }
 
   offset = 0;
@@ -2144,91 +2334,132 @@ static int action_cmd_update_fw(struct cxl_memdev *memdev, struct action_context
     opcode = 0x0201; // Spec defined transfer-fw
   }
 
-  for (int i = 0; i < num_blocks; i++)
+  /* one command is rewritten and resubmitted for every block */
+  cmd = cxl_cmd_new_transfer_fw(memdev, opcode);
+  if (!cmd) {
+    fprintf(stderr, "%s: could not allocate transfer-fw command\n",
+      cxl_memdev_get_devname(memdev));
+    fw_image_close(img);
+    fclose(rom);
+    return -ENOMEM;
+  }
+
+  for (int i = 0; ; i++)
   {
-    offset = i * (FW_BLOCK_SIZE / FW_BYTE_ALIGN);
+    size = fw_image_next(img, &data);
+    if (size <= 0) {
+      if (i == 0) {
+        fprintf(stderr, "%s: %s is empty\n", devname, update_fw_params.filepath);
+        ret = -EINVAL;
+        goto out;
+      }
+      fprintf(stderr, "%s: reading block %d failed: %s\n", devname, i,
+        size ? strerror(-size) : "image shorter than expected");
+      ret = size ? size : -EIO;
+      goto abort;
+    }
 
-    if ( (i *  100) / num_blocks >= percent_to_print)
+    offset = ((size_t) i * block_size) / FW_BYTE_ALIGN;
+
+    if (num_blocks && (i *  100) / num_blocks >= percent_to_print)
     {
-      printf("%d percent complete. Transfering block %d of %d at offset 0x%x\n", percent_to_print, i, num_blocks, offset);
+      printf("%s: %d percent complete. Transfering block %d of %d at offset 0x%x, %llu ms spent waiting\n",
+        devname, percent_to_print, i, num_blocks, offset, backoff.total_ms);
       percent_to_print = percent_to_print + 10;
     }
 
 
         if (i == 0)
             action = INITIATE_TRANSFER;
-        else if (i == num_blocks - 1)
+        else if (fw_image_last(img))
             action = END_TRANSFER;
         else
             action = CONTINUE_TRANSFER;
 
-        size = FW_BLOCK_SIZE;
-        if (i == num_blocks - 1 && filesize % FW_BLOCK_SIZE != 0) {
-            size = filesize % FW_BLOCK_SIZE;
-        }
-
     fflush(stdout);
-    rc = cxl_memdev_transfer_fw(memdev, action, update_fw_params.slot, offset, size, rom_buffer[i], opcode);
+    rc = cxl_cmd_transfer_fw_set_block(cmd, action, update_fw_params.slot,
+      offset, data, size);
+    if (rc) {
+      fprintf(stderr, "%s: transfer_fw failed on %d of %d\n", devname, i, num_blocks);
+      ret = rc;
+      goto abort;
+    }
 
-    retry_count = 0;
-    sleep_time = 10;
-    while (rc != 0)
+    fw_backoff_reset(&backoff);
+    for (;;)
     {
-      if (retry_count > max_retries)
+      rc = cxl_cmd_submit(cmd);
+      if (rc == 0)
+        rc = cxl_cmd_get_mbox_status(cmd);
+      /* 1: Background Command Started, completion is polled below */
+      if (rc == 0 || rc == 1)
+        break;
+      dbg(ctx, "Mailbox returned %d: %s\nretrying in %u ms...\n", rc,
+        rc > 0 && rc < (int) ARRAY_SIZE(TRANSFER_FW_ERRORS) ?
+        TRANSFER_FW_ERRORS[rc] : strerror(-rc), backoff.delay_ms);
+      if (fw_backoff_wait(&backoff) < 0)
       {
-        fprintf(stderr, "Maximum %d retries exceeded while transferring block %d\n", max_retries, i);
+        fprintf(stderr, "%s: retry timeout of %llu ms exceeded while transferring block %d\n",
+          devname, backoff.block_ms, i);
+        ret = -ETIMEDOUT;
         goto abort;
       }
-      dbg(ctx, "Mailbox returned %d: %s\nretrying in %d seconds...\n", rc, TRANSFER_FW_ERRORS[rc], sleep_time);
-      sleep(sleep_time);
-      rc = cxl_memdev_transfer_fw(memdev, action, update_fw_params.slot, offset, size, rom_buffer[i], opcode);
-      retry_count++;
     }
 
-    if (rc != 0)
-    {
-      fprintf(stderr, "transfer_fw failed on %d of %d\n", i, num_blocks);
-      goto abort;
-    }
-
-    rc = cxl_memdev_hbo_status(memdev, 0);
-    retry_count = 0;
-    sleep_time = 10;
-    while (rc != 0)
+    /*
+     * Only background transfers need their status polled before the
+     * next block: always for the HBO opcode, and for the spec opcode
+     * only when the device reported that it went to the background.
+     */
+    if (update_fw_params.hbo || rc == 1)
     {
-      if (retry_count > max_retries)
+      rc = cxl_memdev_hbo_status(memdev, 0);
+      fw_backoff_reset(&backoff);
+      while (rc != 0)
       {
-        dbg(ctx, "Maximum %d retries exceeded for hbo_status of block %d\n", max_retries, i);
-        goto abort;
+        dbg(ctx, "HBO Status Mailbox returned %d: %s\nretrying in %u ms...\n", rc,
+          rc > 0 && rc < (int) ARRAY_SIZE(TRANSFER_FW_ERRORS) ?
+          TRANSFER_FW_ERRORS[rc] : strerror(-rc), backoff.delay_ms);
+        if (fw_backoff_wait(&backoff) < 0)
+        {
+          fprintf(stderr, "%s: retry timeout of %llu ms exceeded for hbo_status of block %d\n",
+            devname, backoff.block_ms, i);
+          ret = -ETIMEDOUT;
+          goto abort;
+        }
+        rc = cxl_memdev_hbo_status(memdev, 0);
       }
-      dbg(ctx, "HBO Status Mailbox returned %d: %s\nretrying in %d seconds...\n", rc, TRANSFER_FW_ERRORS[rc], sleep_time);
-      sleep(sleep_time);
-      rc = cxl_memdev_hbo_status(memdev, 0);
-      retry_count++;
     }
 
-    if (rc != 0)
+    if (update_fw_params.mock)
     {
-      fprintf(stderr, "transfer_fw failed on %d of %d\n", i, num_blocks);
       goto abort;
     }
 
-    if (update_fw_params.mock)
-    {
-      goto abort;
+    if (fw_image_last(img)) {
+      num_blocks = i + 1;
+      break;
     }
   }
 
+  printf("%s: 100 percent complete. %d blocks transferred, %llu ms spent waiting\n",
+    devname, num_blocks, backoff.total_ms);
   dbg(ctx, "Transfer completed successfully and fw was transferred to slot %d\n", update_fw_params.slot);
   goto out;
 abort:
   sleep(2.0);
-  rc = cxl_memdev_transfer_fw(memdev, ABORT_TRANSFER, update_fw_params.slot, FW_BLOCK_SIZE, FW_BLOCK_SIZE, rom_buffer[0], opcode);
+  rc = cxl_cmd_transfer_fw_set_block(cmd, ABORT_TRANSFER, update_fw_params.slot,
+    0, NULL, 0);
+  if (rc == 0)
+    rc = cxl_cmd_submit(cmd);
+  if (rc == 0)
+    rc = cxl_cmd_get_mbox_status(cmd);
   dbg(ctx, "Abort return status %d\n", rc);
 out:
-  free(rom_buffer);
+  cxl_cmd_unref(cmd);
+  fw_image_close(img);
   fclose(rom);
-  return 0;
+  return ret;
 }
 
 static int action_cmd_get_event_interrupt_policy(struct cxl_memdev *memdev, struct action_context *actx)
@@ -2366,6 +2597,14 @@ static int action_cmd_get_fw_info(struct cxl_memdev *memdev, struct action_conte
   return cxl_memdev_get_fw_info(memdev);
 }
 
+static int activate_fw_progress(struct cxl_memdev *memdev, int opcode,
+    int percent, void *data)
+{
+  printf("%s: activation %d percent complete\n",
+    cxl_memdev_get_devname(memdev), percent);
+  return 0;
+}
+
 static int action_cmd_activate_fw(struct cxl_memdev *memdev, struct action_context *actx)
 {
     int rc;
@@ -2397,21 +2636,11 @@ static int action_cmd_activate_fw(struct cxl_memdev *memdev, struct action_conte
         return rc;
   }
 
-    rc = cxl_memdev_hbo_status(memdev, 0);
-    retry_count = 0;
-  while (rc != 0) {
-        if (retry_count > max_retries) {
-            printf("Maximum %d retries exceeded for hbo_status\n", max_retries);
-            return rc;
-      }
-        printf("HBO Status Mailbox returned %d: %s\nretrying in %d seconds...\n", rc, TRANSFER_FW_ERRORS[rc], sleep_time);
-        sleep(sleep_time);
-        rc = cxl_memdev_hbo_status(memdev, 0);
-    retry_count++;
-  }
-
+  rc = cxl_memdev_bg_wait(memdev, max_retries * sleep_time * 1000,
+      activate_fw_progress, NULL);
   if (rc != 0) {
-        fprintf(stderr, "activate_fw failed for slot %d\n", activate_fw_params.slot);
+        fprintf(stderr, "activate_fw failed for slot %d: %s\n",
+          activate_fw_params.slot, strerror(-rc));
         return rc;
   }
 
@@ -3290,6 +3519,89 @@ static int action_cmd_fbist_test_randomsequence(struct cxl_memdev *memdev, struc
 }
 
 
+/* 'lspci -xxxx' layout, the format 'lspci -F' reads back */
+static void conf_read_lspci(FILE *f, struct cxl_memdev *memdev,
+		const u8 *buf, u32 offset, u32 length)
+{
+	const char *host = cxl_memdev_get_host(memdev);
+	u32 i;
+
+	fprintf(f, "%s CXL memory device (%s)\n", host ? host : "0000:00:00.0",
+			cxl_memdev_get_devname(memdev));
+	for (i = 0; i < length; i++) {
+		if (i % 16 == 0)
+			fprintf(f, "%03x:", offset + i);
+		fprintf(f, " %02x", buf[i]);
+		if (i % 16 == 15 || i + 1 == length)
+			fprintf(f, "\n");
+	}
+	fprintf(f, "\n");
+}
+
+/*
+ * The whole space comes from the per-memdev image libcxl caches, a
+ * partial range is read in payload sized chunks with one command.
+ */
+static int conf_read_dump(struct cxl_memdev *memdev)
+{
+	u32 offset = conf_read_params.offset, length = conf_read_params.length;
+	const char *file = conf_read_params.outfile;
+	const u8 *image;
+	u8 *buf = NULL;
+	int rc = 0;
+
+	if (conf_read_params.all) {
+		offset = 0;
+		length = CXL_CONF_SPACE_SIZE;
+	}
+	if (!length || (offset | length) & 3
+			|| offset + length > CXL_CONF_SPACE_SIZE) {
+		fprintf(stderr, "%s: offset and length must be dword aligned and within %d bytes\n",
+				cxl_memdev_get_devname(memdev), CXL_CONF_SPACE_SIZE);
+		return -EINVAL;
+	}
+
+	if (!conf_read_out) {
+		if (!file || strcmp(file, "-") == 0)
+			conf_read_out = stdout;
+		else
+			conf_read_out = fopen(file, "w");
+		if (!conf_read_out) {
+			rc = -errno;
+			fprintf(stderr, "failed to open: %s: (%s)\n", file,
+					strerror(errno));
+			return rc;
+		}
+	}
+
+	if (offset == 0 && length == CXL_CONF_SPACE_SIZE) {
+		image = cxl_memdev_get_conf_space(memdev);
+		if (!image)
+			rc = -errno;
+	} else {
+		buf = malloc(length);
+		if (!buf)
+			return -ENOMEM;
+		rc = cxl_memdev_conf_read_range(memdev, offset, length, buf);
+		image = buf;
+	}
+	if (rc) {
+		fprintf(stderr, "%s: config space read failed: %s\n",
+				cxl_memdev_get_devname(memdev), strerror(-rc));
+		goto out;
+	}
+
+	if (conf_read_params.lspci)
+		conf_read_lspci(conf_read_out, memdev, image, offset, length);
+	else if (fwrite(image, 1, length, conf_read_out) != length)
+		rc = -EIO;
+	if (fflush(conf_read_out))
+		rc = -errno;
+out:
+	free(buf);
+	return rc;
+}
+
 static int action_cmd_conf_read(struct cxl_memdev *memdev, struct action_context *actx)
 {
 	if (cxl_memdev_is_active(memdev)) {
@@ -3298,7 +3610,12 @@ static int action_cmd_conf_read(struct cxl_memdev *memdev, struct action_context
 		return -EBUSY;
 	}
 
-	return cxl_memdev_conf_read(memdev, conf_read_params.offset, conf_read_params.length);
+	if (!conf_read_params.all && !conf_read_params.outfile
+			&& !conf_read_params.lspci)
+		return cxl_memdev_conf_read(memdev, conf_read_params.offset,
+				conf_read_params.length);
+
+	return conf_read_dump(memdev);
 }
 
 static int action_zero(struct cxl_memdev *memdev, struct action_context *actx)
@@ -3330,6 +3647,24 @@ static int action_cmd_hct_get_config(struct cxl_memdev *memdev, struct action_co
 	return cxl_memdev_hct_get_config(memdev, hct_get_config_params.hct_inst);
 }
 
+static int stream_cmd_hct_read_buffer(struct cxl_cmd *cmd)
+{
+	const u32 *buf;
+	int nr;
+
+	if (!cmd)
+		return -errno;
+	while ((nr = cxl_cmd_hct_read_buffer_next(cmd, &buf)) > 0)
+		if (fwrite(buf, sizeof(*buf), nr, stdout) != (size_t) nr) {
+			nr = -errno;
+			break;
+		}
+	cxl_cmd_unref(cmd);
+	if (fflush(stdout) != 0 && !nr)
+		nr = -errno;
+	return nr;
+}
+
 static int action_cmd_hct_read_buffer(struct cxl_memdev *memdev, struct action_context *actx)
 {
 	if (cxl_memdev_is_active(memdev)) {
@@ -3338,6 +3673,11 @@ static int action_cmd_hct_read_buffer(struct cxl_memdev *memdev, struct action_c
 		return -EBUSY;
 	}
 
+	if (hct_read_buffer_params.stream)
+		return stream_cmd_hct_read_buffer(cxl_cmd_new_hct_read_buffer(memdev,
+			hct_read_buffer_params.hct_inst,
+			hct_read_buffer_params.num_entries_to_read));
+
 	return cxl_memdev_hct_read_buffer(memdev, hct_read_buffer_params.hct_inst,
 		hct_read_buffer_params.num_entries_to_read);
 }
@@ -3479,10 +3819,73 @@ static int action_cmd_pmic_vtmon_info(struct cxl_memdev *memdev, struct action_c
 	return cxl_memdev_pmic_vtmon_info(memdev);
 }
 
+/*
+ * Label images are mapped rather than staged through a heap buffer, so
+ * get-lsa lands straight in the output file's pages and set-lsa reads
+ * straight from the input file's. Pipes and other unmappable streams
+ * fall back to stdio.
+ */
+struct lsa_map {
+  void *addr;
+  size_t len;
+  unsigned char *data;
+};
+
+static int lsa_map_file(FILE *f, size_t size, bool out, struct lsa_map *map)
+{
+  long page = sysconf(_SC_PAGESIZE);
+  int fd = fileno(f);
+  struct stat st;
+  off_t pos, base;
+
+  if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !size)
+    return -ENOTSUP;
+  /* a shared writable mapping needs the file open for reading too */
+  if (out && (fcntl(fd, F_GETFL) & O_ACCMODE) != O_RDWR)
+    return -ENOTSUP;
+  if (fflush(f))
+    return -errno;
+  pos = ftello(f);
+  if (pos < 0)
+    return -ENOTSUP;
+
+  if (out) {
+    if (st.st_size < pos + (off_t) size && ftruncate(fd, pos + size) < 0)
+      return -errno;
+  } else if (st.st_size < pos + (off_t) size)
+    return -ENXIO;
+
+  base = pos & ~((off_t) page - 1);
+  map->len = pos - base + size;
+  map->addr = mmap(NULL, map->len, out ? PROT_READ | PROT_WRITE : PROT_READ,
+      MAP_SHARED, fd, base);
+  if (map->addr == MAP_FAILED)
+    return -ENOTSUP;
+  map->data = (unsigned char *) map->addr + (pos - base);
+
+  /* leave the stream where a sequential read or write would have */
+  if (fseeko(f, pos + size, SEEK_SET) < 0) {
+    munmap(map->addr, map->len);
+    return -errno;
+  }
+  return 0;
+}
+
+static int lsa_unmap_file(struct lsa_map *map, bool out)
+{
+  int rc = 0;
+
+  if (out && msync(map->addr, map->len, MS_SYNC) < 0)
+    rc = -errno;
+  munmap(map->addr, map->len);
+  return rc;
+}
+
 static int action_write(struct cxl_memdev *memdev, struct action_context *actx)
 {
   size_t size = param.len, read_len;
-  unsigned char *buf;
+  struct lsa_map map = { 0 };
+  unsigned char *buf = NULL;
   int rc;
 
   if (cxl_memdev_is_active(memdev)) {
@@ -3506,35 +3909,67 @@ static int action_write(struct cxl_memdev *memdev, struct action_context *actx)
     }
   }
 
-  buf = calloc(1, size);
-  if (!buf)
-    return -ENOMEM;
+  rc = lsa_map_file(actx->f_in, size, false, &map);
+  if (rc == 0)
+    buf = map.data;
+  else if (rc != -ENOTSUP)
+    return rc;
+  else {
+    buf = calloc(1, size);
+    if (!buf)
+      return -ENOMEM;
 
-  read_len = fread(buf, 1, size, actx->f_in);
-  if (read_len != size) {
-    rc = -ENXIO;
-    goto out;
+    read_len = fread(buf, 1, size, actx->f_in);
+    if (read_len != size) {
+      rc = -ENXIO;
+      goto out;
+    }
   }
 
-  rc = cxl_memdev_set_lsa(memdev, buf, size, param.offset);
+  if (param.incremental) {
+    rc = cxl_memdev_update_lsa(memdev, buf, size, param.offset);
+    if (rc >= 0) {
+      if (param.verbose)
+        fprintf(stderr, "%s: wrote %d of %zu label bytes\n",
+          cxl_memdev_get_devname(memdev), rc, size);
+      rc = 0;
+    }
+  } else
+    rc = cxl_memdev_set_lsa(memdev, buf, size, param.offset);
   if (rc < 0)
     fprintf(stderr, "%s: label write failed: %s\n",
       cxl_memdev_get_devname(memdev), strerror(-rc));
 
 out:
-  free(buf);
+  if (map.addr)
+    lsa_unmap_file(&map, false);
+  else
+    free(buf);
   return rc;
 }
-
 static int action_read(struct cxl_memdev *memdev, struct action_context *actx)
 {
   size_t size = param.len, write_len;
+  struct lsa_map map = { 0 };
   char *buf;
   int rc;
 
   if (!size)
     size = cxl_memdev_get_lsa_size(memdev);
 
+  rc = lsa_map_file(actx->f_out, size, true, &map);
+  if (rc == 0) {
+    rc = cxl_memdev_get_lsa(memdev, map.data, size, param.offset);
+    if (rc < 0) {
+      fprintf(stderr, "%s: label read failed: %s\n",
+        cxl_memdev_get_devname(memdev), strerror(-rc));
+      lsa_unmap_file(&map, false);
+      return rc;
+    }
+    return lsa_unmap_file(&map, true);
+  } else if (rc != -ENOTSUP)
+    return rc;
+
   buf = calloc(1, size);
   if (!buf)
     return -ENOMEM;
@@ -3558,13 +3993,259 @@ out:
   return rc;
 }
 
+/*
+ * --json: every vendor field an action decodes is collected, keyed by
+ * command title and field name, into one object per memdev. Whatever
+ * the action still prints as text, such as commands that decode their
+ * output by hand, is captured into "text" so stdout stays valid JSON.
+ */
+static void memdev_json_field(struct cxl_memdev *memdev,
+    const struct cxl_vendor_value *v, void *data)
+{
+  struct json_object *jmemdev = data, *jcmd, *jarray, *jval;
+
+  if (!json_object_object_get_ex(jmemdev, v->cmd, &jcmd)) {
+    jcmd = json_object_new_object();
+    if (!jcmd)
+      return;
+    json_object_object_add(jmemdev, v->cmd, jcmd);
+  }
+
+  if (v->label)
+    jval = json_object_new_string(v->label);
+  else
+    jval = json_object_new_int64(v->value);
+  if (!jval)
+    return;
+  if (v->index < 0) {
+    json_object_object_add(jcmd, v->field, jval);
+    return;
+  }
+
+  if (!json_object_object_get_ex(jcmd, v->field, &jarray)) {
+    jarray = json_object_new_array();
+    if (!jarray) {
+      json_object_put(jval);
+      return;
+    }
+    json_object_object_add(jcmd, v->field, jarray);
+  }
+  json_object_array_add(jarray, jval);
+}
+
+static void memdev_json_text(struct json_object *jmemdev, FILE *text)
+{
+  long len = ftell(text);
+  char *buf;
+
+  if (len <= 0)
+    return;
+  buf = calloc(1, len + 1);
+  if (!buf)
+    return;
+  rewind(text);
+  len = fread(buf, 1, len, text);
+  while (len && buf[len - 1] == '\n')
+    buf[--len] = '\0';
+  json_object_object_add(jmemdev, "text", json_object_new_string(buf));
+  free(buf);
+}
+
+static int action_json(struct cxl_memdev *memdev, struct action_context *actx)
+{
+  struct cxl_ctx *ctx = cxl_memdev_get_ctx(memdev);
+  struct json_object *jmemdev;
+  FILE *text = NULL;
+  int fd, rc;
+
+  jmemdev = json_object_new_object();
+  if (!jmemdev)
+    return -ENOMEM;
+  json_object_object_add(jmemdev, "memdev",
+      json_object_new_string(cxl_memdev_get_devname(memdev)));
+
+  fflush(stdout);
+  fd = dup(STDOUT_FILENO);
+  if (fd >= 0)
+    text = tmpfile();
+  if (!text) {
+    rc = -errno;
+    if (fd >= 0)
+      close(fd);
+    goto out;
+  }
+  dup2(fileno(text), STDOUT_FILENO);
+
+  cxl_set_vendor_output(ctx, memdev_json_field, jmemdev);
+  rc = actx->json_action(memdev, actx);
+  cxl_set_vendor_output(ctx, NULL, NULL);
+
+  fflush(stdout);
+  dup2(fd, STDOUT_FILENO);
+  close(fd);
+  memdev_json_text(jmemdev, text);
+  fclose(text);
+
+out:
+  if (rc)
+    json_object_object_add(jmemdev, "error",
+        json_object_new_string(strerror(abs(rc))));
+  printf("%s\n", json_object_to_json_string_ext(jmemdev,
+        param.pretty ? JSON_C_TO_STRING_PRETTY : JSON_C_TO_STRING_PLAIN));
+  fflush(stdout);
+  json_object_put(jmemdev);
+  return rc;
+}
+
+/*
+ * Run @action on several memdevs at once, at most @nr_jobs at a time.
+ * Each memdev runs in its own child process with stdout and stderr
+ * captured, since both the actions and libcxl print as they go. The
+ * captured output is replayed in the order the memdevs were named, as
+ * soon as a memdev and every memdev before it have finished.
+ */
+struct memdev_job {
+  pid_t pid;
+  FILE *out;
+  FILE *err;
+  int rc;
+  bool done;
+};
+
+static int memdev_job_start(struct memdev_job *job, struct cxl_memdev *memdev,
+    int (*action)(struct cxl_memdev *memdev, struct action_context *actx),
+    struct action_context *actx)
+{
+  int rc;
+
+  job->out = tmpfile();
+  job->err = tmpfile();
+  if (!job->out || !job->err)
+    return -errno;
+
+  /* nothing buffered by the parent may be flushed twice */
+  fflush(stdout);
+  fflush(stderr);
+  job->pid = fork();
+  if (job->pid < 0)
+    return -errno;
+  if (job->pid)
+    return 0;
+
+  dup2(fileno(job->out), STDOUT_FILENO);
+  dup2(fileno(job->err), STDERR_FILENO);
+  rc = action(memdev, actx);
+  fflush(stdout);
+  fflush(stderr);
+  _exit(min(abs(rc), 255));
+}
+
+static void memdev_job_replay(FILE *from, FILE *to)
+{
+  char buf[4096];
+  size_t len;
+
+  if (!from)
+    return;
+  rewind(from);
+  while ((len = fread(buf, 1, sizeof(buf), from)) > 0)
+    fwrite(buf, 1, len, to);
+  fflush(to);
+  fclose(from);
+}
+
+static int memdev_jobs_reap(struct memdev_job *jobs, int nr)
+{
+  int i, status;
+  pid_t pid;
+
+  do {
+    pid = waitpid(-1, &status, 0);
+  } while (pid < 0 && errno == EINTR);
+  if (pid < 0)
+    return -errno;
+
+  for (i = 0; i < nr; i++)
+    if (jobs[i].pid == pid && !jobs[i].done)
+      break;
+  if (i == nr)
+    return 0;
+  jobs[i].rc = WIFEXITED(status) ? -WEXITSTATUS(status) : -EINTR;
+  jobs[i].done = true;
+  return 1;
+}
+
+static int memdev_action_parallel(struct cxl_memdev **memdevs, int nr,
+    int (*action)(struct cxl_memdev *memdev, struct action_context *actx),
+    struct action_context *actx, int nr_jobs, int *count)
+{
+  int i, next = 0, shown = 0, running = 0, failed = 0, rc = 0;
+  struct timespec start, end;
+  struct memdev_job *jobs;
+
+  jobs = calloc(nr, sizeof(*jobs));
+  if (!jobs)
+    return -ENOMEM;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (shown < nr) {
+    for (; running < nr_jobs && next < nr; next++) {
+      jobs[next].rc = memdev_job_start(&jobs[next], memdevs[next],
+          action, actx);
+      if (jobs[next].rc)
+        jobs[next].done = true;
+      else
+        running++;
+    }
+
+    if (running) {
+      i = memdev_jobs_reap(jobs, next);
+      if (i < 0) {
+        fprintf(stderr, "failed to wait for memdev jobs: %s\n",
+            strerror(-i));
+        break;
+      }
+      running -= i;
+    }
+
+    for (; shown < next && jobs[shown].done; shown++) {
+      memdev_job_replay(jobs[shown].out, stdout);
+      memdev_job_replay(jobs[shown].err, stderr);
+    }
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  for (i = 0; i < nr; i++) {
+    if (jobs[i].done && jobs[i].rc == 0) {
+      (*count)++;
+      continue;
+    }
+    if (!jobs[i].done)
+      jobs[i].rc = -ECHILD;
+    fprintf(stderr, "%s: failed: %s\n", cxl_memdev_get_devname(memdevs[i]),
+        strerror(abs(jobs[i].rc)));
+    failed++;
+    if (!rc)
+      rc = jobs[i].rc;
+  }
+  /* with --json, stdout carries only the per-memdev objects */
+  fprintf(param.json ? stderr : stdout,
+      "%d of %d memdevs succeeded, %d failed, %ld seconds elapsed\n",
+      nr - failed, nr, failed, (long) (end.tv_sec - start.tv_sec));
+
+  free(jobs);
+  return rc;
+}
+
 static int memdev_action(int argc, const char **argv, struct cxl_ctx *ctx,
     int (*action)(struct cxl_memdev *memdev, struct action_context *actx),
     const struct option *options, const char *usage)
 {
   struct cxl_memdev *memdev, *single = NULL;
+  struct cxl_memdev **parallel = NULL;
   struct action_context actx = { 0 };
-  int i, rc = 0, count = 0, err = 0;
+  int i, rc = 0, count = 0, err = 0, nr_parallel = 0, nr_jobs = 1;
   const char * const u[] = {
     usage,
     NULL
@@ -3621,10 +4302,22 @@ static int memdev_action(int argc, const char **argv, struct cxl_ctx *ctx,
   if (param.verbose){
     cxl_set_log_priority(ctx, LOG_DEBUG);
   }
+
+  /* label contents are binary, everything else can be decoded */
+  if (param.pretty)
+    param.json = true;
+  if (param.json && action != action_read && action != action_write) {
+    actx.json_action = action;
+    action = action_json;
+  }
   rc = 0;
   err = 0;
   count = 0;
 
+  /* label output to a file and label input must stay in order */
+  if (param.jobs > 1 && action != action_write && actx.f_out == stdout)
+    nr_jobs = util_pool_jobs(param.jobs);
+
   for (i = 0; i < argc; i++) {
     if (sscanf(argv[i], "mem%lu", &id) != 1
         && strcmp(argv[i], "all") != 0)
@@ -3637,6 +4330,24 @@ static int memdev_action(int argc, const char **argv, struct cxl_ctx *ctx,
       if (action == action_write) {
         single = memdev;
         rc = 0;
+      } else if (nr_jobs > 1) {
+        struct cxl_memdev **p;
+        int j;
+
+        /* a memdev named twice must not be handled by two workers */
+        for (j = 0; j < nr_parallel; j++)
+          if (parallel[j] == memdev)
+            break;
+        if (j < nr_parallel)
+          continue;
+        p = realloc(parallel, (nr_parallel + 1) * sizeof(*p));
+        if (!p) {
+          rc = -ENOMEM;
+        } else {
+          parallel = p;
+          parallel[nr_parallel++] = memdev;
+          continue;
+        }
       } else
         rc = action(memdev, &actx);
 
@@ -3648,6 +4359,14 @@ static int memdev_action(int argc, const char **argv, struct cxl_ctx *ctx,
   }
   rc = err;
 
+  if (nr_parallel) {
+    rc = memdev_action_parallel(parallel, nr_parallel, action, &actx,
+        min(nr_jobs, nr_parallel), &count);
+    if (!rc)
+      rc = err;
+    free(parallel);
+  }
+
   if (action == action_write) {
     if (count > 1) {
       error("write-labels only supports writing a single memdev\n");
@@ -4470,6 +5189,9 @@ int cmd_conf_read(int argc, const char **argv, struct cxl_ctx *ctx)
 	int rc = memdev_action(argc, argv, ctx, action_cmd_conf_read, cmd_conf_read_options,
 			"cxl conf_read <mem0> [<mem1>..<memN>] [<options>]");
 
+	if (conf_read_out && conf_read_out != stdout)
+		fclose(conf_read_out);
+
 	return rc >= 0 ? 0 : EXIT_FAILURE;
 }
 
@@ -0,0 +1,594 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <json-c/json.h>
+#include <uuid/uuid.h>
+#include <util/json.h>
+#include <util/util.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <ccan/list/list.h>
+#include <ccan/array_size/array_size.h>
+#include <cxl/libcxl.h>
+#include <cxl/config.h>
+#include <daxctl/libdaxctl.h>
+
+/* reuse the core log helpers for the monitor logger */
+#ifndef ENABLE_LOGGING
+#define ENABLE_LOGGING
+#endif
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include <util/log.h>
+#include <util/monitor.h>
+
+#define CXL_MONITOR_POLL_DEFAULT 60
+#define CXL_EVENT_LOG_NR 4
+#define SOFT_OFFLINE_PAGE "/sys/devices/system/memory/soft_offline_page"
+
+static struct monitor {
+	const char *log;
+	const char *config_file;
+	const char *memdev;
+	const char *poll;
+	bool daemon;
+	bool human;
+	bool verbose;
+	bool health_counters;
+	bool offline_pages;
+	unsigned int poll_interval;
+	struct log_ctx ctx;
+} monitor;
+
+struct health_info {
+	int health_status;
+	int media_status;
+	int ext_status;
+	int life_used;
+	int temperature;
+	int dirty_shutdowns;
+	int volatile_errors;
+	int pmem_errors;
+};
+
+struct health_counter {
+	const char *name;
+	long long (*get)(struct cxl_cmd *cmd);
+};
+
+#define HEALTH_COUNTER(n) { #n, cxl_cmd_health_counters_get_get_##n }
+
+static const struct health_counter health_counters[] = {
+	HEALTH_COUNTER(critical_over_temperature_exceeded),
+	HEALTH_COUNTER(over_temperature_warning_level_exceeded),
+	HEALTH_COUNTER(critical_under_temperature_exceeded),
+	HEALTH_COUNTER(under_temperature_warning_level_exceeded),
+	HEALTH_COUNTER(power_on_events),
+	HEALTH_COUNTER(power_on_hours),
+	HEALTH_COUNTER(cxl_mem_link_crc_errors),
+	HEALTH_COUNTER(cxl_io_link_lcrc_errors),
+	HEALTH_COUNTER(cxl_io_link_ecrc_errors),
+	HEALTH_COUNTER(num_ddr_single_ecc_errors),
+	HEALTH_COUNTER(num_ddr_double_ecc_errors),
+	HEALTH_COUNTER(link_recovery_events),
+	HEALTH_COUNTER(time_in_throttled),
+	HEALTH_COUNTER(rx_retry_request),
+	HEALTH_COUNTER(rcmd_qs0_hi_threshold_detect),
+	HEALTH_COUNTER(rcmd_qs1_hi_threshold_detect),
+};
+
+struct monitor_memdev {
+	struct cxl_memdev *memdev;
+	struct health_info health;
+	bool health_valid;
+	/* previous health counters sample, never cleared on the device */
+	struct cxl_cmd *counters_cmd;
+	unsigned int counters[ARRAY_SIZE(health_counters)];
+	struct timespec counters_ts;
+	bool counters_valid;
+	struct list_node list;
+};
+
+static const char * const event_log_names[CXL_EVENT_LOG_NR] = {
+	"informational", "warning", "failure", "fatal",
+};
+
+static void notify(struct monitor_memdev *mm, const char *event,
+		const char *key, struct json_object *jdata)
+{
+	struct json_object *jmsg, *jobj;
+	struct timespec ts;
+	char timestamp[32];
+
+	jmsg = json_object_new_object();
+	if (!jmsg) {
+		json_object_put(jdata);
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	sprintf(timestamp, "%10ld.%09ld", ts.tv_sec, ts.tv_nsec);
+	jobj = json_object_new_string(timestamp);
+	if (jobj)
+		json_object_object_add(jmsg, "timestamp", jobj);
+
+	jobj = json_object_new_int(getpid());
+	if (jobj)
+		json_object_object_add(jmsg, "pid", jobj);
+
+	jobj = json_object_new_string(event);
+	if (jobj)
+		json_object_object_add(jmsg, "event", jobj);
+
+	jobj = util_cxl_memdev_to_json(mm->memdev, 0);
+	if (jobj)
+		json_object_object_add(jmsg, "memdev", jobj);
+
+	if (jdata)
+		json_object_object_add(jmsg, key, jdata);
+
+	/* one object per line unless a human asked for pretty output */
+	notice(&monitor, "%s\n", json_object_to_json_string_ext(jmsg,
+				monitor.human ? JSON_C_TO_STRING_PRETTY
+				: JSON_C_TO_STRING_PLAIN));
+	json_object_put(jmsg);
+}
+
+static void json_add_u64(struct json_object *jobj, const char *key, u64 v)
+{
+	struct json_object *jval = json_object_new_int64(v);
+
+	if (jval)
+		json_object_object_add(jobj, key, jval);
+}
+
+/* ask the kernel to migrate off and retire the page holding @hpa */
+static int soft_offline_page(unsigned long long hpa)
+{
+	char buf[32];
+	int fd, len, rc = 0;
+
+	fd = open(SOFT_OFFLINE_PAGE, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	len = sprintf(buf, "%#llx", hpa);
+	if (write(fd, buf, len) != len)
+		rc = -errno;
+	close(fd);
+	return rc;
+}
+
+/*
+ * Resolve the DPA of a DRAM record to where the host sees it, and with
+ * --offline-pages retire the page right away when the device reports
+ * the error as uncorrectable or over its correctable threshold.
+ */
+static void dram_event_resolve(struct cxl_memdev *memdev,
+		const struct cxl_event_record_info *rec, struct json_object *jrec)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	u64 dpa = rec->dram.physical_addr & CXL_EVENT_DPA_MASK;
+	struct cxl_hpa_info info;
+	struct json_object *jobj;
+	int rc;
+
+	if (cxl_memdev_dpa_to_hpa(memdev, dpa, &info) < 0) {
+		dbg(&monitor, "%s: dpa %#llx is not mapped\n", devname,
+				(unsigned long long) dpa);
+		return;
+	}
+	json_add_u64(jrec, "hpa", info.hpa);
+	jobj = json_object_new_string(cxl_region_get_devname(info.region));
+	if (jobj)
+		json_object_object_add(jrec, "region", jobj);
+	if (info.dax) {
+		jobj = json_object_new_string(daxctl_dev_get_devname(info.dax));
+		if (jobj)
+			json_object_object_add(jrec, "dax", jobj);
+		json_add_u64(jrec, "dax_offset", info.dax_offset);
+	}
+	if (info.numa_node >= 0)
+		json_add_u64(jrec, "numa_node", info.numa_node);
+
+	if (!monitor.offline_pages || !(rec->dram.memory_event_descriptor
+				& (CXL_EVENT_DESC_UNCORRECTABLE
+					| CXL_EVENT_DESC_THRESHOLD)))
+		return;
+	rc = soft_offline_page(info.hpa);
+	jobj = json_object_new_string(rc ? strerror(-rc) : "offlined");
+	if (jobj)
+		json_object_object_add(jrec, "page_offline", jobj);
+	if (rc)
+		err(&monitor, "%s: soft offline of hpa %#llx failed: %s\n",
+				devname, info.hpa, strerror(-rc));
+}
+
+static int notify_event_record(struct cxl_memdev *memdev,
+		const struct cxl_event_record_info *rec, void *priv)
+{
+	struct monitor_memdev *mm = priv;
+	struct json_object *jrec, *jobj;
+	char uuid[40];
+
+	jrec = json_object_new_object();
+	if (!jrec)
+		return -ENOMEM;
+
+	jobj = json_object_new_string(event_log_names[rec->log_type]);
+	if (jobj)
+		json_object_object_add(jrec, "log", jobj);
+	uuid_unparse(rec->uuid, uuid);
+	jobj = json_object_new_string(uuid);
+	if (jobj)
+		json_object_object_add(jrec, "uuid", jobj);
+	json_add_u64(jrec, "handle", rec->handle);
+	json_add_u64(jrec, "related_handle", rec->related_handle);
+	json_add_u64(jrec, "flags", rec->flags);
+	json_add_u64(jrec, "timestamp", rec->timestamp);
+
+	switch (rec->type) {
+	case CXL_EVENT_RECORD_DRAM:
+		jobj = json_object_new_string("dram");
+		if (jobj)
+			json_object_object_add(jrec, "type", jobj);
+		json_add_u64(jrec, "physical_addr", rec->dram.physical_addr);
+		json_add_u64(jrec, "memory_event_descriptor",
+				rec->dram.memory_event_descriptor);
+		json_add_u64(jrec, "memory_event_type",
+				rec->dram.memory_event_type);
+		json_add_u64(jrec, "transaction_type",
+				rec->dram.transaction_type);
+		json_add_u64(jrec, "validity_flags", rec->dram.validity_flags);
+		json_add_u64(jrec, "channel", rec->dram.channel);
+		json_add_u64(jrec, "rank", rec->dram.rank);
+		json_add_u64(jrec, "nibble_mask", rec->dram.nibble_mask);
+		json_add_u64(jrec, "bank_group", rec->dram.bank_group);
+		json_add_u64(jrec, "bank", rec->dram.bank);
+		json_add_u64(jrec, "row", rec->dram.row);
+		json_add_u64(jrec, "column", rec->dram.column);
+		dram_event_resolve(memdev, rec, jrec);
+		break;
+	case CXL_EVENT_RECORD_MEMORY_MODULE:
+		jobj = json_object_new_string("memory-module");
+		if (jobj)
+			json_object_object_add(jrec, "type", jobj);
+		json_add_u64(jrec, "dev_event_type",
+				rec->memory_module.dev_event_type);
+		break;
+	default:
+		jobj = json_object_new_string("generic");
+		if (jobj)
+			json_object_object_add(jrec, "type", jobj);
+		break;
+	}
+
+	notify(mm, "cxl-event-record", "record", jrec);
+	return 0;
+}
+
+static int health_read(struct cxl_memdev *memdev, struct health_info *h)
+{
+	struct cxl_cmd *cmd;
+	int rc;
+
+	cmd = cxl_cmd_new_get_health_info(memdev);
+	if (!cmd)
+		return -ENOMEM;
+
+	rc = cxl_cmd_submit(cmd);
+	if (rc == 0)
+		rc = cxl_cmd_get_mbox_status(cmd) ? -ENXIO : 0;
+	if (rc == 0) {
+		h->health_status = cxl_cmd_get_health_info_get_health_status(cmd);
+		h->media_status = cxl_cmd_get_health_info_get_media_status(cmd);
+		h->ext_status = cxl_cmd_get_health_info_get_ext_status(cmd);
+		h->life_used = cxl_cmd_get_health_info_get_life_used(cmd);
+		h->temperature = cxl_cmd_get_health_info_get_temperature(cmd);
+		h->dirty_shutdowns =
+			cxl_cmd_get_health_info_get_dirty_shutdowns(cmd);
+		h->volatile_errors =
+			cxl_cmd_get_health_info_get_volatile_errors(cmd);
+		h->pmem_errors = cxl_cmd_get_health_info_get_pmem_errors(cmd);
+	}
+
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+/* report health on the first poll and whenever it changes after that */
+static void monitor_health(struct monitor_memdev *mm)
+{
+	const char *devname = cxl_memdev_get_devname(mm->memdev);
+	struct health_info h;
+	struct json_object *jhealth;
+
+	if (health_read(mm->memdev, &h) < 0) {
+		err(&monitor, "%s: get-health-info failed\n", devname);
+		return;
+	}
+	if (mm->health_valid && memcmp(&h, &mm->health, sizeof(h)) == 0)
+		return;
+	mm->health = h;
+	mm->health_valid = true;
+
+	jhealth = json_object_new_object();
+	if (!jhealth)
+		return;
+	json_add_u64(jhealth, "health_status", h.health_status);
+	json_add_u64(jhealth, "media_status", h.media_status);
+	json_add_u64(jhealth, "ext_status", h.ext_status);
+	json_add_u64(jhealth, "life_used_percent", h.life_used);
+	json_add_u64(jhealth, "temperature", h.temperature);
+	json_add_u64(jhealth, "dirty_shutdowns", h.dirty_shutdowns);
+	json_add_u64(jhealth, "volatile_errors", h.volatile_errors);
+	json_add_u64(jhealth, "pmem_errors", h.pmem_errors);
+	notify(mm, "cxl-health", "health", jhealth);
+}
+
+/*
+ * Report the health counters that moved since the previous poll with
+ * their delta and per-second rate; the first poll reports all of them
+ * as the baseline. A counter that went backwards was cleared by someone
+ * else and its new value is taken as the delta.
+ */
+static void monitor_health_counters(struct monitor_memdev *mm)
+{
+	const char *devname = cxl_memdev_get_devname(mm->memdev);
+	unsigned int v[ARRAY_SIZE(health_counters)];
+	struct json_object *jcounters, *jc;
+	struct timespec ts;
+	double elapsed = 0;
+	int i, rc, changed = 0;
+
+	if (!mm->counters_cmd) {
+		mm->counters_cmd = cxl_cmd_new_health_counters_get(mm->memdev);
+		if (!mm->counters_cmd) {
+			err(&monitor, "%s: health counters cmd alloc failed\n",
+					devname);
+			return;
+		}
+	}
+
+	rc = cxl_cmd_submit(mm->counters_cmd);
+	if (rc == 0)
+		rc = cxl_cmd_get_mbox_status(mm->counters_cmd) ? -ENXIO : 0;
+	if (rc) {
+		err(&monitor, "%s: health-counters-get failed\n", devname);
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	for (i = 0; i < (int) ARRAY_SIZE(health_counters); i++) {
+		long long val = health_counters[i].get(mm->counters_cmd);
+
+		if (val < 0) {
+			err(&monitor, "%s: health-counters-get short payload\n",
+					devname);
+			return;
+		}
+		v[i] = val;
+	}
+
+	jcounters = json_object_new_object();
+	if (!jcounters)
+		return;
+	if (mm->counters_valid)
+		elapsed = (ts.tv_sec - mm->counters_ts.tv_sec)
+			+ (ts.tv_nsec - mm->counters_ts.tv_nsec) / 1e9;
+
+	for (i = 0; i < (int) ARRAY_SIZE(health_counters); i++) {
+		unsigned int delta;
+
+		if (mm->counters_valid && v[i] == mm->counters[i])
+			continue;
+		jc = json_object_new_object();
+		if (!jc)
+			continue;
+		json_add_u64(jc, "value", v[i]);
+		if (mm->counters_valid) {
+			delta = v[i] >= mm->counters[i] ? v[i] - mm->counters[i]
+				: v[i];
+			json_add_u64(jc, "delta", delta);
+			if (elapsed > 0)
+				json_object_object_add(jc, "rate_per_sec",
+						json_object_new_double(delta
+							/ elapsed));
+		}
+		json_object_object_add(jcounters, health_counters[i].name, jc);
+		changed++;
+	}
+
+	memcpy(mm->counters, v, sizeof(v));
+	mm->counters_ts = ts;
+	mm->counters_valid = true;
+
+	if (!changed) {
+		json_object_put(jcounters);
+		return;
+	}
+	notify(mm, "cxl-health-counters", "health_counters", jcounters);
+}
+
+static void monitor_events(struct monitor_memdev *mm)
+{
+	const char *devname = cxl_memdev_get_devname(mm->memdev);
+	int log, rc;
+
+	for (log = 0; log < CXL_EVENT_LOG_NR; log++) {
+		rc = cxl_memdev_drain_event_records(mm->memdev, log,
+				CXL_EVENT_DRAIN_CLEAR, notify_event_record, mm);
+		if (rc < 0)
+			err(&monitor, "%s: draining %s event log failed: %s\n",
+					devname, event_log_names[log],
+					strerror(-rc));
+		else if (rc)
+			dbg(&monitor, "%s: %d %s event records\n", devname,
+					rc, event_log_names[log]);
+	}
+}
+
+static int monitor_loop(struct list_head *memdevs)
+{
+	struct monitor_memdev *mm;
+	struct timespec ts;
+
+	for (;;) {
+		list_for_each(memdevs, mm, list) {
+			monitor_events(mm);
+			monitor_health(mm);
+			if (monitor.health_counters)
+				monitor_health_counters(mm);
+		}
+
+		ts.tv_sec = monitor.poll_interval;
+		ts.tv_nsec = 0;
+		while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+			;
+	}
+
+	return 0;
+}
+
+/* the memdev filter may name several space separated memdevs */
+static bool filter_memdev(struct cxl_memdev *memdev, const char *filter)
+{
+	char *idents, *ident, *save;
+	bool match = false;
+
+	if (!filter)
+		return true;
+
+	idents = strdup(filter);
+	if (!idents)
+		return false;
+	for (ident = strtok_r(idents, " ", &save); ident && !match;
+			ident = strtok_r(NULL, " ", &save))
+		match = util_cxl_memdev_filter(memdev, ident) != NULL;
+	free(idents);
+
+	return match;
+}
+
+static void parse_config(const char *key, const char *value, void *arg)
+{
+	struct monitor *_monitor = arg;
+
+	util_config_append(&_monitor->memdev, "memdev", key, value);
+	if (!_monitor->log)
+		util_config_append(&_monitor->log, "log", key, value);
+	if (!_monitor->poll_interval && !_monitor->poll)
+		util_config_append(&_monitor->poll, "poll", key, value);
+}
+
+int cmd_monitor(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_STRING('d', "memdev", &monitor.memdev, "memdev-id",
+				"filter by memdev"),
+		OPT_FILENAME('l', "log", &monitor.log,
+				"<file> | syslog | standard",
+				"where to output the monitor's notification"),
+		OPT_FILENAME('c', "config-file", &monitor.config_file,
+				"config-file", "override the default config"),
+		OPT_BOOLEAN('\0', "daemon", &monitor.daemon,
+				"run cxl monitor as a daemon"),
+		OPT_BOOLEAN('u', "human", &monitor.human,
+				"use human friendly output formats"),
+		OPT_BOOLEAN('v', "verbose", &monitor.verbose,
+				"emit extra debug messages to log"),
+		OPT_UINTEGER('p', "poll", &monitor.poll_interval,
+				"drain event logs and check health every <n> seconds (default 60)"),
+		OPT_BOOLEAN('\0', "health-counters", &monitor.health_counters,
+				"also report changed vendor health counters"),
+		OPT_BOOLEAN('\0', "offline-pages", &monitor.offline_pages,
+				"soft offline pages hit by DRAM errors"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl monitor [<options>]",
+		NULL
+	};
+	const char *prefix = "./";
+	struct monitor_memdev *mm, *_mm;
+	struct cxl_memdev *memdev;
+	LIST_HEAD(memdevs);
+	int i, rc, count = 0;
+
+	argc = parse_options_prefix(argc, argv, prefix, options, u, 0);
+	for (i = 0; i < argc; i++) {
+		error("unknown parameter \"%s\"\n", argv[i]);
+	}
+	if (argc)
+		usage_with_options(u, options);
+
+	log_init(&monitor.ctx, "cxl/monitor", "CXL_MONITOR_LOG");
+	monitor.ctx.log_fn = util_monitor_log_standard;
+
+	if (monitor.verbose)
+		monitor.ctx.log_priority = LOG_DEBUG;
+	else
+		monitor.ctx.log_priority = LOG_INFO;
+
+	rc = util_read_config_file(&monitor.ctx,
+			monitor.config_file ? monitor.config_file
+			: CXL_MONITOR_CONF_FILE, !!monitor.config_file,
+			parse_config, &monitor);
+	if (rc)
+		goto out;
+	if (!monitor.poll_interval && monitor.poll)
+		monitor.poll_interval = strtoul(monitor.poll, NULL, 0);
+	if (!monitor.poll_interval)
+		monitor.poll_interval = CXL_MONITOR_POLL_DEFAULT;
+
+	if (monitor.log) {
+		rc = util_monitor_set_log(&monitor.ctx, &monitor.log, prefix);
+		if (rc)
+			goto out;
+	}
+
+	if (monitor.daemon) {
+		if (!monitor.log || strncmp(monitor.log, "./", 2) == 0)
+			monitor.ctx.log_fn = util_monitor_log_syslog;
+		if (daemon(0, 0) != 0) {
+			err(&monitor, "daemon start failed\n");
+			goto out;
+		}
+		info(&monitor, "cxl monitor daemon started\n");
+	}
+
+	cxl_memdev_foreach(ctx, memdev) {
+		if (!filter_memdev(memdev, monitor.memdev))
+			continue;
+		mm = calloc(1, sizeof(*mm));
+		if (!mm) {
+			err(&monitor, "%s: calloc for monitor memdev failed\n",
+					cxl_memdev_get_devname(memdev));
+			continue;
+		}
+		mm->memdev = memdev;
+		list_add_tail(&memdevs, &mm->list);
+		count++;
+	}
+
+	if (!count) {
+		info(&monitor, "no memdevs to monitor, exiting\n");
+		if (!monitor.daemon)
+			rc = -ENXIO;
+		goto out;
+	}
+
+	rc = monitor_loop(&memdevs);
+out:
+	list_for_each_safe(&memdevs, mm, _mm, list) {
+		list_del(&mm->list);
+		cxl_cmd_unref(mm->counters_cmd);
+		free(mm);
+	}
+	util_monitor_close_log();
+	return rc;
+}
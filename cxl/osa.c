@@ -0,0 +1,387 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <ccan/endian/endian.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+#include <cxl/capture.h>
+
+/*
+ * osa-capture file: a struct osa_file_header, then one struct
+ * osa_segment index entry per captured lane and direction, then the
+ * segments' entries back to back. Entries are stored exactly as the
+ * device returned them (little endian), and each segment's @offset is
+ * from the start of the file, so a reader can mmap the capture and go
+ * straight to any sample.
+ */
+#define OSA_FILE_MAGIC "CXLOSA\0\0"
+#define OSA_FILE_VERSION 1
+#define OSA_NUM_LANES 16
+#define OSA_NUM_DIRS 2
+#define OSA_ENTRIES_MAX 32
+
+struct osa_file_header {
+	char magic[8];
+	__le32 version;
+	__le16 nr_segments;
+	u8 cxl_mem_id;
+	u8 state;
+	__le64 timestamp_ns;
+	u8 trig_lane;
+	u8 trig_lane_dir;
+	__le16 trig_reason;
+	__le32 rsvd;
+} __attribute__((packed));
+
+struct osa_segment {
+	u8 lane_id;
+	u8 lane_dir;
+	u8 wrap;
+	u8 rsvd;
+	__le32 nr_entries;
+	__le64 offset;
+} __attribute__((packed));
+
+static struct {
+	const char *outfile;
+	unsigned int cxl_mem_id;
+	unsigned int lane_mask;
+	unsigned int lane_dir_mask;
+	unsigned int drop_single_os;
+	unsigned int stop_mode;
+	unsigned int snapshot_mode;
+	unsigned int post_trig_num;
+	unsigned int os_type_mask;
+	int wait_state;
+	unsigned int timeout;
+	bool no_config;
+	bool verbose;
+} param = {
+	.lane_mask = 0xffff,
+	.lane_dir_mask = 0x3,
+	.wait_state = -1,
+	.timeout = 30,
+};
+
+struct osa_capture {
+	struct cxl_memdev *memdev;
+	const char *devname;
+	int fd;
+	u8 *map;
+	size_t len;
+	size_t used;
+	struct osa_segment *seg;
+	int nr_segments;
+};
+
+static u64 osa_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* extend the capture file by @len bytes and remap it */
+static int osa_capture_grow(struct osa_capture *cap, size_t len)
+{
+	size_t new_len = cap->used + len;
+	void *map;
+	int rc;
+
+	if (new_len <= cap->len)
+		return 0;
+
+	rc = posix_fallocate(cap->fd, 0, new_len);
+	if (rc)
+		return -rc;
+
+	if (cap->map)
+		map = mremap(cap->map, cap->len, new_len, MREMAP_MAYMOVE);
+	else
+		map = mmap(NULL, new_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+				cap->fd, 0);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	cap->map = map;
+	cap->len = new_len;
+	cap->seg = (void *) (cap->map + sizeof(struct osa_file_header));
+	return 0;
+}
+
+/*
+ * Record the analyzer state in the file header, optionally polling
+ * until it reaches --wait-state first.
+ */
+static int osa_capture_status(struct osa_capture *cap)
+{
+	struct osa_file_header *hdr = (void *) cap->map;
+	struct timespec delay = { .tv_nsec = 100 * 1000 * 1000 };
+	u64 deadline = osa_now_ns() + param.timeout * 1000000000ULL;
+	struct cxl_cmd *cmd;
+	int state, rc;
+
+	cmd = cxl_cmd_new_osa_status_query(cap->memdev, param.cxl_mem_id);
+	if (!cmd)
+		return -ENOMEM;
+
+	for (;;) {
+		rc = cxl_cmd_submit(cmd);
+		if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+			rc = -ENXIO;
+		if (rc)
+			goto out;
+
+		state = cxl_cmd_osa_status_query_get_state(cmd);
+		if (param.wait_state < 0 || state == param.wait_state)
+			break;
+		if (osa_now_ns() >= deadline) {
+			fprintf(stderr, "%s: timed out in osa state %d waiting for %d\n",
+					cap->devname, state, param.wait_state);
+			rc = -ETIMEDOUT;
+			goto out;
+		}
+		nanosleep(&delay, NULL);
+	}
+
+	hdr->state = state;
+	hdr->trig_lane = cxl_cmd_osa_status_query_get_trig_lane(cmd);
+	hdr->trig_lane_dir = cxl_cmd_osa_status_query_get_trig_lane_dir(cmd);
+	hdr->trig_reason = cpu_to_le16(cxl_cmd_osa_status_query_get_trig_reason(cmd));
+out:
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+/*
+ * Walk one lane/direction of the analyzer buffer. The first response
+ * tells us how many entries remain, so the file is grown once per
+ * segment and every chunk is copied straight into the mapping.
+ */
+static int osa_capture_segment(struct osa_capture *cap, int idx)
+{
+	struct osa_segment *seg = &cap->seg[idx];
+	u32 nr_entries = 0, total = 0;
+	struct cxl_cmd *cmd;
+	const u32 *data;
+	int nr, rem, next, rc = 0;
+
+	cmd = cxl_cmd_new_osa_data_read(cap->memdev, param.cxl_mem_id,
+			seg->lane_id, seg->lane_dir, OSA_ENTRIES_MAX);
+	if (!cmd)
+		return -ENOMEM;
+
+	next = 0;
+	do {
+		cxl_cmd_osa_data_read_set_start(cmd, next);
+		rc = cxl_cmd_submit(cmd);
+		if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+			rc = -ENXIO;
+		if (rc)
+			break;
+
+		nr = cxl_cmd_osa_data_read_get_entries(cmd, &data);
+		rem = cxl_cmd_osa_data_read_get_entries_rem(cmd);
+		next = cxl_cmd_osa_data_read_get_next_entry(cmd);
+		if (nr < 0 || rem < 0 || next < 0) {
+			rc = -EINVAL;
+			break;
+		}
+		if (nr == 0)
+			break;
+
+		if (nr_entries + nr > total) {
+			total = nr_entries + nr + rem;
+			rc = osa_capture_grow(cap, (total - nr_entries)
+					* sizeof(*data));
+			if (rc)
+				break;
+			/* the index may have moved with the mapping */
+			seg = &cap->seg[idx];
+		}
+		memcpy(cap->map + cap->used, data, nr * sizeof(*data));
+		cap->used += nr * sizeof(*data);
+		nr_entries += nr;
+		seg->wrap = cxl_cmd_osa_data_read_get_wrap(cmd);
+	} while (rem);
+
+	seg->nr_entries = cpu_to_le32(nr_entries);
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+static int osa_capture(struct osa_capture *cap)
+{
+	struct osa_file_header *hdr;
+	struct osa_segment *seg;
+	unsigned long long entries = 0;
+	int lane, dir, i, rc;
+
+	for (lane = 0; lane < OSA_NUM_LANES; lane++)
+		for (dir = 0; dir < OSA_NUM_DIRS; dir++)
+			if ((param.lane_mask & (1 << lane))
+					&& (param.lane_dir_mask & (1 << dir)))
+				cap->nr_segments++;
+	if (!cap->nr_segments)
+		return -EINVAL;
+
+	rc = osa_capture_grow(cap, sizeof(*hdr)
+			+ cap->nr_segments * sizeof(*seg));
+	if (rc)
+		return rc;
+	cap->used = cap->len;
+
+	hdr = (void *) cap->map;
+	memcpy(hdr->magic, OSA_FILE_MAGIC, sizeof(hdr->magic));
+	hdr->version = cpu_to_le32(OSA_FILE_VERSION);
+	hdr->nr_segments = cpu_to_le16(cap->nr_segments);
+	hdr->cxl_mem_id = param.cxl_mem_id;
+	hdr->timestamp_ns = cpu_to_le64(osa_now_ns());
+
+	rc = osa_capture_status(cap);
+	if (rc)
+		return rc;
+
+	i = 0;
+	for (lane = 0; lane < OSA_NUM_LANES; lane++)
+		for (dir = 0; dir < OSA_NUM_DIRS; dir++) {
+			if (!(param.lane_mask & (1 << lane))
+					|| !(param.lane_dir_mask & (1 << dir)))
+				continue;
+			seg = &cap->seg[i];
+			seg->lane_id = lane;
+			seg->lane_dir = dir;
+			seg->offset = cpu_to_le64(cap->used);
+			rc = osa_capture_segment(cap, i);
+			if (rc)
+				return rc;
+			entries += le32_to_cpu(cap->seg[i++].nr_entries);
+		}
+
+	fprintf(stderr, "%s: %d segments, %llu entries captured\n",
+			cap->devname, cap->nr_segments, entries);
+	return 0;
+}
+
+static int osa_capture_file(struct osa_capture *cap, const char *path)
+{
+	int rc;
+
+	cap->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (cap->fd < 0) {
+		rc = -errno;
+		fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+		return rc;
+	}
+
+	rc = osa_capture(cap);
+	if (rc)
+		fprintf(stderr, "%s: capture failed: %s\n", cap->devname,
+				strerror(-rc));
+
+	if (cap->map) {
+		msync(cap->map, cap->used, MS_SYNC);
+		munmap(cap->map, cap->len);
+	}
+	/* drop the unused tail of the last allocation */
+	if (ftruncate(cap->fd, cap->used) < 0 && !rc)
+		rc = -errno;
+	close(cap->fd);
+	return rc;
+}
+
+int cmd_osa_capture(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_FILENAME('o', "output", &param.outfile, "output-file",
+				"write the capture to this file"),
+		OPT_UINTEGER('c', "cxl_mem_id", &param.cxl_mem_id, "CXL.MEM ID"),
+		OPT_UINTEGER('l', "lane_mask", &param.lane_mask,
+				"Lane Mask (default 0xffff)"),
+		OPT_UINTEGER('m', "lane_dir_mask", &param.lane_dir_mask,
+				"Lane Direction Mask (see OSA_LANE_DIR_BITMSK_*, default 0x3)"),
+		OPT_UINTEGER('d', "drop_single_os", &param.drop_single_os,
+				"Drop Single OS's (TS1/TS2/FTS/CTL_SKP)"),
+		OPT_UINTEGER('s', "stop_mode", &param.stop_mode,
+				"Capture Stop Mode (see osa_cap_stop_mode_enum)"),
+		OPT_UINTEGER('t', "snapshot_mode", &param.snapshot_mode,
+				"Snapshot Mode Enable"),
+		OPT_UINTEGER('p', "post_trig_num", &param.post_trig_num,
+				"Number of post-trigger entries"),
+		OPT_UINTEGER('y', "os_type_mask", &param.os_type_mask,
+				"OS Type mask (see OSA_OS_TYPE_CAP_BITMSK_*)"),
+		OPT_BOOLEAN('n', "no-config", &param.no_config,
+				"read the buffer as already configured, skip capture control"),
+		OPT_INTEGER('w', "wait-state", &param.wait_state,
+				"poll osa status until it reports this state (see osa_state_enum)"),
+		OPT_UINTEGER('T', "timeout", &param.timeout,
+				"seconds to wait for --wait-state (default 30)"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl osa-capture <mem0> -o <file> [<options>]",
+		NULL
+	};
+	struct osa_capture cap = { .fd = -1 };
+	struct cxl_memdev *memdev;
+	int rc;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc != 1 || !param.outfile)
+		usage_with_options(u, options);
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	cxl_memdev_foreach(ctx, memdev)
+		if (util_cxl_memdev_filter(memdev, argv[0])) {
+			cap.memdev = memdev;
+			break;
+		}
+	if (!cap.memdev) {
+		fprintf(stderr, "%s: no such memdev\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	cap.devname = cxl_memdev_get_devname(cap.memdev);
+
+	if (!param.no_config) {
+		rc = cxl_memdev_osa_cap_ctrl(cap.memdev, param.cxl_mem_id,
+				param.lane_mask, param.lane_dir_mask,
+				param.drop_single_os, param.stop_mode,
+				param.snapshot_mode, param.post_trig_num,
+				param.os_type_mask);
+		if (rc)
+			return EXIT_FAILURE;
+	}
+
+	rc = osa_capture_file(&cap, param.outfile);
+	return rc ? EXIT_FAILURE : 0;
+}
+
+/* read out an analyzer buffer that has already been armed and triggered */
+int osa_capture_drain(struct cxl_memdev *memdev, u8 cxl_mem_id, u16 lane_mask,
+		u8 lane_dir_mask, const char *path)
+{
+	struct osa_capture cap = {
+		.fd = -1,
+		.memdev = memdev,
+		.devname = cxl_memdev_get_devname(memdev),
+	};
+
+	param.cxl_mem_id = cxl_mem_id;
+	param.lane_mask = lane_mask;
+	param.lane_dir_mask = lane_dir_mask;
+	param.wait_state = -1;
+	return osa_capture_file(&cap, path);
+}
@@ -0,0 +1,761 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ccan/minmax/minmax.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+/*
+ * 'cxl perf stat': program the selected MTA counters once, then on a
+ * fixed CLOCK_MONOTONIC cadence latch every counter of a memdev back
+ * to back, read the latched values, and print per-interval deltas and
+ * rates. The sample time is the midpoint of the latch window.
+ *
+ * With --thermal the health temperature, the throttled time counter
+ * and the PMIC rails are read inside the same window, so they share
+ * the counters' timestamp and line up with them row for row.
+ *
+ * With --publish every row of an interval also lands in a counter page,
+ * see struct cxl_counters_hdr, for readers that must not add mailbox
+ * traffic of their own.
+ */
+enum perf_event_kind {
+	PERF_EVENT_MTA,
+	PERF_EVENT_HIF,
+};
+
+struct perf_event {
+	enum perf_event_kind kind;
+	u8 type;
+	u32 counter;
+	bool program;
+	u32 cfg[4];
+	char name[32];
+};
+
+struct perf_counter {
+	const struct perf_event *event;
+	struct cxl_cmd *latch;
+	struct cxl_cmd *read;
+	unsigned long long last;
+};
+
+struct perf_memdev {
+	struct cxl_memdev *memdev;
+	struct perf_counter *counters;
+	struct cxl_cmd *health;
+	struct cxl_cmd *health_counters;
+	struct cxl_cmd *pmic;
+	unsigned long long throttled, last_throttled;
+	u64 last_ns;
+};
+
+static struct {
+	const char *interval;
+	const char *format;
+	const char *output;
+	const char *publish;
+	unsigned int count;
+	unsigned int bytes_per_count;
+	bool thermal;
+	bool verbose;
+} param = {
+	.interval = "1s",
+	.format = "csv",
+};
+
+static struct perf_event *perf_events;
+static int nr_perf_events;
+static volatile sig_atomic_t perf_stop;
+
+static void perf_stop_handler(int sig)
+{
+	perf_stop = 1;
+}
+
+static u64 perf_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * An interval's rows are staged while its mailbox commands run, and
+ * then copied into the page in one short write under the sequence lock,
+ * so readers never wait on the device.
+ */
+static struct {
+	struct cxl_counters_hdr *hdr;
+	struct cxl_counter *slots;
+	struct cxl_counter *stage;
+	size_t size;
+	u32 nr;
+	u64 start_ns;
+	u64 time_ns;
+} perf_pub;
+
+/* built aside and renamed into place, a reader never sees it half set up */
+static int perf_publish_open(const char *path, u32 nr_slots, u64 period)
+{
+	struct cxl_counters_hdr *hdr;
+	size_t size = sizeof(*hdr) + nr_slots * sizeof(struct cxl_counter);
+	char *tmp;
+	int fd, rc;
+
+	if (asprintf(&tmp, "%s.XXXXXX", path) < 0)
+		return -ENOMEM;
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		rc = -errno;
+		goto out;
+	}
+	if (fchmod(fd, 0644) < 0 || ftruncate(fd, size) < 0) {
+		rc = -errno;
+		goto out_unlink;
+	}
+	hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		rc = -errno;
+		goto out_unlink;
+	}
+	perf_pub.stage = calloc(nr_slots, sizeof(*perf_pub.stage));
+	if (!perf_pub.stage) {
+		munmap(hdr, size);
+		rc = -ENOMEM;
+		goto out_unlink;
+	}
+
+	memcpy(hdr->magic, CXL_COUNTERS_MAGIC, sizeof(hdr->magic));
+	hdr->version = CXL_COUNTERS_VERSION;
+	hdr->hdr_size = sizeof(*hdr);
+	hdr->slot_size = sizeof(struct cxl_counter);
+	hdr->nr_slots = nr_slots;
+	hdr->interval_ns = period;
+	hdr->pid = getpid();
+	if (rename(tmp, path) < 0) {
+		rc = -errno;
+		munmap(hdr, size);
+		free(perf_pub.stage);
+		perf_pub.stage = NULL;
+		goto out_unlink;
+	}
+	perf_pub.hdr = hdr;
+	perf_pub.slots = (struct cxl_counter *) (hdr + 1);
+	perf_pub.size = size;
+	rc = 0;
+	goto out_close;
+
+ out_unlink:
+	unlink(tmp);
+ out_close:
+	close(fd);
+ out:
+	free(tmp);
+	return rc;
+}
+
+static void perf_publish(const char *devname, u64 ts_ns, const char *name,
+		unsigned long long value, unsigned long long delta,
+		double rate, u32 flags)
+{
+	struct cxl_counter *c;
+
+	if (!perf_pub.hdr || perf_pub.nr >= perf_pub.hdr->nr_slots)
+		return;
+	c = &perf_pub.stage[perf_pub.nr++];
+	memset(c, 0, sizeof(*c));
+	snprintf(c->memdev, sizeof(c->memdev), "%s", devname);
+	snprintf(c->event, sizeof(c->event), "%s", name);
+	c->time_ns = perf_pub.start_ns + ts_ns;
+	c->value = value;
+	c->delta = delta;
+	c->rate = rate;
+	c->flags = flags;
+	perf_pub.time_ns = max(perf_pub.time_ns, c->time_ns);
+}
+
+/* odd while the page is written, readers retry across that window */
+static void perf_publish_write(u32 set_flags)
+{
+	struct cxl_counters_hdr *hdr = perf_pub.hdr;
+	u64 seq = hdr->seq;
+
+	__atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if (set_flags)
+		hdr->flags |= set_flags;
+	else {
+		memcpy(perf_pub.slots, perf_pub.stage,
+				perf_pub.nr * sizeof(*perf_pub.slots));
+		hdr->nr = perf_pub.nr;
+		hdr->time_ns = perf_pub.time_ns;
+	}
+	__atomic_store_n(&hdr->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void perf_publish_commit(void)
+{
+	if (!perf_pub.hdr)
+		return;
+	perf_publish_write(0);
+	perf_pub.nr = 0;
+}
+
+/* the path may belong to a newer writer by now, so it is left in place */
+static void perf_publish_close(void)
+{
+	if (!perf_pub.hdr)
+		return;
+	perf_publish_write(CXL_COUNTERS_EXITED);
+	munmap(perf_pub.hdr, perf_pub.size);
+	free(perf_pub.stage);
+	memset(&perf_pub, 0, sizeof(perf_pub));
+}
+
+/* "100ms", "2s", "500us", or a bare number of milliseconds */
+static int perf_parse_interval(const char *str, u64 *ns)
+{
+	unsigned long long val;
+	char *end;
+
+	errno = 0;
+	val = strtoull(str, &end, 0);
+	if (errno || end == str || !val)
+		return -EINVAL;
+
+	if (strcmp(end, "us") == 0)
+		*ns = val * 1000ULL;
+	else if (*end == '\0' || strcmp(end, "ms") == 0)
+		*ns = val * 1000000ULL;
+	else if (strcmp(end, "s") == 0)
+		*ns = val * 1000000000ULL;
+	else
+		return -EINVAL;
+	return 0;
+}
+
+/*
+ * Event syntax: mta:<type>:<counter>[=<match>,<opcode>,<meta_field>,<meta_value>]
+ * or hif:<counter>[=<match>,<addr>,<req_ty>,<sc_ty>]. With a '=' suffix
+ * the counter is programmed with perfcnt-mta-ltif-set or
+ * perfcnt-mta-hif-set before sampling starts.
+ */
+static int perf_parse_event(const char *str, struct perf_event *ev)
+{
+	const char *cfg = strchr(str, '=');
+	unsigned int type, counter;
+	int n = 0;
+
+	memset(ev, 0, sizeof(*ev));
+	if (sscanf(str, "mta:%u:%u%n", &type, &counter, &n) == 2) {
+		ev->kind = PERF_EVENT_MTA;
+		ev->type = type;
+		snprintf(ev->name, sizeof(ev->name), "mta:%u:%u", type, counter);
+	} else if (sscanf(str, "hif:%u%n", &counter, &n) == 1) {
+		ev->kind = PERF_EVENT_HIF;
+		snprintf(ev->name, sizeof(ev->name), "hif:%u", counter);
+	} else
+		return -EINVAL;
+	ev->counter = counter;
+
+	if (str[n] != '\0' && &str[n] != cfg)
+		return -EINVAL;
+	if (cfg) {
+		if (sscanf(cfg + 1, "%i,%i,%i,%i", &ev->cfg[0], &ev->cfg[1],
+					&ev->cfg[2], &ev->cfg[3]) != 4)
+			return -EINVAL;
+		ev->program = true;
+	}
+	return 0;
+}
+
+static int perf_parse_events(const char *list)
+{
+	char *dup, *tok, *save;
+	int rc = 0;
+
+	dup = strdup(list);
+	if (!dup)
+		return -ENOMEM;
+
+	for (tok = strtok_r(dup, " ;", &save); tok;
+			tok = strtok_r(NULL, " ;", &save)) {
+		struct perf_event *ev;
+
+		ev = realloc(perf_events, (nr_perf_events + 1) * sizeof(*ev));
+		if (!ev) {
+			rc = -ENOMEM;
+			break;
+		}
+		perf_events = ev;
+		rc = perf_parse_event(tok, &perf_events[nr_perf_events]);
+		if (rc) {
+			fprintf(stderr, "invalid event: %s\n", tok);
+			break;
+		}
+		nr_perf_events++;
+	}
+
+	free(dup);
+	return rc;
+}
+
+static int perf_submit(struct cxl_cmd *cmd)
+{
+	int rc = cxl_cmd_submit(cmd);
+
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	return rc;
+}
+
+static int perf_program(struct cxl_memdev *memdev, const struct perf_event *ev)
+{
+	if (!ev->program)
+		return 0;
+	if (ev->kind == PERF_EVENT_MTA)
+		return cxl_memdev_perfcnt_mta_ltif_set(memdev, ev->counter,
+				ev->cfg[0], ev->cfg[1], ev->cfg[2], ev->cfg[3]);
+	return cxl_memdev_perfcnt_mta_hif_set(memdev, ev->counter, ev->cfg[0],
+			ev->cfg[1], ev->cfg[2], ev->cfg[3]);
+}
+
+static int perf_memdev_init(struct perf_memdev *pm)
+{
+	struct cxl_memdev *memdev = pm->memdev;
+	int i, rc;
+
+	pm->counters = calloc(nr_perf_events, sizeof(*pm->counters));
+	if (!pm->counters && nr_perf_events)
+		return -ENOMEM;
+
+	if (param.thermal) {
+		pm->health = cxl_cmd_new_get_health_info(memdev);
+		pm->health_counters = cxl_cmd_new_health_counters_get(memdev);
+		pm->pmic = cxl_cmd_new_pmic_vtmon_info(memdev);
+		if (!pm->health || !pm->health_counters || !pm->pmic)
+			return -ENOMEM;
+	}
+
+	for (i = 0; i < nr_perf_events; i++) {
+		const struct perf_event *ev = &perf_events[i];
+		struct perf_counter *pc = &pm->counters[i];
+
+		rc = perf_program(memdev, ev);
+		if (rc)
+			return rc;
+
+		pc->event = ev;
+		if (ev->kind == PERF_EVENT_MTA) {
+			pc->latch = cxl_cmd_new_perfcnt_mta_cnt_val_latch(memdev,
+					ev->type, ev->counter);
+			pc->read = cxl_cmd_new_perfcnt_mta_latch_val_get(memdev,
+					ev->type, ev->counter);
+		} else {
+			pc->latch = cxl_cmd_new_perfcnt_mta_hif_cnt_val_latch(
+					memdev, ev->counter);
+			pc->read = cxl_cmd_new_perfcnt_mta_hif_latch_val_get(
+					memdev, ev->counter);
+		}
+		if (!pc->latch || !pc->read)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void perf_memdev_free(struct perf_memdev *pm)
+{
+	int i;
+
+	cxl_cmd_unref(pm->health);
+	cxl_cmd_unref(pm->health_counters);
+	cxl_cmd_unref(pm->pmic);
+	if (!pm->counters)
+		return;
+	for (i = 0; i < nr_perf_events; i++) {
+		cxl_cmd_unref(pm->counters[i].latch);
+		cxl_cmd_unref(pm->counters[i].read);
+	}
+	free(pm->counters);
+}
+
+static int perf_counter_value(struct perf_counter *pc,
+		unsigned long long *value)
+{
+	if (pc->event->kind == PERF_EVENT_MTA)
+		return cxl_cmd_perfcnt_mta_latch_val_get_get_latch_val(pc->read,
+				value);
+	return cxl_cmd_perfcnt_mta_hif_latch_val_get_get_latch_val(pc->read,
+			value);
+}
+
+static void perf_print_header(FILE *out)
+{
+	if (strcmp(param.format, "csv") != 0)
+		return;
+	fprintf(out, "time_s,memdev,event,value,delta,per_s");
+	if (param.bytes_per_count)
+		fprintf(out, ",bytes_per_s");
+	fprintf(out, "\n");
+}
+
+/* bandwidth is only reported for the counters selected with --events */
+static void perf_print(FILE *out, const char *devname, u64 ts_ns,
+		const char *name, unsigned long long value,
+		unsigned long long delta, double secs, bool bw)
+{
+	double rate = secs > 0 ? delta / secs : 0;
+
+	perf_publish(devname, ts_ns, name, value, delta, rate, 0);
+	if (strcmp(param.format, "csv") == 0) {
+		fprintf(out, "%llu.%09llu,%s,%s,%llu,%llu,%.0f",
+				(unsigned long long) ts_ns / 1000000000ULL,
+				(unsigned long long) ts_ns % 1000000000ULL,
+				devname, name, value, delta, rate);
+		if (param.bytes_per_count && bw)
+			fprintf(out, ",%.0f", rate * param.bytes_per_count);
+		else if (param.bytes_per_count)
+			fprintf(out, ",");
+		fprintf(out, "\n");
+		return;
+	}
+
+	fprintf(out, "{\"time_ns\":%llu,\"memdev\":\"%s\",\"event\":\"%s\","
+			"\"value\":%llu,\"delta\":%llu,\"per_s\":%.0f",
+			(unsigned long long) ts_ns, devname, name,
+			value, delta, rate);
+	if (param.bytes_per_count && bw)
+		fprintf(out, ",\"bytes_per_s\":%.0f",
+				rate * param.bytes_per_count);
+	fprintf(out, "}\n");
+}
+
+/* instantaneous readings have a value but no delta or rate */
+static void perf_print_gauge(FILE *out, const char *devname, u64 ts_ns,
+		const char *name, double value)
+{
+	perf_publish(devname, ts_ns, name, 0, 0, value, CXL_COUNTER_GAUGE);
+	if (strcmp(param.format, "csv") == 0) {
+		fprintf(out, "%llu.%09llu,%s,%s,%g,,%s\n",
+				(unsigned long long) ts_ns / 1000000000ULL,
+				(unsigned long long) ts_ns % 1000000000ULL,
+				devname, name, value,
+				param.bytes_per_count ? "," : "");
+		return;
+	}
+
+	fprintf(out, "{\"time_ns\":%llu,\"memdev\":\"%s\",\"event\":\"%s\","
+			"\"value\":%g}\n", (unsigned long long) ts_ns, devname,
+			name, value);
+}
+
+static int perf_thermal_read(struct perf_memdev *pm)
+{
+	long long throttled;
+	int rc;
+
+	rc = perf_submit(pm->health);
+	if (rc == 0)
+		rc = perf_submit(pm->health_counters);
+	if (rc == 0) {
+		throttled = cxl_cmd_health_counters_get_get_time_in_throttled(
+				pm->health_counters);
+		if (throttled < 0)
+			return throttled;
+		pm->throttled = throttled;
+		rc = perf_submit(pm->pmic);
+	}
+	return rc;
+}
+
+static void perf_thermal_print(struct perf_memdev *pm, FILE *out,
+		const char *devname, u64 ts_ns, double secs)
+{
+	struct cxl_pmic_reading r;
+	char name[64];
+	int i;
+
+	perf_print_gauge(out, devname, ts_ns, "temperature",
+			cxl_cmd_get_health_info_get_temperature(pm->health));
+
+	perf_print(out, devname, ts_ns, "throttled", pm->throttled,
+			pm->throttled - pm->last_throttled, secs, false);
+
+	for (i = 0; i < CXL_PMIC_MAX; i++) {
+		if (cxl_cmd_pmic_vtmon_info_get_pmic(pm->pmic, i, &r) < 0)
+			break;
+		if (!r.name[0])
+			continue;
+		snprintf(name, sizeof(name), "pmic:%s:vout", r.name);
+		perf_print_gauge(out, devname, ts_ns, name, r.vout);
+		snprintf(name, sizeof(name), "pmic:%s:iout", r.name);
+		perf_print_gauge(out, devname, ts_ns, name, r.iout);
+		snprintf(name, sizeof(name), "pmic:%s:power", r.name);
+		perf_print_gauge(out, devname, ts_ns, name, r.power);
+		snprintf(name, sizeof(name), "pmic:%s:temp", r.name);
+		perf_print_gauge(out, devname, ts_ns, name, r.temp);
+	}
+}
+
+/*
+ * Latch every counter first so the values of one memdev describe the
+ * same instant, then read them back. The first sample only primes
+ * the baseline.
+ */
+static int perf_sample(struct perf_memdev *pm, FILE *out, u64 start_ns)
+{
+	const char *devname = cxl_memdev_get_devname(pm->memdev);
+	unsigned long long value, delta;
+	u64 t0, t1, ts;
+	double secs;
+	int i, rc;
+
+	t0 = perf_now_ns();
+	for (i = 0; i < nr_perf_events; i++) {
+		rc = perf_submit(pm->counters[i].latch);
+		if (rc)
+			return rc;
+	}
+	if (param.thermal) {
+		rc = perf_thermal_read(pm);
+		if (rc)
+			return rc;
+	}
+	t1 = perf_now_ns();
+	ts = t0 + (t1 - t0) / 2;
+	secs = pm->last_ns ? (ts - pm->last_ns) / 1e9 : 0;
+
+	for (i = 0; i < nr_perf_events; i++) {
+		struct perf_counter *pc = &pm->counters[i];
+
+		rc = perf_submit(pc->read);
+		if (rc)
+			return rc;
+		rc = perf_counter_value(pc, &value);
+		if (rc)
+			return rc;
+		delta = value - pc->last;
+		if (pm->last_ns)
+			perf_print(out, devname, ts - start_ns, pc->event->name,
+					value, delta, secs, true);
+		pc->last = value;
+	}
+	if (param.thermal) {
+		if (pm->last_ns)
+			perf_thermal_print(pm, out, devname, ts - start_ns, secs);
+		pm->last_throttled = pm->throttled;
+	}
+	pm->last_ns = ts;
+	fflush(out);
+
+	return 0;
+}
+
+static int perf_stat(struct perf_memdev *pms, int nr, FILE *out, u64 period)
+{
+	struct timespec next;
+	unsigned int samples = 0;
+	u64 start, deadline;
+	int i, rc = 0;
+
+	for (i = 0; i < nr; i++) {
+		rc = perf_memdev_init(&pms[i]);
+		if (rc) {
+			fprintf(stderr, "%s: failed to set up counters: %s\n",
+					cxl_memdev_get_devname(pms[i].memdev),
+					strerror(-rc));
+			return rc;
+		}
+	}
+
+	perf_print_header(out);
+	start = deadline = perf_now_ns();
+	perf_pub.start_ns = start;
+	while (!perf_stop) {
+		for (i = 0; i < nr; i++) {
+			rc = perf_sample(&pms[i], out, start);
+			if (rc) {
+				fprintf(stderr, "%s: sample failed: %s\n",
+						cxl_memdev_get_devname(pms[i].memdev),
+						strerror(-rc));
+				return rc;
+			}
+		}
+		perf_publish_commit();
+		/* the priming sample does not count */
+		if (param.count && samples++ >= param.count)
+			break;
+
+		deadline += period;
+		next.tv_sec = deadline / 1000000000ULL;
+		next.tv_nsec = deadline % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+					NULL) == EINTR && !perf_stop)
+			;
+	}
+
+	return 0;
+}
+
+static int perf_add_memdevs(struct cxl_ctx *ctx, const char *list,
+		struct perf_memdev **pms, int *nr)
+{
+	struct cxl_memdev *memdev;
+	char *dup, *tok, *save;
+	int i, rc = 0;
+
+	dup = strdup(list);
+	if (!dup)
+		return -ENOMEM;
+
+	for (tok = strtok_r(dup, ", ", &save); tok;
+			tok = strtok_r(NULL, ", ", &save)) {
+		bool found = false;
+
+		cxl_memdev_foreach(ctx, memdev) {
+			struct perf_memdev *p;
+
+			if (!util_cxl_memdev_filter(memdev, tok))
+				continue;
+			found = true;
+			for (i = 0; i < *nr; i++)
+				if ((*pms)[i].memdev == memdev)
+					break;
+			if (i < *nr)
+				continue;
+			p = realloc(*pms, (*nr + 1) * sizeof(*p));
+			if (!p) {
+				rc = -ENOMEM;
+				goto out;
+			}
+			*pms = p;
+			memset(&p[*nr], 0, sizeof(*p));
+			p[(*nr)++].memdev = memdev;
+		}
+		if (!found) {
+			fprintf(stderr, "%s: no such memdev\n", tok);
+			rc = -ENODEV;
+			goto out;
+		}
+	}
+out:
+	free(dup);
+	return rc;
+}
+
+static int cmd_perf_stat(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const char *events = NULL;
+	const struct option options[] = {
+		OPT_STRING('e', "events", &events, "event-list",
+				"counters to sample, see cxl-perf(1)"),
+		OPT_STRING('I', "interval", &param.interval, "interval",
+				"sample period, e.g. 100ms, 2s (default 1s)"),
+		OPT_UINTEGER('n', "count", &param.count,
+				"stop after <n> intervals (default: until interrupted)"),
+		OPT_UINTEGER('b', "bytes-per-count", &param.bytes_per_count,
+				"bytes moved per counted event, to report bandwidth"),
+		OPT_BOOLEAN('T', "thermal", &param.thermal,
+				"also sample temperature, throttling and PMIC rails"),
+		OPT_STRING('f', "format", &param.format, "format",
+				"output format: csv (default) or json"),
+		OPT_FILENAME('o', "output", &param.output, "output-file",
+				"write samples to this file instead of stdout"),
+		OPT_FILENAME('P', "publish", &param.publish, "counter-page",
+				"also keep the latest sample in a shared counter page"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl perf stat [-e <events>] [-T] [<options>] <mem0>[,<mem1>..]",
+		NULL
+	};
+	struct sigaction sa = { .sa_handler = perf_stop_handler };
+	struct perf_memdev *pms = NULL;
+	FILE *out = stdout;
+	int i, nr = 0, rc;
+	u64 period;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1 || (!events && !param.thermal))
+		usage_with_options(u, options);
+	if (strcmp(param.format, "csv") != 0 && strcmp(param.format, "json") != 0) {
+		fprintf(stderr, "unknown format: %s\n", param.format);
+		return EXIT_FAILURE;
+	}
+	if (perf_parse_interval(param.interval, &period) < 0) {
+		fprintf(stderr, "invalid interval: %s\n", param.interval);
+		return EXIT_FAILURE;
+	}
+	if (events) {
+		rc = perf_parse_events(events);
+		if (rc || !nr_perf_events)
+			return EXIT_FAILURE;
+	}
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	for (i = 0; i < argc; i++) {
+		rc = perf_add_memdevs(ctx, argv[i], &pms, &nr);
+		if (rc)
+			goto out;
+	}
+
+	if (param.output) {
+		out = fopen(param.output, "w");
+		if (!out) {
+			fprintf(stderr, "failed to open %s: %s\n", param.output,
+					strerror(errno));
+			rc = -errno;
+			goto out;
+		}
+	}
+
+	if (param.publish) {
+		int per_memdev = nr_perf_events
+			+ (param.thermal ? 2 + 4 * CXL_PMIC_MAX : 0);
+
+		rc = perf_publish_open(param.publish, nr * per_memdev, period);
+		if (rc) {
+			fprintf(stderr, "failed to publish to %s: %s\n",
+					param.publish, strerror(-rc));
+			goto out;
+		}
+	}
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	rc = perf_stat(pms, nr, out, period);
+out:
+	perf_publish_close();
+	if (out && out != stdout)
+		fclose(out);
+	for (i = 0; i < nr; i++)
+		perf_memdev_free(&pms[i]);
+	free(pms);
+	free(perf_events);
+	return rc ? EXIT_FAILURE : 0;
+}
+
+int cmd_perf(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	if (argc > 1 && strcmp(argv[1], "stat") == 0)
+		return cmd_perf_stat(argc - 1, argv + 1, ctx);
+
+	fprintf(stderr, "usage: cxl perf stat [<options>] <mem0>[,<mem1>..]\n");
+	return EXIT_FAILURE;
+}
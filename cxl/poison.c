@@ -0,0 +1,338 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <util/json.h>
+#include <util/size.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <json-c/json.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+static struct {
+	const char *dpa;
+	const char *length;
+	const char *chunk;
+	unsigned int timeout;
+	bool stream;
+	bool no_event_log;
+	bool human;
+	bool verbose;
+} param;
+
+static unsigned long long dpa, length, chunk;
+static unsigned long flags;
+
+static const char *poison_source_names[] = {
+	[CXL_POISON_SOURCE_UNKNOWN] = "unknown",
+	[CXL_POISON_SOURCE_EXTERNAL] = "external",
+	[CXL_POISON_SOURCE_INTERNAL] = "internal",
+	[CXL_POISON_SOURCE_INJECTED] = "injected",
+	[CXL_POISON_SOURCE_VENDOR] = "vendor",
+};
+
+#define RANGE_OPTIONS() \
+OPT_STRING('a', "dpa", &param.dpa, "addr", \
+	"start of the device physical address range (default 0)"), \
+OPT_STRING('l', "length", &param.length, "size", \
+	"size of the range (default to the end of the device)"), \
+OPT_BOOLEAN('u', "human", &param.human, "use human friendly number formats"), \
+OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug")
+
+static int parse_range(void)
+{
+	dpa = 0;
+	length = 0;
+	if (param.dpa) {
+		dpa = parse_size64(param.dpa);
+		if (dpa == ULLONG_MAX || dpa % 64) {
+			fprintf(stderr, "invalid --dpa '%s', must be 64 byte aligned\n",
+					param.dpa);
+			return -EINVAL;
+		}
+	}
+	if (param.length) {
+		length = parse_size64(param.length);
+		if (length == ULLONG_MAX || !length || length % 64) {
+			fprintf(stderr, "invalid --length '%s', must be a multiple of 64\n",
+					param.length);
+			return -EINVAL;
+		}
+	}
+	chunk = 64ULL * SZ_1G;
+	if (param.chunk) {
+		chunk = parse_size64(param.chunk);
+		if (chunk == ULLONG_MAX || chunk % 64) {
+			fprintf(stderr, "invalid --chunk '%s', must be a multiple of 64\n",
+					param.chunk);
+			return -EINVAL;
+		}
+	}
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+	return 0;
+}
+
+static struct json_object *poison_record_to_json(struct cxl_memdev *memdev,
+		const struct cxl_poison_record *rec)
+{
+	struct json_object *jrec = json_object_new_object();
+	const char *source = NULL;
+	struct json_object *jobj;
+
+	if (!jrec)
+		return NULL;
+	if (memdev) {
+		jobj = json_object_new_string(cxl_memdev_get_devname(memdev));
+		if (jobj)
+			json_object_object_add(jrec, "memdev", jobj);
+	}
+	jobj = util_json_object_hex(rec->dpa, flags);
+	if (jobj)
+		json_object_object_add(jrec, "dpa", jobj);
+	jobj = util_json_object_size(rec->length, flags);
+	if (jobj)
+		json_object_object_add(jrec, "length", jobj);
+	if (rec->source >= 0 && rec->source < (int) ARRAY_SIZE(poison_source_names))
+		source = poison_source_names[rec->source];
+	jobj = json_object_new_string(source ? source : "reserved");
+	if (jobj)
+		json_object_object_add(jrec, "source", jobj);
+	return jrec;
+}
+
+/* one record per line, printed as soon as its page arrives */
+static int poison_stream(struct cxl_memdev *memdev,
+		const struct cxl_poison_record *rec, void *data)
+{
+	struct json_object *jrec = poison_record_to_json(memdev, rec);
+
+	if (!jrec)
+		return -ENOMEM;
+	printf("%s\n", json_object_to_json_string_ext(jrec,
+				JSON_C_TO_STRING_PLAIN));
+	fflush(stdout);
+	json_object_put(jrec);
+	return 0;
+}
+
+static struct json_object *poison_list_to_json(struct cxl_memdev *memdev,
+		struct cxl_poison_list *list)
+{
+	struct json_object *jmemdev, *jrecs;
+	const struct cxl_poison_record *rec;
+	int i;
+
+	jmemdev = json_object_new_object();
+	if (!jmemdev)
+		return NULL;
+	json_object_object_add(jmemdev, "memdev",
+			json_object_new_string(cxl_memdev_get_devname(memdev)));
+	if (cxl_poison_list_get_overflow(list))
+		json_object_object_add(jmemdev, "overflow",
+				json_object_new_boolean(true));
+	jrecs = json_object_new_array();
+	if (!jrecs)
+		return jmemdev;
+	for (i = 0; i < cxl_poison_list_get_count(list); i++) {
+		rec = cxl_poison_list_get_record(list, i);
+		json_object_array_add(jrecs, poison_record_to_json(NULL, rec));
+	}
+	json_object_object_add(jmemdev, "poison", jrecs);
+	return jmemdev;
+}
+
+static int list_poison(struct cxl_memdev *memdev, struct json_object *jlist)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	struct cxl_poison_list *list;
+	int rc;
+
+	if (param.stream) {
+		rc = cxl_memdev_poison_foreach(memdev, dpa, length,
+				poison_stream, NULL);
+		if (rc > 0)
+			fprintf(stderr, "%s: poison list overflowed, incomplete\n",
+					devname);
+		return rc < 0 ? rc : 0;
+	}
+
+	list = cxl_memdev_get_poison_list(memdev, dpa, length);
+	if (!list)
+		return -errno;
+	if (jlist)
+		json_object_array_add(jlist, poison_list_to_json(memdev, list));
+	cxl_poison_list_free(list);
+	return 0;
+}
+
+static int scan_progress(struct cxl_memdev *memdev, int opcode, int percent,
+		void *data)
+{
+	unsigned long long *start = data;
+
+	if (param.verbose)
+		fprintf(stderr, "%s: scanning %#llx: %d%%\n",
+				cxl_memdev_get_devname(memdev), *start, percent);
+	return 0;
+}
+
+/*
+ * Scan one chunk at a time and stream its results before moving on,
+ * so neither the device nor this tool has to hold the errors of the
+ * whole range at once.
+ */
+static int scan_media(struct cxl_memdev *memdev)
+{
+	const char *devname = cxl_memdev_get_devname(memdev);
+	unsigned long long start = dpa, end, len, restart, left;
+	int rc = 0, est;
+
+	end = length ? dpa + length : cxl_memdev_get_pmem_size(memdev)
+		+ cxl_memdev_get_ram_size(memdev);
+	if (end <= start) {
+		fprintf(stderr, "%s: empty scan range\n", devname);
+		return -EINVAL;
+	}
+
+	if (param.verbose) {
+		est = cxl_memdev_get_scan_media_time(memdev, start, end - start);
+		if (est >= 0)
+			fprintf(stderr, "%s: estimated scan time %d ms\n",
+					devname, est);
+	}
+
+	while (start < end) {
+		len = chunk ? min(chunk, end - start) : end - start;
+		rc = cxl_memdev_scan_media(memdev, start, len,
+				param.no_event_log ? CXL_SCAN_MEDIA_NO_EVENT_LOG : 0,
+				param.timeout * 1000, scan_progress, &start);
+		if (rc) {
+			fprintf(stderr, "%s: scan media at %#llx failed: %s\n",
+					devname, start, strerror(-rc));
+			break;
+		}
+		rc = cxl_memdev_scan_media_foreach(memdev, poison_stream, NULL,
+				&restart, &left);
+		if (rc < 0) {
+			fprintf(stderr, "%s: get scan media results failed: %s\n",
+					devname, strerror(-rc));
+			break;
+		}
+		if (rc > 0 && left && restart == start) {
+			fprintf(stderr, "%s: scan stopped at %#llx without progress\n",
+					devname, start);
+			rc = -EAGAIN;
+			break;
+		}
+		/* the device stopped early, pick up where it left off */
+		if (rc > 0 && left && restart > start
+				&& restart < start + len) {
+			if (param.verbose)
+				fprintf(stderr, "%s: scan stopped at %#llx, resuming\n",
+						devname, restart);
+			start = restart;
+		} else
+			start += len;
+		rc = 0;
+	}
+	return rc;
+}
+
+static int poison_action(int argc, const char **argv, struct cxl_ctx *ctx,
+		int (*action)(struct cxl_memdev *memdev,
+			struct json_object *jlist),
+		const struct option *options, const char *usage)
+{
+	const char * const u[] = {
+		usage,
+		NULL
+	};
+	struct cxl_memdev *memdev, **seen = NULL, **s;
+	struct json_object *jlist = NULL;
+	int i, j, nr = 0, rc, err = 0;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1 || parse_range())
+		usage_with_options(u, options);
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+	if (action == list_poison && !param.stream)
+		jlist = json_object_new_array();
+
+	for (i = 0; i < argc; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, argv[i]))
+				continue;
+			for (j = 0; j < nr; j++)
+				if (seen[j] == memdev)
+					break;
+			if (j < nr)
+				continue;
+			s = realloc(seen, (nr + 1) * sizeof(*s));
+			if (!s) {
+				err = -ENOMEM;
+				goto out;
+			}
+			seen = s;
+			seen[nr++] = memdev;
+
+			rc = action(memdev, jlist);
+			if (rc) {
+				fprintf(stderr, "%s: %s\n",
+						cxl_memdev_get_devname(memdev),
+						strerror(-rc));
+				err = rc;
+			}
+		}
+out:
+	if (jlist)
+		util_display_json_array(stdout, jlist, flags);
+	free(seen);
+	if (!nr)
+		fprintf(stderr, "no memdevs matched\n");
+	return err || !nr ? EXIT_FAILURE : 0;
+}
+
+int cmd_list_poison(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		RANGE_OPTIONS(),
+		OPT_BOOLEAN('s', "stream", &param.stream,
+				"print records as they are read, one per line"),
+		OPT_END(),
+	};
+
+	return poison_action(argc, argv, ctx, list_poison, options,
+			"cxl list-poison <mem0> [<mem1>..<memN>] [<options>]");
+}
+
+static int scan_media_action(struct cxl_memdev *memdev,
+		struct json_object *jlist)
+{
+	return scan_media(memdev);
+}
+
+int cmd_scan_media(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		RANGE_OPTIONS(),
+		OPT_STRING('c', "chunk", &param.chunk, "size",
+				"scan and report this much at a time (default 64G)"),
+		OPT_UINTEGER('t', "timeout", &param.timeout,
+				"seconds to wait for each chunk, 0 for no limit"),
+		OPT_BOOLEAN('n', "no-event-log", &param.no_event_log,
+				"do not log events for newly found errors"),
+		OPT_END(),
+	};
+	const char *usage = "cxl scan-media <mem0> [<mem1>..<memN>] [<options>]";
+
+	return poison_action(argc, argv, ctx, scan_media_action, options,
+			usage);
+}
@@ -0,0 +1,397 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <util/json.h>
+#include <util/size.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <json-c/json.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+static struct {
+	unsigned int interval;
+	unsigned int count;
+	unsigned int refresh;
+	bool changes;
+	bool verbose;
+} param = {
+	.interval = 1000,
+	.refresh = 60,
+};
+
+static volatile sig_atomic_t qos_stop;
+
+static void qos_stop_handler(int sig)
+{
+	qos_stop = 1;
+}
+
+static const char *qos_load_names[] = {
+	[CXL_QOS_LOAD_NORMAL] = "normal",
+	[CXL_QOS_LOAD_MODERATE] = "moderate",
+	[CXL_QOS_LOAD_SEVERE] = "severe",
+};
+
+struct qos_dev {
+	struct cxl_memdev *memdev;
+	struct cxl_qos_telemetry t;
+	int last_load;
+	int rc;
+};
+
+static void qos_print(struct qos_dev *q, bool full)
+{
+	struct json_object *jobj = json_object_new_object();
+
+	if (!jobj)
+		return;
+	json_object_object_add(jobj, "memdev",
+		json_object_new_string(cxl_memdev_get_devname(q->memdev)));
+	json_object_object_add(jobj, "timestamp",
+			json_object_new_int64(q->t.timestamp_ns));
+	if (q->rc) {
+		json_object_object_add(jobj, "error",
+				json_object_new_string(strerror(-q->rc)));
+		goto out;
+	}
+	json_object_object_add(jobj, "backpressure",
+			json_object_new_int(q->t.backpressure_pct));
+	json_object_object_add(jobj, "load",
+			json_object_new_string(qos_load_names[q->t.load]));
+	if (full) {
+		json_object_object_add(jobj, "ld_count",
+				json_object_new_int(q->t.ld_count));
+		json_object_object_add(jobj, "egress_congestion",
+			json_object_new_boolean(q->t.enabled
+				& CXL_QOS_TELEMETRY_EGRESS_CONGESTION));
+		json_object_object_add(jobj, "throughput_reduction",
+			json_object_new_boolean(q->t.enabled
+				& CXL_QOS_TELEMETRY_THROUGHPUT_REDUCTION));
+		json_object_object_add(jobj, "moderate_pct",
+				json_object_new_int(q->t.moderate_pct));
+		json_object_object_add(jobj, "severe_pct",
+				json_object_new_int(q->t.severe_pct));
+	}
+out:
+	printf("%s\n", json_object_to_json_string_ext(jobj,
+				JSON_C_TO_STRING_PLAIN));
+	json_object_put(jobj);
+}
+
+/*
+ * The first sample and every --refresh samples after it re-read the
+ * capabilities and thresholds, in between only the status is read.
+ */
+static void qos_sample(struct qos_dev *q, unsigned long long n)
+{
+	bool full = q->rc || n == 0 || (param.refresh && n % param.refresh == 0);
+	int rc;
+
+	if (full)
+		rc = cxl_memdev_get_qos_telemetry(q->memdev, &q->t);
+	else
+		rc = cxl_memdev_update_qos_status(q->memdev, &q->t);
+
+	if (rc == q->rc && rc)
+		return;
+	q->rc = rc;
+	if (!param.changes || rc || q->t.load != q->last_load || n == 0)
+		qos_print(q, full && !rc);
+	q->last_load = rc ? -1 : q->t.load;
+}
+
+int cmd_monitor_qos(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_UINTEGER('i', "interval", &param.interval,
+				"milliseconds between samples (default 1000)"),
+		OPT_UINTEGER('c', "count", &param.count,
+				"stop after <n> samples (default: until interrupted)"),
+		OPT_UINTEGER('r', "refresh", &param.refresh,
+				"re-read thresholds every <n> samples (default 60)"),
+		OPT_BOOLEAN('C', "changes", &param.changes,
+				"only report samples where the load level changed"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl monitor-qos <mem0> [<mem1>..<memN>] [<options>]",
+		NULL
+	};
+	struct sigaction sa = { .sa_handler = qos_stop_handler };
+	struct qos_dev *devs = NULL, *q;
+	struct cxl_memdev *memdev;
+	unsigned long long n;
+	struct timespec ts;
+	int i, j, nr = 0;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1 || !param.interval)
+		usage_with_options(u, options);
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	for (i = 0; i < argc; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, argv[i]))
+				continue;
+			for (j = 0; j < nr; j++)
+				if (devs[j].memdev == memdev)
+					break;
+			if (j < nr)
+				continue;
+			q = realloc(devs, (nr + 1) * sizeof(*q));
+			if (!q) {
+				free(devs);
+				return EXIT_FAILURE;
+			}
+			devs = q;
+			q = &devs[nr++];
+			memset(q, 0, sizeof(*q));
+			q->memdev = memdev;
+			q->last_load = -1;
+		}
+	if (!nr) {
+		fprintf(stderr, "no memdevs matched\n");
+		return EXIT_FAILURE;
+	}
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	for (n = 0; !qos_stop && (!param.count || n < param.count); n++) {
+		for (i = 0; i < nr; i++)
+			qos_sample(&devs[i], n);
+		fflush(stdout);
+
+		/* sample on a fixed cadence regardless of mailbox latency */
+		ts.tv_nsec += (param.interval % 1000) * 1000000L;
+		ts.tv_sec += param.interval / 1000 + ts.tv_nsec / 1000000000L;
+		ts.tv_nsec %= 1000000000L;
+		if (!param.count || n + 1 < param.count)
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+
+	for (i = 0, j = 0; i < nr; i++)
+		j += devs[i].rc != 0;
+	free(devs);
+	return j ? EXIT_FAILURE : 0;
+}
+
+static struct {
+	unsigned int ld;
+	const char *size;
+	const char *size2;
+	const char *bandwidth;
+	const char *limit;
+	bool human;
+	bool verbose;
+} ld_param;
+
+/* bandwidth is set as a percentage, the device counts 256ths */
+static unsigned int ld_pct_to_frac(double pct)
+{
+	return min((unsigned int) (pct * 256 / 100 + 0.5), 255U);
+}
+
+static double ld_frac_to_pct(unsigned int frac)
+{
+	return (int) (frac * 10000 / 256) / 100.0;
+}
+
+/*
+ * Parse a comma separated list of per-LD values into the allocation,
+ * starting at --ld. Returns the number of values, or -1.
+ */
+static int ld_parse_list(const char *str, struct cxl_ld_allocs *a,
+		unsigned int what, bool range2)
+{
+	char *dup = strdup(str), *tok, *save, *end;
+	struct cxl_ld_alloc *ld;
+	unsigned long long size;
+	int n = 0, rc = 0;
+	double pct;
+
+	if (!dup)
+		return -1;
+	for (tok = strtok_r(dup, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save), n++) {
+		if (ld_param.ld + n >= (unsigned int) a->ld_count) {
+			fprintf(stderr, "%s: more values than LDs\n", str);
+			rc = -1;
+			break;
+		}
+		ld = &a->ld[ld_param.ld + n];
+		if (what == CXL_LD_ALLOC_CAPACITY) {
+			size = parse_size64(tok);
+			if (size == ULLONG_MAX) {
+				fprintf(stderr, "%s: invalid size\n", tok);
+				rc = -1;
+				break;
+			}
+			if (range2)
+				ld->range2 = size;
+			else
+				ld->range1 = size;
+			continue;
+		}
+		pct = strtod(tok, &end);
+		if (end == tok || *end || pct < 0 || pct > 100) {
+			fprintf(stderr, "%s: invalid percentage\n", tok);
+			rc = -1;
+			break;
+		}
+		if (what == CXL_LD_ALLOC_BANDWIDTH)
+			ld->bw = ld_pct_to_frac(pct);
+		else
+			ld->bw_limit = ld_pct_to_frac(pct);
+	}
+	free(dup);
+	return rc ? rc : n;
+}
+
+static struct json_object *ld_alloc_to_json(struct cxl_memdev *memdev,
+		struct cxl_ld_allocs *a, unsigned long flags)
+{
+	struct json_object *jobj, *jlds, *jld;
+	int i;
+
+	jobj = json_object_new_object();
+	if (!jobj)
+		return NULL;
+	json_object_object_add(jobj, "memdev",
+		json_object_new_string(cxl_memdev_get_devname(memdev)));
+	json_object_object_add(jobj, "ld_count",
+			json_object_new_int(a->ld_count));
+	json_object_object_add(jobj, "granularity",
+			util_json_object_size(a->granularity, flags));
+
+	jlds = json_object_new_array();
+	if (!jlds)
+		return jobj;
+	json_object_object_add(jobj, "lds", jlds);
+	for (i = 0; i < a->ld_count; i++) {
+		jld = json_object_new_object();
+		if (!jld)
+			break;
+		json_object_object_add(jld, "ld", json_object_new_int(i));
+		json_object_object_add(jld, "range1",
+				util_json_object_size(a->ld[i].range1, flags));
+		json_object_object_add(jld, "range2",
+				util_json_object_size(a->ld[i].range2, flags));
+		if (a->qos_caps) {
+			json_object_object_add(jld, "bandwidth_pct",
+				json_object_new_double(
+					ld_frac_to_pct(a->ld[i].bw)));
+			json_object_object_add(jld, "bandwidth_limit_pct",
+				json_object_new_double(
+					ld_frac_to_pct(a->ld[i].bw_limit)));
+		}
+		json_object_array_add(jlds, jld);
+	}
+	return jobj;
+}
+
+int cmd_ld_alloc(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_UINTEGER('l', "ld", &ld_param.ld,
+				"first LD the value lists apply to (default 0)"),
+		OPT_STRING('s', "size", &ld_param.size, "size[,size..]",
+				"range 1 capacity of each LD"),
+		OPT_STRING('S', "size2", &ld_param.size2, "size[,size..]",
+				"range 2 capacity of each LD"),
+		OPT_STRING('b', "bandwidth", &ld_param.bandwidth, "pct[,pct..]",
+				"share of the egress bandwidth of each LD"),
+		OPT_STRING('L', "limit", &ld_param.limit, "pct[,pct..]",
+				"egress bandwidth limit of each LD"),
+		OPT_BOOLEAN('u', "human", &ld_param.human,
+				"use human friendly number formats"),
+		OPT_BOOLEAN('v', "verbose", &ld_param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl ld-alloc <mem0> [<options>]",
+		NULL
+	};
+	const struct {
+		const char *str;
+		unsigned int what;
+		bool range2;
+	} lists[] = {
+		{ ld_param.size, CXL_LD_ALLOC_CAPACITY, false },
+		{ ld_param.size2, CXL_LD_ALLOC_CAPACITY, true },
+		{ ld_param.bandwidth, CXL_LD_ALLOC_BANDWIDTH, false },
+		{ ld_param.limit, CXL_LD_ALLOC_BANDWIDTH_LIMIT, false },
+	};
+	struct cxl_memdev *memdev, *found = NULL;
+	unsigned long flags = 0;
+	unsigned int what = 0;
+	struct json_object *jobj;
+	struct cxl_ld_allocs a;
+	int i, n, nr = 0, rc;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc != 1)
+		usage_with_options(u, options);
+	if (ld_param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+	if (ld_param.human)
+		flags |= UTIL_JSON_HUMAN;
+
+	cxl_memdev_foreach(ctx, memdev)
+		if (util_cxl_memdev_filter(memdev, argv[0])) {
+			found = memdev;
+			break;
+		}
+	if (!found) {
+		fprintf(stderr, "%s: no such memdev\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	rc = cxl_memdev_get_ld_alloc(found, &a);
+	if (rc) {
+		fprintf(stderr, "%s: failed to read LD allocations: %s\n",
+				argv[0], strerror(-rc));
+		return EXIT_FAILURE;
+	}
+
+	/* read-modify-write, not given values keep their current setting */
+	for (i = 0; i < (int) ARRAY_SIZE(lists); i++) {
+		if (!lists[i].str)
+			continue;
+		n = ld_parse_list(lists[i].str, &a, lists[i].what,
+				lists[i].range2);
+		if (n < 0)
+			return EXIT_FAILURE;
+		nr = max(nr, n);
+		what |= lists[i].what;
+	}
+
+	if (what) {
+		rc = cxl_memdev_set_ld_alloc(found, &a, ld_param.ld, nr, what);
+		if (rc) {
+			fprintf(stderr, "%s: failed to set LD allocations: %s\n",
+					argv[0], strerror(-rc));
+			return EXIT_FAILURE;
+		}
+	}
+
+	jobj = ld_alloc_to_json(found, &a, flags);
+	if (!jobj)
+		return EXIT_FAILURE;
+	printf("%s\n", json_object_to_json_string_ext(jobj,
+				JSON_C_TO_STRING_PRETTY));
+	json_object_put(jobj);
+	return 0;
+}
@@ -0,0 +1,502 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <util/json.h>
+#include <util/size.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <json-c/json.h>
+#include <uuid/uuid.h>
+#include <ccan/minmax/minmax.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+static struct {
+	const char *decoder;
+	const char *type;
+	const char *size;
+	const char *uuid;
+	unsigned int ways;
+	unsigned int granularity;
+	bool dry_run;
+	bool human;
+	bool verbose;
+} param;
+
+/* HPA and DPA allocations are made in 256M units per target */
+#define REGION_ALIGN (256ULL * SZ_1M)
+
+struct region_target {
+	struct cxl_memdev *memdev;
+	struct cxl_port *endpoint;
+	struct cxl_port *host_bridge;
+	struct cxl_decoder *decoder;
+	unsigned long long avail;
+	bool used;
+};
+
+struct region_plan {
+	struct cxl_decoder *root;
+	unsigned int ways;
+	unsigned int granularity;
+	unsigned long long size;
+	struct region_target **pos;
+};
+
+static bool pmem;
+
+static bool valid_ways(unsigned int ways)
+{
+	switch (ways) {
+	case 1: case 2: case 3: case 4: case 6: case 8: case 12: case 16:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool valid_granularity(unsigned int g)
+{
+	return g >= 256 && g <= 16384 && !(g & (g - 1));
+}
+
+/* the port just below the root is the host bridge an endpoint sits on */
+static struct cxl_port *endpoint_to_host_bridge(struct cxl_port *port)
+{
+	struct cxl_port *parent;
+
+	for (; port; port = parent) {
+		parent = cxl_port_get_parent(port);
+		if (parent && cxl_port_is_root(parent))
+			return port;
+	}
+	return NULL;
+}
+
+/*
+ * Free capacity in the selected partition, and the next endpoint
+ * decoder to hand out. The kernel allocates endpoint decoders in id
+ * order, so the first one without a DPA allocation is the only choice.
+ */
+static int target_init(struct region_target *t)
+{
+	unsigned long long used = 0, size;
+	struct cxl_decoder *decoder;
+	const char *mode;
+
+	t->endpoint = cxl_memdev_get_endpoint(t->memdev);
+	t->host_bridge = endpoint_to_host_bridge(t->endpoint);
+	if (!t->endpoint || !t->host_bridge)
+		return -ENXIO;
+
+	cxl_decoder_foreach(t->endpoint, decoder) {
+		size = cxl_decoder_get_dpa_size(decoder);
+		mode = cxl_decoder_get_mode(decoder);
+		if (size && size != ULLONG_MAX) {
+			if (mode && strcmp(mode, param.type) == 0)
+				used += size;
+			continue;
+		}
+		if (!t->decoder)
+			t->decoder = decoder;
+	}
+	if (!t->decoder)
+		return -EBUSY;
+
+	size = pmem ? cxl_memdev_get_pmem_size(t->memdev)
+		: cxl_memdev_get_ram_size(t->memdev);
+	t->avail = size > used ? size - used : 0;
+	t->avail -= t->avail % REGION_ALIGN;
+	return t->avail ? 0 : -ENOSPC;
+}
+
+/*
+ * A root decoder interleaves across the host bridges in its target
+ * list, and each host bridge across the memdevs below it. Spread the
+ * ways evenly: position p goes to host bridge p % nr_hb, so every
+ * host bridge carries the same share of the region's bandwidth.
+ * Returns the number of ways achievable through @root.
+ */
+static int plan_for_root(struct cxl_decoder *root, struct region_target *t,
+		int nr, struct region_plan *plan)
+{
+	int nr_hb = cxl_decoder_get_nr_targets(root), i, j, hb, per = INT_MAX;
+	unsigned int ways, m, granularity;
+	struct cxl_port **hbs;
+	int *count;
+
+	if (nr_hb < 1 || (pmem ? !cxl_decoder_is_pmem_capable(root)
+				: !cxl_decoder_is_volatile_capable(root)))
+		return 0;
+
+	granularity = param.granularity ? param.granularity
+		: cxl_decoder_get_interleave_granularity(root);
+	if (nr_hb > 1 && granularity
+			!= cxl_decoder_get_interleave_granularity(root)) {
+		if (param.decoder)
+			fprintf(stderr, "%s: interleaves %d host bridges at %u, --granularity must match\n",
+					cxl_decoder_get_devname(root), nr_hb,
+					cxl_decoder_get_interleave_granularity(root));
+		return 0;
+	}
+	if (!valid_granularity(granularity))
+		return 0;
+
+	hbs = calloc(nr_hb, sizeof(*hbs));
+	count = calloc(nr_hb, sizeof(*count));
+	if (!hbs || !count) {
+		free(hbs);
+		free(count);
+		return 0;
+	}
+	for (i = 0; i < nr_hb; i++)
+		hbs[i] = cxl_decoder_get_target(root, i);
+	for (i = 0; i < nr; i++)
+		for (j = 0; j < nr_hb; j++)
+			if (t[i].decoder && t[i].host_bridge == hbs[j])
+				count[j]++;
+	for (j = 0; j < nr_hb; j++)
+		per = min(per, count[j]);
+
+	ways = 0;
+	for (m = per; m > 0 && !ways; m--) {
+		if (!valid_ways(m) || !valid_ways(m * nr_hb))
+			continue;
+		if (param.ways && param.ways != m * nr_hb)
+			continue;
+		ways = m * nr_hb;
+	}
+	if (!ways)
+		goto out;
+
+	plan->root = root;
+	plan->ways = ways;
+	plan->granularity = granularity;
+	plan->size = ULLONG_MAX;
+	for (i = 0; i < nr; i++)
+		t[i].used = false;
+	for (i = 0; i < (int) ways; i++) {
+		hb = i % nr_hb;
+		for (j = 0; j < nr; j++)
+			if (!t[j].used && t[j].decoder
+					&& t[j].host_bridge == hbs[hb])
+				break;
+		t[j].used = true;
+		plan->pos[i] = &t[j];
+		plan->size = min(plan->size, t[j].avail);
+	}
+	plan->size *= ways;
+out:
+	free(hbs);
+	free(count);
+	return ways;
+}
+
+static int plan_region(struct cxl_ctx *ctx, struct region_target *t, int nr,
+		struct region_plan *plan)
+{
+	struct region_plan best = { .pos = calloc(nr, sizeof(*best.pos)) };
+	struct region_plan try = { .pos = calloc(nr, sizeof(*try.pos)) };
+	struct cxl_decoder *decoder;
+	struct cxl_port *port;
+	int rc = -ENXIO;
+
+	if (!best.pos || !try.pos)
+		goto out;
+
+	cxl_port_foreach(ctx, port) {
+		if (!cxl_port_is_root(port))
+			continue;
+		cxl_decoder_foreach(port, decoder) {
+			if (param.decoder && strcmp(param.decoder,
+					cxl_decoder_get_devname(decoder)) != 0)
+				continue;
+			if (plan_for_root(decoder, t, nr, &try) <= (int) best.ways)
+				continue;
+			free(best.pos);
+			best = try;
+			try.pos = calloc(nr, sizeof(*try.pos));
+			if (!try.pos)
+				goto out;
+		}
+	}
+	if (best.ways) {
+		free(plan->pos);
+		*plan = best;
+		best.pos = NULL;
+		rc = 0;
+	}
+out:
+	free(best.pos);
+	free(try.pos);
+	return rc;
+}
+
+static struct json_object *plan_to_json(struct region_plan *plan,
+		unsigned long flags)
+{
+	struct json_object *jplan, *jtargets, *jtarget;
+	unsigned int i;
+
+	jplan = json_object_new_object();
+	if (!jplan)
+		return NULL;
+	json_object_object_add(jplan, "decoder", json_object_new_string(
+				cxl_decoder_get_devname(plan->root)));
+	json_object_object_add(jplan, "size",
+			util_json_object_size(plan->size, flags));
+	json_object_object_add(jplan, "interleave_ways",
+			json_object_new_int(plan->ways));
+	json_object_object_add(jplan, "interleave_granularity",
+			json_object_new_int(plan->granularity));
+	jtargets = json_object_new_array();
+	if (!jtargets)
+		return jplan;
+	for (i = 0; i < plan->ways; i++) {
+		jtarget = json_object_new_object();
+		if (!jtarget)
+			break;
+		json_object_object_add(jtarget, "position",
+				json_object_new_int(i));
+		json_object_object_add(jtarget, "memdev", json_object_new_string(
+				cxl_memdev_get_devname(plan->pos[i]->memdev)));
+		json_object_object_add(jtarget, "decoder", json_object_new_string(
+				cxl_decoder_get_devname(plan->pos[i]->decoder)));
+		json_object_object_add(jtarget, "host_bridge",
+				json_object_new_string(cxl_port_get_devname(
+						plan->pos[i]->host_bridge)));
+		json_object_array_add(jtargets, jtarget);
+	}
+	json_object_object_add(jplan, "targets", jtargets);
+	return jplan;
+}
+
+/* program the plan, undoing every step already taken on failure */
+static struct cxl_region *create_region(struct region_plan *plan)
+{
+	unsigned long long per_target = plan->size / plan->ways;
+	struct cxl_region *region;
+	const char *step;
+	unsigned int i, attached = 0, sized = 0;
+	uuid_t uuid;
+	int rc;
+
+	region = pmem ? cxl_decoder_create_pmem_region(plan->root)
+		: cxl_decoder_create_ram_region(plan->root);
+	if (!region) {
+		fprintf(stderr, "%s: failed to create region: %s\n",
+				cxl_decoder_get_devname(plan->root),
+				strerror(errno));
+		return NULL;
+	}
+
+	step = "uuid";
+	rc = 0;
+	if (pmem) {
+		if (param.uuid)
+			rc = uuid_parse(param.uuid, uuid) ? -EINVAL : 0;
+		else
+			uuid_generate(uuid);
+		if (rc == 0)
+			rc = cxl_region_set_uuid(region, uuid);
+	}
+	if (rc == 0) {
+		step = "interleave_granularity";
+		rc = cxl_region_set_interleave_granularity(region,
+				plan->granularity);
+	}
+	if (rc == 0) {
+		step = "interleave_ways";
+		rc = cxl_region_set_interleave_ways(region, plan->ways);
+	}
+	if (rc == 0) {
+		step = "size";
+		rc = cxl_region_set_size(region, plan->size);
+	}
+	for (i = 0; rc == 0 && i < plan->ways; i++) {
+		struct cxl_decoder *decoder = plan->pos[i]->decoder;
+
+		step = cxl_decoder_get_devname(decoder);
+		rc = cxl_decoder_set_mode(decoder, param.type);
+		if (rc == 0)
+			rc = cxl_decoder_set_dpa_size(decoder, per_target);
+		if (rc)
+			break;
+		sized++;
+		rc = cxl_region_set_target(region, i, decoder);
+		if (rc == 0)
+			attached++;
+	}
+	if (rc == 0) {
+		step = "commit";
+		rc = cxl_region_commit(region);
+	}
+	if (rc == 0)
+		return region;
+
+	fprintf(stderr, "%s: %s failed: %s\n", cxl_region_get_devname(region),
+			step, strerror(-rc));
+	for (i = 0; i < attached; i++)
+		cxl_region_set_target(region, i, NULL);
+	for (i = 0; i < sized; i++)
+		cxl_decoder_set_dpa_size(plan->pos[i]->decoder, 0);
+	cxl_decoder_delete_region(plan->root, region);
+	return NULL;
+}
+
+int cmd_create_region(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_STRING('d', "decoder", &param.decoder, "root decoder",
+				"create the region on this root decoder (default: best fit)"),
+		OPT_STRING('t', "type", &param.type, "type",
+				"'pmem' (default) or 'ram'"),
+		OPT_STRING('s', "size", &param.size, "size",
+				"total region size (default: all free capacity)"),
+		OPT_UINTEGER('w', "ways", &param.ways,
+				"interleave ways (default: as many as the memdevs allow)"),
+		OPT_UINTEGER('g', "granularity", &param.granularity,
+				"interleave granularity in bytes (default: the root decoder's)"),
+		OPT_STRING('U', "uuid", &param.uuid, "uuid",
+				"uuid of a pmem region (default: generated)"),
+		OPT_BOOLEAN('n', "dry-run", &param.dry_run,
+				"print the chosen layout without creating the region"),
+		OPT_BOOLEAN('u', "human", &param.human,
+				"use human friendly number formats"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl create-region <mem0> [<mem1>..<memN>] [<options>]",
+		NULL
+	};
+	struct region_target *targets = NULL, *t;
+	struct region_plan plan = { 0 };
+	unsigned long flags = 0;
+	struct cxl_region *region;
+	struct cxl_memdev *memdev;
+	struct json_object *jobj;
+	unsigned long long size = 0;
+	int i, j, nr = 0, rc = -ENXIO;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1)
+		usage_with_options(u, options);
+	if (!param.type)
+		param.type = "pmem";
+	if (strcmp(param.type, "pmem") != 0 && strcmp(param.type, "ram") != 0) {
+		fprintf(stderr, "invalid --type '%s'\n", param.type);
+		usage_with_options(u, options);
+	}
+	pmem = strcmp(param.type, "pmem") == 0;
+	if (param.ways && !valid_ways(param.ways)) {
+		fprintf(stderr, "invalid --ways %u, must be 1, 2, 3, 4, 6, 8, 12 or 16\n",
+				param.ways);
+		return EXIT_FAILURE;
+	}
+	if (param.granularity && !valid_granularity(param.granularity)) {
+		fprintf(stderr, "invalid --granularity %u, must be a power of 2 from 256 to 16384\n",
+				param.granularity);
+		return EXIT_FAILURE;
+	}
+	if (param.size) {
+		size = parse_size64(param.size);
+		if (size == ULLONG_MAX || !size) {
+			fprintf(stderr, "invalid --size '%s'\n", param.size);
+			return EXIT_FAILURE;
+		}
+	}
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+
+	for (i = 0; i < argc; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, argv[i]))
+				continue;
+			for (j = 0; j < nr; j++)
+				if (targets[j].memdev == memdev)
+					break;
+			if (j < nr)
+				continue;
+			t = realloc(targets, (nr + 1) * sizeof(*t));
+			if (!t) {
+				rc = -ENOMEM;
+				goto out;
+			}
+			targets = t;
+			t = &targets[nr++];
+			memset(t, 0, sizeof(*t));
+			t->memdev = memdev;
+			rc = target_init(t);
+			if (rc) {
+				if (param.verbose)
+					fprintf(stderr, "%s: skipped: %s\n",
+						cxl_memdev_get_devname(memdev),
+						strerror(-rc));
+				t->decoder = NULL;
+			}
+		}
+	if (!nr) {
+		fprintf(stderr, "no memdevs matched\n");
+		rc = -ENODEV;
+		goto out;
+	}
+
+	rc = plan_region(ctx, targets, nr, &plan);
+	if (rc) {
+		fprintf(stderr, "no %s capable root decoder can interleave %s the given memdevs\n",
+				param.type, param.ways ? "the requested ways across"
+				: "across");
+		goto out;
+	}
+
+	if (size) {
+		if (size % (plan.ways * REGION_ALIGN)) {
+			fprintf(stderr, "--size must be a multiple of %u x 256M\n",
+					plan.ways);
+			rc = -EINVAL;
+			goto out;
+		}
+		if (size > plan.size) {
+			fprintf(stderr, "--size exceeds the %llu bytes available\n",
+					plan.size);
+			rc = -ENOSPC;
+			goto out;
+		}
+		plan.size = size;
+	}
+
+	if (param.dry_run) {
+		jobj = plan_to_json(&plan, flags);
+		if (jobj) {
+			printf("%s\n", json_object_to_json_string_ext(jobj,
+						JSON_C_TO_STRING_PRETTY));
+			json_object_put(jobj);
+		}
+		rc = 0;
+		goto out;
+	}
+
+	region = create_region(&plan);
+	if (!region) {
+		rc = -ENXIO;
+		goto out;
+	}
+	jobj = util_cxl_region_to_json(region, flags);
+	if (jobj) {
+		printf("%s\n", json_object_to_json_string_ext(jobj,
+					JSON_C_TO_STRING_PRETTY));
+		json_object_put(jobj);
+	}
+	rc = 0;
+out:
+	free(plan.pos);
+	free(targets);
+	return rc ? EXIT_FAILURE : 0;
+}
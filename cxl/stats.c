@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <util/json.h>
+#include <json-c/json.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+#include <util/parse-options.h>
+
+static struct {
+	bool human;
+} param;
+
+static int stats_cmp(const void *a, const void *b)
+{
+	const struct cxl_mbox_stats *x = a, *y = b;
+
+	return (int) x->opcode - (int) y->opcode;
+}
+
+static struct json_object *mbox_stats_to_json(struct cxl_mbox_stats *stats,
+		unsigned long flags)
+{
+	struct json_object *jstats, *jhist, *jbucket, *jobj;
+	int i;
+
+	jstats = json_object_new_object();
+	if (!jstats)
+		return NULL;
+
+	jobj = util_json_object_hex(stats->opcode, flags);
+	if (jobj)
+		json_object_object_add(jstats, "opcode", jobj);
+
+	jobj = json_object_new_int64(stats->count);
+	if (jobj)
+		json_object_object_add(jstats, "count", jobj);
+
+	jobj = json_object_new_int64(stats->errors);
+	if (jobj)
+		json_object_object_add(jstats, "errors", jobj);
+
+	jobj = json_object_new_int64(stats->total_ns);
+	if (jobj)
+		json_object_object_add(jstats, "total_ns", jobj);
+
+	jobj = json_object_new_int64(stats->max_ns);
+	if (jobj)
+		json_object_object_add(jstats, "max_ns", jobj);
+
+	if (stats->count) {
+		jobj = json_object_new_int64(stats->total_ns / stats->count);
+		if (jobj)
+			json_object_object_add(jstats, "avg_ns", jobj);
+	}
+
+	jhist = json_object_new_array();
+	if (!jhist)
+		return jstats;
+
+	for (i = 0; i < CXL_MBOX_STATS_NR_BUCKETS; i++) {
+		if (!stats->hist[i])
+			continue;
+
+		jbucket = json_object_new_object();
+		if (!jbucket)
+			continue;
+
+		jobj = json_object_new_int64(i ? 1ULL << (i - 1) : 0);
+		if (jobj)
+			json_object_object_add(jbucket, "min_us", jobj);
+
+		jobj = json_object_new_int64(stats->hist[i]);
+		if (jobj)
+			json_object_object_add(jbucket, "count", jobj);
+
+		json_object_array_add(jhist, jbucket);
+	}
+	json_object_object_add(jstats, "histogram", jhist);
+
+	return jstats;
+}
+
+int cmd_stats(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_BOOLEAN('u', "human", &param.human,
+				"use human friendly number formats "),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl stats [<options>] <command> [<args>]",
+		NULL
+	};
+	struct cxl_mbox_stats *stats;
+	struct json_object *jstats;
+	unsigned long flags = 0;
+	int i, n, nr, rc;
+
+	argc = parse_options(argc, argv, options, u,
+			PARSE_OPT_STOP_AT_NON_OPTION);
+	if (argc == 0)
+		usage_with_options(u, options);
+
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+
+	rc = cxl_run_builtin(argc, argv, ctx);
+
+	nr = cxl_ctx_get_mbox_stats(ctx, NULL, 0);
+	stats = calloc(nr ? nr : 1, sizeof(*stats));
+	jstats = json_object_new_array();
+	if (!stats || !jstats) {
+		free(stats);
+		if (jstats)
+			json_object_put(jstats);
+		return -ENOMEM;
+	}
+
+	/* the count is of opcodes seen, which may have grown since */
+	n = cxl_ctx_get_mbox_stats(ctx, stats, nr);
+	if (n > nr)
+		n = nr;
+	qsort(stats, n, sizeof(*stats), stats_cmp);
+	for (i = 0; i < n; i++) {
+		struct json_object *jobj = mbox_stats_to_json(&stats[i], flags);
+
+		if (jobj)
+			json_object_array_add(jstats, jobj);
+	}
+	free(stats);
+
+	util_display_json_array(stdout, jstats, flags);
+
+	return rc;
+}
@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <pthread.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <util/parse-options.h>
+#include <json-c/json.h>
+#include <cxl/libcxl.h>
+#include <cxl/builtin.h>
+
+static struct {
+	unsigned int rounds;
+	bool verbose;
+} param = {
+	.rounds = 8,
+};
+
+/*
+ * One memdev being synchronized. @offset_ns is the device time minus
+ * the host time at the midpoint of the readback with the shortest
+ * round trip, @rtt_ns that round trip and so the bound on @offset_ns.
+ */
+struct tsync {
+	struct cxl_memdev *memdev;
+	pthread_t thread;
+	bool started;
+	int rc;
+	u64 set_ns;
+	long long offset_ns;
+	u64 rtt_ns;
+};
+
+/* workers prepare their commands, then wait here to set together */
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool go;
+} gate = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static u64 tsync_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int tsync_submit(struct cxl_cmd *cmd)
+{
+	int rc = cxl_cmd_submit(cmd);
+
+	if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+		rc = -ENXIO;
+	return rc;
+}
+
+static void *tsync_run(void *arg)
+{
+	struct tsync *t = arg;
+	struct cxl_cmd *set, *get = NULL;
+	u64 t0, t1, dev;
+	unsigned int i;
+	int rc = -ENOMEM;
+
+	set = cxl_cmd_new_set_timestamp(t->memdev);
+	if (set)
+		get = cxl_cmd_new_get_timestamp(t->memdev);
+
+	pthread_mutex_lock(&gate.lock);
+	while (!gate.go)
+		pthread_cond_wait(&gate.cond, &gate.lock);
+	pthread_mutex_unlock(&gate.lock);
+	if (!get)
+		goto out;
+
+	/* take the host time as late as possible before the set */
+	t->set_ns = tsync_now_ns();
+	cxl_cmd_set_timestamp_set_timestamp(set, t->set_ns);
+	rc = tsync_submit(set);
+	if (rc)
+		goto out;
+
+	t->rtt_ns = ~0ULL;
+	for (i = 0; i < param.rounds; i++) {
+		t0 = tsync_now_ns();
+		rc = tsync_submit(get);
+		t1 = tsync_now_ns();
+		if (rc)
+			goto out;
+		dev = cxl_cmd_get_timestamp_get_timestamp(get);
+		if (t1 - t0 >= t->rtt_ns)
+			continue;
+		t->rtt_ns = t1 - t0;
+		t->offset_ns = (long long) (dev - (t0 + t->rtt_ns / 2));
+	}
+out:
+	cxl_cmd_unref(get);
+	cxl_cmd_unref(set);
+	t->rc = rc;
+	return NULL;
+}
+
+static struct json_object *tsync_to_json(struct tsync *t)
+{
+	struct json_object *jobj = json_object_new_object();
+
+	if (!jobj)
+		return NULL;
+	json_object_object_add(jobj, "memdev",
+		json_object_new_string(cxl_memdev_get_devname(t->memdev)));
+	if (t->rc) {
+		json_object_object_add(jobj, "error",
+				json_object_new_string(strerror(-t->rc)));
+		return jobj;
+	}
+	json_object_object_add(jobj, "timestamp",
+			json_object_new_int64(t->set_ns));
+	json_object_object_add(jobj, "offset_ns",
+			json_object_new_int64(t->offset_ns));
+	json_object_object_add(jobj, "rtt_ns",
+			json_object_new_int64(t->rtt_ns));
+	return jobj;
+}
+
+int cmd_sync_timestamp(int argc, const char **argv, struct cxl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_UINTEGER('r', "rounds", &param.rounds,
+				"readbacks per memdev to measure the offset (default 8)"),
+		OPT_BOOLEAN('v', "verbose", &param.verbose, "turn on debug"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"cxl sync-timestamp <mem0> [<mem1>..<memN>] [<options>]",
+		NULL
+	};
+	long long min_offset = 0, max_offset = 0;
+	struct tsync *syncs = NULL, *t;
+	struct json_object *jsyncs;
+	struct cxl_memdev *memdev;
+	int i, j, nr = 0, failed = 0, synced = 0;
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc < 1 || !param.rounds)
+		usage_with_options(u, options);
+	if (param.verbose)
+		cxl_set_log_priority(ctx, LOG_DEBUG);
+
+	for (i = 0; i < argc; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			if (!util_cxl_memdev_filter(memdev, argv[i]))
+				continue;
+			for (j = 0; j < nr; j++)
+				if (syncs[j].memdev == memdev)
+					break;
+			if (j < nr)
+				continue;
+			t = realloc(syncs, (nr + 1) * sizeof(*t));
+			if (!t) {
+				free(syncs);
+				return EXIT_FAILURE;
+			}
+			syncs = t;
+			t = &syncs[nr++];
+			memset(t, 0, sizeof(*t));
+			t->memdev = memdev;
+		}
+	if (!nr) {
+		fprintf(stderr, "no memdevs matched\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < nr; i++)
+		if (pthread_create(&syncs[i].thread, NULL, tsync_run,
+					&syncs[i]) == 0)
+			syncs[i].started = true;
+		else
+			syncs[i].rc = -EAGAIN;
+	pthread_mutex_lock(&gate.lock);
+	gate.go = true;
+	pthread_cond_broadcast(&gate.cond);
+	pthread_mutex_unlock(&gate.lock);
+	for (i = 0; i < nr; i++)
+		if (syncs[i].started)
+			pthread_join(syncs[i].thread, NULL);
+
+	jsyncs = json_object_new_array();
+	for (i = 0; i < nr; i++) {
+		t = &syncs[i];
+		if (t->rc) {
+			failed++;
+		} else {
+			if (!synced || t->offset_ns < min_offset)
+				min_offset = t->offset_ns;
+			if (!synced || t->offset_ns > max_offset)
+				max_offset = t->offset_ns;
+			synced++;
+		}
+		if (jsyncs)
+			json_object_array_add(jsyncs, tsync_to_json(t));
+	}
+	if (jsyncs)
+		util_display_json_array(stdout, jsyncs, 0);
+
+	fprintf(stderr, "synchronized %d memdev%s, %d failed, skew %lld ns\n",
+			synced, synced == 1 ? "" : "s", failed,
+			max_offset - min_offset);
+	free(syncs);
+	return failed ? EXIT_FAILURE : 0;
+}
@@ -248,6 +248,7 @@ enum acpi_table {
 	ACPI_SRAT,
 	ACPI_SLIT,
 	ACPI_NFIT,
+	ACPI_HMAT,
 	ACPI_TABLES,
 };
 
@@ -257,6 +258,7 @@ static const char *acpi_table_name(enum acpi_table id)
 		[ACPI_SRAT] = "srat",
 		[ACPI_SLIT] = "slit",
 		[ACPI_NFIT] = "nfit",
+		[ACPI_HMAT] = "hmat",
 	};
 
 	return names[id];
@@ -270,16 +272,42 @@ struct parameters {
 	int nodes;
 	int pxm;
 	const char *path;
+	bool hmat;
+	unsigned int latency;
+	unsigned int bandwidth;
 } param = {
 	.nodes = 2,
+	.latency = 100,
+	.bandwidth = 25600,
 };
 
+/* --perf: latency and bandwidth from one initiator, or all, to a target */
+struct hmat_perf {
+	struct list_node list;
+	int initiator;
+	int target;
+	unsigned int latency;
+	unsigned int bandwidth;
+};
+static LIST_HEAD(perfs);
+
+/*
+ * @initiators, @targets: proximity domains with cpus (or generic
+ * initiators) and with memory, over @nr_pxm domains including the ones
+ * the split adds
+ * @slit: the new distance matrix, @slit_nodes square, if there was a SLIT
+ */
 struct split_context {
 	uint64_t address;
 	uint64_t length;
 	int max_pxm;
 	int max_region_id;
 	int max_range_index;
+	int nr_pxm;
+	unsigned long *initiators;
+	unsigned long *targets;
+	uint8_t *slit;
+	int slit_nodes;
 };
 
 static int create_nfit(struct parameters *p, struct nfit_container *container,
@@ -373,6 +401,57 @@ static int create_srat(struct parameters *p, struct srat_container *container,
 		do { } while (0); \
 	}})
 
+static int srat_ent_pxm(struct srat_ent *ent)
+{
+	struct srat_generic *g;
+	struct srat_cpu *c;
+	struct srat_mem *m;
+	int pxm;
+
+	switch (readb(&ent->tbl->type)) {
+	case ACPI_SRAT_TYPE_MEMORY_AFFINITY:
+		m = (struct srat_mem *) ent->tbl;
+		return readl(&m->proximity_domain);
+	case ACPI_SRAT_TYPE_CPU_AFFINITY:
+		c = (struct srat_cpu *) ent->tbl;
+		pxm = readb(&c->proximity_domain_lo);
+		pxm |= readw(&c->proximity_domain_hi[0]) << 8;
+		pxm |= readb(&c->proximity_domain_hi[2]) << 24;
+		return pxm;
+	case ACPI_SRAT_TYPE_GENERIC_AFFINITY:
+		g = (struct srat_generic *) ent->tbl;
+		return readl(&g->proximity_domain);
+	default:
+		return -1;
+	}
+}
+
+/* which domains the HMAT describes, as initiators and as targets */
+static int srat_domains(struct parameters *p, struct srat_container *srat,
+		struct split_context *split)
+{
+	struct srat_ent *ent;
+	int pxm;
+
+	split->nr_pxm = split->max_pxm + p->nodes;
+	split->initiators = bitmap_alloc(split->nr_pxm);
+	split->targets = bitmap_alloc(split->nr_pxm);
+	if (!split->initiators || !split->targets)
+		return -ENOMEM;
+
+	list_for_each(&srat->ents, ent, list) {
+		pxm = srat_ent_pxm(ent);
+		if (pxm < 0)
+			continue;
+		if (readb(&ent->tbl->type) == ACPI_SRAT_TYPE_MEMORY_AFFINITY)
+			bitmap_set(split->targets, pxm, 1);
+		else
+			bitmap_set(split->initiators, pxm, 1);
+	}
+	bitmap_set(split->targets, split->max_pxm + 1, p->nodes - 1);
+	return 0;
+}
+
 static int split_srat(struct parameters *p, struct split_context *split)
 {
 	struct srat_container *srat = read_srat(p->in_fd[ACPI_SRAT]);
@@ -383,30 +462,10 @@ static int split_srat(struct parameters *p, struct split_context *split)
 	LIST_HEAD(mems);
 
 	list_for_each(&srat->ents, ent, list) {
-		struct srat_generic *g;
-		struct srat_cpu *c;
 		int pxm, type;
 
 		type = readb(&ent->tbl->type);
-		switch (type) {
-		case ACPI_SRAT_TYPE_MEMORY_AFFINITY:
-			m = (struct srat_mem *) ent->tbl;
-			pxm = readl(&m->proximity_domain);
-			break;
-		case ACPI_SRAT_TYPE_CPU_AFFINITY:
-			c = (struct srat_cpu *) ent->tbl;
-			pxm = readb(&c->proximity_domain_lo);
-			pxm |= readw(&c->proximity_domain_hi[0]) << 8;
-			pxm |= readb(&c->proximity_domain_hi[2]) << 24;
-			break;
-		case ACPI_SRAT_TYPE_GENERIC_AFFINITY:
-			g = (struct srat_generic *) ent->tbl;
-			pxm = readl(&g->proximity_domain);
-			break;
-		default:
-			pxm = -1;
-			break;
-		}
+		pxm = srat_ent_pxm(ent);
 		max_pxm = max(pxm, max_pxm);
 
 		if (type != ACPI_SRAT_TYPE_MEMORY_AFFINITY)
@@ -439,6 +498,11 @@ static int split_srat(struct parameters *p, struct split_context *split)
 		.length = length,
 		.max_pxm = max_pxm,
 	};
+	if (p->hmat && srat_domains(p, srat, split) < 0) {
+		error("failed to alloc proximity domain maps\n");
+		free_srat_container(srat);
+		return -ENOMEM;
+	}
 
 	length /= p->nodes;
 	writeq(length, &m->spa_length);
@@ -540,11 +604,217 @@ static int split_slit(struct parameters *p, struct split_context *split)
 	writeb(acpi_checksum(slit, size), &slit->h.checksum);
 
 	rc = write(p->out_fd[ACPI_SLIT], slit, size);
-	free(slit);
 	free(slit_old);
+	if (rc >= 0 && p->hmat) {
+		/* the HMAT defaults follow the new distances */
+		split->slit = malloc(nodes * nodes);
+		if (split->slit) {
+			memcpy(split->slit, slit->entry, nodes * nodes);
+			split->slit_nodes = nodes;
+		}
+	}
+	free(slit);
 	return rc;
 }
 
+static int parse_perf(const struct option *option, const char *arg,
+		int unset)
+{
+	struct hmat_perf *perf = calloc(1, sizeof(*perf));
+	char initiator[16];
+	int n;
+
+	if (!perf)
+		return -ENOMEM;
+	if (sscanf(arg, "%15[^:]:%d:%u:%u%n", initiator, &perf->target,
+				&perf->latency, &perf->bandwidth, &n) != 4
+			|| arg[n] || perf->target < 0 || !perf->latency
+			|| !perf->bandwidth)
+		goto err;
+	if (strcmp(initiator, "*") == 0)
+		perf->initiator = -1;
+	else if (sscanf(initiator, "%d%n", &perf->initiator, &n) != 1
+			|| initiator[n] || perf->initiator < 0)
+		goto err;
+
+	list_add_tail(&perfs, &perf->list);
+	param.hmat = true;
+	return 0;
+ err:
+	error("failed to parse --perf=%s\n", arg);
+	free(perf);
+	return -EINVAL;
+}
+
+static int slit_distance(struct split_context *split, int i, int t)
+{
+	if (i < split->slit_nodes && t < split->slit_nodes)
+		return split->slit[i * split->slit_nodes + t];
+	return i == t ? 10 : 20;
+}
+
+/* the smallest base unit that fits every value in a 16 bit entry */
+static uint64_t hmat_base_unit(uint64_t *vals, int nr)
+{
+	uint64_t hi = 0;
+	int i;
+
+	for (i = 0; i < nr; i++)
+		hi = max(hi, vals[i]);
+	return max(1ULL, (unsigned long long) (hi + 0xfffd) / 0xfffe);
+}
+
+static void *hmat_add_locality(void *buf, int data_type, uint64_t unit,
+		int *ipds, int ni, int *tpds, int nt, uint64_t *vals)
+{
+	struct hmat_locality *loc = buf;
+	uint32_t *pd = (uint32_t *) (loc + 1);
+	uint16_t *entry;
+	size_t len;
+	int i;
+
+	len = ALIGN(sizeof(*loc) + (ni + nt) * 4 + ni * nt * 2, 4);
+	writew(ACPI_HMAT_TYPE_LOCALITY, &loc->type);
+	writel(len, &loc->length);
+	writeb(data_type, &loc->data_type);
+	writel(ni, &loc->number_of_initiator_pds);
+	writel(nt, &loc->number_of_target_pds);
+	writeq(unit, &loc->entry_base_unit);
+	for (i = 0; i < ni; i++)
+		writel(ipds[i], pd++);
+	for (i = 0; i < nt; i++)
+		writel(tpds[i], pd++);
+	entry = (uint16_t *) pd;
+	for (i = 0; i < ni * nt; i++) {
+		/* entries are in units of the base unit, 0 means no data */
+		uint64_t v = vals[i] / unit;
+
+		writew(max(1ULL, (unsigned long long) v), entry++);
+	}
+	return (char *) buf + len;
+}
+
+/*
+ * Write an HMAT for the split topology: an attribute structure per
+ * memory domain, then access latency and bandwidth from every initiator
+ * to every target. A pair not given on the command line gets the local
+ * --latency and --bandwidth scaled by its SLIT distance, so the HMAT
+ * ranks targets the way the SLIT does.
+ */
+static int create_hmat(struct parameters *p, struct split_context *split)
+{
+	int *ipds = NULL, *tpds = NULL, ni = 0, nt = 0, i, t, rc = -ENOMEM;
+	uint64_t *lat = NULL, *bw = NULL, lat_unit, bw_unit;
+	struct hmat_proximity *prox;
+	struct hmat_perf *perf;
+	struct hmat *hmat_old;
+	struct hmat *hmat;
+	size_t size;
+	void *pos;
+	char *buf;
+
+	for (i = 0; i < split->nr_pxm; i++) {
+		ni += test_bit(i, split->initiators);
+		nt += test_bit(i, split->targets);
+	}
+	if (!ni || !nt) {
+		error("HMAT: SRAT lists no initiators or no memory\n");
+		return -ENXIO;
+	}
+
+	ipds = calloc(ni, sizeof(*ipds));
+	tpds = calloc(nt, sizeof(*tpds));
+	lat = calloc(ni * nt, sizeof(*lat));
+	bw = calloc(ni * nt, sizeof(*bw));
+	size = sizeof(*hmat) + nt * sizeof(*prox)
+		+ 2 * ALIGN(sizeof(struct hmat_locality) + (ni + nt) * 4
+				+ ni * nt * 2, 4);
+	buf = calloc(1, size);
+	if (!ipds || !tpds || !lat || !bw || !buf)
+		goto out;
+
+	ni = nt = 0;
+	for (i = 0; i < split->nr_pxm; i++) {
+		if (test_bit(i, split->initiators))
+			ipds[ni++] = i;
+		if (test_bit(i, split->targets))
+			tpds[nt++] = i;
+	}
+
+	for (i = 0; i < ni; i++)
+		for (t = 0; t < nt; t++) {
+			int d = slit_distance(split, ipds[i], tpds[t]);
+
+			lat[i * nt + t] = (uint64_t) param.latency * d / 10;
+			bw[i * nt + t] = (uint64_t) param.bandwidth * 10 / d;
+			list_for_each(&perfs, perf, list) {
+				if (perf->target != tpds[t])
+					continue;
+				if (perf->initiator >= 0
+						&& perf->initiator != ipds[i])
+					continue;
+				lat[i * nt + t] = perf->latency;
+				bw[i * nt + t] = perf->bandwidth;
+			}
+			dbg("HMAT: %d -> %d: %lluns %lluMB/s\n", ipds[i],
+					tpds[t],
+					(unsigned long long) lat[i * nt + t],
+					(unsigned long long) bw[i * nt + t]);
+			/* latency entries are in picoseconds */
+			lat[i * nt + t] *= 1000;
+		}
+	lat_unit = hmat_base_unit(lat, ni * nt);
+	bw_unit = hmat_base_unit(bw, ni * nt);
+
+	/* keep the platform's identity from an HMAT that is replaced */
+	hmat = (struct hmat *) buf;
+	hmat_old = p->in_fd[ACPI_HMAT] > 0
+		? read_table(p->in_fd[ACPI_HMAT], "HMAT") : NULL;
+	p->in_fd[ACPI_HMAT] = 0;
+	if (hmat_old) {
+		hmat->h = hmat_old->h;
+		writel(readl(&hmat->h.oem_revision) + 1, &hmat->h.oem_revision);
+		free(hmat_old);
+	} else {
+		memcpy(hmat->h.signature, "HMAT", 4);
+		memcpy(hmat->h.oemid, "LOCAL", 6);
+		writew(1, &hmat->h.oem_tbl_id);
+		writel(1, &hmat->h.oem_revision);
+		writel(0x80860000, &hmat->h.asl_id);
+		writel(1, &hmat->h.asl_revision);
+	}
+	writel(size, &hmat->h.length);
+	writeb(2, &hmat->h.revision);
+	writeb(0, &hmat->h.checksum);
+
+	prox = (struct hmat_proximity *) (hmat + 1);
+	for (t = 0; t < nt; t++, prox++) {
+		writew(ACPI_HMAT_TYPE_PROXIMITY, &prox->type);
+		writel(sizeof(*prox), &prox->length);
+		writel(tpds[t], &prox->memory_pd);
+		if (test_bit(tpds[t], split->initiators)) {
+			writew(ACPI_HMAT_INITIATOR_PD_VALID, &prox->flags);
+			writel(tpds[t], &prox->processor_pd);
+		}
+	}
+	pos = hmat_add_locality(prox, ACPI_HMAT_ACCESS_LATENCY, lat_unit,
+			ipds, ni, tpds, nt, lat);
+	hmat_add_locality(pos, ACPI_HMAT_ACCESS_BANDWIDTH, bw_unit,
+			ipds, ni, tpds, nt, bw);
+	writeb(acpi_checksum(hmat, size), &hmat->h.checksum);
+
+	rc = write(p->out_fd[ACPI_HMAT], hmat, size);
+	if (rc < 0)
+		rc = -errno;
+ out:
+	free(buf);
+	free(bw);
+	free(lat);
+	free(tpds);
+	free(ipds);
+	return rc < 0 ? rc : 0;
+}
+
 static int split_nfit_map(struct parameters *p, struct nfit_map *map,
 		struct list_head *maps, struct split_context *split)
 {
@@ -753,29 +1023,37 @@ static int split_nfit(struct parameters *p, struct split_context *split)
 
 static int do_split(struct parameters *p)
 {
-	struct split_context split;
+	struct split_context split = { 0 };
 	int rc = split_srat(p, &split);
 
 	if (rc < 0)
-		return rc;
+		goto out;
 	fprintf(stderr, "created: %s\n", p->new_table[ACPI_SRAT]);
 
 	rc = split_slit(p, &split);
 	if (rc < 0)
-		return rc;
+		goto out;
 	fprintf(stderr, "created: %s\n", p->new_table[ACPI_SLIT]);
 
 	rc = split_nfit(p, &split);
 	if (rc == -ENOENT) {
 		unlink(p->new_table[ACPI_NFIT]);
-		return 0;
+		rc = 0;
+	} else if (rc >= 0)
+		fprintf(stderr, "created: %s\n", p->new_table[ACPI_NFIT]);
+
+	if (rc >= 0 && p->hmat) {
+		rc = create_hmat(p, &split);
+		if (rc >= 0)
+			fprintf(stderr, "created: %s\n",
+					p->new_table[ACPI_HMAT]);
 	}
 
-	if (rc < 0)
-		return rc;
-
-	fprintf(stderr, "created: %s\n", p->new_table[ACPI_NFIT]);
-	return 0;
+out:
+	free(split.slit);
+	free(split.initiators);
+	free(split.targets);
+	return rc < 0 ? rc : 0;
 }
 
 int cmd_split_acpi(int argc, const char **argv, void *ctx)
@@ -792,9 +1070,19 @@ int cmd_split_acpi(int argc, const char **argv, void *ctx)
 			"Proximity domain to split"),
 	OPT_INTEGER('n', "nodes", &param.nodes,
 			"Number of nodes to split capacity (default 2)"),
+	OPT_BOOLEAN('H', "hmat", &param.hmat,
+			"Generate an HMAT for the split topology"),
+	OPT_UINTEGER('l', "latency", &param.latency,
+			"HMAT: local access latency in ns (default 100)"),
+	OPT_UINTEGER('b', "bandwidth", &param.bandwidth,
+			"HMAT: local access bandwidth in MB/s (default 25600)"),
+	OPT_CALLBACK('P', "perf", NULL, "initiator:target:ns:MB/s",
+			"HMAT: latency and bandwidth from an initiator, or '*', to a target",
+			parse_perf),
 	OPT_BOOLEAN('v', "verbose", &verbose, "Enable verbose output"),
 	OPT_END(),
 	};
+	struct hmat_perf *perf, *_perf;
 
         argc = parse_options(argc, argv, options, u, 0);
 
@@ -803,6 +1091,11 @@ int cmd_split_acpi(int argc, const char **argv, void *ctx)
 		rc = -EINVAL;
 	}
 
+	if (!param.latency || !param.bandwidth) {
+		error("--latency and --bandwidth must not be 0\n");
+		rc = -EINVAL;
+	}
+
 	if (param.nodes < 2) {
 		error("--nodes=%d, must be greater than 2\n", param.nodes);
 		rc = -EINVAL;
@@ -817,6 +1110,10 @@ int cmd_split_acpi(int argc, const char **argv, void *ctx)
 		usage_with_options(u, options);
 
 	for (i = 0; i < ACPI_TABLES; i++) {
+		/* without --hmat an HMAT is left alone */
+		if (i == ACPI_HMAT && !param.hmat)
+			break;
+
 		rc = asprintf(&param.table[i], "%s/%s.dat", param.path
 				? param.path : ".", acpi_table_name(i));
 		if (rc < 0) {
@@ -826,14 +1123,16 @@ int cmd_split_acpi(int argc, const char **argv, void *ctx)
 		}
 
 		rc = open(param.table[i], O_RDONLY);
-		if (rc < 0 && i > ACPI_SLIT) {
+		if (rc < 0 && i == ACPI_NFIT) {
 			error("failed to open required %s\n", param.table[i]);
 			break;
 		}
 
-		if (rc < 0)
+		/* the HMAT is written from scratch, it needs no input */
+		if (rc < 0 && i != ACPI_HMAT)
 			continue;
-		param.in_fd[i] = rc;
+		if (rc >= 0)
+			param.in_fd[i] = rc;
 
 		rc = asprintf(&param.new_table[i], "%s/%s.dat.new", param.path
 				? param.path : ".", acpi_table_name(i));
@@ -844,7 +1143,7 @@ int cmd_split_acpi(int argc, const char **argv, void *ctx)
 		}
 
 		rc = open(param.new_table[i], O_RDWR | O_TRUNC | O_CREAT, 0640);
-		if (rc < 0 && i <= ACPI_SLIT) {
+		if (rc < 0 && (i <= ACPI_SLIT || i == ACPI_HMAT)) {
 			error("failed to open %s\n", param.new_table[i]);
 			break;
 		}
@@ -866,5 +1165,9 @@ out:
 		if (param.out_fd[i] > 0)
 			close(param.out_fd[i]);
 	}
+	list_for_each_safe(&perfs, perf, _perf, list) {
+		list_del(&perf->list);
+		free(perf);
+	}
 	return rc;
 }
@@ -0,0 +1,574 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sched.h>
+#include <limits.h>
+#include <pthread.h>
+#include <util/size.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <json-c/json.h>
+#include <daxctl/libdaxctl.h>
+#include <daxctl/memops.h>
+#include <util/pool.h>
+#include <util/parse-options.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
+
+static struct {
+	const char *region;
+	const char *align;
+	const char *size;
+	const char *nodes;
+	const char *tests;
+	unsigned int jobs;
+	bool human;
+	bool verbose;
+} param;
+
+static unsigned long flags;
+
+static const struct option bench_options[] = {
+	OPT_STRING('r', "region", &param.region, "region-id", "filter by region"),
+	OPT_STRING('a', "align", &param.align, "align[,align...]",
+			"mapping granularities to run at (default: the device's)"),
+	OPT_STRING('s', "size", &param.size, "size",
+			"bytes of the device to run over (default: up to 4G)"),
+	OPT_STRING('n', "cpu-node", &param.nodes, "node[,node...]",
+			"nodes to run the threads on (default: all with cpus)"),
+	OPT_STRING('t', "test", &param.tests, "test[,test...]",
+			"tests to run (default: all)"),
+	OPT_UINTEGER('j', "jobs", &param.jobs,
+			"threads per node (default: one per cpu of the node)"),
+	OPT_BOOLEAN('u', "human", &param.human, "use human friendly number formats"),
+	OPT_BOOLEAN('v', "verbose", &param.verbose, "emit more debug messages"),
+	OPT_END(),
+};
+
+#define BENCH_DEFAULT_SIZE (4ULL * SZ_1G)
+#define CACHELINE 64
+/* the pointer chase covers at most this many lines, spread evenly */
+#define CHASE_MAX_LINES (1UL << 24)
+#define CHASE_MIN_HOPS (1UL << 22)
+#define MAX_NODES 1024
+
+enum bench_test {
+	SEQ_READ,
+	SEQ_WRITE,
+	SEQ_WRITE_NT,
+	RAND_READ,
+	RAND_WRITE,
+	RAND_WRITE_NT,
+	LOAD_LATENCY,
+	NR_TESTS,
+};
+
+static const struct {
+	const char *name;
+	const char *key;
+} tests[] = {
+	[SEQ_READ] = { "seq_read", "seq_read_mbps" },
+	[SEQ_WRITE] = { "seq_write", "seq_write_mbps" },
+	[SEQ_WRITE_NT] = { "seq_write_nt", "seq_write_nt_mbps" },
+	[RAND_READ] = { "rand_read", "rand_read_mbps" },
+	[RAND_WRITE] = { "rand_write", "rand_write_mbps" },
+	[RAND_WRITE_NT] = { "rand_write_nt", "rand_write_nt_mbps" },
+	[LOAD_LATENCY] = { "latency", "load_latency_ns" },
+};
+
+struct bench_run {
+	char *addr;
+	size_t size;
+	enum bench_test test;
+	int nr_threads;
+	size_t slice;
+	int go;
+	/* pointer chase */
+	unsigned long hops;
+	bool nt;
+};
+
+struct bench_thread {
+	struct bench_run *run;
+	int idx;
+	pthread_t thread;
+	unsigned long long sink;
+	bool nt;
+};
+
+static unsigned long long xorshift(unsigned long long *s)
+{
+	*s ^= *s << 13;
+	*s ^= *s >> 7;
+	*s ^= *s << 17;
+	return *s;
+}
+
+static unsigned long pick(unsigned long long *s, unsigned long n)
+{
+	return xorshift(s) % n;
+}
+
+static unsigned long long seq_read(const char *p, size_t len)
+{
+	const unsigned long long *w = (const void *) p;
+	unsigned long long a = 0, b = 0, c = 0, d = 0;
+	size_t i, n = len / sizeof(*w);
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		a += w[i];
+		b += w[i + 1];
+		c += w[i + 2];
+		d += w[i + 3];
+	}
+	return a + b + c + d;
+}
+
+/* value varies per word so the compiler can not turn this into memset */
+static void seq_write(char *p, size_t len, unsigned long long val)
+{
+	unsigned long long *w = (void *) p;
+	size_t i, n = len / sizeof(*w);
+
+	for (i = 0; i < n; i++)
+		w[i] = val + i;
+}
+
+static unsigned long long line_read(const char *p)
+{
+	return seq_read(p, CACHELINE);
+}
+
+static void *bench_worker(void *arg)
+{
+	struct bench_thread *t = arg;
+	struct bench_run *run = t->run;
+	char *base = run->addr + t->idx * run->slice, *line;
+	unsigned long long s = 0x9e3779b97f4a7c15ULL * (t->idx + 1);
+	unsigned long i, nr_lines = run->slice / CACHELINE;
+	void **p;
+
+	while (!__atomic_load_n(&run->go, __ATOMIC_ACQUIRE))
+		sched_yield();
+	switch (run->test) {
+	case SEQ_READ:
+		t->sink = seq_read(base, run->slice);
+		break;
+	case SEQ_WRITE:
+		seq_write(base, run->slice, s);
+		break;
+	case SEQ_WRITE_NT:
+		t->nt = mem_fill_nt(base, run->slice, s);
+		mem_drain();
+		break;
+	case RAND_READ:
+		for (i = 0; i < nr_lines; i++)
+			t->sink += line_read(base
+					+ pick(&s, nr_lines) * CACHELINE);
+		break;
+	case RAND_WRITE:
+		for (i = 0; i < nr_lines; i++)
+			seq_write(base + pick(&s, nr_lines) * CACHELINE,
+					CACHELINE, i);
+		break;
+	case RAND_WRITE_NT:
+		for (i = 0; i < nr_lines; i++) {
+			line = base + pick(&s, nr_lines) * CACHELINE;
+			t->nt = mem_fill_nt(line, CACHELINE, i);
+		}
+		mem_drain();
+		break;
+	case LOAD_LATENCY:
+		/* every load depends on the one before */
+		p = (void **) run->addr;
+		for (i = 0; i < run->hops; i++)
+			p = *p;
+		t->sink = (unsigned long) p;
+		break;
+	default:
+		break;
+	}
+	return NULL;
+}
+
+/*
+ * One cycle through @nr lines spaced evenly over the mapping, in random
+ * order (Sattolo's algorithm), so neither the prefetchers nor the TLB
+ * get any help. Written before the clock starts.
+ */
+static int chase_setup(struct bench_run *run)
+{
+	unsigned long i, j, nr, stride, tmp, *order;
+	unsigned long long s = 0x2545f4914f6cdd1dULL;
+
+	nr = min_t(unsigned long, run->size / CACHELINE, CHASE_MAX_LINES);
+	stride = run->size / CACHELINE / nr;
+	order = calloc(nr, sizeof(*order));
+	if (!order)
+		return -ENOMEM;
+	for (i = 0; i < nr; i++)
+		order[i] = i;
+	for (i = nr - 1; i > 0; i--) {
+		j = pick(&s, i);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+	/* order[] is a single cycle, line i points at line order[i] */
+	for (i = 0; i < nr; i++)
+		*(void **) (run->addr + i * stride * CACHELINE) =
+			run->addr + order[i] * stride * CACHELINE;
+	free(order);
+	run->hops = max(nr, CHASE_MIN_HOPS);
+	return 0;
+}
+
+/* returns MB/s, or ns per load for LOAD_LATENCY, negative on error */
+static long long bench_run_one(struct bench_run *run, const cpu_set_t *cpus)
+{
+	int i, nr = run->test == LOAD_LATENCY ? 1 : run->nr_threads, spawned;
+	unsigned long long start, ns;
+	struct bench_thread *threads;
+	pthread_attr_t attr;
+	long long rc;
+
+	if (run->test == LOAD_LATENCY) {
+		rc = chase_setup(run);
+		if (rc)
+			return rc;
+	}
+	run->slice = run->size / nr / CACHELINE * CACHELINE;
+
+	threads = calloc(nr, sizeof(*threads));
+	if (!threads)
+		return -ENOMEM;
+	run->go = 0;
+	pthread_attr_init(&attr);
+	pthread_attr_setaffinity_np(&attr, sizeof(*cpus), cpus);
+	for (spawned = 0; spawned < nr; spawned++) {
+		threads[spawned].run = run;
+		threads[spawned].idx = spawned;
+		if (pthread_create(&threads[spawned].thread, &attr,
+					bench_worker, &threads[spawned]))
+			break;
+	}
+	pthread_attr_destroy(&attr);
+
+	/* all threads start at once */
+	start = now_ns();
+	__atomic_store_n(&run->go, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < spawned; i++)
+		pthread_join(threads[i].thread, NULL);
+	ns = max(now_ns() - start, 1ULL);
+	if (spawned < nr) {
+		/* part of the range was not covered, the number is meaningless */
+		free(threads);
+		return -EAGAIN;
+	}
+
+	run->nt = true;
+	for (i = 0; i < nr; i++)
+		run->nt &= threads[i].nt;
+	free(threads);
+
+	if (run->test == LOAD_LATENCY)
+		return ns / run->hops;
+	/* bytes per ns times 1000 is MB/s */
+	return run->slice * nr * 1000ULL / ns;
+}
+
+static int parse_list(const char *str, unsigned long long *vals, int max,
+		bool sizes)
+{
+	char *dup, *tok, *save, *end;
+	int nr = 0;
+
+	dup = strdup(str);
+	if (!dup)
+		return -ENOMEM;
+	for (tok = strtok_r(dup, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save)) {
+		if (nr == max) {
+			nr = -E2BIG;
+			break;
+		}
+		if (sizes) {
+			vals[nr] = parse_size64(tok);
+			end = vals[nr] == ULLONG_MAX ? tok : tok + strlen(tok);
+		} else
+			vals[nr] = strtoul(tok, &end, 0);
+		if (end == tok || *end) {
+			fprintf(stderr, "invalid list entry: %s\n", tok);
+			nr = -EINVAL;
+			break;
+		}
+		nr++;
+	}
+	free(dup);
+	return nr;
+}
+
+static int parse_tests(const char *str, bool *enabled)
+{
+	char *dup, *tok, *save;
+	unsigned int i;
+	int rc = 0;
+
+	if (!str) {
+		for (i = 0; i < NR_TESTS; i++)
+			enabled[i] = true;
+		return 0;
+	}
+
+	dup = strdup(str);
+	if (!dup)
+		return -ENOMEM;
+	for (tok = strtok_r(dup, ",", &save); tok && rc == 0;
+			tok = strtok_r(NULL, ",", &save)) {
+		for (i = 0; i < NR_TESTS; i++)
+			if (strcmp(tok, tests[i].name) == 0)
+				break;
+		if (i < NR_TESTS)
+			enabled[i] = true;
+		else {
+			fprintf(stderr, "unknown test: %s\n", tok);
+			rc = -EINVAL;
+		}
+	}
+	free(dup);
+	return rc;
+}
+
+/* device-dax only takes a new alignment while disabled */
+static int bench_set_align(struct daxctl_dev *dev, unsigned long align)
+{
+	const char *devname = daxctl_dev_get_devname(dev);
+	int rc;
+
+	if (daxctl_dev_get_align(dev) == align)
+		return 0;
+	rc = daxctl_dev_disable(dev);
+	if (rc == 0) {
+		rc = daxctl_dev_set_align(dev, align);
+		if (rc)
+			fprintf(stderr, "%s: can not use align %#lx\n",
+					devname, align);
+		if (daxctl_dev_enable_devdax(dev) && rc == 0)
+			rc = -ENXIO;
+	}
+	if (rc)
+		fprintf(stderr, "%s: failed to switch to align %#lx: %s\n",
+				devname, align, strerror(-rc));
+	return rc;
+}
+
+static struct json_object *bench_map(struct daxctl_map *map,
+		unsigned long align, int node, const cpu_set_t *cpus,
+		const bool *enabled)
+{
+	struct bench_run run = {
+		.addr = daxctl_map_get_addr(map),
+		.size = daxctl_map_get_size(map),
+		.nr_threads = param.jobs ? (int) param.jobs : CPU_COUNT(cpus),
+	};
+	struct json_object *jres;
+	unsigned int i;
+	long long val;
+	bool nt = true;
+
+	jres = json_object_new_object();
+	if (!jres)
+		return NULL;
+	json_object_object_add(jres, "align", util_json_object_size(align,
+				flags));
+	json_object_object_add(jres, "size", util_json_object_size(run.size,
+				flags));
+	json_object_object_add(jres, "cpu_node", json_object_new_int(node));
+	json_object_object_add(jres, "threads",
+			json_object_new_int(run.nr_threads));
+
+	for (i = 0; i < NR_TESTS; i++) {
+		if (!enabled[i])
+			continue;
+		run.test = i;
+		val = bench_run_one(&run, cpus);
+		if (val < 0) {
+			fprintf(stderr, "node%d: %s failed: %s\n", node,
+					tests[i].name, strerror(-val));
+			continue;
+		}
+		if (i == SEQ_WRITE_NT || i == RAND_WRITE_NT)
+			nt &= run.nt;
+		json_object_object_add(jres, tests[i].key,
+				json_object_new_int64(val));
+	}
+	if (enabled[SEQ_WRITE_NT] || enabled[RAND_WRITE_NT])
+		json_object_object_add(jres, "non_temporal",
+				json_object_new_boolean(nt));
+	return jres;
+}
+
+static int bench_dev(struct daxctl_dev *dev, unsigned long long *aligns,
+		int nr_aligns, int *nodes, int nr_nodes, const bool *enabled,
+		struct json_object *jdevs)
+{
+	unsigned long orig_align = daxctl_dev_get_align(dev), align;
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct json_object *jdev, *jresults, *jres;
+	unsigned long long size;
+	struct daxctl_map *map;
+	int a, n, rc = 0, err = 0, ran = 0;
+	cpu_set_t cpus;
+
+	if (daxctl_dev_get_memory(dev) || !daxctl_dev_is_enabled(dev)) {
+		fprintf(stderr, "%s: not an enabled devdax device\n", devname);
+		return -ENXIO;
+	}
+
+	jdev = json_object_new_object();
+	jresults = json_object_new_array();
+	if (!jdev || !jresults) {
+		json_object_put(jdev);
+		json_object_put(jresults);
+		return -ENOMEM;
+	}
+	json_object_object_add(jdev, "chardev",
+			json_object_new_string(devname));
+	json_object_object_add(jdev, "target_node",
+			json_object_new_int(daxctl_dev_get_target_node(dev)));
+	json_object_object_add(jdev, "results", jresults);
+
+	for (a = 0; a < max(nr_aligns, 1); a++) {
+		align = nr_aligns ? aligns[a] : orig_align;
+		rc = bench_set_align(dev, align);
+		if (rc)
+			continue;
+		align = daxctl_dev_get_align(dev);
+
+		size = param.size ? parse_size64(param.size)
+			: min(daxctl_dev_get_size(dev), BENCH_DEFAULT_SIZE);
+		size = min(size, daxctl_dev_get_size(dev));
+		if (align > 1)
+			size = size / align * align;
+		if (!size) {
+			fprintf(stderr, "%s: less than one %#lx page to run over\n",
+					devname, align);
+			rc = -EINVAL;
+			continue;
+		}
+		/* faults are not what is measured */
+		rc = daxctl_dev_mmap(dev, 0, size, DAXCTL_MAP_PREFAULT, &map);
+		if (rc) {
+			fprintf(stderr, "%s: mmap at align %#lx failed: %s\n",
+					devname, align, strerror(-rc));
+			continue;
+		}
+
+		for (n = 0; n < nr_nodes; n++) {
+			if (node_get_cpus(nodes[n], &cpus) < 0) {
+				fprintf(stderr, "node%d: no cpus\n", nodes[n]);
+				continue;
+			}
+			jres = bench_map(map, align, nodes[n], &cpus, enabled);
+			if (jres) {
+				json_object_array_add(jresults, jres);
+				ran++;
+			}
+		}
+		daxctl_map_unmap(map);
+	}
+
+	/* put the device back the way it was found */
+	if (nr_aligns && bench_set_align(dev, orig_align))
+		err = -ENXIO;
+	if (!ran) {
+		json_object_put(jdev);
+		return rc ? rc : -ENXIO;
+	}
+	json_object_array_add(jdevs, jdev);
+	return err;
+}
+
+int cmd_bench(int argc, const char **argv, struct daxctl_ctx *ctx)
+{
+	const char * const u[] = {
+		"daxctl bench <device> [<options>]",
+		NULL
+	};
+	unsigned long long aligns[8], vals[MAX_NODES];
+	int i, nr_aligns = 0, nr_nodes, rc = -ENXIO, processed = 0;
+	int nodes[MAX_NODES];
+	struct json_object *jdevs;
+	struct daxctl_region *region;
+	bool enabled[NR_TESTS] = { false };
+	struct daxctl_dev *dev;
+	const char *device;
+
+	argc = parse_options(argc, argv, bench_options, u, 0);
+	for (i = 1; i < argc; i++)
+		fprintf(stderr, "unknown extra parameter \"%s\"\n", argv[i]);
+	if (argc != 1)
+		usage_with_options(u, bench_options);
+	device = argv[0];
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+	if (param.verbose)
+		daxctl_set_log_priority(ctx, LOG_DEBUG);
+
+	if (param.size && parse_size64(param.size) == ULLONG_MAX) {
+		fprintf(stderr, "invalid size: %s\n", param.size);
+		return -EINVAL;
+	}
+	if (param.align) {
+		nr_aligns = parse_list(param.align, aligns,
+				ARRAY_SIZE(aligns), true);
+		if (nr_aligns < 0)
+			return nr_aligns;
+	}
+	if (param.nodes) {
+		nr_nodes = parse_list(param.nodes, vals, MAX_NODES, false);
+		for (i = 0; i < nr_nodes; i++)
+			nodes[i] = vals[i];
+	} else
+		nr_nodes = min(node_get_cpu_nodes(nodes, MAX_NODES),
+				MAX_NODES);
+	if (nr_nodes <= 0) {
+		fprintf(stderr, "no nodes to run on\n");
+		return nr_nodes < 0 ? nr_nodes : -ENXIO;
+	}
+	rc = parse_tests(param.tests, enabled);
+	if (rc)
+		return rc;
+
+	jdevs = json_object_new_array();
+	if (!jdevs)
+		return -ENOMEM;
+
+	rc = -ENXIO;
+	daxctl_region_foreach(ctx, region) {
+		if (!util_daxctl_region_filter(region, param.region))
+			continue;
+
+		daxctl_dev_foreach(region, dev) {
+			if (!util_daxctl_dev_filter(dev, device))
+				continue;
+			if (!daxctl_dev_get_size(dev))
+				continue;
+			rc = bench_dev(dev, aligns, nr_aligns, nodes, nr_nodes,
+					enabled, jdevs);
+			if (rc == 0)
+				processed++;
+		}
+	}
+
+	if (processed)
+		util_display_json_array(stdout, jdevs, flags);
+	else
+		json_object_put(jdevs);
+
+	return rc;
+}
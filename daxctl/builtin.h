@@ -5,6 +5,7 @@
 
 struct daxctl_ctx;
 int cmd_list(int argc, const char **argv, struct daxctl_ctx *ctx);
+int cmd_daemon(int argc, const char **argv, struct daxctl_ctx *ctx);
 int cmd_migrate(int argc, const char **argv, struct daxctl_ctx *ctx);
 int cmd_create_device(int argc, const char **argv, struct daxctl_ctx *ctx);
 int cmd_destroy_device(int argc, const char **argv, struct daxctl_ctx *ctx);
@@ -13,5 +14,9 @@ int cmd_disable_device(int argc, const char **argv, struct daxctl_ctx *ctx);
 int cmd_enable_device(int argc, const char **argv, struct daxctl_ctx *ctx);
 int cmd_online_memory(int argc, const char **argv, struct daxctl_ctx *ctx);
 int cmd_offline_memory(int argc, const char **argv, struct daxctl_ctx *ctx);
+int cmd_save_config(int argc, const char **argv, struct daxctl_ctx *ctx);
+int cmd_apply_config(int argc, const char **argv, struct daxctl_ctx *ctx);
+int cmd_zero_device(int argc, const char **argv, struct daxctl_ctx *ctx);
+int cmd_bench(int argc, const char **argv, struct daxctl_ctx *ctx);
 int cmd_split_acpi(int argc, const char **argv, struct daxctl_ctx *ctx);
 #endif /* _DAXCTL_BUILTIN_H_ */
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <daxctl/libdaxctl.h>
+#include <util/parse-options.h>
+#include <ccan/array_size/array_size.h>
+
+#include <util/daemon.h>
+#include <daxctl/builtin.h>
+
+static const char * const subsystems[] = { "dax", "cxl", NULL };
+
+static struct cmd_struct served_cmds[] = {
+	{ "list", .d_fn = cmd_list },
+};
+
+static void *daemon_refresh(struct util_daemon *d)
+{
+	struct daxctl_ctx *old = d->ctx, *ctx;
+
+	if (daxctl_new(&ctx) != 0) {
+		log_err(&d->log, "failed to re-create the context\n");
+		return NULL;
+	}
+	daxctl_set_log_priority(ctx, daxctl_get_log_priority(old));
+	daxctl_unref(old);
+	return ctx;
+}
+
+static void daemon_warm(struct util_daemon *d)
+{
+	struct daxctl_region *region;
+
+	daxctl_region_foreach(d->ctx, region)
+		daxctl_dev_get_first(region);
+}
+
+int cmd_daemon(int argc, const char **argv, struct daxctl_ctx *ctx)
+{
+	const char *log = NULL;
+	bool background = false, verbose = false;
+	struct util_daemon d = {
+		.prog = PROG_DAXCTL,
+		.subsystems = subsystems,
+		.refresh = daemon_refresh,
+		.warm = daemon_warm,
+		.cmds = served_cmds,
+		.num_cmds = ARRAY_SIZE(served_cmds),
+	};
+	const struct option options[] = {
+		OPT_STRING('s', "socket", &d.socket, "path",
+			"listen on <path> (default " UTIL_DAEMON_DIR "/daxctl.sock)"),
+		OPT_FILENAME('l', "log", &log,
+			"<file> | syslog | standard",
+			"where to log (default standard)"),
+		OPT_BOOLEAN('\0', "daemon", &background,
+			"run daxctl daemon in the background"),
+		OPT_BOOLEAN('v', "verbose", &verbose, "log every query"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"daxctl daemon [<options>]",
+		NULL
+	};
+	const char *prefix = "./";
+	int i, rc;
+
+	argc = parse_options_prefix(argc, argv, prefix, options, u, 0);
+	for (i = 0; i < argc; i++)
+		error("unknown parameter \"%s\"\n", argv[i]);
+	if (argc)
+		usage_with_options(u, options);
+
+	rc = util_daemon_start(&d, "daxctl/daemon", log, prefix, background,
+			verbose);
+	if (rc)
+		return rc;
+
+	/* main() keeps its reference, refreshes drop only ours */
+	d.ctx = daxctl_ref(ctx);
+	rc = util_daemon_serve(&d);
+	daxctl_unref(d.ctx);
+	return rc;
+}
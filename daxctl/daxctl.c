@@ -18,9 +18,11 @@
 #include <util/strbuf.h>
 #include <util/util.h>
 #include <util/main.h>
+#include <util/daemon.h>
+#include <util/pool.h>
 #include <daxctl/builtin.h>
 
-const char daxctl_usage_string[] = "daxctl [--version] [--help] COMMAND [ARGS]";
+const char daxctl_usage_string[] = "daxctl [--version] [--help] [-j <n>] COMMAND [ARGS]";
 const char daxctl_more_info_string[] =
 	"See 'daxctl help COMMAND' for more information on a specific command.\n"
 	" daxctl --list-cmds to see all available commands";
@@ -69,6 +71,11 @@ static struct cmd_struct commands[] = {
 	{ "offline-memory", .d_fn = cmd_offline_memory },
 	{ "disable-device", .d_fn = cmd_disable_device },
 	{ "enable-device", .d_fn = cmd_enable_device },
+	{ "save-config", .d_fn = cmd_save_config },
+	{ "apply-config", .d_fn = cmd_apply_config },
+	{ "zero-device", .d_fn = cmd_zero_device },
+	{ "bench", .d_fn = cmd_bench },
+	{ "daemon", .d_fn = cmd_daemon },
 };
 
 int main(int argc, const char **argv)
@@ -92,9 +99,14 @@ int main(int argc, const char **argv)
 		goto out;
 	}
 
+	/* a resident daemon answers this without enumerating */
+	main_handle_daemon_command(argc, argv, PROG_DAXCTL);
+
 	rc = daxctl_new(&ctx);
 	if (rc)
 		goto out;
+	/* the top level -j bounds the library's threads too */
+	daxctl_set_max_threads(ctx, util_pool_max_jobs);
 	main_handle_internal_command(argc, argv, ctx, commands,
 			ARRAY_SIZE(commands), PROG_DAXCTL);
 	daxctl_unref(ctx);
@@ -3,19 +3,26 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
+#include <time.h>
 #include <unistd.h>
 #include <limits.h>
+#include <pthread.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/sysmacros.h>
 #include <util/size.h>
 #include <util/json.h>
 #include <util/filter.h>
+#include <util/pool.h>
 #include <json-c/json.h>
 #include <json-c/json_util.h>
 #include <daxctl/libdaxctl.h>
+#include <daxctl/plan.h>
 #include <util/parse-options.h>
+#include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
 
 static struct {
@@ -25,12 +32,30 @@ static struct {
 	const char *size;
 	const char *align;
 	const char *input;
+	const char *output;
 	bool no_online;
 	bool no_movable;
+	const char *normal;
+	bool plan;
 	bool force;
 	bool human;
+	bool timing;
+	bool demotion;
+	bool promotion;
 	bool verbose;
-} param;
+	unsigned int jobs;
+	unsigned int count;
+} param = {
+	.jobs = 1,
+};
+
+/*
+ * Enabling a device rescans its region and loads modules through the
+ * shared libdaxctl context, neither of which is thread safe. With
+ * --jobs, mode changes take this lock, and only memory onlining and
+ * offlining run concurrently.
+ */
+static pthread_mutex_t dev_lock = PTHREAD_MUTEX_INITIALIZER;
 
 enum dev_mode {
 	DAXCTL_DEV_MODE_UNKNOWN,
@@ -38,22 +63,23 @@ enum dev_mode {
 	DAXCTL_DEV_MODE_RAM,
 };
 
-struct mapping {
-	unsigned long long start, end, pgoff;
-};
-
 static enum dev_mode reconfig_mode = DAXCTL_DEV_MODE_UNKNOWN;
 static long long align = -1;
 static long long size = -1;
 static unsigned long flags;
 static struct mapping *maps = NULL;
 static long long nmaps = -1;
+static unsigned long long *plan_sizes;
+static int nr_plan_sizes;
 
 enum memory_zone {
 	MEM_ZONE_MOVABLE,
 	MEM_ZONE_NORMAL,
 };
 static enum memory_zone mem_zone = MEM_ZONE_MOVABLE;
+/* --normal: the leading part of the memory to online to ZONE_NORMAL */
+static unsigned long long normal_size;
+static unsigned int normal_pct;
 
 enum device_action {
 	ACTION_RECONFIG,
@@ -63,6 +89,7 @@ enum device_action {
 	ACTION_DISABLE,
 	ACTION_ENABLE,
 	ACTION_DESTROY,
+	ACTION_APPLY,
 };
 
 #define BASE_OPTIONS() \
@@ -88,13 +115,40 @@ OPT_BOOLEAN('f', "force", &param.force, \
 
 #define ZONE_OPTIONS() \
 OPT_BOOLEAN('\0', "no-movable", &param.no_movable, \
-		"online memory in ZONE_NORMAL")
+		"online memory in ZONE_NORMAL"), \
+OPT_STRING('\0', "normal", &param.normal, "size|N%", \
+		"online <size>, or N% of each device, in ZONE_NORMAL, the rest movable")
+
+#define TIERING_OPTIONS() \
+OPT_BOOLEAN('\0', "demotion", &param.demotion, \
+		"let reclaim demote cold pages to slower memory tiers"), \
+OPT_BOOLEAN('\0', "promotion", &param.promotion, \
+		"let NUMA balancing promote hot pages to faster tiers")
+
+#define JOBS_OPTIONS() \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+		"handle up to <n> devices at once (default 1)")
+
+#define TIMING_OPTIONS() \
+OPT_BOOLEAN('\0', "timing", &param.timing, \
+		"report time spent per step and per memory block")
+
+#define COUNT_OPTIONS() \
+OPT_UINTEGER('c', "count", &param.count, \
+		"create <n> devices, splitting the region if no size is given")
+
+#define PLAN_OPTIONS() \
+OPT_BOOLEAN('\0', "plan", &param.plan, \
+		"place devices on huge page aligned ranges, sizes may be a list")
 
 static const struct option create_options[] = {
 	BASE_OPTIONS(),
 	CREATE_OPTIONS(),
+	COUNT_OPTIONS(),
+	PLAN_OPTIONS(),
 	RECONFIG_OPTIONS(),
 	ZONE_OPTIONS(),
+	JOBS_OPTIONS(),
 	OPT_END(),
 };
 
@@ -103,17 +157,23 @@ static const struct option reconfig_options[] = {
 	CREATE_OPTIONS(),
 	RECONFIG_OPTIONS(),
 	ZONE_OPTIONS(),
+	TIERING_OPTIONS(),
+	TIMING_OPTIONS(),
+	JOBS_OPTIONS(),
 	OPT_END(),
 };
 
 static const struct option online_options[] = {
 	BASE_OPTIONS(),
 	ZONE_OPTIONS(),
+	TIMING_OPTIONS(),
+	JOBS_OPTIONS(),
 	OPT_END(),
 };
 
 static const struct option offline_options[] = {
 	BASE_OPTIONS(),
+	JOBS_OPTIONS(),
 	OPT_END(),
 };
 
@@ -133,6 +193,25 @@ static const struct option destroy_options[] = {
 	OPT_END(),
 };
 
+/* the saved file is parsed back, so no --human */
+static const struct option save_options[] = {
+	OPT_STRING('r', "region", &param.region, "region-id", "filter by region"),
+	OPT_STRING('o', "output", &param.output, "file",
+			"write the configuration to <file> instead of stdout"),
+	OPT_BOOLEAN('v', "verbose", &param.verbose, "emit more debug messages"),
+	OPT_END(),
+};
+
+static const struct option apply_options[] = {
+	OPT_BOOLEAN('u', "human", &param.human, "use human friendly number formats"),
+	OPT_BOOLEAN('v', "verbose", &param.verbose, "emit more debug messages"),
+	OPT_BOOLEAN('f', "force", &param.force,
+		"offline memory and ignore the kernel auto-online policy"),
+	OPT_UINTEGER('j', "jobs", &param.jobs,
+		"handle up to <n> devices at once (default all)"),
+	OPT_END(),
+};
+
 static int sort_mappings(const void *a, const void *b)
 {
 	json_object **jsoa, **jsob;
@@ -154,10 +233,53 @@ static int sort_mappings(const void *a, const void *b)
 	return pga > pgb;
 }
 
+/* @jmappings is a "mappings" array as listed by 'daxctl list -M' */
+static int parse_mappings(struct json_object *jmappings,
+		struct mapping **mapsp, long long *nmapsp)
+{
+	struct mapping *m;
+	long long i, nr;
+
+	json_object_array_sort(jmappings, sort_mappings);
+
+	nr = json_object_array_length(jmappings);
+	m = calloc(nr, sizeof(*m));
+	if (!m)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		struct json_object *j, *val;
+
+		j = json_object_array_get_idx(jmappings, i);
+		if (!j)
+			goto err;
+
+		if (!json_object_object_get_ex(j, "start", &val))
+			goto err;
+		m[i].start = json_object_get_int64(val);
+
+		if (!json_object_object_get_ex(j, "end", &val))
+			goto err;
+		m[i].end = json_object_get_int64(val);
+
+		if (!json_object_object_get_ex(j, "page_offset", &val))
+			goto err;
+		m[i].pgoff = json_object_get_int64(val);
+	}
+
+	*mapsp = m;
+	*nmapsp = nr;
+	return 0;
+
+err:
+	free(m);
+	return -EINVAL;
+}
+
 static int parse_device_file(const char *filename)
 {
 	struct json_object *jobj, *jval = NULL, *jmappings = NULL;
-	int i, rc = -EINVAL, region_id, id;
+	int rc = -EINVAL, region_id, id;
 	const char *chardev;
 	char  *region = NULL;
 
@@ -184,38 +306,66 @@ static int parse_device_file(const char *filename)
 
 	if (!json_object_object_get_ex(jobj, "mappings", &jmappings))
 		return rc;
-	json_object_array_sort(jmappings, sort_mappings);
 
-	nmaps = json_object_array_length(jmappings);
-	maps = calloc(nmaps, sizeof(*maps));
-	if (!maps)
-		return -ENOMEM;
+	return parse_mappings(jmappings, &maps, &nmaps);
+}
 
-	for (i = 0; i < nmaps; i++) {
-		struct json_object *j, *val;
+/* a comma separated list of sizes for create-device --plan */
+static int parse_size_list(const char *list)
+{
+	unsigned long long units = 1, *sizes, val;
+	char *buf, *tok, *save;
+	int rc = 0;
 
-		j = json_object_array_get_idx(jmappings, i);
-		if (!j)
-			goto err;
+	buf = strdup(list);
+	if (!buf)
+		return -ENOMEM;
 
-		if (!json_object_object_get_ex(j, "start", &val))
-			goto err;
-		maps[i].start = json_object_get_int64(val);
+	for (tok = strtok_r(buf, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save)) {
+		val = __parse_size64(tok, &units);
+		if (val == ULLONG_MAX || !val) {
+			rc = -EINVAL;
+			break;
+		}
+		sizes = realloc(plan_sizes, (nr_plan_sizes + 1)
+				* sizeof(*sizes));
+		if (!sizes) {
+			rc = -ENOMEM;
+			break;
+		}
+		plan_sizes = sizes;
+		plan_sizes[nr_plan_sizes++] = val;
+	}
+	free(buf);
+	return rc;
+}
 
-		if (!json_object_object_get_ex(j, "end", &val))
-			goto err;
-		maps[i].end = json_object_get_int64(val);
+static int parse_normal(const char *arg)
+{
+	unsigned long pct;
+	char *end;
 
-		if (!json_object_object_get_ex(j, "page_offset", &val))
-			goto err;
-		maps[i].pgoff = json_object_get_int64(val);
+	if (param.no_movable) {
+		fprintf(stderr, "--normal is incompatible with --no-movable\n");
+		return -EINVAL;
+	}
+	if (arg[strlen(arg) - 1] == '%') {
+		pct = strtoul(arg, &end, 10);
+		if (*end != '%' || pct == 0 || pct >= 100) {
+			fprintf(stderr, "error: --normal takes 1%% to 99%%, not \"%s\"\n",
+					arg);
+			return -EINVAL;
+		}
+		normal_pct = pct;
+		return 0;
+	}
+	normal_size = parse_size64(arg);
+	if (normal_size == ULLONG_MAX || normal_size == 0) {
+		fprintf(stderr, "error: invalid --normal size \"%s\"\n", arg);
+		return -EINVAL;
 	}
-
 	return 0;
-
-err:
-	free(maps);
-	return rc;
 }
 
 static const char *parse_device_options(int argc, const char **argv,
@@ -306,6 +456,12 @@ static const char *parse_device_options(int argc, const char **argv,
 				rc =  -EINVAL;
 			}
 		}
+		if ((param.demotion || param.promotion)
+				&& reconfig_mode != DAXCTL_DEV_MODE_RAM) {
+			fprintf(stderr,
+				"--demotion and --promotion need --mode=system-ram\n");
+			rc = -EINVAL;
+		}
 		break;
 	case ACTION_CREATE:
 		if (param.input &&
@@ -315,7 +471,34 @@ static const char *parse_device_options(int argc, const char **argv,
 				strerror(-rc));
 			break;
 		}
-		if (param.size)
+		if (param.plan && param.input) {
+			fprintf(stderr, "--plan is incompatible with --input\n");
+			rc = -EINVAL;
+			break;
+		}
+		if (param.count > 1 && param.input) {
+			fprintf(stderr, "--count is incompatible with --input\n");
+			rc = -EINVAL;
+			break;
+		}
+		if (!param.mode || strcmp(param.mode, "devdax") == 0)
+			reconfig_mode = DAXCTL_DEV_MODE_DEVDAX;
+		else if (strcmp(param.mode, "system-ram") == 0)
+			reconfig_mode = DAXCTL_DEV_MODE_RAM;
+		else {
+			fprintf(stderr, "error: unknown mode \"%s\"\n",
+				param.mode);
+			rc = -EINVAL;
+			break;
+		}
+		if (param.plan && param.size) {
+			rc = parse_size_list(param.size);
+			if (rc) {
+				fprintf(stderr, "error: invalid size list \"%s\"\n",
+					param.size);
+				break;
+			}
+		} else if (param.size)
 			size = __parse_size64(param.size, &units);
 		if (param.align)
 			align = __parse_size64(param.align, &units);
@@ -328,9 +511,12 @@ static const char *parse_device_options(int argc, const char **argv,
 	case ACTION_OFFLINE:
 	case ACTION_DISABLE:
 	case ACTION_ENABLE:
+	case ACTION_APPLY:
 		/* nothing special */
 		break;
 	}
+	if (!rc && param.normal)
+		rc = parse_normal(param.normal);
 	if (rc) {
 		usage_with_options(u, options);
 		return NULL;
@@ -339,10 +525,132 @@ static const char *parse_device_options(int argc, const char **argv,
 	return argv[0];
 }
 
-static int dev_online_memory(struct daxctl_dev *dev)
+/*
+ * Wall time of each step of a reconfigure or online-memory, reported
+ * with --timing. Per block times and the zone check come from libdaxctl.
+ */
+struct dev_timing {
+	unsigned long long start_ns;
+	unsigned long long total_ns;
+	unsigned long long disable_ns;
+	unsigned long long bind_ns;
+	unsigned long long online_ns;
+};
+
+struct dev_job {
+	struct daxctl_dev *dev;
+	struct dev_timing t;
+	/* from the command line, or per device with apply-config */
+	enum dev_mode mode;
+	bool no_online;
+	bool no_movable;
+	/* split between ZONE_NORMAL and ZONE_MOVABLE, see --normal */
+	unsigned long long normal_size;
+	unsigned int normal_pct;
+	/* whether the device gets an entry in the JSON output */
+	bool report;
+	int rc;
+};
+
+struct dev_queue {
+	struct dev_job *jobs;
+	enum device_action action;
+	int nr;
+};
+
+static void dev_queue_run(struct dev_queue *q);
+
+#define TIMING_SLOWEST 5
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct block_time {
+	unsigned long block;
+	unsigned long long ns;
+};
+
+static int block_time_cmp(const void *a, const void *b)
+{
+	const struct block_time *t1 = a, *t2 = b;
+
+	if (t1->ns != t2->ns)
+		return t1->ns < t2->ns ? 1 : -1;
+	return t1->block < t2->block ? -1 : t1->block > t2->block;
+}
+
+static void timing_add_us(struct json_object *jtiming, const char *key,
+		unsigned long long ns)
+{
+	json_object_object_add(jtiming, key,
+			json_object_new_int64((ns + 500) / 1000));
+}
+
+static struct json_object *timing_to_json(struct daxctl_dev *dev,
+		struct dev_timing *t)
 {
+	struct daxctl_memory *mem = daxctl_dev_get_memory(dev);
+	struct json_object *jtiming, *jslow, *jblock;
+	struct block_time *times = NULL;
+	int i, nr = 0;
+
+	jtiming = json_object_new_object();
+	if (!jtiming)
+		return NULL;
+
+	timing_add_us(jtiming, "total_us", t->total_ns);
+	if (t->disable_ns)
+		timing_add_us(jtiming, "disable_us", t->disable_ns);
+	if (t->bind_ns)
+		timing_add_us(jtiming, "bind_us", t->bind_ns);
+	if (t->online_ns)
+		timing_add_us(jtiming, "online_us", t->online_ns);
+	if (mem && t->online_ns)
+		timing_add_us(jtiming, "zone_us",
+				daxctl_memory_get_zone_time(mem));
+
+	if (mem && t->online_ns)
+		nr = daxctl_memory_get_num_block_times(mem);
+	if (nr > 0)
+		times = calloc(nr, sizeof(*times));
+	if (!times)
+		return jtiming;
+	for (i = 0; i < nr; i++)
+		daxctl_memory_get_block_time(mem, i, &times[i].block,
+				&times[i].ns);
+	qsort(times, nr, sizeof(*times), block_time_cmp);
+
+	/* sorted slowest first */
+	json_object_object_add(jtiming, "blocks", json_object_new_int(nr));
+	timing_add_us(jtiming, "block_p50_us", times[nr / 2].ns);
+	timing_add_us(jtiming, "block_p99_us", times[nr / 100].ns);
+	jslow = json_object_new_array();
+	for (i = 0; jslow && i < min(nr, TIMING_SLOWEST); i++) {
+		jblock = json_object_new_object();
+		if (!jblock)
+			break;
+		json_object_object_add(jblock, "block",
+				json_object_new_int64(times[i].block));
+		timing_add_us(jblock, "us", times[i].ns);
+		json_object_array_add(jslow, jblock);
+	}
+	if (jslow)
+		json_object_object_add(jtiming, "slowest_blocks", jslow);
+	free(times);
+	return jtiming;
+}
+
+static int dev_online_memory(struct dev_job *job)
+{
+	struct daxctl_dev *dev = job->dev;
 	struct daxctl_memory *mem = daxctl_dev_get_memory(dev);
 	const char *devname = daxctl_dev_get_devname(dev);
+	unsigned long long start;
 	int num_sections, num_on, rc;
 
 	if (!mem) {
@@ -385,10 +693,17 @@ static int dev_online_memory(struct daxctl_dev *dev)
 			num_on == 1 ? "" : "s");
 
 	/* online the remaining sections */
-	if (param.no_movable)
+	start = now_ns();
+	if (job->no_movable)
 		rc = daxctl_memory_online_no_movable(mem);
+	else if (job->normal_pct)
+		rc = daxctl_memory_online_split(mem,
+			daxctl_dev_get_size(dev) / 100 * job->normal_pct);
+	else if (job->normal_size)
+		rc = daxctl_memory_online_split(mem, job->normal_size);
 	else
 		rc = daxctl_memory_online(mem);
+	job->t.online_ns = now_ns() - start;
 	if (rc < 0) {
 		fprintf(stderr, "%s: failed to online memory: %s\n",
 			devname, strerror(-rc));
@@ -530,7 +845,9 @@ static int disable_devdax_device(struct daxctl_dev *dev)
 			devname);
 		return 1;
 	}
+	pthread_mutex_lock(&dev_lock);
 	rc = daxctl_dev_disable(dev);
+	pthread_mutex_unlock(&dev_lock);
 	if (rc) {
 		fprintf(stderr, "%s: disable failed: %s\n",
 			daxctl_dev_get_devname(dev), strerror(-rc));
@@ -539,12 +856,72 @@ static int disable_devdax_device(struct daxctl_dev *dev)
 	return 0;
 }
 
-static int reconfig_mode_system_ram(struct daxctl_dev *dev)
+/*
+ * The kernel picks demotion targets from the memory tiers, which the
+ * kmem driver assigns from the node's performance. Demotion only
+ * reaches the new node if that put it below the memory of the cpus
+ * doing the reclaim.
+ */
+static void check_memory_tier(struct daxctl_dev *dev)
 {
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
 	const char *devname = daxctl_dev_get_devname(dev);
+	int node = daxctl_dev_get_target_node(dev);
+	unsigned int cpu, local;
+	int tier, local_tier;
+
+	tier = daxctl_node_get_memory_tier(ctx, node);
+	if (tier == -EOPNOTSUPP) {
+		fprintf(stderr, "%s: kernel has no memory tiering\n", devname);
+		return;
+	}
+	if (tier < 0 || syscall(SYS_getcpu, &cpu, &local, NULL) != 0)
+		return;
+	local_tier = daxctl_node_get_memory_tier(ctx, local);
+	if (local_tier >= 0 && tier <= local_tier)
+		fprintf(stderr,
+			"%s: node %d is in memory tier %d, not below node %u (tier %d), nothing will be demoted to it\n",
+			devname, node, tier, local, local_tier);
+}
+
+/* system wide, so applied once after the devices are online */
+static int apply_tiering(struct daxctl_ctx *ctx)
+{
+	int rc, mode;
+
+	if (param.demotion) {
+		rc = daxctl_set_demotion(ctx, 1);
+		if (rc) {
+			fprintf(stderr, "failed to enable demotion: %s\n",
+				strerror(-rc));
+			return rc;
+		}
+	}
+
+	if (param.promotion) {
+		mode = daxctl_get_numa_balancing(ctx);
+		if (mode < 0)
+			mode = 0;
+		rc = daxctl_set_numa_balancing(ctx,
+				mode | DAXCTL_NUMA_BALANCING_TIERING);
+		if (rc) {
+			fprintf(stderr, "failed to enable promotion: %s\n",
+				strerror(-rc));
+			return rc;
+		}
+	}
+	return 0;
+}
+
+static int reconfig_mode_system_ram(struct dev_job *job)
+{
+	struct daxctl_dev *dev = job->dev;
+	struct dev_timing *t = &job->t;
+	const char *devname = daxctl_dev_get_devname(dev);
+	unsigned long long start;
 	int rc, skip_enable = 0;
 
-	if (param.no_online || !param.no_movable) {
+	if (job->no_online || !job->no_movable) {
 		if (!param.force && daxctl_dev_will_auto_online_memory(dev)) {
 			fprintf(stderr,
 				"%s: error: kernel policy will auto-online memory, aborting\n",
@@ -554,7 +931,9 @@ static int reconfig_mode_system_ram(struct daxctl_dev *dev)
 	}
 
 	if (daxctl_dev_is_enabled(dev)) {
+		start = now_ns();
 		rc = disable_devdax_device(dev);
+		t->disable_ns = now_ns() - start;
 		if (rc < 0)
 			return rc;
 		if (rc > 0)
@@ -562,15 +941,22 @@ static int reconfig_mode_system_ram(struct daxctl_dev *dev)
 	}
 
 	if (!skip_enable) {
+		start = now_ns();
+		pthread_mutex_lock(&dev_lock);
 		rc = daxctl_dev_enable_ram(dev);
+		pthread_mutex_unlock(&dev_lock);
+		t->bind_ns = now_ns() - start;
 		if (rc)
 			return rc;
 	}
 
-	if (param.no_online)
+	if (job->no_online)
 		return 0;
 
-	return dev_online_memory(dev);
+	rc = dev_online_memory(job);
+	if (rc >= 0 && param.demotion)
+		check_memory_tier(dev);
+	return rc;
 }
 
 static int disable_system_ram_device(struct daxctl_dev *dev)
@@ -605,7 +991,9 @@ static int disable_system_ram_device(struct daxctl_dev *dev)
 		}
 		return -EBUSY;
 	}
+	pthread_mutex_lock(&dev_lock);
 	rc = daxctl_dev_disable(dev);
+	pthread_mutex_unlock(&dev_lock);
 	if (rc) {
 		fprintf(stderr, "%s: disable failed: %s\n",
 			daxctl_dev_get_devname(dev), strerror(-rc));
@@ -614,130 +1002,391 @@ static int disable_system_ram_device(struct daxctl_dev *dev)
 	return 0;
 }
 
-static int reconfig_mode_devdax(struct daxctl_dev *dev)
+static int reconfig_mode_devdax(struct daxctl_dev *dev, struct dev_timing *t)
 {
+	unsigned long long start;
 	int rc;
 
 	if (daxctl_dev_is_enabled(dev)) {
+		start = now_ns();
 		rc = disable_system_ram_device(dev);
+		t->disable_ns = now_ns() - start;
 		if (rc)
 			return rc;
 	}
 
+	start = now_ns();
+	pthread_mutex_lock(&dev_lock);
 	rc = daxctl_dev_enable_devdax(dev);
+	pthread_mutex_unlock(&dev_lock);
+	t->bind_ns = now_ns() - start;
 	if (rc)
 		return rc;
 
 	return 0;
 }
 
-static int do_create(struct daxctl_region *region, long long val,
-		     struct json_object **jdevs)
+/* size an idle device, from its ranges when they are given */
+static int dev_set_layout(struct daxctl_dev *dev, long long dev_align,
+		struct mapping *m, long long nr, long long val)
+{
+	long long i, alloc = 0;
+	int rc;
+
+	if (dev_align > 0) {
+		rc = daxctl_dev_set_align(dev, dev_align);
+		if (rc < 0)
+			return rc;
+	}
+
+	/* @m is ordered by page_offset */
+	for (i = 0; i < nr; i++) {
+		rc = daxctl_dev_set_mapping(dev, m[i].start, m[i].end);
+		if (rc < 0)
+			return rc;
+		alloc += (m[i].end - m[i].start + 1);
+	}
+
+	if (nr > 0 && val > 0 && alloc != val) {
+		fprintf(stderr, "%s: allocated %lld but specified size %lld\n",
+			daxctl_dev_get_devname(dev), alloc, val);
+		return 0;
+	}
+
+	return daxctl_dev_set_size(dev, val);
+}
+
+/* what each of nr devices gets when they split the rest of the region */
+static long long create_share(struct daxctl_region *region, int nr)
+{
+	unsigned long long avail = daxctl_region_get_available_size(region);
+	unsigned long a = align > 0 ? align : daxctl_region_get_align(region);
+
+	if (nr == 1)
+		return avail;
+	avail /= nr;
+	if (a && a != ULONG_MAX)
+		avail = ALIGN_DOWN(avail, a);
+	return avail;
+}
+
+static int create_enable(struct daxctl_dev *dev)
 {
+	const char *devname = daxctl_dev_get_devname(dev);
+	int rc;
+
+	if (reconfig_mode != DAXCTL_DEV_MODE_RAM)
+		rc = daxctl_dev_enable_devdax(dev);
+	else if ((param.no_online || !param.no_movable) && !param.force
+			&& daxctl_dev_will_auto_online_memory(dev)) {
+		fprintf(stderr,
+			"%s: error: kernel policy will auto-online memory, aborting\n",
+			devname);
+		return -EBUSY;
+	} else
+		rc = daxctl_dev_enable_ram(dev);
+	if (rc)
+		fprintf(stderr, "%s: enable failed: %s\n", devname,
+			strerror(-rc));
+	return rc;
+}
+
+/*
+ * Report the devices a create-device run made. With --mode=system-ram
+ * they are bound to kmem already, their memory is onlined here through
+ * the job queue, so --jobs devices come up at once.
+ */
+static int create_finish(struct daxctl_dev **devs, int nr,
+		struct json_object **jdevs)
+{
+	struct dev_queue q = { .action = ACTION_CREATE, .nr = nr };
 	struct json_object *jdev;
-	struct daxctl_dev *dev;
 	int i, rc = 0;
-	long long alloc = 0;
 
-	if (daxctl_region_create_dev(region))
-		return -ENOSPC;
+	if (!nr)
+		return 0;
 
-	dev = daxctl_region_get_dev_seed(region);
-	if (!dev)
-		return -ENOSPC;
+	if (reconfig_mode == DAXCTL_DEV_MODE_RAM && !param.no_online) {
+		q.jobs = calloc(nr, sizeof(*q.jobs));
+		if (!q.jobs)
+			return -ENOMEM;
+		for (i = 0; i < nr; i++) {
+			q.jobs[i].dev = devs[i];
+			q.jobs[i].mode = reconfig_mode;
+			q.jobs[i].no_movable = param.no_movable;
+			q.jobs[i].normal_size = normal_size;
+			q.jobs[i].normal_pct = normal_pct;
+		}
+		dev_queue_run(&q);
+	}
+
+	if (!*jdevs)
+		*jdevs = json_object_new_array();
+	for (i = 0; i < nr; i++) {
+		if (q.jobs && q.jobs[i].rc < 0) {
+			rc = q.jobs[i].rc;
+			continue;
+		}
+		jdev = util_daxctl_dev_to_json(devs[i], flags);
+		if (*jdevs && jdev)
+			json_object_array_add(*jdevs, jdev);
+	}
+	free(q.jobs);
+	return rc;
+}
+
+/*
+ * Make --count devices of @val bytes each, or share out what the region
+ * has left. The seed the kernel keeps only moves on once a device is
+ * bound, so each is created, sized and enabled before the next.
+ */
+static int do_create(struct daxctl_region *region, long long val,
+		     struct json_object **jdevs, int *created)
+{
+	int i, nr = max(param.count, 1U), made = 0, rc = 0, frc;
+	struct daxctl_dev *dev, **devs;
 
 	if (val == -1)
-		val = daxctl_region_get_available_size(region);
+		val = create_share(region, nr);
 
 	if (val <= 0)
 		return -ENOSPC;
 
-	if (align > 0) {
-		rc = daxctl_dev_set_align(dev, align);
+	devs = calloc(nr, sizeof(*devs));
+	if (!devs)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		if (daxctl_region_create_dev(region)) {
+			rc = -ENOSPC;
+			break;
+		}
+
+		dev = daxctl_region_get_dev_seed(region);
+		if (!dev) {
+			rc = -ENOSPC;
+			break;
+		}
+
+		rc = dev_set_layout(dev, align, maps, nmaps, val);
 		if (rc < 0)
-			return rc;
+			break;
+
+		rc = create_enable(dev);
+		if (rc)
+			break;
+		devs[made++] = dev;
 	}
+	*created += made;
 
-	/* @maps is ordered by page_offset */
-	for (i = 0; i < nmaps; i++) {
-		rc = daxctl_dev_set_mapping(dev, maps[i].start, maps[i].end);
-		if (rc < 0)
-			return rc;
-		alloc += (maps[i].end - maps[i].start + 1);
+	frc = create_finish(devs, made, jdevs);
+	free(devs);
+	return rc ? rc : frc;
+}
+
+static int plan_range_cmp(const void *a, const void *b)
+{
+	const struct plan_range *r1 = a, *r2 = b;
+
+	if (r1->start != r2->start)
+		return r1->start < r2->start ? -1 : 1;
+	return 0;
+}
+
+/* the region's span less every range any device already holds */
+static int region_free_ranges(struct daxctl_region *region,
+		struct plan_range **availp, int *nrp)
+{
+	unsigned long long start = daxctl_region_get_resource(region);
+	unsigned long long rsize = daxctl_region_get_size(region);
+	struct plan_range *used = NULL, *avail, *r;
+	struct daxctl_mapping *mapping;
+	struct daxctl_dev *dev;
+	unsigned long long pos;
+	int i, nr_used = 0, nr = 0;
+
+	if (!start || !rsize || rsize == ULLONG_MAX) {
+		fprintf(stderr, "%s: unable to determine the region's range\n",
+			daxctl_region_get_devname(region));
+		return -ENXIO;
 	}
 
-	if (nmaps > 0 && val > 0 && alloc != val) {
-		fprintf(stderr, "%s: allocated %lld but specified size %lld\n",
-			daxctl_dev_get_devname(dev), alloc, val);
-	} else {
-		rc = daxctl_dev_set_size(dev, val);
-		if (rc < 0)
-			return rc;
+	daxctl_dev_foreach(region, dev)
+		daxctl_mapping_foreach(dev, mapping) {
+			r = realloc(used, (nr_used + 1) * sizeof(*r));
+			if (!r) {
+				free(used);
+				return -ENOMEM;
+			}
+			used = r;
+			used[nr_used].start = daxctl_mapping_get_start(mapping);
+			used[nr_used++].end = daxctl_mapping_get_end(mapping);
+		}
+	qsort(used, nr_used, sizeof(*used), plan_range_cmp);
+
+	/* each used range splits off at most one free range before it */
+	avail = calloc(nr_used + 1, sizeof(*avail));
+	if (!avail) {
+		free(used);
+		return -ENOMEM;
 	}
+	pos = start;
+	for (i = 0; i < nr_used; i++) {
+		if (used[i].start > pos)
+			avail[nr++] = (struct plan_range) { pos,
+				used[i].start - 1 };
+		pos = max(pos, used[i].end + 1);
+	}
+	if (pos < start + rsize)
+		avail[nr++] = (struct plan_range) { pos, start + rsize - 1 };
+	free(used);
 
-	rc = daxctl_dev_enable_devdax(dev);
-	if (rc) {
-		fprintf(stderr, "%s: enable failed: %s\n",
-			daxctl_dev_get_devname(dev), strerror(-rc));
+	*availp = avail;
+	*nrp = nr;
+	return 0;
+}
+
+static void fault_size_str(unsigned long long f, char *buf, size_t len)
+{
+	if (IS_ALIGNED(f, SZ_1G))
+		snprintf(buf, len, "%lluG", f / SZ_1G);
+	else if (IS_ALIGNED(f, SZ_1M))
+		snprintf(buf, len, "%lluM", f / SZ_1M);
+	else
+		snprintf(buf, len, "%lluK", f / SZ_1K);
+}
+
+/*
+ * create-device --plan: choose the ranges of all requested devices up
+ * front, see plan.c, and create them with those ranges and the largest
+ * alignment they allow.
+ */
+static int do_create_plan(struct daxctl_region *region,
+		struct json_object **jdevs, int *created)
+{
+	const char *region_name = daxctl_region_get_devname(region);
+	unsigned long region_align = daxctl_region_get_align(region);
+	int i, nr, nr_avail, rc;
+	int count = max(param.count, 1U), frc, made = 0;
+	struct daxctl_dev *dev, **made_devs;
+	struct plan_range *avail;
+	struct plan_dev *devs;
+	char fault[16];
+
+	rc = region_free_ranges(region, &avail, &nr_avail);
+	if (rc)
 		return rc;
+
+	/* --count repeats the size list, or splits the region */
+	nr = (nr_plan_sizes ? nr_plan_sizes : 1) * count;
+	devs = calloc(nr, sizeof(*devs));
+	made_devs = calloc(nr, sizeof(*made_devs));
+	if (!devs || !made_devs) {
+		free(made_devs);
+		free(devs);
+		free(avail);
+		return -ENOMEM;
+	}
+	for (i = 0; i < nr; i++) {
+		devs[i].size = nr_plan_sizes ? plan_sizes[i % nr_plan_sizes]
+			: (unsigned long long) create_share(region, count);
+		devs[i].align = align > 0 ? align : 0;
 	}
 
-	*jdevs = json_object_new_array();
-	if (*jdevs) {
-		jdev = util_daxctl_dev_to_json(dev, flags);
-		if (jdev)
-			json_object_array_add(*jdevs, jdev);
+	if (region_align == ULONG_MAX)
+		region_align = 0;
+	rc = plan_mappings(avail, nr_avail, region_align, devs, nr);
+	free(avail);
+	if (rc) {
+		fprintf(stderr, "%s: unable to place %d device%s: %s\n",
+			region_name, nr, nr == 1 ? "" : "s", strerror(-rc));
+		free(made_devs);
+		free(devs);
+		return rc;
 	}
 
-	return 0;
+	for (i = 0; i < nr; i++) {
+		if (daxctl_region_create_dev(region)) {
+			rc = -ENOSPC;
+			break;
+		}
+		dev = daxctl_region_get_dev_seed(region);
+		if (!dev) {
+			rc = -ENOSPC;
+			break;
+		}
+
+		rc = dev_set_layout(dev, devs[i].fault_size, devs[i].maps,
+				devs[i].nmaps, devs[i].size);
+		if (rc < 0)
+			break;
+
+		/* enabling finds the next seed */
+		rc = create_enable(dev);
+		if (rc)
+			break;
+
+		fault_size_str(devs[i].fault_size, fault, sizeof(fault));
+		fprintf(stderr, "%s: %d range%s, %s faults\n",
+			daxctl_dev_get_devname(dev), devs[i].nmaps,
+			devs[i].nmaps == 1 ? "" : "s", fault);
+		made_devs[made++] = dev;
+	}
+	*created += made;
+
+	frc = create_finish(made_devs, made, jdevs);
+	for (i = 0; i < nr; i++)
+		free(devs[i].maps);
+	free(made_devs);
+	free(devs);
+	return rc ? rc : frc;
 }
 
-static int do_reconfig(struct daxctl_dev *dev, enum dev_mode mode,
-		struct json_object **jdevs)
+static int do_reconfig(struct dev_job *job)
 {
+	struct daxctl_dev *dev = job->dev;
 	const char *devname = daxctl_dev_get_devname(dev);
-	struct json_object *jdev;
 	int rc = 0;
 
+	/* resizing moves capacity within the region, keep it serial */
 	if (align > 0) {
+		pthread_mutex_lock(&dev_lock);
 		rc = daxctl_dev_set_align(dev, align);
+		pthread_mutex_unlock(&dev_lock);
 		if (rc < 0)
 			return rc;
 	}
 
 	if (size >= 0) {
+		pthread_mutex_lock(&dev_lock);
 		rc = dev_resize(dev, size);
+		pthread_mutex_unlock(&dev_lock);
 		return rc;
 	}
 
-	switch (mode) {
+	switch (job->mode) {
 	case DAXCTL_DEV_MODE_RAM:
-		rc = reconfig_mode_system_ram(dev);
+		rc = reconfig_mode_system_ram(job);
 		break;
 	case DAXCTL_DEV_MODE_DEVDAX:
-		rc = reconfig_mode_devdax(dev);
+		rc = reconfig_mode_devdax(dev, &job->t);
 		break;
 	default:
 		fprintf(stderr, "%s: unknown mode requested: %d\n",
-			devname, mode);
+			devname, job->mode);
 		rc = -EINVAL;
 	}
 
 	if (rc < 0)
 		return rc;
 
-	*jdevs = json_object_new_array();
-	if (*jdevs) {
-		jdev = util_daxctl_dev_to_json(dev, flags);
-		if (jdev)
-			json_object_array_add(*jdevs, jdev);
-	}
-
+	job->report = true;
 	return 0;
 }
 
-static int do_xline(struct daxctl_dev *dev, enum device_action action)
+static int do_xline(struct dev_job *job, enum device_action action)
 {
+	struct daxctl_dev *dev = job->dev;
 	struct daxctl_memory *mem = daxctl_dev_get_memory(dev);
 	const char *devname = daxctl_dev_get_devname(dev);
 	int rc;
@@ -751,7 +1400,7 @@ static int do_xline(struct daxctl_dev *dev, enum device_action action)
 
 	switch (action) {
 	case ACTION_ONLINE:
-		rc = dev_online_memory(dev);
+		rc = dev_online_memory(job);
 		break;
 	case ACTION_OFFLINE:
 		rc = dev_offline_memory(dev);
@@ -760,6 +1409,144 @@ static int do_xline(struct daxctl_dev *dev, enum device_action action)
 		fprintf(stderr, "%s: invalid action: %d\n", devname, action);
 		rc = -EINVAL;
 	}
+
+	if (rc >= 0 && action == ACTION_ONLINE && param.timing)
+		job->report = true;
+	return rc;
+}
+
+/* leave devdax devices that are already up alone */
+static int do_apply(struct dev_job *job)
+{
+	struct daxctl_dev *dev = job->dev;
+
+	if (job->mode == DAXCTL_DEV_MODE_DEVDAX && !daxctl_dev_get_memory(dev)
+			&& daxctl_dev_is_enabled(dev)) {
+		job->report = true;
+		return 0;
+	}
+	return do_reconfig(job);
+}
+
+static struct json_object *dev_job_to_json(struct dev_job *job,
+		enum device_action action)
+{
+	struct daxctl_dev *dev = job->dev;
+	struct json_object *jdev;
+
+	if (action == ACTION_RECONFIG || action == ACTION_APPLY)
+		jdev = util_daxctl_dev_to_json(dev, flags);
+	else {
+		jdev = json_object_new_object();
+		if (jdev)
+			json_object_object_add(jdev, "chardev",
+					json_object_new_string(
+						daxctl_dev_get_devname(dev)));
+	}
+	if (jdev && param.timing)
+		json_object_object_add(jdev, "timing",
+				timing_to_json(dev, &job->t));
+	return jdev;
+}
+
+static void dev_worker(void *arg, int i)
+{
+	struct dev_queue *q = arg;
+	struct dev_job *job = &q->jobs[i];
+
+	job->t.start_ns = now_ns();
+	if (q->action == ACTION_RECONFIG)
+		job->rc = do_reconfig(job);
+	else if (q->action == ACTION_APPLY)
+		job->rc = do_apply(job);
+	else if (q->action == ACTION_CREATE)
+		job->rc = dev_online_memory(job);
+	else
+		job->rc = do_xline(job, q->action);
+	job->t.total_ns = now_ns() - job->t.start_ns;
+}
+
+/* online work runs near the memory it brings up */
+static int dev_node(void *arg, int i)
+{
+	struct dev_queue *q = arg;
+
+	return daxctl_dev_get_target_node(q->jobs[i].dev);
+}
+
+/*
+ * Devices are independent, and most of a reconfigure or online is spent
+ * in the kernel onlining memory blocks, so up to --jobs devices are
+ * handled at once. Output is reported in device order afterwards.
+ */
+static void dev_queue_run(struct dev_queue *q)
+{
+	struct util_pool pool = {
+		.arg = q,
+		.nr = q->nr,
+		.jobs = max(param.jobs, 1U),
+		.run = dev_worker,
+		.node = dev_node,
+	};
+
+	util_pool_run(&pool);
+}
+
+static int do_xaction_queue(const char *device, enum device_action action,
+		struct daxctl_ctx *ctx, int *processed)
+{
+	struct dev_queue q = { .action = action };
+	struct json_object *jdevs = NULL, *jdev;
+	struct daxctl_region *region;
+	struct dev_job *jobs;
+	struct daxctl_dev *dev;
+	int i, rc = -ENXIO;
+
+	*processed = 0;
+
+	daxctl_region_foreach(ctx, region) {
+		if (!util_daxctl_region_filter(region, param.region))
+			continue;
+
+		daxctl_dev_foreach(region, dev) {
+			if (!util_daxctl_dev_filter(dev, device))
+				continue;
+			jobs = realloc(q.jobs, (q.nr + 1) * sizeof(*jobs));
+			if (!jobs) {
+				free(q.jobs);
+				return -ENOMEM;
+			}
+			q.jobs = jobs;
+			memset(&q.jobs[q.nr], 0, sizeof(*jobs));
+			q.jobs[q.nr].mode = reconfig_mode;
+			q.jobs[q.nr].no_online = param.no_online;
+			q.jobs[q.nr].no_movable = param.no_movable;
+			q.jobs[q.nr].normal_size = normal_size;
+			q.jobs[q.nr].normal_pct = normal_pct;
+			q.jobs[q.nr++].dev = dev;
+		}
+	}
+
+	dev_queue_run(&q);
+
+	for (i = 0; i < q.nr; i++) {
+		/* as when handled one by one, the last device sets the result */
+		rc = q.jobs[i].rc;
+		if (rc == 0)
+			(*processed)++;
+		if (!q.jobs[i].report)
+			continue;
+		if (!jdevs)
+			jdevs = json_object_new_array();
+		jdev = dev_job_to_json(&q.jobs[i], action);
+		if (jdevs && jdev)
+			json_object_array_add(jdevs, jdev);
+	}
+	free(q.jobs);
+
+	if (jdevs)
+		util_display_json_array(stdout, jdevs, flags);
+
 	return rc;
 }
 
@@ -815,9 +1602,11 @@ static int do_xaction_region(enum device_action action,
 
 		switch (action) {
 		case ACTION_CREATE:
-			rc = do_create(region, size, &jdevs);
-			if (rc == 0)
-				(*processed)++;
+			if (param.plan) {
+				rc = do_create_plan(region, &jdevs, processed);
+				break;
+			}
+			rc = do_create(region, size, &jdevs, processed);
 			break;
 		default:
 			rc = -EINVAL;
@@ -825,6 +1614,7 @@ static int do_xaction_region(enum device_action action,
 		}
 	}
 	free(maps);
+	free(plan_sizes);
 
 	/*
 	 * jdevs is the containing json array for all devices we are reporting
@@ -845,6 +1635,15 @@ static int do_xaction_device(const char *device, enum device_action action,
 	struct daxctl_dev *dev;
 	int rc = -ENXIO;
 
+	switch (action) {
+	case ACTION_RECONFIG:
+	case ACTION_ONLINE:
+	case ACTION_OFFLINE:
+		return do_xaction_queue(device, action, ctx, processed);
+	default:
+		break;
+	}
+
 	*processed = 0;
 
 	daxctl_region_foreach(ctx, region) {
@@ -856,21 +1655,6 @@ static int do_xaction_device(const char *device, enum device_action action,
 				continue;
 
 			switch (action) {
-			case ACTION_RECONFIG:
-				rc = do_reconfig(dev, reconfig_mode, &jdevs);
-				if (rc == 0)
-					(*processed)++;
-				break;
-			case ACTION_ONLINE:
-				rc = do_xline(dev, action);
-				if (rc == 0)
-					(*processed)++;
-				break;
-			case ACTION_OFFLINE:
-				rc = do_xline(dev, action);
-				if (rc == 0)
-					(*processed)++;
-				break;
 			case ACTION_ENABLE:
 				rc = do_xble(dev, action);
 				if (rc == 0)
@@ -904,6 +1688,203 @@ static int do_xaction_device(const char *device, enum device_action action,
 	return rc;
 }
 
+/*
+ * save-config and apply-config: a device as "daxctl list -M" shows it,
+ * reduced to what it takes to recreate it, plus whether its memory is
+ * online. apply-config carves out the layout of every device first, one
+ * region at a time since space is allocated in creation order, then
+ * binds and onlines all of them at once on the device queue.
+ */
+struct config_dev {
+	const char *chardev;
+	int region_id;
+	long long size;
+	long long align;
+	struct mapping *maps;
+	long long nmaps;
+	enum dev_mode mode;
+	bool enabled;
+	bool movable;
+	bool online;
+};
+
+static struct json_object *config_dev_to_json(struct daxctl_dev *dev)
+{
+	struct daxctl_memory *mem = daxctl_dev_get_memory(dev);
+	struct json_object *jdev, *jmappings = NULL, *jmapping;
+	struct daxctl_mapping *mapping;
+	int movable, online;
+
+	jdev = json_object_new_object();
+	if (!jdev)
+		return NULL;
+
+	json_object_object_add(jdev, "chardev",
+			json_object_new_string(daxctl_dev_get_devname(dev)));
+	json_object_object_add(jdev, "size",
+			json_object_new_int64(daxctl_dev_get_size(dev)));
+	if (daxctl_dev_get_align(dev) > 0)
+		json_object_object_add(jdev, "align",
+				json_object_new_int64(daxctl_dev_get_align(dev)));
+	json_object_object_add(jdev, "mode",
+			json_object_new_string(mem ? "system-ram" : "devdax"));
+	if (!mem && !daxctl_dev_is_enabled(dev))
+		json_object_object_add(jdev, "enabled",
+				json_object_new_boolean(false));
+
+	if (mem) {
+		movable = daxctl_memory_is_movable(mem);
+		if (movable >= 0)
+			json_object_object_add(jdev, "movable",
+					json_object_new_boolean(movable));
+		online = daxctl_memory_is_online(mem);
+		if (online >= 0)
+			json_object_object_add(jdev, "online",
+					json_object_new_boolean(online > 0));
+	}
+
+	daxctl_mapping_foreach(dev, mapping) {
+		if (!jmappings) {
+			jmappings = json_object_new_array();
+			if (!jmappings)
+				break;
+			json_object_object_add(jdev, "mappings", jmappings);
+		}
+		jmapping = util_daxctl_mapping_to_json(mapping, 0);
+		if (jmapping)
+			json_object_array_add(jmappings, jmapping);
+	}
+
+	return jdev;
+}
+
+static int parse_config_dev(struct json_object *jdev, struct config_dev *c)
+{
+	struct json_object *jval, *jmappings;
+	const char *mode;
+	int id;
+
+	if (!json_object_object_get_ex(jdev, "chardev", &jval))
+		return -EINVAL;
+	c->chardev = json_object_get_string(jval);
+	if (sscanf(c->chardev, "dax%d.%d", &c->region_id, &id) != 2)
+		return -EINVAL;
+
+	if (!json_object_object_get_ex(jdev, "size", &jval))
+		return -EINVAL;
+	c->size = json_object_get_int64(jval);
+
+	c->align = -1;
+	if (json_object_object_get_ex(jdev, "align", &jval))
+		c->align = json_object_get_int64(jval);
+
+	c->mode = DAXCTL_DEV_MODE_DEVDAX;
+	if (json_object_object_get_ex(jdev, "mode", &jval)) {
+		mode = json_object_get_string(jval);
+		if (strcmp(mode, "system-ram") == 0)
+			c->mode = DAXCTL_DEV_MODE_RAM;
+		else if (strcmp(mode, "devdax") != 0)
+			return -EINVAL;
+	}
+
+	c->enabled = true;
+	if (json_object_object_get_ex(jdev, "enabled", &jval))
+		c->enabled = json_object_get_boolean(jval);
+	c->movable = true;
+	if (json_object_object_get_ex(jdev, "movable", &jval))
+		c->movable = json_object_get_boolean(jval);
+	c->online = true;
+	if (json_object_object_get_ex(jdev, "online", &jval))
+		c->online = json_object_get_boolean(jval);
+
+	if (json_object_object_get_ex(jdev, "mappings", &jmappings))
+		return parse_mappings(jmappings, &c->maps, &c->nmaps);
+	return 0;
+}
+
+/*
+ * A device that already has the saved size is taken as it is, an idle
+ * one is resized, and a missing one is created from the region seed.
+ * Devices of any other size are left for the administrator to destroy.
+ */
+static int config_dev_layout(struct daxctl_ctx *ctx, struct config_dev *c,
+		struct daxctl_dev **devp)
+{
+	struct daxctl_region *region;
+	struct daxctl_dev *dev = NULL;
+	unsigned long long cur = 0;
+	int rc;
+
+	daxctl_region_foreach(ctx, region)
+		if (daxctl_region_get_id(region) == c->region_id)
+			break;
+	if (!region) {
+		fprintf(stderr, "%s: region %d not found\n", c->chardev,
+			c->region_id);
+		return -ENXIO;
+	}
+
+	daxctl_dev_foreach(region, dev)
+		if (strcmp(daxctl_dev_get_devname(dev), c->chardev) == 0)
+			break;
+	if (dev)
+		cur = daxctl_dev_get_size(dev);
+
+	if (dev && cur == (unsigned long long) c->size) {
+		*devp = dev;
+		return 0;
+	}
+	if (cur) {
+		fprintf(stderr,
+			"%s: size %llu differs from the saved %lld, destroy it to recreate\n",
+			c->chardev, cur, c->size);
+		return -EBUSY;
+	}
+
+	if (!dev) {
+		if (daxctl_region_create_dev(region))
+			return -ENOSPC;
+		dev = daxctl_region_get_dev_seed(region);
+		if (!dev)
+			return -ENOSPC;
+		if (param.verbose)
+			fprintf(stderr, "%s: created as %s\n", c->chardev,
+				daxctl_dev_get_devname(dev));
+	}
+
+	rc = dev_set_layout(dev, c->align, c->maps, c->nmaps, c->size);
+	if (rc < 0) {
+		fprintf(stderr, "%s: failed to restore the layout: %s\n",
+			c->chardev, strerror(-rc));
+		return rc;
+	}
+
+	*devp = dev;
+	return 0;
+}
+
+static int apply_config_tunables(struct daxctl_ctx *ctx,
+		struct json_object *jconfig)
+{
+	struct json_object *jval;
+	int rc = 0;
+
+	if (json_object_object_get_ex(jconfig, "demotion", &jval)) {
+		rc = daxctl_set_demotion(ctx, json_object_get_boolean(jval));
+		if (rc)
+			fprintf(stderr, "failed to set demotion: %s\n",
+				strerror(-rc));
+	}
+
+	if (json_object_object_get_ex(jconfig, "numa_balancing", &jval)) {
+		rc = daxctl_set_numa_balancing(ctx, json_object_get_int(jval));
+		if (rc)
+			fprintf(stderr, "failed to set numa_balancing: %s\n",
+				strerror(-rc));
+	}
+	return rc;
+}
+
 int cmd_create_device(int argc, const char **argv, struct daxctl_ctx *ctx)
 {
 	char *usage = "daxctl create-device [<options>]";
@@ -950,6 +1931,8 @@ int cmd_reconfig_device(int argc, const char **argv, struct daxctl_ctx *ctx)
 	if (rc < 0)
 		fprintf(stderr, "error reconfiguring devices: %s\n",
 				strerror(-rc));
+	else if (processed)
+		rc = apply_tiering(ctx);
 
 	fprintf(stderr, "reconfigured %d device%s\n", processed,
 			processed == 1 ? "" : "s");
@@ -1023,3 +2006,206 @@ int cmd_offline_memory(int argc, const char **argv, struct daxctl_ctx *ctx)
 			processed == 1 ? "" : "s");
 	return rc;
 }
+
+int cmd_save_config(int argc, const char **argv, struct daxctl_ctx *ctx)
+{
+	const char * const u[] = {
+		"daxctl save-config [<device>] [<options>]",
+		NULL
+	};
+	struct json_object *jconfig, *jdevs, *jdev;
+	struct daxctl_region *region;
+	const char *device = NULL;
+	struct daxctl_dev *dev;
+	int i, nr = 0, rc = 0;
+	FILE *f_out = stdout;
+
+	argc = parse_options(argc, argv, save_options, u, 0);
+	for (i = 1; i < argc; i++)
+		fprintf(stderr, "unknown extra parameter \"%s\"\n", argv[i]);
+	if (argc > 1)
+		usage_with_options(u, save_options);
+	if (argc)
+		device = argv[0];
+	if (param.verbose)
+		daxctl_set_log_priority(ctx, LOG_DEBUG);
+
+	jconfig = json_object_new_object();
+	jdevs = json_object_new_array();
+	if (!jconfig || !jdevs) {
+		json_object_put(jconfig);
+		json_object_put(jdevs);
+		return -ENOMEM;
+	}
+	json_object_object_add(jconfig, "devices", jdevs);
+
+	daxctl_region_foreach(ctx, region) {
+		if (!util_daxctl_region_filter(region, param.region))
+			continue;
+
+		daxctl_dev_foreach(region, dev) {
+			if (!util_daxctl_dev_filter(dev, device))
+				continue;
+			/* idle seeds are recreated on demand */
+			if (!daxctl_dev_get_size(dev))
+				continue;
+			jdev = config_dev_to_json(dev);
+			if (!jdev) {
+				rc = -ENOMEM;
+				goto out;
+			}
+			json_object_array_add(jdevs, jdev);
+			nr++;
+		}
+	}
+
+	/* system wide, only part of a configuration of everything */
+	if (!device && !param.region) {
+		i = daxctl_get_demotion(ctx);
+		if (i >= 0)
+			json_object_object_add(jconfig, "demotion",
+					json_object_new_boolean(i));
+		i = daxctl_get_numa_balancing(ctx);
+		if (i >= 0)
+			json_object_object_add(jconfig, "numa_balancing",
+					json_object_new_int(i));
+	}
+
+	if (param.output) {
+		f_out = fopen(param.output, "w");
+		if (!f_out) {
+			rc = -errno;
+			fprintf(stderr, "failed to open %s: %s\n",
+				param.output, strerror(-rc));
+			goto out;
+		}
+	}
+	fprintf(f_out, "%s\n", json_object_to_json_string_ext(jconfig,
+				JSON_C_TO_STRING_PRETTY));
+	if (f_out != stdout && fclose(f_out)) {
+		rc = -errno;
+		fprintf(stderr, "failed to write %s: %s\n", param.output,
+			strerror(-rc));
+	}
+
+out:
+	json_object_put(jconfig);
+	if (rc == 0)
+		fprintf(stderr, "saved %d device%s\n", nr, nr == 1 ? "" : "s");
+	return rc;
+}
+
+int cmd_apply_config(int argc, const char **argv, struct daxctl_ctx *ctx)
+{
+	const char * const u[] = {
+		"daxctl apply-config <file> [<options>]",
+		NULL
+	};
+	struct json_object *jconfig, *jconfig_devs, *jdevs = NULL, *jdev;
+	struct config_dev *cdevs = NULL;
+	struct dev_queue q = { .action = ACTION_APPLY };
+	int i, nr, processed = 0, rc = 0, err;
+	struct daxctl_dev *dev;
+	struct dev_job *job;
+
+	/* at boot the point is to get everything online at once */
+	param.jobs = 0;
+	argc = parse_options(argc, argv, apply_options, u, 0);
+	if (argc != 1) {
+		for (i = 1; i < argc; i++)
+			fprintf(stderr, "unknown extra parameter \"%s\"\n",
+				argv[i]);
+		if (!argc)
+			fprintf(stderr, "specify a configuration file\n");
+		usage_with_options(u, apply_options);
+	}
+	if (param.verbose)
+		daxctl_set_log_priority(ctx, LOG_DEBUG);
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+	if (!param.jobs)
+		param.jobs = UINT_MAX;
+
+	jconfig = json_object_from_file(argv[0]);
+	if (!jconfig) {
+		fprintf(stderr, "failed to parse %s\n", argv[0]);
+		return -EINVAL;
+	}
+	if (!json_object_object_get_ex(jconfig, "devices", &jconfig_devs)
+			|| !json_object_is_type(jconfig_devs, json_type_array)) {
+		fprintf(stderr, "%s: no \"devices\" array\n", argv[0]);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	nr = json_object_array_length(jconfig_devs);
+	cdevs = calloc(nr, sizeof(*cdevs));
+	q.jobs = calloc(nr, sizeof(*q.jobs));
+	if (nr && (!cdevs || !q.jobs)) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		rc = parse_config_dev(json_object_array_get_idx(jconfig_devs, i),
+				&cdevs[i]);
+		if (rc) {
+			fprintf(stderr, "%s: device %d: invalid entry: %s\n",
+				argv[0], i, strerror(-rc));
+			goto out;
+		}
+	}
+
+	for (i = 0; i < nr; i++) {
+		err = config_dev_layout(ctx, &cdevs[i], &dev);
+		if (err) {
+			rc = err;
+			continue;
+		}
+		if (cdevs[i].mode == DAXCTL_DEV_MODE_DEVDAX
+				&& !cdevs[i].enabled) {
+			processed++;
+			continue;
+		}
+		job = &q.jobs[q.nr++];
+		job->dev = dev;
+		job->mode = cdevs[i].mode;
+		job->no_online = !cdevs[i].online;
+		job->no_movable = !cdevs[i].movable;
+	}
+
+	dev_queue_run(&q);
+
+	for (i = 0; i < q.nr; i++) {
+		if (q.jobs[i].rc < 0) {
+			rc = q.jobs[i].rc;
+			continue;
+		}
+		processed++;
+		if (!q.jobs[i].report)
+			continue;
+		if (!jdevs)
+			jdevs = json_object_new_array();
+		jdev = dev_job_to_json(&q.jobs[i], ACTION_APPLY);
+		if (jdevs && jdev)
+			json_object_array_add(jdevs, jdev);
+	}
+	if (jdevs)
+		util_display_json_array(stdout, jdevs, flags);
+
+	if (processed) {
+		err = apply_config_tunables(ctx, jconfig);
+		if (err && !rc)
+			rc = err;
+	}
+
+out:
+	for (i = 0; cdevs && i < nr; i++)
+		free(cdevs[i].maps);
+	free(cdevs);
+	free(q.jobs);
+	json_object_put(jconfig);
+	fprintf(stderr, "applied configuration to %d device%s\n", processed,
+			processed == 1 ? "" : "s");
+	return rc;
+}
@@ -33,6 +33,7 @@ enum memory_op {
 	MEM_SET_OFFLINE,
 	MEM_SET_ONLINE,
 	MEM_SET_ONLINE_NO_MOVABLE,
+	MEM_SET_ONLINE_SPLIT,
 	MEM_IS_ONLINE,
 	MEM_COUNT,
 	MEM_GET_ZONE,
@@ -61,18 +62,31 @@ static const char *state_strings[] = {
 	[MEM_ZONE_MOVABLE] = "online_movable",
 };
 
+/* attributes of struct daxctl_region that have been loaded on demand */
+enum daxctl_region_attr {
+	DAXCTL_REGION_ATTR_SIZE = 1 << 0,
+	DAXCTL_REGION_ATTR_ALIGN = 1 << 1,
+};
+
+/* attributes of struct daxctl_dev that have been loaded on demand */
+enum daxctl_dev_attr {
+	DAXCTL_DEV_ATTR_DEVT = 1 << 0,
+	DAXCTL_DEV_ATTR_RESOURCE = 1 << 1,
+	DAXCTL_DEV_ATTR_SIZE = 1 << 2,
+	DAXCTL_DEV_ATTR_ALIGN = 1 << 3,
+	DAXCTL_DEV_ATTR_TARGET_NODE = 1 << 4,
+};
+
 /**
  * struct daxctl_region - container for dax_devices
  */
-#define REGION_BUF_SIZE 50
 struct daxctl_region {
 	int id;
 	uuid_t uuid;
 	int refcount;
 	char *devname;
-	size_t buf_len;
-	void *region_buf;
 	int devices_init;
+	unsigned int attrs;
 	char *region_path;
 	unsigned long align;
 	unsigned long long size;
@@ -89,8 +103,7 @@ struct daxctl_mapping {
 
 struct daxctl_dev {
 	int id, major, minor;
-	void *dev_buf;
-	size_t buf_len;
+	unsigned int attrs;
 	char *dev_path;
 	struct list_node list;
 	unsigned long long resource;
@@ -104,14 +117,49 @@ struct daxctl_dev {
 	struct list_head mappings;
 };
 
+struct daxctl_memblock_time {
+	unsigned long block;
+	unsigned long long ns;
+};
+
+/* consecutive blocks in the same state */
+struct daxctl_memblock_run {
+	unsigned long first;
+	unsigned long nr;
+	enum daxctl_memblock_state state;
+};
+
+/*
+ * @times: blocks changed by the last online or offline, and how long
+ * each took, so tools can tell kernel hotplug time from their own
+ * @zone_ns: duration of the zone check that follows onlining
+ * @runs: state of every block, from one scan, dropped by any online or
+ * offline
+ */
 struct daxctl_memory {
 	struct daxctl_dev *dev;
-	void *mem_buf;
-	size_t buf_len;
 	char *node_path;
 	unsigned long block_size;
 	enum memory_zones zone;
 	bool auto_online;
+	struct daxctl_memblock_time *times;
+	int nr_times;
+	unsigned long long zone_ns;
+	struct daxctl_memblock_run *runs;
+	int nr_runs;
+	bool runs_valid;
+	/* MEM_SET_ONLINE_SPLIT: leading blocks to online to ZONE_NORMAL */
+	unsigned long long normal_blocks;
+};
+
+struct daxctl_map {
+	struct daxctl_dev *dev;
+	int fd;
+	void *addr;
+	size_t size;
+	unsigned long fault_size;
+	unsigned int flags;
+	int nr_threads;
 };
 
 
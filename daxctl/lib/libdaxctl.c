@@ -6,16 +6,24 @@
 #include <libgen.h>
 #include <stdlib.h>
 #include <dirent.h>
+#include <sched.h>
+#include <time.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/sysmacros.h>
 #include <uuid/uuid.h>
 #include <ccan/list/list.h>
+#include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
 
 #include <util/log.h>
+#include <util/size.h>
 #include <util/sysfs.h>
+#include <util/usdt.h>
 #include <util/iomem.h>
 #include <daxctl/libdaxctl.h>
 #include "libdaxctl-private.h"
@@ -40,6 +48,10 @@ struct daxctl_ctx {
 	int regions_init;
 	struct list_head regions;
 	struct kmod_ctx *kmod_ctx;
+	struct iomem_index iomem;
+	unsigned int memory_threads;
+	unsigned int max_threads;
+	char *sysfs_root;
 };
 
 /**
@@ -80,6 +92,7 @@ DAXCTL_EXPORT int daxctl_new(struct daxctl_ctx **ctx)
 {
 	struct kmod_ctx *kmod_ctx;
 	struct daxctl_ctx *c;
+	const char *env;
 	int rc = 0;
 
 	c = calloc(1, sizeof(struct daxctl_ctx));
@@ -94,6 +107,12 @@ DAXCTL_EXPORT int daxctl_new(struct daxctl_ctx **ctx)
 
 	c->refcount = 1;
 	log_init(&c->ctx, "libdaxctl", "DAXCTL_LOG");
+	env = secure_getenv("DAXCTL_MEMORY_THREADS");
+	if (env)
+		daxctl_set_memory_threads(c, strtoul(env, NULL, 0));
+	env = secure_getenv("DAXCTL_SYSFS_ROOT");
+	if (env)
+		daxctl_set_sysfs_root(c, env);
 	info(c, "ctx %p created\n", c);
 	dbg(c, "log_priority=%d\n", c->ctx.log_priority);
 	*ctx = c;
@@ -139,10 +158,93 @@ DAXCTL_EXPORT void daxctl_unref(struct daxctl_ctx *ctx)
 		free_region(region, &ctx->regions);
 
 	kmod_unref(ctx->kmod_ctx);
+	iomem_index_invalidate(&ctx->iomem);
 	info(ctx, "context %p released\n", ctx);
+	log_exit(&ctx->ctx);
+	free(ctx->sysfs_root);
 	free(ctx);
 }
 
+/**
+ * daxctl_set_memory_threads - online and offline memory blocks in parallel
+ * @ctx: daxctl library context
+ * @nr: number of threads, 0 or 1 to handle one block at a time
+ *
+ * daxctl_memory_online(), daxctl_memory_online_no_movable() and
+ * daxctl_memory_offline() spread a device's memory blocks over up to
+ * @nr threads, the calling one included, with the others bound to the
+ * cpus of the device's target node if it has any. The zone checks that
+ * follow onlining are unchanged. The DAXCTL_MEMORY_THREADS environment
+ * variable provides the default.
+ */
+DAXCTL_EXPORT void daxctl_set_memory_threads(struct daxctl_ctx *ctx,
+		unsigned int nr)
+{
+	ctx->memory_threads = nr;
+}
+
+/**
+ * daxctl_set_max_threads - bound the threads the library starts
+ * @ctx: daxctl library context
+ * @nr: most threads any one call runs at once, 0 for no bound
+ *
+ * Applies on top of daxctl_set_memory_threads(), and also bounds the
+ * threads that prefault a DAXCTL_MAP_PREFAULT mapping. The daxctl tool
+ * sets it from its top level '-j' option.
+ */
+DAXCTL_EXPORT void daxctl_set_max_threads(struct daxctl_ctx *ctx,
+		unsigned int nr)
+{
+	ctx->max_threads = nr;
+}
+
+/* clamp a thread count to the daxctl_set_max_threads() ceiling */
+static int daxctl_threads(struct daxctl_ctx *ctx, int nr)
+{
+	if (ctx->max_threads && nr > (int) ctx->max_threads)
+		return ctx->max_threads;
+	return nr;
+}
+
+/**
+ * daxctl_set_sysfs_root - enumerate from a copy of the sysfs tree
+ * @ctx: daxctl library context
+ * @path: directory standing in for /sys, or NULL for the default
+ *
+ * Regions are looked up under @path/class/dax and @path/bus/dax/devices,
+ * and device numbers come from each device's 'dev' attribute rather
+ * than its /dev node. Must be called before the first region lookup.
+ * The DAXCTL_SYSFS_ROOT environment variable provides the default.
+ */
+DAXCTL_EXPORT int daxctl_set_sysfs_root(struct daxctl_ctx *ctx,
+		const char *path)
+{
+	char *p = NULL;
+
+	if (ctx->regions_init)
+		return -EBUSY;
+	if (path && *path) {
+		p = strdup(path);
+		if (!p)
+			return -ENOMEM;
+	}
+	free(ctx->sysfs_root);
+	ctx->sysfs_root = p;
+	return 0;
+}
+
+/* dax_subsystems[] with /sys swapped for the configured root */
+static char *dax_subsys_path(struct daxctl_ctx *ctx,
+		enum dax_subsystem subsys)
+{
+	char *path;
+
+	if (asprintf(&path, "%s%s", ctx->sysfs_root ?: "/sys",
+				dax_subsystems[subsys] + strlen("/sys")) < 0)
+		return NULL;
+	return path;
+}
+
 /**
  * daxctl_set_log_fn - override default log routine
  * @ctx: daxctl library context
@@ -181,6 +283,35 @@ DAXCTL_EXPORT void daxctl_set_log_priority(struct daxctl_ctx *ctx, int priority)
 	ctx->ctx.log_priority = priority;
 }
 
+/**
+ * daxctl_set_log_ring - record messages, and format them only when dumped
+ * @ctx: daxctl library context
+ * @size: bytes of ring, e.g. 1 << 20, 0 to format every message again
+ *
+ * Every message down to LOG_DEBUG is kept as its format pointer,
+ * arguments and a timestamp, the most recent ones that fit in @size.
+ * The priority in effect before still decides what is printed as it
+ * happens, and an error first dumps the recorded history, see
+ * daxctl_log_dump(). The DAXCTL_LOG_RING environment variable, e.g. "1M",
+ * provides the default. Debug messages need the library built with
+ * "configure --enable-debug".
+ */
+DAXCTL_EXPORT int daxctl_set_log_ring(struct daxctl_ctx *ctx, unsigned long size)
+{
+	return log_ring_enable(&ctx->ctx, size);
+}
+
+/**
+ * daxctl_log_dump - format and emit the recorded messages, oldest first
+ * @ctx: daxctl library context
+ *
+ * Messages go through the log function, the ring is left empty.
+ */
+DAXCTL_EXPORT void daxctl_log_dump(struct daxctl_ctx *ctx)
+{
+	log_ring_dump(&ctx->ctx);
+}
+
 DAXCTL_EXPORT struct daxctl_ctx *daxctl_region_get_ctx(
 		struct daxctl_region *region)
 {
@@ -196,7 +327,8 @@ static void free_mem(struct daxctl_dev *dev)
 {
 	if (dev->mem) {
 		free(dev->mem->node_path);
-		free(dev->mem->mem_buf);
+		free(dev->mem->times);
+		free(dev->mem->runs);
 		free(dev->mem);
 		dev->mem = NULL;
 	}
@@ -207,7 +339,6 @@ static void free_dev(struct daxctl_dev *dev, struct list_head *head)
 	if (head)
 		list_del_from(head, &dev->list);
 	kmod_module_unref(dev->module);
-	free(dev->dev_buf);
 	free(dev->dev_path);
 	free_mem(dev);
 	free(dev);
@@ -222,7 +353,6 @@ static void free_region(struct daxctl_region *region, struct list_head *head)
 	if (head)
 		list_del_from(head, &region->list);
 	free(region->region_path);
-	free(region->region_buf);
 	free(region->devname);
 	free(region);
 }
@@ -253,8 +383,6 @@ static struct daxctl_region *add_dax_region(void *parent, int id,
 {
 	struct daxctl_region *region, *region_dup;
 	struct daxctl_ctx *ctx = parent;
-	char buf[SYSFS_ATTR_SIZE];
-	char *path;
 
 	dbg(ctx, "%s: \'%s\'\n", __func__, base);
 
@@ -262,17 +390,11 @@ static struct daxctl_region *add_dax_region(void *parent, int id,
 		if (strcmp(region_dup->region_path, base) == 0)
 			return region_dup;
 
-	path = calloc(1, strlen(base) + 100);
-	if (!path)
-		return NULL;
-
 	region = calloc(1, sizeof(*region));
 	if (!region)
-		goto err_region;
+		return NULL;
 
 	region->id = id;
-	region->align = -1;
-	region->size = -1;
 	region->ctx = ctx;
 	region->refcount = 1;
 	list_head_init(&region->devices);
@@ -280,36 +402,18 @@ static struct daxctl_region *add_dax_region(void *parent, int id,
 	if (!region->devname)
 		goto err_read;
 
-	sprintf(path, "%s/%s/size", base, attrs);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
-		region->size = strtoull(buf, NULL, 0);
-
-	sprintf(path, "%s/%s/align", base, attrs);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
-		region->align = strtoul(buf, NULL, 0);
-
 	region->region_path = strdup(base);
 	if (!region->region_path)
 		goto err_read;
 
-	region->region_buf = calloc(1, strlen(path) + strlen(attrs)
-			+ REGION_BUF_SIZE);
-	if (!region->region_buf)
-		goto err_read;
-	region->buf_len = strlen(path) + REGION_BUF_SIZE;
-
 	list_add(&ctx->regions, &region->list);
 
-	free(path);
 	return region;
 
  err_read:
-	free(region->region_buf);
 	free(region->region_path);
 	free(region->devname);
 	free(region);
- err_region:
-	free(path);
 	return NULL;
 }
 
@@ -332,8 +436,8 @@ static bool device_model_is_dax_bus(struct daxctl_dev *dev)
 {
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	char *path = dev->dev_buf, *resolved;
-	size_t len = dev->buf_len;
+	char path[PATH_MAX], *resolved;
+	size_t len = sizeof(path);
 	struct stat sb;
 
 	if (snprintf(path, len, "/dev/%s", devname) < 0)
@@ -439,99 +543,105 @@ static struct daxctl_memory *daxctl_dev_alloc_mem(struct daxctl_dev *dev)
 		}
 	}
 
-	mem->mem_buf = calloc(1, strlen(node_base) + 256);
-	if (!mem->mem_buf)
-		goto err_node;
-	mem->buf_len = strlen(node_base) + 256;
-
 	dev->mem = mem;
 	return mem;
 
-err_node:
-	free(mem->node_path);
 err_mem:
 	free(mem);
 	return NULL;
 }
 
-static void *add_dax_dev(void *parent, int id, const char *daxdev_base)
+/*
+ * Only the device path is recorded at enumeration time. Its attributes
+ * are read on first use and cached, like libcxl's memdevs, so that
+ * targeting one device, or looking up a region, does not pay for every
+ * device in the region. Failed reads are not cached and are retried by
+ * the next caller.
+ */
+static bool attr_test(unsigned int *loaded, unsigned int attr)
 {
-	const char *devname = devpath_to_devname(daxdev_base);
-	char *path = calloc(1, strlen(daxdev_base) + 100);
-	struct daxctl_region *region = parent;
-	struct daxctl_ctx *ctx = region->ctx;
-	struct daxctl_dev *dev, *dev_dup;
-	char buf[SYSFS_ATTR_SIZE];
-	struct stat st;
+	return __atomic_load_n(loaded, __ATOMIC_ACQUIRE) & attr;
+}
 
-	if (!path)
-		return NULL;
-	dbg(ctx, "%s: base: \'%s\'\n", __func__, daxdev_base);
+/* the value is stored before @attr is set, so readers never see it torn */
+static void attr_set(unsigned int *loaded, unsigned int attr)
+{
+	__atomic_fetch_or(loaded, attr, __ATOMIC_RELEASE);
+}
 
-	dev = calloc(1, sizeof(*dev));
-	if (!dev)
-		goto err_dev;
-	dev->id = id;
-	dev->region = region;
+static void attr_clear(unsigned int *loaded, unsigned int attr)
+{
+	__atomic_fetch_and(loaded, ~attr, __ATOMIC_RELEASE);
+}
 
-	sprintf(path, "/dev/%s", devname);
-	if (stat(path, &st) < 0)
-		goto err_read;
-	dev->major = major(st.st_rdev);
-	dev->minor = minor(st.st_rdev);
+static int dev_read_attr(struct daxctl_dev *dev, const char *attr,
+		char *buf)
+{
+	char path[PATH_MAX];
 
-	sprintf(path, "%s/resource", daxdev_base);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
-		dev->resource = strtoull(buf, NULL, 0);
-	else
-		dev->resource = iomem_get_dev_resource(ctx, daxdev_base);
+	if (snprintf(path, sizeof(path), "%s/%s", dev->dev_path, attr)
+			>= (int) sizeof(path))
+		return -ENAMETOOLONG;
+	return sysfs_read_attr(daxctl_dev_get_ctx(dev), path, buf);
+}
 
-	sprintf(path, "%s/size", daxdev_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
-		goto err_read;
-	dev->size = strtoull(buf, NULL, 0);
+static int dev_load_devt(struct daxctl_dev *dev)
+{
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	char buf[SYSFS_ATTR_SIZE];
+	char path[PATH_MAX];
+	struct stat st;
 
-	/* Device align attribute is only available in v5.10 or up */
-	sprintf(path, "%s/align", daxdev_base);
-	if (!sysfs_read_attr(ctx, path, buf))
-		dev->align = strtoull(buf, NULL, 0);
-	else
-		dev->align = 0;
+	if (attr_test(&dev->attrs, DAXCTL_DEV_ATTR_DEVT))
+		return 0;
 
-	dev->dev_path = strdup(daxdev_base);
-	if (!dev->dev_path)
-		goto err_read;
+	if (ctx->sysfs_root) {
+		/* a generated tree has no /dev nodes behind it */
+		if (dev_read_attr(dev, "dev", buf) < 0
+				|| sscanf(buf, "%d:%d", &dev->major,
+					&dev->minor) != 2)
+			return -ENXIO;
+	} else {
+		snprintf(path, sizeof(path), "/dev/%s",
+				daxctl_dev_get_devname(dev));
+		if (stat(path, &st) < 0)
+			return -errno;
+		dev->major = major(st.st_rdev);
+		dev->minor = minor(st.st_rdev);
+	}
+	attr_set(&dev->attrs, DAXCTL_DEV_ATTR_DEVT);
+	return 0;
+}
 
-	dev->dev_buf = calloc(1, strlen(daxdev_base) + 50);
-	if (!dev->dev_buf)
-		goto err_read;
-	dev->buf_len = strlen(daxdev_base) + 50;
+static void *add_dax_dev(void *parent, int id, const char *daxdev_base)
+{
+	struct daxctl_region *region = parent;
+	struct daxctl_ctx *ctx = region->ctx;
+	struct daxctl_dev *dev, *dev_dup;
 
-	sprintf(path, "%s/target_node", daxdev_base);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
-		dev->target_node = strtol(buf, NULL, 0);
-	else
-		dev->target_node = -1;
+	dbg(ctx, "%s: base: \'%s\'\n", __func__, daxdev_base);
 
 	daxctl_dev_foreach(region, dev_dup)
-		if (dev_dup->id == dev->id) {
-			free_dev(dev, NULL);
-			free(path);
+		if (dev_dup->id == id) {
+			/* a rescan picks up changes made behind our back */
+			__atomic_store_n(&dev_dup->attrs, 0, __ATOMIC_RELEASE);
 			return dev_dup;
 		}
+
+	dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		return NULL;
+	dev->id = id;
+	dev->region = region;
+	dev->dev_path = strdup(daxdev_base);
+	if (!dev->dev_path) {
+		free(dev);
+		return NULL;
+	}
 	dev->num_mappings = -1;
 	list_head_init(&dev->mappings);
 	list_add(&region->devices, &dev->list);
-	free(path);
 	return dev;
-
- err_read:
-	free(dev->dev_buf);
-	free(dev->dev_path);
-	free(dev);
- err_dev:
-	free(path);
-	return NULL;
 }
 
 DAXCTL_EXPORT int daxctl_region_get_id(struct daxctl_region *region)
@@ -539,13 +649,40 @@ DAXCTL_EXPORT int daxctl_region_get_id(struct daxctl_region *region)
 	return region->id;
 }
 
+static int region_read_attr(struct daxctl_region *region, const char *attr,
+		char *buf)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%s/%s", region->region_path,
+				attrs, attr) >= (int) sizeof(path))
+		return -ENAMETOOLONG;
+	return sysfs_read_attr(region->ctx, path, buf);
+}
+
 DAXCTL_EXPORT unsigned long daxctl_region_get_align(struct daxctl_region *region)
 {
+	char buf[SYSFS_ATTR_SIZE];
+
+	if (attr_test(&region->attrs, DAXCTL_REGION_ATTR_ALIGN))
+		return region->align;
+	if (region_read_attr(region, "align", buf) < 0)
+		return ULONG_MAX;
+	region->align = strtoul(buf, NULL, 0);
+	attr_set(&region->attrs, DAXCTL_REGION_ATTR_ALIGN);
 	return region->align;
 }
 
 DAXCTL_EXPORT unsigned long long daxctl_region_get_size(struct daxctl_region *region)
 {
+	char buf[SYSFS_ATTR_SIZE];
+
+	if (attr_test(&region->attrs, DAXCTL_REGION_ATTR_SIZE))
+		return region->size;
+	if (region_read_attr(region, "size", buf) < 0)
+		return ULLONG_MAX;
+	region->size = strtoull(buf, NULL, 0);
+	attr_set(&region->attrs, DAXCTL_REGION_ATTR_SIZE);
 	return region->size;
 }
 
@@ -559,13 +696,72 @@ DAXCTL_EXPORT const char *daxctl_region_get_path(struct daxctl_region *region)
 	return region->region_path;
 }
 
+/**
+ * daxctl_region_get_resource - physical start of a region
+ * @region: dax region
+ *
+ * Taken from the parent device's 'resource' attribute where it has one,
+ * like CXL regions, else from the range the parent claimed in
+ * /proc/iomem. Returns 0 when neither says, e.g. when addresses are
+ * hidden from an unprivileged caller.
+ */
+DAXCTL_EXPORT unsigned long long daxctl_region_get_resource(
+		struct daxctl_region *region)
+{
+	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
+	const struct iomem_res *res;
+	char path[PATH_MAX];
+	char buf[SYSFS_ATTR_SIZE], *end;
+	unsigned long long start;
+
+	if (snprintf(path, sizeof(path), "%s/resource",
+				region->region_path) < (int) sizeof(path)
+			&& sysfs_read_attr(ctx, path, buf) == 0) {
+		start = strtoull(buf, &end, 0);
+		if (buf[0] && *end == '\0')
+			return start;
+	}
+
+	res = iomem_find_name(&ctx->ctx, &ctx->iomem, region->devname);
+	if (!res)
+		return 0;
+	return res->start;
+}
+
+/**
+ * daxctl_region_get_persistence_domain - how far stores must get to persist
+ * @region: dax region
+ *
+ * A region carved from an nvdimm region inherits its parent's
+ * 'persistence_domain'. Any other parent, like hmem or a CXL ram
+ * region, is volatile.
+ */
+DAXCTL_EXPORT enum daxctl_persistence_domain
+daxctl_region_get_persistence_domain(struct daxctl_region *region)
+{
+	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
+	const char *base = region->region_path;
+	char path[PATH_MAX], buf[SYSFS_ATTR_SIZE];
+	int len = strrchr(base, '/') - base;
+
+	if (snprintf(path, sizeof(path), "%.*s/persistence_domain", len, base)
+			>= (int) sizeof(path)
+			|| sysfs_read_attr(ctx, path, buf) < 0)
+		return DAXCTL_PERSISTENCE_VOLATILE;
+	if (strncmp(buf, "cpu_cache", 9) == 0)
+		return DAXCTL_PERSISTENCE_CPU_CACHE;
+	if (strncmp(buf, "memory_controller", 17) == 0)
+		return DAXCTL_PERSISTENCE_MEM_CTRL;
+	return DAXCTL_PERSISTENCE_NONE;
+}
+
 DAXCTL_EXPORT unsigned long long daxctl_region_get_available_size(
 		struct daxctl_region *region)
 {
 	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
-	char *path = region->region_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE], *end;
-	int len = region->buf_len;
+	int len = sizeof(path);
 	unsigned long long avail;
 
 	if (snprintf(path, len, "%s/%s/available_size",
@@ -587,8 +783,8 @@ DAXCTL_EXPORT unsigned long long daxctl_region_get_available_size(
 DAXCTL_EXPORT int daxctl_region_create_dev(struct daxctl_region *region)
 {
 	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int rc, len = region->buf_len;
+	char path[PATH_MAX];
+	int rc, len = sizeof(path);
 	char *num_devices;
 
 	if (snprintf(path, len, "%s/%s/create", region->region_path, attrs) >= len) {
@@ -614,8 +810,8 @@ DAXCTL_EXPORT int daxctl_region_destroy_dev(struct daxctl_region *region,
 					    struct daxctl_dev *dev)
 {
 	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int rc, len = region->buf_len;
+	char path[PATH_MAX];
+	int rc, len = sizeof(path);
 
 	if (snprintf(path, len, "%s/%s/delete", region->region_path, attrs) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -627,12 +823,31 @@ DAXCTL_EXPORT int daxctl_region_destroy_dev(struct daxctl_region *region,
 	return rc;
 }
 
+static void dax_devices_init(struct daxctl_region *region);
+
+/* add one device by name, without rescanning the rest of the region */
+static struct daxctl_dev *dax_region_add_dev(struct daxctl_region *region,
+		const char *devname)
+{
+	struct daxctl_dev *dev;
+	char *path;
+	int id;
+
+	if (sscanf(devname, "dax%*d.%d", &id) != 1)
+		return NULL;
+	if (asprintf(&path, "%s/%s", region->region_path, devname) < 0)
+		return NULL;
+	dev = add_dax_dev(region, id, path);
+	free(path);
+	return dev;
+}
+
 DAXCTL_EXPORT struct daxctl_dev *daxctl_region_get_dev_seed(
 		struct daxctl_region *region)
 {
 	struct daxctl_ctx *ctx = daxctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int len = region->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 	struct daxctl_dev *dev;
 
@@ -648,7 +863,15 @@ DAXCTL_EXPORT struct daxctl_dev *daxctl_region_get_dev_seed(
 	daxctl_dev_foreach(region, dev)
 		if (strcmp(buf, daxctl_dev_get_devname(dev)) == 0)
 			return dev;
-	return NULL;
+
+	/*
+	 * A seed made by daxctl_region_create_dev() since the last scan.
+	 * Only it is added, so creating n devices reads n devices' worth of
+	 * sysfs rather than n^2.
+	 */
+	if (!buf[0])
+		return NULL;
+	return dax_region_add_dev(region, buf);
 }
 
 static void dax_devices_init(struct daxctl_region *region)
@@ -682,11 +905,12 @@ static void dax_devices_init(struct daxctl_region *region)
 	}
 }
 
-static char *dax_region_path(const char *device, enum dax_subsystem subsys)
+static char *dax_region_path(const char *base, const char *device,
+		enum dax_subsystem subsys)
 {
 	char *path, *region_path, *c;
 
-	if (asprintf(&path, "%s/%s", dax_subsystems[subsys], device) < 0)
+	if (asprintf(&path, "%s/%s", base, device) < 0)
 		return NULL;
 
 	/* dax_region must be the instance's direct parent */
@@ -724,11 +948,15 @@ static void __dax_regions_init(struct daxctl_ctx *ctx, enum dax_subsystem subsys
 {
 	struct dirent *de;
 	DIR *dir = NULL;
+	char *base;
 
-	dir = opendir(dax_subsystems[subsys]);
+	base = dax_subsys_path(ctx, subsys);
+	if (!base)
+		return;
+	dir = opendir(base);
 	if (!dir) {
-		dbg(ctx, "no dax regions found via: %s\n",
-				dax_subsystems[subsys]);
+		dbg(ctx, "no dax regions found via: %s\n", base);
+		free(base);
 		return;
 	}
 
@@ -741,7 +969,7 @@ static void __dax_regions_init(struct daxctl_ctx *ctx, enum dax_subsystem subsys
 			continue;
 		if (sscanf(de->d_name, "dax%d.%d", &region_id, &id) != 2)
 			continue;
-		dev_path = dax_region_path(de->d_name, subsys);
+		dev_path = dax_region_path(base, de->d_name, subsys);
 		if (!dev_path) {
 			err(ctx, "dax region path allocation failure\n");
 			continue;
@@ -752,6 +980,7 @@ static void __dax_regions_init(struct daxctl_ctx *ctx, enum dax_subsystem subsys
 			err(ctx, "add_dax_region() for %s failed\n", de->d_name);
 	}
 	closedir(dir);
+	free(base);
 }
 
 static void dax_regions_init(struct daxctl_ctx *ctx)
@@ -763,11 +992,13 @@ static void dax_regions_init(struct daxctl_ctx *ctx)
 
 	ctx->regions_init = 1;
 
+	usdt(libdaxctl, enumerate_start, ctx);
 	for (i = 0; i < ARRAY_SIZE(dax_subsystems); i++) {
 		if (i == DAX_UNKNOWN)
 			continue;
 		__dax_regions_init(ctx, i);
 	}
+	usdt(libdaxctl, enumerate_done, ctx);
 }
 
 static int is_enabled(const char *drvpath)
@@ -869,8 +1100,8 @@ static int daxctl_unbind(struct daxctl_ctx *ctx, const char *devpath)
 DAXCTL_EXPORT int daxctl_dev_is_enabled(struct daxctl_dev *dev)
 {
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	char *path = dev->dev_buf;
-	int len = dev->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (!device_model_is_dax_bus(dev))
 		return 1;
@@ -946,8 +1177,13 @@ static int daxctl_dev_enable(struct daxctl_dev *dev, enum daxctl_dev_mode mode)
 		return rc ? rc : -ENXIO;
 	}
 
-	region->devices_init = 0;
-	dax_devices_init(region);
+	/*
+	 * Binding uses up the region's seed, look up its successor rather
+	 * than rescanning every device. It may be placed after iomem was
+	 * indexed.
+	 */
+	iomem_index_invalidate(&ctx->iomem);
+	daxctl_region_get_dev_seed(region);
 	rc = 0;
 	dbg(ctx, "%s: enabled\n", devname);
 	return rc;
@@ -1045,21 +1281,44 @@ DAXCTL_EXPORT const char *daxctl_dev_get_devname(struct daxctl_dev *dev)
 
 DAXCTL_EXPORT int daxctl_dev_get_major(struct daxctl_dev *dev)
 {
-	return dev->major;
+	int rc = dev_load_devt(dev);
+
+	return rc < 0 ? rc : dev->major;
 }
 
 DAXCTL_EXPORT int daxctl_dev_get_minor(struct daxctl_dev *dev)
 {
-	return dev->minor;
+	int rc = dev_load_devt(dev);
+
+	return rc < 0 ? rc : dev->minor;
 }
 
 DAXCTL_EXPORT unsigned long long daxctl_dev_get_resource(struct daxctl_dev *dev)
 {
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	char buf[SYSFS_ATTR_SIZE];
+
+	if (attr_test(&dev->attrs, DAXCTL_DEV_ATTR_RESOURCE))
+		return dev->resource;
+	/* older kernels lack the attribute, fall back to /proc/iomem */
+	if (dev_read_attr(dev, "resource", buf) == 0)
+		dev->resource = strtoull(buf, NULL, 0);
+	else
+		dev->resource = iomem_get_dev_resource(ctx, dev->dev_path);
+	attr_set(&dev->attrs, DAXCTL_DEV_ATTR_RESOURCE);
 	return dev->resource;
 }
 
 DAXCTL_EXPORT unsigned long long daxctl_dev_get_size(struct daxctl_dev *dev)
 {
+	char buf[SYSFS_ATTR_SIZE];
+
+	if (attr_test(&dev->attrs, DAXCTL_DEV_ATTR_SIZE))
+		return dev->size;
+	if (dev_read_attr(dev, "size", buf) < 0)
+		return 0;
+	dev->size = strtoull(buf, NULL, 0);
+	attr_set(&dev->attrs, DAXCTL_DEV_ATTR_SIZE);
 	return dev->size;
 }
 
@@ -1067,8 +1326,8 @@ DAXCTL_EXPORT int daxctl_dev_set_size(struct daxctl_dev *dev, unsigned long long
 {
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
 	char buf[SYSFS_ATTR_SIZE];
-	char *path = dev->dev_buf;
-	int len = dev->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/size", dev->dev_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -1084,11 +1343,23 @@ DAXCTL_EXPORT int daxctl_dev_set_size(struct daxctl_dev *dev, unsigned long long
 	}
 
 	dev->size = size;
+	attr_set(&dev->attrs, DAXCTL_DEV_ATTR_SIZE);
+	/* resizing may move the device's start */
+	attr_clear(&dev->attrs, DAXCTL_DEV_ATTR_RESOURCE);
 	return 0;
 }
 
 DAXCTL_EXPORT unsigned long daxctl_dev_get_align(struct daxctl_dev *dev)
 {
+	char buf[SYSFS_ATTR_SIZE];
+
+	if (attr_test(&dev->attrs, DAXCTL_DEV_ATTR_ALIGN))
+		return dev->align;
+	/* Device align attribute is only available in v5.10 or up */
+	if (dev_read_attr(dev, "align", buf) < 0)
+		return 0;
+	dev->align = strtoull(buf, NULL, 0);
+	attr_set(&dev->attrs, DAXCTL_DEV_ATTR_ALIGN);
 	return dev->align;
 }
 
@@ -1096,8 +1367,8 @@ DAXCTL_EXPORT int daxctl_dev_set_align(struct daxctl_dev *dev, unsigned long ali
 {
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
 	char buf[SYSFS_ATTR_SIZE];
-	char *path = dev->dev_buf;
-	int len = dev->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/align", dev->dev_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -1113,6 +1384,7 @@ DAXCTL_EXPORT int daxctl_dev_set_align(struct daxctl_dev *dev, unsigned long ali
 	}
 
 	dev->align = align;
+	attr_set(&dev->attrs, DAXCTL_DEV_ATTR_ALIGN);
 	return 0;
 }
 
@@ -1121,10 +1393,9 @@ DAXCTL_EXPORT int daxctl_dev_set_mapping(struct daxctl_dev *dev,
 					unsigned long long end)
 {
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	unsigned long long size = end - start + 1;
 	char buf[SYSFS_ATTR_SIZE];
-	char *path = dev->dev_buf;
-	int len = dev->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/mapping", dev->dev_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -1138,13 +1409,21 @@ DAXCTL_EXPORT int daxctl_dev_set_mapping(struct daxctl_dev *dev,
 				daxctl_dev_get_devname(dev));
 		return -ENXIO;
 	}
-	dev->size += size;
+	attr_clear(&dev->attrs, DAXCTL_DEV_ATTR_SIZE | DAXCTL_DEV_ATTR_RESOURCE);
 
 	return 0;
 }
 
 DAXCTL_EXPORT int daxctl_dev_get_target_node(struct daxctl_dev *dev)
 {
+	char buf[SYSFS_ATTR_SIZE];
+
+	if (attr_test(&dev->attrs, DAXCTL_DEV_ATTR_TARGET_NODE))
+		return dev->target_node;
+	if (dev_read_attr(dev, "target_node", buf) < 0)
+		return -1;
+	dev->target_node = strtol(buf, NULL, 0);
+	attr_set(&dev->attrs, DAXCTL_DEV_ATTR_TARGET_NODE);
 	return dev->target_node;
 }
 
@@ -1175,13 +1454,16 @@ static void mappings_init(struct daxctl_dev *dev)
 {
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
 	char buf[SYSFS_ATTR_SIZE];
-	char *path = dev->dev_buf;
-	int i;
+	char attr[32];
+	int i, dirfd;
 
 	if (dev->num_mappings != -1)
 		return;
 
 	dev->num_mappings = 0;
+	dirfd = sysfs_open_dev(ctx, dev->dev_path);
+	if (dirfd < 0)
+		return;
 	for (;;) {
 		struct daxctl_mapping *mapping;
 		unsigned long long pgoff, start, end;
@@ -1194,22 +1476,22 @@ static void mappings_init(struct daxctl_dev *dev)
 			continue;
 		}
 
-		sprintf(path, "%s/mapping%d/start", dev->dev_path, i);
-		if (sysfs_read_attr(ctx, path, buf) < 0) {
+		sprintf(attr, "mapping%d/start", i);
+		if (sysfs_read_attr_at(ctx, dirfd, attr, buf) < 0) {
 			free(mapping);
 			break;
 		}
 		start = strtoull(buf, NULL, 0);
 
-		sprintf(path, "%s/mapping%d/end", dev->dev_path, i);
-		if (sysfs_read_attr(ctx, path, buf) < 0) {
+		sprintf(attr, "mapping%d/end", i);
+		if (sysfs_read_attr_at(ctx, dirfd, attr, buf) < 0) {
 			free(mapping);
 			break;
 		}
 		end = strtoull(buf, NULL, 0);
 
-		sprintf(path, "%s/mapping%d/page_offset", dev->dev_path, i);
-		if (sysfs_read_attr(ctx, path, buf) < 0) {
+		sprintf(attr, "mapping%d/page_offset", i);
+		if (sysfs_read_attr_at(ctx, dirfd, attr, buf) < 0) {
 			free(mapping);
 			break;
 		}
@@ -1223,6 +1505,7 @@ static void mappings_init(struct daxctl_dev *dev)
 		dev->num_mappings++;
 		list_add(&dev->mappings, &mapping->list);
 	}
+	close(dirfd);
 }
 
 DAXCTL_EXPORT struct daxctl_mapping *daxctl_mapping_get_first(struct daxctl_dev *dev)
@@ -1264,9 +1547,9 @@ static int memblock_is_online(struct daxctl_memory *mem, char *memblock)
 	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	int len = mem->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char buf[SYSFS_ATTR_SIZE];
-	char *path = mem->mem_buf;
 	const char *node_path;
 
 	node_path = daxctl_memory_get_node_path(mem);
@@ -1296,8 +1579,8 @@ static int online_one_memblock(struct daxctl_memory *mem, char *memblock,
 {
 	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	int len = mem->buf_len, rc;
-	char *path = mem->mem_buf;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	const char *node_path;
 
 	node_path = daxctl_memory_get_node_path(mem);
@@ -1312,6 +1595,7 @@ static int online_one_memblock(struct daxctl_memory *mem, char *memblock,
 	if (rc)
 		return rc;
 
+	usdt(libdaxctl, memblock_online_start, memblock, zone);
 	switch (zone) {
 	case MEM_ZONE_MOVABLE:
 	case MEM_ZONE_NORMAL:
@@ -1320,6 +1604,7 @@ static int online_one_memblock(struct daxctl_memory *mem, char *memblock,
 	default:
 		rc = -EINVAL;
 	}
+	usdt(libdaxctl, memblock_online_done, memblock, zone, rc);
 	if (rc) {
 		/*
 		 * If the block got onlined, potentially by some other agent,
@@ -1339,8 +1624,8 @@ static int offline_one_memblock(struct daxctl_memory *mem, char *memblock)
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
 	const char *mode = "offline";
-	int len = mem->buf_len, rc;
-	char *path = mem->mem_buf;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	const char *node_path;
 
 	node_path = daxctl_memory_get_node_path(mem);
@@ -1358,7 +1643,9 @@ static int offline_one_memblock(struct daxctl_memory *mem, char *memblock)
 	if (!rc)
 		return 1;
 
+	usdt(libdaxctl, memblock_offline_start, memblock);
 	rc = sysfs_write_attr_quiet(ctx, path, mode);
+	usdt(libdaxctl, memblock_offline_done, memblock, rc);
 	if (rc) {
 		/* check if something raced us to offline (unlikely) */
 		if (!memblock_is_online(mem, memblock))
@@ -1376,9 +1663,9 @@ static int memblock_find_zone(struct daxctl_memory *mem, char *memblock,
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
 	enum memory_zones cur_zone;
-	int len = mem->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char buf[SYSFS_ATTR_SIZE];
-	char *path = mem->mem_buf;
 	const char *node_path;
 
 	rc = memblock_is_online(mem, memblock);
@@ -1428,11 +1715,11 @@ static int memblock_in_dev(struct daxctl_memory *mem, const char *memblock)
 	unsigned long long memblock_res, dev_start, dev_end;
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	int rc, path_len = mem->buf_len;
+	char path[PATH_MAX];
+	int rc, path_len = sizeof(path);
 	unsigned long memblock_size;
 	char buf[SYSFS_ATTR_SIZE];
 	unsigned long phys_index;
-	char *path = mem->mem_buf;
 
 	if (snprintf(path, path_len, "%s/%s/phys_index",
 			mem_base, memblock) < 0)
@@ -1504,76 +1791,380 @@ static int op_for_one_memblock(struct daxctl_memory *mem, char *memblock,
 		return 0;
 	case MEM_GET_ZONE:
 		return memblock_find_zone(mem, memblock, status);
+	case MEM_SET_ONLINE_SPLIT:
+		/* split into the two zones by memory_op_range() */
+		break;
 	}
 
 	err(ctx, "%s: BUG: unknown op: %d\n", devname, op);
 	return -EINVAL;
 }
 
-static int daxctl_memory_op(struct daxctl_memory *mem, enum memory_op op)
+/*
+ * Walk the kernel's cpulist / nodelist format, e.g. "0-3,8,10-11",
+ * calling @fn on each range until it returns non-zero
+ */
+static int parse_id_list(const char *buf,
+		int (*fn)(unsigned long first, unsigned long last, void *arg),
+		void *arg)
 {
-	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
-	const char *devname = daxctl_dev_get_devname(dev);
-	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
-	int rc, count = 0, status_flags = 0;
-	const char *node_path;
-	struct dirent *de;
-	DIR *node_dir;
+	unsigned long first, last;
+	const char *p;
+	char *end;
+	int rc;
 
-	node_path = daxctl_memory_get_node_path(mem);
-	if (!node_path) {
-		err(ctx, "%s: Failed to get node_path\n", devname);
-		return -ENXIO;
+	for (p = buf; *p && *p != '\n'; p = end) {
+		first = strtoul(p, &end, 10);
+		if (end == p)
+			return -EINVAL;
+		last = first;
+		if (*end == '-')
+			last = strtoul(end + 1, &end, 10);
+		rc = fn(first, last, arg);
+		if (rc)
+			return rc;
+		if (*end == ',')
+			end++;
 	}
+	return 0;
+}
 
-	node_dir = opendir(node_path);
-	if (!node_dir)
-		return -errno;
+static int cpu_range_set(unsigned long cpu, unsigned long last, void *cpus)
+{
+	for (; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+		CPU_SET(cpu, (cpu_set_t *) cpus);
+	return 0;
+}
 
-	errno = 0;
-	while ((de = readdir(node_dir)) != NULL) {
-		if (strncmp(de->d_name, "memory", 6) == 0) {
-			rc = memblock_in_dev(mem, de->d_name);
-			if (rc < 0)
-				goto out_dir;
-			if (rc == 0) /* memblock not in dev */
-				continue;
-			/* memblock is in dev, perform op */
-			rc = op_for_one_memblock(mem, de->d_name, op,
-					&status_flags);
-			if (rc < 0)
-				goto out_dir;
-			if (rc == 0)
-				count++;
-		}
-		errno = 0;
-	}
+static int node_cpus(struct daxctl_ctx *ctx, const char *node_path,
+		cpu_set_t *cpus)
+{
+	char path[PATH_MAX], buf[SYSFS_ATTR_SIZE];
 
-	if (status_flags & MEM_ST_ZONE_INCONSISTENT)
-		mem->zone = MEM_ZONE_UNKNOWN;
+	CPU_ZERO(cpus);
+	if (snprintf(path, sizeof(path), "%s/cpulist", node_path)
+			>= (int) sizeof(path))
+		return -ENOMEM;
+	if (sysfs_read_attr(ctx, path, buf) < 0)
+		return -ENXIO;
+	if (parse_id_list(buf, cpu_range_set, cpus) < 0)
+		return -EINVAL;
+	return CPU_COUNT(cpus) ? 0 : -ENXIO;
+}
 
-	if (errno) {
-		rc = -errno;
-		goto out_dir;
-	}
-	rc = count;
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
 
-out_dir:
-	closedir(node_dir);
-	return rc;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
-/*
- * daxctl_memory_online() will online to ZONE_MOVABLE by default
- */
-static int daxctl_memory_online_with_zone(struct daxctl_memory *mem,
-		enum memory_zones zone)
-{
-	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
+struct memblock_pool {
+	struct daxctl_memory *mem;
+	enum memory_op op;
+	unsigned long long *idx;
+	/* per @idx entry, 0 unless the block was changed */
+	unsigned long long *ns;
+	int nr;
+	int next;
+	int count;
+	int status;
+	int rc;
+};
+
+static void *memblock_worker(void *arg)
+{
+	struct memblock_pool *pool = arg;
+	unsigned long long start = 0;
+	char memblock[32];
+	int i, rc, status;
+
+	while (!__atomic_load_n(&pool->rc, __ATOMIC_RELAXED)
+			&& (i = __atomic_fetch_add(&pool->next, 1,
+					__ATOMIC_RELAXED)) < pool->nr) {
+		status = 0;
+		sprintf(memblock, "memory%llu", pool->idx[i]);
+		if (pool->ns)
+			start = now_ns();
+		rc = op_for_one_memblock(pool->mem, memblock, pool->op,
+				&status);
+		__atomic_fetch_or(&pool->status, status, __ATOMIC_RELAXED);
+		if (rc == 0 && pool->ns)
+			pool->ns[i] = max(now_ns() - start, 1ULL);
+		if (rc == 0)
+			__atomic_fetch_add(&pool->count, 1, __ATOMIC_RELAXED);
+		else if (rc < 0) {
+			/* first failure wins, the others stop claiming */
+			status = 0;
+			__atomic_compare_exchange_n(&pool->rc, &status, rc,
+					false, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Online and offline writes have each block go through the kernel's
+ * hotplug path, memmap initialization included, so they are spread
+ * over daxctl_set_memory_threads() workers. The workers run on the
+ * target node's cpus when it has any, which keeps memmap
+ * initialization node local. Zone resolution and the read-only ops
+ * stay on the caller's thread.
+ */
+static int memblock_pool_run(struct memblock_pool *pool)
+{
+	struct daxctl_dev *dev = daxctl_memory_get_dev(pool->mem);
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	int i, nr_threads = daxctl_threads(ctx,
+			min_t(int, ctx->memory_threads, pool->nr));
+	pthread_t *threads = NULL;
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+
+	if (nr_threads > 1)
+		threads = calloc(nr_threads, sizeof(*threads));
+	pthread_attr_init(&attr);
+	if (threads && node_cpus(ctx,
+				daxctl_memory_get_node_path(pool->mem),
+				&cpus) == 0)
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	else if (threads)
+		dbg(ctx, "%s: target node has no cpus, workers unbound\n",
+				devname);
+	/* the calling thread is the last of the @nr_threads */
+	for (i = 0; threads && i < nr_threads - 1; i++)
+		if (pthread_create(&threads[i], &attr, memblock_worker, pool))
+			break;
+	pthread_attr_destroy(&attr);
+	/* whatever could not be handed to a thread runs here */
+	memblock_worker(pool);
+	while (threads && i--)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	return pool->rc ? pool->rc : pool->count;
+}
+
+/*
+ * ZONE_MOVABLE has to sit above the kernel zones, so the leading
+ * @normal blocks are onlined to ZONE_NORMAL, and only once they all
+ * are, the rest to ZONE_MOVABLE. Each half still goes to the pool.
+ */
+static int memblock_split_run(struct memblock_pool *pool,
+		unsigned long long normal)
+{
+	struct memblock_pool movable;
+	int nr = pool->nr, rc;
+
+	pool->op = MEM_SET_ONLINE_NO_MOVABLE;
+	pool->nr = min_t(unsigned long long, normal, nr);
+	rc = memblock_pool_run(pool);
+	if (rc < 0 || pool->nr == nr) {
+		pool->nr = nr;
+		return rc;
+	}
+
+	movable = (struct memblock_pool) {
+		.mem = pool->mem,
+		.op = MEM_SET_ONLINE,
+		.idx = pool->idx + pool->nr,
+		.ns = pool->ns ? pool->ns + pool->nr : NULL,
+		.nr = nr - pool->nr,
+	};
+	rc = memblock_pool_run(&movable);
+	pool->nr = nr;
+	pool->status |= movable.status;
+	pool->count += movable.count;
+	pool->rc = movable.rc;
+	return rc < 0 ? rc : pool->count;
+}
+
+/* timing is best effort, a failed allocation only leaves it empty */
+static void memblock_times_save(struct daxctl_memory *mem,
+		struct memblock_pool *pool)
+{
+	int i;
+
+	mem->nr_times = 0;
+	if (!pool->ns)
+		return;
+	free(mem->times);
+	mem->times = calloc(pool->nr ? pool->nr : 1, sizeof(*mem->times));
+	if (!mem->times)
+		return;
+	for (i = 0; i < pool->nr; i++) {
+		if (!pool->ns[i])
+			continue;
+		mem->times[mem->nr_times].block = pool->idx[i];
+		mem->times[mem->nr_times++].ns = pool->ns[i];
+	}
+}
+
+/*
+ * The device's memory blocks are consecutive, so their indices follow
+ * from the resource and the block size, and only those entries of the
+ * node directory need to be looked at. Indices with no entry are holes
+ * or blocks that sit on another node. Returns -ENOTTY when the range
+ * cannot be computed, and the caller walks the node directory instead.
+ */
+static int memory_block_range(struct daxctl_memory *mem,
+		unsigned long long *first, unsigned long long *last)
+{
+	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
+	unsigned long long start = daxctl_dev_get_resource(dev);
+	unsigned long long size = daxctl_dev_get_size(dev);
+	unsigned long block_size = daxctl_memory_get_block_size(mem);
+
+	if (!start || !size || !block_size)
+		return -ENOTTY;
+
+	*first = (start + block_size - 1) / block_size;
+	*last = (start + size - 1) / block_size;
+	return 0;
+}
+
+static int memory_op_range(struct daxctl_memory *mem, enum memory_op op,
+		int *status)
+{
+	const char *node_path = daxctl_memory_get_node_path(mem);
+	struct memblock_pool pool = { .mem = mem, .op = op };
+	unsigned long long idx, first, last;
+	char path[PATH_MAX];
 	int rc;
 
+	rc = memory_block_range(mem, &first, &last);
+	if (rc)
+		return rc;
+	if (last < first)
+		return 0;
+	pool.idx = calloc(last - first + 1, sizeof(*pool.idx));
+	if (!pool.idx)
+		return -ENOMEM;
+
+	for (idx = first; idx <= last; idx++) {
+		if (snprintf(path, sizeof(path), "%s/memory%llu", node_path,
+					idx) >= (int) sizeof(path)) {
+			free(pool.idx);
+			return -ENOMEM;
+		}
+		if (access(path, F_OK) == 0)
+			pool.idx[pool.nr++] = idx;
+	}
+
+	switch (op) {
+	case MEM_SET_ONLINE:
+	case MEM_SET_ONLINE_NO_MOVABLE:
+	case MEM_SET_OFFLINE:
+		pool.ns = calloc(pool.nr ? pool.nr : 1, sizeof(*pool.ns));
+		rc = memblock_pool_run(&pool);
+		memblock_times_save(mem, &pool);
+		break;
+	case MEM_SET_ONLINE_SPLIT:
+		pool.ns = calloc(pool.nr ? pool.nr : 1, sizeof(*pool.ns));
+		rc = memblock_split_run(&pool, mem->normal_blocks);
+		memblock_times_save(mem, &pool);
+		break;
+	default:
+		memblock_worker(&pool);
+		rc = pool.rc ? pool.rc : pool.count;
+		break;
+	}
+	*status |= pool.status;
+	free(pool.idx);
+	free(pool.ns);
+	return rc;
+}
+
+static int memory_op_node_walk(struct daxctl_memory *mem, enum memory_op op,
+		int *status)
+{
+	const char *node_path = daxctl_memory_get_node_path(mem);
+	int rc, count = 0;
+	struct dirent *de;
+	DIR *node_dir;
+
+	node_dir = opendir(node_path);
+	if (!node_dir)
+		return -errno;
+
+	errno = 0;
+	while ((de = readdir(node_dir)) != NULL) {
+		if (strncmp(de->d_name, "memory", 6) == 0) {
+			rc = memblock_in_dev(mem, de->d_name);
+			if (rc < 0)
+				goto out_dir;
+			if (rc == 0) /* memblock not in dev */
+				continue;
+			/* memblock is in dev, perform op */
+			rc = op_for_one_memblock(mem, de->d_name, op, status);
+			if (rc < 0)
+				goto out_dir;
+			if (rc == 0)
+				count++;
+		}
+		errno = 0;
+	}
+
+	if (errno) {
+		rc = -errno;
+		goto out_dir;
+	}
+	rc = count;
+
+out_dir:
+	closedir(node_dir);
+	return rc;
+}
+
+static int daxctl_memory_op(struct daxctl_memory *mem, enum memory_op op)
+{
+	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	int rc, status_flags = 0;
+
+	if (!daxctl_memory_get_node_path(mem)) {
+		err(ctx, "%s: Failed to get node_path\n", devname);
+		return -ENXIO;
+	}
+
+	if (op == MEM_SET_ONLINE || op == MEM_SET_ONLINE_NO_MOVABLE
+			|| op == MEM_SET_ONLINE_SPLIT || op == MEM_SET_OFFLINE) {
+		mem->nr_times = 0;
+		mem->runs_valid = false;
+	}
+	rc = memory_op_range(mem, op, &status_flags);
+	/* a split needs the blocks in address order */
+	if (rc == -ENOTTY && op == MEM_SET_ONLINE_SPLIT)
+		err(ctx, "%s: unable to determine the memory block range\n",
+				devname);
+	else if (rc == -ENOTTY) {
+		dbg(ctx, "%s: walking the node for memory blocks\n", devname);
+		rc = memory_op_node_walk(mem, op, &status_flags);
+	}
+
+	if (rc >= 0 && (status_flags & MEM_ST_ZONE_INCONSISTENT))
+		mem->zone = MEM_ZONE_UNKNOWN;
+
+	return rc;
+}
+
+/*
+ * daxctl_memory_online() will online to ZONE_MOVABLE by default
+ */
+static int daxctl_memory_online_with_zone(struct daxctl_memory *mem,
+		enum memory_zones zone)
+{
+	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	unsigned long long start;
+	int rc;
+
+	mem->zone_ns = 0;
 	switch (zone) {
 	case MEM_ZONE_MOVABLE:
 		rc = daxctl_memory_op(mem, MEM_SET_ONLINE);
@@ -1594,7 +2185,9 @@ static int daxctl_memory_online_with_zone(struct daxctl_memory *mem,
 	 * any of the blocks are not in ZONE_MOVABLE, emit a warning.
 	 */
 	mem->zone = 0;
+	start = now_ns();
 	rc = daxctl_memory_op(mem, MEM_GET_ZONE);
+	mem->zone_ns = now_ns() - start;
 	if (rc)
 		return rc;
 	if (mem->zone != zone) {
@@ -1608,6 +2201,164 @@ static int daxctl_memory_online_with_zone(struct daxctl_memory *mem,
 	return rc;
 }
 
+/**
+ * daxctl_memory_get_num_block_times - blocks timed by the last online/offline
+ * @mem: memory object of a system-ram device
+ *
+ * Each memory block that daxctl_memory_online(),
+ * daxctl_memory_online_no_movable() or daxctl_memory_offline() changed
+ * has its state write timed. Blocks that were already in the requested
+ * state are not counted.
+ */
+DAXCTL_EXPORT int daxctl_memory_get_num_block_times(struct daxctl_memory *mem)
+{
+	return mem->nr_times;
+}
+
+/**
+ * daxctl_memory_get_block_time - retrieve one block's state change time
+ * @mem: memory object of a system-ram device
+ * @i: 0 .. daxctl_memory_get_num_block_times() - 1
+ * @block: memory block index, as in /sys/devices/system/memory/memoryN
+ * @ns: duration of the state write in nanoseconds
+ */
+DAXCTL_EXPORT int daxctl_memory_get_block_time(struct daxctl_memory *mem,
+		int i, unsigned long *block, unsigned long long *ns)
+{
+	if (i < 0 || i >= mem->nr_times)
+		return -ENXIO;
+	*block = mem->times[i].block;
+	*ns = mem->times[i].ns;
+	return 0;
+}
+
+/**
+ * daxctl_memory_get_zone_time - duration of the last post-online zone check
+ * @mem: memory object of a system-ram device
+ *
+ * Returns nanoseconds, 0 if no online has run.
+ */
+DAXCTL_EXPORT unsigned long long daxctl_memory_get_zone_time(
+		struct daxctl_memory *mem)
+{
+	return mem->zone_ns;
+}
+
+static int memblock_state(struct daxctl_memory *mem, const char *node_path,
+		unsigned long long idx)
+{
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(daxctl_memory_get_dev(mem));
+	char path[PATH_MAX], buf[SYSFS_ATTR_SIZE];
+	int rc;
+
+	if (snprintf(path, sizeof(path), "%s/memory%llu/state", node_path,
+				idx) >= (int) sizeof(path))
+		return -ENOMEM;
+	/* a missing block is a hole, or on another node */
+	rc = sysfs_read_attr(ctx, path, buf);
+	if (rc)
+		return rc;
+	if (strncmp(buf, "online", 6) != 0)
+		return DAXCTL_MEMBLOCK_OFFLINE;
+
+	/* once online, valid_zones is just the zone the block is in */
+	sprintf(strrchr(path, '/'), "/valid_zones");
+	if (sysfs_read_attr(ctx, path, buf) == 0) {
+		if (strcmp(buf, zone_strings[MEM_ZONE_MOVABLE]) == 0)
+			return DAXCTL_MEMBLOCK_ONLINE_MOVABLE;
+		if (strcmp(buf, zone_strings[MEM_ZONE_NORMAL]) == 0)
+			return DAXCTL_MEMBLOCK_ONLINE_NORMAL;
+	}
+	return DAXCTL_MEMBLOCK_ONLINE;
+}
+
+/*
+ * Reading the count, online state and zone one op at a time visits
+ * every block three times over. The summary reads each block's state,
+ * plus the zone of online ones, once, and keeps the result as runs
+ * until the next online or offline through this library.
+ */
+static int memory_summary_load(struct daxctl_memory *mem)
+{
+	const char *node_path = daxctl_memory_get_node_path(mem);
+	struct daxctl_memblock_run *run, *runs;
+	unsigned long long idx, first, last;
+	int rc, state;
+
+	if (mem->runs_valid)
+		return 0;
+	if (!node_path)
+		return -ENXIO;
+	rc = memory_block_range(mem, &first, &last);
+	if (rc)
+		return rc;
+
+	mem->nr_runs = 0;
+	for (idx = first; idx <= last; idx++) {
+		state = memblock_state(mem, node_path, idx);
+		if (state == -ENOENT)
+			continue;
+		if (state < 0)
+			return state;
+
+		run = mem->nr_runs ? &mem->runs[mem->nr_runs - 1] : NULL;
+		if (run && run->state == (enum daxctl_memblock_state) state
+				&& run->first + run->nr == idx) {
+			run->nr++;
+			continue;
+		}
+		runs = realloc(mem->runs, (mem->nr_runs + 1) * sizeof(*runs));
+		if (!runs)
+			return -ENOMEM;
+		mem->runs = runs;
+		runs[mem->nr_runs++] = (struct daxctl_memblock_run) {
+			.first = idx, .nr = 1, .state = state,
+		};
+	}
+
+	mem->runs_valid = true;
+	return 0;
+}
+
+/**
+ * daxctl_memory_get_num_block_runs - summarize a device's memory blocks
+ * @mem: memory object of a system-ram device
+ *
+ * Groups the device's memory blocks into runs of consecutive blocks in
+ * the same state, see daxctl_memory_get_block_run(). Scanned on first
+ * use and kept until memory is onlined or offlined through @mem.
+ * Returns the number of runs, or a negative error.
+ */
+DAXCTL_EXPORT int daxctl_memory_get_num_block_runs(struct daxctl_memory *mem)
+{
+	int rc = memory_summary_load(mem);
+
+	return rc ? rc : mem->nr_runs;
+}
+
+/**
+ * daxctl_memory_get_block_run - retrieve one run of the block summary
+ * @mem: memory object of a system-ram device
+ * @i: 0 .. daxctl_memory_get_num_block_runs() - 1
+ * @first: index of the run's first block, as in memoryN
+ * @nr: number of blocks in the run
+ *
+ * Returns the run's enum daxctl_memblock_state, or a negative error.
+ */
+DAXCTL_EXPORT int daxctl_memory_get_block_run(struct daxctl_memory *mem,
+		int i, unsigned long *first, unsigned long *nr)
+{
+	int rc = memory_summary_load(mem);
+
+	if (rc)
+		return rc;
+	if (i < 0 || i >= mem->nr_runs)
+		return -ENXIO;
+	*first = mem->runs[i].first;
+	*nr = mem->runs[i].nr;
+	return mem->runs[i].state;
+}
+
 DAXCTL_EXPORT int daxctl_memory_online(struct daxctl_memory *mem)
 {
 	return daxctl_memory_online_with_zone(mem, MEM_ZONE_MOVABLE);
@@ -1618,6 +2369,68 @@ DAXCTL_EXPORT int daxctl_memory_online_no_movable(struct daxctl_memory *mem)
 	return daxctl_memory_online_with_zone(mem, MEM_ZONE_NORMAL);
 }
 
+/**
+ * daxctl_memory_online_split - online a device's memory into two zones
+ * @mem: memory object of a system-ram device
+ * @normal_size: bytes, rounded up to whole memory blocks, to online to
+ *	ZONE_NORMAL
+ *
+ * The device's lowest addressed blocks, @normal_size worth of them, go
+ * to ZONE_NORMAL, where the kernel can place the page tables, slab and
+ * other allocations for the memory node local, and the rest to
+ * ZONE_MOVABLE, where it can still be offlined and unplugged. Each zone
+ * is one contiguous range. Blocks already online are left as they are,
+ * and are caught by the zone check that follows.
+ */
+DAXCTL_EXPORT int daxctl_memory_online_split(struct daxctl_memory *mem,
+		unsigned long long normal_size)
+{
+	struct daxctl_dev *dev = daxctl_memory_get_dev(mem);
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	unsigned long block_size = daxctl_memory_get_block_size(mem);
+	unsigned long long start, seen = 0;
+	unsigned long first, nr;
+	int i, n, state, rc;
+
+	if (!block_size)
+		return -ENXIO;
+	mem->normal_blocks = (normal_size + block_size - 1) / block_size;
+
+	mem->zone_ns = 0;
+	rc = daxctl_memory_op(mem, MEM_SET_ONLINE_SPLIT);
+	if (rc)
+		return rc;
+
+	/* every block up to the split in ZONE_NORMAL, all after it movable */
+	start = now_ns();
+	n = daxctl_memory_get_num_block_runs(mem);
+	for (i = 0; rc == 0 && i < n; i++) {
+		state = daxctl_memory_get_block_run(mem, i, &first, &nr);
+		if (state < 0) {
+			rc = state;
+			break;
+		}
+		if (seen < mem->normal_blocks) {
+			if (state != DAXCTL_MEMBLOCK_ONLINE_NORMAL
+					|| seen + nr > mem->normal_blocks)
+				rc = -EBUSY;
+		} else if (state != DAXCTL_MEMBLOCK_ONLINE_MOVABLE)
+			rc = -EBUSY;
+		seen += nr;
+	}
+	mem->zone_ns = now_ns() - start;
+	mem->zone = MEM_ZONE_UNKNOWN;
+	if (n < 0)
+		return n;
+	if (rc == -EBUSY)
+		err(ctx,
+		    "%s:\n  WARNING: detected a race while onlining memory\n"
+		    "  See 'man daxctl-reconfigure-device' for more details\n",
+		    devname);
+	return rc;
+}
+
 DAXCTL_EXPORT int daxctl_memory_offline(struct daxctl_memory *mem)
 {
 	return daxctl_memory_op(mem, MEM_SET_OFFLINE);
@@ -1675,3 +2488,432 @@ DAXCTL_EXPORT int daxctl_dev_has_online_memory(struct daxctl_dev *dev)
 	else
 		return 0;
 }
+
+static int node_range_match(unsigned long first, unsigned long last,
+		void *arg)
+{
+	unsigned long node = *(unsigned long *) arg;
+
+	return node >= first && node <= last;
+}
+
+/**
+ * daxctl_node_get_memory_tier - find the memory tier a NUMA node is in
+ * @ctx: daxctl library context
+ * @node: NUMA node id
+ *
+ * Returns N for /sys/devices/virtual/memory_tiering/memory_tierN, where a
+ * larger N is a slower tier, the kernel demotes cold pages from a tier
+ * to the slower ones. -ENOENT if no tier lists @node, -EOPNOTSUPP if the
+ * kernel has no memory tiering.
+ */
+DAXCTL_EXPORT int daxctl_node_get_memory_tier(struct daxctl_ctx *ctx,
+		int node)
+{
+	const char *tier_base = "/sys/devices/virtual/memory_tiering";
+	char path[PATH_MAX], buf[SYSFS_ATTR_SIZE];
+	unsigned long id = node;
+	int tier, rc = -ENOENT;
+	struct dirent *de;
+	DIR *dir;
+
+	if (node < 0)
+		return -EINVAL;
+	dir = opendir(tier_base);
+	if (!dir)
+		return -EOPNOTSUPP;
+	while ((de = readdir(dir)) != NULL) {
+		if (sscanf(de->d_name, "memory_tier%d", &tier) != 1)
+			continue;
+		if (snprintf(path, sizeof(path), "%s/%s/nodelist", tier_base,
+					de->d_name) >= (int) sizeof(path))
+			continue;
+		if (sysfs_read_attr(ctx, path, buf) < 0)
+			continue;
+		if (parse_id_list(buf, node_range_match, &id) > 0) {
+			rc = tier;
+			break;
+		}
+	}
+	closedir(dir);
+	return rc;
+}
+
+/**
+ * daxctl_node_get_perf - retrieve a NUMA node's access performance
+ * @ctx: daxctl library context
+ * @node: NUMA node id
+ * @access: access class, 0 for the best initiators of any kind (e.g.
+ * accelerators), 1 for the best cpu initiators
+ * @perf: read and write bandwidth in MB/s and latency in nanoseconds,
+ * zero where the platform does not say
+ *
+ * These are what the kernel derived from the ACPI HMAT, see
+ * /sys/devices/system/node/nodeN/accessC/initiators. Returns -ENOENT if
+ * none are provided for @node.
+ */
+DAXCTL_EXPORT int daxctl_node_get_perf(struct daxctl_ctx *ctx, int node,
+		int access, struct daxctl_node_perf *perf)
+{
+	static const char * const perf_attrs[] = {
+		"read_bandwidth", "write_bandwidth",
+		"read_latency", "write_latency",
+	};
+	unsigned long *vals[] = {
+		&perf->read_bandwidth, &perf->write_bandwidth,
+		&perf->read_latency, &perf->write_latency,
+	};
+	char path[PATH_MAX], buf[SYSFS_ATTR_SIZE];
+	unsigned int i, found = 0;
+
+	memset(perf, 0, sizeof(*perf));
+	if (node < 0 || access < 0)
+		return -EINVAL;
+	for (i = 0; i < ARRAY_SIZE(perf_attrs); i++) {
+		snprintf(path, sizeof(path),
+				"/sys/devices/system/node/node%d/access%d/initiators/%s",
+				node, access, perf_attrs[i]);
+		/* most platforms have no HMAT, misses only log at debug */
+		if (sysfs_read_attr(ctx, path, buf) < 0)
+			continue;
+		*vals[i] = strtoul(buf, NULL, 0);
+		found++;
+	}
+	return found ? 0 : -ENOENT;
+}
+
+static const char *demotion_path = "/sys/kernel/mm/numa/demotion_enabled";
+static const char *numa_balancing_path = "/proc/sys/kernel/numa_balancing";
+
+/**
+ * daxctl_get_demotion - whether reclaim demotes pages to slower tiers
+ * @ctx: daxctl library context
+ *
+ * Returns 1 or 0, or a negative error if the kernel lacks the knob.
+ */
+DAXCTL_EXPORT int daxctl_get_demotion(struct daxctl_ctx *ctx)
+{
+	char buf[SYSFS_ATTR_SIZE];
+	int rc;
+
+	rc = sysfs_read_attr(ctx, demotion_path, buf);
+	if (rc < 0)
+		return rc;
+	return buf[0] == 't' || buf[0] == 'T' || buf[0] == 'y'
+		|| buf[0] == 'Y' || buf[0] == '1';
+}
+
+/**
+ * daxctl_set_demotion - let reclaim demote pages to slower memory tiers
+ * @ctx: daxctl library context
+ * @enable: zero to reclaim without demotion
+ *
+ * This is system wide. The kernel derives demotion targets from the
+ * memory tiers, see daxctl_node_get_memory_tier().
+ */
+DAXCTL_EXPORT int daxctl_set_demotion(struct daxctl_ctx *ctx, int enable)
+{
+	return sysfs_write_attr(ctx, demotion_path, enable ? "true" : "false");
+}
+
+/**
+ * daxctl_get_numa_balancing - read kernel.numa_balancing
+ * @ctx: daxctl library context
+ *
+ * Returns the mode bits, DAXCTL_NUMA_BALANCING_NORMAL and/or
+ * DAXCTL_NUMA_BALANCING_TIERING, or a negative error.
+ */
+DAXCTL_EXPORT int daxctl_get_numa_balancing(struct daxctl_ctx *ctx)
+{
+	char buf[SYSFS_ATTR_SIZE];
+	int rc;
+
+	rc = sysfs_read_attr(ctx, numa_balancing_path, buf);
+	if (rc < 0)
+		return rc;
+	return strtoul(buf, NULL, 0);
+}
+
+/**
+ * daxctl_set_numa_balancing - write kernel.numa_balancing
+ * @ctx: daxctl library context
+ * @mode: DAXCTL_NUMA_BALANCING_* bits, TIERING promotes hot pages from
+ * slower memory tiers back to faster ones
+ */
+DAXCTL_EXPORT int daxctl_set_numa_balancing(struct daxctl_ctx *ctx, int mode)
+{
+	char buf[16];
+
+	sprintf(buf, "%d", mode);
+	return sysfs_write_attr(ctx, numa_balancing_path, buf);
+}
+
+#ifndef MAP_SYNC
+#define MAP_SYNC 0x80000
+#endif
+#ifndef MAP_SHARED_VALIDATE
+#define MAP_SHARED_VALIDATE 0x03
+#endif
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ 22
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+/* prefault work is handed out this many bytes, or one fault, at a time */
+#define PREFAULT_CHUNK SZ_64M
+
+struct prefault_pool {
+	struct daxctl_map *map;
+	unsigned long long chunk;
+	int nr;
+	int next;
+	int rc;
+};
+
+static int prefault_range(struct daxctl_map *map, char *addr, size_t len)
+{
+	bool ro = map->flags & DAXCTL_MAP_READONLY;
+	size_t off;
+
+	if (madvise(addr, len, ro ? MADV_POPULATE_READ
+				: MADV_POPULATE_WRITE) == 0)
+		return 0;
+	if (errno != EINVAL)
+		return -errno;
+
+	/* before MADV_POPULATE_*, one access per fault, data left as is */
+	for (off = 0; off < len; off += map->fault_size)
+		if (ro)
+			(void) *(volatile char *) (addr + off);
+		else
+			__atomic_fetch_add(addr + off, 0, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static void *prefault_worker(void *arg)
+{
+	struct prefault_pool *pool = arg;
+	struct daxctl_map *map = pool->map;
+	unsigned long long off;
+	int i, rc, zero;
+
+	while (!__atomic_load_n(&pool->rc, __ATOMIC_RELAXED)
+			&& (i = __atomic_fetch_add(&pool->next, 1,
+					__ATOMIC_RELAXED)) < pool->nr) {
+		off = i * pool->chunk;
+		rc = prefault_range(map, (char *) map->addr + off,
+				min_t(unsigned long long, pool->chunk,
+					map->size - off));
+		if (rc) {
+			zero = 0;
+			__atomic_compare_exchange_n(&pool->rc, &zero, rc,
+					false, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * One worker per cpu of the device's target node, so the page tables
+ * for the mapping are allocated node local. A node without cpus, as
+ * is usual for CXL memory, gets one unbound worker per online cpu.
+ * Either way daxctl_set_max_threads() bounds the count.
+ */
+static int map_prefault(struct daxctl_map *map)
+{
+	struct daxctl_dev *dev = map->dev;
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	int i, nr_threads, node = daxctl_dev_get_target_node(dev);
+	struct prefault_pool pool = { .map = map };
+	char path[PATH_MAX];
+	pthread_t *threads;
+	pthread_attr_t attr;
+	bool bound = false;
+	cpu_set_t cpus;
+
+	pool.chunk = max_t(unsigned long long, map->fault_size,
+			PREFAULT_CHUNK);
+	pool.nr = (map->size + pool.chunk - 1) / pool.chunk;
+
+	if (node >= 0) {
+		sprintf(path, "/sys/devices/system/node/node%d", node);
+		bound = node_cpus(ctx, path, &cpus) == 0;
+	}
+	nr_threads = bound ? CPU_COUNT(&cpus) : sysconf(_SC_NPROCESSORS_ONLN);
+	nr_threads = min(max(daxctl_threads(ctx, nr_threads), 1), pool.nr);
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	pthread_attr_init(&attr);
+	if (bound)
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	for (i = 0; threads && i < nr_threads; i++)
+		if (pthread_create(&threads[i], &attr, prefault_worker, &pool))
+			break;
+	pthread_attr_destroy(&attr);
+	map->nr_threads = threads ? i : 0;
+	/* whatever could not be handed to a thread runs here */
+	prefault_worker(&pool);
+	while (threads && i--)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	dbg(ctx, "%s: prefaulted %#zx with %d %s thread(s)\n", devname,
+			map->size, map->nr_threads, bound ? "node" : "unbound");
+	if (pool.rc)
+		err(ctx, "%s: prefault failed: %s\n", devname,
+				strerror(-pool.rc));
+	return pool.rc;
+}
+
+/**
+ * daxctl_dev_mmap - map a device-dax instance on its fault boundary
+ * @dev: a devdax mode device, enabled
+ * @offset: start within the device, a multiple of daxctl_dev_get_align()
+ * @size: bytes to map, a multiple of the alignment, 0 for the rest of
+ *	the device
+ * @flags: DAXCTL_MAP_* bits
+ * @map: on success, the new mapping
+ *
+ * The device faults in units of its alignment and refuses a mapping
+ * that does not start on, and span a multiple of, that alignment. The
+ * address is picked accordingly, and daxctl_map_get_fault_size() is
+ * then the page size every fault installs. DAXCTL_MAP_SYNC asks for
+ * MAP_SYNC semantics and fails where the kernel does not support them.
+ * DAXCTL_MAP_PREFAULT populates the whole mapping before returning,
+ * see daxctl_map_get_prefault_threads(); where the kernel lacks
+ * MADV_POPULATE_* it touches each fault instead, and a poisoned page
+ * then raises SIGBUS in the caller.
+ */
+DAXCTL_EXPORT int daxctl_dev_mmap(struct daxctl_dev *dev,
+		unsigned long long offset, size_t size, unsigned int flags,
+		struct daxctl_map **map)
+{
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct daxctl_ctx *ctx = daxctl_dev_get_ctx(dev);
+	unsigned long long dev_size = daxctl_dev_get_size(dev);
+	unsigned long align = daxctl_dev_get_align(dev);
+	int prot = PROT_READ, mflags = MAP_SHARED;
+	char path[PATH_MAX], *hint, *addr;
+	size_t head;
+	struct daxctl_map *m;
+	int rc;
+
+	if (!align)
+		align = sysconf(_SC_PAGESIZE);
+	if (!size && offset < dev_size)
+		size = dev_size - offset;
+	if (!size || offset + size > dev_size || !IS_ALIGNED(offset, align)
+			|| !IS_ALIGNED(size, align)) {
+		err(ctx, "%s: can not map %#zx at %#llx, align: %#lx size: %#llx\n",
+				devname, size, offset, align, dev_size);
+		return -EINVAL;
+	}
+
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return -ENOMEM;
+	m->dev = dev;
+	m->size = size;
+	m->flags = flags;
+	m->fault_size = align;
+
+	if (!(flags & DAXCTL_MAP_READONLY))
+		prot |= PROT_WRITE;
+	if (flags & DAXCTL_MAP_SYNC)
+		mflags = MAP_SHARED_VALIDATE | MAP_SYNC;
+
+	sprintf(path, "/dev/%s", devname);
+	m->fd = open(path, (flags & DAXCTL_MAP_READONLY ? O_RDONLY : O_RDWR)
+			| O_CLOEXEC);
+	if (m->fd < 0) {
+		rc = -errno;
+		err(ctx, "%s: open %s: %s\n", devname, path, strerror(-rc));
+		goto err_free;
+	}
+
+	/*
+	 * Reserve a window with @align of slack, map over its aligned
+	 * part, and give back what is left on either side.
+	 */
+	hint = mmap(NULL, size + align, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (hint == MAP_FAILED) {
+		rc = -errno;
+		goto err_close;
+	}
+	addr = (char *) ALIGN((unsigned long) hint, align);
+	head = addr - hint;
+	if (head)
+		munmap(hint, head);
+	if (align - head)
+		munmap(addr + size, align - head);
+
+	m->addr = mmap(addr, size, prot, mflags | MAP_FIXED, m->fd, offset);
+	if (m->addr == MAP_FAILED) {
+		rc = -errno;
+		munmap(addr, size);
+		err(ctx, "%s: mmap%s: %s\n", devname,
+				flags & DAXCTL_MAP_SYNC ? " (MAP_SYNC)" : "",
+				strerror(-rc));
+		goto err_close;
+	}
+
+	if (flags & DAXCTL_MAP_PREFAULT) {
+		rc = map_prefault(m);
+		if (rc) {
+			munmap(m->addr, size);
+			goto err_close;
+		}
+	}
+
+	dbg(ctx, "%s: mapped %#zx at %p, %#lx faults\n", devname, size,
+			m->addr, m->fault_size);
+	*map = m;
+	return 0;
+
+err_close:
+	close(m->fd);
+err_free:
+	free(m);
+	return rc;
+}
+
+/* unmap and close, @map is freed */
+DAXCTL_EXPORT void daxctl_map_unmap(struct daxctl_map *map)
+{
+	if (!map)
+		return;
+	munmap(map->addr, map->size);
+	close(map->fd);
+	free(map);
+}
+
+DAXCTL_EXPORT void *daxctl_map_get_addr(struct daxctl_map *map)
+{
+	return map->addr;
+}
+
+DAXCTL_EXPORT size_t daxctl_map_get_size(struct daxctl_map *map)
+{
+	return map->size;
+}
+
+DAXCTL_EXPORT int daxctl_map_get_fd(struct daxctl_map *map)
+{
+	return map->fd;
+}
+
+DAXCTL_EXPORT unsigned long daxctl_map_get_fault_size(struct daxctl_map *map)
+{
+	return map->fault_size;
+}
+
+/* threads spawned for DAXCTL_MAP_PREFAULT, besides the caller's own */
+DAXCTL_EXPORT int daxctl_map_get_prefault_threads(struct daxctl_map *map)
+{
+	return map->nr_threads;
+}
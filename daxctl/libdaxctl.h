@@ -26,8 +26,13 @@ void daxctl_set_log_fn(struct daxctl_ctx *ctx,
 			const char *format, va_list args));
 int daxctl_get_log_priority(struct daxctl_ctx *ctx);
 void daxctl_set_log_priority(struct daxctl_ctx *ctx, int priority);
+int daxctl_set_log_ring(struct daxctl_ctx *ctx, unsigned long size);
+void daxctl_log_dump(struct daxctl_ctx *ctx);
 void daxctl_set_userdata(struct daxctl_ctx *ctx, void *userdata);
 void *daxctl_get_userdata(struct daxctl_ctx *ctx);
+void daxctl_set_memory_threads(struct daxctl_ctx *ctx, unsigned int nr);
+void daxctl_set_max_threads(struct daxctl_ctx *ctx, unsigned int nr);
+int daxctl_set_sysfs_root(struct daxctl_ctx *ctx, const char *path);
 
 struct daxctl_region;
 struct daxctl_region *daxctl_new_region(struct daxctl_ctx *ctx, int id,
@@ -42,6 +47,17 @@ struct daxctl_ctx *daxctl_region_get_ctx(struct daxctl_region *region);
 unsigned long long daxctl_region_get_available_size(
 		struct daxctl_region *region);
 unsigned long long daxctl_region_get_size(struct daxctl_region *region);
+unsigned long long daxctl_region_get_resource(struct daxctl_region *region);
+
+enum daxctl_persistence_domain {
+	DAXCTL_PERSISTENCE_VOLATILE,
+	/* persistent memory, but the platform flushes nothing on power loss */
+	DAXCTL_PERSISTENCE_NONE,
+	DAXCTL_PERSISTENCE_MEM_CTRL,
+	DAXCTL_PERSISTENCE_CPU_CACHE,
+};
+enum daxctl_persistence_domain daxctl_region_get_persistence_domain(
+		struct daxctl_region *region);
 unsigned long daxctl_region_get_align(struct daxctl_region *region);
 const char *daxctl_region_get_devname(struct daxctl_region *region);
 const char *daxctl_region_get_path(struct daxctl_region *region);
@@ -74,6 +90,41 @@ int daxctl_dev_get_target_node(struct daxctl_dev *dev);
 int daxctl_dev_will_auto_online_memory(struct daxctl_dev *dev);
 int daxctl_dev_has_online_memory(struct daxctl_dev *dev);
 
+enum daxctl_map_flags {
+	DAXCTL_MAP_READONLY = 1 << 0,
+	/* fail if the kernel can not honour MAP_SYNC for this device */
+	DAXCTL_MAP_SYNC = 1 << 1,
+	DAXCTL_MAP_PREFAULT = 1 << 2,
+};
+
+struct daxctl_map;
+int daxctl_dev_mmap(struct daxctl_dev *dev, unsigned long long offset,
+		size_t size, unsigned int flags, struct daxctl_map **map);
+void daxctl_map_unmap(struct daxctl_map *map);
+void *daxctl_map_get_addr(struct daxctl_map *map);
+size_t daxctl_map_get_size(struct daxctl_map *map);
+int daxctl_map_get_fd(struct daxctl_map *map);
+unsigned long daxctl_map_get_fault_size(struct daxctl_map *map);
+int daxctl_map_get_prefault_threads(struct daxctl_map *map);
+
+#define DAXCTL_NUMA_BALANCING_NORMAL	0x1
+#define DAXCTL_NUMA_BALANCING_TIERING	0x2
+
+int daxctl_node_get_memory_tier(struct daxctl_ctx *ctx, int node);
+
+struct daxctl_node_perf {
+	unsigned long read_bandwidth;
+	unsigned long write_bandwidth;
+	unsigned long read_latency;
+	unsigned long write_latency;
+};
+int daxctl_node_get_perf(struct daxctl_ctx *ctx, int node, int access,
+		struct daxctl_node_perf *perf);
+int daxctl_get_demotion(struct daxctl_ctx *ctx);
+int daxctl_set_demotion(struct daxctl_ctx *ctx, int enable);
+int daxctl_get_numa_balancing(struct daxctl_ctx *ctx);
+int daxctl_set_numa_balancing(struct daxctl_ctx *ctx, int mode);
+
 struct daxctl_memory;
 struct daxctl_memory *daxctl_dev_get_memory(struct daxctl_dev *dev);
 struct daxctl_dev *daxctl_memory_get_dev(struct daxctl_memory *mem);
@@ -85,6 +136,23 @@ int daxctl_memory_is_online(struct daxctl_memory *mem);
 int daxctl_memory_num_sections(struct daxctl_memory *mem);
 int daxctl_memory_is_movable(struct daxctl_memory *mem);
 int daxctl_memory_online_no_movable(struct daxctl_memory *mem);
+int daxctl_memory_online_split(struct daxctl_memory *mem,
+		unsigned long long normal_size);
+int daxctl_memory_get_num_block_times(struct daxctl_memory *mem);
+int daxctl_memory_get_block_time(struct daxctl_memory *mem, int i,
+		unsigned long *block, unsigned long long *ns);
+unsigned long long daxctl_memory_get_zone_time(struct daxctl_memory *mem);
+
+enum daxctl_memblock_state {
+	DAXCTL_MEMBLOCK_OFFLINE,
+	/* online, zone neither of the below */
+	DAXCTL_MEMBLOCK_ONLINE,
+	DAXCTL_MEMBLOCK_ONLINE_NORMAL,
+	DAXCTL_MEMBLOCK_ONLINE_MOVABLE,
+};
+int daxctl_memory_get_num_block_runs(struct daxctl_memory *mem);
+int daxctl_memory_get_block_run(struct daxctl_memory *mem, int i,
+		unsigned long *first, unsigned long *nr);
 
 #define daxctl_dev_foreach(region, dev) \
         for (dev = daxctl_dev_get_first(region); \
@@ -9,6 +9,7 @@
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <daxctl/libdaxctl.h>
+#include <cxl/libcxl.h>
 #include <util/parse-options.h>
 #include <ccan/array_size/array_size.h>
 
@@ -18,6 +19,8 @@ static struct {
 	bool mappings;
 	bool idle;
 	bool human;
+	bool cxl;
+	const char *fields;
 } list;
 
 static unsigned long listopts_to_flags(void)
@@ -32,6 +35,8 @@ static unsigned long listopts_to_flags(void)
 		flags |= UTIL_JSON_IDLE;
 	if (list.human)
 		flags |= UTIL_JSON_HUMAN;
+	if (list.fields)
+		flags |= UTIL_JSON_FIELDS;
 	return flags;
 }
 
@@ -54,6 +59,56 @@ static int num_list_flags(void)
 	return list.regions + list.devs;
 }
 
+/* the CXL region, and the memdevs interleaved into it, behind a dax region */
+static struct json_object *cxl_region_info(struct cxl_ctx *cxl_ctx,
+		struct daxctl_region *region)
+{
+	struct cxl_region *cxl_region;
+	struct cxl_decoder *decoder;
+	struct cxl_memdev *memdev;
+	struct json_object *jcxl, *jmemdevs, *jobj;
+	int i;
+
+	if (!cxl_ctx)
+		return NULL;
+	cxl_region = cxl_region_get_by_daxctl_region(cxl_ctx, region);
+	if (!cxl_region)
+		return NULL;
+
+	jcxl = json_object_new_object();
+	if (!jcxl)
+		return NULL;
+	jobj = json_object_new_string(cxl_region_get_devname(cxl_region));
+	if (jobj)
+		json_object_object_add(jcxl, "region", jobj);
+	jobj = json_object_new_int(cxl_region_get_interleave_ways(cxl_region));
+	if (jobj)
+		json_object_object_add(jcxl, "interleave_ways", jobj);
+	jmemdevs = json_object_new_array();
+	if (!jmemdevs)
+		return jcxl;
+	for (i = 0; i < cxl_region_get_interleave_ways(cxl_region); i++) {
+		decoder = cxl_region_get_target(cxl_region, i);
+		memdev = decoder ? cxl_decoder_get_memdev(decoder) : NULL;
+		if (!memdev)
+			continue;
+		jobj = json_object_new_string(cxl_memdev_get_devname(memdev));
+		if (jobj)
+			json_object_array_add(jmemdevs, jobj);
+	}
+	json_object_object_add(jcxl, "memdevs", jmemdevs);
+	return jcxl;
+}
+
+static void add_cxl_region_info(struct cxl_ctx *cxl_ctx,
+		struct daxctl_region *region, struct json_object *jobj)
+{
+	struct json_object *jcxl = cxl_region_info(cxl_ctx, region);
+
+	if (jcxl)
+		json_object_object_add(jobj, "cxl", jcxl);
+}
+
 int cmd_list(int argc, const char **argv, struct daxctl_ctx *ctx)
 {
 	const struct option options[] = {
@@ -67,17 +122,22 @@ int cmd_list(int argc, const char **argv, struct daxctl_ctx *ctx)
 		OPT_BOOLEAN('i', "idle", &list.idle, "include idle devices"),
 		OPT_BOOLEAN('u', "human", &list.human,
 				"use human friendly number formats "),
+		OPT_BOOLEAN('C', "cxl", &list.cxl,
+				"include the CXL region and memdevs behind each device"),
+		OPT_STRING('\0', "fields", &list.fields, "field[,field...]",
+				"only collect and print these attributes"),
 		OPT_END(),
 	};
 	const char * const u[] = {
 		"daxctl list [<options>]",
 		NULL
 	};
-	struct json_object *jregions = NULL;
-	struct json_object *jdevs = NULL;
 	struct daxctl_region *region;
+	struct cxl_ctx *cxl_ctx = NULL;
+	struct util_json_stream out;
 	unsigned long list_flags;
-	int i;
+	struct json_object *jdevs;
+	int i, n, len;
 
         argc = parse_options(argc, argv, options, u, 0);
 	for (i = 0; i < argc; i++)
@@ -94,8 +154,25 @@ int cmd_list(int argc, const char **argv, struct daxctl_ctx *ctx)
 	if (num_list_flags() == 0)
 		list.devs = true;
 
+	if (list.fields) {
+		if (util_json_fields_parse(list.fields)) {
+			error("invalid --fields \"%s\"\n", list.fields);
+			usage_with_options(u, options);
+		}
+		/* the CXL context is only opened for the "cxl" attribute */
+		if (!util_json_want(UTIL_JSON_FIELDS, "cxl"))
+			list.cxl = false;
+	}
+
 	list_flags = listopts_to_flags();
 
+	if (list.cxl && cxl_new(&cxl_ctx) != 0) {
+		error("failed to open CXL context\n");
+		cxl_ctx = NULL;
+	}
+
+	/* regions, or devices, are written out as each region is visited */
+	util_json_stream_init(&out, stdout, list_flags);
 	daxctl_region_foreach(ctx, region) {
 		struct json_object *jregion = NULL;
 
@@ -103,30 +180,29 @@ int cmd_list(int argc, const char **argv, struct daxctl_ctx *ctx)
 			continue;
 
 		if (list.regions) {
-			if (!jregions) {
-				jregions = json_object_new_array();
-				if (!jregions) {
-					fail("\n");
-					continue;
-				}
-			}
-
 			jregion = util_daxctl_region_to_json(region,
 					param.dev, list_flags);
 			if (!jregion) {
 				fail("\n");
 				continue;
 			}
-			json_object_array_add(jregions, jregion);
-		} else if (list.devs)
-			jdevs = util_daxctl_devs_to_list(region, jdevs,
+			if (cxl_ctx)
+				add_cxl_region_info(cxl_ctx, region, jregion);
+			util_json_stream_add(&out, jregion);
+		} else if (list.devs) {
+			jdevs = util_daxctl_devs_to_list(region, NULL,
 					param.dev, list_flags);
+			if (!jdevs)
+				continue;
+			len = json_object_array_length(jdevs);
+			for (n = 0; cxl_ctx && n < len; n++)
+				add_cxl_region_info(cxl_ctx, region,
+					json_object_array_get_idx(jdevs, n));
+			util_json_stream_add_array(&out, jdevs);
+		}
 	}
-
-	if (jregions)
-		util_display_json_array(stdout, jregions, list_flags);
-	else if (jdevs)
-		util_display_json_array(stdout, jdevs, list_flags);
+	util_json_stream_end(&out);
+	cxl_unref(cxl_ctx);
 
 	if (did_fail)
 		return -ENOMEM;
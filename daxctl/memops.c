@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/size.h>
+#include <daxctl/memops.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/*
+ * mem_zero_nt() returns whether the stores went around the cache, in
+ * which case mem_drain() on the same cpu is all it takes to have them
+ * reach memory. Otherwise mem_flush() writes the lines back first.
+ */
+#if defined(__x86_64__)
+#define CACHELINE 64
+
+bool mem_zero_nt(void *addr, size_t len)
+{
+	char *p = addr, *end = p + len;
+	char *s = (char *) ALIGN((unsigned long) p, CACHELINE);
+	char *e = (char *) ((unsigned long) end & ~(CACHELINE - 1UL));
+	const __m128i zero = _mm_setzero_si128();
+
+	if (s >= e) {
+		memset(p, 0, len);
+		mem_flush(p, len);
+		return true;
+	}
+
+	/* partial lines at either end go through the cache */
+	memset(p, 0, s - p);
+	mem_flush(p, s - p);
+	for (; s < e; s += CACHELINE) {
+		_mm_stream_si128((__m128i *) s, zero);
+		_mm_stream_si128((__m128i *) (s + 16), zero);
+		_mm_stream_si128((__m128i *) (s + 32), zero);
+		_mm_stream_si128((__m128i *) (s + 48), zero);
+	}
+	memset(e, 0, end - e);
+	mem_flush(e, end - e);
+	return true;
+}
+
+/* @addr and @len are multiples of the cacheline */
+bool mem_fill_nt(void *addr, size_t len, unsigned long long val)
+{
+	const __m128i v = _mm_set1_epi64x(val);
+	char *p = addr, *end = p + len;
+
+	for (; p < end; p += CACHELINE) {
+		_mm_stream_si128((__m128i *) p, v);
+		_mm_stream_si128((__m128i *) (p + 16), v);
+		_mm_stream_si128((__m128i *) (p + 32), v);
+		_mm_stream_si128((__m128i *) (p + 48), v);
+	}
+	return true;
+}
+
+int mem_flush(void *addr, size_t len)
+{
+	char *p = (char *) ((unsigned long) addr & ~(CACHELINE - 1UL));
+	char *end = (char *) addr + len;
+
+	for (; p < end; p += CACHELINE)
+		_mm_clflush(p);
+	return 0;
+}
+
+void mem_drain(void)
+{
+	_mm_sfence();
+}
+#elif defined(__aarch64__)
+/*
+ * DC ZVA zeroes a whole block without reading it first, which is what
+ * the non-temporal path buys on x86, but the result sits in the cache.
+ */
+bool mem_zero_nt(void *addr, size_t len)
+{
+	char *p = addr, *end = p + len, *s, *e;
+	unsigned long dczid, bs;
+
+	asm volatile("mrs %0, dczid_el0" : "=r" (dczid));
+	if (dczid & (1 << 4)) {
+		/* prohibited */
+		memset(p, 0, len);
+		return false;
+	}
+	bs = 4UL << (dczid & 0xf);
+	s = (char *) ALIGN((unsigned long) p, bs);
+	e = (char *) ((unsigned long) end & ~(bs - 1));
+	if (s >= e) {
+		memset(p, 0, len);
+		return false;
+	}
+	memset(p, 0, s - p);
+	for (; s < e; s += bs)
+		asm volatile("dc zva, %0" : : "r" (s) : "memory");
+	memset(e, 0, end - e);
+	return false;
+}
+
+/* @addr is 16 byte aligned and @len a multiple of 16 */
+bool mem_fill_nt(void *addr, size_t len, unsigned long long val)
+{
+	char *p = addr, *end = p + len;
+
+	for (; p < end; p += 16)
+		asm volatile("stnp %1, %1, [%0]" : : "r" (p), "r" (val)
+				: "memory");
+	return true;
+}
+
+int mem_flush(void *addr, size_t len)
+{
+	unsigned long ctr, line;
+	char *p, *end = (char *) addr + len;
+
+	asm volatile("mrs %0, ctr_el0" : "=r" (ctr));
+	line = 4UL << ((ctr >> 16) & 0xf);
+	for (p = (char *) ((unsigned long) addr & ~(line - 1)); p < end;
+			p += line)
+		asm volatile("dc cvac, %0" : : "r" (p) : "memory");
+	return 0;
+}
+
+void mem_drain(void)
+{
+	asm volatile("dsb sy" : : : "memory");
+}
+#else
+bool mem_zero_nt(void *addr, size_t len)
+{
+	memset(addr, 0, len);
+	return false;
+}
+
+bool mem_fill_nt(void *addr, size_t len, unsigned long long val)
+{
+	unsigned long long *p = addr;
+	size_t i;
+
+	for (i = 0; i < len / sizeof(*p); i++)
+		p[i] = val;
+	return false;
+}
+
+int mem_flush(void *addr, size_t len)
+{
+	return -EOPNOTSUPP;
+}
+
+void mem_drain(void)
+{
+	__sync_synchronize();
+}
+#endif
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _DAXCTL_MEMOPS_H_
+#define _DAXCTL_MEMOPS_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+bool mem_zero_nt(void *addr, size_t len);
+bool mem_fill_nt(void *addr, size_t len, unsigned long long val);
+int mem_flush(void *addr, size_t len);
+void mem_drain(void);
+
+static inline unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#endif /* _DAXCTL_MEMOPS_H_ */
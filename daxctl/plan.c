@@ -0,0 +1,333 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <util/size.h>
+#include <daxctl/plan.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
+
+/*
+ * A device-dax instance faults in units of its alignment, and the kernel
+ * only accepts an alignment that every range of the device, and its page
+ * offset, is a multiple of. So a device gets PUD mappings only if all of
+ * it sits on 1G boundaries, and PMD mappings only if all of it sits on
+ * 2M boundaries.
+ *
+ * The planner works per device, largest fault size first, so the 1G
+ * devices pick from the 1G aligned space before the 2M ones cut into
+ * it. Within a fault size F it prefers, in order: one span outside the
+ * space aligned to the next larger size, so that space stays whole;
+ * one span inside it, taken from its end; and then the largest spans
+ * left, which costs more ranges. A device that does not fit at F is
+ * retried at the next smaller size.
+ */
+static const unsigned long long fault_sizes[] = { SZ_1G, SZ_2M };
+
+struct free_list {
+	struct plan_range *r;
+	int nr;
+};
+
+struct piece {
+	int idx;
+	unsigned long long start, len;
+	bool core;
+};
+
+static int free_list_copy(struct free_list *dst, const struct free_list *src)
+{
+	dst->r = malloc((src->nr + 1) * sizeof(*dst->r));
+	if (!dst->r)
+		return -ENOMEM;
+	memcpy(dst->r, src->r, src->nr * sizeof(*dst->r));
+	dst->nr = src->nr;
+	return 0;
+}
+
+/* remove [@start, @start + @len) from r[@i], which contains it */
+static int free_take(struct free_list *fl, int i, unsigned long long start,
+		unsigned long long len)
+{
+	struct plan_range *r = &fl->r[i], *n;
+	unsigned long long end = start + len - 1;
+
+	if (start == r->start && end == r->end) {
+		memmove(r, r + 1, (fl->nr - i - 1) * sizeof(*r));
+		fl->nr--;
+	} else if (start == r->start) {
+		r->start = end + 1;
+	} else if (end == r->end) {
+		r->end = start - 1;
+	} else {
+		n = realloc(fl->r, (fl->nr + 1) * sizeof(*n));
+		if (!n)
+			return -ENOMEM;
+		fl->r = n;
+		r = &n[i];
+		memmove(r + 2, r + 1, (fl->nr - i - 1) * sizeof(*r));
+		r[1].start = end + 1;
+		r[1].end = r->end;
+		r->end = start - 1;
+		fl->nr++;
+	}
+	return 0;
+}
+
+/*
+ * The @f aligned spans of the free list, split into the parts aligned
+ * to @g as well (core) and the rest. Returns the number of pieces.
+ */
+static int free_pieces(struct free_list *fl, unsigned long long f,
+		unsigned long long g, struct piece *p)
+{
+	unsigned long long ws, we, cs, ce;
+	int i, n = 0;
+
+	for (i = 0; i < fl->nr; i++) {
+		ws = ALIGN(fl->r[i].start, f);
+		we = ALIGN_DOWN(fl->r[i].end + 1, f);
+		if (ws >= we)
+			continue;
+
+		cs = g ? ALIGN(ws, g) : ws;
+		ce = g ? ALIGN_DOWN(we, g) : we;
+		if (cs >= ce) {
+			p[n++] = (struct piece) { i, ws, we - ws, false };
+			continue;
+		}
+		if (ws < cs)
+			p[n++] = (struct piece) { i, ws, cs - ws, false };
+		p[n++] = (struct piece) { i, cs, ce - cs, true };
+		if (ce < we)
+			p[n++] = (struct piece) { i, ce, we - ce, false };
+	}
+	return n;
+}
+
+static int pick_piece(struct piece *p, int n, unsigned long long need)
+{
+	int i, best = -1;
+
+	/* smallest single fit, outside the core first */
+	for (i = 0; i < n; i++) {
+		if (p[i].len < need)
+			continue;
+		if (best < 0 || p[i].core < p[best].core
+				|| (p[i].core == p[best].core
+					&& p[i].len < p[best].len))
+			best = i;
+	}
+	if (best >= 0)
+		return best;
+
+	/* otherwise the largest, again outside the core on a tie */
+	for (i = 0; i < n; i++)
+		if (best < 0 || p[i].len > p[best].len
+				|| (p[i].len == p[best].len && !p[i].core))
+			best = i;
+	return best;
+}
+
+static int add_map(struct plan_dev *dev, unsigned long long start,
+		unsigned long long len)
+{
+	struct mapping *m;
+
+	m = realloc(dev->maps, (dev->nmaps + 1) * sizeof(*m));
+	if (!m)
+		return -ENOMEM;
+	dev->maps = m;
+	m[dev->nmaps].start = start;
+	m[dev->nmaps].end = start + len - 1;
+	dev->nmaps++;
+	return 0;
+}
+
+static int plan_alloc(struct free_list *fl, struct plan_dev *dev,
+		unsigned long long f, unsigned long long g)
+{
+	unsigned long long need = dev->size, start, len;
+	struct piece *p;
+	int n, i, rc = 0;
+
+	while (need && rc == 0) {
+		/* each range yields at most three pieces */
+		p = calloc(fl->nr * 3 + 1, sizeof(*p));
+		if (!p)
+			return -ENOMEM;
+		n = free_pieces(fl, f, g, p);
+		i = pick_piece(p, n, need);
+		if (i < 0) {
+			free(p);
+			return -ENOSPC;
+		}
+
+		len = min_t(unsigned long long, p[i].len, need);
+		/* a partial core take comes off the end, keeping the start */
+		start = p[i].core ? p[i].start + p[i].len - len : p[i].start;
+		rc = free_take(fl, p[i].idx, start, len);
+		if (rc == 0)
+			rc = add_map(dev, start, len);
+		need -= len;
+		free(p);
+	}
+	return rc;
+}
+
+static int map_cmp(const void *a, const void *b)
+{
+	const struct mapping *m1 = a, *m2 = b;
+
+	if (m1->start != m2->start)
+		return m1->start < m2->start ? -1 : 1;
+	return 0;
+}
+
+static void plan_merge(struct plan_dev *dev)
+{
+	unsigned long long pgoff = 0;
+	int i, n = 0;
+
+	qsort(dev->maps, dev->nmaps, sizeof(*dev->maps), map_cmp);
+	for (i = 0; i < dev->nmaps; i++) {
+		if (n && dev->maps[n - 1].end + 1 == dev->maps[i].start) {
+			dev->maps[n - 1].end = dev->maps[i].end;
+			continue;
+		}
+		dev->maps[n++] = dev->maps[i];
+	}
+	dev->nmaps = n;
+
+	for (i = 0; i < n; i++) {
+		dev->maps[i].pgoff = pgoff;
+		pgoff += dev->maps[i].end - dev->maps[i].start + 1;
+	}
+}
+
+/* the next size up from @f that is worth keeping whole, 0 if none */
+static unsigned long long next_fault_size(unsigned long long f)
+{
+	unsigned long long g = 0;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(fault_sizes); i++)
+		if (fault_sizes[i] > f)
+			g = fault_sizes[i];
+	return g;
+}
+
+static unsigned long long target_fault_size(struct plan_dev *dev,
+		unsigned long region_align)
+{
+	unsigned int i;
+
+	if (dev->align)
+		return dev->align;
+	for (i = 0; i < ARRAY_SIZE(fault_sizes); i++)
+		if (fault_sizes[i] >= region_align
+				&& IS_ALIGNED(dev->size, fault_sizes[i]))
+			return fault_sizes[i];
+	return region_align;
+}
+
+static int plan_dev(struct free_list *fl, struct plan_dev *dev,
+		unsigned long region_align)
+{
+	unsigned long long f = target_fault_size(dev, region_align);
+	struct free_list try;
+	int rc;
+
+	for (;;) {
+		rc = free_list_copy(&try, fl);
+		if (rc)
+			return rc;
+		rc = plan_alloc(&try, dev, f, next_fault_size(f));
+		if (rc == 0) {
+			free(fl->r);
+			*fl = try;
+			dev->fault_size = f;
+			plan_merge(dev);
+			return 0;
+		}
+		free(try.r);
+		free(dev->maps);
+		dev->maps = NULL;
+		dev->nmaps = 0;
+		if (rc != -ENOSPC || dev->align || f <= region_align)
+			return rc;
+		/* drop to the next smaller fault size the size allows */
+		do {
+			f = f == SZ_1G ? SZ_2M : region_align;
+		} while (f > region_align && !IS_ALIGNED(dev->size, f));
+	}
+}
+
+static int plan_order_cmp(const void *a, const void *b)
+{
+	const struct plan_dev *d1 = *(const struct plan_dev **) a;
+	const struct plan_dev *d2 = *(const struct plan_dev **) b;
+
+	if (d1->fault_size != d2->fault_size)
+		return d1->fault_size < d2->fault_size ? 1 : -1;
+	if (d1->size != d2->size)
+		return d1->size < d2->size ? 1 : -1;
+	return 0;
+}
+
+/**
+ * plan_mappings - place devices in a region's free space
+ * @avail: free spans of the region, in address order
+ * @nr_avail: number of entries in @avail
+ * @region_align: allocation granularity of the region
+ * @devs: devices to place, see struct plan_dev
+ * @nr_devs: number of entries in @devs
+ *
+ * Returns 0 with every device planned, or -ENOSPC if one does not fit,
+ * in which case nothing is kept. Sizes and requested alignments must be
+ * multiples of @region_align.
+ */
+int plan_mappings(const struct plan_range *avail, int nr_avail,
+		unsigned long region_align, struct plan_dev *devs, int nr_devs)
+{
+	struct free_list fl = { .nr = nr_avail };
+	struct plan_dev **order;
+	int i, rc = 0;
+
+	if (!region_align)
+		region_align = SZ_4K;
+	for (i = 0; i < nr_devs; i++) {
+		if (!devs[i].size || !IS_ALIGNED(devs[i].size, region_align)
+				|| (devs[i].align && !IS_ALIGNED(devs[i].size,
+						devs[i].align)))
+			return -EINVAL;
+		/* sort key until planned */
+		devs[i].fault_size = target_fault_size(&devs[i], region_align);
+	}
+
+	fl.r = malloc((nr_avail + 1) * sizeof(*fl.r));
+	order = calloc(nr_devs, sizeof(*order));
+	if (!fl.r || !order) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	memcpy(fl.r, avail, nr_avail * sizeof(*fl.r));
+	for (i = 0; i < nr_devs; i++)
+		order[i] = &devs[i];
+	qsort(order, nr_devs, sizeof(*order), plan_order_cmp);
+
+	for (i = 0; i < nr_devs && rc == 0; i++)
+		rc = plan_dev(&fl, order[i], region_align);
+
+	if (rc)
+		for (i = 0; i < nr_devs; i++) {
+			free(devs[i].maps);
+			devs[i].maps = NULL;
+			devs[i].nmaps = 0;
+		}
+out:
+	free(order);
+	free(fl.r);
+	return rc;
+}
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _DAXCTL_PLAN_H_
+#define _DAXCTL_PLAN_H_
+
+/* one range of a device, @end inclusive as in the 'mapping' attribute */
+struct mapping {
+	unsigned long long start, end, pgoff;
+};
+
+/* a free span of a region, @end inclusive */
+struct plan_range {
+	unsigned long long start, end;
+};
+
+/**
+ * struct plan_dev - a device to carve out of a region's free space
+ * @size: requested size
+ * @align: fault size to plan for, 0 to pick the largest that fits
+ * @maps: chosen ranges ordered by page offset, adjacent ones merged
+ * @nmaps: number of entries in @maps
+ * @fault_size: largest fault size every range is aligned for, the
+ *	alignment to give the device
+ */
+struct plan_dev {
+	unsigned long long size;
+	unsigned long long align;
+	struct mapping *maps;
+	int nmaps;
+	unsigned long long fault_size;
+};
+
+int plan_mappings(const struct plan_range *avail, int nr_avail,
+		unsigned long region_align, struct plan_dev *devs, int nr_devs);
+
+#endif /* _DAXCTL_PLAN_H_ */
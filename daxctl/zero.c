@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <util/size.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <json-c/json.h>
+#include <daxctl/libdaxctl.h>
+#include <daxctl/memops.h>
+#include <util/pool.h>
+#include <util/parse-options.h>
+#include <ccan/minmax/minmax.h>
+
+static struct {
+	const char *region;
+	unsigned int jobs;
+	bool human;
+	bool verbose;
+} param;
+
+static unsigned long flags;
+
+static const struct option zero_options[] = {
+	OPT_STRING('r', "region", &param.region, "region-id", "filter by region"),
+	OPT_UINTEGER('j', "jobs", &param.jobs,
+			"threads per device (default: one per cpu of its node)"),
+	OPT_BOOLEAN('u', "human", &param.human, "use human friendly number formats"),
+	OPT_BOOLEAN('v', "verbose", &param.verbose, "emit more debug messages"),
+	OPT_END(),
+};
+
+/* work is handed out to the threads this many bytes at a time */
+#define ZERO_CHUNK SZ_64M
+
+struct zero_job {
+	char *addr;
+	size_t size;
+	/* write back whatever the stores leave in the cache */
+	bool flush;
+	int nr;
+	int next;
+	bool cached;
+	int rc;
+};
+
+static void *zero_worker(void *arg)
+{
+	struct zero_job *z = arg;
+	size_t off, len;
+	int i;
+
+	while ((i = __atomic_fetch_add(&z->next, 1, __ATOMIC_RELAXED))
+			< z->nr) {
+		off = (size_t) i * ZERO_CHUNK;
+		len = min_t(size_t, ZERO_CHUNK, z->size - off);
+		if (mem_zero_nt(z->addr + off, len))
+			continue;
+		__atomic_store_n(&z->cached, true, __ATOMIC_RELAXED);
+		if (z->flush && mem_flush(z->addr + off, len) < 0)
+			__atomic_store_n(&z->rc, -EOPNOTSUPP,
+					__ATOMIC_RELAXED);
+	}
+	/* stores are only ordered per cpu, each worker drains its own */
+	mem_drain();
+	return NULL;
+}
+
+static const char *persistence_domain_str(enum daxctl_persistence_domain pd)
+{
+	switch (pd) {
+	case DAXCTL_PERSISTENCE_CPU_CACHE:
+		return "cpu_cache";
+	case DAXCTL_PERSISTENCE_MEM_CTRL:
+		return "memory_controller";
+	case DAXCTL_PERSISTENCE_NONE:
+		return "none";
+	default:
+		return "volatile";
+	}
+}
+
+/*
+ * The device is mapped whole and zeroed by threads on the cpus of its
+ * target node, or unbound ones when the node has no cpus, as is usual
+ * for CXL memory. Faulting the mapping in is part of the work, so the
+ * page tables end up node local too. Stores bypass the cache where the
+ * cpu allows, and anything left cached is written back unless the
+ * region is volatile or its persistence domain includes the cache.
+ */
+static int do_zero(struct daxctl_dev *dev, struct json_object *jdevs)
+{
+	struct daxctl_region *region = daxctl_dev_get_region(dev);
+	enum daxctl_persistence_domain pd =
+		daxctl_region_get_persistence_domain(region);
+	int i, rc, nr_threads, node = daxctl_dev_get_target_node(dev);
+	const char *devname = daxctl_dev_get_devname(dev);
+	struct zero_job z = { 0 };
+	unsigned long long start, ns;
+	struct json_object *jdev;
+	struct daxctl_map *map;
+	pthread_t *threads;
+	pthread_attr_t attr;
+	bool bound = false;
+	cpu_set_t cpus;
+
+	if (daxctl_dev_get_memory(dev)) {
+		fprintf(stderr, "%s: in system-ram mode, not zeroed\n",
+				devname);
+		return -EBUSY;
+	}
+	if (!daxctl_dev_is_enabled(dev)) {
+		fprintf(stderr, "%s: not enabled, not zeroed\n", devname);
+		return -ENXIO;
+	}
+
+	rc = daxctl_dev_mmap(dev, 0, 0, 0, &map);
+	if (rc) {
+		fprintf(stderr, "%s: mmap failed: %s\n", devname,
+				strerror(-rc));
+		return rc;
+	}
+	z.addr = daxctl_map_get_addr(map);
+	z.size = daxctl_map_get_size(map);
+	z.nr = (z.size + ZERO_CHUNK - 1) / ZERO_CHUNK;
+	z.flush = pd == DAXCTL_PERSISTENCE_MEM_CTRL
+		|| pd == DAXCTL_PERSISTENCE_NONE;
+
+	nr_threads = node >= 0 ? node_get_cpus(node, &cpus) : -ENXIO;
+	bound = nr_threads > 0;
+	/* util_pool_jobs() has 0 mean one per online cpu */
+	if (param.jobs || !bound)
+		nr_threads = param.jobs;
+	nr_threads = min_t(int, util_pool_jobs(nr_threads), z.nr);
+
+	start = now_ns();
+	threads = calloc(nr_threads, sizeof(*threads));
+	pthread_attr_init(&attr);
+	if (bound)
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	for (i = 0; threads && i < nr_threads; i++)
+		if (pthread_create(&threads[i], &attr, zero_worker, &z))
+			break;
+	pthread_attr_destroy(&attr);
+	/* only if no thread started, the rest is left to the node's cpus */
+	if (i == 0)
+		zero_worker(&z);
+	nr_threads = max(i, 1);
+	while (threads && i--)
+		pthread_join(threads[i], NULL);
+	free(threads);
+	ns = max(now_ns() - start, 1ULL);
+	daxctl_map_unmap(map);
+
+	if (z.rc)
+		fprintf(stderr, "%s: zeroed, but no cache flush on this cpu, it may not persist\n",
+				devname);
+
+	jdev = json_object_new_object();
+	if (!jdev)
+		return -ENOMEM;
+	json_object_object_add(jdev, "chardev",
+			json_object_new_string(devname));
+	json_object_object_add(jdev, "size",
+			util_json_object_size(z.size, flags));
+	json_object_object_add(jdev, "threads",
+			json_object_new_int(nr_threads));
+	json_object_object_add(jdev, "numa_bound",
+			json_object_new_boolean(bound));
+	json_object_object_add(jdev, "persistence_domain",
+			json_object_new_string(persistence_domain_str(pd)));
+	json_object_object_add(jdev, "non_temporal",
+			json_object_new_boolean(!z.cached));
+	if (z.cached && z.flush && !z.rc)
+		json_object_object_add(jdev, "flushed",
+				json_object_new_boolean(true));
+	json_object_object_add(jdev, "time_us",
+			json_object_new_int64(ns / 1000));
+	/* bytes per ns times 1000 is MB/s */
+	json_object_object_add(jdev, "bandwidth_mbps",
+			json_object_new_int64(z.size * 1000ULL / ns));
+	json_object_array_add(jdevs, jdev);
+
+	return 0;
+}
+
+int cmd_zero_device(int argc, const char **argv, struct daxctl_ctx *ctx)
+{
+	const char * const u[] = {
+		"daxctl zero-device <device> [<options>]",
+		NULL
+	};
+	struct json_object *jdevs;
+	struct daxctl_region *region;
+	const char *device;
+	struct daxctl_dev *dev;
+	int i, rc = -ENXIO, processed = 0;
+
+	argc = parse_options(argc, argv, zero_options, u, 0);
+	for (i = 1; i < argc; i++)
+		fprintf(stderr, "unknown extra parameter \"%s\"\n", argv[i]);
+	if (argc != 1)
+		usage_with_options(u, zero_options);
+	device = argv[0];
+	if (param.human)
+		flags |= UTIL_JSON_HUMAN;
+	if (param.verbose)
+		daxctl_set_log_priority(ctx, LOG_DEBUG);
+
+	jdevs = json_object_new_array();
+	if (!jdevs)
+		return -ENOMEM;
+
+	daxctl_region_foreach(ctx, region) {
+		if (!util_daxctl_region_filter(region, param.region))
+			continue;
+
+		daxctl_dev_foreach(region, dev) {
+			if (!util_daxctl_dev_filter(dev, device))
+				continue;
+			/* nothing to zero in an idle seed */
+			if (!daxctl_dev_get_size(dev))
+				continue;
+			rc = do_zero(dev, jdevs);
+			if (rc == 0)
+				processed++;
+		}
+	}
+
+	if (processed)
+		util_display_json_array(stdout, jdevs, flags);
+	else
+		json_object_put(jdevs);
+	fprintf(stderr, "zeroed %d device%s\n", processed,
+			processed == 1 ? "" : "s");
+
+	return rc;
+}
@@ -14,5 +14,8 @@ enum device_action {
 	ACTION_ACTIVATE,
 	ACTION_READ_INFOBLOCK,
 	ACTION_WRITE_INFOBLOCK,
+	ACTION_CHECK_MAPPING,
+	ACTION_CONVERT,
+	ACTION_BENCH,
 };
 #endif /* __NDCTL_ACTION_H__ */
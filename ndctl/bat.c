@@ -8,6 +8,7 @@
 
 int cmd_bat(int argc, const char **argv, struct ndctl_ctx *ctx)
 {
+	const char *timing = NULL, *baseline = NULL;
 	int loglevel = LOG_DEBUG, i, rc;
 	struct test_ctx *test;
 	bool force = false;
@@ -20,6 +21,10 @@ int cmd_bat(int argc, const char **argv, struct ndctl_ctx *ctx)
 		"set the log level (default LOG_DEBUG)"),
 	OPT_BOOLEAN('f', "force", &force,
 		"force run all tests regardless of required kernel"),
+	OPT_STRING('t', "timing", &timing, "file",
+		"append per-step wall times to <file>"),
+	OPT_STRING('b', "baseline", &baseline, "file",
+		"fail steps more than 3x slower than in <file>, see NDCTL_TEST_SLOWDOWN"),
 	OPT_END(),
 	};
 
@@ -40,6 +45,7 @@ int cmd_bat(int argc, const char **argv, struct ndctl_ctx *ctx)
 		fprintf(stderr, "failed to initialize test\n");
 		return EXIT_FAILURE;
 	}
+	test_set_timing(test, "bat", timing, baseline);
 
 	rc = test_blk_namespaces(loglevel, test, ctx);
 	fprintf(stderr, "test_blk_namespaces: %s\n", rc ? "FAIL" : "PASS");
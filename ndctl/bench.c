@@ -0,0 +1,575 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <util/size.h>
+#include <util/json.h>
+#include <util/filter.h>
+#include <ccan/array_size/array_size.h>
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include "bench.h"
+
+/*
+ * 'ndctl bench-namespace' drives O_DIRECT reads and writes through
+ * io_uring at the block device of a raw, sector or fsdax namespace.
+ * Every workload, block size and queue depth makes one job, and each
+ * job's results are kept across namespaces so that the report puts,
+ * say, a 512 and a 4096 byte sector BTT side by side.
+ */
+
+static const char * const workload_names[] = {
+	[BENCH_READ] = "read",
+	[BENCH_WRITE] = "write",
+	[BENCH_RANDREAD] = "randread",
+	[BENCH_RANDWRITE] = "randwrite",
+};
+
+static bool workload_is_write(int w)
+{
+	return w == BENCH_WRITE || w == BENCH_RANDWRITE;
+}
+
+static bool workload_is_random(int w)
+{
+	return w == BENCH_RANDREAD || w == BENCH_RANDWRITE;
+}
+
+int bench_parse(struct bench_ctx *bctx, const char *workloads,
+		const char *block_sizes, const char *queue_depths)
+{
+	char *buf, *tok, *save;
+	unsigned long long val;
+	int rc = 0;
+	unsigned int i;
+
+	buf = strdup(workloads);
+	if (!buf)
+		return -ENOMEM;
+	for (tok = strtok_r(buf, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save)) {
+		for (i = 0; i < ARRAY_SIZE(workload_names); i++)
+			if (strcmp(tok, workload_names[i]) == 0)
+				break;
+		if (i >= ARRAY_SIZE(workload_names)) {
+			fprintf(stderr, "unknown workload '%s'\n", tok);
+			rc = -EINVAL;
+			goto out;
+		}
+		bctx->workloads |= 1 << i;
+	}
+	free(buf);
+
+	buf = strdup(block_sizes);
+	if (!buf)
+		return -ENOMEM;
+	for (tok = strtok_r(buf, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save)) {
+		val = parse_size64(tok);
+		if (val == ULLONG_MAX || val < 512 || val % 512 || val > SZ_1G
+				|| bctx->nr_block_sizes >= BENCH_MAX_SIZES) {
+			fprintf(stderr, "invalid block size '%s'\n", tok);
+			rc = -EINVAL;
+			goto out;
+		}
+		bctx->block_sizes[bctx->nr_block_sizes++] = val;
+	}
+	free(buf);
+
+	buf = strdup(queue_depths);
+	if (!buf)
+		return -ENOMEM;
+	for (tok = strtok_r(buf, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save)) {
+		val = strtoul(tok, NULL, 0);
+		if (!val || val > 4096
+				|| bctx->nr_queue_depths >= BENCH_MAX_DEPTHS) {
+			fprintf(stderr, "invalid queue depth '%s'\n", tok);
+			rc = -EINVAL;
+			goto out;
+		}
+		bctx->queue_depths[bctx->nr_queue_depths++] = val;
+	}
+out:
+	free(buf);
+	if (rc == 0 && (!bctx->workloads || !bctx->nr_block_sizes
+				|| !bctx->nr_queue_depths))
+		rc = -EINVAL;
+	return rc;
+}
+
+/*
+ * Latencies go in a log-linear histogram: exact below 64ns, then 32
+ * buckets per power of two, so every percentile is within about 3% of
+ * the latency actually seen, whatever the number of I/Os.
+ */
+#define LAT_SUB 32
+#define LAT_BUCKETS (64 * LAT_SUB)
+
+struct bench_result {
+	unsigned long long ios;
+	unsigned long long lat_max;
+	unsigned long long elapsed;
+	unsigned long long hist[LAT_BUCKETS];
+};
+
+static unsigned int lat_bucket(unsigned long long ns)
+{
+	unsigned int shift;
+
+	if (ns < 2 * LAT_SUB)
+		return ns;
+	shift = 63 - __builtin_clzll(ns) - 5;
+	return (shift + 1) * LAT_SUB + ((ns >> shift) - LAT_SUB);
+}
+
+static unsigned long long lat_value(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < 2 * LAT_SUB)
+		return idx;
+	shift = idx / LAT_SUB - 1;
+	return (unsigned long long) (idx % LAT_SUB + LAT_SUB) << shift;
+}
+
+static unsigned long long lat_percentile(struct bench_result *res,
+		double pct)
+{
+	unsigned long long want, seen = 0;
+	unsigned int i;
+
+	if (!res->ios)
+		return 0;
+	want = res->ios * pct / 100.0;
+	if (want >= res->ios)
+		want = res->ios - 1;
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += res->hist[i];
+		if (seen > want)
+			return lat_value(i);
+	}
+	return res->lat_max;
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#ifdef HAVE_LIBURING
+struct bench_slot {
+	void *buf;
+	unsigned long long start;
+};
+
+struct bench_job {
+	int fd;
+	int workload;
+	unsigned long bs;
+	unsigned int qd;
+	unsigned long long nr_blocks;
+	unsigned long long next;
+	unsigned long long seed;
+	struct io_uring ring;
+	struct bench_slot *slots;
+};
+
+static unsigned long long job_offset(struct bench_job *job)
+{
+	unsigned long long blk;
+
+	if (workload_is_random(job->workload)) {
+		/* xorshift64 */
+		job->seed ^= job->seed << 13;
+		job->seed ^= job->seed >> 7;
+		job->seed ^= job->seed << 17;
+		blk = job->seed % job->nr_blocks;
+	} else {
+		blk = job->next++;
+		if (job->next >= job->nr_blocks)
+			job->next = 0;
+	}
+	return blk * job->bs;
+}
+
+static int job_queue(struct bench_job *job, unsigned int i)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&job->ring);
+	struct bench_slot *slot = &job->slots[i];
+
+	if (!sqe)
+		return -EBUSY;
+	if (workload_is_write(job->workload))
+		io_uring_prep_write(sqe, job->fd, slot->buf, job->bs,
+				job_offset(job));
+	else
+		io_uring_prep_read(sqe, job->fd, slot->buf, job->bs,
+				job_offset(job));
+	io_uring_sqe_set_data(sqe, (void *) (uintptr_t) i);
+	slot->start = now_ns();
+	return 0;
+}
+
+static int job_run(struct bench_job *job, unsigned int runtime,
+		struct bench_result *res)
+{
+	unsigned long long start, deadline, t, lat;
+	unsigned int i, inflight = 0;
+	struct io_uring_cqe *cqe;
+	int rc = 0;
+
+	for (i = 0; i < job->qd; i++) {
+		rc = job_queue(job, i);
+		if (rc)
+			return rc;
+		inflight++;
+	}
+
+	start = now_ns();
+	deadline = start + runtime * 1000000000ULL;
+	while (inflight) {
+		rc = io_uring_submit_and_wait(&job->ring, 1);
+		if (rc < 0 && rc != -EINTR)
+			break;
+		rc = 0;
+		while (io_uring_peek_cqe(&job->ring, &cqe) == 0) {
+			i = (uintptr_t) io_uring_cqe_get_data(cqe);
+			if (cqe->res != (int) job->bs && !rc)
+				rc = cqe->res < 0 ? cqe->res : -EIO;
+			io_uring_cqe_seen(&job->ring, cqe);
+			inflight--;
+
+			t = now_ns();
+			lat = t - job->slots[i].start;
+			res->ios++;
+			res->hist[lat_bucket(lat)]++;
+			if (lat > res->lat_max)
+				res->lat_max = lat;
+
+			if (rc || t >= deadline)
+				continue;
+			if (job_queue(job, i) == 0)
+				inflight++;
+		}
+		if (rc)
+			break;
+	}
+	res->elapsed = now_ns() - start;
+
+	/* reap whatever an error left in flight before the ring goes */
+	while (inflight && io_uring_wait_cqe(&job->ring, &cqe) == 0) {
+		io_uring_cqe_seen(&job->ring, cqe);
+		inflight--;
+	}
+	return rc;
+}
+
+static int bench_one(int fd, int workload, unsigned long bs, unsigned int qd,
+		unsigned long long size, unsigned int runtime,
+		struct bench_result *res)
+{
+	struct bench_job job = {
+		.fd = fd,
+		.workload = workload,
+		.bs = bs,
+		.qd = qd,
+		.nr_blocks = size / bs,
+		.seed = now_ns() | 1,
+	};
+	unsigned int i;
+	int rc;
+
+	if (!job.nr_blocks)
+		return -ENOSPC;
+	job.slots = calloc(qd, sizeof(*job.slots));
+	if (!job.slots)
+		return -ENOMEM;
+	for (i = 0; i < qd; i++) {
+		/* O_DIRECT wants the buffer aligned to the logical block */
+		if (posix_memalign(&job.slots[i].buf, SZ_4K, bs)) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		memset(job.slots[i].buf, 0x5a, bs);
+	}
+
+	rc = io_uring_queue_init(qd, &job.ring, 0);
+	if (rc < 0)
+		goto out;
+	rc = job_run(&job, runtime, res);
+	io_uring_queue_exit(&job.ring);
+out:
+	for (i = 0; i < qd; i++)
+		free(job.slots[i].buf);
+	free(job.slots);
+	return rc;
+}
+#else
+static int bench_one(int fd, int workload, unsigned long bs, unsigned int qd,
+		unsigned long long size, unsigned int runtime,
+		struct bench_result *res)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+static struct json_object *result_to_json(struct ndctl_namespace *ndns,
+		const char *bdev, unsigned int sector_size,
+		unsigned long bs, struct bench_result *res,
+		unsigned long flags)
+{
+	static const struct {
+		const char *name;
+		double pct;
+	} pcts[] = {
+		{ "p50", 50.0 }, { "p90", 90.0 }, { "p99", 99.0 },
+		{ "p99.9", 99.9 },
+	};
+	struct json_object *jres, *jlat, *jobj;
+	double secs = res->elapsed / 1e9;
+	unsigned int i;
+
+	jres = json_object_new_object();
+	if (!jres)
+		return NULL;
+	jobj = json_object_new_string(ndctl_namespace_get_devname(ndns));
+	if (jobj)
+		json_object_object_add(jres, "dev", jobj);
+	jobj = json_object_new_string(bdev);
+	if (jobj)
+		json_object_object_add(jres, "blockdev", jobj);
+	jobj = json_object_new_string(
+			util_nsmode_name(ndctl_namespace_get_mode(ndns)));
+	if (jobj)
+		json_object_object_add(jres, "mode", jobj);
+	jobj = json_object_new_int(sector_size);
+	if (jobj)
+		json_object_object_add(jres, "sector_size", jobj);
+	jobj = json_object_new_int64(secs ? res->ios / secs : 0);
+	if (jobj)
+		json_object_object_add(jres, "iops", jobj);
+	jobj = util_json_object_size(secs ? res->ios * bs / secs : 0, flags);
+	if (jobj)
+		json_object_object_add(jres, "bandwidth", jobj);
+
+	jlat = json_object_new_object();
+	if (!jlat)
+		return jres;
+	for (i = 0; i < ARRAY_SIZE(pcts); i++) {
+		jobj = json_object_new_double(
+				lat_percentile(res, pcts[i].pct) / 1000.0);
+		if (jobj)
+			json_object_object_add(jlat, pcts[i].name, jobj);
+	}
+	jobj = json_object_new_double(res->lat_max / 1000.0);
+	if (jobj)
+		json_object_object_add(jlat, "max", jobj);
+	json_object_object_add(jres, "latency_us", jlat);
+	return jres;
+}
+
+static struct json_object *bench_job_get(struct bench_ctx *bctx, int w,
+		int b, int q)
+{
+	int idx = (w * BENCH_MAX_SIZES + b) * BENCH_MAX_DEPTHS + q;
+	struct json_object *jjob, *jobj;
+
+	if (bctx->jobs[idx])
+		return bctx->jobs[idx];
+	jjob = json_object_new_object();
+	if (!jjob)
+		return NULL;
+	jobj = json_object_new_string(workload_names[w]);
+	if (jobj)
+		json_object_object_add(jjob, "workload", jobj);
+	jobj = util_json_object_size(bctx->block_sizes[b], bctx->flags);
+	if (jobj)
+		json_object_object_add(jjob, "block_size", jobj);
+	jobj = json_object_new_int(bctx->queue_depths[q]);
+	if (jobj)
+		json_object_object_add(jjob, "queue_depth", jobj);
+	jobj = json_object_new_array();
+	if (!jobj) {
+		json_object_put(jjob);
+		return NULL;
+	}
+	json_object_object_add(jjob, "results", jobj);
+	bctx->jobs[idx] = jjob;
+	return jjob;
+}
+
+static const char *namespace_bdev(struct ndctl_namespace *ndns,
+		unsigned int *sector_size)
+{
+	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
+	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
+	unsigned int ss;
+
+	if (btt) {
+		*sector_size = ndctl_btt_get_sector_size(btt);
+		return ndctl_btt_get_block_device(btt);
+	}
+	ss = ndctl_namespace_get_sector_size(ndns);
+	*sector_size = (!ss || ss == UINT_MAX) ? 512 : ss;
+	if (pfn)
+		return ndctl_pfn_get_block_device(pfn);
+	if (ndctl_namespace_get_dax(ndns))
+		return NULL;
+	return ndctl_namespace_get_block_device(ndns);
+}
+
+int namespace_bench(struct ndctl_namespace *ndns, struct bench_ctx *bctx,
+		bool verbose)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	struct json_object *jjob, *jresults, *jres;
+	unsigned long long size;
+	struct bench_result *res;
+	unsigned int sector_size;
+	int w, b, q, fd, rc = 0;
+	const char *bdev;
+	char path[50];
+
+	bdev = namespace_bdev(ndns, &sector_size);
+	if (!bdev || !*bdev) {
+		if (verbose)
+			fprintf(stderr, "%s: no block device to benchmark\n",
+					devname);
+		return -EOPNOTSUPP;
+	}
+	snprintf(path, sizeof(path), "/dev/%s", bdev);
+
+	/* O_EXCL keeps writes off a block device with a mounted fs */
+	if (bctx->workloads & (1 << BENCH_WRITE | 1 << BENCH_RANDWRITE))
+		fd = open(path, O_RDWR | O_DIRECT | O_EXCL);
+	else
+		fd = open(path, O_RDONLY | O_DIRECT);
+	if (fd < 0) {
+		rc = -errno;
+		fprintf(stderr, "%s: failed to open %s: %s\n", devname, path,
+				strerror(errno));
+		return rc;
+	}
+	if (ioctl(fd, BLKGETSIZE64, &size) < 0) {
+		rc = -errno;
+		goto out;
+	}
+	if (bctx->size && bctx->size < size)
+		size = bctx->size;
+
+	res = malloc(sizeof(*res));
+	if (!res) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	for (w = 0; w < BENCH_WORKLOADS; w++) {
+		if (!(bctx->workloads & (1 << w)))
+			continue;
+		for (b = 0; b < bctx->nr_block_sizes; b++) {
+			unsigned long bs = bctx->block_sizes[b];
+
+			if (bs % sector_size) {
+				fprintf(stderr, "%s: skipping %lu byte I/O, below its %u byte sectors\n",
+						devname, bs, sector_size);
+				continue;
+			}
+			for (q = 0; q < bctx->nr_queue_depths; q++) {
+				unsigned int qd = bctx->queue_depths[q];
+
+				if (verbose)
+					fprintf(stderr, "%s: %s bs=%lu qd=%u\n",
+						devname, workload_names[w],
+						bs, qd);
+				memset(res, 0, sizeof(*res));
+				rc = bench_one(fd, w, bs, qd, size,
+						bctx->runtime, res);
+				if (rc < 0) {
+					fprintf(stderr, "%s: %s bs=%lu qd=%u failed: %s\n",
+						devname, workload_names[w],
+						bs, qd, strerror(-rc));
+					goto out_free;
+				}
+				jjob = bench_job_get(bctx, w, b, q);
+				if (!jjob || !json_object_object_get_ex(jjob,
+							"results", &jresults))
+					continue;
+				jres = result_to_json(ndns, bdev, sector_size,
+						bs, res, bctx->flags);
+				if (jres)
+					json_object_array_add(jresults, jres);
+			}
+		}
+	}
+out_free:
+	free(res);
+out:
+	close(fd);
+	return rc;
+}
+
+/*
+ * One entry per job, with every namespace's result ranked against the
+ * fastest of them as "relative_iops".
+ */
+struct json_object *bench_report(struct bench_ctx *bctx)
+{
+	struct json_object *jreport, *jresults, *jres, *jobj;
+	long long iops, best;
+	unsigned int i;
+	int j, n;
+
+	jreport = json_object_new_array();
+	if (!jreport)
+		return NULL;
+	for (i = 0; i < ARRAY_SIZE(bctx->jobs); i++) {
+		if (!bctx->jobs[i])
+			continue;
+		json_object_object_get_ex(bctx->jobs[i], "results", &jresults);
+		n = json_object_array_length(jresults);
+		best = 0;
+		for (j = 0; j < n; j++) {
+			jres = json_object_array_get_idx(jresults, j);
+			if (json_object_object_get_ex(jres, "iops", &jobj)
+					&& json_object_get_int64(jobj) > best)
+				best = json_object_get_int64(jobj);
+		}
+		for (j = 0; best && j < n; j++) {
+			jres = json_object_array_get_idx(jresults, j);
+			if (!json_object_object_get_ex(jres, "iops", &jobj))
+				continue;
+			iops = json_object_get_int64(jobj);
+			jobj = json_object_new_double((double) iops / best);
+			if (jobj)
+				json_object_object_add(jres, "relative_iops",
+						jobj);
+		}
+		json_object_array_add(jreport, bctx->jobs[i]);
+		bctx->jobs[i] = NULL;
+	}
+	return jreport;
+}
+
+void bench_free(struct bench_ctx *bctx)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(bctx->jobs); i++) {
+		json_object_put(bctx->jobs[i]);
+		bctx->jobs[i] = NULL;
+	}
+}
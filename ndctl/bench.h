@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __NDCTL_BENCH_H__
+#define __NDCTL_BENCH_H__
+#include <stdbool.h>
+#include <json-c/json.h>
+#include <ndctl/libndctl.h>
+
+enum bench_workload {
+	BENCH_READ,
+	BENCH_WRITE,
+	BENCH_RANDREAD,
+	BENCH_RANDWRITE,
+	BENCH_WORKLOADS,
+};
+
+#define BENCH_MAX_SIZES 8
+#define BENCH_MAX_DEPTHS 8
+
+/**
+ * struct bench_ctx - what 'ndctl bench-namespace' runs, and has measured
+ * @workloads: bitmask of enum bench_workload to run
+ * @block_sizes: I/O sizes, each run against every queue depth
+ * @queue_depths: I/Os kept in flight
+ * @runtime: seconds per job
+ * @size: bytes of the device to span, 0 for all of it
+ * @flags: UTIL_JSON_* flags for the report
+ * @jobs: one report entry per workload, block size and queue depth,
+ *	holding the results of every namespace benchmarked
+ */
+struct bench_ctx {
+	unsigned int workloads;
+	unsigned long block_sizes[BENCH_MAX_SIZES];
+	int nr_block_sizes;
+	unsigned int queue_depths[BENCH_MAX_DEPTHS];
+	int nr_queue_depths;
+	unsigned int runtime;
+	unsigned long long size;
+	unsigned long flags;
+	struct json_object *jobs[BENCH_WORKLOADS * BENCH_MAX_SIZES
+		* BENCH_MAX_DEPTHS];
+};
+
+int bench_parse(struct bench_ctx *bctx, const char *workloads,
+		const char *block_sizes, const char *queue_depths);
+int namespace_bench(struct ndctl_namespace *ndns, struct bench_ctx *bctx,
+		bool verbose);
+struct json_object *bench_report(struct bench_ctx *bctx);
+void bench_free(struct bench_ctx *bctx);
+#endif /* __NDCTL_BENCH_H__ */
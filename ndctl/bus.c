@@ -3,7 +3,10 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
 #include "action.h"
 #include <syslog.h>
 #include <builtin.h>
@@ -19,11 +22,30 @@ static struct {
 	bool force;
 	bool idle;
 	bool dryrun;
+	bool probe;
 	unsigned int poll_interval;
 } param = {
 	.idle = true,
 };
 
+/*
+ * How long the last activation held up the system. @activate_ns is the
+ * wall time of the activate write. With --probe a helper thread spins
+ * on the clock meanwhile, any gap between two of its reads over
+ * FWA_STALL_NS is time it was kept off the cpu, by the platform
+ * quiesce, the suspend cycle, or the scheduler.
+ */
+struct fwa_pause {
+	bool valid;
+	unsigned long long activate_ns;
+	unsigned long long max_gap_ns;
+	unsigned long long stall_ns;
+	unsigned int stalls;
+};
+static struct fwa_pause pause_stats;
+
+#define FWA_STALL_NS 100000ULL
+
 
 #define BASE_OPTIONS() \
 	OPT_BOOLEAN('v',"verbose", &param.verbose, "turn on debug")
@@ -36,7 +58,9 @@ static struct {
 			"allow platform-injected idle over activate (default)"), \
 	OPT_BOOLEAN('f', "force", &param.force, "try to force live activation"), \
 	OPT_BOOLEAN('n', "dry-run", &param.dryrun, \
-			"perform all setup/validation steps, skip the activate")
+			"perform all setup/validation steps, skip the activate"), \
+	OPT_BOOLEAN('P', "probe", &param.probe, \
+			"measure the stall with a timestamp gap probe thread")
 
 static const struct option start_options[] = {
 	BASE_OPTIONS(),
@@ -55,6 +79,91 @@ static const struct option activate_options[] = {
 	OPT_END(),
 };
 
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct fwa_probe {
+	struct fwa_pause *pause;
+	bool stop;
+};
+
+static void *fwa_probe_run(void *arg)
+{
+	struct fwa_probe *probe = arg;
+	struct fwa_pause *pause = probe->pause;
+	unsigned long long last = now_ns(), t, gap;
+
+	while (!__atomic_load_n(&probe->stop, __ATOMIC_ACQUIRE)) {
+		t = now_ns();
+		gap = t - last;
+		last = t;
+		if (gap > pause->max_gap_ns)
+			pause->max_gap_ns = gap;
+		if (gap > FWA_STALL_NS) {
+			pause->stall_ns += gap;
+			pause->stalls++;
+		}
+	}
+	return NULL;
+}
+
+static int activate_timed(struct ndctl_bus *bus, enum ndctl_fwa_method method)
+{
+	struct fwa_probe probe = { .pause = &pause_stats };
+	unsigned long long start;
+	pthread_t thread;
+	bool probing;
+	int rc;
+
+	memset(&pause_stats, 0, sizeof(pause_stats));
+	probing = param.probe
+		&& pthread_create(&thread, NULL, fwa_probe_run, &probe) == 0;
+	if (param.probe && !probing)
+		fprintf(stderr, "%s: failed to start the stall probe\n",
+				ndctl_bus_get_devname(bus));
+
+	start = now_ns();
+	rc = ndctl_bus_activate_firmware(bus, method);
+	pause_stats.activate_ns = now_ns() - start;
+
+	if (probing) {
+		__atomic_store_n(&probe.stop, true, __ATOMIC_RELEASE);
+		pthread_join(thread, NULL);
+	}
+	pause_stats.valid = rc == 0;
+	return rc;
+}
+
+static struct json_object *pause_to_json(struct fwa_pause *pause)
+{
+	struct json_object *jpause, *jprobe;
+
+	jpause = json_object_new_object();
+	if (!jpause)
+		return NULL;
+	json_object_object_add(jpause, "activate_us",
+			json_object_new_int64(pause->activate_ns / 1000));
+	if (!param.probe)
+		return jpause;
+
+	jprobe = json_object_new_object();
+	if (!jprobe)
+		return jpause;
+	json_object_object_add(jprobe, "max_gap_us",
+			json_object_new_int64(pause->max_gap_ns / 1000));
+	json_object_object_add(jprobe, "stall_us",
+			json_object_new_int64(pause->stall_ns / 1000));
+	json_object_object_add(jprobe, "stalls",
+			json_object_new_int(pause->stalls));
+	json_object_object_add(jpause, "probe", jprobe);
+	return jpause;
+}
+
 static int activate_firmware(struct ndctl_bus *bus)
 {
 	const char *provider = ndctl_bus_get_provider(bus);
@@ -110,7 +219,7 @@ static int activate_firmware(struct ndctl_bus *bus)
 			goto out;
 		}
 
-		rc = ndctl_bus_activate_firmware(bus, method);
+		rc = activate_timed(bus, method);
 	}
 
 	if (rc) {
@@ -148,9 +257,15 @@ static void collect_result(struct json_object *jbuses, struct ndctl_bus *bus,
 	jbus = util_bus_to_json(bus, flags);
 	if (jbus)
 		json_object_array_add(jbuses, jbus);
-	if (action != ACTION_ACTIVATE)
+	if (action != ACTION_ACTIVATE || !jbus)
 		return;
 
+	if (pause_stats.valid) {
+		json_object_object_add(jbus, "activate_pause",
+				pause_to_json(&pause_stats));
+		pause_stats.valid = false;
+	}
+
 	jdimms = json_object_new_array();
 	if (!jdimms)
 		return;
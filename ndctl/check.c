@@ -8,10 +8,12 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <ndctl.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <util/log.h>
 #include <uuid/uuid.h>
 #include <sys/types.h>
@@ -20,6 +22,7 @@
 #include <util/util.h>
 #include <util/bitmap.h>
 #include <util/fletcher.h>
+#include <util/pool.h>
 #include <ndctl/libndctl.h>
 #include <ndctl/namespace.h>
 #include <ccan/endian/endian.h>
@@ -27,11 +30,22 @@
 #include <ccan/array_size/array_size.h>
 #include <ccan/short_types/short_types.h>
 
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 struct check_opts {
 	bool verbose;
 	bool force;
 	bool repair;
 	bool logfix;
+	bool stream;
+	bool quick;
+	bool resume;
+	const char *checkpoint;
+	unsigned int jobs;
 };
 
 struct btt_chk {
@@ -69,12 +83,19 @@ struct arena_info {
 	int num;
 	struct btt_chk *bttc;
 	int log_index[2];
+	/* --stream: map entries that could not be read, and a lost log */
+	unsigned long media_errs;
+	bool unreadable;
 };
 
 static sigjmp_buf sj_env;
+/* a scan thread catches its own faults, see btt_scan_worker() */
+static __thread sigjmp_buf *sj_thread;
 
 static void sigbus_hdl(int sig, siginfo_t *siginfo, void *ptr)
 {
+	if (sj_thread)
+		siglongjmp(*sj_thread, 1);
 	siglongjmp(sj_env, 1);
 }
 
@@ -84,6 +105,45 @@ static int repair_msg(struct btt_chk *bttc)
 	return 0;
 }
 
+/*
+ * With --stream nothing is mapped: the info blocks and the log are read
+ * into memory, and the map is read a scan chunk at a time, so a media
+ * error costs the entries it covers rather than the whole pass. A read
+ * that fails is retried BTT_STREAM_UNIT at a time to find what exactly
+ * is unreadable, and those units are zero-filled and marked in @bad.
+ */
+#define BTT_STREAM_UNIT 4096
+
+static size_t btt_stream_read(struct btt_chk *bttc, void *buf, size_t len,
+		u64 off, unsigned long *bad)
+{
+	size_t pos, n, lost = 0;
+
+	if (pread(bttc->fd, buf, len, off) == (ssize_t) len)
+		return 0;
+
+	for (pos = 0; pos < len; pos += n) {
+		n = min_t(size_t, BTT_STREAM_UNIT, len - pos);
+		if (pread(bttc->fd, buf + pos, n, off + pos) == (ssize_t) n)
+			continue;
+		memset(buf + pos, 0, n);
+		if (bad)
+			bitmap_set(bad, pos / BTT_STREAM_UNIT, 1);
+		lost += n;
+	}
+	return lost;
+}
+
+static int btt_stream_write(struct btt_chk *bttc, const void *buf,
+		size_t len, u64 off)
+{
+	if (pwrite(bttc->fd, buf, len, off) != (ssize_t) len)
+		return errno ? -errno : -EIO;
+	if (fdatasync(bttc->fd) < 0)
+		return -errno;
+	return 0;
+}
+
 /**
  * btt_read_info - read an info block from a given offset
  * @bttc:	the main btt_chk structure for this btt
@@ -170,6 +230,9 @@ static int btt_copy_to_info2(struct arena_info *a)
 	}
 	printf("Arena %d: Restoring BTT info2\n", a->num);
 	memcpy(a->map.info2, a->map.info, BTT_INFO_SIZE);
+	if (a->bttc->opts->stream)
+		return btt_stream_write(a->bttc, a->map.info2, BTT_INFO_SIZE,
+				a->info2off);
 
 	ms_align = (void *)rounddown((u64)a->map.info2, a->bttc->sys_page_size);
 	ms_size = max(BTT_INFO_SIZE, a->bttc->sys_page_size);
@@ -186,17 +249,30 @@ static int btt_copy_to_info2(struct arena_info *a)
  *
  * This will correctly account for map entries in the 'initial state'
  */
-static u32 btt_map_lookup(struct arena_info *a, u32 lba)
+static u32 btt_map_decode(u32 raw, u32 lba)
 {
-	u32 raw_mapping;
+	u32 raw_mapping = le32_to_cpu(raw);
 
-	raw_mapping = le32_to_cpu(a->map.map[lba]);
 	if (raw_mapping & MAP_ENT_NORMAL)
 		return raw_mapping & MAP_LBA_MASK;
 	else
 		return lba;
 }
 
+static u32 btt_map_lookup(struct arena_info *a, u32 lba)
+{
+	u32 raw;
+
+	if (a->map.map)
+		return btt_map_decode(a->map.map[lba], lba);
+
+	/* an unreadable entry matches nothing */
+	if (pread(a->bttc->fd, &raw, sizeof(raw), a->mapoff
+				+ (u64) lba * sizeof(raw)) != sizeof(raw))
+		return UINT_MAX;
+	return btt_map_decode(raw, lba);
+}
+
 static int btt_map_write(struct arena_info *a, u32 lba, u32 mapping)
 {
 	void *ms_align;
@@ -216,6 +292,12 @@ static int btt_map_write(struct arena_info *a, u32 lba, u32 mapping)
 	 * indicate a 'normal' map entry
 	 */
 	mapping |= MAP_ENT_NORMAL;
+	if (!a->map.map) {
+		u32 raw = cpu_to_le32(mapping);
+
+		return btt_stream_write(a->bttc, &raw, sizeof(raw),
+				a->mapoff + (u64) lba * sizeof(raw));
+	}
 	a->map.map[lba] = cpu_to_le32(mapping);
 
 	ms_align = (void *)rounddown((u64)&a->map.map[lba],
@@ -236,6 +318,11 @@ static void btt_log_group_write(struct arena_info *a, u32 lane,
 			struct log_group *log)
 {
 	memcpy(&a->map.log[lane], log, LOG_GRP_SIZE);
+	if (a->bttc->opts->stream && btt_stream_write(a->bttc, log,
+				LOG_GRP_SIZE, a->logoff
+				+ (u64) lane * LOG_GRP_SIZE))
+		err(a->bttc, "arena %d: failed to write log lane %u\n",
+				a->num, lane);
 }
 
 static u32 log_seq(struct log_group *log, int log_idx)
@@ -432,20 +519,383 @@ static int btt_check_log_entries(struct arena_info *a)
 	return rc;
 }
 
-/* Check that map entries are self consistent */
-static int btt_check_map_entries(struct arena_info *a)
+/*
+ * The passes that walk a whole map are read-only, so they are split into
+ * chunks of map entries and handed to a pool of threads: the bounds check
+ * covers every arena at once, the bitmap check one arena at a time, each
+ * thread marking a bitmap of its own that is merged into the arena's at
+ * the end. Everything that may write to the namespace stays in arena
+ * order on the calling thread.
+ */
+#define BTT_SCAN_CHUNK (1U << 20)
+/* per-thread bitmaps beyond this only buy memory pressure */
+#define BTT_SCAN_BM_MAX (256UL << 20)
+
+/*
+ * Map entries are looked at a block at a time, one bitmap word's worth,
+ * so a block of entries in the initial identity state can be marked
+ * with a single store. btt_map_block() reports whether any entry in the
+ * block carries flags, i.e. is not an identity mapping, and whether any
+ * flagged entry points at or past @nlba. Identity entries are always in
+ * bounds since external_nlba <= internal_nlba.
+ */
+#define BTT_SCAN_BLOCK BITS_PER_LONG
+#define BTT_BLK_FLAGGED (1 << 0)
+#define BTT_BLK_OOB (1 << 1)
+
+static unsigned int btt_map_block_generic(const u32 *map, u32 nlba)
+{
+	unsigned int i, rc = 0;
+	u32 raw;
+
+	for (i = 0; i < BTT_SCAN_BLOCK; i++) {
+		raw = le32_to_cpu(map[i]);
+		if (!(raw & MAP_ENT_NORMAL))
+			continue;
+		rc |= BTT_BLK_FLAGGED;
+		if ((raw & MAP_LBA_MASK) >= nlba)
+			rc |= BTT_BLK_OOB;
+	}
+	return rc;
+}
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && defined(__x86_64__)
+static unsigned int btt_map_block(const u32 *map, u32 nlba)
 {
-	unsigned int i;
-	u32 mapping;
+	const __m128i flags = _mm_set1_epi32(MAP_ENT_NORMAL);
+	const __m128i lba_mask = _mm_set1_epi32(MAP_LBA_MASK);
+	/* masked lbas are below 2^30, so a signed compare is exact */
+	const __m128i last = _mm_set1_epi32(min_t(u32, nlba, INT_MAX) - 1);
+	__m128i any = _mm_setzero_si128(), oob = _mm_setzero_si128();
+	const __m128i zero = _mm_setzero_si128();
+	unsigned int i, rc = 0;
+
+	for (i = 0; i < BTT_SCAN_BLOCK; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *) &map[i]);
+		__m128i f = _mm_and_si128(v, flags);
+		__m128i plain = _mm_cmpeq_epi32(f, zero);
+
+		any = _mm_or_si128(any, f);
+		oob = _mm_or_si128(oob, _mm_andnot_si128(plain, _mm_cmpgt_epi32(
+				_mm_and_si128(v, lba_mask), last)));
+	}
+	if (_mm_movemask_epi8(_mm_cmpeq_epi32(any, zero)) != 0xffff)
+		rc |= BTT_BLK_FLAGGED;
+	if (_mm_movemask_epi8(oob))
+		rc |= BTT_BLK_OOB;
+	return rc;
+}
+#elif __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && defined(__aarch64__)
+static unsigned int btt_map_block(const u32 *map, u32 nlba)
+{
+	const uint32x4_t flags = vdupq_n_u32(MAP_ENT_NORMAL);
+	const uint32x4_t lba_mask = vdupq_n_u32(MAP_LBA_MASK);
+	const uint32x4_t limit = vdupq_n_u32(nlba);
+	uint32x4_t any = vdupq_n_u32(0), oob = vdupq_n_u32(0);
+	unsigned int i, rc = 0;
+
+	for (i = 0; i < BTT_SCAN_BLOCK; i += 4) {
+		uint32x4_t v = vld1q_u32(&map[i]);
+		uint32x4_t f = vandq_u32(v, flags);
+
+		any = vorrq_u32(any, f);
+		oob = vorrq_u32(oob, vbicq_u32(vcgeq_u32(vandq_u32(v, lba_mask),
+				limit), vceqzq_u32(f)));
+	}
+	if (vmaxvq_u32(any))
+		rc |= BTT_BLK_FLAGGED;
+	if (vmaxvq_u32(oob))
+		rc |= BTT_BLK_OOB;
+	return rc;
+}
+#else
+#define btt_map_block btt_map_block_generic
+#endif
 
-	for (i = 0; i < a->external_nlba; i++) {
-		mapping = btt_map_lookup(a, i);
-		if (mapping >= a->internal_nlba)
-			return BTT_MAP_OOB;
+/* start reading a chunk of the map in before it is walked */
+static void btt_map_willneed(struct btt_chk *bttc, struct arena_info *a,
+		u32 start, u32 end)
+{
+	uintptr_t addr, base;
+
+	if (!a->map.map) {
+		posix_fadvise(bttc->fd, a->mapoff + (u64) start * sizeof(u32),
+				(u64) (end - start) * sizeof(u32),
+				POSIX_FADV_WILLNEED);
+		return;
+	}
+	addr = (uintptr_t) &a->map.map[start];
+	base = rounddown(addr, bttc->sys_page_size);
+	madvise((void *) base, (uintptr_t) &a->map.map[end] - base,
+			MADV_WILLNEED);
+}
+
+struct btt_scan_item {
+	struct arena_info *a;
+	u32 start, end;
+};
+
+struct btt_scan {
+	struct btt_chk *bttc;
+	struct btt_scan_item *items;
+	unsigned long nr, next;
+	/* bounds pass: result per arena, it reports media errors too */
+	int *map_rc;
+	/* bitmap pass: the arena's merged bitmap and the first duplicate */
+	unsigned long *bm;
+	u32 nbits;
+	pthread_mutex_t lock;
+	bool dup_found;
+	u32 dup;
+	bool nomem;
+	bool fault;
+};
+
+static int btt_scan_add(struct btt_scan *scan, struct arena_info *a)
+{
+	struct btt_scan_item *items;
+	unsigned long nr = DIV_ROUND_UP(a->external_nlba, BTT_SCAN_CHUNK);
+	unsigned long i;
+
+	items = realloc(scan->items, (scan->nr + nr) * sizeof(*items));
+	if (!items)
+		return -ENOMEM;
+	scan->items = items;
+	for (i = 0; i < nr; i++) {
+		items[scan->nr + i].a = a;
+		items[scan->nr + i].start = i * BTT_SCAN_CHUNK;
+		items[scan->nr + i].end = min_t(u64, (i + 1) * BTT_SCAN_CHUNK,
+				a->external_nlba);
 	}
+	scan->nr += nr;
 	return 0;
 }
 
+/* @ents holds the map entries from @start to @end */
+static void btt_scan_map(struct btt_scan *scan, struct arena_info *a,
+		const u32 *ents, u32 start, u32 end)
+{
+	int *rc = &scan->map_rc[a - scan->bttc->arena];
+	u32 i;
+
+	if (__atomic_load_n(rc, __ATOMIC_RELAXED))
+		return;
+	for (i = start; i + BTT_SCAN_BLOCK <= end; i += BTT_SCAN_BLOCK)
+		if (btt_map_block(&ents[i - start], a->internal_nlba)
+				& BTT_BLK_OOB)
+			goto oob;
+	for (; i < end; i++)
+		if (btt_map_decode(ents[i - start], i) >= a->internal_nlba)
+			goto oob;
+	return;
+ oob:
+	__atomic_store_n(rc, BTT_MAP_OOB, __ATOMIC_RELAXED);
+}
+
+static void btt_scan_dup(struct btt_scan *scan, u32 block)
+{
+	pthread_mutex_lock(&scan->lock);
+	if (!scan->dup_found) {
+		scan->dup_found = true;
+		scan->dup = block;
+	}
+	pthread_mutex_unlock(&scan->lock);
+}
+
+static void btt_scan_bitmap(struct btt_scan *scan, struct arena_info *a,
+		const u32 *ents, u32 start, u32 stop, unsigned long *bm)
+{
+	u32 i, end, m;
+
+	/* ranges start on a block boundary, so each block is a bitmap word */
+	for (i = start; i < stop; i = end) {
+		end = min_t(u32, i + BTT_SCAN_BLOCK, stop);
+		if (end - i == BTT_SCAN_BLOCK && !bm[BIT_WORD(i)]
+				&& !(btt_map_block(&ents[i - start],
+						a->internal_nlba)
+					& BTT_BLK_FLAGGED)) {
+			bm[BIT_WORD(i)] = ~0UL;
+			continue;
+		}
+		for (; i < end; i++) {
+			m = btt_map_decode(ents[i - start], i);
+			if (bm[BIT_WORD(m)] & BIT_MASK(m)) {
+				btt_scan_dup(scan, m);
+				return;
+			}
+			bm[BIT_WORD(m)] |= BIT_MASK(m);
+		}
+	}
+}
+
+static void btt_scan_range(struct btt_scan *scan, struct arena_info *a,
+		const u32 *ents, u32 start, u32 end, unsigned long *bm)
+{
+	if (!bm)
+		btt_scan_map(scan, a, ents, start, end);
+	else if (!__atomic_load_n(&scan->dup_found, __ATOMIC_RELAXED))
+		btt_scan_bitmap(scan, a, ents, start, end, bm);
+}
+
+#define BTT_STREAM_ENTS (BTT_STREAM_UNIT / sizeof(u32))
+#define BTT_STREAM_UNITS (BTT_SCAN_CHUNK / BTT_STREAM_ENTS)
+
+/* read an item's map entries into @buf and scan what could be read */
+static void btt_scan_stream(struct btt_scan *scan, struct btt_scan_item *item,
+		u32 *buf, unsigned long *bm)
+{
+	unsigned long bad[BITS_TO_LONGS(BTT_STREAM_UNITS)] = { 0 };
+	struct arena_info *a = item->a;
+	struct btt_chk *bttc = scan->bttc;
+	u32 nr = item->end - item->start, s, e, u, v;
+	u64 off = a->mapoff + (u64) item->start * sizeof(u32);
+	size_t lost;
+
+	lost = btt_stream_read(bttc, buf, nr * sizeof(u32), off, bad);
+	posix_fadvise(bttc->fd, off, nr * sizeof(u32), POSIX_FADV_DONTNEED);
+	if (!lost) {
+		btt_scan_range(scan, a, buf, item->start, item->end, bm);
+		return;
+	}
+
+	for (u = 0; u * BTT_STREAM_ENTS < nr; u = v) {
+		bool unit_bad = test_bit(u, bad);
+
+		for (v = u + 1; v * BTT_STREAM_ENTS < nr
+				&& test_bit(v, bad) == unit_bad; v++)
+			;
+		s = item->start + u * BTT_STREAM_ENTS;
+		e = min_t(u32, item->start + v * BTT_STREAM_ENTS, item->end);
+		if (!unit_bad) {
+			btt_scan_range(scan, a, &buf[s - item->start], s, e,
+					bm);
+			continue;
+		}
+		if (bm)
+			continue;
+		err(bttc, "arena %d: media error in map entries %#x-%#x, skipped\n",
+				a->num, s, e - 1);
+		__atomic_fetch_add(&a->media_errs, e - s, __ATOMIC_RELAXED);
+	}
+}
+
+static void btt_scan_merge(struct btt_scan *scan, unsigned long *bm,
+		u32 nbits)
+{
+	unsigned long w, both;
+
+	pthread_mutex_lock(&scan->lock);
+	for (w = 0; w < BITS_TO_LONGS(nbits); w++) {
+		both = scan->bm[w] & bm[w];
+		if (both && !scan->dup_found) {
+			scan->dup_found = true;
+			scan->dup = w * BITS_PER_LONG + __builtin_ctzl(both);
+		}
+		scan->bm[w] |= bm[w];
+	}
+	pthread_mutex_unlock(&scan->lock);
+}
+
+/*
+ * One pool item per thread: each keeps its own bitmap and stream
+ * buffer while it claims chunks, and merges once they run out.
+ */
+static void btt_scan_worker(void *arg, int idx)
+{
+	struct btt_scan *scan = arg;
+	struct btt_scan_item *item;
+	unsigned long *bm = NULL;
+	u32 *buf = NULL;
+	sigjmp_buf env;
+	unsigned long i;
+
+	if (scan->bm) {
+		bm = bitmap_alloc(scan->nbits);
+		if (!bm)
+			goto nomem;
+	}
+	if (scan->bttc->opts->stream) {
+		buf = aligned_alloc(BTT_STREAM_UNIT,
+				BTT_SCAN_CHUNK * sizeof(u32));
+		if (!buf)
+			goto nomem;
+	}
+
+	if (sigsetjmp(env, 1)) {
+		__atomic_store_n(&scan->fault, true, __ATOMIC_RELAXED);
+		goto out;
+	}
+	sj_thread = &env;
+
+	while ((i = __atomic_fetch_add(&scan->next, 1, __ATOMIC_RELAXED))
+			< scan->nr) {
+		item = &scan->items[i];
+		/* streaming, have the next chunk on its way while this one is read */
+		if (buf && i + 1 < scan->nr)
+			item++;
+		btt_map_willneed(scan->bttc, item->a, item->start, item->end);
+		item = &scan->items[i];
+		if (buf)
+			btt_scan_stream(scan, item, buf, bm);
+		else
+			btt_scan_range(scan, item->a,
+					&item->a->map.map[item->start],
+					item->start, item->end, bm);
+	}
+	if (bm)
+		btt_scan_merge(scan, bm, scan->nbits);
+ out:
+	sj_thread = NULL;
+	free(buf);
+	free(bm);
+	return;
+ nomem:
+	__atomic_store_n(&scan->nomem, true, __ATOMIC_RELAXED);
+	free(bm);
+}
+
+static int btt_scan_run(struct btt_scan *scan, unsigned long thread_bytes)
+{
+	struct btt_chk *bttc = scan->bttc;
+	unsigned long jobs = bttc->opts->jobs;
+	struct util_pool pool = {
+		.arg = scan,
+		.run = btt_scan_worker,
+	};
+
+	jobs = util_pool_jobs(jobs);
+	if (thread_bytes)
+		jobs = min(jobs, max(BTT_SCAN_BM_MAX / thread_bytes, 1UL));
+	pool.nr = min(jobs, scan->nr - scan->next);
+	pool.jobs = pool.nr;
+
+	pthread_mutex_init(&scan->lock, NULL);
+	util_pool_run(&pool);
+	pthread_mutex_destroy(&scan->lock);
+
+	/* take the same way out as a fault on the calling thread */
+	if (scan->fault)
+		siglongjmp(sj_env, 1);
+	return scan->nomem ? -ENOMEM : 0;
+}
+
+/* Check that map entries are self consistent, for every arena at once */
+static int btt_check_map_entries(struct btt_chk *bttc, int *map_rc)
+{
+	struct btt_scan scan = {
+		.bttc = bttc,
+		.map_rc = map_rc,
+	};
+	int i, rc = 0;
+
+	for (i = 0; rc == 0 && i < bttc->num_arenas; i++)
+		rc = btt_scan_add(&scan, &bttc->arena[i]);
+	if (rc == 0)
+		rc = btt_scan_run(&scan, 0);
+	free(scan.items);
+	return rc;
+}
+
 /* Check that each flog entry has the correct corresponding map entry */
 static int btt_check_log_map(struct arena_info *a)
 {
@@ -489,6 +939,176 @@ static int btt_check_info2(struct arena_info *a)
 	return 0;
 }
 
+/*
+ * --checkpoint state. Arenas before @arena are done, and when @nbits is
+ * set, the bitmap check of @arena has taken in the map entries below
+ * @next and the bitmap so far follows the per-arena records. The file
+ * is only ever read back on the same host, so it is in host order. The
+ * uuid and size tie it to the namespace, and the checksums catch a torn
+ * or stale copy.
+ */
+#define BTT_CKPT_MAGIC "BTTCKPT"
+#define BTT_CKPT_VERSION 1
+#define BTT_CKPT_MAPS_DONE (1U << 0)
+#define BTT_CKPT_MEDIA_ERRS (1U << 1)
+
+struct btt_ckpt {
+	char magic[8];
+	u32 version;
+	u32 flags;
+	u8 uuid[16];
+	u64 rawsize;
+	u32 num_arenas;
+	u32 arena;
+	u32 next;
+	u32 nbits;
+	u64 bm_checksum;
+	u64 checksum;
+	struct btt_ckpt_arena {
+		int map_rc;
+		u32 pad;
+		u64 media_errs;
+	} arenas[];
+};
+
+static size_t btt_ckpt_size(struct btt_chk *bttc)
+{
+	return sizeof(struct btt_ckpt)
+		+ bttc->num_arenas * sizeof(struct btt_ckpt_arena);
+}
+
+/*
+ * Losing a checkpoint costs a rerun, not a result, so a failure to save
+ * one is reported and the check carries on.
+ */
+static void btt_ckpt_save(struct btt_chk *bttc, struct btt_ckpt *ck,
+		unsigned long *bm)
+{
+	const char *path = bttc->opts->checkpoint;
+	size_t bm_bytes = BITS_TO_LONGS(ck->nbits) * sizeof(long);
+	size_t len = btt_ckpt_size(bttc);
+	char tmp[PATH_MAX];
+	FILE *f;
+
+	ck->bm_checksum = ck->nbits ? fletcher64(bm, bm_bytes, false) : 0;
+	ck->checksum = 0;
+	ck->checksum = fletcher64(ck, len, false);
+
+	if (snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid())
+			>= (int) sizeof(tmp))
+		goto err;
+	f = fopen(tmp, "we");
+	if (!f)
+		goto err;
+	if (fwrite(ck, len, 1, f) != 1 || (ck->nbits
+				&& fwrite(bm, bm_bytes, 1, f) != 1)
+			|| fflush(f) != 0 || fsync(fileno(f)) < 0) {
+		fclose(f);
+		goto err_unlink;
+	}
+	if (fclose(f) != 0 || rename(tmp, path) < 0)
+		goto err_unlink;
+	dbg(bttc, "checkpoint: arena %u, map entry %#x\n", ck->arena, ck->next);
+	return;
+ err_unlink:
+	unlink(tmp);
+ err:
+	err(bttc, "%s: failed to save checkpoint: %s\n", path, strerror(errno));
+}
+
+static int btt_ckpt_load(struct btt_chk *bttc, struct btt_ckpt *ck,
+		unsigned long **bm)
+{
+	const char *path = bttc->opts->checkpoint;
+	size_t len = btt_ckpt_size(bttc), bm_bytes;
+	struct btt_ckpt *saved;
+	u64 sum;
+	int rc = -EINVAL;
+	FILE *f;
+
+	f = fopen(path, "re");
+	if (!f) {
+		if (errno != ENOENT) {
+			err(bttc, "%s: %s\n", path, strerror(errno));
+			return -errno;
+		}
+		info(bttc, "%s: no checkpoint, checking from the start\n", path);
+		return 0;
+	}
+
+	saved = malloc(len);
+	if (!saved) {
+		fclose(f);
+		return -ENOMEM;
+	}
+	if (fread(saved, len, 1, f) != 1)
+		goto bad;
+	sum = saved->checksum;
+	saved->checksum = 0;
+	if (fletcher64(saved, len, false) != sum)
+		goto bad;
+	if (memcmp(saved->magic, ck->magic, sizeof(ck->magic)) != 0
+			|| saved->version != ck->version
+			|| memcmp(saved->uuid, ck->uuid, sizeof(ck->uuid)) != 0
+			|| saved->rawsize != ck->rawsize
+			|| saved->num_arenas != ck->num_arenas
+			|| saved->arena > ck->num_arenas) {
+		err(bttc, "%s: checkpoint is not for this namespace\n", path);
+		goto out;
+	}
+
+	if (saved->nbits) {
+		struct arena_info *a = &bttc->arena[saved->arena];
+
+		if (saved->arena == ck->num_arenas
+				|| saved->nbits != a->internal_nlba
+				|| saved->next % BTT_SCAN_CHUNK
+				|| saved->next >= a->external_nlba)
+			goto bad;
+		bm_bytes = BITS_TO_LONGS(saved->nbits) * sizeof(long);
+		*bm = bitmap_alloc(saved->nbits);
+		if (!*bm) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		if (fread(*bm, bm_bytes, 1, f) != 1
+				|| fletcher64(*bm, bm_bytes, false)
+				!= saved->bm_checksum) {
+			free(*bm);
+			*bm = NULL;
+			goto bad;
+		}
+	}
+
+	memcpy(ck, saved, len);
+	info(bttc, "resuming at arena %u, map entry %#x\n", ck->arena, ck->next);
+	rc = 0;
+	goto out;
+ bad:
+	err(bttc, "%s: checkpoint is damaged\n", path);
+ out:
+	free(saved);
+	fclose(f);
+	return rc;
+}
+
+static struct btt_ckpt *btt_ckpt_init(struct btt_chk *bttc)
+{
+	struct btt_ckpt *ck = calloc(1, btt_ckpt_size(bttc));
+
+	if (!ck)
+		return NULL;
+	memcpy(ck->magic, BTT_CKPT_MAGIC, sizeof(ck->magic));
+	ck->version = BTT_CKPT_VERSION;
+	memcpy(ck->uuid, bttc->arena[0].map.info->uuid, sizeof(ck->uuid));
+	ck->rawsize = bttc->rawsize;
+	ck->num_arenas = bttc->num_arenas;
+	return ck;
+}
+
+/* map chunks the bitmap check takes in between checkpoints */
+#define BTT_CKPT_CHUNKS 64
+
 /*
  * This will create a bitmap where each bit corresponds to an internal
  * 'block'. Between the BTT map and flog (representing 'free' blocks),
@@ -496,26 +1116,53 @@ static int btt_check_info2(struct arena_info *a)
  * check will detect cases where either one or more blocks are never
  * referenced, or if a block is referenced more than once.
  */
-static int btt_check_bitmap(struct arena_info *a)
+static int btt_check_bitmap(struct arena_info *a, struct btt_ckpt *ck,
+		unsigned long *resume_bm)
 {
-	unsigned long *bm;
-	u32 i, btt_mapping;
+	struct btt_scan scan = {
+		.bttc = a->bttc,
+	};
+	size_t bm_bytes = BITS_TO_LONGS(a->internal_nlba) * sizeof(long);
+	unsigned long *bm, done, total;
+	u32 i;
 	int rc = BTT_BITMAP_ERROR;
 
-	bm = bitmap_alloc(a->internal_nlba);
+	bm = resume_bm ? resume_bm : bitmap_alloc(a->internal_nlba);
 	if (bm == NULL)
 		return -ENOMEM;
 
 	/* map 'external_nlba' number of map entries */
-	for (i = 0; i < a->external_nlba; i++) {
-		btt_mapping = btt_map_lookup(a, i);
-		if (test_bit(btt_mapping, bm)) {
-			info(a->bttc,
-				"arena %d: internal block %#x is referenced by two map entries\n",
-				a->num, btt_mapping);
+	scan.bm = bm;
+	scan.nbits = a->internal_nlba;
+	if (btt_scan_add(&scan, a)) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	/*
+	 * With a checkpoint, take the map in a few chunks at a time and
+	 * save the bitmap in between, resuming where the last run got to.
+	 */
+	total = scan.nr;
+	done = resume_bm ? ck->next / BTT_SCAN_CHUNK : 0;
+	for (; done < total && !scan.dup_found; done = scan.nr) {
+		scan.next = done;
+		scan.nr = ck ? min(done + BTT_CKPT_CHUNKS, total) : total;
+		if (btt_scan_run(&scan, bm_bytes)) {
+			rc = -ENOMEM;
 			goto out;
 		}
-		bitmap_set(bm, btt_mapping, 1);
+		if (ck && !scan.dup_found && scan.nr < total) {
+			ck->next = scan.items[scan.nr].start;
+			ck->nbits = a->internal_nlba;
+			btt_ckpt_save(a->bttc, ck, bm);
+		}
+	}
+	if (scan.dup_found) {
+		info(a->bttc,
+			"arena %d: internal block %#x is referenced by two map entries\n",
+			a->num, scan.dup);
+		goto out;
 	}
 
 	/* map 'nfree' number of flog entries */
@@ -536,9 +1183,14 @@ static int btt_check_bitmap(struct arena_info *a)
 	}
 
 	/* check that the bitmap is full */
-	if (!bitmap_full(bm, a->internal_nlba))
+	if (a->media_errs)
+		info(a->bttc,
+			"arena %d: %lu map entries unreadable, skipping the unreferenced block check\n",
+			a->num, a->media_errs);
+	else if (!bitmap_full(bm, a->internal_nlba))
 		rc = BTT_BITMAP_ERROR;
  out:
+	free(scan.items);
 	free(bm);
 	return rc;
 }
@@ -583,16 +1235,75 @@ static int btt_rewrite_log(struct arena_info *a)
 
 static int btt_check_arenas(struct btt_chk *bttc)
 {
+	struct check_opts *opts = bttc->opts;
 	struct arena_info *a = NULL;
-	int i, rc;
+	unsigned long *resume_bm = NULL;
+	struct btt_ckpt *ck = NULL;
+	bool media_errs = false;
+	int *map_rc;
+	int i, first = 0, rc = 0;
+
+	map_rc = calloc(bttc->num_arenas, sizeof(*map_rc));
+	if (!map_rc)
+		return -ENOMEM;
+
+	if (opts->checkpoint) {
+		ck = btt_ckpt_init(bttc);
+		if (!ck) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		if (opts->resume)
+			rc = btt_ckpt_load(bttc, ck, &resume_bm);
+		if (rc)
+			goto out;
+		first = ck->arena;
+		media_errs = ck->flags & BTT_CKPT_MEDIA_ERRS;
+	}
+
+	/*
+	 * The bounds check does not depend on any repair, so scan all the
+	 * maps up front and pick the results up in order below.
+	 */
+	if (ck && (ck->flags & BTT_CKPT_MAPS_DONE)) {
+		for (i = 0; i < bttc->num_arenas; i++) {
+			map_rc[i] = ck->arenas[i].map_rc;
+			bttc->arena[i].media_errs = ck->arenas[i].media_errs;
+		}
+	} else if (!opts->quick) {
+		rc = btt_check_map_entries(bttc, map_rc);
+		if (rc)
+			goto out;
+		for (i = 0; ck && i < bttc->num_arenas; i++) {
+			ck->arenas[i].map_rc = map_rc[i];
+			ck->arenas[i].media_errs = bttc->arena[i].media_errs;
+		}
+		if (ck) {
+			ck->flags |= BTT_CKPT_MAPS_DONE;
+			btt_ckpt_save(bttc, ck, NULL);
+		}
+	}
 
-	for(i = 0; i < bttc->num_arenas; i++) {
+	for(i = first; i < bttc->num_arenas; i++) {
 		info(bttc, "checking arena %d\n", i);
 		a = &bttc->arena[i];
+		if (a->unreadable) {
+			err(bttc, "arena %d: log unreadable, not checked\n", i);
+			media_errs = true;
+			goto next;
+		}
+		media_errs |= !!a->media_errs;
 		rc = btt_check_log_entries(a);
 		if (rc)
 			break;
-		rc = btt_check_map_entries(a);
+		/* --quick stops at the metadata that is small enough to read */
+		if (opts->quick) {
+			rc = btt_check_info2(a);
+			if (rc)
+				break;
+			goto logfix;
+		}
+		rc = map_rc[i];
 		if (rc)
 			break;
 		rc = btt_check_log_map(a);
@@ -606,22 +1317,45 @@ static int btt_check_arenas(struct btt_chk *bttc)
 		 * pending log updates have been performed. Otherwise the
 		 * bitmap test may result in a false positive
 		 */
-		rc = btt_check_bitmap(a);
+		rc = btt_check_bitmap(a, ck, i == first ? resume_bm : NULL);
+		resume_bm = NULL;
 		if (rc)
 			break;
-
+ logfix:
 		if (bttc->opts->logfix) {
 			rc = btt_rewrite_log(a);
 			if (rc)
 				break;
 		}
+ next:
+		if (ck) {
+			ck->arena = i + 1;
+			ck->next = 0;
+			ck->nbits = 0;
+			if (media_errs)
+				ck->flags |= BTT_CKPT_MEDIA_ERRS;
+			btt_ckpt_save(bttc, ck, NULL);
+		}
 	}
+	/* a finished check starts over next time */
+	if (ck && i == bttc->num_arenas && unlink(opts->checkpoint) < 0
+			&& errno != ENOENT)
+		err(bttc, "%s: %s\n", opts->checkpoint, strerror(errno));
 
 	if (a && rc != BTT_OK) {
 		btt_xlat_status(a, rc);
-		return -ENXIO;
+		rc = -ENXIO;
+		goto out;
 	}
-	return 0;
+	if (media_errs) {
+		err(bttc, "media errors found, the check is incomplete\n");
+		rc = -EIO;
+	}
+ out:
+	free(resume_bm);
+	free(map_rc);
+	free(ck);
+	return rc;
 }
 
 /*
@@ -875,6 +1609,7 @@ static int btt_discover_arenas(struct btt_chk *bttc)
 
  out:
 	free(bttc->arena);
+	bttc->arena = NULL;
 	free(btt_sb);
 	return ret;
 }
@@ -931,11 +1666,76 @@ static void btt_unmap(struct btt_chk *bttc, void *ptr, size_t length)
 	    (void *) addr, length, page_offset);
 }
 
+/*
+ * The map is walked front to back in large chunks, so ask for aggressive
+ * readahead, and for large pages where the backing allows it, rather
+ * than take a fault every 4K. These are only hints, failures are fine.
+ */
+static void btt_map_advise(struct btt_chk *bttc, struct arena_info *a)
+{
+	uintptr_t addr = (uintptr_t) a->map.map;
+	uintptr_t base = rounddown(addr, bttc->sys_page_size);
+	size_t len = a->map.map_len + addr - base;
+
+	if (madvise((void *) base, len, MADV_SEQUENTIAL) < 0)
+		dbg(bttc, "arena %d: MADV_SEQUENTIAL: %s\n", a->num,
+				strerror(errno));
+#ifdef MADV_HUGEPAGE
+	if (madvise((void *) base, len, MADV_HUGEPAGE) < 0)
+		dbg(bttc, "arena %d: MADV_HUGEPAGE: %s\n", a->num,
+				strerror(errno));
+#endif
+}
+
+static void *btt_stream_load(struct btt_chk *bttc, struct arena_info *a,
+		const char *what, size_t len, u64 off)
+{
+	void *buf = malloc(len);
+
+	if (!buf)
+		return NULL;
+	if (btt_stream_read(bttc, buf, len, off, NULL)) {
+		err(bttc, "arena %d: media error reading %s at %#lx-%#lx\n",
+				a->num, what, off, off + len - 1);
+		if (strcmp(what, "log") == 0)
+			a->unreadable = true;
+	}
+	return buf;
+}
+
+/* read the small metadata in, the map is streamed as it is checked */
+static int btt_stream_setup(struct btt_chk *bttc)
+{
+	struct arena_info *a;
+	int i;
+
+	for (i = 0; i < bttc->num_arenas; i++) {
+		a = &bttc->arena[i];
+		a->map.info_len = BTT_INFO_SIZE;
+		a->map.info = btt_stream_load(bttc, a, "info", a->map.info_len,
+				a->infooff);
+		a->map.log_len = a->info2off - a->logoff;
+		a->map.log = btt_stream_load(bttc, a, "log", a->map.log_len,
+				a->logoff);
+		/* treated as a mismatch and restored from the info block */
+		a->map.info2_len = BTT_INFO_SIZE;
+		a->map.info2 = btt_stream_load(bttc, a, "info2",
+				a->map.info2_len, a->info2off);
+		if (!a->map.info || !a->map.log || !a->map.info2)
+			return -ENOMEM;
+		a->map.map_len = a->logoff - a->mapoff;
+	}
+	return 0;
+}
+
 static int btt_create_mappings(struct btt_chk *bttc)
 {
 	struct arena_info *a;
 	int i;
 
+	if (bttc->opts->stream)
+		return btt_stream_setup(bttc);
+
 	for (i = 0; i < bttc->num_arenas; i++) {
 		a = &bttc->arena[i];
 		a->map.info_len = BTT_INFO_SIZE;
@@ -961,6 +1761,7 @@ static int btt_create_mappings(struct btt_chk *bttc)
 				i, a->map.map_len, a->mapoff, strerror(errno));
 			return -errno;
 		}
+		btt_map_advise(bttc, a);
 
 		a->map.log_len = a->info2off - a->logoff;
 		a->map.log = btt_mmap(bttc, a->map.log_len, a->logoff);
@@ -989,6 +1790,12 @@ static void btt_remove_mappings(struct btt_chk *bttc)
 
 	for (i = 0; i < bttc->num_arenas; i++) {
 		a = &bttc->arena[i];
+		if (bttc->opts->stream) {
+			free(a->map.info);
+			free(a->map.log);
+			free(a->map.info2);
+			continue;
+		}
 		if (a->map.info)
 			btt_unmap(bttc, a->map.info, a->map.info_len);
 		if (a->map.data)
@@ -1158,103 +1965,34 @@ static int btt_recover_first_sb(struct btt_chk *bttc)
 	return rc;
 }
 
-int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
-		bool repair, bool logfix)
+/*
+ * Bring up the namespace in raw mode, discover and map its arenas, and
+ * hand them to @fn, then put the namespace back the way it was.
+ */
+/*
+ * Find and map the arenas of the BTT at bttc->path, which holds
+ * bttc->rawsize bytes, and run @fn over them.
+ */
+static int btt_run(struct btt_chk *bttc,
+		int (*fn)(struct btt_chk *bttc, void *data), void *data)
 {
-	const char *devname = ndctl_namespace_get_devname(ndns);
-	struct check_opts __opts = {
-		.verbose = verbose,
-		.force = force,
-		.repair = repair,
-		.logfix = logfix,
-	}, *opts = &__opts;
-	int raw_mode, rc, disabled_flag = 0, open_flags;
 	struct btt_sb *btt_sb;
-	struct btt_chk *bttc;
 	struct sigaction act;
-	char path[50];
+	int rc, open_flags;
 	int i;
 
-	bttc = calloc(1, sizeof(*bttc));
-	if (bttc == NULL)
-		return -ENOMEM;
-
-	log_init(&bttc->ctx, devname, "NDCTL_CHECK_NAMESPACE");
-	if (opts->verbose)
-		bttc->ctx.log_priority = LOG_DEBUG;
-
 	memset(&act, 0, sizeof(act));
 	act.sa_sigaction = sigbus_hdl;
 	act.sa_flags = SA_SIGINFO;
 
 	if (sigaction(SIGBUS, &act, 0)) {
 		err(bttc, "Unable to set sigaction\n");
-		rc = -errno;
-		goto out_bttc;
-	}
-
-	if (opts->logfix) {
-		if (!opts->repair) {
-			err(bttc, "--rewrite-log also requires --repair\n");
-			rc = -EINVAL;
-			goto out_bttc;
-		}
-		info(bttc,
-			"WARNING: interruption may cause unrecoverable metadata corruption\n");
-	}
-
-	bttc->opts = opts;
-	bttc->sys_page_size = sysconf(_SC_PAGESIZE);
-	bttc->rawsize = ndctl_namespace_get_size(ndns);
-	ndctl_namespace_get_uuid(ndns, bttc->parent_uuid);
-
-	info(bttc, "checking %s\n", devname);
-	if (ndctl_namespace_is_active(ndns)) {
-		if (opts->force) {
-			rc = ndctl_namespace_disable_safe(ndns);
-			if (rc)
-				goto out_bttc;
-			disabled_flag = 1;
-		} else {
-			err(bttc, "%s: check aborted, namespace online\n",
-				devname);
-			rc = -EBUSY;
-			goto out_bttc;
-		}
-	}
-
-	/* In typical usage, the current raw_mode should be false. */
-	raw_mode = ndctl_namespace_get_raw_mode(ndns);
-
-	/*
-	 * Putting the namespace into raw mode will allow us to access
-	 * the btt metadata.
-	 */
-	rc = ndctl_namespace_set_raw_mode(ndns, 1);
-	if (rc < 0) {
-		err(bttc, "%s: failed to set the raw mode flag: %s (%d)\n",
-			devname, strerror(abs(rc)), rc);
-		goto out_ns;
-	}
-	/*
-	 * Now enable the namespace.  This will result in a pmem device
-	 * node showing up in /dev that is in raw mode.
-	 */
-	rc = ndctl_namespace_enable(ndns);
-	if (rc != 0) {
-		err(bttc, "%s: failed to enable in raw mode: %s (%d)\n",
-			devname, strerror(abs(rc)), rc);
-		goto out_ns;
+		return -errno;
 	}
 
-	sprintf(path, "/dev/%s", ndctl_namespace_get_block_device(ndns));
-	bttc->path = path;
-
 	btt_sb = malloc(sizeof(*btt_sb));
-	if (btt_sb == NULL) {
-		rc = -ENOMEM;
-		goto out_ns;
-	}
+	if (btt_sb == NULL)
+		return -ENOMEM;
 
 	if (!bttc->opts->repair)
 		open_flags = O_RDONLY|O_EXCL;
@@ -1317,6 +2055,8 @@ int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 		goto out_close;
 
 	for (i = 0; i < bttc->num_arenas; i++) {
+		if (bttc->arena[i].unreadable)
+			continue;
 		rc = log_set_indices(&bttc->arena[i]);
 		if (rc) {
 			err(bttc,
@@ -1325,13 +2065,92 @@ int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 		}
 	}
 
-	rc = btt_check_arenas(bttc);
+	rc = fn(bttc, data);
 
 	btt_remove_mappings(bttc);
  out_close:
 	close(bttc->fd);
  out_sb:
 	free(btt_sb);
+	return rc;
+}
+
+static int namespace_btt_run(struct ndctl_namespace *ndns,
+		struct check_opts *opts,
+		int (*fn)(struct btt_chk *bttc, void *data), void *data)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	int raw_mode, rc, disabled_flag = 0;
+	struct btt_chk *bttc;
+	char path[50];
+
+	bttc = calloc(1, sizeof(*bttc));
+	if (bttc == NULL)
+		return -ENOMEM;
+
+	log_init(&bttc->ctx, devname, "NDCTL_CHECK_NAMESPACE");
+	if (opts->verbose)
+		bttc->ctx.log_priority = LOG_DEBUG;
+
+	if (opts->logfix) {
+		if (!opts->repair) {
+			err(bttc, "--rewrite-log also requires --repair\n");
+			rc = -EINVAL;
+			goto out_bttc;
+		}
+		info(bttc,
+			"WARNING: interruption may cause unrecoverable metadata corruption\n");
+	}
+
+	bttc->opts = opts;
+	bttc->sys_page_size = sysconf(_SC_PAGESIZE);
+	bttc->rawsize = ndctl_namespace_get_size(ndns);
+	ndctl_namespace_get_uuid(ndns, bttc->parent_uuid);
+
+	info(bttc, "checking %s\n", devname);
+	if (ndctl_namespace_is_active(ndns)) {
+		if (opts->force) {
+			rc = ndctl_namespace_disable_safe(ndns);
+			if (rc)
+				goto out_bttc;
+			disabled_flag = 1;
+		} else {
+			err(bttc, "%s: check aborted, namespace online\n",
+				devname);
+			rc = -EBUSY;
+			goto out_bttc;
+		}
+	}
+
+	/* In typical usage, the current raw_mode should be false. */
+	raw_mode = ndctl_namespace_get_raw_mode(ndns);
+
+	/*
+	 * Putting the namespace into raw mode will allow us to access
+	 * the btt metadata.
+	 */
+	rc = ndctl_namespace_set_raw_mode(ndns, 1);
+	if (rc < 0) {
+		err(bttc, "%s: failed to set the raw mode flag: %s (%d)\n",
+			devname, strerror(abs(rc)), rc);
+		goto out_ns;
+	}
+	/*
+	 * Now enable the namespace.  This will result in a pmem device
+	 * node showing up in /dev that is in raw mode.
+	 */
+	rc = ndctl_namespace_enable(ndns);
+	if (rc != 0) {
+		err(bttc, "%s: failed to enable in raw mode: %s (%d)\n",
+			devname, strerror(abs(rc)), rc);
+		goto out_ns;
+	}
+
+	sprintf(path, "/dev/%s", ndctl_namespace_get_block_device(ndns));
+	bttc->path = path;
+
+	rc = btt_run(bttc, fn, data);
+
  out_ns:
 	ndctl_namespace_set_raw_mode(ndns, raw_mode);
 	ndctl_namespace_disable_invalidate(ndns);
@@ -1340,6 +2159,377 @@ int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
 			err(bttc, "%s: failed to re-enable namespace\n",
 				devname);
  out_bttc:
+	free(bttc->arena);
+	free(bttc);
+	return rc;
+}
+
+static int btt_check_fn(struct btt_chk *bttc, void *data)
+{
+	return btt_check_arenas(bttc);
+}
+
+int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
+		bool repair, bool logfix, bool stream, bool quick,
+		const char *checkpoint, bool resume, unsigned int jobs)
+{
+	struct check_opts opts = {
+		.verbose = verbose,
+		.force = force,
+		.repair = repair,
+		.logfix = logfix,
+		.stream = stream,
+		.quick = quick,
+		.checkpoint = checkpoint,
+		.resume = resume,
+		.jobs = jobs,
+	};
+
+	return namespace_btt_run(ndns, &opts, btt_check_fn, NULL);
+}
+
+/**
+ * btt_check_file - check the BTT held in an image file
+ * @path: file holding the raw namespace contents
+ * @verbose: log each step
+ * @jobs: threads for the map and bitmap scans, as for namespace_check()
+ *
+ * Runs the same checks as namespace_check() without repairing anything,
+ * for BTT images saved from a namespace or generated by a test.
+ */
+int btt_check_file(const char *path, bool verbose, unsigned int jobs)
+{
+	struct check_opts opts = {
+		.verbose = verbose,
+		.jobs = jobs,
+	};
+	struct btt_chk *bttc;
+	struct stat st;
+	int rc;
+
+	if (stat(path, &st) < 0)
+		return -errno;
+	if (!S_ISREG(st.st_mode))
+		return -EINVAL;
+
+	bttc = calloc(1, sizeof(*bttc));
+	if (bttc == NULL)
+		return -ENOMEM;
+
+	log_init(&bttc->ctx, path, "NDCTL_CHECK_NAMESPACE");
+	if (verbose)
+		bttc->ctx.log_priority = LOG_DEBUG;
+	bttc->opts = &opts;
+	bttc->sys_page_size = sysconf(_SC_PAGESIZE);
+	bttc->rawsize = st.st_size;
+	bttc->path = (char *) path;
+
+	rc = btt_run(bttc, btt_check_fn, NULL);
+
+	free(bttc->arena);
 	free(bttc);
 	return rc;
 }
+
+struct btt_clear {
+	const struct ndctl_range *bbs;
+	unsigned int nr;
+	int (*clear)(u64 offset, u64 len, void *data);
+	void *data;
+	unsigned int skipped;
+};
+
+static int u32_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *) a, y = *(const u32 *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Flag a mapped block as an error so the kernel fails reads of it with
+ * -EIO rather than returning whatever is left once the poison is gone.
+ * The next write to the lba moves it to a fresh block.
+ */
+static int btt_map_set_error(struct arena_info *a, u32 lba, u32 mapping)
+{
+	void *ms_align;
+
+	info(a->bttc, "Arena %d: map[%#x] -> %#x lost, flagging error\n",
+			a->num, lba, mapping);
+	a->map.map[lba] = cpu_to_le32(mapping | (1 << MAP_ERR_SHIFT));
+
+	ms_align = (void *)rounddown((u64)&a->map.map[lba],
+		a->bttc->sys_page_size);
+	if (msync(ms_align, a->bttc->sys_page_size, MS_SYNC) < 0)
+		return -errno;
+	return 0;
+}
+
+static int btt_clear_arena(struct btt_chk *bttc, struct arena_info *a,
+		struct btt_clear *bc)
+{
+	u64 data_end = a->dataoff + (u64) a->internal_nlba * a->internal_lbasize;
+	u32 *blocks = NULL, nr_blocks = 0, alloc = 0, lba, post, i, j;
+	bool *in_data;
+	u64 start, end;
+	int rc = 0;
+
+	in_data = calloc(bc->nr, sizeof(*in_data));
+	if (!in_data)
+		return -ENOMEM;
+
+	for (i = 0; i < bc->nr; i++) {
+		start = bc->bbs[i].address;
+		end = start + bc->bbs[i].length;
+		if (end <= a->infooff || start >= a->infooff + a->size)
+			continue;
+		if (start < a->dataoff || end > data_end) {
+			err(bttc, "Arena %d: error at %#lx-%#lx hits metadata, not cleared\n",
+				a->num, start, end - 1);
+			bc->skipped++;
+			continue;
+		}
+		in_data[i] = true;
+
+		for (post = (start - a->dataoff) / a->internal_lbasize;
+				(u64) post * a->internal_lbasize + a->dataoff < end;
+				post++) {
+			if (nr_blocks == alloc) {
+				u32 *b;
+
+				alloc = alloc ? alloc * 2 : 64;
+				b = realloc(blocks, alloc * sizeof(*b));
+				if (!b) {
+					rc = -ENOMEM;
+					goto out;
+				}
+				blocks = b;
+			}
+			blocks[nr_blocks++] = post;
+		}
+	}
+	if (!nr_blocks)
+		goto out;
+
+	qsort(blocks, nr_blocks, sizeof(*blocks), u32_cmp);
+	for (i = 1, j = 1; i < nr_blocks; i++)
+		if (blocks[i] != blocks[j - 1])
+			blocks[j++] = blocks[i];
+	nr_blocks = j;
+
+	/*
+	 * One pass over the map finds the lbas whose data is gone. A
+	 * trimmed lba reads as zeroes whatever its block holds, and one
+	 * already flagged fails reads anyway, so only identity and normal
+	 * entries get the error flag.
+	 */
+	for (lba = 0; lba < a->external_nlba; lba++) {
+		u32 flags = le32_to_cpu(a->map.map[lba]) & MAP_ENT_NORMAL;
+
+		if (flags == 1U << MAP_TRIM_SHIFT
+				|| flags == 1U << MAP_ERR_SHIFT)
+			continue;
+		post = btt_map_lookup(a, lba);
+		if (!bsearch(&post, blocks, nr_blocks, sizeof(*blocks),
+					u32_cmp))
+			continue;
+		rc = btt_map_set_error(a, lba, post);
+		if (rc)
+			goto out;
+	}
+
+	/*
+	 * Clear exactly the poisoned ranges, not whole blocks: with 520 or
+	 * 4104 byte sectors a block edge need not meet the clear unit.
+	 */
+	for (i = 0; i < bc->nr; i++) {
+		if (!in_data[i])
+			continue;
+		rc = bc->clear(bc->bbs[i].address, bc->bbs[i].length,
+				bc->data);
+		if (rc)
+			goto out;
+	}
+	info(bttc, "Arena %d: cleared errors in %u blocks\n", a->num,
+			nr_blocks);
+ out:
+	free(in_data);
+	free(blocks);
+	return rc;
+}
+
+static int btt_clear_fn(struct btt_chk *bttc, void *data)
+{
+	struct btt_clear *bc = data;
+	int i, rc;
+
+	for (i = 0; i < bttc->num_arenas; i++) {
+		rc = btt_clear_arena(bttc, &bttc->arena[i], bc);
+		if (rc)
+			return rc;
+	}
+	return bc->skipped ? -ENXIO : 0;
+}
+
+/**
+ * namespace_clear_btt - clear media errors under a BTT
+ * @ndns: sector-mode namespace, in use or not
+ * @verbose: log each step
+ * @bbs: poisoned byte ranges, relative to the start of the namespace
+ * @nr: number of @bbs
+ * @clear: issues the clear for a byte range relative to the namespace
+ * @data: passed to @clear
+ *
+ * Errors in the data area of an arena are cleared, after the blocks
+ * that held live data are flagged as errors in the map so that their
+ * loss is reported instead of returned as garbage. Free blocks are
+ * simply cleared. Errors in arena metadata are left alone and make this
+ * return -ENXIO once everything else is done.
+ */
+int namespace_clear_btt(struct ndctl_namespace *ndns, bool verbose,
+		const struct ndctl_range *bbs, unsigned int nr,
+		int (*clear)(u64 offset, u64 len, void *data), void *data)
+{
+	struct check_opts opts = {
+		.verbose = verbose,
+		.force = true,
+		.repair = true,
+	};
+	struct btt_clear bc = {
+		.bbs = bbs,
+		.nr = nr,
+		.clear = clear,
+		.data = data,
+	};
+
+	return namespace_btt_run(ndns, &opts, btt_clear_fn, &bc);
+}
+
+/*
+ * Blocks are gathered through the map into one buffer and written out
+ * together, and each chunk is synced before @next moves past it, so an
+ * interrupted export picks up where the last save() left off.
+ */
+#define BTT_EXPORT_CHUNK SZ_16M
+
+static int btt_export_block(struct arena_info *a, u32 lba, void *dst)
+{
+	u32 raw = le32_to_cpu(a->map.map[lba]);
+	u32 lbasize = a->external_lbasize;
+	u32 postmap;
+
+	switch (raw & MAP_ENT_NORMAL) {
+	case 1U << MAP_TRIM_SHIFT:
+		memset(dst, 0, lbasize);
+		return 0;
+	case 1U << MAP_ERR_SHIFT:
+		err(a->bttc, "arena %d: lba %#x has a media error\n", a->num,
+				lba);
+		return -EIO;
+	}
+
+	postmap = btt_map_decode(a->map.map[lba], lba);
+	if (postmap >= a->internal_nlba) {
+		err(a->bttc, "arena %d: map[%#x] = %#x is out of range\n",
+				a->num, lba, postmap);
+		return -ENXIO;
+	}
+	memcpy(dst, a->map.data + (u64) postmap * a->internal_lbasize,
+			lbasize);
+	return 0;
+}
+
+static int btt_export_fn(struct btt_chk *bttc, void *data)
+{
+	struct btt_export *exp = data;
+	struct arena_info *a = &bttc->arena[0];
+	u64 lba, end, pos, chunk;
+	int i = 0, rc;
+	ssize_t n;
+	size_t len;
+	void *buf;
+
+	exp->nlba = bttc->nlba;
+	exp->lbasize = a->external_lbasize;
+	if (exp->lbasize != 512 && exp->lbasize != 4096) {
+		err(bttc, "lba size %u has integrity metadata, not supported\n",
+				exp->lbasize);
+		return -EOPNOTSUPP;
+	}
+	if (exp->next > exp->nlba)
+		return -EINVAL;
+
+	/* only copy out a BTT that checks clean */
+	if (exp->next == 0) {
+		rc = btt_check_arenas(bttc);
+		if (rc)
+			return rc;
+	}
+	rc = exp->save(exp);
+	if (rc)
+		return rc;
+
+	if (posix_memalign(&buf, bttc->sys_page_size, BTT_EXPORT_CHUNK))
+		return -ENOMEM;
+	chunk = BTT_EXPORT_CHUNK / exp->lbasize;
+
+	for (lba = exp->next; lba < exp->nlba; lba = end) {
+		end = min(lba + chunk, exp->nlba);
+		for (pos = lba; pos < end; pos++) {
+			while (pos >= a->external_lba_start + a->external_nlba)
+				a = &bttc->arena[++i];
+			rc = btt_export_block(a, pos - a->external_lba_start,
+					buf + (pos - lba) * exp->lbasize);
+			if (rc)
+				goto out;
+		}
+
+		len = (end - lba) * exp->lbasize;
+		n = pwrite(exp->fd, buf, len, exp->off + lba * exp->lbasize);
+		if (n != (ssize_t) len) {
+			rc = n < 0 ? -errno : -ENOSPC;
+			err(bttc, "write at lba %#llx failed: %s\n",
+					(unsigned long long) lba,
+					strerror(-rc));
+			goto out;
+		}
+		if (fdatasync(exp->fd) < 0) {
+			rc = -errno;
+			goto out;
+		}
+
+		exp->next = end;
+		rc = exp->save(exp);
+		if (rc)
+			goto out;
+		dbg(bttc, "exported %llu of %llu lbas\n",
+				(unsigned long long) end,
+				(unsigned long long) exp->nlba);
+	}
+ out:
+	free(buf);
+	return rc;
+}
+
+/**
+ * namespace_export_btt - copy the logical contents of a sector-mode namespace
+ * @ndns: sector-mode namespace, disabled unless @force
+ * @verbose: log each step
+ * @force: take @ndns offline for the copy, and bring it back after
+ * @exp: destination and progress, see struct btt_export
+ *
+ * A fresh export (@exp->next == 0) checks the BTT first, and refuses to
+ * copy one that is inconsistent. Blocks flagged as media errors fail the
+ * export, trimmed blocks read back as zeroes.
+ */
+int namespace_export_btt(struct ndctl_namespace *ndns, bool verbose,
+		bool force, struct btt_export *exp)
+{
+	struct check_opts opts = {
+		.verbose = verbose,
+		.force = force,
+	};
+
+	return namespace_btt_run(ndns, &opts, btt_export_fn, exp);
+}
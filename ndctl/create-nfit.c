@@ -18,9 +18,31 @@
 static const char *nfit_file = DEFAULT_NFIT;
 static LIST_HEAD(spas);
 
+/*
+ * A generated topology: @dimms DIMMs, split into groups of @ways, with
+ * @regions interleave sets dealt out over the groups in turn. Scale
+ * tests of enumeration use it to describe hundreds of DIMMs and
+ * regions without the hardware.
+ */
+static struct {
+	unsigned int dimms;
+	unsigned int ways;
+	unsigned int regions;
+	const char *sizes;
+	const char *base;
+} topo = {
+	.regions = 1,
+};
+
+#define DEFAULT_BASE (4ULL * SZ_1G)
+/* interleave granularity, only used to order the set's members */
+#define NFIT_LINE_SIZE 256
+
 struct spa {
 	struct list_node list;
 	unsigned long long size, offset;
+	/* for generated regions, the dimms interleaved to back the range */
+	unsigned int ways, first_dimm;
 };
 
 static int parse_add_spa(const struct option *option, const char *__arg, int unset)
@@ -58,22 +80,167 @@ static int parse_add_spa(const struct option *option, const char *__arg, int uns
 	return rc;
 }
 
+static int add_regions(void)
+{
+	unsigned long long base = DEFAULT_BASE, *sizes = NULL, *v;
+	char *list = NULL, *tok, *save;
+	unsigned int i, groups;
+	int nr = 0, rc = -EINVAL;
+	struct spa *s;
+
+	if (!topo.ways)
+		topo.ways = topo.dimms;
+	if (topo.ways > topo.dimms || topo.dimms % topo.ways) {
+		error("--ways=%u does not divide --dimms=%u\n", topo.ways,
+				topo.dimms);
+		return -EINVAL;
+	}
+	/* physical ids, dcr indexes and range indexes are 16 bit */
+	if (topo.dimms >= 0xffff || !topo.regions
+			|| topo.regions >= 0xffff) {
+		error("invalid dimm or region count\n");
+		return -EINVAL;
+	}
+	if (!topo.sizes) {
+		error("--dimms needs --region-size\n");
+		return -EINVAL;
+	}
+	if (topo.base) {
+		base = parse_size64(topo.base);
+		if (base == ULLONG_MAX) {
+			error("failed to parse --base=%s\n", topo.base);
+			return -EINVAL;
+		}
+	}
+
+	list = strdup(topo.sizes);
+	if (!list)
+		return -ENOMEM;
+	for (tok = strtok_r(list, ",", &save); tok;
+			tok = strtok_r(NULL, ",", &save)) {
+		v = realloc(sizes, (nr + 1) * sizeof(*sizes));
+		if (!v) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		sizes = v;
+		sizes[nr] = parse_size64(tok);
+		/* every dimm's share of the set must be page aligned */
+		if (sizes[nr] == ULLONG_MAX || !sizes[nr]
+				|| sizes[nr] % (topo.ways * SZ_4K)) {
+			error("invalid region size \"%s\" for %u ways\n", tok,
+					topo.ways);
+			goto out;
+		}
+		nr++;
+	}
+	if (nr != 1 && nr != (int) topo.regions) {
+		error("give one --region-size, or one per region\n");
+		goto out;
+	}
+
+	groups = topo.dimms / topo.ways;
+	for (i = 0; i < topo.regions; i++) {
+		s = calloc(1, sizeof(*s));
+		if (!s) {
+			rc = -ENOMEM;
+			goto out;
+		}
+		s->size = sizes[nr == 1 ? 0 : i];
+		s->offset = base;
+		s->ways = topo.ways;
+		s->first_dimm = (i % groups) * topo.ways;
+		base += s->size;
+		list_add_tail(&spas, &s->list);
+	}
+	rc = 0;
+ out:
+	free(sizes);
+	free(list);
+	return rc;
+}
+
+/*
+ * Device handle, from the bottom nibble up: dimm in channel, channel in
+ * memory controller, controller in socket, socket, then node controller.
+ */
+static unsigned int dimm_handle(unsigned int dimm)
+{
+	return (dimm & 0xfff) | (dimm >> 12) << 16;
+}
+
+static void write_maps(struct spa *s, int range_index,
+		unsigned long long *dpa, unsigned short *region_ids,
+		struct nfit_map *map)
+{
+	unsigned long long share;
+	unsigned int i, dimm;
+
+	/* --add-spa ranges are not backed by any dimm */
+	if (!s->ways)
+		return;
+	share = s->size / s->ways;
+	for (i = 0; i < s->ways; i++, map++) {
+		dimm = s->first_dimm + i;
+		writew(ACPI_NFIT_TYPE_MEMORY_MAP, &map->type);
+		writew(sizeof(*map), &map->length);
+		writel(dimm_handle(dimm), &map->device_handle);
+		writew(dimm, &map->physical_id);
+		writew(region_ids[dimm]++, &map->region_id);
+		writew(range_index, &map->range_index);
+		writew(dimm + 1, &map->region_index);
+		writeq(share, &map->region_size);
+		writeq(i * NFIT_LINE_SIZE, &map->region_offset);
+		writeq(dpa[dimm], &map->address);
+		writew(s->ways, &map->interleave_ways);
+		dpa[dimm] += share;
+	}
+}
+
+static void write_dcr(unsigned int dimm, struct nfit_dcr *dcr)
+{
+	writew(ACPI_NFIT_TYPE_CONTROL_REGION, &dcr->type);
+	writew(sizeof(*dcr), &dcr->length);
+	writew(dimm + 1, &dcr->region_index);
+	writew(0x8086, &dcr->vendor_id);
+	writew(1, &dcr->device_id);
+	writew(1, &dcr->revision_id);
+	writel(dimm + 1, &dcr->serial_number);
+	/* byte addressable, no block windows */
+	writew(0x201, &dcr->code);
+}
+
 static struct nfit *create_nfit(struct list_head *spa_list)
 {
+	unsigned short *region_ids = NULL;
+	unsigned long long *dpa = NULL;
 	struct nfit_spa *nfit_spa;
 	struct nfit *nfit;
 	struct spa *s;
 	size_t size;
 	char *buf;
+	unsigned int d;
 	int i;
 
 	size = sizeof(struct nfit);
 	list_for_each(spa_list, s, list)
-		size += sizeof(struct nfit_spa);
+		size += sizeof(struct nfit_spa)
+			+ s->ways * sizeof(struct nfit_map);
+	size += topo.dimms * sizeof(struct nfit_dcr);
+	if (size > UINT32_MAX)
+		return NULL;
 
 	buf = calloc(1, size);
-	if (!buf)
+	if (topo.dimms) {
+		dpa = calloc(topo.dimms, sizeof(*dpa));
+		region_ids = calloc(topo.dimms, sizeof(*region_ids));
+	}
+	if (!buf || (topo.dimms && (!dpa || !region_ids))) {
+		free(region_ids);
+		free(dpa);
+		free(buf);
 		return NULL;
+	}
 
 	/* nfit header */
 	nfit = (typeof(nfit)) buf;
@@ -86,19 +253,28 @@ static struct nfit *create_nfit(struct list_head *spa_list)
 	writel(0x80860000, &nfit->h.asl_id);
 	writel(1, &nfit->h.asl_revision);
 
+	/* each range is followed by the memdevs that back it */
 	nfit_spa = (struct nfit_spa *) (buf + sizeof(*nfit));
 	i = 1;
 	list_for_each(spa_list, s, list) {
 		writew(NFIT_TABLE_SPA, &nfit_spa->type);
 		writew(sizeof(*nfit_spa), &nfit_spa->length);
 		nfit_spa_uuid_pm(&nfit_spa->type_uuid);
-		writew(i++, &nfit_spa->range_index);
+		writew(i, &nfit_spa->range_index);
 		writeq(s->offset, &nfit_spa->spa_base);
 		writeq(s->size, &nfit_spa->spa_length);
-		nfit_spa++;
+		write_maps(s, i++, dpa, region_ids,
+				(struct nfit_map *) (nfit_spa + 1));
+		nfit_spa = (struct nfit_spa *) ((char *) (nfit_spa + 1)
+				+ s->ways * sizeof(struct nfit_map));
 	}
 
+	for (d = 0; d < topo.dimms; d++)
+		write_dcr(d, (struct nfit_dcr *) nfit_spa + d);
+
 	writeb(acpi_checksum(buf, size), &nfit->h.checksum);
+	free(region_ids);
+	free(dpa);
 
 	return nfit;
 }
@@ -139,6 +315,16 @@ int cmd_create_nfit(int argc, const char **argv, struct ndctl_ctx *ctx)
         OPT_CALLBACK('a', "add-spa", NULL, "size,offset",
                         "add a system-physical-address range table entry",
                         parse_add_spa),
+	OPT_UINTEGER('d', "dimms", &topo.dimms,
+			"generate <n> DIMMs with interleaved regions"),
+	OPT_UINTEGER('w', "ways", &topo.ways,
+			"interleave each region across <n> DIMMs (default: all)"),
+	OPT_UINTEGER('r', "regions", &topo.regions,
+			"generate <n> regions, dealt out over the DIMM groups"),
+	OPT_STRING('s', "region-size", &topo.sizes, "size[,size..]",
+			"size of every region, or of each in turn"),
+	OPT_STRING('b', "base", &topo.base, "offset",
+			"physical address of the first generated region (default: 4G)"),
 	OPT_STRING('o', NULL, &nfit_file, "file",
 			"output to <file> (default: " DEFAULT_NFIT ")"),
 	OPT_INCR('f', "force", &force, "overwrite <file> if it already exists"),
@@ -151,8 +337,10 @@ int cmd_create_nfit(int argc, const char **argv, struct ndctl_ctx *ctx)
 
 	for (i = 0; i < argc; i++)
 		error("unknown parameter \"%s\"\n", argv[i]);
-	if (list_empty(&spas))
-		error("specify at least one --add-spa= option\n");
+	if (topo.dimms && add_regions() < 0)
+		argc = 1;
+	else if (list_empty(&spas))
+		error("specify at least one --add-spa= or --dimms= option\n");
 
 	if (argc || list_empty(&spas))
 		usage_with_options(u, options);
@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ndctl/libndctl.h>
+#include <daxctl/libdaxctl.h>
+#include <util/parse-options.h>
+#include <ccan/array_size/array_size.h>
+
+#include <util/daemon.h>
+#include <ndctl.h>
+#include "builtin.h"
+
+static const char * const subsystems[] = { "nd", "dax", NULL };
+
+static struct cmd_struct served_cmds[] = {
+	{ "list", { cmd_list } },
+};
+
+static void *daemon_refresh(struct util_daemon *d)
+{
+	struct ndctl_ctx *old = d->ctx, *ctx;
+
+	if (ndctl_new(&ctx) != 0) {
+		log_err(&d->log, "failed to re-create the context\n");
+		return NULL;
+	}
+	ndctl_set_log_priority(ctx, ndctl_get_log_priority(old));
+	ndctl_set_smart_ttl(ctx, ndctl_get_smart_ttl(old));
+	ndctl_unref(old);
+	return ctx;
+}
+
+/* enumerate everything, and leave each dimm's smart payload cached */
+static void daemon_warm(struct util_daemon *d)
+{
+	struct ndctl_ctx *ctx = d->ctx;
+	struct daxctl_region *dax_region;
+	struct ndctl_region *region;
+	struct daxctl_ctx *dax_ctx;
+	struct ndctl_dimm *dimm;
+	struct ndctl_bus *bus;
+
+	ndctl_bus_foreach(ctx, bus) {
+		ndctl_dimm_foreach(bus, dimm) {
+			struct ndctl_cmd *cmd;
+
+			if (!ndctl_dimm_is_cmd_supported(dimm, ND_CMD_SMART))
+				continue;
+			cmd = ndctl_dimm_cmd_new_smart(dimm);
+			if (!cmd)
+				continue;
+			ndctl_cmd_submit(cmd);
+			ndctl_cmd_unref(cmd);
+		}
+		ndctl_region_foreach(bus, region)
+			ndctl_namespace_get_first(region);
+	}
+	dax_ctx = ndctl_get_daxctl_ctx(ctx);
+	if (dax_ctx)
+		daxctl_region_foreach(dax_ctx, dax_region)
+			daxctl_dev_get_first(dax_region);
+}
+
+int cmd_daemon(int argc, const char **argv, struct ndctl_ctx *ctx)
+{
+	const char *log = NULL;
+	bool background = false, verbose = false;
+	struct util_daemon d = {
+		.prog = PROG_NDCTL,
+		.subsystems = subsystems,
+		.ttl_ms = 5000,
+		.refresh = daemon_refresh,
+		.warm = daemon_warm,
+		.cmds = served_cmds,
+		.num_cmds = ARRAY_SIZE(served_cmds),
+	};
+	const struct option options[] = {
+		OPT_STRING('s', "socket", &d.socket, "path",
+			"listen on <path> (default " UTIL_DAEMON_DIR "/ndctl.sock)"),
+		OPT_UINTEGER('t', "ttl", &d.ttl_ms,
+			"milliseconds cached health stays valid (default 5000)"),
+		OPT_FILENAME('l', "log", &log,
+			"<file> | syslog | standard",
+			"where to log (default standard)"),
+		OPT_BOOLEAN('\0', "daemon", &background,
+			"run ndctl daemon in the background"),
+		OPT_BOOLEAN('v', "verbose", &verbose, "log every query"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"ndctl daemon [<options>]",
+		NULL
+	};
+	const char *prefix = "./";
+	int i, rc;
+
+	argc = parse_options_prefix(argc, argv, prefix, options, u, 0);
+	for (i = 0; i < argc; i++)
+		error("unknown parameter \"%s\"\n", argv[i]);
+	if (argc)
+		usage_with_options(u, options);
+
+	rc = util_daemon_start(&d, "ndctl/daemon", log, prefix, background,
+			verbose);
+	if (rc)
+		return rc;
+
+	/* main() keeps its reference, refreshes drop only ours */
+	d.ctx = ndctl_ref(ctx);
+	ndctl_set_smart_ttl(ctx, d.ttl_ms);
+	rc = util_daemon_serve(&d);
+	ndctl_unref(d.ctx);
+	return rc;
+}
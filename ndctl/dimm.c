@@ -14,6 +14,8 @@
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <util/fletcher.h>
+#include <util/fwimage.h>
+#include <util/pool.h>
 #include <ndctl/libndctl.h>
 #include <ndctl/namespace.h>
 #include <util/parse-options.h>
@@ -22,6 +24,8 @@
 #include <ndctl/firmware-update.h>
 #include <util/keys.h>
 
+#include "label-archive.h"
+
 static const char *cmd_name = "dimm";
 static int err_count;
 #define err(fmt, ...) \
@@ -45,6 +49,7 @@ static struct parameters {
 	unsigned offset;
 	bool crypto_erase;
 	bool overwrite;
+	bool wait;
 	bool zero_key;
 	bool master_pass;
 	bool human;
@@ -56,6 +61,9 @@ static struct parameters {
 	bool index;
 	bool json;
 	bool verbose;
+	bool activate;
+	bool archive;
+	unsigned int jobs;
 } param = {
 	.arm = true,
 	.labelversion = "1.1",
@@ -592,51 +600,36 @@ err:
 	return rc;
 }
 
-static int get_fw_data_from_file(FILE *file, void *buf, uint32_t len)
-{
-	size_t rc;
-
-	rc = fread(buf, len, 1, file);
-	if (rc != 1) {
-		if (feof(file))
-			fprintf(stderr,
-				"Firmware file shorter than expected\n");
-		else if (ferror(file))
-			fprintf(stderr, "Firmware file read error\n");
-		return -EBADF;
-	}
-
-	return len;
-}
-
 static int send_firmware(struct ndctl_dimm *dimm, struct action_context *actx)
 {
 	const char *devname = ndctl_dimm_get_devname(dimm);
 	struct update_context *uctx = &actx->update;
 	struct fw_info *fw = &uctx->dimm_fw;
-	uint32_t copied = 0, len, remain;
+	uint32_t copied = 0, remain;
 	struct ndctl_cmd *cmd = NULL;
 	enum ND_FW_STATUS status;
+	struct fw_image *img;
 	int rc = -ENXIO;
+	const void *buf;
 	ssize_t read;
-	void *buf;
 
-	buf = malloc(fw->update_size);
-	if (!buf)
-		return -ENOMEM;
+	img = fw_image_dup(uctx->img, fw->update_size);
+	if (!img)
+		return -errno;
 
 	remain = uctx->fw_size;
 
 	while (remain) {
-		len = min(fw->update_size, remain);
-		read = get_fw_data_from_file(actx->f_in, buf, len);
-		if (read < 0) {
-			rc = read;
+		read = fw_image_next(img, &buf);
+		if (read <= 0 || (size_t) read > remain) {
+			fprintf(stderr, "Firmware file %s\n", read < 0 ?
+					"read error" : "size changed during update");
+			rc = -EBADF;
 			goto cleanup;
 		}
 
 		cmd = ndctl_dimm_cmd_new_fw_send(uctx->start, copied, read,
-				buf);
+				(void *) buf);
 		if (!cmd) {
 			rc = -ENOMEM;
 			goto cleanup;
@@ -666,7 +659,7 @@ static int send_firmware(struct ndctl_dimm *dimm, struct action_context *actx)
 
 cleanup:
 	ndctl_cmd_unref(cmd);
-	free(buf);
+	fw_image_close(img);
 	return rc;
 }
 
@@ -903,12 +896,6 @@ static int update_firmware(struct ndctl_dimm *dimm,
 		return rc;
 	}
 
-	/*
-	 * Done reading file, reset firmware file back to beginning for
-	 * next update.
-	 */
-	rewind(actx->f_in);
-
 	rc = submit_finish_firmware(dimm, actx);
 	if (rc < 0) {
 		err("%s: failed to finish update sequence", devname);
@@ -955,10 +942,6 @@ static int action_update(struct ndctl_dimm *dimm, struct action_context *actx)
 		return -EBUSY;
 	}
 
-	rc = update_verify_input(actx);
-	if (rc < 0)
-		return rc;
-
 	rc = update_firmware(dimm, actx);
 	if (rc < 0)
 		return rc;
@@ -1027,6 +1010,66 @@ static int action_security_freeze(struct ndctl_dimm *dimm,
 	return rc;
 }
 
+/*
+ * Overwrite runs in the background on each dimm once it is issued, so
+ * every dimm is started first and then all of them are waited on in a
+ * single poll() loop: the wait lasts as long as the slowest dimm.
+ */
+static struct wait_queue {
+	struct ndctl_dimm **dimms;
+	int nr;
+} wait_queue;
+
+static int wait_queue_add(struct ndctl_dimm *dimm)
+{
+	struct ndctl_dimm **dimms;
+
+	dimms = realloc(wait_queue.dimms,
+			(wait_queue.nr + 1) * sizeof(*dimms));
+	if (!dimms)
+		return -ENOMEM;
+	wait_queue.dimms = dimms;
+	wait_queue.dimms[wait_queue.nr++] = dimm;
+	return 0;
+}
+
+/*
+ * @count is NULL when the dimms were already counted as the overwrite
+ * was issued, otherwise results are counted the way a per-dimm
+ * action_wait_overwrite() would have been.
+ */
+static int wait_queue_run(int *count)
+{
+	struct wait_queue *q = &wait_queue;
+	int i, rc, *results;
+
+	results = calloc(q->nr, sizeof(*results));
+	if (!results)
+		return -ENOMEM;
+
+	rc = ndctl_dimm_wait_overwrite_many(q->dimms, q->nr, results);
+	for (i = 0; i < q->nr; i++) {
+		const char *devname = ndctl_dimm_get_devname(q->dimms[i]);
+
+		if (results[i] == 1 && param.verbose)
+			fprintf(stderr, "%s: overwrite completed.\n", devname);
+		else if (results[i] < 0 && !count)
+			error("%s: failed to wait for overwrite: %s\n",
+					devname, strerror(-results[i]));
+
+		if (count && results[i] == 0)
+			(*count)++;
+		else if (!rc && (count || results[i] < 0))
+			rc = results[i];
+	}
+
+	free(results);
+	free(q->dimms);
+	q->dimms = NULL;
+	q->nr = 0;
+	return rc;
+}
+
 static int action_sanitize_dimm(struct ndctl_dimm *dimm,
 		struct action_context *actx)
 {
@@ -1039,6 +1082,12 @@ static int action_sanitize_dimm(struct ndctl_dimm *dimm,
 		return -EOPNOTSUPP;
 	}
 
+	if (param.wait && !param.overwrite) {
+		error("%s: --wait requires --overwrite\n",
+				ndctl_dimm_get_devname(dimm));
+		return -EINVAL;
+	}
+
 	if (param.overwrite && param.master_pass) {
 		error("%s: overwrite does not support master passphrase\n",
 				ndctl_dimm_get_devname(dimm));
@@ -1072,6 +1121,8 @@ static int action_sanitize_dimm(struct ndctl_dimm *dimm,
 		rc = ndctl_dimm_overwrite_key(dimm);
 		if (rc < 0)
 			return rc;
+		if (param.wait)
+			return wait_queue_add(dimm);
 	}
 
 	return 0;
@@ -1080,19 +1131,13 @@ static int action_sanitize_dimm(struct ndctl_dimm *dimm,
 static int action_wait_overwrite(struct ndctl_dimm *dimm,
 		struct action_context *actx)
 {
-	int rc;
-
 	if (ndctl_dimm_get_security(dimm) < 0) {
 		error("%s: security operation not supported\n",
 				ndctl_dimm_get_devname(dimm));
 		return -EOPNOTSUPP;
 	}
 
-	rc = ndctl_dimm_wait_overwrite(dimm);
-	if (rc == 1 && param.verbose)
-		fprintf(stderr, "%s: overwrite completed.\n",
-				ndctl_dimm_get_devname(dimm));
-	return rc;
+	return wait_queue_add(dimm);
 }
 
 static int __action_init(struct ndctl_dimm *dimm,
@@ -1170,7 +1215,9 @@ OPT_STRING('o', "output", &param.outfile, "output-file", \
 	"filename to write label area contents"), \
 OPT_BOOLEAN('j', "json", &param.json, "parse label data into json"), \
 OPT_BOOLEAN('u', "human", &param.human, "use human friendly number formats (implies --json)"), \
-OPT_BOOLEAN('I', "index", &param.index, "limit read to the index block area")
+OPT_BOOLEAN('I', "index", &param.index, "limit read to the index block area"), \
+OPT_BOOLEAN('\0', "archive", &param.archive, \
+	"write every label area into one archive for query-labels")
 
 #define WRITE_OPTIONS() \
 OPT_STRING('i', "input", &param.infile, "input-file", \
@@ -1183,7 +1230,15 @@ OPT_BOOLEAN('i', "force", &param.force, "ignore ARS / arm status, try to force u
 OPT_BOOLEAN_SET('A', "arm", &param.arm, &param.arm_set, \
 	"arm device for firmware activation (default)"), \
 OPT_BOOLEAN_SET('D', "disarm", &param.disarm, &param.disarm_set, \
-	"disarm device for firmware activation")
+	"disarm device for firmware activation"), \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+	"update up to <n> dimms at once (default 1)"), \
+OPT_BOOLEAN('\0', "activate", &param.activate, \
+	"activate the new firmware on each bus once every dimm is armed")
+
+#define LABEL_JOBS_OPTIONS() \
+OPT_UINTEGER('\0', "jobs", &param.jobs, \
+	"operate on up to <n> dimms at once (default 16)")
 
 #define INIT_OPTIONS() \
 OPT_BOOLEAN('f', "force", &param.force, \
@@ -1201,7 +1256,9 @@ OPT_BOOLEAN('c', "crypto-erase", &param.crypto_erase, \
 OPT_BOOLEAN('o', "overwrite", &param.overwrite, \
 		"overwrite a dimm"), \
 OPT_BOOLEAN('z', "zero-key", &param.zero_key, \
-		"pass in a zero key")
+		"pass in a zero key"), \
+OPT_BOOLEAN('w', "wait", &param.wait, \
+		"wait for every overwrite to complete")
 
 #define MASTER_OPTIONS() \
 OPT_BOOLEAN('m', "master-passphrase", &param.master_pass, \
@@ -1215,6 +1272,7 @@ OPT_UINTEGER('O', "offset", &param.offset, \
 static const struct option read_options[] = {
 	BASE_OPTIONS(),
 	LABEL_OPTIONS(),
+	LABEL_JOBS_OPTIONS(),
 	READ_OPTIONS(),
 	OPT_END(),
 };
@@ -1229,6 +1287,7 @@ static const struct option write_options[] = {
 static const struct option zero_options[] = {
 	BASE_OPTIONS(),
 	LABEL_OPTIONS(),
+	LABEL_JOBS_OPTIONS(),
 	OPT_END(),
 };
 
@@ -1246,6 +1305,13 @@ static const struct option base_options[] = {
 static const struct option init_options[] = {
 	BASE_OPTIONS(),
 	INIT_OPTIONS(),
+	LABEL_JOBS_OPTIONS(),
+	OPT_END(),
+};
+
+static const struct option check_options[] = {
+	BASE_OPTIONS(),
+	LABEL_JOBS_OPTIONS(),
 	OPT_END(),
 };
 
@@ -1262,6 +1328,191 @@ static const struct option sanitize_options[] = {
 	OPT_END(),
 };
 
+/*
+ * The dimms have separate mailboxes and label areas, so the actions
+ * that are dominated by per-dimm DSM round trips, firmware updates and
+ * label reads, initialization and validation, can proceed side by side.
+ * Each job has its own action context, json list and, for raw label
+ * reads, output buffer, and the results are collected in the order the
+ * dimms were found.
+ */
+struct dimm_job {
+	struct ndctl_dimm *dimm;
+	struct action_context actx;
+	char *out;
+	size_t out_len;
+	int rc;
+};
+
+static struct dimm_queue {
+	struct dimm_job *jobs;
+	int nr;
+	int (*action)(struct ndctl_dimm *dimm, struct action_context *actx);
+} dimm_queue;
+
+static bool dimm_action_queued(
+		int (*action)(struct ndctl_dimm *dimm, struct action_context *actx),
+		struct action_context *actx)
+{
+	if (action == action_update)
+		return actx->update.img != NULL;
+	return action == action_read || action == action_zero
+		|| action == action_init || action == action_check;
+}
+
+static int dimm_queue_add(struct ndctl_dimm *dimm,
+		int (*action)(struct ndctl_dimm *dimm, struct action_context *actx),
+		struct action_context *actx)
+{
+	struct dimm_job *job;
+	int i;
+
+	/* a dimm named twice must not race with itself */
+	for (i = 0; i < dimm_queue.nr; i++)
+		if (dimm_queue.jobs[i].dimm == dimm)
+			return 0;
+
+	job = realloc(dimm_queue.jobs, (dimm_queue.nr + 1) * sizeof(*job));
+	if (!job)
+		return -ENOMEM;
+	dimm_queue.jobs = job;
+	dimm_queue.action = action;
+	job = &dimm_queue.jobs[dimm_queue.nr];
+	memset(job, 0, sizeof(*job));
+	job->dimm = dimm;
+	job->actx = *actx;
+	if (actx->jdimms) {
+		job->actx.jdimms = json_object_new_array();
+		if (!job->actx.jdimms)
+			return -ENOMEM;
+	} else if (action == action_read) {
+		job->actx.f_out = open_memstream(&job->out, &job->out_len);
+		if (!job->actx.f_out)
+			return -errno;
+	}
+	dimm_queue.nr++;
+	return 0;
+}
+
+static void dimm_worker(void *arg, int i)
+{
+	struct dimm_queue *q = arg;
+
+	q->jobs[i].rc = q->action(q->jobs[i].dimm, &q->jobs[i].actx);
+}
+
+/* one activation per bus, once all of its dimms have been armed */
+static int update_activate(struct ndctl_bus *bus)
+{
+	const char *devname = ndctl_bus_get_devname(bus);
+	enum ndctl_fwa_method method = ndctl_bus_get_fw_activate_method(bus);
+	enum ndctl_fwa_state state = ndctl_bus_get_fw_activate_state(bus);
+	int rc;
+
+	if (method == NDCTL_FWA_METHOD_RESET) {
+		err("%s: requires a platform reset to activate firmware\n",
+				devname);
+		return -EOPNOTSUPP;
+	}
+	if (state != NDCTL_FWA_ARMED) {
+		err("%s: no devices armed, skipping activation\n", devname);
+		return -ENXIO;
+	}
+
+	rc = ndctl_bus_activate_firmware(bus, method);
+	if (rc)
+		err("%s: firmware activation failed (%s)\n", devname,
+				strerror(-rc));
+	else if (param.verbose)
+		fprintf(stderr, "%s: firmware activated\n", devname);
+	return rc;
+}
+
+static int dimm_queue_run(struct action_context *actx, unsigned int jobs,
+		int *count)
+{
+	struct dimm_queue *q = &dimm_queue;
+	struct util_pool pool = {
+		.arg = q,
+		.nr = q->nr,
+		.jobs = jobs,
+		.run = dimm_worker,
+	};
+	struct label_archive_src *srcs = NULL;
+	struct ndctl_bus *bus;
+	int i, j, rc = 0, nr_srcs = 0;
+
+	util_pool_run(&pool);
+
+	if (param.archive) {
+		srcs = calloc(q->nr, sizeof(*srcs));
+		if (!srcs)
+			rc = -ENOMEM;
+	}
+
+	for (i = 0; i < q->nr; i++) {
+		struct dimm_job *job = &q->jobs[i];
+		struct json_object *jdimms = job->actx.jdimms;
+
+		if (jdimms) {
+			for (j = 0; j < (int) json_object_array_length(jdimms); j++)
+				json_object_array_add(actx->jdimms, json_object_get(
+						json_object_array_get_idx(jdimms, j)));
+			json_object_put(jdimms);
+		}
+		if (job->actx.f_out != actx->f_out) {
+			fclose(job->actx.f_out);
+			if (srcs) {
+				if (job->rc == 0)
+					srcs[nr_srcs++] = (struct label_archive_src) {
+						.dev = ndctl_dimm_get_devname(job->dimm),
+						.id = ndctl_dimm_get_unique_id(job->dimm),
+						.label_size = ndctl_dimm_sizeof_namespace_label(
+								job->dimm),
+						.data = job->out,
+						.len = job->out_len,
+					};
+			} else if (fwrite(job->out, 1, job->out_len, actx->f_out)
+					!= job->out_len && job->rc == 0)
+				job->rc = -ENXIO;
+		}
+		if (job->rc == 0)
+			(*count)++;
+		else if (!rc)
+			rc = job->rc;
+	}
+	if (srcs) {
+		j = label_archive_write(actx->f_out, srcs, nr_srcs);
+		if (j) {
+			rc = j;
+			*count = 0;
+		}
+		free(srcs);
+	}
+	for (i = 0; i < q->nr; i++)
+		free(q->jobs[i].out);
+	fflush(actx->f_out);
+
+	for (i = 0; param.activate && i < q->nr; i++) {
+		bus = ndctl_dimm_get_bus(q->jobs[i].dimm);
+		if (q->jobs[i].rc)
+			continue;
+		for (j = 0; j < i; j++)
+			if (q->jobs[j].rc == 0
+					&& ndctl_dimm_get_bus(q->jobs[j].dimm) == bus)
+				break;
+		if (j < i)
+			continue;
+		j = update_activate(bus);
+		if (j && !rc)
+			rc = j;
+	}
+
+	free(q->jobs);
+	memset(q, 0, sizeof(*q));
+	return rc;
+}
+
 static int dimm_action(int argc, const char **argv, struct ndctl_ctx *ctx,
 		int (*action)(struct ndctl_dimm *dimm, struct action_context *actx),
 		const struct option *options, const char *usage)
@@ -1306,6 +1557,13 @@ static int dimm_action(int argc, const char **argv, struct ndctl_ctx *ctx,
 		return -EINVAL;
 	}
 
+	if (action == action_read && param.archive && (json || param.index
+				|| param.len || param.offset)) {
+		fprintf(stderr, "--archive is incompatible with --json, --index, --size and --offset\n");
+		usage_with_options(u, options);
+		return -EINVAL;
+	}
+
 	if (param.index && param.len) {
 		fprintf(stderr, "pick either --size, or --index, not both\n");
 		usage_with_options(u, options);
@@ -1374,6 +1632,26 @@ static int dimm_action(int argc, const char **argv, struct ndctl_ctx *ctx,
 	if (param.verbose)
 		ndctl_set_log_priority(ctx, LOG_DEBUG);
 
+	if (param.activate && (action != action_update || !param.infile
+				|| param.disarm)) {
+		fprintf(stderr, "--activate needs --firmware, and an armed update\n");
+		rc = -EINVAL;
+		goto out_close_fin_fout;
+	}
+
+	/* the image is checked and mapped once, for every dimm */
+	if (action == action_update && param.infile) {
+		rc = update_verify_input(&actx);
+		if (rc < 0)
+			goto out_close_fin_fout;
+		actx.update.img = fw_image_open(fileno(actx.f_in),
+				sysconf(_SC_PAGESIZE));
+		if (!actx.update.img) {
+			rc = -errno;
+			goto out_close_fin_fout;
+		}
+	}
+
 	if (strcmp(param.labelversion, "1.1") == 0)
 		actx.labelversion = NDCTL_NS_VERSION_1_1;
 	else if (strcmp(param.labelversion, "v1.1") == 0)
@@ -1409,6 +1687,14 @@ static int dimm_action(int argc, const char **argv, struct ndctl_ctx *ctx,
 				if (action == action_write) {
 					single = dimm;
 					rc = 0;
+				} else if (dimm_action_queued(action, &actx)) {
+					rc = dimm_queue_add(dimm, action, &actx);
+					if (rc == 0)
+						continue;
+				} else if (action == action_wait_overwrite) {
+					rc = action(dimm, &actx);
+					if (rc == 0)
+						continue;
 				} else
 					rc = action(dimm, &actx);
 
@@ -1419,6 +1705,19 @@ static int dimm_action(int argc, const char **argv, struct ndctl_ctx *ctx,
 			}
 		}
 	}
+	if (dimm_queue.nr) {
+		/* firmware updates stay one at a time unless asked */
+		rc = dimm_queue_run(&actx, param.jobs ? param.jobs
+				: action == action_update ? 1 : 16, &count);
+		if (rc && !err)
+			err = rc;
+	}
+	if (wait_queue.nr) {
+		rc = wait_queue_run(action == action_wait_overwrite
+				? &count : NULL);
+		if (rc && !err)
+			err = rc;
+	}
 	rc = err;
 
 	if (action == action_write) {
@@ -1439,6 +1738,7 @@ static int dimm_action(int argc, const char **argv, struct ndctl_ctx *ctx,
 	}
 
  out_close_fin_fout:
+	fw_image_close(actx.update.img);
 	if (actx.f_in != stdin)
 		fclose(actx.f_in);
 
@@ -1498,7 +1798,7 @@ int cmd_init_labels(int argc, const char **argv, struct ndctl_ctx *ctx)
 
 int cmd_check_labels(int argc, const char **argv, struct ndctl_ctx *ctx)
 {
-	int count = dimm_action(argc, argv, ctx, action_check, base_options,
+	int count = dimm_action(argc, argv, ctx, action_check, check_options,
 			"ndctl check-labels <nmem0> [<nmem1>..<nmemN>] [<options>]");
 
 	fprintf(stderr, "successfully verified %d nmem label%s\n",
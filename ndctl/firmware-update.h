@@ -36,8 +36,12 @@ struct fw_info {
 	uint32_t context;
 };
 
+struct fw_image;
+
 struct update_context {
 	size_t fw_size;
+	/* the image, mapped once and shared by every dimm's update */
+	struct fw_image *img;
 	struct fw_info dimm_fw;
 	struct ndctl_cmd *start;
 	struct json_object *jdimms;
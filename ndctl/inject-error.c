@@ -33,6 +33,7 @@ static struct parameters {
 	const char *namespace;
 	const char *block;
 	const char *count;
+	const char *file;
 	bool clear;
 	bool status;
 	bool no_notify;
@@ -41,8 +42,8 @@ static struct parameters {
 } param;
 
 static struct inject_ctx {
-	u64 block;
-	u64 count;
+	struct ndctl_inject_range *ranges;
+	unsigned int nr_ranges;
 	unsigned int op_mask;
 	unsigned long json_flags;
 	unsigned int inject_flags;
@@ -60,6 +61,8 @@ OPT_STRING('B', "block", &param.block, "namespace block offset (512B)", \
 	"specify the block at which to (un)inject the error"), \
 OPT_STRING('n', "count", &param.count, "count", \
 	"specify the number of blocks of errors to (un)inject"), \
+OPT_FILENAME('f', "file", &param.file, "file", \
+	"(un)inject the '<block> <count>' ranges listed in <file>"), \
 OPT_BOOLEAN('d', "uninject", &param.clear, \
 	"un-inject a previously injected error"), \
 OPT_BOOLEAN('t', "status", &param.status, "get error injection status"), \
@@ -80,8 +83,77 @@ enum {
 	OP_STATUS,
 };
 
+static int add_range(const char *block, const char *count)
+{
+	struct ndctl_inject_range *r;
+	u64 b, c;
+
+	b = parse_size64(block);
+	if (b == ULLONG_MAX) {
+		error("Invalid block: %s\n", block);
+		return -EINVAL;
+	}
+	c = parse_size64(count);
+	if (c == ULLONG_MAX) {
+		error("Invalid count: %s\n", count);
+		return -EINVAL;
+	}
+
+	r = realloc(ictx.ranges, (ictx.nr_ranges + 1) * sizeof(*r));
+	if (!r)
+		return -ENOMEM;
+	ictx.ranges = r;
+	r[ictx.nr_ranges].block = b;
+	r[ictx.nr_ranges].count = c;
+	ictx.nr_ranges++;
+	return 0;
+}
+
+/* one '<block> <count>' pair per line, '#' starts a comment */
+static int parse_ranges(const char *path)
+{
+	char *line = NULL, *block, *count, *save;
+	unsigned int lineno = 0;
+	size_t n = 0;
+	int rc = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		rc = -errno;
+		error("%s: %s\n", path, strerror(-rc));
+		return rc;
+	}
+
+	while (rc == 0 && getline(&line, &n, f) != -1) {
+		lineno++;
+		line[strcspn(line, "#\n")] = '\0';
+		block = strtok_r(line, " \t,", &save);
+		if (!block)
+			continue;
+		count = strtok_r(NULL, " \t,", &save);
+		if (!count || strtok_r(NULL, " \t,", &save)) {
+			error("%s:%u: expected '<block> <count>'\n", path,
+					lineno);
+			rc = -EINVAL;
+			break;
+		}
+		rc = add_range(block, count);
+	}
+	free(line);
+	fclose(f);
+
+	if (rc == 0 && !ictx.nr_ranges) {
+		error("%s: no ranges found\n", path);
+		rc = -EINVAL;
+	}
+	return rc;
+}
+
 static int inject_init(void)
 {
+	int rc;
+
 	if (!param.clear && !param.status) {
 		ictx.op_mask |= 1 << OP_INJECT;
 		ictx.inject_flags |= (1 << NDCTL_NS_INJECT_NOTIFY);
@@ -96,7 +168,8 @@ static int inject_init(void)
 		ictx.op_mask |= 1 << OP_CLEAR;
 	}
 	if (param.status) {
-		if (param.block || param.count || param.saturate) {
+		if (param.block || param.count || param.file
+				|| param.saturate) {
 			error("status is invalid with inject or uninject\n");
 			return -EINVAL;
 		}
@@ -112,26 +185,23 @@ static int inject_init(void)
 		(1 << OP_CLEAR) |
 		(1 << OP_STATUS));
 
-	if (param.block) {
-		ictx.block = parse_size64(param.block);
-		if (ictx.block == ULLONG_MAX) {
-			error("Invalid block: %s\n", param.block);
-			return -EINVAL;
-		}
-	}
-	if (param.count) {
-		ictx.count = parse_size64(param.count);
-		if (ictx.count == ULLONG_MAX) {
-			error("Invalid count: %s\n", param.count);
+	/* For inject or clear, a block and count, or a file, are required */
+	if (ictx.op_mask & ((1 << OP_INJECT) | (1 << OP_CLEAR))) {
+		if (param.file && (param.block || param.count)) {
+			error("block and count are invalid with --file\n");
 			return -EINVAL;
 		}
-	}
-
-	/* For inject or clear, an block and count are required */
-	if (ictx.op_mask & ((1 << OP_INJECT) | (1 << OP_CLEAR))) {
-		if (!param.block || !param.count) {
+		if (param.file) {
+			rc = parse_ranges(param.file);
+			if (rc)
+				return rc;
+		} else if (!param.block || !param.count) {
 			error("block and count required for inject/uninject\n");
 			return -EINVAL;
+		} else {
+			rc = add_range(param.block, param.count);
+			if (rc)
+				return rc;
 		}
 	}
 
@@ -179,8 +249,7 @@ static int ns_errors_to_json(struct ndctl_namespace *ndns,
 	return 0;
 }
 
-static int inject_error(struct ndctl_namespace *ndns, u64 offset, u64 length,
-		unsigned int flags)
+static int inject_error(struct ndctl_namespace *ndns, unsigned int flags)
 {
 	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
 	unsigned int scrub_count;
@@ -192,7 +261,8 @@ static int inject_error(struct ndctl_namespace *ndns, u64 offset, u64 length,
 		return -ENXIO;
 	}
 
-	rc = ndctl_namespace_inject_error2(ndns, offset, length, flags);
+	rc = ndctl_namespace_inject_errors(ndns, ictx.ranges, ictx.nr_ranges,
+			flags);
 	if (rc) {
 		fprintf(stderr, "Unable to inject error: %s (%d)\n",
 			strerror(abs(rc)), rc);
@@ -202,12 +272,12 @@ static int inject_error(struct ndctl_namespace *ndns, u64 offset, u64 length,
 	return ns_errors_to_json(ndns, scrub_count);
 }
 
-static int uninject_error(struct ndctl_namespace *ndns, u64 offset, u64 length,
-		unsigned int flags)
+static int uninject_error(struct ndctl_namespace *ndns, unsigned int flags)
 {
 	int rc;
 
-	rc = ndctl_namespace_uninject_error2(ndns, offset, length, flags);
+	rc = ndctl_namespace_uninject_errors(ndns, ictx.ranges,
+			ictx.nr_ranges, flags);
 	if (rc) {
 		fprintf(stderr, "Unable to uninject error: %s (%d)\n",
 			strerror(abs(rc)), rc);
@@ -272,15 +342,13 @@ static int err_inject_ns(struct ndctl_namespace *ndns)
 	op_mask = ictx.op_mask;
 	while (op_mask) {
 		if (op_mask & (1 << OP_INJECT)) {
-			rc = inject_error(ndns, ictx.block, ictx.count,
-				ictx.inject_flags);
+			rc = inject_error(ndns, ictx.inject_flags);
 			if (rc)
 				return rc;
 			op_mask &= ~(1 << OP_INJECT);
 		}
 		if (op_mask & (1 << OP_CLEAR)) {
-			rc = uninject_error(ndns, ictx.block, ictx.count,
-				ictx.inject_flags);
+			rc = uninject_error(ndns, ictx.inject_flags);
 			if (rc)
 				return rc;
 			op_mask &= ~(1 << OP_CLEAR);
@@ -361,5 +429,7 @@ int cmd_inject_error(int argc, const char **argv, struct ndctl_ctx *ctx)
 		return -ENODEV; /* we won't return from usage_with_options() */
 	}
 
-	return do_inject(argv[0], ctx);
+	rc = do_inject(argv[0], ctx);
+	free(ictx.ranges);
+	return rc;
 }
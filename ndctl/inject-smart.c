@@ -10,6 +10,8 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
 
@@ -21,6 +23,8 @@
 #include <util/filter.h>
 #include <ndctl/libndctl.h>
 #include <util/parse-options.h>
+#include <util/pool.h>
+#include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
 #include <ccan/short_types/short_types.h>
 
@@ -49,7 +53,11 @@ static struct parameters {
 	bool fatal_uninject;
 	bool unsafe_shutdown_uninject;
 	bool uninject_all;
-} param;
+	const char *scenario;
+	unsigned int jobs;
+} param = {
+	.jobs = 16,
+};
 
 static struct smart_ctx {
 	bool alarms_present;
@@ -120,6 +128,10 @@ OPT_BOOLEAN('N', "uninject-all", \
 
 static const struct option smart_opts[] = {
 	SMART_OPTIONS(),
+	OPT_STRING('\0', "scenario", &param.scenario, "file",
+		"apply a timed series of injections described in a JSON file"),
+	OPT_UINTEGER('j', "jobs", &param.jobs,
+		"with --scenario, inject into up to <n> dimms at once (default 16)"),
 	OPT_END(),
 };
 
@@ -133,94 +145,94 @@ enum alarms {
 	ALARM_OFF,
 };
 
-static inline void enable_set(void)
+static inline void enable_set(struct smart_ctx *s)
 {
-	sctx.op_mask |= 1 << OP_SET;
+	s->op_mask |= 1 << OP_SET;
 }
 
-static inline void enable_inject(void)
+static inline void enable_inject(struct smart_ctx *s)
 {
-	sctx.op_mask |= 1 << OP_INJECT;
+	s->op_mask |= 1 << OP_INJECT;
 }
 
 #define smart_param_setup_uint(arg) \
 { \
-	if (param.arg) { \
-		sctx.arg = strtoul(param.arg, NULL, 0); \
-		if (sctx.arg == ULONG_MAX || sctx.arg > UINT_MAX) { \
-			error("Invalid argument: %s: %s\n", #arg, param.arg); \
+	if (p->arg) { \
+		s->arg = strtoul(p->arg, NULL, 0); \
+		if (s->arg == ULONG_MAX || s->arg > UINT_MAX) { \
+			error("Invalid argument: %s: %s\n", #arg, p->arg); \
 			return -EINVAL; \
 		} \
-		enable_inject(); \
+		enable_inject(s); \
 	} \
-	if (param.arg##_threshold) { \
-		sctx.arg##_threshold = \
-			strtoul(param.arg##_threshold, NULL, 0); \
-		if (sctx.arg##_threshold == ULONG_MAX \
-				|| sctx.arg##_threshold > UINT_MAX) { \
+	if (p->arg##_threshold) { \
+		s->arg##_threshold = \
+			strtoul(p->arg##_threshold, NULL, 0); \
+		if (s->arg##_threshold == ULONG_MAX \
+				|| s->arg##_threshold > UINT_MAX) { \
 			error("Invalid argument: %s\n", \
-				param.arg##_threshold); \
+				p->arg##_threshold); \
 			return -EINVAL; \
 		} \
-		enable_set(); \
+		enable_set(s); \
 	} \
 }
 
 #define smart_param_setup_temps(arg) \
 { \
 	double temp; \
-	if (param.arg) { \
-		temp = strtod(param.arg, NULL); \
+	if (p->arg) { \
+		temp = strtod(p->arg, NULL); \
 		if (temp == HUGE_VAL || temp == -HUGE_VAL) { \
-			error("Invalid argument: %s: %s\n", #arg, param.arg); \
+			error("Invalid argument: %s: %s\n", #arg, p->arg); \
 			return -EINVAL; \
 		} \
-		sctx.arg = ndctl_encode_smart_temperature(temp); \
-		enable_inject(); \
+		s->arg = ndctl_encode_smart_temperature(temp); \
+		enable_inject(s); \
 	} \
-	if (param.arg##_threshold) { \
-		temp = strtod(param.arg##_threshold, NULL); \
+	if (p->arg##_threshold) { \
+		temp = strtod(p->arg##_threshold, NULL); \
 		if (temp == HUGE_VAL || temp == -HUGE_VAL) { \
 			error("Invalid argument: %s\n", \
-				param.arg##_threshold); \
+				p->arg##_threshold); \
 			return -EINVAL; \
 		} \
-		sctx.arg##_threshold = ndctl_encode_smart_temperature(temp); \
-		enable_set(); \
+		s->arg##_threshold = ndctl_encode_smart_temperature(temp); \
+		enable_set(s); \
 	} \
 }
 
 #define smart_param_setup_alarm(arg) \
 { \
-	if (param.arg##_alarm) { \
-		if (strncmp(param.arg##_alarm, "on", 2) == 0) \
-			sctx.arg##_alarm = ALARM_ON; \
-		else if (strncmp(param.arg##_alarm, "off", 3) == 0) \
-			sctx.arg##_alarm = ALARM_OFF; \
-		sctx.alarms_present = true; \
+	if (p->arg##_alarm) { \
+		if (strncmp(p->arg##_alarm, "on", 2) == 0) \
+			s->arg##_alarm = ALARM_ON; \
+		else if (strncmp(p->arg##_alarm, "off", 3) == 0) \
+			s->arg##_alarm = ALARM_OFF; \
+		s->alarms_present = true; \
 	} \
 }
 
 #define smart_param_setup_uninj(arg) \
 { \
-	if (param.arg##_uninject) { \
+	if (p->arg##_uninject) { \
 		/* Ensure user didn't set inject and uninject together */ \
-		if (param.arg) { \
+		if (p->arg) { \
 			error("Cannot use %s inject and uninject together\n", \
 				#arg); \
 			return -EINVAL; \
 		} \
 		/* Then set the inject flag so this can be accounted for */ \
-		param.arg = "0"; \
-		enable_inject(); \
+		p->arg = "0"; \
+		enable_inject(s); \
 	} \
 }
 
-static int smart_init(void)
+static int smart_init(struct parameters *p, struct smart_ctx *s)
 {
-	if (param.human)
-		sctx.flags |= UTIL_JSON_HUMAN;
-	sctx.err_continue = false;
+	if (p->human)
+		s->flags |= UTIL_JSON_HUMAN;
+	s->err_continue = false;
 
 	/* setup attributes and thresholds except alarm_control */
 	smart_param_setup_temps(media_temperature)
@@ -231,21 +243,21 @@ static int smart_init(void)
 	smart_param_setup_alarm(media_temperature)
 	smart_param_setup_alarm(ctrl_temperature)
 	smart_param_setup_alarm(spares)
-	if (sctx.alarms_present)
-		enable_set();
+	if (s->alarms_present)
+		enable_set(s);
 
 	/* setup remaining injection attributes */
-	if (param.fatal || param.unsafe_shutdown)
-		enable_inject();
+	if (p->fatal || p->unsafe_shutdown)
+		enable_inject(s);
 
 	/* setup uninjections */
-	if (param.uninject_all) {
-		param.media_temperature_uninject = true;
-		param.ctrl_temperature_uninject = true;
-		param.spares_uninject = true;
-		param.fatal_uninject = true;
-		param.unsafe_shutdown_uninject = true;
-		sctx.err_continue = true;
+	if (p->uninject_all) {
+		p->media_temperature_uninject = true;
+		p->ctrl_temperature_uninject = true;
+		p->spares_uninject = true;
+		p->fatal_uninject = true;
+		p->unsafe_shutdown_uninject = true;
+		s->err_continue = true;
 	}
 	smart_param_setup_uninj(media_temperature)
 	smart_param_setup_uninj(ctrl_temperature)
@@ -253,7 +265,7 @@ static int smart_init(void)
 	smart_param_setup_uninj(fatal)
 	smart_param_setup_uninj(unsafe_shutdown)
 
-	if (sctx.op_mask == 0) {
+	if (s->op_mask == 0) {
 		error("No valid operation specified\n");
 		return -EINVAL;
 	}
@@ -263,12 +275,13 @@ static int smart_init(void)
 
 #define setup_thresh_field(arg) \
 { \
-	if (param.arg##_threshold) \
+	if (p->arg##_threshold) \
 		ndctl_cmd_smart_threshold_set_##arg(sst_cmd, \
-					sctx.arg##_threshold); \
+					s->arg##_threshold); \
 }
 
-static int smart_set_thresh(struct ndctl_dimm *dimm)
+static int smart_set_thresh(struct ndctl_dimm *dimm, struct parameters *p,
+		struct smart_ctx *s)
 {
 	const char *name = ndctl_dimm_get_devname(dimm);
 	struct ndctl_cmd *st_cmd = NULL, *sst_cmd = NULL;
@@ -300,21 +313,21 @@ static int smart_set_thresh(struct ndctl_dimm *dimm)
 	setup_thresh_field(spares)
 
 	/* setup alarm_control manually */
-	if (sctx.alarms_present) {
+	if (s->alarms_present) {
 		unsigned int alarm;
 
 		alarm = ndctl_cmd_smart_threshold_get_alarm_control(st_cmd);
-		if (sctx.media_temperature_alarm == ALARM_ON)
+		if (s->media_temperature_alarm == ALARM_ON)
 			alarm |= ND_SMART_TEMP_TRIP;
-		else if (sctx.media_temperature_alarm == ALARM_OFF)
+		else if (s->media_temperature_alarm == ALARM_OFF)
 			alarm &= ~ND_SMART_TEMP_TRIP;
-		if (sctx.ctrl_temperature_alarm == ALARM_ON)
+		if (s->ctrl_temperature_alarm == ALARM_ON)
 			alarm |= ND_SMART_CTEMP_TRIP;
-		else if (sctx.ctrl_temperature_alarm == ALARM_OFF)
+		else if (s->ctrl_temperature_alarm == ALARM_OFF)
 			alarm &= ~ND_SMART_CTEMP_TRIP;
-		if (sctx.spares_alarm == ALARM_ON)
+		if (s->spares_alarm == ALARM_ON)
 			alarm |= ND_SMART_SPARE_TRIP;
-		else if (sctx.spares_alarm == ALARM_OFF)
+		else if (s->spares_alarm == ALARM_OFF)
 			alarm &= ~ND_SMART_SPARE_TRIP;
 
 		ndctl_cmd_smart_threshold_set_alarm_control(sst_cmd, alarm);
@@ -333,29 +346,29 @@ out:
 
 #define send_inject_val(arg) \
 { \
-	if (param.arg) { \
+	if (p->arg) { \
 		bool enable = true; \
 		\
 		si_cmd = ndctl_dimm_cmd_new_smart_inject(dimm); \
 		if (!si_cmd) { \
 			error("%s: no smart inject command support\n", name); \
-			if (sctx.err_continue == false) \
+			if (s->err_continue == false) \
 				goto out; \
 		} \
-		if (param.arg##_uninject) \
+		if (p->arg##_uninject) \
 			enable = false; \
-		rc = ndctl_cmd_smart_inject_##arg(si_cmd, enable, sctx.arg); \
+		rc = ndctl_cmd_smart_inject_##arg(si_cmd, enable, s->arg); \
 		if (rc) { \
 			error("%s: smart inject %s cmd invalid: %s (%d)\n", \
 				name, #arg, strerror(abs(rc)), rc); \
-			if (sctx.err_continue == false) \
+			if (s->err_continue == false) \
 				goto out; \
 		} \
 		rc = ndctl_cmd_submit_xlat(si_cmd); \
 		if (rc < 0) { \
 			error("%s: smart inject %s command failed: %s (%d)\n", \
 				name, #arg, strerror(abs(rc)), rc); \
-			if (sctx.err_continue == false) \
+			if (s->err_continue == false) \
 				goto out; \
 		} \
 		ndctl_cmd_unref(si_cmd); \
@@ -364,36 +377,37 @@ out:
 
 #define send_inject_bool(arg) \
 { \
-	if (param.arg) { \
+	if (p->arg) { \
 		bool enable = true; \
 		\
 		si_cmd = ndctl_dimm_cmd_new_smart_inject(dimm); \
 		if (!si_cmd) { \
 			error("%s: no smart inject command support\n", name); \
-			if (sctx.err_continue == false) \
+			if (s->err_continue == false) \
 				goto out; \
 		} \
-		if (param.arg##_uninject) \
+		if (p->arg##_uninject) \
 			enable = false; \
 		rc = ndctl_cmd_smart_inject_##arg(si_cmd, enable); \
 		if (rc) { \
 			error("%s: smart inject %s cmd invalid: %s (%d)\n", \
 				name, #arg, strerror(abs(rc)), rc); \
-			if (sctx.err_continue == false) \
+			if (s->err_continue == false) \
 				goto out; \
 		} \
 		rc = ndctl_cmd_submit_xlat(si_cmd); \
 		if (rc < 0) { \
 			error("%s: smart inject %s command failed: %s (%d)\n", \
 				name, #arg, strerror(abs(rc)), rc); \
-			if (sctx.err_continue == false) \
+			if (s->err_continue == false) \
 				goto out; \
 		} \
 		ndctl_cmd_unref(si_cmd); \
 	} \
 }
 
-static int smart_inject(struct ndctl_dimm *dimm)
+static int smart_inject(struct ndctl_dimm *dimm, struct parameters *p,
+		struct smart_ctx *s)
 {
 	const char *name = ndctl_dimm_get_devname(dimm);
 	struct ndctl_cmd *si_cmd = NULL;
@@ -410,40 +424,54 @@ out:
 	return rc;
 }
 
-static int dimm_inject_smart(struct ndctl_dimm *dimm)
+static int smart_supported(struct ndctl_dimm *dimm)
 {
-	struct json_object *jhealth;
-	struct json_object *jdimms;
-	struct json_object *jdimm;
-	int rc;
+	int rc = ndctl_dimm_smart_inject_supported(dimm);
 
-	rc = ndctl_dimm_smart_inject_supported(dimm);
 	switch (rc) {
 	case -ENOTTY:
 		error("%s: smart injection not supported by ndctl.",
 			ndctl_dimm_get_devname(dimm));
-		return rc;
+		break;
 	case -EOPNOTSUPP:
 		error("%s: smart injection not supported by the kernel",
 			ndctl_dimm_get_devname(dimm));
-		return rc;
+		break;
 	case -EIO:
 		error("%s: smart injection not supported by either platform firmware or the kernel.",
 			ndctl_dimm_get_devname(dimm));
-		return rc;
+		break;
 	}
+	return rc;
+}
+
+static int smart_apply(struct ndctl_dimm *dimm, struct parameters *p,
+		struct smart_ctx *s)
+{
+	int rc = 0;
 
-	if (sctx.op_mask & (1 << OP_SET)) {
-		rc = smart_set_thresh(dimm);
+	if (s->op_mask & (1 << OP_SET)) {
+		rc = smart_set_thresh(dimm, p, s);
 		if (rc)
-			goto out;
-	}
-	if (sctx.op_mask & (1 << OP_INJECT)) {
-		rc = smart_inject(dimm);
-		if (rc)
-			goto out;
+			return rc;
 	}
+	if (s->op_mask & (1 << OP_INJECT))
+		rc = smart_inject(dimm, p, s);
+	return rc;
+}
 
+static int dimm_inject_smart(struct ndctl_dimm *dimm)
+{
+	struct json_object *jhealth;
+	struct json_object *jdimms;
+	struct json_object *jdimm;
+	int rc;
+
+	rc = smart_supported(dimm);
+	if (rc == -ENOTTY || rc == -EOPNOTSUPP || rc == -EIO)
+		return rc;
+
+	rc = smart_apply(dimm, &param, &sctx);
 	if (rc == 0) {
 		jdimms = json_object_new_array();
 		if (!jdimms)
@@ -490,16 +518,348 @@ static int do_smart(const char *dimm_arg, struct ndctl_ctx *ctx)
 	return rc;
 }
 
+/*
+ * A scenario is a JSON array of steps. Each step names the dimms it
+ * applies to ("dimm", a name or an array of names, "all" allowed), an
+ * optional "bus", the time it fires ("at", milliseconds from the start
+ * of the run) and any of the injection options above by their long
+ * name. Steps fire in time order, a step's dimms are injected
+ * concurrently, and a step that overruns delays the ones after it
+ * rather than overlapping them.
+ */
+struct scenario_step {
+	int idx;
+	unsigned long at;
+	struct parameters p;
+	struct smart_ctx s;
+	struct ndctl_dimm **dimms;
+	u64 *done_ns;
+	int *rc;
+	int nr;
+};
+
+static const struct scenario_key {
+	const char *name;
+	size_t offset;
+	bool is_bool;
+} scenario_keys[] = {
+	{ "media-temperature",
+		offsetof(struct parameters, media_temperature), false },
+	{ "media-temperature-threshold",
+		offsetof(struct parameters, media_temperature_threshold), false },
+	{ "media-temperature-alarm",
+		offsetof(struct parameters, media_temperature_alarm), false },
+	{ "media-temperature-uninject",
+		offsetof(struct parameters, media_temperature_uninject), true },
+	{ "ctrl-temperature",
+		offsetof(struct parameters, ctrl_temperature), false },
+	{ "ctrl-temperature-threshold",
+		offsetof(struct parameters, ctrl_temperature_threshold), false },
+	{ "ctrl-temperature-alarm",
+		offsetof(struct parameters, ctrl_temperature_alarm), false },
+	{ "ctrl-temperature-uninject",
+		offsetof(struct parameters, ctrl_temperature_uninject), true },
+	{ "spares", offsetof(struct parameters, spares), false },
+	{ "spares-threshold",
+		offsetof(struct parameters, spares_threshold), false },
+	{ "spares-alarm", offsetof(struct parameters, spares_alarm), false },
+	{ "spares-uninject",
+		offsetof(struct parameters, spares_uninject), true },
+	{ "fatal", offsetof(struct parameters, fatal), true },
+	{ "fatal-uninject", offsetof(struct parameters, fatal_uninject), true },
+	{ "unsafe-shutdown",
+		offsetof(struct parameters, unsafe_shutdown), true },
+	{ "unsafe-shutdown-uninject",
+		offsetof(struct parameters, unsafe_shutdown_uninject), true },
+	{ "uninject-all", offsetof(struct parameters, uninject_all), true },
+};
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int scenario_add_dimm(struct scenario_step *step,
+		struct ndctl_dimm *dimm)
+{
+	struct ndctl_dimm **dimms;
+	int i;
+
+	for (i = 0; i < step->nr; i++)
+		if (step->dimms[i] == dimm)
+			return 0;
+	dimms = realloc(step->dimms, (step->nr + 1) * sizeof(*dimms));
+	if (!dimms)
+		return -ENOMEM;
+	step->dimms = dimms;
+	step->dimms[step->nr++] = dimm;
+	return 0;
+}
+
+/* the dimms are enumerated once, here, and reused for every firing */
+static int scenario_match(struct ndctl_ctx *ctx, struct scenario_step *step,
+		const char *filter)
+{
+	const char *bus_filter = step->p.bus ? step->p.bus : param.bus;
+	struct ndctl_dimm *dimm;
+	struct ndctl_bus *bus;
+	int rc, found = 0;
+
+	ndctl_bus_foreach(ctx, bus) {
+		if (!util_bus_filter(bus, bus_filter))
+			continue;
+		ndctl_dimm_foreach(bus, dimm) {
+			if (!util_dimm_filter(dimm, filter))
+				continue;
+			rc = smart_supported(dimm);
+			if (rc == -ENOTTY || rc == -EOPNOTSUPP || rc == -EIO)
+				return rc;
+			rc = scenario_add_dimm(step, dimm);
+			if (rc)
+				return rc;
+			found++;
+		}
+	}
+	if (!found) {
+		error("step %d: %s: no such dimm\n", step->idx, filter);
+		return -ENXIO;
+	}
+	return 0;
+}
+
+static int scenario_parse_step(struct ndctl_ctx *ctx,
+		struct scenario_step *step, struct json_object *jstep)
+{
+	const struct scenario_key *k;
+	struct json_object *jdimm = NULL;
+	unsigned int i;
+	int64_t at;
+	int rc;
+
+	if (!json_object_is_type(jstep, json_type_object)) {
+		error("step %d: not a JSON object\n", step->idx);
+		return -EINVAL;
+	}
+
+	json_object_object_foreach(jstep, key, jval) {
+		if (strcmp(key, "at") == 0) {
+			at = json_object_get_int64(jval);
+			if (!json_object_is_type(jval, json_type_int) || at < 0) {
+				error("step %d: 'at' must be a number of milliseconds\n",
+						step->idx);
+				return -EINVAL;
+			}
+			step->at = at;
+			continue;
+		}
+		if (strcmp(key, "dimm") == 0) {
+			jdimm = jval;
+			continue;
+		}
+		if (strcmp(key, "bus") == 0) {
+			step->p.bus = json_object_get_string(jval);
+			continue;
+		}
+
+		for (i = 0; i < ARRAY_SIZE(scenario_keys); i++)
+			if (strcmp(key, scenario_keys[i].name) == 0)
+				break;
+		if (i == ARRAY_SIZE(scenario_keys)) {
+			error("step %d: unknown key '%s'\n", step->idx, key);
+			return -EINVAL;
+		}
+		k = &scenario_keys[i];
+		if (k->is_bool) {
+			if (!json_object_is_type(jval, json_type_boolean)) {
+				error("step %d: '%s' must be true or false\n",
+						step->idx, key);
+				return -EINVAL;
+			}
+			*(bool *) ((char *) &step->p + k->offset) =
+				json_object_get_boolean(jval);
+		} else
+			*(const char **) ((char *) &step->p + k->offset) =
+				json_object_get_string(jval);
+	}
+
+	step->p.human = param.human;
+	rc = smart_init(&step->p, &step->s);
+	if (rc) {
+		error("step %d: invalid injection\n", step->idx);
+		return rc;
+	}
+
+	if (!jdimm) {
+		error("step %d: missing 'dimm'\n", step->idx);
+		return -EINVAL;
+	}
+	if (!json_object_is_type(jdimm, json_type_array))
+		return scenario_match(ctx, step, json_object_get_string(jdimm));
+	for (i = 0; i < json_object_array_length(jdimm); i++) {
+		rc = scenario_match(ctx, step, json_object_get_string(
+					json_object_array_get_idx(jdimm, i)));
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+static int scenario_step_cmp(const void *a, const void *b)
+{
+	const struct scenario_step *x = a, *y = b;
+
+	if (x->at != y->at)
+		return x->at < y->at ? -1 : 1;
+	return x->idx - y->idx;
+}
+
+static void scenario_worker(void *arg, int idx)
+{
+	struct scenario_step *step = arg;
+
+	step->rc[idx] = smart_apply(step->dimms[idx], &step->p, &step->s);
+	step->done_ns[idx] = now_ns();
+}
+
+static void scenario_fire(struct scenario_step *step)
+{
+	struct util_pool pool = {
+		.arg = step,
+		.nr = step->nr,
+		.jobs = max(param.jobs, 1U),
+		.run = scenario_worker,
+	};
+
+	util_pool_run(&pool);
+}
+
+static struct json_object *scenario_result_to_json(
+		struct scenario_step *step, int i, u64 start)
+{
+	struct json_object *jres = json_object_new_object();
+
+	if (!jres)
+		return NULL;
+	json_object_object_add(jres, "step", json_object_new_int(step->idx));
+	json_object_object_add(jres, "dimm", json_object_new_string(
+				ndctl_dimm_get_devname(step->dimms[i])));
+	json_object_object_add(jres, "at", json_object_new_int64(step->at));
+	json_object_object_add(jres, "completed_us", json_object_new_int64(
+				(step->done_ns[i] - start) / 1000));
+	if (step->rc[i])
+		json_object_object_add(jres, "error", json_object_new_string(
+					strerror(abs(step->rc[i]))));
+	return jres;
+}
+
+static int do_scenario(const char *path, struct ndctl_ctx *ctx)
+{
+	struct json_object *jscenario, *jlist, *jres;
+	struct scenario_step *steps = NULL, *step;
+	int i, j, nr = 0, rc = 0;
+	struct timespec when;
+	u64 start, fire;
+
+	if (param.verbose)
+		ndctl_set_log_priority(ctx, LOG_DEBUG);
+
+	jscenario = json_object_from_file(path);
+	if (!jscenario || !json_object_is_type(jscenario, json_type_array)) {
+		error("%s: not a JSON array\n", path);
+		json_object_put(jscenario);
+		return -EINVAL;
+	}
+
+	nr = json_object_array_length(jscenario);
+	steps = calloc(nr, sizeof(*steps));
+	if (!steps && nr) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < nr; i++) {
+		step = &steps[i];
+		step->idx = i;
+		rc = scenario_parse_step(ctx, step,
+				json_object_array_get_idx(jscenario, i));
+		if (rc)
+			goto out;
+		step->rc = calloc(step->nr, sizeof(*step->rc));
+		step->done_ns = calloc(step->nr, sizeof(*step->done_ns));
+		if (!step->rc || !step->done_ns) {
+			rc = -ENOMEM;
+			goto out;
+		}
+	}
+	qsort(steps, nr, sizeof(*steps), scenario_step_cmp);
+
+	start = now_ns();
+	for (i = 0; i < nr; i++) {
+		step = &steps[i];
+		fire = start + step->at * 1000000ULL;
+		when.tv_sec = fire / 1000000000ULL;
+		when.tv_nsec = fire % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when,
+					NULL) == EINTR)
+			;
+		scenario_fire(step);
+	}
+
+	jlist = json_object_new_array();
+	for (i = 0; i < nr; i++)
+		for (j = 0; j < steps[i].nr; j++) {
+			if (steps[i].rc[j] && !rc)
+				rc = steps[i].rc[j];
+			jres = scenario_result_to_json(&steps[i], j, start);
+			if (jlist && jres)
+				json_object_array_add(jlist, jres);
+		}
+	if (jlist)
+		util_display_json_array(stdout, jlist, sctx.flags);
+
+out:
+	for (i = 0; steps && i < nr; i++) {
+		free(steps[i].dimms);
+		free(steps[i].done_ns);
+		free(steps[i].rc);
+	}
+	free(steps);
+	/* the steps point into the parsed file until here */
+	json_object_put(jscenario);
+	return rc;
+}
+
 int cmd_inject_smart(int argc, const char **argv, struct ndctl_ctx *ctx)
 {
 	const char * const u[] = {
 		"ndctl inject-smart <dimm> [<options>]",
+		"ndctl inject-smart --scenario <file> [<options>]",
 		NULL
 	};
+	static const struct parameters none;
+	struct parameters rest;
 	int i, rc;
 
         argc = parse_options(argc, argv, smart_opts, u, 0);
-	rc = smart_init();
+	if (param.scenario) {
+		/* the steps carry the injections and the dimms */
+		rest = param;
+		rest.bus = rest.scenario = NULL;
+		rest.verbose = rest.human = false;
+		rest.jobs = 0;
+		if (argc || memcmp(&rest, &none, sizeof(rest)) != 0) {
+			error("--scenario takes no dimms or injection options\n");
+			usage_with_options(u, smart_opts);
+			return -EINVAL;
+		}
+		if (param.human)
+			sctx.flags |= UTIL_JSON_HUMAN;
+		return do_scenario(param.scenario, ctx);
+	}
+
+	rc = smart_init(&param, &sctx);
 	if (rc)
 		return rc;
 
@@ -0,0 +1,518 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <uuid/uuid.h>
+#include <util/size.h>
+#include <util/bitmap.h>
+#include <util/fletcher.h>
+#include <ndctl/namespace.h>
+#include <util/parse-options.h>
+#include <ndctl/libndctl.h>
+#include <ccan/minmax/minmax.h>
+
+#include "label-archive.h"
+#include "builtin.h"
+
+/* fletcher64 wants whole words, a ragged tail is summed zero padded */
+static int archive_sum(const void *data, size_t len, u64 *sum)
+{
+	size_t padded = ALIGN(len, sizeof(u32));
+	void *buf;
+
+	if (padded == len) {
+		*sum = fletcher64((void *) data, len, 1);
+		return 0;
+	}
+
+	buf = calloc(1, padded);
+	if (!buf)
+		return -ENOMEM;
+	memcpy(buf, data, len);
+	*sum = fletcher64(buf, padded, 1);
+	free(buf);
+	return 0;
+}
+
+/**
+ * label_archive_write - write the label areas in @src as one archive
+ * @f: destination, written front to back
+ * @src: one entry per dimm, in the order they should appear
+ * @nr: number of @src entries
+ */
+int label_archive_write(FILE *f, struct label_archive_src *src, int nr)
+{
+	size_t table_off = sizeof(struct label_archive_hdr);
+	size_t meta_len = table_off + nr * sizeof(struct label_archive_ent);
+	struct label_archive_hdr *hdr;
+	struct label_archive_ent *ent;
+	static const char zero[LABEL_ARCHIVE_ALIGN];
+	u64 off = ALIGN(meta_len, LABEL_ARCHIVE_ALIGN);
+	int i, rc = 0;
+	void *meta;
+	u64 sum;
+
+	meta = calloc(1, off);
+	if (!meta)
+		return -ENOMEM;
+	hdr = meta;
+	ent = meta + table_off;
+
+	memcpy(hdr->sig, LABEL_ARCHIVE_SIG, LABEL_ARCHIVE_SIG_LEN);
+	hdr->version = cpu_to_le32(LABEL_ARCHIVE_VERSION);
+	hdr->nr_dimms = cpu_to_le32(nr);
+	hdr->table_off = cpu_to_le64(table_off);
+	hdr->time = cpu_to_le64(time(NULL));
+	gethostname(hdr->host, sizeof(hdr->host) - 1);
+
+	for (i = 0; i < nr; i++) {
+		snprintf(ent[i].dev, sizeof(ent[i].dev), "%s", src[i].dev);
+		if (src[i].id)
+			snprintf(ent[i].id, sizeof(ent[i].id), "%s",
+					src[i].id);
+		ent[i].off = cpu_to_le64(off);
+		ent[i].len = cpu_to_le64(src[i].len);
+		ent[i].label_size = cpu_to_le32(src[i].label_size);
+		rc = archive_sum(src[i].data, src[i].len, &sum);
+		if (rc)
+			goto out;
+		ent[i].checksum = cpu_to_le64(sum);
+		off += ALIGN(src[i].len, LABEL_ARCHIVE_ALIGN);
+	}
+	hdr->size = cpu_to_le64(off);
+	hdr->checksum = cpu_to_le64(fletcher64(meta, meta_len, 1));
+
+	if (fwrite(meta, 1, ALIGN(meta_len, LABEL_ARCHIVE_ALIGN), f)
+			!= ALIGN(meta_len, LABEL_ARCHIVE_ALIGN))
+		rc = -EIO;
+	for (i = 0; rc == 0 && i < nr; i++) {
+		size_t pad = ALIGN(src[i].len, LABEL_ARCHIVE_ALIGN)
+			- src[i].len;
+
+		if (fwrite(src[i].data, 1, src[i].len, f) != src[i].len
+				|| fwrite(zero, 1, pad, f) != pad)
+			rc = -EIO;
+	}
+	if (fflush(f))
+		rc = -errno;
+ out:
+	free(meta);
+	return rc;
+}
+
+struct archive {
+	const char *path;
+	void *map;
+	size_t size;
+	struct label_archive_hdr *hdr;
+	struct label_archive_ent *ents;
+	int nr;
+};
+
+static int archive_open(struct archive *a, const char *path)
+{
+	struct label_archive_hdr *hdr;
+	size_t meta_len, i;
+	struct stat st;
+	u64 sum;
+	int fd;
+
+	memset(a, 0, sizeof(*a));
+	a->path = path;
+	fd = open(path, O_RDONLY|O_CLOEXEC);
+	if (fd < 0) {
+		error("%s: %s\n", path, strerror(errno));
+		return -errno;
+	}
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(*hdr)) {
+		error("%s: not a label archive\n", path);
+		close(fd);
+		return -EINVAL;
+	}
+
+	/*
+	 * Private and writable for the in-place index checks, which zero
+	 * the checksum while they sum a block, only those pages are copied
+	 */
+	a->size = st.st_size;
+	a->map = mmap(NULL, a->size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (a->map == MAP_FAILED) {
+		a->map = NULL;
+		error("%s: mmap: %s\n", path, strerror(errno));
+		return -errno;
+	}
+
+	hdr = a->hdr = a->map;
+	if (memcmp(hdr->sig, LABEL_ARCHIVE_SIG, LABEL_ARCHIVE_SIG_LEN) != 0) {
+		error("%s: not a label archive\n", path);
+		return -EINVAL;
+	}
+	if (le32_to_cpu(hdr->version) != LABEL_ARCHIVE_VERSION) {
+		error("%s: unsupported archive version %u\n", path,
+				le32_to_cpu(hdr->version));
+		return -EOPNOTSUPP;
+	}
+
+	a->nr = le32_to_cpu(hdr->nr_dimms);
+	meta_len = le64_to_cpu(hdr->table_off)
+		+ (size_t) a->nr * sizeof(struct label_archive_ent);
+	if (le64_to_cpu(hdr->size) != a->size || meta_len > a->size) {
+		error("%s: truncated archive\n", path);
+		return -EINVAL;
+	}
+
+	sum = le64_to_cpu(hdr->checksum);
+	hdr->checksum = 0;
+	if (fletcher64(a->map, meta_len, 1) != sum) {
+		error("%s: header checksum mismatch\n", path);
+		return -EINVAL;
+	}
+	hdr->checksum = cpu_to_le64(sum);
+
+	a->ents = a->map + le64_to_cpu(hdr->table_off);
+	for (i = 0; i < (size_t) a->nr; i++) {
+		struct label_archive_ent *ent = &a->ents[i];
+		u64 off = le64_to_cpu(ent->off), len = le64_to_cpu(ent->len);
+
+		if (off > a->size || ALIGN(len, sizeof(u32)) > a->size - off
+				|| !le32_to_cpu(ent->label_size)) {
+			error("%s: %.16s: bad table entry\n", path, ent->dev);
+			return -EINVAL;
+		}
+		/* the writer zero pads, so the padded sum is in place */
+		if (fletcher64(a->map + off, ALIGN(len, sizeof(u32)), 1)
+				!= le64_to_cpu(ent->checksum)) {
+			error("%s: %.16s: label data checksum mismatch\n",
+					path, ent->dev);
+			return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+static void archive_close(struct archive *a)
+{
+	if (a->map)
+		munmap(a->map, a->size);
+}
+
+static const char *ent_name(struct label_archive_ent *ent)
+{
+	return ent->id[0] ? ent->id : ent->dev;
+}
+
+static const unsigned int next_seq[] = { 0, 2, 3, 1 };
+
+/* the kernel's sizeof_namespace_index() for this config_size */
+static size_t index_size(u64 config_size, unsigned int label_size)
+{
+	u32 nslot = config_size / label_size;
+	size_t size = ALIGN(sizeof(struct namespace_index)
+			+ DIV_ROUND_UP(nslot, 8), NSINDEX_ALIGN);
+
+	nslot = (config_size - 2 * size) / label_size;
+	return ALIGN(sizeof(struct namespace_index) + DIV_ROUND_UP(nslot, 8),
+			NSINDEX_ALIGN);
+}
+
+/*
+ * Collect the live labels of one dimm: the slots the current index
+ * block has allocated, and whose label claims that slot. Returns the
+ * count, or -ENXIO when neither index block is valid.
+ */
+static int ent_labels(struct archive *a, struct label_archive_ent *ent,
+		struct namespace_label ***labels)
+{
+	unsigned int label_size = le32_to_cpu(ent->label_size);
+	u64 len = le64_to_cpu(ent->len);
+	struct namespace_index *nsindex[2], *cur = NULL;
+	char *area = a->map + le64_to_cpu(ent->off);
+	struct namespace_label **list, *label;
+	u32 seq[2] = { 0, 0 }, slot, nslot;
+	size_t isize;
+	int i, nr = 0;
+
+	*labels = NULL;
+	if (len < 2 * NSINDEX_ALIGN + 2 * label_size)
+		return -ENXIO;
+	isize = index_size(len, label_size);
+	for (i = 0; i < 2; i++) {
+		nsindex[i] = (struct namespace_index *) (area + i * isize);
+		if (nsindex_verify(nsindex[i], i, isize, label_size, len))
+			continue;
+		seq[i] = le32_to_cpu(nsindex[i]->seq) & NSINDEX_SEQ_MASK;
+	}
+	if (seq[0] && seq[1])
+		cur = next_seq[seq[0]] == seq[1] ? nsindex[1] : nsindex[0];
+	else if (seq[0] || seq[1])
+		cur = seq[0] ? nsindex[0] : nsindex[1];
+	if (!cur)
+		return -ENXIO;
+
+	nslot = le32_to_cpu(cur->nslot);
+	list = calloc(nslot ? nslot : 1, sizeof(*list));
+	if (!list)
+		return -ENOMEM;
+	for (slot = 0; slot < nslot; slot++) {
+		/* a set bit in the free bitmap is a free slot */
+		if (cur->free[slot / 8] & (1 << (slot % 8)))
+			continue;
+		label = (struct namespace_label *) (area + 2 * isize
+				+ (u64) slot * label_size);
+		if (le32_to_cpu(label->slot) != slot)
+			continue;
+		list[nr++] = label;
+	}
+	*labels = list;
+	return nr;
+}
+
+static int label_cmp(const void *a, const void *b)
+{
+	struct namespace_label *l = *(struct namespace_label **) a;
+	struct namespace_label *r = *(struct namespace_label **) b;
+	int rc = memcmp(l->uuid, r->uuid, NSLABEL_UUID_LEN);
+
+	if (rc)
+		return rc;
+	if (le64_to_cpu(l->dpa) != le64_to_cpu(r->dpa))
+		return le64_to_cpu(l->dpa) < le64_to_cpu(r->dpa) ? -1 : 1;
+	return 0;
+}
+
+/* the fields that describe a namespace, not where the label sits */
+static bool label_same(struct namespace_label *l, struct namespace_label *r)
+{
+	return memcmp(l->name, r->name, NSLABEL_NAME_LEN) == 0
+		&& l->flags == r->flags && l->nlabel == r->nlabel
+		&& l->position == r->position
+		&& l->isetcookie == r->isetcookie
+		&& l->lbasize == r->lbasize && l->rawsize == r->rawsize;
+}
+
+static void label_show(char prefix, struct label_archive_ent *ent,
+		struct namespace_label *label)
+{
+	char uuid[40], pfx[3] = { prefix, ' ', 0 };
+
+	uuid_unparse((void *) label->uuid, uuid);
+	printf("%s%s slot=%u uuid=%s dpa=%#llx rawsize=%#llx pos=%u/%u "
+			"flags=%#x isetcookie=%#llx name=\"%.*s\"\n",
+			prefix ? pfx : "",
+			ent_name(ent), le32_to_cpu(label->slot), uuid,
+			(unsigned long long) le64_to_cpu(label->dpa),
+			(unsigned long long) le64_to_cpu(label->rawsize),
+			le16_to_cpu(label->position),
+			le16_to_cpu(label->nlabel), le32_to_cpu(label->flags),
+			(unsigned long long) le64_to_cpu(label->isetcookie),
+			(int) strnlen(label->name, NSLABEL_NAME_LEN),
+			label->name);
+}
+
+static struct {
+	const char *diff;
+	const char *dimm;
+	const char *uuid;
+} param;
+
+static bool ent_match(struct label_archive_ent *ent)
+{
+	if (!param.dimm)
+		return true;
+	return strncmp(param.dimm, ent->dev, sizeof(ent->dev)) == 0
+		|| strncmp(param.dimm, ent->id, sizeof(ent->id)) == 0;
+}
+
+static bool label_match(struct namespace_label *label, uuid_t uuid)
+{
+	return !param.uuid || memcmp(label->uuid, uuid, NSLABEL_UUID_LEN) == 0;
+}
+
+static struct label_archive_ent *archive_find(struct archive *a,
+		struct label_archive_ent *ent)
+{
+	int i;
+
+	for (i = 0; i < a->nr; i++)
+		if (strncmp(ent_name(&a->ents[i]), ent_name(ent),
+					sizeof(ent->id)) == 0)
+			return &a->ents[i];
+	return NULL;
+}
+
+static int query_archive(struct archive *a, uuid_t uuid, int *nr_labels)
+{
+	struct namespace_label **labels;
+	int i, j, nr;
+
+	for (i = 0; i < a->nr; i++) {
+		struct label_archive_ent *ent = &a->ents[i];
+
+		if (!ent_match(ent))
+			continue;
+		nr = ent_labels(a, ent, &labels);
+		if (nr == -ENOMEM)
+			return nr;
+		if (nr < 0) {
+			printf("%s no valid index block\n", ent_name(ent));
+			continue;
+		}
+		for (j = 0; j < nr; j++) {
+			if (!label_match(labels[j], uuid))
+				continue;
+			label_show(0, ent, labels[j]);
+			(*nr_labels)++;
+		}
+		free(labels);
+	}
+	return 0;
+}
+
+/* report what @new has over @old: '+' added, '-' removed, '~' changed */
+static int diff_ent(struct archive *old, struct label_archive_ent *o,
+		struct archive *new, struct label_archive_ent *n, uuid_t uuid,
+		int *nr_diffs)
+{
+	struct namespace_label **ol = NULL, **nl = NULL;
+	int nr_o = 0, nr_n = 0, i = 0, j = 0, rc;
+
+	if (o) {
+		nr_o = ent_labels(old, o, &ol);
+		if (nr_o == -ENOMEM)
+			return nr_o;
+		nr_o = max(nr_o, 0);
+	}
+	if (n) {
+		nr_n = ent_labels(new, n, &nl);
+		if (nr_n == -ENOMEM) {
+			free(ol);
+			return nr_n;
+		}
+		nr_n = max(nr_n, 0);
+	}
+	qsort(ol, nr_o, sizeof(*ol), label_cmp);
+	qsort(nl, nr_n, sizeof(*nl), label_cmp);
+
+	while (i < nr_o || j < nr_n) {
+		rc = i >= nr_o ? 1 : j >= nr_n ? -1
+			: label_cmp(&ol[i], &nl[j]);
+		if (rc < 0) {
+			if (label_match(ol[i], uuid)) {
+				label_show('-', o, ol[i]);
+				(*nr_diffs)++;
+			}
+			i++;
+		} else if (rc > 0) {
+			if (label_match(nl[j], uuid)) {
+				label_show('+', n, nl[j]);
+				(*nr_diffs)++;
+			}
+			j++;
+		} else {
+			if (!label_same(ol[i], nl[j])
+					&& label_match(nl[j], uuid)) {
+				label_show('-', o, ol[i]);
+				label_show('~', n, nl[j]);
+				(*nr_diffs)++;
+			}
+			i++;
+			j++;
+		}
+	}
+	free(ol);
+	free(nl);
+	return 0;
+}
+
+static int diff_archives(struct archive *old, struct archive *new,
+		uuid_t uuid, int *nr_diffs)
+{
+	struct label_archive_ent *o, *n;
+	int i, rc;
+
+	for (i = 0; i < old->nr; i++) {
+		o = &old->ents[i];
+		if (!ent_match(o))
+			continue;
+		n = archive_find(new, o);
+		rc = diff_ent(old, o, new, n, uuid, nr_diffs);
+		if (rc)
+			return rc;
+	}
+	for (i = 0; i < new->nr; i++) {
+		n = &new->ents[i];
+		if (!ent_match(n) || archive_find(old, n))
+			continue;
+		rc = diff_ent(old, NULL, new, n, uuid, nr_diffs);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+int cmd_query_labels(int argc, const char **argv, struct ndctl_ctx *ctx)
+{
+	const struct option options[] = {
+		OPT_FILENAME('D', "diff", &param.diff, "archive",
+			"show what changed from <archive> to this one"),
+		OPT_STRING('d', "dimm", &param.dimm, "nmem-or-id",
+			"only the dimm with this device name or unique id"),
+		OPT_STRING('u', "uuid", &param.uuid, "uuid",
+			"only labels of the namespace with this uuid"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"ndctl query-labels <archive> [<options>]",
+		NULL
+	};
+	struct archive a, old = { 0 };
+	int i, rc, count = 0;
+	uuid_t uuid = { 0 };
+
+	argc = parse_options(argc, argv, options, u, 0);
+	if (argc == 0)
+		error("specify a label archive, see read-labels --archive\n");
+	for (i = 1; i < argc; i++)
+		error("unknown extra parameter \"%s\"\n", argv[i]);
+	if (param.uuid && uuid_parse(param.uuid, uuid)) {
+		error("failed to parse uuid: '%s'\n", param.uuid);
+		argc = 0;
+	}
+	if (argc != 1)
+		usage_with_options(u, options);
+
+	rc = archive_open(&a, argv[0]);
+	if (rc == 0 && param.diff)
+		rc = archive_open(&old, param.diff);
+	if (rc)
+		goto out;
+
+	if (param.diff) {
+		rc = diff_archives(&old, &a, uuid, &count);
+		if (rc == 0)
+			fprintf(stderr, "%d label difference%s\n", count,
+					count == 1 ? "" : "s");
+	} else {
+		rc = query_archive(&a, uuid, &count);
+		if (rc == 0)
+			fprintf(stderr, "%d label%s in %d dimm%s from %.64s\n",
+					count, count == 1 ? "" : "s", a.nr,
+					a.nr == 1 ? "" : "s", a.hdr->host);
+	}
+	/* a diff exits 1 when there are differences, like diff(1) */
+	if (rc == 0 && param.diff && count)
+		rc = 1;
+ out:
+	archive_close(&old);
+	archive_close(&a);
+	if (rc < 0)
+		fprintf(stderr, "error querying labels: %s\n", strerror(-rc));
+	return rc;
+}
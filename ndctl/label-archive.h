@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __NDCTL_LABEL_ARCHIVE_H__
+#define __NDCTL_LABEL_ARCHIVE_H__
+#include <stdio.h>
+#include <ccan/endian/endian.h>
+#include <ccan/short_types/short_types.h>
+
+/*
+ * 'ndctl read-labels --archive' writes the whole label area of each dimm
+ * into one file that 'ndctl query-labels' maps and walks in place:
+ *
+ *   struct label_archive_hdr          at 0
+ *   struct label_archive_ent[nr]      at @table_off
+ *   label area data                   at each @off, 4K aligned
+ *
+ * All fields are little-endian. Readers reject a @version they do not
+ * know, new fields are only ever added with a new version.
+ */
+#define LABEL_ARCHIVE_SIG_LEN 16
+#define LABEL_ARCHIVE_SIG "NDCTL_LABELS\0\0\0"
+#define LABEL_ARCHIVE_VERSION 1
+#define LABEL_ARCHIVE_ALIGN 4096
+
+/**
+ * struct label_archive_hdr - archive superblock
+ * @sig: LABEL_ARCHIVE_SIG
+ * @version: LABEL_ARCHIVE_VERSION
+ * @nr_dimms: entries in the table
+ * @table_off: offset of the entry table
+ * @size: total archive size
+ * @time: when the archive was written, seconds since the epoch
+ * @host: node name of the host the labels were read on
+ * @checksum: fletcher64 of the header, with this field zero, and the table
+ */
+struct label_archive_hdr {
+	u8 sig[LABEL_ARCHIVE_SIG_LEN];
+	le32 version;
+	le32 nr_dimms;
+	le64 table_off;
+	le64 size;
+	le64 time;
+	char host[64];
+	le64 checksum;
+};
+
+/**
+ * struct label_archive_ent - one dimm's label area
+ * @dev: kernel device name, e.g. "nmem0"
+ * @id: ndctl_dimm_get_unique_id(), empty when the dimm has none
+ * @off: offset of the label area data
+ * @len: size of the label area
+ * @label_size: size of one label slot
+ * @checksum: fletcher64 of the data, zero padded to a multiple of 4 bytes
+ */
+struct label_archive_ent {
+	char dev[16];
+	char id[48];
+	le64 off;
+	le64 len;
+	le32 label_size;
+	u8 reserved[4];
+	le64 checksum;
+};
+
+struct label_archive_src {
+	const char *dev;
+	const char *id;
+	unsigned int label_size;
+	const void *data;
+	size_t len;
+};
+
+int label_archive_write(FILE *f, struct label_archive_src *src, int nr);
+#endif /* __NDCTL_LABEL_ARCHIVE_H__ */
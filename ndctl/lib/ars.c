@@ -1,6 +1,9 @@
 // SPDX-License-Identifier: LGPL-2.1
 // Copyright (C) 2014-2020, Intel Corporation. All rights reserved.
+#include <poll.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <util/size.h>
 #include <ndctl/libndctl.h>
 #include "private.h"
@@ -351,3 +354,151 @@ NDCTL_EXPORT unsigned long long ndctl_cmd_clear_error_get_cleared(
 	dbg(ctx, "invalid clear_err\n");
 	return 0;
 }
+
+struct ars_seen {
+	struct ndctl_range *ranges;
+	unsigned int nr, alloc;
+};
+
+/* insert @addr,@len unless already present, returns 1 when new */
+static int ars_seen_add(struct ars_seen *seen, unsigned long long addr,
+		unsigned long long len)
+{
+	unsigned int lo = 0, hi = seen->nr, mid;
+	struct ndctl_range *r;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		r = &seen->ranges[mid];
+		if (r->address == addr && r->length == len)
+			return 0;
+		if (r->address < addr || (r->address == addr
+					&& r->length < len))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (seen->nr == seen->alloc) {
+		unsigned int alloc = seen->alloc ? seen->alloc * 2 : 64;
+
+		r = realloc(seen->ranges, alloc * sizeof(*r));
+		if (!r)
+			return -ENOMEM;
+		seen->ranges = r;
+		seen->alloc = alloc;
+	}
+	memmove(&seen->ranges[lo + 1], &seen->ranges[lo],
+			(seen->nr - lo) * sizeof(*r));
+	seen->ranges[lo].address = addr;
+	seen->ranges[lo].length = len;
+	seen->nr++;
+	return 1;
+}
+
+/**
+ * ndctl_bus_stream_ars_records - deliver ARS records as a scrub finds them
+ * @ars_cap: successfully completed ars_cap command for the range to watch
+ * @poll_interval: seconds between interim ARS status queries, 0 for none
+ * @timeout: total number of seconds to wait, 0 to wait for completion
+ * @fn: called once per distinct error record
+ * @data: passed through to @fn
+ *
+ * Firmware reports the records found so far while a scrub is still in
+ * progress, so a caller can start recovery on the first bad ranges long
+ * before a large scrub finishes. Each (address, length) record is handed
+ * to @fn exactly once, however many status queries return it. Between
+ * queries this sleeps in poll() on the bus 'scrub' attribute, which the
+ * kernel notifies when its scrub completes, rather than re-reading on a
+ * timer. A scrub not started by the kernel sends no notification, so
+ * waiting on one needs a @poll_interval.
+ *
+ * Returns 0 once the firmware reports the scrub complete and the final
+ * records have been delivered, -ETIMEDOUT when @timeout expires, the
+ * first non-zero return of @fn, or another negative error code.
+ */
+NDCTL_EXPORT int ndctl_bus_stream_ars_records(struct ndctl_cmd *ars_cap,
+		unsigned int poll_interval, unsigned int timeout,
+		ndctl_ars_record_fn fn, void *data)
+{
+	struct ndctl_bus *bus = ars_cap->bus;
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	struct ars_seen seen = { 0 };
+	struct ndctl_cmd *ars_stat;
+	struct pollfd fds = { 0 };
+	unsigned long long addr, len;
+	unsigned int i, nr, waited = 0, tmo;
+	char buf[1];
+	int rc;
+
+	ars_stat = ndctl_bus_cmd_new_ars_status(ars_cap);
+	if (!ars_stat)
+		return -ENOTTY;
+
+	fds.fd = open(bus->scrub_path, O_RDONLY|O_CLOEXEC);
+	if (fds.fd < 0) {
+		rc = -errno;
+		goto out;
+	}
+
+	for (;;) {
+		/* arm the notification before sampling the firmware state */
+		if (pread(fds.fd, buf, sizeof(buf), 0) < 0) {
+			rc = -errno;
+			break;
+		}
+
+		ars_stat->ars_status->out_length = ars_cap->ars_cap->max_ars_out;
+		rc = ndctl_cmd_submit(ars_stat);
+		if (rc < 0)
+			break;
+		if (!validate_ars_stat(ctx, ars_stat)) {
+			rc = -ENXIO;
+			break;
+		}
+
+		nr = ars_stat->ars_status->num_records;
+		for (i = 0, rc = 0; i < nr && rc == 0; i++) {
+			addr = ars_stat->ars_status->records[i].err_address;
+			len = ars_stat->ars_status->records[i].length;
+			rc = ars_seen_add(&seen, addr, len);
+			if (rc > 0)
+				rc = fn(bus, addr, len, data);
+		}
+		if (rc)
+			break;
+
+		if (!ndctl_cmd_ars_in_progress(ars_stat)) {
+			if (ars_stat->ars_status->flags
+					& ND_ARS_STAT_FLAG_OVERFLOW)
+				dbg(ctx, "records truncated at %#llx\n",
+					(unsigned long long) ars_stat->ars_status->restart_address);
+			break;
+		}
+
+		if (timeout && waited >= timeout) {
+			rc = -ETIMEDOUT;
+			break;
+		}
+		tmo = poll_interval;
+		if (timeout && (!tmo || tmo > timeout - waited))
+			tmo = timeout - waited;
+
+		rc = poll(&fds, 1, tmo ? (int) tmo * 1000 : -1);
+		if (rc < 0) {
+			rc = -errno;
+			break;
+		}
+		dbg(ctx, "%s: %s after %u records\n",
+				ndctl_bus_get_provider(bus),
+				rc ? "scrub event" : "poll interval", seen.nr);
+		fds.revents = 0;
+		waited += tmo;
+	}
+
+	close(fds.fd);
+ out:
+	free(seen.ranges);
+	ndctl_cmd_unref(ars_stat);
+	return rc;
+}
@@ -5,11 +5,12 @@
 #include <util/fletcher.h>
 #include <util/bitmap.h>
 #include <util/sysfs.h>
+#include <ccan/minmax/minmax.h>
 #include <stdlib.h>
 #include <poll.h>
 #include "private.h"
 
-static const char NSINDEX_SIGNATURE[] = "NAMESPACE_INDEX\0";
+static const char NSINDEX_SIGNATURE[] = NSINDEX_SIG;
 
 /*
  * Note, best_seq(), inc_seq(), sizeof_namespace_index()
@@ -157,75 +158,12 @@ static int __label_validate(struct nvdimm_data *ndd)
 	u32 seq;
 
 	for (i = 0; i < num_index; i++) {
-		u32 nslot;
-		u8 sig[NSINDEX_SIG_LEN];
-		u64 sum_save, sum, size;
-		unsigned int version, labelsize;
-
-		memcpy(sig, nsindex[i]->sig, NSINDEX_SIG_LEN);
-		if (memcmp(sig, NSINDEX_SIGNATURE, NSINDEX_SIG_LEN) != 0) {
-			dbg(ctx, "nsindex%d signature invalid\n", i);
-			continue;
-		}
-
-		/* label sizes larger than 128 arrived with v1.2 */
-		version = le16_to_cpu(nsindex[i]->major) * 100
-			+ le16_to_cpu(nsindex[i]->minor);
-		if (version >= 102)
-			labelsize = 1 << (7 + nsindex[i]->labelsize);
-		else
-			labelsize = 128;
-
-		if (labelsize != sizeof_namespace_label(ndd)) {
-			dbg(ctx, "nsindex%d labelsize %d invalid\n",
-					i, nsindex[i]->labelsize);
-			continue;
-		}
-
-		sum_save = le64_to_cpu(nsindex[i]->checksum);
-		nsindex[i]->checksum = cpu_to_le64(0);
-		sum = fletcher64(nsindex[i], sizeof_namespace_index(ndd), 1);
-		nsindex[i]->checksum = cpu_to_le64(sum_save);
-		if (sum != sum_save) {
-			dbg(ctx, "nsindex%d checksum invalid\n", i);
-			continue;
-		}
-
-		seq = le32_to_cpu(nsindex[i]->seq);
-		if ((seq & NSINDEX_SEQ_MASK) == 0) {
-			dbg(ctx, "nsindex%d sequence: %#x invalid\n", i, seq);
-			continue;
-		}
+		const char *bad;
 
-		/* sanity check the index against expected values */
-		if (le64_to_cpu(nsindex[i]->myoff)
-				!= i * sizeof_namespace_index(ndd)) {
-			dbg(ctx, "nsindex%d myoff: %#llx invalid\n",
-					i, (unsigned long long)
-					le64_to_cpu(nsindex[i]->myoff));
-			continue;
-		}
-		if (le64_to_cpu(nsindex[i]->otheroff)
-				!= (!i) * sizeof_namespace_index(ndd)) {
-			dbg(ctx, "nsindex%d otheroff: %#llx invalid\n",
-					i, (unsigned long long)
-					le64_to_cpu(nsindex[i]->otheroff));
-			continue;
-		}
-
-		size = le64_to_cpu(nsindex[i]->mysize);
-		if (size > sizeof_namespace_index(ndd)
-				|| size < sizeof(struct namespace_index)) {
-			dbg(ctx, "nsindex%d mysize: %#zx invalid\n", i, size);
-			continue;
-		}
-
-		nslot = le32_to_cpu(nsindex[i]->nslot);
-		if (nslot * sizeof_namespace_label(ndd)
-				+ 2 * sizeof_namespace_index(ndd)
-				> ndd->config_size) {
-			dbg(ctx, "nsindex%d nslot: %u invalid, config_size: %#zx\n",
-					i, nslot, ndd->config_size);
+		bad = nsindex_verify(nsindex[i], i, sizeof_namespace_index(ndd),
+				sizeof_namespace_label(ndd), ndd->config_size);
+		if (bad) {
+			dbg(ctx, "nsindex%d %s invalid\n", i, bad);
 			continue;
 		}
 		valid[i] = true;
@@ -323,17 +261,21 @@ static int label_validate(struct nvdimm_data *ndd)
 	return -EINVAL;
 }
 
-static int nvdimm_set_config_data(struct nvdimm_data *ndd, size_t offset,
-		void *buf, size_t len)
+static int cfg_write_extent(struct ndctl_cmd *cmd_read, const void *buf,
+		unsigned int len, unsigned int offset)
 {
 	struct ndctl_cmd *cmd_write;
 	int rc;
 
-	cmd_write = ndctl_dimm_cmd_new_cfg_write(ndd->cmd_read);
+	cmd_write = ndctl_dimm_cmd_new_cfg_write(cmd_read);
 	if (!cmd_write)
 		return -ENXIO;
 
-	rc = ndctl_cmd_cfg_write_set_data(cmd_write, buf, len, offset);
+	rc = ndctl_cmd_cfg_write_set_extent(cmd_write, len, offset);
+	if (rc < 0)
+		goto out;
+
+	rc = ndctl_cmd_cfg_write_set_data(cmd_write, (void *) buf, len, offset);
 	if (rc < 0)
 		goto out;
 
@@ -345,6 +287,57 @@ static int nvdimm_set_config_data(struct nvdimm_data *ndd, size_t offset,
 	return rc;
 }
 
+/*
+ * The read buffer of @cmd_read mirrors what is on the dimm, so compare
+ * @buf against it a max_xfer block at a time and only write back the
+ * runs of blocks that changed. Returns the number of bytes written.
+ */
+static ssize_t cfg_write_changed(struct ndctl_cmd *cmd_read, const void *buf,
+		unsigned int len, unsigned int offset)
+{
+	const char *cur = cmd_read->iter.total_buf, *src = buf;
+	unsigned int xfer = cmd_read->iter.max_xfer ? : len;
+	unsigned int start, end, run = UINT_MAX;
+	ssize_t written = 0;
+	int rc;
+
+	for (start = offset; start < offset + len; start = end) {
+		end = min(start - start % xfer + xfer, offset + len);
+		if (memcmp(cur + start, src + (start - offset),
+					end - start) != 0) {
+			if (run == UINT_MAX)
+				run = start;
+			continue;
+		}
+		if (run == UINT_MAX)
+			continue;
+		rc = cfg_write_extent(cmd_read, src + (run - offset),
+				start - run, run);
+		if (rc < 0)
+			return rc;
+		written += start - run;
+		run = UINT_MAX;
+	}
+
+	if (run != UINT_MAX) {
+		rc = cfg_write_extent(cmd_read, src + (run - offset),
+				offset + len - run, run);
+		if (rc < 0)
+			return rc;
+		written += offset + len - run;
+	}
+
+	return written;
+}
+
+static int nvdimm_set_config_data(struct nvdimm_data *ndd, size_t offset,
+		void *buf, size_t len)
+{
+	ssize_t rc = cfg_write_changed(ndd->cmd_read, buf, len, offset);
+
+	return rc < 0 ? rc : 0;
+}
+
 static int label_next_nsindex(int index)
 {
 	if (index < 0)
@@ -381,6 +374,7 @@ static int write_label_index(struct ndctl_dimm *dimm,
 	unsigned long offset;
 	u64 checksum;
 	u32 nslot;
+	int rc;
 
 	/*
 	 * We may have initialized ndd to whatever labelsize is
@@ -398,14 +392,19 @@ static int write_label_index(struct ndctl_dimm *dimm,
 		return -EINVAL;
 	}
 
-	nsindex = to_namespace_index(ndd, index);
+	/* build the block aside so that only what changed gets written */
+	nsindex = malloc(sizeof_namespace_index(ndd));
+	if (!nsindex)
+		return -ENOMEM;
+	memcpy(nsindex, to_namespace_index(ndd, index),
+			sizeof_namespace_index(ndd));
 	nslot = nvdimm_num_label_slots(ndd);
 
 	memcpy(nsindex->sig, NSINDEX_SIGNATURE, NSINDEX_SIG_LEN);
 	memset(nsindex->flags, 0, 3);
 	nsindex->labelsize = sizeof_namespace_label(ndd) >> 8;
 	nsindex->seq = cpu_to_le32(seq);
-	offset = (unsigned long) nsindex
+	offset = (unsigned long) to_namespace_index(ndd, index)
 		- (unsigned long) to_namespace_index(ndd, 0);
 	nsindex->myoff = cpu_to_le64(offset);
 	nsindex->mysize = cpu_to_le64(sizeof_namespace_index(ndd));
@@ -427,8 +426,10 @@ static int write_label_index(struct ndctl_dimm *dimm,
 	memset(nsindex->free, 0xff, ALIGN(nslot, BITS_PER_LONG) / 8);
 	checksum = fletcher64(nsindex, sizeof_namespace_index(ndd), 1);
 	nsindex->checksum = cpu_to_le64(checksum);
-	return nvdimm_set_config_data(ndd, le64_to_cpu(nsindex->myoff),
+	rc = nvdimm_set_config_data(ndd, le64_to_cpu(nsindex->myoff),
 			nsindex, sizeof_namespace_index(ndd));
+	free(nsindex);
+	return rc;
 }
 
 NDCTL_EXPORT int ndctl_dimm_init_labels(struct ndctl_dimm *dimm,
@@ -585,8 +586,9 @@ NDCTL_EXPORT int ndctl_dimm_zero_label_extent(struct ndctl_dimm *dimm,
 		unsigned int len, unsigned int offset)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	struct ndctl_cmd *cmd_read, *cmd_write;
-	int rc;
+	struct ndctl_cmd *cmd_read;
+	void *zero_buf;
+	ssize_t rc;
 
 	cmd_read = ndctl_dimm_read_label_extent(dimm, len, offset);
 	if (!cmd_read)
@@ -599,33 +601,38 @@ NDCTL_EXPORT int ndctl_dimm_zero_label_extent(struct ndctl_dimm *dimm,
 		goto out_read;
 	}
 
-	cmd_write = ndctl_dimm_cmd_new_cfg_write(cmd_read);
-	if (!cmd_write) {
+	if (!ndctl_dimm_is_cmd_supported(dimm, ND_CMD_SET_CONFIG_DATA)) {
 		rc = -ENOTTY;
 		goto out_read;
 	}
-	if (ndctl_cmd_cfg_write_zero_data(cmd_write) < 0) {
-		rc = -ENXIO;
-		goto out_write;
+
+	len = cmd_read->iter.total_xfer;
+	offset = cmd_read->iter.init_offset;
+	zero_buf = calloc(1, len);
+	if (!zero_buf) {
+		rc = -ENOMEM;
+		goto out_read;
 	}
-	rc = ndctl_cmd_submit_xlat(cmd_write);
-	if (rc < 0)
-		goto out_write;
+
+	/* blocks that already read back as zero are left alone */
+	rc = cfg_write_changed(cmd_read, zero_buf, len, offset);
+	free(zero_buf);
+	if (rc <= 0)
+		goto out_read;
 
 	/*
 	 * If the dimm is already disabled the kernel is not holding a cached
 	 * copy of the label space.
 	 */
+	rc = 0;
 	if (!ndctl_dimm_is_enabled(dimm))
-		goto out_write;
+		goto out_read;
 
 	rc = ndctl_dimm_disable(dimm);
 	if (rc)
-		goto out_write;
+		goto out_read;
 	rc = ndctl_dimm_enable(dimm);
 
- out_write:
-	ndctl_cmd_unref(cmd_write);
  out_read:
 	ndctl_cmd_unref(cmd_read);
 
@@ -641,8 +648,8 @@ NDCTL_EXPORT unsigned long ndctl_dimm_get_available_labels(
 		struct ndctl_dimm *dimm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
-	int rc, len = dimm->buf_len;
+	char path[PATH_MAX];
+	int rc, len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 
 	if (snprintf(path, len, "%s/available_slots", dimm->dimm_path) >= len) {
@@ -665,9 +672,9 @@ NDCTL_EXPORT enum ndctl_security_state ndctl_dimm_get_security(
 		struct ndctl_dimm *dimm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = dimm->buf_len;
+	int len = sizeof(path);
 	int rc;
 
 	if (snprintf(path, len, "%s/security", dimm->dimm_path) >= len) {
@@ -697,9 +704,9 @@ NDCTL_EXPORT enum ndctl_security_state ndctl_dimm_get_security(
 NDCTL_EXPORT bool ndctl_dimm_security_is_frozen(struct ndctl_dimm *dimm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = dimm->buf_len;
+	int len = sizeof(path);
 	int rc;
 
 
@@ -722,8 +729,8 @@ NDCTL_EXPORT bool ndctl_dimm_security_is_frozen(struct ndctl_dimm *dimm)
 static int write_security(struct ndctl_dimm *dimm, const char *cmd)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
-	int len = dimm->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/security", dimm->dimm_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -773,14 +780,18 @@ NDCTL_EXPORT int ndctl_dimm_overwrite(struct ndctl_dimm *dimm, long key)
 	return write_security(dimm, buf);
 }
 
-NDCTL_EXPORT int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm)
+/*
+ * Open @dimm's security attribute for polling. Returns 0 with *@fd set
+ * if an overwrite is in flight, 0 with *@fd left at -1 if there is
+ * nothing to wait for, or -errno.
+ */
+static int overwrite_wait_open(struct ndctl_dimm *dimm, int *fd)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	struct pollfd fds;
 	char buf[SYSFS_ATTR_SIZE];
-	int fd = 0, rc;
-	char *path = dimm->dimm_buf;
-	int len = dimm->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
+	int rc;
 
 	if (snprintf(path, len, "%s/security", dimm->dimm_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -788,52 +799,52 @@ NDCTL_EXPORT int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm)
 		return -ERANGE;
 	}
 
-	fd = open(path, O_RDONLY|O_CLOEXEC);
-	if (fd < 0) {
+	rc = open(path, O_RDONLY|O_CLOEXEC);
+	if (rc < 0) {
 		rc = -errno;
 		err(ctx, "open: %s\n", strerror(errno));
 		return rc;
 	}
-	memset(&fds, 0, sizeof(fds));
-	fds.fd = fd;
 
-	rc = sysfs_read_attr(ctx, path, buf);
-	if (rc < 0) {
-		rc = -EOPNOTSUPP;
-		goto out;
+	if (sysfs_read_attr(ctx, path, buf) < 0) {
+		close(rc);
+		return -EOPNOTSUPP;
 	}
 	/* skipping if we aren't in overwrite state */
 	if (strcmp(buf, "overwrite") != 0) {
-		rc = 0;
-		goto out;
+		close(rc);
+		return 0;
 	}
 
-	for (;;) {
-		rc = sysfs_read_attr(ctx, path, buf);
-		if (rc < 0) {
-			rc = -EOPNOTSUPP;
-			break;
-		}
+	*fd = rc;
+	return 0;
+}
 
-		if (strncmp(buf, "overwrite", 9) == 0) {
-			rc = poll(&fds, 1, -1);
-			if (rc < 0) {
-				rc = -errno;
-				err(ctx, "poll error: %s\n", strerror(errno));
-				break;
-			}
-			dbg(ctx, "poll wake: revents: %d\n", fds.revents);
-			if (pread(fd, buf, 1, 0) == -1) {
-				rc = -errno;
-				break;
-			}
-			fds.revents = 0;
-		} else {
-			if (strncmp(buf, "disabled", 8) == 0)
-				rc = 1;
-			break;
-		}
-	}
+/*
+ * Re-read the state through the polled descriptor, which also re-arms
+ * it. Returns 1 once the overwrite has finished with security disabled,
+ * 0 if it finished otherwise, -EAGAIN while it is still running.
+ */
+static int overwrite_wait_check(int fd)
+{
+	char buf[SYSFS_ATTR_SIZE];
+	ssize_t n;
+
+	n = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (n < 0)
+		return -errno;
+	buf[n] = 0;
+
+	if (strncmp(buf, "overwrite", 9) == 0)
+		return -EAGAIN;
+	if (strncmp(buf, "disabled", 8) == 0)
+		return 1;
+	return 0;
+}
+
+static void overwrite_wait_done(struct ndctl_dimm *dimm, int rc)
+{
+	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
 
 	if (rc == 1)
 		dbg(ctx, "%s: overwrite complete\n",
@@ -844,12 +855,89 @@ NDCTL_EXPORT int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm)
 	else
 		dbg(ctx, "%s: overwrite error waiting for complete\n",
 				ndctl_dimm_get_devname(dimm));
+}
 
- out:
-	close(fd);
+/**
+ * ndctl_dimm_wait_overwrite_many() - wait for several overwrites at once
+ * @dimms: dimms that may have an overwrite in flight
+ * @count: number of entries in @dimms
+ * @results: per-dimm outcome, as ndctl_dimm_wait_overwrite() returns it
+ *
+ * One poll() loop covers every dimm's security attribute, so the wait
+ * lasts as long as the slowest overwrite rather than the sum of them.
+ * Returns 0 when every dimm has settled, or -errno if poll() itself
+ * failed, in which case the dimms still pending report that error.
+ */
+NDCTL_EXPORT int ndctl_dimm_wait_overwrite_many(struct ndctl_dimm **dimms,
+		int count, int *results)
+{
+	struct ndctl_ctx *ctx;
+	struct pollfd *fds;
+	int i, rc = 0, pending = 0;
+
+	if (count <= 0)
+		return 0;
+	ctx = ndctl_dimm_get_ctx(dimms[0]);
+
+	fds = calloc(count, sizeof(*fds));
+	if (!fds)
+		return -ENOMEM;
+
+	for (i = 0; i < count; i++) {
+		/* poll() skips negative descriptors */
+		fds[i].fd = -1;
+		results[i] = overwrite_wait_open(dimms[i], &fds[i].fd);
+		if (fds[i].fd >= 0)
+			pending++;
+		else
+			overwrite_wait_done(dimms[i], results[i]);
+	}
+
+	while (pending) {
+		rc = poll(fds, count, -1);
+		if (rc < 0) {
+			rc = -errno;
+			err(ctx, "poll error: %s\n", strerror(errno));
+			break;
+		}
+		rc = 0;
+
+		for (i = 0; i < count; i++) {
+			if (fds[i].fd < 0 || !fds[i].revents)
+				continue;
+			dbg(ctx, "%s: poll wake: revents: %d\n",
+					ndctl_dimm_get_devname(dimms[i]),
+					fds[i].revents);
+			fds[i].revents = 0;
+			results[i] = overwrite_wait_check(fds[i].fd);
+			if (results[i] == -EAGAIN)
+				continue;
+			overwrite_wait_done(dimms[i], results[i]);
+			close(fds[i].fd);
+			fds[i].fd = -1;
+			pending--;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (fds[i].fd < 0)
+			continue;
+		results[i] = rc;
+		overwrite_wait_done(dimms[i], rc);
+		close(fds[i].fd);
+	}
+	free(fds);
 	return rc;
 }
 
+NDCTL_EXPORT int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm)
+{
+	int rc, result;
+
+	rc = ndctl_dimm_wait_overwrite_many(&dimm, 1, &result);
+	return rc < 0 ? rc : result;
+}
+
 NDCTL_EXPORT int ndctl_dimm_update_master_passphrase(struct ndctl_dimm *dimm,
 		long ckey, long nkey)
 {
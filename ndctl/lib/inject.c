@@ -126,30 +126,14 @@ out:
 	return rc;
 }
 
-static int ndctl_namespace_inject_one_error(struct ndctl_namespace *ndns,
-		unsigned long long block, unsigned int flags)
+static int submit_err_inj(struct ndctl_bus *bus, u64 offset, u64 length,
+		unsigned int flags)
 {
-	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
 	struct nd_cmd_ars_err_inj *err_inj;
 	struct nd_cmd_pkg *pkg;
 	struct ndctl_cmd *cmd;
-	u64 offset, length;
-	int rc, clear_unit;
-
-	rc = block_to_spa_offset(ndns, block, 1, &offset, &length);
-	if (rc)
-		return rc;
-
-	clear_unit = ndctl_namespace_get_clear_unit(ndns);
-	if (clear_unit < 0)
-		return clear_unit;
-
-	if (!(flags & (1 << NDCTL_NS_INJECT_SATURATE))) {
-		/* clamp injection length per block to the clear_unit */
-		if (length > (unsigned int)clear_unit)
-			length = clear_unit;
-	}
+	int rc;
 
 	cmd = ndctl_bus_cmd_new_err_inj(bus);
 	if (!cmd)
@@ -174,62 +158,14 @@ static int ndctl_namespace_inject_one_error(struct ndctl_namespace *ndns,
 	return rc;
 }
 
-NDCTL_EXPORT int ndctl_namespace_inject_error2(struct ndctl_namespace *ndns,
-		unsigned long long block, unsigned long long count,
+static int submit_err_inj_clr(struct ndctl_bus *bus, u64 offset, u64 length,
 		unsigned int flags)
 {
-	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
-	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
-	unsigned long long i;
-	int rc = -EINVAL;
-
-	if (!ndctl_bus_has_error_injection(bus))
-		return -EOPNOTSUPP;
-	if (!ndctl_bus_has_nfit(bus))
-		return -EOPNOTSUPP;
-
-	for (i = 0; i < count; i++) {
-		rc = ndctl_namespace_inject_one_error(ndns, block + i, flags);
-		if (rc) {
-			err(ctx, "Injection failed at block %llx\n",
-				block + i);
-			return rc;
-		}
-	}
-	return rc;
-}
-
-NDCTL_EXPORT int ndctl_namespace_inject_error(struct ndctl_namespace *ndns,
-		unsigned long long block, unsigned long long count, bool notify)
-{
-	return ndctl_namespace_inject_error2(ndns, block, count,
-		notify ? (1 << NDCTL_NS_INJECT_NOTIFY) : 0);
-}
-
-static int ndctl_namespace_uninject_one_error(struct ndctl_namespace *ndns,
-		unsigned long long block, unsigned int flags)
-{
-	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
 	struct nd_cmd_ars_err_inj_clr *err_inj_clr;
 	struct nd_cmd_pkg *pkg;
 	struct ndctl_cmd *cmd;
-	u64 offset, length;
-	int rc, clear_unit;
-
-	rc = block_to_spa_offset(ndns, block, 1, &offset, &length);
-	if (rc)
-		return rc;
-
-	clear_unit = ndctl_namespace_get_clear_unit(ndns);
-	if (clear_unit < 0)
-		return clear_unit;
-
-	if (!(flags & (1 << NDCTL_NS_INJECT_SATURATE))) {
-		/* clamp injection length per block to the clear_unit */
-		if (length > (unsigned int)clear_unit)
-			length = clear_unit;
-	}
+	int rc;
 
 	cmd = ndctl_bus_cmd_new_err_inj_clr(bus);
 	if (!cmd)
@@ -252,32 +188,157 @@ static int ndctl_namespace_uninject_one_error(struct ndctl_namespace *ndns,
 	return rc;
 }
 
-NDCTL_EXPORT int ndctl_namespace_uninject_error2(struct ndctl_namespace *ndns,
-		unsigned long long block, unsigned long long count,
-		unsigned int flags)
+static int inject_range_cmp(const void *a, const void *b)
+{
+	const struct ndctl_inject_range *ra = a, *rb = b;
+
+	if (ra->block < rb->block)
+		return -1;
+	return ra->block > rb->block;
+}
+
+/*
+ * Sort and coalesce the requested ranges, then cover each with as few
+ * DSMs as the injection granularity allows. Without --saturate only the
+ * first clear_unit bytes of every block are poisoned, so blocks can only
+ * share a DSM when clear_unit spans the whole block.
+ */
+static int namespace_inject_ranges(struct ndctl_namespace *ndns,
+		const struct ndctl_inject_range *ranges, unsigned int nr,
+		unsigned int flags, bool clear)
 {
 	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
-	unsigned long long i;
-	int rc = -EINVAL;
+	struct ndctl_inject_range *r;
+	unsigned long long i, end;
+	unsigned int n, nr_cmds = 0;
+	int rc, clear_unit;
+	u64 offset, length;
+	bool whole;
 
 	if (!ndctl_bus_has_error_injection(bus))
 		return -EOPNOTSUPP;
 	if (!ndctl_bus_has_nfit(bus))
 		return -EOPNOTSUPP;
+	if (!nr)
+		return -EINVAL;
 
-	for (i = 0; i < count; i++) {
-		rc = ndctl_namespace_uninject_one_error(ndns, block + i,
-			flags);
-		if (rc) {
-			err(ctx, "Un-injection failed at block %llx\n",
-				block + i);
-			return rc;
+	r = calloc(nr, sizeof(*r));
+	if (!r)
+		return -ENOMEM;
+	for (i = 0, n = 0; i < nr; i++)
+		if (ranges[i].count)
+			r[n++] = ranges[i];
+	if (!n) {
+		rc = -EINVAL;
+		goto out;
+	}
+	qsort(r, n, sizeof(*r), inject_range_cmp);
+	for (i = 1, nr = 1; i < n; i++) {
+		struct ndctl_inject_range *last = &r[nr - 1];
+
+		end = last->block + last->count;
+		if (r[i].block <= end) {
+			if (r[i].block + r[i].count > end)
+				last->count = r[i].block + r[i].count
+					- last->block;
+		} else
+			r[nr++] = r[i];
+	}
+
+	clear_unit = ndctl_namespace_get_clear_unit(ndns);
+	if (clear_unit < 0) {
+		rc = clear_unit;
+		goto out;
+	}
+	whole = (flags & (1 << NDCTL_NS_INJECT_SATURATE)) || clear_unit >= 512;
+
+	/* the last range is the furthest, so it bounds them all */
+	rc = block_to_spa_offset(ndns, r[nr - 1].block, r[nr - 1].count,
+			&offset, &length);
+	if (rc)
+		goto out;
+
+	for (n = 0; n < nr && rc == 0; n++) {
+		block_to_spa_offset(ndns, r[n].block, r[n].count, &offset,
+				&length);
+
+		for (i = 0; i < r[n].count; i++) {
+			u64 off = offset + i * 512;
+			u64 len = whole ? length : (u64) clear_unit;
+
+			if (clear)
+				rc = submit_err_inj_clr(bus, off, len, flags);
+			else
+				rc = submit_err_inj(bus, off, len, flags);
+			nr_cmds++;
+			if (rc) {
+				err(ctx, "%s failed at block %llx\n",
+					clear ? "Un-injection" : "Injection",
+					r[n].block + i);
+				break;
+			}
+			if (whole)
+				break;
 		}
 	}
+	dbg(ctx, "%s: %u ranges in %u commands\n",
+			ndctl_namespace_get_devname(ndns), nr, nr_cmds);
+ out:
+	free(r);
 	return rc;
 }
 
+/**
+ * ndctl_namespace_inject_errors - inject media errors at many ranges
+ * @ndns: namespace to inject into
+ * @ranges: array of 512-byte block ranges, relative to the namespace
+ * @nr: number of entries in @ranges
+ * @flags: bitmask of enum ndctl_namespace_inject_flags
+ *
+ * Overlapping and adjacent ranges are merged first, and the whole set
+ * is validated against the namespace before any command is sent. On
+ * failure the ranges before the failing one stay injected.
+ */
+NDCTL_EXPORT int ndctl_namespace_inject_errors(struct ndctl_namespace *ndns,
+		const struct ndctl_inject_range *ranges, unsigned int nr,
+		unsigned int flags)
+{
+	return namespace_inject_ranges(ndns, ranges, nr, flags, false);
+}
+
+NDCTL_EXPORT int ndctl_namespace_uninject_errors(struct ndctl_namespace *ndns,
+		const struct ndctl_inject_range *ranges, unsigned int nr,
+		unsigned int flags)
+{
+	return namespace_inject_ranges(ndns, ranges, nr, flags, true);
+}
+
+NDCTL_EXPORT int ndctl_namespace_inject_error2(struct ndctl_namespace *ndns,
+		unsigned long long block, unsigned long long count,
+		unsigned int flags)
+{
+	struct ndctl_inject_range range = { block, count };
+
+	return namespace_inject_ranges(ndns, &range, 1, flags, false);
+}
+
+NDCTL_EXPORT int ndctl_namespace_inject_error(struct ndctl_namespace *ndns,
+		unsigned long long block, unsigned long long count, bool notify)
+{
+	return ndctl_namespace_inject_error2(ndns, block, count,
+		notify ? (1 << NDCTL_NS_INJECT_NOTIFY) : 0);
+}
+
+NDCTL_EXPORT int ndctl_namespace_uninject_error2(struct ndctl_namespace *ndns,
+		unsigned long long block, unsigned long long count,
+		unsigned int flags)
+{
+	struct ndctl_inject_range range = { block, count };
+
+	return namespace_inject_ranges(ndns, &range, 1, flags, true);
+}
+
 NDCTL_EXPORT int ndctl_namespace_uninject_error(struct ndctl_namespace *ndns,
 		unsigned long long block, unsigned long long count)
 {
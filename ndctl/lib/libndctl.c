@@ -10,6 +10,7 @@
 #include <errno.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include <fcntl.h>
 #include <dirent.h>
 #include <sys/stat.h>
@@ -24,6 +25,8 @@
 #include <util/util.h>
 #include <util/size.h>
 #include <util/sysfs.h>
+#include <util/pool.h>
+#include <util/usdt.h>
 #include <ndctl/libndctl.h>
 #include <ndctl/namespace.h>
 #include <daxctl/libdaxctl.h>
@@ -117,7 +120,7 @@ struct ndctl_mapping {
 
 /**
  * struct ndctl_region - container for 'pmem' or 'block' capacity
- * @module: kernel module
+ * @modalias: kernel module alias, resolved at enable time
  * @mappings: number of extent ranges contributing to the region
  * @size: total capacity of the region before resolving aliasing
  * @type: integer nd-bus device-type
@@ -137,7 +140,7 @@ struct ndctl_mapping {
  * specify the cleanup flag to ndctl_region_disable().
  */
 struct ndctl_region {
-	struct kmod_module *module;
+	char *modalias;
 	struct ndctl_bus *bus;
 	int id, num_mappings, nstype, range_index, ro;
 	unsigned long align;
@@ -149,8 +152,6 @@ struct ndctl_region {
 	int refresh_type;
 	unsigned long long size;
 	char *region_path;
-	char *region_buf;
-	int buf_len;
 	int generation;
 	int numa_node, target_node;
 	struct list_head btts;
@@ -173,6 +174,9 @@ struct ndctl_region {
 		unsigned long long cookie;
 	} iset;
 	struct badblocks_iter bb_iter;
+	struct badblock *bb_index;
+	unsigned int nr_bb_index;
+	int bb_index_init;
 	enum ndctl_persistence_domain persistence_domain;
 	/* file descriptor for deep flush sysfs entry */
 	int flush_fd;
@@ -180,45 +184,41 @@ struct ndctl_region {
 
 /**
  * struct ndctl_btt - stacked block device provided sector atomicity
- * @module: kernel module (nd_btt)
+ * @modalias: kernel module alias (nd_btt)
  * @lbasize: sector size info
  * @size: usable size of the btt after removing metadata etc
  * @ndns: host namespace for the btt instance
  * @region: parent region
  * @btt_path: btt devpath
  * @uuid: unique identifier for a btt instance
- * @btt_buf: space to print paths for bind/unbind operations
  * @bdev: block device associated with a btt
  */
 struct ndctl_btt {
-	struct kmod_module *module;
+	char *modalias;
 	struct ndctl_region *region;
 	struct ndctl_namespace *ndns;
 	struct list_node list;
 	struct ndctl_lbasize lbasize;
 	unsigned long long size;
 	char *btt_path;
-	char *btt_buf;
 	char *bdev;
-	int buf_len;
 	uuid_t uuid;
 	int id, generation;
 };
 
 /**
  * struct ndctl_pfn - reservation for per-page-frame metadata
- * @module: kernel module (nd_pfn)
+ * @modalias: kernel module alias (nd_pfn)
  * @ndns: host namespace for the pfn instance
  * @loc: host metadata location (ram or pmem (default))
  * @align: data offset alignment
  * @region: parent region
  * @pfn_path: pfn devpath
  * @uuid: unique identifier for a pfn instance
- * @pfn_buf: space to print paths for bind/unbind operations
  * @bdev: block device associated with a pfn
  */
 struct ndctl_pfn {
-	struct kmod_module *module;
+	char *modalias;
 	struct ndctl_region *region;
 	struct ndctl_namespace *ndns;
 	struct list_node list;
@@ -226,9 +226,7 @@ struct ndctl_pfn {
 	unsigned long align;
 	unsigned long long resource, size;
 	char *pfn_path;
-	char *pfn_buf;
 	char *bdev;
-	int buf_len;
 	uuid_t uuid;
 	int id, generation;
 	struct ndctl_lbasize alignments;
@@ -275,38 +273,35 @@ NDCTL_EXPORT void ndctl_set_userdata(struct ndctl_ctx *ctx, void *userdata)
  */
 NDCTL_EXPORT int ndctl_new(struct ndctl_ctx **ctx)
 {
-	struct daxctl_ctx *daxctl_ctx;
-	struct kmod_ctx *kmod_ctx;
+	pthread_mutexattr_t attr;
 	struct ndctl_ctx *c;
 	struct udev *udev;
 	const char *env;
-	int rc = 0;
 
 	udev = udev_new();
 	if (check_udev(udev) != 0)
 		return -ENXIO;
 
-	kmod_ctx = kmod_new(NULL, NULL);
-	if (check_kmod(kmod_ctx) != 0) {
-		rc = -ENXIO;
-		goto err_kmod;
-	}
-
-	rc = daxctl_new(&daxctl_ctx);
-	if (rc)
-		goto err_daxctl;
-
 	c = calloc(1, sizeof(struct ndctl_ctx));
 	if (!c) {
-		rc = -ENOMEM;
-		goto err_ctx;
+		udev_unref(udev);
+		return -ENOMEM;
 	}
 
 	c->refcount = 1;
 	log_init(&c->ctx, "libndctl", "NDCTL_LOG");
 	c->udev = udev;
 	c->timeout = 5000;
+	c->probe_unsettled = 1;
+	c->daxctl_log_priority = -1;
 	list_head_init(&c->busses);
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&c->init_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_mutex_init(&c->kmod_lock, NULL);
+	pthread_mutex_init(&c->smart_lock, NULL);
+	arena_init(&c->arena);
 
 	info(c, "ctx %p created\n", c);
 	dbg(c, "log_priority=%d\n", c->ctx.log_priority);
@@ -323,21 +318,92 @@ NDCTL_EXPORT int ndctl_new(struct ndctl_ctx **ctx)
 		dbg(c, "timeout = %ld\n", tmo);
 	}
 
+	env = secure_getenv("NDCTL_SNAPSHOT");
+	if (env)
+		ndctl_set_snapshot(c, env);
+
+	env = secure_getenv("NDCTL_ENUMERATE_THREADS");
+	if (env)
+		ndctl_set_enumerate_threads(c, strtoul(env, NULL, 0));
+
+	env = secure_getenv("NDCTL_SMART_TTL_MS");
+	if (env)
+		ndctl_set_smart_ttl(c, strtoul(env, NULL, 0));
+
+	env = secure_getenv("NDCTL_SYSFS_ROOT");
+	if (env)
+		ndctl_set_sysfs_root(c, env);
+
 	c->udev_queue = udev_queue_new(udev);
 	if (!c->udev_queue)
 		err(c, "failed to retrieve udev queue\n");
 
-	c->kmod_ctx = kmod_ctx;
-	c->daxctl_ctx = daxctl_ctx;
+	return 0;
+}
+
+/**
+ * ndctl_set_snapshot - reuse enumerated topology across invocations
+ * @ctx: ndctl library context
+ * @path: snapshot file, e.g. /run/ndctl/topology, or NULL to disable
+ *
+ * Building the bus, dimm, region and namespace lists reads every
+ * device's attributes from sysfs. With a snapshot set, those reads are
+ * served from @path while it matches the current boot, uevent sequence
+ * number and device directory mtimes, and the file is refreshed when
+ * the context is released. Attribute changes made through this
+ * library discard it. Values read after enumeration, like health or
+ * available capacity, always come from sysfs. The NDCTL_SNAPSHOT
+ * environment variable provides the default.
+ */
+NDCTL_EXPORT int ndctl_set_snapshot(struct ndctl_ctx *ctx, const char *path)
+{
+	char *p = NULL;
 
+	/* only before the first enumeration */
+	if (ctx->busses_init)
+		return -EBUSY;
+	if (path && *path) {
+		p = strdup(path);
+		if (!p)
+			return -ENOMEM;
+	}
+	ndctl_snapshot_release(ctx);
+	free(ctx->snapshot_path);
+	ctx->snapshot_path = p;
+	return 0;
+}
+
+/**
+ * ndctl_set_sysfs_root - enumerate from a copy of the sysfs tree
+ * @ctx: ndctl library context
+ * @path: directory standing in for /sys, or NULL for the default
+ *
+ * Buses are looked up under @path/class/nd and resolved through
+ * @path/dev, so a generated tree, see test/gen-sysfs-tree.sh, can be
+ * listed without the devices present. The internal libdaxctl context
+ * gets the same root. Only listing is meaningful against such a tree.
+ * The NDCTL_SYSFS_ROOT environment variable provides the default.
+ */
+NDCTL_EXPORT int ndctl_set_sysfs_root(struct ndctl_ctx *ctx, const char *path)
+{
+	char *p = NULL;
+
+	/* only before the first enumeration */
+	if (ctx->busses_init || ctx->daxctl_ctx)
+		return -EBUSY;
+	if (path && *path) {
+		p = strdup(path);
+		if (!p)
+			return -ENOMEM;
+	}
+	free(ctx->sysfs_root);
+	ctx->sysfs_root = p;
 	return 0;
- err_ctx:
-	daxctl_unref(daxctl_ctx);
- err_daxctl:
-	kmod_unref(kmod_ctx);
- err_kmod:
-	udev_unref(udev);
-	return rc;
+}
+
+static const char *nd_sysfs_root(struct ndctl_ctx *ctx)
+{
+	return ctx->sysfs_root ?: "/sys";
 }
 
 NDCTL_EXPORT void ndctl_set_private_data(struct ndctl_ctx *ctx, void *data)
@@ -350,9 +416,38 @@ NDCTL_EXPORT void *ndctl_get_private_data(struct ndctl_ctx *ctx)
 	return ctx->private_data;
 }
 
+/**
+ * ndctl_get_daxctl_ctx - retrieve the internal libdaxctl context
+ * @ctx: ndctl library context
+ *
+ * The daxctl context is created on first use, and follows the log
+ * priority set with ndctl_set_log_priority(). Returns NULL if it could
+ * not be created.
+ */
 NDCTL_EXPORT struct daxctl_ctx *ndctl_get_daxctl_ctx(struct ndctl_ctx *ctx)
 {
-	return ctx->daxctl_ctx;
+	struct daxctl_ctx *daxctl_ctx, *cur = NULL;
+
+	daxctl_ctx = __atomic_load_n(&ctx->daxctl_ctx, __ATOMIC_ACQUIRE);
+	if (daxctl_ctx)
+		return daxctl_ctx;
+
+	if (daxctl_new(&daxctl_ctx) < 0) {
+		err(ctx, "failed to initialize libdaxctl\n");
+		return NULL;
+	}
+	if (ctx->daxctl_log_priority >= 0)
+		daxctl_set_log_priority(daxctl_ctx, ctx->daxctl_log_priority);
+	if (ctx->sysfs_root)
+		daxctl_set_sysfs_root(daxctl_ctx, ctx->sysfs_root);
+
+	/* parallel enumeration may race here, the loser drops its copy */
+	if (!__atomic_compare_exchange_n(&ctx->daxctl_ctx, &cur, daxctl_ctx,
+				false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		daxctl_unref(daxctl_ctx);
+		return cur;
+	}
+	return daxctl_ctx;
 }
 
 /**
@@ -363,7 +458,7 @@ NDCTL_EXPORT struct ndctl_ctx *ndctl_ref(struct ndctl_ctx *ctx)
 {
 	if (ctx == NULL)
 		return NULL;
-	ctx->refcount++;
+	__atomic_add_fetch(&ctx->refcount, 1, __ATOMIC_RELAXED);
 	return ctx;
 }
 
@@ -448,11 +543,10 @@ static void free_namespace(struct ndctl_namespace *ndns, struct list_head *head)
 		free(bb);
 	free(ndns->lbasize.supported);
 	free(ndns->ndns_path);
-	free(ndns->ndns_buf);
 	free(ndns->bdev);
 	free(ndns->alt_name);
 	badblocks_iter_free(&ndns->bb_iter);
-	kmod_module_unref(ndns->module);
+	free(ndns->modalias);
 	free(ndns);
 }
 
@@ -476,10 +570,9 @@ static void free_btt(struct ndctl_btt *btt, struct list_head *head)
 {
 	if (head)
 		list_del_from(head, &btt->list);
-	kmod_module_unref(btt->module);
+	free(btt->modalias);
 	free(btt->lbasize.supported);
 	free(btt->btt_path);
-	free(btt->btt_buf);
 	free(btt->bdev);
 	free(btt);
 }
@@ -504,9 +597,8 @@ static void __free_pfn(struct ndctl_pfn *pfn, struct list_head *head, void *to_f
 {
 	if (head)
 		list_del_from(head, &pfn->list);
-	kmod_module_unref(pfn->module);
+	free(pfn->modalias);
 	free(pfn->pfn_path);
-	free(pfn->pfn_buf);
 	free(pfn->bdev);
 	free(pfn->alignments.supported);
 	free(to_free);
@@ -554,15 +646,16 @@ static void free_stale_daxs(struct ndctl_region *region)
 		free_dax(dax, &region->stale_daxs);
 }
 
-static void free_region(struct ndctl_region *region)
+static void free_region(struct ndctl_region *region, struct list_head *head)
 {
-	struct ndctl_bus *bus = region->bus;
 	struct ndctl_mapping *mapping, *_m;
 
-	list_for_each_safe(&region->mappings, mapping, _m, list) {
+	/*
+	 * The region, its path, modalias and mappings belong to
+	 * ctx->arena.
+	 */
+	list_for_each_safe(&region->mappings, mapping, _m, list)
 		list_del_from(&region->mappings, &mapping->list);
-		free(mapping);
-	}
 	free_btts(region);
 	free_stale_btts(region);
 	free_pfns(region);
@@ -571,29 +664,22 @@ static void free_region(struct ndctl_region *region)
 	free_stale_daxs(region);
 	free_namespaces(region);
 	free_stale_namespaces(region);
-	list_del_from(&bus->regions, &region->list);
-	kmod_module_unref(region->module);
-	free(region->region_buf);
-	free(region->region_path);
+	list_del_from(head, &region->list);
 	badblocks_iter_free(&region->bb_iter);
+	free(region->bb_index);
 	if (region->flush_fd > 0)
 		close(region->flush_fd);
-	free(region);
 }
 
 static void free_dimm(struct ndctl_dimm *dimm)
 {
+	/* the dimm, its path, modalias and id belong to ctx->arena */
 	if (!dimm)
 		return;
-	free(dimm->unique_id);
-	free(dimm->dimm_buf);
-	free(dimm->dimm_path);
-	if (dimm->module)
-		kmod_module_unref(dimm->module);
 	if (dimm->health_eventfd > -1)
 		close(dimm->health_eventfd);
 	ndctl_cmd_unref(dimm->ndd.cmd_read);
-	free(dimm);
+	free(dimm->smart_cache);
 }
 
 static void free_bus(struct ndctl_bus *bus, struct list_head *head)
@@ -606,12 +692,16 @@ static void free_bus(struct ndctl_bus *bus, struct list_head *head)
 		free_dimm(dimm);
 	}
 	list_for_each_safe(&bus->regions, region, _r, list)
-		free_region(region);
+		free_region(region, &bus->regions);
+	list_for_each_safe(&bus->stale_regions, region, _r, list)
+		free_region(region, &bus->stale_regions);
+	free(bus->addr_index);
 	if (head)
 		list_del_from(head, &bus->list);
+	if (bus->fd >= 0)
+		close(bus->fd);
 	free(bus->provider);
 	free(bus->bus_path);
-	free(bus->bus_buf);
 	free(bus->wait_probe_path);
 	free(bus->scrub_path);
 	free(bus);
@@ -623,6 +713,13 @@ static void free_context(struct ndctl_ctx *ctx)
 
 	list_for_each_safe(&ctx->busses, bus, _b, list)
 		free_bus(bus, &ctx->busses);
+	arena_release(&ctx->arena);
+	ndctl_snapshot_release(ctx);
+	free(ctx->snapshot_path);
+	free(ctx->sysfs_root);
+	pthread_mutex_destroy(&ctx->init_lock);
+	pthread_mutex_destroy(&ctx->kmod_lock);
+	pthread_mutex_destroy(&ctx->smart_lock);
 	free(ctx);
 }
 
@@ -637,14 +734,15 @@ NDCTL_EXPORT struct ndctl_ctx *ndctl_unref(struct ndctl_ctx *ctx)
 {
 	if (ctx == NULL)
 		return NULL;
-	ctx->refcount--;
-	if (ctx->refcount > 0)
+	if (__atomic_sub_fetch(&ctx->refcount, 1, __ATOMIC_ACQ_REL) > 0)
 		return NULL;
+	udev_monitor_unref(ctx->udev_monitor);
 	udev_queue_unref(ctx->udev_queue);
 	udev_unref(ctx->udev);
 	kmod_unref(ctx->kmod_ctx);
 	daxctl_unref(ctx->daxctl_ctx);
 	info(ctx, "context %p released\n", ctx);
+	log_exit(&ctx->ctx);
 	free_context(ctx);
 	return NULL;
 }
@@ -686,25 +784,58 @@ NDCTL_EXPORT void ndctl_set_log_priority(struct ndctl_ctx *ctx, int priority)
 {
 	ctx->ctx.log_priority = priority;
 	/* forward the debug level to our internal libdaxctl instance */
-	daxctl_set_log_priority(ctx->daxctl_ctx, priority);
+	ctx->daxctl_log_priority = priority;
+	if (ctx->daxctl_ctx)
+		daxctl_set_log_priority(ctx->daxctl_ctx, priority);
+}
+
+/**
+ * ndctl_set_log_ring - record messages, and format them only when dumped
+ * @ctx: ndctl library context
+ * @size: bytes of ring, e.g. 1 << 20, 0 to format every message again
+ *
+ * Every message down to LOG_DEBUG is kept as its format pointer,
+ * arguments and a timestamp, the most recent ones that fit in @size.
+ * The priority in effect before still decides what is printed as it
+ * happens, and an error first dumps the recorded history, see
+ * ndctl_log_dump(). The NDCTL_LOG_RING environment variable, e.g. "1M",
+ * provides the default. Debug messages need the library built with
+ * "configure --enable-debug".
+ */
+NDCTL_EXPORT int ndctl_set_log_ring(struct ndctl_ctx *ctx, unsigned long size)
+{
+	return log_ring_enable(&ctx->ctx, size);
+}
+
+/**
+ * ndctl_log_dump - format and emit the recorded messages, oldest first
+ * @ctx: ndctl library context
+ *
+ * Messages go through the log function, the ring is left empty.
+ */
+NDCTL_EXPORT void ndctl_log_dump(struct ndctl_ctx *ctx)
+{
+	log_ring_dump(&ctx->ctx);
 }
 
-static char *__dev_path(char *type, int major, int minor, int parent)
+static char *__dev_path(struct ndctl_ctx *ctx, char *type, int major,
+		int minor, int parent)
 {
 	char *path, *dev_path;
 
-	if (asprintf(&path, "/sys/dev/%s/%d:%d%s", type, major, minor,
-				parent ? "/device" : "") < 0)
+	if (asprintf(&path, "%s/dev/%s/%d:%d%s", nd_sysfs_root(ctx), type,
+				major, minor, parent ? "/device" : "") < 0)
 		return NULL;
 
-	dev_path = realpath(path, NULL);
+	dev_path = ndctl_snapshot_realpath(ctx, path);
 	free(path);
 	return dev_path;
 }
 
-static char *parent_dev_path(char *type, int major, int minor)
+static char *parent_dev_path(struct ndctl_ctx *ctx, char *type, int major,
+		int minor)
 {
-        return __dev_path(type, major, minor, 1);
+        return __dev_path(ctx, type, major, minor, 1);
 }
 
 static int device_parse(struct ndctl_ctx *ctx, struct ndctl_bus *bus,
@@ -713,7 +844,8 @@ static int device_parse(struct ndctl_ctx *ctx, struct ndctl_bus *bus,
 {
 	if (bus)
 		ndctl_bus_wait_probe(bus);
-	return sysfs_device_parse(ctx, base_path, dev_name, parent, add_dev);
+	return ndctl_snapshot_device_parse(ctx, base_path, dev_name, parent,
+			add_dev);
 }
 
 static int to_cmd_index(const char *name, int dimm)
@@ -855,11 +987,18 @@ static enum ndctl_fwa_method fwa_method_to_method(const char *fwa_method)
 	return NDCTL_FWA_METHOD_RESET;
 }
 
+static const char * const bus_attrs[] = {
+	"dev", "device/commands", "device/nfit/revision",
+	"device/of_node/compatible", "device/nfit/dsm_mask", "device/provider",
+	"device/firmware/activate", "device/firmware/capability",
+};
+
 static void *add_bus(void *parent, int id, const char *ctl_base)
 {
 	char buf[SYSFS_ATTR_SIZE];
 	struct ndctl_ctx *ctx = parent;
 	struct ndctl_bus *bus, *bus_dup;
+	struct ndctl_sysfs_dir dir;
 	char *path = calloc(1, strlen(ctl_base) + 100);
 
 	if (!path)
@@ -870,21 +1009,22 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 		goto err_bus;
 	list_head_init(&bus->dimms);
 	list_head_init(&bus->regions);
+	list_head_init(&bus->stale_regions);
 	bus->ctx = ctx;
 	bus->id = id;
+	bus->fd = -1;
+	ndctl_sysfs_dir_init(&dir, ctx, ctl_base);
+	ndctl_sysfs_dir_prefetch(&dir, bus_attrs, ARRAY_SIZE(bus_attrs));
 
-	sprintf(path, "%s/dev", ctl_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0
+	if (ndctl_sysfs_dir_read(&dir, "dev", buf) < 0
 			|| sscanf(buf, "%d:%d", &bus->major, &bus->minor) != 2)
 		goto err_read;
 
-	sprintf(path, "%s/device/commands", ctl_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "device/commands", buf) < 0)
 		goto err_read;
 	bus->cmd_mask = parse_commands(buf, 0);
 
-	sprintf(path, "%s/device/nfit/revision", ctl_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0) {
+	if (ndctl_sysfs_dir_read(&dir, "device/nfit/revision", buf) < 0) {
 		bus->has_nfit = 0;
 		bus->revision = -1;
 	} else {
@@ -892,20 +1032,17 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 		bus->revision = strtoul(buf, NULL, 0);
 	}
 
-	sprintf(path, "%s/device/of_node/compatible", ctl_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "device/of_node/compatible", buf) < 0)
 		bus->has_of_node = 0;
 	else
 		bus->has_of_node = 1;
 
-	sprintf(path, "%s/device/nfit/dsm_mask", ctl_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "device/nfit/dsm_mask", buf) < 0)
 		bus->nfit_dsm_mask = 0;
 	else
 		bus->nfit_dsm_mask = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/device/provider", ctl_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "device/provider", buf) < 0)
 		goto err_read;
 
 	bus->provider = strdup(buf);
@@ -922,39 +1059,34 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 	if (!bus->scrub_path)
 		goto err_read;
 
-	sprintf(path, "%s/device/firmware/activate", ctl_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "device/firmware/activate", buf) < 0)
 		bus->fwa_state = NDCTL_FWA_INVALID;
 	else
 		bus->fwa_state = fwa_to_state(buf);
 
-	sprintf(path, "%s/device/firmware/capability", ctl_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "device/firmware/capability", buf) < 0)
 		bus->fwa_method = fwa_method_to_method(NULL);
 	else
 		bus->fwa_method = fwa_method_to_method(buf);
 
 
-	bus->bus_path = parent_dev_path("char", bus->major, bus->minor);
+	bus->bus_path = parent_dev_path(ctx, "char", bus->major, bus->minor);
 	if (!bus->bus_path)
 		goto err_dev_path;
 
-	bus->bus_buf = calloc(1, strlen(bus->bus_path) + 50);
-	if (!bus->bus_buf)
-		goto err_read;
-	bus->buf_len = strlen(bus->bus_path) + 50;
-
 	ndctl_bus_foreach(ctx, bus_dup)
 		if (strcmp(ndctl_bus_get_provider(bus_dup),
 					ndctl_bus_get_provider(bus)) == 0
 				&& strcmp(ndctl_bus_get_devname(bus_dup),
 					ndctl_bus_get_devname(bus)) == 0) {
 			free_bus(bus, NULL);
+			ndctl_sysfs_dir_close(&dir);
 			free(path);
 			return bus_dup;
 		}
 
 	list_add(&ctx->busses, &bus->list);
+	ndctl_sysfs_dir_close(&dir);
 	free(path);
 
 	return bus;
@@ -965,21 +1097,304 @@ static void *add_bus(void *parent, int id, const char *ctl_base)
 	free(bus->scrub_path);
 	free(bus->provider);
 	free(bus->bus_path);
-	free(bus->bus_buf);
 	free(bus);
+	ndctl_sysfs_dir_close(&dir);
  err_bus:
 	free(path);
 
 	return NULL;
 }
 
+/*
+ * The bus, dimm, region, namespace, btt, pfn and dax lists are built on
+ * first lookup and only read after that, so threads may walk them and
+ * query different objects in parallel. The thread that builds a list
+ * holds ctx->init_lock, which is recursive because building one list
+ * walks others, and marks it done only once it is complete. Readers
+ * that find it done never take the lock. Calls that change state, like
+ * enable, disable and namespace creation, still need the caller to
+ * keep them apart from concurrent readers.
+ *
+ * With ndctl_set_enumerate_threads(), the thread that builds the bus
+ * list also fills the lists below it through a pool of workers while
+ * it still holds the lock. Each worker owns the lists it was handed,
+ * and its nested lookups only ever read lists that are complete or
+ * that it is filling itself.
+ */
+enum {
+	ND_INIT_NONE,
+	ND_INIT_BUSY,
+	ND_INIT_DONE,
+};
+
+static __thread bool nd_populate_worker;
+
+/* true when the caller must build the list and then call nd_init_end() */
+static bool nd_init_begin(struct ndctl_ctx *ctx, int *state)
+{
+	if (__atomic_load_n(state, __ATOMIC_ACQUIRE) == ND_INIT_DONE)
+		return false;
+	if (nd_populate_worker)
+		return false;
+	pthread_mutex_lock(&ctx->init_lock);
+	if (*state != ND_INIT_NONE) {
+		pthread_mutex_unlock(&ctx->init_lock);
+		return false;
+	}
+	*state = ND_INIT_BUSY;
+	ndctl_snapshot_enter();
+	return true;
+}
+
+static void nd_init_end(struct ndctl_ctx *ctx, int *state)
+{
+	ndctl_snapshot_leave();
+	__atomic_store_n(state, ND_INIT_DONE, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ctx->init_lock);
+}
+
+static void __dimms_init(struct ndctl_bus *bus);
+static void __regions_init(struct ndctl_bus *bus);
+static void __namespaces_init(struct ndctl_region *region);
+static void __btts_init(struct ndctl_region *region);
+static void __pfns_init(struct ndctl_region *region);
+static void __daxs_init(struct ndctl_region *region);
+
+enum nd_populate_kind {
+	ND_POPULATE_DIMMS,
+	ND_POPULATE_REGIONS,
+	ND_POPULATE_REGION_CHILDREN,
+};
+
+struct nd_populate_task {
+	enum nd_populate_kind kind;
+	void *obj;
+};
+
+struct nd_populate {
+	struct nd_populate_task *tasks;
+	int nr;
+	int next;
+};
+
+static void nd_populate_task(struct nd_populate_task *task)
+{
+	struct ndctl_region *region = task->obj;
+
+	switch (task->kind) {
+	case ND_POPULATE_DIMMS:
+		__dimms_init(task->obj);
+		break;
+	case ND_POPULATE_REGIONS:
+		__regions_init(task->obj);
+		break;
+	case ND_POPULATE_REGION_CHILDREN:
+		__namespaces_init(region);
+		__btts_init(region);
+		__pfns_init(region);
+		__daxs_init(region);
+		break;
+	}
+}
+
+static void *nd_populate_thread(void *arg)
+{
+	struct nd_populate *pop = arg;
+	int i;
+
+	nd_populate_worker = true;
+	while ((i = __atomic_fetch_add(&pop->next, 1, __ATOMIC_RELAXED))
+			< pop->nr)
+		nd_populate_task(&pop->tasks[i]);
+	nd_populate_worker = false;
+	return NULL;
+}
+
+/* clamp a thread count to the ndctl_set_max_threads() ceiling */
+static int nd_threads(struct ndctl_ctx *ctx, int nr)
+{
+	if (ctx->max_threads && nr > (int) ctx->max_threads)
+		return ctx->max_threads;
+	return nr;
+}
+
+static void nd_populate_run(struct ndctl_ctx *ctx, struct nd_populate *pop)
+{
+	int i, nr_threads = nd_threads(ctx,
+			min_t(int, ctx->enumerate_threads, pop->nr));
+	pthread_t *threads = NULL;
+
+	if (nr_threads > 1)
+		threads = calloc(nr_threads - 1, sizeof(*threads));
+	for (i = 0; threads && i < nr_threads - 1; i++)
+		if (pthread_create(&threads[i], NULL, nd_populate_thread, pop))
+			break;
+	/* this thread takes a share too, and whatever could not be handed out */
+	nd_populate_thread(pop);
+	while (threads && i--)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+
+static bool nd_populate_claim(int *state)
+{
+	if (*state != ND_INIT_NONE)
+		return false;
+	*state = ND_INIT_BUSY;
+	return true;
+}
+
+static void nd_populate_finish(struct nd_populate *pop)
+{
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+	int i;
+
+	for (i = 0; i < pop->nr; i++) {
+		bus = pop->tasks[i].obj;
+		region = pop->tasks[i].obj;
+		switch (pop->tasks[i].kind) {
+		case ND_POPULATE_DIMMS:
+			__atomic_store_n(&bus->dimms_init, ND_INIT_DONE,
+					__ATOMIC_RELEASE);
+			break;
+		case ND_POPULATE_REGIONS:
+			__atomic_store_n(&bus->regions_init, ND_INIT_DONE,
+					__ATOMIC_RELEASE);
+			break;
+		case ND_POPULATE_REGION_CHILDREN:
+			__atomic_store_n(&region->namespaces_init, ND_INIT_DONE,
+					__ATOMIC_RELEASE);
+			__atomic_store_n(&region->btts_init, ND_INIT_DONE,
+					__ATOMIC_RELEASE);
+			__atomic_store_n(&region->pfns_init, ND_INIT_DONE,
+					__ATOMIC_RELEASE);
+			__atomic_store_n(&region->daxs_init, ND_INIT_DONE,
+					__ATOMIC_RELEASE);
+			break;
+		}
+	}
+}
+
+/*
+ * Fill every bus's dimm and region lists, then every region's child
+ * lists, on the worker pool. Each list is filled by a single worker in
+ * directory order, the same as on demand, so iteration order does not
+ * depend on the number of threads. Called with ctx->init_lock held.
+ */
+static void nd_populate(struct ndctl_ctx *ctx)
+{
+	struct nd_populate pop = { 0 };
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+	int nr = 0;
+
+	list_for_each(&ctx->busses, bus, list)
+		nr += 2;
+	if (!nr)
+		return;
+	pop.tasks = calloc(nr, sizeof(*pop.tasks));
+	if (!pop.tasks)
+		return;
+
+	list_for_each(&ctx->busses, bus, list) {
+		if (nd_populate_claim(&bus->dimms_init))
+			pop.tasks[pop.nr++] = (struct nd_populate_task) {
+				ND_POPULATE_DIMMS, bus };
+		if (nd_populate_claim(&bus->regions_init))
+			pop.tasks[pop.nr++] = (struct nd_populate_task) {
+				ND_POPULATE_REGIONS, bus };
+	}
+	nd_populate_run(ctx, &pop);
+	nd_populate_finish(&pop);
+	free(pop.tasks);
+
+	nr = 0;
+	list_for_each(&ctx->busses, bus, list)
+		list_for_each(&bus->regions, region, list)
+			nr++;
+	if (!nr)
+		return;
+	pop = (struct nd_populate) { 0 };
+	pop.tasks = calloc(nr, sizeof(*pop.tasks));
+	if (!pop.tasks)
+		return;
+
+	list_for_each(&ctx->busses, bus, list)
+		list_for_each(&bus->regions, region, list) {
+			if (region->namespaces_init || region->btts_init
+					|| region->pfns_init || region->daxs_init)
+				continue;
+			region->namespaces_init = ND_INIT_BUSY;
+			region->btts_init = ND_INIT_BUSY;
+			region->pfns_init = ND_INIT_BUSY;
+			region->daxs_init = ND_INIT_BUSY;
+			pop.tasks[pop.nr++] = (struct nd_populate_task) {
+				ND_POPULATE_REGION_CHILDREN, region };
+		}
+	nd_populate_run(ctx, &pop);
+	nd_populate_finish(&pop);
+	free(pop.tasks);
+}
+
+static void __busses_init(struct ndctl_ctx *ctx)
+{
+	char *path;
+
+	if (asprintf(&path, "%s/class/nd", nd_sysfs_root(ctx)) < 0)
+		return;
+	device_parse(ctx, NULL, path, "ndctl", ctx, add_bus);
+	free(path);
+}
+
 static void busses_init(struct ndctl_ctx *ctx)
 {
+	if (nd_init_begin(ctx, &ctx->busses_init)) {
+		usdt(libndctl, enumerate_start, ctx);
+		__busses_init(ctx);
+		/* the snapshot already skips the sysfs reads, and is not shared */
+		if (ctx->enumerate_threads > 1 && !ctx->snapshot_path)
+			nd_populate(ctx);
+		usdt(libndctl, enumerate_done, ctx);
+		nd_init_end(ctx, &ctx->busses_init);
+	}
+}
+
+/**
+ * ndctl_set_enumerate_threads - read the device tree ahead in parallel
+ * @ctx: ndctl library context
+ * @nr: number of threads, 0 or 1 to build each list on first use
+ *
+ * On the first bus lookup, every bus's dimms and regions, and then every
+ * region's namespaces, btts, pfns and daxs, are read on up to @nr
+ * threads. Iteration order is the same as without. Has no effect while
+ * a topology snapshot is set. The NDCTL_ENUMERATE_THREADS environment
+ * variable provides the default.
+ */
+NDCTL_EXPORT int ndctl_set_enumerate_threads(struct ndctl_ctx *ctx,
+		unsigned int nr)
+{
+	/* only before the first enumeration */
 	if (ctx->busses_init)
-		return;
-	ctx->busses_init = 1;
+		return -EBUSY;
+	ctx->enumerate_threads = nr;
+	return 0;
+}
 
-	device_parse(ctx, NULL, "/sys/class/nd", "ndctl", ctx, add_bus);
+/**
+ * ndctl_set_max_threads - bound the threads the library starts
+ * @ctx: ndctl library context
+ * @nr: most threads any one call runs at once, the calling one
+ *	included, 0 for no bound
+ *
+ * Applies on top of ndctl_set_enumerate_threads(), and also bounds
+ * ndctl_region_deep_flush_many() and ndctl_cmd_batch_submit(). The
+ * ndctl tool sets it from its top level '-j' option.
+ */
+NDCTL_EXPORT void ndctl_set_max_threads(struct ndctl_ctx *ctx,
+		unsigned int nr)
+{
+	ctx->max_threads = nr;
 }
 
 NDCTL_EXPORT void ndctl_invalidate(struct ndctl_ctx *ctx)
@@ -1027,11 +1442,10 @@ NDCTL_EXPORT int ndctl_bus_has_of_node(struct ndctl_bus *bus)
 
 NDCTL_EXPORT int ndctl_bus_is_papr_scm(struct ndctl_bus *bus)
 {
-	char buf[SYSFS_ATTR_SIZE];
+	char buf[SYSFS_ATTR_SIZE], path[PATH_MAX];
 
-	snprintf(bus->bus_buf, bus->buf_len,
-		 "%s/of_node/compatible", bus->bus_path);
-	if (sysfs_read_attr(bus->ctx, bus->bus_buf, buf) < 0)
+	snprintf(path, sizeof(path), "%s/of_node/compatible", bus->bus_path);
+	if (sysfs_read_attr(bus->ctx, path, buf) < 0)
 		return 0;
 
 	return (strcmp(buf, "ibm,pmemory") == 0 ||
@@ -1092,8 +1506,8 @@ ndctl_bus_get_persistence_domain(struct ndctl_bus *bus)
 NDCTL_EXPORT struct ndctl_btt *ndctl_region_get_btt_seed(struct ndctl_region *region)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int len = region->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	struct ndctl_btt *btt;
 	char buf[SYSFS_ATTR_SIZE];
 
@@ -1115,8 +1529,8 @@ NDCTL_EXPORT struct ndctl_btt *ndctl_region_get_btt_seed(struct ndctl_region *re
 NDCTL_EXPORT struct ndctl_pfn *ndctl_region_get_pfn_seed(struct ndctl_region *region)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int len = region->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	struct ndctl_pfn *pfn;
 	char buf[SYSFS_ATTR_SIZE];
 
@@ -1138,8 +1552,8 @@ NDCTL_EXPORT struct ndctl_pfn *ndctl_region_get_pfn_seed(struct ndctl_region *re
 NDCTL_EXPORT struct ndctl_dax *ndctl_region_get_dax_seed(struct ndctl_region *region)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int len = region->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	struct ndctl_dax *dax;
 	char buf[SYSFS_ATTR_SIZE];
 
@@ -1166,8 +1580,8 @@ NDCTL_EXPORT int ndctl_region_get_ro(struct ndctl_region *region)
 NDCTL_EXPORT int ndctl_region_set_ro(struct ndctl_region *region, int ro)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int len = region->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 
 	if (snprintf(path, len, "%s/read_only", region->region_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -1203,8 +1617,8 @@ NDCTL_EXPORT int ndctl_region_set_align(struct ndctl_region *region,
 		unsigned long align)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int len = region->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char buf[SYSFS_ATTR_SIZE];
 
 	if (snprintf(path, len, "%s/align", region->region_path) >= len) {
@@ -1225,8 +1639,8 @@ NDCTL_EXPORT int ndctl_region_set_align(struct ndctl_region *region,
 NDCTL_EXPORT unsigned long long ndctl_region_get_resource(struct ndctl_region *region)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int len = region->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 	int rc;
 
@@ -1253,6 +1667,109 @@ NDCTL_EXPORT int ndctl_region_deep_flush(struct ndctl_region *region)
 	return (rc == -1) ? -errno : 0;
 }
 
+struct deep_flush_job {
+	struct ndctl_region *region;
+	int rc;
+	unsigned long long latency_ns;
+};
+
+struct deep_flush_pool {
+	struct deep_flush_job *jobs;
+	int nr, next;
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *deep_flush_worker(void *arg)
+{
+	struct deep_flush_pool *pool = arg;
+	int i;
+
+	while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED))
+			< pool->nr) {
+		struct deep_flush_job *job = &pool->jobs[i];
+		unsigned long long start = now_ns();
+
+		if (job->region->flush_fd < 0) {
+			job->rc = -EOPNOTSUPP;
+			continue;
+		}
+		job->rc = ndctl_region_deep_flush(job->region);
+		job->latency_ns = now_ns() - start;
+	}
+	return NULL;
+}
+
+/**
+ * ndctl_region_deep_flush_many() - deep flush several regions at once
+ * @regions: regions to flush
+ * @count: number of entries in @regions
+ * @results: per-region outcome, as ndctl_region_deep_flush() returns it
+ * @latency_ns: optional, per-region time spent in the flush
+ *
+ * The regions are flushed from one thread each, up to the
+ * ndctl_set_max_threads() bound, so the call lasts as long as the
+ * slowest flush domain rather than the sum of them. A region without a
+ * deep_flush attribute reports -EOPNOTSUPP. Regions no thread could be
+ * started for are flushed by the calling thread. Returns the number of
+ * regions that failed, or -errno if the bookkeeping could not be
+ * allocated, in which case nothing was flushed.
+ */
+NDCTL_EXPORT int ndctl_region_deep_flush_many(struct ndctl_region **regions,
+		int count, int *results, unsigned long long *latency_ns)
+{
+	struct deep_flush_pool pool = { .nr = count };
+	pthread_t *threads = NULL;
+	struct ndctl_ctx *ctx;
+	int i, nr_threads, failed = 0;
+
+	if (count <= 0)
+		return 0;
+	ctx = ndctl_region_get_ctx(regions[0]);
+
+	pool.jobs = calloc(count, sizeof(*pool.jobs));
+	if (!pool.jobs)
+		return -ENOMEM;
+	for (i = 0; i < count; i++)
+		pool.jobs[i].region = regions[i];
+
+	nr_threads = nd_threads(ctx, count);
+	if (nr_threads > 1)
+		threads = calloc(nr_threads - 1, sizeof(*threads));
+	for (i = 0; threads && i < nr_threads - 1; i++)
+		if (pthread_create(&threads[i], NULL, deep_flush_worker, &pool))
+			break;
+	if (i < nr_threads - 1)
+		dbg(ctx, "flushing on %d of %d threads\n", i + 1, nr_threads);
+	deep_flush_worker(&pool);
+	while (threads && i--)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	for (i = 0; i < count; i++) {
+		struct deep_flush_job *job = &pool.jobs[i];
+
+		if (job->rc)
+			failed++;
+		dbg(ctx, "%s: deep flush: %s in %llu ns\n",
+				ndctl_region_get_devname(job->region),
+				job->rc ? strerror(-job->rc) : "ok",
+				job->latency_ns);
+		results[i] = job->rc;
+		if (latency_ns)
+			latency_ns[i] = job->latency_ns;
+	}
+
+	free(pool.jobs);
+	return failed;
+}
+
 
 NDCTL_EXPORT const char *ndctl_bus_get_cmd_name(struct ndctl_bus *bus, int cmd)
 {
@@ -1300,17 +1817,30 @@ NDCTL_EXPORT int ndctl_bus_wait_probe(struct ndctl_bus *bus)
 	char buf[SYSFS_ATTR_SIZE];
 	int rc, sleep = 0;
 
-	do {
-		rc = sysfs_read_attr(bus->ctx, bus->wait_probe_path, buf);
-		if (rc < 0)
-			break;
+	/*
+	 * Once every bind and unbind this context issued was confirmed by
+	 * its own uevent, flushing the kernel side is all that is left.
+	 * Otherwise fall back to waiting for the whole udev queue.
+	 */
+	rc = sysfs_read_attr(bus->ctx, bus->wait_probe_path, buf);
+	if (rc == 0 && !__atomic_load_n(&ctx->probe_unsettled,
+				__ATOMIC_ACQUIRE))
+		return 0;
+
+	while (rc == 0) {
 		if (!ctx->udev_queue)
 			break;
-		if (udev_queue_get_queue_is_empty(ctx->udev_queue))
+		if (udev_queue_get_queue_is_empty(ctx->udev_queue)) {
+			__atomic_store_n(&ctx->probe_unsettled, 0,
+					__ATOMIC_RELEASE);
+			break;
+		}
+		if (ctx->timeout && tmo-- == 0)
 			break;
 		sleep++;
 		usleep(1000);
-	} while (ctx->timeout == 0 || tmo-- != 0);
+		rc = sysfs_read_attr(bus->ctx, bus->wait_probe_path, buf);
+	}
 
 	if (sleep)
 		dbg(ctx, "waited %d millisecond%s for bus%d...\n", sleep,
@@ -1518,9 +2048,9 @@ NDCTL_EXPORT enum ndctl_fwa_state ndctl_bus_get_fw_activate_state(
 		struct ndctl_bus *bus)
 {
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
-	char *path = bus->bus_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = bus->buf_len;
+	int len = sizeof(path);
 
 	if (bus->fwa_state == NDCTL_FWA_INVALID)
 		return NDCTL_FWA_INVALID;
@@ -1547,9 +2077,9 @@ NDCTL_EXPORT enum ndctl_fwa_method ndctl_bus_get_fw_activate_method(struct ndctl
 NDCTL_EXPORT int ndctl_bus_activate_firmware(struct ndctl_bus *bus, enum ndctl_fwa_method method)
 {
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
-	char *path = bus->bus_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = bus->buf_len;
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/firmware/activate", bus->bus_path) >= len) {
 		err(ctx, "%s: buffer too small!\n", ndctl_bus_get_devname(bus));
@@ -1573,9 +2103,9 @@ NDCTL_EXPORT int ndctl_bus_activate_firmware(struct ndctl_bus *bus, enum ndctl_f
 static int write_fw_activate_noidle(struct ndctl_bus *bus, int arg)
 {
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
-	char *path = bus->bus_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = bus->buf_len;
+	int len = sizeof(path);
 
 	if (!ndctl_bus_has_nfit(bus))
 		return -EOPNOTSUPP;
@@ -1603,9 +2133,9 @@ NDCTL_EXPORT int ndctl_bus_clear_fw_activate_noidle(struct ndctl_bus *bus)
 static int write_fw_activate_nosuspend(struct ndctl_bus *bus, int arg)
 {
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
-	char *path = bus->bus_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = bus->buf_len;
+	int len = sizeof(path);
 
 	if (!ndctl_bus_has_nfit(bus))
 		return -EOPNOTSUPP;
@@ -1645,32 +2175,43 @@ static enum ndctl_fwa_result fwa_result_to_result(const char *result)
 	return NDCTL_FWA_RESULT_INVALID;
 }
 
-static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
+static int ndctl_bind(struct ndctl_ctx *ctx, const char *modalias,
 		const char *devname);
 static int ndctl_unbind(struct ndctl_ctx *ctx, const char *devpath);
 static struct kmod_module *to_module(struct ndctl_ctx *ctx, const char *alias);
 
+/* "format1" stays last, it is only present on dimms with two formats */
+static const char * const dimm_bus_attrs[] = {
+	"id", "handle", "phys_id", "serial", "vendor", "device", "rev_id",
+	"dirty_shutdown", "subsystem_vendor", "subsystem_device",
+	"subsystem_rev_id", "family", "dsm_mask", "flags", "format", "format1",
+};
+
 static int populate_dimm_attributes(struct ndctl_dimm *dimm,
 				    const char *dimm_base,
 				    const char *bus_prefix)
 {
 	int i, rc = -1;
-	char buf[SYSFS_ATTR_SIZE];
+	char buf[SYSFS_ATTR_SIZE], attr[16];
 	struct ndctl_ctx *ctx = dimm->bus->ctx;
 	char *path = calloc(1, strlen(dimm_base) + 100);
+	struct ndctl_sysfs_dir dir;
 
 	if (!path)
 		return -ENOMEM;
+	sprintf(path, "%s/%s", dimm_base, bus_prefix);
+	ndctl_sysfs_dir_init(&dir, ctx, path);
+	ndctl_sysfs_dir_prefetch(&dir, dimm_bus_attrs,
+			ARRAY_SIZE(dimm_bus_attrs) - (dimm->formats < 2));
 
 	/*
 	 * 'unique_id' may not be available on older kernels, so don't
 	 * fail if the read fails.
 	 */
-	sprintf(path, "%s/%s/id", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0) {
+	if (ndctl_sysfs_dir_read(&dir, "id", buf) == 0) {
 		unsigned int b[9];
 
-		dimm->unique_id = strdup(buf);
+		dimm->unique_id = arena_strdup(&ctx->arena, buf);
 		if (!dimm->unique_id)
 			goto err_read;
 		if (sscanf(dimm->unique_id, "%02x%02x-%02x-%02x%02x-%02x%02x%02x%02x",
@@ -1681,67 +2222,53 @@ static int populate_dimm_attributes(struct ndctl_dimm *dimm,
 		}
 	}
 
-	sprintf(path, "%s/%s/handle", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "handle", buf) < 0)
 		goto err_read;
 	dimm->handle = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/phys_id", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "phys_id", buf) < 0)
 		goto err_read;
 	dimm->phys_id = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/serial", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "serial", buf) == 0)
 		dimm->serial = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/vendor", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "vendor", buf) == 0)
 		dimm->vendor_id = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/device", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "device", buf) == 0)
 		dimm->device_id = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/rev_id", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "rev_id", buf) == 0)
 		dimm->revision_id = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/dirty_shutdown", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "dirty_shutdown", buf) == 0)
 		dimm->dirty_shutdown = strtoll(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/subsystem_vendor", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "subsystem_vendor", buf) == 0)
 		dimm->subsystem_vendor_id = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/subsystem_device", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "subsystem_device", buf) == 0)
 		dimm->subsystem_device_id = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/subsystem_rev_id", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "subsystem_rev_id", buf) == 0)
 		dimm->subsystem_revision_id = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/family", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "family", buf) == 0)
 		dimm->cmd_family = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/dsm_mask", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "dsm_mask", buf) == 0)
 		dimm->nfit_dsm_mask = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/format", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "format", buf) == 0)
 		dimm->format[0] = strtoul(buf, NULL, 0);
 	for (i = 1; i < dimm->formats; i++) {
-		sprintf(path, "%s/%s/format%d", dimm_base, bus_prefix, i);
-		if (sysfs_read_attr(ctx, path, buf) == 0)
+		sprintf(attr, "format%d", i);
+		if (ndctl_sysfs_dir_read(&dir, attr, buf) == 0)
 			dimm->format[i] = strtoul(buf, NULL, 0);
 	}
 
-	sprintf(path, "%s/%s/flags", dimm_base, bus_prefix);
-	if (sysfs_read_attr(ctx, path, buf) == 0) {
+	if (ndctl_sysfs_dir_read(&dir, "flags", buf) == 0) {
 		if (ndctl_bus_has_nfit(dimm->bus))
 			parse_nfit_mem_flags(dimm, buf);
 		else if (ndctl_bus_is_papr_scm(dimm->bus)) {
@@ -1750,10 +2277,13 @@ static int populate_dimm_attributes(struct ndctl_dimm *dimm,
 		}
 	}
 
-	dimm->health_eventfd = open(path, O_RDONLY|O_CLOEXEC);
 	rc = 0;
  err_read:
-
+	ndctl_sysfs_dir_close(&dir);
+	if (rc == 0) {
+		strcat(path, "/flags");
+		dimm->health_eventfd = open(path, O_RDONLY|O_CLOEXEC);
+	}
 	free(path);
 	return rc;
 }
@@ -1817,48 +2347,44 @@ static void *add_dimm(void *parent, int id, const char *dimm_base)
 	char buf[SYSFS_ATTR_SIZE];
 	struct ndctl_bus *bus = parent;
 	struct ndctl_ctx *ctx = bus->ctx;
-	char *path = calloc(1, strlen(dimm_base) + 100);
-
-	if (!path)
-		return NULL;
+	const char *attrs[] = {
+		ndctl_bus_has_nfit(bus) ? "nfit/formats" : "papr/formats",
+		"dev", "commands", "modalias", "flags", "firmware/activate",
+		"firmware/result",
+	};
+	struct ndctl_sysfs_dir dir;
 
-	sprintf(path, "%s/%s/formats", dimm_base,
-		ndctl_bus_has_nfit(bus) ? "nfit" : "papr");
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	ndctl_sysfs_dir_init(&dir, ctx, dimm_base);
+	ndctl_sysfs_dir_prefetch(&dir, attrs, ARRAY_SIZE(attrs));
+	if (ndctl_sysfs_dir_read(&dir, attrs[0], buf) < 0)
 		formats = 1;
 	else
 		formats = clamp(strtoul(buf, NULL, 0), 1UL, 2UL);
 
-	dimm = calloc(1, sizeof(*dimm) + sizeof(int) * formats);
+	dimm = arena_zalloc(&ctx->arena, sizeof(*dimm) + sizeof(int) * formats);
 	if (!dimm)
 		goto err_dimm;
 	dimm->bus = bus;
 	dimm->id = id;
 
-	sprintf(path, "%s/dev", dimm_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "dev", buf) < 0)
 		goto err_read;
 	if (sscanf(buf, "%d:%d", &dimm->major, &dimm->minor) != 2)
 		goto err_read;
 
-	sprintf(path, "%s/commands", dimm_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "commands", buf) < 0)
 		goto err_read;
 	dimm->cmd_mask = parse_commands(buf, 1);
 
-	dimm->dimm_buf = calloc(1, strlen(dimm_base) + 50);
-	if (!dimm->dimm_buf)
-		goto err_read;
-	dimm->buf_len = strlen(dimm_base) + 50;
-
-	dimm->dimm_path = strdup(dimm_base);
+	dimm->dimm_path = arena_strdup(&ctx->arena, dimm_base);
 	if (!dimm->dimm_path)
 		goto err_read;
 
-	sprintf(path, "%s/modalias", dimm_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "modalias", buf) < 0)
+		goto err_read;
+	dimm->modalias = arena_strdup(&ctx->arena, buf);
+	if (!dimm->modalias)
 		goto err_read;
-	dimm->module = to_module(ctx, buf);
 
 	dimm->handle = -1;
 	dimm->phys_id = -1;
@@ -1878,21 +2404,18 @@ static void *add_dimm(void *parent, int id, const char *dimm_base)
 	for (i = 0; i < formats; i++)
 		dimm->format[i] = -1;
 
-	sprintf(path, "%s/flags", dimm_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0) {
+	if (ndctl_sysfs_dir_read(&dir, "flags", buf) < 0) {
 		dimm->locked = -1;
 		dimm->aliased = -1;
 	} else
 		parse_dimm_flags(dimm, buf);
 
-	sprintf(path, "%s/firmware/activate", dimm_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "firmware/activate", buf) < 0)
 		dimm->fwa_state = NDCTL_FWA_INVALID;
 	else
 		dimm->fwa_state = fwa_to_state(buf);
 
-	sprintf(path, "%s/firmware/result", dimm_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "firmware/result", buf) < 0)
 		dimm->fwa_result = NDCTL_FWA_RESULT_INVALID;
 	else
 		dimm->fwa_result = fwa_result_to_result(buf);
@@ -1931,26 +2454,30 @@ static void *add_dimm(void *parent, int id, const char *dimm_base)
 	}
 
 	list_add(&bus->dimms, &dimm->list);
-	free(path);
+	ndctl_sysfs_dir_close(&dir);
 
 	return dimm;
 
  err_read:
 	free_dimm(dimm);
  err_dimm:
-	free(path);
+	ndctl_sysfs_dir_close(&dir);
 	return NULL;
 }
 
-static void dimms_init(struct ndctl_bus *bus)
+static void __dimms_init(struct ndctl_bus *bus)
 {
-	if (bus->dimms_init)
-		return;
-
-	bus->dimms_init = 1;
 	device_parse(bus->ctx, bus, bus->bus_path, "nmem", bus, add_dimm);
 }
 
+static void dimms_init(struct ndctl_bus *bus)
+{
+	if (nd_init_begin(bus->ctx, &bus->dimms_init)) {
+		__dimms_init(bus);
+		nd_init_end(bus->ctx, &bus->dimms_init);
+	}
+}
+
 NDCTL_EXPORT struct ndctl_dimm *ndctl_dimm_get_first(struct ndctl_bus *bus)
 {
 	dimms_init(bus);
@@ -2200,8 +2727,59 @@ NDCTL_EXPORT unsigned int ndctl_dimm_get_flags(struct ndctl_dimm *dimm)
 	return flags;
 }
 
-NDCTL_EXPORT int ndctl_dimm_is_flag_supported(struct ndctl_dimm *dimm,
-		unsigned int flag)
+static const char * const perf_stat_names[] = {
+	[NDCTL_PERF_CTL_RESET_COUNT] = "controller_reset_count",
+	[NDCTL_PERF_CTL_RESET_TIME] = "controller_reset_time",
+	[NDCTL_PERF_POWER_ON_SECS] = "power_on_seconds",
+	[NDCTL_PERF_LIFE_REMAINING] = "life_remaining_percentage",
+	[NDCTL_PERF_CRIT_RESOURCE_UTIL] = "critical_resource_utilization",
+	[NDCTL_PERF_HOST_LOAD_COUNT] = "host_load_count",
+	[NDCTL_PERF_HOST_STORE_COUNT] = "host_store_count",
+	[NDCTL_PERF_HOST_LOAD_DURATION] = "host_load_duration",
+	[NDCTL_PERF_HOST_STORE_DURATION] = "host_store_duration",
+	[NDCTL_PERF_MEDIA_READ_COUNT] = "media_read_count",
+	[NDCTL_PERF_MEDIA_WRITE_COUNT] = "media_write_count",
+	[NDCTL_PERF_MEDIA_READ_DURATION] = "media_read_duration",
+	[NDCTL_PERF_MEDIA_WRITE_DURATION] = "media_write_duration",
+	[NDCTL_PERF_CACHE_READ_HIT_COUNT] = "cache_read_hit_count",
+	[NDCTL_PERF_CACHE_WRITE_HIT_COUNT] = "cache_write_hit_count",
+	[NDCTL_PERF_FAST_WRITE_COUNT] = "fast_write_count",
+};
+
+NDCTL_EXPORT const char *ndctl_perf_stat_name(enum ndctl_perf_stat stat)
+{
+	if ((unsigned int) stat >= ARRAY_SIZE(perf_stat_names))
+		return NULL;
+	return perf_stat_names[stat];
+}
+
+/**
+ * ndctl_dimm_get_perf_stats - read a dimm's performance counters
+ * @dimm: dimm to read
+ * @stats: filled with up to @nr counters, indexed by enum ndctl_perf_stat
+ * @nr: entries in @stats
+ * @valid: set to the mask of (1ULL << stat) for the counters reported
+ *
+ * Returns 0, or -EOPNOTSUPP when the dimm's family has no performance
+ * counters, or another negative error code when they can't be read.
+ */
+NDCTL_EXPORT int ndctl_dimm_get_perf_stats(struct ndctl_dimm *dimm,
+		unsigned long long *stats, unsigned int nr,
+		unsigned long long *valid)
+{
+	struct ndctl_dimm_ops *ops = dimm->ops;
+
+	*valid = 0;
+	if (!ops || !ops->get_perf_stats)
+		return -EOPNOTSUPP;
+	if (nr > NDCTL_PERF_STAT_MAX)
+		nr = NDCTL_PERF_STAT_MAX;
+	memset(stats, 0, nr * sizeof(*stats));
+	return ops->get_perf_stats(dimm, stats, nr, valid);
+}
+
+NDCTL_EXPORT int ndctl_dimm_is_flag_supported(struct ndctl_dimm *dimm,
+		unsigned int flag)
 {
 	unsigned int flags = ndctl_dimm_get_flags(dimm);
 	return (flags ==  UINT_MAX) ? 0 : !!(flags & flag);
@@ -2305,7 +2883,7 @@ NDCTL_EXPORT int ndctl_dimm_enable(struct ndctl_dimm *dimm)
 	if (ndctl_dimm_is_enabled(dimm))
 		return 0;
 
-	ndctl_bind(ctx, dimm->module, devname);
+	ndctl_bind(ctx, dimm->modalias, devname);
 
 	if (!ndctl_dimm_is_enabled(dimm)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -2320,8 +2898,8 @@ NDCTL_EXPORT int ndctl_dimm_enable(struct ndctl_dimm *dimm)
 static int dimm_set_arm(struct ndctl_dimm *dimm, bool arm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
-	int len = dimm->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (dimm->fwa_state == NDCTL_FWA_INVALID)
 		return NDCTL_FWA_INVALID;
@@ -2352,9 +2930,9 @@ NDCTL_EXPORT enum ndctl_fwa_state ndctl_dimm_get_fw_activate_state(
 		struct ndctl_dimm *dimm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = dimm->buf_len;
+	int len = sizeof(path);
 
 	if (dimm->fwa_state == NDCTL_FWA_INVALID)
 		return NDCTL_FWA_INVALID;
@@ -2375,9 +2953,9 @@ NDCTL_EXPORT enum ndctl_fwa_result ndctl_dimm_get_fw_activate_result(
 		struct ndctl_dimm *dimm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = dimm->buf_len;
+	int len = sizeof(path);
 
 	if (dimm->fwa_result == NDCTL_FWA_RESULT_INVALID)
 		return NDCTL_FWA_RESULT_INVALID;
@@ -2415,50 +2993,101 @@ static struct ndctl_dimm *ndctl_dimm_get_by_id(struct ndctl_bus *bus, unsigned i
 	return NULL;
 }
 
-/**
- * ndctl_bus_get_region_by_physical_address - get region by physical address
- * @bus: ndctl_bus instance
- * @address: (System) Physical Address
- *
- * If @bus and @address is valid, returns a region address, which
- * physical address belongs to.
+static int addr_range_cmp(const void *a, const void *b)
+{
+	const struct ndctl_addr_range *r_a = a, *r_b = b;
+
+	if (r_a->start < r_b->start)
+		return -1;
+	return r_a->start > r_b->start;
+}
+
+/*
+ * Region resources are fixed for the life of the region, so read them
+ * once into an array sorted by start address that lookups can bisect.
  */
-NDCTL_EXPORT struct ndctl_region *ndctl_bus_get_region_by_physical_address(
-		struct ndctl_bus *bus, unsigned long long address)
+static void addr_index_init(struct ndctl_bus *bus)
 {
-	unsigned long long region_start, region_end;
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	unsigned long long start, size;
 	struct ndctl_region *region;
+	struct ndctl_addr_range *r;
+	unsigned int nr = 0;
+
+	if (!nd_init_begin(ctx, &bus->addr_index_init))
+		return;
+
+	ndctl_region_foreach(bus, region)
+		nr++;
+	bus->addr_index = calloc(nr, sizeof(*bus->addr_index));
+	if (!bus->addr_index)
+		nr = 0;
 
+	r = bus->addr_index;
 	ndctl_region_foreach(bus, region) {
-		region_start = ndctl_region_get_resource(region);
-		region_end = region_start + ndctl_region_get_size(region);
-		if (region_start <= address && address < region_end)
-			return region;
+		if (r == bus->addr_index + nr)
+			break;
+		start = ndctl_region_get_resource(region);
+		size = ndctl_region_get_size(region);
+		if (start == ULLONG_MAX || !size)
+			continue;
+		r->start = start;
+		r->end = start + size;
+		r->region = region;
+		r++;
 	}
+	bus->nr_addr_index = r - bus->addr_index;
+	if (bus->nr_addr_index > 1)
+		qsort(bus->addr_index, bus->nr_addr_index,
+				sizeof(*bus->addr_index), addr_range_cmp);
+	nd_init_end(ctx, &bus->addr_index_init);
+}
 
-	return NULL;
+static struct ndctl_region *addr_index_lookup(struct ndctl_bus *bus,
+		unsigned long long address)
+{
+	unsigned int lo = 0, hi = bus->nr_addr_index;
+	struct ndctl_addr_range *r;
+
+	/* find the last range starting at or below @address */
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (bus->addr_index[mid].start <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (!lo)
+		return NULL;
+	r = &bus->addr_index[lo - 1];
+	return address < r->end ? r->region : NULL;
 }
 
 /**
- * ndctl_bus_get_dimm_by_physical_address - get ndctl_dimm pointer by physical address
+ * ndctl_bus_get_region_by_physical_address - get region by physical address
  * @bus: ndctl_bus instance
  * @address: (System) Physical Address
  *
- * Returns address of ndctl_dimm on success.
+ * If @bus and @address is valid, returns a region address, which
+ * physical address belongs to.
  */
-NDCTL_EXPORT struct ndctl_dimm *ndctl_bus_get_dimm_by_physical_address(
+NDCTL_EXPORT struct ndctl_region *ndctl_bus_get_region_by_physical_address(
 		struct ndctl_bus *bus, unsigned long long address)
 {
-	unsigned int handle;
-	unsigned long long dpa;
-	struct ndctl_region *region;
-
 	if (!bus)
 		return NULL;
 
-	region = ndctl_bus_get_region_by_physical_address(bus, address);
-	if (!region)
-		return NULL;
+	addr_index_init(bus);
+	return addr_index_lookup(bus, address);
+}
+
+static struct ndctl_dimm *region_get_dimm_by_physical_address(
+		struct ndctl_region *region, unsigned long long address)
+{
+	struct ndctl_bus *bus = ndctl_region_get_bus(region);
+	unsigned long long dpa;
+	unsigned int handle;
 
 	if (ndctl_region_get_interleave_ways(region) == 1) {
 		struct ndctl_mapping *mapping = ndctl_mapping_get_first(region);
@@ -2486,6 +3115,63 @@ NDCTL_EXPORT struct ndctl_dimm *ndctl_bus_get_dimm_by_physical_address(
 	return NULL;
 }
 
+/**
+ * ndctl_bus_get_dimm_by_physical_address - get ndctl_dimm pointer by physical address
+ * @bus: ndctl_bus instance
+ * @address: (System) Physical Address
+ *
+ * Returns address of ndctl_dimm on success.
+ */
+NDCTL_EXPORT struct ndctl_dimm *ndctl_bus_get_dimm_by_physical_address(
+		struct ndctl_bus *bus, unsigned long long address)
+{
+	struct ndctl_region *region;
+
+	region = ndctl_bus_get_region_by_physical_address(bus, address);
+	if (!region)
+		return NULL;
+
+	return region_get_dimm_by_physical_address(region, address);
+}
+
+/**
+ * ndctl_bus_translate_physical_addresses - look up many addresses at once
+ * @bus: ndctl_bus instance
+ * @addresses: array of @nr (System) Physical Addresses
+ * @nr: number of entries in @addresses
+ * @regions: optional array of @nr results, NULL where no region matches
+ * @dimms: optional array of @nr results, NULL where no dimm is known
+ *
+ * Equivalent to calling ndctl_bus_get_region_by_physical_address() and
+ * ndctl_bus_get_dimm_by_physical_address() for each address, without
+ * repeating the region lookup for the dimm. Interleaved regions still
+ * cost one Translate SPA call per address when @dimms is given.
+ *
+ * Returns the number of addresses that fall within a region.
+ */
+NDCTL_EXPORT unsigned int ndctl_bus_translate_physical_addresses(
+		struct ndctl_bus *bus, const unsigned long long *addresses,
+		unsigned int nr, struct ndctl_region **regions,
+		struct ndctl_dimm **dimms)
+{
+	struct ndctl_region *region;
+	unsigned int i, found = 0;
+
+	if (bus)
+		addr_index_init(bus);
+	for (i = 0; i < nr; i++) {
+		region = bus ? addr_index_lookup(bus, addresses[i]) : NULL;
+		if (region)
+			found++;
+		if (regions)
+			regions[i] = region;
+		if (dimms)
+			dimms[i] = region ? region_get_dimm_by_physical_address(
+					region, addresses[i]) : NULL;
+	}
+	return found;
+}
+
 static int region_set_type(struct ndctl_region *region, char *path)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
@@ -2531,12 +3217,21 @@ static void *add_region(void *parent, int id, const char *region_base)
 	struct ndctl_bus *bus = parent;
 	struct ndctl_ctx *ctx = bus->ctx;
 	char *path = calloc(1, strlen(region_base) + 100);
+	const char *attrs[] = {
+		"size", "mappings", ndctl_bus_has_nfit(bus)
+			? "nfit/range_index" : "papr/range_index",
+		"read_only", "modalias", "numa_node", "target_node", "align",
+		"persistence_domain",
+	};
+	struct ndctl_sysfs_dir dir;
 	int perm, rc;
 
 	if (!path)
 		return NULL;
+	ndctl_sysfs_dir_init(&dir, ctx, region_base);
+	ndctl_sysfs_dir_prefetch(&dir, attrs, ARRAY_SIZE(attrs));
 
-	region = calloc(1, sizeof(*region));
+	region = arena_zalloc(&ctx->arena, sizeof(*region));
 	if (!region)
 		goto err_region;
 	list_head_init(&region->btts);
@@ -2552,49 +3247,42 @@ static void *add_region(void *parent, int id, const char *region_base)
 	region->bus = bus;
 	region->id = id;
 
-	sprintf(path, "%s/size", region_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "size", buf) < 0)
 		goto err_read;
 	region->size = strtoull(buf, NULL, 0);
 
-	sprintf(path, "%s/mappings", region_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "mappings", buf) < 0)
 		goto err_read;
 	region->num_mappings = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/%s/range_index", region_base,
-		ndctl_bus_has_nfit(bus) ? "nfit": "papr");
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, attrs[2], buf) < 0)
 		region->range_index = -1;
 	else
 		region->range_index = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/read_only", region_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "read_only", buf) < 0)
 		goto err_read;
 	region->ro = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/modalias", region_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "modalias", buf) < 0)
+		goto err_read;
+	region->modalias = arena_strdup(&ctx->arena, buf);
+	if (!region->modalias)
 		goto err_read;
-	region->module = to_module(ctx, buf);
 
-	sprintf(path, "%s/numa_node", region_base);
-	if ((rc = sysfs_read_attr(ctx, path, buf)) == 0)
+	if ((rc = ndctl_sysfs_dir_read(&dir, "numa_node", buf)) == 0)
 		region->numa_node = strtol(buf, NULL, 0);
 	else if (rc == -ENOENT)
 		region->numa_node = NUMA_NO_ATTR;
 	else
 		region->numa_node = NUMA_NO_NODE;
 
-	sprintf(path, "%s/target_node", region_base);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "target_node", buf) == 0)
 		region->target_node = strtol(buf, NULL, 0);
 	else
 		region->target_node = -1;
 
-	sprintf(path, "%s/align", region_base);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "align", buf) == 0)
 		region->align = strtoul(buf, NULL, 0);
 	else
 		region->align = ULONG_MAX;
@@ -2602,20 +3290,14 @@ static void *add_region(void *parent, int id, const char *region_base)
 	if (region_set_type(region, path) < 0)
 		goto err_read;
 
-        region->region_buf = calloc(1, strlen(region_base) + 50);
-        if (!region->region_buf)
-                goto err_read;
-        region->buf_len = strlen(region_base) + 50;
-
-	region->region_path = strdup(region_base);
+	region->region_path = arena_strdup(&ctx->arena, region_base);
 	if (!region->region_path)
 		goto err_read;
 
 	list_add(&bus->regions, &region->list);
 
 	/* get the persistence domain attrib */
-	sprintf(path, "%s/persistence_domain", region_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "persistence_domain", buf) < 0)
 		region->persistence_domain = PERSISTENCE_UNKNOWN;
 	else
 		region->persistence_domain = region_get_pd_type(buf);
@@ -2638,27 +3320,32 @@ static void *add_region(void *parent, int id, const char *region_base)
 	}
 
  out:
+	ndctl_sysfs_dir_close(&dir);
 	free(path);
 	return region;
 
  err_read:
-	free(region->region_buf);
-	free(region);
+	/* the arena takes the region back at ndctl_unref() */
  err_region:
+	ndctl_sysfs_dir_close(&dir);
 	free(path);
 
 	return NULL;
 }
 
-static void regions_init(struct ndctl_bus *bus)
+static void __regions_init(struct ndctl_bus *bus)
 {
-	if (bus->regions_init)
-		return;
-
-	bus->regions_init = 1;
 	device_parse(bus->ctx, bus, bus->bus_path, "region", bus, add_region);
 }
 
+static void regions_init(struct ndctl_bus *bus)
+{
+	if (nd_init_begin(bus->ctx, &bus->regions_init)) {
+		__regions_init(bus);
+		nd_init_end(bus->ctx, &bus->regions_init);
+	}
+}
+
 NDCTL_EXPORT struct ndctl_region *ndctl_region_get_first(struct ndctl_bus *bus)
 {
 	regions_init(bus);
@@ -2698,8 +3385,8 @@ NDCTL_EXPORT unsigned long long ndctl_region_get_available_size(
 {
 	unsigned int nstype = ndctl_region_get_nstype(region);
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int rc, len = region->buf_len;
+	char path[PATH_MAX];
+	int rc, len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 
 	switch (nstype) {
@@ -2731,8 +3418,8 @@ NDCTL_EXPORT unsigned long long ndctl_region_get_max_available_extent(
 {
 	unsigned int nstype = ndctl_region_get_nstype(region);
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int rc, len = region->buf_len;
+	char path[PATH_MAX];
+	int rc, len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 
 	switch (nstype) {
@@ -2788,9 +3475,9 @@ NDCTL_EXPORT struct ndctl_namespace *ndctl_region_get_namespace_seed(
 {
 	struct ndctl_bus *bus = ndctl_region_get_bus(region);
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
-	char *path = region->region_buf;
+	char path[PATH_MAX];
 	struct ndctl_namespace *ndns;
-	int len = region->buf_len;
+	int len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 
 	if (snprintf(path, len, "%s/namespace_seed", region->region_path) >= len) {
@@ -2889,10 +3576,121 @@ NDCTL_EXPORT struct badblock *ndctl_region_get_next_badblock(struct ndctl_region
 
 NDCTL_EXPORT struct badblock *ndctl_region_get_first_badblock(struct ndctl_region *region)
 {
+	/* a fresh walk rereads the list, so let the index follow it */
+	free(region->bb_index);
+	region->bb_index = NULL;
+	region->nr_bb_index = 0;
+	region->bb_index_init = ND_INIT_NONE;
+
 	return badblocks_iter_first(&region->bb_iter,
 			ndctl_region_get_ctx(region), region->region_path);
 }
 
+static int badblock_cmp(const void *a, const void *b)
+{
+	const struct badblock *bb_a = a, *bb_b = b;
+
+	if (bb_a->offset < bb_b->offset)
+		return -1;
+	return bb_a->offset > bb_b->offset;
+}
+
+/*
+ * Sorted by offset with overlapping entries merged, so that the ends
+ * ascend as well and a lookup is a binary search rather than a pass
+ * over the sysfs text for every namespace in the region.
+ */
+static void region_bb_index_init(struct ndctl_region *region)
+{
+	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
+	struct badblocks_iter iter = { 0 };
+	struct badblock *bb, *bbs = NULL, *tmp;
+	unsigned int nr = 0, alloc = 0, i, j;
+	unsigned long long end;
+
+	if (!nd_init_begin(ctx, &region->bb_index_init))
+		return;
+
+	for (bb = badblocks_iter_first(&iter, ctx, region->region_path); bb;
+			bb = badblocks_iter_next(&iter)) {
+		if (nr == alloc) {
+			alloc = alloc ? alloc * 2 : 16;
+			tmp = realloc(bbs, alloc * sizeof(*bbs));
+			if (!tmp) {
+				err(ctx, "%s: badblocks index truncated\n",
+						ndctl_region_get_devname(region));
+				break;
+			}
+			bbs = tmp;
+		}
+		bbs[nr++] = *bb;
+	}
+	badblocks_iter_free(&iter);
+
+	if (nr > 1)
+		qsort(bbs, nr, sizeof(*bbs), badblock_cmp);
+	for (i = 1, j = 0; i < nr; i++) {
+		end = bbs[j].offset + bbs[j].len;
+		if (bbs[i].offset < end) {
+			end = max(end, bbs[i].offset + bbs[i].len);
+			if (end - bbs[j].offset <= UINT_MAX) {
+				bbs[j].len = end - bbs[j].offset;
+				continue;
+			}
+		}
+		bbs[++j] = bbs[i];
+	}
+
+	region->bb_index = bbs;
+	region->nr_bb_index = nr ? j + 1 : 0;
+	nd_init_end(ctx, &region->bb_index_init);
+}
+
+/**
+ * ndctl_region_get_badblocks_range() - badblocks overlapping a span of a region
+ * @region: region to search
+ * @offset: start of the span in 512-byte sectors from the region base
+ * @len: length of the span in sectors
+ * @bbs: set to the first overlapping entry
+ *
+ * The region's badblocks are read once into a sorted index and served
+ * from memory until the next ndctl_region_get_first_badblock(), which
+ * rereads them. Entries are not clipped to the span, and those that
+ * overlapped each other in sysfs are reported merged.
+ *
+ * Returns the number of consecutive entries at @bbs.
+ */
+NDCTL_EXPORT unsigned int ndctl_region_get_badblocks_range(
+		struct ndctl_region *region, unsigned long long offset,
+		unsigned long long len, const struct badblock **bbs)
+{
+	unsigned int lo = 0, hi, first;
+	const struct badblock *bb;
+
+	region_bb_index_init(region);
+
+	*bbs = region->bb_index;
+	hi = region->nr_bb_index;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		bb = &region->bb_index[mid];
+		if (bb->offset + bb->len <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	first = lo;
+	while (lo < region->nr_bb_index
+			&& region->bb_index[lo].offset < offset + len)
+		lo++;
+	if (lo == first)
+		return 0;
+	*bbs = &region->bb_index[first];
+	return lo - first;
+}
+
 NDCTL_EXPORT enum ndctl_persistence_domain
 ndctl_region_get_persistence_domain(struct ndctl_region *region)
 {
@@ -3300,7 +4098,7 @@ NDCTL_EXPORT void ndctl_cmd_unref(struct ndctl_cmd *cmd)
 {
 	if (!cmd)
 		return;
-	if (--cmd->refcount == 0) {
+	if (__atomic_sub_fetch(&cmd->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
 		if (cmd->source)
 			ndctl_cmd_unref(cmd->source);
 		else
@@ -3311,7 +4109,7 @@ NDCTL_EXPORT void ndctl_cmd_unref(struct ndctl_cmd *cmd)
 
 NDCTL_EXPORT void ndctl_cmd_ref(struct ndctl_cmd *cmd)
 {
-	cmd->refcount++;
+	__atomic_add_fetch(&cmd->refcount, 1, __ATOMIC_RELAXED);
 }
 
 NDCTL_EXPORT int ndctl_cmd_get_type(struct ndctl_cmd *cmd)
@@ -3400,10 +4198,11 @@ static int do_cmd(int fd, int ioctl_cmd, struct ndctl_cmd *cmd)
 	for (offset = 0; offset < iter->total_xfer; offset += iter->max_xfer) {
 		cmd->set_xfer(cmd, min(iter->total_xfer - offset,
 				iter->max_xfer));
-		cmd->set_offset(cmd, offset);
+		cmd->set_offset(cmd, iter->init_offset + offset);
 		if (iter->dir == WRITE)
-			memcpy(iter->data, iter->total_buf + offset,
-					cmd->get_xfer(cmd));
+			memcpy(iter->data,
+				iter->total_buf + iter->init_offset + offset,
+				cmd->get_xfer(cmd));
 		rc = ioctl(fd, ioctl_cmd, cmd->cmd_buf);
 		if (rc < 0) {
 			rc = -errno;
@@ -3411,8 +4210,8 @@ static int do_cmd(int fd, int ioctl_cmd, struct ndctl_cmd *cmd)
 		}
 
 		if (iter->dir == READ)
-			memcpy(iter->total_buf + offset, iter->data,
-					cmd->get_xfer(cmd) - rc);
+			memcpy(iter->total_buf + iter->init_offset + offset,
+					iter->data, cmd->get_xfer(cmd) - rc);
 		if (cmd->get_firmware_status(cmd) || rc) {
 			rc = offset + cmd->get_xfer(cmd) - rc;
 			break;
@@ -3429,12 +4228,104 @@ static int do_cmd(int fd, int ioctl_cmd, struct ndctl_cmd *cmd)
 	return rc;
 }
 
-NDCTL_EXPORT int ndctl_cmd_submit(struct ndctl_cmd *cmd)
+static int open_cmd_node(struct ndctl_ctx *ctx, const char *prefix,
+		unsigned int id, unsigned int major, unsigned int minor)
 {
 	struct stat st;
-	char path[20], *prefix;
+	char path[20];
+	int fd, len = sizeof(path);
+
+	if (snprintf(path, len, "/dev/%s%u", prefix, id) >= len)
+		return -EINVAL;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd < 0) {
+		err(ctx, "failed to open %s: %s\n", path, strerror(errno));
+		return -errno;
+	}
+
+	if (fstat(fd, &st) < 0 || !S_ISCHR(st.st_mode)
+			|| major(st.st_rdev) != major
+			|| minor(st.st_rdev) != minor) {
+		err(ctx, "failed to validate %s as a control node\n", path);
+		close(fd);
+		return -ENXIO;
+	}
+
+	return fd;
+}
+
+/* bus commands that only read state, safe to issue a second time */
+static bool bus_cmd_is_query(struct ndctl_cmd *cmd)
+{
+	switch (cmd->type) {
+	case ND_CMD_ARS_CAP:
+	case ND_CMD_ARS_STATUS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int bus_do_cmd(struct ndctl_bus *bus, int ioctl_cmd,
+		struct ndctl_cmd *cmd)
+{
+	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
+	int rc, fd, retry = bus_cmd_is_query(cmd);
+
+	do {
+		if (bus->fd < 0) {
+			fd = open_cmd_node(ctx, "ndctl", ndctl_bus_get_id(bus),
+					ndctl_bus_get_major(bus),
+					ndctl_bus_get_minor(bus));
+			if (fd < 0)
+				return fd;
+			bus->fd = fd;
+		}
+
+		rc = do_cmd(bus->fd, ioctl_cmd, cmd);
+
+		/*
+		 * Revalidate a stale control node, and retry once if the
+		 * command only reads. Whether a failed command reached the
+		 * device is unknown, so one that changes state is not
+		 * issued twice.
+		 */
+		if (rc != -ENODEV && rc != -ENXIO)
+			break;
+		close(bus->fd);
+		bus->fd = -1;
+	} while (retry--);
+
+	return rc;
+}
+
+/**
+ * ndctl_bus_set_persistent_fd - keep the bus control node open
+ * @bus: bus to operate on
+ * @enable: non-zero to cache the file descriptor, zero to release it
+ *
+ * By default ndctl_cmd_submit() opens and validates /dev/ndctlN for
+ * every bus-scope command. When enabled, a validated descriptor is
+ * kept open until the bus is freed, and revalidated if a command fails
+ * with -ENODEV or -ENXIO. Only ARS capability and status queries are
+ * then retried, any other command reports the failure.
+ */
+NDCTL_EXPORT void ndctl_bus_set_persistent_fd(struct ndctl_bus *bus,
+		int enable)
+{
+	bus->persistent_fd = !!enable;
+	if (!enable && bus->fd >= 0) {
+		close(bus->fd);
+		bus->fd = -1;
+	}
+}
+
+NDCTL_EXPORT int ndctl_cmd_submit(struct ndctl_cmd *cmd)
+{
+	char *prefix;
 	unsigned int major, minor, id;
-	int rc = 0, fd, len = sizeof(path);
+	int rc = 0, fd;
 	int ioctl_cmd = to_ioctl_cmd(cmd->type, !!cmd->dimm);
 	struct ndctl_bus *bus = cmd_to_bus(cmd);
 	struct ndctl_ctx *ctx = ndctl_bus_get_ctx(bus);
@@ -3444,65 +4335,310 @@ NDCTL_EXPORT int ndctl_cmd_submit(struct ndctl_cmd *cmd)
 		return -EINVAL;
 	}
 
-	if (ioctl_cmd == 0) {
-		rc = -EINVAL;
-		goto out;
-	}
+	if (cmd->dimm && ndctl_smart_cache_get(cmd, &rc))
+		return rc;
+
+	if (ioctl_cmd == 0) {
+		rc = -EINVAL;
+		goto out;
+	}
+
+	usdt(libndctl, cmd_start, bus->id,
+			cmd->dimm ? ndctl_dimm_get_handle(cmd->dimm) : 0,
+			cmd->type);
+	if (!cmd->dimm && bus->persistent_fd) {
+		rc = bus_do_cmd(bus, ioctl_cmd, cmd);
+		goto out;
+	}
+
+	if (cmd->dimm) {
+		prefix = "nmem";
+		id = ndctl_dimm_get_id(cmd->dimm);
+		major = ndctl_dimm_get_major(cmd->dimm);
+		minor = ndctl_dimm_get_minor(cmd->dimm);
+	} else {
+		prefix = "ndctl";
+		id = ndctl_bus_get_id(cmd->bus);
+		major = ndctl_bus_get_major(cmd->bus);
+		minor = ndctl_bus_get_minor(cmd->bus);
+	}
+
+	fd = open_cmd_node(ctx, prefix, id, major, minor);
+	if (fd < 0) {
+		rc = fd;
+		goto out;
+	}
+
+	rc = do_cmd(fd, ioctl_cmd, cmd);
+	close(fd);
+ out:
+	usdt(libndctl, cmd_done, bus->id,
+			cmd->dimm ? ndctl_dimm_get_handle(cmd->dimm) : 0,
+			cmd->type, rc);
+	cmd->status = rc;
+	if (cmd->dimm)
+		ndctl_smart_cache_update(cmd, rc);
+	return rc;
+}
+
+NDCTL_EXPORT int ndctl_cmd_submit_xlat(struct ndctl_cmd *cmd)
+{
+	int rc, xlat_rc;
+
+	rc = ndctl_cmd_submit(cmd);
+	if (rc < 0)
+		return rc;
+
+	/*
+	 * NOTE: This can lose a positive rc when xlat_rc is non-zero. The
+	 * positive rc indicates a buffer underrun from the original command
+	 * submission. If the caller cares about that (generally not very
+	 * useful), then the xlat function is available separately as well.
+	 */
+	xlat_rc = ndctl_cmd_xlat_firmware_status(cmd);
+	return (xlat_rc == 0) ? rc : xlat_rc;
+}
+
+struct ndctl_cmd_batch_entry {
+	struct ndctl_cmd *cmd;
+	int rc;
+};
+
+/**
+ * struct ndctl_cmd_batch - set of prepared commands submitted together
+ * @ctx: library context the commands belong to
+ * @entries: commands in submission order with their submit result
+ * @nr: number of queued commands
+ * @alloc: allocated size of @entries
+ */
+struct ndctl_cmd_batch {
+	struct ndctl_ctx *ctx;
+	struct ndctl_cmd_batch_entry *entries;
+	int nr, alloc;
+};
+
+/* commands are serialized per target: a dimm, or the bus for bus commands */
+struct ndctl_cmd_batch_run {
+	struct ndctl_cmd_batch *batch;
+	void **targets;
+};
+
+static void *cmd_target(struct ndctl_cmd *cmd)
+{
+	if (cmd->dimm)
+		return cmd->dimm;
+	return cmd->bus;
+}
+
+NDCTL_EXPORT struct ndctl_cmd_batch *ndctl_cmd_batch_new(struct ndctl_ctx *ctx)
+{
+	struct ndctl_cmd_batch *batch;
+
+	batch = calloc(1, sizeof(*batch));
+	if (!batch)
+		return NULL;
+	batch->ctx = ctx;
+	return batch;
+}
+
+NDCTL_EXPORT void ndctl_cmd_batch_free(struct ndctl_cmd_batch *batch)
+{
+	int i;
+
+	if (!batch)
+		return;
+	for (i = 0; i < batch->nr; i++)
+		ndctl_cmd_unref(batch->entries[i].cmd);
+	free(batch->entries);
+	free(batch);
+}
+
+/**
+ * ndctl_cmd_batch_add - queue a prepared command
+ * @batch: batch established by ndctl_cmd_batch_new()
+ * @cmd: fully prepared command, the batch takes its own reference
+ *
+ * Returns the index of @cmd in the batch, or a negative error code.
+ */
+NDCTL_EXPORT int ndctl_cmd_batch_add(struct ndctl_cmd_batch *batch,
+		struct ndctl_cmd *cmd)
+{
+	struct ndctl_cmd_batch_entry *entries;
+
+	if (!cmd || ndctl_bus_get_ctx(cmd_to_bus(cmd)) != batch->ctx)
+		return -EINVAL;
+
+	if (batch->nr == batch->alloc) {
+		int alloc = batch->alloc ? batch->alloc * 2 : 16;
+
+		entries = realloc(batch->entries, alloc * sizeof(*entries));
+		if (!entries)
+			return -ENOMEM;
+		batch->entries = entries;
+		batch->alloc = alloc;
+	}
+
+	ndctl_cmd_ref(cmd);
+	batch->entries[batch->nr].cmd = cmd;
+	batch->entries[batch->nr].rc = -EINPROGRESS;
+	return batch->nr++;
+}
+
+NDCTL_EXPORT int ndctl_cmd_batch_get_count(struct ndctl_cmd_batch *batch)
+{
+	return batch->nr;
+}
+
+NDCTL_EXPORT struct ndctl_cmd *ndctl_cmd_batch_get_cmd(
+		struct ndctl_cmd_batch *batch, int idx)
+{
+	if (idx < 0 || idx >= batch->nr)
+		return NULL;
+	return batch->entries[idx].cmd;
+}
+
+/**
+ * ndctl_cmd_batch_get_result - retrieve the submission result of one command
+ * @batch: submitted batch
+ * @idx: index returned by ndctl_cmd_batch_add()
+ *
+ * Returns the ndctl_cmd_submit() result for the command. The firmware
+ * status is left for the caller to translate, as with ndctl_cmd_submit().
+ */
+NDCTL_EXPORT int ndctl_cmd_batch_get_result(struct ndctl_cmd_batch *batch,
+		int idx)
+{
+	if (idx < 0 || idx >= batch->nr)
+		return -EINVAL;
+	return batch->entries[idx].rc;
+}
+
+/**
+ * ndctl_cmd_batch_find_dimm - find the first queued command for a dimm
+ * @batch: batch to search
+ * @dimm: target of the command
+ *
+ * Returns the command's index in the batch, or -ENOENT.
+ */
+NDCTL_EXPORT int ndctl_cmd_batch_find_dimm(struct ndctl_cmd_batch *batch,
+		struct ndctl_dimm *dimm)
+{
+	int i;
+
+	for (i = 0; i < batch->nr; i++)
+		if (batch->entries[i].cmd->dimm == dimm)
+			return i;
+	return -ENOENT;
+}
+
+static void ndctl_cmd_batch_target(void *arg, int idx)
+{
+	struct ndctl_cmd_batch_run *run = arg;
+	struct ndctl_cmd_batch *batch = run->batch;
+	int i;
+
+	for (i = 0; i < batch->nr; i++) {
+		struct ndctl_cmd_batch_entry *entry = &batch->entries[i];
+
+		if (cmd_target(entry->cmd) != run->targets[idx])
+			continue;
+		entry->rc = ndctl_cmd_submit(entry->cmd);
+	}
+}
+
+/**
+ * ndctl_cmd_batch_submit - submit all queued commands
+ * @batch: batch established by ndctl_cmd_batch_new()
+ *
+ * Commands targeting the same dimm, or the same bus for bus scope
+ * commands, are issued in the order they were added. Different targets
+ * are serviced concurrently, on up to one thread per online cpu, or
+ * the ndctl_set_max_threads() bound, so a batch of DSMs across a bus
+ * completes in roughly the time of the slowest dimm rather than the
+ * sum of all of them.
+ *
+ * Returns 0 if every command was submitted, otherwise the first
+ * failure in queue order. Per-command results are available from
+ * ndctl_cmd_batch_get_result().
+ */
+NDCTL_EXPORT int ndctl_cmd_batch_submit(struct ndctl_cmd_batch *batch)
+{
+	struct ndctl_cmd_batch_run run = { .batch = batch };
+	struct util_pool pool = {
+		.arg = &run,
+		.jobs = batch->ctx->max_threads,
+		.run = ndctl_cmd_batch_target,
+	};
+	int i, j, rc;
+
+	if (!batch->nr)
+		return 0;
 
-	if (cmd->dimm) {
-		prefix = "nmem";
-		id = ndctl_dimm_get_id(cmd->dimm);
-		major = ndctl_dimm_get_major(cmd->dimm);
-		minor = ndctl_dimm_get_minor(cmd->dimm);
-	} else {
-		prefix = "ndctl";
-		id = ndctl_bus_get_id(cmd->bus);
-		major = ndctl_bus_get_major(cmd->bus);
-		minor = ndctl_bus_get_minor(cmd->bus);
-	}
+	run.targets = calloc(batch->nr, sizeof(*run.targets));
+	if (!run.targets)
+		return -ENOMEM;
 
-	if (snprintf(path, len, "/dev/%s%u", prefix, id) >= len) {
-		rc = -EINVAL;
-		goto out;
-	}
+	for (i = 0; i < batch->nr; i++) {
+		void *target = cmd_target(batch->entries[i].cmd);
 
-	fd = open(path, O_RDWR);
-	if (fd < 0) {
-		err(ctx, "failed to open %s: %s\n", path, strerror(errno));
-		rc = -errno;
-		goto out;
+		for (j = 0; j < pool.nr; j++)
+			if (run.targets[j] == target)
+				break;
+		if (j == pool.nr)
+			run.targets[pool.nr++] = target;
 	}
 
-	if (fstat(fd, &st) >= 0 && S_ISCHR(st.st_mode)
-			&& major(st.st_rdev) == major
-			&& minor(st.st_rdev) == minor) {
-		rc = do_cmd(fd, ioctl_cmd, cmd);
-	} else {
-		err(ctx, "failed to validate %s as a control node\n", path);
-		rc = -ENXIO;
-	}
-	close(fd);
- out:
-	cmd->status = rc;
+	util_pool_run(&pool);
+	free(run.targets);
+
+	rc = 0;
+	for (i = 0; i < batch->nr; i++)
+		if (batch->entries[i].rc < 0) {
+			rc = batch->entries[i].rc;
+			break;
+		}
+
 	return rc;
 }
 
-NDCTL_EXPORT int ndctl_cmd_submit_xlat(struct ndctl_cmd *cmd)
+/**
+ * ndctl_bus_cmd_batch_dimms - run one command type across a bus
+ * @bus: bus whose dimms are targeted
+ * @new_cmd: constructor such as ndctl_dimm_cmd_new_smart()
+ *
+ * Builds a command for every dimm on @bus for which @new_cmd succeeds
+ * and submits them as one batch. Look up a dimm's command with
+ * ndctl_cmd_batch_find_dimm().
+ *
+ * Returns the submitted batch, or NULL if it could not be allocated.
+ */
+NDCTL_EXPORT struct ndctl_cmd_batch *ndctl_bus_cmd_batch_dimms(
+		struct ndctl_bus *bus,
+		struct ndctl_cmd *(*new_cmd)(struct ndctl_dimm *dimm))
 {
-	int rc, xlat_rc;
+	struct ndctl_cmd_batch *batch;
+	struct ndctl_dimm *dimm;
+	struct ndctl_cmd *cmd;
+	int rc;
 
-	rc = ndctl_cmd_submit(cmd);
-	if (rc < 0)
-		return rc;
+	batch = ndctl_cmd_batch_new(ndctl_bus_get_ctx(bus));
+	if (!batch)
+		return NULL;
 
-	/*
-	 * NOTE: This can lose a positive rc when xlat_rc is non-zero. The
-	 * positive rc indicates a buffer underrun from the original command
-	 * submission. If the caller cares about that (generally not very
-	 * useful), then the xlat function is available separately as well.
-	 */
-	xlat_rc = ndctl_cmd_xlat_firmware_status(cmd);
-	return (xlat_rc == 0) ? rc : xlat_rc;
+	ndctl_dimm_foreach(bus, dimm) {
+		cmd = new_cmd(dimm);
+		if (!cmd)
+			continue;
+		rc = ndctl_cmd_batch_add(batch, cmd);
+		ndctl_cmd_unref(cmd);
+		if (rc < 0) {
+			ndctl_cmd_batch_free(batch);
+			return NULL;
+		}
+	}
+
+	ndctl_cmd_batch_submit(batch);
+	return batch;
 }
 
 NDCTL_EXPORT int ndctl_cmd_get_status(struct ndctl_cmd *cmd)
@@ -3534,8 +4670,8 @@ static int is_enabled(struct ndctl_bus *bus, const char *drvpath)
 NDCTL_EXPORT int ndctl_region_is_enabled(struct ndctl_region *region)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
-	char *path = region->region_buf;
-	int len = region->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/driver", region->region_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -3550,11 +4686,12 @@ NDCTL_EXPORT int ndctl_region_enable(struct ndctl_region *region)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
 	const char *devname = ndctl_region_get_devname(region);
+	char path[PATH_MAX];
 
 	if (ndctl_region_is_enabled(region))
 		return 0;
 
-	ndctl_bind(ctx, region->module, devname);
+	ndctl_bind(ctx, region->modalias, devname);
 
 	if (!ndctl_region_is_enabled(region)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -3563,7 +4700,7 @@ NDCTL_EXPORT int ndctl_region_enable(struct ndctl_region *region)
 
 	if (region->refresh_type) {
 		region->refresh_type = 0;
-		region_set_type(region, region->region_buf);
+		region_set_type(region, path);
 	}
 
 	dbg(ctx, "%s: enabled\n", devname);
@@ -3677,8 +4814,8 @@ NDCTL_EXPORT struct ndctl_interleave_set *ndctl_interleave_set_get_next(
 NDCTL_EXPORT int ndctl_dimm_is_enabled(struct ndctl_dimm *dimm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
-	int len = dimm->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/driver", dimm->dimm_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -3692,9 +4829,9 @@ NDCTL_EXPORT int ndctl_dimm_is_enabled(struct ndctl_dimm *dimm)
 NDCTL_EXPORT int ndctl_dimm_is_active(struct ndctl_dimm *dimm)
 {
 	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
-	char *path = dimm->dimm_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = dimm->buf_len;
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/state", dimm->dimm_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -3747,17 +4884,13 @@ NDCTL_EXPORT struct ndctl_dimm *ndctl_interleave_set_get_next_dimm(
 	return ndctl_region_get_next_dimm(region, dimm);
 }
 
-static void mappings_init(struct ndctl_region *region)
+static void __mappings_init(struct ndctl_region *region)
 {
 	char *mapping_path, buf[SYSFS_ATTR_SIZE];
 	struct ndctl_bus *bus = region->bus;
 	struct ndctl_ctx *ctx = bus->ctx;
 	int i;
 
-	if (region->mappings_init)
-		return;
-	region->mappings_init = 1;
-
 	mapping_path = calloc(1, strlen(region->region_path) + 100);
 	if (!mapping_path) {
 		err(ctx, "bus%d region%d: allocation failure\n",
@@ -3796,7 +4929,7 @@ static void mappings_init(struct ndctl_region *region)
 			continue;
 		}
 
-		mapping = calloc(1, sizeof(*mapping));
+		mapping = arena_zalloc(&ctx->arena, sizeof(*mapping));
 		if (!mapping) {
 			err(ctx, "bus%d region%d mapping%d: allocation failure\n",
 					bus->id, region->id, i);
@@ -3813,6 +4946,14 @@ static void mappings_init(struct ndctl_region *region)
 	free(mapping_path);
 }
 
+static void mappings_init(struct ndctl_region *region)
+{
+	if (nd_init_begin(region->bus->ctx, &region->mappings_init)) {
+		__mappings_init(region);
+		nd_init_end(region->bus->ctx, &region->mappings_init);
+	}
+}
+
 NDCTL_EXPORT struct ndctl_mapping *ndctl_mapping_get_first(struct ndctl_region *region)
 {
 	mappings_init(region);
@@ -3871,11 +5012,26 @@ static struct kmod_module *to_module(struct ndctl_ctx *ctx, const char *alias)
 	struct kmod_module *mod;
 	int rc;
 
-	if (!ctx->kmod_ctx)
+	/*
+	 * libkmod is not thread safe. The kmod context, and the
+	 * modules.dep indexes it loads, are only set up the first time a
+	 * device is enabled, read-only commands never pay for them.
+	 */
+	pthread_mutex_lock(&ctx->kmod_lock);
+	if (!ctx->kmod_ctx && !ctx->kmod_failed) {
+		ctx->kmod_ctx = kmod_new(NULL, NULL);
+		if (check_kmod(ctx->kmod_ctx) != 0) {
+			err(ctx, "failed to initialize kmod\n");
+			ctx->kmod_failed = 1;
+		}
+	}
+	if (!ctx->kmod_ctx) {
+		pthread_mutex_unlock(&ctx->kmod_lock);
 		return NULL;
-
+	}
 	rc = kmod_module_new_from_lookup(ctx->kmod_ctx, alias, &list);
 	if (rc < 0 || !list) {
+		pthread_mutex_unlock(&ctx->kmod_lock);
 		dbg(ctx, "failed to find module for alias: %s %d list: %s\n",
 				alias, rc, list ? "populated" : "empty");
 		return NULL;
@@ -3883,6 +5039,7 @@ static struct kmod_module *to_module(struct ndctl_ctx *ctx, const char *alias)
 	mod = kmod_module_get_module(list);
 	dbg(ctx, "alias: %s module: %s\n", alias, kmod_module_get_name(mod));
 	kmod_module_unref_list(list);
+	pthread_mutex_unlock(&ctx->kmod_lock);
 
 	return mod;
 }
@@ -3944,18 +5101,25 @@ static enum ndctl_namespace_mode enforce_name_to_id(const char *name)
 	return NDCTL_NS_MODE_UNKNOWN;
 }
 
+/* the last three are only present on pmem and blk namespaces */
+static const char * const namespace_attrs[] = {
+	"nstype", "size", "resource", "force_raw", "numa_node", "target_node",
+	"holder_class", "modalias", "sector_size", "alt_name", "uuid",
+};
+
 static void *add_namespace(void *parent, int id, const char *ndns_base)
 {
 	const char *devname = devpath_to_devname(ndns_base);
-	char *path = calloc(1, strlen(ndns_base) + 100);
 	struct ndctl_namespace *ndns, *ndns_dup;
 	struct ndctl_region *region = parent;
 	struct ndctl_bus *bus = region->bus;
 	struct ndctl_ctx *ctx = bus->ctx;
 	char buf[SYSFS_ATTR_SIZE];
+	struct ndctl_sysfs_dir dir;
 
-	if (!path)
-		return NULL;
+	ndctl_sysfs_dir_init(&dir, ctx, ndns_base);
+	ndctl_sysfs_dir_prefetch(&dir, namespace_attrs,
+			ARRAY_SIZE(namespace_attrs));
 
 	ndns = calloc(1, sizeof(*ndns));
 	if (!ndns)
@@ -3965,48 +5129,40 @@ static void *add_namespace(void *parent, int id, const char *ndns_base)
 	ndns->generation = region->generation;
 	list_head_init(&ndns->injected_bb);
 
-	sprintf(path, "%s/nstype", ndns_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "nstype", buf) < 0)
 		goto err_read;
 	ndns->type = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/size", ndns_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "size", buf) < 0)
 		goto err_read;
 	ndns->size = strtoull(buf, NULL, 0);
 
-	sprintf(path, "%s/resource", ndns_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "resource", buf) < 0)
 		ndns->resource = ULLONG_MAX;
 	else
 		ndns->resource = strtoull(buf, NULL, 0);
 
-	sprintf(path, "%s/force_raw", ndns_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "force_raw", buf) < 0)
 		goto err_read;
 	ndns->raw_mode = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/numa_node", ndns_base);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "numa_node", buf) == 0)
 		ndns->numa_node = strtol(buf, NULL, 0);
 	else
 		ndns->numa_node = -1;
 
-	sprintf(path, "%s/target_node", ndns_base);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "target_node", buf) == 0)
 		ndns->target_node = strtol(buf, NULL, 0);
 	else
 		ndns->target_node = -1;
 
-	sprintf(path, "%s/holder_class", ndns_base);
-	if (sysfs_read_attr(ctx, path, buf) == 0)
+	if (ndctl_sysfs_dir_read(&dir, "holder_class", buf) == 0)
 		ndns->enforce_mode = enforce_name_to_id(buf);
 
 	switch (ndns->type) {
 	case ND_DEVICE_NAMESPACE_BLK:
 	case ND_DEVICE_NAMESPACE_PMEM:
-		sprintf(path, "%s/sector_size", ndns_base);
-		if (sysfs_read_attr(ctx, path, buf) == 0)
+		if (ndctl_sysfs_dir_read(&dir, "sector_size", buf) == 0)
 			parse_lbasize_supported(ctx, devname, buf,
 					&ndns->lbasize);
 		else if (ndns->type == ND_DEVICE_NAMESPACE_BLK) {
@@ -4018,18 +5174,16 @@ static void *add_namespace(void *parent, int id, const char *ndns_base)
 		} else
 			parse_lbasize_supported(ctx, devname, "",
 					&ndns->lbasize);
-		sprintf(path, "%s/alt_name", ndns_base);
-		if (sysfs_read_attr(ctx, path, buf) < 0)
+		if (ndctl_sysfs_dir_read(&dir, "alt_name", buf) < 0)
 			goto err_read;
 		ndns->alt_name = strdup(buf);
 		if (!ndns->alt_name)
 			goto err_read;
 
-		sprintf(path, "%s/uuid", ndns_base);
-		if (sysfs_read_attr(ctx, path, buf) < 0)
+		if (ndctl_sysfs_dir_read(&dir, "uuid", buf) < 0)
 			goto err_read;
 		if (strlen(buf) && uuid_parse(buf, ndns->uuid) < 0) {
-			dbg(ctx, "%s:%s\n", path, buf);
+			dbg(ctx, "%s/uuid:%s\n", ndns_base, buf);
 			goto err_read;
 		}
 		break;
@@ -4041,51 +5195,51 @@ static void *add_namespace(void *parent, int id, const char *ndns_base)
 	if (!ndns->ndns_path)
 		goto err_read;
 
-	ndns->ndns_buf = calloc(1, strlen(ndns_base) + 50);
-	if (!ndns->ndns_buf)
+	if (ndctl_sysfs_dir_read(&dir, "modalias", buf) < 0)
 		goto err_read;
-	ndns->buf_len = strlen(ndns_base) + 50;
-
-	sprintf(path, "%s/modalias", ndns_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	ndns->modalias = strdup(buf);
+	if (!ndns->modalias)
 		goto err_read;
-	ndns->module = to_module(ctx, buf);
 
 	ndctl_namespace_foreach(region, ndns_dup)
 		if (ndns_dup->id == ndns->id) {
 			free_namespace(ndns, NULL);
-			free(path);
+			ndctl_sysfs_dir_close(&dir);
 			return ndns_dup;
 		}
 
 	list_add(&region->namespaces, &ndns->list);
-	free(path);
+	ndctl_sysfs_dir_close(&dir);
 	return ndns;
 
  err_read:
-	free(ndns->ndns_buf);
 	free(ndns->ndns_path);
 	free(ndns->alt_name);
+	free(ndns->modalias);
 	free(ndns);
  err_namespace:
-	free(path);
+	ndctl_sysfs_dir_close(&dir);
 	return NULL;
 }
 
-static void namespaces_init(struct ndctl_region *region)
+static void __namespaces_init(struct ndctl_region *region)
 {
 	struct ndctl_bus *bus = region->bus;
 	struct ndctl_ctx *ctx = bus->ctx;
 	char ndns_fmt[20];
 
-	if (region->namespaces_init)
-		return;
-	region->namespaces_init = 1;
-
 	sprintf(ndns_fmt, "namespace%d.", region->id);
 	device_parse(ctx, bus, region->region_path, ndns_fmt, region, add_namespace);
 }
 
+static void namespaces_init(struct ndctl_region *region)
+{
+	if (nd_init_begin(region->bus->ctx, &region->namespaces_init)) {
+		__namespaces_init(region);
+		nd_init_end(region->bus->ctx, &region->namespaces_init);
+	}
+}
+
 NDCTL_EXPORT struct ndctl_namespace *ndctl_namespace_get_first(struct ndctl_region *region)
 {
 	namespaces_init(region);
@@ -4139,8 +5293,8 @@ NDCTL_EXPORT struct ndctl_btt *ndctl_namespace_get_btt(struct ndctl_namespace *n
 {
 	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	struct ndctl_btt *btt;
 	char buf[SYSFS_ATTR_SIZE];
 
@@ -4163,8 +5317,8 @@ NDCTL_EXPORT struct ndctl_pfn *ndctl_namespace_get_pfn(struct ndctl_namespace *n
 {
 	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	struct ndctl_pfn *pfn;
 	char buf[SYSFS_ATTR_SIZE];
 
@@ -4187,8 +5341,8 @@ NDCTL_EXPORT struct ndctl_dax *ndctl_namespace_get_dax(struct ndctl_namespace *n
 {
 	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	struct ndctl_dax *dax;
 	char buf[SYSFS_ATTR_SIZE];
 
@@ -4211,8 +5365,8 @@ NDCTL_EXPORT const char *ndctl_namespace_get_block_device(struct ndctl_namespace
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
 	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (ndns->bdev)
 		return ndns->bdev;
@@ -4232,8 +5386,8 @@ NDCTL_EXPORT enum ndctl_namespace_mode ndctl_namespace_get_mode(
 		struct ndctl_namespace *ndns)
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 
 	if (snprintf(path, len, "%s/mode", ndns->ndns_path) >= len) {
@@ -4266,8 +5420,8 @@ NDCTL_EXPORT int ndctl_namespace_set_enforce_mode(struct ndctl_namespace *ndns,
 		enum ndctl_namespace_mode mode)
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	int rc;
 
 	if (mode < 0 || mode >= NDCTL_NS_MODE_UNKNOWN)
@@ -4301,8 +5455,8 @@ NDCTL_EXPORT int ndctl_namespace_set_raw_mode(struct ndctl_namespace *ndns,
 		int raw_mode)
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 
 	if (snprintf(path, len, "%s/force_raw", ndns->ndns_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -4322,8 +5476,8 @@ NDCTL_EXPORT int ndctl_namespace_set_raw_mode(struct ndctl_namespace *ndns,
 NDCTL_EXPORT int ndctl_namespace_is_enabled(struct ndctl_namespace *ndns)
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/driver", ndns->ndns_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -4376,9 +5530,80 @@ NDCTL_EXPORT struct badblock *ndctl_namespace_get_first_badblock(
 	return badblocks_iter_first(&ndns->bb_iter, ctx, path);
 }
 
-static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
+/*
+ * Binds and unbinds wait for their own device's uevent rather than for
+ * udev to go idle system-wide. A private monitor is armed before the
+ * sysfs write, and udev rebroadcasts the event only after the rules of
+ * the device, and of the children it registered while probing, ran.
+ * With no monitor, completion falls back to ndctl_bus_wait_probe().
+ */
+#define NDCTL_PROBE_EVENT_TIMEOUT_MS 5000
+
+static struct udev_monitor *ndctl_probe_monitor(struct ndctl_ctx *ctx)
+{
+	struct udev_monitor *mon;
+
+	/*
+	 * Without udevd, as in containers and the initramfs, no event
+	 * will ever arrive, take the synchronous path straight away.
+	 */
+	if (!ctx->udev_queue || !udev_queue_get_udev_is_active(ctx->udev_queue))
+		return NULL;
+	mon = udev_monitor_new_from_netlink(ctx->udev, "udev");
+	if (!mon)
+		return NULL;
+	if (udev_monitor_filter_add_match_subsystem_devtype(mon, "nd",
+				NULL) < 0
+			|| udev_monitor_enable_receiving(mon) < 0) {
+		udev_monitor_unref(mon);
+		return NULL;
+	}
+	return mon;
+}
+
+static bool ndctl_probe_event(struct ndctl_ctx *ctx, struct udev_monitor *mon,
+		const char *devname, const char *action)
+{
+	struct pollfd pfd = { .fd = udev_monitor_get_fd(mon), .events = POLLIN };
+	long left = ctx->timeout ? (long) ctx->timeout
+		: NDCTL_PROBE_EVENT_TIMEOUT_MS;
+	struct timespec start, now;
+	struct udev_device *dev;
+	bool found = false;
+	const char *name, *act;
+	int rc;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (!found && left > 0) {
+		rc = poll(&pfd, 1, left);
+		if (rc == 0 || (rc < 0 && errno != EINTR))
+			break;
+		while (!found && (dev = udev_monitor_receive_device(mon))) {
+			name = udev_device_get_sysname(dev);
+			act = udev_device_get_action(dev);
+			found = name && act && strcmp(name, devname) == 0
+				&& strcmp(act, action) == 0;
+			udev_device_unref(dev);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		left -= (now.tv_sec - start.tv_sec) * 1000
+			+ (now.tv_nsec - start.tv_nsec) / 1000000;
+		start = now;
+	}
+
+	if (!found) {
+		dbg(ctx, "%s: no %s uevent, falling back to udev settle\n",
+				devname, action);
+		__atomic_store_n(&ctx->probe_unsettled, 1, __ATOMIC_RELEASE);
+	}
+	return found;
+}
+
+static int ndctl_bind(struct ndctl_ctx *ctx, const char *modalias,
 		const char *devname)
 {
+	struct udev_monitor *mon;
+	struct kmod_module *module;
 	DIR *dir;
 	int rc = 0;
 	char path[200];
@@ -4390,10 +5615,12 @@ static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
 		return -EINVAL;
 	}
 
+	module = to_module(ctx, modalias);
 	if (module) {
 		rc = kmod_module_probe_insert_module(module,
 				KMOD_PROBE_APPLY_BLACKLIST, NULL, NULL, NULL,
 				NULL);
+		kmod_module_unref(module);
 		if (rc < 0) {
 			err(ctx, "%s: insert failure: %d\n", __func__, rc);
 			return rc;
@@ -4411,6 +5638,7 @@ static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
 		return -ENXIO;
 	}
 
+	mon = ndctl_probe_monitor(ctx);
 	while ((de = readdir(dir)) != NULL) {
 		char *drv_path;
 
@@ -4431,69 +5659,294 @@ static int ndctl_bind(struct ndctl_ctx *ctx, struct kmod_module *module,
 	closedir(dir);
 
 	if (rc) {
+		udev_monitor_unref(mon);
 		dbg(ctx, "%s: bind failed\n", devname);
 		return -ENXIO;
 	}
+	if (mon)
+		ndctl_probe_event(ctx, mon, devname, "bind");
+	else
+		__atomic_store_n(&ctx->probe_unsettled, 1, __ATOMIC_RELEASE);
+	udev_monitor_unref(mon);
 	return 0;
 }
 
 static int ndctl_unbind(struct ndctl_ctx *ctx, const char *devpath)
 {
 	const char *devname = devpath_to_devname(devpath);
+	struct udev_monitor *mon;
 	char path[200];
 	const int len = sizeof(path);
+	int rc;
 
 	if (snprintf(path, len, "%s/driver/unbind", devpath) >= len) {
 		err(ctx, "%s: buffer too small!\n", devname);
 		return -ENXIO;
 	}
 
-	return sysfs_write_attr(ctx, path, devname);
+	mon = ndctl_probe_monitor(ctx);
+	rc = sysfs_write_attr(ctx, path, devname);
+	if (rc == 0 && mon)
+		ndctl_probe_event(ctx, mon, devname, "unbind");
+	else if (rc == 0)
+		__atomic_store_n(&ctx->probe_unsettled, 1, __ATOMIC_RELEASE);
+	udev_monitor_unref(mon);
+	return rc;
 }
 
 static void *add_btt(void *parent, int id, const char *btt_base);
 static void *add_pfn(void *parent, int id, const char *pfn_base);
 static void *add_dax(void *parent, int id, const char *dax_base);
 
-static void btts_init(struct ndctl_region *region)
+static void __btts_init(struct ndctl_region *region)
 {
 	struct ndctl_bus *bus = ndctl_region_get_bus(region);
 	char btt_fmt[20];
 
-	if (region->btts_init)
-		return;
-	region->btts_init = 1;
-
 	sprintf(btt_fmt, "btt%d.", region->id);
 	device_parse(bus->ctx, bus, region->region_path, btt_fmt, region, add_btt);
 }
 
-static void pfns_init(struct ndctl_region *region)
+static void btts_init(struct ndctl_region *region)
+{
+	if (nd_init_begin(region->bus->ctx, &region->btts_init)) {
+		__btts_init(region);
+		nd_init_end(region->bus->ctx, &region->btts_init);
+	}
+}
+
+static void __pfns_init(struct ndctl_region *region)
 {
 	struct ndctl_bus *bus = ndctl_region_get_bus(region);
 	char pfn_fmt[20];
 
-	if (region->pfns_init)
-		return;
-	region->pfns_init = 1;
-
 	sprintf(pfn_fmt, "pfn%d.", region->id);
 	device_parse(bus->ctx, bus, region->region_path, pfn_fmt, region, add_pfn);
 }
 
-static void daxs_init(struct ndctl_region *region)
+static void pfns_init(struct ndctl_region *region)
+{
+	if (nd_init_begin(region->bus->ctx, &region->pfns_init)) {
+		__pfns_init(region);
+		nd_init_end(region->bus->ctx, &region->pfns_init);
+	}
+}
+
+static void __daxs_init(struct ndctl_region *region)
 {
 	struct ndctl_bus *bus = ndctl_region_get_bus(region);
 	char dax_fmt[20];
 
-	if (region->daxs_init)
-		return;
-	region->daxs_init = 1;
-
 	sprintf(dax_fmt, "dax%d.", region->id);
 	device_parse(bus->ctx, bus, region->region_path, dax_fmt, region, add_dax);
 }
 
+static void daxs_init(struct ndctl_region *region)
+{
+	if (nd_init_begin(region->bus->ctx, &region->daxs_init)) {
+		__daxs_init(region);
+		nd_init_end(region->bus->ctx, &region->daxs_init);
+	}
+}
+
+/*
+ * Uevent driven refresh. An object whose device went away, or whose
+ * cached attributes are out of date, moves to its parent's stale list,
+ * so pointers callers still hold stay valid until ndctl_region_cleanup()
+ * or the context is released. Anything added or changed is loaded
+ * afresh. Lists that have not been enumerated yet are left alone, they
+ * will be read in full, and current, on first use.
+ */
+static bool is_parent_path(const char *parent, const char *path)
+{
+	const char *sep = strrchr(path, '/');
+
+	return sep && (size_t) (sep - path) == strlen(parent)
+		&& strncmp(parent, path, sep - path) == 0;
+}
+
+#define uevent_move_stale(list, stale, obj, member, match) \
+do { \
+	list_for_each(list, obj, member) \
+		if (match) { \
+			list_del_from(list, &(obj)->member); \
+			list_add_tail(stale, &(obj)->member); \
+			break; \
+		} \
+} while (0)
+
+static int uevent_region_child(struct ndctl_region *region, const char *name,
+		const char *path, bool gone)
+{
+	struct ndctl_namespace *ndns;
+	struct ndctl_btt *btt;
+	struct ndctl_pfn *pfn;
+	struct ndctl_dax *dax;
+	int region_id, id;
+
+	if (sscanf(name, "namespace%d.%d", &region_id, &id) == 2) {
+		if (region->namespaces_init != ND_INIT_DONE)
+			return 0;
+		uevent_move_stale(&region->namespaces,
+				&region->stale_namespaces, ndns, list,
+				ndns->id == id);
+		if (!gone)
+			add_namespace(region, id, path);
+	} else if (sscanf(name, "btt%d.%d", &region_id, &id) == 2) {
+		if (region->btts_init != ND_INIT_DONE)
+			return 0;
+		uevent_move_stale(&region->btts, &region->stale_btts, btt,
+				list, btt->id == id);
+		if (!gone)
+			add_btt(region, id, path);
+	} else if (sscanf(name, "pfn%d.%d", &region_id, &id) == 2) {
+		if (region->pfns_init != ND_INIT_DONE)
+			return 0;
+		uevent_move_stale(&region->pfns, &region->stale_pfns, pfn,
+				list, pfn->id == id);
+		if (!gone)
+			add_pfn(region, id, path);
+	} else if (sscanf(name, "dax%d.%d", &region_id, &id) == 2) {
+		if (region->daxs_init != ND_INIT_DONE)
+			return 0;
+		uevent_move_stale(&region->daxs, &region->stale_daxs, dax,
+				pfn.list, dax->pfn.id == id);
+		if (!gone)
+			add_dax(region, id, path);
+	} else
+		return 0;
+	return 1;
+}
+
+static int uevent_bus_child(struct ndctl_bus *bus, const char *name,
+		const char *path, const char *action)
+{
+	struct ndctl_region *region;
+	int id;
+
+	if (bus->regions_init != ND_INIT_DONE)
+		return 0;
+
+	if (sscanf(name, "region%d", &id) == 1) {
+		/* a region's own attributes do not change while it exists */
+		if (strcmp(action, "add") != 0 && strcmp(action, "remove") != 0)
+			return 0;
+		uevent_move_stale(&bus->regions, &bus->stale_regions, region,
+				list, region->id == id);
+		if (strcmp(action, "add") == 0)
+			add_region(bus, id, path);
+		free(bus->addr_index);
+		bus->addr_index = NULL;
+		bus->nr_addr_index = 0;
+		bus->addr_index_init = ND_INIT_NONE;
+		return 1;
+	}
+
+	list_for_each(&bus->regions, region, list)
+		if (is_parent_path(region->region_path, path))
+			return uevent_region_child(region, name, path,
+					strcmp(action, "remove") == 0);
+	return 0;
+}
+
+static int uevent_apply(struct ndctl_ctx *ctx, struct udev_device *dev)
+{
+	const char *action = udev_device_get_action(dev);
+	const char *name = udev_device_get_sysname(dev);
+	const char *path = udev_device_get_syspath(dev);
+	struct ndctl_bus *bus;
+	int id;
+
+	if (!action || !name || !path)
+		return 0;
+	dbg(ctx, "%s: %s\n", name, action);
+
+	if (ctx->busses_init != ND_INIT_DONE)
+		return 0;
+	/* a new bus is picked up by rescanning, existing ones are kept */
+	if (sscanf(name, "ndbus%d", &id) == 1) {
+		if (strcmp(action, "add") != 0)
+			return 0;
+		ctx->busses_init = ND_INIT_NONE;
+		return 1;
+	}
+
+	list_for_each(&ctx->busses, bus, list)
+		if (strncmp(path, bus->bus_path, strlen(bus->bus_path)) == 0
+				&& path[strlen(bus->bus_path)] == '/') {
+			if (sscanf(name, "region%d", &id) == 1
+					&& !is_parent_path(bus->bus_path, path))
+				return 0;
+			return uevent_bus_child(bus, name, path, action);
+		}
+	return 0;
+}
+
+/**
+ * ndctl_watch - subscribe to nvdimm device events
+ * @ctx: ndctl library context
+ *
+ * Returns a file descriptor that polls readable whenever a bus, region,
+ * namespace, btt, pfn or dax device is added, removed or changes state.
+ * Call ndctl_refresh() to bring the enumerated objects up to date. The
+ * descriptor is owned by @ctx, repeated calls return the same one.
+ * Returns a negative error code if the subscription fails.
+ */
+NDCTL_EXPORT int ndctl_watch(struct ndctl_ctx *ctx)
+{
+	struct udev_monitor *mon = ctx->udev_monitor;
+	int rc;
+
+	if (mon)
+		return udev_monitor_get_fd(mon);
+
+	mon = udev_monitor_new_from_netlink(ctx->udev, "udev");
+	if (!mon)
+		return -ENOMEM;
+	rc = udev_monitor_filter_add_match_subsystem_devtype(mon, "nd", NULL);
+	if (rc == 0)
+		rc = udev_monitor_enable_receiving(mon);
+	if (rc < 0) {
+		err(ctx, "failed to monitor nvdimm events: %s\n",
+				strerror(-rc));
+		udev_monitor_unref(mon);
+		return rc;
+	}
+	ctx->udev_monitor = mon;
+	return udev_monitor_get_fd(mon);
+}
+
+/**
+ * ndctl_refresh - apply pending device events
+ * @ctx: ndctl library context subscribed with ndctl_watch()
+ *
+ * Updates only the objects the pending events name instead of
+ * rescanning the whole topology. Objects that are removed or replaced
+ * move to their parent's stale list and remain valid until
+ * ndctl_region_cleanup(). As with enable and disable, the caller must
+ * keep this away from other threads walking the same context.
+ *
+ * Returns the number of objects that were updated, or a negative error
+ * code if @ctx is not subscribed.
+ */
+NDCTL_EXPORT int ndctl_refresh(struct ndctl_ctx *ctx)
+{
+	struct udev_device *dev;
+	int count = 0;
+
+	if (!ctx->udev_monitor)
+		return -ENXIO;
+
+	pthread_mutex_lock(&ctx->init_lock);
+	while ((dev = udev_monitor_receive_device(ctx->udev_monitor))) {
+		count += uevent_apply(ctx, dev);
+		udev_device_unref(dev);
+	}
+	pthread_mutex_unlock(&ctx->init_lock);
+
+	return count;
+}
+
 static void region_refresh_children(struct ndctl_region *region)
 {
 	region->namespaces_init = 0;
@@ -4541,7 +5994,7 @@ NDCTL_EXPORT int ndctl_namespace_enable(struct ndctl_namespace *ndns)
 	if (size == 0)
 		return -ENXIO;
 
-	rc = ndctl_bind(ctx, ndns->module, devname);
+	rc = ndctl_bind(ctx, ndns->modalias, devname);
 
 	/*
 	 * Rescan now as successfully enabling a namespace device leads
@@ -4766,8 +6219,8 @@ NDCTL_EXPORT void ndctl_namespace_get_uuid(struct ndctl_namespace *ndns, uuid_t
 NDCTL_EXPORT int ndctl_namespace_set_uuid(struct ndctl_namespace *ndns, uuid_t uu)
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char uuid[40];
 
 	if (snprintf(path, len, "%s/uuid", ndns->ndns_path) >= len) {
@@ -4811,8 +6264,8 @@ NDCTL_EXPORT int ndctl_namespace_set_sector_size(struct ndctl_namespace *ndns,
 		unsigned int sector_size)
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char sector_str[40];
 	int i;
 
@@ -4853,8 +6306,8 @@ NDCTL_EXPORT int ndctl_namespace_set_alt_name(struct ndctl_namespace *ndns,
 		const char *alt_name)
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char *buf;
 
 	if (!ndns->alt_name)
@@ -4898,8 +6351,8 @@ static int namespace_set_size(struct ndctl_namespace *ndns,
 		unsigned long long size)
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
-	char *path = ndns->ndns_buf;
-	int len = ndns->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char buf[SYSFS_ATTR_SIZE];
 
 	if (snprintf(path, len, "%s/size", ndns->ndns_path) >= len) {
@@ -4976,9 +6429,9 @@ static int __ndctl_namespace_set_write_cache(struct ndctl_namespace *ndns,
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
 	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
-	char *path = ndns->ndns_buf;
+	char path[PATH_MAX];
 	char buf[SYSFS_ATTR_SIZE];
-	int len = ndns->buf_len;
+	int len = sizeof(path);
 	const char *bdev;
 
 	if (state != 1 && state != 0)
@@ -5018,8 +6471,8 @@ NDCTL_EXPORT int ndctl_namespace_write_cache_is_enabled(
 {
 	struct ndctl_ctx *ctx = ndctl_namespace_get_ctx(ndns);
 	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
-	int len = ndns->buf_len, wc;
-	char *path = ndns->ndns_buf;
+	char path[PATH_MAX];
+	int len = sizeof(path), wc;
 	char buf[SYSFS_ATTR_SIZE];
 	const char *bdev;
 
@@ -5136,17 +6589,21 @@ static int parse_lbasize_supported(struct ndctl_ctx *ctx, const char *devname,
 	return -ENXIO;
 }
 
+static const char * const btt_attrs[] = {
+	"modalias", "uuid", "sector_size", "size",
+};
+
 static void *add_btt(void *parent, int id, const char *btt_base)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(parent);
 	const char *devname = devpath_to_devname(btt_base);
-	char *path = calloc(1, strlen(btt_base) + 100);
 	struct ndctl_region *region = parent;
 	struct ndctl_btt *btt, *btt_dup;
 	char buf[SYSFS_ATTR_SIZE];
+	struct ndctl_sysfs_dir dir;
 
-	if (!path)
-		return NULL;
+	ndctl_sysfs_dir_init(&dir, ctx, btt_base);
+	ndctl_sysfs_dir_prefetch(&dir, btt_attrs, ARRAY_SIZE(btt_attrs));
 
 	btt = calloc(1, sizeof(*btt));
 	if (!btt)
@@ -5159,35 +6616,28 @@ static void *add_btt(void *parent, int id, const char *btt_base)
 	if (!btt->btt_path)
 		goto err_read;
 
-	btt->btt_buf = calloc(1, strlen(btt_base) + 50);
-	if (!btt->btt_buf)
+	if (ndctl_sysfs_dir_read(&dir, "modalias", buf) < 0)
 		goto err_read;
-	btt->buf_len = strlen(btt_base) + 50;
-
-	sprintf(path, "%s/modalias", btt_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	btt->modalias = strdup(buf);
+	if (!btt->modalias)
 		goto err_read;
-	btt->module = to_module(ctx, buf);
 
-	sprintf(path, "%s/uuid", btt_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "uuid", buf) < 0)
 		goto err_read;
 	if (strlen(buf) && uuid_parse(buf, btt->uuid) < 0)
 		goto err_read;
 
-	sprintf(path, "%s/sector_size", btt_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "sector_size", buf) < 0)
 		goto err_read;
 	if (parse_lbasize_supported(ctx, devname, buf, &btt->lbasize) < 0)
 		goto err_read;
 
-	sprintf(path, "%s/size", btt_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "size", buf) < 0)
 		btt->size = ULLONG_MAX;
 	else
 		btt->size = strtoull(buf, NULL, 0);
 
-	free(path);
+	ndctl_sysfs_dir_close(&dir);
 	ndctl_btt_foreach(region, btt_dup)
 		if (btt->id == btt_dup->id) {
 			btt_dup->size = btt->size;
@@ -5200,11 +6650,11 @@ static void *add_btt(void *parent, int id, const char *btt_base)
 
  err_read:
 	free(btt->lbasize.supported);
-	free(btt->btt_buf);
 	free(btt->btt_path);
+	free(btt->modalias);
 	free(btt);
  err_btt:
-	free(path);
+	ndctl_sysfs_dir_close(&dir);
 	return NULL;
 }
 
@@ -5252,8 +6702,8 @@ NDCTL_EXPORT struct ndctl_namespace *ndctl_btt_get_namespace(struct ndctl_btt *b
 	struct ndctl_ctx *ctx = ndctl_btt_get_ctx(btt);
 	struct ndctl_namespace *ndns, *found = NULL;
 	struct ndctl_region *region = btt->region;
-	char *path = region->region_buf;
-	int len = region->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 
 	if (btt->ndns)
@@ -5288,8 +6738,8 @@ NDCTL_EXPORT unsigned long long ndctl_btt_get_size(struct ndctl_btt *btt)
 NDCTL_EXPORT int ndctl_btt_set_uuid(struct ndctl_btt *btt, uuid_t uu)
 {
 	struct ndctl_ctx *ctx = ndctl_btt_get_ctx(btt);
-	char *path = btt->btt_buf;
-	int len = btt->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char uuid[40];
 
 	if (snprintf(path, len, "%s/uuid", btt->btt_path) >= len) {
@@ -5310,8 +6760,8 @@ NDCTL_EXPORT int ndctl_btt_set_sector_size(struct ndctl_btt *btt,
 		unsigned int sector_size)
 {
 	struct ndctl_ctx *ctx = ndctl_btt_get_ctx(btt);
-	char *path = btt->btt_buf;
-	int len = btt->buf_len, rc;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char sector_str[40];
 	int i;
 
@@ -5336,8 +6786,8 @@ NDCTL_EXPORT int ndctl_btt_set_namespace(struct ndctl_btt *btt,
 		struct ndctl_namespace *ndns)
 {
 	struct ndctl_ctx *ctx = ndctl_btt_get_ctx(btt);
-	int len = btt->buf_len, rc;
-	char *path = btt->btt_buf;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 
 	if (snprintf(path, len, "%s/namespace", btt->btt_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -5373,8 +6823,8 @@ NDCTL_EXPORT const char *ndctl_btt_get_block_device(struct ndctl_btt *btt)
 {
 	struct ndctl_ctx *ctx = ndctl_btt_get_ctx(btt);
 	struct ndctl_bus *bus = ndctl_btt_get_bus(btt);
-	char *path = btt->btt_buf;
-	int len = btt->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (btt->bdev)
 		return btt->bdev;
@@ -5400,8 +6850,8 @@ NDCTL_EXPORT int ndctl_btt_is_valid(struct ndctl_btt *btt)
 NDCTL_EXPORT int ndctl_btt_is_enabled(struct ndctl_btt *btt)
 {
 	struct ndctl_ctx *ctx = ndctl_btt_get_ctx(btt);
-	char *path = btt->btt_buf;
-	int len = btt->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/driver", btt->btt_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -5422,13 +6872,13 @@ NDCTL_EXPORT int ndctl_btt_enable(struct ndctl_btt *btt)
 	struct ndctl_region *region = ndctl_btt_get_region(btt);
 	const char *devname = ndctl_btt_get_devname(btt);
 	struct ndctl_ctx *ctx = ndctl_btt_get_ctx(btt);
-	char *path = btt->btt_buf;
-	int len = btt->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (ndctl_btt_is_enabled(btt))
 		return 0;
 
-	ndctl_bind(ctx, btt->module, devname);
+	ndctl_bind(ctx, btt->modalias, devname);
 
 	if (!ndctl_btt_is_enabled(btt)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -5494,15 +6944,20 @@ NDCTL_EXPORT int ndctl_btt_is_configured(struct ndctl_btt *btt)
 	return 0;
 }
 
+static const char * const pfn_attrs[] = {
+	"modalias", "uuid", "mode", "align", "resource", "size",
+	"supported_alignments",
+};
+
 static void *__add_pfn(struct ndctl_pfn *pfn, const char *pfn_base)
 {
 	struct ndctl_ctx *ctx = ndctl_region_get_ctx(pfn->region);
-	char *path = calloc(1, strlen(pfn_base) + 100);
 	struct ndctl_region *region = pfn->region;
 	char buf[SYSFS_ATTR_SIZE];
+	struct ndctl_sysfs_dir dir;
 
-	if (!path)
-		return NULL;
+	ndctl_sysfs_dir_init(&dir, ctx, pfn_base);
+	ndctl_sysfs_dir_prefetch(&dir, pfn_attrs, ARRAY_SIZE(pfn_attrs));
 
 	pfn->generation = region->generation;
 
@@ -5510,24 +6965,18 @@ static void *__add_pfn(struct ndctl_pfn *pfn, const char *pfn_base)
 	if (!pfn->pfn_path)
 		goto err_read;
 
-	pfn->pfn_buf = calloc(1, strlen(pfn_base) + 50);
-	if (!pfn->pfn_buf)
+	if (ndctl_sysfs_dir_read(&dir, "modalias", buf) < 0)
 		goto err_read;
-	pfn->buf_len = strlen(pfn_base) + 50;
-
-	sprintf(path, "%s/modalias", pfn_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	pfn->modalias = strdup(buf);
+	if (!pfn->modalias)
 		goto err_read;
-	pfn->module = to_module(ctx, buf);
 
-	sprintf(path, "%s/uuid", pfn_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "uuid", buf) < 0)
 		goto err_read;
 	if (strlen(buf) && uuid_parse(buf, pfn->uuid) < 0)
 		goto err_read;
 
-	sprintf(path, "%s/mode", pfn_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "mode", buf) < 0)
 		goto err_read;
 	if (strcmp(buf, "none") == 0)
 		pfn->loc = NDCTL_PFN_LOC_NONE;
@@ -5538,20 +6987,17 @@ static void *__add_pfn(struct ndctl_pfn *pfn, const char *pfn_base)
 	else
 		goto err_read;
 
-	sprintf(path, "%s/align", pfn_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "align", buf) < 0)
 		pfn->align = 0;
 	else
 		pfn->align = strtoul(buf, NULL, 0);
 
-	sprintf(path, "%s/resource", pfn_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "resource", buf) < 0)
 		pfn->resource = ULLONG_MAX;
 	else
 		pfn->resource = strtoull(buf, NULL, 0);
 
-	sprintf(path, "%s/size", pfn_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "size", buf) < 0)
 		pfn->size = ULLONG_MAX;
 	else
 		pfn->size = strtoull(buf, NULL, 0);
@@ -5562,20 +7008,19 @@ static void *__add_pfn(struct ndctl_pfn *pfn, const char *pfn_base)
 	 * attribute then it's safe to assume that we running on x86 where
 	 * 4KiB and 2MiB have always been supported.
 	 */
-	sprintf(path, "%s/supported_alignments", pfn_base);
-	if (sysfs_read_attr(ctx, path, buf) < 0)
+	if (ndctl_sysfs_dir_read(&dir, "supported_alignments", buf) < 0)
 		sprintf(buf, "%d %d", SZ_4K, SZ_2M);
 
 	if (parse_lbasize_supported(ctx, pfn_base, buf, &pfn->alignments) < 0)
 		goto err_read;
 
-	free(path);
+	ndctl_sysfs_dir_close(&dir);
 	return pfn;
 
  err_read:
-	free(pfn->pfn_buf);
 	free(pfn->pfn_path);
-	free(path);
+	free(pfn->modalias);
+	ndctl_sysfs_dir_close(&dir);
 	return NULL;
 }
 
@@ -5663,8 +7108,8 @@ NDCTL_EXPORT struct ndctl_namespace *ndctl_pfn_get_namespace(struct ndctl_pfn *p
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
 	struct ndctl_namespace *ndns, *found = NULL;
 	struct ndctl_region *region = pfn->region;
-	char *path = region->region_buf;
-	int len = region->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	char buf[SYSFS_ATTR_SIZE];
 
 	if (pfn->ndns)
@@ -5704,8 +7149,8 @@ NDCTL_EXPORT unsigned long long ndctl_pfn_get_resource(struct ndctl_pfn *pfn)
 NDCTL_EXPORT int ndctl_pfn_set_uuid(struct ndctl_pfn *pfn, uuid_t uu)
 {
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
-	int len = pfn->buf_len, rc;
-	char *path = pfn->pfn_buf;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char uuid[40];
 
 	if (snprintf(path, len, "%s/uuid", pfn->pfn_path) >= len) {
@@ -5731,8 +7176,8 @@ NDCTL_EXPORT int ndctl_pfn_set_location(struct ndctl_pfn *pfn,
 		enum ndctl_pfn_loc loc)
 {
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
-	int len = pfn->buf_len, rc;
-	char *path = pfn->pfn_buf;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	const char *locations[] = {
 		[NDCTL_PFN_LOC_NONE] = "none",
 		[NDCTL_PFN_LOC_RAM] = "ram",
@@ -5769,8 +7214,8 @@ NDCTL_EXPORT unsigned long ndctl_pfn_get_align(struct ndctl_pfn *pfn)
 NDCTL_EXPORT int ndctl_pfn_has_align(struct ndctl_pfn *pfn)
 {
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
-	char *path = pfn->pfn_buf;
-	int len = pfn->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 	struct stat st;
 
 	if (snprintf(path, len, "%s/align", pfn->pfn_path) >= len) {
@@ -5785,8 +7230,8 @@ NDCTL_EXPORT int ndctl_pfn_has_align(struct ndctl_pfn *pfn)
 NDCTL_EXPORT int ndctl_pfn_set_align(struct ndctl_pfn *pfn, unsigned long align)
 {
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
-	int len = pfn->buf_len, rc;
-	char *path = pfn->pfn_buf;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 	char align_str[40];
 
 	if (snprintf(path, len, "%s/align", pfn->pfn_path) >= len) {
@@ -5824,8 +7269,8 @@ NDCTL_EXPORT int ndctl_pfn_set_namespace(struct ndctl_pfn *pfn,
 		struct ndctl_namespace *ndns)
 {
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
-	int len = pfn->buf_len, rc;
-	char *path = pfn->pfn_buf;
+	char path[PATH_MAX];
+	int len = sizeof(path), rc;
 
 	if (snprintf(path, len, "%s/namespace", pfn->pfn_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -5861,8 +7306,8 @@ NDCTL_EXPORT const char *ndctl_pfn_get_block_device(struct ndctl_pfn *pfn)
 {
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
 	struct ndctl_bus *bus = ndctl_pfn_get_bus(pfn);
-	char *path = pfn->pfn_buf;
-	int len = pfn->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (pfn->bdev)
 		return pfn->bdev;
@@ -5888,8 +7333,8 @@ NDCTL_EXPORT int ndctl_pfn_is_valid(struct ndctl_pfn *pfn)
 NDCTL_EXPORT int ndctl_pfn_is_enabled(struct ndctl_pfn *pfn)
 {
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
-	char *path = pfn->pfn_buf;
-	int len = pfn->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (snprintf(path, len, "%s/driver", pfn->pfn_path) >= len) {
 		err(ctx, "%s: buffer too small!\n",
@@ -5910,13 +7355,13 @@ NDCTL_EXPORT int ndctl_pfn_enable(struct ndctl_pfn *pfn)
 	struct ndctl_region *region = ndctl_pfn_get_region(pfn);
 	const char *devname = ndctl_pfn_get_devname(pfn);
 	struct ndctl_ctx *ctx = ndctl_pfn_get_ctx(pfn);
-	char *path = pfn->pfn_buf;
-	int len = pfn->buf_len;
+	char path[PATH_MAX];
+	int len = sizeof(path);
 
 	if (ndctl_pfn_is_enabled(pfn))
 		return 0;
 
-	ndctl_bind(ctx, pfn->module, devname);
+	ndctl_bind(ctx, pfn->modalias, devname);
 
 	if (!ndctl_pfn_is_enabled(pfn)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -6109,7 +7554,7 @@ NDCTL_EXPORT int ndctl_dax_enable(struct ndctl_dax *dax)
 	if (ndctl_dax_is_enabled(dax))
 		return 0;
 
-	ndctl_bind(ctx, pfn->module, devname);
+	ndctl_bind(ctx, pfn->modalias, devname);
 
 	if (!ndctl_dax_is_enabled(dax)) {
 		err(ctx, "%s: failed to enable\n", devname);
@@ -6164,6 +7609,7 @@ NDCTL_EXPORT struct daxctl_region *ndctl_dax_get_daxctl_region(
 		struct ndctl_dax *dax)
 {
 	struct ndctl_ctx *ctx = ndctl_dax_get_ctx(dax);
+	struct daxctl_ctx *daxctl_ctx;
 	struct ndctl_region *region;
 	uuid_t uuid;
 	int id;
@@ -6174,7 +7620,10 @@ NDCTL_EXPORT struct daxctl_region *ndctl_dax_get_daxctl_region(
 
 	id = ndctl_region_get_id(region);
 	ndctl_dax_get_uuid(dax, uuid);
-	dax->region = daxctl_new_region(ctx->daxctl_ctx, id, uuid,
+	daxctl_ctx = ndctl_get_daxctl_ctx(ctx);
+	if (!daxctl_ctx)
+		return NULL;
+	dax->region = daxctl_new_region(daxctl_ctx, id, uuid,
 			dax->pfn.pfn_path);
 
 	return dax->region;
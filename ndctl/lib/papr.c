@@ -9,6 +9,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <util/sysfs.h>
+#include <ccan/array_size/array_size.h>
 #include <util/log.h>
 #include <ndctl.h>
 #include <ndctl/libndctl.h>
@@ -107,6 +111,7 @@ static struct ndctl_cmd *allocate_cmd(struct ndctl_dimm *dimm,
 
 	ndctl_cmd_ref(cmd);
 	cmd->dimm = dimm;
+	cmd->size = sizeof(struct ndctl_cmd) + sizeof(struct nd_pkg_papr);
 	cmd->type = ND_CMD_CALL;
 	cmd->status = 0;
 	cmd->get_firmware_status = &papr_get_firmware_status;
@@ -236,6 +241,79 @@ static unsigned int papr_smart_get_life_used(struct ndctl_cmd *cmd)
 		(100 - health.dimm_fuel_gauge) : 0;
 }
 
+/*
+ * papr_scm reports the hypervisor's performance statistics for the
+ * dimm in its "papr/perf_stats" attribute, one "<stat-id> = 0x<value>"
+ * line per counter. Only readable by root, and absent when the
+ * hypervisor doesn't provide them.
+ */
+static const struct {
+	const char *id;
+	enum ndctl_perf_stat stat;
+} papr_perf_ids[] = {
+	{ "CtlResCt", NDCTL_PERF_CTL_RESET_COUNT },
+	{ "CtlResTm", NDCTL_PERF_CTL_RESET_TIME },
+	{ "PonSecs", NDCTL_PERF_POWER_ON_SECS },
+	{ "MemLife", NDCTL_PERF_LIFE_REMAINING },
+	{ "CritRscU", NDCTL_PERF_CRIT_RESOURCE_UTIL },
+	{ "HostLCnt", NDCTL_PERF_HOST_LOAD_COUNT },
+	{ "HostSCnt", NDCTL_PERF_HOST_STORE_COUNT },
+	{ "HostLDur", NDCTL_PERF_HOST_LOAD_DURATION },
+	{ "HostSDur", NDCTL_PERF_HOST_STORE_DURATION },
+	{ "MedRCnt", NDCTL_PERF_MEDIA_READ_COUNT },
+	{ "MedWCnt", NDCTL_PERF_MEDIA_WRITE_COUNT },
+	{ "MedRDur", NDCTL_PERF_MEDIA_READ_DURATION },
+	{ "MedWDur", NDCTL_PERF_MEDIA_WRITE_DURATION },
+	{ "CchRHCnt", NDCTL_PERF_CACHE_READ_HIT_COUNT },
+	{ "CchWHCnt", NDCTL_PERF_CACHE_WRITE_HIT_COUNT },
+	{ "FastWCnt", NDCTL_PERF_FAST_WRITE_COUNT },
+};
+
+static int papr_get_perf_stats(struct ndctl_dimm *dimm,
+		unsigned long long *stats, unsigned int nr,
+		unsigned long long *valid)
+{
+	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
+	char path[PATH_MAX], buf[SYSFS_ATTR_SIZE];
+	char *line, *eq, *save;
+	unsigned int i;
+	size_t len;
+	int rc;
+
+	if (snprintf(path, sizeof(path), "%s/papr/perf_stats",
+				dimm->dimm_path) >= (int) sizeof(path))
+		return -ENOMEM;
+	rc = sysfs_read_attr(ctx, path, buf);
+	if (rc < 0) {
+		papr_dbg(dimm, "perf_stats not available: %s\n",
+				strerror(-rc));
+		return rc;
+	}
+
+	for (line = strtok_r(buf, "\n", &save); line;
+			line = strtok_r(NULL, "\n", &save)) {
+		eq = strchr(line, '=');
+		if (!eq)
+			continue;
+		/* ids shorter than 8 characters are padded with spaces */
+		for (len = eq - line; len && line[len - 1] == ' '; len--)
+			;
+		for (i = 0; i < ARRAY_SIZE(papr_perf_ids); i++) {
+			if (strlen(papr_perf_ids[i].id) != len
+					|| strncmp(line, papr_perf_ids[i].id,
+						len) != 0)
+				continue;
+			if (papr_perf_ids[i].stat >= nr)
+				break;
+			stats[papr_perf_ids[i].stat] =
+				strtoull(eq + 1, NULL, 0);
+			*valid |= 1ULL << papr_perf_ids[i].stat;
+			break;
+		}
+	}
+	return 0;
+}
+
 struct ndctl_dimm_ops * const papr_dimm_ops = &(struct ndctl_dimm_ops) {
 	.cmd_is_supported = papr_cmd_is_supported,
 	.smart_get_flags = papr_smart_get_flags,
@@ -245,4 +323,5 @@ struct ndctl_dimm_ops * const papr_dimm_ops = &(struct ndctl_dimm_ops) {
 	.smart_get_health = papr_smart_get_health,
 	.smart_get_shutdown_state = papr_smart_get_shutdown_state,
 	.smart_get_life_used = papr_smart_get_life_used,
+	.get_perf_stats = papr_get_perf_stats,
 };
@@ -0,0 +1,236 @@
+// SPDX-License-Identifier: LGPL-2.1
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <ndctl/libndctl.h>
+#include "private.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/*
+ * Write-back helpers for applications that store to a DAX mapping of
+ * a region directly. Which one is right depends on the region's
+ * persistence domain, whether a store is durable once it leaves the
+ * cpu cache (memory controller, ADR) or already once it is globally
+ * visible (cpu cache, eADR), and on what the cpu offers.
+ */
+#define CACHELINE 64
+
+static void flush_none(const void *addr, size_t len)
+{
+}
+
+static void drain_none(void)
+{
+}
+
+#if defined(__x86_64__)
+static bool x86_feature7(unsigned int bit)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	return !!(ebx & (1U << bit));
+}
+
+static bool clwb_supported(void)
+{
+	return x86_feature7(24);
+}
+
+static bool clflushopt_supported(void)
+{
+	return x86_feature7(23);
+}
+
+static bool clflush_supported(void)
+{
+	/* part of the x86-64 baseline */
+	return true;
+}
+
+/*
+ * Spelled out with prefixes, as the kernel does, so the library does
+ * not need to be built for a cpu that has the instructions
+ */
+static void flush_clwb(const void *addr, size_t len)
+{
+	const char *p = (const char *) ((unsigned long) addr
+			& ~(CACHELINE - 1UL));
+	const char *end = (const char *) addr + len;
+
+	for (; p < end; p += CACHELINE)
+		asm volatile(".byte 0x66; xsaveopt %0"
+				: "+m" (*(volatile char *) p));
+}
+
+static void flush_clflushopt(const void *addr, size_t len)
+{
+	const char *p = (const char *) ((unsigned long) addr
+			& ~(CACHELINE - 1UL));
+	const char *end = (const char *) addr + len;
+
+	for (; p < end; p += CACHELINE)
+		asm volatile(".byte 0x66; clflush %0"
+				: "+m" (*(volatile char *) p));
+}
+
+static void flush_clflush(const void *addr, size_t len)
+{
+	const char *p = (const char *) ((unsigned long) addr
+			& ~(CACHELINE - 1UL));
+	const char *end = (const char *) addr + len;
+
+	for (; p < end; p += CACHELINE)
+		asm volatile("clflush %0" : "+m" (*(volatile char *) p));
+}
+
+static void drain_sfence(void)
+{
+	asm volatile("sfence" : : : "memory");
+}
+
+static const struct ndctl_persist_fns persist_flush[] = {
+	{ "clwb", flush_clwb, drain_sfence },
+	{ "clflushopt", flush_clflushopt, drain_sfence },
+	/* clflush is ordered against other stores already */
+	{ "clflush", flush_clflush, drain_none },
+};
+
+static bool (*const persist_supported[])(void) = {
+	clwb_supported,
+	clflushopt_supported,
+	clflush_supported,
+};
+
+/* non-temporal stores still have to be fenced on eADR */
+static const struct ndctl_persist_fns persist_cpu_cache = {
+	"none", flush_none, drain_sfence,
+};
+#elif defined(__aarch64__)
+#ifndef HWCAP_DCPOP
+#define HWCAP_DCPOP (1 << 16)
+#endif
+
+static bool dcpop_supported(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_DCPOP);
+}
+
+static bool dccvac_supported(void)
+{
+	return true;
+}
+
+static unsigned long dcache_line(void)
+{
+	unsigned long ctr;
+
+	asm volatile("mrs %0, ctr_el0" : "=r" (ctr));
+	return 4UL << ((ctr >> 16) & 0xf);
+}
+
+static void flush_dcpop(const void *addr, size_t len)
+{
+	unsigned long line = dcache_line();
+	const char *p, *end = (const char *) addr + len;
+
+	for (p = (const char *) ((unsigned long) addr & ~(line - 1));
+			p < end; p += line)
+		/* dc cvap, not every assembler knows the mnemonic */
+		asm volatile("sys #3, c7, c12, #1, %0" : : "r" (p)
+				: "memory");
+}
+
+static void flush_dccvac(const void *addr, size_t len)
+{
+	unsigned long line = dcache_line();
+	const char *p, *end = (const char *) addr + len;
+
+	for (p = (const char *) ((unsigned long) addr & ~(line - 1));
+			p < end; p += line)
+		asm volatile("dc cvac, %0" : : "r" (p) : "memory");
+}
+
+static void drain_dsb(void)
+{
+	asm volatile("dsb sy" : : : "memory");
+}
+
+static const struct ndctl_persist_fns persist_flush[] = {
+	{ "dc-cvap", flush_dcpop, drain_dsb },
+	{ "dc-cvac", flush_dccvac, drain_dsb },
+};
+
+static bool (*const persist_supported[])(void) = {
+	dcpop_supported,
+	dccvac_supported,
+};
+
+static const struct ndctl_persist_fns persist_cpu_cache = {
+	"none", flush_none, drain_dsb,
+};
+#else
+static void drain_sync(void)
+{
+	__sync_synchronize();
+}
+
+static const struct ndctl_persist_fns persist_flush[] = {};
+static bool (*const persist_supported[])(void) = {};
+
+static const struct ndctl_persist_fns persist_cpu_cache = {
+	"none", flush_none, drain_sync,
+};
+#endif
+
+/**
+ * ndctl_persist_fns_for_region() - pick the write-back helpers for @region
+ * @region: region that backs the application's mapping
+ *
+ * A region whose persistence domain is the cpu cache gets a flush()
+ * that does nothing, otherwise the fastest cache write-back the cpu
+ * supports is used, and an unknown domain is treated as the memory
+ * controller one. Call flush() on every range stored to, then drain()
+ * once before relying on the data being durable. Returns NULL with
+ * errno set to EOPNOTSUPP when @region has no persistence domain, or
+ * the architecture has no user space write-back.
+ */
+NDCTL_EXPORT const struct ndctl_persist_fns *ndctl_persist_fns_for_region(
+		struct ndctl_region *region)
+{
+	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
+	const struct ndctl_persist_fns *fns = NULL;
+	size_t i;
+
+	switch (ndctl_region_get_persistence_domain(region)) {
+	case PERSISTENCE_NONE:
+		break;
+	case PERSISTENCE_CPU_CACHE:
+		fns = &persist_cpu_cache;
+		break;
+	default:
+		for (i = 0; i < ARRAY_SIZE(persist_flush); i++)
+			if (persist_supported[i]()) {
+				fns = &persist_flush[i];
+				break;
+			}
+		break;
+	}
+
+	if (!fns) {
+		dbg(ctx, "%s: no user space persistence\n",
+				ndctl_region_get_devname(region));
+		errno = EOPNOTSUPP;
+		return NULL;
+	}
+	dbg(ctx, "%s: persist with %s\n", ndctl_region_get_devname(region),
+			fns->name);
+	return fns;
+}
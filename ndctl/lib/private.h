@@ -4,12 +4,15 @@
 #define _LIBNDCTL_PRIVATE_H_
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <syslog.h>
 #include <string.h>
 #include <libudev.h>
 #include <libkmod.h>
 #include <util/log.h>
+#include <util/arena.h>
+#include <util/sysfs.h>
 #include <uuid/uuid.h>
 #include <ccan/list/list.h>
 #include <ccan/array_size/array_size.h>
@@ -35,7 +38,7 @@ struct nvdimm_data {
 
 /**
  * struct ndctl_dimm - memory device as identified by NFIT
- * @module: kernel module (libnvdimm)
+ * @modalias: kernel module alias (libnvdimm), resolved at enable time
  * @handle: NFIT-handle value
  * @major: /dev/nmemX major character device number
  * @minor: /dev/nmemX minor character device number
@@ -52,7 +55,7 @@ struct nvdimm_data {
  * @format: array of format interface code numbers
  */
 struct ndctl_dimm {
-	struct kmod_module *module;
+	char *modalias;
 	struct ndctl_bus *bus;
 	struct ndctl_dimm_ops *ops;
 	struct nvdimm_data ndd;
@@ -74,9 +77,8 @@ struct ndctl_dimm {
 	enum ndctl_fwa_result fwa_result;
 	char *unique_id;
 	char *dimm_path;
-	char *dimm_buf;
 	int health_eventfd;
-	int buf_len;
+	struct ndctl_smart_cache *smart_cache;
 	int id;
 	union dimm_flags {
 		unsigned long flags;
@@ -128,14 +130,86 @@ struct ndctl_ctx {
 	int refcount;
 	int regions_init;
 	void *userdata;
+	pthread_mutex_t init_lock;
+	pthread_mutex_t kmod_lock;
+	unsigned int enumerate_threads;
+	unsigned int max_threads;
+	pthread_mutex_t smart_lock;
+	unsigned int smart_ttl_ms;
 	struct list_head busses;
 	int busses_init;
 	struct udev *udev;
 	struct udev_queue *udev_queue;
+	struct udev_monitor *udev_monitor;
+	/* a state change was not confirmed by its uevent, see ndctl_bind() */
+	int probe_unsettled;
 	struct kmod_ctx *kmod_ctx;
+	int kmod_failed;
+	/* created on first use, see ndctl_get_daxctl_ctx() */
 	struct daxctl_ctx *daxctl_ctx;
+	int daxctl_log_priority;
 	unsigned long timeout;
 	void *private_data;
+	char *snapshot_path;
+	struct ndctl_snapshot *snapshot;
+	/* replaces /sys for enumeration, see ndctl_set_sysfs_root() */
+	char *sysfs_root;
+	/* dimms, regions and mappings, see arena_zalloc() callers */
+	struct arena arena;
+};
+
+/*
+ * Route the library's sysfs accesses through the topology snapshot,
+ * see snapshot.c. Outside of list building they go straight to sysfs.
+ */
+void ndctl_snapshot_enter(void);
+void ndctl_snapshot_leave(void);
+void ndctl_snapshot_release(struct ndctl_ctx *ctx);
+int ndctl_snapshot_read_attr(struct ndctl_ctx *ctx, const char *path,
+		char *buf);
+int ndctl_snapshot_write_attr(struct ndctl_ctx *ctx, const char *path,
+		const char *buf, bool quiet);
+int ndctl_snapshot_device_parse(struct ndctl_ctx *ctx, const char *base_path,
+		const char *dev_name, void *parent, add_dev_fn add_dev);
+char *ndctl_snapshot_realpath(struct ndctl_ctx *ctx, const char *path);
+
+/*
+ * A device directory that its attributes are read relative to, so that
+ * loading an object resolves the directory once rather than once per
+ * attribute. Reads still go through the snapshot first. A loader that
+ * knows up front which attributes it wants can prefetch them in one
+ * batch, and its reads are then served from that.
+ */
+struct ndctl_sysfs_dir {
+	struct ndctl_ctx *ctx;
+	const char *base;
+	int fd;
+	int err;
+	struct sysfs_attr_req *prefetch;
+	int nr_prefetch;
+};
+
+void ndctl_sysfs_dir_init(struct ndctl_sysfs_dir *dir, struct ndctl_ctx *ctx,
+		const char *base);
+void ndctl_sysfs_dir_prefetch(struct ndctl_sysfs_dir *dir,
+		const char * const *attrs, int nr);
+int ndctl_sysfs_dir_read(struct ndctl_sysfs_dir *dir, const char *attr,
+		char *buf);
+void ndctl_sysfs_dir_close(struct ndctl_sysfs_dir *dir);
+
+#undef sysfs_read_attr
+#undef sysfs_write_attr
+#undef sysfs_write_attr_quiet
+#define sysfs_read_attr(c, p, b) ndctl_snapshot_read_attr((c), (p), (b))
+#define sysfs_write_attr(c, p, b) \
+	ndctl_snapshot_write_attr((c), (p), (b), false)
+#define sysfs_write_attr_quiet(c, p, b) \
+	ndctl_snapshot_write_attr((c), (p), (b), true)
+
+/* one entry of a bus's physical address index, sorted by @start */
+struct ndctl_addr_range {
+	unsigned long long start, end;
+	struct ndctl_region *region;
 };
 
 /**
@@ -156,20 +230,24 @@ struct ndctl_bus {
 	char *provider;
 	struct list_head dimms;
 	struct list_head regions;
+	struct list_head stale_regions;
 	struct list_node list;
 	int dimms_init;
 	int regions_init;
+	struct ndctl_addr_range *addr_index;
+	unsigned int nr_addr_index;
+	int addr_index_init;
 	int has_nfit;
 	int has_of_node;
 	char *bus_path;
-	char *bus_buf;
-	size_t buf_len;
 	char *wait_probe_path;
 	char *scrub_path;
 	unsigned long cmd_mask;
 	unsigned long nfit_dsm_mask;
 	enum ndctl_fwa_state fwa_state;
 	enum ndctl_fwa_method fwa_method;
+	int persistent_fd;
+	int fd;
 };
 
 /**
@@ -191,7 +269,7 @@ struct badblocks_iter {
 
 /**
  * struct ndctl_namespace - device claimed by the nd_blk or nd_pmem driver
- * @module: kernel module
+ * @modalias: kernel module alias, resolved at enable time
  * @type: integer nd-bus device-type
  * @type_name: 'namespace_io', 'namespace_pmem', or 'namespace_block'
  * @namespace_path: devpath for namespace device
@@ -204,13 +282,12 @@ struct badblocks_iter {
  * label-parsing is resolved.
  */
 struct ndctl_namespace {
-	struct kmod_module *module;
+	char *modalias;
 	struct ndctl_region *region;
 	struct list_node list;
 	char *ndns_path;
-	char *ndns_buf;
 	char *bdev;
-	int type, id, buf_len, raw_mode;
+	int type, id, raw_mode;
 	int generation;
 	unsigned long long resource, size;
 	enum ndctl_namespace_mode enforce_mode;
@@ -222,6 +299,18 @@ struct ndctl_namespace {
 	struct list_head injected_bb;
 };
 
+/* how a command interacts with its dimm's cached smart payload, smart.c */
+enum ndctl_smart_cache_op {
+	ND_SMART_CACHE_NONE,
+	ND_SMART_CACHE_FILL,	/* smart read: served from or stored in cache */
+	ND_SMART_CACHE_REFRESH,	/* smart read that bypasses the cache */
+	ND_SMART_CACHE_DROP,	/* changes smart state: invalidate */
+};
+
+struct ndctl_cmd;
+bool ndctl_smart_cache_get(struct ndctl_cmd *cmd, int *rc);
+void ndctl_smart_cache_update(struct ndctl_cmd *cmd, int rc);
+
 /**
  * struct ndctl_cmd - device-specific-method (_DSM ioctl) container
  * @dimm: set if the command is relative to a dimm, NULL otherwise
@@ -261,6 +350,7 @@ struct ndctl_cmd {
 		int dir;
 	} iter;
 	struct ndctl_cmd *source;
+	enum ndctl_smart_cache_op smart_cache;
 	union {
 		struct nd_cmd_ars_cap ars_cap[0];
 		struct nd_cmd_ars_start ars_start[0];
@@ -343,6 +433,8 @@ struct ndctl_dimm_ops {
 	int (*fw_update_supported)(struct ndctl_dimm *);
 	int (*xlat_firmware_status)(struct ndctl_cmd *);
 	u32 (*get_firmware_status)(struct ndctl_cmd *);
+	int (*get_perf_stats)(struct ndctl_dimm *, unsigned long long *,
+			unsigned int, unsigned long long *);
 };
 
 extern struct ndctl_dimm_ops * const intel_dimm_ops;
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: LGPL-2.1
 // Copyright (C) 2016-2020, Intel Corporation. All rights reserved.
+#include <time.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <util/log.h>
@@ -10,13 +11,22 @@
  * Define the wrappers around the ndctl_dimm_ops:
  */
 
+static struct ndctl_cmd *smart_cache_mark(struct ndctl_cmd *cmd,
+		enum ndctl_smart_cache_op op)
+{
+	if (cmd)
+		cmd->smart_cache = op;
+	return cmd;
+}
+
 NDCTL_EXPORT struct ndctl_cmd *ndctl_dimm_cmd_new_smart(
 		struct ndctl_dimm *dimm)
 {
 	struct ndctl_dimm_ops *ops = dimm->ops;
 
 	if (ops && ops->new_smart)
-		return ops->new_smart(dimm);
+		return smart_cache_mark(ops->new_smart(dimm),
+				ND_SMART_CACHE_FILL);
 	else
 		return NULL;
 }
@@ -46,7 +56,8 @@ NDCTL_EXPORT struct ndctl_cmd *ndctl_dimm_cmd_new_smart_set_threshold(
 	ops = cmd->dimm->ops;
 
 	if (ops && ops->new_smart_set_threshold)
-		return ops->new_smart_set_threshold(cmd);
+		return smart_cache_mark(ops->new_smart_set_threshold(cmd),
+				ND_SMART_CACHE_DROP);
 	else
 		return NULL;
 }
@@ -119,7 +130,8 @@ NDCTL_EXPORT struct ndctl_cmd *ndctl_dimm_cmd_new_smart_inject(
 	struct ndctl_dimm_ops *ops = dimm->ops;
 
 	if (ops && ops->new_smart_inject)
-		return ops->new_smart_inject(dimm);
+		return smart_cache_mark(ops->new_smart_inject(dimm),
+				ND_SMART_CACHE_DROP);
 	else
 		return NULL;
 }
@@ -159,7 +171,8 @@ ndctl_dimm_cmd_new_ack_shutdown_count(struct ndctl_dimm *dimm)
 	struct ndctl_dimm_ops *ops = dimm->ops;
 
 	if (ops && ops->new_ack_shutdown_count)
-		return ops->new_ack_shutdown_count(dimm);
+		return smart_cache_mark(ops->new_ack_shutdown_count(dimm),
+				ND_SMART_CACHE_DROP);
 	else
 		return NULL;
 }
@@ -173,3 +186,176 @@ NDCTL_EXPORT int ndctl_dimm_smart_inject_supported(struct ndctl_dimm *dimm)
 	else
 		return -ENOTTY;
 }
+
+/*
+ * With a TTL set, a successful smart read leaves a copy of its payload
+ * with the dimm, and smart reads within the TTL are answered from that
+ * copy without a DSM. The ndctl_cmd_smart_get_* accessors only parse
+ * the payload, so they cannot tell the difference. Commands that change
+ * smart state drop the copy.
+ */
+struct ndctl_smart_cache {
+	unsigned long long stamp_ms;
+	int rc;
+	size_t len;
+	char buf[];
+};
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static size_t smart_payload_len(struct ndctl_cmd *cmd)
+{
+	if (cmd->size <= (int) sizeof(*cmd))
+		return 0;
+	return cmd->size - sizeof(*cmd);
+}
+
+bool ndctl_smart_cache_get(struct ndctl_cmd *cmd, int *rc)
+{
+	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(cmd->dimm);
+	struct ndctl_dimm *dimm = cmd->dimm;
+	size_t len = smart_payload_len(cmd);
+	struct ndctl_smart_cache *c;
+	bool hit = false;
+
+	if (cmd->smart_cache != ND_SMART_CACHE_FILL || !ctx->smart_ttl_ms)
+		return false;
+
+	pthread_mutex_lock(&ctx->smart_lock);
+	c = dimm->smart_cache;
+	if (c && c->len == len && now_ms() - c->stamp_ms < ctx->smart_ttl_ms) {
+		memcpy(cmd->cmd_buf, c->buf, len);
+		*rc = c->rc;
+		hit = true;
+	}
+	pthread_mutex_unlock(&ctx->smart_lock);
+
+	if (hit) {
+		dbg(ctx, "%s: smart from cache\n", ndctl_dimm_get_devname(dimm));
+		cmd->status = *rc;
+	}
+	return hit;
+}
+
+static void smart_cache_set(struct ndctl_dimm *dimm,
+		struct ndctl_smart_cache *c)
+{
+	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(dimm);
+	struct ndctl_smart_cache *old;
+
+	pthread_mutex_lock(&ctx->smart_lock);
+	old = dimm->smart_cache;
+	dimm->smart_cache = c;
+	pthread_mutex_unlock(&ctx->smart_lock);
+	free(old);
+}
+
+void ndctl_smart_cache_update(struct ndctl_cmd *cmd, int rc)
+{
+	struct ndctl_ctx *ctx = ndctl_dimm_get_ctx(cmd->dimm);
+	size_t len = smart_payload_len(cmd);
+	struct ndctl_smart_cache *c;
+
+	switch (cmd->smart_cache) {
+	case ND_SMART_CACHE_NONE:
+		return;
+	case ND_SMART_CACHE_DROP:
+		smart_cache_set(cmd->dimm, NULL);
+		return;
+	default:
+		break;
+	}
+
+	/* only keep answers the firmware vouched for */
+	if (!ctx->smart_ttl_ms || rc < 0 || !len
+			|| cmd->get_firmware_status(cmd))
+		return;
+
+	c = malloc(sizeof(*c) + len);
+	if (!c)
+		return;
+	c->stamp_ms = now_ms();
+	c->rc = rc;
+	c->len = len;
+	memcpy(c->buf, cmd->cmd_buf, len);
+	smart_cache_set(cmd->dimm, c);
+}
+
+/**
+ * ndctl_set_smart_ttl - answer repeated smart reads from memory
+ * @ctx: ndctl library context
+ * @ttl_ms: how long a dimm's smart result stays valid, 0 to disable
+ *
+ * Lets tools that each ask for health, or a list followed by a monitor
+ * pass, share one DSM per dimm. The NDCTL_SMART_TTL_MS environment
+ * variable provides the default, which is 0.
+ */
+NDCTL_EXPORT void ndctl_set_smart_ttl(struct ndctl_ctx *ctx,
+		unsigned int ttl_ms)
+{
+	ctx->smart_ttl_ms = ttl_ms;
+}
+
+NDCTL_EXPORT unsigned int ndctl_get_smart_ttl(struct ndctl_ctx *ctx)
+{
+	return ctx->smart_ttl_ms;
+}
+
+/**
+ * ndctl_dimm_invalidate_smart - forget a dimm's cached smart result
+ * @dimm: dimm whose next smart read must go to firmware
+ *
+ * For callers that learn of a health change out of band, for example
+ * from the dimm's health event file descriptor.
+ */
+NDCTL_EXPORT void ndctl_dimm_invalidate_smart(struct ndctl_dimm *dimm)
+{
+	smart_cache_set(dimm, NULL);
+}
+
+/**
+ * ndctl_bus_refresh_smart - reread smart data on all of a bus's dimms
+ * @bus: bus to refresh
+ *
+ * Issues a smart read to every dimm that supports one, concurrently,
+ * and refills the cache with the results whatever their age.
+ *
+ * Returns the number of dimms refreshed, or a negative error code.
+ */
+NDCTL_EXPORT int ndctl_bus_refresh_smart(struct ndctl_bus *bus)
+{
+	struct ndctl_cmd_batch *batch;
+	struct ndctl_dimm *dimm;
+	struct ndctl_cmd *cmd;
+	int i, rc, nr = 0;
+
+	batch = ndctl_cmd_batch_new(ndctl_bus_get_ctx(bus));
+	if (!batch)
+		return -ENOMEM;
+
+	ndctl_dimm_foreach(bus, dimm) {
+		cmd = smart_cache_mark(ndctl_dimm_cmd_new_smart(dimm),
+				ND_SMART_CACHE_REFRESH);
+		if (!cmd)
+			continue;
+		rc = ndctl_cmd_batch_add(batch, cmd);
+		ndctl_cmd_unref(cmd);
+		if (rc < 0)
+			goto out;
+	}
+
+	ndctl_cmd_batch_submit(batch);
+	for (i = 0; i < ndctl_cmd_batch_get_count(batch); i++)
+		if (ndctl_cmd_batch_get_result(batch, i) >= 0)
+			nr++;
+	rc = nr;
+ out:
+	ndctl_cmd_batch_free(batch);
+	return rc;
+}
@@ -0,0 +1,661 @@
+// SPDX-License-Identifier: LGPL-2.1
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <util/log.h>
+#include <util/sysfs.h>
+#include <ndctl/libndctl.h>
+#include "private.h"
+
+/*
+ * Topology snapshot, see ndctl_set_snapshot(). While a bus, dimm,
+ * region, namespace, btt, pfn or dax list is being built, the
+ * attribute reads, directory listings and link resolutions it makes
+ * are looked up in the snapshot before going to sysfs, and any that
+ * miss are recorded. When the context is released, the snapshot is
+ * written back if anything was added and the generation it was taken
+ * under still holds.
+ *
+ * The generation is the boot id, the uevent sequence number and the
+ * mtime of every directory that was listed. Adding or removing a
+ * device, binding or unbinding a driver, and changing device state
+ * through this library all invalidate it. Attributes read after
+ * enumeration, which can change without a uevent, always go to sysfs.
+ *
+ * The file is a header followed by packed, 8 byte aligned entries,
+ * each a key and a value string. It is mapped read-only and indexed in
+ * a hash table along with the entries added since.
+ */
+#define ND_SNAPSHOT_MAGIC "NDSNAP\0\0"
+#define ND_SNAPSHOT_VERSION 1
+#define ND_SNAPSHOT_BOOT_ID_LEN 40
+
+enum {
+	ND_SNAP_ATTR,
+	ND_SNAP_DIR,
+	ND_SNAP_LINK,
+	ND_SNAP_MTIME,
+};
+
+struct nd_snap_header {
+	char magic[8];
+	u32 version;
+	u32 nr_entries;
+	u64 seqnum;
+	u64 size;
+	char boot_id[ND_SNAPSHOT_BOOT_ID_LEN];
+};
+
+struct nd_snap_entry {
+	u32 type;
+	s32 rc;
+	u32 key_len;
+	u32 val_len;
+	char data[];
+};
+
+struct ndctl_snapshot {
+	void *map;
+	size_t map_size;
+	const struct nd_snap_entry **table;
+	unsigned int table_size;
+	unsigned int nr;
+	struct nd_snap_entry **added;
+	unsigned int nr_added;
+	u64 seqnum;
+	char boot_id[ND_SNAPSHOT_BOOT_ID_LEN];
+	bool invalid;
+};
+
+/* only the thread building a list, under ctx->init_lock, uses the snapshot */
+static __thread int nd_snapshot_scope;
+
+void ndctl_snapshot_enter(void)
+{
+	nd_snapshot_scope++;
+}
+
+void ndctl_snapshot_leave(void)
+{
+	nd_snapshot_scope--;
+}
+
+static size_t nd_snap_entry_size(const struct nd_snap_entry *e)
+{
+	return (sizeof(*e) + e->key_len + e->val_len + 7) & ~7UL;
+}
+
+static const char *nd_snap_key(const struct nd_snap_entry *e)
+{
+	return e->data;
+}
+
+static const char *nd_snap_val(const struct nd_snap_entry *e)
+{
+	return e->data + e->key_len;
+}
+
+static unsigned int nd_snap_hash(int type, const char *key)
+{
+	unsigned int h = 2166136261u ^ type;
+
+	while (*key)
+		h = (h ^ (unsigned char) *key++) * 16777619u;
+	return h;
+}
+
+static const struct nd_snap_entry **nd_snap_slot(struct ndctl_snapshot *snap,
+		int type, const char *key)
+{
+	unsigned int mask = snap->table_size - 1;
+	unsigned int i = nd_snap_hash(type, key) & mask;
+	const struct nd_snap_entry *e;
+
+	while ((e = snap->table[i])) {
+		if ((int) e->type == type && strcmp(nd_snap_key(e), key) == 0)
+			break;
+		i = (i + 1) & mask;
+	}
+	return &snap->table[i];
+}
+
+static int nd_snap_index(struct ndctl_snapshot *snap,
+		const struct nd_snap_entry *e)
+{
+	const struct nd_snap_entry **table, **old = snap->table, **slot;
+	unsigned int i, old_size = snap->table_size;
+
+	if ((snap->nr + 1) * 2 > snap->table_size) {
+		table = calloc(old_size ? old_size * 2 : 256, sizeof(*table));
+		if (!table)
+			return -ENOMEM;
+		snap->table = table;
+		snap->table_size = old_size ? old_size * 2 : 256;
+		for (i = 0; i < old_size; i++)
+			if (old[i])
+				*nd_snap_slot(snap, old[i]->type,
+						nd_snap_key(old[i])) = old[i];
+		free(old);
+	}
+	slot = nd_snap_slot(snap, e->type, nd_snap_key(e));
+	if (!*slot)
+		snap->nr++;
+	*slot = e;
+	return 0;
+}
+
+static const struct nd_snap_entry *nd_snap_find(struct ndctl_snapshot *snap,
+		int type, const char *key)
+{
+	if (!snap->table_size)
+		return NULL;
+	return *nd_snap_slot(snap, type, key);
+}
+
+static void nd_snap_add(struct ndctl_snapshot *snap, int type, int rc,
+		const char *key, const char *val)
+{
+	struct nd_snap_entry *e, **added;
+	size_t key_len = strlen(key) + 1, val_len = strlen(val) + 1;
+
+	e = calloc(1, (sizeof(*e) + key_len + val_len + 7) & ~7UL);
+	if (!e)
+		return;
+	e->type = type;
+	e->rc = rc;
+	e->key_len = key_len;
+	e->val_len = val_len;
+	memcpy(e->data, key, key_len);
+	memcpy(e->data + key_len, val, val_len);
+
+	added = realloc(snap->added, (snap->nr_added + 1) * sizeof(*added));
+	if (!added || nd_snap_index(snap, e) < 0) {
+		snap->added = added ? added : snap->added;
+		free(e);
+		return;
+	}
+	snap->added = added;
+	snap->added[snap->nr_added++] = e;
+}
+
+static int nd_read_small(const char *path, char *buf, size_t len)
+{
+	ssize_t n;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return -errno;
+	while (n && buf[n - 1] == '\n')
+		n--;
+	buf[n] = '\0';
+	return 0;
+}
+
+static int nd_generation(u64 *seqnum, char *boot_id)
+{
+	char buf[32];
+	int rc;
+
+	rc = nd_read_small("/proc/sys/kernel/random/boot_id", boot_id,
+			ND_SNAPSHOT_BOOT_ID_LEN);
+	if (rc)
+		return rc;
+	rc = nd_read_small("/sys/kernel/uevent_seqnum", buf, sizeof(buf));
+	if (rc)
+		return rc;
+	*seqnum = strtoull(buf, NULL, 0);
+	return 0;
+}
+
+static void nd_mtime(const char *path, char *buf, size_t len)
+{
+	struct stat st;
+
+	if (stat(path, &st) < 0)
+		snprintf(buf, len, "-");
+	else
+		snprintf(buf, len, "%lld.%09ld", (long long) st.st_mtim.tv_sec,
+				st.st_mtim.tv_nsec);
+}
+
+/* map @path and index its entries if it matches the current generation */
+static int nd_snap_load(struct ndctl_ctx *ctx, struct ndctl_snapshot *snap,
+		const char *path)
+{
+	const struct nd_snap_header *hdr;
+	const struct nd_snap_entry *e;
+	char mtime[48];
+	size_t off;
+	struct stat st;
+	unsigned int i;
+	int fd, rc = 0;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(*hdr)) {
+		close(fd);
+		return -EINVAL;
+	}
+	snap->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (snap->map == MAP_FAILED) {
+		snap->map = NULL;
+		return -errno;
+	}
+	snap->map_size = st.st_size;
+
+	hdr = snap->map;
+	if (memcmp(hdr->magic, ND_SNAPSHOT_MAGIC, sizeof(hdr->magic)) != 0
+			|| hdr->version != ND_SNAPSHOT_VERSION
+			|| hdr->size != snap->map_size
+			|| hdr->seqnum != snap->seqnum
+			|| strncmp(hdr->boot_id, snap->boot_id,
+				sizeof(hdr->boot_id)) != 0) {
+		rc = -ESTALE;
+		goto out;
+	}
+
+	off = sizeof(*hdr);
+	for (i = 0; i < hdr->nr_entries && rc == 0; i++) {
+		e = (const void *) ((const char *) snap->map + off);
+		if (off + sizeof(*e) > snap->map_size
+				|| off + nd_snap_entry_size(e) > snap->map_size
+				|| !e->key_len || !e->val_len
+				|| nd_snap_key(e)[e->key_len - 1]
+				|| nd_snap_val(e)[e->val_len - 1]) {
+			rc = -EINVAL;
+			break;
+		}
+		off += nd_snap_entry_size(e);
+		if (e->type == ND_SNAP_MTIME) {
+			nd_mtime(nd_snap_key(e), mtime, sizeof(mtime));
+			if (strcmp(mtime, nd_snap_val(e)) != 0) {
+				rc = -ESTALE;
+				break;
+			}
+		}
+		rc = nd_snap_index(snap, e);
+	}
+out:
+	if (rc) {
+		dbg(ctx, "%s: not used: %s\n", path, strerror(-rc));
+		free(snap->table);
+		snap->table = NULL;
+		snap->table_size = 0;
+		snap->nr = 0;
+		munmap(snap->map, snap->map_size);
+		snap->map = NULL;
+	} else
+		dbg(ctx, "%s: %u entries\n", path, snap->nr);
+	return rc;
+}
+
+static struct ndctl_snapshot *nd_snapshot_get(struct ndctl_ctx *ctx)
+{
+	struct ndctl_snapshot *snap = ctx->snapshot;
+
+	if (!nd_snapshot_scope || !ctx->snapshot_path)
+		return NULL;
+	if (snap)
+		return snap->invalid ? NULL : snap;
+
+	snap = calloc(1, sizeof(*snap));
+	if (!snap)
+		return NULL;
+	ctx->snapshot = snap;
+	if (nd_generation(&snap->seqnum, snap->boot_id) < 0) {
+		snap->invalid = true;
+		return NULL;
+	}
+	nd_snap_load(ctx, snap, ctx->snapshot_path);
+	return snap;
+}
+
+int ndctl_snapshot_read_attr(struct ndctl_ctx *ctx, const char *path,
+		char *buf)
+{
+	struct ndctl_snapshot *snap = nd_snapshot_get(ctx);
+	const struct nd_snap_entry *e;
+	int rc;
+
+	if (!snap)
+		return __sysfs_read_attr(&ctx->ctx, path, buf);
+
+	e = nd_snap_find(snap, ND_SNAP_ATTR, path);
+	if (e && e->val_len <= SYSFS_ATTR_SIZE) {
+		memcpy(buf, nd_snap_val(e), e->val_len);
+		return e->rc;
+	}
+	rc = __sysfs_read_attr(&ctx->ctx, path, buf);
+	nd_snap_add(snap, ND_SNAP_ATTR, rc, path, rc ? "" : buf);
+	return rc;
+}
+
+void ndctl_sysfs_dir_init(struct ndctl_sysfs_dir *dir, struct ndctl_ctx *ctx,
+		const char *base)
+{
+	dir->ctx = ctx;
+	dir->base = base;
+	dir->fd = -1;
+	dir->err = 0;
+	dir->prefetch = NULL;
+	dir->nr_prefetch = 0;
+}
+
+/* the directory is only opened once a read actually has to go to sysfs */
+static int nd_dir_open(struct ndctl_sysfs_dir *dir)
+{
+	if (dir->fd < 0 && !dir->err) {
+		dir->fd = __sysfs_open_dev(&dir->ctx->ctx, dir->base);
+		if (dir->fd < 0)
+			dir->err = dir->fd;
+	}
+	return dir->err;
+}
+
+static int nd_dir_read(struct ndctl_sysfs_dir *dir, const char *attr,
+		char *buf)
+{
+	struct sysfs_attr_req *req;
+	int i, rc;
+
+	for (i = 0; i < dir->nr_prefetch; i++) {
+		req = &dir->prefetch[i];
+		if (strcmp(req->attr, attr) != 0)
+			continue;
+		if (req->rc == 0)
+			memcpy(buf, req->buf, strlen(req->buf) + 1);
+		else
+			buf[0] = 0;
+		return req->rc;
+	}
+
+	rc = nd_dir_open(dir);
+	if (rc)
+		return rc;
+	return __sysfs_read_attr_at(&dir->ctx->ctx, dir->fd, attr, buf);
+}
+
+/*
+ * Attributes the snapshot already holds are left out, the rest are
+ * read in one go and kept until the directory is closed. Prefetching
+ * is only a hint: if it fails, reads fall back to one at a time.
+ */
+void ndctl_sysfs_dir_prefetch(struct ndctl_sysfs_dir *dir,
+		const char * const *attrs, int nr)
+{
+	struct ndctl_snapshot *snap = nd_snapshot_get(dir->ctx);
+	struct sysfs_attr_req *reqs;
+	char path[PATH_MAX];
+	char *bufs;
+	int i, n = 0;
+
+	if (dir->prefetch || nd_dir_open(dir))
+		return;
+	reqs = calloc(nr, sizeof(*reqs) + SYSFS_ATTR_SIZE);
+	if (!reqs)
+		return;
+	bufs = (char *) &reqs[nr];
+
+	for (i = 0; i < nr; i++) {
+		if (snap && snprintf(path, sizeof(path), "%s/%s", dir->base,
+					attrs[i]) < (int) sizeof(path)
+				&& nd_snap_find(snap, ND_SNAP_ATTR, path))
+			continue;
+		reqs[n].dirfd = dir->fd;
+		reqs[n].attr = attrs[i];
+		reqs[n].buf = bufs + n * SYSFS_ATTR_SIZE;
+		n++;
+	}
+	if (!n) {
+		free(reqs);
+		return;
+	}
+	__sysfs_read_attrs(&dir->ctx->ctx, reqs, n);
+	dir->prefetch = reqs;
+	dir->nr_prefetch = n;
+}
+
+int ndctl_sysfs_dir_read(struct ndctl_sysfs_dir *dir, const char *attr,
+		char *buf)
+{
+	struct ndctl_snapshot *snap = nd_snapshot_get(dir->ctx);
+	const struct nd_snap_entry *e;
+	char path[PATH_MAX];
+	int rc;
+
+	if (!snap)
+		return nd_dir_read(dir, attr, buf);
+
+	/* keyed by full path, the same as ndctl_snapshot_read_attr() */
+	if (snprintf(path, sizeof(path), "%s/%s", dir->base, attr)
+			>= (int) sizeof(path))
+		return -ENAMETOOLONG;
+	e = nd_snap_find(snap, ND_SNAP_ATTR, path);
+	if (e && e->val_len <= SYSFS_ATTR_SIZE) {
+		memcpy(buf, nd_snap_val(e), e->val_len);
+		return e->rc;
+	}
+	rc = nd_dir_read(dir, attr, buf);
+	nd_snap_add(snap, ND_SNAP_ATTR, rc, path, rc ? "" : buf);
+	return rc;
+}
+
+void ndctl_sysfs_dir_close(struct ndctl_sysfs_dir *dir)
+{
+	if (dir->fd >= 0)
+		close(dir->fd);
+	dir->fd = -1;
+	free(dir->prefetch);
+	dir->prefetch = NULL;
+	dir->nr_prefetch = 0;
+}
+
+static void nd_snapshot_invalidate(struct ndctl_ctx *ctx)
+{
+	struct ndctl_snapshot *snap;
+
+	if (!ctx->snapshot_path)
+		return;
+	pthread_mutex_lock(&ctx->init_lock);
+	snap = ctx->snapshot;
+	if (!snap) {
+		snap = calloc(1, sizeof(*snap));
+		ctx->snapshot = snap;
+	}
+	if (snap && !snap->invalid) {
+		snap->invalid = true;
+		unlink(ctx->snapshot_path);
+	}
+	pthread_mutex_unlock(&ctx->init_lock);
+}
+
+int ndctl_snapshot_write_attr(struct ndctl_ctx *ctx, const char *path,
+		const char *buf, bool quiet)
+{
+	nd_snapshot_invalidate(ctx);
+	if (quiet)
+		return __sysfs_write_attr_quiet(&ctx->ctx, path, buf);
+	return __sysfs_write_attr(&ctx->ctx, path, buf);
+}
+
+char *ndctl_snapshot_realpath(struct ndctl_ctx *ctx, const char *path)
+{
+	struct ndctl_snapshot *snap = nd_snapshot_get(ctx);
+	const struct nd_snap_entry *e;
+	char *resolved;
+
+	if (!snap)
+		return realpath(path, NULL);
+	e = nd_snap_find(snap, ND_SNAP_LINK, path);
+	if (e)
+		return e->rc ? NULL : strdup(nd_snap_val(e));
+	resolved = realpath(path, NULL);
+	nd_snap_add(snap, ND_SNAP_LINK, resolved ? 0 : -errno, path,
+			resolved ? resolved : "");
+	return resolved;
+}
+
+/* "\n" separated entry names of @base_path, recorded with its mtime */
+static char *nd_snap_list(struct ndctl_ctx *ctx, struct ndctl_snapshot *snap,
+		const char *base_path)
+{
+	const struct nd_snap_entry *e;
+	char mtime[48], *names = NULL, *n;
+	size_t len = 0, dlen;
+	struct dirent *de;
+	DIR *dir;
+
+	e = nd_snap_find(snap, ND_SNAP_DIR, base_path);
+	if (e)
+		return e->rc ? NULL : strdup(nd_snap_val(e));
+
+	nd_mtime(base_path, mtime, sizeof(mtime));
+	dir = opendir(base_path);
+	if (!dir) {
+		nd_snap_add(snap, ND_SNAP_DIR, -ENODEV, base_path, "");
+		return NULL;
+	}
+	names = strdup("");
+	while (names && (de = readdir(dir)) != NULL) {
+		if (de->d_ino == 0 || de->d_name[0] == '.')
+			continue;
+		dlen = strlen(de->d_name);
+		n = realloc(names, len + dlen + 2);
+		if (!n) {
+			free(names);
+			names = NULL;
+			break;
+		}
+		names = n;
+		memcpy(names + len, de->d_name, dlen);
+		len += dlen;
+		names[len++] = '\n';
+		names[len] = '\0';
+	}
+	closedir(dir);
+	if (names) {
+		nd_snap_add(snap, ND_SNAP_DIR, 0, base_path, names);
+		nd_snap_add(snap, ND_SNAP_MTIME, 0, base_path, mtime);
+	}
+	return names;
+}
+
+int ndctl_snapshot_device_parse(struct ndctl_ctx *ctx, const char *base_path,
+		const char *dev_name, void *parent, add_dev_fn add_dev)
+{
+	struct ndctl_snapshot *snap = nd_snapshot_get(ctx);
+	char *names, *name, *next, *dev_path, fmt[20];
+	int add_errors = 0, id;
+	void *dev;
+
+	if (!snap)
+		return __sysfs_device_parse(&ctx->ctx, base_path, dev_name,
+				parent, add_dev);
+
+	names = nd_snap_list(ctx, snap, base_path);
+	if (!names) {
+		dbg(ctx, "no \"%s\" devices found\n", dev_name);
+		return -ENODEV;
+	}
+
+	sprintf(fmt, "%s%%d", dev_name);
+	for (name = names; *name; name = next) {
+		next = strchr(name, '\n');
+		*next++ = '\0';
+		if (sscanf(name, fmt, &id) != 1)
+			continue;
+		if (asprintf(&dev_path, "%s/%s", base_path, name) < 0) {
+			err(ctx, "%s%d: path allocation failure\n", dev_name, id);
+			continue;
+		}
+		dev = add_dev(parent, id, dev_path);
+		free(dev_path);
+		if (!dev) {
+			add_errors++;
+			err(ctx, "%s%d: add_dev() failed\n", dev_name, id);
+		} else
+			dbg(ctx, "%s%d: processed\n", dev_name, id);
+	}
+	free(names);
+	return add_errors;
+}
+
+/* write via a temporary file so concurrent readers never see a partial file */
+static void nd_snap_save(struct ndctl_ctx *ctx, struct ndctl_snapshot *snap)
+{
+	char *path = ctx->snapshot_path, tmp[PATH_MAX], *dir;
+	char boot_id[ND_SNAPSHOT_BOOT_ID_LEN];
+	struct nd_snap_header hdr = { 0 };
+	const struct nd_snap_entry *e;
+	unsigned int i;
+	u64 seqnum;
+	FILE *f;
+
+	/* a device came or went while enumerating, what was read may be mixed */
+	if (nd_generation(&seqnum, boot_id) < 0 || seqnum != snap->seqnum)
+		return;
+
+	if (snprintf(tmp, sizeof(tmp), "%s", path) >= (int) sizeof(tmp))
+		return;
+	dir = dirname(tmp);
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+		return;
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+	f = fopen(tmp, "we");
+	if (!f)
+		return;
+
+	memcpy(hdr.magic, ND_SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	hdr.version = ND_SNAPSHOT_VERSION;
+	hdr.nr_entries = snap->nr;
+	hdr.seqnum = snap->seqnum;
+	hdr.size = sizeof(hdr);
+	memcpy(hdr.boot_id, snap->boot_id, sizeof(hdr.boot_id));
+	for (i = 0; i < snap->table_size; i++)
+		if ((e = snap->table[i]))
+			hdr.size += nd_snap_entry_size(e);
+
+	fwrite(&hdr, sizeof(hdr), 1, f);
+	for (i = 0; i < snap->table_size; i++)
+		if ((e = snap->table[i]))
+			fwrite(e, nd_snap_entry_size(e), 1, f);
+	if (fclose(f) != 0 || rename(tmp, path) < 0) {
+		dbg(ctx, "failed to save snapshot to %s\n", path);
+		unlink(tmp);
+	}
+}
+
+void ndctl_snapshot_release(struct ndctl_ctx *ctx)
+{
+	struct ndctl_snapshot *snap = ctx->snapshot;
+	unsigned int i;
+
+	if (!snap)
+		return;
+	if (!snap->invalid && snap->nr_added)
+		nd_snap_save(ctx, snap);
+	for (i = 0; i < snap->nr_added; i++)
+		free(snap->added[i]);
+	free(snap->added);
+	free(snap->table);
+	if (snap->map)
+		munmap(snap->map, snap->map_size);
+	free(snap);
+	ctx->snapshot = NULL;
+}
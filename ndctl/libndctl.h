@@ -81,15 +81,23 @@ struct ndctl_ctx *ndctl_unref(struct ndctl_ctx *ctx);
 int ndctl_new(struct ndctl_ctx **ctx);
 void ndctl_set_private_data(struct ndctl_ctx *ctx, void *data);
 void *ndctl_get_private_data(struct ndctl_ctx *ctx);
+int ndctl_set_snapshot(struct ndctl_ctx *ctx, const char *path);
+int ndctl_set_enumerate_threads(struct ndctl_ctx *ctx, unsigned int nr);
+void ndctl_set_max_threads(struct ndctl_ctx *ctx, unsigned int nr);
+int ndctl_set_sysfs_root(struct ndctl_ctx *ctx, const char *path);
 struct daxctl_ctx;
 struct daxctl_ctx *ndctl_get_daxctl_ctx(struct ndctl_ctx *ctx);
 void ndctl_invalidate(struct ndctl_ctx *ctx);
+int ndctl_watch(struct ndctl_ctx *ctx);
+int ndctl_refresh(struct ndctl_ctx *ctx);
 void ndctl_set_log_fn(struct ndctl_ctx *ctx,
                   void (*log_fn)(struct ndctl_ctx *ctx,
                                  int priority, const char *file, int line, const char *fn,
                                  const char *format, va_list args));
 int ndctl_get_log_priority(struct ndctl_ctx *ctx);
 void ndctl_set_log_priority(struct ndctl_ctx *ctx, int priority);
+int ndctl_set_log_ring(struct ndctl_ctx *ctx, unsigned long size);
+void ndctl_log_dump(struct ndctl_ctx *ctx);
 void ndctl_set_userdata(struct ndctl_ctx *ctx, void *userdata);
 void *ndctl_get_userdata(struct ndctl_ctx *ctx);
 
@@ -154,6 +162,7 @@ int ndctl_bus_clear_fw_activate_nosuspend(struct ndctl_bus *bus);
 int ndctl_bus_activate_firmware(struct ndctl_bus *bus, enum ndctl_fwa_method method);
 int ndctl_bus_nfit_translate_spa(struct ndctl_bus *bus, unsigned long long addr,
 		unsigned int *handle, unsigned long long *dpa);
+void ndctl_bus_set_persistent_fd(struct ndctl_bus *bus, int enable);
 
 struct ndctl_dimm;
 struct ndctl_dimm *ndctl_dimm_get_first(struct ndctl_bus *bus);
@@ -198,6 +207,35 @@ unsigned int ndctl_dimm_get_health(struct ndctl_dimm *dimm);
 unsigned int ndctl_dimm_get_flags(struct ndctl_dimm *dimm);
 unsigned int ndctl_dimm_get_event_flags(struct ndctl_dimm *dimm);
 int ndctl_dimm_is_flag_supported(struct ndctl_dimm *dimm, unsigned int flag);
+
+/*
+ * Performance counters a dimm's platform keeps outside of SMART, today
+ * those PowerVM reports for papr_scm dimms. Durations and times are in
+ * the units the platform reports them.
+ */
+enum ndctl_perf_stat {
+	NDCTL_PERF_CTL_RESET_COUNT,
+	NDCTL_PERF_CTL_RESET_TIME,
+	NDCTL_PERF_POWER_ON_SECS,
+	NDCTL_PERF_LIFE_REMAINING,
+	NDCTL_PERF_CRIT_RESOURCE_UTIL,
+	NDCTL_PERF_HOST_LOAD_COUNT,
+	NDCTL_PERF_HOST_STORE_COUNT,
+	NDCTL_PERF_HOST_LOAD_DURATION,
+	NDCTL_PERF_HOST_STORE_DURATION,
+	NDCTL_PERF_MEDIA_READ_COUNT,
+	NDCTL_PERF_MEDIA_WRITE_COUNT,
+	NDCTL_PERF_MEDIA_READ_DURATION,
+	NDCTL_PERF_MEDIA_WRITE_DURATION,
+	NDCTL_PERF_CACHE_READ_HIT_COUNT,
+	NDCTL_PERF_CACHE_WRITE_HIT_COUNT,
+	NDCTL_PERF_FAST_WRITE_COUNT,
+	NDCTL_PERF_STAT_MAX,
+};
+const char *ndctl_perf_stat_name(enum ndctl_perf_stat stat);
+int ndctl_dimm_get_perf_stats(struct ndctl_dimm *dimm,
+		unsigned long long *stats, unsigned int nr,
+		unsigned long long *valid);
 unsigned int ndctl_dimm_handle_get_node(struct ndctl_dimm *dimm);
 unsigned int ndctl_dimm_handle_get_socket(struct ndctl_dimm *dimm);
 unsigned int ndctl_dimm_handle_get_imc(struct ndctl_dimm *dimm);
@@ -373,6 +411,9 @@ struct badblock *ndctl_region_get_next_badblock(struct ndctl_region *region);
         for (badblock = ndctl_region_get_first_badblock(region); \
              badblock != NULL; \
              badblock = ndctl_region_get_next_badblock(region))
+unsigned int ndctl_region_get_badblocks_range(struct ndctl_region *region,
+		unsigned long long offset, unsigned long long len,
+		const struct badblock **bbs);
 unsigned int ndctl_region_get_id(struct ndctl_region *region);
 const char *ndctl_region_get_devname(struct ndctl_region *region);
 unsigned int ndctl_region_get_interleave_ways(struct ndctl_region *region);
@@ -404,6 +445,9 @@ int ndctl_region_has_numa(struct ndctl_region *region);
 int ndctl_region_get_target_node(struct ndctl_region *region);
 struct ndctl_region *ndctl_bus_get_region_by_physical_address(struct ndctl_bus *bus,
 		unsigned long long address);
+unsigned int ndctl_bus_translate_physical_addresses(struct ndctl_bus *bus,
+		const unsigned long long *addresses, unsigned int nr,
+		struct ndctl_region **regions, struct ndctl_dimm **dimms);
 #define ndctl_dimm_foreach_in_region(region, dimm) \
         for (dimm = ndctl_region_get_first_dimm(region); \
              dimm != NULL; \
@@ -416,6 +460,23 @@ int ndctl_region_disable_invalidate(struct ndctl_region *region);
 int ndctl_region_disable_preserve(struct ndctl_region *region);
 void ndctl_region_cleanup(struct ndctl_region *region);
 int ndctl_region_deep_flush(struct ndctl_region *region);
+int ndctl_region_deep_flush_many(struct ndctl_region **regions, int count,
+		int *results, unsigned long long *latency_ns);
+
+/**
+ * struct ndctl_persist_fns - how to make stores to a dax mapping durable
+ * @name: instruction behind @flush, "none" when no write-back is needed
+ * @flush: write back the cachelines overlapping a range
+ * @drain: wait for preceding write-backs and non-temporal stores
+ */
+struct ndctl_persist_fns {
+	const char *name;
+	void (*flush)(const void *addr, size_t len);
+	void (*drain)(void);
+};
+
+const struct ndctl_persist_fns *ndctl_persist_fns_for_region(
+		struct ndctl_region *region);
 
 struct ndctl_interleave_set;
 struct ndctl_interleave_set *ndctl_region_get_interleave_set(
@@ -549,6 +610,19 @@ enum ndctl_namespace_inject_flags {
 	NDCTL_NS_INJECT_SATURATE,
 };
 
+/* @block and @count in 512-byte units, relative to the namespace */
+struct ndctl_inject_range {
+	unsigned long long block;
+	unsigned long long count;
+};
+
+int ndctl_namespace_inject_errors(struct ndctl_namespace *ndns,
+		const struct ndctl_inject_range *ranges, unsigned int nr,
+		unsigned int flags);
+int ndctl_namespace_uninject_errors(struct ndctl_namespace *ndns,
+		const struct ndctl_inject_range *ranges, unsigned int nr,
+		unsigned int flags);
+
 struct ndctl_bb;
 unsigned long long ndctl_bb_get_block(struct ndctl_bb *bb);
 unsigned long long ndctl_bb_get_count(struct ndctl_bb *bb);
@@ -735,6 +809,32 @@ enum ndctl_fwa_state ndctl_dimm_fw_activate_arm(struct ndctl_dimm *dimm);
 int ndctl_cmd_xlat_firmware_status(struct ndctl_cmd *cmd);
 int ndctl_cmd_submit_xlat(struct ndctl_cmd *cmd);
 
+struct ndctl_cmd_batch;
+struct ndctl_cmd_batch *ndctl_cmd_batch_new(struct ndctl_ctx *ctx);
+void ndctl_cmd_batch_free(struct ndctl_cmd_batch *batch);
+int ndctl_cmd_batch_add(struct ndctl_cmd_batch *batch, struct ndctl_cmd *cmd);
+int ndctl_cmd_batch_get_count(struct ndctl_cmd_batch *batch);
+struct ndctl_cmd *ndctl_cmd_batch_get_cmd(struct ndctl_cmd_batch *batch,
+		int idx);
+int ndctl_cmd_batch_get_result(struct ndctl_cmd_batch *batch, int idx);
+int ndctl_cmd_batch_find_dimm(struct ndctl_cmd_batch *batch,
+		struct ndctl_dimm *dimm);
+int ndctl_cmd_batch_submit(struct ndctl_cmd_batch *batch);
+struct ndctl_cmd_batch *ndctl_bus_cmd_batch_dimms(struct ndctl_bus *bus,
+		struct ndctl_cmd *(*new_cmd)(struct ndctl_dimm *dimm));
+
+void ndctl_set_smart_ttl(struct ndctl_ctx *ctx, unsigned int ttl_ms);
+unsigned int ndctl_get_smart_ttl(struct ndctl_ctx *ctx);
+void ndctl_dimm_invalidate_smart(struct ndctl_dimm *dimm);
+int ndctl_bus_refresh_smart(struct ndctl_bus *bus);
+
+typedef int (*ndctl_ars_record_fn)(struct ndctl_bus *bus,
+		unsigned long long address, unsigned long long length,
+		void *data);
+int ndctl_bus_stream_ars_records(struct ndctl_cmd *ars_cap,
+		unsigned int poll_interval, unsigned int timeout,
+		ndctl_ars_record_fn fn, void *data);
+
 #define ND_PASSPHRASE_SIZE	32
 #define ND_KEY_DESC_LEN	22
 #define ND_KEY_DESC_PREFIX  7
@@ -757,6 +857,8 @@ int ndctl_dimm_freeze_security(struct ndctl_dimm *dimm);
 int ndctl_dimm_secure_erase(struct ndctl_dimm *dimm, long key);
 int ndctl_dimm_overwrite(struct ndctl_dimm *dimm, long key);
 int ndctl_dimm_wait_overwrite(struct ndctl_dimm *dimm);
+int ndctl_dimm_wait_overwrite_many(struct ndctl_dimm **dimms, int count,
+		int *results);
 int ndctl_dimm_update_master_passphrase(struct ndctl_dimm *dimm,
 		long ckey, long nkey);
 int ndctl_dimm_master_secure_erase(struct ndctl_dimm *dimm, long key);
@@ -3,14 +3,19 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <limits.h>
+#include <poll.h>
 
 #include <util/json.h>
+#include <util/monitor.h>
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <ndctl/libndctl.h>
 #include <util/parse-options.h>
+#include <util/pool.h>
+#include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
 
 #include <ndctl.h>
@@ -28,9 +33,109 @@ static struct {
 	bool firmware;
 	bool capabilities;
 	bool configured;
+	bool watch;
+	const char *fields;
+	unsigned int jobs;
 	int verbose;
 } list;
 
+/* smart data for the current bus, fetched from all its dimms at once */
+static struct {
+	struct ndctl_cmd_batch *smart;
+	struct ndctl_cmd_batch *threshold;
+} health;
+
+/*
+ * The walk decides what is listed and where it goes, but leaves building
+ * the dimm, region and namespace records, the part that issues DSMs and
+ * reads badblocks, to a pool of workers. A region's record and those of
+ * its namespaces are built by one worker, since they share the region's
+ * badblocks state. The records are then added in walk order, so the
+ * output does not depend on the number of workers.
+ */
+enum list_job_type {
+	LIST_JOB_DIMM,
+	LIST_JOB_REGION,
+	LIST_JOB_NAMESPACE,
+};
+
+struct list_job {
+	enum list_job_type type;
+	void *dev;
+	unsigned long flags;
+	struct ndctl_cmd_batch *smart, *threshold;
+	struct json_object *jarray;
+	struct json_object *jnamespaces;
+	struct json_object *jobj;
+	int parent;
+	bool failed;
+};
+
+/*
+ * Set when the output is a single top-level array, either of buses or of
+ * the one device type listed. The records are then written out as each
+ * bus completes rather than kept until the end of the walk.
+ */
+static struct util_json_stream *stream;
+
+static struct {
+	struct list_job *jobs;
+	int nr;
+	int cur_region;
+	struct ndctl_cmd_batch **batches;
+	int nr_batches;
+} pending = {
+	.cur_region = -1,
+};
+
+static void health_batch_free(void)
+{
+	int i;
+
+	for (i = 0; i < pending.nr_batches; i++)
+		ndctl_cmd_batch_free(pending.batches[i]);
+	free(pending.batches);
+	pending.batches = NULL;
+	pending.nr_batches = 0;
+	health.smart = NULL;
+	health.threshold = NULL;
+}
+
+static void health_batch_keep(struct ndctl_cmd_batch *batch)
+{
+	struct ndctl_cmd_batch **b;
+
+	if (!batch)
+		return;
+	b = realloc(pending.batches, (pending.nr_batches + 1) * sizeof(*b));
+	if (!b) {
+		/* the dimms fall back to individual commands */
+		ndctl_cmd_batch_free(batch);
+		return;
+	}
+	pending.batches = b;
+	pending.batches[pending.nr_batches++] = batch;
+}
+
+static struct list_job *list_job_add(enum list_job_type type, void *dev,
+		unsigned long flags, struct json_object *jarray)
+{
+	struct list_job *job;
+
+	job = realloc(pending.jobs, (pending.nr + 1) * sizeof(*job));
+	if (!job)
+		return NULL;
+	pending.jobs = job;
+	job = &pending.jobs[pending.nr++];
+	memset(job, 0, sizeof(*job));
+	job->type = type;
+	job->dev = dev;
+	job->flags = flags;
+	job->jarray = jarray;
+	job->parent = -1;
+	return job;
+}
+
 static unsigned long listopts_to_flags(void)
 {
 	unsigned long flags = 0;
@@ -51,6 +156,8 @@ static unsigned long listopts_to_flags(void)
 		flags |= UTIL_JSON_CAPABILITIES;
 	if (list.firmware)
 		flags |= UTIL_JSON_FIRMWARE;
+	if (list.fields)
+		flags |= UTIL_JSON_FIELDS;
 	return flags;
 }
 
@@ -69,7 +176,7 @@ static struct json_object *region_to_json(struct ndctl_region *region,
 		unsigned long flags)
 {
 	struct json_object *jregion = json_object_new_object();
-	struct json_object *jobj, *jbbs, *jmappings = NULL;
+	struct json_object *jobj, *jbbs = NULL, *jmappings = NULL;
 	struct ndctl_interleave_set *iset;
 	struct ndctl_mapping *mapping;
 	unsigned int bb_count = 0;
@@ -154,7 +261,7 @@ static struct json_object *region_to_json(struct ndctl_region *region,
 		struct ndctl_dimm *dimm = ndctl_mapping_get_dimm(mapping);
 		struct json_object *jmapping;
 
-		if (!list.dimms)
+		if (!list.dimms || !util_json_want(flags, "mappings"))
 			break;
 
 		if (!util_dimm_filter(dimm, param.dimm))
@@ -188,7 +295,9 @@ static struct json_object *region_to_json(struct ndctl_region *region,
 		json_object_object_add(jregion, "state", jobj);
 	}
 
-	jbbs = util_region_badblocks_to_json(region, &bb_count, flags);
+	if (util_json_want(flags, "badblock_count")
+			|| util_json_want(flags, "badblocks"))
+		jbbs = util_region_badblocks_to_json(region, &bb_count, flags);
 	if (bb_count) {
 		jobj = json_object_new_int(bb_count);
 		if (!jobj) {
@@ -200,7 +309,8 @@ static struct json_object *region_to_json(struct ndctl_region *region,
 	if ((flags & UTIL_JSON_MEDIA_ERRORS) && jbbs)
 		json_object_object_add(jregion, "badblocks", jbbs);
 
-	if (flags & UTIL_JSON_CAPABILITIES) {
+	if ((flags & UTIL_JSON_CAPABILITIES)
+			&& util_json_want(flags, "capabilities")) {
 		jobj = util_region_capabilities_to_json(region);
 		if (jobj)
 			json_object_object_add(jregion, "capabilities", jobj);
@@ -235,10 +345,11 @@ static struct json_object *region_to_json(struct ndctl_region *region,
 static void filter_namespace(struct ndctl_namespace *ndns,
 		struct util_filter_ctx *ctx)
 {
-	struct json_object *jndns;
 	struct list_filter_arg *lfa = ctx->list;
-	struct json_object *container = lfa->jregion ? lfa->jregion : lfa->jbus;
+	struct list_job *region = pending.cur_region >= 0
+		? &pending.jobs[pending.cur_region] : NULL;
 	unsigned long long size = ndctl_namespace_get_size(ndns);
+	struct list_job *job;
 
 	if (ndctl_namespace_is_active(ndns))
 		/* pass */;
@@ -256,18 +367,21 @@ static void filter_namespace(struct ndctl_namespace *ndns,
 			return;
 		}
 
-		if (container)
-			json_object_object_add(container, "namespaces",
+		/* a region's record does not exist until it is built */
+		if (region)
+			region->jnamespaces = lfa->jnamespaces;
+		else if (lfa->jbus)
+			json_object_object_add(lfa->jbus, "namespaces",
 					lfa->jnamespaces);
 	}
 
-	jndns = util_namespace_to_json(ndns, lfa->flags);
-	if (!jndns) {
+	job = list_job_add(LIST_JOB_NAMESPACE, ndns, lfa->flags,
+			lfa->jnamespaces);
+	if (!job) {
 		fail("\n");
 		return;
 	}
-
-	json_object_array_add(lfa->jnamespaces, jndns);
+	job->parent = pending.cur_region;
 }
 
 static bool filter_region(struct ndctl_region *region,
@@ -275,7 +389,7 @@ static bool filter_region(struct ndctl_region *region,
 {
 	struct list_filter_arg *lfa = ctx->list;
 	struct json_object *jbus = lfa->jbus;
-	struct json_object *jregion;
+	struct list_job *job;
 
 	if (!list.regions)
 		return true;
@@ -295,12 +409,12 @@ static bool filter_region(struct ndctl_region *region,
 					lfa->jregions);
 	}
 
-	jregion = region_to_json(region, lfa->flags);
-	if (!jregion) {
+	job = list_job_add(LIST_JOB_REGION, region, lfa->flags, lfa->jregions);
+	if (!job) {
 		fail("\n");
 		return false;
 	}
-	lfa->jregion = jregion;
+	pending.cur_region = job - pending.jobs;
 
 	/*
 	 * We've started a new region, any previous jnamespaces will
@@ -309,18 +423,13 @@ static bool filter_region(struct ndctl_region *region,
 	 */
 	lfa->jnamespaces = NULL;
 
-	/*
-	 * Without a bus we are collecting regions anonymously across
-	 * the platform.
-	 */
-	json_object_array_add(lfa->jregions, jregion);
 	return true;
 }
 
 static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
 {
 	struct list_filter_arg *lfa = ctx->list;
-	struct json_object *jdimm;
+	struct list_job *job;
 
 	if (!list.configured && !list.idle && !ndctl_dimm_is_enabled(dimm))
 		return;
@@ -336,36 +445,17 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *ctx)
 			json_object_object_add(lfa->jbus, "dimms", lfa->jdimms);
 	}
 
-	jdimm = util_dimm_to_json(dimm, lfa->flags);
-	if (!jdimm) {
+	job = list_job_add(LIST_JOB_DIMM, dimm, lfa->flags, lfa->jdimms);
+	if (!job) {
 		fail("\n");
 		return;
 	}
-
-	if (list.health) {
-		struct json_object *jhealth;
-
-		jhealth = util_dimm_health_to_json(dimm);
-		if (jhealth)
-			json_object_object_add(jdimm, "health", jhealth);
-		else if (ndctl_dimm_is_cmd_supported(dimm, ND_CMD_SMART)) {
-			/*
-			 * Failed to retrieve health data from a dimm
-			 * that otherwise supports smart data retrieval
-			 * commands.
-			 */
-			fail("\n");
-			return;
-		}
-	}
-
-	/*
-	 * Without a bus we are collecting dimms anonymously across the
-	 * platform.
-	 */
-	json_object_array_add(lfa->jdimms, jdimm);
+	job->smart = health.smart;
+	job->threshold = health.threshold;
 }
 
+static void list_flush(struct list_filter_arg *lfa);
+
 static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
 {
 	struct list_filter_arg *lfa = ctx->list;
@@ -375,17 +465,31 @@ static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
 	 * been added as a child of a parent object on the last
 	 * iteration.
 	 */
-	if (lfa->jbuses) {
+	if (stream)
+		list_flush(lfa);
+	else if (lfa->jbuses) {
 		lfa->jdimms = NULL;
 		lfa->jregion = NULL;
 		lfa->jregions = NULL;
 		lfa->jnamespaces = NULL;
+		pending.cur_region = -1;
+	}
+
+	health.smart = NULL;
+	health.threshold = NULL;
+	if (list.dimms && list.health) {
+		health.smart = ndctl_bus_cmd_batch_dimms(bus,
+				ndctl_dimm_cmd_new_smart);
+		health.threshold = ndctl_bus_cmd_batch_dimms(bus,
+				ndctl_dimm_cmd_new_smart_threshold);
+		health_batch_keep(health.smart);
+		health_batch_keep(health.threshold);
 	}
 
 	if (!list.buses)
 		return true;
 
-	if (!lfa->jbuses) {
+	if (!stream && !lfa->jbuses) {
 		lfa->jbuses = json_object_new_array();
 		if (!lfa->jbuses) {
 			fail("\n");
@@ -399,10 +503,139 @@ static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *ctx)
 		return false;
 	}
 
-	json_object_array_add(lfa->jbuses, lfa->jbus);
+	if (!stream)
+		json_object_array_add(lfa->jbuses, lfa->jbus);
 	return true;
 }
 
+static void list_job_run(struct list_job *job)
+{
+	struct json_object *jhealth;
+	struct ndctl_dimm *dimm;
+
+	switch (job->type) {
+	case LIST_JOB_DIMM:
+		dimm = job->dev;
+		job->jobj = util_dimm_to_json(dimm, job->flags);
+		if (!job->jobj || !list.health)
+			break;
+		jhealth = util_dimm_health_batch_to_json(dimm, job->smart,
+				job->threshold);
+		if (jhealth)
+			json_object_object_add(job->jobj, "health", jhealth);
+		else if (ndctl_dimm_is_cmd_supported(dimm, ND_CMD_SMART)) {
+			/*
+			 * Failed to retrieve health data from a dimm
+			 * that otherwise supports smart data retrieval
+			 * commands.
+			 */
+			json_object_put(job->jobj);
+			job->jobj = NULL;
+		}
+		break;
+	case LIST_JOB_REGION:
+		job->jobj = region_to_json(job->dev, job->flags);
+		break;
+	case LIST_JOB_NAMESPACE:
+		job->jobj = util_namespace_to_json(job->dev, job->flags);
+		break;
+	}
+	job->failed = !job->jobj;
+}
+
+static void *list_job_group(struct list_job *job)
+{
+	if (job->type == LIST_JOB_NAMESPACE)
+		return ndctl_namespace_get_region(job->dev);
+	return job->dev;
+}
+
+/* @arg holds the first job of every group, and pending.nr at the end */
+static void list_group_run(void *arg, int idx)
+{
+	int *groups = arg, i;
+
+	for (i = groups[idx]; i < groups[idx + 1]; i++)
+		list_job_run(&pending.jobs[i]);
+}
+
+static void list_jobs_run(void)
+{
+	struct util_pool pool = {
+		.jobs = max(list.jobs, 1U),
+		.run = list_group_run,
+	};
+	struct list_job *job;
+	int i, *groups;
+
+	/* consecutive jobs of one region run in order on one thread */
+	groups = calloc(pending.nr + 1, sizeof(*groups));
+	for (i = 0; groups && i < pending.nr; i++)
+		if (!i || list_job_group(&pending.jobs[i])
+				!= list_job_group(&pending.jobs[i - 1]))
+			groups[pool.nr++] = i;
+	if (groups) {
+		groups[pool.nr] = pending.nr;
+		pool.arg = groups;
+		util_pool_run(&pool);
+	} else
+		for (i = 0; i < pending.nr; i++)
+			list_job_run(&pending.jobs[i]);
+	free(groups);
+
+	for (i = 0; i < pending.nr; i++) {
+		job = &pending.jobs[i];
+		if (job->parent >= 0 && pending.jobs[job->parent].failed) {
+			/* as if the walk had skipped the region's children */
+			json_object_put(job->jobj);
+			continue;
+		}
+		if (job->failed) {
+			fail("\n");
+			if (job->jnamespaces)
+				json_object_put(job->jnamespaces);
+			continue;
+		}
+		json_object_array_add(job->jarray, job->jobj);
+		if (job->jnamespaces)
+			json_object_object_add(job->jobj, "namespaces",
+					job->jnamespaces);
+	}
+	free(pending.jobs);
+	pending.jobs = NULL;
+	pending.nr = 0;
+}
+
+/* finish the records queued so far and hand the top-level ones out */
+static void list_flush(struct list_filter_arg *lfa)
+{
+	struct json_object **jtop;
+
+	list_jobs_run();
+	health_batch_free();
+
+	if (list.buses) {
+		util_json_stream_add(stream, lfa->jbus);
+		lfa->jbus = NULL;
+	} else {
+		if (list.dimms)
+			jtop = &lfa->jdimms;
+		else if (list.regions)
+			jtop = &lfa->jregions;
+		else
+			jtop = &lfa->jnamespaces;
+		if (*jtop)
+			util_json_stream_add_array(stream, *jtop);
+	}
+
+	/* whatever these pointed at has been written out with its parent */
+	lfa->jdimms = NULL;
+	lfa->jregion = NULL;
+	lfa->jregions = NULL;
+	lfa->jnamespaces = NULL;
+	pending.cur_region = -1;
+}
+
 static int list_display(struct list_filter_arg *lfa)
 {
 	struct json_object *jnamespaces = lfa->jnamespaces;
@@ -427,6 +660,7 @@ static int list_display(struct list_filter_arg *lfa)
 		if (jnamespaces && !jregions)
 			json_object_object_add(jplatform, "namespaces",
 					jnamespaces);
+		util_json_fields_prune(jplatform, lfa->flags);
 		printf("%s\n", json_object_to_json_string_ext(jplatform,
 					JSON_C_TO_STRING_PRETTY));
 		json_object_put(jplatform);
@@ -439,11 +673,225 @@ static int list_display(struct list_filter_arg *lfa)
 	return 0;
 }
 
+/* objects are told apart by these, "chardev" for device-dax instances */
+static const char * const list_keys[] = { "dev", "chardev", NULL };
+static const char * const list_subsystems[] = { "nd", "dax", NULL };
+
+/* debounce, a region reconfiguration is a burst of uevents */
+#define LIST_WATCH_SETTLE_MS 100
+
+static int list_snap(struct list_filter_arg *lfa, struct util_json_snap *snap)
+{
+	int rc;
+
+	util_json_fields_prune(lfa->jbuses, lfa->flags);
+	util_json_fields_prune(lfa->jdimms, lfa->flags);
+	util_json_fields_prune(lfa->jregions, lfa->flags);
+	util_json_fields_prune(lfa->jnamespaces, lfa->flags);
+
+	if (lfa->jbuses)
+		return util_json_snap_add(snap, lfa->jbuses, list_keys);
+	rc = util_json_snap_add(snap, lfa->jdimms, list_keys);
+	if (!rc)
+		rc = util_json_snap_add(snap, lfa->jregions, list_keys);
+	if (!rc && !lfa->jregions)
+		rc = util_json_snap_add(snap, lfa->jnamespaces, list_keys);
+	return rc;
+}
+
+static void list_clear(struct list_filter_arg *lfa)
+{
+	lfa->jbuses = NULL;
+	lfa->jbus = NULL;
+	lfa->jdimms = NULL;
+	lfa->jregion = NULL;
+	lfa->jregions = NULL;
+	lfa->jnamespaces = NULL;
+}
+
+/* drop what list_display() would have consumed */
+static void list_put(struct list_filter_arg *lfa)
+{
+	if (lfa->jbuses)
+		json_object_put(lfa->jbuses);
+	else {
+		json_object_put(lfa->jdimms);
+		json_object_put(lfa->jregions);
+		if (!lfa->jregions)
+			json_object_put(lfa->jnamespaces);
+	}
+	list_clear(lfa);
+}
+
+static int list_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx)
+{
+	int rc;
+
+	pending.cur_region = -1;
+	rc = util_filter_walk(ctx, fctx, &param);
+	list_jobs_run();
+	health_batch_free();
+	return rc;
+}
+
+/* uevent socket first, then a health eventfd per dimm when listing health */
+static struct pollfd *list_watch_fds(struct ndctl_ctx *ctx, int ufd, int *nfds)
+{
+	struct ndctl_dimm *dimm;
+	struct ndctl_bus *bus;
+	struct pollfd *fds;
+	char buf;
+	int n = 1;
+
+	if (list.health)
+		ndctl_bus_foreach(ctx, bus)
+			ndctl_dimm_foreach(bus, dimm)
+				n++;
+	fds = calloc(n, sizeof(*fds));
+	if (!fds)
+		return NULL;
+	fds[0].fd = ufd;
+	fds[0].events = POLLIN;
+	n = 1;
+	if (list.health)
+		ndctl_bus_foreach(ctx, bus)
+			ndctl_dimm_foreach(bus, dimm) {
+				int fd = ndctl_dimm_get_health_eventfd(dimm);
+
+				/* notifications are edge triggered, arm it */
+				if (fd < 0 || pread(fd, &buf, 1, 0) < 0)
+					continue;
+				fds[n].fd = fd;
+				fds[n].events = POLLPRI;
+				n++;
+			}
+	*nfds = n;
+	return fds;
+}
+
+static bool list_watch_drain(struct pollfd *fds, int nfds)
+{
+	bool changed = false;
+	char buf;
+	int i;
+
+	if (fds[0].revents & POLLIN)
+		changed |= util_uevent_match(fds[0].fd, list_subsystems);
+	for (i = 1; i < nfds; i++)
+		if (fds[i].revents & (POLLPRI | POLLERR)) {
+			pread(fds[i].fd, &buf, 1, 0);
+			changed = true;
+		}
+	return changed;
+}
+
+/*
+ * Print the listing once, then one JSON object per line for every
+ * object added, removed, or whose attributes changed, see
+ * util_json_snap_diff(). Each change re-runs the whole walk against
+ * a fresh context, so what is compared is exactly what 'ndctl list'
+ * would have printed with the same options.
+ */
+static int list_watch(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx)
+{
+	struct list_filter_arg *lfa = fctx->list;
+	struct util_json_snap prev = { 0 }, cur = { 0 };
+	struct ndctl_ctx *wctx = ndctl_ref(ctx);
+	struct pollfd *fds = NULL;
+	int ufd, nfds, rc;
+	bool changed;
+
+	ufd = util_uevent_open();
+	if (ufd < 0) {
+		error("failed to listen for uevents: %s\n", strerror(-ufd));
+		ndctl_unref(wctx);
+		return ufd;
+	}
+
+	rc = list_snap(lfa, &prev);
+	if (rc) {
+		list_put(lfa);
+		goto out;
+	}
+	rc = list_display(lfa);
+	list_clear(lfa);
+	if (rc)
+		goto out;
+	fflush(stdout);
+
+	for (;;) {
+		struct ndctl_ctx *next;
+
+		free(fds);
+		fds = list_watch_fds(wctx, ufd, &nfds);
+		if (!fds) {
+			rc = -ENOMEM;
+			break;
+		}
+
+		if (poll(fds, nfds, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = -errno;
+			break;
+		}
+		changed = list_watch_drain(fds, nfds);
+		while (poll(fds, nfds, LIST_WATCH_SETTLE_MS) > 0)
+			changed |= list_watch_drain(fds, nfds);
+		if (!changed)
+			continue;
+
+		rc = ndctl_new(&next);
+		if (rc)
+			break;
+		ndctl_set_log_priority(next, ndctl_get_log_priority(wctx));
+		ndctl_set_smart_ttl(next, ndctl_get_smart_ttl(wctx));
+		free(fds);
+		fds = NULL;
+		ndctl_unref(wctx);
+		wctx = next;
+
+		did_fail = 0;
+		rc = list_walk(wctx, fctx);
+		if (!rc)
+			rc = list_snap(lfa, &cur);
+		list_put(lfa);
+		if (rc || did_fail) {
+			util_json_snap_free(&cur);
+			error("failed to re-list, keeping the previous state\n");
+			continue;
+		}
+		util_json_snap_diff(stdout, &prev, &cur);
+		util_json_snap_free(&prev);
+		prev = cur;
+		memset(&cur, 0, sizeof(cur));
+	}
+out:
+	free(fds);
+	util_json_snap_free(&prev);
+	close(ufd);
+	ndctl_unref(wctx);
+	return rc;
+}
+
 static int num_list_flags(void)
 {
 	return list.buses + list.dimms + list.regions + list.namespaces;
 }
 
+/*
+ * Without buses the dimm, region and namespace arrays are only wrapped in
+ * a "platform" object when more than one of them turns out non-empty,
+ * which is not known until the walk is done.
+ */
+static bool list_can_stream(void)
+{
+	if (list.buses)
+		return true;
+	return list.dimms + list.regions
+		+ (list.namespaces && !list.regions) == 1;
+}
+
 int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 {
 	const struct option options[] = {
@@ -481,6 +929,12 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 				"use human friendly number formats "),
 		OPT_INCR('v', "verbose", &list.verbose,
 				"increase output detail"),
+		OPT_UINTEGER('j', "jobs", &list.jobs,
+				"build up to <n> device records at once"),
+		OPT_STRING('\0', "fields", &list.fields, "field[,field...]",
+				"only collect and print these attributes"),
+		OPT_BOOLEAN('\0', "watch", &list.watch,
+				"keep running and print changes as they happen"),
 		OPT_END(),
 	};
 	const char * const u[] = {
@@ -490,6 +944,7 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 	bool lint = !!secure_getenv("NDCTL_LIST_LINT");
 	struct util_filter_ctx fctx = { 0 };
 	struct list_filter_arg lfa = { 0 };
+	struct util_json_stream out;
 	int i, rc;
 
         argc = parse_options(argc, argv, options, u, 0);
@@ -536,6 +991,16 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 	if (num_list_flags() == 0)
 		list.namespaces = true;
 
+	if (list.fields) {
+		if (util_json_fields_parse(list.fields)) {
+			error("invalid --fields \"%s\"\n", list.fields);
+			usage_with_options(u, options);
+		}
+		/* no SMART commands for health nobody asked for */
+		if (!util_json_want(UTIL_JSON_FIELDS, "health"))
+			list.health = false;
+	}
+
 	fctx.filter_bus = filter_bus;
 	fctx.filter_dimm = list.dimms ? filter_dimm : NULL;
 	fctx.filter_region = filter_region;
@@ -543,7 +1008,29 @@ int cmd_list(int argc, const char **argv, struct ndctl_ctx *ctx)
 	fctx.list = &lfa;
 	lfa.flags = listopts_to_flags();
 
+	if (list.watch) {
+		rc = list_walk(ctx, &fctx);
+		if (rc || did_fail) {
+			list_put(&lfa);
+			return rc ? rc : -ENOMEM;
+		}
+		return list_watch(ctx, &fctx);
+	}
+
+	if (list_can_stream()) {
+		util_json_stream_init(&out, stdout, lfa.flags);
+		stream = &out;
+	}
+
 	rc = util_filter_walk(ctx, &fctx, &param);
+	if (stream) {
+		list_flush(&lfa);
+		util_json_stream_end(stream);
+		stream = NULL;
+	} else {
+		list_jobs_run();
+		health_batch_free();
+	}
 	if (rc)
 		return rc;
 
@@ -10,12 +10,15 @@
 #include <sys/stat.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <time.h>
 #include <keyutils.h>
 #include <util/json.h>
 #include <util/filter.h>
 #include <json-c/json.h>
 #include <ndctl/libndctl.h>
 #include <util/parse-options.h>
+#include <util/pool.h>
+#include <ccan/minmax/minmax.h>
 #include <ccan/array_size/array_size.h>
 #include <util/keys.h>
 #include <ndctl.h>
@@ -23,7 +26,11 @@
 static struct parameters {
 	const char *key_path;
 	const char *tpm_handle;
-} param;
+	unsigned int jobs;
+	bool unlock;
+} param = {
+	.jobs = 16,
+};
 
 static const char *key_names[] = {"user", "trusted", "encrypted"};
 
@@ -31,8 +38,26 @@ static struct loadkeys {
 	enum key_type key_type;
 	DIR *dir;
 	int dirfd;
+	/* ids of the dimm passphrases loaded by this run */
+	char **ids;
+	int nr_ids;
 } loadkey_ctx;
 
+static int loadkeys_add_id(struct loadkeys *lk_ctx, const char *id)
+{
+	char **ids;
+
+	ids = realloc(lk_ctx->ids, (lk_ctx->nr_ids + 1) * sizeof(*ids));
+	if (!ids)
+		return -ENOMEM;
+	lk_ctx->ids = ids;
+	ids[lk_ctx->nr_ids] = strdup(id);
+	if (!ids[lk_ctx->nr_ids])
+		return -ENOMEM;
+	lk_ctx->nr_ids++;
+	return 0;
+}
+
 static int load_master_key(struct loadkeys *lk_ctx, const char *keypath)
 {
 	key_serial_t key;
@@ -137,8 +162,11 @@ static int load_dimm_keys(struct loadkeys *lk_ctx)
 		if (key < 0)
 			fprintf(stderr, "add_key failed: %s\n",
 					strerror(errno));
-		else
+		else {
 			count++;
+			if (param.unlock)
+				loadkeys_add_id(lk_ctx, id);
+		}
 		free(fname);
 		free(blob);
 	}
@@ -228,6 +256,150 @@ static int load_keys(struct loadkeys *lk_ctx, const char *keypath,
 	return rc;
 }
 
+/*
+ * The kernel unlocks a dimm from its passphrase in the keyring when the
+ * dimm is enabled, so a dimm left locked because its key was not loaded
+ * in time is unlocked by cycling it. Each cycle is a round of security
+ * DSMs on that dimm alone, so the dimms are cycled side by side.
+ */
+struct unlock_job {
+	struct ndctl_dimm *dimm;
+	unsigned long long ns;
+	int rc;
+};
+
+static struct unlock_queue {
+	struct unlock_job *jobs;
+	int nr;
+} unlock_queue;
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* keys this run loaded are known, anything else is searched for once */
+static bool dimm_has_key(struct loadkeys *lk_ctx, struct ndctl_dimm *dimm)
+{
+	const char *id = ndctl_dimm_get_unique_id(dimm);
+	char desc[ND_KEY_DESC_SIZE];
+	int i;
+
+	if (!id)
+		return false;
+	for (i = 0; i < lk_ctx->nr_ids; i++)
+		if (strcmp(lk_ctx->ids[i], id) == 0)
+			return true;
+	if (snprintf(desc, sizeof(desc), "nvdimm:%s", id) >= (int) sizeof(desc))
+		return false;
+	return keyctl_search(KEY_SPEC_USER_KEYRING, "encrypted", desc,
+			0) > 0;
+}
+
+static void unlock_dimm(struct unlock_job *job)
+{
+	struct ndctl_dimm *dimm = job->dimm;
+	unsigned long long start;
+
+	/* no key, nothing to try */
+	if (job->rc)
+		return;
+
+	start = now_ns();
+	if (ndctl_dimm_is_enabled(dimm))
+		job->rc = ndctl_dimm_disable(dimm);
+	if (job->rc == 0)
+		job->rc = ndctl_dimm_enable(dimm);
+	if (job->rc == 0 && ndctl_dimm_get_security(dimm)
+			== NDCTL_SECURITY_LOCKED)
+		job->rc = -EACCES;
+	job->ns = now_ns() - start;
+}
+
+static void unlock_worker(void *arg, int idx)
+{
+	struct unlock_queue *q = arg;
+
+	unlock_dimm(&q->jobs[idx]);
+}
+
+static struct json_object *unlock_job_to_json(struct unlock_job *job)
+{
+	struct json_object *jdimm = json_object_new_object();
+
+	if (!jdimm)
+		return NULL;
+	json_object_object_add(jdimm, "dev", json_object_new_string(
+				ndctl_dimm_get_devname(job->dimm)));
+	json_object_object_add(jdimm, "id", json_object_new_string(
+				ndctl_dimm_get_unique_id(job->dimm)));
+	json_object_object_add(jdimm, "unlocked",
+			json_object_new_boolean(job->rc == 0));
+	if (job->ns)
+		json_object_object_add(jdimm, "time_us",
+				json_object_new_int64(job->ns / 1000));
+	if (job->rc)
+		json_object_object_add(jdimm, "error", json_object_new_string(
+					job->rc == -ENOKEY ? "no passphrase loaded"
+					: strerror(-job->rc)));
+	return jdimm;
+}
+
+static int unlock_dimms(struct loadkeys *lk_ctx, struct ndctl_ctx *ctx)
+{
+	struct unlock_queue *q = &unlock_queue;
+	struct json_object *jdimms, *jdimm;
+	struct unlock_job *job;
+	struct ndctl_dimm *dimm;
+	struct ndctl_bus *bus;
+	struct util_pool pool = {
+		.arg = q,
+		.jobs = max(param.jobs, 1U),
+		.run = unlock_worker,
+	};
+	int i, rc = 0;
+
+	ndctl_bus_foreach(ctx, bus)
+		ndctl_dimm_foreach(bus, dimm) {
+			if (ndctl_dimm_get_security(dimm)
+					!= NDCTL_SECURITY_LOCKED)
+				continue;
+			job = realloc(q->jobs, (q->nr + 1) * sizeof(*job));
+			if (!job)
+				return -ENOMEM;
+			q->jobs = job;
+			job = &q->jobs[q->nr++];
+			job->dimm = dimm;
+			job->ns = 0;
+			job->rc = dimm_has_key(lk_ctx, dimm) ? 0 : -ENOKEY;
+		}
+	if (!q->nr) {
+		printf("no locked nvdimms\n");
+		return 0;
+	}
+
+	pool.nr = q->nr;
+	util_pool_run(&pool);
+
+	jdimms = json_object_new_array();
+	for (i = 0; i < q->nr; i++) {
+		if (q->jobs[i].rc && !rc)
+			rc = q->jobs[i].rc;
+		jdimm = unlock_job_to_json(&q->jobs[i]);
+		if (jdimms && jdimm)
+			json_object_array_add(jdimms, jdimm);
+	}
+	if (jdimms)
+		util_display_json_array(stdout, jdimms, 0);
+
+	free(q->jobs);
+	memset(q, 0, sizeof(*q));
+	return rc;
+}
+
 int cmd_load_keys(int argc, const char **argv, struct ndctl_ctx *ctx)
 {
 	const struct option options[] = {
@@ -235,13 +407,17 @@ int cmd_load_keys(int argc, const char **argv, struct ndctl_ctx *ctx)
 				"override the default key path"),
 		OPT_STRING('t', "tpm-handle", &param.tpm_handle, "tpm-handle",
 				"TPM handle for trusted key"),
+		OPT_BOOLEAN('u', "unlock", &param.unlock,
+				"unlock the locked nvdimms once the keys are loaded"),
+		OPT_UINTEGER('j', "jobs", &param.jobs,
+				"with --unlock, unlock up to <n> nvdimms at once (default 16)"),
 		OPT_END(),
 	};
 	const char *const u[] = {
 		"ndctl load-keys [<options>]",
 		NULL
 	};
-	int i;
+	int i, rc;
 
 	argc = parse_options(argc, argv, options, u, 0);
 	for (i = 0; i < argc; i++)
@@ -252,5 +428,12 @@ int cmd_load_keys(int argc, const char **argv, struct ndctl_ctx *ctx)
 	if (!param.key_path)
 		param.key_path = strdup(NDCTL_KEYS_DIR);
 
-	return load_keys(&loadkey_ctx, param.key_path, param.tpm_handle);
+	rc = load_keys(&loadkey_ctx, param.key_path, param.tpm_handle);
+	if (rc == 0 && param.unlock)
+		rc = unlock_dimms(&loadkey_ctx, ctx);
+
+	for (i = 0; i < loadkey_ctx.nr_ids; i++)
+		free(loadkey_ctx.ids[i]);
+	free(loadkey_ctx.ids);
+	return rc;
 }
@@ -2,6 +2,8 @@
 // Copyright (C) 2018, FUJITSU LIMITED. All rights reserved.
 
 #include <stdio.h>
+#include <limits.h>
+#include <unistd.h>
 #include <json-c/json.h>
 #include <libgen.h>
 #include <time.h>
@@ -11,11 +13,14 @@
 #include <util/util.h>
 #include <util/parse-options.h>
 #include <util/strbuf.h>
+#include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
 #include <ndctl/config.h>
 #include <ndctl/ndctl.h>
 #include <ndctl/libndctl.h>
 #include <sys/epoll.h>
-#define BUF_SIZE 2048
+#include <sys/socket.h>
+#include <netdb.h>
 
 /* reuse the core log helpers for the monitor logger */
 #ifndef ENABLE_LOGGING
@@ -25,12 +30,13 @@
 #define ENABLE_DEBUG
 #endif
 #include <util/log.h>
+#include <util/monitor.h>
 
 static struct monitor {
 	const char *log;
 	const char *config_file;
 	const char *dimm_event;
-	FILE *log_file;
+	const char *exporter;
 	bool daemon;
 	bool human;
 	bool verbose;
@@ -44,9 +50,53 @@ struct monitor_dimm {
 	int health_eventfd;
 	unsigned int health;
 	unsigned int event_flags;
+	/* monitored events last reported, repeats are not notified */
+	unsigned int notified;
+	bool queued;
+	/* what the exporter serves, refreshed whenever the dimm is checked */
+	struct monitor_smart {
+		unsigned int flags;
+		unsigned int health;
+		unsigned int temperature;
+		unsigned int ctrl_temperature;
+		unsigned int spares;
+		unsigned int life_used;
+		unsigned int shutdown_count;
+		unsigned int alarm_flags;
+		bool valid;
+		unsigned long long perf[NDCTL_PERF_STAT_MAX];
+		unsigned long long perf_valid;
+	} smart;
+	unsigned long long events[5];
 	struct list_node list;
+	struct list_node wheel;
+	struct list_node ready;
 };
 
+/*
+ * Health checks are scheduled on a timer wheel whose slots together
+ * span one poll interval, with the dimms spread across the slots so a
+ * large host never checks them all at once. A checked dimm, whether its
+ * slot came up or its health event fired, goes back in the slot a full
+ * interval ahead. Due dimms wait on the ready list, at most once each,
+ * and are checked MONITOR_BATCH at a time no more often than every
+ * MONITOR_BATCH_MS, which bounds the SMART traffic a burst of events,
+ * or a slot falling due, can cause.
+ */
+#define MONITOR_WHEEL_SLOTS 64
+#define MONITOR_BATCH 32
+#define MONITOR_BATCH_MS 100
+
+static struct {
+	struct list_head slots[MONITOR_WHEEL_SLOTS];
+	unsigned int nr_slots;
+	unsigned int cur;
+	unsigned long long tick_ms;
+	unsigned long long next_ms;
+	unsigned long long batch_ms;
+	struct list_head ready;
+} wheel;
+
 static struct util_filter_params param;
 
 static int did_fail;
@@ -58,38 +108,6 @@ do { \
 			VERSION, __func__, __LINE__, ##__VA_ARGS__); \
 } while (0)
 
-static void log_syslog(struct log_ctx *ctx, int priority, const char *file,
-		int line, const char *fn, const char *format, va_list args)
-{
-	vsyslog(priority, format, args);
-}
-
-static void log_standard(struct log_ctx *ctx, int priority, const char *file,
-		int line, const char *fn, const char *format, va_list args)
-{
-	if (priority == 6)
-		vfprintf(stdout, format, args);
-	else
-		vfprintf(stderr, format, args);
-}
-
-static void log_file(struct log_ctx *ctx, int priority, const char *file,
-		int line, const char *fn, const char *format, va_list args)
-{
-	FILE *f = monitor.log_file;
-
-	if (priority != LOG_NOTICE) {
-		struct timespec ts;
-
-		clock_gettime(CLOCK_REALTIME, &ts);
-		fprintf(f, "[%10ld.%09ld] [%d] ", ts.tv_sec, ts.tv_nsec, getpid());
-		vfprintf(f, format, args);
-	} else
-		vfprintf(f, format, args);
-
-	fflush(f);
-}
-
 static struct json_object *dimm_event_to_json(struct monitor_dimm *mdimm)
 {
 	struct json_object *jevent, *jobj;
@@ -177,12 +195,12 @@ static int notify_dimm_event(struct monitor_dimm *mdimm)
 		json_object_object_add(jmsg, "event", jobj);
 
 	jdimm = util_dimm_to_json(mdimm->dimm, 0);
-	if (jdimm)
+	if (jdimm) {
 		json_object_object_add(jmsg, "dimm", jdimm);
-
-	jobj = util_dimm_health_to_json(mdimm->dimm);
-	if (jobj)
-		json_object_object_add(jdimm, "health", jobj);
+		jobj = util_dimm_health_to_json(mdimm->dimm);
+		if (jobj)
+			json_object_object_add(jdimm, "health", jobj);
+	}
 
 	if (monitor.human)
 		notice(&monitor, "%s\n", json_object_to_json_string_ext(jmsg,
@@ -191,12 +209,384 @@ static int notify_dimm_event(struct monitor_dimm *mdimm)
 		notice(&monitor, "%s\n", json_object_to_json_string_ext(jmsg,
 						JSON_C_TO_STRING_PLAIN));
 
-	free(jobj);
-	free(jdimm);
-	free(jmsg);
+	json_object_put(jmsg);
 	return 0;
 }
 
+/* in the order of monitor_dimm.events[] */
+static const struct monitor_event_name {
+	unsigned int flag;
+	const char *name;
+} monitor_events[] = {
+	{ ND_EVENT_SPARES_REMAINING, "dimm-spares-remaining" },
+	{ ND_EVENT_MEDIA_TEMPERATURE, "dimm-media-temperature" },
+	{ ND_EVENT_CTRL_TEMPERATURE, "dimm-controller-temperature" },
+	{ ND_EVENT_HEALTH_STATE, "dimm-health-state" },
+	{ ND_EVENT_UNCLEAN_SHUTDOWN, "dimm-unclean-shutdown" },
+};
+
+/* count the events in @flags that were not already outstanding */
+static void monitor_count_events(struct monitor_dimm *mdimm,
+		unsigned int flags)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(monitor_events); i++)
+		if (flags & ~mdimm->notified & monitor_events[i].flag)
+			mdimm->events[i]++;
+}
+
+/*
+ * Only called as part of a health check, so serving the exporter never
+ * costs a DSM. A failed read keeps the last good values.
+ */
+static void monitor_smart_refresh(struct monitor_dimm *mdimm)
+{
+	struct monitor_smart *smart = &mdimm->smart;
+	struct ndctl_cmd *cmd;
+
+	if (!monitor.exporter)
+		return;
+
+	/* sysfs, not a DSM, and only on platforms that keep them */
+	if (ndctl_dimm_get_perf_stats(mdimm->dimm, smart->perf,
+				ARRAY_SIZE(smart->perf), &smart->perf_valid) < 0)
+		smart->perf_valid = 0;
+
+	cmd = ndctl_dimm_cmd_new_smart(mdimm->dimm);
+	if (!cmd)
+		return;
+	if (ndctl_cmd_submit_xlat(cmd) < 0) {
+		dbg(&monitor, "%s: smart read failed\n",
+				ndctl_dimm_get_devname(mdimm->dimm));
+		ndctl_cmd_unref(cmd);
+		return;
+	}
+
+	smart->flags = ndctl_cmd_smart_get_flags(cmd);
+	if (smart->flags & ND_SMART_HEALTH_VALID)
+		smart->health = ndctl_cmd_smart_get_health(cmd);
+	if (smart->flags & ND_SMART_TEMP_VALID)
+		smart->temperature = ndctl_cmd_smart_get_temperature(cmd);
+	if (smart->flags & ND_SMART_CTEMP_VALID)
+		smart->ctrl_temperature =
+			ndctl_cmd_smart_get_ctrl_temperature(cmd);
+	if (smart->flags & ND_SMART_SPARES_VALID)
+		smart->spares = ndctl_cmd_smart_get_spares(cmd);
+	if (smart->flags & ND_SMART_USED_VALID)
+		smart->life_used = ndctl_cmd_smart_get_life_used(cmd);
+	if (smart->flags & ND_SMART_SHUTDOWN_COUNT_VALID)
+		smart->shutdown_count = ndctl_cmd_smart_get_shutdown_count(cmd);
+	if (smart->flags & ND_SMART_ALARM_VALID)
+		smart->alarm_flags = ndctl_cmd_smart_get_alarm_flags(cmd);
+	smart->valid = true;
+	ndctl_cmd_unref(cmd);
+}
+
+/*
+ * The exporter answers one request per connection from the monitor's
+ * own loop. A client gets EXPORTER_IO_MS to send its request and take
+ * the reply, so a stalled scraper only delays the next health check.
+ */
+#define EXPORTER_IO_MS 1000
+
+static struct {
+	int fd;
+	struct list_head *dimms;
+} exporter = {
+	.fd = -1,
+};
+
+static int exporter_listen(const char *spec)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+		.ai_flags = AI_PASSIVE,
+	}, *res, *ai;
+	char *host, *port;
+	int fd = -1, one = 1, rc;
+
+	host = strdup(spec);
+	if (!host)
+		return -ENOMEM;
+	port = strrchr(host, ':');
+	if (!port || !port[1]) {
+		err(&monitor, "exporter: expected [<addr>]:<port>, got '%s'\n",
+				spec);
+		free(host);
+		return -EINVAL;
+	}
+	*port++ = '\0';
+	if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+		host[strlen(host) - 1] = '\0';
+		memmove(host, host + 1, strlen(host));
+	}
+
+	rc = getaddrinfo(host[0] ? host : NULL, port, &hints, &res);
+	if (rc) {
+		err(&monitor, "exporter: %s: %s\n", spec, gai_strerror(rc));
+		free(host);
+		return -EINVAL;
+	}
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+				ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0
+				&& listen(fd, 16) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	rc = fd < 0 ? -errno : 0;
+	freeaddrinfo(res);
+	free(host);
+	if (rc) {
+		err(&monitor, "exporter: %s: %s\n", spec, strerror(-rc));
+		return rc;
+	}
+	info(&monitor, "exporter listening on %s\n", spec);
+	return fd;
+}
+
+static void metric_header(struct strbuf *sb, const char *name,
+		const char *type, const char *unit, const char *help)
+{
+	strbuf_addf(sb, "# TYPE %s %s\n", name, type);
+	if (unit)
+		strbuf_addf(sb, "# UNIT %s %s\n", name, unit);
+	strbuf_addf(sb, "# HELP %s %s\n", name, help);
+}
+
+enum exporter_field {
+	EXP_TEMPERATURE,
+	EXP_CTRL_TEMPERATURE,
+	EXP_SPARES,
+	EXP_LIFE_USED,
+	EXP_SHUTDOWN_COUNT,
+};
+
+static const struct exporter_gauge {
+	const char *name;
+	const char *unit;
+	const char *help;
+	unsigned int valid;
+} exporter_gauges[] = {
+	[EXP_TEMPERATURE] = { "ndctl_dimm_media_temperature_celsius",
+		"celsius", "Media temperature.", ND_SMART_TEMP_VALID },
+	[EXP_CTRL_TEMPERATURE] = { "ndctl_dimm_controller_temperature_celsius",
+		"celsius", "Controller temperature.", ND_SMART_CTEMP_VALID },
+	[EXP_SPARES] = { "ndctl_dimm_spares_percent", "percent",
+		"Spare capacity remaining.", ND_SMART_SPARES_VALID },
+	[EXP_LIFE_USED] = { "ndctl_dimm_life_used_percent", "percent",
+		"Rated lifetime used.", ND_SMART_USED_VALID },
+	[EXP_SHUTDOWN_COUNT] = { "ndctl_dimm_unsafe_shutdowns", NULL,
+		"Unsafe shutdown count.", ND_SMART_SHUTDOWN_COUNT_VALID },
+};
+
+static void exporter_gauge_value(struct strbuf *sb, enum exporter_field f,
+		struct monitor_dimm *mdimm)
+{
+	const struct monitor_smart *smart = &mdimm->smart;
+	const char *name = exporter_gauges[f].name;
+	const char *dev = ndctl_dimm_get_devname(mdimm->dimm);
+
+	switch (f) {
+	case EXP_TEMPERATURE:
+		strbuf_addf(sb, "%s{dimm=\"%s\"} %g\n", name, dev,
+			ndctl_decode_smart_temperature(smart->temperature));
+		break;
+	case EXP_CTRL_TEMPERATURE:
+		strbuf_addf(sb, "%s{dimm=\"%s\"} %g\n", name, dev,
+			ndctl_decode_smart_temperature(smart->ctrl_temperature));
+		break;
+	case EXP_SPARES:
+		strbuf_addf(sb, "%s{dimm=\"%s\"} %u\n", name, dev,
+				smart->spares);
+		break;
+	case EXP_LIFE_USED:
+		strbuf_addf(sb, "%s{dimm=\"%s\"} %u\n", name, dev,
+				smart->life_used);
+		break;
+	case EXP_SHUTDOWN_COUNT:
+		strbuf_addf(sb, "%s{dimm=\"%s\"} %u\n", name, dev,
+				smart->shutdown_count);
+		break;
+	}
+}
+
+/* render the metrics from what the last health checks recorded */
+static void exporter_render(struct strbuf *sb)
+{
+	static const struct {
+		unsigned int trip;
+		const char *name;
+	} alarms[] = {
+		{ ND_SMART_SPARE_TRIP, "spares" },
+		{ ND_SMART_TEMP_TRIP, "media_temperature" },
+		{ ND_SMART_CTEMP_TRIP, "controller_temperature" },
+	};
+	static const char * const health_states[] = {
+		"ok", "non-critical", "critical", "fatal",
+	};
+	unsigned long long perf_any = 0;
+	struct monitor_dimm *mdimm;
+	const char *dev;
+	unsigned int f, i;
+
+	for (f = 0; f < ARRAY_SIZE(exporter_gauges); f++) {
+		metric_header(sb, exporter_gauges[f].name, "gauge",
+				exporter_gauges[f].unit, exporter_gauges[f].help);
+		list_for_each(exporter.dimms, mdimm, list)
+			if (mdimm->smart.valid && (mdimm->smart.flags
+						& exporter_gauges[f].valid))
+				exporter_gauge_value(sb, f, mdimm);
+	}
+
+	metric_header(sb, "ndctl_dimm_health", "stateset", NULL,
+			"SMART health state.");
+	list_for_each(exporter.dimms, mdimm, list) {
+		unsigned int health = mdimm->smart.health, state;
+
+		if (!mdimm->smart.valid
+				|| !(mdimm->smart.flags & ND_SMART_HEALTH_VALID))
+			continue;
+		if (health & ND_SMART_FATAL_HEALTH)
+			state = 3;
+		else if (health & ND_SMART_CRITICAL_HEALTH)
+			state = 2;
+		else if (health & ND_SMART_NON_CRITICAL_HEALTH)
+			state = 1;
+		else
+			state = 0;
+		dev = ndctl_dimm_get_devname(mdimm->dimm);
+		for (i = 0; i < ARRAY_SIZE(health_states); i++)
+			strbuf_addf(sb, "ndctl_dimm_health{dimm=\"%s\",ndctl_dimm_health=\"%s\"} %d\n",
+				dev, health_states[i], i == state);
+	}
+
+	metric_header(sb, "ndctl_dimm_alarm", "gauge", NULL,
+			"SMART threshold alarm tripped.");
+	list_for_each(exporter.dimms, mdimm, list) {
+		if (!mdimm->smart.valid
+				|| !(mdimm->smart.flags & ND_SMART_ALARM_VALID))
+			continue;
+		dev = ndctl_dimm_get_devname(mdimm->dimm);
+		for (i = 0; i < ARRAY_SIZE(alarms); i++)
+			strbuf_addf(sb, "ndctl_dimm_alarm{dimm=\"%s\",alarm=\"%s\"} %d\n",
+				dev, alarms[i].name,
+				!!(mdimm->smart.alarm_flags & alarms[i].trip));
+	}
+
+	/* most platforms keep none of these, so skip the empty families */
+	list_for_each(exporter.dimms, mdimm, list)
+		perf_any |= mdimm->smart.perf_valid;
+	for (f = 0; f < NDCTL_PERF_STAT_MAX; f++) {
+		/* all but these two only ever count up */
+		bool gauge = f == NDCTL_PERF_LIFE_REMAINING
+			|| f == NDCTL_PERF_CRIT_RESOURCE_UTIL;
+		char name[64];
+
+		if (!(perf_any & (1ULL << f)))
+			continue;
+		snprintf(name, sizeof(name), "ndctl_dimm_perf_%s",
+				ndctl_perf_stat_name(f));
+		metric_header(sb, name, gauge ? "gauge" : "counter", NULL,
+				"Platform performance statistic.");
+		list_for_each(exporter.dimms, mdimm, list) {
+			if (!(mdimm->smart.perf_valid & (1ULL << f)))
+				continue;
+			strbuf_addf(sb, "%s%s{dimm=\"%s\"} %llu\n", name,
+				gauge ? "" : "_total",
+				ndctl_dimm_get_devname(mdimm->dimm),
+				mdimm->smart.perf[f]);
+		}
+	}
+
+	metric_header(sb, "ndctl_dimm_events", "counter", NULL,
+			"Monitored events reported since the monitor started.");
+	list_for_each(exporter.dimms, mdimm, list) {
+		dev = ndctl_dimm_get_devname(mdimm->dimm);
+		for (i = 0; i < ARRAY_SIZE(monitor_events); i++) {
+			if (!(monitor.event_flags & monitor_events[i].flag))
+				continue;
+			strbuf_addf(sb, "ndctl_dimm_events_total{dimm=\"%s\",event=\"%s\"} %llu\n",
+				dev, monitor_events[i].name, mdimm->events[i]);
+		}
+	}
+	strbuf_addstr(sb, "# EOF\n");
+}
+
+static void exporter_reply(int fd, const char *status, const char *type,
+		const char *body, size_t len)
+{
+	char hdr[256];
+	int n;
+
+	n = snprintf(hdr, sizeof(hdr), "HTTP/1.1 %s\r\n"
+			"Content-Type: %s\r\n"
+			"Content-Length: %zu\r\n"
+			"Connection: close\r\n\r\n", status, type, len);
+	/* a scraper that hangs up must not take the monitor down with it */
+	if (send(fd, hdr, n, MSG_NOSIGNAL) != n)
+		return;
+	while (len) {
+		ssize_t w = send(fd, body, len, MSG_NOSIGNAL);
+
+		if (w <= 0)
+			return;
+		body += w;
+		len -= w;
+	}
+}
+
+static void exporter_serve(void)
+{
+	struct timeval tv = {
+		.tv_sec = EXPORTER_IO_MS / 1000,
+		.tv_usec = (EXPORTER_IO_MS % 1000) * 1000,
+	};
+	struct strbuf sb = STRBUF_INIT;
+	char req[1024], *path, *end;
+	ssize_t len;
+	int fd;
+
+	fd = accept4(exporter.fd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	/* only the request line matters */
+	len = read(fd, req, sizeof(req) - 1);
+	if (len <= 0)
+		goto out;
+	req[len] = '\0';
+	if (strncmp(req, "GET ", 4) != 0) {
+		exporter_reply(fd, "405 Method Not Allowed", "text/plain",
+				"", 0);
+		goto out;
+	}
+	path = req + 4;
+	end = strpbrk(path, " ?\r\n");
+	if (end)
+		*end = '\0';
+	if (strcmp(path, "/metrics") != 0 && strcmp(path, "/") != 0) {
+		exporter_reply(fd, "404 Not Found", "text/plain", "", 0);
+		goto out;
+	}
+
+	exporter_render(&sb);
+	exporter_reply(fd, "200 OK", "application/openmetrics-text; "
+			"version=1.0.0; charset=utf-8", sb.buf, sb.len);
+	strbuf_release(&sb);
+ out:
+	close(fd);
+}
+
 static struct monitor_dimm *util_dimm_event_filter(struct monitor_dimm *mdimm,
 		unsigned int event_flags)
 {
@@ -211,6 +601,7 @@ static struct monitor_dimm *util_dimm_event_filter(struct monitor_dimm *mdimm,
 		return NULL;
 	if (mdimm->health != health)
 		mdimm->event_flags |= ND_EVENT_HEALTH_STATE;
+	mdimm->health = health;
 
 	if (mdimm->event_flags & event_flags)
 		return mdimm;
@@ -306,7 +697,11 @@ static void filter_dimm(struct ndctl_dimm *dimm, struct util_filter_ctx *fctx)
 			free(mdimm);
 			return;
 		}
+		monitor_count_events(mdimm,
+				mdimm->event_flags & monitor.event_flags);
+		mdimm->notified = mdimm->event_flags & monitor.event_flags;
 	}
+	monitor_smart_refresh(mdimm);
 
 	list_add_tail(&mfa->dimms, &mdimm->list);
 	if (mdimm->health_eventfd > mfa->maxfd_dimm)
@@ -320,29 +715,146 @@ static bool filter_bus(struct ndctl_bus *bus, struct util_filter_ctx *fctx)
 	return true;
 }
 
+static unsigned long long monitor_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static void monitor_queue(struct monitor_dimm *mdimm)
+{
+	if (mdimm->queued)
+		return;
+	mdimm->queued = true;
+	list_add_tail(&wheel.ready, &mdimm->ready);
+}
+
+/* put @mdimm in the slot that fires a full interval from now */
+static void wheel_reschedule(struct monitor_dimm *mdimm)
+{
+	if (!wheel.nr_slots)
+		return;
+	list_del(&mdimm->wheel);
+	list_add_tail(&wheel.slots[(wheel.cur + wheel.nr_slots - 1)
+			% wheel.nr_slots], &mdimm->wheel);
+}
+
+static void wheel_init(struct monitor_filter_arg *mfa, unsigned long long now)
+{
+	struct monitor_dimm *mdimm;
+	unsigned int i = 0;
+
+	list_head_init(&wheel.ready);
+	if (!monitor.poll_timeout)
+		return;
+
+	wheel.nr_slots = min_t(unsigned int, MONITOR_WHEEL_SLOTS,
+			mfa->num_dimm);
+	wheel.tick_ms = max(monitor.poll_timeout * 1000ULL / wheel.nr_slots,
+			1ULL);
+	for (i = 0; i < wheel.nr_slots; i++)
+		list_head_init(&wheel.slots[i]);
+	i = 0;
+	list_for_each(&mfa->dimms, mdimm, list)
+		list_add_tail(&wheel.slots[i++ % wheel.nr_slots],
+				&mdimm->wheel);
+	wheel.cur = 0;
+	wheel.next_ms = now + wheel.tick_ms;
+}
+
+/* queue the dimms of every slot that has come due */
+static void wheel_advance(unsigned long long now)
+{
+	struct monitor_dimm *mdimm;
+	unsigned int i;
+
+	if (!wheel.nr_slots)
+		return;
+
+	/* after a suspend, say, check everything once and carry on */
+	if (now >= wheel.next_ms + wheel.tick_ms * wheel.nr_slots) {
+		dbg(&monitor, "poll overdue, checking all dimms\n");
+		for (i = 0; i < wheel.nr_slots; i++)
+			list_for_each(&wheel.slots[i], mdimm, wheel)
+				monitor_queue(mdimm);
+		wheel.next_ms = now + wheel.tick_ms;
+		return;
+	}
+
+	while (now >= wheel.next_ms) {
+		list_for_each(&wheel.slots[wheel.cur], mdimm, wheel)
+			monitor_queue(mdimm);
+		wheel.cur = (wheel.cur + 1) % wheel.nr_slots;
+		wheel.next_ms += wheel.tick_ms;
+	}
+}
+
+static int monitor_timeout(unsigned long long now)
+{
+	unsigned long long due = ULLONG_MAX;
+
+	if (!list_empty(&wheel.ready))
+		due = wheel.batch_ms;
+	if (wheel.nr_slots)
+		due = min(due, wheel.next_ms);
+	if (due == ULLONG_MAX)
+		return -1;
+	return due > now ? min(due - now, (unsigned long long) INT_MAX) : 0;
+}
+
+/* check up to MONITOR_BATCH queued dimms, notifying what changed */
+static int monitor_check_ready(unsigned long long now)
+{
+	struct monitor_dimm *mdimm;
+	unsigned int flags;
+	int nr = 0, rc;
+
+	if (now < wheel.batch_ms)
+		return 0;
+
+	while (nr++ < MONITOR_BATCH
+			&& (mdimm = list_pop(&wheel.ready, struct monitor_dimm,
+					ready))) {
+		mdimm->queued = false;
+		wheel_reschedule(mdimm);
+
+		/* the health event means any cached smart is stale */
+		ndctl_dimm_invalidate_smart(mdimm->dimm);
+		monitor_smart_refresh(mdimm);
+		flags = 0;
+		if (util_dimm_event_filter(mdimm, monitor.event_flags))
+			flags = mdimm->event_flags & monitor.event_flags;
+		monitor_count_events(mdimm, flags);
+		if (flags && flags != mdimm->notified) {
+			rc = notify_dimm_event(mdimm);
+			if (rc) {
+				err(&monitor, "%s: notify dimm event failed\n",
+					ndctl_dimm_get_devname(mdimm->dimm));
+				did_fail = 1;
+				return rc;
+			}
+		}
+		mdimm->notified = flags;
+	}
+	wheel.batch_ms = now + MONITOR_BATCH_MS;
+	return 0;
+}
+
 static int monitor_event(struct ndctl_ctx *ctx,
 		struct monitor_filter_arg *mfa)
 {
-	struct epoll_event ev, *events;
-	int nfds, epollfd, i, rc = 0, polltimeout = -1;
+	struct epoll_event ev, events[MONITOR_BATCH];
+	int nfds, epollfd, i, rc = 0;
 	struct monitor_dimm *mdimm;
+	unsigned long long now;
 	char buf;
-	/* last time a full poll happened */
-	struct timespec fullpoll_ts, ts;
-
-	if (monitor.poll_timeout)
-		polltimeout = monitor.poll_timeout * 1000;
 
-	events = calloc(mfa->num_dimm, sizeof(struct epoll_event));
-	if (!events) {
-		err(&monitor, "malloc for events error\n");
-		return -ENOMEM;
-	}
 	epollfd = epoll_create1(0);
 	if (epollfd == -1) {
 		err(&monitor, "epoll_create1 error\n");
-		rc = -errno;
-		goto out;
+		return -errno;
 	}
 	list_for_each(&mfa->dimms, mdimm, list) {
 		memset(&ev, 0, sizeof(ev));
@@ -361,53 +873,63 @@ static int monitor_event(struct ndctl_ctx *ctx,
 		}
 	}
 
-	clock_gettime(CLOCK_BOOTTIME, &fullpoll_ts);
+	if (monitor.exporter) {
+		exporter.fd = exporter_listen(monitor.exporter);
+		if (exporter.fd < 0) {
+			rc = exporter.fd;
+			goto out;
+		}
+		exporter.dimms = &mfa->dimms;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = &exporter;
+		if (epoll_ctl(epollfd, EPOLL_CTL_ADD, exporter.fd, &ev) != 0) {
+			err(&monitor, "epoll_ctl error\n");
+			rc = -errno;
+			goto out;
+		}
+	}
+
+	wheel_init(mfa, monitor_now_ms());
 	while (1) {
 		did_fail = 0;
-		nfds = epoll_wait(epollfd, events, mfa->num_dimm, polltimeout);
+		nfds = epoll_wait(epollfd, events, ARRAY_SIZE(events),
+				monitor_timeout(monitor_now_ms()));
 		if (nfds < 0 && errno != EINTR) {
 			err(&monitor, "epoll_wait error: (%s)\n", strerror(errno));
 			rc = -errno;
 			goto out;
 		}
 
-		/* If needed force a full poll of dimm health */
-		clock_gettime(CLOCK_BOOTTIME, &ts);
-		if ((fullpoll_ts.tv_sec - ts.tv_sec) > monitor.poll_timeout) {
-			nfds = 0;
-			dbg(&monitor, "forcing a full poll\n");
-		}
-
-		/* If we timed out then fill events array with all dimms */
-		if (nfds == 0) {
-			list_for_each(&mfa->dimms, mdimm, list)
-				events[nfds++].data.ptr = mdimm;
-			fullpoll_ts = ts;
-		}
-
+		/*
+		 * Re-arm each notification as it is queued, a dimm that
+		 * fires again before it is checked is only checked once.
+		 */
 		for (i = 0; i < nfds; i++) {
-			mdimm = events[i].data.ptr;
-			if (util_dimm_event_filter(mdimm, monitor.event_flags)) {
-				rc = notify_dimm_event(mdimm);
-				if (rc) {
-					err(&monitor, "%s: notify dimm event failed\n",
-						ndctl_dimm_get_devname(mdimm->dimm));
-					did_fail = 1;
-					goto out;
-				}
+			if (events[i].data.ptr == &exporter) {
+				exporter_serve();
+				continue;
 			}
+			mdimm = events[i].data.ptr;
 			rc = pread(mdimm->health_eventfd, &buf, sizeof(buf), 0);
 			if (rc < 0) {
 				err(&monitor, "pread error\n");
 				rc = -errno;
 				goto out;
 			}
+			monitor_queue(mdimm);
 		}
-		if (did_fail)
-			return 1;
+
+		now = monitor_now_ms();
+		wheel_advance(now);
+		rc = monitor_check_ready(now);
+		if (rc)
+			goto out;
 	}
  out:
-	free(events);
+	if (exporter.fd >= 0)
+		close(exporter.fd);
+	close(epollfd);
 	return rc;
 }
 
@@ -463,111 +985,43 @@ out:
 	return rc;
 }
 
-static void parse_config(const char **arg, char *key, char *val, char *ident)
-{
-	struct strbuf value = STRBUF_INIT;
-	size_t arg_len = *arg ? strlen(*arg) : 0;
-
-	if (!ident || !key || (strcmp(ident, key) != 0))
-		return;
+struct monitor_config {
+	struct monitor *monitor;
+	struct util_filter_params *param;
+};
 
-	if (arg_len) {
-		strbuf_add(&value, *arg, arg_len);
-		strbuf_addstr(&value, " ");
-	}
-	strbuf_addstr(&value, val);
-	*arg = strbuf_detach(&value, NULL);
+static void parse_config(const char *key, const char *value, void *arg)
+{
+	struct monitor_config *cfg = arg;
+	struct util_filter_params *_param = cfg->param;
+	struct monitor *_monitor = cfg->monitor;
+
+	util_config_append(&_param->bus, "bus", key, value);
+	util_config_append(&_param->dimm, "dimm", key, value);
+	util_config_append(&_param->region, "region", key, value);
+	util_config_append(&_param->namespace, "namespace", key, value);
+	util_config_append(&_monitor->dimm_event, "dimm-event", key, value);
+
+	if (!_monitor->log)
+		util_config_append(&_monitor->log, "log", key, value);
+	if (!_monitor->exporter)
+		util_config_append(&_monitor->exporter, "exporter", key, value);
 }
 
 static int read_config_file(struct ndctl_ctx *ctx, struct monitor *_monitor,
 		struct util_filter_params *_param)
 {
-	FILE *f;
-	size_t len = 0;
-	int line = 0, rc = 0;
-	char *buf = NULL, *seek, *value, *config_file;
+	struct monitor_config cfg = {
+		.monitor = _monitor,
+		.param = _param,
+	};
+	const char *config_file = NDCTL_CONF_FILE;
 
 	if (_monitor->config_file)
-		config_file = strdup(_monitor->config_file);
-	else
-		config_file = strdup(NDCTL_CONF_FILE);
-	if (!config_file) {
-		fail("strdup default config file failed\n");
-		rc = -ENOMEM;
-		goto out;
-	}
-
-	buf = malloc(BUF_SIZE);
-	if (!buf) {
-		fail("malloc read config-file buf error\n");
-		rc = -ENOMEM;
-		goto out;
-	}
-	seek = buf;
-
-	f = fopen(config_file, "r");
-	if (!f) {
-		if (_monitor->config_file) {
-			err(&monitor, "config-file: %s cannot be opened\n",
-				config_file);
-			rc = -errno;
-		}
-		goto out;
-	}
-
-	while (fgets(seek, BUF_SIZE, f)) {
-		value = NULL;
-		line++;
-
-		while (isspace(*seek))
-			seek++;
-
-		if (*seek == '#' || *seek == '\0')
-			continue;
-
-		value = strchr(seek, '=');
-		if (!value) {
-			fail("config-file syntax error, skip line[%i]\n", line);
-			continue;
-		}
-
-		value[0] = '\0';
-		value++;
-
-		while (isspace(value[0]))
-			value++;
-
-		len = strlen(seek);
-		if (len == 0)
-			continue;
-		while (isspace(seek[len-1]))
-			len--;
-		seek[len] = '\0';
-
-		len = strlen(value);
-		if (len == 0)
-			continue;
-		while (isspace(value[len-1]))
-			len--;
-		value[len] = '\0';
-
-		if (len == 0)
-			continue;
-
-		parse_config(&_param->bus, "bus", value, seek);
-		parse_config(&_param->dimm, "dimm", value, seek);
-		parse_config(&_param->region, "region", value, seek);
-		parse_config(&_param->namespace, "namespace", value, seek);
-		parse_config(&_monitor->dimm_event, "dimm-event", value, seek);
+		config_file = _monitor->config_file;
 
-		if (!_monitor->log)
-			parse_config(&_monitor->log, "log", value, seek);
-	}
-	fclose(f);
-out:
-	free(buf);
-	free(config_file);
-	return rc;
+	return util_read_config_file(&monitor.ctx, config_file,
+			!!_monitor->config_file, parse_config, &cfg);
 }
 
 int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
@@ -595,6 +1049,8 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 				"emit extra debug messages to log"),
 		OPT_UINTEGER('p', "poll", &monitor.poll_timeout,
 			     "poll and report events/status every <n> seconds"),
+		OPT_STRING('\0', "exporter", &monitor.exporter, "[addr]:port",
+			"serve health and event counts as OpenMetrics over HTTP"),
 		OPT_END(),
 	};
 	const char * const u[] = {
@@ -614,7 +1070,7 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 		usage_with_options(u, options);
 
 	log_init(&monitor.ctx, "ndctl/monitor", "NDCTL_MONITOR_LOG");
-	monitor.ctx.log_fn = log_standard;
+	monitor.ctx.log_fn = util_monitor_log_standard;
 
 	if (monitor.verbose)
 		monitor.ctx.log_priority = LOG_DEBUG;
@@ -626,26 +1082,14 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 		goto out;
 
 	if (monitor.log) {
-		if (strncmp(monitor.log, "./", 2) != 0)
-			fix_filename(prefix, (const char **)&monitor.log);
-		if (strncmp(monitor.log, "./syslog", 8) == 0)
-			monitor.ctx.log_fn = log_syslog;
-		else if (strncmp(monitor.log, "./standard", 10) == 0)
-			monitor.ctx.log_fn = log_standard;
-		else {
-			monitor.log_file = fopen(monitor.log, "a+");
-			if (!monitor.log_file) {
-				error("open %s failed\n", monitor.log);
-				rc = -errno;
-				goto out;
-			}
-			monitor.ctx.log_fn = log_file;
-		}
+		rc = util_monitor_set_log(&monitor.ctx, &monitor.log, prefix);
+		if (rc)
+			goto out;
 	}
 
 	if (monitor.daemon) {
 		if (!monitor.log || strncmp(monitor.log, "./", 2) == 0)
-			monitor.ctx.log_fn = log_syslog;
+			monitor.ctx.log_fn = util_monitor_log_syslog;
 		if (daemon(0, 0) != 0) {
 			err(&monitor, "daemon start failed\n");
 			goto out;
@@ -679,7 +1123,6 @@ int cmd_monitor(int argc, const char **argv, struct ndctl_ctx *ctx)
 
 	rc = monitor_event(ctx, &mfa);
 out:
-	if (monitor.log_file)
-		fclose(monitor.log_file);
+	util_monitor_close_log();
 	return rc;
 }
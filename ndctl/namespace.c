@@ -8,22 +8,29 @@
 #include <unistd.h>
 #include <limits.h>
 #include <syslog.h>
+#include <pthread.h>
 
 #include <ndctl.h>
 #include "action.h"
 #include "namespace.h"
+#include "bench.h"
 #include <sys/stat.h>
 #include <linux/fs.h>
 #include <uuid/uuid.h>
+#include <sys/mman.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <dirent.h>
 #include <util/size.h>
 #include <util/json.h>
 #include <json-c/json.h>
 #include <util/filter.h>
+#include <util/pool.h>
 #include <ndctl/libndctl.h>
 #include <util/parse-options.h>
 #include <ccan/minmax/minmax.h>
+#include <ccan/array_size/array_size.h>
 
 static bool verbose;
 static bool force;
@@ -40,6 +47,9 @@ static struct parameters {
 	bool human;
 	bool json;
 	bool std_out;
+	bool advise;
+	bool pack;
+	bool plan;
 	const char *bus;
 	const char *map;
 	const char *type;
@@ -55,6 +65,18 @@ static struct parameters {
 	const char *outfile;
 	const char *infile;
 	const char *parent_uuid;
+	const char *from;
+	unsigned int jobs;
+	bool stream;
+	bool quick;
+	bool resume;
+	const char *checkpoint;
+	const char *path;
+	const char *staging;
+	const char *workload;
+	const char *block_size;
+	const char *queue_depth;
+	unsigned int runtime;
 } param = {
 	.autolabel = true,
 	.autorecover = true,
@@ -135,15 +157,37 @@ OPT_BOOLEAN('f', "force", &force, "reconfigure namespace even if currently activ
 OPT_BOOLEAN('L', "autolabel", &param.autolabel, "automatically initialize labels"), \
 OPT_BOOLEAN('c', "continue", &param.greedy, \
 	"continue creating namespaces as long as the filter criteria are met"), \
-OPT_BOOLEAN('R', "autorecover", &param.autorecover, "automatically cleanup on failure")
+OPT_BOOLEAN('R', "autorecover", &param.autorecover, "automatically cleanup on failure"), \
+OPT_FILENAME('\0', "from", &param.from, "spec-file", \
+	"create every namespace listed in a JSON spec file"), \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+	"with --from, create in up to <n> regions at once (default 16)"), \
+OPT_BOOLEAN('\0', "advise", &param.advise, \
+	"report the memmap cost of each --map choice, create nothing"), \
+OPT_BOOLEAN('\0', "pack", &param.pack, \
+	"with --from, order the entries to keep namespaces 1G aligned"), \
+OPT_BOOLEAN('\0', "plan", &param.plan, \
+	"with --from, show where each entry would go, create nothing")
 
 #define CHECK_OPTIONS() \
 OPT_BOOLEAN('R', "repair", &repair, "perform metadata repairs"), \
 OPT_BOOLEAN('L', "rewrite-log", &logfix, "regenerate the log"), \
-OPT_BOOLEAN('f', "force", &force, "check namespace even if currently active")
+OPT_BOOLEAN('f', "force", &force, "check namespace even if currently active"), \
+OPT_BOOLEAN('\0', "stream", &param.stream, \
+	"read the BTT metadata instead of mapping it, skip over media errors"), \
+OPT_BOOLEAN('\0', "quick", &param.quick, \
+	"only check the info blocks and the flog"), \
+OPT_FILENAME('\0', "checkpoint", &param.checkpoint, "file", \
+	"save progress to <file> as the check goes"), \
+OPT_BOOLEAN('\0', "resume", &param.resume, \
+	"continue from the --checkpoint file if there is one"), \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+	"scan the BTT with up to <n> threads (default: online cpus)")
 
 #define CLEAR_OPTIONS() \
-OPT_BOOLEAN('s', "scrub", &scrub, "run a scrub to find latent errors")
+OPT_BOOLEAN('s', "scrub", &scrub, "run a scrub to find latent errors"), \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+	"clear up to <n> regions at once (default 16)")
 
 #define READ_INFOBLOCK_OPTIONS() \
 OPT_FILENAME('o', "output", &param.outfile, "output-file", \
@@ -173,7 +217,9 @@ OPT_STRING('M', "map", &param.map, "memmap-location", \
 OPT_STRING('p', "parent-uuid", &param.parent_uuid, "parent-uuid", \
 	"specify the parent namespace uuid for the infoblock (default: 0)"), \
 OPT_STRING('O', "offset", &param.offset, "offset", \
-	"EXPERT/DEBUG only: enable namespace inner alignment padding")
+	"EXPERT/DEBUG only: enable namespace inner alignment padding"), \
+OPT_UINTEGER('j', "jobs", &param.jobs, \
+	"write up to <n> regions' namespaces at once (default 16)")
 
 static const struct option base_options[] = {
 	BASE_OPTIONS(),
@@ -184,6 +230,8 @@ static const struct option destroy_options[] = {
 	BASE_OPTIONS(),
 	OPT_BOOLEAN('f', "force", &force,
 			"destroy namespace even if currently active"),
+	OPT_UINTEGER('j', "jobs", &param.jobs,
+			"destroy in up to <n> regions at once (default 16)"),
 	OPT_END(),
 };
 
@@ -217,6 +265,49 @@ static const struct option write_infoblock_options[] = {
 	OPT_END(),
 };
 
+static const struct option check_mapping_options[] = {
+	BASE_OPTIONS(),
+	OPT_FILENAME('p', "path", &param.path, "file",
+		"test-map <file> on the fsdax namespace's filesystem"),
+	OPT_END(),
+};
+
+static const struct option convert_options[] = {
+	BASE_OPTIONS(),
+	OPT_STRING('m', "mode", &param.mode, "operation-mode",
+		"the mode to convert to, only 'fsdax' (default)"),
+	OPT_STRING('M', "map", &param.map, "memmap-location",
+		"specify 'mem' or 'dev' for the location of the memmap"),
+	OPT_STRING('a', "align", &param.align, "align",
+		"specify the namespace alignment in bytes (default: 2M)"),
+	OPT_FILENAME('S', "staging", &param.staging, "file",
+		"hold the data, and the progress, in <file> during conversion"),
+	OPT_BOOLEAN('f', "force", &force,
+		"convert the namespace even if currently active"),
+	OPT_END(),
+};
+
+static const struct option bench_options[] = {
+	BASE_OPTIONS(),
+	OPT_STRING('w', "workload", &param.workload, "workload[,workload..]",
+		"read, write, randread and/or randwrite (default: read,randread)"),
+	OPT_STRING('B', "block-size", &param.block_size, "size[,size..]",
+		"I/O sizes to run (default: 4K)"),
+	OPT_STRING('Q', "queue-depth", &param.queue_depth, "depth[,depth..]",
+		"I/Os to keep in flight (default: 1,32)"),
+	OPT_UINTEGER('t', "runtime", &param.runtime,
+		"seconds per workload, block size and queue depth (default: 5)"),
+	OPT_STRING('s', "size", &param.size, "size",
+		"only span the first <size> bytes of each namespace"),
+	OPT_BOOLEAN('f', "force", &force,
+		"allow write workloads, destroying the namespace contents"),
+	OPT_BOOLEAN('u', "human", &param.human,
+		"use human friendly number formats"),
+	OPT_END(),
+};
+
+static struct bench_ctx bench;
+
 static int set_defaults(enum device_action action)
 {
 	uuid_t uuid;
@@ -253,7 +344,8 @@ static int set_defaults(enum device_action action)
 			}
 			break;
 		}
-	} else if (action == ACTION_WRITE_INFOBLOCK) {
+	} else if (action == ACTION_WRITE_INFOBLOCK
+			|| action == ACTION_CONVERT) {
 		param.mode = "fsdax";
 	} else if (!param.reconfig && param.type) {
 		if (strcmp(param.type, "pmem") == 0)
@@ -399,6 +491,15 @@ static const char *parse_namespace_options(int argc, const char **argv,
 			case ACTION_WRITE_INFOBLOCK:
 				action_string = "write-infoblock";
 				break;
+			case ACTION_CHECK_MAPPING:
+				action_string = "check-mapping";
+				break;
+			case ACTION_CONVERT:
+				action_string = "convert";
+				break;
+			case ACTION_BENCH:
+				action_string = "bench";
+				break;
 			default:
 				action_string = "<>";
 				break;
@@ -433,6 +534,71 @@ static const char *parse_namespace_options(int argc, const char **argv,
 		rc = -EINVAL;
 	}
 
+	if (action == ACTION_CREATE && param.from
+			&& (param.reconfig || param.greedy)) {
+		error("--from does not take --reconfig or --continue\n");
+		rc = -EINVAL;
+	}
+
+	if (action == ACTION_CREATE && !param.from
+			&& (param.pack || param.plan)) {
+		error("--pack and --plan take a --from spec file\n");
+		rc = -EINVAL;
+	}
+
+	if (action == ACTION_CHECK && param.resume && !param.checkpoint) {
+		error("--resume requires --checkpoint\n");
+		rc = -EINVAL;
+	}
+
+	if (action == ACTION_CHECK && param.checkpoint && param.quick) {
+		error("--quick does not take a --checkpoint\n");
+		rc = -EINVAL;
+	}
+
+	/* one file holds the progress of one namespace */
+	if (action == ACTION_CHECK && param.checkpoint && argc
+			&& strcmp(argv[0], "all") == 0) {
+		error("--checkpoint needs a single namespace, not \"all\"\n");
+		rc = -EINVAL;
+	}
+
+	if (action == ACTION_CONVERT) {
+		if (util_nsmode(param.mode) != NDCTL_NS_MODE_FSDAX) {
+			error("only conversion to fsdax is supported\n");
+			rc = -EINVAL;
+		}
+		if (!param.staging) {
+			error("--staging is required\n");
+			rc = -EINVAL;
+		}
+		if (argc && strcmp(argv[0], "all") == 0) {
+			error("convert a single namespace at a time, not \"all\"\n");
+			rc = -EINVAL;
+		}
+	}
+
+	if (action == ACTION_BENCH) {
+		memset(&bench, 0, sizeof(bench));
+		if (bench_parse(&bench, param.workload ? param.workload
+					: "read,randread",
+				param.block_size ? param.block_size : "4K",
+				param.queue_depth ? param.queue_depth
+					: "1,32") < 0) {
+			error("invalid --workload, --block-size or --queue-depth\n");
+			rc = -EINVAL;
+		}
+		if ((bench.workloads & (1 << BENCH_WRITE
+						| 1 << BENCH_RANDWRITE))
+				&& !force) {
+			error("write workloads destroy the namespace contents, use --force\n");
+			rc = -EINVAL;
+		}
+		bench.runtime = param.runtime ? param.runtime : 5;
+		bench.size = param.size ? parse_size64(param.size) : 0;
+		bench.flags = param.human ? UTIL_JSON_HUMAN : 0;
+	}
+
 	if (rc) {
 		usage_with_options(u, options);
 		return NULL; /* we won't return from usage_with_options() */
@@ -490,8 +656,10 @@ static int check_dax_align(struct ndctl_namespace *ndns)
 	return -EINVAL;
 }
 
+/* @jout, when set, takes the new namespace's listing instead of stdout */
 static int setup_namespace(struct ndctl_region *region,
-		struct ndctl_namespace *ndns, struct parsed_parameters *p)
+		struct ndctl_namespace *ndns, struct parsed_parameters *p,
+		struct json_object **jout)
 {
 	uuid_t uuid;
 	int rc;
@@ -598,17 +766,51 @@ static int setup_namespace(struct ndctl_region *region,
 		if (isatty(1))
 			flags |= UTIL_JSON_HUMAN;
 		jndns = util_namespace_to_json(ndns, flags);
-		if (jndns)
+		if (jout)
+			*jout = jndns;
+		else if (jndns)
 			printf("%s\n", json_object_to_json_string_ext(jndns,
 						JSON_C_TO_STRING_PRETTY));
 	}
 	return rc;
 }
 
+/*
+ * create-namespace --from: every entry of the spec is validated against
+ * the topology before anything is created, then each region's entries
+ * are created in spec order, with the regions side by side.
+ */
+struct create_entry {
+	struct ndctl_region *region;
+	struct parsed_parameters p;
+	struct json_object *jndns;
+	int idx;
+	/* position in the plan, the spec order unless --pack */
+	int order;
+	int rc;
+};
+
+static struct create_queue {
+	struct create_entry *entries;
+	int nr;
+} create_queue;
+
+/* capacity already promised to earlier entries of the spec */
+static unsigned long long create_queue_reserved(struct ndctl_region *region)
+{
+	unsigned long long reserved = 0;
+	int i;
+
+	for (i = 0; i < create_queue.nr; i++)
+		if (create_queue.entries[i].region == region)
+			reserved += create_queue.entries[i].p.size;
+	return reserved;
+}
+
 static int validate_available_capacity(struct ndctl_region *region,
 		struct parsed_parameters *p)
 {
-	unsigned long long available;
+	unsigned long long available, reserved;
 
 	if (ndctl_region_get_nstype(region) == ND_DEVICE_NAMESPACE_IO)
 		available = ndctl_region_get_size(region);
@@ -617,6 +819,8 @@ static int validate_available_capacity(struct ndctl_region *region,
 		if (available == ULLONG_MAX)
 			available = ndctl_region_get_available_size(region);
 	}
+	reserved = create_queue_reserved(region);
+	available = available > reserved ? available - reserved : 0;
 	if (!available || p->size > available) {
 		debug("%s: insufficient capacity size: %llx avail: %llx\n",
 			ndctl_region_get_devname(region), p->size, available);
@@ -1006,6 +1210,197 @@ static struct ndctl_namespace *region_get_namespace(struct ndctl_region *region)
 	return ndctl_region_get_namespace_seed(region);
 }
 
+/* as nd_pfn_init(): info block, then the memmap if on pmem, rounded to @align */
+#define PFN_INFO_SIZE SZ_8K
+#define STRUCT_PAGE_SIZE 64
+
+struct node_mem {
+	int node;
+	unsigned long long total, free;
+};
+
+static int node_mem_read(int node, struct node_mem *m)
+{
+	char path[64], line[128];
+	unsigned long long val;
+	FILE *f;
+
+	sprintf(path, "/sys/devices/system/node/node%d/meminfo", node);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	m->node = node;
+	m->total = m->free = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "Node %*d MemTotal: %llu kB", &val) == 1)
+			m->total = val * SZ_1K;
+		else if (sscanf(line, "Node %*d MemFree: %llu kB", &val) == 1)
+			m->free = val * SZ_1K;
+	}
+	fclose(f);
+	return 0;
+}
+
+static struct json_object *node_mem_to_json(struct node_mem *m)
+{
+	struct json_object *jnode, *jobj;
+
+	jnode = json_object_new_object();
+	if (!jnode)
+		return NULL;
+	jobj = json_object_new_int(m->node);
+	if (jobj)
+		json_object_object_add(jnode, "node", jobj);
+	jobj = util_json_object_size(m->total, 0);
+	if (jobj)
+		json_object_object_add(jnode, "mem_total", jobj);
+	jobj = util_json_object_size(m->free, 0);
+	if (jobj)
+		json_object_object_add(jnode, "mem_free", jobj);
+	return jnode;
+}
+
+/* DRAM of every node that has any, memory-only nodes included */
+static struct json_object *nodes_mem_to_json(void)
+{
+	struct json_object *jnodes;
+	struct dirent *de;
+	struct node_mem m;
+	DIR *dir;
+	int node;
+
+	dir = opendir("/sys/devices/system/node");
+	if (!dir)
+		return NULL;
+	jnodes = json_object_new_array();
+	while (jnodes && (de = readdir(dir))) {
+		if (sscanf(de->d_name, "node%d", &node) != 1)
+			continue;
+		if (node_mem_read(node, &m) || !m.total)
+			continue;
+		json_object_array_add(jnodes, node_mem_to_json(&m));
+	}
+	closedir(dir);
+	return jnodes;
+}
+
+/* the memmap may take this much of its node's free DRAM before --map=dev */
+#define MEMMAP_NODE_BUDGET_PCT 10
+
+/*
+ * create-namespace --advise: what each --map choice would cost for the
+ * namespace these options describe. With --map=mem the memmap, one
+ * struct page per 4K, is allocated from the DRAM of the namespace's
+ * node, with --map=dev it comes out of the namespace's own capacity
+ * and is read from pmem on every struct page access.
+ */
+static int namespace_advise(struct ndctl_region *region,
+		struct parsed_parameters *p)
+{
+	unsigned long long memmap, dev_offset, mem_offset, budget;
+	unsigned long align = p->align ? p->align : SZ_2M;
+	struct json_object *jadv, *jmaps, *jmap, *jobj;
+	int node = ndctl_region_get_numa_node(region);
+	const char *map, *reason;
+	struct node_mem m = { 0 };
+	bool have_node;
+
+	if (p->mode != NDCTL_NS_MODE_FSDAX && p->mode != NDCTL_NS_MODE_DEVDAX) {
+		error("--advise only applies to fsdax and devdax namespaces\n");
+		return -EINVAL;
+	}
+
+	memmap = p->size / SZ_4K * STRUCT_PAGE_SIZE;
+	mem_offset = ALIGN(PFN_INFO_SIZE, align);
+	dev_offset = ALIGN(PFN_INFO_SIZE + memmap, align);
+	have_node = node >= 0 && node_mem_read(node, &m) == 0;
+
+	jadv = json_object_new_object();
+	jmaps = json_object_new_array();
+	if (!jadv || !jmaps) {
+		json_object_put(jadv);
+		json_object_put(jmaps);
+		return -ENOMEM;
+	}
+
+	jobj = json_object_new_string(ndctl_region_get_devname(region));
+	if (jobj)
+		json_object_object_add(jadv, "region", jobj);
+	jobj = json_object_new_string(util_nsmode_name(p->mode));
+	if (jobj)
+		json_object_object_add(jadv, "mode", jobj);
+	jobj = util_json_object_size(p->size, 0);
+	if (jobj)
+		json_object_object_add(jadv, "size", jobj);
+	jobj = util_json_object_size(align, 0);
+	if (jobj)
+		json_object_object_add(jadv, "align", jobj);
+	if (node >= 0) {
+		jobj = json_object_new_int(node);
+		if (jobj)
+			json_object_object_add(jadv, "numa_node", jobj);
+	}
+
+	jmap = json_object_new_object();
+	if (jmap) {
+		json_object_object_add(jmap, "map",
+				json_object_new_string("mem"));
+		json_object_object_add(jmap, "memmap_size",
+				util_json_object_size(memmap, 0));
+		json_object_object_add(jmap, "location",
+				json_object_new_string("dram"));
+		if (have_node) {
+			json_object_object_add(jmap, "node",
+					json_object_new_int(node));
+			json_object_object_add(jmap, "node_free_after",
+				util_json_object_size(m.free > memmap
+					? m.free - memmap : 0, 0));
+		}
+		json_object_object_add(jmap, "usable_size",
+				util_json_object_size(p->size - mem_offset, 0));
+		json_object_array_add(jmaps, jmap);
+	}
+
+	jmap = json_object_new_object();
+	if (jmap) {
+		json_object_object_add(jmap, "map",
+				json_object_new_string("dev"));
+		json_object_object_add(jmap, "memmap_size",
+				util_json_object_size(memmap, 0));
+		json_object_object_add(jmap, "location",
+				json_object_new_string("pmem"));
+		json_object_object_add(jmap, "usable_size",
+				util_json_object_size(p->size > dev_offset
+					? p->size - dev_offset : 0, 0));
+		json_object_array_add(jmaps, jmap);
+	}
+	json_object_object_add(jadv, "memmap", jmaps);
+
+	jobj = nodes_mem_to_json();
+	if (jobj)
+		json_object_object_add(jadv, "nodes", jobj);
+
+	budget = m.free / 100 * MEMMAP_NODE_BUDGET_PCT;
+	if (!have_node) {
+		map = "dev";
+		reason = "numa node of the region unknown, keep DRAM untouched";
+	} else if (memmap > budget) {
+		map = "dev";
+		reason = "memmap exceeds 10% of the node's free DRAM";
+	} else {
+		map = "mem";
+		reason = "memmap fits the node's DRAM, struct page access stays off pmem";
+	}
+	json_object_object_add(jadv, "recommended_map",
+			json_object_new_string(map));
+	json_object_object_add(jadv, "reason", json_object_new_string(reason));
+
+	printf("%s\n", json_object_to_json_string_ext(jadv,
+				JSON_C_TO_STRING_PRETTY));
+	json_object_put(jadv);
+	return 0;
+}
+
 static int namespace_create(struct ndctl_region *region)
 {
 	const char *devname = ndctl_region_get_devname(region);
@@ -1017,6 +1412,9 @@ static int namespace_create(struct ndctl_region *region)
 	if (rc)
 		return rc;
 
+	if (param.advise)
+		return namespace_advise(region, &p);
+
 	if (ndctl_region_get_ro(region)) {
 		debug("%s: read-only, ineligible for namespace creation\n",
 			devname);
@@ -1030,7 +1428,7 @@ static int namespace_create(struct ndctl_region *region)
 		return -EAGAIN;
 	}
 
-	rc = setup_namespace(region, ndns, &p);
+	rc = setup_namespace(region, ndns, &p, NULL);
 	if (rc && p.autorecover) {
 		ndctl_namespace_set_enforce_mode(ndns, NDCTL_NS_MODE_RAW);
 		ndctl_namespace_delete(ndns);
@@ -1039,6 +1437,319 @@ static int namespace_create(struct ndctl_region *region)
 	return rc;
 }
 
+static bool region_type_filter(struct ndctl_region *region)
+{
+	if (!param.type)
+		return true;
+	if (strcmp(param.type, "pmem") == 0)
+		return ndctl_region_get_type(region) == ND_DEVICE_REGION_PMEM;
+	if (strcmp(param.type, "blk") == 0)
+		return ndctl_region_get_type(region) == ND_DEVICE_REGION_BLK;
+	return false;
+}
+
+/* spec keys are the long option names, and fill in the same parameters */
+static const struct spec_key {
+	const char *name;
+	const char **val;
+} spec_keys[] = {
+	{ "bus", &param.bus },
+	{ "region", &param.region },
+	{ "type", &param.type },
+	{ "size", &param.size },
+	{ "mode", &param.mode },
+	{ "map", &param.map },
+	{ "name", &param.name },
+	{ "uuid", &param.uuid },
+	{ "sector-size", &param.sector_size },
+	{ "align", &param.align },
+};
+
+static int spec_entry_parse(struct json_object *jentry, int idx)
+{
+	unsigned int i;
+
+	if (!json_object_is_type(jentry, json_type_object)) {
+		error("%s: entry %d: not a JSON object\n", param.from, idx);
+		return -EINVAL;
+	}
+
+	json_object_object_foreach(jentry, key, jval) {
+		for (i = 0; i < ARRAY_SIZE(spec_keys); i++)
+			if (strcmp(key, spec_keys[i].name) == 0)
+				break;
+		if (i == ARRAY_SIZE(spec_keys)) {
+			error("%s: entry %d: unknown key '%s'\n", param.from,
+					idx, key);
+			return -EINVAL;
+		}
+		/* numbers are taken as written, e.g. "size": 17179869184 */
+		*spec_keys[i].val = json_object_get_string(jval);
+	}
+	return set_defaults(ACTION_CREATE);
+}
+
+/* pick the first region with room for the entry, as a plain create would */
+static int spec_entry_plan(struct ndctl_ctx *ctx, int idx, int order)
+{
+	struct create_entry entry = { .idx = idx, .order = order }, *e;
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+	int rc;
+
+	ndctl_bus_foreach(ctx, bus) {
+		if (!util_bus_filter(bus, param.bus))
+			continue;
+		ndctl_region_foreach(bus, region) {
+			if (!util_region_filter(region, param.region)
+					|| !region_type_filter(region)
+					|| ndctl_region_get_ro(region))
+				continue;
+			rc = validate_namespace_options(region, NULL, &entry.p);
+			if (rc == -EAGAIN)
+				continue;
+			if (rc)
+				return rc;
+			entry.region = region;
+			goto found;
+		}
+	}
+	error("%s: entry %d: no region has the capacity for it\n",
+			param.from, idx);
+	return -ENOSPC;
+ found:
+	e = realloc(create_queue.entries,
+			(create_queue.nr + 1) * sizeof(*e));
+	if (!e)
+		return -ENOMEM;
+	create_queue.entries = e;
+	create_queue.entries[create_queue.nr++] = entry;
+	return 0;
+}
+
+static void create_entry_run(struct create_entry *e)
+{
+	struct ndctl_namespace *ndns = region_get_namespace(e->region);
+
+	if (!ndns || !ndctl_namespace_is_configuration_idle(ndns)) {
+		error("%s: no %s namespace seed\n",
+				ndctl_region_get_devname(e->region),
+				ndns ? "idle" : "available");
+		e->rc = -ENXIO;
+		return;
+	}
+
+	e->rc = setup_namespace(e->region, ndns, &e->p, &e->jndns);
+	if (e->rc && e->p.autorecover) {
+		ndctl_namespace_set_enforce_mode(ndns, NDCTL_NS_MODE_RAW);
+		ndctl_namespace_delete(ndns);
+	}
+}
+
+/* the first entry of each region runs that region's entries in order */
+static void create_worker(void *arg, int i)
+{
+	struct create_queue *q = arg;
+	struct ndctl_region *region = q->entries[i].region;
+	bool failed;
+
+	if (i && q->entries[i - 1].region == region)
+		return;
+	/* as with --continue, stop at the first error unless forced */
+	for (failed = false; i < q->nr && q->entries[i].region == region; i++) {
+		if (failed) {
+			q->entries[i].rc = -ECANCELED;
+			continue;
+		}
+		create_entry_run(&q->entries[i]);
+		failed = q->entries[i].rc && !force;
+	}
+}
+
+static int create_node(void *arg, int i)
+{
+	struct create_queue *q = arg;
+
+	return ndctl_region_get_numa_node(q->entries[i].region);
+}
+
+static int create_entry_cmp(const void *a, const void *b)
+{
+	const struct create_entry *x = a, *y = b;
+
+	if (x->region != y->region)
+		return x->region < y->region ? -1 : 1;
+	return x->order - y->order;
+}
+
+/* a spec entry as parsed, before it is given a region */
+struct spec_entry {
+	struct parameters param;
+	unsigned long long size, align;
+	int idx;
+};
+
+/*
+ * --pack: place the entries that keep the next start on 1G first, the
+ * largest alignment and size first among those, so that first-fit
+ * across regions wastes the least, and the sizes that break 1G
+ * alignment, or take the rest of a region, come last.
+ */
+static int spec_entry_cmp(const void *a, const void *b)
+{
+	const struct spec_entry *x = a, *y = b;
+	bool x_1g = x->size && IS_ALIGNED(x->size, SZ_1G);
+	bool y_1g = y->size && IS_ALIGNED(y->size, SZ_1G);
+
+	if (!x->size != !y->size)
+		return !x->size ? 1 : -1;
+	if (x_1g != y_1g)
+		return x_1g ? -1 : 1;
+	if (x->align != y->align)
+		return x->align > y->align ? -1 : 1;
+	if (x->size != y->size)
+		return x->size > y->size ? -1 : 1;
+	return x->idx - y->idx;
+}
+
+/*
+ * --plan: where each entry lands, assuming, as the kernel allocates
+ * them, that a region's namespaces are laid out back to back from its
+ * first free byte.
+ */
+static void create_queue_show(struct create_queue *q)
+{
+	struct json_object *jplan, *jentry, *jobj;
+	struct ndctl_region *region = NULL;
+	unsigned long long start = 0;
+	int i;
+
+	jplan = json_object_new_array();
+	if (!jplan)
+		return;
+	for (i = 0; i < q->nr; i++) {
+		struct create_entry *e = &q->entries[i];
+
+		if (e->region != region) {
+			region = e->region;
+			start = ndctl_region_get_resource(region)
+				+ ndctl_region_get_size(region)
+				- ndctl_region_get_available_size(region);
+		}
+		jentry = json_object_new_object();
+		if (!jentry)
+			break;
+		json_object_array_add(jplan, jentry);
+
+		jobj = json_object_new_int(e->idx);
+		if (jobj)
+			json_object_object_add(jentry, "entry", jobj);
+		jobj = json_object_new_string(ndctl_region_get_devname(region));
+		if (jobj)
+			json_object_object_add(jentry, "region", jobj);
+		jobj = json_object_new_string(util_nsmode_name(e->p.mode));
+		if (jobj)
+			json_object_object_add(jentry, "mode", jobj);
+		jobj = util_json_object_hex(start, 0);
+		if (jobj)
+			json_object_object_add(jentry, "start", jobj);
+		jobj = util_json_object_size(e->p.size, 0);
+		if (jobj)
+			json_object_object_add(jentry, "size", jobj);
+		if (e->p.align) {
+			jobj = util_json_object_size(e->p.align, 0);
+			if (jobj)
+				json_object_object_add(jentry, "align", jobj);
+		}
+		jobj = json_object_new_boolean(IS_ALIGNED(start, SZ_1G));
+		if (jobj)
+			json_object_object_add(jentry, "1g_aligned", jobj);
+		start += e->p.size;
+	}
+	util_display_json_array(stdout, jplan, 0);
+}
+
+static int namespace_create_from(struct ndctl_ctx *ctx, int *created)
+{
+	struct create_queue *q = &create_queue;
+	struct parameters base = param;
+	struct util_pool pool = {
+		.arg = q,
+		.jobs = param.jobs ? param.jobs : 16,
+		.run = create_worker,
+		.node = create_node,
+	};
+	struct spec_entry *entries = NULL;
+	struct json_object *jspec;
+	int i, nr, rc = 0;
+
+	*created = 0;
+	jspec = json_object_from_file(param.from);
+	if (!jspec || !json_object_is_type(jspec, json_type_array)) {
+		error("%s: not a JSON array\n", param.from);
+		json_object_put(jspec);
+		return -EINVAL;
+	}
+
+	/* the command line supplies the defaults for every entry */
+	nr = json_object_array_length(jspec);
+	entries = calloc(nr ? nr : 1, sizeof(*entries));
+	if (!entries) {
+		rc = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; rc == 0 && i < nr; i++) {
+		param = base;
+		rc = spec_entry_parse(json_object_array_get_idx(jspec, i), i);
+		entries[i].param = param;
+		entries[i].idx = i;
+		if (param.size)
+			entries[i].size = parse_size64(param.size);
+		if (param.align)
+			entries[i].align = parse_size64(param.align);
+	}
+	if (!rc && base.pack)
+		qsort(entries, nr, sizeof(*entries), spec_entry_cmp);
+	for (i = 0; rc == 0 && i < nr; i++) {
+		param = entries[i].param;
+		rc = spec_entry_plan(ctx, entries[i].idx, i);
+	}
+	param = base;
+	if (rc)
+		goto out;
+
+	qsort(q->entries, q->nr, sizeof(*q->entries), create_entry_cmp);
+	if (param.plan) {
+		create_queue_show(q);
+		goto out;
+	}
+	pool.nr = q->nr;
+	util_pool_run(&pool);
+
+	for (i = 0; i < q->nr; i++) {
+		struct create_entry *e = &q->entries[i];
+
+		if (e->rc) {
+			if (!rc)
+				rc = e->rc;
+			continue;
+		}
+		(*created)++;
+		if (e->jndns) {
+			printf("%s\n", json_object_to_json_string_ext(e->jndns,
+					JSON_C_TO_STRING_PRETTY));
+			json_object_put(e->jndns);
+		}
+	}
+ out:
+	/* the spec's strings are referenced from param until here */
+	json_object_put(jspec);
+	free(entries);
+	free(q->entries);
+	memset(q, 0, sizeof(*q));
+	return rc;
+}
+
 /*
  * Return convention:
  * rc < 0 : Error while zeroing, propagate forward
@@ -1092,7 +1803,7 @@ static int zero_info_block(struct ndctl_namespace *ndns)
 	}
 
 	rc = pwrite(fd, buf, info_size, 0);
-	if (rc < info_size) {
+	if (rc < info_size || fdatasync(fd) < 0) {
 		err("%s: failed to zero info block %s\n",
 				devname, path);
 		rc = -ENXIO;
@@ -1307,77 +2018,92 @@ static int namespace_reconfig(struct ndctl_region *region,
 		}
 	}
 
-	return setup_namespace(region, ndns, &p);
+	return setup_namespace(region, ndns, &p, NULL);
 }
 
 int namespace_check(struct ndctl_namespace *ndns, bool verbose, bool force,
-		bool repair, bool logfix);
-
-static int bus_send_clear(struct ndctl_bus *bus, unsigned long long start,
-		unsigned long long size)
+		bool repair, bool logfix, bool stream, bool quick,
+		const char *checkpoint, bool resume, unsigned int jobs);
+int namespace_clear_btt(struct ndctl_namespace *ndns, bool verbose,
+		const struct ndctl_range *bbs, unsigned int nr,
+		int (*clear)(u64 offset, u64 len, void *data), void *data);
+int namespace_export_btt(struct ndctl_namespace *ndns, bool verbose,
+		bool force, struct btt_export *exp);
+
+static struct ndctl_cmd *region_ars_cap(struct ndctl_region *region)
 {
+	struct ndctl_bus *bus = ndctl_region_get_bus(region);
 	const char *busname = ndctl_bus_get_provider(bus);
-	struct ndctl_cmd *cmd_cap, *cmd_clear;
-	unsigned long long cleared;
-	struct ndctl_range range;
+	struct ndctl_cmd *cmd_cap;
 	int rc;
 
-	/* get ars_cap */
-	cmd_cap = ndctl_bus_cmd_new_ars_cap(bus, start, size);
+	cmd_cap = ndctl_bus_cmd_new_ars_cap(bus,
+			ndctl_region_get_resource(region),
+			ndctl_region_get_size(region));
 	if (!cmd_cap) {
 		err("bus: %s failed to create cmd\n", busname);
-		return -ENOTTY;
+		return NULL;
 	}
 
 	rc = ndctl_cmd_submit_xlat(cmd_cap);
 	if (rc < 0) {
 		err("bus: %s failed to submit cmd: %d\n", busname, rc);
-		goto out_cap;
+		ndctl_cmd_unref(cmd_cap);
+		return NULL;
 	}
+	return cmd_cap;
+}
 
-	/* send clear_error */
-	if (ndctl_cmd_ars_cap_get_range(cmd_cap, &range)) {
-		err("bus: %s failed to get ars_cap range\n", busname);
-		rc = -ENXIO;
-		goto out_cap;
-	}
+/* clear [start, start + size), resuming after any partial clear */
+static int bus_send_clear(struct ndctl_cmd *cmd_cap, struct ndctl_bus *bus,
+		unsigned long long start, unsigned long long size)
+{
+	const char *busname = ndctl_bus_get_provider(bus);
+	unsigned long long cleared;
+	struct ndctl_cmd *cmd_clear;
+	int rc = 0;
 
-	cmd_clear = ndctl_bus_cmd_new_clear_error(range.address,
-					range.length, cmd_cap);
-	if (!cmd_clear) {
-		err("bus: %s failed to create cmd\n", busname);
-		rc = -ENOTTY;
-		goto out_cap;
-	}
+	while (size) {
+		cmd_clear = ndctl_bus_cmd_new_clear_error(start, size, cmd_cap);
+		if (!cmd_clear) {
+			err("bus: %s failed to create cmd\n", busname);
+			return -ENOTTY;
+		}
 
-	rc = ndctl_cmd_submit_xlat(cmd_clear);
-	if (rc < 0) {
-		err("bus: %s failed to submit cmd: %d\n", busname, rc);
-		goto out_clr;
-	}
+		rc = ndctl_cmd_submit_xlat(cmd_clear);
+		cleared = ndctl_cmd_clear_error_get_cleared(cmd_clear);
+		ndctl_cmd_unref(cmd_clear);
+		if (rc < 0) {
+			err("bus: %s failed to submit cmd: %d\n", busname, rc);
+			return rc;
+		}
 
-	cleared = ndctl_cmd_clear_error_get_cleared(cmd_clear);
-	if (cleared != range.length) {
-		err("bus: %s expected to clear: %lld actual: %lld\n",
-				busname, range.length, cleared);
-		rc = -ENXIO;
+		if (!cleared || cleared > size) {
+			err("bus: %s expected to clear: %lld actual: %lld\n",
+					busname, size, cleared);
+			return -ENXIO;
+		}
+		start += cleared;
+		size -= cleared;
 	}
-
-out_clr:
-	ndctl_cmd_unref(cmd_clear);
-out_cap:
-	ndctl_cmd_unref(cmd_cap);
 	return rc;
 }
 
+/*
+ * Badblocks arrive sorted, so runs of abutting records, once widened to
+ * the clear unit, go out as one CLEAR_ERROR against a single ARS_CAP for
+ * the region.
+ */
 static int nstype_clear_badblocks(struct ndctl_namespace *ndns,
 		const char *devname, unsigned long long dev_begin,
 		unsigned long long dev_size)
 {
 	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
 	struct ndctl_bus *bus = ndctl_region_get_bus(region);
-	unsigned long long region_begin, dev_end;
-	unsigned int cleared = 0;
+	unsigned long long region_begin, dev_end, unit;
+	unsigned long long run_begin = 0, run_end = 0;
+	unsigned int cleared = 0, run_blocks = 0;
+	struct ndctl_cmd *cmd_cap;
 	struct badblock *bb;
 	int rc = 0;
 
@@ -1389,6 +2115,16 @@ static int nstype_clear_badblocks(struct ndctl_namespace *ndns,
 		return rc;
 	}
 
+	cmd_cap = region_ars_cap(region);
+	if (!cmd_cap) {
+		if (ndctl_namespace_enable(ndns) < 0)
+			error("%s: failed to reenable namespace\n", devname);
+		return -ENXIO;
+	}
+	unit = ndctl_cmd_ars_cap_get_clear_unit(cmd_cap);
+	if (!unit)
+		unit = 1;
+
 	dev_end = dev_begin + dev_size - 1;
 
 	ndctl_region_badblock_foreach(region, bb) {
@@ -1402,15 +2138,36 @@ static int nstype_clear_badblocks(struct ndctl_namespace *ndns,
 		if (bb_begin < dev_begin || bb_end > dev_end)
 			continue;
 
-		rc = bus_send_clear(bus, bb_begin, bb_len);
-		if (rc) {
-			error("%s: failed to clear badblock at {%lld, %u}\n",
-				devname, bb->offset, bb->len);
-			break;
+		bb_begin = max(ALIGN_DOWN(bb_begin, unit), dev_begin);
+		bb_end = min(ALIGN(bb_end + 1, unit) - 1, dev_end);
+		if (run_blocks && bb_begin <= run_end + 1) {
+			run_end = max(run_end, bb_end);
+			run_blocks += bb->len;
+			continue;
+		}
+
+		if (run_blocks) {
+			rc = bus_send_clear(cmd_cap, bus, run_begin,
+					run_end - run_begin + 1);
+			if (rc)
+				break;
+			cleared += run_blocks;
 		}
-		cleared += bb->len;
+		run_begin = bb_begin;
+		run_end = bb_end;
+		run_blocks = bb->len;
+	}
+	if (rc == 0 && run_blocks) {
+		rc = bus_send_clear(cmd_cap, bus, run_begin,
+				run_end - run_begin + 1);
+		if (rc == 0)
+			cleared += run_blocks;
 	}
+	if (rc)
+		error("%s: failed to clear badblocks at %#llx-%#llx\n",
+				devname, run_begin, run_end);
 	debug("%s: cleared %u badblocks\n", devname, cleared);
+	ndctl_cmd_unref(cmd_cap);
 
 	rc = ndctl_namespace_enable(ndns);
 	if (rc < 0)
@@ -1489,15 +2246,103 @@ static int raw_clear_badblocks(struct ndctl_namespace *ndns)
 	return nstype_clear_badblocks(ndns, devname, begin, size);
 }
 
-static int namespace_wait_scrub(struct ndctl_namespace *ndns, bool do_scrub)
+struct btt_clear_ctx {
+	struct ndctl_cmd *cmd_cap;
+	struct ndctl_bus *bus;
+	unsigned long long ns_begin;
+	unsigned long long cleared;
+};
+
+static int btt_send_clear(u64 offset, u64 len, void *data)
 {
-	const char *devname = ndctl_namespace_get_devname(ndns);
-	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
-	int in_progress, rc;
+	struct btt_clear_ctx *c = data;
+	int rc;
 
-	in_progress = ndctl_bus_get_scrub_state(bus);
-	if (in_progress < 0) {
-		error("%s: Unable to determine scrub state: %s\n", devname,
+	rc = bus_send_clear(c->cmd_cap, c->bus, c->ns_begin + offset, len);
+	if (rc == 0)
+		c->cleared += len >> 9;
+	return rc;
+}
+
+/* the btt walk takes over SIGBUS, so only one may run at a time */
+static pthread_mutex_t btt_clear_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int btt_clear_badblocks(struct ndctl_btt *btt)
+{
+	struct ndctl_namespace *ndns = ndctl_btt_get_namespace(btt);
+	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
+	const char *devname = ndctl_btt_get_devname(btt);
+	unsigned long long region_begin, ns_begin, ns_end;
+	struct btt_clear_ctx c = { 0 };
+	struct ndctl_range *ranges = NULL, *rng;
+	unsigned int nr = 0;
+	struct badblock *bb;
+	int rc;
+
+	region_begin = ndctl_region_get_resource(region);
+	ns_begin = ndctl_namespace_get_resource(ndns);
+	ns_end = ns_begin + ndctl_namespace_get_size(ndns);
+	if (region_begin == ULLONG_MAX || ns_begin == ULLONG_MAX)
+		return -ENXIO;
+
+	/* namespace relative, abutting records merged */
+	ndctl_region_badblock_foreach(region, bb) {
+		unsigned long long bb_begin, bb_len;
+
+		bb_begin = region_begin + (bb->offset << 9);
+		bb_len = (unsigned long long)bb->len << 9;
+		if (bb_begin < ns_begin || bb_begin + bb_len > ns_end)
+			continue;
+		bb_begin -= ns_begin;
+		if (nr && ranges[nr - 1].address + ranges[nr - 1].length
+				== bb_begin) {
+			ranges[nr - 1].length += bb_len;
+			continue;
+		}
+		rng = realloc(ranges, (nr + 1) * sizeof(*rng));
+		if (!rng) {
+			free(ranges);
+			return -ENOMEM;
+		}
+		ranges = rng;
+		ranges[nr].address = bb_begin;
+		ranges[nr].length = bb_len;
+		nr++;
+	}
+	if (!nr)
+		return 0;
+
+	c.bus = ndctl_region_get_bus(region);
+	c.ns_begin = ns_begin;
+	c.cmd_cap = region_ars_cap(region);
+	if (!c.cmd_cap) {
+		free(ranges);
+		return -ENXIO;
+	}
+
+	pthread_mutex_lock(&btt_clear_lock);
+	rc = namespace_clear_btt(ndns, verbose, ranges, nr, btt_send_clear,
+			&c);
+	pthread_mutex_unlock(&btt_clear_lock);
+	if (rc)
+		error("%s: failed to clear all badblocks: %s\n", devname,
+				strerror(-rc));
+	debug("%s: cleared %llu badblocks\n", devname, c.cleared);
+
+	ndctl_cmd_unref(c.cmd_cap);
+	free(ranges);
+	return rc;
+}
+
+static int namespace_wait_scrub(struct ndctl_namespace *ndns, bool do_scrub)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	struct ndctl_bus *bus = ndctl_namespace_get_bus(ndns);
+	int in_progress, rc;
+
+	in_progress = ndctl_bus_get_scrub_state(bus);
+	if (in_progress < 0) {
+		error("%s: Unable to determine scrub state: %s\n", devname,
 				strerror(-in_progress));
 		return in_progress;
 	}
@@ -1526,40 +2371,139 @@ static int namespace_wait_scrub(struct ndctl_namespace *ndns, bool do_scrub)
 	return 0;
 }
 
-static int namespace_clear_bb(struct ndctl_namespace *ndns, bool do_scrub)
-{
-	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
-	struct ndctl_dax *dax = ndctl_namespace_get_dax(ndns);
-	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
+/*
+ * Namespaces are cleared, or destroyed, by a pool of workers, one region
+ * at a time per worker: namespaces in one region share its badblocks
+ * iterator and its seed devices, so they stay in order. Results are
+ * printed afterwards in the order the namespaces were found.
+ */
+struct ns_entry {
+	struct ndctl_namespace *ndns;
 	struct json_object *jndns;
 	int rc;
+};
 
-	if (btt) {
-		/* skip btt error clearing for now */
-		debug("%s: skip error clearing for btt\n",
-				ndctl_btt_get_devname(btt));
-		return 1;
+static struct ns_queue {
+	struct ns_entry *entries;
+	int nr;
+	void (*run)(struct ns_entry *e);
+} ns_queue;
+
+static int ns_queue_add(struct ndctl_namespace *ndns,
+		void (*run)(struct ns_entry *e))
+{
+	struct ns_entry *e;
+
+	e = realloc(ns_queue.entries, (ns_queue.nr + 1) * sizeof(*e));
+	if (!e)
+		return -ENOMEM;
+	ns_queue.entries = e;
+	ns_queue.run = run;
+	e = &ns_queue.entries[ns_queue.nr++];
+	e->ndns = ndns;
+	e->jndns = NULL;
+	e->rc = 0;
+	return 0;
+}
+
+static void destroy_entry_run(struct ns_entry *e)
+{
+	e->rc = namespace_destroy(ndctl_namespace_get_region(e->ndns),
+			e->ndns);
+}
+
+static void clear_entry_run(struct ns_entry *e);
+
+static int namespace_clear_bb(struct ndctl_namespace *ndns, bool do_scrub,
+		bool wait_scrub)
+{
+	int rc;
+
+	if (wait_scrub) {
+		rc = namespace_wait_scrub(ndns, do_scrub);
+		if (rc)
+			return rc;
 	}
 
-	rc = namespace_wait_scrub(ndns, do_scrub);
-	if (rc)
-		return rc;
+	return ns_queue_add(ndns, clear_entry_run);
+}
 
-	if (dax)
-		rc = dax_clear_badblocks(dax);
+static void clear_entry_run(struct ns_entry *e)
+{
+	struct ndctl_namespace *ndns = e->ndns;
+	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
+	struct ndctl_dax *dax = ndctl_namespace_get_dax(ndns);
+	struct ndctl_btt *btt = ndctl_namespace_get_btt(ndns);
+
+	if (btt)
+		e->rc = btt_clear_badblocks(btt);
+	else if (dax)
+		e->rc = dax_clear_badblocks(dax);
 	else if (pfn)
-		rc = pfn_clear_badblocks(pfn);
+		e->rc = pfn_clear_badblocks(pfn);
 	else
-		rc = raw_clear_badblocks(ndns);
+		e->rc = raw_clear_badblocks(ndns);
 
-	if (rc)
-		return rc;
+	if (e->rc == 0)
+		e->jndns = util_namespace_to_json(ndns, UTIL_JSON_MEDIA_ERRORS);
+}
 
-	jndns = util_namespace_to_json(ndns, UTIL_JSON_MEDIA_ERRORS);
-	if (jndns)
-		printf("%s\n", json_object_to_json_string_ext(jndns,
-				JSON_C_TO_STRING_PRETTY));
-	return 0;
+/* the first entry of each region runs that region's entries in order */
+static void ns_worker(void *arg, int i)
+{
+	struct ns_queue *q = arg;
+	struct ndctl_region *region;
+
+	region = ndctl_namespace_get_region(q->entries[i].ndns);
+	if (i && ndctl_namespace_get_region(q->entries[i - 1].ndns) == region)
+		return;
+	for (; i < q->nr && ndctl_namespace_get_region(q->entries[i].ndns)
+			== region; i++)
+		q->run(&q->entries[i]);
+}
+
+static int ns_node(void *arg, int i)
+{
+	struct ns_queue *q = arg;
+
+	return ndctl_namespace_get_numa_node(q->entries[i].ndns);
+}
+
+static int ns_queue_run(int *processed)
+{
+	struct ns_queue *q = &ns_queue;
+	struct util_pool pool = {
+		.arg = q,
+		.nr = q->nr,
+		.jobs = param.jobs ? param.jobs : 16,
+		.run = ns_worker,
+		.node = ns_node,
+	};
+	int i, rc = 0;
+
+	util_pool_run(&pool);
+
+	for (i = 0; i < q->nr; i++) {
+		struct ns_entry *e = &q->entries[i];
+
+		/* skipped, not an error */
+		if (e->rc > 0)
+			continue;
+		if (e->rc) {
+			if (!rc)
+				rc = e->rc;
+			continue;
+		}
+		(*processed)++;
+		if (e->jndns) {
+			printf("%s\n", json_object_to_json_string_ext(e->jndns,
+					JSON_C_TO_STRING_PRETTY));
+			json_object_put(e->jndns);
+		}
+	}
+	free(q->entries);
+	memset(q, 0, sizeof(*q));
+	return rc;
 }
 
 struct read_infoblock_ctx {
@@ -1863,9 +2807,13 @@ static unsigned long PHYS_PFN(unsigned long long phys)
 #define SUBSECTION_SIZE (1UL << SUBSECTION_SHIFT)
 #define MAX_STRUCT_PAGE_SIZE 64
 
-/* Derived from nd_pfn_init() in kernel version v5.5 */
-static int write_pfn_sb(int fd, unsigned long long size, const char *sig,
-		void *buf)
+/*
+ * Derived from nd_pfn_init() in kernel version v5.5. @align and
+ * @parent_uuid are passed in, rather than read from param, so that
+ * namespaces can be written side by side.
+ */
+static int format_pfn_sb(unsigned long long size, const char *sig, void *buf,
+		const char *align_str, const char *parent_uuid_str)
 {
 	unsigned long npfns, align, pfn_align;
 	struct pfn_sb *pfn_sb = buf + SZ_4K;
@@ -1874,19 +2822,18 @@ static int write_pfn_sb(int fd, unsigned long long size, const char *sig,
 	u32 end_trunc, start_pad;
 	enum pfn_mode mode;
 	u64 checksum;
-	int rc;
 
 	start = parse_size64(param.offset);
 	npfns = PHYS_PFN(size - SZ_8K);
-	pfn_align = parse_size64(param.align);
+	pfn_align = parse_size64(align_str);
 	align = max(pfn_align, SUBSECTION_SIZE);
 	if (param.uuid)
 		uuid_parse(param.uuid, uuid);
 	else
 		uuid_generate(uuid);
 
-	if (param.parent_uuid)
-		uuid_parse(param.parent_uuid, parent_uuid);
+	if (parent_uuid_str)
+		uuid_parse(parent_uuid_str, parent_uuid);
 	else
 		memset(parent_uuid, 0, sizeof(uuid_t));
 
@@ -1940,23 +2887,46 @@ static int write_pfn_sb(int fd, unsigned long long size, const char *sig,
 	pfn_sb->page_size = cpu_to_le32(sysconf(_SC_PAGE_SIZE));
 	checksum = fletcher64(pfn_sb, sizeof(*pfn_sb), 0);
 	pfn_sb->checksum = cpu_to_le64(checksum);
+	return 0;
+}
 
-	rc = write(fd, buf, INFOBLOCK_SZ);
+/*
+ * Write the whole infoblock range, including the zeroed first 4K, in a
+ * single write and then flush once. Block devices are switched to
+ * O_DIRECT so the write goes straight to media instead of the page
+ * cache, which is why @buf is page aligned.
+ */
+static int infoblock_write(int fd, void *buf, bool is_blk)
+{
+	ssize_t rc;
+
+	if (fd == STDOUT_FILENO) {
+		rc = write(fd, buf, INFOBLOCK_SZ);
+		return rc < INFOBLOCK_SZ ? -EIO : 0;
+	}
+
+	if (is_blk && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) < 0)
+		debug("O_DIRECT: %s, using buffered writes\n", strerror(errno));
+	rc = pwrite(fd, buf, INFOBLOCK_SZ, 0);
 	if (rc < INFOBLOCK_SZ)
-		return -EIO;
+		return rc < 0 ? -errno : -EIO;
+	if (fdatasync(fd) < 0)
+		return -errno;
 	return 0;
 }
 
-static int file_write_infoblock(const char *path)
+static int file_write_infoblock(const char *path, const char *align,
+		const char *parent_uuid)
 {
 	unsigned long long size = parse_size64(param.size);
+	bool is_blk = false;
 	int fd = -1, rc;
 	void *buf;
 
 	if (param.std_out)
 		fd = STDOUT_FILENO;
 	else {
-		fd = open(path, O_CREAT|O_RDWR, 0644);
+		fd = open(path, O_CREAT|O_RDWR|O_CLOEXEC, 0644);
 		if (fd < 0) {
 			error("failed to open: %s\n", path);
 			return -errno;
@@ -1988,23 +2958,31 @@ static int file_write_infoblock(const char *path)
 		}
 	}
 
-	buf = calloc(INFOBLOCK_SZ, 1);
-	if (!buf) {
+	if (fd != STDOUT_FILENO) {
+		struct stat st;
+
+		is_blk = fstat(fd, &st) == 0 && S_ISBLK(st.st_mode);
+	}
+
+	if (posix_memalign(&buf, SZ_4K, INFOBLOCK_SZ) != 0) {
 		rc = -ENOMEM;
 		goto out;
 	}
+	memset(buf, 0, INFOBLOCK_SZ);
 
 	switch (util_nsmode(param.mode)) {
 	case NDCTL_NS_MODE_FSDAX:
-		rc = write_pfn_sb(fd, size, PFN_SIG, buf);
+		rc = format_pfn_sb(size, PFN_SIG, buf, align, parent_uuid);
 		break;
 	case NDCTL_NS_MODE_DEVDAX:
-		rc = write_pfn_sb(fd, size, DAX_SIG, buf);
+		rc = format_pfn_sb(size, DAX_SIG, buf, align, parent_uuid);
 		break;
 	default:
 		rc = -EINVAL;
 		break;
 	}
+	if (rc == 0)
+		rc = infoblock_write(fd, buf, is_blk);
 
 	free(buf);
 out:
@@ -2037,7 +3015,8 @@ static int namespace_rw_infoblock(struct ndctl_namespace *ndns,
 	uuid_t uuid;
 	char str[40];
 	char path[50];
-	const char *save;
+	char align_str[24];
+	const char *parent_uuid = param.parent_uuid;
 	const char *cmd = write ? "write-infoblock" : "read-infoblock";
 	const char *devname = ndctl_namespace_get_devname(ndns);
 
@@ -2053,61 +3032,585 @@ static int namespace_rw_infoblock(struct ndctl_namespace *ndns,
 		goto out;
 	}
 
-	save = param.parent_uuid;
-	if (!param.parent_uuid) {
+	if (!parent_uuid) {
 		ndctl_namespace_get_uuid(ndns, uuid);
 		uuid_unparse(uuid, str);
-		param.parent_uuid = str;
+		parent_uuid = str;
 	}
 
 	sprintf(path, "/dev/%s", ndctl_namespace_get_block_device(ndns));
 	if (write) {
+		const char *align_arg = param.align;
 		unsigned long long align;
-		bool align_provided = true;
-
-		if (!param.align) {
-			align = ndctl_get_default_alignment(ndns);
 
-			if (asprintf((char **)&param.align, "%llu", align) < 0) {
-				rc = -EINVAL;
-				goto out;
-			}
-			align_provided = false;
+		if (!align_arg) {
+			snprintf(align_str, sizeof(align_str), "%lu",
+					ndctl_get_default_alignment(ndns));
+			align_arg = align_str;
 		}
 
 		if (param.size) {
 			unsigned long long size = parse_size64(param.size);
-			align = parse_size64(param.align);
+			align = parse_size64(align_arg);
 
 			if (align < ULLONG_MAX && !IS_ALIGNED(size, align)) {
 				error("--size=%s not aligned to %s\n", param.size,
-					param.align);
+					align_arg);
 
 				rc = -EINVAL;
 			}
 		}
 
 		if (!rc)
-			rc = file_write_infoblock(path);
-
-		if (!align_provided) {
-			free((char *)param.align);
-			param.align = NULL;
-		}
+			rc = file_write_infoblock(path, align_arg, parent_uuid);
 	} else
 		rc = file_read_infoblock(path, ndns, ri_ctx);
-	param.parent_uuid = save;
 out:
 	ndctl_namespace_set_raw_mode(ndns, 0);
 	ndctl_namespace_disable_invalidate(ndns);
 	return rc;
 }
 
+static void write_infoblock_entry_run(struct ns_entry *e)
+{
+	e->rc = namespace_rw_infoblock(e->ndns, NULL, WRITE);
+}
+
+/* largest of 1G, 2M and 4K faults an address aligned at @addr allows */
+static unsigned long fault_size_at(unsigned long long addr, unsigned long align)
+{
+	unsigned long sizes[] = { SZ_1G, SZ_2M, SZ_4K };
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		if (align >= sizes[i] && IS_ALIGNED(addr, sizes[i]))
+			return sizes[i];
+	return SZ_4K;
+}
+
+static long nr_faults_taken(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_minflt + ru.ru_majflt;
+}
+
+/*
+ * Map @len bytes of @path placed on @align and read one byte per 4K
+ * page, the fault count then gives the size each fault installed.
+ * Reads only, the namespace contents are not touched. Returns the
+ * fault size, or a negative error.
+ */
+static long test_map(const char *path, unsigned long long len,
+		unsigned long align)
+{
+	char *hint, *addr;
+	unsigned long long off;
+	long faults, rc;
+	struct stat st;
+	size_t head;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+		len = min(len, (unsigned long long) st.st_size & ~(SZ_4K - 1ULL));
+	if (!len) {
+		rc = -EINVAL;
+		goto out;
+	}
+
+	hint = mmap(NULL, len + align, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (hint == MAP_FAILED) {
+		rc = -errno;
+		goto out;
+	}
+	addr = (char *) ALIGN((unsigned long) hint, align);
+	head = addr - hint;
+	if (head)
+		munmap(hint, head);
+	if (align - head)
+		munmap(addr + len, align - head);
+
+	addr = mmap(addr, len, PROT_READ, MAP_SHARED | MAP_FIXED, fd, 0);
+	if (addr == MAP_FAILED) {
+		rc = -errno;
+		goto out;
+	}
+
+	faults = nr_faults_taken();
+	for (off = 0; off < len; off += SZ_4K)
+		(void) *(volatile char *) (addr + off);
+	faults = nr_faults_taken() - faults;
+	munmap(addr, len);
+
+	rc = faults > 0 ? (long) (len / faults) : -ENXIO;
+out:
+	close(fd);
+	return rc;
+}
+
+/*
+ * Physical layout of an fsdax or devdax namespace: where the data
+ * starts past the info block and memmap, the alignment that start
+ * actually has, and so the largest fault the kernel can install. A
+ * devdax instance, or an fsdax one given --path on its filesystem, is
+ * then test-mapped to measure what faults are really taken.
+ */
+static int namespace_check_mapping(struct ndctl_namespace *ndns,
+		struct json_object *jmaps)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	enum ndctl_namespace_mode mode = ndctl_namespace_get_mode(ndns);
+	unsigned long long ns_res, res, size, len;
+	struct ndctl_dax *dax = ndctl_namespace_get_dax(ndns);
+	struct ndctl_pfn *pfn = ndctl_namespace_get_pfn(ndns);
+	struct json_object *jmap, *jobj;
+	unsigned long align, layout, fault;
+	const char *path = NULL;
+	char chardev[50];
+	long measured = 0;
+
+	ns_res = ndctl_namespace_get_resource(ndns);
+	if (mode == NDCTL_NS_MODE_FSDAX && pfn) {
+		res = ndctl_pfn_get_resource(pfn);
+		size = ndctl_pfn_get_size(pfn);
+		align = ndctl_pfn_get_align(pfn);
+		path = param.path;
+	} else if (mode == NDCTL_NS_MODE_DEVDAX && dax) {
+		struct daxctl_region *dax_region;
+		struct daxctl_dev *dev = NULL;
+
+		res = ndctl_dax_get_resource(dax);
+		size = ndctl_dax_get_size(dax);
+		align = ndctl_dax_get_align(dax);
+		dax_region = ndctl_dax_get_daxctl_region(dax);
+		if (dax_region)
+			dev = daxctl_dev_get_first(dax_region);
+		if (dev && daxctl_dev_is_enabled(dev)) {
+			snprintf(chardev, sizeof(chardev), "/dev/%s",
+					daxctl_dev_get_devname(dev));
+			path = chardev;
+		}
+	} else {
+		pr_verbose("%s: %s mode is not mapped\n", devname,
+				util_nsmode_name(mode));
+		return -EOPNOTSUPP;
+	}
+
+	if (ns_res == ULLONG_MAX || res == ULLONG_MAX || !align) {
+		err("%s: layout not available\n", devname);
+		return -ENXIO;
+	}
+	layout = fault_size_at(res, align);
+
+	if (path) {
+		/* two of the largest faults, or all of it when smaller */
+		len = min(size, 2ULL * align) & ~(SZ_4K - 1ULL);
+		measured = test_map(path, len, align);
+		if (measured < 0)
+			pr_verbose("%s: test map of %s failed: %s\n", devname,
+					path, strerror(-measured));
+	}
+
+	jmap = json_object_new_object();
+	if (!jmap)
+		return -ENOMEM;
+	json_object_array_add(jmaps, jmap);
+
+	jobj = json_object_new_string(devname);
+	if (jobj)
+		json_object_object_add(jmap, "dev", jobj);
+	jobj = json_object_new_string(util_nsmode_name(mode));
+	if (jobj)
+		json_object_object_add(jmap, "mode", jobj);
+	jobj = util_json_object_hex(ns_res, 0);
+	if (jobj)
+		json_object_object_add(jmap, "resource", jobj);
+	jobj = util_json_object_size(res - ns_res, 0);
+	if (jobj)
+		json_object_object_add(jmap, "data_offset", jobj);
+	jobj = util_json_object_hex(res, 0);
+	if (jobj)
+		json_object_object_add(jmap, "data_start", jobj);
+	jobj = util_json_object_size(size, 0);
+	if (jobj)
+		json_object_object_add(jmap, "data_size", jobj);
+	jobj = util_json_object_size(align, 0);
+	if (jobj)
+		json_object_object_add(jmap, "align", jobj);
+	/* how far past an @align boundary the data starts */
+	jobj = util_json_object_size(res & (align - 1), 0);
+	if (jobj)
+		json_object_object_add(jmap, "misalignment", jobj);
+	jobj = util_json_object_size(layout, 0);
+	if (jobj)
+		json_object_object_add(jmap, "layout_fault_size", jobj);
+	if (measured > 0) {
+		jobj = util_json_object_size(measured, 0);
+		if (jobj)
+			json_object_object_add(jmap, "measured_fault_size",
+					jobj);
+	}
+
+	fault = measured > 0 ? (unsigned long) measured : layout;
+	if (fault <= SZ_4K && size >= SZ_2M)
+		jobj = json_object_new_string("4k-faults");
+	else if (fault < align)
+		jobj = json_object_new_string("degraded");
+	else
+		jobj = json_object_new_string("ok");
+	if (jobj)
+		json_object_object_add(jmap, "status", jobj);
+	return 0;
+}
+
+/*
+ * convert-namespace keeps its progress in the first 4K of the staging
+ * file, and the logical blocks of the namespace follow. Each step is
+ * synced before the progress moves past it, so an interrupted
+ * conversion is resumed by running the same command again.
+ */
+#define CONVERT_SIG_LEN 16
+#define CONVERT_SIG "NDCTL_CONVERT\0\0"
+#define CONVERT_DATA_OFF SZ_4K
+#define CONVERT_CHUNK SZ_16M
+
+enum convert_phase {
+	/* copying out through the BTT, @next is the first lba left */
+	CONVERT_EXPORT,
+	/* everything is staged, the namespace may be in either mode */
+	CONVERT_RECONFIG,
+	/* fsdax, copying back in, @next is the first lba left */
+	CONVERT_IMPORT,
+	CONVERT_DONE,
+};
+
+struct convert_sb {
+	u8 sig[CONVERT_SIG_LEN];
+	u8 uuid[16];
+	char dev[32];
+	le64 nlba;
+	le32 lbasize;
+	le32 phase;
+	le64 next;
+	le64 checksum;
+};
+
+static int convert_sb_write(int fd, struct convert_sb *sb)
+{
+	sb->checksum = 0;
+	sb->checksum = cpu_to_le64(fletcher64(sb, sizeof(*sb), 1));
+	if (pwrite(fd, sb, sizeof(*sb), 0) != sizeof(*sb))
+		return errno ? -errno : -EIO;
+	if (fdatasync(fd) < 0)
+		return -errno;
+	return 0;
+}
+
+/* -ENOENT when @fd holds no conversion, -EINVAL for someone else's */
+static int convert_sb_read(int fd, struct convert_sb *sb, const char *devname,
+		uuid_t uuid)
+{
+	bool match;
+	u64 sum;
+
+	if (pread(fd, sb, sizeof(*sb), 0) != sizeof(*sb)
+			|| memcmp(sb->sig, CONVERT_SIG, CONVERT_SIG_LEN) != 0)
+		return -ENOENT;
+
+	sum = le64_to_cpu(sb->checksum);
+	sb->checksum = 0;
+	if (fletcher64(sb, sizeof(*sb), 1) != sum) {
+		err("%s: staging progress checksum mismatch\n", param.staging);
+		return -EINVAL;
+	}
+	sb->checksum = cpu_to_le64(sum);
+
+	/*
+	 * Reconfiguring may have been interrupted after the namespace was
+	 * torn down, it then has no uuid until convert_reconfig() gives
+	 * it back the staged one. Any other uuid, or a mismatch in any
+	 * other phase, is a different namespace under the same name.
+	 */
+	match = memcmp(sb->uuid, uuid, sizeof(sb->uuid)) == 0;
+	if (le32_to_cpu(sb->phase) == CONVERT_RECONFIG && uuid_is_null(uuid))
+		match = true;
+	if (strncmp(sb->dev, devname, sizeof(sb->dev)) != 0 || !match) {
+		err("%s: holds a conversion of %.*s, not %s\n", param.staging,
+				(int) sizeof(sb->dev), sb->dev, devname);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int convert_reserve(int fd, unsigned long long len)
+{
+	unsigned long long size;
+	struct stat st;
+	int rc;
+
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	if (S_ISREG(st.st_mode)) {
+		/* fail now, not halfway through the copy */
+		rc = posix_fallocate(fd, 0, len);
+		if (rc)
+			err("%s: failed to reserve %llu bytes: %s\n",
+					param.staging, len, strerror(rc));
+		return -rc;
+	}
+	if (!S_ISBLK(st.st_mode) || ioctl(fd, BLKGETSIZE64, &size) < 0) {
+		err("%s: not a file or a block device\n", param.staging);
+		return -EINVAL;
+	}
+	if (size < len) {
+		err("%s: holds %llu bytes, %llu are needed\n", param.staging,
+				size, len);
+		return -ENOSPC;
+	}
+	return 0;
+}
+
+static int convert_export_save(struct btt_export *exp)
+{
+	struct convert_sb *sb = exp->data;
+	int rc;
+
+	if (!sb->nlba) {
+		rc = convert_reserve(exp->fd, exp->off
+				+ exp->nlba * exp->lbasize);
+		if (rc)
+			return rc;
+		sb->nlba = cpu_to_le64(exp->nlba);
+		sb->lbasize = cpu_to_le32(exp->lbasize);
+	} else if (le64_to_cpu(sb->nlba) != exp->nlba
+			|| le32_to_cpu(sb->lbasize) != exp->lbasize) {
+		err("%s: the namespace changed since the export started\n",
+				param.staging);
+		return -EINVAL;
+	}
+
+	sb->next = cpu_to_le64(exp->next);
+	return convert_sb_write(exp->fd, sb);
+}
+
+/* the fsdax block device of @ndns, and its capacity */
+static int convert_open_fsdax(struct ndctl_namespace *ndns,
+		unsigned long long *size)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	struct ndctl_pfn *pfn;
+	char path[50];
+	int fd, rc;
+
+	pfn = ndctl_namespace_get_pfn(ndns);
+	if (!pfn || !ndctl_pfn_is_enabled(pfn)) {
+		rc = ndctl_namespace_enable(ndns);
+		if (rc < 0) {
+			err("%s: failed to enable: %s\n", devname,
+					strerror(-rc));
+			return rc;
+		}
+		pfn = ndctl_namespace_get_pfn(ndns);
+	}
+	if (!pfn || !ndctl_pfn_get_block_device(pfn)) {
+		err("%s: not in fsdax mode\n", devname);
+		return -ENXIO;
+	}
+
+	sprintf(path, "/dev/%s", ndctl_pfn_get_block_device(pfn));
+	fd = open(path, O_RDWR|O_DIRECT|O_EXCL|O_CLOEXEC);
+	if (fd < 0) {
+		rc = -errno;
+		err("%s: failed to open %s: %s\n", devname, path,
+				strerror(errno));
+		return rc;
+	}
+	if (ioctl(fd, BLKGETSIZE64, size) < 0) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+	return fd;
+}
+
+static int convert_reconfig(struct ndctl_region *region,
+		struct ndctl_namespace *ndns, struct convert_sb *sb)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	unsigned long long len, size;
+	char uuid[40];
+	int fd, rc;
+
+	/* keep the identity, and the label layout, the data lives in */
+	if (!uuid_is_null(sb->uuid)) {
+		uuid_unparse(sb->uuid, uuid);
+		param.uuid = uuid;
+	}
+	param.autolabel = false;
+
+	rc = namespace_reconfig(region, ndns);
+	param.uuid = NULL;
+	if (rc)
+		return rc;
+
+	fd = convert_open_fsdax(ndns, &size);
+	if (fd < 0)
+		return fd;
+	close(fd);
+
+	len = le64_to_cpu(sb->nlba) * le32_to_cpu(sb->lbasize);
+	if (size < len) {
+		err("%s: fsdax capacity %llu is short of the %llu staged%s\n",
+				devname, size, len,
+				strcmp(param.map, "dev") == 0
+				? ", retry with --map=mem" : "");
+		return -ENOSPC;
+	}
+	return 0;
+}
+
+static int convert_import(struct ndctl_namespace *ndns, int fd,
+		struct convert_sb *sb)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	unsigned long long size, len, pos, n;
+	void *buf = NULL;
+	int dev_fd, rc = 0;
+
+	dev_fd = convert_open_fsdax(ndns, &size);
+	if (dev_fd < 0)
+		return dev_fd;
+
+	len = le64_to_cpu(sb->nlba) * le32_to_cpu(sb->lbasize);
+	if (size < len) {
+		rc = -ENOSPC;
+		goto out;
+	}
+	if (posix_memalign(&buf, SZ_4K, CONVERT_CHUNK)) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	pos = le64_to_cpu(sb->next) * le32_to_cpu(sb->lbasize);
+	for (; pos < len; pos += n) {
+		n = min(len - pos, (unsigned long long) CONVERT_CHUNK);
+		if (pread(fd, buf, n, CONVERT_DATA_OFF + pos) != (ssize_t) n) {
+			rc = errno ? -errno : -EIO;
+			err("%s: staging read at %#llx failed\n", devname, pos);
+			break;
+		}
+		if (pwrite(dev_fd, buf, n, pos) != (ssize_t) n) {
+			rc = errno ? -errno : -EIO;
+			err("%s: write at %#llx failed: %s\n", devname, pos,
+					strerror(-rc));
+			break;
+		}
+		if (fdatasync(dev_fd) < 0) {
+			rc = -errno;
+			break;
+		}
+		sb->next = cpu_to_le64((pos + n) / le32_to_cpu(sb->lbasize));
+		rc = convert_sb_write(fd, sb);
+		if (rc)
+			break;
+	}
+ out:
+	free(buf);
+	close(dev_fd);
+	return rc;
+}
+
+static int namespace_convert(struct ndctl_region *region,
+		struct ndctl_namespace *ndns)
+{
+	const char *devname = ndctl_namespace_get_devname(ndns);
+	struct convert_sb sb;
+	uuid_t uuid;
+	int fd, rc;
+
+	fd = open(param.staging, O_RDWR|O_CREAT|O_CLOEXEC, 0600);
+	if (fd < 0) {
+		rc = -errno;
+		err("%s: %s\n", param.staging, strerror(errno));
+		return rc;
+	}
+
+	ndctl_namespace_get_uuid(ndns, uuid);
+	rc = convert_sb_read(fd, &sb, devname, uuid);
+	if (rc == -ENOENT) {
+		if (ndctl_namespace_get_mode(ndns) != NDCTL_NS_MODE_SECTOR) {
+			err("%s: not a sector mode namespace\n", devname);
+			rc = -EINVAL;
+			goto out;
+		}
+		memset(&sb, 0, sizeof(sb));
+		memcpy(sb.sig, CONVERT_SIG, CONVERT_SIG_LEN);
+		memcpy(sb.uuid, uuid, sizeof(sb.uuid));
+		snprintf(sb.dev, sizeof(sb.dev), "%s", devname);
+		rc = 0;
+	} else if (rc == 0)
+		pr_verbose("%s: resuming from %s\n", devname, param.staging);
+	if (rc)
+		goto out;
+
+	if (le32_to_cpu(sb.phase) == CONVERT_EXPORT) {
+		struct btt_export exp = {
+			.fd = fd,
+			.off = CONVERT_DATA_OFF,
+			.next = le64_to_cpu(sb.next),
+			.save = convert_export_save,
+			.data = &sb,
+		};
+
+		rc = namespace_export_btt(ndns, verbose, force, &exp);
+		if (rc)
+			goto out;
+		sb.phase = cpu_to_le32(CONVERT_RECONFIG);
+		rc = convert_sb_write(fd, &sb);
+		if (rc)
+			goto out;
+	}
+
+	/* nothing is written to the namespace yet, so redo it from scratch */
+	if (le32_to_cpu(sb.phase) == CONVERT_RECONFIG) {
+		rc = convert_reconfig(region, ndns, &sb);
+		if (rc)
+			goto out;
+		sb.phase = cpu_to_le32(CONVERT_IMPORT);
+		sb.next = 0;
+		rc = convert_sb_write(fd, &sb);
+		if (rc)
+			goto out;
+	}
+
+	if (le32_to_cpu(sb.phase) == CONVERT_IMPORT) {
+		rc = convert_import(ndns, fd, &sb);
+		if (rc)
+			goto out;
+		sb.phase = cpu_to_le32(CONVERT_DONE);
+		rc = convert_sb_write(fd, &sb);
+		if (rc)
+			goto out;
+	}
+
+	pr_verbose("%s: converted, %s is no longer needed\n", devname,
+			param.staging);
+ out:
+	close(fd);
+	return rc;
+}
+
 static int do_xaction_namespace(const char *namespace,
 		enum device_action action, struct ndctl_ctx *ctx,
 		int *processed)
 {
 	struct read_infoblock_ctx ri_ctx = { 0 };
+	struct json_object *jmaps = NULL;
 	struct ndctl_namespace *ndns, *_n;
 	int rc = -ENXIO, saved_rc = 0;
 	struct ndctl_region *region;
@@ -2142,7 +3645,8 @@ static int do_xaction_namespace(const char *namespace,
 		if (!param.align)
 			param.align = "2M";
 
-		rc = file_write_infoblock(param.outfile);
+		rc = file_write_infoblock(param.outfile, param.align,
+				param.parent_uuid);
 		if (rc >= 0)
 			(*processed)++;
 		return rc;
@@ -2166,9 +3670,19 @@ static int do_xaction_namespace(const char *namespace,
 		cmd_name = "check namespace";
 	else if (action == ACTION_CLEAR)
 		cmd_name = "clear errors namespace";
+	else if (action == ACTION_CONVERT)
+		cmd_name = "convert namespace";
+	else if (action == ACTION_BENCH)
+		cmd_name = "bench namespace";
+	else if (action == ACTION_CHECK_MAPPING) {
+		cmd_name = "check mapping";
+		jmaps = json_object_new_array();
+		if (!jmaps)
+			return -ENOMEM;
+	}
 
         ndctl_bus_foreach(ctx, bus) {
-		bool do_scrub;
+		bool do_scrub, wait_scrub = true;
 
 		if (!util_bus_filter(bus, param.bus))
 			continue;
@@ -2180,18 +3694,8 @@ static int do_xaction_namespace(const char *namespace,
 			if (!util_region_filter(region, param.region))
 				continue;
 
-			if (param.type) {
-				if (strcmp(param.type, "pmem") == 0
-						&& ndctl_region_get_type(region)
-						== ND_DEVICE_REGION_PMEM)
-					/* pass */;
-				else if (strcmp(param.type, "blk") == 0
-						&& ndctl_region_get_type(region)
-						== ND_DEVICE_REGION_BLK)
-					/* pass */;
-				else
-					continue;
-			}
+			if (!region_type_filter(region))
+				continue;
 
 			if (action == ACTION_CREATE && !namespace) {
 				rc = namespace_create(region);
@@ -2227,26 +3731,28 @@ static int do_xaction_namespace(const char *namespace,
 					}
 					break;
 				case ACTION_DESTROY:
-					rc = namespace_destroy(region, ndns);
-					if (rc == 0)
-						(*processed)++;
-					/* return success if skipped */
-					if (rc > 0)
-						rc = 0;
+					rc = ns_queue_add(ndns, destroy_entry_run);
 					break;
 				case ACTION_CHECK:
 					rc = namespace_check(ndns, verbose,
-							force, repair, logfix);
+							force, repair, logfix,
+							param.stream,
+							param.quick,
+							param.checkpoint,
+							param.resume,
+							param.jobs);
 					if (rc == 0)
 						(*processed)++;
 					break;
 				case ACTION_CLEAR:
-					rc = namespace_clear_bb(ndns, do_scrub);
+					rc = namespace_clear_bb(ndns, do_scrub,
+							wait_scrub);
 
 					/* one scrub per bus is sufficient */
-					do_scrub = false;
-					if (rc == 0)
-						(*processed)++;
+					if (rc == 0) {
+						do_scrub = false;
+						wait_scrub = false;
+					}
 					break;
 				case ACTION_CREATE:
 					rc = namespace_reconfig(region, ndns);
@@ -2259,10 +3765,32 @@ static int do_xaction_namespace(const char *namespace,
 						(*processed)++;
 					break;
 				case ACTION_WRITE_INFOBLOCK:
-					rc = namespace_rw_infoblock(ndns, NULL, WRITE);
+					rc = ns_queue_add(ndns,
+							write_infoblock_entry_run);
+					break;
+				case ACTION_CONVERT:
+					rc = namespace_convert(region, ndns);
 					if (rc == 0)
 						(*processed)++;
 					break;
+				case ACTION_BENCH:
+					rc = namespace_bench(ndns, &bench, verbose);
+					if (rc == 0)
+						(*processed)++;
+					/* "all" skips devdax namespaces */
+					else if (rc == -EOPNOTSUPP
+						&& strcmp(namespace, "all") == 0)
+						rc = 0;
+					break;
+				case ACTION_CHECK_MAPPING:
+					rc = namespace_check_mapping(ndns, jmaps);
+					if (rc == 0)
+						(*processed)++;
+					/* "all" skips raw and sector namespaces */
+					else if (rc == -EOPNOTSUPP
+						&& strcmp(namespace, "all") == 0)
+						rc = 0;
+					break;
 				default:
 					rc = -EINVAL;
 					break;
@@ -2271,9 +3799,27 @@ static int do_xaction_namespace(const char *namespace,
 		}
 	}
 
+	if (ns_queue.nr) {
+		int queue_rc = ns_queue_run(processed);
+
+		if (queue_rc)
+			rc = queue_rc;
+	}
+
 	if (ri_ctx.jblocks)
 		util_display_json_array(ri_ctx.f_out, ri_ctx.jblocks, 0);
 
+	if (jmaps)
+		util_display_json_array(stdout, jmaps, 0);
+
+	if (action == ACTION_BENCH) {
+		struct json_object *jreport = bench_report(&bench);
+
+		if (jreport)
+			util_display_json_array(stdout, jreport, 0);
+		bench_free(&bench);
+	}
+
 	if (ri_ctx.f_out && ri_ctx.f_out != stdout)
 		fclose(ri_ctx.f_out);
 
@@ -2337,6 +3883,17 @@ int cmd_create_namespace(int argc, const char **argv, struct ndctl_ctx *ctx)
 			ACTION_CREATE, create_options, xable_usage);
 	int created, rc;
 
+	if (param.from) {
+		rc = namespace_create_from(ctx, &created);
+		if (!param.plan)
+			fprintf(stderr, "created %d namespace%s\n", created,
+				created == 1 ? "" : "s");
+		if (rc < 0 && !err_count)
+			fprintf(stderr, "failed to create namespaces: %s\n",
+					strerror(-rc));
+		return rc;
+	}
+
 	rc = do_xaction_namespace(namespace, ACTION_CREATE, ctx, &created);
 	if (rc < 0 && created < 1 && param.do_scan) {
 		/*
@@ -2442,3 +3999,53 @@ int cmd_write_infoblock(int argc, const char **argv, struct ndctl_ctx *ctx)
 	fprintf(stderr, "wrote %d infoblock%s\n", write, write == 1 ? "" : "s");
 	return rc;
 }
+
+int cmd_check_mapping(int argc, const char **argv, struct ndctl_ctx *ctx)
+{
+	char *xable_usage = "ndctl check-mapping <namespace> [<options>]";
+	const char *namespace = parse_namespace_options(argc, argv,
+			ACTION_CHECK_MAPPING, check_mapping_options,
+			xable_usage);
+	int checked, rc;
+
+	rc = do_xaction_namespace(namespace, ACTION_CHECK_MAPPING, ctx,
+			&checked);
+	if (rc < 0 && !err_count)
+		fprintf(stderr, "error checking mappings: %s\n",
+				strerror(-rc));
+	fprintf(stderr, "checked %d namespace%s\n", checked,
+			checked == 1 ? "" : "s");
+	return rc;
+}
+
+int cmd_convert_namespace(int argc, const char **argv, struct ndctl_ctx *ctx)
+{
+	char *xable_usage = "ndctl convert-namespace <namespace> [<options>]";
+	const char *namespace = parse_namespace_options(argc, argv,
+			ACTION_CONVERT, convert_options, xable_usage);
+	int converted, rc;
+
+	rc = do_xaction_namespace(namespace, ACTION_CONVERT, ctx, &converted);
+	if (rc < 0 && !err_count)
+		fprintf(stderr, "error converting namespaces: %s\n",
+				strerror(-rc));
+	fprintf(stderr, "converted %d namespace%s\n", converted,
+			converted == 1 ? "" : "s");
+	return rc;
+}
+
+int cmd_bench_namespace(int argc, const char **argv, struct ndctl_ctx *ctx)
+{
+	char *xable_usage = "ndctl bench-namespace <namespace> [<options>]";
+	const char *namespace = parse_namespace_options(argc, argv,
+			ACTION_BENCH, bench_options, xable_usage);
+	int benched, rc;
+
+	rc = do_xaction_namespace(namespace, ACTION_BENCH, ctx, &benched);
+	if (rc < 0 && !err_count)
+		fprintf(stderr, "error benchmarking namespaces: %s\n",
+				strerror(-rc));
+	fprintf(stderr, "benchmarked %d namespace%s\n", benched,
+			benched == 1 ? "" : "s");
+	return rc;
+}
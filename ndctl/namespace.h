@@ -89,6 +89,62 @@ struct namespace_label {
 	le64 checksum;
 };
 
+#define NSINDEX_SIG "NAMESPACE_INDEX\0"
+
+/*
+ * One index block of a label area, checked the way __label_validate()
+ * in ndctl/lib/dimm.c checks each of the two, for @label_size byte
+ * labels in @index_size byte index blocks. Returns NULL if the block is
+ * valid, otherwise the name of the first field found wrong.
+ */
+static inline const char *nsindex_verify(struct namespace_index *nsindex,
+		int i, size_t index_size, unsigned int label_size,
+		unsigned long config_size)
+{
+	unsigned int version, labelsize;
+	u64 sum_save, sum, size;
+	u32 seq, nslot;
+
+	if (memcmp(nsindex->sig, NSINDEX_SIG, NSINDEX_SIG_LEN) != 0)
+		return "signature";
+
+	/* label sizes larger than 128 arrived with v1.2 */
+	version = le16_to_cpu(nsindex->major) * 100
+		+ le16_to_cpu(nsindex->minor);
+	if (version >= 102)
+		labelsize = 1 << (7 + nsindex->labelsize);
+	else
+		labelsize = 128;
+	if (labelsize != label_size)
+		return "labelsize";
+
+	sum_save = le64_to_cpu(nsindex->checksum);
+	nsindex->checksum = cpu_to_le64(0);
+	sum = fletcher64(nsindex, index_size, 1);
+	nsindex->checksum = cpu_to_le64(sum_save);
+	if (sum != sum_save)
+		return "checksum";
+
+	seq = le32_to_cpu(nsindex->seq);
+	if ((seq & NSINDEX_SEQ_MASK) == 0)
+		return "sequence";
+
+	/* sanity check the index against expected values */
+	if (le64_to_cpu(nsindex->myoff) != i * index_size)
+		return "myoff";
+	if (le64_to_cpu(nsindex->otheroff) != (!i) * index_size)
+		return "otheroff";
+
+	size = le64_to_cpu(nsindex->mysize);
+	if (size > index_size || size < sizeof(struct namespace_index))
+		return "mysize";
+
+	nslot = le32_to_cpu(nsindex->nslot);
+	if (nslot * label_size + 2 * index_size > config_size)
+		return "nslot";
+	return NULL;
+}
+
 #define BTT_SIG_LEN 16
 #define BTT_SIG "BTT_ARENA_INFO\0"
 #define MAP_TRIM_SHIFT 31
@@ -252,5 +308,25 @@ static inline bool verify_infoblock_checksum(union info_block *sb)
 	return true;
 }
 
+/**
+ * struct btt_export - logical blocks of a BTT streamed out, see
+ * namespace_export_btt()
+ * @fd: where the blocks go
+ * @off: offset in @fd of lba 0
+ * @next: first lba still to copy, advanced as chunks reach @fd
+ * @nlba: set to the number of external lbas
+ * @lbasize: set to the external lba size
+ * @save: called once @nlba and @lbasize are known, and after each chunk
+ * @data: for @save
+ */
+struct btt_export {
+	int fd;
+	u64 off;
+	u64 next;
+	u64 nlba;
+	u32 lbasize;
+	int (*save)(struct btt_export *exp);
+	void *data;
+};
 
 #endif /* __NDCTL_NAMESPACE_H__ */
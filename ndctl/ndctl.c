@@ -12,14 +12,17 @@
 #include <sys/types.h>
 #include <ndctl/builtin.h>
 #include <ndctl/libndctl.h>
+#include <daxctl/libdaxctl.h>
 #include <ccan/array_size/array_size.h>
 
 #include <util/parse-options.h>
 #include <util/strbuf.h>
 #include <util/util.h>
 #include <util/main.h>
+#include <util/daemon.h>
+#include <util/pool.h>
 
-static const char ndctl_usage_string[] = "ndctl [--version] [--help] COMMAND [ARGS]";
+static const char ndctl_usage_string[] = "ndctl [--version] [--help] [-j <n>] COMMAND [ARGS]";
 static const char ndctl_more_info_string[] =
 	"See 'ndctl help COMMAND' for more information on a specific command.\n"
 	" ndctl --list-cmds to see all available commands";
@@ -65,9 +68,13 @@ static struct cmd_struct commands[] = {
 	{ "read-infoblock",  { cmd_read_infoblock } },
 	{ "write-infoblock",  { cmd_write_infoblock } },
 	{ "check-namespace", { cmd_check_namespace } },
+	{ "check-mapping", { cmd_check_mapping } },
+	{ "convert-namespace", { cmd_convert_namespace } },
+	{ "bench-namespace", { cmd_bench_namespace } },
 	{ "clear-errors", { cmd_clear_errors } },
 	{ "enable-region", { cmd_enable_region } },
 	{ "disable-region", { cmd_disable_region } },
+	{ "flush", { cmd_flush } },
 	{ "enable-dimm", { cmd_enable_dimm } },
 	{ "disable-dimm", { cmd_disable_dimm } },
 	{ "zero-labels", { cmd_zero_labels } },
@@ -75,6 +82,7 @@ static struct cmd_struct commands[] = {
 	{ "write-labels", { cmd_write_labels } },
 	{ "init-labels", { cmd_init_labels } },
 	{ "check-labels", { cmd_check_labels } },
+	{ "query-labels", { cmd_query_labels } },
 	{ "inject-error", { cmd_inject_error } },
 	{ "update-firmware", { cmd_update_firmware } },
 	{ "inject-smart", { cmd_inject_smart } },
@@ -92,6 +100,7 @@ static struct cmd_struct commands[] = {
 	{ "wait-overwrite", { cmd_wait_overwrite } },
 	{ "list", { cmd_list } },
 	{ "monitor", { cmd_monitor } },
+	{ "daemon", { cmd_daemon } },
 	{ "help", { cmd_help } },
 	#ifdef ENABLE_TEST
 	{ "test", { cmd_test } },
@@ -122,9 +131,15 @@ int main(int argc, const char **argv)
 		goto out;
 	}
 
+	/* a resident daemon answers this without enumerating */
+	main_handle_daemon_command(argc, argv, PROG_NDCTL);
+
 	rc = ndctl_new(&ctx);
 	if (rc)
 		goto out;
+	/* the top level -j bounds the library's threads too */
+	ndctl_set_max_threads(ctx, util_pool_max_jobs);
+	daxctl_set_max_threads(ndctl_get_daxctl_ctx(ctx), util_pool_max_jobs);
 	main_handle_internal_command(argc, argv, ctx, commands,
 			ARRAY_SIZE(commands), PROG_NDCTL);
 	ndctl_unref(ctx);
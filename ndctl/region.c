@@ -4,8 +4,11 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <ndctl.h>
 #include "action.h"
+#include <util/json.h>
 #include <util/filter.h>
+#include <json-c/json.h>
 #include <util/parse-options.h>
 #include <ndctl/libndctl.h>
 
@@ -153,3 +156,117 @@ int cmd_enable_region(int argc, const char **argv, struct ndctl_ctx *ctx)
 		return 0;
 	}
 }
+
+static struct ndctl_region **flush_regions_get(struct ndctl_ctx *ctx,
+		const char *bus_arg, const char *region_arg, int *count)
+{
+	struct ndctl_region **regions = NULL, **tmp, *region;
+	struct ndctl_bus *bus;
+	int nr = 0;
+
+	ndctl_bus_foreach(ctx, bus) {
+		if (!util_bus_filter(bus, bus_arg))
+			continue;
+
+		ndctl_region_foreach(bus, region) {
+			if (!util_region_filter(region, region_arg))
+				continue;
+			/* only pmem regions have a deep_flush attribute */
+			if (ndctl_region_get_type(region)
+					!= ND_DEVICE_REGION_PMEM)
+				continue;
+			tmp = realloc(regions, sizeof(*regions) * (nr + 1));
+			if (!tmp) {
+				free(regions);
+				*count = -ENOMEM;
+				return NULL;
+			}
+			regions = tmp;
+			regions[nr++] = region;
+		}
+	}
+
+	*count = nr;
+	return regions;
+}
+
+int cmd_flush(int argc, const char **argv, struct ndctl_ctx *ctx)
+{
+	const char *bus = NULL, *region = "all";
+	struct json_object *jregions, *jregion;
+	unsigned long long *latency = NULL;
+	struct ndctl_region **regions;
+	int i, count = 0, *results = NULL, failed;
+	const struct option options[] = {
+		OPT_STRING('b', "bus", &bus, "bus-id",
+			"flush regions on a bus with an id/provider of <bus-id>"),
+		OPT_STRING('r', "regions", &region, "region-id",
+			"flush <region-id>, or \"all\" regions (default)"),
+		OPT_END(),
+	};
+	const char * const u[] = {
+		"ndctl flush [<options>]",
+		NULL
+	};
+
+	argc = parse_options(argc, argv, options, u, 0);
+	for (i = 0; i < argc; i++)
+		error("unknown parameter \"%s\"\n", argv[i]);
+	if (argc)
+		usage_with_options(u, options);
+
+	regions = flush_regions_get(ctx, bus, region, &count);
+	if (count < 0) {
+		failed = count;
+		goto out;
+	}
+	if (count == 0) {
+		fprintf(stderr, "flushed 0 regions\n");
+		return 0;
+	}
+
+	results = calloc(count, sizeof(*results));
+	latency = calloc(count, sizeof(*latency));
+	if (!results || !latency) {
+		failed = -ENOMEM;
+		goto out;
+	}
+
+	failed = ndctl_region_deep_flush_many(regions, count, results, latency);
+	if (failed < 0)
+		goto out;
+
+	jregions = json_object_new_array();
+	if (!jregions) {
+		failed = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < count; i++) {
+		jregion = json_object_new_object();
+		if (!jregion)
+			continue;
+		json_object_object_add(jregion, "dev", json_object_new_string(
+				ndctl_region_get_devname(regions[i])));
+		if (results[i])
+			json_object_object_add(jregion, "error",
+					json_object_new_string(
+						strerror(-results[i])));
+		else
+			json_object_object_add(jregion, "latency_ns",
+					json_object_new_int64(latency[i]));
+		json_object_array_add(jregions, jregion);
+	}
+	util_display_json_array(stdout, jregions, 0);
+
+	fprintf(stderr, "flushed %d region%s\n", count - failed,
+			count - failed == 1 ? "" : "s");
+	failed = failed ? -EIO : 0;
+ out:
+	if (failed == -ENOMEM)
+		fprintf(stderr, "error flushing regions: %s\n",
+				strerror(ENOMEM));
+	free(latency);
+	free(results);
+	free(regions);
+	return failed;
+}
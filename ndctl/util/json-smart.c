@@ -8,19 +8,50 @@
 #include <ccan/array_size/array_size.h>
 #include <ndctl.h>
 
+/*
+ * Take @dimm's completed command from @batch when there is one, else
+ * build and submit it here. Either way the caller owns a reference.
+ */
+static struct ndctl_cmd *health_cmd_submit(struct ndctl_dimm *dimm,
+		struct ndctl_cmd_batch *batch,
+		struct ndctl_cmd *(*new_cmd)(struct ndctl_dimm *dimm), int *rc)
+{
+	struct ndctl_cmd *cmd;
+	int idx = -ENOENT, xlat_rc;
+
+	if (batch)
+		idx = ndctl_cmd_batch_find_dimm(batch, dimm);
+	if (idx < 0) {
+		cmd = new_cmd(dimm);
+		if (cmd)
+			*rc = ndctl_cmd_submit_xlat(cmd);
+		return cmd;
+	}
+
+	cmd = ndctl_cmd_batch_get_cmd(batch, idx);
+	ndctl_cmd_ref(cmd);
+	*rc = ndctl_cmd_batch_get_result(batch, idx);
+	if (*rc >= 0) {
+		xlat_rc = ndctl_cmd_xlat_firmware_status(cmd);
+		if (xlat_rc)
+			*rc = xlat_rc;
+	}
+	return cmd;
+}
+
 static void smart_threshold_to_json(struct ndctl_dimm *dimm,
-		struct json_object *jhealth)
+		struct ndctl_cmd_batch *batch, struct json_object *jhealth)
 {
 	unsigned int alarm_control;
 	struct json_object *jobj;
 	struct ndctl_cmd *cmd;
 	int rc;
 
-	cmd = ndctl_dimm_cmd_new_smart_threshold(dimm);
+	cmd = health_cmd_submit(dimm, batch,
+			ndctl_dimm_cmd_new_smart_threshold, &rc);
 	if (!cmd)
 		return;
 
-	rc = ndctl_cmd_submit_xlat(cmd);
 	if (rc < 0)
 		goto out;
 
@@ -90,7 +121,42 @@ static void smart_threshold_to_json(struct ndctl_dimm *dimm,
 	ndctl_cmd_unref(cmd);
 }
 
-struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
+/* platform counters outside of SMART, e.g. papr_scm's perf_stats */
+static void perf_stats_to_json(struct ndctl_dimm *dimm,
+		struct json_object *jhealth)
+{
+	unsigned long long stats[NDCTL_PERF_STAT_MAX], valid;
+	struct json_object *jstats, *jobj;
+	unsigned int i;
+
+	if (ndctl_dimm_get_perf_stats(dimm, stats, ARRAY_SIZE(stats),
+				&valid) < 0 || !valid)
+		return;
+
+	jstats = json_object_new_object();
+	if (!jstats)
+		return;
+	for (i = 0; i < ARRAY_SIZE(stats); i++) {
+		if (!(valid & (1ULL << i)))
+			continue;
+		jobj = json_object_new_int64(stats[i]);
+		if (jobj)
+			json_object_object_add(jstats,
+					ndctl_perf_stat_name(i), jobj);
+	}
+	json_object_object_add(jhealth, "performance_stats", jstats);
+}
+
+/**
+ * util_dimm_health_batch_to_json - health from pre-submitted commands
+ * @dimm: dimm to report
+ * @smart: optional ndctl_bus_cmd_batch_dimms() batch of smart commands
+ * @threshold: optional batch of smart threshold commands
+ *
+ * A dimm missing from a batch has its command submitted here instead.
+ */
+struct json_object *util_dimm_health_batch_to_json(struct ndctl_dimm *dimm,
+		struct ndctl_cmd_batch *smart, struct ndctl_cmd_batch *threshold)
 {
 	struct json_object *jhealth = json_object_new_object();
 	struct json_object *jobj;
@@ -101,11 +167,10 @@ struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
 	if (!jhealth)
 		return NULL;
 
-	cmd = ndctl_dimm_cmd_new_smart(dimm);
+	cmd = health_cmd_submit(dimm, smart, ndctl_dimm_cmd_new_smart, &rc);
 	if (!cmd)
 		goto err;
 
-	rc = ndctl_cmd_submit_xlat(cmd);
 	if (rc < 0) {
 		jobj = json_object_new_string("unknown");
 		if (jobj)
@@ -175,7 +240,7 @@ struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
 			json_object_object_add(jhealth, "alarm_spares", jobj);
 	}
 
-	smart_threshold_to_json(dimm, jhealth);
+	smart_threshold_to_json(dimm, threshold, jhealth);
 
 	if (flags & ND_SMART_USED_VALID) {
 		unsigned int life_used = ndctl_cmd_smart_get_life_used(cmd);
@@ -201,6 +266,8 @@ struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
 			json_object_object_add(jhealth, "shutdown_count", jobj);
 	}
 
+	perf_stats_to_json(dimm, jhealth);
+
 	ndctl_cmd_unref(cmd);
 	return jhealth;
  err:
@@ -211,3 +278,8 @@ struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
 		ndctl_cmd_unref(cmd);
 	return jhealth;
 }
+
+struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm)
+{
+	return util_dimm_health_batch_to_json(dimm, NULL, NULL);
+}
@@ -8,6 +8,10 @@ struct test_ctx;
 struct ndctl_ctx;
 struct test_ctx *test_new(unsigned int kver);
 int test_result(struct test_ctx *test, int rc);
+void test_set_timing(struct test_ctx *test, const char *name,
+		const char *timing, const char *baseline);
+void test_step_begin(struct test_ctx *test, const char *name);
+void test_step_end(struct test_ctx *test);
 int test_get_skipped(struct test_ctx *test);
 int test_get_attempted(struct test_ctx *test);
 int __test_attempt(struct test_ctx *test, unsigned int kver,
@@ -26,6 +30,7 @@ int ndctl_test_init(struct kmod_ctx **ctx, struct kmod_module **mod,
 
 struct ndctl_ctx;
 int test_parent_uuid(int loglevel, struct test_ctx *test, struct ndctl_ctx *ctx);
+int test_watch(int loglevel, struct test_ctx *test, struct ndctl_ctx *ctx);
 int test_multi_pmem(int loglevel, struct test_ctx *test, struct ndctl_ctx *ctx);
 int test_dax_directio(int dax_fd, unsigned long align, void *dax_addr, off_t offset);
 int test_dax_remap(struct test_ctx *test, int dax_fd, unsigned long align, void *dax_addr,
@@ -35,8 +35,8 @@
 #define err(msg)\
 	fprintf(stderr, "%s:%d: %s (%s)\n", __func__, __LINE__, msg, strerror(errno))
 
-static struct ndctl_namespace *create_blk_namespace(int region_fraction,
-		struct ndctl_region *region)
+static struct ndctl_namespace *create_blk_namespace(struct test_ctx *test,
+		int region_fraction, struct ndctl_region *region)
 {
 	struct ndctl_namespace *ndns, *seed_ns = NULL;
 	unsigned long long size;
@@ -55,6 +55,8 @@ static struct ndctl_namespace *create_blk_namespace(int region_fraction,
 	uuid_generate(uuid);
 	size = ndctl_region_get_size(region)/region_fraction;
 
+	/* setting the uuid and size writes the labels */
+	test_step_begin(test, "blk-namespace-create");
 	if (ndctl_namespace_set_uuid(seed_ns, uuid) < 0)
 		return NULL;
 
@@ -64,8 +66,10 @@ static struct ndctl_namespace *create_blk_namespace(int region_fraction,
 	if (ndctl_namespace_set_sector_size(seed_ns, 512) < 0)
 		return NULL;
 
+	test_step_begin(test, "blk-namespace-enable");
 	if (ndctl_namespace_enable(seed_ns) < 0)
 		return NULL;
+	test_step_end(test);
 
 	return seed_ns;
 }
@@ -242,17 +246,20 @@ int test_blk_namespaces(int log_level, struct test_ctx *test,
 			ndctl_bus_get_provider(bus));
 
 	/* get the system to a clean state */
-        ndctl_region_foreach(bus, region)
-                ndctl_region_disable_invalidate(region);
-
-        ndctl_dimm_foreach(bus, dimm) {
-                rc = ndctl_dimm_zero_labels(dimm);
-                if (rc < 0) {
-                        fprintf(stderr, "failed to zero %s\n",
-                                        ndctl_dimm_get_devname(dimm));
+	ndctl_region_foreach(bus, region)
+		ndctl_region_disable_invalidate(region);
+
+	test_step_begin(test, "blk-zero-labels");
+	ndctl_dimm_foreach(bus, dimm) {
+		rc = ndctl_dimm_zero_labels(dimm);
+		if (rc < 0) {
+			fprintf(stderr, "failed to zero %s\n",
+					ndctl_dimm_get_devname(dimm));
 			goto err_module;
-                }
-        }
+		}
+	}
+
+	test_step_end(test);
 
 	/* create our config */
 	ndctl_region_foreach(bus, region)
@@ -268,31 +275,33 @@ int test_blk_namespaces(int log_level, struct test_ctx *test,
 	}
 
 	rc = -ENODEV;
-	ndns[0] = create_blk_namespace(4, blk_region);
+	ndns[0] = create_blk_namespace(test, 4, blk_region);
 	if (!ndns[0]) {
 		fprintf(stderr, "%s: failed to create block namespace\n", comm);
 		goto err_cleanup;
 	}
 
-	ndns[1] = create_blk_namespace(4, blk_region);
+	ndns[1] = create_blk_namespace(test, 4, blk_region);
 	if (!ndns[1]) {
 		fprintf(stderr, "%s: failed to create block namespace\n", comm);
 		goto err_cleanup;
 	}
 
+	test_step_begin(test, "blk-namespace-destroy");
 	rc = disable_blk_namespace(ndns[0]);
 	if (rc < 0) {
 		fprintf(stderr, "%s: failed to disable block namespace\n", comm);
 		goto err_cleanup;
 	}
 
-	ndns[0] = create_blk_namespace(2, blk_region);
+	ndns[0] = create_blk_namespace(test, 2, blk_region);
 	if (!ndns[0]) {
 		fprintf(stderr, "%s: failed to create block namespace\n", comm);
 		rc = -ENODEV;
 		goto err_cleanup;
 	}
 
+	test_step_begin(test, "blk-namespace-destroy");
 	rc = disable_blk_namespace(ndns[1]);
 	if (rc < 0) {
 		fprintf(stderr, "%s: failed to disable block namespace\n", comm);
@@ -300,13 +309,14 @@ int test_blk_namespaces(int log_level, struct test_ctx *test,
 	}
 
 	rc = -ENODEV;
-	ndns[1] = create_blk_namespace(2, blk_region);
+	ndns[1] = create_blk_namespace(test, 2, blk_region);
 	if (!ndns[1]) {
 		fprintf(stderr, "%s: failed to create block namespace\n", comm);
 		goto err_cleanup;
 	}
 
 	/* okay, all set up, do some I/O */
+	test_step_begin(test, "blk-io");
 	rc = -EIO;
 	sprintf(bdev, "/dev/%s", ndctl_namespace_get_block_device(ndns[0]));
 	if (ns_do_io(bdev))
@@ -314,6 +324,7 @@ int test_blk_namespaces(int log_level, struct test_ctx *test,
 	sprintf(bdev, "/dev/%s", ndctl_namespace_get_block_device(ndns[1]));
 	if (ns_do_io(bdev))
 		goto err_cleanup;
+	test_step_end(test);
 	rc = 0;
 
  err_cleanup:
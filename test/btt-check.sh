@@ -147,6 +147,45 @@ test_bitmap()
 	reset && create
 }
 
+# print the first arena's map offset, in raw mode
+map_offset()
+{
+	local map
+
+	map=$(hexdump -s 96 -n 4 "/dev/$raw_bdev" | head -1 | cut -d' ' -f2-)
+	echo $((0x${map#* }${map%% *}))
+}
+
+# print the raw map entry for lba $1 of the first arena, in raw mode
+map_entry()
+{
+	local ent
+
+	ent=$(hexdump -s $(($(map_offset) + 4 * $1)) -n 4 "/dev/$raw_bdev" | head -1 | cut -d' ' -f2-)
+	printf "0x%x\n" "0x${ent#* }${ent%% *}"
+}
+
+test_clear_trimmed()
+{
+	echo "=== ${FUNCNAME[0]} ==="
+	reset && create
+	set_raw
+	# trim lba 0, Z flag alone, over its initial block 0
+	printf '\x00\x00\x00\x80' | dd of=/dev/$raw_bdev bs=1 seek=$(map_offset) conv=notrunc
+	[ "$(map_entry 0)" = "0x80000000" ] || err "$LINENO"
+	# poison block 0, the data area starts one page in
+	$NDCTL inject-error --block=$((bs / 512)) --count=$((bs / 512)) $dev
+	$NDCTL start-scrub $NFIT_TEST_BUS0 && $NDCTL wait-scrub $NFIT_TEST_BUS0
+	unset_raw
+	$NDCTL clear-errors $dev
+	set_raw
+	# still trimmed, not turned into an error or a normal mapping
+	[ "$(map_entry 0)" = "0x80000000" ] || err "$LINENO"
+	unset_raw
+	dd if=/dev/$blockdev of=/dev/null iflag=direct bs=$sector_size count=1
+	reset && create
+}
+
 do_tests()
 {
 	test_normal
@@ -154,6 +193,7 @@ do_tests()
 	test_bad_info2
 	test_bad_info
 	test_bitmap
+	test_clear_trimmed
 }
 
 # setup (reset nfit_test dimms, create the BTT namespace)
@@ -0,0 +1,52 @@
+#!/bin/bash -x
+# SPDX-License-Identifier: GPL-2.0
+
+rc=77
+
+. $(dirname $0)/common
+
+check_prereq "jq"
+check_prereq "cmp"
+
+set -e
+trap 'err $LINENO' ERR
+
+# setup (reset nfit_test dimms)
+modprobe nfit_test
+$NDCTL disable-region -b $NFIT_TEST_BUS0 all
+$NDCTL zero-labels -b $NFIT_TEST_BUS0 all
+$NDCTL enable-region -b $NFIT_TEST_BUS0 all
+
+rc=1
+STAGING=$(mktemp)
+PATTERN=$(mktemp)
+LEN=$((8 << 20))
+
+json=$($NDCTL create-namespace -b $NFIT_TEST_BUS0 -t pmem -m sector -l 4K -s 64M)
+dev=$(echo "$json" | jq -r ".dev")
+blockdev=$(echo "$json" | jq -r ".blockdev")
+dd if=/dev/urandom of=$PATTERN bs=1M count=8
+dd if=$PATTERN of=/dev/$blockdev bs=1M oflag=direct conv=fsync
+
+# a device memmap leaves less than the sector namespace held, the
+# conversion stops at the reconfig step with everything staged
+if $NDCTL convert-namespace $dev -S $STAGING -f --map=dev; then
+	echo "convert with --map=dev was expected to run short"
+	false
+fi
+
+# as if interrupted while reconfiguring: the namespace is gone
+$NDCTL destroy-namespace -f $dev
+[ "$($NDCTL list -b $NFIT_TEST_BUS0 -Ni -n $dev | jq -r '.[0].size')" = "0" ]
+
+$NDCTL convert-namespace $dev -S $STAGING -f --map=mem
+
+json=$($NDCTL list -b $NFIT_TEST_BUS0 -n $dev)
+[ "$(echo "$json" | jq -r '.[0].mode')" = "fsdax" ]
+blockdev=$(echo "$json" | jq -r '.[0].blockdev')
+cmp -n $LEN $PATTERN /dev/$blockdev
+
+rm -f $STAGING $PATTERN
+_cleanup
+
+exit 0
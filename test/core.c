@@ -4,8 +4,10 @@
 #include <sys/utsname.h>
 #include <libkmod.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <time.h>
 #include <test.h>
 
 #include <util/log.h>
@@ -15,13 +17,43 @@
 #include <ccan/array_size/array_size.h>
 
 #define KVER_STRLEN 20
+#define TEST_MAX_STEPS 32
+#define TEST_STEP_STRLEN 32
+
+/*
+ * Steps that took less than this are never called a regression,
+ * however many times slower than the baseline, it is all noise.
+ */
+#define TEST_MIN_REGRESS_NS (10ULL * 1000 * 1000)
+
+struct test_step {
+	char name[TEST_STEP_STRLEN];
+	unsigned long long ns;
+};
 
 struct test_ctx {
 	unsigned int kver;
 	int attempt;
 	int skip;
+	const char *name;
+	const char *timing;
+	const char *baseline;
+	double slowdown;
+	unsigned long long start;
+	unsigned long long step_start;
+	struct test_step *step;
+	struct test_step steps[TEST_MAX_STEPS];
+	int nr_steps;
 };
 
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static unsigned int get_system_kver(void)
 {
 	const char *kver = getenv("KVER");
@@ -51,11 +83,153 @@ struct test_ctx *test_new(unsigned int kver)
 	else
 		test->kver = kver;
 
+	test->name = program_invocation_short_name;
+	test->timing = getenv("NDCTL_TEST_TIMING");
+	test->baseline = getenv("NDCTL_TEST_BASELINE");
+	test->slowdown = 3.0;
+	if (getenv("NDCTL_TEST_SLOWDOWN"))
+		test->slowdown = strtod(getenv("NDCTL_TEST_SLOWDOWN"), NULL);
+	test->start = now_ns();
+
 	return test;
 }
 
+void test_set_timing(struct test_ctx *test, const char *name,
+		const char *timing, const char *baseline)
+{
+	if (name)
+		test->name = name;
+	if (timing)
+		test->timing = timing;
+	if (baseline)
+		test->baseline = baseline;
+}
+
+static struct test_step *test_find_step(struct test_ctx *test,
+		const char *name)
+{
+	int i;
+
+	for (i = 0; i < test->nr_steps; i++)
+		if (strcmp(test->steps[i].name, name) == 0)
+			return &test->steps[i];
+	return NULL;
+}
+
+/*
+ * Steps are timed back to back, beginning one ends the one before.
+ * A step run more than once, per region say, accumulates.
+ */
+void test_step_begin(struct test_ctx *test, const char *name)
+{
+	struct test_step *step;
+
+	test_step_end(test);
+	step = test_find_step(test, name);
+	if (!step) {
+		if (test->nr_steps >= TEST_MAX_STEPS)
+			return;
+		step = &test->steps[test->nr_steps++];
+		snprintf(step->name, sizeof(step->name), "%s", name);
+	}
+	test->step = step;
+	test->step_start = now_ns();
+}
+
+void test_step_end(struct test_ctx *test)
+{
+	if (!test->step)
+		return;
+	test->step->ns += now_ns() - test->step_start;
+	test->step = NULL;
+}
+
+static void test_write_step(FILE *f, struct test_ctx *test, const char *step,
+		unsigned long long ns)
+{
+	fprintf(f, "{\"test\":\"%s\",\"step\":\"%s\",\"ns\":%llu}\n",
+			test->name, step, ns);
+}
+
+/* one line per step, appended so every test in a run shares a file */
+static void test_write_timing(struct test_ctx *test, unsigned long long total)
+{
+	FILE *f = fopen(test->timing, "a");
+	int i;
+
+	if (!f) {
+		fprintf(stderr, "%s: %s: %s\n", test->name, test->timing,
+				strerror(errno));
+		return;
+	}
+	test_write_step(f, test, "total", total);
+	for (i = 0; i < test->nr_steps; i++)
+		test_write_step(f, test, test->steps[i].name,
+				test->steps[i].ns);
+	fclose(f);
+}
+
+static int test_check_step(struct test_ctx *test, const char *name,
+		unsigned long long ns, unsigned long long base)
+{
+	if (ns < TEST_MIN_REGRESS_NS || ns <= base * test->slowdown)
+		return 0;
+	fprintf(stderr, "%s: %s regressed: %llu us, baseline %llu us (%.1fx)\n",
+			test->name, name, ns / 1000, base / 1000,
+			base ? (double) ns / base : 0.0);
+	return 1;
+}
+
+/*
+ * Compare against a results file from an earlier run, any step more
+ * than @slowdown times slower fails the test. Steps the baseline never
+ * saw, and tests missing from it, pass.
+ */
+static int test_check_baseline(struct test_ctx *test, unsigned long long total)
+{
+	char name[64], step[TEST_STEP_STRLEN], line[256];
+	struct test_step *s;
+	unsigned long long ns;
+	int regressed = 0;
+	FILE *f;
+
+	f = fopen(test->baseline, "r");
+	if (!f) {
+		fprintf(stderr, "%s: %s: %s\n", test->name, test->baseline,
+				strerror(errno));
+		return 0;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "{\"test\":\"%63[^\"]\",\"step\":\"%31[^\"]\",\"ns\":%llu}",
+					name, step, &ns) != 3)
+			continue;
+		if (strcmp(name, test->name) != 0)
+			continue;
+		if (strcmp(step, "total") == 0) {
+			regressed |= test_check_step(test, step, total, ns);
+			continue;
+		}
+		s = test_find_step(test, step);
+		if (s)
+			regressed |= test_check_step(test, step, s->ns, ns);
+	}
+	fclose(f);
+	return regressed;
+}
+
 int test_result(struct test_ctx *test, int rc)
 {
+	unsigned long long total = now_ns() - test->start;
+
+	test_step_end(test);
+	if (test->timing)
+		test_write_timing(test, total);
+	/* only a clean pass is worth timing, a skip did none of the work */
+	if (!rc && test->baseline
+			&& test_get_skipped(test) < test_get_attempted(test)
+			&& test_check_baseline(test, total))
+		rc = EXIT_FAILURE;
+
 	if (test_get_skipped(test))
 		fprintf(stderr, "attempted: %d skipped: %d\n",
 				test_get_attempted(test),
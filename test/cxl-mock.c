@@ -0,0 +1,311 @@
+// SPDX-License-Identifier: LGPL-2.1
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+
+#include <ccan/short_types/short_types.h>
+#include <ccan/array_size/array_size.h>
+#include <cxl/libcxl.h>
+#include <cxl/cxl_mem.h>
+#include "cxl-mock.h"
+
+struct cxl_mock_response {
+	u16 opcode;
+	u32 retval;
+	void *out;
+	size_t size;
+};
+
+struct cxl_mock {
+	char root[PATH_MAX];
+	int nr_memdevs;
+	int payload_max;
+	unsigned long latency_ns;
+	pthread_mutex_t lock;
+	struct cxl_mock_response *responses;
+	int nr_responses;
+	unsigned long long nr_commands;
+};
+
+/* what the kernel reports for each command, and the opcode behind it */
+static const struct {
+	struct cxl_command_info info;
+	u16 opcode;
+} mock_commands[] = {
+	{ { CXL_MEM_COMMAND_ID_IDENTIFY, 0, 0, 0x43 }, 0x4000 },
+	{ { CXL_MEM_COMMAND_ID_RAW, 0, -1, -1 }, 0 },
+	{ { CXL_MEM_COMMAND_ID_GET_SUPPORTED_LOGS, 0, 0, -1 }, 0x0400 },
+	{ { CXL_MEM_COMMAND_ID_GET_FW_INFO, 0, 0, 0x50 }, 0x0200 },
+	{ { CXL_MEM_COMMAND_ID_GET_PARTITION_INFO, 0, 0, 0x20 }, 0x4100 },
+	{ { CXL_MEM_COMMAND_ID_GET_LSA, 0, 0x8, -1 }, 0x4102 },
+	{ { CXL_MEM_COMMAND_ID_GET_HEALTH_INFO, 0, 0, 0x12 }, 0x4200 },
+	{ { CXL_MEM_COMMAND_ID_GET_LOG, 0, 0x18, -1 }, 0x0401 },
+	{ { CXL_MEM_COMMAND_ID_SET_LSA, 0, -1, 0 }, 0x4103 },
+};
+
+static int mock_write_attr(const char *dir, const char *attr,
+		const char *val)
+{
+	char path[PATH_MAX];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, attr);
+	f = fopen(path, "w");
+	if (!f)
+		return -errno;
+	fprintf(f, "%s\n", val);
+	fclose(f);
+	return 0;
+}
+
+static const char * const mock_attrs[] = {
+	"payload_max", "label_storage_size", "firmware_version", "serial",
+	"pmem/size", "ram/size",
+};
+
+static int mock_add_memdev(struct cxl_mock *mock, int id)
+{
+	const char *vals[ARRAY_SIZE(mock_attrs)];
+	char dir[PATH_MAX], sub[PATH_MAX], payload[16], serial[32];
+	unsigned int i;
+	int rc;
+
+	snprintf(dir, sizeof(dir), "%s/mem%d", mock->root, id);
+	if (mkdir(dir, 0755) < 0)
+		return -errno;
+	snprintf(sub, sizeof(sub), "%s/pmem", dir);
+	if (mkdir(sub, 0755) < 0)
+		return -errno;
+	snprintf(sub, sizeof(sub), "%s/ram", dir);
+	if (mkdir(sub, 0755) < 0)
+		return -errno;
+
+	snprintf(payload, sizeof(payload), "%d", mock->payload_max);
+	snprintf(serial, sizeof(serial), "%#x", 0xc0de0000 + id);
+	vals[0] = payload;
+	vals[1] = "1048576";
+	vals[2] = "MOCK FW 1.0";
+	vals[3] = serial;
+	vals[4] = "0";
+	vals[5] = "0x10000000";
+	for (i = 0; i < ARRAY_SIZE(mock_attrs); i++) {
+		rc = mock_write_attr(dir, mock_attrs[i], vals[i]);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+static void mock_remove_tree(struct cxl_mock *mock)
+{
+	char path[PATH_MAX];
+	unsigned int i;
+	int id;
+
+	for (id = 0; id < mock->nr_memdevs; id++) {
+		for (i = 0; i < ARRAY_SIZE(mock_attrs); i++) {
+			snprintf(path, sizeof(path), "%s/mem%d/%s", mock->root,
+					id, mock_attrs[i]);
+			unlink(path);
+		}
+		snprintf(path, sizeof(path), "%s/mem%d/pmem", mock->root, id);
+		rmdir(path);
+		snprintf(path, sizeof(path), "%s/mem%d/ram", mock->root, id);
+		rmdir(path);
+		snprintf(path, sizeof(path), "%s/mem%d", mock->root, id);
+		rmdir(path);
+	}
+	rmdir(mock->root);
+}
+
+struct cxl_mock *cxl_mock_new(int nr_memdevs, int payload_max)
+{
+	struct cxl_mock *mock;
+	const char *tmpdir = getenv("TMPDIR");
+	int id;
+
+	mock = calloc(1, sizeof(*mock));
+	if (!mock)
+		return NULL;
+	mock->payload_max = payload_max;
+	pthread_mutex_init(&mock->lock, NULL);
+
+	snprintf(mock->root, sizeof(mock->root), "%s/cxl-mock.XXXXXX",
+			tmpdir ? tmpdir : "/tmp");
+	if (!mkdtemp(mock->root)) {
+		free(mock);
+		return NULL;
+	}
+	for (id = 0; id < nr_memdevs; id++) {
+		mock->nr_memdevs = id + 1;
+		if (mock_add_memdev(mock, id) < 0) {
+			cxl_mock_free(mock);
+			return NULL;
+		}
+	}
+	return mock;
+}
+
+void cxl_mock_free(struct cxl_mock *mock)
+{
+	int i;
+
+	if (!mock)
+		return;
+	mock_remove_tree(mock);
+	for (i = 0; i < mock->nr_responses; i++)
+		free(mock->responses[i].out);
+	free(mock->responses);
+	pthread_mutex_destroy(&mock->lock);
+	free(mock);
+}
+
+void cxl_mock_set_latency(struct cxl_mock *mock, unsigned long latency_ns)
+{
+	mock->latency_ns = latency_ns;
+}
+
+/*
+ * Answer @opcode with @retval and a copy of @out. Opcodes without a
+ * response complete successfully with an empty output payload.
+ */
+int cxl_mock_set_response(struct cxl_mock *mock, unsigned short opcode,
+		unsigned int retval, const void *out, size_t size)
+{
+	struct cxl_mock_response *r = NULL;
+	void *buf = NULL;
+	int i;
+
+	if (size) {
+		buf = malloc(size);
+		if (!buf)
+			return -ENOMEM;
+		memcpy(buf, out, size);
+	}
+
+	pthread_mutex_lock(&mock->lock);
+	for (i = 0; i < mock->nr_responses; i++)
+		if (mock->responses[i].opcode == opcode)
+			r = &mock->responses[i];
+	if (!r) {
+		r = realloc(mock->responses,
+				(mock->nr_responses + 1) * sizeof(*r));
+		if (!r) {
+			pthread_mutex_unlock(&mock->lock);
+			free(buf);
+			return -ENOMEM;
+		}
+		mock->responses = r;
+		r = &mock->responses[mock->nr_responses++];
+		r->out = NULL;
+	}
+	free(r->out);
+	r->opcode = opcode;
+	r->retval = retval;
+	r->out = buf;
+	r->size = size;
+	pthread_mutex_unlock(&mock->lock);
+	return 0;
+}
+
+unsigned long long cxl_mock_get_nr_commands(struct cxl_mock *mock)
+{
+	unsigned long long n;
+
+	pthread_mutex_lock(&mock->lock);
+	n = mock->nr_commands;
+	pthread_mutex_unlock(&mock->lock);
+	return n;
+}
+
+static void mock_delay(unsigned long ns)
+{
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000UL,
+		.tv_nsec = ns % 1000000000UL,
+	};
+
+	if (ns)
+		while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+			;
+}
+
+static int mock_query(struct cxl_mem_query_commands *query)
+{
+	u32 i, n = ARRAY_SIZE(mock_commands);
+
+	for (i = 0; i < query->n_commands && i < n; i++)
+		query->commands[i] = mock_commands[i].info;
+	query->n_commands = n;
+	return 0;
+}
+
+static int mock_send(struct cxl_mock *mock, struct cxl_send_command *send)
+{
+	struct cxl_mock_response *r = NULL;
+	unsigned int i;
+	int opcode = -1;
+	size_t len = 0;
+
+	for (i = 0; i < ARRAY_SIZE(mock_commands); i++)
+		if (mock_commands[i].info.id == send->id)
+			opcode = mock_commands[i].opcode;
+	if (opcode < 0)
+		return -ENOTTY;
+	if (send->id == CXL_MEM_COMMAND_ID_RAW)
+		opcode = send->raw.opcode;
+	if (send->in.size > mock->payload_max
+			|| send->out.size > mock->payload_max)
+		return -EINVAL;
+
+	mock_delay(mock->latency_ns);
+
+	pthread_mutex_lock(&mock->lock);
+	mock->nr_commands++;
+	for (i = 0; i < (unsigned int) mock->nr_responses; i++)
+		if (mock->responses[i].opcode == opcode)
+			r = &mock->responses[i];
+	send->retval = r ? r->retval : 0;
+	if (r && r->out) {
+		len = r->size < (size_t) send->out.size ? r->size
+			: (size_t) send->out.size;
+		memcpy((void *) (unsigned long) send->out.payload, r->out, len);
+	}
+	pthread_mutex_unlock(&mock->lock);
+	send->out.size = len;
+	return 0;
+}
+
+static int mock_transport(struct cxl_memdev *memdev, unsigned long request,
+		void *arg, void *data)
+{
+	struct cxl_mock *mock = data;
+
+	if (cxl_memdev_get_id(memdev) >= mock->nr_memdevs)
+		return -ENODEV;
+	switch (request) {
+	case CXL_MEM_QUERY_COMMANDS:
+		return mock_query(arg);
+	case CXL_MEM_SEND_COMMAND:
+		return mock_send(mock, arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+int cxl_mock_attach(struct cxl_mock *mock, struct cxl_ctx *ctx)
+{
+	int rc = cxl_set_sysfs_root(ctx, mock->root);
+
+	if (rc)
+		return rc;
+	cxl_set_transport(ctx, mock_transport, mock);
+	return 0;
+}
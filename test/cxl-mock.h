@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+#ifndef __CXL_MOCK_H__
+#define __CXL_MOCK_H__
+#include <stddef.h>
+
+/*
+ * In-process stand-in for cxl_mem devices: a throwaway sysfs tree for
+ * enumeration plus a libcxl transport that answers mailbox commands
+ * from canned per-opcode responses after a configurable delay.
+ */
+struct cxl_ctx;
+struct cxl_mock;
+
+struct cxl_mock *cxl_mock_new(int nr_memdevs, int payload_max);
+void cxl_mock_free(struct cxl_mock *mock);
+int cxl_mock_attach(struct cxl_mock *mock, struct cxl_ctx *ctx);
+void cxl_mock_set_latency(struct cxl_mock *mock, unsigned long latency_ns);
+int cxl_mock_set_response(struct cxl_mock *mock, unsigned short opcode,
+		unsigned int retval, const void *out, size_t size);
+unsigned long long cxl_mock_get_nr_commands(struct cxl_mock *mock);
+#endif /* __CXL_MOCK_H__ */
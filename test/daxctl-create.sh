@@ -399,6 +399,118 @@ daxctl_test7()
 	test_pass
 }
 
+# Test 8: save and apply a configuration
+# Saves a multi-range device, destroys it, and checks that apply-config
+# brings it back with the same ranges and mode.
+daxctl_test8()
+{
+	local daxdev_1
+
+	size=$((available / 4))
+	daxdev_1=$("$DAXCTL" create-device -r 0 -s $size | jq -er '.[].chardev')
+	"$DAXCTL" save-config -r 0 -o config.json "$daxdev_1"
+	test "$(jq -er '.devices | length' config.json)" -eq 1
+	test "$(jq -er 'has("demotion")' config.json)" == "false"
+	mappings=$("$DAXCTL" list -M -d "$daxdev_1" | jq -c '.[].mappings')
+
+	"$DAXCTL" disable-device "$daxdev_1" && "$DAXCTL" destroy-device "$daxdev_1"
+
+	daxdev_1=$("$DAXCTL" apply-config config.json | jq -er '.[].chardev')
+	test "$(daxctl_get_mode "$daxdev_1")" == "devdax"
+	test "$("$DAXCTL" list -M -d "$daxdev_1" | jq -c '.[].mappings')" == "$mappings"
+
+	# a second run finds everything in place
+	"$DAXCTL" apply-config config.json
+	test "$(daxctl_get_nr_mappings "$daxdev_1")" -eq 1
+
+	"$DAXCTL" disable-device "$daxdev_1" && "$DAXCTL" destroy-device "$daxdev_1"
+	rm -f config.json
+
+	clear_dev
+	test_pass
+}
+
+# Test 9: planned placement
+# Creates two devices with --plan and checks that both got a single range
+# and an alignment of at least 2M.
+daxctl_test9()
+{
+	local daxdevs
+	local dev
+
+	size=$((available / 4 / 2097152 * 2097152))
+	daxdevs=$("$DAXCTL" create-device -r 0 --plan -s "$size,$size" | jq -er '.[].chardev')
+	test "$(echo "$daxdevs" | wc -w)" -eq 2
+
+	for dev in $daxdevs; do
+		test "$(daxctl_get_nr_mappings "$dev")" -eq 1
+		test "$("$DAXCTL" list -d "$dev" | jq -er '.[].align')" -ge 2097152
+		"$DAXCTL" disable-device "$dev" && "$DAXCTL" destroy-device "$dev"
+	done
+
+	clear_dev
+	test_pass
+}
+
+daxctl_test10()
+{
+	local daxdev
+	local json
+
+	daxdev=$("$DAXCTL" create-device -r 0 -s 2G | jq -er '.[].chardev')
+	test -n "$daxdev"
+
+	json=$("$DAXCTL" zero-device "$daxdev" -j 2)
+	test "$(echo "$json" | jq -er '.[].chardev')" == "$daxdev"
+	test "$(echo "$json" | jq -er '.[].threads')" -eq 2
+	test "$(echo "$json" | jq -er '.[].bandwidth_mbps')" -gt 0
+
+	"$DAXCTL" disable-device "$daxdev" && "$DAXCTL" destroy-device "$daxdev"
+	clear_dev
+	test_pass
+}
+
+daxctl_test11()
+{
+	local daxdev
+	local json
+	local node
+
+	daxdev=$("$DAXCTL" create-device -r 0 -s 2G | jq -er '.[].chardev')
+	test -n "$daxdev"
+
+	node=$(cut -d, -f1 /sys/devices/system/node/has_cpu | cut -d- -f1)
+	json=$("$DAXCTL" bench "$daxdev" -s 64M -n "$node" -j 2 -t seq_read,seq_write_nt,latency)
+	test "$(echo "$json" | jq -er '.[].results | length')" -eq 1
+	test "$(echo "$json" | jq -er '.[].results[0].threads')" -eq 2
+	test "$(echo "$json" | jq -er '.[].results[0].seq_read_mbps')" -gt 0
+	test "$(echo "$json" | jq -er '.[].results[0].load_latency_ns')" -gt 0
+	test "$(echo "$json" | jq -r '.[].results[0].rand_read_mbps')" == "null"
+
+	"$DAXCTL" disable-device "$daxdev" && "$DAXCTL" destroy-device "$daxdev"
+	clear_dev
+	test_pass
+}
+
+# Test 12: batch creation
+# Creates four devices with one --count run, sharing the available space.
+daxctl_test12()
+{
+	local daxdevs
+	local dev
+
+	daxdevs=$("$DAXCTL" create-device -r 0 --count 4 | jq -er '.[].chardev')
+	test "$(echo "$daxdevs" | wc -w)" -eq 4
+
+	for dev in $daxdevs; do
+		test "$("$DAXCTL" list -d "$dev" | jq -er '.[].size')" -ge $((available / 4 - 2097152))
+		"$DAXCTL" disable-device "$dev" && "$DAXCTL" destroy-device "$dev"
+	done
+
+	clear_dev
+	test_pass
+}
+
 find_testdev
 rc=1
 setup_dev
@@ -410,5 +522,10 @@ daxctl_test4
 daxctl_test5
 daxctl_test6
 daxctl_test7
+daxctl_test8
+daxctl_test9
+daxctl_test10
+daxctl_test11
+daxctl_test12
 reset_dev
 exit 0
@@ -98,6 +98,10 @@ daxctl_test()
 	[[ $(daxctl_get_mode "$daxdev") == "system-ram" ]]
 	"$DAXCTL" online-memory "$daxdev"
 	"$DAXCTL" offline-memory "$daxdev"
+	# same again with the blocks spread over a worker pool
+	DAXCTL_MEMORY_THREADS=4 "$DAXCTL" online-memory -j 2 --timing "$daxdev" | \
+		jq -e '.[0].timing.blocks > 0'
+	DAXCTL_MEMORY_THREADS=4 "$DAXCTL" offline-memory -j 2 "$daxdev"
 	"$DAXCTL" reconfigure-device -m devdax "$daxdev"
 	[[ $(daxctl_get_mode "$daxdev") == "devdax" ]]
 	"$DAXCTL" reconfigure-device -m system-ram "$daxdev"
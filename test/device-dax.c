@@ -174,6 +174,7 @@ static int __test_device_dax(unsigned long align, int loglevel,
 	struct ndctl_dax *dax;
 	struct ndctl_pfn *pfn;
 	struct daxctl_dev *dev;
+	struct daxctl_map *map;
 	int fd, rc, *p, salt;
 	struct ndctl_namespace *ndns;
 	struct daxctl_region *dax_region;
@@ -275,6 +276,29 @@ static int __test_device_dax(unsigned long align, int loglevel,
 	close(fd);
 	munmap(buf, VERIFY_SIZE(align));
 
+	/* the library helper must land on the same fault boundary */
+	rc = daxctl_dev_mmap(dev, 0, VERIFY_SIZE(align),
+			DAXCTL_MAP_READONLY | DAXCTL_MAP_PREFAULT, &map);
+	if (rc) {
+		fprintf(stderr, "%s: daxctl_dev_mmap failed: %s\n", path,
+				strerror(-rc));
+		goto out;
+	}
+	buf = daxctl_map_get_addr(map);
+	if ((daxctl_dev_get_align(dev)
+				&& daxctl_map_get_fault_size(map) != align)
+			|| !IS_ALIGNED((unsigned long) buf,
+				daxctl_map_get_fault_size(map))) {
+		fprintf(stderr, "%s: mapped at %p, fault size %#lx, expected %#lx\n",
+				path, buf, daxctl_map_get_fault_size(map),
+				align);
+		rc = -ENXIO;
+	} else
+		rc = verify_data(dev, buf, align, salt, test);
+	daxctl_map_unmap(map);
+	if (rc)
+		goto out;
+
 	/*
 	 * Prior to 4.8-final these tests cause crashes, or are
 	 * otherwise not supported.
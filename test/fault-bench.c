@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <util/size.h>
+
+#ifndef MAP_SYNC
+#define MAP_SYNC 0x80000
+#endif
+#ifndef MAP_SHARED_VALIDATE
+#define MAP_SHARED_VALIDATE 0x03
+#endif
+
+/*
+ * First-touch fault cost of a dax mapping, file or device. A first
+ * pass touches every 4K page and counts the faults it takes,
+ * which gives the size each fault actually installed: a mapping that
+ * silently drops from PMD or PUD to PTE faults shows up here. A second
+ * pass over a fresh mapping then times one touch per installed fault
+ * and reports the distribution. The result is one JSON object on
+ * stdout, for fault-bench.sh to collect.
+ */
+#define MAX_SAMPLES (1UL << 20)
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* fsdax faults that allocate blocks count as major */
+static long nr_faults_taken(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_minflt + ru.ru_majflt;
+}
+
+static int ull_cmp(const void *a, const void *b)
+{
+	const unsigned long long *x = a, *y = b;
+
+	if (*x != *y)
+		return *x < *y ? -1 : 1;
+	return 0;
+}
+
+static char *map(int fd, size_t len, size_t align, int flags, bool ro)
+{
+	char *hint, *addr;
+	size_t head;
+
+	/* place the mapping on @align, or PMD and PUD faults are off */
+	hint = mmap(NULL, len + align, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (hint == MAP_FAILED)
+		return NULL;
+	addr = (char *) ALIGN((unsigned long) hint, align);
+	head = addr - hint;
+	if (head)
+		munmap(hint, head);
+	if (align - head)
+		munmap(addr + len, align - head);
+
+	addr = mmap(addr, len, ro ? PROT_READ : PROT_READ | PROT_WRITE,
+			flags | MAP_FIXED, fd, 0);
+	return addr == MAP_FAILED ? NULL : addr;
+}
+
+static void touch(char *p, bool ro)
+{
+	if (ro)
+		(void) *(volatile char *) p;
+	else
+		*(volatile char *) p = 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-a align] [-l length] [-r] [-s] [-t tag] <file>\n"
+			"  -a  mapping alignment, default 1G\n"
+			"  -l  bytes to map, default the file size, at most 4G\n"
+			"  -r  read faults instead of write faults\n"
+			"  -s  map with MAP_SYNC\n"
+			"  -t  label echoed in the output\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long len = 0, align = SZ_1G, fault_size, *ns, start, total;
+	const char *path, *tag = "";
+	int c, fd, flags = MAP_SHARED;
+	unsigned long i, nr_faults, nr;
+	bool ro = false, sync = false;
+	struct stat st;
+	long faults;
+	char *addr;
+
+	while ((c = getopt(argc, argv, "a:l:rst:")) != -1) {
+		switch (c) {
+		case 'a':
+			align = parse_size64(optarg);
+			break;
+		case 'l':
+			len = parse_size64(optarg);
+			break;
+		case 'r':
+			ro = true;
+			break;
+		case 's':
+			sync = true;
+			break;
+		case 't':
+			tag = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind + 1 != argc || align == ULLONG_MAX || len == ULLONG_MAX
+			|| !is_power_of_2(align))
+		usage(argv[0]);
+	path = argv[optind];
+
+	fd = open(path, ro ? O_RDONLY : O_RDWR);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if (!len) {
+		/* a char device reports no size, stay within the smallest */
+		len = S_ISREG(st.st_mode) ? (unsigned long long) st.st_size
+			: 4ULL * SZ_1G;
+		if (len > 4ULL * SZ_1G)
+			len = 4ULL * SZ_1G;
+	}
+	len = len / align * align;
+	if (!len) {
+		fprintf(stderr, "%s: smaller than one %#llx page\n", path,
+				align);
+		return 77;
+	}
+	if (sync)
+		flags = MAP_SHARED_VALIDATE | MAP_SYNC;
+
+	/* pass 1: how big is a fault */
+	addr = map(fd, len, align, flags, ro);
+	if (!addr) {
+		fprintf(stderr, "%s: mmap%s: %s\n", path,
+				sync ? " (MAP_SYNC)" : "", strerror(errno));
+		return errno == EOPNOTSUPP || errno == EINVAL ? 77
+			: EXIT_FAILURE;
+	}
+	faults = nr_faults_taken();
+	start = now_ns();
+	for (i = 0; i < len; i += SZ_4K)
+		touch(addr + i, ro);
+	total = now_ns() - start;
+	faults = nr_faults_taken() - faults;
+	munmap(addr, len);
+	if (faults <= 0)
+		faults = 1;
+	fault_size = len / faults;
+
+	/* pass 2: one timed touch per fault, on a fresh mapping */
+	nr_faults = len / fault_size;
+	nr = nr_faults < MAX_SAMPLES ? nr_faults : MAX_SAMPLES;
+	ns = calloc(nr, sizeof(*ns));
+	addr = map(fd, len, align, flags, ro);
+	if (!ns || !addr) {
+		fprintf(stderr, "%s: second pass setup failed\n", path);
+		return EXIT_FAILURE;
+	}
+	for (i = 0; i < nr; i++) {
+		char *p = addr + (nr_faults / nr) * i * fault_size;
+
+		start = now_ns();
+		touch(p, ro);
+		ns[i] = now_ns() - start;
+	}
+	munmap(addr, len);
+	close(fd);
+	qsort(ns, nr, sizeof(*ns), ull_cmp);
+
+	printf("{\"tag\":\"%s\",\"path\":\"%s\",\"align\":%llu,\"length\":%llu,"
+			"\"fault\":\"%s\",\"map_sync\":%s,\"faults\":%ld,"
+			"\"fault_size\":%llu,\"faults_per_sec\":%llu,"
+			"\"fault_ns\":{\"min\":%llu,\"p50\":%llu,\"p90\":%llu,"
+			"\"p99\":%llu,\"max\":%llu}}\n",
+			tag, path, align, len, ro ? "read" : "write",
+			sync ? "true" : "false", faults, fault_size,
+			faults * 1000000000ULL / (total ? total : 1),
+			ns[0], ns[nr / 2], ns[nr * 9 / 10], ns[nr * 99 / 100],
+			ns[nr - 1]);
+	free(ns);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+
+. $(dirname $0)/common
+
+MNT=test_fault_bench_mnt
+FILE=image
+BENCH=./fault-bench
+ALIGNS="4096 2097152 1073741824"
+results=()
+rc=77
+
+cleanup() {
+	echo "test-fault-bench: failed at line $1"
+	mountpoint -q $MNT && umount $MNT
+	rmdir $MNT
+	exit $rc
+}
+
+# $1: tag, the rest goes to fault-bench, a mapping it can not make is skipped
+bench()
+{
+	local tag="$1"
+	local out
+
+	shift
+	if out=$($BENCH -t "$tag" "$@"); then
+		echo "$out"
+		results+=("$out")
+	elif [ $? -ne 77 ]; then
+		return 1
+	fi
+}
+
+# every combination of read / write and MAP_SYNC / plain faults
+bench_all()
+{
+	local sync
+	local fault
+
+	for sync in "" "-s"; do
+		for fault in "" "-r"; do
+			bench "$@" $sync $fault
+		done
+	done
+}
+
+run_devdax()
+{
+	local align
+	local json
+	local chardev
+	local size
+
+	for align in $ALIGNS; do
+		# not every platform has the ranges for 1G
+		json=$($NDCTL create-namespace -m devdax -a $align -f -e $dev) || continue
+		chardev=$(jq -er '.daxregion.devices[0].chardev' <<< "$json")
+		bench_all "devdax-$align" -a $align /dev/$chardev
+
+		# device-dax never falls back to a smaller page
+		for size in $(printf '%s\n' "${results[@]}" | \
+				jq -r "select(.tag == \"devdax-$align\") | .fault_size"); do
+			[ "$size" -eq $align ]
+		done
+	done
+}
+
+run_fsdax()
+{
+	local align
+	local fs
+
+	for align in 4096 2097152; do
+		json=$($NDCTL create-namespace -m fsdax -M dev -a $align -f -e $dev)
+		eval $(json2var <<< "$json")
+
+		for fs in ext4 xfs; do
+			if [ $fs = ext4 ]; then
+				mkfs.ext4 -q -b 4096 /dev/$blockdev
+			else
+				mkfs.xfs -q -f -d su=2m,sw=1,agcount=2 -m reflink=0 /dev/$blockdev
+			fi
+			mount /dev/$blockdev $MNT -o dax
+			fallocate -l 1GiB $MNT/$FILE
+			# the filesystem decides the fault size, only reported
+			bench_all "fsdax-$fs-$align" -a 2M $MNT/$FILE
+			umount $MNT
+		done
+	done
+}
+
+check_prereq "jq"
+check_prereq "mkfs.ext4"
+check_prereq "mkfs.xfs"
+
+set -e
+mkdir -p $MNT
+trap 'err $LINENO cleanup' ERR
+
+dev=$(./dax-dev)
+json=$($NDCTL list -N -n $dev)
+eval $(json2var <<< "$json")
+orig_mode=$mode
+rc=1
+
+run_devdax
+run_fsdax
+
+$NDCTL create-namespace -m $orig_mode -f -e $dev
+rmdir $MNT
+
+# the whole run as one array, to file as a baseline or compare against one
+printf '%s\n' "${results[@]}" | jq -s . > fault-bench.json
+exit 0
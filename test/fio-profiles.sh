@@ -0,0 +1,138 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+
+# Run a fixed set of fio profiles against one namespace in devdax,
+# fsdax and sector mode, condense fio's JSON output, and compare it to
+# a stored baseline. Environment:
+#   FIO_BASELINE   baseline file, written when it does not exist yet
+#                  (default: fio-baseline.json)
+#   FIO_THRESHOLD  percent of bandwidth lost, or p99 latency gained,
+#                  that counts as a regression (default: 10)
+#   FIO_RUNTIME    seconds per profile (default: 5)
+#   FIO_MODES      subset of "devdax fsdax sector"
+
+. $(dirname $0)/common
+
+BASELINE=${FIO_BASELINE:-fio-baseline.json}
+THRESHOLD=${FIO_THRESHOLD:-10}
+RUNTIME=${FIO_RUNTIME:-5}
+MODES=${FIO_MODES:-"devdax fsdax sector"}
+RESULTS=fio-results.json
+
+# name rw bs iodepth numjobs, iodepth only applies to libaio
+PROFILES="
+seqread-2m-qd1-j1	read		2m	1	1
+seqwrite-2m-qd1-j1	write		2m	1	1
+seqread-64k-qd16-j4	read		64k	16	4
+randread-4k-qd1-j1	randread	4k	1	1
+randread-4k-qd16-j4	randread	4k	16	4
+randwrite-4k-qd1-j1	randwrite	4k	1	1
+randwrite-4k-qd16-j4	randwrite	4k	16	4
+"
+
+rc=77
+
+set -e
+
+check_min_kver "4.11" || do_skip "kernel may lack device-dax fixes"
+
+trap 'err $LINENO' ERR
+
+check_prereq "fio"
+check_prereq "jq"
+
+# $1: mode, $2: target, $3: engine
+run_profiles()
+{
+	local mode="$1" target="$2" engine="$3"
+	local name rw bs qd jobs
+
+	while read -r name rw bs qd jobs; do
+		[ -n "$name" ] || continue
+		[ "$engine" = "libaio" ] || qd=1
+
+		cat > fio.job <<- EOF
+			[global]
+			ioengine=${engine}
+			direct=$([ "$engine" = "libaio" ] && echo 1 || echo 0)
+			filename=${target}
+			time_based=1
+			runtime=${RUNTIME}
+			group_reporting=1
+
+			[${mode}-${name}]
+			rw=${rw}
+			bs=${bs}
+			iodepth=${qd}
+			numjobs=${jobs}
+		EOF
+
+		# one condensed record per profile
+		fio --output-format=json fio.job | jq -c \
+			--arg mode "$mode" --arg profile "$name" '
+			.jobs[0] as $j
+			| (if ($j.read.io_bytes > 0) then $j.read else $j.write end) as $d
+			| { key: ($mode + "-" + $profile),
+			    value: { bw_kib: $d.bw, iops: ($d.iops | floor),
+				     p99_ns: ($d.clat_ns.percentile["99.000000"] // 0) } }' \
+			>> "$RESULTS.tmp"
+	done <<< "$PROFILES"
+}
+
+dev=$(./dax-dev)
+json=$($NDCTL list -N -n $dev)
+eval $(json2var <<< "$json")
+orig_mode=$mode
+rm -f "$RESULTS.tmp"
+rc=1
+
+for m in $MODES; do
+	case $m in
+	devdax)
+		if ! fio --enghelp | grep -q "dev-dax"; then
+			echo "fio lacks dev-dax engine, skipping devdax"
+			continue
+		fi
+		json=$($NDCTL create-namespace -m devdax -a 2m -f -e $dev)
+		chardev=$(jq -r ".daxregion.devices[0].chardev" <<< "$json")
+		run_profiles devdax /dev/$chardev dev-dax
+		;;
+	fsdax|sector)
+		json=$($NDCTL create-namespace -m $m -f -e $dev)
+		eval $(json2var <<< "$json")
+		run_profiles $m /dev/$blockdev libaio
+		;;
+	*)
+		echo "unknown mode: $m"
+		exit 1
+		;;
+	esac
+done
+
+$NDCTL create-namespace -m $orig_mode -f -e $dev
+jq -s 'from_entries' "$RESULTS.tmp" > "$RESULTS"
+rm -f "$RESULTS.tmp" fio.job
+
+if [ ! -f "$BASELINE" ]; then
+	cp "$RESULTS" "$BASELINE"
+	echo "recorded baseline $BASELINE"
+	exit 0
+fi
+
+# profiles missing from either side are not compared
+regressions=$(jq -r --slurpfile base "$BASELINE" --argjson t "$THRESHOLD" '
+	to_entries[] | .key as $k | .value as $cur
+	| ($base[0][$k] // empty) as $old
+	| (if $old.bw_kib > 0 and $cur.bw_kib < $old.bw_kib * (100 - $t) / 100
+	   then "\($k): bandwidth \($old.bw_kib) -> \($cur.bw_kib) KiB/s" else empty end),
+	  (if $old.p99_ns > 0 and $cur.p99_ns > $old.p99_ns * (100 + $t) / 100
+	   then "\($k): p99 latency \($old.p99_ns) -> \($cur.p99_ns) ns" else empty end)
+	' "$RESULTS")
+
+if [ -n "$regressions" ]; then
+	echo "regressions beyond ${THRESHOLD}% against $BASELINE:"
+	echo "$regressions"
+	exit 1
+fi
+
+exit 0
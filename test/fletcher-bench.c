@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <util/fletcher.h>
+#include <ccan/array_size/array_size.h>
+
+/*
+ * Check every fletcher64 implementation the cpu supports against the
+ * generic loop, across lengths and alignments that exercise the vector
+ * tails, then report throughput at the sizes the label and info-block
+ * code checksums: namespace index blocks and 4K info blocks.
+ * BENCH_ITERATIONS overrides the default.
+ */
+#define BUF_SIZE (256 << 10)
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int verify(const struct fletcher64_impl *impl, unsigned char *buf)
+{
+	size_t len, off;
+	u64 want, got;
+	int le;
+
+	for (le = 0; le < 2; le++)
+		for (off = 0; off < 8; off += 4)
+			for (len = 0; len < 4096; len += 4) {
+				want = fletcher64_generic(buf + off, len, le);
+				got = impl->fn(buf + off, len, le);
+				if (want == got)
+					continue;
+				fprintf(stderr, "%s: len %zu off %zu le %d: %#llx != %#llx\n",
+						impl->name, len, off, le,
+						(unsigned long long) got,
+						(unsigned long long) want);
+				return -1;
+			}
+
+	/* all ones stresses the 32-bit wrap of the running sum */
+	memset(buf, 0xff, BUF_SIZE);
+	want = fletcher64_generic(buf, BUF_SIZE, 1);
+	got = impl->fn(buf, BUF_SIZE, 1);
+	if (want != got) {
+		fprintf(stderr, "%s: saturated buffer: %#llx != %#llx\n",
+				impl->name, (unsigned long long) got,
+				(unsigned long long) want);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static const size_t sizes[] = { 256, 4096, 65536, BUF_SIZE };
+	const struct fletcher64_impl *impl;
+	unsigned long iterations, n, i;
+	volatile u64 sink = 0;
+	unsigned char *buf;
+	const char *env;
+	unsigned int j, k;
+	u64 start, ns;
+	int rc = 0;
+
+	env = getenv("BENCH_ITERATIONS");
+	iterations = env ? strtoul(env, NULL, 0) : 100000;
+	if (!iterations)
+		return EXIT_FAILURE;
+
+	buf = malloc(BUF_SIZE + 8);
+	if (!buf)
+		return EXIT_FAILURE;
+	srand(0);
+	for (i = 0; i < BUF_SIZE + 8; i++)
+		buf[i] = rand();
+
+	for (j = 0; (impl = fletcher64_get_impl(j)); j++) {
+		if (!impl->supported()) {
+			printf("%-8s unsupported\n", impl->name);
+			continue;
+		}
+
+		for (k = 0; k < ARRAY_SIZE(sizes); k++) {
+			n = iterations * 256 / sizes[k];
+			if (!n)
+				n = 1;
+			start = now_ns();
+			for (i = 0; i < n; i++)
+				sink += impl->fn(buf, sizes[k], 1);
+			ns = now_ns() - start;
+			printf("%-8s %8zu bytes %10.2f GB/s\n", impl->name,
+					sizes[k], (double) n * sizes[k]
+					/ (ns ? ns : 1));
+		}
+
+		if (verify(impl, buf)) {
+			rc = -1;
+			break;
+		}
+		for (i = 0; i < BUF_SIZE + 8; i++)
+			buf[i] = rand();
+	}
+
+	free(buf);
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
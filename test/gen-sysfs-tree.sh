@@ -0,0 +1,153 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+
+# Build a synthetic sysfs tree for NDCTL_SYSFS_ROOT, DAXCTL_SYSFS_ROOT
+# and CXL_SYSFS_ROOT, holding only what "ndctl list", "daxctl list" and
+# "cxl list" read while enumerating. The tree can be made far larger
+# than nfit_test or cxl_test, to time enumeration as topology grows.
+#
+# usage: gen-sysfs-tree.sh <root> [buses [dimms [regions [namespaces
+#			    [memdevs [dax-regions [dax-devs]]]]]]]
+#
+# dimms and regions are per bus, namespaces per region, dax-devs per
+# dax region. The defaults make a single small bus of each kind. The
+# tree is only for listing, nothing behind it accepts writes.
+
+root=$1
+nr_bus=${2:-1}
+nr_dimm=${3:-4}
+nr_region=${4:-2}
+nr_ns=${5:-2}
+nr_memdev=${6:-4}
+nr_dax_region=${7:-1}
+nr_dax_dev=${8:-2}
+
+if [ -z "$root" ]; then
+	echo "usage: $0 <root> [buses dimms regions namespaces memdevs dax-regions dax-devs]" >&2
+	exit 1
+fi
+
+set -e
+
+# attr <dir> <name> <value>
+attr()
+{
+	printf '%s\n' "$3" > "$1/$2"
+}
+
+# link <target relative to root> <link relative to root>
+link()
+{
+	local slashes=${2//[^\/]/} up=.. i
+
+	for ((i = 1; i < ${#slashes}; i++)); do
+		up=$up/..
+	done
+	ln -s "$up/$1" "$root/$2"
+}
+
+rm -rf "$root"
+mkdir -p "$root"/{class/nd,dev/char,bus/nd/drivers,bus/dax/devices,bus/dax/drivers,bus/cxl/devices}
+mkdir -p "$root"/bus/nd/drivers/{nd_bus,nvdimm,nd_region,nd_pmem}
+mkdir -p "$root"/bus/dax/drivers/device_dax
+
+# ids are global, as the kernel hands them out
+dimm=0
+region=0
+for ((b = 0; b < nr_bus; b++)); do
+	plat=devices/platform/fake_nd.$b
+	bus=$plat/ndbus$b
+	mkdir -p "$root/$bus/ndctl$b"
+	attr "$root/$bus" provider "fake_nd.$b"
+	attr "$root/$bus" commands ""
+	attr "$root/$bus" wait_probe 1
+	link bus/nd/drivers/nd_bus $bus/driver
+	attr "$root/$bus/ndctl$b" dev "250:$b"
+	ln -s .. "$root/$bus/ndctl$b/device"
+	link $bus/ndctl$b class/nd/ndctl$b
+	link $bus/ndctl$b dev/char/250:$b
+
+	for ((d = 0; d < nr_dimm; d++, dimm++)); do
+		nmem=$bus/nmem$dimm
+		mkdir -p "$root/$nmem"
+		attr "$root/$nmem" dev "251:$dimm"
+		attr "$root/$nmem" commands ""
+		attr "$root/$nmem" modalias "nd:t4"
+		attr "$root/$nmem" flags ""
+		attr "$root/$nmem" state idle
+		link bus/nd/drivers/nvdimm $nmem/driver
+	done
+
+	for ((r = 0; r < nr_region; r++, region++)); do
+		reg=$bus/region$region
+		mkdir -p "$root/$reg"
+		attr "$root/$reg" size $((nr_ns * 1 << 30))
+		attr "$root/$reg" mappings 0
+		attr "$root/$reg" read_only 0
+		attr "$root/$reg" modalias "nd:t2"
+		attr "$root/$reg" numa_node 0
+		attr "$root/$reg" target_node 0
+		attr "$root/$reg" align $((2 << 20))
+		attr "$root/$reg" nstype 5
+		attr "$root/$reg" set_cookie $((0x1000 + region))
+		attr "$root/$reg" persistence_domain memory_controller
+		attr "$root/$reg" available_size 0
+		attr "$root/$reg" max_available_extent 0
+		attr "$root/$reg" namespace_seed "namespace$region.$nr_ns"
+		link bus/nd/drivers/nd_region $reg/driver
+
+		for ((n = 0; n < nr_ns; n++)); do
+			ns=$reg/namespace$region.$n
+			mkdir -p "$root/$ns/block/pmem$region.$n"
+			attr "$root/$ns" nstype 5
+			attr "$root/$ns" size $((1 << 30))
+			attr "$root/$ns" resource $(((region * nr_ns + n + 1) << 30))
+			attr "$root/$ns" force_raw 0
+			attr "$root/$ns" numa_node 0
+			attr "$root/$ns" target_node 0
+			attr "$root/$ns" holder_class ""
+			attr "$root/$ns" sector_size "512 4096"
+			attr "$root/$ns" alt_name ""
+			printf -v uuid '%08x-0000-4000-8000-%012x' $region $n
+			attr "$root/$ns" uuid $uuid
+			attr "$root/$ns" modalias "nd:t5"
+			attr "$root/$ns" mode raw
+			link bus/nd/drivers/nd_pmem $ns/driver
+		done
+	done
+done
+
+mkdir -p "$root/devices/platform/fake_cxl"
+for ((m = 0; m < nr_memdev; m++)); do
+	mem=devices/platform/fake_cxl/mem$m
+	mkdir -p "$root/$mem"/{ram,pmem}
+	attr "$root/$mem" dev "252:$m"
+	attr "$root/$mem" firmware_version "fake"
+	attr "$root/$mem" payload_max 1048576
+	attr "$root/$mem" label_storage_size 0
+	attr "$root/$mem" serial $m
+	attr "$root/$mem" numa_node 0
+	attr "$root/$mem/ram" size $((1 << 30))
+	attr "$root/$mem/pmem" size 0
+	link $mem bus/cxl/devices/mem$m
+done
+
+for ((r = 0; r < nr_dax_region; r++)); do
+	plat=devices/platform/fake_dax.$r
+	mkdir -p "$root/$plat/dax_region"
+	attr "$root/$plat/dax_region" id $r
+	attr "$root/$plat/dax_region" size $((nr_dax_dev << 30))
+	attr "$root/$plat/dax_region" align $((2 << 20))
+	for ((i = 0; i < nr_dax_dev; i++)); do
+		dax=$plat/dax$r.$i
+		mkdir -p "$root/$dax"
+		attr "$root/$dax" dev "253:$((r * nr_dax_dev + i))"
+		attr "$root/$dax" size $((1 << 30))
+		attr "$root/$dax" align $((2 << 20))
+		attr "$root/$dax" resource $(((r * nr_dax_dev + i + 1) << 30))
+		attr "$root/$dax" target_node 0
+		attr "$root/$dax" modalias "dax:t0"
+		link bus/dax/drivers/device_dax $dax/driver
+		link $dax bus/dax/devices/dax$r.$i
+	done
+done
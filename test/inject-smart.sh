@@ -142,6 +142,23 @@ test_field()
 	fi
 }
 
+test_scenario()
+{
+	local scenario="$(mktemp)"
+
+	cat > $scenario <<- EOF
+	[
+	  { "at": 0, "bus": "$bus", "dimm": "$dimm", "media-temperature": $inj_val },
+	  { "at": 100, "bus": "$bus", "dimm": "$dimm", "unsafe-shutdown": true }
+	]
+	EOF
+	$NDCTL inject-smart --scenario $scenario
+	verify media-temperature $inj_val
+	verify unsafe-shutdown 1
+	$NDCTL inject-smart -b $bus --uninject-all $dimm
+	rm -f $scenario
+}
+
 do_tests()
 {
 	local fields_val=(media-temperature spares)
@@ -163,6 +180,8 @@ do_tests()
 	for field in "${fields_thresh[@]}"; do
 		test_field $field $inj_val "thresh"
 	done
+
+	test_scenario
 }
 
 check_min_kver "4.19" || do_skip "kernel $KVER may not support smart (un)injection"
@@ -0,0 +1,319 @@
+// SPDX-License-Identifier: LGPL-2.1
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <ccan/short_types/short_types.h>
+#include <ccan/array_size/array_size.h>
+#include <ccan/endian/endian.h>
+#include <cxl/libcxl.h>
+#include "cxl-mock.h"
+
+/*
+ * Throughput of the libcxl hot paths against the in-process mock, so
+ * that enumeration and command overhead can be tracked without CXL
+ * hardware. Mailbox latency defaults to zero, leaving only library
+ * cost in the numbers. BENCH_ITERATIONS, BENCH_MEMDEVS,
+ * BENCH_LATENCY_NS and BENCH_THREADS override the defaults.
+ */
+#define BENCH_PAYLOAD_MAX 4096
+
+struct bench {
+	const char *name;
+	int (*fn)(struct cxl_mock *mock, struct cxl_ctx *ctx,
+			unsigned long iterations);
+	unsigned long scale;
+};
+
+static unsigned long nr_memdevs = 16;
+static unsigned long nr_threads = 4;
+
+static unsigned long env_ul(const char *name, unsigned long def)
+{
+	const char *env = getenv(name);
+
+	return env ? strtoul(env, NULL, 0) : def;
+}
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int bench_enumerate(struct cxl_mock *mock, struct cxl_ctx *unused,
+		unsigned long iterations)
+{
+	struct cxl_memdev *memdev;
+	struct cxl_ctx *ctx;
+	unsigned long i, n;
+	int rc;
+
+	for (i = 0; i < iterations; i++) {
+		rc = cxl_new(&ctx);
+		if (rc)
+			return rc;
+		rc = cxl_mock_attach(mock, ctx);
+		n = 0;
+		if (rc == 0)
+			cxl_memdev_foreach(ctx, memdev)
+				n++;
+		cxl_unref(ctx);
+		if (rc)
+			return rc;
+		if (n != nr_memdevs)
+			return -ENODEV;
+	}
+	return 0;
+}
+
+static int bench_cmd_new(struct cxl_mock *mock, struct cxl_ctx *ctx,
+		unsigned long iterations)
+{
+	struct cxl_memdev *memdev = cxl_memdev_get_first(ctx);
+	struct cxl_cmd *cmd;
+	unsigned long i;
+
+	for (i = 0; i < iterations; i++) {
+		cmd = cxl_cmd_new_identify(memdev);
+		if (!cmd)
+			return -ENOMEM;
+		cxl_cmd_unref(cmd);
+	}
+	return 0;
+}
+
+static int bench_identify(struct cxl_mock *mock, struct cxl_ctx *ctx,
+		unsigned long iterations)
+{
+	struct cxl_memdev *memdev = cxl_memdev_get_first(ctx);
+	struct cxl_cmd *cmd;
+	unsigned long i;
+	int rc;
+
+	for (i = 0; i < iterations; i++) {
+		cmd = cxl_cmd_new_identify(memdev);
+		if (!cmd)
+			return -ENOMEM;
+		rc = cxl_cmd_submit(cmd);
+		if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+			rc = -ENXIO;
+		cxl_cmd_unref(cmd);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+static int bench_raw_reuse(struct cxl_mock *mock, struct cxl_ctx *ctx,
+		unsigned long iterations)
+{
+	struct cxl_memdev *memdev = cxl_memdev_get_first(ctx);
+	struct cxl_cmd *cmd;
+	unsigned long i;
+	int rc = 0;
+
+	cmd = cxl_cmd_new_raw(memdev, 0x4200);
+	if (!cmd)
+		return -errno;
+	for (i = 0; i < iterations && rc == 0; i++) {
+		rc = cxl_cmd_submit(cmd);
+		if (rc == 0 && cxl_cmd_get_mbox_status(cmd))
+			rc = -ENXIO;
+	}
+	cxl_cmd_unref(cmd);
+	return rc;
+}
+
+static int bench_all_memdevs(struct cxl_mock *mock, struct cxl_ctx *ctx,
+		unsigned long iterations)
+{
+	struct cxl_memdev *memdev;
+	struct cxl_cmd *cmd;
+	unsigned long i;
+	int rc;
+
+	for (i = 0; i < iterations; i++)
+		cxl_memdev_foreach(ctx, memdev) {
+			cmd = cxl_cmd_new_get_health_info(memdev);
+			if (!cmd)
+				return -ENOMEM;
+			rc = cxl_cmd_submit(cmd);
+			cxl_cmd_unref(cmd);
+			if (rc)
+				return rc;
+		}
+	return 0;
+}
+
+struct bench_thread {
+	pthread_t thread;
+	struct cxl_ctx *ctx;
+	unsigned long idx;
+	unsigned long iterations;
+	int rc;
+};
+
+/*
+ * Each thread walks the shared memdev list, racing the others through
+ * its lazy enumeration, then issues commands to its own share of the
+ * memdevs.
+ */
+static void *bench_thread_run(void *arg)
+{
+	struct bench_thread *t = arg;
+	struct cxl_memdev *memdev;
+	struct cxl_cmd *cmd;
+	unsigned long i, n;
+
+	for (i = 0; i < t->iterations && t->rc == 0; i++) {
+		n = 0;
+		cxl_memdev_foreach(t->ctx, memdev) {
+			if (n++ % nr_threads != t->idx)
+				continue;
+			cmd = cxl_cmd_new_get_health_info(memdev);
+			if (!cmd) {
+				t->rc = -ENOMEM;
+				break;
+			}
+			t->rc = cxl_cmd_submit(cmd);
+			if (t->rc == 0 && cxl_cmd_get_mbox_status(cmd))
+				t->rc = -ENXIO;
+			cxl_cmd_unref(cmd);
+			if (t->rc)
+				break;
+		}
+		if (t->rc == 0 && n != nr_memdevs)
+			t->rc = -ENODEV;
+	}
+	return NULL;
+}
+
+static int bench_threads(struct cxl_mock *mock, struct cxl_ctx *unused,
+		unsigned long iterations)
+{
+	struct bench_thread *threads;
+	struct cxl_ctx *ctx;
+	unsigned long i;
+	int rc;
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		return -ENOMEM;
+	rc = cxl_new(&ctx);
+	if (rc)
+		goto out;
+	cxl_set_log_priority(ctx, LOG_ERR);
+	rc = cxl_mock_attach(mock, ctx);
+	if (rc)
+		goto out_ctx;
+
+	for (i = 0; i < nr_threads; i++) {
+		threads[i].ctx = ctx;
+		threads[i].idx = i;
+		threads[i].iterations = iterations;
+		if (pthread_create(&threads[i].thread, NULL, bench_thread_run,
+					&threads[i])) {
+			rc = -EAGAIN;
+			break;
+		}
+	}
+	while (i--) {
+		pthread_join(threads[i].thread, NULL);
+		if (threads[i].rc && !rc)
+			rc = threads[i].rc;
+	}
+out_ctx:
+	cxl_unref(ctx);
+out:
+	free(threads);
+	return rc;
+}
+
+static struct bench benches[] = {
+	{ "enumerate", bench_enumerate, 100 },
+	{ "cmd-new", bench_cmd_new, 1 },
+	{ "identify", bench_identify, 1 },
+	{ "raw-reuse", bench_raw_reuse, 1 },
+	{ "health-all-memdevs", bench_all_memdevs, 16 },
+	{ "threads-shared-ctx", bench_threads, 16 },
+};
+
+/* Command Effects Log advertising the opcodes used above */
+static void mock_set_cel(struct cxl_mock *mock)
+{
+	static const u16 opcodes[] = { 0x0200, 0x0400, 0x0401, 0x4000,
+		0x4100, 0x4102, 0x4103, 0x4200 };
+	le16 cel[ARRAY_SIZE(opcodes) * 2];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(opcodes); i++) {
+		cel[i * 2] = cpu_to_le16(opcodes[i]);
+		cel[i * 2 + 1] = 0;
+	}
+	cxl_mock_set_response(mock, 0x0401, 0, cel, sizeof(cel));
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long iterations, n;
+	struct cxl_mock *mock;
+	struct cxl_ctx *ctx;
+	unsigned int i;
+	u64 start, ns;
+	int rc;
+
+	iterations = env_ul("BENCH_ITERATIONS", 100000);
+	nr_memdevs = env_ul("BENCH_MEMDEVS", nr_memdevs);
+	nr_threads = env_ul("BENCH_THREADS", nr_threads);
+	if (!iterations || !nr_memdevs || !nr_threads)
+		return EXIT_FAILURE;
+
+	mock = cxl_mock_new(nr_memdevs, BENCH_PAYLOAD_MAX);
+	if (!mock) {
+		fprintf(stderr, "failed to create mock devices\n");
+		return EXIT_FAILURE;
+	}
+	cxl_mock_set_latency(mock, env_ul("BENCH_LATENCY_NS", 0));
+	mock_set_cel(mock);
+
+	rc = cxl_new(&ctx);
+	if (rc)
+		goto out;
+	cxl_set_log_priority(ctx, LOG_ERR);
+	rc = cxl_mock_attach(mock, ctx);
+	if (rc)
+		goto out_ctx;
+
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		struct bench *b = &benches[i];
+
+		n = iterations / b->scale;
+		if (!n)
+			n = 1;
+		start = now_ns();
+		rc = b->fn(mock, ctx, n);
+		ns = now_ns() - start;
+		if (rc) {
+			fprintf(stderr, "%s: failed: %s\n", b->name,
+					strerror(-rc));
+			break;
+		}
+		printf("%-20s %10lu ops %10llu ns/op %12.0f ops/s\n", b->name,
+				n, ns / n, n * 1e9 / (ns ? ns : 1));
+	}
+	printf("%-20s %10llu\n", "mailbox-commands",
+			cxl_mock_get_nr_commands(mock));
+
+out_ctx:
+	cxl_unref(ctx);
+out:
+	cxl_mock_free(mock);
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
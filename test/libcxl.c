@@ -484,6 +484,16 @@ static int test_cxl_read_write_lsa(struct cxl_ctx *ctx)
 			rc = -EIO;
 			goto out_fail;
 		}
+
+		/* rewriting identical data must not issue any SET_LSA */
+		rc = cxl_memdev_update_lsa(memdev, test_lsa_api_data,
+				data_size, 0);
+		if (rc != 0) {
+			fprintf(stderr, "%s: incremental update wrote %d bytes\n",
+				__func__, rc);
+			rc = rc < 0 ? rc : -EIO;
+			goto out_fail;
+		}
 	}
 
 out_fail:
@@ -491,6 +501,98 @@ out_fail:
 	return rc;
 }
 
+static int test_cxl_cmd_batch(struct cxl_ctx *ctx)
+{
+	struct cxl_cmd_batch *batch;
+	struct cxl_memdev *memdev;
+	struct cxl_cmd *cmd;
+	int i, rc = 0;
+
+	batch = cxl_cmd_batch_new(ctx);
+	if (!batch)
+		return -ENOMEM;
+
+	/* two identify commands per memdev exercise in-order submission */
+	cxl_memdev_foreach(ctx, memdev)
+		for (i = 0; i < 2; i++) {
+			cmd = cxl_cmd_new_identify(memdev);
+			if (!cmd) {
+				rc = -ENOMEM;
+				goto out;
+			}
+			rc = cxl_cmd_batch_add(batch, cmd);
+			cxl_cmd_unref(cmd);
+			if (rc < 0)
+				goto out;
+		}
+
+	rc = cxl_cmd_batch_submit(batch);
+	if (rc < 0) {
+		fprintf(stderr, "%s: batch submission failed: %s\n",
+			__func__, strerror(-rc));
+		goto out;
+	}
+
+	for (i = 0; i < cxl_cmd_batch_get_count(batch); i++) {
+		cmd = cxl_cmd_batch_get_cmd(batch, i);
+		if (cxl_cmd_batch_get_result(batch, i) < 0
+				|| cxl_cmd_get_mbox_status(cmd)) {
+			fprintf(stderr, "%s: %s: cmd[%d] failed\n", __func__,
+				cxl_cmd_get_devname(cmd), i);
+			rc = -ENXIO;
+			goto out;
+		}
+		if (cxl_cmd_identify_get_lsa_size(cmd)
+				!= EXPECT_CMD_IDENTIFY_LSA_SIZE) {
+			fprintf(stderr, "%s: %s: lsa_size mismatch\n",
+				__func__, cxl_cmd_get_devname(cmd));
+			rc = -ENXIO;
+			goto out;
+		}
+	}
+	rc = 0;
+out:
+	cxl_cmd_batch_free(batch);
+	return rc;
+}
+
+static int test_cxl_mbox_stats(struct cxl_ctx *ctx)
+{
+	struct cxl_mbox_stats stats[CXL_MEM_COMMAND_ID_MAX];
+	struct cxl_memdev *memdev;
+	unsigned long long expect = 0;
+	struct cxl_cmd *cmd;
+	int i, n, rc;
+
+	cxl_ctx_reset_mbox_stats(ctx);
+	cxl_memdev_foreach(ctx, memdev) {
+		cmd = cxl_cmd_new_identify(memdev);
+		if (!cmd)
+			return -ENOMEM;
+		rc = cxl_cmd_submit(cmd);
+		cxl_cmd_unref(cmd);
+		if (rc < 0)
+			return rc;
+		expect++;
+	}
+
+	n = cxl_ctx_get_mbox_stats(ctx, stats, ARRAY_SIZE(stats));
+	for (i = 0; i < n && i < (int) ARRAY_SIZE(stats); i++) {
+		if (stats[i].opcode != 0x4000)
+			continue;
+		if (stats[i].count != expect || stats[i].errors) {
+			fprintf(stderr, "%s: identify count %llu errors %llu, expected %llu\n",
+				__func__, stats[i].count, stats[i].errors,
+				expect);
+			return -ENXIO;
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "%s: no stats recorded for identify\n", __func__);
+	return -ENXIO;
+}
+
 typedef int (*do_test_fn)(struct cxl_ctx *ctx);
 
 static do_test_fn do_test[] = {
@@ -501,6 +603,8 @@ static do_test_fn do_test[] = {
 	test_cxl_cmd_lsa,
 	test_cxl_cmd_fuzz_sizes,
 	test_cxl_read_write_lsa,
+	test_cxl_cmd_batch,
+	test_cxl_mbox_stats,
 };
 
 static int test_libcxl(int loglevel, struct test_ctx *test, struct cxl_ctx *ctx)
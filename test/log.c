@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include <util/log.h>
+
+/*
+ * A message recorded in the log ring and dumped later must read the
+ * same as if it had been printed right away, and one whose arguments
+ * do not fit a record must be cut at an argument boundary and marked.
+ */
+static char dumped[1024];
+static int nr_dumped;
+
+static void capture(struct log_ctx *ctx, int loud, int priority,
+		const char *file, int line, const char *fn,
+		const char *format, va_list args)
+{
+	char buf[sizeof(dumped)];
+	char *msg;
+
+	vsnprintf(buf, sizeof(buf), format, args);
+	/* skip the "[seconds.nanoseconds] " the dump prefixes */
+	msg = strstr(buf, "] ");
+	strcpy(dumped, msg ? msg + 2 : buf);
+	nr_dumped++;
+}
+
+static int check_record(struct log_ctx *ctx, const char *want, int line)
+{
+	log_ring_dump(ctx);
+	if (nr_dumped == 1 && strcmp(dumped, want) == 0)
+		return 0;
+	fprintf(stderr, "line %d: %d dumped, got \"%s\" want \"%s\"\n", line,
+			nr_dumped, nr_dumped ? dumped : "", want);
+	return -1;
+}
+
+int main(void)
+{
+	char want[sizeof(dumped)], big[300];
+	struct log_ctx ctx;
+	int x = 42, rc = 0;
+
+	log_init(&ctx, "log-test", "LOG_TEST_UNSET");
+	ctx.log_fn = capture;
+	ctx.log_priority = LOG_ERR;
+	if (log_ring_enable(&ctx, 16 * 256) != 0) {
+		fprintf(stderr, "failed to set up the ring\n");
+		return EXIT_FAILURE;
+	}
+
+#define CHECK(format, ...) \
+do { \
+	nr_dumped = 0; \
+	snprintf(want, sizeof(want), format, ##__VA_ARGS__); \
+	do_log(&ctx, 1, LOG_DEBUG, __FILE__, __LINE__, __func__, format, \
+			##__VA_ARGS__); \
+	rc |= check_record(&ctx, want, __LINE__); \
+} while (0)
+
+	CHECK("plain\n");
+	CHECK("%d %u %x %c %%\n", -1, 2U, 0xbeef, 'c');
+	CHECK("%ld %lu %lld %llx\n", -3L, 4UL, -5LL, 0x1234567890abcdefULL);
+	CHECK("%zu %zd %td %jd\n", (size_t) 6, (ssize_t) -7,
+			(ptrdiff_t) 8, (intmax_t) -9);
+	CHECK("%hhu %hd\n", 10, 11);
+	CHECK("%f %.3e %g %Lf\n", 1.5, 2.25, 0.125, (long double) 3.75);
+	CHECK("%p %p\n", (void *) &x, NULL);
+	CHECK("%s, %s and %s\n", "one", "", "three");
+	CHECK("%.3s|%-6s|%6s\n", "abcdef", "ab", "cd");
+	CHECK("%*d|%-*d|%.*s|%*.*s\n", 5, 1, 4, 2, 2, "xyz", 6, 1, "pq");
+	CHECK("%.*s\n", -1, "negative precision is none");
+	CHECK("%s\n", (char *) NULL);
+
+	/* %m is recorded at the call, not at the dump */
+	errno = ENOENT;
+	snprintf(want, sizeof(want), "%s\n", strerror(ENOENT));
+	nr_dumped = 0;
+	do_log(&ctx, 1, LOG_DEBUG, __FILE__, __LINE__, __func__, "%m\n");
+	errno = 0;
+	rc |= check_record(&ctx, want, __LINE__);
+
+	/* an oversized string is cut, the arguments after it are lost */
+	memset(big, 'a', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	nr_dumped = 0;
+	do_log(&ctx, 1, LOG_DEBUG, __FILE__, __LINE__, __func__, "<%s> %d\n",
+			big, x);
+	log_ring_dump(&ctx);
+	if (nr_dumped != 1 || strncmp(dumped, "<aaaa", 5) != 0
+			|| strlen(dumped) >= sizeof(big)
+			|| strcmp(dumped + strlen(dumped) - 4, "...\n") != 0) {
+		fprintf(stderr, "cut record: got \"%s\"\n", dumped);
+		rc = -1;
+	}
+
+	/* messages within log_priority are printed, not held back */
+	nr_dumped = 0;
+	ctx.log_priority = LOG_DEBUG;
+	do_log(&ctx, 1, LOG_DEBUG, __FILE__, __LINE__, __func__, "live %d\n",
+			x);
+	if (nr_dumped != 1 || strcmp(dumped, "live 42\n") != 0) {
+		fprintf(stderr, "live message: got \"%s\"\n", dumped);
+		rc = -1;
+	}
+
+	log_exit(&ctx);
+	fprintf(stderr, "log: %s\n", rc ? "FAIL" : "PASS");
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,381 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <time.h>
+#include <uuid/uuid.h>
+
+#include <util/size.h>
+#include <util/bitmap.h>
+#include <util/fletcher.h>
+#include <ndctl/namespace.h>
+#include <ccan/array_size/array_size.h>
+
+/*
+ * Time the metadata checks that run on every label read, info-block
+ * read and BTT check against synthetic images, so that work on them
+ * can be measured without a dimm or namespace: the label index checks
+ * of __label_validate(), info-block signature and checksum
+ * verification, and a full read-only check of a generated BTT, which
+ * is dominated by the map, log and bitmap passes. Each is run for a
+ * warmup round and then a number of timed rounds, and the fastest
+ * round is reported as ns/op and GB/s of metadata covered.
+ */
+int btt_check_file(const char *path, bool verbose, unsigned int jobs);
+
+#define NSLABEL_SIZE 256
+#define BTT_NFREE 256
+
+static unsigned long iterations = 100000;
+static unsigned int rounds = 5;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, unsigned long long size,
+		unsigned long n, u64 best, unsigned long long bytes)
+{
+	printf("%-14s %12llu bytes %12.1f ns/op %8.2f GB/s\n", name, size,
+			(double) best / n, (double) bytes * n / best);
+}
+
+static size_t sizeof_index(u32 nslot)
+{
+	return ALIGN(sizeof(struct namespace_index) + DIV_ROUND_UP(nslot, 8),
+			NSINDEX_ALIGN);
+}
+
+/* a v1.2 label area as ndctl_dimm_init_labels() lays it out */
+static void *label_area(unsigned long config_size, size_t *index_size)
+{
+	u32 nslot, i;
+	char *area;
+	size_t n;
+
+	nslot = config_size / NSLABEL_SIZE;
+	n = sizeof_index(nslot) / NSINDEX_ALIGN;
+	nslot = (config_size - NSINDEX_ALIGN * n * 2) / NSLABEL_SIZE;
+	*index_size = sizeof_index(nslot);
+
+	area = calloc(1, config_size);
+	if (!area)
+		return NULL;
+	for (i = 0; i < 2; i++) {
+		struct namespace_index *nsindex;
+
+		nsindex = (void *) (area + *index_size * i);
+		memcpy(nsindex->sig, NSINDEX_SIG, NSINDEX_SIG_LEN);
+		nsindex->labelsize = 1;
+		nsindex->seq = cpu_to_le32(i + 1);
+		nsindex->myoff = cpu_to_le64(*index_size * i);
+		nsindex->otheroff = cpu_to_le64(*index_size * !i);
+		nsindex->mysize = cpu_to_le64(*index_size);
+		nsindex->labeloff = cpu_to_le64(*index_size * 2);
+		nsindex->nslot = cpu_to_le32(nslot);
+		nsindex->major = cpu_to_le16(1);
+		nsindex->minor = cpu_to_le16(2);
+		memset(nsindex->free, 0xff, nslot / 8);
+		nsindex->checksum = cpu_to_le64(fletcher64(nsindex,
+					*index_size, 1));
+	}
+	return area;
+}
+
+static int bench_labels(unsigned long config_size)
+{
+	unsigned long n, i;
+	size_t index_size;
+	u64 start, ns, best = ULLONG_MAX;
+	unsigned int r;
+	char *area;
+
+	area = label_area(config_size, &index_size);
+	if (!area)
+		return -ENOMEM;
+
+	for (r = 0; r <= rounds; r++) {
+		n = r ? iterations : iterations / 10 + 1;
+		start = now_ns();
+		for (i = 0; i < n; i++)
+			if (nsindex_verify((void *) area, 0, index_size,
+						NSLABEL_SIZE, config_size)
+					|| nsindex_verify((void *) (area
+							+ index_size), 1,
+						index_size, NSLABEL_SIZE,
+						config_size)) {
+				fprintf(stderr, "label index rejected\n");
+				free(area);
+				return -ENXIO;
+			}
+		ns = now_ns() - start;
+		/* round 0 is the warmup */
+		if (r && ns < best)
+			best = ns;
+	}
+	report("label-index", config_size, iterations, best ? best : 1,
+			index_size * 2);
+	free(area);
+	return 0;
+}
+
+static void infoblock_seal(union info_block *ib, const char *sig)
+{
+	memcpy(ib->btt_sb.signature, sig, BTT_SIG_LEN);
+	ib->btt_sb.checksum = 0;
+	ib->btt_sb.checksum = cpu_to_le64(fletcher64(ib, sizeof(*ib), 1));
+}
+
+/* what read-infoblock does per block: classify, then verify */
+static int bench_infoblocks(void)
+{
+	static const char * const sigs[] = { BTT_SIG, PFN_SIG, DAX_SIG };
+	union info_block *ib;
+	u64 start, ns, best = ULLONG_MAX;
+	unsigned long n, i;
+	unsigned int r, j;
+
+	ib = calloc(ARRAY_SIZE(sigs), sizeof(*ib));
+	if (!ib)
+		return -ENOMEM;
+	for (j = 0; j < ARRAY_SIZE(sigs); j++) {
+		memset(ib[j].btt_sb.padding, j + 1,
+				sizeof(ib[j].btt_sb.padding));
+		infoblock_seal(&ib[j], sigs[j]);
+	}
+
+	for (r = 0; r <= rounds; r++) {
+		n = r ? iterations : iterations / 10 + 1;
+		start = now_ns();
+		for (i = 0; i < n; i++) {
+			union info_block *b = &ib[i % ARRAY_SIZE(sigs)];
+
+			for (j = 0; j < ARRAY_SIZE(sigs); j++)
+				if (memcmp(b->btt_sb.signature, sigs[j],
+							BTT_SIG_LEN) == 0)
+					break;
+			if (j == ARRAY_SIZE(sigs)
+					|| !verify_infoblock_checksum(b)) {
+				fprintf(stderr, "info block rejected\n");
+				free(ib);
+				return -ENXIO;
+			}
+		}
+		ns = now_ns() - start;
+		if (r && ns < best)
+			best = ns;
+	}
+	report("infoblock", sizeof(*ib), iterations, best ? best : 1,
+			sizeof(*ib));
+	free(ib);
+	return 0;
+}
+
+static int pwrite_all(int fd, const void *buf, size_t len, off_t off)
+{
+	ssize_t rc = pwrite(fd, buf, len, off);
+
+	if (rc < 0)
+		return -errno;
+	return (size_t) rc == len ? 0 : -EIO;
+}
+
+/*
+ * One v1.1 arena in its freshly created state, laid out as the kernel's
+ * btt_arena_alloc() does: an identity map, every lane of the log
+ * holding one free block, and a copy of the info block at the end. The
+ * data area is left as a hole.
+ */
+static int btt_image(int fd, unsigned long long size,
+		unsigned long long *meta)
+{
+	unsigned long long arena = size - BTT1_START_OFFSET, available;
+	unsigned long long logsize, mapsize, datasize;
+	u32 internal_nlba, external_nlba, i;
+	struct log_group *log;
+	struct btt_sb *sb;
+	int rc;
+
+	if (arena < ARENA_MIN_SIZE || arena > ARENA_MAX_SIZE)
+		return -EINVAL;
+	available = arena - 2 * BTT_INFO_SIZE;
+	logsize = ALIGN(BTT_NFREE * LOG_GRP_SIZE, SZ_4K);
+	available -= logsize;
+	internal_nlba = (available - SZ_4K) / (SZ_4K + sizeof(u32));
+	external_nlba = internal_nlba - BTT_NFREE;
+	mapsize = ALIGN((unsigned long long) external_nlba * sizeof(u32),
+			SZ_4K);
+	datasize = available - mapsize;
+	*meta = mapsize + logsize;
+
+	sb = calloc(1, sizeof(*sb));
+	log = calloc(BTT_NFREE, sizeof(*log));
+	if (!sb || !log) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	memcpy(sb->signature, BTT_SIG, BTT_SIG_LEN);
+	uuid_generate((void *) sb->uuid);
+	sb->version_major = cpu_to_le16(1);
+	sb->version_minor = cpu_to_le16(1);
+	sb->external_lbasize = cpu_to_le32(SZ_4K);
+	sb->internal_lbasize = cpu_to_le32(SZ_4K);
+	sb->external_nlba = cpu_to_le32(external_nlba);
+	sb->internal_nlba = cpu_to_le32(internal_nlba);
+	sb->nfree = cpu_to_le32(BTT_NFREE);
+	sb->infosize = cpu_to_le32(sizeof(*sb));
+	sb->dataoff = cpu_to_le64(BTT_INFO_SIZE);
+	sb->mapoff = cpu_to_le64(BTT_INFO_SIZE + datasize);
+	sb->logoff = cpu_to_le64(BTT_INFO_SIZE + datasize + mapsize);
+	sb->info2off = cpu_to_le64(BTT_INFO_SIZE + datasize + mapsize
+			+ logsize);
+	sb->checksum = cpu_to_le64(fletcher64(sb, sizeof(*sb), 1));
+
+	for (i = 0; i < BTT_NFREE; i++) {
+		log[i].ent[0].lba = cpu_to_le32(i);
+		log[i].ent[0].old_map = cpu_to_le32(external_nlba + i);
+		log[i].ent[0].new_map = cpu_to_le32(external_nlba + i);
+		log[i].ent[0].seq = cpu_to_le32(1);
+	}
+
+	if (ftruncate(fd, 0) < 0 || ftruncate(fd, size) < 0) {
+		rc = -errno;
+		goto out;
+	}
+	rc = pwrite_all(fd, sb, sizeof(*sb), BTT1_START_OFFSET);
+	if (rc == 0)
+		rc = pwrite_all(fd, log, BTT_NFREE * sizeof(*log),
+				BTT1_START_OFFSET + le64_to_cpu(sb->logoff));
+	if (rc == 0)
+		rc = pwrite_all(fd, sb, sizeof(*sb), BTT1_START_OFFSET
+				+ le64_to_cpu(sb->info2off));
+	if (rc == 0 && fsync(fd) < 0)
+		rc = -errno;
+ out:
+	free(log);
+	free(sb);
+	return rc;
+}
+
+static int bench_btt(unsigned long long size, unsigned int jobs)
+{
+	char path[] = "/tmp/ndctl-bench-btt.XXXXXX";
+	u64 start, ns, best = ULLONG_MAX;
+	unsigned long long meta;
+	unsigned int r;
+	int fd, rc;
+
+	fd = mkstemp(path);
+	if (fd < 0)
+		return -errno;
+	rc = btt_image(fd, size, &meta);
+	close(fd);
+	if (rc)
+		goto out;
+
+	/* a whole check per op, so far fewer of them */
+	for (r = 0; r <= rounds; r++) {
+		start = now_ns();
+		rc = btt_check_file(path, false, jobs);
+		ns = now_ns() - start;
+		if (rc) {
+			fprintf(stderr, "btt check failed: %s\n",
+					strerror(rc < 0 ? -rc : EIO));
+			goto out;
+		}
+		if (r && ns < best)
+			best = ns;
+	}
+	report(jobs == 1 ? "btt-check" : "btt-check-mt", size, 1,
+			best ? best : 1, meta);
+ out:
+	unlink(path);
+	return rc;
+}
+
+static void bench_usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-l label-area-size] [-b btt-size] [-j jobs] [-n iterations] [-r rounds]\n"
+			"  -l  label area size, repeatable, default 128K and 1M\n"
+			"  -b  BTT image size, repeatable, default 64M and 1G\n"
+			"  -j  threads for the BTT check, 0 for one per cpu, default 1\n"
+			"  -n  operations per round for the label and info-block runs\n"
+			"  -r  timed rounds after the warmup, default 5\n", prog);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long labels[8] = { 128 * SZ_1K, SZ_1M };
+	unsigned long long btts[8] = { SZ_64M, SZ_1G };
+	int nr_labels = 2, nr_btts = 2, c, i, rc = 0;
+	bool set_labels = false, set_btts = false;
+	unsigned int jobs = 1;
+	const char *env;
+
+	env = getenv("BENCH_ITERATIONS");
+	if (env)
+		iterations = strtoul(env, NULL, 0);
+
+	while ((c = getopt(argc, argv, "l:b:j:n:r:")) != -1) {
+		switch (c) {
+		case 'l':
+			if (!set_labels)
+				nr_labels = 0;
+			set_labels = true;
+			if (nr_labels == (int) ARRAY_SIZE(labels))
+				bench_usage(argv[0]);
+			labels[nr_labels++] = parse_size64(optarg);
+			break;
+		case 'b':
+			if (!set_btts)
+				nr_btts = 0;
+			set_btts = true;
+			if (nr_btts == (int) ARRAY_SIZE(btts))
+				bench_usage(argv[0]);
+			btts[nr_btts++] = parse_size64(optarg);
+			break;
+		case 'j':
+			jobs = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			bench_usage(argv[0]);
+		}
+	}
+	if (optind != argc || !iterations || !rounds)
+		bench_usage(argv[0]);
+
+	for (i = 0; i < nr_labels && rc == 0; i++) {
+		if (labels[i] == ULLONG_MAX
+				|| labels[i] < 2 * NSINDEX_ALIGN
+				+ 2 * NSLABEL_SIZE)
+			bench_usage(argv[0]);
+		rc = bench_labels(labels[i]);
+	}
+	if (rc == 0)
+		rc = bench_infoblocks();
+	for (i = 0; i < nr_btts && rc == 0; i++) {
+		if (btts[i] == ULLONG_MAX)
+			bench_usage(argv[0]);
+		rc = bench_btt(btts[i], jobs);
+	}
+
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
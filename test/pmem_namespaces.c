@@ -23,7 +23,8 @@
 #define err(msg)\
 	fprintf(stderr, "%s:%d: %s (%s)\n", __func__, __LINE__, msg, strerror(errno))
 
-static struct ndctl_namespace *create_pmem_namespace(struct ndctl_region *region)
+static struct ndctl_namespace *create_pmem_namespace(struct test_ctx *test,
+		struct ndctl_region *region)
 {
 	struct ndctl_namespace *seed_ns = NULL;
 	unsigned long long size;
@@ -36,14 +37,18 @@ static struct ndctl_namespace *create_pmem_namespace(struct ndctl_region *region
 	uuid_generate(uuid);
 	size = ndctl_region_get_size(region);
 
+	/* setting the uuid and size writes the labels */
+	test_step_begin(test, "pmem-namespace-create");
 	if (ndctl_namespace_set_uuid(seed_ns, uuid) < 0)
 		return NULL;
 
 	if (ndctl_namespace_set_size(seed_ns, size) < 0)
 		return NULL;
 
+	test_step_begin(test, "pmem-namespace-enable");
 	if (ndctl_namespace_enable(seed_ns) < 0)
 		return NULL;
+	test_step_end(test);
 
 	return seed_ns;
 }
@@ -209,6 +214,7 @@ int test_pmem_namespaces(int log_level, struct test_ctx *test,
         ndctl_region_foreach(bus, region)
 		ndctl_region_disable_invalidate(region);
 
+	test_step_begin(test, "pmem-zero-labels");
 	ndctl_dimm_foreach(bus, dimm) {
 		rc = ndctl_dimm_zero_labels(dimm);
 		if (rc < 0) {
@@ -218,6 +224,8 @@ int test_pmem_namespaces(int log_level, struct test_ctx *test,
 		}
 	}
 
+	test_step_end(test);
+
 	/* create our config */
 	ndctl_region_foreach(bus, region)
 		if (strcmp(ndctl_region_get_type_name(region), "pmem") == 0) {
@@ -232,16 +240,19 @@ int test_pmem_namespaces(int log_level, struct test_ctx *test,
 	}
 
 	rc = -ENODEV;
-	ndns = create_pmem_namespace(pmem_region);
+	ndns = create_pmem_namespace(test, pmem_region);
 	if (!ndns) {
 		fprintf(stderr, "%s: failed to create PMEM namespace\n", comm);
 		goto err;
 	}
 
+	test_step_begin(test, "pmem-io");
 	sprintf(bdev, "/dev/%s", ndctl_namespace_get_block_device(ndns));
 	rc = ns_do_io(bdev);
 
+	test_step_begin(test, "pmem-namespace-destroy");
 	disable_pmem_namespace(ndns);
+	test_step_end(test);
 
  err:
 	/* unload nfit_test */
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/pool.h>
+#include <ccan/array_size/array_size.h>
+
+/*
+ * Every item of a util_pool_run() batch must run exactly once, whatever
+ * the mix of items with and without a numa node and however many
+ * threads the batch is spread over.
+ */
+#define NR_ITEMS 64
+
+struct pool_test {
+	int nr_nodes;
+	int runs[NR_ITEMS];
+};
+
+static void test_run(void *arg, int idx)
+{
+	struct pool_test *t = arg;
+
+	__atomic_add_fetch(&t->runs[idx], 1, __ATOMIC_RELAXED);
+}
+
+/* nr_nodes 0 is "-1 for all", otherwise spread with every third anywhere */
+static int test_node(void *arg, int idx)
+{
+	struct pool_test *t = arg;
+
+	if (!t->nr_nodes || idx % 3 == 0)
+		return -1;
+	return idx % t->nr_nodes;
+}
+
+static int test_pool(int nr, unsigned int jobs, int nr_nodes, bool node)
+{
+	struct pool_test t = { .nr_nodes = nr_nodes };
+	struct util_pool pool = {
+		.arg = &t,
+		.nr = nr,
+		.jobs = jobs,
+		.run = test_run,
+		.node = node ? test_node : NULL,
+	};
+	int i;
+
+	util_pool_run(&pool);
+	for (i = 0; i < NR_ITEMS; i++) {
+		int want = i < nr ? 1 : 0;
+
+		if (t.runs[i] == want)
+			continue;
+		fprintf(stderr, "nr: %d jobs: %u nodes: %d%s: item %d ran %d times\n",
+				nr, jobs, nr_nodes, node ? "" : " (no node)",
+				i, t.runs[i]);
+		return -1;
+	}
+	return 0;
+}
+
+int main(void)
+{
+	static const int nrs[] = { 1, 2, 8, NR_ITEMS };
+	static const unsigned int jobs[] = { 1, 2, 4, 16 };
+	unsigned int i, j;
+	int nodes, rc = 0;
+
+	for (i = 0; i < ARRAY_SIZE(nrs); i++)
+		for (j = 0; j < ARRAY_SIZE(jobs); j++) {
+			rc |= test_pool(nrs[i], jobs[j], 0, false);
+			for (nodes = 0; nodes < 4; nodes++)
+				rc |= test_pool(nrs[i], jobs[j], nodes, true);
+		}
+
+	fprintf(stderr, "pool: %s\n", rc ? "FAIL" : "PASS");
+	return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
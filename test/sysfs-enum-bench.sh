@@ -0,0 +1,97 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+
+# Time "ndctl list", "cxl list" and "daxctl list" end to end against
+# generated sysfs trees of growing size, see gen-sysfs-tree.sh, and
+# check each one found everything in the tree. Environment:
+#   ENUM_SCALES   topology multipliers to run (default: "1 4 16 64")
+#   ENUM_RUNS     runs per command, the fastest is kept (default: 3)
+#   ENUM_RESULTS  output file, one JSON object per scale
+#                 (default: sysfs-enum-bench.json)
+#
+# At scale N the tree has N buses of 8 dimms and 2 regions with 4
+# namespaces each, 8N memdevs, and N dax regions of 4 devices.
+
+. $(dirname $0)/common
+
+SCALES=${ENUM_SCALES:-"1 4 16 64"}
+RUNS=${ENUM_RUNS:-3}
+RESULTS=${ENUM_RESULTS:-sysfs-enum-bench.json}
+
+if [ -x ../cxl/cxl ]; then
+	CXL=../cxl/cxl
+elif [ -x ./cxl/cxl ]; then
+	CXL=./cxl/cxl
+fi
+
+rc=77
+
+set -e
+
+trap 'err $LINENO cleanup' ERR
+
+check_prereq "jq"
+
+root=$(mktemp -d /tmp/sysfs-enum.XXXXXX)
+
+cleanup()
+{
+	rm -rf "$root"
+}
+
+# $1: expected count, then the command; prints the best time in us
+time_list()
+{
+	local expect=$1 best=0 start end t i nr
+	shift
+
+	for ((i = 0; i < RUNS; i++)); do
+		start=$(date +%s%N)
+		nr=$("$@" | jq "$filter")
+		end=$(date +%s%N)
+		if [ "$nr" -ne "$expect" ]; then
+			echo "$*: found $nr of $expect" >&2
+			return 1
+		fi
+		t=$(((end - start) / 1000))
+		if [ $best -eq 0 ] || [ $t -lt $best ]; then
+			best=$t
+		fi
+	done
+	echo $best
+}
+
+rm -f "$RESULTS"
+rc=1
+
+export NDCTL_SYSFS_ROOT=$root
+export DAXCTL_SYSFS_ROOT=$root
+export CXL_SYSFS_ROOT=$root
+
+for n in $SCALES; do
+	nr_ns=$((n * 2 * 4))
+	nr_mem=$((n * 8))
+	nr_dax=$((n * 4))
+	bash $(dirname $0)/gen-sysfs-tree.sh "$root" $n 8 2 4 $nr_mem $n 4
+
+	filter='[.. | objects | select(.dev? // "" | startswith("namespace"))] | length'
+	ndctl_us=$(time_list $nr_ns $NDCTL list -BDRN)
+
+	filter='[.. | objects | select(.memdev?)] | length'
+	cxl_us=null
+	if [ -n "$CXL" ]; then
+		cxl_us=$(time_list $nr_mem $CXL list --memdevs)
+	fi
+
+	filter='[.. | objects | select(.chardev?)] | length'
+	daxctl_us=$(time_list $nr_dax $DAXCTL list -RD)
+
+	jq -n -c --argjson scale $n --argjson namespaces $nr_ns \
+		--argjson memdevs $nr_mem --argjson dax_devs $nr_dax \
+		--argjson ndctl_us $ndctl_us --argjson cxl_us $cxl_us \
+		--argjson daxctl_us $daxctl_us \
+		'$ARGS.named' | tee -a "$RESULTS"
+done
+
+cleanup
+exit 0
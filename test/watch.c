@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: LGPL-2.1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <syslog.h>
+#include <libkmod.h>
+#include <linux/version.h>
+#include <test.h>
+
+#include <ndctl/libndctl.h>
+#include <ndctl.h>
+
+/*
+ * Disable and re-enable a region through one context, and check that
+ * a second one, subscribed with ndctl_watch(), sees its namespaces go
+ * away and come back through ndctl_refresh() alone.
+ */
+static const char *PROVIDER = "nfit_test.0";
+
+/* how long the kernel and udev get to deliver the events */
+#define WATCH_TIMEOUT_MS 10000
+
+static struct ndctl_region *get_pmem_region(struct ndctl_ctx *ctx, int id)
+{
+	struct ndctl_region *region;
+	struct ndctl_bus *bus;
+
+	ndctl_bus_foreach(ctx, bus) {
+		if (strcmp(PROVIDER, ndctl_bus_get_provider(bus)) != 0)
+			continue;
+		ndctl_region_foreach(bus, region) {
+			if (ndctl_region_get_type(region) != ND_DEVICE_REGION_PMEM)
+				continue;
+			if (id < 0 || (int) ndctl_region_get_id(region) == id)
+				return region;
+		}
+	}
+	return NULL;
+}
+
+static int count_namespaces(struct ndctl_region *region)
+{
+	struct ndctl_namespace *ndns;
+	int count = 0;
+
+	ndctl_namespace_foreach(region, ndns)
+		count++;
+	return count;
+}
+
+/* refresh @region's context until it lists @want namespaces */
+static int wait_namespaces(struct ndctl_region *region, int fd, int want)
+{
+	struct ndctl_ctx *ctx = ndctl_region_get_ctx(region);
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	int waited, rc;
+
+	for (waited = 0; waited < WATCH_TIMEOUT_MS; waited += 100) {
+		rc = ndctl_refresh(ctx);
+		if (rc < 0) {
+			fprintf(stderr, "refresh failed: %s\n", strerror(-rc));
+			return rc;
+		}
+		if (count_namespaces(region) == want)
+			return 0;
+		poll(&pfd, 1, 100);
+	}
+	fprintf(stderr, "%s: %d namespaces listed, expected %d\n",
+			ndctl_region_get_devname(region),
+			count_namespaces(region), want);
+	return -ETIMEDOUT;
+}
+
+static int do_test(struct ndctl_ctx *ctx, struct ndctl_ctx *wctx)
+{
+	struct ndctl_region *region, *wregion;
+	int fd, nr, rc;
+
+	region = get_pmem_region(ctx, -1);
+	if (!region) {
+		fprintf(stderr, "failed to find a pmem region on %s\n",
+				PROVIDER);
+		return -ENODEV;
+	}
+
+	fd = ndctl_watch(wctx);
+	if (fd < 0) {
+		fprintf(stderr, "failed to watch: %s\n", strerror(-fd));
+		return fd;
+	}
+	if (ndctl_watch(wctx) != fd) {
+		fprintf(stderr, "a second watch returned a new descriptor\n");
+		return -ENXIO;
+	}
+
+	/* enumerate before the change, that is what gets refreshed */
+	wregion = get_pmem_region(wctx, ndctl_region_get_id(region));
+	if (!wregion) {
+		fprintf(stderr, "watcher does not list %s\n",
+				ndctl_region_get_devname(region));
+		return -ENODEV;
+	}
+	nr = count_namespaces(wregion);
+	if (nr == 0) {
+		fprintf(stderr, "%s: no namespaces to watch\n",
+				ndctl_region_get_devname(region));
+		return -ENXIO;
+	}
+
+	rc = ndctl_region_disable_invalidate(region);
+	if (rc) {
+		fprintf(stderr, "failed to disable %s\n",
+				ndctl_region_get_devname(region));
+		return rc;
+	}
+	rc = wait_namespaces(wregion, fd, 0);
+
+	if (ndctl_region_enable(region) < 0) {
+		fprintf(stderr, "failed to enable %s\n",
+				ndctl_region_get_devname(region));
+		return -ENXIO;
+	}
+	if (rc)
+		return rc;
+	rc = wait_namespaces(wregion, fd, nr);
+	if (rc)
+		return rc;
+
+	/* the namespaces that went away stay valid until the cleanup */
+	ndctl_region_cleanup(wregion);
+	return 0;
+}
+
+int test_watch(int loglevel, struct test_ctx *test, struct ndctl_ctx *ctx)
+{
+	struct kmod_module *mod;
+	struct kmod_ctx *kmod_ctx;
+	struct ndctl_ctx *wctx;
+	int err, result = EXIT_FAILURE;
+
+	if (!test_attempt(test, KERNEL_VERSION(4, 3, 0)))
+		return 77;
+
+	ndctl_set_log_priority(ctx, loglevel);
+	err = ndctl_test_init(&kmod_ctx, &mod, NULL, loglevel, test);
+	if (err < 0) {
+		test_skip(test);
+		fprintf(stderr, "nfit_test unavailable skipping tests\n");
+		return 77;
+	}
+
+	err = ndctl_new(&wctx);
+	if (err == 0) {
+		ndctl_set_log_priority(wctx, loglevel);
+		err = do_test(ctx, wctx);
+		ndctl_unref(wctx);
+	}
+	if (err == 0)
+		result = EXIT_SUCCESS;
+	kmod_module_remove_module(mod, 0);
+	kmod_unref(kmod_ctx);
+	return result;
+}
+
+int __attribute__((weak)) main(int argc, char *argv[])
+{
+	struct test_ctx *test = test_new(0);
+	struct ndctl_ctx *ctx;
+	int rc;
+
+	if (!test) {
+		fprintf(stderr, "failed to initialize test\n");
+		return EXIT_FAILURE;
+	}
+
+	rc = ndctl_new(&ctx);
+	if (rc)
+		return test_result(test, rc);
+
+	rc = test_watch(LOG_DEBUG, test, ctx);
+	ndctl_unref(ctx);
+	return test_result(test, rc);
+}
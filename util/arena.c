@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <util/arena.h>
+
+#define ARENA_CHUNK (16 << 10)
+
+struct arena_chunk {
+	struct arena_chunk *prev;
+	size_t used, size;
+	alignas(max_align_t) char data[];
+};
+
+void arena_init(struct arena *arena)
+{
+	arena->chunks = NULL;
+	pthread_mutex_init(&arena->lock, NULL);
+}
+
+void *arena_zalloc(struct arena *arena, size_t size)
+{
+	const size_t align = alignof(max_align_t);
+	struct arena_chunk *chunk;
+	void *ptr = NULL;
+
+	size = (size + align - 1) & ~(align - 1);
+
+	pthread_mutex_lock(&arena->lock);
+	chunk = arena->chunks;
+	if (!chunk || chunk->size - chunk->used < size) {
+		size_t csize = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+
+		/* calloc, so everything handed out starts zeroed */
+		chunk = calloc(1, sizeof(*chunk) + csize);
+		if (!chunk)
+			goto out;
+		chunk->size = csize;
+		/* an oversized chunk goes behind the current one */
+		if (arena->chunks && size > ARENA_CHUNK) {
+			chunk->prev = arena->chunks->prev;
+			arena->chunks->prev = chunk;
+		} else {
+			chunk->prev = arena->chunks;
+			arena->chunks = chunk;
+		}
+	}
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+ out:
+	pthread_mutex_unlock(&arena->lock);
+	return ptr;
+}
+
+char *arena_strdup(struct arena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *dup = arena_zalloc(arena, len);
+
+	if (dup)
+		memcpy(dup, str, len);
+	return dup;
+}
+
+void arena_release(struct arena *arena)
+{
+	struct arena_chunk *chunk, *prev;
+
+	for (chunk = arena->chunks; chunk; chunk = prev) {
+		prev = chunk->prev;
+		free(chunk);
+	}
+	arena->chunks = NULL;
+	pthread_mutex_destroy(&arena->lock);
+}
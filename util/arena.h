@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _NDCTL_ARENA_H_
+#define _NDCTL_ARENA_H_
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * struct arena - bump allocator for objects that live as long as their owner
+ * @chunks: most recent chunk first, each chunk links to the previous one
+ * @lock: allocation may race with parallel enumeration
+ *
+ * Nothing is freed individually, arena_release() returns every chunk at
+ * once. Allocations are zeroed and aligned for any object.
+ */
+struct arena_chunk;
+
+struct arena {
+	struct arena_chunk *chunks;
+	pthread_mutex_t lock;
+};
+
+void arena_init(struct arena *arena);
+void *arena_zalloc(struct arena *arena, size_t size);
+char *arena_strdup(struct arena *arena, const char *str);
+void arena_release(struct arena *arena);
+
+#endif /* _NDCTL_ARENA_H_ */
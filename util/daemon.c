@@ -0,0 +1,493 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <poll.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <ccan/short_types/short_types.h>
+#include <ccan/array_size/array_size.h>
+#include <util/util.h>
+
+/* the daemon logs through its own logger, whatever the build */
+#ifndef ENABLE_LOGGING
+#define ENABLE_LOGGING
+#endif
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include <util/daemon.h>
+#include <util/monitor.h>
+
+/*
+ * A request is a u32 length followed by that many bytes of NUL
+ * terminated arguments, the command name first, with the client's
+ * stdout and stderr attached to the length. The reply is the command's
+ * exit status as an int, written by the child once the output is out.
+ */
+#define DAEMON_ARGS_MAX 65536
+#define DAEMON_ARGC_MAX 256
+
+/* commands that only read, and so can run against a warm context */
+static const char * const served[] = {
+	"list",
+};
+
+static const char * const prog_names[] = {
+	[PROG_NDCTL] = "NDCTL",
+	[PROG_DAXCTL] = "DAXCTL",
+	[PROG_CXL] = "CXL",
+};
+
+static const char * const sock_names[] = {
+	[PROG_NDCTL] = UTIL_DAEMON_DIR "/ndctl.sock",
+	[PROG_DAXCTL] = UTIL_DAEMON_DIR "/daxctl.sock",
+	[PROG_CXL] = UTIL_DAEMON_DIR "/cxl.sock",
+};
+
+/**
+ * util_daemon_socket - where a program's daemon listens
+ * @prog: which of ndctl, daxctl or cxl
+ *
+ * <PROG>_DAEMON_SOCKET overrides the default, set empty it keeps the
+ * client from ever trying the daemon. Returns NULL in that case.
+ */
+const char *util_daemon_socket(enum program prog)
+{
+	char env[32];
+	const char *path;
+
+	snprintf(env, sizeof(env), "%s_DAEMON_SOCKET", prog_names[prog]);
+	path = secure_getenv(env);
+	if (!path)
+		return sock_names[prog];
+	return *path ? path : NULL;
+}
+
+static bool is_served(const char *cmd)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(served); i++)
+		if (strcmp(cmd, served[i]) == 0)
+			return true;
+	return false;
+}
+
+static int send_request(int fd, int argc, const char **argv)
+{
+	char cbuf[CMSG_SPACE(2 * sizeof(int))] = { 0 };
+	struct msghdr msg = { 0 };
+	struct cmsghdr *cmsg;
+	struct iovec iov[2];
+	int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+	char *args, *p;
+	size_t len = 0;
+	int i, rc;
+	u32 hdr;
+
+	for (i = 0; i < argc; i++)
+		len += strlen(argv[i]) + 1;
+	if (len > DAEMON_ARGS_MAX || argc > DAEMON_ARGC_MAX)
+		return -E2BIG;
+	args = malloc(len);
+	if (!args)
+		return -ENOMEM;
+	for (p = args, i = 0; i < argc; i++)
+		p = stpcpy(p, argv[i]) + 1;
+
+	hdr = len;
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = args;
+	iov[1].iov_len = len;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	rc = sendmsg(fd, &msg, MSG_NOSIGNAL);
+	free(args);
+	if (rc < 0)
+		return -errno;
+	return rc == (int) (sizeof(hdr) + len) ? 0 : -EIO;
+}
+
+/**
+ * main_handle_daemon_command - run a read-only command through the daemon
+ * @argc: arguments left after the program's own options
+ * @argv: the command and its arguments
+ * @prog: which program is asking
+ *
+ * Returns if the command is not one the daemon serves, help was asked
+ * for, or no daemon is listening, and the caller runs the command
+ * itself. Otherwise exits with the command's status.
+ */
+void main_handle_daemon_command(int argc, const char **argv,
+		enum program prog)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	const char *path = util_daemon_socket(prog);
+	int fd, i, status;
+	ssize_t rc;
+
+	if (!path || argc < 1 || !is_served(argv[0]))
+		return;
+	for (i = 1; i < argc; i++)
+		if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0
+				|| strcmp(argv[i], "--list-opts") == 0)
+			return;
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return;
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return;
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+			|| send_request(fd, argc, argv) < 0) {
+		/* not running, or gone: do it the slow way */
+		close(fd);
+		return;
+	}
+
+	/* only the child writes to our stdout from here on */
+	do {
+		rc = recv(fd, &status, sizeof(status), MSG_WAITALL);
+	} while (rc < 0 && errno == EINTR);
+	close(fd);
+	if (rc != sizeof(status)) {
+		fprintf(stderr, "%s: daemon at %s failed the request\n",
+				argv[0], path);
+		exit(1);
+	}
+	exit(status);
+}
+
+static unsigned long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static int listen_socket(struct util_daemon *d)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	mode_t mask;
+	int fd, rc;
+
+	if (strlen(d->socket) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strcpy(addr.sun_path, d->socket);
+	if (strncmp(d->socket, UTIL_DAEMON_DIR "/", strlen(UTIL_DAEMON_DIR) + 1) == 0)
+		mkdir(UTIL_DAEMON_DIR, 0755);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -errno;
+	/* a daemon that died leaves its socket behind */
+	unlink(d->socket);
+	mask = umask(0177);
+	rc = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+	umask(mask);
+	if (rc == 0)
+		rc = listen(fd, 64);
+	if (rc < 0) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+	return fd;
+}
+
+/* close every descriptor a rejected message carried */
+static void close_cmsg_fds(struct msghdr *msg)
+{
+	struct cmsghdr *cmsg;
+	size_t i, nr;
+	int cfd;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET
+				|| cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		nr = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < nr; i++) {
+			memcpy(&cfd, CMSG_DATA(cmsg) + i * sizeof(int),
+					sizeof(cfd));
+			close(cfd);
+		}
+	}
+}
+
+static int recv_request(int fd, char *args, int *fds)
+{
+	char cbuf[CMSG_SPACE(2 * sizeof(int))];
+	struct iovec iov;
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = cbuf,
+		.msg_controllen = sizeof(cbuf),
+	};
+	struct cmsghdr *cmsg;
+	ssize_t rc;
+	u32 len;
+
+	iov.iov_base = &len;
+	iov.iov_len = sizeof(len);
+	rc = recvmsg(fd, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+	if (rc < 0)
+		return -EIO;
+	if (rc != sizeof(len)) {
+		close_cmsg_fds(&msg);
+		return -EIO;
+	}
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET
+			|| cmsg->cmsg_type != SCM_RIGHTS
+			|| cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int))
+			|| CMSG_NXTHDR(&msg, cmsg)) {
+		close_cmsg_fds(&msg);
+		return -EBADMSG;
+	}
+	memcpy(fds, CMSG_DATA(cmsg), 2 * sizeof(int));
+	if (!len || len > DAEMON_ARGS_MAX)
+		return -E2BIG;
+	if (recv(fd, args, len, MSG_WAITALL) != (ssize_t) len)
+		return -EIO;
+	if (args[len - 1] != '\0')
+		return -EBADMSG;
+	return len;
+}
+
+static bool peer_allowed(int fd)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0)
+		return false;
+	return cred.uid == 0 || cred.uid == geteuid();
+}
+
+static void __attribute__((noreturn)) run_request(struct util_daemon *d,
+		int conn, char *args, int len, int *fds)
+{
+	const char *argv[DAEMON_ARGC_MAX + 1];
+	int argc = 0, status = 1, i;
+	char *p;
+
+	for (p = args; p < args + len && argc < DAEMON_ARGC_MAX;
+			p += strlen(p) + 1)
+		argv[argc++] = p;
+	argv[argc] = NULL;
+
+	if (dup2(fds[0], STDOUT_FILENO) < 0 || dup2(fds[1], STDERR_FILENO) < 0)
+		_exit(1);
+	close(fds[0]);
+	close(fds[1]);
+
+	for (i = 0; i < d->num_cmds; i++) {
+		struct cmd_struct *c = &d->cmds[i];
+
+		if (strcmp(c->cmd, argv[0]) || !is_served(argv[0]))
+			continue;
+		if (d->prog == PROG_NDCTL)
+			status = c->n_fn(argc, argv, d->ctx);
+		else if (d->prog == PROG_DAXCTL)
+			status = c->d_fn(argc, argv, d->ctx);
+		else
+			status = c->c_fn(argc, argv, d->ctx);
+		break;
+	}
+	if (i >= d->num_cmds)
+		fprintf(stderr, "%s: not served by the daemon\n", argv[0]);
+	fflush(stdout);
+	fflush(stderr);
+
+	status &= 0xff;
+	if (send(conn, &status, sizeof(status), MSG_NOSIGNAL) < 0)
+		_exit(1);
+	_exit(0);
+}
+
+/**
+ * util_daemon_start - set up logging and detach, ahead of serving
+ * @d: the daemon, @d->socket is defaulted here when unset
+ * @owner: log prefix, e.g. "ndctl/daemon"
+ * @log: "syslog", "standard" or a file to append to, NULL for the default
+ * @prefix: directory @log is relative to
+ * @background: detach, and log to syslog unless @log names a file
+ * @verbose: log each query
+ */
+int util_daemon_start(struct util_daemon *d, const char *owner,
+		const char *log, const char *prefix, bool background,
+		bool verbose)
+{
+	int rc;
+
+	if (!d->socket)
+		d->socket = util_daemon_socket(d->prog);
+	if (!d->socket)
+		return -EINVAL;
+
+	log_init(&d->log, owner, "NDCTL_DAEMON_LOG");
+	d->log.log_fn = util_monitor_log_standard;
+	d->log.log_priority = verbose ? LOG_DEBUG : LOG_INFO;
+	if (log) {
+		rc = util_monitor_set_log(&d->log, &log, prefix);
+		if (rc)
+			return rc;
+	}
+
+	if (background) {
+		if (!log || strncmp(log, "./", 2) == 0)
+			d->log.log_fn = util_monitor_log_syslog;
+		if (daemon(0, 0) != 0) {
+			log_err(&d->log, "daemon start failed\n");
+			return -errno;
+		}
+	}
+	return 0;
+}
+
+/**
+ * util_daemon_serve - answer queries until a fatal error
+ * @d: the program's context, socket and hooks
+ *
+ * Topology changes only mark the context stale, it is re-created on
+ * the next query, so a burst of uevents costs one re-enumeration.
+ */
+int util_daemon_serve(struct util_daemon *d)
+{
+	unsigned long long warmed = 0;
+	struct pollfd pfd[2];
+	bool stale = false;
+	int lfd, ufd, rc;
+	char *args;
+
+	args = malloc(DAEMON_ARGS_MAX);
+	if (!args)
+		return -ENOMEM;
+
+	lfd = listen_socket(d);
+	if (lfd < 0) {
+		log_err(&d->log, "%s: %s\n", d->socket, strerror(-lfd));
+		free(args);
+		return lfd;
+	}
+	ufd = util_uevent_open();
+	if (ufd < 0)
+		log_err(&d->log, "no uevents (%s), topology changes are not seen\n",
+				strerror(-ufd));
+
+	/* children report to their clients, nobody waits for them */
+	signal(SIGCHLD, SIG_IGN);
+	if (d->warm) {
+		d->warm(d);
+		warmed = now_ms();
+	}
+	log_info(&d->log, "serving queries on %s\n", d->socket);
+
+	pfd[0].fd = lfd;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = ufd;
+	pfd[1].events = POLLIN;
+	for (;;) {
+		struct timeval tv = { .tv_sec = 1 };
+		int conn, fds[2], len;
+		pid_t pid;
+
+		rc = poll(pfd, ufd < 0 ? 1 : 2, -1);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			rc = -errno;
+			log_err(&d->log, "poll: %s\n", strerror(errno));
+			break;
+		}
+		if (ufd >= 0 && (pfd[1].revents & POLLIN)
+				&& util_uevent_match(ufd, d->subsystems)) {
+			log_dbg(&d->log, "topology changed\n");
+			stale = true;
+		}
+		if (!(pfd[0].revents & POLLIN))
+			continue;
+
+		conn = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+		if (conn < 0)
+			continue;
+		if (!peer_allowed(conn)) {
+			log_info(&d->log, "refused a query from another user\n");
+			close(conn);
+			continue;
+		}
+		/* a client that never sends holds up nobody for long */
+		setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		fds[0] = fds[1] = -1;
+		len = recv_request(conn, args, fds);
+		if (len < 0) {
+			log_dbg(&d->log, "bad request: %s\n", strerror(-len));
+			if (fds[0] >= 0) {
+				close(fds[0]);
+				close(fds[1]);
+			}
+			close(conn);
+			continue;
+		}
+
+		if (stale) {
+			void *ctx = d->refresh(d);
+
+			if (ctx) {
+				d->ctx = ctx;
+				warmed = 0;
+			}
+			stale = !ctx;
+		}
+		if (d->warm && (!warmed || (d->ttl_ms
+				&& now_ms() - warmed >= d->ttl_ms))) {
+			d->warm(d);
+			warmed = now_ms();
+		}
+
+		log_dbg(&d->log, "%s\n", args);
+		/* nothing of ours may reach the client through the child */
+		fflush(stdout);
+		fflush(stderr);
+		pid = fork();
+		if (pid == 0) {
+			close(lfd);
+			if (ufd >= 0)
+				close(ufd);
+			run_request(d, conn, args, len, fds);
+		}
+		if (pid < 0)
+			log_err(&d->log, "fork: %s\n", strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		close(conn);
+	}
+
+	close(lfd);
+	if (ufd >= 0)
+		close(ufd);
+	unlink(d->socket);
+	free(args);
+	util_monitor_close_log();
+	return rc;
+}
@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UTIL_DAEMON_H_
+#define _UTIL_DAEMON_H_
+#include <stdbool.h>
+#include <util/log.h>
+#include <util/main.h>
+
+/*
+ * Resident query service behind 'ndctl daemon', 'daxctl daemon' and
+ * 'cxl daemon'. The daemon holds an enumerated library context, and
+ * re-creates it when a uevent reports a change in one of @subsystems.
+ * A client hands over its command line and its stdout and stderr, and
+ * the command runs in a child forked from the warm context. Only
+ * read-only commands, see main_handle_daemon_command(), are served.
+ */
+struct util_daemon {
+	enum program prog;
+	const char *socket;
+	const char * const *subsystems;
+	/* how long a warm() stays valid, 0 to only warm after a refresh */
+	unsigned int ttl_ms;
+	void *ctx;
+	/* replace @ctx with a fresh context after a topology change */
+	void *(*refresh)(struct util_daemon *d);
+	/* read ahead what queries will need, e.g. fill the health cache */
+	void (*warm)(struct util_daemon *d);
+	struct cmd_struct *cmds;
+	int num_cmds;
+	struct log_ctx log;
+};
+
+#define UTIL_DAEMON_DIR "/run/ndctl"
+
+const char *util_daemon_socket(enum program prog);
+int util_daemon_start(struct util_daemon *d, const char *owner,
+		const char *log, const char *prefix, bool background,
+		bool verbose);
+int util_daemon_serve(struct util_daemon *d);
+void main_handle_daemon_command(int argc, const char **argv,
+		enum program prog);
+#endif /* _UTIL_DAEMON_H_ */
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0
 // Copyright (C) 2015-2020 Intel Corporation. All rights reserved.
 #include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -14,263 +16,394 @@
 #include <daxctl/libdaxctl.h>
 #include <cxl/libcxl.h>
 
-struct ndctl_bus *util_bus_filter(struct ndctl_bus *bus, const char *__ident)
+/*
+ * A filter string is a space separated list of identifiers, or "all".
+ * It is compiled once into terms: identifiers that resolve to a device
+ * id become id terms, so matching is integer compares, and anything
+ * else is a name term carrying its hash so most mismatches skip
+ * strcmp(). util_filter_walk() compiles each of its parameters up front
+ * rather than re-parsing them for every object it visits.
+ */
+enum filter_kind {
+	FILTER_BUS,
+	FILTER_REGION,
+	FILTER_DIMM,
+	FILTER_NAMESPACE,
+};
+
+struct filter_term {
+	const char *name;
+	unsigned long hash;
+	unsigned long id;
+	/* namespace id, for a FILTER_NAMESPACE id term */
+	unsigned long sub;
+};
+
+struct filter_match {
+	bool all;
+	int nr;
+	struct filter_term *terms;
+	char *buf;
+};
+
+static unsigned long filter_hash(const char *name)
 {
-	char *end = NULL, *ident, *save;
-	unsigned long bus_id, id;
-	const char *provider, *devname, *name;
-
-	if (!__ident)
-		return bus;
-
-	ident = strdup(__ident);
-	if (!ident)
-		return NULL;
-
-	for (name = strtok_r(ident, " ", &save); name;
-			name = strtok_r(NULL, " ", &save)) {
-		if (strcmp(name, "all") == 0)
-			break;
-
-		bus_id = strtoul(ident, &end, 0);
-		if (end == ident || end[0])
-			bus_id = ULONG_MAX;
+	unsigned long hash = 5381;
 
-		provider = ndctl_bus_get_provider(bus);
-		devname = ndctl_bus_get_devname(bus);
-		id = ndctl_bus_get_id(bus);
+	while (*name)
+		hash = hash * 33 + (unsigned char) *name++;
+	return hash;
+}
 
-		if (bus_id < ULONG_MAX && bus_id == id)
-			break;
+static bool filter_parse_id(const char *name, const char *prefix,
+		unsigned long *id)
+{
+	size_t len = prefix ? strlen(prefix) : 0;
+	char *end;
+
+	if (len && strncmp(name, prefix, len) != 0)
+		return false;
+	name += len;
+	if (!isdigit((unsigned char) name[0]))
+		return false;
+	/* bare numbers may be hex, as strtoul(, 0) always accepted */
+	*id = strtoul(name, &end, len ? 10 : 0);
+	return end[0] == '\0';
+}
 
-		if (bus_id == ULONG_MAX && (strcmp(provider, name) == 0
-				|| strcmp(devname, name) == 0))
-			break;
+static bool filter_parse_term(struct filter_term *t, const char *name,
+		enum filter_kind kind)
+{
+	switch (kind) {
+	case FILTER_BUS:
+		/* providers are names, so only bare numbers are ids */
+		return filter_parse_id(name, NULL, &t->id);
+	case FILTER_REGION:
+		return filter_parse_id(name, NULL, &t->id)
+			|| filter_parse_id(name, "region", &t->id);
+	case FILTER_DIMM:
+		return filter_parse_id(name, NULL, &t->id)
+			|| filter_parse_id(name, "nmem", &t->id);
+	case FILTER_NAMESPACE:
+		return sscanf(name, "%lu.%lu", &t->id, &t->sub) == 2
+			|| sscanf(name, "namespace%lu.%lu", &t->id,
+					&t->sub) == 2;
 	}
-	free(ident);
-
-	if (name)
-		return bus;
-	return NULL;
+	return false;
 }
 
-struct ndctl_region *util_region_filter(struct ndctl_region *region,
-		const char *__ident)
+static int filter_compile(struct filter_match *m, const char *ident,
+		enum filter_kind kind)
 {
-	char *end = NULL, *ident, *save;
-	const char *name, *region_name;
-	unsigned long region_id, id;
+	char *name, *save;
+	int nr = 1;
 
-	if (!__ident)
-		return region;
+	memset(m, 0, sizeof(*m));
+	if (!ident) {
+		m->all = true;
+		return 0;
+	}
 
-	ident = strdup(__ident);
-	if (!ident)
-		return NULL;
+	m->buf = strdup(ident);
+	for (name = m->buf; name && *name; name++)
+		nr += *name == ' ';
+	m->terms = calloc(nr, sizeof(*m->terms));
+	if (!m->buf || !m->terms) {
+		free(m->buf);
+		free(m->terms);
+		m->buf = NULL;
+		m->terms = NULL;
+		return -ENOMEM;
+	}
 
-	for (name = strtok_r(ident, " ", &save); name;
+	for (name = strtok_r(m->buf, " ", &save); name;
 			name = strtok_r(NULL, " ", &save)) {
-		if (strcmp(name, "all") == 0)
-			break;
-
-		region_id = strtoul(ident, &end, 0);
-		if (end == ident || end[0])
-			region_id = ULONG_MAX;
-
-		region_name = ndctl_region_get_devname(region);
-		id = ndctl_region_get_id(region);
-
-		if (region_id < ULONG_MAX && region_id == id)
-			break;
+		struct filter_term *t = &m->terms[m->nr++];
 
-		if (region_id == ULONG_MAX && strcmp(region_name, name) == 0)
+		if (strcmp(name, "all") == 0) {
+			m->all = true;
 			break;
+		}
+		if (filter_parse_term(t, name, kind))
+			continue;
+		t->name = name;
+		t->hash = filter_hash(name);
 	}
-	free(ident);
+	return 0;
+}
 
-	if (name)
-		return region;
-	return NULL;
+static void filter_release(struct filter_match *m)
+{
+	free(m->terms);
+	free(m->buf);
 }
 
-struct ndctl_namespace *util_namespace_filter(struct ndctl_namespace *ndns,
-		const char *__ident)
+static bool filter_match_id(struct filter_match *m, unsigned long id)
 {
-	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
-	unsigned long region_id, ndns_id;
-	const char *name;
-	char *ident, *save;
+	int i;
 
-	if (!__ident)
-		return ndns;
+	for (i = 0; i < m->nr; i++)
+		if (!m->terms[i].name && m->terms[i].id == id)
+			return true;
+	return false;
+}
 
-	ident = strdup(__ident);
-	if (!ident)
-		return NULL;
+static bool filter_match_name(struct filter_match *m, const char *name)
+{
+	unsigned long hash;
+	int i;
+
+	if (!name)
+		return false;
+	hash = filter_hash(name);
+	for (i = 0; i < m->nr; i++)
+		if (m->terms[i].name && m->terms[i].hash == hash
+				&& strcmp(m->terms[i].name, name) == 0)
+			return true;
+	return false;
+}
 
-	for (name = strtok_r(ident, " ", &save); name;
-			name = strtok_r(NULL, " ", &save)) {
-		if (strcmp(name, "all") == 0)
-			break;
+static bool filter_match_bus(struct filter_match *m, struct ndctl_bus *bus)
+{
+	return m->all || filter_match_id(m, ndctl_bus_get_id(bus))
+		|| filter_match_name(m, ndctl_bus_get_provider(bus))
+		|| filter_match_name(m, ndctl_bus_get_devname(bus));
+}
 
-		if (strcmp(name, ndctl_namespace_get_devname(ndns)) == 0)
-			break;
+static bool filter_match_region(struct filter_match *m,
+		struct ndctl_region *region)
+{
+	return m->all || filter_match_id(m, ndctl_region_get_id(region))
+		|| filter_match_name(m, ndctl_region_get_devname(region));
+}
 
-		if (sscanf(name, "%ld.%ld", &region_id, &ndns_id) == 2
-				&& ndctl_region_get_id(region) == region_id
-				&& ndctl_namespace_get_id(ndns) == ndns_id)
-			break;
-	}
-	free(ident);
+static bool filter_match_dimm(struct filter_match *m, struct ndctl_dimm *dimm)
+{
+	return m->all || filter_match_id(m, ndctl_dimm_get_id(dimm))
+		|| filter_match_name(m, ndctl_dimm_get_devname(dimm));
+}
 
-	if (name)
-		return ndns;
-	return NULL;
+/*
+ * Whether any namespace of @region could match. Only this looks at the
+ * region id, so namespaces of other regions are never enumerated.
+ */
+static bool filter_match_ns_region(struct filter_match *m,
+		struct ndctl_region *region)
+{
+	unsigned long id = ndctl_region_get_id(region);
+	int i;
+
+	if (m->all)
+		return true;
+	for (i = 0; i < m->nr; i++)
+		if (m->terms[i].name || m->terms[i].id == id)
+			return true;
+	return false;
 }
 
-struct ndctl_dimm *util_dimm_filter(struct ndctl_dimm *dimm,
-		const char *__ident)
+static bool filter_match_namespace(struct filter_match *m,
+		struct ndctl_namespace *ndns)
 {
-	char *end = NULL, *ident, *save;
-	const char *name, *dimm_name;
-	unsigned long dimm_id, id;
+	struct ndctl_region *region = ndctl_namespace_get_region(ndns);
+	unsigned long region_id = ndctl_region_get_id(region);
+	unsigned long id = ndctl_namespace_get_id(ndns);
+	int i;
+
+	if (m->all)
+		return true;
+	for (i = 0; i < m->nr; i++)
+		if (!m->terms[i].name && m->terms[i].id == region_id
+				&& m->terms[i].sub == id)
+			return true;
+	return filter_match_name(m, ndctl_namespace_get_devname(ndns));
+}
 
-	if (!__ident)
-		return dimm;
+static bool filter_region_has_namespace(struct filter_match *m,
+		struct ndctl_region *region)
+{
+	struct ndctl_namespace *ndns;
 
-	ident = strdup(__ident);
-	if (!ident)
-		return NULL;
+	if (m->all)
+		return true;
+	if (!filter_match_ns_region(m, region))
+		return false;
+	ndctl_namespace_foreach(region, ndns)
+		if (filter_match_namespace(m, ndns))
+			return true;
+	return false;
+}
 
-	for (name = strtok_r(ident, " ", &save); name;
-			name = strtok_r(NULL, " ", &save)) {
-		if (strcmp(name, "all") == 0)
-			break;
+static bool filter_region_has_dimm(struct filter_match *m,
+		struct ndctl_region *region)
+{
+	struct ndctl_dimm *dimm;
 
-		dimm_id = strtoul(ident, &end, 0);
-		if (end == ident || end[0])
-			dimm_id = ULONG_MAX;
+	if (m->all)
+		return true;
+	ndctl_dimm_foreach_in_region(region, dimm)
+		if (filter_match_dimm(m, dimm))
+			return true;
+	return false;
+}
 
-		dimm_name = ndctl_dimm_get_devname(dimm);
-		id = ndctl_dimm_get_id(dimm);
+static bool filter_region_contains(struct ndctl_region *region,
+		struct ndctl_dimm *dimm)
+{
+	struct ndctl_dimm *check;
 
-		if (dimm_id < ULONG_MAX && dimm_id == id)
-			break;
+	ndctl_dimm_foreach_in_region(region, check)
+		if (check == dimm)
+			return true;
+	return false;
+}
 
-		if (dimm_id == ULONG_MAX && strcmp(dimm_name, name) == 0)
-			break;
-	}
-	free(ident);
+struct ndctl_bus *util_bus_filter(struct ndctl_bus *bus, const char *ident)
+{
+	struct filter_match m;
+	bool match;
 
-	if (name)
-		return dimm;
-	return NULL;
+	if (filter_compile(&m, ident, FILTER_BUS))
+		return NULL;
+	match = filter_match_bus(&m, bus);
+	filter_release(&m);
+	return match ? bus : NULL;
 }
 
-struct ndctl_bus *util_bus_filter_by_dimm(struct ndctl_bus *bus,
+struct ndctl_region *util_region_filter(struct ndctl_region *region,
 		const char *ident)
 {
-	struct ndctl_dimm *dimm;
-
-	if (!ident || strcmp(ident, "all") == 0)
-		return bus;
+	struct filter_match m;
+	bool match;
 
-	ndctl_dimm_foreach(bus, dimm)
-		if (util_dimm_filter(dimm, ident))
-			return bus;
-	return NULL;
+	if (filter_compile(&m, ident, FILTER_REGION))
+		return NULL;
+	match = filter_match_region(&m, region);
+	filter_release(&m);
+	return match ? region : NULL;
 }
 
-struct ndctl_bus *util_bus_filter_by_region(struct ndctl_bus *bus,
+struct ndctl_namespace *util_namespace_filter(struct ndctl_namespace *ndns,
 		const char *ident)
 {
-	struct ndctl_region *region;
+	struct filter_match m;
+	bool match;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return bus;
-
-	ndctl_region_foreach(bus, region)
-		if (util_region_filter(region, ident))
-			return bus;
-	return NULL;
+	if (filter_compile(&m, ident, FILTER_NAMESPACE))
+		return NULL;
+	match = filter_match_namespace(&m, ndns);
+	filter_release(&m);
+	return match ? ndns : NULL;
 }
 
-struct ndctl_bus *util_bus_filter_by_namespace(struct ndctl_bus *bus,
+struct ndctl_dimm *util_dimm_filter(struct ndctl_dimm *dimm,
 		const char *ident)
 {
-	struct ndctl_region *region;
-	struct ndctl_namespace *ndns;
-
-	if (!ident || strcmp(ident, "all") == 0)
-		return bus;
+	struct filter_match m;
+	bool match;
 
-	ndctl_region_foreach(bus, region)
-		ndctl_namespace_foreach(region, ndns)
-			if (util_namespace_filter(ndns, ident))
-				return bus;
-	return NULL;
+	if (filter_compile(&m, ident, FILTER_DIMM))
+		return NULL;
+	match = filter_match_dimm(&m, dimm);
+	filter_release(&m);
+	return match ? dimm : NULL;
 }
 
-struct ndctl_region *util_region_filter_by_dimm(struct ndctl_region *region,
-		const char *ident)
+static bool filter_bus_has_dimm(struct filter_match *m, struct ndctl_bus *bus)
 {
 	struct ndctl_dimm *dimm;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return region;
+	if (m->all)
+		return true;
+	ndctl_dimm_foreach(bus, dimm)
+		if (filter_match_dimm(m, dimm))
+			return true;
+	return false;
+}
 
-	ndctl_dimm_foreach_in_region(region, dimm)
-		if (util_dimm_filter(dimm, ident))
-			return region;
+static bool filter_bus_has_region(struct filter_match *m,
+		struct ndctl_bus *bus)
+{
+	struct ndctl_region *region;
 
-	return NULL;
+	if (m->all)
+		return true;
+	ndctl_region_foreach(bus, region)
+		if (filter_match_region(m, region))
+			return true;
+	return false;
 }
 
-struct ndctl_dimm *util_dimm_filter_by_region(struct ndctl_dimm *dimm,
-		const char *ident)
+static bool filter_bus_has_namespace(struct filter_match *m,
+		struct ndctl_bus *bus)
 {
-	struct ndctl_bus *bus = ndctl_dimm_get_bus(dimm);
 	struct ndctl_region *region;
-	struct ndctl_dimm *check;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return dimm;
+	if (m->all)
+		return true;
+	ndctl_region_foreach(bus, region)
+		if (filter_region_has_namespace(m, region))
+			return true;
+	return false;
+}
 
-	ndctl_region_foreach(bus, region) {
-		if (!util_region_filter(region, ident))
-			continue;
-		ndctl_dimm_foreach_in_region(region, check)
-			if (check == dimm)
-				return dimm;
-	}
+static bool filter_dimm_in_region(struct filter_match *m,
+		struct ndctl_dimm *dimm)
+{
+	struct ndctl_region *region;
 
-	return NULL;
+	if (m->all)
+		return true;
+	ndctl_region_foreach(ndctl_dimm_get_bus(dimm), region)
+		if (filter_match_region(m, region)
+				&& filter_region_contains(region, dimm))
+			return true;
+	return false;
 }
 
-struct ndctl_dimm *util_dimm_filter_by_namespace(struct ndctl_dimm *dimm,
-		const char *ident)
+static bool filter_dimm_in_namespace(struct filter_match *m,
+		struct ndctl_dimm *dimm)
 {
-	struct ndctl_bus *bus = ndctl_dimm_get_bus(dimm);
-	struct ndctl_namespace *ndns;
 	struct ndctl_region *region;
-	struct ndctl_dimm *check;
 
-	if (!ident || strcmp(ident, "all") == 0)
-		return dimm;
-
-	ndctl_region_foreach(bus, region) {
-		ndctl_namespace_foreach(region, ndns) {
-			if (!util_namespace_filter(ndns, ident))
-				continue;
-			ndctl_dimm_foreach_in_region(region, check)
-				if (check == dimm)
-					return dimm;
-		}
-	}
+	if (m->all)
+		return true;
+	ndctl_region_foreach(ndctl_dimm_get_bus(dimm), region)
+		if (filter_region_contains(region, dimm)
+				&& filter_region_has_namespace(m, region))
+			return true;
+	return false;
+}
 
-	return NULL;
+#define DEFINE_FILTER_BY(type, name, kind, test) \
+type *name(type *obj, const char *ident) \
+{ \
+	struct filter_match m; \
+	bool match; \
+	\
+	if (!ident || strcmp(ident, "all") == 0) \
+		return obj; \
+	if (filter_compile(&m, ident, kind)) \
+		return NULL; \
+	match = test(&m, obj); \
+	filter_release(&m); \
+	return match ? obj : NULL; \
 }
 
+DEFINE_FILTER_BY(struct ndctl_bus, util_bus_filter_by_dimm, FILTER_DIMM,
+		filter_bus_has_dimm)
+DEFINE_FILTER_BY(struct ndctl_bus, util_bus_filter_by_region, FILTER_REGION,
+		filter_bus_has_region)
+DEFINE_FILTER_BY(struct ndctl_bus, util_bus_filter_by_namespace,
+		FILTER_NAMESPACE, filter_bus_has_namespace)
+DEFINE_FILTER_BY(struct ndctl_region, util_region_filter_by_dimm,
+		FILTER_DIMM, filter_region_has_dimm)
+DEFINE_FILTER_BY(struct ndctl_dimm, util_dimm_filter_by_region,
+		FILTER_REGION, filter_dimm_in_region)
+DEFINE_FILTER_BY(struct ndctl_dimm, util_dimm_filter_by_namespace,
+		FILTER_NAMESPACE, filter_dimm_in_namespace)
+DEFINE_FILTER_BY(struct ndctl_region, util_region_filter_by_namespace,
+		FILTER_NAMESPACE, filter_region_has_namespace)
+
 struct ndctl_dimm *util_dimm_filter_by_numa_node(struct ndctl_dimm *dimm,
 		int numa_node)
 {
@@ -290,20 +423,6 @@ struct ndctl_dimm *util_dimm_filter_by_numa_node(struct ndctl_dimm *dimm,
 	return NULL;
 }
 
-struct ndctl_region *util_region_filter_by_namespace(struct ndctl_region *region,
-		const char *ident)
-{
-	struct ndctl_namespace *ndns;
-
-	if (!ident || strcmp(ident, "all") == 0)
-		return region;
-
-	ndctl_namespace_foreach(region, ndns)
-		if (util_namespace_filter(ndns, ident))
-			return region;
-	return NULL;
-}
-
 struct daxctl_dev *util_daxctl_dev_filter(struct daxctl_dev *dev,
 		const char *ident)
 {
@@ -397,10 +516,13 @@ const char *util_nsmode_name(enum ndctl_namespace_mode mode)
 int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 		struct util_filter_params *param)
 {
+	struct filter_match fbus = { 0 }, fregion = { 0 }, fdimm = { 0 };
+	struct filter_match fns = { 0 };
 	struct ndctl_bus *bus;
 	unsigned int type = 0;
 	int numa_node = NUMA_NO_NODE;
 	char *end = NULL;
+	int rc = 0;
 
 	if (param->type && (strcmp(param->type, "pmem") != 0
 				&& strcmp(param->type, "blk") != 0)) {
@@ -436,14 +558,23 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 		}
 	}
 
+	if (filter_compile(&fbus, param->bus, FILTER_BUS)
+			|| filter_compile(&fregion, param->region, FILTER_REGION)
+			|| filter_compile(&fdimm, param->dimm, FILTER_DIMM)
+			|| filter_compile(&fns, param->namespace,
+				FILTER_NAMESPACE)) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
 	ndctl_bus_foreach(ctx, bus) {
 		struct ndctl_region *region;
 		struct ndctl_dimm *dimm;
 
-		if (!util_bus_filter(bus, param->bus)
-				|| !util_bus_filter_by_dimm(bus, param->dimm)
-				|| !util_bus_filter_by_region(bus, param->region)
-				|| !util_bus_filter_by_namespace(bus, param->namespace))
+		if (!filter_match_bus(&fbus, bus)
+				|| !filter_bus_has_dimm(&fdimm, bus)
+				|| !filter_bus_has_region(&fregion, bus)
+				|| !filter_bus_has_namespace(&fns, bus))
 			continue;
 
 		if (!fctx->filter_bus(bus, fctx))
@@ -453,11 +584,9 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 			if (!fctx->filter_dimm)
 				break;
 
-			if (!util_dimm_filter(dimm, param->dimm)
-					|| !util_dimm_filter_by_region(dimm,
-						param->region)
-					|| !util_dimm_filter_by_namespace(dimm,
-						param->namespace)
+			if (!filter_match_dimm(&fdimm, dimm)
+					|| !filter_dimm_in_region(&fregion, dimm)
+					|| !filter_dimm_in_namespace(&fns, dimm)
 					|| !util_dimm_filter_by_numa_node(dimm,
 						numa_node))
 				continue;
@@ -468,11 +597,9 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 		ndctl_region_foreach(bus, region) {
 			struct ndctl_namespace *ndns;
 
-			if (!util_region_filter(region, param->region)
-					|| !util_region_filter_by_dimm(region,
-						param->dimm)
-					|| !util_region_filter_by_namespace(region,
-						param->namespace))
+			if (!filter_match_region(&fregion, region)
+					|| !filter_region_has_dimm(&fdimm, region)
+					|| !filter_region_has_namespace(&fns, region))
 				continue;
 
 			/*
@@ -500,12 +627,15 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 			if (!fctx->filter_region(region, fctx))
 				continue;
 
+			/* don't populate namespaces that can't be reported */
+			if (!fctx->filter_namespace
+					|| !filter_match_ns_region(&fns, region))
+				continue;
+
 			ndctl_namespace_foreach(region, ndns) {
 				enum ndctl_namespace_mode mode;
 
-				if (!fctx->filter_namespace)
-					break;
-				if (!util_namespace_filter(ndns, param->namespace))
+				if (!filter_match_namespace(&fns, ndns))
 					continue;
 
 				mode = ndctl_namespace_get_mode(ndns);
@@ -520,5 +650,10 @@ int util_filter_walk(struct ndctl_ctx *ctx, struct util_filter_ctx *fctx,
 			}
 		}
 	}
-	return 0;
+ out:
+	filter_release(&fns);
+	filter_release(&fdimm);
+	filter_release(&fregion);
+	filter_release(&fbus);
+	return rc;
 }
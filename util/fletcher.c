@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <util/fletcher.h>
+#include <ccan/array_size/array_size.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/*
+ * The serial dependency in the reference loop is lo32 feeding hi32 one
+ * word at a time. The vector versions take a block of words at once:
+ * an in-register prefix sum of the block plus the lo32 carried in from
+ * the previous block gives every running lo32, exactly, since lo32 is
+ * only ever a sum modulo 2^32. The block total comes from the prefix
+ * sum before the carry is added, so the critical path is one vector add
+ * per block. Each lane is then widened into 64-bit hi32 accumulators
+ * that no later block reads.
+ *
+ * Only little-endian data on little-endian hosts, or host-order data
+ * (@le == false), is vectorized. Anything else takes the generic loop.
+ */
+static u64 fletcher64_tail(const u32 *buf, size_t nr, u32 lo32, u64 hi32)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++) {
+		lo32 += buf[i];
+		hi32 += lo32;
+	}
+
+	return hi32 << 32 | lo32;
+}
+
+static bool can_vectorize(bool le)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return true;
+#else
+	return !le;
+#endif
+}
+
+static bool generic_supported(void)
+{
+	return true;
+}
+
+#if defined(__x86_64__)
+static bool sse2_supported(void)
+{
+	/* part of the x86-64 baseline */
+	return true;
+}
+
+static u64 fletcher64_sse2(const void *addr, size_t len, bool le)
+{
+	const u32 *buf = addr;
+	size_t i, nr = len / sizeof(u32);
+	__m128i lo = _mm_setzero_si128(), zero = _mm_setzero_si128();
+	__m128i hi_a = _mm_setzero_si128(), hi_b = _mm_setzero_si128();
+	u64 hi[2];
+
+	if (!can_vectorize(le))
+		return fletcher64_generic(addr, len, le);
+
+	for (i = 0; i + 4 <= nr; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *) &buf[i]), t;
+
+		v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+		v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+		t = _mm_shuffle_epi32(v, 0xff);
+		v = _mm_add_epi32(v, lo);
+		lo = _mm_add_epi32(lo, t);
+		hi_a = _mm_add_epi64(hi_a, _mm_unpacklo_epi32(v, zero));
+		hi_b = _mm_add_epi64(hi_b, _mm_unpackhi_epi32(v, zero));
+	}
+
+	_mm_storeu_si128((__m128i *) hi, _mm_add_epi64(hi_a, hi_b));
+	return fletcher64_tail(&buf[i], nr - i, _mm_cvtsi128_si32(lo),
+			hi[0] + hi[1]);
+}
+
+static bool avx2_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+static u64 fletcher64_avx2(const void *addr, size_t len, bool le)
+{
+	const u32 *buf = addr;
+	size_t i, nr = len / sizeof(u32);
+	const __m256i last = _mm256_set1_epi32(7);
+	__m256i lo = _mm256_setzero_si256();
+	__m256i hi_a = _mm256_setzero_si256(), hi_b = _mm256_setzero_si256();
+	u64 hi[4];
+
+	if (!can_vectorize(le))
+		return fletcher64_generic(addr, len, le);
+
+	for (i = 0; i + 8 <= nr; i += 8) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) &buf[i]), c;
+
+		/* prefix within each 128-bit half, then carry low into high */
+		v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+		v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+		c = _mm256_shuffle_epi32(v, 0xff);
+		v = _mm256_add_epi32(v, _mm256_permute2x128_si256(c, c, 0x08));
+		c = _mm256_permutevar8x32_epi32(v, last);
+		v = _mm256_add_epi32(v, lo);
+		lo = _mm256_add_epi32(lo, c);
+		hi_a = _mm256_add_epi64(hi_a,
+				_mm256_cvtepu32_epi64(_mm256_castsi256_si128(v)));
+		hi_b = _mm256_add_epi64(hi_b,
+				_mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1)));
+	}
+
+	_mm256_storeu_si256((__m256i *) hi, _mm256_add_epi64(hi_a, hi_b));
+	return fletcher64_tail(&buf[i], nr - i,
+			_mm_cvtsi128_si32(_mm256_castsi256_si128(lo)),
+			hi[0] + hi[1] + hi[2] + hi[3]);
+}
+#elif defined(__aarch64__)
+static bool neon_supported(void)
+{
+	/* mandatory on aarch64 */
+	return true;
+}
+
+static u64 fletcher64_neon(const void *addr, size_t len, bool le)
+{
+	const u32 *buf = addr;
+	size_t i, nr = len / sizeof(u32);
+	const uint32x4_t zero = vdupq_n_u32(0);
+	uint32x4_t lo = zero;
+	uint64x2_t hi_a = vdupq_n_u64(0), hi_b = vdupq_n_u64(0);
+
+	if (!can_vectorize(le))
+		return fletcher64_generic(addr, len, le);
+
+	for (i = 0; i + 4 <= nr; i += 4) {
+		uint32x4_t v = vld1q_u32(&buf[i]), t;
+
+		v = vaddq_u32(v, vextq_u32(zero, v, 3));
+		v = vaddq_u32(v, vextq_u32(zero, v, 2));
+		t = vdupq_laneq_u32(v, 3);
+		v = vaddq_u32(v, lo);
+		lo = vaddq_u32(lo, t);
+		hi_a = vaddw_u32(hi_a, vget_low_u32(v));
+		hi_b = vaddw_high_u32(hi_b, v);
+	}
+
+	return fletcher64_tail(&buf[i], nr - i, vgetq_lane_u32(lo, 0),
+			vaddvq_u64(vaddq_u64(hi_a, hi_b)));
+}
+#endif
+
+/* in order of preference, best last */
+static const struct fletcher64_impl impls[] = {
+	{ "generic", generic_supported, fletcher64_generic },
+#if defined(__x86_64__)
+	{ "sse2", sse2_supported, fletcher64_sse2 },
+	{ "avx2", avx2_supported, fletcher64_avx2 },
+#elif defined(__aarch64__)
+	{ "neon", neon_supported, fletcher64_neon },
+#endif
+};
+
+const struct fletcher64_impl *fletcher64_get_impl(unsigned int idx)
+{
+	if (idx >= ARRAY_SIZE(impls))
+		return NULL;
+	return &impls[idx];
+}
+
+static u64 (*fletcher64_fn)(const void *addr, size_t len, bool le);
+
+u64 fletcher64(void *addr, size_t len, bool le)
+{
+	u64 (*fn)(const void *, size_t, bool);
+	unsigned int i;
+
+	fn = __atomic_load_n(&fletcher64_fn, __ATOMIC_RELAXED);
+	if (!fn) {
+		/* racing callers all settle on the same answer */
+		for (i = ARRAY_SIZE(impls); i--;)
+			if (impls[i].supported()) {
+				fn = impls[i].fn;
+				break;
+			}
+		__atomic_store_n(&fletcher64_fn, fn, __ATOMIC_RELAXED);
+	}
+
+	return fn(addr, len, le);
+}
@@ -1,16 +1,18 @@
 #ifndef _NDCTL_FLETCHER_H_
 #define _NDCTL_FLETCHER_H_
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <ccan/endian/endian.h>
 #include <ccan/short_types/short_types.h>
 
 /*
- * Note, fletcher64() is copied from drivers/nvdimm/label.c in the Linux kernel
+ * Note, fletcher64_generic() is copied from drivers/nvdimm/label.c in the
+ * Linux kernel
  */
-static inline u64 fletcher64(void *addr, size_t len, bool le)
+static inline u64 fletcher64_generic(const void *addr, size_t len, bool le)
 {
-	u32 *buf = addr;
+	const u32 *buf = addr;
 	u32 lo32 = 0;
 	u64 hi32 = 0;
 	size_t i;
@@ -23,4 +25,21 @@ static inline u64 fletcher64(void *addr, size_t len, bool le)
 	return hi32 << 32 | lo32;
 }
 
+/* bit-exact with fletcher64_generic(), using the best unit the cpu has */
+u64 fletcher64(void *addr, size_t len, bool le);
+
+/**
+ * struct fletcher64_impl - one implementation, for tests and benchmarks
+ * @name: instruction set it is written for
+ * @supported: whether the running cpu can execute it
+ * @fn: the checksum, same contract as fletcher64_generic()
+ */
+struct fletcher64_impl {
+	const char *name;
+	bool (*supported)(void);
+	u64 (*fn)(const void *addr, size_t len, bool le);
+};
+
+const struct fletcher64_impl *fletcher64_get_impl(unsigned int idx);
+
 #endif /* _NDCTL_FLETCHER_H_ */
@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <util/fwimage.h>
+#include <ccan/minmax/minmax.h>
+
+struct fw_image_buf {
+	void *data;
+	ssize_t len;
+	bool full;
+};
+
+/**
+ * struct fw_image - firmware image source
+ * @chunk: slice size handed to the caller
+ * @size: image size, -1 if unknown
+ * @map: mapping of the whole image, NULL when streaming
+ * @shared: @map belongs to the image this one was duplicated from
+ * @pos: offset of the next slice in @map
+ * @buf: streaming buffers, owned by the reader while !full
+ * @cur: buffer currently lent to the caller, -1 if none
+ * @next: buffer the caller will get next
+ * @eof: the short, final slice has been handed out
+ */
+struct fw_image {
+	int fd;
+	size_t chunk;
+	ssize_t size;
+	void *map;
+	bool shared;
+	size_t pos;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct fw_image_buf buf[2];
+	int cur;
+	int next;
+	bool eof;
+	bool stop;
+};
+
+static ssize_t fw_image_read_full(int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t rc;
+
+	while (done < len) {
+		rc = read(fd, (char *) buf + done, len - done);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (rc == 0)
+			break;
+		done += rc;
+	}
+
+	return done;
+}
+
+static void *fw_image_reader(void *arg)
+{
+	struct fw_image *img = arg;
+	struct fw_image_buf *buf;
+	ssize_t len;
+	bool stop;
+	int i = 0;
+
+	for (;;) {
+		buf = &img->buf[i];
+		pthread_mutex_lock(&img->lock);
+		while (buf->full && !img->stop)
+			pthread_cond_wait(&img->cond, &img->lock);
+		stop = img->stop;
+		pthread_mutex_unlock(&img->lock);
+		if (stop)
+			break;
+
+		len = fw_image_read_full(img->fd, buf->data, img->chunk);
+
+		pthread_mutex_lock(&img->lock);
+		buf->len = len;
+		buf->full = true;
+		pthread_cond_broadcast(&img->cond);
+		pthread_mutex_unlock(&img->lock);
+
+		/* a short read is the end of the image */
+		if (len < (ssize_t) img->chunk)
+			break;
+		i ^= 1;
+	}
+
+	return NULL;
+}
+
+static int fw_image_map(struct fw_image *img)
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(img->fd, &st) < 0)
+		return -errno;
+	if (!S_ISREG(st.st_mode))
+		return -ENODEV;
+	img->size = st.st_size;
+	if (st.st_size == 0)
+		return -ENODATA;
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, img->fd, 0);
+	if (map == MAP_FAILED)
+		return -errno;
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+	img->map = map;
+
+	return 0;
+}
+
+static int fw_image_stream(struct fw_image *img)
+{
+	int i, rc;
+
+	for (i = 0; i < 2; i++) {
+		img->buf[i].data = malloc(img->chunk);
+		if (!img->buf[i].data)
+			return -ENOMEM;
+	}
+
+	pthread_mutex_init(&img->lock, NULL);
+	pthread_cond_init(&img->cond, NULL);
+	rc = pthread_create(&img->thread, NULL, fw_image_reader, img);
+	if (rc) {
+		pthread_cond_destroy(&img->cond);
+		pthread_mutex_destroy(&img->lock);
+		return -rc;
+	}
+
+	return 0;
+}
+
+/*
+ * Regular files are mapped from offset 0, other sources are read from
+ * their current position.
+ */
+struct fw_image *fw_image_open(int fd, size_t chunk)
+{
+	struct fw_image *img;
+	int rc;
+
+	if (!chunk) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	img = calloc(1, sizeof(*img));
+	if (!img)
+		return NULL;
+	img->fd = fd;
+	img->chunk = chunk;
+	img->size = -1;
+	img->cur = -1;
+
+	if (fw_image_map(img) == 0)
+		return img;
+
+	rc = fw_image_stream(img);
+	if (rc) {
+		free(img->buf[0].data);
+		free(img->buf[1].data);
+		free(img);
+		errno = -rc;
+		return NULL;
+	}
+
+	return img;
+}
+
+/* streamed images are consumed once, so only a mapping can be shared */
+struct fw_image *fw_image_dup(struct fw_image *img, size_t chunk)
+{
+	struct fw_image *dup;
+
+	if (!img->map || !chunk) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	dup = calloc(1, sizeof(*dup));
+	if (!dup)
+		return NULL;
+	dup->fd = img->fd;
+	dup->chunk = chunk;
+	dup->size = img->size;
+	dup->map = img->map;
+	dup->shared = true;
+	dup->cur = -1;
+
+	return dup;
+}
+
+void fw_image_close(struct fw_image *img)
+{
+	if (!img)
+		return;
+
+	if (img->map) {
+		if (!img->shared)
+			munmap(img->map, img->size);
+	} else {
+		pthread_mutex_lock(&img->lock);
+		img->stop = true;
+		pthread_cond_broadcast(&img->cond);
+		pthread_mutex_unlock(&img->lock);
+		pthread_join(img->thread, NULL);
+		pthread_cond_destroy(&img->cond);
+		pthread_mutex_destroy(&img->lock);
+		free(img->buf[0].data);
+		free(img->buf[1].data);
+	}
+	free(img);
+}
+
+ssize_t fw_image_size(struct fw_image *img)
+{
+	return img->size;
+}
+
+/* wait for the reader to fill the caller's next buffer */
+static struct fw_image_buf *fw_image_wait(struct fw_image *img)
+{
+	struct fw_image_buf *buf = &img->buf[img->next];
+
+	pthread_mutex_lock(&img->lock);
+	while (!buf->full)
+		pthread_cond_wait(&img->cond, &img->lock);
+	pthread_mutex_unlock(&img->lock);
+
+	return buf;
+}
+
+ssize_t fw_image_next(struct fw_image *img, const void **data)
+{
+	struct fw_image_buf *buf;
+	size_t len;
+
+	if (img->map) {
+		len = img->size - img->pos;
+		if (len > img->chunk)
+			len = img->chunk;
+		*data = (char *) img->map + img->pos;
+		img->pos += len;
+		/* fault the following slice in while this one is sent */
+		if ((size_t) img->size > img->pos) {
+			size_t pg = sysconf(_SC_PAGESIZE), off = img->pos % pg;
+
+			madvise((char *) img->map + img->pos - off, off
+					+ min_t(size_t, img->chunk,
+						img->size - img->pos),
+					MADV_WILLNEED);
+		}
+		return len;
+	}
+
+	/* hand the previous slice back to the reader */
+	if (img->cur >= 0) {
+		pthread_mutex_lock(&img->lock);
+		img->buf[img->cur].full = false;
+		pthread_cond_broadcast(&img->cond);
+		pthread_mutex_unlock(&img->lock);
+		img->cur = -1;
+	}
+	if (img->eof)
+		return 0;
+
+	buf = fw_image_wait(img);
+	if (buf->len <= 0)
+		return buf->len;
+
+	img->cur = img->next;
+	img->next ^= 1;
+	img->eof = buf->len < (ssize_t) img->chunk;
+	*data = buf->data;
+	return buf->len;
+}
+
+bool fw_image_last(struct fw_image *img)
+{
+	struct fw_image_buf *buf;
+
+	if (img->map)
+		return img->pos >= (size_t) img->size;
+
+	if (img->eof)
+		return true;
+	buf = fw_image_wait(img);
+	return buf->len == 0;
+}
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _NDCTL_FWIMAGE_H_
+#define _NDCTL_FWIMAGE_H_
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*
+ * Firmware image reader shared by the update paths. The image is
+ * consumed as a sequence of @chunk sized slices (the last one may be
+ * short). Regular files are mmapped and slices point straight into the
+ * mapping. Anything that cannot be mapped, such as a pipe, is read by a
+ * helper thread into two alternating buffers so that reading the next
+ * slice overlaps sending the current one.
+ *
+ * A slice stays valid until the next fw_image_next() or fw_image_close().
+ *
+ * A mapped image can be shared: fw_image_dup() gives another cursor, with
+ * its own slice size, over the same mapping. Close the copies before the
+ * image they came from.
+ */
+struct fw_image;
+
+struct fw_image *fw_image_open(int fd, size_t chunk);
+struct fw_image *fw_image_dup(struct fw_image *img, size_t chunk);
+void fw_image_close(struct fw_image *img);
+/* total image size, or -1 when the source does not know it */
+ssize_t fw_image_size(struct fw_image *img);
+/* next slice: its length, 0 once the image is exhausted, or -errno */
+ssize_t fw_image_next(struct fw_image *img, const void **data);
+/* true when the slice last returned by fw_image_next() is the final one */
+bool fw_image_last(struct fw_image *img);
+#endif /* _NDCTL_FWIMAGE_H_ */
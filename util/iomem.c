@@ -2,35 +2,184 @@
 // Copyright (C) 2019-2020 Intel Corporation. All rights reserved.
 #include <stdio.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 #include <util/log.h>
 #include <util/iomem.h>
 #include <util/sysfs.h>
 
-unsigned long long __iomem_get_dev_resource(struct log_ctx *ctx,
-		const char *devpath)
+static unsigned int iomem_hash(const char *name)
 {
-	const char *devname = devpath_to_devname(devpath);
-	FILE *fp = fopen("/proc/iomem", "r");
-	unsigned long long res;
-	char name[256];
+	unsigned int hash = 5381;
 
-	if (fp == NULL) {
-		log_err(ctx, "%s: open /proc/iomem: %s\n", devname,
-				strerror(errno));
+	while (*name)
+		hash = hash * 33 + (unsigned char) *name++;
+	return hash;
+}
+
+void iomem_index_invalidate(struct iomem_index *idx)
+{
+	int i;
+
+	for (i = 0; i < idx->nr; i++)
+		free(idx->res[i].name);
+	free(idx->res);
+	free(idx->buckets);
+	memset(idx, 0, sizeof(*idx));
+}
+
+/*
+ * /proc/iomem is already listed in start order with parents ahead of
+ * children. Sorting keeps that, and falls back to file order (stashed
+ * in @next until the hash is built) when starts collide, which they all
+ * do when an unprivileged reader sees zeroed addresses.
+ */
+static int iomem_res_cmp(const void *a, const void *b)
+{
+	const struct iomem_res *r1 = a, *r2 = b;
+
+	if (r1->start != r2->start)
+		return r1->start < r2->start ? -1 : 1;
+	if (r1->depth != r2->depth)
+		return r1->depth < r2->depth ? -1 : 1;
+	return r1->next - r2->next;
+}
+
+static int iomem_index_load(struct log_ctx *ctx, struct iomem_index *idx)
+{
+	unsigned long long start, end;
+	struct iomem_res *res;
+	size_t len = 0;
+	char *line = NULL;
+	int i, alloc = 0;
+	unsigned int b;
+	int depth, off, rc;
+	FILE *fp;
+
+	if (idx->loaded)
 		return 0;
+
+	fp = fopen("/proc/iomem", "r");
+	if (fp == NULL) {
+		rc = -errno;
+		log_err(ctx, "open /proc/iomem: %s\n", strerror(-rc));
+		return rc;
 	}
 
-	while (fscanf(fp, "%llx-%*x : %254[^\n]\n", &res, name) == 2) {
-		if (strcmp(name, devname) == 0) {
-			log_dbg(ctx, "%s: got resource via iomem: %#llx\n",
-					devname, res);
-			fclose(fp);
-			return res;
+	while (getline(&line, &len, fp) > 0) {
+		line[strcspn(line, "\n")] = '\0';
+		depth = strspn(line, " ");
+		if (sscanf(line + depth, "%llx-%llx : %n", &start, &end,
+					&off) != 2)
+			continue;
+		if (idx->nr == alloc) {
+			alloc = alloc ? alloc * 2 : 256;
+			res = realloc(idx->res, alloc * sizeof(*res));
+			if (!res)
+				goto err;
+			idx->res = res;
 		}
+		res = &idx->res[idx->nr];
+		res->name = strdup(line + depth + off);
+		if (!res->name)
+			goto err;
+		res->start = start;
+		res->end = end;
+		res->depth = depth / 2;
+		res->hash = iomem_hash(res->name);
+		res->next = idx->nr++;
 	}
-
-	log_dbg(ctx, "%s: not found in iomem\n", devname);
+	free(line);
 	fclose(fp);
+
+	qsort(idx->res, idx->nr, sizeof(*idx->res), iomem_res_cmp);
+
+	idx->nr_buckets = 1;
+	while (idx->nr_buckets < (unsigned int) idx->nr)
+		idx->nr_buckets <<= 1;
+	idx->buckets = malloc(idx->nr_buckets * sizeof(int));
+	if (!idx->buckets) {
+		iomem_index_invalidate(idx);
+		return -ENOMEM;
+	}
+	memset(idx->buckets, -1, idx->nr_buckets * sizeof(int));
+	/* push back to front so each chain runs in sorted order */
+	for (i = idx->nr - 1; i >= 0; i--) {
+		b = idx->res[i].hash & (idx->nr_buckets - 1);
+		idx->res[i].next = idx->buckets[b];
+		idx->buckets[b] = i;
+	}
+
+	idx->loaded = true;
+	log_dbg(ctx, "indexed %d iomem resources\n", idx->nr);
 	return 0;
+err:
+	free(line);
+	fclose(fp);
+	iomem_index_invalidate(idx);
+	return -ENOMEM;
+}
+
+/* first resource with this name, in /proc/iomem order */
+const struct iomem_res *iomem_find_name(struct log_ctx *ctx,
+		struct iomem_index *idx, const char *name)
+{
+	unsigned int hash = iomem_hash(name);
+	int i;
+
+	if (iomem_index_load(ctx, idx) < 0)
+		return NULL;
+
+	for (i = idx->buckets[hash & (idx->nr_buckets - 1)]; i >= 0;
+			i = idx->res[i].next)
+		if (idx->res[i].hash == hash
+				&& strcmp(idx->res[i].name, name) == 0)
+			return &idx->res[i];
+	return NULL;
+}
+
+/* innermost resource that contains @addr */
+const struct iomem_res *iomem_find_addr(struct log_ctx *ctx,
+		struct iomem_index *idx, unsigned long long addr)
+{
+	int lo = 0, hi, i;
+
+	if (iomem_index_load(ctx, idx) < 0)
+		return NULL;
+
+	/* last resource starting at or below @addr */
+	hi = idx->nr;
+	while (lo < hi) {
+		i = lo + (hi - lo) / 2;
+		if (idx->res[i].start <= addr)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+
+	/*
+	 * Walking back from there, children come before their parents, so
+	 * the first range that still covers @addr is the deepest one.
+	 */
+	for (i = lo - 1; i >= 0; i--)
+		if (idx->res[i].end >= addr)
+			return &idx->res[i];
+	return NULL;
+}
+
+unsigned long long __iomem_get_dev_resource(struct log_ctx *ctx,
+		struct iomem_index *idx, const char *devpath)
+{
+	const char *devname = devpath_to_devname(devpath);
+	const struct iomem_res *res;
+
+	res = iomem_find_name(ctx, idx, devname);
+	if (!res) {
+		log_dbg(ctx, "%s: not found in iomem\n", devname);
+		return 0;
+	}
+
+	log_dbg(ctx, "%s: got resource via iomem: %#llx\n", devname,
+			res->start);
+	return res->start;
 }
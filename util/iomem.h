@@ -2,11 +2,52 @@
 /* Copyright (C) 2019-2020 Intel Corporation. All rights reserved. */
 #ifndef _NDCTL_IOMEM_H_
 #define _NDCTL_IOMEM_H_
+#include <stdbool.h>
 
 struct log_ctx;
+
+/**
+ * struct iomem_res - one line of /proc/iomem
+ * @start: first byte of the range
+ * @end: last byte of the range
+ * @depth: nesting level, 0 for top-level resources
+ * @name: resource name, e.g. "dax0.0" or "System RAM"
+ */
+struct iomem_res {
+	unsigned long long start, end;
+	unsigned int depth;
+	unsigned int hash;
+	int next;
+	char *name;
+};
+
+/**
+ * struct iomem_index - /proc/iomem parsed once and kept by a context
+ * @res: resources sorted by start, parents ahead of their children
+ * @nr: number of entries in @res
+ * @buckets: heads of the name hash chains, indices into @res
+ *
+ * Loaded on the first lookup and dropped by iomem_index_invalidate(),
+ * after which the next lookup re-reads /proc/iomem.
+ */
+struct iomem_index {
+	bool loaded;
+	struct iomem_res *res;
+	int nr;
+	int *buckets;
+	unsigned int nr_buckets;
+};
+
+void iomem_index_invalidate(struct iomem_index *idx);
+const struct iomem_res *iomem_find_name(struct log_ctx *ctx,
+		struct iomem_index *idx, const char *name);
+const struct iomem_res *iomem_find_addr(struct log_ctx *ctx,
+		struct iomem_index *idx, unsigned long long addr);
+
 unsigned long long __iomem_get_dev_resource(struct log_ctx *ctx,
-		const char *path);
+		struct iomem_index *idx, const char *path);
 
-#define iomem_get_dev_resource(c, p) __iomem_get_dev_resource(&(c)->ctx, (p))
+#define iomem_get_dev_resource(c, p) \
+	__iomem_get_dev_resource(&(c)->ctx, &(c)->iomem, (p))
 
 #endif /* _NDCTL_IOMEM_H_ */
@@ -1,6 +1,8 @@
 // SPDX-License-Identifier: GPL-2.0
 // Copyright (C) 2015-2020 Intel Corporation. All rights reserved.
+#include <errno.h>
 #include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 #include <util/json.h>
 #include <util/filter.h>
@@ -102,6 +104,7 @@ void util_display_json_array(FILE *f_out, struct json_object *jarray,
 	int len = json_object_array_length(jarray);
 	int jflag = JSON_C_TO_STRING_PRETTY;
 
+	util_json_fields_prune(jarray, flags);
 	if (json_object_array_length(jarray) > 1 || !(flags & UTIL_JSON_HUMAN))
 		fprintf(f_out, "%s\n", json_object_to_json_string_ext(jarray, jflag));
 	else if (len) {
@@ -113,6 +116,416 @@ void util_display_json_array(FILE *f_out, struct json_object *jarray,
 	json_object_put(jarray);
 }
 
+/*
+ * Write array elements as they are produced instead of building the
+ * whole array first. The output is the same as util_display_json_array()
+ * would print for the equivalent array: each element is serialized on
+ * its own and indented one level, and with UTIL_JSON_HUMAN a lone
+ * element is printed bare, so the first one is held until a second
+ * arrives or the stream ends. An empty stream prints nothing.
+ */
+void util_json_stream_init(struct util_json_stream *s, FILE *f_out,
+		unsigned long flags)
+{
+	s->f_out = f_out;
+	s->flags = flags;
+	s->held = NULL;
+	s->count = 0;
+}
+
+static void util_json_stream_write(struct util_json_stream *s,
+		struct json_object *jobj)
+{
+	const char *str, *nl;
+
+	str = json_object_to_json_string_ext(jobj, JSON_C_TO_STRING_PRETTY);
+	fputs(s->count ? ",\n  " : "[\n  ", s->f_out);
+	while ((nl = strchr(str, '\n'))) {
+		fwrite(str, 1, nl - str + 1, s->f_out);
+		fputs("  ", s->f_out);
+		str = nl + 1;
+	}
+	fputs(str, s->f_out);
+	s->count++;
+	json_object_put(jobj);
+}
+
+/* takes ownership of @jobj */
+void util_json_stream_add(struct util_json_stream *s, struct json_object *jobj)
+{
+	if (!jobj)
+		return;
+	util_json_fields_prune(jobj, s->flags);
+	if ((s->flags & UTIL_JSON_HUMAN) && !s->count && !s->held) {
+		s->held = jobj;
+		return;
+	}
+	if (s->held) {
+		util_json_stream_write(s, s->held);
+		s->held = NULL;
+	}
+	util_json_stream_write(s, jobj);
+}
+
+/* move the elements of @jarray into the stream and drop the array */
+void util_json_stream_add_array(struct util_json_stream *s,
+		struct json_object *jarray)
+{
+	int i, len = json_object_array_length(jarray);
+
+	for (i = 0; i < len; i++)
+		util_json_stream_add(s,
+			json_object_get(json_object_array_get_idx(jarray, i)));
+	json_object_put(jarray);
+}
+
+void util_json_stream_end(struct util_json_stream *s)
+{
+	if (s->held) {
+		fprintf(s->f_out, "%s\n", json_object_to_json_string_ext(
+					s->held, JSON_C_TO_STRING_PRETTY));
+		json_object_put(s->held);
+		s->held = NULL;
+	} else if (s->count)
+		fputs("\n]\n", s->f_out);
+	s->count = 0;
+}
+
+/*
+ * A listing reduced to one entry per identified object, named by the
+ * first of @keys it carries, e.g. "dev" or "memdev". Each entry holds
+ * the object's own attributes, but not the arrays of identified
+ * children below it, which are entries of their own. A namespace
+ * coming or going then shows as that namespace, not as its region
+ * changing too.
+ */
+static const char *snap_ident(struct json_object *jobj,
+		const char * const *keys)
+{
+	struct json_object *jval;
+
+	if (!json_object_is_type(jobj, json_type_object))
+		return NULL;
+	for (; *keys; keys++)
+		if (json_object_object_get_ex(jobj, *keys, &jval))
+			return json_object_get_string(jval);
+	return NULL;
+}
+
+static bool snap_is_children(struct json_object *jval,
+		const char * const *keys)
+{
+	return json_object_is_type(jval, json_type_array)
+		&& json_object_array_length(jval)
+		&& snap_ident(json_object_array_get_idx(jval, 0), keys);
+}
+
+static struct json_object *snap_shallow(struct json_object *jobj,
+		const char * const *keys)
+{
+	struct json_object *jcopy = json_object_new_object();
+
+	if (!jcopy)
+		return NULL;
+	json_object_object_foreach(jobj, key, jval) {
+		if (snap_is_children(jval, keys))
+			continue;
+		if (json_object_is_type(jval, json_type_object)
+				&& !snap_ident(jval, keys))
+			jval = snap_shallow(jval, keys);
+		else
+			jval = json_object_get(jval);
+		json_object_object_add(jcopy, key, jval);
+	}
+	return jcopy;
+}
+
+/* without @keys the object is recorded whole */
+static int snap_add(struct util_json_snap *snap, const char *ident,
+		struct json_object *jobj, const char * const *keys)
+{
+	struct util_json_snap_ent *ent;
+	struct json_object *jcopy;
+
+	if (snap->nr == snap->alloc) {
+		int alloc = snap->alloc ? snap->alloc * 2 : 64;
+
+		ent = realloc(snap->ents, alloc * sizeof(*ent));
+		if (!ent)
+			return -ENOMEM;
+		snap->ents = ent;
+		snap->alloc = alloc;
+	}
+	jcopy = keys ? snap_shallow(jobj, keys) : json_object_get(jobj);
+	if (!jcopy)
+		return -ENOMEM;
+	ent = &snap->ents[snap->nr];
+	ent->ident = strdup(ident);
+	ent->json = strdup(json_object_to_json_string_ext(jcopy,
+				JSON_C_TO_STRING_PLAIN));
+	json_object_put(jcopy);
+	if (!ent->ident || !ent->json) {
+		free(ent->ident);
+		free(ent->json);
+		return -ENOMEM;
+	}
+	snap->nr++;
+	return 0;
+}
+
+static int snap_walk(struct util_json_snap *snap, struct json_object *jobj,
+		const char * const *keys)
+{
+	const char *ident;
+	int i, rc;
+
+	if (json_object_is_type(jobj, json_type_array)) {
+		for (i = 0; i < (int) json_object_array_length(jobj); i++) {
+			rc = snap_walk(snap, json_object_array_get_idx(jobj, i),
+					keys);
+			if (rc)
+				return rc;
+		}
+		return 0;
+	}
+	if (!json_object_is_type(jobj, json_type_object))
+		return 0;
+
+	ident = snap_ident(jobj, keys);
+	if (ident) {
+		rc = snap_add(snap, ident, jobj, keys);
+		if (rc)
+			return rc;
+	}
+	json_object_object_foreach(jobj, key, jval) {
+		(void) key;
+		rc = snap_walk(snap, jval, keys);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+static int snap_cmp(const void *a, const void *b)
+{
+	const struct util_json_snap_ent *x = a, *y = b;
+
+	return strcmp(x->ident, y->ident);
+}
+
+/**
+ * util_json_snap_add - record the identified objects in a listing
+ * @snap: snapshot to add to, zeroed before first use
+ * @jobj: listing, as built for display, not consumed
+ * @keys: NULL terminated attribute names that identify an object
+ */
+int util_json_snap_add(struct util_json_snap *snap, struct json_object *jobj,
+		const char * const *keys)
+{
+	int rc;
+
+	if (!jobj)
+		return 0;
+	rc = snap_walk(snap, jobj, keys);
+	qsort(snap->ents, snap->nr, sizeof(*snap->ents), snap_cmp);
+	return rc;
+}
+
+/**
+ * util_json_snap_add_flat - record each element of a listing whole
+ * @snap: snapshot to add to, zeroed before first use
+ * @jarray: array of objects, not consumed
+ * @keys: NULL terminated attribute names that identify an element
+ *
+ * For listings like 'cxl list' where objects only refer to each other
+ * by name, e.g. a memdev's regions, rather than nest their children.
+ */
+int util_json_snap_add_flat(struct util_json_snap *snap,
+		struct json_object *jarray, const char * const *keys)
+{
+	struct json_object *jobj;
+	const char *ident;
+	int i, rc;
+
+	if (!jarray)
+		return 0;
+	for (i = 0; i < (int) json_object_array_length(jarray); i++) {
+		jobj = json_object_array_get_idx(jarray, i);
+		ident = snap_ident(jobj, keys);
+		if (!ident)
+			continue;
+		rc = snap_add(snap, ident, jobj, NULL);
+		if (rc)
+			return rc;
+	}
+	qsort(snap->ents, snap->nr, sizeof(*snap->ents), snap_cmp);
+	return 0;
+}
+
+static void snap_print(FILE *f_out, const char *event,
+		struct util_json_snap_ent *ent, bool object)
+{
+	struct json_object *jident = json_object_new_string(ent->ident);
+
+	fprintf(f_out, "{\"event\":\"%s\",\"id\":%s", event,
+			json_object_to_json_string(jident));
+	if (object)
+		fprintf(f_out, ",\"object\":%s", ent->json);
+	fputs("}\n", f_out);
+	json_object_put(jident);
+}
+
+/**
+ * util_json_snap_diff - print what changed between two snapshots
+ * @f_out: where the events go, one JSON object per line
+ * @old: previous snapshot
+ * @new: current snapshot
+ *
+ * Emits {"event":"added"|"changed","id":..,"object":{..}} and
+ * {"event":"removed","id":..}, and returns the number of events.
+ */
+int util_json_snap_diff(FILE *f_out, struct util_json_snap *old,
+		struct util_json_snap *new)
+{
+	int i = 0, j = 0, nr = 0, cmp;
+
+	while (i < old->nr || j < new->nr) {
+		if (i == old->nr)
+			cmp = 1;
+		else if (j == new->nr)
+			cmp = -1;
+		else
+			cmp = strcmp(old->ents[i].ident, new->ents[j].ident);
+
+		if (cmp < 0) {
+			snap_print(f_out, "removed", &old->ents[i++], false);
+			nr++;
+		} else if (cmp > 0) {
+			snap_print(f_out, "added", &new->ents[j++], true);
+			nr++;
+		} else {
+			if (strcmp(old->ents[i].json, new->ents[j].json)) {
+				snap_print(f_out, "changed", &new->ents[j], true);
+				nr++;
+			}
+			i++;
+			j++;
+		}
+	}
+	if (nr)
+		fflush(f_out);
+	return nr;
+}
+
+void util_json_snap_free(struct util_json_snap *snap)
+{
+	int i;
+
+	for (i = 0; i < snap->nr; i++) {
+		free(snap->ents[i].ident);
+		free(snap->ents[i].json);
+	}
+	free(snap->ents);
+	memset(snap, 0, sizeof(*snap));
+}
+
+/*
+ * --fields: the attributes, by name, a listing is reduced to. Builders
+ * check util_json_want() before collecting anything that costs a
+ * sysfs walk or a firmware command, and display drops whatever else
+ * was not asked for, see util_json_fields_prune().
+ */
+static struct {
+	char *buf;
+	char **names;
+	int nr;
+} fields;
+
+int util_json_fields_parse(const char *list)
+{
+	char *save, *name;
+	int nr = 1;
+	const char *c;
+
+	for (c = list; *c; c++)
+		if (*c == ',')
+			nr++;
+	fields.buf = strdup(list);
+	fields.names = calloc(nr, sizeof(char *));
+	if (!fields.buf || !fields.names)
+		return -ENOMEM;
+
+	for (name = strtok_r(fields.buf, ",", &save); name;
+			name = strtok_r(NULL, ",", &save))
+		fields.names[fields.nr++] = name;
+	return fields.nr ? 0 : -EINVAL;
+}
+
+bool util_json_want(unsigned long flags, const char *field)
+{
+	int i;
+
+	if (!(flags & UTIL_JSON_FIELDS))
+		return true;
+	for (i = 0; i < fields.nr; i++)
+		if (strcmp(fields.names[i], field) == 0)
+			return true;
+	return false;
+}
+
+/*
+ * Arrays of objects are nested listings, e.g. a bus's regions, and
+ * are kept, pruned, as long as something in them was asked for. Any
+ * other attribute, objects like "health" included, stays only when
+ * named. Returns whether anything is left of @jobj.
+ */
+static bool fields_prune(struct json_object *jobj)
+{
+	int i, nr = 0, len = json_object_object_length(jobj);
+	const char **drop;
+	bool keep;
+
+	drop = calloc(len ? len : 1, sizeof(*drop));
+	if (!drop)
+		return true;
+	json_object_object_foreach(jobj, key, jval) {
+		if (util_json_want(UTIL_JSON_FIELDS, key))
+			continue;
+		keep = false;
+		if (json_object_is_type(jval, json_type_array))
+			for (i = 0; i < (int) json_object_array_length(jval);
+					i++) {
+				struct json_object *jent;
+
+				jent = json_object_array_get_idx(jval, i);
+				if (json_object_is_type(jent, json_type_object))
+					keep |= fields_prune(jent);
+			}
+		if (!keep)
+			drop[nr++] = key;
+	}
+	for (i = 0; i < nr; i++)
+		json_object_object_del(jobj, drop[i]);
+	free(drop);
+	return json_object_object_length(jobj) > 0;
+}
+
+void util_json_fields_prune(struct json_object *jobj, unsigned long flags)
+{
+	int i;
+
+	if (!(flags & UTIL_JSON_FIELDS) || !jobj)
+		return;
+	if (json_object_is_type(jobj, json_type_object)) {
+		fields_prune(jobj);
+		return;
+	}
+	if (json_object_is_type(jobj, json_type_array))
+		for (i = 0; i < (int) json_object_array_length(jobj); i++)
+			util_json_fields_prune(json_object_array_get_idx(jobj,
+						i), flags);
+}
+
 struct json_object *util_bus_to_json(struct ndctl_bus *bus, unsigned long flags)
 {
 	struct json_object *jbus = json_object_new_object();
@@ -132,16 +545,18 @@ struct json_object *util_bus_to_json(struct ndctl_bus *bus, unsigned long flags)
 		goto err;
 	json_object_object_add(jbus, "dev", jobj);
 
-	scrub = ndctl_bus_get_scrub_state(bus);
-	if (scrub < 0)
-		return jbus;
+	if (util_json_want(flags, "scrub_state")) {
+		scrub = ndctl_bus_get_scrub_state(bus);
+		if (scrub < 0)
+			return jbus;
 
-	jobj = json_object_new_string(scrub ? "active" : "idle");
-	if (!jobj)
-		goto err;
-	json_object_object_add(jbus, "scrub_state", jobj);
+		jobj = json_object_new_string(scrub ? "active" : "idle");
+		if (!jobj)
+			goto err;
+		json_object_object_add(jbus, "scrub_state", jobj);
+	}
 
-	if (flags & UTIL_JSON_FIRMWARE) {
+	if ((flags & UTIL_JSON_FIRMWARE) && util_json_want(flags, "firmware")) {
 		struct ndctl_dimm *dimm;
 
 		/*
@@ -426,7 +841,7 @@ struct json_object *util_dimm_to_json(struct ndctl_dimm *dimm,
 			json_object_object_add(jdimm, "security_frozen", jobj);
 	}
 
-	if (flags & UTIL_JSON_FIRMWARE) {
+	if ((flags & UTIL_JSON_FIRMWARE) && util_json_want(flags, "firmware")) {
 		struct json_object *jfirmware;
 
 		jfirmware = util_dimm_firmware_to_json(dimm, flags);
@@ -440,6 +855,133 @@ struct json_object *util_dimm_to_json(struct ndctl_dimm *dimm,
 	return NULL;
 }
 
+struct util_memblock_counts {
+	int total;
+	int online;
+	int movable;
+};
+
+/* one pass over the block summary rather than one op per count */
+static int util_daxctl_memblocks_count(struct daxctl_memory *mem,
+		struct util_memblock_counts *counts)
+{
+	int i, nr, state;
+	unsigned long first, len;
+
+	memset(counts, 0, sizeof(*counts));
+	nr = daxctl_memory_get_num_block_runs(mem);
+	if (nr < 0)
+		return nr;
+	for (i = 0; i < nr; i++) {
+		state = daxctl_memory_get_block_run(mem, i, &first, &len);
+		if (state < 0)
+			return state;
+		counts->total += len;
+		if (state != DAXCTL_MEMBLOCK_OFFLINE)
+			counts->online += len;
+		if (state == DAXCTL_MEMBLOCK_ONLINE_MOVABLE)
+			counts->movable += len;
+	}
+	return 0;
+}
+
+static struct json_object *util_daxctl_memblocks_to_json(
+		struct daxctl_memory *mem)
+{
+	static const char * const zones[] = {
+		[DAXCTL_MEMBLOCK_ONLINE_NORMAL] = "Normal",
+		[DAXCTL_MEMBLOCK_ONLINE_MOVABLE] = "Movable",
+	};
+	struct json_object *jruns, *jrun;
+	unsigned long first, len;
+	int i, nr, state;
+
+	nr = daxctl_memory_get_num_block_runs(mem);
+	if (nr <= 0)
+		return NULL;
+	jruns = json_object_new_array();
+	if (!jruns)
+		return NULL;
+
+	for (i = 0; i < nr; i++) {
+		state = daxctl_memory_get_block_run(mem, i, &first, &len);
+		if (state < 0)
+			break;
+		jrun = json_object_new_object();
+		if (!jrun)
+			break;
+		json_object_object_add(jrun, "first",
+				json_object_new_int64(first));
+		json_object_object_add(jrun, "count",
+				json_object_new_int64(len));
+		json_object_object_add(jrun, "state", json_object_new_string(
+				state == DAXCTL_MEMBLOCK_OFFLINE
+				? "offline" : "online"));
+		if (state == DAXCTL_MEMBLOCK_ONLINE_NORMAL
+				|| state == DAXCTL_MEMBLOCK_ONLINE_MOVABLE)
+			json_object_object_add(jrun, "zone",
+					json_object_new_string(zones[state]));
+		json_object_array_add(jruns, jrun);
+	}
+	return jruns;
+}
+
+static struct json_object *util_daxctl_node_perf_to_json(
+		struct daxctl_ctx *ctx, int node, int access)
+{
+	static const char * const names[] = {
+		"read_bandwidth_mbps", "write_bandwidth_mbps",
+		"read_latency_ns", "write_latency_ns",
+	};
+	struct json_object *jperf, *jobj;
+	unsigned long vals[ARRAY_SIZE(names)];
+	struct daxctl_node_perf perf;
+	unsigned int i;
+
+	if (daxctl_node_get_perf(ctx, node, access, &perf) < 0)
+		return NULL;
+
+	jperf = json_object_new_object();
+	if (!jperf)
+		return NULL;
+
+	vals[0] = perf.read_bandwidth;
+	vals[1] = perf.write_bandwidth;
+	vals[2] = perf.read_latency;
+	vals[3] = perf.write_latency;
+	for (i = 0; i < ARRAY_SIZE(names); i++) {
+		if (!vals[i])
+			continue;
+		jobj = json_object_new_int64(vals[i]);
+		if (jobj)
+			json_object_object_add(jperf, names[i], jobj);
+	}
+	return jperf;
+}
+
+static void util_daxctl_node_perfs_to_json(struct daxctl_ctx *ctx, int node,
+		struct json_object *jdev)
+{
+	struct json_object *jperfs, *jperf;
+
+	jperfs = json_object_new_object();
+	if (!jperfs)
+		return;
+
+	/* access1 is cpu initiators only, access0 any initiator */
+	jperf = util_daxctl_node_perf_to_json(ctx, node, 1);
+	if (jperf)
+		json_object_object_add(jperfs, "cpu", jperf);
+	jperf = util_daxctl_node_perf_to_json(ctx, node, 0);
+	if (jperf)
+		json_object_object_add(jperfs, "any", jperf);
+
+	if (json_object_object_length(jperfs))
+		json_object_object_add(jdev, "performance", jperfs);
+	else
+		json_object_put(jperfs);
+}
+
 struct json_object *util_daxctl_dev_to_json(struct daxctl_dev *dev,
 		unsigned long flags)
 {
@@ -447,7 +989,8 @@ struct json_object *util_daxctl_dev_to_json(struct daxctl_dev *dev,
 	const char *devname = daxctl_dev_get_devname(dev);
 	struct json_object *jdev, *jobj, *jmappings = NULL;
 	struct daxctl_mapping *mapping = NULL;
-	int node, movable, align;
+	struct util_memblock_counts counts;
+	int node, align, tier;
 
 	jdev = json_object_new_object();
 	if (!devname || !jdev)
@@ -466,6 +1009,9 @@ struct json_object *util_daxctl_dev_to_json(struct daxctl_dev *dev,
 		jobj = json_object_new_int(node);
 		if (jobj)
 			json_object_object_add(jdev, "target_node", jobj);
+		if (util_json_want(flags, "performance"))
+			util_daxctl_node_perfs_to_json(daxctl_dev_get_ctx(dev),
+					node, jdev);
 	}
 
 	align = daxctl_dev_get_align(dev);
@@ -482,27 +1028,36 @@ struct json_object *util_daxctl_dev_to_json(struct daxctl_dev *dev,
 	if (jobj)
 		json_object_object_add(jdev, "mode", jobj);
 
-	if (mem && daxctl_dev_get_resource(dev) != 0) {
-		int num_sections = daxctl_memory_num_sections(mem);
-		int num_online = daxctl_memory_is_online(mem);
-
-		jobj = json_object_new_int(num_online);
+	if (mem && daxctl_dev_get_resource(dev) != 0
+			&& (util_json_want(flags, "online_memblocks")
+				|| util_json_want(flags, "total_memblocks")
+				|| util_json_want(flags, "movable")
+				|| util_json_want(flags, "memory_tier"))
+			&& util_daxctl_memblocks_count(mem, &counts) == 0) {
+		jobj = json_object_new_int(counts.online);
 		if (jobj)
 			json_object_object_add(jdev, "online_memblocks", jobj);
 
-		jobj = json_object_new_int(num_sections);
+		jobj = json_object_new_int(counts.total);
 		if (jobj)
 			json_object_object_add(jdev, "total_memblocks", jobj);
 
-		movable = daxctl_memory_is_movable(mem);
-		if (movable == 1)
-			jobj = json_object_new_boolean(true);
-		else if (movable == 0)
-			jobj = json_object_new_boolean(false);
-		else
-			jobj = NULL;
-		if (jobj)
-			json_object_object_add(jdev, "movable", jobj);
+		/* as daxctl_memory_is_movable(), only said of online memory */
+		if (counts.online) {
+			jobj = json_object_new_boolean(
+					counts.movable == counts.online);
+			if (jobj)
+				json_object_object_add(jdev, "movable", jobj);
+		}
+
+		tier = daxctl_node_get_memory_tier(daxctl_dev_get_ctx(dev),
+				node);
+		if (tier >= 0) {
+			jobj = json_object_new_int(tier);
+			if (jobj)
+				json_object_object_add(jdev, "memory_tier",
+						jobj);
+		}
 	}
 
 	if (!daxctl_dev_is_enabled(dev)) {
@@ -514,9 +1069,18 @@ struct json_object *util_daxctl_dev_to_json(struct daxctl_dev *dev,
 	if (!(flags & UTIL_JSON_DAX_MAPPINGS))
 		return jdev;
 
+	if (mem && daxctl_dev_get_resource(dev) != 0
+			&& util_json_want(flags, "memblocks")) {
+		jobj = util_daxctl_memblocks_to_json(mem);
+		if (jobj)
+			json_object_object_add(jdev, "memblocks", jobj);
+	}
+
 	daxctl_mapping_foreach(dev, mapping) {
 		struct json_object *jmapping;
 
+		if (!util_json_want(flags, "mappings"))
+			break;
 		if (!jmappings) {
 			jmappings = json_object_new_array();
 			if (!jmappings)
@@ -928,14 +1492,16 @@ static struct json_object *dev_badblocks_to_json(struct ndctl_region *region,
 {
 	struct json_object *jbb = NULL, *jbbs = NULL, *jobj;
 	unsigned long long region_begin, dev_end, offset;
-	unsigned int len, bbs = 0;
-	struct badblock *bb;
+	unsigned int len, bbs = 0, nr, i;
+	const struct badblock *bb, *index;
 
 	region_begin = ndctl_region_get_resource(region);
 	if (region_begin == ULLONG_MAX)
 		return NULL;
 
 	dev_end = dev_begin + dev_size - 1;
+	nr = ndctl_region_get_badblocks_range(region,
+			(dev_begin - region_begin) >> 9, dev_size >> 9, &index);
 
 	if (flags & UTIL_JSON_MEDIA_ERRORS) {
 		jbbs = json_object_new_array();
@@ -943,10 +1509,11 @@ static struct json_object *dev_badblocks_to_json(struct ndctl_region *region,
 			return NULL;
 	}
 
-	ndctl_region_badblock_foreach(region, bb) {
+	for (i = 0; i < nr; i++) {
 		unsigned long long bb_begin, bb_end, begin, end;
 		struct json_object *jdimms;
 
+		bb = &index[i];
 		bb_begin = region_begin + (bb->offset << 9);
 		bb_end = bb_begin + (bb->len << 9) - 1;
 
@@ -1309,6 +1876,10 @@ struct json_object *util_namespace_to_json(struct ndctl_namespace *ndns,
 			json_object_object_add(jndns, "target_node", jobj);
 	}
 
+	if (!util_json_want(flags, "badblock_count")
+			&& !util_json_want(flags, "badblocks"))
+		return jndns;
+
 	if (pfn)
 		jbbs = util_pfn_badblocks_to_json(pfn, &bb_count, flags);
 	else if (dax)
@@ -1442,6 +2013,215 @@ struct json_object *util_badblock_rec_to_json(u64 block, u64 count,
 	return NULL;
 }
 
+static struct json_object *util_cxl_inventory_to_json(
+		struct cxl_memdev *memdev, unsigned long flags)
+{
+	struct cxl_inventory *inv = cxl_memdev_get_inventory(memdev);
+	struct json_object *jinv, *jslots, *jslot, *jobj;
+	char buf[17];
+	int i, nr;
+
+	if (!inv)
+		return NULL;
+	jinv = json_object_new_object();
+	if (!jinv)
+		return NULL;
+
+	cxl_inventory_get_fw_rev(inv, buf, sizeof(buf));
+	jobj = json_object_new_string(buf);
+	if (jobj)
+		json_object_object_add(jinv, "bufision", jobj);
+
+	jobj = util_json_object_size(cxl_inventory_get_total_capacity(inv),
+			flags);
+	if (jobj)
+		json_object_object_add(jinv, "total_capacity", jobj);
+
+	jobj = util_json_object_hex(cxl_inventory_get_device_id(inv), flags);
+	if (jobj)
+		json_object_object_add(jinv, "device_id", jobj);
+
+	jobj = util_json_object_hex(cxl_inventory_get_device_rev(inv), flags);
+	if (jobj)
+		json_object_object_add(jinv, "device_rev", jobj);
+
+	snprintf(buf, sizeof(buf), "%d.%d",
+			cxl_inventory_get_chipinfo_rel_major(inv),
+			cxl_inventory_get_chipinfo_rel_minor(inv));
+	jobj = json_object_new_string(buf);
+	if (jobj)
+		json_object_object_add(jinv, "chipinfo_release", jobj);
+
+	snprintf(buf, sizeof(buf), "%d.%d",
+			cxl_inventory_get_configfile_ver_major(inv),
+			cxl_inventory_get_configfile_ver_minor(inv));
+	jobj = json_object_new_string(buf);
+	if (jobj)
+		json_object_object_add(jinv, "configfile_version", jobj);
+
+	jobj = json_object_new_int(cxl_inventory_get_active_fw_slot(inv));
+	if (jobj)
+		json_object_object_add(jinv, "active_fw_slot", jobj);
+
+	nr = cxl_inventory_get_fw_slots_supported(inv);
+	jslots = json_object_new_array();
+	for (i = 1; jslots && i <= nr && i <= 4; i++) {
+		cxl_inventory_get_slot_fw_rev(inv, i, buf, sizeof(buf));
+		jobj = json_object_new_string(buf);
+		if (jobj)
+			json_object_array_add(jslots, jobj);
+	}
+	if (jslots)
+		json_object_object_add(jinv, "fw_slots", jslots);
+
+	nr = cxl_inventory_get_nr_dimm_slots(inv);
+	jslots = json_object_new_array();
+	for (i = 0; jslots && i < nr; i++) {
+		jslot = json_object_new_object();
+		if (!jslot)
+			continue;
+		snprintf(buf, sizeof(buf), "%c",
+				cxl_inventory_get_dimm_silk_screen(inv, i));
+		jobj = json_object_new_string(buf);
+		if (jobj)
+			json_object_object_add(jslot, "silk_screen", jobj);
+		jobj = json_object_new_boolean(
+				cxl_inventory_get_dimm_present(inv, i));
+		if (jobj)
+			json_object_object_add(jslot, "present", jobj);
+		jobj = json_object_new_int(cxl_inventory_get_dimm_channel(inv, i));
+		if (jobj)
+			json_object_object_add(jslot, "channel", jobj);
+		jobj = util_json_object_hex(
+				cxl_inventory_get_dimm_spd_addr(inv, i), flags);
+		if (jobj)
+			json_object_object_add(jslot, "spd_i2c_addr", jobj);
+		json_object_array_add(jslots, jslot);
+	}
+	if (jslots)
+		json_object_object_add(jinv, "dimm_slots", jslots);
+
+	return jinv;
+}
+
+/* CXL mailbox command sets, i.e. the opcode high byte */
+static const struct {
+	int set;
+	const char *name;
+} cxl_command_sets[] = {
+	{ 0x01, "events" },
+	{ 0x02, "firmware-update" },
+	{ 0x03, "timestamp" },
+	{ 0x04, "logs" },
+	{ 0x05, "features" },
+	{ 0x40, "identify" },
+	{ 0x41, "capacity-config" },
+	{ 0x42, "health-info" },
+	{ 0x43, "media-poison" },
+	{ 0x44, "sanitize" },
+	{ 0x45, "pmem-security" },
+	{ 0x46, "security-passthrough" },
+	{ 0x47, "sld-qos" },
+};
+
+static const char *cxl_command_set_name(int set)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(cxl_command_sets); i++)
+		if (cxl_command_sets[i].set == set)
+			return cxl_command_sets[i].name;
+	return set >= 0xc0 ? "vendor" : "unknown";
+}
+
+/* one object per command set with the number of opcodes it supports */
+static struct json_object *util_cxl_commands_to_json(
+		struct cxl_memdev *memdev, unsigned long flags)
+{
+	int i, nr = cxl_memdev_cel_get_nr_entries(memdev), set, count = 0;
+	struct json_object *jsets, *jset = NULL, *jobj;
+	int cur = -1;
+
+	if (nr < 0)
+		return NULL;
+	jsets = json_object_new_array();
+	if (!jsets)
+		return NULL;
+
+	/* entries come sorted by opcode, so each set is contiguous */
+	for (i = 0; i <= nr; i++) {
+		set = i < nr ? cxl_memdev_cel_get_opcode(memdev, i) >> 8 : -1;
+		if (set == cur) {
+			count++;
+			continue;
+		}
+		if (jset) {
+			json_object_object_add(jset, "opcodes",
+					json_object_new_int(count));
+			json_object_array_add(jsets, jset);
+			jset = NULL;
+		}
+		cur = set;
+		count = 1;
+		if (set < 0)
+			break;
+
+		jset = json_object_new_object();
+		if (!jset)
+			continue;
+		jobj = util_json_object_hex(set, flags);
+		if (jobj)
+			json_object_object_add(jset, "set", jobj);
+		jobj = json_object_new_string(cxl_command_set_name(set));
+		if (jobj)
+			json_object_object_add(jset, "name", jobj);
+	}
+
+	return jsets;
+}
+
+/*
+ * Regions the memdev contributes capacity to, with the dax devices, and
+ * so the NUMA nodes, that capacity ends up behind.
+ */
+static struct json_object *util_cxl_memdev_regions_to_json(
+		struct cxl_memdev *memdev, unsigned long flags)
+{
+	struct json_object *jregions = NULL, *jregion, *jobj;
+	struct daxctl_region *dax_region;
+	struct cxl_region *region;
+	int pos;
+
+	cxl_region_foreach(cxl_memdev_get_ctx(memdev), region) {
+		pos = cxl_region_get_memdev_position(region, memdev);
+		if (pos < 0)
+			continue;
+		if (!jregions) {
+			jregions = json_object_new_array();
+			if (!jregions)
+				return NULL;
+		}
+		jregion = json_object_new_object();
+		if (!jregion)
+			continue;
+		jobj = json_object_new_string(cxl_region_get_devname(region));
+		if (jobj)
+			json_object_object_add(jregion, "region", jobj);
+		jobj = json_object_new_int(pos);
+		if (jobj)
+			json_object_object_add(jregion, "position", jobj);
+		dax_region = cxl_region_get_daxctl_region(region);
+		if (dax_region) {
+			jobj = util_daxctl_devs_to_list(dax_region, NULL, NULL,
+					flags);
+			if (jobj)
+				json_object_object_add(jregion, "daxdevs", jobj);
+		}
+		json_object_array_add(jregions, jregion);
+	}
+	return jregions;
+}
+
 struct json_object *util_cxl_memdev_to_json(struct cxl_memdev *memdev,
 		unsigned long flags)
 {
@@ -1464,5 +2244,262 @@ struct json_object *util_cxl_memdev_to_json(struct cxl_memdev *memdev,
 	if (jobj)
 		json_object_object_add(jdev, "ram_size", jobj);
 
+	if ((flags & UTIL_JSON_COMMANDS) && util_json_want(flags, "commands")) {
+		jobj = util_cxl_commands_to_json(memdev, flags);
+		if (jobj)
+			json_object_object_add(jdev, "commands", jobj);
+	}
+
+	if ((flags & UTIL_JSON_INVENTORY)
+			&& util_json_want(flags, "inventory")) {
+		jobj = util_cxl_inventory_to_json(memdev, flags);
+		if (jobj)
+			json_object_object_add(jdev, "inventory", jobj);
+	}
+
+	if ((flags & UTIL_JSON_DAX) && util_json_want(flags, "regions")) {
+		jobj = util_cxl_memdev_regions_to_json(memdev, flags);
+		if (jobj)
+			json_object_object_add(jdev, "regions", jobj);
+	}
+
 	return jdev;
 }
+
+struct json_object *util_cxl_port_to_json(struct cxl_port *port,
+		unsigned long flags)
+{
+	const char *type, *host = cxl_port_get_host(port);
+	struct cxl_port *parent = cxl_port_get_parent(port);
+	struct json_object *jport, *jobj;
+
+	jport = json_object_new_object();
+	if (!jport)
+		return NULL;
+
+	jobj = json_object_new_string(cxl_port_get_devname(port));
+	if (jobj)
+		json_object_object_add(jport, "port", jobj);
+
+	if (cxl_port_is_root(port))
+		type = "root";
+	else if (cxl_port_is_endpoint(port))
+		type = "endpoint";
+	else
+		type = "switch";
+	jobj = json_object_new_string(type);
+	if (jobj)
+		json_object_object_add(jport, "type", jobj);
+
+	if (host) {
+		jobj = json_object_new_string(host);
+		if (jobj)
+			json_object_object_add(jport, "host", jobj);
+	}
+
+	if (parent) {
+		jobj = json_object_new_string(cxl_port_get_devname(parent));
+		if (jobj)
+			json_object_object_add(jport, "parent", jobj);
+	}
+
+	if (!cxl_port_is_endpoint(port)) {
+		jobj = json_object_new_int(cxl_port_get_nr_dports(port));
+		if (jobj)
+			json_object_object_add(jport, "nr_dports", jobj);
+	}
+
+	return jport;
+}
+
+struct json_object *util_cxl_decoder_to_json(struct cxl_decoder *decoder,
+		unsigned long flags)
+{
+	struct json_object *jdecoder, *jobj;
+	unsigned long long val;
+	const char *str;
+	int ways;
+
+	jdecoder = json_object_new_object();
+	if (!jdecoder)
+		return NULL;
+
+	jobj = json_object_new_string(cxl_decoder_get_devname(decoder));
+	if (jobj)
+		json_object_object_add(jdecoder, "decoder", jobj);
+
+	val = cxl_decoder_get_resource(decoder);
+	if (val < ULLONG_MAX) {
+		jobj = util_json_object_hex(val, flags);
+		if (jobj)
+			json_object_object_add(jdecoder, "resource", jobj);
+	}
+
+	val = cxl_decoder_get_size(decoder);
+	if (val < ULLONG_MAX) {
+		jobj = util_json_object_size(val, flags);
+		if (jobj)
+			json_object_object_add(jdecoder, "size", jobj);
+	}
+
+	val = cxl_decoder_get_dpa_resource(decoder);
+	if (val < ULLONG_MAX) {
+		jobj = util_json_object_hex(val, flags);
+		if (jobj)
+			json_object_object_add(jdecoder, "dpa_resource", jobj);
+	}
+
+	val = cxl_decoder_get_dpa_size(decoder);
+	if (val < ULLONG_MAX) {
+		jobj = util_json_object_size(val, flags);
+		if (jobj)
+			json_object_object_add(jdecoder, "dpa_size", jobj);
+	}
+
+	ways = cxl_decoder_get_interleave_ways(decoder);
+	if (ways > 0) {
+		jobj = json_object_new_int(ways);
+		if (jobj)
+			json_object_object_add(jdecoder, "interleave_ways", jobj);
+		jobj = json_object_new_int(
+			cxl_decoder_get_interleave_granularity(decoder));
+		if (jobj)
+			json_object_object_add(jdecoder,
+					"interleave_granularity", jobj);
+	}
+
+	str = cxl_decoder_get_target_list(decoder);
+	if (str && str[0]) {
+		jobj = json_object_new_string(str);
+		if (jobj)
+			json_object_object_add(jdecoder, "target_list", jobj);
+	}
+
+	str = cxl_decoder_get_mode(decoder);
+	if (str) {
+		jobj = json_object_new_string(str);
+		if (jobj)
+			json_object_object_add(jdecoder, "mode", jobj);
+	}
+
+	return jdecoder;
+}
+
+/* interleave position -> endpoint decoder -> memdev behind it */
+static struct json_object *util_cxl_region_targets_to_json(
+		struct cxl_region *region)
+{
+	struct cxl_ctx *ctx = cxl_region_get_ctx(region);
+	struct json_object *jtargets, *jtarget, *jobj;
+	int i, ways = cxl_region_get_interleave_ways(region);
+	struct cxl_decoder *decoder;
+	struct cxl_memdev *memdev;
+
+	jtargets = json_object_new_array();
+	if (!jtargets)
+		return NULL;
+
+	for (i = 0; i < ways; i++) {
+		decoder = cxl_region_get_target(region, i);
+		if (!decoder)
+			continue;
+		jtarget = json_object_new_object();
+		if (!jtarget)
+			break;
+		jobj = json_object_new_int(i);
+		if (jobj)
+			json_object_object_add(jtarget, "position", jobj);
+		jobj = json_object_new_string(cxl_decoder_get_devname(decoder));
+		if (jobj)
+			json_object_object_add(jtarget, "decoder", jobj);
+		cxl_memdev_foreach(ctx, memdev) {
+			if (cxl_memdev_get_endpoint(memdev)
+					!= cxl_decoder_get_port(decoder))
+				continue;
+			jobj = json_object_new_string(
+					cxl_memdev_get_devname(memdev));
+			if (jobj)
+				json_object_object_add(jtarget, "memdev", jobj);
+			break;
+		}
+		json_object_array_add(jtargets, jtarget);
+	}
+
+	return jtargets;
+}
+
+struct json_object *util_cxl_region_to_json(struct cxl_region *region,
+		unsigned long flags)
+{
+	struct json_object *jregion, *jobj;
+	unsigned long long val;
+	const char *str;
+	int ways;
+
+	jregion = json_object_new_object();
+	if (!jregion)
+		return NULL;
+
+	jobj = json_object_new_string(cxl_region_get_devname(region));
+	if (jobj)
+		json_object_object_add(jregion, "region", jobj);
+
+	val = cxl_region_get_resource(region);
+	if (val < ULLONG_MAX) {
+		jobj = util_json_object_hex(val, flags);
+		if (jobj)
+			json_object_object_add(jregion, "resource", jobj);
+	}
+
+	val = cxl_region_get_size(region);
+	if (val < ULLONG_MAX) {
+		jobj = util_json_object_size(val, flags);
+		if (jobj)
+			json_object_object_add(jregion, "size", jobj);
+	}
+
+	str = cxl_region_get_mode(region);
+	if (str) {
+		jobj = json_object_new_string(str);
+		if (jobj)
+			json_object_object_add(jregion, "mode", jobj);
+	}
+
+	str = cxl_region_get_uuid(region);
+	if (str && str[0]) {
+		jobj = json_object_new_string(str);
+		if (jobj)
+			json_object_object_add(jregion, "uuid", jobj);
+	}
+
+	ways = cxl_region_get_interleave_ways(region);
+	jobj = json_object_new_int(ways);
+	if (jobj)
+		json_object_object_add(jregion, "interleave_ways", jobj);
+
+	jobj = json_object_new_int(
+			cxl_region_get_interleave_granularity(region));
+	if (jobj)
+		json_object_object_add(jregion, "interleave_granularity", jobj);
+
+	if (ways > 0) {
+		jobj = util_cxl_region_targets_to_json(region);
+		if (jobj)
+			json_object_object_add(jregion, "targets", jobj);
+	}
+
+	if (flags & UTIL_JSON_DAX) {
+		struct daxctl_region *dax_region;
+
+		dax_region = cxl_region_get_daxctl_region(region);
+		if (dax_region) {
+			jobj = util_daxctl_region_to_json(dax_region, NULL,
+					flags | UTIL_JSON_DAX_DEVS);
+			if (jobj)
+				json_object_object_add(jregion, "daxregion",
+						jobj);
+		}
+	}
+
+	return jregion;
+}
@@ -19,11 +19,63 @@ enum util_json_flags {
 	UTIL_JSON_CONFIGURED	= (1 << 7),
 	UTIL_JSON_FIRMWARE	= (1 << 8),
 	UTIL_JSON_DAX_MAPPINGS	= (1 << 9),
+	UTIL_JSON_INVENTORY	= (1 << 10),
+	UTIL_JSON_COMMANDS	= (1 << 11),
+	UTIL_JSON_FIELDS	= (1 << 12),
 };
 
 struct json_object;
 void util_display_json_array(FILE *f_out, struct json_object *jarray,
 		unsigned long flags);
+
+/**
+ * struct util_json_stream - array output written element by element
+ * @f_out: where the array goes
+ * @flags: UTIL_JSON_* flags, as for util_display_json_array()
+ * @held: first element, while it may still be the only one
+ * @count: elements written so far
+ */
+struct util_json_stream {
+	FILE *f_out;
+	unsigned long flags;
+	struct json_object *held;
+	int count;
+};
+
+void util_json_stream_init(struct util_json_stream *s, FILE *f_out,
+		unsigned long flags);
+void util_json_stream_add(struct util_json_stream *s,
+		struct json_object *jobj);
+void util_json_stream_add_array(struct util_json_stream *s,
+		struct json_object *jarray);
+void util_json_stream_end(struct util_json_stream *s);
+
+/**
+ * struct util_json_snap - a listing flattened for comparison
+ * @ents: one per identified object, sorted by @ident
+ * @nr: entries used
+ * @alloc: entries allocated
+ */
+struct util_json_snap {
+	struct util_json_snap_ent {
+		char *ident;
+		char *json;
+	} *ents;
+	int nr;
+	int alloc;
+};
+
+int util_json_snap_add(struct util_json_snap *snap, struct json_object *jobj,
+		const char * const *keys);
+int util_json_snap_add_flat(struct util_json_snap *snap,
+		struct json_object *jarray, const char * const *keys);
+int util_json_snap_diff(FILE *f_out, struct util_json_snap *old,
+		struct util_json_snap *new);
+void util_json_snap_free(struct util_json_snap *snap);
+
+int util_json_fields_parse(const char *list);
+bool util_json_want(unsigned long flags, const char *field);
+void util_json_fields_prune(struct json_object *jobj, unsigned long flags);
 struct json_object *util_bus_to_json(struct ndctl_bus *bus,
 		unsigned long flags);
 struct json_object *util_dimm_to_json(struct ndctl_dimm *dimm,
@@ -52,10 +104,21 @@ struct json_object *util_json_object_size(unsigned long long size,
 struct json_object *util_json_object_hex(unsigned long long val,
 		unsigned long flags);
 struct json_object *util_dimm_health_to_json(struct ndctl_dimm *dimm);
+struct json_object *util_dimm_health_batch_to_json(struct ndctl_dimm *dimm,
+		struct ndctl_cmd_batch *smart, struct ndctl_cmd_batch *threshold);
 struct json_object *util_dimm_firmware_to_json(struct ndctl_dimm *dimm,
 		unsigned long flags);
 struct json_object *util_region_capabilities_to_json(struct ndctl_region *region);
 struct cxl_memdev;
 struct json_object *util_cxl_memdev_to_json(struct cxl_memdev *memdev,
 		unsigned long flags);
+struct cxl_port;
+struct json_object *util_cxl_port_to_json(struct cxl_port *port,
+		unsigned long flags);
+struct cxl_decoder;
+struct json_object *util_cxl_decoder_to_json(struct cxl_decoder *decoder,
+		unsigned long flags);
+struct cxl_region;
+struct json_object *util_cxl_region_to_json(struct cxl_region *region,
+		unsigned long flags);
 #endif /* __NDCTL_JSON_H__ */
@@ -5,16 +5,450 @@
 #include <ctype.h>
 #include <string.h>
 #include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
 #include <util/log.h>
 
+/*
+ * Binary logging: with a ring set up, do_log() only stores the format
+ * pointer, the arguments it consumes and a timestamp, and formatting
+ * waits for log_ring_dump(). Everything up to LOG_DEBUG is recorded,
+ * messages within the context's log_priority are still printed as they
+ * happen, and an error first dumps the history that led up to it.
+ * Formats must be string literals, as every log call site passes, since
+ * only the pointer is kept. Records are fixed size, an argument that
+ * does not fit ends the record, and the dump marks it with "...".
+ */
+#define LOG_REC_SIZE 256
+
+struct log_rec {
+	struct timespec ts;
+	const char *file;
+	const char *fn;
+	const char *format;
+	int line;
+	short priority;
+	unsigned short len;
+	char args[LOG_REC_SIZE - sizeof(struct timespec) - 3 * sizeof(char *)
+		- 2 * sizeof(int)];
+};
+
+struct log_ring {
+	pthread_mutex_t lock;
+	unsigned long nr;
+	unsigned long seq;
+	struct log_rec recs[];
+};
+
+enum log_arg {
+	ARG_NONE,
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_SIZE,
+	ARG_PTRDIFF,
+	ARG_INTMAX,
+	ARG_DOUBLE,
+	ARG_LDOUBLE,
+	ARG_PTR,
+	ARG_STR,
+	ARG_ERRNO,
+	ARG_PERCENT,
+};
+
+static const size_t arg_size[] = {
+	[ARG_INT] = sizeof(int),
+	[ARG_LONG] = sizeof(long),
+	[ARG_LLONG] = sizeof(long long),
+	[ARG_SIZE] = sizeof(size_t),
+	[ARG_PTRDIFF] = sizeof(ptrdiff_t),
+	[ARG_INTMAX] = sizeof(intmax_t),
+	[ARG_DOUBLE] = sizeof(double),
+	[ARG_LDOUBLE] = sizeof(long double),
+	[ARG_PTR] = sizeof(void *),
+	[ARG_ERRNO] = sizeof(int),
+};
+
+/*
+ * @p is just past a '%', returns the end of the conversion. @prec is
+ * the precision, -1 without one and -2 when it is passed as the last
+ * star argument.
+ */
+static const char *parse_spec(const char *p, enum log_arg *arg, int *stars,
+		int *prec)
+{
+	enum log_arg len = ARG_INT;
+
+	*stars = 0;
+	*prec = -1;
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	if (*p == '*') {
+		(*stars)++;
+		p++;
+	}
+	while (isdigit(*p))
+		p++;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			(*stars)++;
+			*prec = -2;
+			p++;
+		} else
+			*prec = 0;
+		for (; isdigit(*p); p++)
+			if (*prec < LOG_REC_SIZE)
+				*prec = *prec * 10 + *p - '0';
+	}
+	switch (*p) {
+	case 'h':
+		p += p[1] == 'h' ? 2 : 1;
+		break;
+	case 'l':
+		len = p[1] == 'l' ? ARG_LLONG : ARG_LONG;
+		p += p[1] == 'l' ? 2 : 1;
+		break;
+	case 'q':
+	case 'L':
+		len = *p == 'L' ? ARG_LDOUBLE : ARG_LLONG;
+		p++;
+		break;
+	case 'z':
+		len = ARG_SIZE;
+		p++;
+		break;
+	case 't':
+		len = ARG_PTRDIFF;
+		p++;
+		break;
+	case 'j':
+		len = ARG_INTMAX;
+		p++;
+		break;
+	}
+
+	switch (*p) {
+	case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+		*arg = len == ARG_LDOUBLE ? ARG_LLONG : len;
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+	case 'a': case 'A':
+		*arg = len == ARG_LDOUBLE ? ARG_LDOUBLE : ARG_DOUBLE;
+		break;
+	case 'p':
+		*arg = ARG_PTR;
+		break;
+	case 's':
+		*arg = ARG_STR;
+		break;
+	case 'm':
+		*arg = ARG_ERRNO;
+		break;
+	case '%':
+		*arg = ARG_PERCENT;
+		break;
+	case '\0':
+		*arg = ARG_NONE;
+		return p;
+	default:
+		/* e.g. %n, nothing is stored for it or after it */
+		*arg = ARG_NONE;
+		break;
+	}
+	return p + 1;
+}
+
+static unsigned short pack_args(struct log_rec *rec, const char *format,
+		va_list args)
+{
+	char *out = rec->args, *end = rec->args + sizeof(rec->args);
+	union {
+		int i;
+		long l;
+		long long ll;
+		size_t z;
+		ptrdiff_t t;
+		intmax_t j;
+		double d;
+		long double ld;
+		void *p;
+	} v;
+	const char *p = format;
+	enum log_arg arg;
+	int stars, prec, i;
+
+	while ((p = strchr(p, '%'))) {
+		p = parse_spec(p + 1, &arg, &stars, &prec);
+		if (arg == ARG_NONE)
+			break;
+		if (arg == ARG_PERCENT)
+			continue;
+		for (i = 0; i < stars; i++) {
+			v.i = va_arg(args, int);
+			if (out + sizeof(int) > end)
+				return sizeof(rec->args) + 1;
+			memcpy(out, &v.i, sizeof(int));
+			out += sizeof(int);
+		}
+		/* a negative star precision is taken as none */
+		if (prec == -2)
+			prec = v.i < 0 ? -1 : v.i;
+		switch (arg) {
+		case ARG_STR: {
+			const char *s = va_arg(args, const char *) ?: "(null)";
+			size_t len = end - out - 1;
+
+			/* a long string is cut, what follows it is lost */
+			if (out + 1 >= end)
+				return sizeof(rec->args) + 1;
+			/* with a precision @s need not be terminated */
+			if (prec >= 0 && (size_t) prec < len)
+				len = prec;
+			len = strnlen(s, len);
+			memcpy(out, s, len);
+			out[len] = '\0';
+			out += len + 1;
+			continue;
+		}
+		case ARG_INT: v.i = va_arg(args, int); break;
+		case ARG_LONG: v.l = va_arg(args, long); break;
+		case ARG_LLONG: v.ll = va_arg(args, long long); break;
+		case ARG_SIZE: v.z = va_arg(args, size_t); break;
+		case ARG_PTRDIFF: v.t = va_arg(args, ptrdiff_t); break;
+		case ARG_INTMAX: v.j = va_arg(args, intmax_t); break;
+		case ARG_DOUBLE: v.d = va_arg(args, double); break;
+		case ARG_LDOUBLE: v.ld = va_arg(args, long double); break;
+		case ARG_PTR: v.p = va_arg(args, void *); break;
+		case ARG_ERRNO: v.i = errno; break;
+		default: break;
+		}
+		if (out + arg_size[arg] > end)
+			return sizeof(rec->args) + 1;
+		memcpy(out, &v, arg_size[arg]);
+		out += arg_size[arg];
+	}
+	return out - rec->args;
+}
+
+static void ring_record(struct log_ring *ring, int priority, const char *file,
+		int line, const char *fn, const char *format, va_list args)
+{
+	struct log_rec *rec;
+
+	pthread_mutex_lock(&ring->lock);
+	rec = &ring->recs[ring->seq++ % ring->nr];
+	clock_gettime(CLOCK_REALTIME, &rec->ts);
+	rec->file = file;
+	rec->line = line;
+	rec->fn = fn;
+	rec->format = format;
+	rec->priority = priority;
+	rec->len = pack_args(rec, format, args);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+#define SPEC_PRINT(buf, len, spec, stars, s, val) \
+	((stars) == 0 ? snprintf(buf, len, spec, val) \
+	 : (stars) == 1 ? snprintf(buf, len, spec, s[0], val) \
+	 : snprintf(buf, len, spec, s[0], s[1], val))
+
+/* render @rec into @buf, the reverse of pack_args() */
+static void format_rec(struct log_rec *rec, char *buf, size_t size)
+{
+	size_t len = rec->len > sizeof(rec->args) ? sizeof(rec->args) : rec->len;
+	const char *in = rec->args, *end = rec->args + len;
+	const char *p = rec->format, *q;
+	char *out = buf, spec[32];
+	size_t left = size;
+	enum log_arg arg;
+	int stars, prec, s[2], n, i;
+
+#define EMIT(n) do { \
+	if ((n) < 0) goto out; \
+	if ((size_t) (n) >= left) { out += left - 1; left = 1; goto out; } \
+	out += (n); left -= (n); \
+} while (0)
+
+	while ((q = strchr(p, '%'))) {
+		n = snprintf(out, left, "%.*s", (int) (q - p), p);
+		EMIT(n);
+		p = parse_spec(q + 1, &arg, &stars, &prec);
+		if (arg == ARG_NONE || p - q >= (int) sizeof(spec))
+			goto out;
+		if (arg == ARG_PERCENT) {
+			n = snprintf(out, left, "%%");
+			EMIT(n);
+			continue;
+		}
+		if (in + stars * sizeof(int) + (arg == ARG_STR ? 1
+					: arg_size[arg]) > end) {
+			n = snprintf(out, left, "...");
+			EMIT(n);
+			goto out;
+		}
+		for (i = 0; i < stars; i++, in += sizeof(int))
+			memcpy(&s[i], in, sizeof(int));
+		memcpy(spec, q, p - q);
+		spec[p - q] = '\0';
+
+		switch (arg) {
+		case ARG_STR:
+			n = SPEC_PRINT(out, left, spec, stars, s, in);
+			in += strlen(in) + 1;
+			EMIT(n);
+			continue;
+		case ARG_ERRNO: {
+			int e;
+
+			memcpy(&e, in, sizeof(e));
+			n = snprintf(out, left, "%s", strerror(e));
+			break;
+		}
+#define ARG_CASE(a, type) \
+		case a: { \
+			type v; \
+			memcpy(&v, in, sizeof(v)); \
+			n = SPEC_PRINT(out, left, spec, stars, s, v); \
+			break; \
+		}
+		ARG_CASE(ARG_INT, int)
+		ARG_CASE(ARG_LONG, long)
+		ARG_CASE(ARG_LLONG, long long)
+		ARG_CASE(ARG_SIZE, size_t)
+		ARG_CASE(ARG_PTRDIFF, ptrdiff_t)
+		ARG_CASE(ARG_INTMAX, intmax_t)
+		ARG_CASE(ARG_DOUBLE, double)
+		ARG_CASE(ARG_LDOUBLE, long double)
+		ARG_CASE(ARG_PTR, void *)
+#undef ARG_CASE
+		default:
+			goto out;
+		}
+		in += arg_size[arg];
+		EMIT(n);
+	}
+	n = snprintf(out, left, "%s", p);
+	EMIT(n);
+out:
+	*out = '\0';
+	/* a cut record still ends its line */
+	if (*p && rec->format[strlen(rec->format) - 1] == '\n'
+			&& out > buf && out[-1] != '\n') {
+		if (left < 2)
+			out--;
+		strcpy(out, "\n");
+	}
+#undef EMIT
+}
+
+static void log_emit(struct log_ctx *ctx, int priority, const char *file,
+		int line, const char *fn, const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	ctx->log_fn(ctx, 1, priority, file, line, fn, format, args);
+	va_end(args);
+}
+
+static void ring_dump(struct log_ctx *ctx, struct log_ring *ring)
+{
+	unsigned long i = ring->seq > ring->nr ? ring->seq - ring->nr : 0;
+	char buf[1024];
+
+	for (; i < ring->seq; i++) {
+		struct log_rec *rec = &ring->recs[i % ring->nr];
+
+		format_rec(rec, buf, sizeof(buf));
+		log_emit(ctx, rec->priority, rec->file, rec->line, rec->fn,
+				"[%10ld.%09ld] %s", (long) rec->ts.tv_sec,
+				rec->ts.tv_nsec, buf);
+	}
+	ring->seq = 0;
+}
+
+/**
+ * log_ring_dump - format and emit every recorded message, oldest first
+ * @ctx: log context with a ring, a no-op without
+ *
+ * Messages go to the context's log function, the ring is left empty.
+ */
+void log_ring_dump(struct log_ctx *ctx)
+{
+	struct log_ring *ring = ctx->ring;
+
+	if (!ring)
+		return;
+	pthread_mutex_lock(&ring->lock);
+	ring_dump(ctx, ring);
+	pthread_mutex_unlock(&ring->lock);
+}
+
+/**
+ * log_ring_enable - record messages in memory instead of formatting them
+ * @ctx: log context
+ * @size: bytes of ring, rounded down to whole records, 0 to disable
+ *
+ * Everything up to LOG_DEBUG is recorded whatever the log_priority,
+ * which keeps deciding what is printed right away.
+ */
+int log_ring_enable(struct log_ctx *ctx, unsigned long size)
+{
+	struct log_ring *ring = NULL;
+	unsigned long nr = size / sizeof(struct log_rec);
+
+	if (size && !nr)
+		return -EINVAL;
+	if (nr) {
+		ring = calloc(1, sizeof(*ring) + nr * sizeof(struct log_rec));
+		if (!ring)
+			return -ENOMEM;
+		pthread_mutex_init(&ring->lock, NULL);
+		ring->nr = nr;
+	}
+	log_exit(ctx);
+	ctx->ring = ring;
+	if (ring)
+		ctx->record_priority = LOG_DEBUG;
+	return 0;
+}
+
+/* release the ring, and anything still in it is lost */
+void log_exit(struct log_ctx *ctx)
+{
+	struct log_ring *ring = ctx->ring;
+
+	if (!ring)
+		return;
+	ctx->ring = NULL;
+	ctx->record_priority = -1;
+	pthread_mutex_destroy(&ring->lock);
+	free(ring);
+}
+
 void do_log(struct log_ctx *ctx, int loud, int priority, const char *file,
 		int line, const char *fn, const char *format, ...)
 {
 	va_list args;
 	int errno_save = errno;
+	struct log_ring *ring = ctx->ring;
 
 	va_start(args, format);
-	ctx->log_fn(ctx, loud, priority, file, line, fn, format, args);
+	if (ring && priority <= LOG_ERR) {
+		/* what led up to an error is the point of keeping it */
+		log_ring_dump(ctx);
+	} else if (ring) {
+		va_list copy;
+
+		va_copy(copy, args);
+		ring_record(ring, priority, file, line, fn, format, copy);
+		va_end(copy);
+	}
+	if (priority <= ctx->log_priority)
+		ctx->log_fn(ctx, loud, priority, file, line, fn, format, args);
 	va_end(args);
 	errno = errno_save;
 }
@@ -46,16 +480,43 @@ static int log_priority(const char *priority)
 	return 0;
 }
 
+static unsigned long ring_size(const char *size)
+{
+	char *end;
+	unsigned long val = strtoul(size, &end, 0);
+
+	switch (tolower(*end)) {
+	case 'g':
+		val <<= 10;
+		/* fallthrough */
+	case 'm':
+		val <<= 10;
+		/* fallthrough */
+	case 'k':
+		val <<= 10;
+	}
+	return val;
+}
+
 void log_init(struct log_ctx *ctx, const char *owner, const char *log_env)
 {
+	char ring_env[64];
 	const char *env;
 
 	ctx->owner = owner;
 	ctx->log_fn = log_stderr;
 	ctx->log_priority = LOG_ERR;
+	ctx->record_priority = -1;
+	ctx->ring = NULL;
 
 	/* environment overwrites config */
 	env = secure_getenv(log_env);
 	if (env != NULL)
 		ctx->log_priority = log_priority(env);
+
+	/* e.g. NDCTL_LOG_RING=1M, see log_ring_enable() */
+	snprintf(ring_env, sizeof(ring_env), "%s_RING", log_env);
+	env = secure_getenv(ring_env);
+	if (env != NULL)
+		log_ring_enable(ctx, ring_size(env));
 }
@@ -10,10 +10,15 @@ struct log_ctx;
 typedef void (*log_fn)(struct log_ctx *ctx, int loud, int priority, const char *file,
 		int line, const char *fn, const char *format, va_list args);
 
+struct log_ring;
+
 struct log_ctx {
 	log_fn log_fn;
 	const char *owner;
 	int log_priority;
+	/* with a ring, the priority recorded up to, see log_ring_enable() */
+	int record_priority;
+	struct log_ring *ring;
 };
 
 
@@ -21,12 +26,15 @@ void do_log(struct log_ctx *ctx, int loud, int priority, const char *file, int l
 		const char *fn, const char *format, ...)
 	__attribute__((format(printf, 7, 8)));
 void log_init(struct log_ctx *ctx, const char *owner, const char *log_env);
+int log_ring_enable(struct log_ctx *ctx, unsigned long size);
+void log_ring_dump(struct log_ctx *ctx);
+void log_exit(struct log_ctx *ctx);
 static inline void __attribute__((always_inline, format(printf, 2, 3)))
 	log_null(struct log_ctx *ctx, const char *format, ...) {}
 
 #define log_cond(ctx, loud, prio, arg...) \
 do { \
-	if ((ctx)->log_priority >= prio) \
+	if ((ctx)->log_priority >= prio || (ctx)->record_priority >= prio) \
 		do_log(ctx, loud, prio, __FILE__, __LINE__, __FUNCTION__, ## arg); \
 } while (0)
 
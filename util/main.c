@@ -15,6 +15,34 @@
 #include <util/strbuf.h>
 #include <util/util.h>
 #include <util/main.h>
+#include <util/pool.h>
+
+/* -j <n>, -j<n>, --jobs <n>, --jobs=<n>, returns how many args it took */
+static int main_handle_jobs(const char **argv, int argc, const char *usage_msg)
+{
+	const char *cmd = argv[0], *val = NULL;
+	int used = 1;
+	char *end;
+
+	if (!strcmp(cmd, "-j") || !strcmp(cmd, "--jobs")) {
+		if (argc > 1)
+			val = argv[used++];
+	} else if (!strncmp(cmd, "--jobs=", 7))
+		val = cmd + 7;
+	else
+		val = cmd + 2;
+
+	if (!val || !*val)
+		goto err;
+	errno = 0;
+	util_pool_max_jobs = strtoul(val, &end, 0);
+	if (errno || *end || !util_pool_max_jobs)
+		goto err;
+	return used;
+ err:
+	fprintf(stderr, "%s: expects a thread count greater than zero\n", cmd);
+	usage(usage_msg);
+}
 
 int main_handle_options(const char ***argv, int *argc, const char *usage_msg,
 		struct cmd_struct *cmds, int num_cmds)
@@ -43,7 +71,13 @@ int main_handle_options(const char ***argv, int *argc, const char *usage_msg,
 			break;
 		}
 
-		if (!strcmp(cmd, "--list-cmds")) {
+		if (!strncmp(cmd, "-j", 2) || !strcmp(cmd, "--jobs")
+				|| !strncmp(cmd, "--jobs=", 7)) {
+			int used = main_handle_jobs(*argv, *argc, usage_msg);
+
+			(*argv) += used - 1;
+			(*argc) -= used - 1;
+		} else if (!strcmp(cmd, "--list-cmds")) {
 			int i;
 
 			for (i = 0; i < num_cmds; i++) {
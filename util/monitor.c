@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: GPL-2.0
+// Copyright (C) 2018, FUJITSU LIMITED. All rights reserved.
+#include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <util/util.h>
+#include <util/strbuf.h>
+
+/* config-file diagnostics go to the monitor's own logger */
+#ifndef ENABLE_LOGGING
+#define ENABLE_LOGGING
+#endif
+#ifndef ENABLE_DEBUG
+#define ENABLE_DEBUG
+#endif
+#include <util/monitor.h>
+#define BUF_SIZE 2048
+
+static FILE *monitor_log_file;
+
+void util_monitor_log_syslog(struct log_ctx *ctx, int loud, int priority,
+		const char *file, int line, const char *fn, const char *format,
+		va_list args)
+{
+	vsyslog(priority, format, args);
+}
+
+void util_monitor_log_standard(struct log_ctx *ctx, int loud, int priority,
+		const char *file, int line, const char *fn, const char *format,
+		va_list args)
+{
+	if (priority == 6)
+		vfprintf(stdout, format, args);
+	else
+		vfprintf(stderr, format, args);
+}
+
+static void util_monitor_log_file(struct log_ctx *ctx, int loud, int priority,
+		const char *file, int line, const char *fn, const char *format,
+		va_list args)
+{
+	FILE *f = monitor_log_file;
+
+	if (priority != LOG_NOTICE) {
+		struct timespec ts;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		fprintf(f, "[%10ld.%09ld] [%d] ", ts.tv_sec, ts.tv_nsec, getpid());
+		vfprintf(f, format, args);
+	} else
+		vfprintf(f, format, args);
+
+	fflush(f);
+}
+
+/*
+ * Point @ctx at the notification target named by @log: "syslog",
+ * "standard", or a file that is opened for append. @log is rewritten
+ * relative to @prefix.
+ */
+int util_monitor_set_log(struct log_ctx *ctx, const char **log,
+		const char *prefix)
+{
+	if (strncmp(*log, "./", 2) != 0)
+		fix_filename(prefix, log);
+	if (strncmp(*log, "./syslog", 8) == 0)
+		ctx->log_fn = util_monitor_log_syslog;
+	else if (strncmp(*log, "./standard", 10) == 0)
+		ctx->log_fn = util_monitor_log_standard;
+	else {
+		monitor_log_file = fopen(*log, "a+");
+		if (!monitor_log_file) {
+			error("open %s failed\n", *log);
+			return -errno;
+		}
+		ctx->log_fn = util_monitor_log_file;
+	}
+
+	return 0;
+}
+
+bool util_monitor_log_is_file(void)
+{
+	return monitor_log_file != NULL;
+}
+
+void util_monitor_close_log(void)
+{
+	if (monitor_log_file)
+		fclose(monitor_log_file);
+	monitor_log_file = NULL;
+}
+
+/*
+ * Append @value to *@arg when @key names the option @ident, so that
+ * a value from the configuration file adds to, rather than replaces,
+ * the one given on the command line.
+ */
+void util_config_append(const char **arg, const char *ident, const char *key,
+		const char *value)
+{
+	struct strbuf buf = STRBUF_INIT;
+	size_t arg_len = *arg ? strlen(*arg) : 0;
+
+	if (!ident || !key || (strcmp(ident, key) != 0))
+		return;
+
+	if (arg_len) {
+		strbuf_add(&buf, *arg, arg_len);
+		strbuf_addstr(&buf, " ");
+	}
+	strbuf_addstr(&buf, value);
+	*arg = strbuf_detach(&buf, NULL);
+}
+
+/*
+ * Call @fn for every <key> = <value> line of @config_file. A missing
+ * file is only an error when @required.
+ */
+int util_read_config_file(struct log_ctx *ctx, const char *config_file,
+		bool required, util_config_fn fn, void *arg)
+{
+	FILE *f;
+	size_t len = 0;
+	int line = 0, rc = 0;
+	char *buf, *seek, *value;
+
+	buf = malloc(BUF_SIZE);
+	if (!buf) {
+		log_err(ctx, "malloc read config-file buf error\n");
+		return -ENOMEM;
+	}
+
+	f = fopen(config_file, "r");
+	if (!f) {
+		if (required) {
+			log_err(ctx, "config-file: %s cannot be opened\n",
+				config_file);
+			rc = -errno;
+		}
+		goto out;
+	}
+
+	while (fgets(buf, BUF_SIZE, f)) {
+		seek = buf;
+		value = NULL;
+		line++;
+
+		while (isspace(*seek))
+			seek++;
+
+		if (*seek == '#' || *seek == '\0')
+			continue;
+
+		value = strchr(seek, '=');
+		if (!value) {
+			log_err(ctx, "config-file syntax error, skip line[%i]\n",
+					line);
+			continue;
+		}
+
+		value[0] = '\0';
+		value++;
+
+		while (isspace(value[0]))
+			value++;
+
+		len = strlen(seek);
+		if (len == 0)
+			continue;
+		while (isspace(seek[len-1]))
+			len--;
+		seek[len] = '\0';
+
+		len = strlen(value);
+		if (len == 0)
+			continue;
+		while (isspace(value[len-1]))
+			len--;
+		value[len] = '\0';
+
+		if (len == 0)
+			continue;
+
+		fn(seek, value, arg);
+	}
+	fclose(f);
+out:
+	free(buf);
+	return rc;
+}
+
+/*
+ * Kernel uevents, for the commands that follow topology changes as
+ * they happen rather than rescanning on a timer. The socket is
+ * non-blocking, poll it for POLLIN.
+ */
+int util_uevent_open(void)
+{
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1,
+	};
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+			NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -errno;
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -errno;
+	}
+	return fd;
+}
+
+/* drain pending uevents, true if any was for one of @subsystems */
+bool util_uevent_match(int fd, const char * const *subsystems)
+{
+	char buf[8192];
+	bool match = false;
+	ssize_t len;
+
+	while ((len = recv(fd, buf, sizeof(buf) - 1, 0)) > 0) {
+		const char * const *s;
+		char *p;
+
+		buf[len] = '\0';
+		for (p = buf; p < buf + len; p += strlen(p) + 1) {
+			if (strncmp(p, "SUBSYSTEM=", 10) != 0)
+				continue;
+			for (s = subsystems; *s; s++)
+				if (strcmp(p + 10, *s) == 0)
+					match = true;
+			break;
+		}
+	}
+	return match;
+}
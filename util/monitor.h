@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UTIL_MONITOR_H_
+#define _UTIL_MONITOR_H_
+#include <stdbool.h>
+#include <util/log.h>
+
+/*
+ * Helpers shared by 'ndctl monitor' and 'cxl monitor': notification
+ * loggers, the <key> = <value> configuration file format, and uevents.
+ */
+void util_monitor_log_syslog(struct log_ctx *ctx, int loud, int priority,
+		const char *file, int line, const char *fn, const char *format,
+		va_list args);
+void util_monitor_log_standard(struct log_ctx *ctx, int loud, int priority,
+		const char *file, int line, const char *fn, const char *format,
+		va_list args);
+int util_monitor_set_log(struct log_ctx *ctx, const char **log,
+		const char *prefix);
+bool util_monitor_log_is_file(void);
+void util_monitor_close_log(void);
+
+typedef void (*util_config_fn)(const char *key, const char *value, void *arg);
+int util_read_config_file(struct log_ctx *ctx, const char *config_file,
+		bool required, util_config_fn fn, void *arg);
+void util_config_append(const char **arg, const char *ident, const char *key,
+		const char *value);
+
+int util_uevent_open(void);
+bool util_uevent_match(int fd, const char * const *subsystems);
+#endif /* _UTIL_MONITOR_H_ */
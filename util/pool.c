@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <util/pool.h>
+#include <ccan/minmax/minmax.h>
+
+unsigned int util_pool_max_jobs;
+
+/*
+ * Walk the kernel's cpulist / nodelist format, e.g. "0-3,8,10-11",
+ * empty for a memory-only node
+ */
+static int read_id_list(const char *path,
+		void (*fn)(unsigned long id, void *arg), void *arg)
+{
+	unsigned long first, last;
+	char buf[4096], *p, *end;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	p = fgets(buf, sizeof(buf), f);
+	fclose(f);
+	if (!p)
+		return -ENXIO;
+
+	for (; *p && *p != '\n'; p = end) {
+		first = strtoul(p, &end, 10);
+		if (end == p)
+			return -EINVAL;
+		last = first;
+		if (*end == '-')
+			last = strtoul(end + 1, &end, 10);
+		for (; first <= last; first++)
+			fn(first, arg);
+		if (*end == ',')
+			end++;
+	}
+	return 0;
+}
+
+static void cpu_set(unsigned long cpu, void *cpus)
+{
+	if (cpu < CPU_SETSIZE)
+		CPU_SET(cpu, (cpu_set_t *) cpus);
+}
+
+/* cpus of @node, returns how many or a negative error */
+int node_get_cpus(int node, cpu_set_t *cpus)
+{
+	char path[64];
+	int rc;
+
+	CPU_ZERO(cpus);
+	sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+	rc = read_id_list(path, cpu_set, cpus);
+	if (rc < 0)
+		return rc;
+	return CPU_COUNT(cpus) ? CPU_COUNT(cpus) : -ENXIO;
+}
+
+struct node_list {
+	int *nodes;
+	int nr, max;
+};
+
+static void node_add(unsigned long node, void *arg)
+{
+	struct node_list *l = arg;
+
+	if (l->nr < l->max)
+		l->nodes[l->nr] = node;
+	l->nr++;
+}
+
+/*
+ * Up to @nr nodes that have cpus into @nodes, returns how many there
+ * are in total, or a negative error
+ */
+int node_get_cpu_nodes(int *nodes, int nr)
+{
+	struct node_list l = { .nodes = nodes, .max = nr };
+	int rc;
+
+	rc = read_id_list("/sys/devices/system/node/has_cpu", node_add, &l);
+	return rc < 0 ? rc : l.nr;
+}
+
+unsigned int util_pool_jobs(unsigned int jobs)
+{
+	if (!jobs)
+		jobs = max(sysconf(_SC_NPROCESSORS_ONLN), 1L);
+	if (util_pool_max_jobs && jobs > util_pool_max_jobs)
+		jobs = util_pool_max_jobs;
+	return jobs;
+}
+
+/* queue 0 takes the items that may run anywhere, queue n + 1 node n's */
+struct pool_queue {
+	int *idx;
+	int nr;
+	int next;
+};
+
+struct pool_thread {
+	struct util_pool *pool;
+	struct pool_queue *queues;
+	int nr_queues;
+	int home;
+	pthread_t thread;
+};
+
+static void *pool_worker(void *arg)
+{
+	struct pool_thread *t = arg;
+	struct util_pool *pool = t->pool;
+	struct pool_queue *q;
+	int i, n, empty = 0;
+
+	/* drain the home queue, then steal, until a full pass finds nothing */
+	for (n = t->home; empty < t->nr_queues; n = (n + 1) % t->nr_queues) {
+		q = &t->queues[n];
+		empty++;
+		while ((i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED))
+				< q->nr) {
+			pool->run(pool->arg, q->idx[i]);
+			empty = 0;
+		}
+	}
+	return NULL;
+}
+
+void util_pool_run(struct util_pool *pool)
+{
+	int i, n, nr_queues = 1, nr_threads, started, *idx, *node = NULL;
+	struct pool_queue *queues = NULL;
+	struct pool_thread *threads;
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+
+	if (pool->nr <= 0)
+		return;
+	nr_threads = min_t(int, util_pool_jobs(pool->jobs), pool->nr);
+
+	idx = calloc(pool->nr, sizeof(*idx));
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (pool->node)
+		node = calloc(pool->nr, sizeof(*node));
+	for (i = 0; node && i < pool->nr; i++) {
+		node[i] = max(pool->node(pool->arg, i), -1);
+		nr_queues = max(nr_queues, node[i] + 2);
+	}
+	if (idx && threads && (node || !pool->node))
+		queues = calloc(nr_queues, sizeof(*queues));
+	if (!queues) {
+		/* no memory to spread the work, run it all here */
+		for (i = 0; i < pool->nr; i++)
+			pool->run(pool->arg, i);
+		goto out;
+	}
+
+	for (i = 0; i < pool->nr; i++)
+		queues[node ? node[i] + 1 : 0].nr++;
+	for (n = 0, i = 0; n < nr_queues; i += queues[n++].nr)
+		queues[n].idx = &idx[i];
+	for (i = 0; i < nr_queues; i++)
+		queues[i].nr = 0;
+	for (i = 0; i < pool->nr; i++) {
+		struct pool_queue *q = &queues[node ? node[i] + 1 : 0];
+
+		q->idx[q->nr++] = i;
+	}
+
+	/*
+	 * The calling thread keeps its affinity and starts on the
+	 * anywhere queue, the others are dealt out over the nodes that
+	 * have work, and pinned there when the node has cpus.
+	 */
+	for (i = 0; i < nr_threads; i++) {
+		threads[i].pool = pool;
+		threads[i].queues = queues;
+		threads[i].nr_queues = nr_queues;
+	}
+	/* with no node queues, every thread shares the anywhere queue */
+	n = nr_queues > 1 ? 1 : 0;
+	for (started = 1; started < nr_threads; n = (n + 1) % nr_queues) {
+		struct pool_thread *t = &threads[started];
+
+		if (!queues[n].nr)
+			continue;
+		t->home = n;
+		pthread_attr_init(&attr);
+		if (n && node_get_cpus(n - 1, &cpus) > 0)
+			pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+		i = pthread_create(&t->thread, &attr, pool_worker, t);
+		pthread_attr_destroy(&attr);
+		if (i)
+			break;
+		started++;
+	}
+	/* this thread takes a share too, and whatever could not be handed out */
+	pool_worker(&threads[0]);
+	while (--started)
+		pthread_join(threads[started].thread, NULL);
+ out:
+	free(queues);
+	free(node);
+	free(threads);
+	free(idx);
+}
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _NDCTL_POOL_H_
+#define _NDCTL_POOL_H_
+#include <sched.h>
+
+/*
+ * Thread pool shared by the --jobs paths of ndctl, daxctl and cxl. A
+ * batch of @nr independent work items, @run(@arg, 0..nr-1), is spread
+ * over up to @jobs threads, the calling thread included, and
+ * util_pool_run() returns once every item has run.
+ *
+ * When @node is given, items are queued per numa node and the threads
+ * set up for a node are pinned to its cpus, so work runs close to the
+ * device it touches. A thread whose own queue is empty steals from the
+ * other nodes' queues before giving up, so no item waits on a busy node
+ * while other threads idle. Items within one queue start in index order.
+ */
+struct util_pool {
+	void *arg;
+	int nr;
+	unsigned int jobs;
+	void (*run)(void *arg, int idx);
+	/* numa node for item @idx, or -1 for anywhere */
+	int (*node)(void *arg, int idx);
+};
+
+void util_pool_run(struct util_pool *pool);
+
+/*
+ * Global thread limit, from the top level '-j' / '--jobs' option. Every
+ * parallel path passes its own --jobs value through util_pool_jobs(),
+ * which substitutes one per online cpu for 0 and applies the limit.
+ * The libraries get the limit through their *_set_max_threads() call.
+ */
+extern unsigned int util_pool_max_jobs;
+unsigned int util_pool_jobs(unsigned int jobs);
+
+int node_get_cpus(int node, cpu_set_t *cpus);
+int node_get_cpu_nodes(int *nodes, int nr);
+#endif /* _NDCTL_POOL_H_ */
@@ -13,36 +13,268 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#ifdef HAVE_LIBURING
+#include <stdint.h>
+#include <stdbool.h>
+#include <liburing.h>
+#endif
 
 #include <util/log.h>
 #include <util/sysfs.h>
+#include <util/usdt.h>
 
-int __sysfs_read_attr(struct log_ctx *ctx, const char *path, char *buf)
+/* @n is the byte count read() returned, or -errno */
+static int read_done(struct log_ctx *ctx, const char *path, char *buf, int n)
+{
+	if (n >= SYSFS_ATTR_SIZE)
+		n = -EFBIG;
+	if (n < 0) {
+		buf[0] = 0;
+		log_dbg(ctx, "failed to read %s: %s\n", path, strerror(-n));
+		return n;
+	}
+	buf[n] = 0;
+	if (n && buf[n-1] == '\n')
+		buf[n-1] = 0;
+	return 0;
+}
+
+static int read_attr(struct log_ctx *ctx, int fd, const char *path,
+		char *buf)
 {
-	int fd = open(path, O_RDONLY|O_CLOEXEC);
 	int n;
 
 	if (fd < 0) {
 		log_dbg(ctx, "failed to open %s: %s\n", path, strerror(errno));
 		return -errno;
 	}
+	usdt(sysfs, read_start, path);
 	n = read(fd, buf, SYSFS_ATTR_SIZE);
+	if (n < 0)
+		n = -errno;
+	usdt(sysfs, read_done, path, n);
 	close(fd);
-	if (n < 0 || n >= SYSFS_ATTR_SIZE) {
-		buf[0] = 0;
-		log_dbg(ctx, "failed to read %s: %s\n", path, strerror(errno));
-		return -errno;
+	return read_done(ctx, path, buf, n);
+}
+
+int __sysfs_read_attr(struct log_ctx *ctx, const char *path, char *buf)
+{
+	return read_attr(ctx, open(path, O_RDONLY|O_CLOEXEC), path, buf);
+}
+
+/*
+ * @dirfd is a handle from __sysfs_open_dev(), so only @attr, relative
+ * to the device directory, is looked up rather than the full path.
+ */
+int __sysfs_read_attr_at(struct log_ctx *ctx, int dirfd, const char *attr,
+		char *buf)
+{
+	return read_attr(ctx, openat(dirfd, attr, O_RDONLY|O_CLOEXEC), attr,
+			buf);
+}
+
+static void read_attrs_sync(struct log_ctx *ctx, struct sysfs_attr_req *reqs,
+		int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		reqs[i].rc = read_attr(ctx, openat(reqs[i].dirfd, reqs[i].attr,
+					O_RDONLY|O_CLOEXEC), reqs[i].attr,
+				reqs[i].buf);
+}
+
+#ifdef HAVE_LIBURING
+/* below this many reads, setting up a ring costs more than it saves */
+#define SYSFS_BATCH_MIN 4
+#define SYSFS_RING_DEPTH 64
+
+enum {
+	SYSFS_OPEN,
+	SYSFS_READ,
+	SYSFS_CLOSE,
+};
+
+/* openat, read and close through io_uring need v5.6 or later */
+static bool uring_supported(void)
+{
+	static int supported;
+	struct io_uring_probe *probe;
+	int s = __atomic_load_n(&supported, __ATOMIC_RELAXED);
+
+	if (s)
+		return s > 0;
+	probe = io_uring_get_probe();
+	if (probe && io_uring_opcode_supported(probe, IORING_OP_OPENAT)
+			&& io_uring_opcode_supported(probe, IORING_OP_READ)
+			&& io_uring_opcode_supported(probe, IORING_OP_CLOSE))
+		s = 1;
+	else
+		s = -1;
+	if (probe)
+		io_uring_free_probe(probe);
+	__atomic_store_n(&supported, s, __ATOMIC_RELAXED);
+	return s > 0;
+}
+
+/*
+ * After a failed submit or wait, reap whatever is still in flight, so
+ * that no open goes unrecorded in @fds, where the close phase or the
+ * caller finds it, and no read lands in a buffer after the fallback.
+ */
+static void uring_drain(struct io_uring *ring, int *fds, int phase)
+{
+	struct __kernel_timespec ts = { .tv_nsec = 100000000 };
+	struct io_uring_cqe *cqe;
+	int idx, rc;
+
+	for (;;) {
+		rc = io_uring_wait_cqe_timeout(ring, &cqe, &ts);
+		if (rc == -EINTR)
+			continue;
+		if (rc < 0)
+			break;
+		idx = (uintptr_t) io_uring_cqe_get_data(cqe);
+		if (phase == SYSFS_OPEN)
+			fds[idx] = cqe->res;
+		else if (phase == SYSFS_CLOSE)
+			fds[idx] = -1;
+		io_uring_cqe_seen(ring, cqe);
+	}
+}
+
+/* issue @phase for every request that is still live, a ring's worth at a time */
+static int uring_phase(struct log_ctx *ctx, struct io_uring *ring,
+		struct sysfs_attr_req *reqs, int *fds, int nr, int phase)
+{
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	int i = 0, idx, queued, rc;
+
+	while (i < nr) {
+		for (queued = 0; i < nr && queued < SYSFS_RING_DEPTH; i++) {
+			if (phase != SYSFS_OPEN && fds[i] < 0)
+				continue;
+			sqe = io_uring_get_sqe(ring);
+			if (!sqe)
+				break;
+			if (phase == SYSFS_OPEN)
+				io_uring_prep_openat(sqe, reqs[i].dirfd,
+						reqs[i].attr,
+						O_RDONLY|O_CLOEXEC, 0);
+			else if (phase == SYSFS_READ)
+				io_uring_prep_read(sqe, fds[i], reqs[i].buf,
+						SYSFS_ATTR_SIZE, 0);
+			else
+				io_uring_prep_close(sqe, fds[i]);
+			io_uring_sqe_set_data(sqe, (void *) (uintptr_t) i);
+			queued++;
+		}
+		if (!queued)
+			continue;
+
+		rc = io_uring_submit_and_wait(ring, queued);
+		if (rc < 0) {
+			uring_drain(ring, fds, phase);
+			return rc;
+		}
+		for (; queued; queued--) {
+			rc = io_uring_wait_cqe(ring, &cqe);
+			if (rc < 0) {
+				uring_drain(ring, fds, phase);
+				return rc;
+			}
+			idx = (uintptr_t) io_uring_cqe_get_data(cqe);
+			if (phase == SYSFS_OPEN) {
+				fds[idx] = cqe->res;
+				if (cqe->res < 0) {
+					log_dbg(ctx, "failed to open %s: %s\n",
+							reqs[idx].attr,
+							strerror(-cqe->res));
+					reqs[idx].rc = cqe->res;
+				}
+			} else if (phase == SYSFS_READ)
+				reqs[idx].rc = read_done(ctx, reqs[idx].attr,
+						reqs[idx].buf, cqe->res);
+			else
+				fds[idx] = -1;
+			io_uring_cqe_seen(ring, cqe);
+		}
 	}
-	buf[n] = 0;
-	if (n && buf[n-1] == '\n')
-		buf[n-1] = 0;
 	return 0;
 }
 
-static int write_attr(struct log_ctx *ctx, const char *path,
+static int read_attrs_uring(struct log_ctx *ctx, struct sysfs_attr_req *reqs,
+		int nr)
+{
+	struct io_uring ring;
+	int i, rc, *fds;
+
+	if (nr < SYSFS_BATCH_MIN || !uring_supported())
+		return -EOPNOTSUPP;
+	fds = malloc(nr * sizeof(*fds));
+	if (!fds)
+		return -ENOMEM;
+	for (i = 0; i < nr; i++)
+		fds[i] = -1;
+	rc = io_uring_queue_init(SYSFS_RING_DEPTH, &ring, 0);
+	if (rc < 0) {
+		free(fds);
+		return rc;
+	}
+
+	rc = uring_phase(ctx, &ring, reqs, fds, nr, SYSFS_OPEN);
+	if (rc == 0)
+		rc = uring_phase(ctx, &ring, reqs, fds, nr, SYSFS_READ);
+	if (uring_phase(ctx, &ring, reqs, fds, nr, SYSFS_CLOSE) < 0)
+		for (i = 0; i < nr; i++)
+			if (fds[i] >= 0)
+				close(fds[i]);
+	io_uring_queue_exit(&ring);
+	free(fds);
+	return rc;
+}
+#else
+static int read_attrs_uring(struct log_ctx *ctx, struct sysfs_attr_req *reqs,
+		int nr)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+/*
+ * Read a batch of attributes, each relative to its own @dirfd, or
+ * absolute with AT_FDCWD. With io_uring available all the opens, then
+ * all the reads, then all the closes go to the kernel in one
+ * submission each, otherwise they are read one at a time. The outcome
+ * of each read is left in its @rc, as __sysfs_read_attr() would return.
+ */
+void __sysfs_read_attrs(struct log_ctx *ctx, struct sysfs_attr_req *reqs,
+		int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		reqs[i].rc = 0;
+	if (read_attrs_uring(ctx, reqs, nr) < 0)
+		read_attrs_sync(ctx, reqs, nr);
+}
+
+/* an O_PATH handle on a device directory, or -errno */
+int __sysfs_open_dev(struct log_ctx *ctx, const char *path)
+{
+	int fd = open(path, O_PATH|O_DIRECTORY|O_CLOEXEC);
+
+	if (fd < 0) {
+		log_dbg(ctx, "failed to open %s: %s\n", path, strerror(errno));
+		return -errno;
+	}
+	return fd;
+}
+
+static int write_attr(struct log_ctx *ctx, int fd, const char *path,
 		const char *buf, int quiet)
 {
-	int fd = open(path, O_WRONLY|O_CLOEXEC);
 	int n, len = strlen(buf) + 1, rc;
 
 	if (fd < 0) {
@@ -50,8 +282,10 @@ static int write_attr(struct log_ctx *ctx, const char *path,
 		log_dbg(ctx, "failed to open %s: %s\n", path, strerror(errno));
 		return rc;
 	}
+	usdt(sysfs, write_start, path, buf);
 	n = write(fd, buf, len);
 	rc = -errno;
+	usdt(sysfs, write_done, path, n < len ? rc : 0);
 	close(fd);
 	if (n < len) {
 		if (!quiet)
@@ -65,13 +299,20 @@ static int write_attr(struct log_ctx *ctx, const char *path,
 int __sysfs_write_attr(struct log_ctx *ctx, const char *path,
 		const char *buf)
 {
-	return write_attr(ctx, path, buf, 0);
+	return write_attr(ctx, open(path, O_WRONLY|O_CLOEXEC), path, buf, 0);
 }
 
 int __sysfs_write_attr_quiet(struct log_ctx *ctx, const char *path,
 		const char *buf)
 {
-	return write_attr(ctx, path, buf, 1);
+	return write_attr(ctx, open(path, O_WRONLY|O_CLOEXEC), path, buf, 1);
+}
+
+int __sysfs_write_attr_at(struct log_ctx *ctx, int dirfd, const char *attr,
+		const char *buf)
+{
+	return write_attr(ctx, openat(dirfd, attr, O_WRONLY|O_CLOEXEC), attr,
+			buf, 0);
 }
 
 int __sysfs_device_parse(struct log_ctx *ctx, const char *base_path,
@@ -16,12 +16,33 @@ int __sysfs_write_attr_quiet(struct log_ctx *ctx, const char *path,
 		const char *buf);
 int __sysfs_device_parse(struct log_ctx *ctx, const char *base_path,
 		const char *dev_name, void *parent, add_dev_fn add_dev);
+int __sysfs_open_dev(struct log_ctx *ctx, const char *path);
+int __sysfs_read_attr_at(struct log_ctx *ctx, int dirfd, const char *attr,
+		char *buf);
+int __sysfs_write_attr_at(struct log_ctx *ctx, int dirfd, const char *attr,
+		const char *buf);
+
+struct sysfs_attr_req {
+	int dirfd;
+	const char *attr;
+	char *buf; /* SYSFS_ATTR_SIZE bytes */
+	int rc;
+};
+
+void __sysfs_read_attrs(struct log_ctx *ctx, struct sysfs_attr_req *reqs,
+		int nr);
 
 #define sysfs_read_attr(c, p, b) __sysfs_read_attr(&(c)->ctx, (p), (b))
 #define sysfs_write_attr(c, p, b) __sysfs_write_attr(&(c)->ctx, (p), (b))
 #define sysfs_write_attr_quiet(c, p, b) __sysfs_write_attr_quiet(&(c)->ctx, (p), (b))
 #define sysfs_device_parse(c, b, d, p, fn) __sysfs_device_parse(&(c)->ctx, \
 		(b), (d), (p), (fn))
+#define sysfs_open_dev(c, p) __sysfs_open_dev(&(c)->ctx, (p))
+#define sysfs_read_attr_at(c, d, a, b) __sysfs_read_attr_at(&(c)->ctx, \
+		(d), (a), (b))
+#define sysfs_write_attr_at(c, d, a, b) __sysfs_write_attr_at(&(c)->ctx, \
+		(d), (a), (b))
+#define sysfs_read_attrs(c, r, n) __sysfs_read_attrs(&(c)->ctx, (r), (n))
 
 static inline const char *devpath_to_devname(const char *devpath)
 {
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: LGPL-2.1 */
+#ifndef _UTIL_USDT_H_
+#define _UTIL_USDT_H_
+
+/*
+ * Static probe points for bpftrace, perf and systemtap, for example:
+ *
+ *   bpftrace -e 'usdt:/usr/lib64/libcxl.so.1:libcxl:mbox_done
+ *		{ @us[arg0] = hist(arg5 / 1000); }'
+ *
+ * They are built in with "configure --enable-usdt", and compile to
+ * nothing otherwise. A built-in probe nobody is attached to is a nop,
+ * so arguments should be values already at hand, not computed for the
+ * probe alone.
+ */
+#ifdef ENABLE_USDT
+#include <sys/sdt.h>
+#define usdt(provider, name, ...) STAP_PROBEV(provider, name, __VA_ARGS__)
+#else
+#define usdt(provider, name, ...) do { } while (0)
+#endif
+
+#endif /* _UTIL_USDT_H_ */